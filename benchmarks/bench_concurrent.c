@@ -0,0 +1,315 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/**
+ * Multi-threaded contention on the thread-safe modes of the containers.
+ *
+ * Every thread runs BENCH_NUM / BENCH_THREADS operations on the shared
+ * container. The lookup heavy runs mix 9 lookups with 1 update.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "qbench.h"
+#include "qlibc.h"
+
+#define NUM_KEYS        (100000)
+#define UPDATE_EVERY    (10)
+
+static char *keys[NUM_KEYS];
+static int values[NUM_KEYS];
+
+static qhashtbl_t *hashtbl = NULL;
+static qtreetbl_t *treetbl = NULL;
+static qskiplist_t *skiplist = NULL;
+static qvector_t *vector = NULL;
+static qqueue_t *queue = NULL;
+static qpqueue_t *pqueue = NULL;
+static qcuckoo_t *cuckoo = NULL;
+static qbloom_t *bloom = NULL;
+
+static size_t per_thread(void) {
+    return BENCH_NUM / BENCH_THREADS;
+}
+
+// xorshift, so the threads don't share the state of rand().
+static uint32_t next_rand(uint32_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static int cmp_int(const void *data1, const void *data2) {
+    int a = *(const int *) data1, b = *(const int *) data2;
+    return (a > b) - (a < b);
+}
+
+static void run_hashtbl(int id, void *arg) {
+    bool lockfree = (*(int *) arg & QHASHTBL_LOCKFREE_READ) != 0;
+    uint32_t state = id + 1;
+    size_t i, num = per_thread();
+    for (i = 0; i < num; i++) {
+        const char *key = keys[next_rand(&state) % NUM_KEYS];
+        if ((i % UPDATE_EVERY) == 0) {
+            BENCH_OP(hashtbl->put(hashtbl, key, &i, sizeof(int)));
+        } else if (lockfree) {
+            hashtbl->read_enter(hashtbl);
+            BENCH_OP(BENCH_SINK(hashtbl->get(hashtbl, key, NULL, false)));
+            hashtbl->read_leave(hashtbl);
+        } else {
+            void *data;
+            BENCH_OP(data = hashtbl->get(hashtbl, key, NULL, true));
+            free(data);
+        }
+    }
+}
+
+static void run_treetbl(int id, void *arg) {
+    uint32_t state = id + 1;
+    size_t i, num = per_thread();
+    for (i = 0; i < num; i++) {
+        const char *key = keys[next_rand(&state) % NUM_KEYS];
+        if ((i % UPDATE_EVERY) == 0) {
+            BENCH_OP(treetbl->put(treetbl, key, &i, sizeof(int)));
+        } else {
+            void *data;
+            BENCH_OP(data = treetbl->get(treetbl, key, NULL, true));
+            free(data);
+        }
+    }
+}
+
+static void run_skiplist(int id, void *arg) {
+    uint32_t state = id + 1;
+    size_t i, num = per_thread();
+    for (i = 0; i < num; i++) {
+        const char *key = keys[next_rand(&state) % NUM_KEYS];
+        if ((i % UPDATE_EVERY) == 0) {
+            BENCH_OP(skiplist->put(skiplist, key, &i, sizeof(int)));
+        } else {
+            skiplist->read_enter(skiplist);
+            BENCH_OP(BENCH_SINK(skiplist->get(skiplist, key, NULL, false)));
+            skiplist->read_leave(skiplist);
+        }
+    }
+}
+
+static void run_vector(int id, void *arg) {
+    size_t i, num = per_thread();
+    for (i = 0; i < num; i++) {
+        BENCH_OP(vector->addlast(vector, &values[i % NUM_KEYS]));
+    }
+}
+
+static void run_queue(int id, void *arg) {
+    size_t i, num = per_thread();
+    for (i = 0; i < num; i++) {
+        if ((i % 2) == 0) {
+            BENCH_OP(queue->push(queue, &values[i % NUM_KEYS], sizeof(int)));
+        } else {
+            void *data;
+            BENCH_OP(data = queue->pop(queue, NULL));
+            free(data);
+        }
+    }
+}
+
+static void run_pqueue(int id, void *arg) {
+    size_t i, num = per_thread();
+    for (i = 0; i < num; i++) {
+        if ((i % 2) == 0) {
+            BENCH_OP(pqueue->push(pqueue, &values[i % NUM_KEYS]));
+        } else {
+            BENCH_OP(pqueue->removetop(pqueue));
+        }
+    }
+}
+
+static void run_cuckoo(int id, void *arg) {
+    uint32_t state = id + 1;
+    size_t i, num = per_thread();
+    for (i = 0; i < num; i++) {
+        const char *key = keys[next_rand(&state) % NUM_KEYS];
+        if ((i % UPDATE_EVERY) == 0) {
+            BENCH_OP(cuckoo->add(cuckoo, key, strlen(key)));
+        } else {
+            BENCH_OP(BENCH_SINK(cuckoo->check(cuckoo, key, strlen(key))));
+        }
+    }
+}
+
+static void run_bloom(int id, void *arg) {
+    uint32_t state = id + 1;
+    size_t i, num = per_thread();
+    for (i = 0; i < num; i++) {
+        const char *key = keys[next_rand(&state) % NUM_KEYS];
+        if ((i % UPDATE_EVERY) == 0) {
+            BENCH_OP(bloom->add(bloom, key, strlen(key)));
+        } else {
+            BENCH_OP(BENCH_SINK(bloom->check(bloom, key, strlen(key))));
+        }
+    }
+}
+
+static void *nop_task(void *arg) {
+    return arg;
+}
+
+static void touch_range(size_t begin, size_t end, void *userdata) {
+    int *data = (int *) userdata;
+    size_t i;
+    for (i = begin; i < end; i++) {
+        data[i] = data[i] * 3 + 1;
+    }
+}
+
+QBENCH_START("Benchmark qlibc thread-safe containers");
+size_t i;
+for (i = 0; i < NUM_KEYS; i++) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "key%zu", i);
+    keys[i] = strdup(buf);
+    values[i] = rand();
+}
+
+{
+    int modes[] = { QHASHTBL_THREADSAFE, QHASHTBL_STRIPED,
+                    QHASHTBL_LOCKFREE_READ };
+    const char *names[] = { "qhashtbl/THREADSAFE 90% get()",
+                            "qhashtbl/STRIPED 90% get()",
+                            "qhashtbl/LOCKFREE_READ 90% get()" };
+    int m;
+    for (m = 0; m < 3; m++) {
+        BENCH(names[m]) {
+            hashtbl = qhashtbl(NUM_KEYS, modes[m]);
+            for (i = 0; i < NUM_KEYS; i++) {
+                hashtbl->put(hashtbl, keys[i], &values[i], sizeof(int));
+            }
+            BENCH_RUN_THREADS(run_hashtbl, &modes[m]);
+            hashtbl->free(hashtbl);
+        }
+    }
+}
+
+{
+    int modes[] = { QTREETBL_THREADSAFE, QTREETBL_RWLOCK };
+    const char *names[] = { "qtreetbl/THREADSAFE 90% get()",
+                            "qtreetbl/RWLOCK 90% get()" };
+    int m;
+    for (m = 0; m < 2; m++) {
+        BENCH(names[m]) {
+            treetbl = qtreetbl(modes[m]);
+            for (i = 0; i < NUM_KEYS; i++) {
+                treetbl->put(treetbl, keys[i], &values[i], sizeof(int));
+            }
+            BENCH_RUN_THREADS(run_treetbl, NULL);
+            treetbl->free(treetbl);
+        }
+    }
+}
+
+BENCH("qskiplist 90% get()") {
+    skiplist = qskiplist();
+    for (i = 0; i < NUM_KEYS; i++) {
+        skiplist->put(skiplist, keys[i], &values[i], sizeof(int));
+    }
+    BENCH_RUN_THREADS(run_skiplist, NULL);
+    skiplist->free(skiplist);
+}
+
+BENCH("qvector/THREADSAFE addlast()") {
+    vector = qvector(0, sizeof(int), QVECTOR_THREADSAFE
+                     | QVECTOR_RESIZE_DOUBLE);
+    BENCH_RUN_THREADS(run_vector, NULL);
+    vector->free(vector);
+}
+
+BENCH("qqueue/THREADSAFE push()/pop()") {
+    queue = qqueue(QQUEUE_THREADSAFE);
+    BENCH_RUN_THREADS(run_queue, NULL);
+    queue->free(queue);
+}
+
+BENCH("qpqueue/THREADSAFE push()/removetop()") {
+    pqueue = qpqueue(0, sizeof(int), cmp_int, QPQUEUE_THREADSAFE);
+    BENCH_RUN_THREADS(run_pqueue, NULL);
+    pqueue->free(pqueue);
+}
+
+BENCH("qcuckoo/THREADSAFE 90% check()") {
+    size_t memsize = qcuckoo_calculate_memsize(NUM_KEYS * 2);
+    void *memory = malloc(memsize);
+    cuckoo = qcuckoo(memory, memsize, QCUCKOO_THREADSAFE);
+    for (i = 0; i < NUM_KEYS; i++) {
+        cuckoo->add(cuckoo, keys[i], strlen(keys[i]));
+    }
+    BENCH_RUN_THREADS(run_cuckoo, NULL);
+    cuckoo->free(cuckoo);
+    free(memory);
+}
+
+BENCH("qbloom 90% check()") {
+    size_t memsize = qbloom_calculate_memsize(NUM_KEYS, 0.01);
+    void *memory = malloc(memsize);
+    bloom = qbloom(memory, memsize, NUM_KEYS);
+    BENCH_RUN_THREADS(run_bloom, NULL);
+    bloom->free(bloom);
+    free(memory);
+}
+
+{
+    qthreadpool_t *pool = qthreadpool(BENCH_THREADS);
+
+    BENCH("qthreadpool submit()") {
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            BENCH_OP(qthreadpool_submit(pool, nop_task, NULL));
+        }
+        qthreadpool_wait(pool);
+        BENCH_STOP();
+    }
+
+    BENCH("qthreadpool_parallel_for()") {
+        int *data = (int *) calloc(BENCH_NUM, sizeof(int));
+        BENCH_START();
+        qthreadpool_parallel_for(pool, 0, BENCH_NUM, 0, touch_range, data);
+        BENCH_OPS(BENCH_NUM);
+        BENCH_STOP();
+        free(data);
+    }
+
+    qthreadpool_free(pool);
+}
+
+for (i = 0; i < NUM_KEYS; i++) {
+    free(keys[i]);
+}
+QBENCH_END();
@@ -0,0 +1,686 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/**
+ * Single thread throughput and latency of the containers.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "qbench.h"
+#include "qlibc.h"
+#include "containers/qinline.h"
+
+static char **keys = NULL;      // "key<n>" in a shuffled order
+static char **misses = NULL;    // keys not in the containers
+static int *values = NULL;      // random integers
+
+static void make_inputs(size_t num) {
+    keys = (char **) malloc(sizeof(char *) * num);
+    misses = (char **) malloc(sizeof(char *) * num);
+    values = (int *) malloc(sizeof(int) * num);
+
+    size_t i;
+    for (i = 0; i < num; i++) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "key%zu", i);
+        keys[i] = strdup(buf);
+        snprintf(buf, sizeof(buf), "miss%zu", i);
+        misses[i] = strdup(buf);
+        values[i] = rand();
+    }
+    for (i = num - 1; i > 0; i--) {
+        size_t j = (size_t) rand() % (i + 1);
+        char *swap = keys[i];
+        keys[i] = keys[j];
+        keys[j] = swap;
+    }
+}
+
+static void free_inputs(size_t num) {
+    size_t i;
+    for (i = 0; i < num; i++) {
+        free(keys[i]);
+        free(misses[i]);
+    }
+    free(keys);
+    free(misses);
+    free(values);
+}
+
+static int cmp_int(const void *data1, const void *data2) {
+    int a = *(const int *) data1, b = *(const int *) data2;
+    return (a > b) - (a < b);
+}
+
+static void on_timer(qtimerwheel_t *wheel, int64_t timerid, void *userdata) {
+}
+
+static inline uint32_t hash_id(const uint64_t *key) {
+    return qinline_hash64(*key);
+}
+
+Q_HASHTBL_TYPED(idmap, uint64_t, int, hash_id)
+Q_VECTOR_TYPED(intvec, int)
+
+static void bench_qhashtbl(const char *title, int options) {
+    char name[64];
+    size_t i;
+    qhashtbl_t *tbl = qhashtbl((options & QHASHTBL_AUTORESIZE) ? 0 : BENCH_NUM,
+                               options);
+
+    snprintf(name, sizeof(name), "%s put()", title);
+    BENCH(name) {
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            BENCH_OP(tbl->put(tbl, keys[i], &values[i], sizeof(int)));
+        }
+        BENCH_STOP();
+    }
+
+    snprintf(name, sizeof(name), "%s get()", title);
+    BENCH(name) {
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            BENCH_OP(BENCH_SINK(tbl->get(tbl, keys[i], NULL, false)));
+        }
+        BENCH_STOP();
+    }
+
+    snprintf(name, sizeof(name), "%s get() miss", title);
+    BENCH(name) {
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            BENCH_OP(BENCH_SINK(tbl->get(tbl, misses[i], NULL, false)));
+        }
+        BENCH_STOP();
+    }
+
+    snprintf(name, sizeof(name), "%s getnext()", title);
+    BENCH(name) {
+        qhashtbl_obj_t obj;
+        memset((void *) &obj, 0, sizeof(obj));
+        BENCH_START();
+        bool found = true;
+        while (found) {
+            BENCH_OP(found = tbl->getnext(tbl, &obj, false));
+        }
+        BENCH_STOP();
+    }
+
+    snprintf(name, sizeof(name), "%s remove()", title);
+    BENCH(name) {
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            BENCH_OP(tbl->remove(tbl, keys[i]));
+        }
+        BENCH_STOP();
+    }
+
+    tbl->free(tbl);
+}
+
+static void bench_qtreetbl(const char *title, int options) {
+    char name[64];
+    size_t i;
+    qtreetbl_t *tbl = qtreetbl(options);
+
+    snprintf(name, sizeof(name), "%s put()", title);
+    BENCH(name) {
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            BENCH_OP(tbl->put(tbl, keys[i], &values[i], sizeof(int)));
+        }
+        BENCH_STOP();
+    }
+
+    snprintf(name, sizeof(name), "%s get()", title);
+    BENCH(name) {
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            BENCH_OP(BENCH_SINK(tbl->get(tbl, keys[i], NULL, false)));
+        }
+        BENCH_STOP();
+    }
+
+    snprintf(name, sizeof(name), "%s getnext()", title);
+    BENCH(name) {
+        qtreetbl_obj_t obj;
+        memset((void *) &obj, 0, sizeof(obj));
+        BENCH_START();
+        bool found = true;
+        while (found) {
+            BENCH_OP(found = tbl->getnext(tbl, &obj, false));
+        }
+        BENCH_STOP();
+    }
+
+    snprintf(name, sizeof(name), "%s remove()", title);
+    BENCH(name) {
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            BENCH_OP(tbl->remove(tbl, keys[i]));
+        }
+        BENCH_STOP();
+    }
+
+    tbl->free(tbl);
+}
+
+QBENCH_START("Benchmark qlibc containers");
+make_inputs(BENCH_NUM);
+size_t i;
+
+bench_qhashtbl("qhashtbl", 0);
+bench_qhashtbl("qhashtbl/AUTORESIZE", QHASHTBL_AUTORESIZE);
+bench_qhashtbl("qhashtbl/OPENADDR", QHASHTBL_OPENADDR);
+bench_qtreetbl("qtreetbl", 0);
+bench_qtreetbl("qtreetbl/BPTREE", QTREETBL_BPTREE);
+
+{
+    size_t memsize = qhasharr_calculate_memsize(BENCH_NUM * 2);
+    void *memory = malloc(memsize);
+    qhasharr_t *tbl = qhasharr(memory, memsize);
+
+    BENCH("qhasharr put()") {
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            BENCH_OP(tbl->put(tbl, keys[i], &values[i], sizeof(int)));
+        }
+        BENCH_STOP();
+    }
+    BENCH("qhasharr get()") {
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            void *data;
+            BENCH_OP(data = tbl->get(tbl, keys[i], NULL));
+            free(data);
+        }
+        BENCH_STOP();
+    }
+    BENCH("qhasharr getnext()") {
+        qhasharr_obj_t obj;
+        int idx = 0;
+        bool found = true;
+        BENCH_START();
+        while (found) {
+            BENCH_OP(found = tbl->getnext(tbl, &obj, &idx));
+            if (found) {
+                free(obj.name);
+                free(obj.data);
+            }
+        }
+        BENCH_STOP();
+    }
+    BENCH("qhasharr remove()") {
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            BENCH_OP(tbl->remove(tbl, keys[i]));
+        }
+        BENCH_STOP();
+    }
+
+    tbl->free(tbl);
+    free(memory);
+}
+
+{
+    qlisttbl_t *tbl = qlisttbl(QLISTTBL_HASHINDEX);
+
+    BENCH("qlisttbl/HASHINDEX put()") {
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            BENCH_OP(tbl->put(tbl, keys[i], &values[i], sizeof(int)));
+        }
+        BENCH_STOP();
+    }
+    BENCH("qlisttbl/HASHINDEX get()") {
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            BENCH_OP(BENCH_SINK(tbl->get(tbl, keys[i], NULL, false)));
+        }
+        BENCH_STOP();
+    }
+    BENCH("qlisttbl/HASHINDEX getnext()") {
+        qlisttbl_obj_t obj;
+        memset((void *) &obj, 0, sizeof(obj));
+        bool found = true;
+        BENCH_START();
+        while (found) {
+            BENCH_OP(found = tbl->getnext(tbl, &obj, NULL, false));
+        }
+        BENCH_STOP();
+    }
+    BENCH("qlisttbl/HASHINDEX remove()") {
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            BENCH_OP(tbl->remove(tbl, keys[i]));
+        }
+        BENCH_STOP();
+    }
+
+    tbl->free(tbl);
+}
+
+{
+    qskiplist_t *list = qskiplist();
+
+    BENCH("qskiplist put()") {
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            BENCH_OP(list->put(list, keys[i], &values[i], sizeof(int)));
+        }
+        BENCH_STOP();
+    }
+    BENCH("qskiplist get()") {
+        list->read_enter(list);
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            BENCH_OP(BENCH_SINK(list->get(list, keys[i], NULL, false)));
+        }
+        BENCH_STOP();
+        list->read_leave(list);
+    }
+    BENCH("qskiplist getnext()") {
+        qskiplist_obj_t obj;
+        memset((void *) &obj, 0, sizeof(obj));
+        bool found = true;
+        list->read_enter(list);
+        BENCH_START();
+        while (found) {
+            BENCH_OP(found = list->getnext(list, &obj, false));
+        }
+        BENCH_STOP();
+        list->read_leave(list);
+    }
+    BENCH("qskiplist remove()") {
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            BENCH_OP(list->remove(list, keys[i]));
+        }
+        BENCH_STOP();
+    }
+
+    list->free(list);
+}
+
+{
+    qvector_t *vector = qvector(0, sizeof(int), QVECTOR_RESIZE_DOUBLE);
+
+    BENCH("qvector addlast()") {
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            BENCH_OP(vector->addlast(vector, &values[i]));
+        }
+        BENCH_STOP();
+    }
+    BENCH("qvector getat()") {
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            BENCH_OP(BENCH_SINK(vector->getat(vector, (int) i, false)));
+        }
+        BENCH_STOP();
+    }
+    BENCH("qvector getnext()") {
+        qvector_obj_t obj;
+        memset((void *) &obj, 0, sizeof(obj));
+        bool found = true;
+        BENCH_START();
+        while (found) {
+            BENCH_OP(found = vector->getnext(vector, &obj, false));
+        }
+        BENCH_STOP();
+    }
+    BENCH("qvector sort()") {
+        qvector_t *copy = qvector(BENCH_NUM, sizeof(int), 0);
+        copy->addarray(copy, values, BENCH_NUM);
+        BENCH_START();
+        copy->sort(copy, cmp_int);
+        BENCH_OPS(BENCH_NUM);
+        BENCH_STOP();
+        copy->free(copy);
+    }
+    BENCH("qvector_parallel_sort()") {
+        qthreadpool_t *pool = qthreadpool(BENCH_THREADS);
+        qvector_t *copy = qvector(BENCH_NUM, sizeof(int), 0);
+        copy->addarray(copy, values, BENCH_NUM);
+        BENCH_START();
+        qvector_parallel_sort(copy, pool, cmp_int);
+        BENCH_OPS(BENCH_NUM);
+        BENCH_STOP();
+        copy->free(copy);
+        qthreadpool_free(pool);
+    }
+    BENCH("qvector removelast()") {
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            BENCH_OP(vector->removelast(vector));
+        }
+        BENCH_STOP();
+    }
+
+    vector->free(vector);
+}
+
+{
+    qhashtbl_t *tbl = qhashtbl(BENCH_NUM, 0);
+    qvector_t *vector = intvec_new(0, QVECTOR_RESIZE_DOUBLE);
+
+    BENCH("qinline idmap_put()") {
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            BENCH_OP(idmap_put(tbl, (uint64_t) values[i], values[i]));
+        }
+        BENCH_STOP();
+    }
+    BENCH("qinline idmap_get()") {
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            BENCH_OP(BENCH_SINK(idmap_get(tbl, (uint64_t) values[i])));
+        }
+        BENCH_STOP();
+    }
+    BENCH("qinline intvec_addlast()") {
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            BENCH_OP(intvec_addlast(vector, values[i]));
+        }
+        BENCH_STOP();
+    }
+    BENCH("qinline intvec_getat()") {
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            BENCH_OP(BENCH_SINK(intvec_getat(vector, (int) i)));
+        }
+        BENCH_STOP();
+    }
+
+    vector->free(vector);
+    tbl->free(tbl);
+}
+
+{
+    qlist_t *list = qlist(0);
+
+    BENCH("qlist addlast()") {
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            BENCH_OP(list->addlast(list, &values[i], sizeof(int)));
+        }
+        BENCH_STOP();
+    }
+    BENCH("qlist getnext()") {
+        qlist_obj_t obj;
+        memset((void *) &obj, 0, sizeof(obj));
+        bool found = true;
+        BENCH_START();
+        while (found) {
+            BENCH_OP(found = list->getnext(list, &obj, false));
+        }
+        BENCH_STOP();
+    }
+    BENCH("qlist removefirst()") {
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            BENCH_OP(list->removefirst(list));
+        }
+        BENCH_STOP();
+    }
+
+    list->free(list);
+}
+
+{
+    qqueue_t *queue = qqueue(0);
+    qstack_t *stack = qstack(0);
+
+    BENCH("qqueue push()") {
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            BENCH_OP(queue->push(queue, &values[i], sizeof(int)));
+        }
+        BENCH_STOP();
+    }
+    BENCH("qqueue pop()") {
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            void *data;
+            BENCH_OP(data = queue->pop(queue, NULL));
+            free(data);
+        }
+        BENCH_STOP();
+    }
+    BENCH("qstack push()") {
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            BENCH_OP(stack->push(stack, &values[i], sizeof(int)));
+        }
+        BENCH_STOP();
+    }
+    BENCH("qstack pop()") {
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            void *data;
+            BENCH_OP(data = stack->pop(stack, NULL));
+            free(data);
+        }
+        BENCH_STOP();
+    }
+
+    queue->free(queue);
+    stack->free(stack);
+}
+
+{
+    qdeque_t *dq = qdeque(0);
+
+    BENCH("qdeque push()") {
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            BENCH_OP(dq->push(dq, &values[i]));
+        }
+        BENCH_STOP();
+    }
+    BENCH("qdeque pop()") {
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            BENCH_OP(BENCH_SINK(dq->pop(dq)));
+        }
+        BENCH_STOP();
+    }
+
+    dq->free(dq);
+}
+
+{
+    qpqueue_t *pqueue = qpqueue(0, sizeof(int), cmp_int, 0);
+
+    BENCH("qpqueue push()") {
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            BENCH_OP(pqueue->push(pqueue, &values[i]));
+        }
+        BENCH_STOP();
+    }
+    BENCH("qpqueue removetop()") {
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            BENCH_OP(pqueue->removetop(pqueue));
+        }
+        BENCH_STOP();
+    }
+    BENCH("qpqueue pusharray()") {
+        BENCH_START();
+        pqueue->pusharray(pqueue, values, BENCH_NUM, NULL);
+        BENCH_OPS(BENCH_NUM);
+        BENCH_STOP();
+    }
+
+    pqueue->free(pqueue);
+}
+
+{
+    qtimerwheel_t *wheel = qtimerwheel(1, 0);
+    int64_t *ids = (int64_t *) malloc(sizeof(int64_t) * BENCH_NUM);
+
+    BENCH("qtimerwheel add()") {
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            BENCH_OP(ids[i] = wheel->add(wheel, values[i] % 60000 + 1,
+                                         on_timer, NULL));
+        }
+        BENCH_STOP();
+    }
+    BENCH("qtimerwheel cancel()") {
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            BENCH_OP(wheel->cancel(wheel, ids[i]));
+        }
+        BENCH_STOP();
+    }
+
+    free(ids);
+    wheel->free(wheel);
+}
+
+{
+    size_t memsize = qbloom_calculate_memsize(BENCH_NUM, 0.01);
+    void *memory = malloc(memsize);
+    qbloom_t *bloom = qbloom(memory, memsize, BENCH_NUM);
+
+    BENCH("qbloom add()") {
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            BENCH_OP(bloom->add(bloom, keys[i], strlen(keys[i])));
+        }
+        BENCH_STOP();
+    }
+    BENCH("qbloom check()") {
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            BENCH_OP(BENCH_SINK(bloom->check(bloom, misses[i],
+                                             strlen(misses[i]))));
+        }
+        BENCH_STOP();
+    }
+
+    bloom->free(bloom);
+    free(memory);
+}
+
+{
+    size_t memsize = qcuckoo_calculate_memsize(BENCH_NUM);
+    void *memory = malloc(memsize);
+    qcuckoo_t *cuckoo = qcuckoo(memory, memsize, 0);
+
+    BENCH("qcuckoo add()") {
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            BENCH_OP(cuckoo->add(cuckoo, keys[i], strlen(keys[i])));
+        }
+        BENCH_STOP();
+    }
+    BENCH("qcuckoo check()") {
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            BENCH_OP(BENCH_SINK(cuckoo->check(cuckoo, keys[i],
+                                              strlen(keys[i]))));
+        }
+        BENCH_STOP();
+    }
+    BENCH("qcuckoo remove()") {
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            BENCH_OP(cuckoo->remove(cuckoo, keys[i], strlen(keys[i])));
+        }
+        BENCH_STOP();
+    }
+
+    cuckoo->free(cuckoo);
+    free(memory);
+}
+
+{
+    size_t memsize = qhll_calculate_memsize(14);
+    void *memory = malloc(memsize);
+    qhll_t *hll = qhll(memory, memsize, 14);
+
+    BENCH("qhll add()") {
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            BENCH_OP(hll->add(hll, keys[i], strlen(keys[i])));
+        }
+        BENCH_STOP();
+    }
+
+    hll->free(hll);
+    free(memory);
+}
+
+{
+    qarena_t *arena = qarena(0, 0);
+    qstrpool_t *pool = qstrpool(0, 0);
+
+    BENCH("qarena alloc()") {
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            BENCH_OP(BENCH_SINK(arena->alloc(arena, 32)));
+        }
+        BENCH_STOP();
+    }
+    BENCH("qstrpool internstr()") {
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            BENCH_OP(BENCH_SINK(pool->internstr(pool, keys[i % 1000])));
+        }
+        BENCH_STOP();
+    }
+
+    arena->free(arena);
+    pool->free(pool);
+}
+
+{
+    qgrow_t *grow = qgrow(0);
+
+    BENCH("qgrow addstr()") {
+        BENCH_START();
+        for (i = 0; i < BENCH_NUM; i++) {
+            BENCH_OP(grow->addstr(grow, keys[i]));
+            BENCH_BYTES(strlen(keys[i]));
+        }
+        BENCH_STOP();
+    }
+
+    grow->free(grow);
+}
+
+free_inputs(BENCH_NUM);
+QBENCH_END();
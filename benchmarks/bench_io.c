@@ -0,0 +1,241 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/**
+ * Loopback throughput of qio and qhttpclient.
+ *
+ * The peers run in threads of the same process on 127.0.0.1, so the
+ * numbers are the library and kernel overhead without the network.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "qbench.h"
+#include "qlibc.h"
+#include "qlibcext.h"
+
+#define TIMEOUT_MS      (10000)
+#define LINE_SIZE       (100)
+
+static int listenfd = -1;
+static size_t bodysize = 0;
+static size_t numlines = 0;
+
+static int listen_loopback(int *port) {
+    int fd = qsocket_listen("127.0.0.1", 0, 16, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    struct sockaddr_in addr;
+    socklen_t addrlen = sizeof(addr);
+    getsockname(fd, (struct sockaddr *) &addr, &addrlen);
+    *port = ntohs(addr.sin_port);
+    return fd;
+}
+
+// reads everything until the peer closes.
+static void *drain_main(void *arg) {
+    int fd = accept(listenfd, NULL, NULL);
+    char buf[64 * 1024];
+    while (read(fd, buf, sizeof(buf)) > 0) {
+        ;
+    }
+    close(fd);
+    return NULL;
+}
+
+// writes numlines lines of LINE_SIZE bytes.
+static void *lines_main(void *arg) {
+    int fd = accept(listenfd, NULL, NULL);
+    char line[LINE_SIZE + 1];
+    memset(line, 'x', LINE_SIZE - 1);
+    line[LINE_SIZE - 1] = '\n';
+    line[LINE_SIZE] = '\0';
+
+    char buf[LINE_SIZE * 100];
+    size_t i;
+    for (i = 0; i < 100; i++) {
+        memcpy(buf + i * LINE_SIZE, line, LINE_SIZE);
+    }
+    for (i = 0; i < numlines; i += 100) {
+        size_t n = (numlines - i < 100) ? numlines - i : 100;
+        if (qio_write(fd, buf, n * LINE_SIZE, TIMEOUT_MS) < 0) {
+            break;
+        }
+    }
+    close(fd);
+    return NULL;
+}
+
+// answers keep-alive GET requests with a body of bodysize bytes.
+static void *http_main(void *arg) {
+    int fd = accept(listenfd, NULL, NULL);
+    qio_reader_t *reader = qio_reader(fd, 0);
+
+    // a single write per response, so Nagle does not hold the body back.
+    char header[128];
+    int headerlen = snprintf(header, sizeof(header), "HTTP/1.1 200 OK\r\n"
+                             "Content-Length: %zu\r\n"
+                             "Connection: keep-alive\r\n\r\n", bodysize);
+    size_t ressize = headerlen + bodysize;
+    char *res = (char *) malloc(ressize);
+    memcpy(res, header, headerlen);
+    memset(res + headerlen, 'b', bodysize);
+
+    char line[1024];
+    while (true) {
+        bool request = false;
+        ssize_t len;
+        while ((len = qio_reader_gets(reader, line, sizeof(line),
+                                      TIMEOUT_MS)) >= 0) {
+            request = true;
+            if (line[0] == '\0') {
+                break;   // end of the headers
+            }
+        }
+        if (request == false || len < 0) {
+            break;
+        }
+        if (qio_write(fd, res, ressize, TIMEOUT_MS) < 0) {
+            break;
+        }
+    }
+
+    free(res);
+    qio_reader_free(reader);
+    close(fd);
+    return NULL;
+}
+
+QBENCH_START("Benchmark qlibc I/O on loopback");
+signal(SIGPIPE, SIG_IGN);
+int port;
+pthread_t peer;
+
+{
+    size_t sizes[] = { 1024, 64 * 1024 };
+    int s;
+    for (s = 0; s < 2; s++) {
+        char name[64];
+        snprintf(name, sizeof(name), "qio_write() %zuB", sizes[s]);
+        BENCH(name) {
+            listenfd = listen_loopback(&port);
+            pthread_create(&peer, NULL, drain_main, NULL);
+            int fd = qsocket_open("127.0.0.1", port, TIMEOUT_MS);
+            char *buf = (char *) calloc(1, sizes[s]);
+            size_t i, times = BENCH_NUM * 64 / sizes[s];
+
+            BENCH_START();
+            for (i = 0; i < times; i++) {
+                BENCH_OP(qio_write(fd, buf, sizes[s], TIMEOUT_MS));
+                BENCH_BYTES(sizes[s]);
+            }
+            BENCH_STOP();
+
+            close(fd);
+            pthread_join(peer, NULL);
+            close(listenfd);
+            free(buf);
+        }
+    }
+}
+
+BENCH("qio_reader_gets() 100B lines") {
+    numlines = BENCH_NUM;
+    listenfd = listen_loopback(&port);
+    pthread_create(&peer, NULL, lines_main, NULL);
+    int fd = qsocket_open("127.0.0.1", port, TIMEOUT_MS);
+    qio_reader_t *reader = qio_reader(fd, 0);
+    char line[LINE_SIZE * 2];
+    ssize_t len = 0;
+
+    BENCH_START();
+    while (len >= 0) {
+        BENCH_OP(len = qio_reader_gets(reader, line, sizeof(line),
+                                       TIMEOUT_MS));
+        if (len >= 0) {
+            BENCH_BYTES(len + 1);
+        }
+    }
+    BENCH_STOP();
+
+    qio_reader_free(reader);
+    close(fd);
+    pthread_join(peer, NULL);
+    close(listenfd);
+}
+
+{
+    size_t sizes[] = { 128, 64 * 1024 };
+    int s;
+    for (s = 0; s < 2; s++) {
+        char name[64];
+        snprintf(name, sizeof(name), "qhttpclient GET keep-alive %zuB",
+                 sizes[s]);
+        BENCH(name) {
+            bodysize = sizes[s];
+            listenfd = listen_loopback(&port);
+            pthread_create(&peer, NULL, http_main, NULL);
+            qhttpclient_t *client = qhttpclient("127.0.0.1", port);
+            client->setkeepalive(client, true);
+            client->settimeout(client, TIMEOUT_MS);
+            size_t i, times = BENCH_NUM / 10;
+
+            BENCH_START();
+            for (i = 0; i < times; i++) {
+                int rescode = 0;
+                size_t contentslength = 0;
+                void *content;
+                BENCH_OP(content = client->cmd(client, "GET", "/", NULL, 0,
+                                               &rescode, &contentslength,
+                                               NULL, NULL));
+                if (content == NULL || rescode != 200) {
+                    fprintf(stderr, "request failed.\n");
+                    free(content);
+                    break;
+                }
+                BENCH_BYTES(contentslength);
+                free(content);
+            }
+            BENCH_STOP();
+
+            client->free(client);
+            pthread_join(peer, NULL);
+            close(listenfd);
+        }
+    }
+}
+
+QBENCH_END();
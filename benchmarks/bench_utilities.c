@@ -0,0 +1,188 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/**
+ * Throughput of the encoders and the hash functions.
+ *
+ * Each function runs over inputs of several sizes until BENCH_NUM * 64
+ * bytes have been processed, so the rates of small and large inputs are
+ * measured on the same amount of data.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "qbench.h"
+#include "qlibc.h"
+
+#define BYTES_PER_NUM   (64)
+
+typedef void (*bench_fn_t) (const void *src, size_t size, void *dst,
+                            size_t dstsize);
+
+static void do_md5(const void *src, size_t size, void *dst, size_t dstsize) {
+    qhashmd5(src, size, dst);
+}
+
+static void do_sha256(const void *src, size_t size, void *dst,
+                      size_t dstsize) {
+    qhashsha256(src, size, dst);
+}
+
+static void do_fnv1_32(const void *src, size_t size, void *dst,
+                       size_t dstsize) {
+    BENCH_SINK(qhashfnv1_32(src, size));
+}
+
+static void do_fnv1_64(const void *src, size_t size, void *dst,
+                       size_t dstsize) {
+    BENCH_SINK(qhashfnv1_64(src, size));
+}
+
+static void do_murmur3_32(const void *src, size_t size, void *dst,
+                          size_t dstsize) {
+    BENCH_SINK(qhashmurmur3_32(src, size));
+}
+
+static void do_murmur3_128(const void *src, size_t size, void *dst,
+                           size_t dstsize) {
+    qhashmurmur3_128(src, size, dst);
+}
+
+static void do_wyhash_64(const void *src, size_t size, void *dst,
+                         size_t dstsize) {
+    BENCH_SINK(qhashwyhash_64(src, size));
+}
+
+static void do_crc32c(const void *src, size_t size, void *dst,
+                      size_t dstsize) {
+    BENCH_SINK(qhashcrc32c(src, size));
+}
+
+static void do_base64_encode(const void *src, size_t size, void *dst,
+                             size_t dstsize) {
+    qbase64_encode_into(dst, dstsize, src, size);
+}
+
+static void do_hex_encode(const void *src, size_t size, void *dst,
+                          size_t dstsize) {
+    qhex_encode_into(dst, dstsize, src, size);
+}
+
+static void do_url_encode(const void *src, size_t size, void *dst,
+                          size_t dstsize) {
+    free(qurl_encode(src, size));
+}
+
+// the decoders take the encoded text prepared in src.
+static void do_base64_decode(const void *src, size_t size, void *dst,
+                             size_t dstsize) {
+    qbase64_decode_into(dst, dstsize, src, size);
+}
+
+static void do_hex_decode(const void *src, size_t size, void *dst,
+                          size_t dstsize) {
+    qhex_decode_into(dst, dstsize, src, size);
+}
+
+static void do_url_decode(const void *src, size_t size, void *dst,
+                          size_t dstsize) {
+    qurl_decode_into(dst, dstsize, src, size);
+}
+
+static void run(const char *title, bench_fn_t fn, const void *src,
+                size_t srcsize, void *dst, size_t dstsize) {
+    static const size_t sizes[] = { 16, 256, 4096, 1024 * 1024 };
+    size_t s;
+    for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t size = (sizes[s] < srcsize) ? sizes[s] : srcsize;
+        char name[64];
+        snprintf(name, sizeof(name), "%s %zuB", title, size);
+        BENCH(name) {
+            size_t total = BENCH_NUM * BYTES_PER_NUM;
+            size_t times = (total / size > 0) ? total / size : 1;
+            size_t i;
+            BENCH_START();
+            for (i = 0; i < times; i++) {
+                BENCH_OP(fn(src, size, dst, dstsize));
+                BENCH_BYTES(size);
+            }
+            BENCH_STOP();
+        }
+        if (size == srcsize) {
+            break;
+        }
+    }
+}
+
+QBENCH_START("Benchmark qlibc encoders and hashes");
+size_t inputsize = 1024 * 1024;
+unsigned char *input = (unsigned char *) malloc(inputsize);
+size_t outsize = inputsize * 3 + 1;
+char *output = (char *) malloc(outsize);
+size_t i;
+for (i = 0; i < inputsize; i++) {
+    // no NUL bytes, qhashfnv1 stops at the end of a string
+    input[i] = (unsigned char) (rand() % 255 + 1);
+}
+
+run("qhashmd5()", do_md5, input, inputsize, output, outsize);
+run("qhashsha256()", do_sha256, input, inputsize, output, outsize);
+run("qhashfnv1_32()", do_fnv1_32, input, inputsize, output, outsize);
+run("qhashfnv1_64()", do_fnv1_64, input, inputsize, output, outsize);
+run("qhashmurmur3_32()", do_murmur3_32, input, inputsize, output, outsize);
+run("qhashmurmur3_128()", do_murmur3_128, input, inputsize, output, outsize);
+run("qhashwyhash_64()", do_wyhash_64, input, inputsize, output, outsize);
+run("qhashcrc32c()", do_crc32c, input, inputsize, output, outsize);
+
+run("qbase64_encode_into()", do_base64_encode, input, inputsize, output,
+    outsize);
+run("qhex_encode_into()", do_hex_encode, input, inputsize, output, outsize);
+run("qurl_encode()", do_url_encode, input, inputsize, output, outsize);
+
+{
+    // decoders run over the encoded forms of the same input
+    char *text = (char *) malloc(outsize);
+    ssize_t len = qbase64_encode_into(text, outsize, input, inputsize);
+    run("qbase64_decode_into()", do_base64_decode, text, (size_t) len / 4 * 4,
+        output, outsize);
+    len = qhex_encode_into(text, outsize, input, inputsize);
+    run("qhex_decode_into()", do_hex_decode, text, (size_t) len / 2 * 2,
+        output, outsize);
+
+    char *encoded = qurl_encode(input, inputsize / 4);
+    run("qurl_decode_into()", do_url_decode, encoded, strlen(encoded),
+        output, outsize);
+    free(encoded);
+    free(text);
+}
+
+free(input);
+free(output);
+QBENCH_END();
@@ -0,0 +1,353 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/**
+ * qbench C Microbenchmark Framework.
+ *
+ * Every benchmark program is a single file with a QBENCH_START() and
+ * QBENCH_END() pair such as the qunit tests. The operations inside
+ * BENCH_START() and BENCH_STOP() are counted for the throughput, and one
+ * of every QBENCH_SAMPLE_RATE operations is timed alone for the latency
+ * percentiles, which keeps the clock reads off the throughput.
+ *
+ * @code
+ *   QBENCH_START("Benchmark qhashtbl");
+ *
+ *   BENCH("qhashtbl->put()") {
+ *       qhashtbl_t *tbl = qhashtbl(0, 0);
+ *       BENCH_START();
+ *       for (i = 0; i < BENCH_NUM; i++) {
+ *           BENCH_OP(tbl->put(tbl, keys[i], &i, sizeof(i)));
+ *       }
+ *       BENCH_STOP();
+ *       tbl->free(tbl);
+ *   }
+ *
+ *   QBENCH_END();
+ * @endcode
+ *
+ * Options of the benchmark programs:
+ *   -n num      base number of operations. (default QBENCH_DEFAULT_NUM)
+ *   -t threads  number of threads of the concurrent runs. (default 4)
+ *   -f filter   run only the benchmarks whose name contains the filter.
+ *
+ * @file qbench.h
+ */
+
+#ifndef QBENCH_H
+#define QBENCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef QBENCH_DEFAULT_NUM
+#define QBENCH_DEFAULT_NUM  (1000000)
+#endif
+#define QBENCH_DEFAULT_THREADS  (4)
+#define QBENCH_SAMPLE_RATE  (16)        /* one of these is timed alone */
+#define QBENCH_MAX_SAMPLES  (1 << 20)   /* latency samples kept per run */
+#define QBENCH_SEED         (20150101)  /* seed of the generated inputs */
+
+typedef struct qbench_s qbench_t;
+struct qbench_s {
+    uint64_t ops;
+    uint64_t bytes;
+    uint64_t *samples;  /* latency samples in nanoseconds */
+    size_t nsamples;
+    size_t maxsamples;
+    uint64_t started;
+    uint64_t elapsed;
+};
+
+typedef void (*qbench_func_t) (int id, void *arg);
+
+#define QBENCH_START(title)                                                 \
+size_t _qb_num = QBENCH_DEFAULT_NUM;                                        \
+int _qb_threads = QBENCH_DEFAULT_THREADS;                                   \
+const char *_qb_filter = NULL;                                              \
+char _qb_name[64] = "";                                                     \
+qbench_t _qb;                                                               \
+__thread qbench_t *_qb_current = NULL;                                      \
+int main(int argc, char *argv[]) {                                          \
+    int _qb_opt;                                                            \
+    while ((_qb_opt = getopt(argc, argv, "n:t:f:")) != -1) {                \
+        if (_qb_opt == 'n') {                                               \
+            _qb_num = strtoul(optarg, NULL, 10);                            \
+        } else if (_qb_opt == 't') {                                        \
+            _qb_threads = atoi(optarg);                                     \
+        } else if (_qb_opt == 'f') {                                        \
+            _qb_filter = optarg;                                            \
+        } else {                                                            \
+            fprintf(stderr, "Usage: %s [-n num] [-t threads] [-f filter]\n", \
+                    argv[0]);                                               \
+            return 1;                                                       \
+        }                                                                   \
+    }                                                                       \
+    if (_qb_num < 1) _qb_num = 1;                                           \
+    if (_qb_threads < 1) _qb_threads = 1;                                   \
+    memset((void *) &_qb, 0, sizeof(_qb));                                  \
+    srand(QBENCH_SEED);                                                     \
+    printf("%s (num %zu, threads %d)\n", title, _qb_num, _qb_threads);     \
+    printf("======================================================================\n");
+
+#define QBENCH_END()                                                        \
+    free(_qb.samples);                                                      \
+    printf("======================================================================\n"); \
+    return 0;                                                               \
+}
+
+#define BENCH(name)                                                         \
+    if (_qbench_select(name))
+
+#define BENCH_NUM       (_qb_num)
+#define BENCH_THREADS   (_qb_threads)
+
+#define BENCH_START() do {                                                  \
+        _qbench_reset(&_qb);                                                \
+        _qb_current = &_qb;                                                 \
+        _qb.started = _qbench_now();                                        \
+    } while(0)
+
+#define BENCH_STOP() do {                                                   \
+        _qb.elapsed = _qbench_now() - _qb.started;                          \
+        _qb_current = NULL;                                                 \
+        _qbench_report(&_qb, 1);                                            \
+    } while(0)
+
+#define BENCH_OP(stmt) do {                                                 \
+        qbench_t *_qb_b = _qb_current;                                      \
+        if ((_qb_b->ops++ % QBENCH_SAMPLE_RATE) == 0) {                     \
+            uint64_t _qb_t = _qbench_now();                                 \
+            stmt;                                                           \
+            _qbench_sample(_qb_b, _qbench_now() - _qb_t);                   \
+        } else {                                                            \
+            stmt;                                                           \
+        }                                                                   \
+    } while(0)
+
+/* counts operations done as a whole, such as sorting n elements */
+#define BENCH_OPS(n) do {                                                   \
+        _qb_current->ops += (n);                                            \
+    } while(0)
+
+#define BENCH_BYTES(n) do {                                                 \
+        _qb_current->bytes += (n);                                          \
+    } while(0)
+
+/* runs func(id, arg) on BENCH_THREADS threads started at once */
+#define BENCH_RUN_THREADS(func, arg) do {                                   \
+        _qbench_threads(&_qb, _qb_threads, func, arg);                      \
+        _qbench_report(&_qb, _qb_threads);                                  \
+    } while(0)
+
+/* keeps the compiler from dropping a result nobody reads */
+#define BENCH_SINK(x) __asm__ __volatile__("" : : "g"(x) : "memory")
+
+extern size_t _qb_num;
+extern int _qb_threads;
+extern const char *_qb_filter;
+extern char _qb_name[64];
+extern qbench_t _qb;
+extern __thread qbench_t *_qb_current;
+
+static inline uint64_t _qbench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline bool _qbench_select(const char *name) {
+    if (_qb_filter != NULL && strstr(name, _qb_filter) == NULL) {
+        return false;
+    }
+    snprintf(_qb_name, sizeof(_qb_name), "%s", name);
+    return true;
+}
+
+static inline void _qbench_reset(qbench_t *bench) {
+    bench->ops = 0;
+    bench->bytes = 0;
+    bench->nsamples = 0;
+    bench->elapsed = 0;
+}
+
+static inline void _qbench_sample(qbench_t *bench, uint64_t ns) {
+    if (bench->nsamples == bench->maxsamples) {
+        if (bench->maxsamples >= QBENCH_MAX_SAMPLES) {
+            return;
+        }
+        size_t newmax = (bench->maxsamples > 0) ? bench->maxsamples * 2 : 4096;
+        uint64_t *samples = (uint64_t *) realloc(bench->samples,
+                                                 sizeof(uint64_t) * newmax);
+        if (samples == NULL) {
+            return;
+        }
+        bench->samples = samples;
+        bench->maxsamples = newmax;
+    }
+    bench->samples[bench->nsamples++] = ns;
+}
+
+static inline int _qbench_cmp(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+static inline char *_qbench_fmttime(char *buf, size_t size, uint64_t ns) {
+    if (ns < 1000) {
+        snprintf(buf, size, "%" PRIu64 "ns", ns);
+    } else if (ns < 1000000) {
+        snprintf(buf, size, "%.1fus", ns / 1e3);
+    } else if (ns < 1000000000) {
+        snprintf(buf, size, "%.1fms", ns / 1e6);
+    } else {
+        snprintf(buf, size, "%.2fs", ns / 1e9);
+    }
+    return buf;
+}
+
+static inline char *_qbench_fmtrate(char *buf, size_t size, double rate) {
+    if (rate < 1e4) {
+        snprintf(buf, size, "%.1f", rate);
+    } else if (rate < 1e7) {
+        snprintf(buf, size, "%.1fK", rate / 1e3);
+    } else {
+        snprintf(buf, size, "%.2fM", rate / 1e6);
+    }
+    return buf;
+}
+
+static inline void _qbench_report(qbench_t *bench, int nthreads) {
+    double secs = (bench->elapsed > 0) ? bench->elapsed / 1e9 : 1e-9;
+    char name[80], rate[16];
+    if (nthreads > 1) {
+        snprintf(name, sizeof(name), "%s x%d", _qb_name, nthreads);
+    } else {
+        snprintf(name, sizeof(name), "%s", _qb_name);
+    }
+    printf("%-44s %8s ops/s", name,
+           _qbench_fmtrate(rate, sizeof(rate), bench->ops / secs));
+
+    if (bench->nsamples > 0) {
+        qsort(bench->samples, bench->nsamples, sizeof(uint64_t), _qbench_cmp);
+        size_t n = bench->nsamples - 1;
+        char p50[16], p99[16], p999[16];
+        printf("  p50 %7s  p99 %7s  p99.9 %7s",
+               _qbench_fmttime(p50, sizeof(p50), bench->samples[n / 2]),
+               _qbench_fmttime(p99, sizeof(p99), bench->samples[n * 99 / 100]),
+               _qbench_fmttime(p999, sizeof(p999),
+                               bench->samples[n * 999 / 1000]));
+    }
+    if (bench->bytes > 0) {
+        printf("  %9.1f MB/s", bench->bytes / secs / (1024 * 1024));
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+typedef struct {
+    int id;
+    qbench_func_t func;
+    void *arg;
+    qbench_t bench;
+    int *ready;
+    int *go;
+} _qbench_thread_t;
+
+static inline void *_qbench_thread_main(void *arg) {
+    _qbench_thread_t *thread = (_qbench_thread_t *) arg;
+    _qb_current = &thread->bench;
+
+    __atomic_add_fetch(thread->ready, 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(thread->go, __ATOMIC_ACQUIRE) == 0) {
+        ;
+    }
+    thread->func(thread->id, thread->arg);
+
+    _qb_current = NULL;
+    return NULL;
+}
+
+static inline void _qbench_threads(qbench_t *total, int nthreads,
+                                   qbench_func_t func, void *arg) {
+    _qbench_thread_t *threads = (_qbench_thread_t *) calloc(
+            nthreads, sizeof(_qbench_thread_t));
+    pthread_t *tids = (pthread_t *) calloc(nthreads, sizeof(pthread_t));
+    int ready = 0, go = 0;
+    int i;
+
+    _qbench_reset(total);
+    for (i = 0; i < nthreads; i++) {
+        threads[i].id = i;
+        threads[i].func = func;
+        threads[i].arg = arg;
+        threads[i].ready = &ready;
+        threads[i].go = &go;
+        pthread_create(&tids[i], NULL, _qbench_thread_main, &threads[i]);
+    }
+    while (__atomic_load_n(&ready, __ATOMIC_SEQ_CST) < nthreads) {
+        ;
+    }
+    total->started = _qbench_now();
+    __atomic_store_n(&go, 1, __ATOMIC_RELEASE);
+
+    for (i = 0; i < nthreads; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    total->elapsed = _qbench_now() - total->started;
+
+    for (i = 0; i < nthreads; i++) {
+        qbench_t *bench = &threads[i].bench;
+        size_t j;
+        total->ops += bench->ops;
+        total->bytes += bench->bytes;
+        for (j = 0; j < bench->nsamples; j++) {
+            _qbench_sample(total, bench->samples[j]);
+        }
+        free(bench->samples);
+    }
+    free(threads);
+    free(tids);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* QBENCH_H */
@@ -0,0 +1,95 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/**
+ * Arena allocator.
+ *
+ * @file qarena.h
+ */
+
+#ifndef QARENA_H
+#define QARENA_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* types */
+typedef struct qarena_s qarena_t;
+
+enum {
+    QARENA_THREADSAFE = (0x01)  /*!< make it thread-safe */
+};
+
+/* member functions
+ *
+ * All the member functions can be accessed in both ways:
+ *  - arena->alloc(arena, ...);    // easier to switch the container type to other kinds.
+ *  - qarena_alloc(arena, ...);    // where avoiding pointer overhead is preferred.
+ */
+extern qarena_t *qarena(size_t chunksize, int options);  /*!< qarena constructor */
+
+extern void *qarena_alloc(qarena_t *arena, size_t size);
+extern void *qarena_calloc(qarena_t *arena, size_t size);
+extern void *qarena_memdup(qarena_t *arena, const void *data, size_t size);
+extern char *qarena_strdup(qarena_t *arena, const char *str);
+
+extern size_t qarena_size(qarena_t *arena);
+extern void qarena_reset(qarena_t *arena);
+extern void qarena_free(qarena_t *arena);
+
+/**
+ * qarena container object structure
+ */
+struct qarena_s {
+    /* encapsulated member functions */
+    void *(*alloc) (qarena_t *arena, size_t size);
+    void *(*calloc) (qarena_t *arena, size_t size);
+    void *(*memdup) (qarena_t *arena, const void *data, size_t size);
+    char *(*strdup) (qarena_t *arena, const char *str);
+
+    size_t (*size) (qarena_t *arena);
+    void (*reset) (qarena_t *arena);
+    void (*free) (qarena_t *arena);
+
+    /* private variables - do not access directly */
+    void *qmutex;       /*!< initialized when QARENA_THREADSAFE is given */
+    size_t chunksize;   /*!< size of a regular chunk */
+    size_t used;        /*!< number of bytes handed out */
+    void *chunks;       /*!< chunk list, the current chunk comes first */
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* QARENA_H */
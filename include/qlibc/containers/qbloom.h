@@ -0,0 +1,99 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/**
+ * Blocked Bloom filter container that works in preallocated fixed size memory.
+ *
+ * @file qbloom.h
+ */
+
+#ifndef QBLOOM_H
+#define QBLOOM_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* memory layout version */
+#define Q_BLOOM_VERSION (1)
+
+/* types */
+typedef struct qbloom_s qbloom_t;
+typedef struct qbloom_data_s qbloom_data_t;
+
+/* member functions
+ *
+ * All the member functions can be accessed in both ways:
+ *  - bloom->add(bloom, ...);      // easier to switch the container type to other kinds.
+ *  - qbloom_add(bloom, ...);      // where avoiding pointer overhead is preferred.
+ */
+extern size_t qbloom_calculate_memsize(size_t nitems, double fpp);
+extern qbloom_t *qbloom(void *memory, size_t memsize, size_t nitems);
+
+extern bool qbloom_add(qbloom_t *bloom, const void *data, size_t size);
+extern bool qbloom_check(qbloom_t *bloom, const void *data, size_t size);
+
+extern size_t qbloom_size(qbloom_t *bloom);
+extern void qbloom_clear(qbloom_t *bloom);
+extern void qbloom_free(qbloom_t *bloom);
+
+/**
+ * qbloom container object
+ */
+struct qbloom_s {
+    /* encapsulated member functions */
+    bool (*add) (qbloom_t *bloom, const void *data, size_t size);
+    bool (*check) (qbloom_t *bloom, const void *data, size_t size);
+
+    size_t (*size) (qbloom_t *bloom);
+    void (*clear) (qbloom_t *bloom);
+    void (*free) (qbloom_t *bloom);
+
+    /* private variables */
+    qbloom_data_t *data;
+};
+
+/**
+ * qbloom memory structure, followed by the blocks from the next cache line
+ */
+struct qbloom_data_s {
+    int version;        /*!< layout version, Q_BLOOM_VERSION */
+    int nhashes;        /*!< bits set in a block for each element */
+    uint32_t nblocks;   /*!< number of 512-bit blocks */
+    uint64_t num;       /*!< number of added elements which set a new bit */
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* QBLOOM_H */
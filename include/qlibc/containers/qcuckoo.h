@@ -0,0 +1,110 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/**
+ * Cuckoo filter container that works in preallocated fixed size memory.
+ *
+ * @file qcuckoo.h
+ */
+
+#ifndef QCUCKOO_H
+#define QCUCKOO_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* memory layout version */
+#define Q_CUCKOO_VERSION (1)
+
+/* filter options */
+enum {
+    QCUCKOO_THREADSAFE = (0x01)     /*!< make it process-safe */
+};
+
+/* types */
+typedef struct qcuckoo_s qcuckoo_t;
+typedef struct qcuckoo_data_s qcuckoo_data_t;
+
+/* member functions
+ *
+ * All the member functions can be accessed in both ways:
+ *  - cuckoo->add(cuckoo, ...);      // easier to switch the container type to other kinds.
+ *  - qcuckoo_add(cuckoo, ...);      // where avoiding pointer overhead is preferred.
+ */
+extern size_t qcuckoo_calculate_memsize(size_t nitems);
+extern qcuckoo_t *qcuckoo(void *memory, size_t memsize, int options);
+
+extern bool qcuckoo_add(qcuckoo_t *cuckoo, const void *data, size_t size);
+extern bool qcuckoo_check(qcuckoo_t *cuckoo, const void *data, size_t size);
+extern bool qcuckoo_remove(qcuckoo_t *cuckoo, const void *data, size_t size);
+
+extern size_t qcuckoo_size(qcuckoo_t *cuckoo);
+extern void qcuckoo_clear(qcuckoo_t *cuckoo);
+extern void qcuckoo_free(qcuckoo_t *cuckoo);
+
+/**
+ * qcuckoo container object
+ */
+struct qcuckoo_s {
+    /* encapsulated member functions */
+    bool (*add) (qcuckoo_t *cuckoo, const void *data, size_t size);
+    bool (*check) (qcuckoo_t *cuckoo, const void *data, size_t size);
+    bool (*remove) (qcuckoo_t *cuckoo, const void *data, size_t size);
+
+    size_t (*size) (qcuckoo_t *cuckoo);
+    void (*clear) (qcuckoo_t *cuckoo);
+    void (*free) (qcuckoo_t *cuckoo);
+
+    /* private variables */
+    qcuckoo_data_t *data;
+    uint32_t seed;      /*!< random state to pick the entry to kick out */
+};
+
+/**
+ * qcuckoo memory structure, followed by the buckets from the next cache line
+ */
+struct qcuckoo_data_s {
+    int version;        /*!< layout version, Q_CUCKOO_VERSION */
+    int options;        /*!< filter options given at creation */
+    uint32_t nbuckets;  /*!< number of 4-entry buckets, a power of 2 */
+    uint32_t num;       /*!< number of stored fingerprints */
+    uint32_t lock;      /*!< process-shared read-write spin lock word */
+    uint32_t victimidx; /*!< bucket of the fingerprint left over when full */
+    uint16_t victimfp;  /*!< fingerprint left over when full, 0 if none */
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* QCUCKOO_H */
@@ -0,0 +1,87 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/**
+ * Work-stealing deque container.
+ *
+ * @file qdeque.h
+ */
+
+#ifndef QDEQUE_H
+#define QDEQUE_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* types */
+typedef struct qdeque_s qdeque_t;
+
+/* member functions
+ *
+ * All the member functions can be accessed in both ways:
+ *  - dq->push(dq, ...);    // easier to switch the container type to other kinds.
+ *  - qdeque_push(dq, ...); // where avoiding pointer overhead is preferred.
+ */
+extern qdeque_t *qdeque(size_t max);  /*!< qdeque constructor */
+
+extern bool qdeque_push(qdeque_t *dq, void *item);
+extern void *qdeque_pop(qdeque_t *dq);
+extern void *qdeque_steal(qdeque_t *dq);
+
+extern size_t qdeque_size(qdeque_t *dq);
+extern void qdeque_free(qdeque_t *dq);
+
+/**
+ * qdeque container object structure
+ */
+struct qdeque_s {
+    /* encapsulated member functions */
+    bool (*push) (qdeque_t *dq, void *item);
+    void *(*pop) (qdeque_t *dq);
+    void *(*steal) (qdeque_t *dq);
+
+    size_t (*size) (qdeque_t *dq);
+    void (*free) (qdeque_t *dq);
+
+    /* private variables - do not access directly */
+    int64_t top __attribute__((aligned(64)));     /*!< steal end, thieves */
+    int64_t bottom __attribute__((aligned(64)));  /*!< owner end */
+    void *array __attribute__((aligned(64)));     /*!< current circular array */
+    void *retired;  /*!< outgrown arrays, freed with the deque */
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* QDEQUE_H */
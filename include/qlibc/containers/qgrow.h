@@ -38,6 +38,7 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <sys/uio.h>
 #include "qlist.h"
 
 #ifdef __cplusplus
@@ -49,7 +50,8 @@ typedef struct qgrow_s qgrow_t;
 
 /* public functions */
 enum {
-    QGROW_THREADSAFE = (QLIST_THREADSAFE)  /*!< make it thread-safe */
+    QGROW_THREADSAFE = (QLIST_THREADSAFE),  /*!< make it thread-safe */
+    QGROW_CONTIGUOUS = (0x01 << 4)          /*!< single buffer, no list */
 };
 
 extern qgrow_t *qgrow(int options);
@@ -63,6 +65,8 @@ extern size_t qgrow_datasize(qgrow_t *grow);
 
 extern void *qgrow_toarray(qgrow_t *grow, size_t *size);
 extern char *qgrow_tostring(qgrow_t *grow);
+extern const void *qgrow_buffer(qgrow_t *grow, size_t *size);
+extern int qgrow_toiovec(qgrow_t *grow, struct iovec *iov, int iovcnt);
 
 extern void qgrow_clear(qgrow_t *grow);
 extern bool qgrow_debug(qgrow_t *grow, FILE *out);
@@ -82,6 +86,8 @@ struct qgrow_s {
 
     void *(*toarray) (qgrow_t *grow, size_t *size);
     char *(*tostring) (qgrow_t *grow);
+    const void *(*buffer) (qgrow_t *grow, size_t *size);
+    int (*toiovec) (qgrow_t *grow, struct iovec *iov, int iovcnt);
 
     void (*clear) (qgrow_t *grow);
     bool (*debug) (qgrow_t *grow, FILE *out);
@@ -89,7 +95,13 @@ struct qgrow_s {
     void (*free) (qgrow_t *grow);
 
     /* private variables - do not access directly */
-    qlist_t *list;  /*!< data container */
+    qlist_t *list;  /*!< data container, NULL with QGROW_CONTIGUOUS */
+
+    void *qmutex;     /*!< initialized when QGROW_THREADSAFE is given */
+    char *buf;        /*!< contiguous buffer */
+    size_t bufsize;   /*!< allocated size of the buffer */
+    size_t buflen;    /*!< size of the data in the buffer */
+    size_t num;       /*!< number of elements added to the buffer */
 };
 
 #ifdef __cplusplus
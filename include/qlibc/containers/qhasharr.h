@@ -38,14 +38,26 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
+#include "qstats.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-/* tunable knobs */
-#define Q_HASHARR_NAMESIZE (16)  /*!< knob for maximum key size. */
-#define Q_HASHARR_DATASIZE (32)  /*!< knob for maximum data size in a slot. */
+/* memory layout version. 0 verifies truncated keys with MD5 and 1 with
+   MurmurHash3 128-bit */
+#define Q_HASHARR_VERSION (1)
+
+/* tunable knobs, qhasharr_ex() takes them at runtime */
+#define Q_HASHARR_NAMESIZE (16)  /*!< default maximum key size in a slot. */
+#define Q_HASHARR_DATASIZE (32)  /*!< default maximum data size in a slot. */
+
+/* table options */
+enum {
+    QHASHARR_THREADSAFE = (0x01),   /*!< make it process-safe */
+    QHASHARR_CACHE = (0x02)         /*!< evict old entries when it's full */
+};
 
 /* types */
 typedef struct qhasharr_s qhasharr_t;
@@ -60,7 +72,11 @@ typedef struct qhasharr_obj_s qhasharr_obj_t;
  *  - qhasharr_put(tbl, ...);  // where avoiding pointer overhead is preferred.
  */
 extern qhasharr_t *qhasharr(void *memory, size_t memsize);
+extern qhasharr_t *qhasharr_ex(void *memory, size_t memsize, int namesize,
+                               int datasize, int options);
 extern size_t qhasharr_calculate_memsize(int max);
+extern size_t qhasharr_calculate_memsize_ex(int max, int namesize, int datasize);
+extern qhasharr_t *qhasharr_map(const char *filepath);
 
 extern bool qhasharr_put(qhasharr_t *tbl, const char *key, const void *value,
                 size_t size);
@@ -68,6 +84,8 @@ extern bool qhasharr_putstr(qhasharr_t *tbl, const char *key, const char *str);
 extern bool qhasharr_putstrf(qhasharr_t *tbl, const char *key, const char *format, ...);
 extern bool qhasharr_put_by_obj(qhasharr_t *tbl, const void *name, size_t namesize,
                                 const void *data, size_t datasize);
+extern bool qhasharr_put_ttl(qhasharr_t *tbl, const char *key, const void *value,
+                             size_t size, int ttl);
 
 extern void *qhasharr_get(qhasharr_t *tbl, const char *key, size_t *size);
 extern char *qhasharr_getstr(qhasharr_t *tbl, const char *key);
@@ -82,7 +100,13 @@ extern bool qhasharr_getnext(qhasharr_t *tbl, qhasharr_obj_t *obj, int *idx);
 
 extern int qhasharr_size(qhasharr_t *tbl, int *maxslots, int *usedslots);
 extern void qhasharr_clear(qhasharr_t *tbl);
+extern bool qhasharr_grow(qhasharr_t *tbl, void *memory, size_t memsize);
+extern bool qhasharr_save(qhasharr_t *tbl, const char *filepath);
 extern bool qhasharr_debug(qhasharr_t *tbl, FILE *out);
+extern bool qhasharr_stats(qhasharr_t *tbl, qstats_t *stats);
+
+extern void qhasharr_set_hash(qhasharr_t *tbl,
+                              uint32_t (*hashfunc)(const void *data, size_t nbytes));
 
 extern void qhasharr_free(qhasharr_t *tbl);
 
@@ -98,6 +122,8 @@ struct qhasharr_s {
     bool (*putstrf) (qhasharr_t *tbl, const char *key, const char *format, ...);
     bool (*put_by_obj) (qhasharr_t *tbl, const void *name, size_t namesize,
                         const void *data, size_t datasize);
+    bool (*put_ttl) (qhasharr_t *tbl, const char *key, const void *value,
+                     size_t size, int ttl);
 
     void *(*get) (qhasharr_t *tbl, const char *key, size_t *size);
     char *(*getstr) (qhasharr_t *tbl, const char *key);
@@ -112,12 +138,27 @@ struct qhasharr_s {
 
     int  (*size) (qhasharr_t *tbl, int *maxslots, int *usedslots);
     void (*clear) (qhasharr_t *tbl);
+    bool (*grow) (qhasharr_t *tbl, void *memory, size_t memsize);
+    bool (*save) (qhasharr_t *tbl, const char *filepath);
     bool (*debug) (qhasharr_t *tbl, FILE *out);
+    bool (*stats) (qhasharr_t *tbl, qstats_t *stats);
 
     void (*free) (qhasharr_t *tbl);
 
+    void (*set_hash) (qhasharr_t *tbl,
+                      uint32_t (*hashfunc)(const void *data, size_t nbytes));
+
     /* private variables */
     qhasharr_data_t *data;
+    uint32_t (*hashfunc)(const void *data, size_t nbytes);
+    size_t mapsize;     /*!< size of the read-only file mapping, 0 if not */
+
+    uint64_t collisions;  /*!< inserts into an occupied home slot */
+    uint64_t resizes;   /*!< number of grows */
+    uint64_t evictions; /*!< entries evicted in QHASHARR_CACHE mode */
+    uint64_t locks;     /*!< lock acquisitions */
+    uint64_t contended; /*!< acquisitions which had to wait */
+    uint64_t waitns;    /*!< total wait time in nanoseconds */
 };
 
 /**
@@ -127,24 +168,20 @@ struct qhasharr_slot_s {
     short  count;      /*!< hash collision counter. 0 indicates empty slot,
                             -1 is used for collision resolution, -2 is used for
                             indicating linked block */
+    uint8_t clock;     /*!< reference bit for the cache eviction */
     uint32_t  hash;    /*!< key hash */
-    uint8_t datasize;  /*!< value size in this slot*/
+    uint16_t datasize; /*!< value size in this slot*/
     int link;          /*!< next link */
 
-    union {
-        /*!< key/value data */
-        struct Q_HASHARR_SLOT_KEYVAL {
-            uint8_t data[Q_HASHARR_DATASIZE];  /*!< value */
-            uint8_t name[Q_HASHARR_NAMESIZE];  /*!< key string, can be cut */
-            uint16_t namesize;                 /*!< original key length */
-            uint8_t namemd5[16];               /*!< md5 hash of the key */
-        } pair;
-
-        /*!< extended data block, used only when the count value is -2 */
-        struct Q_HASHARR_SLOT_EXT {
-            uint8_t data[sizeof(struct Q_HASHARR_SLOT_KEYVAL)];
-        } ext;
-    } data;
+    /*!< key/value data. An extended data block, used only when the count
+         value is -2, stores value over the whole area from keyhash */
+    uint32_t keyhash;  /*!< full hash of the key for rehashing */
+    uint32_t expire;   /*!< expiry time in seconds since the Epoch, 0 for
+                            no expiry */
+    uint16_t namesize; /*!< original key length */
+    uint8_t namefp[16];   /*!< fingerprint of a truncated key */
+    uint8_t data[];    /*!< value then key string which can be cut, sized by
+                            the geometry in qhasharr_data_t */
 };
 
 /**
@@ -154,6 +191,13 @@ struct qhasharr_data_s {
     int maxslots;       /*!< number of maximum slots */
     int usedslots;      /*!< number of used slots */
     int num;            /*!< number of stored keys */
+    int namesize;       /*!< key bytes stored in a slot */
+    int datasize;       /*!< value bytes stored in the leading slot */
+    int slotsize;       /*!< size of a slot in bytes */
+    int version;        /*!< layout version, Q_HASHARR_VERSION */
+    int options;        /*!< table options given at creation */
+    uint32_t lock;      /*!< process-shared read-write spin lock word */
+    int clockhand;      /*!< next slot to look at for the cache eviction */
 };
 
 /**
@@ -39,6 +39,10 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <sys/types.h>
+#include "qarena.h"
+#include "qstrpool.h"
+#include "qstats.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -47,9 +51,14 @@ extern "C" {
 /* types */
 typedef struct qhashtbl_s qhashtbl_t;
 typedef struct qhashtbl_obj_s qhashtbl_obj_t;
+struct qthreadpool_s;   /* qthreadpool_t of utilities/qthreadpool.h */
 
 enum {
-    QHASHTBL_THREADSAFE = (0x01)  /*!< make it thread-safe */
+    QHASHTBL_THREADSAFE = (0x01), /*!< make it thread-safe */
+    QHASHTBL_AUTORESIZE = (0x02), /*!< grow hash range as the table fills up */
+    QHASHTBL_OPENADDR = (0x04),   /*!< use open addressing instead of chaining */
+    QHASHTBL_STRIPED = (0x08),    /*!< thread-safe with a lock per slot stripe */
+    QHASHTBL_LOCKFREE_READ = (0x10)  /*!< thread-safe with lock-free lookups */
 };
 
 /* member functions
@@ -71,15 +80,45 @@ extern int64_t qhashtbl_getint(qhashtbl_t *tbl, const char *name);
 
 extern bool qhashtbl_remove(qhashtbl_t *tbl, const char *name);
 
+extern bool qhashtbl_put_by_obj(qhashtbl_t *tbl, const void *name, size_t namesize,
+                                uint32_t hash, const void *data, size_t size);
+extern void *qhashtbl_get_by_obj(qhashtbl_t *tbl, const void *name, size_t namesize,
+                                 uint32_t hash, size_t *size, bool newmem);
+extern bool qhashtbl_remove_by_obj(qhashtbl_t *tbl, const void *name, size_t namesize,
+                                   uint32_t hash);
+
+extern size_t qhashtbl_getmulti(qhashtbl_t *tbl, const char *names[], size_t num,
+                                void *datas[], size_t sizes[], bool newmem);
+extern size_t qhashtbl_putmulti(qhashtbl_t *tbl, const char *names[],
+                                const void *datas[], const size_t sizes[], size_t num);
+
 extern bool qhashtbl_getnext(qhashtbl_t *tbl, qhashtbl_obj_t *obj, bool newmem);
+extern bool qhashtbl_parallel_foreach(qhashtbl_t *tbl,
+                                      struct qthreadpool_s *pool,
+                                      void (*func)(const qhashtbl_obj_t *obj,
+                                                   void *userdata),
+                                      void *userdata);
 
 extern size_t qhashtbl_size(qhashtbl_t *tbl);
 extern void qhashtbl_clear(qhashtbl_t *tbl);
 extern bool qhashtbl_debug(qhashtbl_t *tbl, FILE *out);
+extern bool qhashtbl_stats(qhashtbl_t *tbl, qstats_t *stats);
+
+extern bool qhashtbl_dump(qhashtbl_t *tbl, const char *filepath, bool checksum);
+extern ssize_t qhashtbl_restore(qhashtbl_t *tbl, const char *filepath);
+
+extern bool qhashtbl_set_loadfactor(qhashtbl_t *tbl, double loadfactor);
+extern bool qhashtbl_set_hash(qhashtbl_t *tbl,
+                              uint32_t (*hashfunc)(const void *data, size_t nbytes));
+extern bool qhashtbl_set_arena(qhashtbl_t *tbl, qarena_t *arena);
+extern bool qhashtbl_set_strpool(qhashtbl_t *tbl, qstrpool_t *pool);
 
 extern void qhashtbl_lock(qhashtbl_t *tbl);
 extern void qhashtbl_unlock(qhashtbl_t *tbl);
 
+extern void qhashtbl_read_enter(qhashtbl_t *tbl);
+extern void qhashtbl_read_leave(qhashtbl_t *tbl);
+
 extern void qhashtbl_free(qhashtbl_t *tbl);
 
 /**
@@ -98,22 +137,64 @@ struct qhashtbl_s {
 
     bool (*remove) (qhashtbl_t *tbl, const char *name);
 
+    bool (*put_by_obj) (qhashtbl_t *tbl, const void *name, size_t namesize,
+                        uint32_t hash, const void *data, size_t size);
+    void *(*get_by_obj) (qhashtbl_t *tbl, const void *name, size_t namesize,
+                         uint32_t hash, size_t *size, bool newmem);
+    bool (*remove_by_obj) (qhashtbl_t *tbl, const void *name, size_t namesize,
+                           uint32_t hash);
+
+    size_t (*getmulti) (qhashtbl_t *tbl, const char *names[], size_t num,
+                        void *datas[], size_t sizes[], bool newmem);
+    size_t (*putmulti) (qhashtbl_t *tbl, const char *names[],
+                        const void *datas[], const size_t sizes[], size_t num);
+
     bool (*getnext) (qhashtbl_t *tbl, qhashtbl_obj_t *obj, bool newmem);
 
     size_t (*size) (qhashtbl_t *tbl);
     void (*clear) (qhashtbl_t *tbl);
     bool (*debug) (qhashtbl_t *tbl, FILE *out);
+    bool (*stats) (qhashtbl_t *tbl, qstats_t *stats);
+
+    bool (*dump) (qhashtbl_t *tbl, const char *filepath, bool checksum);
+    ssize_t (*restore) (qhashtbl_t *tbl, const char *filepath);
 
     void (*lock) (qhashtbl_t *tbl);
     void (*unlock) (qhashtbl_t *tbl);
 
     void (*free) (qhashtbl_t *tbl);
 
+    bool (*set_loadfactor) (qhashtbl_t *tbl, double loadfactor);
+    bool (*set_hash) (qhashtbl_t *tbl,
+                      uint32_t (*hashfunc)(const void *data, size_t nbytes));
+    bool (*set_arena) (qhashtbl_t *tbl, qarena_t *arena);
+    bool (*set_strpool) (qhashtbl_t *tbl, qstrpool_t *pool);
+
+    void (*read_enter) (qhashtbl_t *tbl);
+    void (*read_leave) (qhashtbl_t *tbl);
+
     /* private variables - do not access directly */
     void *qmutex;       /*!< initialized when QHASHTBL_THREADSAFE is given */
     size_t num;         /*!< number of objects in this table */
     size_t range;       /*!< hash range, vertical number of slots */
     qhashtbl_obj_t **slots;   /*!< slot pointer container */
+
+    int options;        /*!< initialization options */
+    double loadfactor;  /*!< load factor threshold for QHASHTBL_AUTORESIZE */
+    size_t oldrange;    /*!< hash range of the slots being migrated */
+    size_t rehashidx;   /*!< next index of the old slots to be migrated */
+    qhashtbl_obj_t **oldslots;  /*!< slots being migrated, NULL if not resizing */
+    qhashtbl_obj_t *openslots;  /*!< slot array for QHASHTBL_OPENADDR */
+    void *stripes;      /*!< stripe locks for QHASHTBL_STRIPED */
+    void *epoch;        /*!< reader epochs for QHASHTBL_LOCKFREE_READ */
+    uint32_t (*hashfunc)(const void *data, size_t nbytes);  /*!< key hash function */
+    qarena_t *arena;    /*!< arena allocator of the objects, NULL for the heap */
+    qstrpool_t *strpool;  /*!< pool of the interned names, NULL to copy them */
+
+    uint64_t collisions;  /*!< inserts into an occupied home slot */
+    uint64_t resizes;   /*!< number of times the slots were grown */
+    uint64_t allocs;    /*!< object allocations */
+    uint64_t frees;     /*!< object releases */
 };
 
 /**
@@ -122,6 +203,7 @@ struct qhashtbl_s {
 struct qhashtbl_obj_s {
     uint32_t hash;      /*!< 32bit-hash value of object name */
     char *name;         /*!< object name */
+    size_t namesize;    /*!< object name size, not counting the NUL terminator */
     void *data;         /*!< data */
     size_t size;        /*!< data size */
 
@@ -0,0 +1,103 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/**
+ * HyperLogLog cardinality estimator that works in preallocated fixed size
+ * memory.
+ *
+ * @file qhll.h
+ */
+
+#ifndef QHLL_H
+#define QHLL_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* memory layout version */
+#define Q_HLL_VERSION (1)
+
+/* precision limits, 2^precision registers of a byte each */
+#define Q_HLL_MIN_PRECISION (4)
+#define Q_HLL_MAX_PRECISION (18)
+
+/* types */
+typedef struct qhll_s qhll_t;
+typedef struct qhll_data_s qhll_data_t;
+
+/* member functions
+ *
+ * All the member functions can be accessed in both ways:
+ *  - hll->add(hll, ...);      // easier to switch the container type to other kinds.
+ *  - qhll_add(hll, ...);      // where avoiding pointer overhead is preferred.
+ */
+extern size_t qhll_calculate_memsize(int precision);
+extern qhll_t *qhll(void *memory, size_t memsize, int precision);
+
+extern bool qhll_add(qhll_t *hll, const void *data, size_t size);
+extern uint64_t qhll_count(qhll_t *hll);
+extern bool qhll_merge(qhll_t *hll, qhll_t *other);
+
+extern void qhll_clear(qhll_t *hll);
+extern void qhll_free(qhll_t *hll);
+
+/**
+ * qhll container object
+ */
+struct qhll_s {
+    /* encapsulated member functions */
+    bool (*add) (qhll_t *hll, const void *data, size_t size);
+    uint64_t (*count) (qhll_t *hll);
+    bool (*merge) (qhll_t *hll, qhll_t *other);
+
+    void (*clear) (qhll_t *hll);
+    void (*free) (qhll_t *hll);
+
+    /* private variables */
+    qhll_data_t *data;
+};
+
+/**
+ * qhll memory structure
+ */
+struct qhll_data_s {
+    int version;            /*!< layout version, Q_HLL_VERSION */
+    int precision;          /*!< number of hash bits picking the register */
+    uint8_t registers[];    /*!< 2^precision registers */
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* QHLL_H */
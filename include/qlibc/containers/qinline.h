@@ -0,0 +1,306 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/**
+ * Inline fast paths and typed wrappers of qhashtbl, qvector and qlist.
+ *
+ * The member functions and qhashtbl_get() style calls go through the
+ * library, so the compiler can't see into them from the caller and every
+ * call checks the options and takes the lock. The functions here read the
+ * container directly in the caller when it's not thread-safe and there's
+ * nothing special going on, and call the library for the rest. So they
+ * give the same results as the library, just faster on the common path.
+ *
+ * The Q_*_TYPED() macros generate static inline functions specialized to
+ * the key and value types, which take and return them by value and let the
+ * compiler fold the sizes and the key comparisons into constants.
+ *
+ * @code
+ *   #include "qlibc.h"
+ *   #include "containers/qinline.h"
+ *
+ *   static inline uint32_t id_hash(const uint64_t *key) {
+ *     return qinline_hash64(*key);
+ *   }
+ *   Q_HASHTBL_TYPED(idmap, uint64_t, struct user, id_hash)
+ *   Q_VECTOR_TYPED(points, struct point)
+ *
+ *   qhashtbl_t *users = qhashtbl(0, 0);
+ *   idmap_put(users, 1001, user);
+ *   struct user *u = idmap_get(users, 1001);
+ *
+ *   qvector_t *path = points_new(0, QVECTOR_RESIZE_DOUBLE);
+ *   points_addlast(path, pt);
+ *   struct point *p = points_getat(path, 0);
+ * @endcode
+ *
+ * @file qinline.h
+ */
+
+#ifndef QINLINE_H
+#define QINLINE_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include "qhashtbl.h"
+#include "qvector.h"
+#include "qlist.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Hash a 64-bit integer key, the finalizer of MurmurHash3.
+ *
+ * @param key   integer key
+ *
+ * @return 32-bit hash value
+ */
+static inline uint32_t qinline_hash64(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return (uint32_t) key;
+}
+
+/**
+ * Inline qhashtbl_get_by_obj() without copying the data.
+ *
+ * @param tbl       qhashtbl_t container pointer.
+ * @param name      key data
+ * @param namesize  size of key data
+ * @param hash      hash value of the key the object was put with
+ * @param size      if not NULL, object size will be stored.
+ *
+ * @return a pointer of the data if found, otherwise returns NULL.
+ * @retval errno will be set in error condition.
+ *  - ENOENT : No such key found.
+ *
+ * @note
+ *  The chains are walked inline for a non thread-safe chaining table which
+ *  isn't in the middle of a resize. Otherwise it's qhashtbl_get_by_obj().
+ */
+static inline void *qhashtbl_get_inline(qhashtbl_t *tbl, const void *name,
+                                        size_t namesize, uint32_t hash,
+                                        size_t *size) {
+    if (__builtin_expect(name == NULL
+                         || tbl->qmutex != NULL || tbl->stripes != NULL
+                         || tbl->epoch != NULL || tbl->openslots != NULL
+                         || tbl->oldslots != NULL, 0)) {
+        return qhashtbl_get_by_obj(tbl, name, namesize, hash, size, false);
+    }
+
+    qhashtbl_obj_t *obj;
+    for (obj = tbl->slots[hash % tbl->range]; obj != NULL; obj = obj->next) {
+        if (obj->hash == hash && obj->namesize == namesize
+                && !memcmp(obj->name, name, namesize)) {
+            if (size != NULL)
+                *size = obj->size;
+            return obj->data;
+        }
+    }
+
+    errno = ENOENT;
+    return NULL;
+}
+
+/**
+ * Inline qvector_getat() without copying the element.
+ *
+ * @param vector    qvector_t container pointer.
+ * @param index     index of the element, negative from the end.
+ *
+ * @return a pointer of the element, otherwise returns NULL.
+ * @retval errno will be set in error condition.
+ *  - ENOENT : Vector is empty.
+ *  - ERANGE : Index out of range.
+ */
+static inline void *qvector_getat_inline(qvector_t *vector, int index) {
+    size_t idx = (index < 0) ? vector->num + index : (size_t) index;
+    if (__builtin_expect(vector->qmutex != NULL || idx >= vector->num, 0)) {
+        return qvector_getat(vector, index, false);
+    }
+
+    size_t pos = vector->head + idx;
+    if (pos >= vector->max)
+        pos -= vector->max;
+    return (unsigned char *) vector->data + pos * vector->objsize;
+}
+
+/**
+ * Inline qvector_addlast().
+ *
+ * @param vector    qvector_t container pointer.
+ * @param data      a pointer of the element.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @note
+ *  The element is copied inline while there's room. Growing the vector is
+ *  left to qvector_addlast().
+ */
+static inline bool qvector_addlast_inline(qvector_t *vector, const void *data) {
+    if (__builtin_expect(vector->qmutex != NULL || data == NULL
+                         || vector->num >= vector->max, 0)) {
+        return qvector_addlast(vector, data);
+    }
+
+    size_t pos = vector->head + vector->num;
+    if (pos >= vector->max)
+        pos -= vector->max;
+    memcpy((unsigned char *) vector->data + pos * vector->objsize, data,
+           vector->objsize);
+    vector->num++;
+    return true;
+}
+
+/**
+ * Inline qlist_getfirst() without copying the element.
+ *
+ * @param list  qlist_t container pointer.
+ * @param size  if not NULL, element size will be stored.
+ *
+ * @return a pointer of the element, otherwise returns NULL.
+ * @retval errno will be set in error condition.
+ *  - ERANGE : List is empty, as qlist_getat() tells.
+ */
+static inline void *qlist_getfirst_inline(qlist_t *list, size_t *size) {
+    if (__builtin_expect(list->qmutex != NULL || list->first == NULL, 0))
+        return qlist_getfirst(list, size, false);
+
+    if (size != NULL)
+        *size = list->first->size;
+    return list->first->data;
+}
+
+/**
+ * Inline qlist_getlast() without copying the element.
+ *
+ * @param list  qlist_t container pointer.
+ * @param size  if not NULL, element size will be stored.
+ *
+ * @return a pointer of the element, otherwise returns NULL.
+ * @retval errno will be set in error condition.
+ *  - ERANGE : List is empty, as qlist_getat() tells.
+ */
+static inline void *qlist_getlast_inline(qlist_t *list, size_t *size) {
+    if (__builtin_expect(list->qmutex != NULL || list->last == NULL, 0))
+        return qlist_getlast(list, size, false);
+
+    if (size != NULL)
+        *size = list->last->size;
+    return list->last->data;
+}
+
+/**
+ * Generate typed qhashtbl functions of the given prefix.
+ *
+ *  - bool PREFIX_put(qhashtbl_t *tbl, K key, V value)
+ *  - V *PREFIX_get(qhashtbl_t *tbl, K key)
+ *  - bool PREFIX_remove(qhashtbl_t *tbl, K key)
+ *
+ * HASHFN is called as uint32_t HASHFN(const K *key). The keys are compared
+ * bytewise, so K must not have padding bytes, like the integers and the
+ * pointers. The objects are hashed by HASHFN rather than the hash function
+ * of the table, so the table must be accessed by these functions only,
+ * except size(), getnext(), clear() and free().
+ */
+#define Q_HASHTBL_TYPED(PREFIX, K, V, HASHFN)                           \
+    static inline bool PREFIX##_put(qhashtbl_t *tbl, K key, V value) {  \
+        return qhashtbl_put_by_obj(tbl, &key, sizeof(K), HASHFN(&key),  \
+                                   &value, sizeof(V));                  \
+    }                                                                   \
+    static inline V *PREFIX##_get(qhashtbl_t *tbl, K key) {             \
+        return (V *) qhashtbl_get_inline(tbl, &key, sizeof(K),          \
+                                         HASHFN(&key), NULL);           \
+    }                                                                   \
+    static inline bool PREFIX##_remove(qhashtbl_t *tbl, K key) {        \
+        return qhashtbl_remove_by_obj(tbl, &key, sizeof(K),             \
+                                      HASHFN(&key));                    \
+    }
+
+/**
+ * Generate typed qvector functions of the given prefix.
+ *
+ *  - qvector_t *PREFIX_new(size_t max, int options)
+ *  - bool PREFIX_addlast(qvector_t *vector, T value)
+ *  - T *PREFIX_getat(qvector_t *vector, int index)
+ *  - size_t PREFIX_size(qvector_t *vector)
+ *
+ * The vector must be created by PREFIX_new() or with sizeof(T) elements.
+ */
+#define Q_VECTOR_TYPED(PREFIX, T)                                       \
+    static inline qvector_t *PREFIX##_new(size_t max, int options) {    \
+        return qvector(max, sizeof(T), options);                        \
+    }                                                                   \
+    static inline bool PREFIX##_addlast(qvector_t *vector, T value) {   \
+        return qvector_addlast_inline(vector, &value);                  \
+    }                                                                   \
+    static inline T *PREFIX##_getat(qvector_t *vector, int index) {     \
+        return (T *) qvector_getat_inline(vector, index);               \
+    }                                                                   \
+    static inline size_t PREFIX##_size(qvector_t *vector) {             \
+        return vector->num;                                             \
+    }
+
+/**
+ * Generate typed qlist functions of the given prefix.
+ *
+ *  - bool PREFIX_addlast(qlist_t *list, T value)
+ *  - T *PREFIX_getfirst(qlist_t *list)
+ *  - T *PREFIX_getlast(qlist_t *list)
+ *  - T *PREFIX_getat(qlist_t *list, int index)
+ */
+#define Q_LIST_TYPED(PREFIX, T)                                         \
+    static inline bool PREFIX##_addlast(qlist_t *list, T value) {       \
+        return qlist_addlast(list, &value, sizeof(T));                  \
+    }                                                                   \
+    static inline T *PREFIX##_getfirst(qlist_t *list) {                 \
+        return (T *) qlist_getfirst_inline(list, NULL);                 \
+    }                                                                   \
+    static inline T *PREFIX##_getlast(qlist_t *list) {                  \
+        return (T *) qlist_getlast_inline(list, NULL);                  \
+    }                                                                   \
+    static inline T *PREFIX##_getat(qlist_t *list, int index) {         \
+        return (T *) qlist_getat(list, index, NULL, false);             \
+    }
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* QINLINE_H */
@@ -39,6 +39,8 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <sys/uio.h>
+#include "qarena.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -60,6 +62,9 @@ enum {
  */
 extern qlist_t *qlist(int options); /*!< qlist constructor */
 extern size_t qlist_setsize(qlist_t *list, size_t max);
+extern size_t qlist_setpool(qlist_t *list, size_t max);
+extern size_t qlist_poolstat(qlist_t *list, size_t *hits, size_t *misses);
+extern bool qlist_set_arena(qlist_t *list, qarena_t *arena);
 
 extern bool qlist_addfirst(qlist_t *list, const void *data, size_t size);
 extern bool qlist_addlast(qlist_t *list, const void *data, size_t size);
@@ -79,12 +84,20 @@ extern bool qlist_removeat(qlist_t *list, int index);
 
 extern bool qlist_getnext(qlist_t *list, qlist_obj_t *obj, bool newmem);
 
+extern bool qlist_splice(qlist_t *list, int index, qlist_t *src);
+extern bool qlist_concat(qlist_t *list, qlist_t *src);
+extern bool qlist_moveto(qlist_t *list, int index, size_t count, qlist_t *dst);
+
 extern size_t qlist_size(qlist_t *list);
 extern size_t qlist_datasize(qlist_t *list);
 extern void qlist_reverse(qlist_t *list);
+extern void qlist_sort(qlist_t *list,
+                       int (*cmp)(const void *data1, size_t size1,
+                                  const void *data2, size_t size2));
 extern void qlist_clear(qlist_t *list);
 
 extern void *qlist_toarray(qlist_t *list, size_t *size);
+extern int qlist_toiovec(qlist_t *list, struct iovec *iov, int iovcnt);
 extern char *qlist_tostring(qlist_t *list);
 extern bool qlist_debug(qlist_t *list, FILE *out);
 
@@ -99,6 +112,9 @@ extern void qlist_free(qlist_t *list);
 struct qlist_s {
     /* encapsulated member functions */
     size_t (*setsize)(qlist_t *list, size_t max);
+    size_t (*setpool)(qlist_t *list, size_t max);
+    size_t (*poolstat)(qlist_t *list, size_t *hits, size_t *misses);
+    bool (*set_arena)(qlist_t *list, qarena_t *arena);
 
     bool (*addfirst)(qlist_t *list, const void *data, size_t size);
     bool (*addlast)(qlist_t *list, const void *data, size_t size);
@@ -118,13 +134,21 @@ struct qlist_s {
 
     bool (*getnext)(qlist_t *list, qlist_obj_t *obj, bool newmem);
 
+    bool (*splice)(qlist_t *list, int index, qlist_t *src);
+    bool (*concat)(qlist_t *list, qlist_t *src);
+    bool (*moveto)(qlist_t *list, int index, size_t count, qlist_t *dst);
+
     void (*reverse)(qlist_t *list);
+    void (*sort)(qlist_t *list,
+                 int (*cmp)(const void *data1, size_t size1,
+                            const void *data2, size_t size2));
     void (*clear)(qlist_t *list);
 
     size_t (*size)(qlist_t *list);
     size_t (*datasize)(qlist_t *list);
 
     void *(*toarray)(qlist_t *list, size_t *size);
+    int (*toiovec)(qlist_t *list, struct iovec *iov, int iovcnt);
     char *(*tostring)(qlist_t *list);
     bool (*debug)(qlist_t *list, FILE *out);
 
@@ -141,6 +165,15 @@ struct qlist_s {
 
     qlist_obj_t *first;   /*!< first object pointer */
     qlist_obj_t *last;    /*!< last object pointer */
+    qlist_obj_t *cursor;  /*!< last object accessed by index, NULL if unknown */
+    size_t cursoridx;     /*!< index of the cursor object */
+    qarena_t *arena;      /*!< arena allocator of the elements, NULL for the heap */
+
+    qlist_obj_t *pool[8]; /*!< recycled nodes by size class, 16 bytes to 2KB */
+    size_t poolnum;       /*!< number of recycled nodes */
+    size_t poolmax;       /*!< maximum number of recycled nodes */
+    size_t poolhits;      /*!< insertions served by the pool */
+    size_t poolmisses;    /*!< insertions which called malloc() */
 };
 
 /**
@@ -38,6 +38,8 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include "qarena.h"
+#include "qstats.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -54,6 +56,7 @@ enum {
     QLISTTBL_CASEINSENSITIVE = (0x01 << 2), /*!< keys are case insensitive */
     QLISTTBL_INSERTTOP       = (0x01 << 3), /*!< insert new key at the top */
     QLISTTBL_LOOKUPFORWARD   = (0x01 << 4), /*!< find key from the top (default: backward) */
+    QLISTTBL_HASHINDEX       = (0x01 << 5), /*!< keep a hash index of keys */
 };
 
 /* member functions
@@ -79,15 +82,31 @@ extern void qlisttbl_freemulti(qlisttbl_data_t *objs);
 extern size_t qlisttbl_remove(qlisttbl_t *tbl, const char *name);
 extern bool qlisttbl_removeobj(qlisttbl_t *tbl, const qlisttbl_obj_t *obj);
 
+extern bool qlisttbl_put_by_obj(qlisttbl_t *tbl, const void *name, size_t namesize,
+                                uint32_t hash, const void *data, size_t size);
+extern void *qlisttbl_get_by_obj(qlisttbl_t *tbl, const void *name, size_t namesize,
+                                 uint32_t hash, size_t *size, bool newmem);
+extern size_t qlisttbl_remove_by_obj(qlisttbl_t *tbl, const void *name, size_t namesize,
+                                     uint32_t hash);
+
 extern bool qlisttbl_getnext(qlisttbl_t *tbl, qlisttbl_obj_t *obj, const char *name, bool newmem);
 
 extern size_t qlisttbl_size(qlisttbl_t *tbl);
 extern void qlisttbl_sort(qlisttbl_t *tbl);
+extern void qlisttbl_sort_by(qlisttbl_t *tbl,
+                             int (*cmp)(const qlisttbl_obj_t *obj1,
+                                        const qlisttbl_obj_t *obj2));
+extern bool qlisttbl_set_hash(qlisttbl_t *tbl,
+                              uint32_t (*hashfunc)(const void *data, size_t nbytes));
+extern bool qlisttbl_set_arena(qlisttbl_t *tbl, qarena_t *arena);
 extern void qlisttbl_clear(qlisttbl_t *tbl);
 extern bool qlisttbl_save(qlisttbl_t *tbl, const char *filepath, char sepchar, bool encode);
 extern ssize_t qlisttbl_load(qlisttbl_t *tbl, const char *filepath, char sepchar, bool decode);
+extern bool qlisttbl_dump(qlisttbl_t *tbl, const char *filepath, bool checksum);
+extern ssize_t qlisttbl_restore(qlisttbl_t *tbl, const char *filepath);
 
 extern bool qlisttbl_debug(qlisttbl_t *tbl, FILE *out);
+extern bool qlisttbl_stats(qlisttbl_t *tbl, qstats_t *stats);
 
 extern void qlisttbl_lock(qlisttbl_t *tbl);
 extern void qlisttbl_unlock(qlisttbl_t *tbl);
@@ -116,17 +135,33 @@ struct qlisttbl_s {
     size_t (*remove) (qlisttbl_t *tbl, const char *name);
     bool (*removeobj) (qlisttbl_t *tbl, const qlisttbl_obj_t *obj);
 
+    bool (*put_by_obj) (qlisttbl_t *tbl, const void *name, size_t namesize,
+                        uint32_t hash, const void *data, size_t size);
+    void *(*get_by_obj) (qlisttbl_t *tbl, const void *name, size_t namesize,
+                         uint32_t hash, size_t *size, bool newmem);
+    size_t (*remove_by_obj) (qlisttbl_t *tbl, const void *name, size_t namesize,
+                             uint32_t hash);
+
     bool (*getnext) (qlisttbl_t *tbl, qlisttbl_obj_t *obj, const char *name, bool newmem);
 
     size_t (*size) (qlisttbl_t *tbl);
     void (*sort) (qlisttbl_t *tbl);
+    void (*sort_by) (qlisttbl_t *tbl,
+                     int (*cmp)(const qlisttbl_obj_t *obj1,
+                                const qlisttbl_obj_t *obj2));
+    bool (*set_hash) (qlisttbl_t *tbl,
+                      uint32_t (*hashfunc)(const void *data, size_t nbytes));
+    bool (*set_arena) (qlisttbl_t *tbl, qarena_t *arena);
     void (*clear) (qlisttbl_t *tbl);
 
     bool (*save) (qlisttbl_t *tbl, const char *filepath, char sepchar,
                   bool encode);
     ssize_t (*load) (qlisttbl_t *tbl, const char *filepath, char sepchar,
                      bool decode);
+    bool (*dump) (qlisttbl_t *tbl, const char *filepath, bool checksum);
+    ssize_t (*restore) (qlisttbl_t *tbl, const char *filepath);
     bool (*debug) (qlisttbl_t *tbl, FILE *out);
+    bool (*stats) (qlisttbl_t *tbl, qstats_t *stats);
 
     void (*lock) (qlisttbl_t *tbl);
     void (*unlock) (qlisttbl_t *tbl);
@@ -134,8 +169,10 @@ struct qlisttbl_s {
     void (*free) (qlisttbl_t *tbl);
 
     /* private methods */
-    bool (*namematch) (qlisttbl_obj_t *obj, const char *name, uint32_t hash);
+    bool (*namematch) (qlisttbl_obj_t *obj, const void *name, size_t namesize,
+                       uint32_t hash);
     int (*namecmp) (const char *s1, const char *s2);
+    uint32_t (*hashfunc) (const void *data, size_t nbytes);
 
     /* private variables - do not access directly */
     bool unique;           /*!< keys are unique */
@@ -148,6 +185,15 @@ struct qlisttbl_s {
     size_t num;            /*!< number of elements */
     qlisttbl_obj_t *first; /*!< first object pointer */
     qlisttbl_obj_t *last;  /*!< last object pointer */
+    qarena_t *arena;       /*!< arena allocator of the objects, NULL for the heap */
+
+    qlisttbl_obj_t **index; /*!< hash index buckets, QLISTTBL_HASHINDEX only */
+    size_t indexsize;      /*!< number of hash index buckets */
+
+    uint64_t collisions;   /*!< inserts into an occupied index bucket */
+    uint64_t resizes;      /*!< number of times the index was grown */
+    uint64_t allocs;       /*!< object allocations */
+    uint64_t frees;        /*!< object releases */
 };
 
 /**
@@ -156,11 +202,14 @@ struct qlisttbl_s {
 struct qlisttbl_obj_s {
     uint32_t hash;      /*!< 32bit-hash value of object name */
     char *name;         /*!< object name */
+    size_t namesize;    /*!< object name size, not counting the NUL terminator */
     void *data;         /*!< data */
     size_t size;        /*!< data size */
 
     qlisttbl_obj_t *prev;    /*!< previous link */
     qlisttbl_obj_t *next;    /*!< next link */
+    qlisttbl_obj_t *hprev;   /*!< previous link in the hash index bucket */
+    qlisttbl_obj_t *hnext;   /*!< next link in the hash index bucket */
 };
 
 /**
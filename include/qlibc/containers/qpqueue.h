@@ -0,0 +1,129 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/**
+ * Priority queue container.
+ *
+ * @file qpqueue.h
+ */
+
+#ifndef QPQUEUE_H
+#define QPQUEUE_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* types */
+typedef struct qpqueue_s qpqueue_t;
+
+enum {
+    QPQUEUE_THREADSAFE = (0x01)  /*!< make it thread-safe */
+};
+
+/* member functions
+ *
+ * All the member functions can be accessed in both ways:
+ *  - pqueue->push(pqueue, ...);     // easier to switch the container type to other kinds.
+ *  - qpqueue_push(pqueue, ...);     // where avoiding pointer overhead is preferred.
+ */
+extern qpqueue_t *qpqueue(size_t max, size_t objsize,
+                          int (*cmp)(const void *data1, const void *data2),
+                          int options);
+
+extern int64_t qpqueue_push(qpqueue_t *pqueue, const void *data);
+extern bool qpqueue_pusharray(qpqueue_t *pqueue, const void *data, size_t n,
+                              int64_t *handles);
+
+extern void *qpqueue_top(qpqueue_t *pqueue, bool newmem);
+extern int64_t qpqueue_tophandle(qpqueue_t *pqueue);
+extern void *qpqueue_pop(qpqueue_t *pqueue);
+extern bool qpqueue_removetop(qpqueue_t *pqueue);
+
+extern void *qpqueue_get(qpqueue_t *pqueue, int64_t handle, bool newmem);
+extern bool qpqueue_update(qpqueue_t *pqueue, int64_t handle,
+                           const void *data);
+extern bool qpqueue_remove(qpqueue_t *pqueue, int64_t handle);
+
+extern size_t qpqueue_size(qpqueue_t *pqueue);
+extern bool qpqueue_reserve(qpqueue_t *pqueue, size_t n);
+extern void qpqueue_lock(qpqueue_t *pqueue);
+extern void qpqueue_unlock(qpqueue_t *pqueue);
+extern void qpqueue_clear(qpqueue_t *pqueue);
+extern bool qpqueue_debug(qpqueue_t *pqueue, FILE *out);
+extern void qpqueue_free(qpqueue_t *pqueue);
+
+/**
+ * qpqueue container object structure
+ */
+struct qpqueue_s {
+    /* encapsulated member functions */
+    int64_t (*push) (qpqueue_t *pqueue, const void *data);
+    bool (*pusharray) (qpqueue_t *pqueue, const void *data, size_t n,
+                       int64_t *handles);
+
+    void *(*top) (qpqueue_t *pqueue, bool newmem);
+    int64_t (*tophandle) (qpqueue_t *pqueue);
+    void *(*pop) (qpqueue_t *pqueue);
+    bool (*removetop) (qpqueue_t *pqueue);
+
+    void *(*get) (qpqueue_t *pqueue, int64_t handle, bool newmem);
+    bool (*update) (qpqueue_t *pqueue, int64_t handle, const void *data);
+    bool (*remove) (qpqueue_t *pqueue, int64_t handle);
+
+    size_t (*size) (qpqueue_t *pqueue);
+    bool (*reserve) (qpqueue_t *pqueue, size_t n);
+    void (*lock) (qpqueue_t *pqueue);
+    void (*unlock) (qpqueue_t *pqueue);
+    void (*clear) (qpqueue_t *pqueue);
+    bool (*debug) (qpqueue_t *pqueue, FILE *out);
+    void (*free) (qpqueue_t *pqueue);
+
+    /* private variables - do not access directly */
+    void *qmutex;       /*!< initialized when QPQUEUE_THREADSAFE is given */
+    void *data;         /*!< elements in heap order */
+    int *heapslot;      /*!< handle slot of each heap position */
+    void *slots;        /*!< handle slots indexed by the handle */
+    int freeslot;       /*!< first free handle slot, -1 if none */
+    size_t num;         /*!< number of elements */
+    size_t max;         /*!< allocated number of elements */
+    size_t objsize;     /*!< the size of each element */
+    void *tmp;          /*!< an element of scratch space for sifting */
+    int (*cmp)(const void *data1, const void *data2);
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* QPQUEUE_H */
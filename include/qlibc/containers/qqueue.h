@@ -58,7 +58,9 @@ enum {
  *  - qqueue_push(tbl, ...);  // where avoiding pointer overhead is preferred.
  */
 extern qqueue_t *qqueue(int options);
+extern qqueue_t *qqueue_ring(size_t max, size_t objsize);
 extern size_t qqueue_setsize(qqueue_t *queue, size_t max);
+extern size_t qqueue_poolstat(qqueue_t *queue, size_t *hits, size_t *misses);
 
 extern bool qqueue_push(qqueue_t *queue, const void *data, size_t size);
 extern bool qqueue_pushstr(qqueue_t *queue, const char *str);
@@ -68,6 +70,9 @@ extern void *qqueue_pop(qqueue_t *queue, size_t *size);
 extern char *qqueue_popstr(qqueue_t *queue);
 extern int64_t qqueue_popint(qqueue_t *queue);
 extern void *qqueue_popat(qqueue_t *queue, int index, size_t *size);
+extern void *qqueue_pop_wait(qqueue_t *queue, size_t *size, int timeoutms);
+extern size_t qqueue_popbatch(qqueue_t *queue, void *datas[], size_t sizes[],
+                              size_t max);
 
 extern void *qqueue_get(qqueue_t *queue, size_t *size, bool newmem);
 extern char *qqueue_getstr(qqueue_t *queue);
@@ -85,6 +90,7 @@ extern void qqueue_free(qqueue_t *queue);
 struct qqueue_s {
     /* encapsulated member functions */
     size_t (*setsize) (qqueue_t *stack, size_t max);
+    size_t (*poolstat) (qqueue_t *stack, size_t *hits, size_t *misses);
 
     bool (*push) (qqueue_t *stack, const void *data, size_t size);
     bool (*pushstr) (qqueue_t *stack, const char *str);
@@ -94,6 +100,9 @@ struct qqueue_s {
     char *(*popstr) (qqueue_t *stack);
     int64_t (*popint) (qqueue_t *stack);
     void *(*popat) (qqueue_t *stack, int index, size_t *size);
+    void *(*pop_wait) (qqueue_t *stack, size_t *size, int timeoutms);
+    size_t (*popbatch) (qqueue_t *stack, void *datas[], size_t sizes[],
+                        size_t max);
 
     void *(*get) (qqueue_t *stack, size_t *size, bool newmem);
     char *(*getstr) (qqueue_t *stack);
@@ -107,6 +116,8 @@ struct qqueue_s {
 
     /* private variables - do not access directly */
     qlist_t  *list;  /*!< data container */
+    void *ring;      /*!< ring buffer, set when created by qqueue_ring() */
+    void *qwait;     /*!< condition variable for pop_wait() */
 };
 
 #ifdef __cplusplus
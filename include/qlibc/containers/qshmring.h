@@ -0,0 +1,101 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/**
+ * Message ring buffer that works in preallocated shared memory.
+ *
+ * @file qshmring.h
+ */
+
+#ifndef QSHMRING_H
+#define QSHMRING_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ring options */
+enum {
+    QSHMRING_MULTIPRODUCER = (0x01)  /*!< allow concurrent producers */
+};
+
+/* types */
+typedef struct qshmring_s qshmring_t;
+
+/* member functions
+ *
+ * All the member functions can be accessed in both ways:
+ *  - ring->push(ring, ...);      // easier to switch the container type to other kinds.
+ *  - qshmring_push(ring, ...);   // where avoiding pointer overhead is preferred.
+ */
+extern size_t qshmring_calculate_memsize(size_t capacity);
+extern qshmring_t *qshmring(void *memory, size_t memsize, int options);
+
+extern bool qshmring_push(qshmring_t *ring, const void *data, size_t size);
+extern bool qshmring_push_wait(qshmring_t *ring, const void *data, size_t size,
+                               int timeoutms);
+extern ssize_t qshmring_pop(qshmring_t *ring, void *buf, size_t bufsize);
+extern ssize_t qshmring_pop_wait(qshmring_t *ring, void *buf, size_t bufsize,
+                                 int timeoutms);
+
+extern size_t qshmring_used(qshmring_t *ring);
+extern size_t qshmring_capacity(qshmring_t *ring);
+extern void qshmring_free(qshmring_t *ring);
+
+/**
+ * qshmring container object structure
+ */
+struct qshmring_s {
+    /* encapsulated member functions */
+    bool (*push) (qshmring_t *ring, const void *data, size_t size);
+    bool (*push_wait) (qshmring_t *ring, const void *data, size_t size,
+                       int timeoutms);
+    ssize_t (*pop) (qshmring_t *ring, void *buf, size_t bufsize);
+    ssize_t (*pop_wait) (qshmring_t *ring, void *buf, size_t bufsize,
+                         int timeoutms);
+
+    size_t (*used) (qshmring_t *ring);
+    size_t (*capacity) (qshmring_t *ring);
+    void (*free) (qshmring_t *ring);
+
+    /* private variables - do not access directly */
+    void *shared;       /*!< ring header in the memory */
+    uint8_t *buf;       /*!< record area following the header */
+    uint64_t mask;      /*!< record area size - 1 */
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* QSHMRING_H */
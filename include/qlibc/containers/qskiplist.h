@@ -0,0 +1,156 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/**
+ * Concurrent skip list container.
+ *
+ * @file qskiplist.h
+ */
+
+#ifndef QSKIPLIST_H
+#define QSKIPLIST_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* types */
+typedef struct qskiplist_s qskiplist_t;
+typedef struct qskiplist_obj_s qskiplist_obj_t;
+
+/* member functions
+ *
+ * All the member functions can be accessed in both ways:
+ *  - list->put(list, ...);      // easier to switch the container type to other kinds.
+ *  - qskiplist_put(list, ...);  // where avoiding pointer overhead is preferred.
+ */
+extern qskiplist_t *qskiplist(void);
+
+extern void qskiplist_set_compare(qskiplist_t *list,
+                                  int (*cmp)(const void *name1,
+                                             size_t namesize1,
+                                             const void *name2,
+                                             size_t namesize2));
+
+extern bool qskiplist_put(qskiplist_t *list, const char *name,
+                          const void *data, size_t datasize);
+extern bool qskiplist_putstr(qskiplist_t *list, const char *name,
+                             const char *str);
+extern bool qskiplist_putobj(qskiplist_t *list, const void *name,
+                             size_t namesize, const void *data,
+                             size_t datasize);
+
+extern void *qskiplist_get(qskiplist_t *list, const char *name,
+                           size_t *datasize, bool newmem);
+extern char *qskiplist_getstr(qskiplist_t *list, const char *name,
+                              bool newmem);
+extern void *qskiplist_getobj(qskiplist_t *list, const void *name,
+                              size_t namesize, size_t *datasize, bool newmem);
+
+extern bool qskiplist_remove(qskiplist_t *list, const char *name);
+extern bool qskiplist_removeobj(qskiplist_t *list, const void *name,
+                                size_t namesize);
+
+extern bool qskiplist_getnext(qskiplist_t *list, qskiplist_obj_t *obj,
+                              bool newmem);
+extern qskiplist_obj_t qskiplist_find_nearest(qskiplist_t *list,
+                                              const void *name,
+                                              size_t namesize, bool newmem);
+
+extern size_t qskiplist_size(qskiplist_t *list);
+extern void qskiplist_read_enter(qskiplist_t *list);
+extern void qskiplist_read_leave(qskiplist_t *list);
+extern void qskiplist_clear(qskiplist_t *list);
+extern void qskiplist_free(qskiplist_t *list);
+
+/**
+ * qskiplist container object
+ */
+struct qskiplist_s {
+    /* encapsulated member functions */
+    void (*set_compare)(qskiplist_t *list,
+                        int (*cmp)(const void *name1, size_t namesize1,
+                                   const void *name2, size_t namesize2));
+
+    bool (*put)(qskiplist_t *list, const char *name, const void *data,
+                size_t datasize);
+    bool (*putstr)(qskiplist_t *list, const char *name, const char *str);
+    bool (*putobj)(qskiplist_t *list, const void *name, size_t namesize,
+                   const void *data, size_t datasize);
+
+    void *(*get)(qskiplist_t *list, const char *name, size_t *datasize,
+                 bool newmem);
+    char *(*getstr)(qskiplist_t *list, const char *name, bool newmem);
+    void *(*getobj)(qskiplist_t *list, const void *name, size_t namesize,
+                    size_t *datasize, bool newmem);
+
+    bool (*remove)(qskiplist_t *list, const char *name);
+    bool (*removeobj)(qskiplist_t *list, const void *name, size_t namesize);
+
+    bool (*getnext)(qskiplist_t *list, qskiplist_obj_t *obj, bool newmem);
+    qskiplist_obj_t (*find_nearest)(qskiplist_t *list, const void *name,
+                                    size_t namesize, bool newmem);
+
+    size_t (*size)(qskiplist_t *list);
+    void (*read_enter)(qskiplist_t *list);
+    void (*read_leave)(qskiplist_t *list);
+    void (*clear)(qskiplist_t *list);
+    void (*free)(qskiplist_t *list);
+
+    /* private member functions */
+    int (*compare)(const void *name1, size_t namesize1, const void *name2,
+                   size_t namesize2);
+
+    /* private variables - do not access directly */
+    void *head;             /*!< head node linking every level */
+    size_t num;             /*!< number of objects */
+    void *epoch;            /*!< reclamation state of the removed nodes */
+};
+
+/**
+ * qskiplist object data structure
+ */
+struct qskiplist_obj_s {
+    void *name;             /*!< name of key */
+    size_t namesize;        /*!< name size */
+    void *data;             /*!< data */
+    size_t datasize;        /*!< data size */
+
+    /* private variables - do not access directly */
+    void *cur;              /*!< node to continue the traversal from */
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* QSKIPLIST_H */
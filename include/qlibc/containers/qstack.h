@@ -59,6 +59,7 @@ enum {
  */
 extern qstack_t *qstack(int options);
 extern size_t qstack_setsize(qstack_t *stack, size_t max);
+extern size_t qstack_poolstat(qstack_t *stack, size_t *hits, size_t *misses);
 
 extern bool qstack_push(qstack_t *stack, const void *data, size_t size);
 extern bool qstack_pushstr(qstack_t *stack, const char *str);
@@ -85,6 +86,7 @@ extern void qstack_free(qstack_t *stack);
 struct qstack_s {
     /* encapsulated member functions */
     size_t (*setsize) (qstack_t *stack, size_t max);
+    size_t (*poolstat) (qstack_t *stack, size_t *hits, size_t *misses);
 
     bool (*push) (qstack_t *stack, const void *data, size_t size);
     bool (*pushstr) (qstack_t *stack, const char *str);
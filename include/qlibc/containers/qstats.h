@@ -0,0 +1,90 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/**
+ * Runtime statistics of the containers.
+ *
+ * @file qstats.h
+ */
+
+#ifndef QSTATS_H
+#define QSTATS_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* number of probe histogram buckets, the last one collects the longer ones */
+#define QSTATS_HISTSIZE (16)
+
+/* types */
+typedef struct qstats_s qstats_t;
+
+/* public functions */
+extern bool qstats_print(const qstats_t *stats, const char *prefix, FILE *out);
+
+/**
+ * container statistics structure
+ *
+ * The shape fields are measured when the statistics are taken and the
+ * counters run from the creation of the container. A field which doesn't
+ * apply to the container is left 0.
+ */
+struct qstats_s {
+    /* shape */
+    size_t num;             /*!< number of stored objects */
+    size_t slots;           /*!< number of hash slots */
+    size_t usedslots;       /*!< number of slots in use */
+    size_t maxprobe;        /*!< longest probe to reach a stored object */
+    size_t probes[QSTATS_HISTSIZE]; /*!< probes[n] is the number of
+                                         objects found after n extra probes
+                                         past their home slot */
+
+    /* counters */
+    uint64_t collisions;    /*!< inserts into an occupied home slot */
+    uint64_t resizes;       /*!< number of times the slots were grown */
+    uint64_t evictions;     /*!< objects evicted to make room */
+    uint64_t allocs;        /*!< memory allocations of objects */
+    uint64_t frees;         /*!< memory releases of objects */
+
+    /* locking */
+    uint64_t locks;         /*!< lock acquisitions */
+    uint64_t contended;     /*!< acquisitions which had to wait */
+    uint64_t lockwait;      /*!< total time spent waiting in nanoseconds */
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* QSTATS_H */
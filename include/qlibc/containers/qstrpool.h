@@ -0,0 +1,102 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/**
+ * String interning pool.
+ *
+ * @file qstrpool.h
+ */
+
+#ifndef QSTRPOOL_H
+#define QSTRPOOL_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "qarena.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* types */
+typedef struct qstrpool_s qstrpool_t;
+
+enum {
+    QSTRPOOL_THREADSAFE = (0x01)  /*!< make it thread-safe */
+};
+
+/* member functions
+ *
+ * All the member functions can be accessed in both ways:
+ *  - pool->intern(pool, ...);    // easier to switch the container type to other kinds.
+ *  - qstrpool_intern(pool, ...); // where avoiding pointer overhead is preferred.
+ */
+extern qstrpool_t *qstrpool(size_t range, int options);  /*!< qstrpool constructor */
+
+extern const char *qstrpool_intern(qstrpool_t *pool, const void *str,
+                                   size_t len, uint32_t *hash);
+extern const char *qstrpool_internstr(qstrpool_t *pool, const char *str);
+extern const char *qstrpool_find(qstrpool_t *pool, const void *str,
+                                 size_t len, uint32_t *hash);
+
+extern uint32_t qstrpool_hash(const char *interned);
+extern size_t qstrpool_len(const char *interned);
+
+extern size_t qstrpool_size(qstrpool_t *pool);
+extern size_t qstrpool_memsize(qstrpool_t *pool);
+extern void qstrpool_free(qstrpool_t *pool);
+
+/**
+ * qstrpool container object structure
+ */
+struct qstrpool_s {
+    /* encapsulated member functions */
+    const char *(*intern) (qstrpool_t *pool, const void *str, size_t len,
+                           uint32_t *hash);
+    const char *(*internstr) (qstrpool_t *pool, const char *str);
+    const char *(*find) (qstrpool_t *pool, const void *str, size_t len,
+                         uint32_t *hash);
+
+    size_t (*size) (qstrpool_t *pool);
+    size_t (*memsize) (qstrpool_t *pool);
+    void (*free) (qstrpool_t *pool);
+
+    /* private variables - do not access directly */
+    void *qrwlock;      /*!< initialized when QSTRPOOL_THREADSAFE is given */
+    size_t num;         /*!< number of interned strings */
+    size_t range;       /*!< number of buckets, always a power of 2 */
+    void **buckets;     /*!< bucket heads of the interned strings */
+    qarena_t *arena;    /*!< storage of the interned strings */
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* QSTRPOOL_H */
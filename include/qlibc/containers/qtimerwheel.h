@@ -0,0 +1,117 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/**
+ * Hierarchical timer wheel container.
+ *
+ * @file qtimerwheel.h
+ */
+
+#ifndef QTIMERWHEEL_H
+#define QTIMERWHEEL_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* types */
+typedef struct qtimerwheel_s qtimerwheel_t;
+
+typedef void (*qtimerwheel_cb_t) (qtimerwheel_t *wheel, int64_t timerid,
+                                  void *userdata);
+
+enum {
+    QTIMERWHEEL_THREADSAFE = (0x01)  /*!< make it thread-safe */
+};
+
+/* member functions
+ *
+ * All the member functions can be accessed in both ways:
+ *  - wheel->add(wheel, ...);     // easier to switch the container type to other kinds.
+ *  - qtimerwheel_add(wheel, ...);    // where avoiding pointer overhead is preferred.
+ */
+extern qtimerwheel_t *qtimerwheel(int tickms, int options);
+
+extern int64_t qtimerwheel_add(qtimerwheel_t *wheel, int timeoutms,
+                               qtimerwheel_cb_t cb, void *userdata);
+extern bool qtimerwheel_reset(qtimerwheel_t *wheel, int64_t timerid,
+                              int timeoutms);
+extern bool qtimerwheel_cancel(qtimerwheel_t *wheel, int64_t timerid);
+
+extern int qtimerwheel_expire(qtimerwheel_t *wheel);
+extern int qtimerwheel_advance(qtimerwheel_t *wheel, int64_t nowms);
+extern int qtimerwheel_nexttimeout(qtimerwheel_t *wheel);
+
+extern size_t qtimerwheel_size(qtimerwheel_t *wheel);
+extern void qtimerwheel_clear(qtimerwheel_t *wheel);
+extern void qtimerwheel_lock(qtimerwheel_t *wheel);
+extern void qtimerwheel_unlock(qtimerwheel_t *wheel);
+extern void qtimerwheel_free(qtimerwheel_t *wheel);
+
+/**
+ * qtimerwheel container object structure
+ */
+struct qtimerwheel_s {
+    /* encapsulated member functions */
+    int64_t (*add) (qtimerwheel_t *wheel, int timeoutms, qtimerwheel_cb_t cb,
+                    void *userdata);
+    bool (*reset) (qtimerwheel_t *wheel, int64_t timerid, int timeoutms);
+    bool (*cancel) (qtimerwheel_t *wheel, int64_t timerid);
+
+    int (*expire) (qtimerwheel_t *wheel);
+    int (*advance) (qtimerwheel_t *wheel, int64_t nowms);
+    int (*nexttimeout) (qtimerwheel_t *wheel);
+
+    size_t (*size) (qtimerwheel_t *wheel);
+    void (*clear) (qtimerwheel_t *wheel);
+    void (*lock) (qtimerwheel_t *wheel);
+    void (*unlock) (qtimerwheel_t *wheel);
+    void (*free) (qtimerwheel_t *wheel);
+
+    /* private variables - do not access directly */
+    void *qmutex;       /*!< initialized when QTIMERWHEEL_THREADSAFE is given */
+    void *timers;       /*!< timer slab indexed by the timer id */
+    int maxtimers;      /*!< allocated slab size */
+    int freetimer;      /*!< first free slab entry, -1 if none */
+    size_t num;         /*!< number of pending timers */
+    int *buckets;       /*!< first timer of each bucket, -1 if empty */
+    int running;        /*!< timers being expired */
+    int tickms;         /*!< milliseconds per tick */
+    int64_t startms;    /*!< monotonic milliseconds at tick 0 */
+    uint64_t tick;      /*!< next tick to expire */
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* QTIMERWHEEL_H */
@@ -39,6 +39,7 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include "qarena.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -47,10 +48,16 @@ extern "C" {
 /* types */
 typedef struct qtreetbl_s qtreetbl_t;
 typedef struct qtreetbl_obj_s qtreetbl_obj_t;
+typedef struct qtreetbl_cursor_s qtreetbl_cursor_t;
 
 /* public functions */
 enum {
-    QTREETBL_THREADSAFE = (0x01) /*!< make it thread-safe */
+    QTREETBL_THREADSAFE = (0x01), /*!< make it thread-safe */
+    QTREETBL_RWLOCK = (0x02),     /*!< thread-safe with concurrent readers */
+    QTREETBL_BPTREE = (0x04),     /*!< B+tree engine instead of red-black tree */
+    QTREETBL_KEY_UINT64 = (0x08), /*!< keys are uint64_t values */
+    QTREETBL_KEY_INT64 = (0x10),  /*!< keys are int64_t values */
+    QTREETBL_KEY_FIXED = (0x20)   /*!< keys are binary of the same size */
 };
 
 extern qtreetbl_t *qtreetbl(int options); /*!< qtreetbl constructor */
@@ -64,6 +71,7 @@ extern qtreetbl_t *qtreetbl(int options); /*!< qtreetbl constructor */
 extern void qtreetbl_set_compare(qtreetbl_t *tbl,
                                  int (*cmp)(const void *name1, size_t namesize1,
                                             const void *name2, size_t namesize2));
+extern bool qtreetbl_set_arena(qtreetbl_t *tbl, qarena_t *arena);
 
 extern bool qtreetbl_put(qtreetbl_t *tbl, const char *name, const void *data,
                          size_t datasize);
@@ -72,6 +80,9 @@ extern bool qtreetbl_putstrf(qtreetbl_t *tbl, const char *name,
                              const char *format, ...);
 extern bool qtreetbl_putobj(qtreetbl_t *tbl, const void *name, size_t namesize,
                             const void *data, size_t datasize);
+extern bool qtreetbl_bulkload(qtreetbl_t *tbl,
+                              bool (*iter)(void *userdata, qtreetbl_obj_t *obj),
+                              void *userdata);
 
 extern void *qtreetbl_get(qtreetbl_t *tbl,
                           const char *name, size_t *datasize, bool newmem);
@@ -88,17 +99,37 @@ extern void *qtreetbl_find_min(qtreetbl_t *tbl, size_t *namesize);
 extern void *qtreetbl_find_max(qtreetbl_t *tbl, size_t *namesize);
 extern qtreetbl_obj_t qtreetbl_find_nearest(qtreetbl_t *tbl, const void *name,
                                             size_t namesize, bool newmem);
+extern qtreetbl_obj_t qtreetbl_select(qtreetbl_t *tbl, size_t k, bool newmem);
+extern size_t qtreetbl_rank(qtreetbl_t *tbl, const void *name, size_t namesize);
+
+extern bool qtreetbl_cursor_seek(qtreetbl_t *tbl, qtreetbl_cursor_t *cursor,
+                                 const void *lo, size_t losize,
+                                 const void *hi, size_t hisize);
+extern bool qtreetbl_cursor_next(qtreetbl_t *tbl, qtreetbl_cursor_t *cursor,
+                                 qtreetbl_obj_t *obj, bool newmem);
+extern size_t qtreetbl_range(qtreetbl_t *tbl, const void *lo, size_t losize,
+                             const void *hi, size_t hisize,
+                             bool (*cb)(const qtreetbl_obj_t *obj, void *userdata),
+                             void *userdata);
 
 extern size_t qtreetbl_size(qtreetbl_t *tbl);
 extern void qtreetbl_clear(qtreetbl_t *tbl);
 
+extern bool qtreetbl_dump(qtreetbl_t *tbl, const char *filepath, bool checksum);
+extern ssize_t qtreetbl_restore(qtreetbl_t *tbl, const char *filepath);
+
 extern void qtreetbl_lock(qtreetbl_t *tbl);
+extern void qtreetbl_rdlock(qtreetbl_t *tbl);
 extern void qtreetbl_unlock(qtreetbl_t *tbl);
 
 extern void qtreetbl_free(qtreetbl_t *tbl);
 
 extern int qtreetbl_byte_cmp(const void *name1, size_t namesize1,
                              const void *name2, size_t namesize2);
+extern int qtreetbl_uint64_cmp(const void *name1, size_t namesize1,
+                               const void *name2, size_t namesize2);
+extern int qtreetbl_int64_cmp(const void *name1, size_t namesize1,
+                              const void *name2, size_t namesize2);
 extern bool qtreetbl_debug(qtreetbl_t *tbl, FILE *out);
 extern int qtreetbl_check(qtreetbl_t *tbl);
 
@@ -110,11 +141,15 @@ struct qtreetbl_s {
     void (*set_compare)(qtreetbl_t *tbl,
         int (*cmp)(const void *name1, size_t namesize1, const void *name2,
         size_t namesize2));
+    bool (*set_arena)(qtreetbl_t *tbl, qarena_t *arena);
     bool (*put)(qtreetbl_t *tbl, const char *name, const void *data, size_t size);
     bool (*putstr)(qtreetbl_t *tbl, const char *name, const char *str);
     bool (*putstrf)(qtreetbl_t *tbl, const char *name, const char *format, ...);
     bool (*putobj)(qtreetbl_t *tbl, const void *name, size_t namesize,
                    const void *data, size_t datasize);
+    bool (*bulkload)(qtreetbl_t *tbl,
+                     bool (*iter)(void *userdata, qtreetbl_obj_t *obj),
+                     void *userdata);
 
     void *(*get)(qtreetbl_t *tbl, const char *name, size_t *datasize,
     bool newmem);
@@ -131,12 +166,28 @@ struct qtreetbl_s {
     void *(*find_max)(qtreetbl_t *tbl, size_t *namesize);
     qtreetbl_obj_t (*find_nearest)(qtreetbl_t *tbl, const void *name,
                                    size_t namesize, bool newmem);
+    qtreetbl_obj_t (*select)(qtreetbl_t *tbl, size_t k, bool newmem);
+    size_t (*rank)(qtreetbl_t *tbl, const void *name, size_t namesize);
+
+    bool (*cursor_seek)(qtreetbl_t *tbl, qtreetbl_cursor_t *cursor,
+                        const void *lo, size_t losize,
+                        const void *hi, size_t hisize);
+    bool (*cursor_next)(qtreetbl_t *tbl, qtreetbl_cursor_t *cursor,
+                        qtreetbl_obj_t *obj, bool newmem);
+    size_t (*range)(qtreetbl_t *tbl, const void *lo, size_t losize,
+                    const void *hi, size_t hisize,
+                    bool (*cb)(const qtreetbl_obj_t *obj, void *userdata),
+                    void *userdata);
 
     size_t (*size)(qtreetbl_t *tbl);
     void (*clear)(qtreetbl_t *tbl);
     bool (*debug)(qtreetbl_t *tbl, FILE *out);
 
+    bool (*dump)(qtreetbl_t *tbl, const char *filepath, bool checksum);
+    ssize_t (*restore)(qtreetbl_t *tbl, const char *filepath);
+
     void (*lock)(qtreetbl_t *tbl);
+    void (*rdlock)(qtreetbl_t *tbl);
     void (*unlock)(qtreetbl_t *tbl);
 
     void (*free)(qtreetbl_t *tbl);
@@ -147,9 +198,15 @@ struct qtreetbl_s {
 
     /* private variables - do not access directly */
     void *qmutex;           /*!< initialized when QTREETBL_THREADSAFE is given */
+    void *qrwlock;          /*!< initialized when QTREETBL_RWLOCK is given */
     qtreetbl_obj_t *root;   /*!< root node */
     size_t num;             /*!< number of objects */
     uint8_t tid;            /*!< travel id sequencer */
+    qarena_t *arena;        /*!< arena allocator of the objects, NULL for the heap */
+    bool bptree;            /*!< true when QTREETBL_BPTREE is given */
+    void *broot;            /*!< B+tree root node */
+    int keytype;            /*!< QTREETBL_KEY_* mode, 0 for the comparator */
+    size_t keysize;         /*!< key size of the key mode, 0 for any */
 };
 
 /**
@@ -164,11 +221,30 @@ struct qtreetbl_obj_s {
     bool red;               /*!< true if upper link is red */
     qtreetbl_obj_t *left;   /*!< left node */
     qtreetbl_obj_t *right;  /*!< right node */
+    size_t count;           /*!< number of objects in this subtree */
 
     qtreetbl_obj_t *next;   /*!< temporary use for tree traversal */
     uint8_t tid;            /*!< temporary use for tree traversal */
 };
 
+/**
+ * maximum depth of the tree, a red-black tree is at most 2*log2(n) deep.
+ */
+#define QTREETBL_MAX_DEPTH  (sizeof(size_t) * 8 * 2)
+
+/**
+ * qtreetbl range cursor, see qtreetbl_cursor_seek()
+ */
+struct qtreetbl_cursor_s {
+    /* private variables - do not access directly */
+    qtreetbl_obj_t *stack[QTREETBL_MAX_DEPTH]; /*!< ancestors yet to visit */
+    int depth;              /*!< number of objects in the stack */
+    const void *hi;         /*!< upper bound, NULL for no bound */
+    size_t hisize;          /*!< upper bound size */
+    void *leaf;             /*!< current B+tree leaf */
+    int slot;               /*!< current object in the leaf */
+};
+
 #ifdef __cplusplus
 }
 #endif
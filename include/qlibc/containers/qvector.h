@@ -42,6 +42,8 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
+#include "qarena.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -50,13 +52,15 @@ extern "C" {
 /* types */
 typedef struct qvector_s qvector_t;
 typedef struct qvector_obj_s qvector_obj_t;
+struct qthreadpool_s;   /* qthreadpool_t of utilities/qthreadpool.h */
 
 /* public functions */
 enum {
     QVECTOR_THREADSAFE = (0x01),  /*!< make it thread-safe */
     QVECTOR_RESIZE_DOUBLE = (0x02), /*!< double the size when vector is full*/
     QVECTOR_RESIZE_LINEAR = (0x04), /*!< add the size with initial num when vector is full*/
-    QVECTOR_RESIZE_EXACT = (0x08) /*!< add up as much as needed*/
+    QVECTOR_RESIZE_EXACT = (0x08), /*!< add up as much as needed*/
+    QVECTOR_CIRCULAR = (0x10) /*!< ring buffer layout, O(1) at both ends*/
 };
 
 extern qvector_t *qvector(size_t max, size_t objsize, int options);
@@ -64,6 +68,7 @@ extern qvector_t *qvector(size_t max, size_t objsize, int options);
 extern bool qvector_addfirst(qvector_t *vector, const void *data);
 extern bool qvector_addlast(qvector_t *vector, const void *data);
 extern bool qvector_addat(qvector_t *vector, int index, const void *data);
+extern bool qvector_addarray(qvector_t *vector, const void *data, size_t n);
 
 extern void *qvector_getfirst(qvector_t *vector, bool newmem);
 extern void *qvector_getlast(qvector_t *vector, bool newmem);
@@ -83,8 +88,11 @@ extern bool qvector_removeat(qvector_t *vector, int index);
 
 extern size_t qvector_size(qvector_t *vector);
 extern bool qvector_resize(qvector_t *vector, size_t newmax);
+extern bool qvector_reserve(qvector_t *vector, size_t n);
+extern bool qvector_set_arena(qvector_t *vector, qarena_t *arena);
 
 extern void *qvector_toarray(qvector_t *vector, size_t *size);
+extern void *qvector_data(qvector_t *vector, size_t *num);
 
 extern void qvector_lock(qvector_t *vector);
 extern void qvector_unlock(qvector_t *vector);
@@ -94,8 +102,45 @@ extern bool qvector_debug(qvector_t *vector, FILE *out);
 extern void qvector_free(qvector_t *vector);
 
 extern void qvector_reverse(qvector_t *vector);
+extern void qvector_sort(qvector_t *vector,
+                         int (*cmp)(const void *data1, const void *data2));
+extern int qvector_bsearch(qvector_t *vector, const void *key,
+                           int (*cmp)(const void *data1, const void *data2));
 extern bool qvector_getnext(qvector_t *vector, qvector_obj_t *obj, bool newmem);
 
+extern bool qvector_parallel_foreach(qvector_t *vector,
+                                     struct qthreadpool_s *pool,
+                                     void (*func)(void *data, size_t index,
+                                                  void *userdata),
+                                     void *userdata);
+extern bool qvector_parallel_sort(qvector_t *vector,
+                                  struct qthreadpool_s *pool,
+                                  int (*cmp)(const void *data1,
+                                             const void *data2));
+
+/**
+ * Direct element access in the buffer returned by qvector_data(), without
+ * function call, locking and bound checking. The element size is known at
+ * compile time, so loops over ints or small structs compile down to plain
+ * array indexing.
+ *
+ * @code
+ *  vector->lock(vector);
+ *  size_t i, num;
+ *  int *data = qvector_data(vector, &num);
+ *  for (i = 0; i < num; i++) sum += data[i];
+ *  // or in place of each element
+ *  for (i = 0; i < num; i++) sum += QVECTOR_AT(vector, int, i);
+ *  vector->unlock(vector);
+ * @endcode
+ *
+ * @note
+ *  Valid only while the buffer is contiguous, which is always the case
+ *  unless QVECTOR_CIRCULAR is given. For a circular vector, call
+ *  qvector_data() first and use it before the next modification.
+ */
+#define QVECTOR_AT(vector, type, index) (((type *)(vector)->data)[(index)])
+
 /**
  * qvector container object
  */
@@ -105,6 +150,7 @@ struct qvector_s {
     bool (*addfirst)(qvector_t *vector, const void *object);
     bool (*addlast)(qvector_t *vector, const void *data);
     bool (*addat)(qvector_t *vector, int index, const void *data);
+    bool (*addarray)(qvector_t *vector, const void *data, size_t n);
 
     void *(*getfirst)(qvector_t *vector, bool newmem);
     void *(*getlast)(qvector_t *vector, bool newmem);
@@ -124,6 +170,8 @@ struct qvector_s {
 
     size_t (*size)(qvector_t *vector);
     bool   (*resize)(qvector_t *vector, size_t newmax);
+    bool   (*reserve)(qvector_t *vector, size_t n);
+    bool   (*set_arena)(qvector_t *vector, qarena_t *arena);
 
     void *(*toarray)(qvector_t *vector, size_t *size);
 
@@ -135,6 +183,10 @@ struct qvector_s {
     void (*free)(qvector_t *vector);
 
     void (*reverse)(qvector_t *vector);
+    void (*sort)(qvector_t *vector,
+                 int (*cmp)(const void *data1, const void *data2));
+    int (*bsearch)(qvector_t *vector, const void *key,
+                   int (*cmp)(const void *data1, const void *data2));
     bool (*getnext)(qvector_t *vector, qvector_obj_t *obj, bool newmem);
 
     /* private variables - do not access directly */
@@ -145,6 +197,8 @@ struct qvector_s {
     size_t max; /*allocated number of elements*/
     int options;
     size_t initnum;
+    size_t head; /*position of the first element, always 0 unless circular*/
+    qarena_t *arena; /*arena allocator of the buffer, NULL for the heap*/
 };
 
 struct qvector_obj_s { 
@@ -184,6 +184,8 @@ struct qaconf_s {
     /* private variables - do not access directly */
     int numoptions;             /*!< a number of user defined options */
     qaconf_option_t *options;   /*!< option data */
+    int *optindex;              /*!< hash index of option names */
+    int optindexsize;           /*!< number of index slots */
 
     qaconf_cb_t *defcb;         /*!< default callback for unregistered option */
     void *userdata;             /*!< userdata */
@@ -0,0 +1,92 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/**
+ * Hot swappable configuration handle.
+ *
+ * This is a qLibc extension implementing a versioned configuration handle
+ * which readers can use without locking while it's reloaded.
+ *
+ * @file qconfhandle.h
+ */
+
+#ifndef QCONFHANDLE_H
+#define QCONFHANDLE_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* types */
+typedef struct qconfhandle_s qconfhandle_t;
+typedef struct qconfhandle_data_s qconfhandle_data_t;
+typedef void (qconfhandle_free_cb_t) (void *config);
+
+/* public functions */
+extern qconfhandle_t *qconfhandle(qconfhandle_free_cb_t *freefunc);
+
+extern uint64_t qconfhandle_publish(qconfhandle_t *handle, void *config);
+extern uint64_t qconfhandle_reload(qconfhandle_t *handle, const char *filepath,
+                                   char sepchar);
+
+extern void *qconfhandle_read_enter(qconfhandle_t *handle);
+extern void qconfhandle_read_leave(qconfhandle_t *handle);
+
+extern uint64_t qconfhandle_version(qconfhandle_t *handle);
+extern size_t qconfhandle_reclaim(qconfhandle_t *handle);
+extern void qconfhandle_free(qconfhandle_t *handle);
+
+/**
+ * qconfhandle container object
+ */
+struct qconfhandle_s {
+    /* encapsulated member functions */
+    uint64_t (*publish) (qconfhandle_t *handle, void *config);
+    uint64_t (*reload) (qconfhandle_t *handle, const char *filepath,
+                        char sepchar);
+
+    void *(*read_enter) (qconfhandle_t *handle);
+    void (*read_leave) (qconfhandle_t *handle);
+
+    uint64_t (*version) (qconfhandle_t *handle);
+    size_t (*reclaim) (qconfhandle_t *handle);
+    void (*free) (qconfhandle_t *handle);
+
+    /* private variables - do not access directly */
+    qconfhandle_data_t *data;
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* QCONFHANDLE_H */
@@ -49,6 +49,7 @@ extern "C" {
 /* public functions */
 extern qlisttbl_t *qconfig_parse_file(qlisttbl_t *tbl, const char *filepath, char sepchar);
 extern qlisttbl_t *qconfig_parse_str(qlisttbl_t *tbl, const char *str, char sepchar);
+extern bool qconfig_set_cache(bool enable);
 
 #ifdef __cplusplus
 }
@@ -47,18 +47,34 @@ extern "C" {
 #endif
 
 /* database header files should be included before this header file. */
-#ifdef _mysql_h
+#if defined(_mysql_h) || defined(MYSQL_H)  /* MYSQL_H since MySQL 8.0 */
 #define Q_ENABLE_MYSQL  (1)
 #endif /* _mysql_h */
 
+/* tunable knobs */
+#define QDBPOOL_PING_INTERVAL   (30)   /*!< idle seconds to ping before use */
+#define QDBPOOL_IDLE_TIMEOUT    (300)  /*!< idle seconds to close above min */
+
 /* types */
 typedef struct qdbresult_s qdbresult_t;
+typedef struct qdbstmt_s qdbstmt_t;
 typedef struct qdb_s qdb_t;
+typedef struct qdbpool_s qdbpool_t;
+
+/* callbacks of asynchronous execution */
+typedef void (*qdbpool_query_cb_t) (qdb_t *db, qdbresult_t *result,
+                                    void *userdata);
+typedef void (*qdbpool_update_cb_t) (qdb_t *db, int affected,
+                                     void *userdata);
 
 /* public functions */
 extern qdb_t *qdb(const char *dbtype,
-                  const char *addr, int port, const char *database,
-                  const char *username, const char *password, bool autocommit);
+                  const char *addr, int port, const char *username,
+                  const char *password, const char *database, bool autocommit);
+extern qdbpool_t *qdbpool(const char *dbtype,
+                          const char *addr, int port, const char *username,
+                          const char *password, const char *database,
+                          bool autocommit, int minconns, int maxconns);
 
 /**
  * qdbresult object structure
@@ -74,6 +90,11 @@ struct qdbresult_s {
     int (*get_cols) (qdbresult_t *result);
     int (*get_rows) (qdbresult_t *result);
     int (*get_row) (qdbresult_t *result);
+    int (*get_col_idx) (qdbresult_t *result, const char *field);
+
+    int (*getbatch) (qdbresult_t *result, int maxrows);
+    const char **(*get_batch_col) (qdbresult_t *result, int idx,
+                                   const unsigned long **lengths);
 
     void (*free) (qdbresult_t *result);
 
@@ -85,6 +106,38 @@ struct qdbresult_s {
     MYSQL_ROW  row;
     int cols;
     int cursor;
+    MYSQL_STMT  *stmt;
+    MYSQL_BIND  *binds;
+    void *columns;
+    int *colmap;
+    int colmapsize;
+    void *batch;
+#endif
+};
+
+/**
+ * qdbstmt object structure
+ */
+struct qdbstmt_s {
+    /* encapsulated member functions */
+    bool (*bind_str) (qdbstmt_t *stmt, int idx, const char *str);
+    bool (*bind_int) (qdbstmt_t *stmt, int idx, int64_t num);
+    bool (*bind_null) (qdbstmt_t *stmt, int idx);
+
+    int (*execute_update) (qdbstmt_t *stmt);
+    qdbresult_t *(*execute_query) (qdbstmt_t *stmt);
+
+    void (*free) (qdbstmt_t *stmt);
+
+    /* private variables - do not access directly */
+    qdb_t *db;
+    int nparams;
+
+#ifdef Q_ENABLE_MYSQL
+    /* private variables for mysql database - do not access directly */
+    MYSQL_STMT  *stmt;
+    MYSQL_BIND  *params;
+    void *values;
 #endif
 };
 
@@ -96,10 +149,13 @@ struct qdb_s {
 
     int (*execute_update) (qdb_t *db, const char *query);
     int (*execute_updatef) (qdb_t *db, const char *format, ...);
+    int (*execute_batch) (qdb_t *db, const char *queries[], int num);
 
     qdbresult_t *(*execute_query) (qdb_t *db, const char *query);
     qdbresult_t *(*execute_queryf) (qdb_t *db, const char *format, ...);
 
+    qdbstmt_t *(*prepare) (qdb_t *db, const char *query);
+
     bool (*begin_tran) (qdb_t *db);
     bool (*end_tran) (qdb_t *db, bool commit);
     bool (*commit) (qdb_t *db);
@@ -133,6 +189,30 @@ struct qdb_s {
 #endif
 };
 
+/* qdbpool object structure */
+struct qdbpool_s {
+    /* encapsulated member functions */
+    qdb_t *(*get) (qdbpool_t *pool, int timeoutms);
+    bool (*release) (qdbpool_t *pool, qdb_t *db);
+    int (*size) (qdbpool_t *pool);
+
+    bool (*submit_query) (qdbpool_t *pool, const char *query,
+                          qdbpool_query_cb_t cb, void *userdata);
+    bool (*submit_update) (qdbpool_t *pool, const char *query,
+                           qdbpool_update_cb_t cb, void *userdata);
+    bool (*drain) (qdbpool_t *pool, int timeoutms);
+
+    void (*free) (qdbpool_t *pool);
+
+    /* private variables - do not access directly */
+    void *qwait;      /*!< mutex, condition variables and async workers */
+    qdb_t *conf;      /*!< connection information, never opened */
+    struct qdbpool_conn_s *conns;
+    int minconns;
+    int maxconns;
+    int numconns;
+};
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,119 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************/
+
+/**
+ * Event loop.
+ *
+ * This is a qLibc extension implementing an event loop driving many
+ * descriptors and timers from a single thread.
+ *
+ * @file qevloop.h
+ */
+
+#ifndef QEVLOOP_H
+#define QEVLOOP_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "../utilities/qio.h"
+#include "../containers/qtimerwheel.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* types */
+typedef struct qevloop_s qevloop_t;
+
+typedef void (*qevloop_cb_t) (qevloop_t *loop, int fd, int events,
+                              void *userdata);
+typedef void (*qevloop_timer_cb_t) (qevloop_t *loop, int timerid,
+                                    void *userdata);
+
+/* constants */
+#define QEVLOOP_READ    (0x01)
+#define QEVLOOP_WRITE   (0x01 << 1)
+#define QEVLOOP_ERROR   (0x01 << 2)  /*!< error or hang-up, given only */
+
+/* tunable knobs */
+#define QEVLOOP_MAXEVENTS   (256)  /*!< default events taken at once */
+
+/* public functions */
+extern qevloop_t *qevloop(int maxevents);
+
+/**
+ * qevloop structure
+ */
+struct qevloop_s {
+    /* encapsulated member functions */
+    bool (*add) (qevloop_t *loop, int fd, int events, qevloop_cb_t cb,
+                 void *userdata);
+    bool (*modify) (qevloop_t *loop, int fd, int events);
+    bool (*remove) (qevloop_t *loop, int fd);
+    bool (*setreader) (qevloop_t *loop, int fd, qio_reader_t *reader);
+
+    int (*addtimer) (qevloop_t *loop, int intervalms, bool repeat,
+                     qevloop_timer_cb_t cb, void *userdata);
+    bool (*removetimer) (qevloop_t *loop, int timerid);
+    bool (*setwheel) (qevloop_t *loop, qtimerwheel_t *wheel);
+
+    int (*once) (qevloop_t *loop, int timeoutms);
+    bool (*run) (qevloop_t *loop);
+    bool (*stop) (qevloop_t *loop);
+
+    void (*free) (qevloop_t *loop);
+
+    /* private variables - do not access directly */
+    int pollfd;         /*!< epoll or kqueue descriptor */
+    int wakeupfd[2];    /*!< pipe to wake up the loop */
+    void *events;       /*!< buffer of the backend events */
+    int maxevents;
+
+    void *handlers;     /*!< handlers indexed by descriptor */
+    int numhandlers;    /*!< size of the handler table */
+
+    void *timers;       /*!< timer heap ordered by expiry */
+    int numtimers;
+    int maxtimers;
+    int lasttimerid;
+
+    qtimerwheel_t *wheel;   /*!< timer wheel expired by the loop */
+
+    int *ready;         /*!< descriptors having buffered data */
+    int numready;
+    int maxready;
+
+    bool stopped;
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* QEVLOOP_H */
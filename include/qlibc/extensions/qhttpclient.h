@@ -41,6 +41,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <netinet/in.h>
+#include "qevloop.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -48,12 +49,18 @@ extern "C" {
 
 /* types */
 typedef struct qhttpclient_s  qhttpclient_t;
+typedef struct qhttpclient_pool_s  qhttpclient_pool_t;
+
+typedef void (*qhttpclient_cb_t) (qhttpclient_t *client, int rescode,
+                                  qlisttbl_t *resheaders, void *body,
+                                  size_t bodysize, void *userdata);
 
 /* constants */
 #define QHTTPCLIENT_NAME "qLibc"
 
 /* public functions */
 extern qhttpclient_t *qhttpclient(const char *hostname, int port);
+extern qhttpclient_pool_t *qhttpclient_pool(int maxperhost, int idlesec);
 
 /**
  * qhttpclient object structure
@@ -64,6 +71,7 @@ struct qhttpclient_s {
     void (*settimeout) (qhttpclient_t *client, int timeoutms);
     void (*setkeepalive) (qhttpclient_t *client, bool keepalive);
     void (*setuseragent) (qhttpclient_t *client, const char *useragent);
+    bool (*setdecoding) (qhttpclient_t *client, bool decoding);
 
     bool (*open) (qhttpclient_t *client);
 
@@ -89,6 +97,21 @@ struct qhttpclient_s {
                          const char *uri, qlisttbl_t *reqheaders);
     int (*readresponse) (qhttpclient_t *client, qlisttbl_t *resheaders,
                          off_t *contentlength);
+    ssize_t (*readbody) (qhttpclient_t *client, const void **data);
+    bool (*stream) (qhttpclient_t *client, const char *method,
+                    const char *uri, void *data, size_t size, int *rescode,
+                    qlisttbl_t *reqheaders, qlisttbl_t *resheaders,
+                    bool (*callback) (void *userdata, const void *data,
+                                      size_t size),
+                    void *userdata);
+
+    bool (*pipeline) (qhttpclient_t *client, const char *method,
+                      const char *uri, void *data, size_t size,
+                      qlisttbl_t *reqheaders, qhttpclient_cb_t callback,
+                      void *userdata);
+    int (*dispatch) (qhttpclient_t *client, int timeoutms);
+    int (*inflight) (qhttpclient_t *client);
+    bool (*attach) (qhttpclient_t *client, qevloop_t *loop);
 
     ssize_t (*gets) (qhttpclient_t *client, char *buf, size_t bufsize);
     ssize_t (*read) (qhttpclient_t *client, void *buf, size_t nbytes);
@@ -103,6 +126,7 @@ struct qhttpclient_s {
     /* private variables - do not access directly */
     int socket;  /*!< socket descriptor */
     void *ssl;   /*!< will be used if SSL has been enabled at compile time */
+    void *reader;  /*!< buffered reader of the socket */
 
     struct sockaddr_in addr;
     char *hostname;
@@ -111,8 +135,34 @@ struct qhttpclient_s {
     int timeoutms;    /*< wait timeout milliseconds*/
     bool keepalive;   /*< keep-alive flag */
     char *useragent;  /*< user-agent name */
+    bool decoding;    /*< content decoding flag */
 
     bool connclose;   /*< response keep-alive flag for a last request */
+
+    int bodystate;    /*< where readbody() is in the response body */
+    off_t bodyremain; /*< bytes left in the body or the chunk */
+    void *bodybuf;    /*< body slice buffer for HTTPS */
+    void *decoder;    /*< decompression state of the body */
+
+    void *pool;       /*< pool host entry owning this client */
+    void *pipe;       /*< pipelined requests and response parser */
+};
+
+/**
+ * qhttpclient_pool object structure
+ */
+struct qhttpclient_pool_s {
+    /* encapsulated member functions */
+    qhttpclient_t *(*get) (qhttpclient_pool_t *pool, const char *destname,
+                           int port);
+    void (*release) (qhttpclient_pool_t *pool, qhttpclient_t *client);
+    void (*free) (qhttpclient_pool_t *pool);
+
+    /* private variables - do not access directly */
+    void *hosts;      /*!< host entries keyed by host, port and ssl */
+    void *lock;       /*!< pool mutex and condition */
+    int maxperhost;   /*!< maximum connections per host, 0 for unlimited */
+    int idlesec;      /*!< idle connection lifetime in seconds */
 };
 
 #ifdef __cplusplus
@@ -42,6 +42,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <limits.h>
+#include <time.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -53,6 +54,12 @@ typedef struct qlog_s qlog_t;
 /* constants */
 #define QLOG_OPT_THREADSAFE  (0x01)
 #define QLOG_OPT_FLUSH       (0x01 << 1)
+#define QLOG_OPT_ASYNC       (0x01 << 2)
+#define QLOG_OPT_DROP        (0x01 << 3)
+#define QLOG_OPT_DEFERRED    (0x01 << 4)
+
+/* tunable knobs */
+#define QLOG_ASYNC_BUFSIZE   (256 * 1024)  /*!< buffer size of the async mode */
 
 /* public functions */
 extern qlog_t *qlog(const char *filepathfmt, mode_t mode, int rotateinterval, int options);
@@ -66,10 +73,14 @@ struct qlog_s {
     bool (*writef) (qlog_t *log, const char *format, ...);
     bool (*duplicate) (qlog_t *log, FILE *outfp, bool flush);
     bool (*flush) (qlog_t *log);
+    bool (*timestamp) (qlog_t *log, const char *format);
+    bool (*compress) (qlog_t *log, int level);
     void (*free) (qlog_t *log);
 
     /* private variables - do not access directly */
     void *qmutex;  /*!< activated if compiled with --enable-threadsafe */
+    void *async;   /*!< background writer, QLOG_OPT_ASYNC only */
+    void *gz;      /*!< compressor of rotated files, see compress() */
 
     char filepathfmt[PATH_MAX]; /*!< file file naming format like
                                      /somepath/daily-%Y%m%d.log */
@@ -80,6 +91,10 @@ struct qlog_s {
     int nextrotate;  /*!< next rotate universal time, seconds */
     bool logflush;   /*!< flag for immediate flushing */
 
+    char tsformat[64];  /*!< strftime() format of the timestamp prefix */
+    char tsprefix[64];  /*!< timestamp prefix rendered at tstime */
+    time_t tstime;      /*!< time of the rendered prefix */
+
     FILE *outfp;    /*!< stream pointer for duplication */
     bool outflush;  /*!< flag for immediate flushing for duplicated stream */
 };
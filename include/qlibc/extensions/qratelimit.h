@@ -0,0 +1,102 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+
+/**
+ * Keyed rate limiter.
+ *
+ * This is a qLibc extension implementing per-key token buckets, for limiting
+ * millions of clients by IP address or API key with bounded memory.
+ *
+ * @file qratelimit.h
+ */
+
+#ifndef QRATELIMIT_H
+#define QRATELIMIT_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* types */
+typedef struct qratelimit_s qratelimit_t;
+typedef struct qratelimit_data_s qratelimit_data_t;
+
+/* public functions */
+extern size_t qratelimit_calculate_memsize(size_t maxkeys);
+extern qratelimit_t *qratelimit(void *memory, size_t memsize, int max_tokens,
+                                int tokens_per_sec);
+
+extern bool qratelimit_set_global(qratelimit_t *limiter, int max_tokens,
+                                  int tokens_per_sec);
+
+extern bool qratelimit_consume(qratelimit_t *limiter, const char *key,
+                               int tokens);
+extern bool qratelimit_consume_by_obj(qratelimit_t *limiter, const void *key,
+                                      size_t keysize, int tokens);
+extern long qratelimit_waittime(qratelimit_t *limiter, const char *key,
+                                int tokens);
+extern long qratelimit_waittime_by_obj(qratelimit_t *limiter, const void *key,
+                                       size_t keysize, int tokens);
+
+extern size_t qratelimit_size(qratelimit_t *limiter);
+extern void qratelimit_clear(qratelimit_t *limiter);
+extern void qratelimit_free(qratelimit_t *limiter);
+
+/**
+ * qratelimit container object
+ */
+struct qratelimit_s {
+    /* encapsulated member functions */
+    bool (*set_global) (qratelimit_t *limiter, int max_tokens,
+                        int tokens_per_sec);
+
+    bool (*consume) (qratelimit_t *limiter, const char *key, int tokens);
+    bool (*consume_by_obj) (qratelimit_t *limiter, const void *key,
+                            size_t keysize, int tokens);
+    long (*waittime) (qratelimit_t *limiter, const char *key, int tokens);
+    long (*waittime_by_obj) (qratelimit_t *limiter, const void *key,
+                             size_t keysize, int tokens);
+
+    size_t (*size) (qratelimit_t *limiter);
+    void (*clear) (qratelimit_t *limiter);
+    void (*free) (qratelimit_t *limiter);
+
+    /* private variables - do not access directly */
+    qratelimit_data_t *data;
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* QRATELIMIT_H */
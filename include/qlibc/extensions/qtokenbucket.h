@@ -39,6 +39,7 @@
 #define QTOKENBUCKET_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -46,6 +47,7 @@ extern "C" {
 
 /* types */
 typedef struct qtokenbucket_s qtokenbucket_t;
+typedef struct qtokenbucket_atomic_s qtokenbucket_atomic_t;
 
 /* public functions */
 extern void qtokenbucket_init(qtokenbucket_t *bucket, int init_tokens,
@@ -53,6 +55,14 @@ extern void qtokenbucket_init(qtokenbucket_t *bucket, int init_tokens,
 extern bool qtokenbucket_consume(qtokenbucket_t *bucket, int tokens);
 extern long qtokenbucket_waittime(qtokenbucket_t *bucket, int tokens);
 
+extern void qtokenbucket_atomic_init(qtokenbucket_atomic_t *bucket,
+                                     int init_tokens, int max_tokens,
+                                     int tokens_per_sec);
+extern bool qtokenbucket_atomic_consume(qtokenbucket_atomic_t *bucket,
+                                        int tokens);
+extern long qtokenbucket_atomic_waittime(qtokenbucket_atomic_t *bucket,
+                                         int tokens);
+
 /**
  * qtokenbucket internal data structure
  */
@@ -63,6 +73,17 @@ struct qtokenbucket_s {
     long last_fill; /*!< last refill time in Millisecond. */
 };
 
+/**
+ * thread-safe qtokenbucket internal data structure
+ */
+struct qtokenbucket_atomic_s {
+    int64_t empty_at; /*!< monotonic time in nanosecond when the bucket
+                           would have been empty. */
+    int64_t burst_ns; /*!< nanoseconds to fill up an empty bucket. */
+    int max_tokens; /*!< maximum number of tokens. */
+    int tokens_per_sec; /*!< fill rate per second. */
+};
+
 #ifdef __cplusplus
 }
 #endif
@@ -35,16 +35,31 @@
 #ifndef QSHM_H
 #define QSHM_H
 
+#include <stdlib.h>
+#include <stdbool.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* qshm_open() and qshm_map() options */
+enum {
+    QSHM_RECREATE = (0x01),   /*!< remove the existing object first */
+    QSHM_HUGEPAGE = (0x02),   /*!< back the memory with huge pages */
+    QSHM_INTERLEAVE = (0x04)  /*!< interleave the pages over the NUMA nodes */
+};
+
 extern int qshm_init(const char *keyfile, int keyid, size_t size,
                      bool recreate);
 extern int qshm_getid(const char *keyfile, int keyid);
 extern void *qshm_get(int shmid);
 extern bool qshm_free(int shmid);
 
+extern int qshm_open(const char *name, size_t size, int options);
+extern void *qshm_map(int fd, size_t *size, int options);
+extern bool qshm_unmap(void *mem, size_t size);
+extern bool qshm_unlink(const char *name);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,78 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/**
+ * qshmlock header file.
+ *
+ * @file qshmlock.h
+ */
+
+#ifndef QSHMLOCK_H
+#define QSHMLOCK_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* types */
+typedef struct qshmlock_s qshmlock_t;
+
+extern qshmlock_t *qshmlock_init(const char *keyfile, int keyid, int nlocks,
+                                 bool recreate);
+extern qshmlock_t *qshmlock_attach(const char *keyfile, int keyid);
+
+extern bool qshmlock_enter(qshmlock_t *lock, int lockno);
+extern bool qshmlock_enter_nowait(qshmlock_t *lock, int lockno);
+extern bool qshmlock_enter_timed(qshmlock_t *lock, int lockno, int maxwaitms);
+extern bool qshmlock_leave(qshmlock_t *lock, int lockno);
+
+extern bool qshmlock_read_enter(qshmlock_t *lock, int lockno);
+extern bool qshmlock_read_leave(qshmlock_t *lock, int lockno);
+extern bool qshmlock_write_enter(qshmlock_t *lock, int lockno);
+extern bool qshmlock_write_leave(qshmlock_t *lock, int lockno);
+
+extern void qshmlock_detach(qshmlock_t *lock);
+extern bool qshmlock_free(qshmlock_t *lock);
+
+/**
+ * qshmlock structure
+ */
+struct qshmlock_s {
+    /* private variables - do not access directly */
+    int shmid;          /*!< shared memory identifier */
+    int nlocks;         /*!< number of locks in the segment */
+    void *shared;       /*!< attached segment */
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* QSHMLOCK_H */
@@ -39,12 +39,23 @@
 #include "containers/qtreetbl.h"
 #include "containers/qhashtbl.h"
 #include "containers/qhasharr.h"
+#include "containers/qshmring.h"
+#include "containers/qtimerwheel.h"
+#include "containers/qpqueue.h"
+#include "containers/qbloom.h"
+#include "containers/qcuckoo.h"
+#include "containers/qhll.h"
+#include "containers/qskiplist.h"
 #include "containers/qlisttbl.h"
 #include "containers/qlist.h"
 #include "containers/qvector.h"
 #include "containers/qqueue.h"
 #include "containers/qstack.h"
 #include "containers/qgrow.h"
+#include "containers/qarena.h"
+#include "containers/qstrpool.h"
+#include "containers/qdeque.h"
+#include "containers/qstats.h"
 
 /* utilities */
 #include "utilities/qcount.h"
@@ -52,14 +63,18 @@
 #include "utilities/qfile.h"
 #include "utilities/qhash.h"
 #include "utilities/qio.h"
+#include "utilities/qiouring.h"
 #include "utilities/qsocket.h"
 #include "utilities/qstring.h"
 #include "utilities/qsystem.h"
 #include "utilities/qtime.h"
+#include "utilities/qthreadpool.h"
+#include "utilities/qtrace.h"
 
 /* ipc */
 #include "ipc/qsem.h"
 #include "ipc/qshm.h"
+#include "ipc/qshmlock.h"
 
 #endif /* QLIBC_H */
 
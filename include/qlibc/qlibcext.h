@@ -36,10 +36,13 @@
 #define QLIBCEXT_H
 
 #include "extensions/qconfig.h"
+#include "extensions/qconfhandle.h"
 #include "extensions/qaconf.h"
 #include "extensions/qlog.h"
 #include "extensions/qhttpclient.h"
 #include "extensions/qdatabase.h"
 #include "extensions/qtokenbucket.h"
+#include "extensions/qratelimit.h"
+#include "extensions/qevloop.h"
 
 #endif /* QLIBCEXT_H */
@@ -43,10 +43,32 @@
 extern "C" {
 #endif
 
+/* types */
+typedef struct qcount_shm_s qcount_shm_t;
+
 extern int64_t qcount_read(const char *filepath);
 extern bool qcount_save(const char *filepath, int64_t number);
 extern int64_t qcount_update(const char *filepath, int64_t number);
 
+extern qcount_shm_t *qcount_shm(const char *filepath, const char *keyfile,
+                                int keyid, int interval, int64_t batch);
+extern int64_t qcount_shm_update(qcount_shm_t *counter, int64_t number);
+extern int64_t qcount_shm_read(qcount_shm_t *counter);
+extern bool qcount_shm_flush(qcount_shm_t *counter);
+extern void qcount_shm_free(qcount_shm_t *counter, bool destroy);
+
+/**
+ * shared memory counter structure
+ */
+struct qcount_shm_s {
+    /* private variables - do not access directly */
+    char *filepath;     /*!< counter file to flush into */
+    int shmid;          /*!< shared memory identifier */
+    void *shared;       /*!< attached counter state */
+    int interval;       /*!< seconds between flushes */
+    int64_t batch;      /*!< updates between flushes */
+};
+
 #ifdef __cplusplus
 }
 #endif
@@ -37,21 +37,82 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <sys/types.h>
 #include "../containers/qlisttbl.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* types */
+typedef struct qquery_s qquery_t;
+typedef struct qcodec_s qcodec_t;
+
+/* qcodec_init() types */
+enum {
+    QCODEC_BASE64_ENCODE = 0,   /*!< binary to BASE64 */
+    QCODEC_BASE64_DECODE,       /*!< BASE64 to binary */
+    QCODEC_HEX_ENCODE,          /*!< binary to Hexadecimal */
+    QCODEC_HEX_DECODE,          /*!< Hexadecimal to binary */
+    QCODEC_URL_ENCODE,          /*!< binary to URL encoded */
+    QCODEC_URL_DECODE           /*!< URL encoded to binary */
+};
+
 extern qlisttbl_t *qparse_queries(qlisttbl_t *tbl, const char *query,
                                   char equalchar, char sepchar, int *count);
+extern bool qquery_getnext(const char *query, size_t len, char equalchar,
+                           char sepchar, qquery_t *obj);
 extern char *qurl_encode(const void *bin, size_t size);
 extern size_t qurl_decode(char *str);
+extern ssize_t qurl_decode_into(char *dst, size_t dstsize, const char *src,
+                                size_t len);
 extern char *qbase64_encode(const void *bin, size_t size);
 extern size_t qbase64_decode(char *str);
 extern char *qhex_encode(const void *bin, size_t size);
 extern size_t qhex_decode(char *str);
 
+extern size_t qbase64_encode_len(size_t size);
+extern size_t qbase64_decode_len(size_t len);
+extern ssize_t qbase64_encode_into(char *dst, size_t dstsize, const void *src,
+                                   size_t size);
+extern ssize_t qbase64_decode_into(void *dst, size_t dstsize, const char *src,
+                                   size_t len);
+extern ssize_t qhex_encode_into(char *dst, size_t dstsize, const void *src,
+                                size_t size);
+extern ssize_t qhex_decode_into(void *dst, size_t dstsize, const char *src,
+                                size_t len);
+
+extern bool qcodec_init(qcodec_t *codec, int type);
+extern size_t qcodec_bound(const qcodec_t *codec, size_t size);
+extern ssize_t qcodec_update(qcodec_t *codec, void *dst, size_t dstsize,
+                             const void *src, size_t size);
+extern ssize_t qcodec_final(qcodec_t *codec, void *dst, size_t dstsize);
+
+/**
+ * qquery_t a name and value pair of query string by qquery_getnext()
+ */
+struct qquery_s {
+    const char *name;   /*!< name, not decoded nor terminated */
+    size_t namesize;    /*!< name length */
+    const char *value;  /*!< value, not decoded nor terminated */
+    size_t valuesize;   /*!< value length */
+
+    /* private variables - do not access directly */
+    size_t next;        /*!< offset of the next pair */
+};
+
+/**
+ * qcodec_t streaming codec state by qcodec_init()
+ */
+struct qcodec_s {
+    /* private variables - do not access directly */
+    int type;
+    unsigned char pending[3];   /*!< input carried over to the next call */
+    size_t npending;
+    int idx;                    /*!< BASE64 position in a quad */
+    unsigned char last;         /*!< BASE64 last value */
+};
+
 #ifdef __cplusplus
 }
 #endif
@@ -43,13 +43,24 @@
 extern "C" {
 #endif
 
+/* qfile_map() access hints */
+enum {
+    QFILE_MAP_SEQUENTIAL = (0x01),  /*!< read ahead aggressively */
+    QFILE_MAP_WILLNEED = (0x02),    /*!< start reading in the whole mapping */
+    QFILE_MAP_HUGEPAGE = (0x04)     /*!< back the mapping with huge pages */
+};
+
 extern bool qfile_lock(int fd);
 extern bool qfile_unlock(int fd);
 extern bool qfile_exist(const char *filepath);
 extern void *qfile_load(const char *filepath, size_t *nbytes);
 extern void *qfile_read(FILE *fp, size_t *nbytes);
+extern const void *qfile_map(const char *filepath, size_t *nbytes, int hints);
+extern bool qfile_unmap(const void *map, size_t nbytes);
 extern ssize_t qfile_save(const char *filepath, const void *buf, size_t size,
                           bool append);
+extern ssize_t qfile_save_atomic(const char *filepath, const void *buf,
+                                 size_t size, bool sync);
 extern bool qfile_mkdir(const char *dirpath, mode_t mode, bool recursive);
 
 extern char *qfile_get_name(const char *filepath);
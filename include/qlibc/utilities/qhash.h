@@ -44,16 +44,61 @@
 extern "C" {
 #endif
 
+#define QHASH_MMAP_WINDOW   (64 * 1024 * 1024) /*!< bytes of a file mapped at once */
+#define QHASH_READ_BUFSIZE  (1024 * 1024)      /*!< read size if not mappable */
+
+/* types */
+typedef struct qhash_s qhash_t;
+
+/* qhash_init() types */
+enum {
+    QHASH_MD5 = 0,      /*!< 128-bit MD5 */
+    QHASH_SHA256,       /*!< 256-bit SHA-256 */
+    QHASH_CRC32C,       /*!< 32-bit CRC32C, uint32_t */
+    QHASH_FNV1_32,      /*!< 32-bit FNV1, uint32_t */
+    QHASH_FNV1_64,      /*!< 64-bit FNV1, uint64_t */
+    QHASH_MURMUR3_32,   /*!< 32-bit Murmur3, uint32_t */
+    QHASH_MURMUR3_128,  /*!< 128-bit Murmur3 */
+    QHASH_WYHASH_64     /*!< 64-bit wyhash, uint64_t */
+};
+
 extern bool qhashmd5(const void *data, size_t nbytes, void *retbuf);
 extern bool qhashmd5_file(const char *filepath, off_t offset, ssize_t nbytes,
                           void *retbuf);
 
+extern bool qhashsha256(const void *data, size_t nbytes, void *retbuf);
+
 extern uint32_t qhashfnv1_32(const void *data, size_t nbytes);
 extern uint64_t qhashfnv1_64(const void *data, size_t nbytes);
 
 extern uint32_t qhashmurmur3_32(const void *data, size_t nbytes);
+extern bool qhashmurmur3_32_multi(const void *datas[], const size_t nbytes[],
+                                  size_t num, uint32_t hashes[]);
 extern bool qhashmurmur3_128(const void *data, size_t nbytes, void *retbuf);
 
+extern uint64_t qhashwyhash_64(const void *data, size_t nbytes);
+extern uint32_t qhashwyhash_32(const void *data, size_t nbytes);
+
+extern uint32_t qhashcrc32c(const void *data, size_t nbytes);
+extern uint32_t qhashcrc32c_update(uint32_t crc, const void *data,
+                                   size_t nbytes);
+
+extern bool qhash_init(qhash_t *ctx, int type);
+extern bool qhash_update(qhash_t *ctx, const void *data, size_t nbytes);
+extern bool qhash_update_file(qhash_t *ctx, const char *filepath,
+                              off_t offset, ssize_t nbytes);
+extern size_t qhash_final(qhash_t *ctx, void *retbuf);
+extern size_t qhash_digestsize(int type);
+
+/**
+ * qhash_t streaming hash state by qhash_init()
+ */
+struct qhash_s {
+    /* private variables - do not access directly */
+    int type;
+    uint64_t ctx[16];   /*!< state of the algorithm */
+};
+
 #ifdef __cplusplus
 }
 #endif
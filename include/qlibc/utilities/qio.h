@@ -38,21 +38,55 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* types */
+typedef struct qio_reader_s qio_reader_t;
+
+/* tunable knobs */
+#define QIO_READER_BUFSIZE  (8 * 1024)  /*!< default buffer size of qio_reader */
+
 extern int qio_wait_readable(int fd, int timeoutms);
 extern int qio_wait_writable(int fd, int timeoutms);
 extern ssize_t qio_read(int fd, void *buf, size_t nbytes, int timeoutms);
 extern ssize_t qio_write(int fd, const void *data, size_t nbytes,
                          int timeoutms);
+extern ssize_t qio_writev(int fd, const struct iovec *iov, int iovcnt,
+                          int timeoutms);
 extern off_t qio_send(int outfd, int infd, off_t nbytes, int timeoutms);
 extern ssize_t qio_gets(int fd, char *buf, size_t bufsize, int timeoutms);
 extern ssize_t qio_puts(int fd, const char *str, int timeoutms);
 extern ssize_t qio_printf(int fd, int timeoutms, const char *format, ...);
 
+extern qio_reader_t *qio_reader(int fd, size_t bufsize);
+extern ssize_t qio_reader_read(qio_reader_t *reader, void *buf, size_t nbytes,
+                               int timeoutms);
+extern ssize_t qio_reader_gets(qio_reader_t *reader, char *buf,
+                               size_t bufsize, int timeoutms);
+extern ssize_t qio_reader_take(qio_reader_t *reader, const void **data,
+                               size_t maxbytes, int timeoutms);
+extern size_t qio_reader_pending(qio_reader_t *reader);
+extern ssize_t qio_reader_fill(qio_reader_t *reader, int timeoutms);
+extern bool qio_reader_hasline(qio_reader_t *reader);
+extern void qio_reader_reset(qio_reader_t *reader, int fd);
+extern void qio_reader_free(qio_reader_t *reader);
+
+/**
+ * qio_reader_t buffered reader structure
+ */
+struct qio_reader_s {
+    /* private variables - do not access directly */
+    int fd;          /*!< file descriptor */
+    char *buf;       /*!< read buffer */
+    size_t bufsize;  /*!< size of the read buffer */
+    size_t pos;      /*!< offset of the first unread byte */
+    size_t len;      /*!< bytes filled in the buffer */
+};
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,114 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************/
+
+/**
+ * qiouring header file.
+ *
+ * @file qiouring.h
+ */
+
+#ifndef QIOURING_H
+#define QIOURING_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* types */
+typedef struct qiouring_s qiouring_t;
+
+typedef void (*qiouring_cb_t) (qiouring_t *ring, int result, void *userdata);
+
+extern qiouring_t *qiouring(unsigned int entries);
+extern bool qiouring_read(qiouring_t *ring, int fd, void *buf, size_t nbytes,
+                          off_t offset, qiouring_cb_t cb, void *userdata);
+extern bool qiouring_write(qiouring_t *ring, int fd, const void *buf,
+                           size_t nbytes, off_t offset, qiouring_cb_t cb,
+                           void *userdata);
+extern bool qiouring_recv(qiouring_t *ring, int fd, void *buf, size_t nbytes,
+                          int flags, qiouring_cb_t cb, void *userdata);
+extern bool qiouring_send(qiouring_t *ring, int fd, const void *buf,
+                          size_t nbytes, int flags, qiouring_cb_t cb,
+                          void *userdata);
+extern bool qiouring_accept(qiouring_t *ring, int fd, qiouring_cb_t cb,
+                            void *userdata);
+extern bool qiouring_register_buffers(qiouring_t *ring,
+                                      const struct iovec *iov, int iovcnt);
+extern bool qiouring_read_fixed(qiouring_t *ring, int fd, void *buf,
+                                size_t nbytes, off_t offset, int bufidx,
+                                qiouring_cb_t cb, void *userdata);
+extern bool qiouring_write_fixed(qiouring_t *ring, int fd, const void *buf,
+                                 size_t nbytes, off_t offset, int bufidx,
+                                 qiouring_cb_t cb, void *userdata);
+extern int qiouring_submit(qiouring_t *ring);
+extern int qiouring_wait(qiouring_t *ring, int mincomplete);
+extern int qiouring_inflight(qiouring_t *ring);
+extern void qiouring_free(qiouring_t *ring);
+
+/**
+ * qiouring_t structure
+ */
+struct qiouring_s {
+    /* private variables - do not access directly */
+    int fd;             /*!< io_uring descriptor */
+
+    void *sqring;       /*!< mapped submission and completion queue ring */
+    size_t sqringsize;
+    void *cqring;
+    void *sqes;         /*!< mapped submission queue entries */
+    size_t sqessize;
+
+    unsigned *sqhead;
+    unsigned *sqtail;
+    unsigned *sqmask;
+    unsigned *sqarray;
+    unsigned sqentries;
+    unsigned sqlocal;   /*!< tail of the entries not submitted yet */
+
+    unsigned *cqhead;
+    unsigned *cqtail;
+    unsigned *cqmask;
+    void *cqes;
+
+    void *slots;        /*!< callbacks of the operations in flight */
+    int numslots;
+    int freeslot;       /*!< head of the free slot list */
+    int inflight;
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* QIOURING_H */
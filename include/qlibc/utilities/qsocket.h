@@ -37,18 +37,68 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <sys/socket.h>
 #include <netinet/in.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* types */
+typedef struct qsocket_dns_s qsocket_dns_t;
+
+/* tunable knobs */
+#define QSOCKET_DNS_TTL         (60)   /*!< default seconds a name is cached */
+#define QSOCKET_DNS_NEGTTL      (5)    /*!< default seconds a failure is cached */
+#define QSOCKET_DNS_CACHESIZE   (256)  /*!< slots of the resolver cache */
+#define QSOCKET_DNS_THREADS     (4)    /*!< threads of the async resolver */
+#define QSOCKET_DNS_MAXADDRS    (8)    /*!< addresses kept for a name */
+#define QSOCKET_CONNECT_DELAY   (250)  /*!< ms before racing the next address */
+
+/* qsocket_listen() options */
+#define QSOCKET_OPT_NODELAY     (0x01) /*!< TCP_NODELAY */
+#define QSOCKET_OPT_REUSEPORT   (0x02) /*!< SO_REUSEPORT */
+#define QSOCKET_OPT_FASTOPEN    (0x04) /*!< TCP_FASTOPEN */
+
 extern int qsocket_open(const char *hostname, int port, int timeoutms);
 extern bool qsocket_close(int sockfd, int timeoutms);
+extern int qsocket_listen(const char *hostname, int port, int backlog,
+                          int options);
 extern bool qsocket_get_addr(struct sockaddr_in *addr, const char *hostname,
                              int port);
 extern char *qsocket_get_localaddr(char *buf, size_t bufsize);
 
+extern bool qsocket_resolve(struct sockaddr_storage *addr, socklen_t *addrlen,
+                            const char *hostname, int port, int family);
+extern qsocket_dns_t *qsocket_resolve_async(const char *hostname, int port,
+                                            int family);
+extern int qsocket_resolve_fd(qsocket_dns_t *req);
+extern bool qsocket_resolve_result(qsocket_dns_t *req,
+                                   struct sockaddr_storage *addr,
+                                   socklen_t *addrlen);
+extern void qsocket_resolve_free(qsocket_dns_t *req);
+extern void qsocket_set_dnscache(int ttlsec, int negttlsec);
+extern void qsocket_clear_dnscache(void);
+
+/**
+ * qsocket_dns_t asynchronous name resolution structure
+ */
+struct qsocket_dns_s {
+    /* private variables - do not access directly */
+    char *hostname;
+    int port;
+    int family;
+    int pipefd[2];   /*!< readable when resolved */
+
+    bool done;
+    int error;       /*!< errno of a failure */
+    struct sockaddr_storage addr;
+    socklen_t addrlen;
+
+    int refcnt;      /*!< held by the caller and a resolver thread */
+    qsocket_dns_t *next;
+};
+
 #ifdef __cplusplus
 }
 #endif
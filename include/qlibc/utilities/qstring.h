@@ -43,6 +43,12 @@
 extern "C" {
 #endif
 
+#define QSTR_INLINESIZE     (48)    /*!< bytes a qstr_t holds without malloc */
+
+/* types */
+typedef struct qstr_s qstr_t;
+typedef struct qtoken_s qtoken_t;
+
 extern char *qstrtrim(char *str);
 extern char *qstrtrim_head(char *str);
 extern char *qstrtrim_tail(char *str);
@@ -63,6 +69,8 @@ extern char *qstrlower(char *str);
 extern char *qstrtok(char *str, const char *delimiters, char *retstop,
                      int *offset);
 extern qlist_t *qstrtokenizer(const char *str, const char *delimiters);
+extern bool qstrtok_getnext(const char *str, size_t len,
+                            const char *delimiters, qtoken_t *obj);
 extern char *qstrunique(const char *seed);
 extern char *qstr_comma_number(int number);
 extern bool qstrtest(int (*testfunc)(int), const char *str);
@@ -71,6 +79,53 @@ extern bool qstr_is_ip4addr(const char *str);
 extern char *qstr_conv_encoding(const char *fromstr, const char *fromcode,
                                 const char *tocode, float mag);
 
+extern void qstr_init(qstr_t *s);
+extern bool qstr_reserve(qstr_t *s, size_t size);
+extern bool qstr_append(qstr_t *s, const void *data, size_t size);
+extern bool qstr_appendstr(qstr_t *s, const char *str);
+extern bool qstr_appendf(qstr_t *s, const char *format, ...);
+extern bool qstr_replace(qstr_t *s, const char *tokstr, const char *word);
+extern void qstr_trim(qstr_t *s);
+extern void qstr_upper(qstr_t *s);
+extern void qstr_lower(qstr_t *s);
+extern void qstr_truncate(qstr_t *s, size_t len);
+extern size_t qstr_len(const qstr_t *s);
+extern const char *qstr_cstr(const qstr_t *s);
+extern char *qstr_detach(qstr_t *s);
+extern void qstr_free(qstr_t *s);
+
+/**
+ * qtoken_t a token of string by qstrtok_getnext()
+ */
+struct qtoken_s {
+    const char *token;  /*!< token, not terminated */
+    size_t tokensize;   /*!< token length */
+    char stop;          /*!< delimiter after the token, '\0' at the end */
+
+    /* private variables - do not access directly */
+    size_t next;        /*!< offset of the next token */
+    bool ready;         /*!< delims is built */
+    struct qstrdelims_s {
+        unsigned char lo[16];   /*!< buckets by low nibble */
+        unsigned char hi[16];   /*!< buckets by high nibble */
+        unsigned char map[32];  /*!< bitmap of the delimiters */
+        bool vec;               /*!< nibble buckets are exact */
+    } delims;           /*!< delimiter set */
+};
+
+/**
+ * qstr_t string builder by qstr_init()
+ */
+struct qstr_s {
+    /* private variables - do not access directly */
+    size_t len;                     /*!< length without the NUL */
+    size_t cap;                     /*!< heap buffer size, 0 if inline */
+    union {
+        char *heap;
+        char inl[QSTR_INLINESIZE];
+    } buf;
+};
+
 #ifdef __cplusplus
 }
 #endif
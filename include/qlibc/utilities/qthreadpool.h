@@ -0,0 +1,96 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/**
+ * qthreadpool header file.
+ *
+ * @file qthreadpool.h
+ */
+
+#ifndef QTHREADPOOL_H
+#define QTHREADPOOL_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* types */
+typedef struct qthreadpool_s qthreadpool_t;
+typedef struct qthreadpool_future_s qthreadpool_future_t;
+
+typedef void *(*qthreadpool_func_t) (void *arg);
+typedef void (*qthreadpool_range_t) (size_t begin, size_t end, void *userdata);
+
+extern qthreadpool_t *qthreadpool(int nthreads);
+extern bool qthreadpool_submit(qthreadpool_t *pool, qthreadpool_func_t func,
+                               void *arg);
+extern qthreadpool_future_t *qthreadpool_async(qthreadpool_t *pool,
+                                               qthreadpool_func_t func,
+                                               void *arg);
+extern void *qthreadpool_future_get(qthreadpool_future_t *future);
+extern bool qthreadpool_future_done(qthreadpool_future_t *future);
+extern void qthreadpool_future_free(qthreadpool_future_t *future);
+extern bool qthreadpool_parallel_for(qthreadpool_t *pool, size_t begin,
+                                     size_t end, size_t grain,
+                                     qthreadpool_range_t func,
+                                     void *userdata);
+extern void qthreadpool_wait(qthreadpool_t *pool);
+extern int qthreadpool_nthreads(qthreadpool_t *pool);
+extern void qthreadpool_shutdown(qthreadpool_t *pool);
+extern void qthreadpool_free(qthreadpool_t *pool);
+
+/**
+ * qthreadpool_t structure
+ */
+struct qthreadpool_s {
+    /* private variables - do not access directly */
+    int nthreads;           /*!< number of the worker threads */
+    pthread_t *threads;     /*!< worker threads */
+    void *workers;          /*!< work stealing deque of each worker */
+    void *inbox;            /*!< tasks submitted from outside, guarded by mutex */
+    void *inboxlast;        /*!< last task of the inbox */
+
+    size_t queued;          /*!< number of the tasks in the deques */
+    size_t pending;         /*!< number of the tasks not finished yet */
+    int sleepers;           /*!< number of the threads waiting on cond */
+    bool shutdown;          /*!< no more outside submission if set */
+
+    pthread_mutex_t mutex;  /*!< guards the inbox and the sleeps on cond */
+    pthread_cond_t cond;    /*!< new tasks and completions are signaled */
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* QTHREADPOOL_H */
@@ -37,6 +37,7 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <time.h>
 
 #ifdef __cplusplus
@@ -49,6 +50,8 @@ extern void qtime_timeval_diff(struct timeval t1, struct timeval t2,
                                struct timeval *diff);
 
 extern long qtime_current_milli(void);
+extern int64_t qtime_monotonic_nano(void);
+extern time_t qtime_coarse(void);
 
 extern char *qtime_localtime_strf(char *buf, int size, time_t utctime,
                                   const char *format);
@@ -60,6 +63,11 @@ extern char *qtime_gmt_str(time_t utctime);
 extern const char *qtime_gmt_staticstr(time_t utctime);
 extern time_t qtime_parse_gmtstr(const char *gmtstr);
 
+extern size_t qtime_format_rfc1123(char *buf, size_t size, time_t utctime);
+extern size_t qtime_format_iso8601(char *buf, size_t size, time_t utctime);
+extern time_t qtime_parse_rfc1123(const char *str);
+extern time_t qtime_parse_iso8601(const char *str);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,86 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/**
+ * qtrace header file.
+ *
+ * @file qtrace.h
+ */
+
+#ifndef QTRACE_H
+#define QTRACE_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* types */
+typedef struct qtrace_event_s qtrace_event_t;
+typedef void (*qtrace_cb_t)(const qtrace_event_t *event, void *userdata);
+
+/**
+ * traced operations
+ */
+enum {
+    QTRACE_SOCKET_RESOLVE = 1,  /*!< name resolution, detail is the host */
+    QTRACE_SOCKET_CONNECT,      /*!< TCP connection by qsocket_open() */
+    QTRACE_IO_READ,             /*!< qio_read() and reader buffer fills */
+    QTRACE_IO_WRITE,            /*!< qio_write() */
+    QTRACE_HTTP_CONNECT,        /*!< qhttpclient TCP connection */
+    QTRACE_HTTP_TLS,            /*!< qhttpclient TLS handshake */
+    QTRACE_HTTP_REQUEST,        /*!< sending a request, detail is the method */
+    QTRACE_HTTP_RESPONSE,       /*!< waiting and reading response headers */
+};
+
+extern void qtrace_set(qtrace_cb_t callback, void *userdata);
+extern bool qtrace_enabled(void);
+extern const char *qtrace_name(int type);
+
+/**
+ * trace event given to the callback
+ */
+struct qtrace_event_s {
+    int type;            /*!< QTRACE_* operation */
+    const char *name;    /*!< name of the operation, "io.read" and so on */
+    int fd;              /*!< descriptor involved, -1 if none yet */
+    const char *detail;  /*!< hostname or method, NULL if none */
+    uint64_t start;      /*!< monotonic nanoseconds when it started */
+    uint64_t elapsed;    /*!< nanoseconds it took */
+    int64_t result;      /*!< return value of the operation */
+    int error;           /*!< errno if it failed, otherwise 0 */
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* QTRACE_H */
@@ -0,0 +1,327 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/**
+ * @file qarena.c Arena allocator implementation.
+ *
+ * qarena is a region allocator. Memory is carved out of large chunks by
+ * bumping an offset, and individual allocations are never freed. All of them
+ * are released together by reset() or free(), which costs one free() per
+ * chunk no matter how many objects were allocated.
+ *
+ * It is useful for short lived data such as request scoped tables, where the
+ * containers can be told to take their elements from an arena with their
+ * set_arena() call. Then dropping the whole request only takes clearing the
+ * containers and resetting the arena.
+ *
+ * @code
+ *  qarena_t *arena = qarena(0, 0);
+ *
+ *  qhashtbl_t *tbl = qhashtbl(0, 0);
+ *  tbl->set_arena(tbl, arena);
+ *  tbl->putstr(tbl, "key", "value");  // comes from the arena
+ *  (...codes...)
+ *
+ *  tbl->free(tbl);        // doesn't free the elements one by one
+ *  arena->reset(arena);   // release everything, ready for the next request
+ *  (...codes...)
+ *
+ *  arena->free(arena);
+ * @endcode
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include "qinternal.h"
+#include "containers/qarena.h"
+
+#define DEFAULT_CHUNK_SIZE  (64 * 1024) /*!< default size of a regular chunk */
+#define ARENA_ALIGN         (16)        /*!< alignment of allocations */
+#define ALIGN_UP(n)         (((n) + (ARENA_ALIGN - 1)) & ~((size_t) ARENA_ALIGN - 1))
+
+#ifndef _DOXYGEN_SKIP
+
+/* chunk header, allocations follow it */
+typedef struct qarena_chunk_s qarena_chunk_t;
+struct qarena_chunk_s {
+    qarena_chunk_t *next;   /*!< next chunk */
+    size_t size;            /*!< usable size of this chunk */
+    size_t offset;          /*!< offset of the next allocation */
+} __attribute__((aligned(ARENA_ALIGN)));
+
+static qarena_chunk_t *new_chunk(size_t size);
+
+#endif
+
+/**
+ * Create an arena allocator.
+ *
+ * @param chunksize     size of a chunk. 0 for the default size of 64KB.
+ * @param options       combination of initialization options.
+ *
+ * @return a pointer of malloced qarena_t, otherwise returns NULL.
+ * @retval errno will be set in error condition.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @code
+ *  qarena_t *arena = qarena(0, QARENA_THREADSAFE);
+ * @endcode
+ *
+ * @note
+ *   Available options:
+ *   - QARENA_THREADSAFE - make it thread-safe. An arena shared by
+ *     thread-safe containers must be created with this option.
+ */
+qarena_t *qarena(size_t chunksize, int options) {
+    if (chunksize == 0) {
+        chunksize = DEFAULT_CHUNK_SIZE;
+    }
+
+    qarena_t *arena = (qarena_t *) calloc(1, sizeof(qarena_t));
+    if (arena == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    // handle options.
+    if (options & QARENA_THREADSAFE) {
+        Q_MUTEX_NEW(arena->qmutex, true);
+        if (arena->qmutex == NULL) {
+            errno = ENOMEM;
+            free(arena);
+            return NULL;
+        }
+    }
+
+    // assign methods
+    arena->alloc = qarena_alloc;
+    arena->calloc = qarena_calloc;
+    arena->memdup = qarena_memdup;
+    arena->strdup = qarena_strdup;
+
+    arena->size = qarena_size;
+    arena->reset = qarena_reset;
+    arena->free = qarena_free;
+
+    arena->chunksize = ALIGN_UP(chunksize);
+
+    return arena;
+}
+
+/**
+ * qarena->alloc(): Allocate memory from the arena.
+ *
+ * @param arena     qarena_t container pointer.
+ * @param size      size of memory to allocate.
+ *
+ * @return a pointer of 16-byte aligned memory, otherwise returns NULL.
+ * @retval errno will be set in error condition.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @note
+ *  The returned memory must not be freed by free(). It stays valid until
+ *  reset() or free() is called on the arena. A request bigger than a quarter
+ *  of the chunk size gets a chunk of its own, so the current chunk isn't
+ *  wasted.
+ */
+void *qarena_alloc(qarena_t *arena, size_t size) {
+    size = ALIGN_UP((size > 0) ? size : 1);
+
+    Q_MUTEX_ENTER(arena->qmutex);
+    qarena_chunk_t *chunk = (qarena_chunk_t *) arena->chunks;
+    if (size > arena->chunksize / 4) {
+        // large one, place it behind the current chunk
+        qarena_chunk_t *big = new_chunk(size);
+        if (big == NULL) {
+            Q_MUTEX_LEAVE(arena->qmutex);
+            errno = ENOMEM;
+            return NULL;
+        }
+        big->offset = size;
+        if (chunk != NULL) {
+            big->next = chunk->next;
+            chunk->next = big;
+        } else {
+            arena->chunks = big;
+        }
+        arena->used += size;
+        Q_MUTEX_LEAVE(arena->qmutex);
+        return (void *) (big + 1);
+    }
+
+    if (chunk == NULL || chunk->size - chunk->offset < size) {
+        qarena_chunk_t *fresh = new_chunk(arena->chunksize);
+        if (fresh == NULL) {
+            Q_MUTEX_LEAVE(arena->qmutex);
+            errno = ENOMEM;
+            return NULL;
+        }
+        fresh->next = chunk;
+        arena->chunks = chunk = fresh;
+    }
+
+    void *ptr = (char *) (chunk + 1) + chunk->offset;
+    chunk->offset += size;
+    arena->used += size;
+    Q_MUTEX_LEAVE(arena->qmutex);
+
+    return ptr;
+}
+
+/**
+ * qarena->calloc(): Allocate zero filled memory from the arena.
+ *
+ * @param arena     qarena_t container pointer.
+ * @param size      size of memory to allocate.
+ *
+ * @return a pointer of zero filled memory, otherwise returns NULL.
+ * @retval errno will be set in error condition.
+ *  - ENOMEM : Memory allocation failure.
+ */
+void *qarena_calloc(qarena_t *arena, size_t size) {
+    void *ptr = qarena_alloc(arena, size);
+    if (ptr != NULL) {
+        memset(ptr, 0, size);
+    }
+    return ptr;
+}
+
+/**
+ * qarena->memdup(): Copy data into the arena.
+ *
+ * @param arena     qarena_t container pointer.
+ * @param data      source data.
+ * @param size      size of data.
+ *
+ * @return a pointer of the copy, otherwise returns NULL.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - ENOMEM : Memory allocation failure.
+ */
+void *qarena_memdup(qarena_t *arena, const void *data, size_t size) {
+    if (data == NULL) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    void *ptr = qarena_alloc(arena, size);
+    if (ptr != NULL) {
+        memcpy(ptr, data, size);
+    }
+    return ptr;
+}
+
+/**
+ * qarena->strdup(): Copy a string into the arena.
+ *
+ * @param arena     qarena_t container pointer.
+ * @param str       source string.
+ *
+ * @return a pointer of the copied string, otherwise returns NULL.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - ENOMEM : Memory allocation failure.
+ */
+char *qarena_strdup(qarena_t *arena, const char *str) {
+    if (str == NULL) {
+        errno = EINVAL;
+        return NULL;
+    }
+    return (char *) qarena_memdup(arena, str, strlen(str) + 1);
+}
+
+/**
+ * qarena->size(): Returns the number of bytes allocated from the arena.
+ *
+ * @param arena     qarena_t container pointer.
+ *
+ * @return the number of bytes handed out including alignment padding.
+ */
+size_t qarena_size(qarena_t *arena) {
+    return arena->used;
+}
+
+/**
+ * qarena->reset(): Release all the memory allocated from the arena.
+ *
+ * @param arena     qarena_t container pointer.
+ *
+ * @note
+ *  One regular chunk is kept for the next round of allocations, the other
+ *  chunks are returned to the system. Containers which took their elements
+ *  from this arena must be cleared or freed before the reset.
+ */
+void qarena_reset(qarena_t *arena) {
+    Q_MUTEX_ENTER(arena->qmutex);
+    qarena_chunk_t *keep = NULL;
+    qarena_chunk_t *chunk = (qarena_chunk_t *) arena->chunks;
+    while (chunk != NULL) {
+        qarena_chunk_t *next = chunk->next;
+        if (keep == NULL && chunk->size == arena->chunksize) {
+            keep = chunk;
+            keep->next = NULL;
+            keep->offset = 0;
+        } else {
+            free(chunk);
+        }
+        chunk = next;
+    }
+    arena->chunks = keep;
+    arena->used = 0;
+    Q_MUTEX_LEAVE(arena->qmutex);
+}
+
+/**
+ * qarena->free(): Free the arena and all the memory allocated from it.
+ *
+ * @param arena     qarena_t container pointer.
+ */
+void qarena_free(qarena_t *arena) {
+    qarena_reset(arena);
+    free(arena->chunks);
+    Q_MUTEX_DESTROY(arena->qmutex);
+    free(arena);
+}
+
+#ifndef _DOXYGEN_SKIP
+
+static qarena_chunk_t *new_chunk(size_t size) {
+    qarena_chunk_t *chunk = (qarena_chunk_t *) malloc(sizeof(qarena_chunk_t) + size);
+    if (chunk == NULL) {
+        return NULL;
+    }
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->offset = 0;
+    return chunk;
+}
+
+#endif /* _DOXYGEN_SKIP */
@@ -0,0 +1,322 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/**
+ * @file qbloom.c Blocked Bloom filter container implementation.
+ *
+ * qbloom tells whether an element has never been added, at the cost of a
+ * few bits for each element. A check returns false only when the element
+ * has definitely not been added, and true when it has been added or, in a
+ * small given probability, it hasn't. That makes a cheap negative lookup in
+ * front of slower storage like qhasharr tables or databases.
+ *
+ * This is a blocked Bloom filter. All the bits of an element fall in one
+ * 512-bit block picked by its hash, so adding and checking touches a single
+ * cache line regardless of the number of hashes. Blocking costs some
+ * accuracy, which qbloom_calculate_memsize() makes up for with 25% more
+ * memory. An element is hashed once with wyhash, and the positions in the
+ * block are derived from the hash value.
+ *
+ * Like qhasharr, the filter works in a memory given by the user and keeps
+ * everything in it, so it can be placed in a shared memory by qshm and
+ * attached by other processes. The bits are set with atomic operations, so
+ * adding and checking are safe from many threads and processes at the same
+ * time without a lock.
+ *
+ * @code
+ *  // for 1 million elements with 1% false positives.
+ *  size_t memsize = qbloom_calculate_memsize(1000000, 0.01);
+ *  void *memory = malloc(memsize);
+ *  qbloom_t *bloom = qbloom(memory, memsize, 1000000);
+ *
+ *  bloom->add(bloom, key, strlen(key));
+ *  if (bloom->check(bloom, key, strlen(key)) == false) {
+ *    // definitely not in the storage, skip the lookup.
+ *  }
+ *
+ *  bloom->free(bloom);
+ *  free(memory);
+ * @endcode
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include "qinternal.h"
+#include "utilities/qhash.h"
+#include "containers/qbloom.h"
+
+#ifndef _DOXYGEN_SKIP
+
+#define BLOCK_BITS      (512)
+#define BLOCK_WORDS     (BLOCK_BITS / 64)
+#define BLOCKS_OFFSET   (64)    /* the blocks start from the next cache line */
+#define MAX_HASHES      (16)
+#define BLOCKED_MARGIN  (1.25)   /* more bits to make up for the blocking */
+#define LN2             (0.69314718055994530942)
+
+static uint64_t *get_block(qbloom_t *bloom, uint64_t hash);
+static uint32_t next_bit(uint64_t *state);
+
+#endif
+
+/**
+ * Get how much memory is needed for the number of elements and the false
+ * positive probability.
+ *
+ * @param nitems    expected number of elements.
+ * @param fpp       false positive probability wanted, between 0 and 1
+ *                  exclusive.
+ *
+ * @return memory size needed, or 0 for invalid arguments.
+ *
+ * @code
+ *  size_t memsize = qbloom_calculate_memsize(1000000, 0.01);  // ~1.5MB
+ * @endcode
+ */
+size_t qbloom_calculate_memsize(size_t nitems, double fpp) {
+    if (nitems == 0 || !(fpp > 0.0 && fpp < 1.0)) {
+        return 0;
+    }
+
+    double bits = (double) nitems * -_q_log(fpp) / (LN2 * LN2)
+            * BLOCKED_MARGIN;
+    double nblocks = bits / BLOCK_BITS + 1;
+    if (nblocks > UINT32_MAX) {
+        return 0;
+    }
+
+    return BLOCKS_OFFSET + (size_t) nblocks * (BLOCK_BITS / 8);
+}
+
+/**
+ * Initialize a Bloom filter in the given memory.
+ *
+ * @param memory    a pointer of data memory.
+ * @param memsize   a size of data memory, 0 for using existing data.
+ * @param nitems    expected number of elements, which determines the number
+ *                  of hashes for the memory size. Ignored if memsize is 0.
+ *
+ * @return qbloom_t container pointer, otherwise returns NULL.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument, or the memory is too small for a block.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @code
+ *  // initialize a new filter in a shared memory.
+ *  size_t memsize = qbloom_calculate_memsize(100000, 0.001);
+ *  int shmid = qshm_init("/tmp/bloom.shm", 'b', memsize, true);
+ *  void *memory = qshm_get(shmid);
+ *  qbloom_t *bloom = qbloom(memory, memsize, 100000);
+ *
+ *  // use the existing filter in other processes.
+ *  qbloom_t *bloom2 = qbloom(memory, 0, 0);
+ * @endcode
+ */
+qbloom_t *qbloom(void *memory, size_t memsize, size_t nitems) {
+    if (memory == NULL) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    qbloom_data_t *bloomdata = (qbloom_data_t *) memory;
+    if (memsize > 0) {
+        if (nitems == 0 || memsize < BLOCKS_OFFSET + BLOCK_BITS / 8) {
+            errno = EINVAL;
+            return NULL;
+        }
+
+        size_t nblocks = (memsize - BLOCKS_OFFSET) / (BLOCK_BITS / 8);
+        if (nblocks > UINT32_MAX) {
+            nblocks = UINT32_MAX;
+        }
+
+        // k = m / n * ln2 minimizes the false positives.
+        double k = (double) nblocks * BLOCK_BITS / nitems * LN2 + 0.5;
+        int nhashes = (k < 1) ? 1 : (k > MAX_HASHES) ? MAX_HASHES : (int) k;
+
+        memset(memory, 0, BLOCKS_OFFSET + nblocks * (BLOCK_BITS / 8));
+        bloomdata->version = Q_BLOOM_VERSION;
+        bloomdata->nhashes = nhashes;
+        bloomdata->nblocks = (uint32_t) nblocks;
+        bloomdata->num = 0;
+    } else if (bloomdata->version != Q_BLOOM_VERSION || bloomdata->nblocks < 1
+            || bloomdata->nhashes < 1 || bloomdata->nhashes > MAX_HASHES) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    qbloom_t *bloom = (qbloom_t *) calloc(1, sizeof(qbloom_t));
+    if (bloom == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    // assign methods
+    bloom->add = qbloom_add;
+    bloom->check = qbloom_check;
+
+    bloom->size = qbloom_size;
+    bloom->clear = qbloom_clear;
+    bloom->free = qbloom_free;
+
+    bloom->data = bloomdata;
+
+    return bloom;
+}
+
+/**
+ * qbloom->add(): Add an element.
+ *
+ * @param bloom     qbloom_t container pointer.
+ * @param data      a pointer of the element.
+ * @param size      size of the element.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ */
+bool qbloom_add(qbloom_t *bloom, const void *data, size_t size) {
+    if (data == NULL) {
+        errno = EINVAL;
+        return false;
+    }
+
+    uint64_t hash = qhashwyhash_64(data, size);
+    uint64_t *block = get_block(bloom, hash);
+
+    bool newbit = false;
+    int i;
+    for (i = 0; i < bloom->data->nhashes; i++) {
+        uint32_t bit = next_bit(&hash);
+        uint64_t mask = 1ULL << (bit % 64);
+        uint64_t old = __atomic_fetch_or(&block[bit / 64], mask,
+                                         __ATOMIC_RELAXED);
+        if (!(old & mask)) {
+            newbit = true;
+        }
+    }
+    if (newbit) {
+        __atomic_fetch_add(&bloom->data->num, 1, __ATOMIC_RELAXED);
+    }
+
+    return true;
+}
+
+/**
+ * qbloom->check(): Check whether an element might have been added.
+ *
+ * @param bloom     qbloom_t container pointer.
+ * @param data      a pointer of the element.
+ * @param size      size of the element.
+ *
+ * @return false if the element has definitely not been added, true if it
+ *         has been added or it's a false positive.
+ */
+bool qbloom_check(qbloom_t *bloom, const void *data, size_t size) {
+    if (data == NULL) {
+        errno = EINVAL;
+        return false;
+    }
+
+    uint64_t hash = qhashwyhash_64(data, size);
+    const uint64_t *block = get_block(bloom, hash);
+
+    int i;
+    for (i = 0; i < bloom->data->nhashes; i++) {
+        uint32_t bit = next_bit(&hash);
+        uint64_t word = __atomic_load_n(&block[bit / 64], __ATOMIC_RELAXED);
+        if (!(word & (1ULL << (bit % 64)))) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * qbloom->size(): Returns the number of added elements.
+ *
+ * @param bloom     qbloom_t container pointer.
+ *
+ * @return the number of added elements which set at least one new bit. It
+ *         doesn't count the same element twice, but it misses elements
+ *         which were false positives when added.
+ */
+size_t qbloom_size(qbloom_t *bloom) {
+    return (size_t) __atomic_load_n(&bloom->data->num, __ATOMIC_RELAXED);
+}
+
+/**
+ * qbloom->clear(): Removes all the elements.
+ *
+ * @param bloom     qbloom_t container pointer.
+ *
+ * @note
+ *  Elements added by others while clearing may or may not be kept.
+ */
+void qbloom_clear(qbloom_t *bloom) {
+    qbloom_data_t *bloomdata = bloom->data;
+    memset((char *) bloomdata + BLOCKS_OFFSET, 0,
+           (size_t) bloomdata->nblocks * (BLOCK_BITS / 8));
+    __atomic_store_n(&bloomdata->num, 0, __ATOMIC_RELAXED);
+}
+
+/**
+ * qbloom->free(): De-initialize the filter.
+ *
+ * @param bloom     qbloom_t container pointer.
+ *
+ * @note
+ *  The memory given to qbloom() is not freed, and the filter stays in it.
+ */
+void qbloom_free(qbloom_t *bloom) {
+    free(bloom);
+}
+
+#ifndef _DOXYGEN_SKIP
+
+// pick a block by the upper half of the hash without a division.
+static uint64_t *get_block(qbloom_t *bloom, uint64_t hash) {
+    uint64_t idx = ((hash >> 32) * bloom->data->nblocks) >> 32;
+    return (uint64_t *) ((char *) bloom->data + BLOCKS_OFFSET) + idx
+            * BLOCK_WORDS;
+}
+
+// the bit positions in the block come from the top bits of a multiplicative
+// sequence seeded by the hash. Double hashing within a block would repeat
+// the same few patterns and put a floor under the false positives.
+static uint32_t next_bit(uint64_t *state) {
+    *state *= 0x9E3779B97F4A7C15ULL;
+    return (uint32_t) (*state >> 55);
+}
+
+#endif /* _DOXYGEN_SKIP */
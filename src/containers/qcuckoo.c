@@ -0,0 +1,524 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/**
+ * @file qcuckoo.c Cuckoo filter container implementation.
+ *
+ * qcuckoo answers the same question as qbloom, whether an element has never
+ * been added, and also supports removing elements. It keeps a 16-bit
+ * fingerprint of each element in one of two buckets of 4 entries, and moves
+ * the entries between their two buckets to make room as cuckoo hashing
+ * does. A check looks at two buckets only, and the false positive
+ * probability is about 0.012%, at 2 bytes for each element up to 95% load.
+ *
+ * Only remove elements which have been added. Removing an element which
+ * hasn't been added can remove the fingerprint of another one which looks
+ * the same. An element added twice takes two entries and needs removing
+ * twice.
+ *
+ * When the filter gets too full to make room, the last kicked out
+ * fingerprint is kept aside, so no element is ever lost, and further adds
+ * fail with ENOBUFS until removals make room for it again.
+ *
+ * Like qhasharr, the filter works in a memory given by the user and keeps
+ * everything in it, so it can be placed in a shared memory by qshm and
+ * attached by other processes. A filter created with QCUCKOO_THREADSAFE
+ * carries a read-write spin lock in its memory, the same one qhasharr uses.
+ *
+ * @code
+ *  size_t memsize = qcuckoo_calculate_memsize(100000);
+ *  void *memory = malloc(memsize);
+ *  qcuckoo_t *cuckoo = qcuckoo(memory, memsize, 0);
+ *
+ *  cuckoo->add(cuckoo, key, strlen(key));
+ *  if (cuckoo->check(cuckoo, key, strlen(key))) {
+ *    (...probably there...)
+ *  }
+ *  cuckoo->remove(cuckoo, key, strlen(key));
+ *
+ *  cuckoo->free(cuckoo);
+ *  free(memory);
+ * @endcode
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include "qinternal.h"
+#include "utilities/qhash.h"
+#include "containers/qcuckoo.h"
+
+#ifndef _DOXYGEN_SKIP
+
+#define BUCKET_ENTRIES    (4)
+#define BUCKETS_OFFSET    (64)     /* the buckets start from the next cache line */
+#define MAX_LOAD          (0.95)   /* load factor to size the filter for */
+#define MAX_KICKS         (500)    /* relocations before giving up */
+
+#define LOCK_WRITER       (0x80000000U)  /* held by a writer */
+#define LOCK_WAITING      (0x40000000U)  /* a writer is waiting */
+#define LOCK_SPINS        (100)          /* spins before yielding the CPU */
+
+static uint16_t *get_bucket(qcuckoo_t *cuckoo, uint32_t idx);
+static uint32_t get_altidx(qcuckoo_t *cuckoo, uint32_t idx, uint16_t fp);
+static void get_fp(qcuckoo_t *cuckoo, const void *data, size_t size,
+                   uint16_t *fp, uint32_t *idx1, uint32_t *idx2);
+static bool put_fp(qcuckoo_t *cuckoo, uint32_t idx, uint16_t fp);
+static void insert_fp(qcuckoo_t *cuckoo, uint32_t idx, uint16_t fp);
+static bool has_fp(qcuckoo_t *cuckoo, uint32_t idx, uint16_t fp);
+static bool delete_fp(qcuckoo_t *cuckoo, uint32_t idx, uint16_t fp);
+static void lock_read(qcuckoo_t *cuckoo);
+static void lock_write(qcuckoo_t *cuckoo);
+static void unlock_read(qcuckoo_t *cuckoo);
+static void unlock_write(qcuckoo_t *cuckoo);
+
+#endif
+
+/**
+ * Get how much memory is needed for the number of elements.
+ *
+ * @param nitems    expected number of elements.
+ *
+ * @return memory size needed, or 0 for invalid arguments.
+ *
+ * @note
+ *  The number of buckets is rounded up to a power of 2, so the filter may
+ *  hold up to twice as many.
+ */
+size_t qcuckoo_calculate_memsize(size_t nitems) {
+    if (nitems == 0) {
+        return 0;
+    }
+
+    double need = (double) nitems / BUCKET_ENTRIES / MAX_LOAD;
+    size_t nbuckets = 1;
+    while (nbuckets < need) {
+        if (nbuckets >= (size_t) 1 << 31) {
+            return 0;
+        }
+        nbuckets *= 2;
+    }
+
+    return BUCKETS_OFFSET + nbuckets * BUCKET_ENTRIES * sizeof(uint16_t);
+}
+
+/**
+ * Initialize a cuckoo filter in the given memory.
+ *
+ * @param memory    a pointer of data memory.
+ * @param memsize   a size of data memory, 0 for using existing data.
+ * @param options   combination of initialization options. Ignored if
+ *                  memsize is 0.
+ *
+ * @return qcuckoo_t container pointer, otherwise returns NULL.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument, or the memory is too small for a bucket.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @code
+ *  // initialize a new filter.
+ *  qcuckoo_t *cuckoo = qcuckoo(memory, memsize, QCUCKOO_THREADSAFE);
+ *
+ *  // use the existing filter in other processes.
+ *  qcuckoo_t *cuckoo2 = qcuckoo(memory, 0, 0);
+ * @endcode
+ *
+ * @note
+ *  Available options:
+ *  - QCUCKOO_THREADSAFE - make it thread-safe and process-safe.
+ *  The number of buckets is the largest power of 2 which fits in the memory.
+ */
+qcuckoo_t *qcuckoo(void *memory, size_t memsize, int options) {
+    if (memory == NULL) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    qcuckoo_data_t *cuckoodata = (qcuckoo_data_t *) memory;
+    size_t bucketsize = BUCKET_ENTRIES * sizeof(uint16_t);
+    if (memsize > 0) {
+        if (memsize < BUCKETS_OFFSET + bucketsize) {
+            errno = EINVAL;
+            return NULL;
+        }
+
+        size_t max = (memsize - BUCKETS_OFFSET) / bucketsize;
+        uint32_t nbuckets = 1;
+        while (nbuckets <= max / 2 && nbuckets < (uint32_t) 1 << 31) {
+            nbuckets *= 2;
+        }
+
+        memset(memory, 0, BUCKETS_OFFSET + nbuckets * bucketsize);
+        cuckoodata->version = Q_CUCKOO_VERSION;
+        cuckoodata->options = options & QCUCKOO_THREADSAFE;
+        cuckoodata->nbuckets = nbuckets;
+    } else if (cuckoodata->version != Q_CUCKOO_VERSION
+            || cuckoodata->nbuckets < 1
+            || (cuckoodata->nbuckets & (cuckoodata->nbuckets - 1)) != 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    qcuckoo_t *cuckoo = (qcuckoo_t *) calloc(1, sizeof(qcuckoo_t));
+    if (cuckoo == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    // assign methods
+    cuckoo->add = qcuckoo_add;
+    cuckoo->check = qcuckoo_check;
+    cuckoo->remove = qcuckoo_remove;
+
+    cuckoo->size = qcuckoo_size;
+    cuckoo->clear = qcuckoo_clear;
+    cuckoo->free = qcuckoo_free;
+
+    cuckoo->data = cuckoodata;
+    cuckoo->seed = (uint32_t) (uintptr_t) cuckoo | 1;
+
+    return cuckoo;
+}
+
+/**
+ * qcuckoo->add(): Add an element.
+ *
+ * @param cuckoo    qcuckoo_t container pointer.
+ * @param data      a pointer of the element.
+ * @param size      size of the element.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - ENOBUFS : The filter is full.
+ */
+bool qcuckoo_add(qcuckoo_t *cuckoo, const void *data, size_t size) {
+    if (data == NULL) {
+        errno = EINVAL;
+        return false;
+    }
+
+    uint16_t fp;
+    uint32_t idx1, idx2;
+    get_fp(cuckoo, data, size, &fp, &idx1, &idx2);
+
+    qcuckoo_data_t *cuckoodata = cuckoo->data;
+    lock_write(cuckoo);
+    if (cuckoodata->victimfp != 0) {
+        unlock_write(cuckoo);
+        errno = ENOBUFS;
+        return false;
+    }
+
+    cuckoodata->num++;
+    insert_fp(cuckoo, idx1, fp);
+    unlock_write(cuckoo);
+
+    return true;
+}
+
+/**
+ * qcuckoo->check(): Check whether an element might have been added.
+ *
+ * @param cuckoo    qcuckoo_t container pointer.
+ * @param data      a pointer of the element.
+ * @param size      size of the element.
+ *
+ * @return false if the element has definitely not been added, true if it
+ *         has been added or it's a false positive.
+ */
+bool qcuckoo_check(qcuckoo_t *cuckoo, const void *data, size_t size) {
+    if (data == NULL) {
+        errno = EINVAL;
+        return false;
+    }
+
+    uint16_t fp;
+    uint32_t idx1, idx2;
+    get_fp(cuckoo, data, size, &fp, &idx1, &idx2);
+
+    qcuckoo_data_t *cuckoodata = cuckoo->data;
+    lock_read(cuckoo);
+    bool found = has_fp(cuckoo, idx1, fp) || has_fp(cuckoo, idx2, fp)
+            || (cuckoodata->victimfp == fp
+                    && (cuckoodata->victimidx == idx1
+                            || cuckoodata->victimidx == idx2));
+    unlock_read(cuckoo);
+
+    return found;
+}
+
+/**
+ * qcuckoo->remove(): Remove an element.
+ *
+ * @param cuckoo    qcuckoo_t container pointer.
+ * @param data      a pointer of the element.
+ * @param size      size of the element.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - ENOENT : No such element.
+ */
+bool qcuckoo_remove(qcuckoo_t *cuckoo, const void *data, size_t size) {
+    if (data == NULL) {
+        errno = EINVAL;
+        return false;
+    }
+
+    uint16_t fp;
+    uint32_t idx1, idx2;
+    get_fp(cuckoo, data, size, &fp, &idx1, &idx2);
+
+    qcuckoo_data_t *cuckoodata = cuckoo->data;
+    lock_write(cuckoo);
+    if (cuckoodata->victimfp == fp
+            && (cuckoodata->victimidx == idx1
+                    || cuckoodata->victimidx == idx2)) {
+        cuckoodata->victimfp = 0;
+    } else if (delete_fp(cuckoo, idx1, fp) == false
+            && delete_fp(cuckoo, idx2, fp) == false) {
+        unlock_write(cuckoo);
+        errno = ENOENT;
+        return false;
+    }
+    cuckoodata->num--;
+
+    // try to make room for the one kept aside again.
+    if (cuckoodata->victimfp != 0) {
+        uint16_t victimfp = cuckoodata->victimfp;
+        cuckoodata->victimfp = 0;
+        insert_fp(cuckoo, cuckoodata->victimidx, victimfp);
+    }
+    unlock_write(cuckoo);
+
+    return true;
+}
+
+/**
+ * qcuckoo->size(): Returns the number of added elements.
+ *
+ * @param cuckoo    qcuckoo_t container pointer.
+ *
+ * @return the number of added elements.
+ */
+size_t qcuckoo_size(qcuckoo_t *cuckoo) {
+    lock_read(cuckoo);
+    size_t num = cuckoo->data->num;
+    unlock_read(cuckoo);
+
+    return num;
+}
+
+/**
+ * qcuckoo->clear(): Removes all the elements.
+ *
+ * @param cuckoo    qcuckoo_t container pointer.
+ */
+void qcuckoo_clear(qcuckoo_t *cuckoo) {
+    qcuckoo_data_t *cuckoodata = cuckoo->data;
+    lock_write(cuckoo);
+    memset((char *) cuckoodata + BUCKETS_OFFSET, 0,
+           (size_t) cuckoodata->nbuckets * BUCKET_ENTRIES * sizeof(uint16_t));
+    cuckoodata->num = 0;
+    cuckoodata->victimfp = 0;
+    unlock_write(cuckoo);
+}
+
+/**
+ * qcuckoo->free(): De-initialize the filter.
+ *
+ * @param cuckoo    qcuckoo_t container pointer.
+ *
+ * @note
+ *  The memory given to qcuckoo() is not freed, and the filter stays in it.
+ */
+void qcuckoo_free(qcuckoo_t *cuckoo) {
+    free(cuckoo);
+}
+
+#ifndef _DOXYGEN_SKIP
+
+static uint16_t *get_bucket(qcuckoo_t *cuckoo, uint32_t idx) {
+    return (uint16_t *) ((char *) cuckoo->data + BUCKETS_OFFSET)
+            + (size_t) idx * BUCKET_ENTRIES;
+}
+
+// the other bucket is derived from the fingerprint only, so an entry can
+// move back and forth without the element.
+static uint32_t get_altidx(qcuckoo_t *cuckoo, uint32_t idx, uint16_t fp) {
+    return (idx ^ (fp * 0x5bd1e995U)) & (cuckoo->data->nbuckets - 1);
+}
+
+// the lower bits of the hash pick the bucket and the upper 16 bits make the
+// fingerprint, 0 is reserved for empty entries.
+static void get_fp(qcuckoo_t *cuckoo, const void *data, size_t size,
+                   uint16_t *fp, uint32_t *idx1, uint32_t *idx2) {
+    uint64_t hash = qhashwyhash_64(data, size);
+    *fp = (uint16_t) (hash >> 48);
+    if (*fp == 0)
+        *fp = 1;
+    *idx1 = (uint32_t) hash & (cuckoo->data->nbuckets - 1);
+    *idx2 = get_altidx(cuckoo, *idx1, *fp);
+}
+
+static bool put_fp(qcuckoo_t *cuckoo, uint32_t idx, uint16_t fp) {
+    uint16_t *bucket = get_bucket(cuckoo, idx);
+    int i;
+    for (i = 0; i < BUCKET_ENTRIES; i++) {
+        if (bucket[i] == 0) {
+            bucket[i] = fp;
+            return true;
+        }
+    }
+    return false;
+}
+
+// put the fingerprint in either of its buckets, kicking out random entries
+// to their other buckets as needed. Keeps the last kicked out one aside
+// when it can't make room, which fills up the filter.
+static void insert_fp(qcuckoo_t *cuckoo, uint32_t idx, uint16_t fp) {
+    if (put_fp(cuckoo, idx, fp))
+        return;
+    idx = get_altidx(cuckoo, idx, fp);
+    if (put_fp(cuckoo, idx, fp))
+        return;
+
+    int kicks;
+    for (kicks = 0; kicks < MAX_KICKS; kicks++) {
+        cuckoo->seed ^= cuckoo->seed << 13;
+        cuckoo->seed ^= cuckoo->seed >> 17;
+        cuckoo->seed ^= cuckoo->seed << 5;
+
+        uint16_t *bucket = get_bucket(cuckoo, idx);
+        int entry = cuckoo->seed % BUCKET_ENTRIES;
+        uint16_t kicked = bucket[entry];
+        bucket[entry] = fp;
+        fp = kicked;
+
+        idx = get_altidx(cuckoo, idx, fp);
+        if (put_fp(cuckoo, idx, fp))
+            return;
+    }
+
+    cuckoo->data->victimfp = fp;
+    cuckoo->data->victimidx = idx;
+}
+
+static bool has_fp(qcuckoo_t *cuckoo, uint32_t idx, uint16_t fp) {
+    const uint16_t *bucket = get_bucket(cuckoo, idx);
+    return (bucket[0] == fp || bucket[1] == fp || bucket[2] == fp
+            || bucket[3] == fp);
+}
+
+static bool delete_fp(qcuckoo_t *cuckoo, uint32_t idx, uint16_t fp) {
+    uint16_t *bucket = get_bucket(cuckoo, idx);
+    int i;
+    for (i = 0; i < BUCKET_ENTRIES; i++) {
+        if (bucket[i] == fp) {
+            bucket[i] = 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+// read-write spin lock over atomic operations, which works between processes
+// sharing the memory. writers are preferred not to get starved by readers.
+static void lock_read(qcuckoo_t *cuckoo) {
+    qcuckoo_data_t *cuckoodata = cuckoo->data;
+    if (!(cuckoodata->options & QCUCKOO_THREADSAFE))
+        return;
+
+    int spins;
+    for (spins = 0;; spins++) {
+        uint32_t lock = __atomic_load_n(&cuckoodata->lock, __ATOMIC_RELAXED);
+        if (!(lock & (LOCK_WRITER | LOCK_WAITING))
+                && __atomic_compare_exchange_n(&cuckoodata->lock, &lock,
+                                               lock + 1, true,
+                                               __ATOMIC_ACQUIRE,
+                                               __ATOMIC_RELAXED)) {
+            return;
+        }
+        if (spins >= LOCK_SPINS) {
+            sched_yield();
+            spins = 0;
+        }
+    }
+}
+
+static void lock_write(qcuckoo_t *cuckoo) {
+    qcuckoo_data_t *cuckoodata = cuckoo->data;
+    if (!(cuckoodata->options & QCUCKOO_THREADSAFE))
+        return;
+
+    int spins;
+    for (spins = 0;; spins++) {
+        uint32_t lock = __atomic_load_n(&cuckoodata->lock, __ATOMIC_RELAXED);
+        if ((lock & ~LOCK_WAITING) == 0) {
+            // no owner, take it over clearing the waiting mark.
+            if (__atomic_compare_exchange_n(&cuckoodata->lock, &lock,
+                                            LOCK_WRITER, true,
+                                            __ATOMIC_ACQUIRE,
+                                            __ATOMIC_RELAXED)) {
+                return;
+            }
+        } else if (!(lock & LOCK_WAITING)) {
+            // hold off new readers.
+            __atomic_fetch_or(&cuckoodata->lock, LOCK_WAITING,
+                              __ATOMIC_RELAXED);
+        }
+        if (spins >= LOCK_SPINS) {
+            sched_yield();
+            spins = 0;
+        }
+    }
+}
+
+static void unlock_read(qcuckoo_t *cuckoo) {
+    qcuckoo_data_t *cuckoodata = cuckoo->data;
+    if (!(cuckoodata->options & QCUCKOO_THREADSAFE))
+        return;
+
+    __atomic_fetch_sub(&cuckoodata->lock, 1, __ATOMIC_RELEASE);
+}
+
+static void unlock_write(qcuckoo_t *cuckoo) {
+    qcuckoo_data_t *cuckoodata = cuckoo->data;
+    if (!(cuckoodata->options & QCUCKOO_THREADSAFE))
+        return;
+
+    // keep the waiting mark of other writers.
+    __atomic_fetch_and(&cuckoodata->lock, ~LOCK_WRITER, __ATOMIC_RELEASE);
+}
+
+#endif /* _DOXYGEN_SKIP */
@@ -0,0 +1,297 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/**
+ * @file qdeque.c Work-stealing deque implementation.
+ *
+ * qdeque is a Chase-Lev work-stealing deque. The owner thread pushes and
+ * pops items at the bottom end like a stack, while any number of other
+ * threads steal items from the top end like a queue. The owner doesn't
+ * take any lock and only competes with the thieves for the very last item,
+ * so a thread pool can keep one deque per worker and let idle workers take
+ * work from busy ones.
+ *
+ * Unlike the other containers, qdeque stores the item pointers as they are
+ * without copying what they point to. The circular array grows when it's
+ * full, and outgrown arrays are kept until the deque is freed because a
+ * thief may still be reading one of them.
+ *
+ * @code
+ *  // owner thread
+ *  qdeque_t *dq = qdeque(0);
+ *  dq->push(dq, task);
+ *  struct task *mine = dq->pop(dq);       // LIFO, the latest pushed one
+ *
+ *  // other threads
+ *  struct task *stolen = dq->steal(dq);   // FIFO, the oldest one
+ *
+ *  dq->free(dq);
+ * @endcode
+ *
+ * @note
+ *  Only the thread which owns the deque may call push() and pop().
+ *  steal() and size() can be called from any thread.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include "qinternal.h"
+#include "containers/qdeque.h"
+
+#define DEFAULT_DEQUE_SIZE  (64)    /*!< default number of slots */
+
+#ifndef _DOXYGEN_SKIP
+
+/* circular array of item pointers */
+typedef struct qdeque_array_s qdeque_array_t;
+struct qdeque_array_s {
+    int64_t size;           /*!< number of slots, power of 2 */
+    qdeque_array_t *next;   /*!< link of the retired arrays */
+    void *items[];          /*!< slots */
+};
+
+static qdeque_array_t *new_array(int64_t size);
+static qdeque_array_t *grow_array(qdeque_t *dq, qdeque_array_t *a,
+                                  int64_t top, int64_t bottom);
+
+#endif
+
+/**
+ * Create a work-stealing deque.
+ *
+ * @param max   initial number of slots. It's rounded up to the next power
+ *              of 2. 0 for the default size of 64. The deque grows as needed.
+ *
+ * @return a pointer of malloced qdeque_t, otherwise returns NULL.
+ * @retval errno will be set in error condition.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @code
+ *  qdeque_t *dq = qdeque(1024);
+ * @endcode
+ */
+qdeque_t *qdeque(size_t max) {
+    int64_t size = 1;
+    while (size < ((max > 0) ? (int64_t) max : DEFAULT_DEQUE_SIZE)) {
+        size <<= 1;
+    }
+
+    qdeque_t *dq;
+    if (posix_memalign((void **) &dq, 64, sizeof(qdeque_t)) != 0) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    memset((void *) dq, 0, sizeof(qdeque_t));
+    dq->array = new_array(size);
+    if (dq->array == NULL) {
+        free(dq);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    // assign methods
+    dq->push = qdeque_push;
+    dq->pop = qdeque_pop;
+    dq->steal = qdeque_steal;
+
+    dq->size = qdeque_size;
+    dq->free = qdeque_free;
+
+    return dq;
+}
+
+/**
+ * qdeque->push(): Push an item at the bottom. Owner thread only.
+ *
+ * @param dq    qdeque_t container pointer.
+ * @param item  item pointer. It's stored as it is, not copied.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - ENOMEM : Memory allocation failure.
+ */
+bool qdeque_push(qdeque_t *dq, void *item) {
+    if (item == NULL) {
+        errno = EINVAL;
+        return false;
+    }
+
+    int64_t b = __atomic_load_n(&dq->bottom, __ATOMIC_RELAXED);
+    int64_t t = __atomic_load_n(&dq->top, __ATOMIC_ACQUIRE);
+    qdeque_array_t *a = __atomic_load_n((qdeque_array_t **) &dq->array,
+                                        __ATOMIC_RELAXED);
+    if (b - t > a->size - 1) {
+        a = grow_array(dq, a, t, b);
+        if (a == NULL) {
+            errno = ENOMEM;
+            return false;
+        }
+    }
+    __atomic_store_n(&a->items[b & (a->size - 1)], item, __ATOMIC_RELAXED);
+    __atomic_store_n(&dq->bottom, b + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+/**
+ * qdeque->pop(): Take the item at the bottom. Owner thread only.
+ *
+ * @param dq    qdeque_t container pointer.
+ *
+ * @return the most recently pushed item, otherwise returns NULL.
+ * @retval errno will be set in error condition.
+ *  - ENOENT : Deque is empty.
+ */
+void *qdeque_pop(qdeque_t *dq) {
+    int64_t b = __atomic_load_n(&dq->bottom, __ATOMIC_RELAXED) - 1;
+    qdeque_array_t *a = __atomic_load_n((qdeque_array_t **) &dq->array,
+                                        __ATOMIC_RELAXED);
+    __atomic_store_n(&dq->bottom, b, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t t = __atomic_load_n(&dq->top, __ATOMIC_RELAXED);
+
+    void *item = NULL;
+    if (t <= b) {
+        item = __atomic_load_n(&a->items[b & (a->size - 1)], __ATOMIC_RELAXED);
+        if (t == b) {
+            // the last one, race against the thieves
+            if (!__atomic_compare_exchange_n(&dq->top, &t, t + 1, false,
+                                             __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+                item = NULL;
+            }
+            __atomic_store_n(&dq->bottom, b + 1, __ATOMIC_RELAXED);
+        }
+    } else {
+        __atomic_store_n(&dq->bottom, b + 1, __ATOMIC_RELAXED);
+    }
+
+    if (item == NULL) {
+        errno = ENOENT;
+    }
+    return item;
+}
+
+/**
+ * qdeque->steal(): Take the item at the top. Any thread.
+ *
+ * @param dq    qdeque_t container pointer.
+ *
+ * @return the oldest item, otherwise returns NULL.
+ * @retval errno will be set in error condition.
+ *  - ENOENT : Deque is empty.
+ *  - EAGAIN : Lost the race against another thread, try again.
+ */
+void *qdeque_steal(qdeque_t *dq) {
+    int64_t t = __atomic_load_n(&dq->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t b = __atomic_load_n(&dq->bottom, __ATOMIC_ACQUIRE);
+    if (t >= b) {
+        errno = ENOENT;
+        return NULL;
+    }
+
+    qdeque_array_t *a = __atomic_load_n((qdeque_array_t **) &dq->array,
+                                        __ATOMIC_ACQUIRE);
+    void *item = __atomic_load_n(&a->items[t & (a->size - 1)], __ATOMIC_RELAXED);
+    if (!__atomic_compare_exchange_n(&dq->top, &t, t + 1, false,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+        errno = EAGAIN;
+        return NULL;
+    }
+
+    return item;
+}
+
+/**
+ * qdeque->size(): Returns the number of items in the deque.
+ *
+ * @param dq    qdeque_t container pointer.
+ *
+ * @return the number of items. It can be stale when other threads are
+ *  working on the deque.
+ */
+size_t qdeque_size(qdeque_t *dq) {
+    int64_t b = __atomic_load_n(&dq->bottom, __ATOMIC_ACQUIRE);
+    int64_t t = __atomic_load_n(&dq->top, __ATOMIC_ACQUIRE);
+    return (b > t) ? (size_t) (b - t) : 0;
+}
+
+/**
+ * qdeque->free(): Free the deque. The items are not freed.
+ *
+ * @param dq    qdeque_t container pointer.
+ */
+void qdeque_free(qdeque_t *dq) {
+    qdeque_array_t *a = (qdeque_array_t *) dq->retired;
+    while (a != NULL) {
+        qdeque_array_t *next = a->next;
+        free(a);
+        a = next;
+    }
+    free(dq->array);
+    free(dq);
+}
+
+#ifndef _DOXYGEN_SKIP
+
+static qdeque_array_t *new_array(int64_t size) {
+    qdeque_array_t *a = (qdeque_array_t *) calloc(1, sizeof(qdeque_array_t)
+                                                  + size * sizeof(void *));
+    if (a == NULL) {
+        return NULL;
+    }
+    a->size = size;
+    return a;
+}
+
+static qdeque_array_t *grow_array(qdeque_t *dq, qdeque_array_t *a,
+                                  int64_t top, int64_t bottom) {
+    qdeque_array_t *bigger = new_array(a->size * 2);
+    if (bigger == NULL) {
+        return NULL;
+    }
+
+    int64_t i;
+    for (i = top; i < bottom; i++) {
+        bigger->items[i & (bigger->size - 1)] =
+                __atomic_load_n(&a->items[i & (a->size - 1)], __ATOMIC_RELAXED);
+    }
+    __atomic_store_n((qdeque_array_t **) &dq->array, bigger, __ATOMIC_RELEASE);
+
+    // thieves may still be reading the old one
+    a->next = (qdeque_array_t *) dq->retired;
+    dq->retired = a;
+
+    return bigger;
+}
+
+#endif /* _DOXYGEN_SKIP */
@@ -33,25 +33,39 @@
  * fixed size static memory like shared-memory and memory-mapped file.
  * The creator qhasharr() initializes static memory to makes small slots in it.
  * The default slot size factors are defined in Q_HASHARR_NAMESIZE and
- * Q_HASHARR_DATASIZE. And they are applied at compile time.
+ * Q_HASHARR_DATASIZE, and qhasharr_ex() takes them at runtime instead. The
+ * geometry is stored in the table memory along with the slots.
  *
  * The value part of an element will be stored across several slots if it's size
  * exceeds the slot size. But the key part of an element will be truncated if
- * the size exceeds and it's length and more complex MD5 hash value will be
+ * the size exceeds and it's length and a 128-bit fingerprint of the key will be
  * stored with the key. So to look up a particular key, first we find an element
  * which has same hash value. If the key was not truncated, we just do key
  * comparison. But if the key was truncated because it's length exceeds, we do
- * both md5 and key comparison(only stored size) to verify that the key is same.
- * So please be aware of that, theoretically there is a possibility we pick
- * wrong element in case a key exceeds the limit, has same length and MD5 hash
- * with lookup key. But this possibility is very low and almost zero in practice.
- *
- * qhasharr hash-table does not provide thread-safe handling intentionally and
+ * both fingerprint and key comparison(only stored size) to verify that the key
+ * is same. So please be aware of that, theoretically there is a possibility we
+ * pick wrong element in case a key exceeds the limit, has same length and
+ * fingerprint with lookup key. But this possibility is very low and almost
+ * zero in practice. The fingerprint is MurmurHash3 128-bit, or MD5 in the
+ * tables of layout version 0.
+ *
+ * qhasharr hash-table does not provide thread-safe handling by default and
  * let users determine whether to provide locking mechanism or not, depending on
- * the use cases. When there's race conditions expected, you should provide a
- * shared resource control using mutex or semaphore to make sure data gets
+ * the use cases. A table created by qhasharr_ex() with QHASHARR_THREADSAFE
+ * option carries a read-write spin lock in its memory, so every process
+ * attached to it can look up the table in parallel while updates are done
+ * one at a time. The lock is built on atomic operations only, so it works
+ * across processes without any system resource. Otherwise you should provide
+ * a shared resource control using mutex or semaphore to make sure data gets
  * updated by one instance at a time.
  *
+ * With QHASHARR_CACHE option, the table works as a fixed-memory cache. A put
+ * into a full table evicts entries in CLOCK order, an approximation of LRU,
+ * until the new one fits in. Every lookup marks the entry as recently used,
+ * and the eviction spares marked entries once, clearing the mark. Entries
+ * put by put_ttl() expire after the given seconds, so they are not found
+ * any more and taken first by the eviction.
+ *
  * @code
  *  [Data Structure Diagram]
  *
@@ -112,6 +126,10 @@
  *
  *  (...your codes with your own locking mechanism...)
  *
+ *  // or let the table lock itself
+ *  // qhasharr_t *tbl = qhasharr_ex(memory, memsize, Q_HASHARR_NAMESIZE,
+ *  //                               Q_HASHARR_DATASIZE, QHASHARR_THREADSAFE);
+ *
  *  // Release reference object
  *  tbl->free(tbl);
  *
@@ -138,31 +156,61 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <inttypes.h>
 #include <stdarg.h>
 #include <string.h>
 #include <errno.h>
 #include <assert.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 #include "qinternal.h"
 #include "utilities/qhash.h"
+#include "utilities/qio.h"
 #include "containers/qhasharr.h"
 
 #define COLLISION_MARK    (-1)
 #define EXTBLOCK_MARK     (-2)
 
+#define LOCK_WRITER       (0x80000000U)  /* held by a writer */
+#define LOCK_WAITING      (0x40000000U)  /* a writer is waiting */
+#define LOCK_SPINS        (100)          /* spins before yielding the CPU */
+
 #ifndef _DOXYGEN_SKIP
 
-static qhasharr_slot_t* get_slots(qhasharr_t *tbl);
+static size_t get_slotsize(int namesize, int datasize);
+static qhasharr_slot_t *get_slot(qhasharr_t *tbl, int idx);
+static uint8_t *get_slotdata(qhasharr_slot_t *slot);
 static int find_avail(qhasharr_t *tbl, int startidx);
 static int get_idx(qhasharr_t *tbl, const void *name, size_t namesize,
-                   uint32_t hash);
+                   const unsigned char *namefp, uint32_t hash);
+static void get_fingerprint(qhasharr_t *tbl, const void *name,
+                            size_t namesize, unsigned char *namefp);
 static void *get_data(qhasharr_t *tbl, int idx, size_t *size);
-static bool put_data(qhasharr_t *tbl, int idx, uint32_t hash, const void *name,
-                     size_t namesize, const void *data, size_t datasize,
-                     int count);
+static bool put_entry(qhasharr_t *tbl, const void *name, size_t namesize,
+                      const void *data, size_t datasize, uint32_t expire);
+static bool put_obj(qhasharr_t *tbl, uint32_t keyhash, const void *name,
+                    size_t namesize, const unsigned char *namefp,
+                    const void *data, size_t datasize, uint32_t expire);
+static bool put_data(qhasharr_t *tbl, int idx, uint32_t hash,
+                     uint32_t keyhash, const void *name, size_t namesize,
+                     const unsigned char *namefp, const void *data,
+                     size_t datasize, uint32_t expire, int count);
 static bool copy_slot(qhasharr_t *tbl, int idx1, int idx2);
 static bool remove_slot(qhasharr_t *tbl, int idx);
 static bool remove_data(qhasharr_t *tbl, int idx);
+static bool remove_idx(qhasharr_t *tbl, int idx);
+static bool is_expired(qhasharr_slot_t *slot, uint32_t now);
+static bool evict_one(qhasharr_t *tbl);
+static void lock_read(qhasharr_t *tbl);
+static void lock_write(qhasharr_t *tbl);
+static void unlock_read(qhasharr_t *tbl);
+static void unlock_write(qhasharr_t *tbl);
+static void count_lock(qhasharr_t *tbl, uint64_t waitstart);
 
 #endif
 
@@ -175,10 +223,26 @@ static bool remove_data(qhasharr_t *tbl, int idx);
  *
  * @note
  *  This can be used for calculating minimum memory size for N slots.
+ *  The slots take the default geometry, Q_HASHARR_NAMESIZE and
+ *  Q_HASHARR_DATASIZE.
  */
 size_t qhasharr_calculate_memsize(int max) {
+    return qhasharr_calculate_memsize_ex(max, Q_HASHARR_NAMESIZE,
+                                         Q_HASHARR_DATASIZE);
+}
+
+/**
+ * Get how much memory is needed for N slots of the given geometry.
+ *
+ * @param max       a number of maximum internal slots
+ * @param namesize  key bytes kept in a slot.
+ * @param datasize  value bytes kept in the leading slot of a key.
+ *
+ * @return memory size needed
+ */
+size_t qhasharr_calculate_memsize_ex(int max, int namesize, int datasize) {
     size_t memsize = sizeof(qhasharr_data_t)
-            + (sizeof(qhasharr_slot_t) * (max));
+            + (get_slotsize(namesize, datasize) * (max));
     return memsize;
 }
 
@@ -196,7 +260,7 @@ size_t qhasharr_calculate_memsize(int max) {
  * @code
  *  // initialize hash-table with 100 slots.
  *  // A single element can take several slots.
- *  char memory[112 * 100];
+ *  char memory[qhasharr_calculate_memsize(100)];
  *
  *  // Initialize new table.
  *  qhasharr_t *tbl = qhasharr(memory, sizeof(memory));
@@ -206,14 +270,66 @@ size_t qhasharr_calculate_memsize(int max) {
  * @endcode
  */
 qhasharr_t *qhasharr(void *memory, size_t memsize) {
+    return qhasharr_ex(memory, memsize, Q_HASHARR_NAMESIZE, Q_HASHARR_DATASIZE,
+                       0);
+}
+
+/**
+ * Initialize static hash table with the given slot geometry.
+ *
+ * Keys longer than namesize are truncated and verified with their MD5 hash,
+ * and values longer than datasize continue in linked slots. So sizing the
+ * slots to the typical key and value lengths saves both lookups and space.
+ * The geometry and the options are stored in the memory, so other processes
+ * can attach to it with qhasharr(memory, 0).
+ *
+ * @param memory    a pointer of data memory.
+ * @param memsize   a size of data memory, 0 for using existing data.
+ * @param namesize  key bytes kept in a slot. Ignored if memsize is 0.
+ * @param datasize  value bytes kept in the leading slot of a key.
+ *                  Ignored if memsize is 0.
+ * @param options   combination of initialization options.
+ *                  Ignored if memsize is 0.
+ *
+ * @return qhasharr_t container pointer, otherwise returns NULL.
+ * @retval errno  will be set in error condition.
+ *  - EINVAL : Invalid slot geometry or the memory is too small to allocate
+ *  at least 1 slot. Or the existing data has a newer layout version.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @code
+ *  // 64 bytes keys and 200 bytes values
+ *  size_t memsize = qhasharr_calculate_memsize_ex(1000, 64, 200);
+ *  void *memory = malloc(memsize);
+ *  qhasharr_t *tbl = qhasharr_ex(memory, memsize, 64, 200, 0);
+ * @endcode
+ *
+ * @note
+ *   Available options:
+ *   - QHASHARR_THREADSAFE - make the table process-safe. Lookups and
+ *     getnext() run in parallel and the updates are exclusive. A process
+ *     terminated in the middle of an update leaves the table locked, so
+ *     the others will wait forever on it.
+ *   - QHASHARR_CACHE - evict old entries to make room when the table is
+ *     full, instead of failing with ENOBUFS.
+ */
+qhasharr_t *qhasharr_ex(void *memory, size_t memsize, int namesize,
+                        int datasize, int options) {
     // Structure memory.
     qhasharr_data_t *tbldata = (qhasharr_data_t *) memory;
 
     // Initialize data if memsize is set or use existing data.
     if (memsize > 0) {
+        if (namesize < 1 || datasize < 1
+            || namesize + datasize > UINT16_MAX) {
+            errno = EINVAL;
+            return NULL;
+        }
+
         // calculate max
-        int maxslots = (memsize - sizeof(qhasharr_data_t))
-                / sizeof(qhasharr_slot_t);
+        size_t slotsize = get_slotsize(namesize, datasize);
+        int maxslots = (memsize > sizeof(qhasharr_data_t)) ?
+                (memsize - sizeof(qhasharr_data_t)) / slotsize : 0;
         if (maxslots < 1 || memsize <= sizeof(qhasharr_t)) {
             errno = EINVAL;
             return NULL;
@@ -224,6 +340,14 @@ qhasharr_t *qhasharr(void *memory, size_t memsize) {
         tbldata->maxslots = maxslots;
         tbldata->usedslots = 0;
         tbldata->num = 0;
+        tbldata->namesize = namesize;
+        tbldata->datasize = datasize;
+        tbldata->slotsize = slotsize;
+        tbldata->version = Q_HASHARR_VERSION;
+        tbldata->options = options;
+    } else if (tbldata->version > Q_HASHARR_VERSION) {
+        errno = EINVAL;
+        return NULL;
     }
 
     // Create the table object.
@@ -239,6 +363,7 @@ qhasharr_t *qhasharr(void *memory, size_t memsize) {
     tbl->putstr = qhasharr_putstr;
     tbl->putstrf = qhasharr_putstrf;
     tbl->put_by_obj = qhasharr_put_by_obj;
+    tbl->put_ttl = qhasharr_put_ttl;
 
     tbl->get = qhasharr_get;
     tbl->getstr = qhasharr_getstr;
@@ -252,11 +377,105 @@ qhasharr_t *qhasharr(void *memory, size_t memsize) {
 
     tbl->size = qhasharr_size;
     tbl->clear = qhasharr_clear;
+    tbl->grow = qhasharr_grow;
+    tbl->save = qhasharr_save;
     tbl->debug = qhasharr_debug;
+    tbl->stats = qhasharr_stats;
 
     tbl->free = qhasharr_free;
 
+    tbl->set_hash = qhasharr_set_hash;
+
     tbl->data = tbldata;
+    tbl->hashfunc = qhashmurmur3_32;
+
+    return tbl;
+}
+
+/**
+ * Map a table file saved by qhasharr->save() for read-only lookups.
+ *
+ * The file is mapped into memory as it is and queried in place, so there's
+ * no loading time whatever the size is, and the pages are shared in the
+ * page cache by all the processes mapping the same file.
+ *
+ * @param filepath  table file path.
+ *
+ * @return qhasharr_t container pointer, otherwise returns NULL.
+ * @retval errno  will be set in error condition.
+ *  - EINVAL : Not a table file, truncated or a newer layout version.
+ *  - ENOMEM : Memory allocation failure.
+ *  - and errors of open() and mmap().
+ *
+ * @code
+ *  // build offline
+ *  qhasharr_t *tbl = qhasharr(memory, memsize);
+ *  (...put entries...)
+ *  tbl->save(tbl, "/var/lib/geo.tbl");
+ *
+ *  // look up in every process
+ *  qhasharr_t *tbl = qhasharr_map("/var/lib/geo.tbl");
+ *  char *country = tbl->getstr(tbl, ip);
+ *  free(country);
+ *  tbl->free(tbl);  // unmaps the file
+ * @endcode
+ *
+ * @note
+ *  The updating calls fail with EROFS, and the table is read without
+ *  locking. The file is in the host byte order and doesn't record the hash
+ *  function, so set the same hash function with set_hash() if it's not the
+ *  default one. A new version of the file can be saved over it while it's
+ *  mapped, the mapping processes keep seeing the old one until re-mapped.
+ */
+qhasharr_t *qhasharr_map(const char *filepath) {
+    if (filepath == NULL) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    int fd = open(filepath, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return NULL;
+    }
+    if (st.st_size < (off_t) sizeof(qhasharr_data_t)) {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    size_t mapsize = st.st_size;
+    void *map = mmap(NULL, mapsize, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return NULL;
+
+    // the geometry must add up to the file size.
+    qhasharr_data_t *tbldata = (qhasharr_data_t *) map;
+    if (tbldata->maxslots < 1 || tbldata->namesize < 1 || tbldata->datasize < 1
+            || tbldata->namesize + tbldata->datasize > UINT16_MAX
+            || (size_t) tbldata->slotsize
+                    != get_slotsize(tbldata->namesize, tbldata->datasize)
+            || mapsize < qhasharr_calculate_memsize_ex(tbldata->maxslots,
+                                                       tbldata->namesize,
+                                                       tbldata->datasize)) {
+        munmap(map, mapsize);
+        errno = EINVAL;
+        return NULL;
+    }
+    madvise(map, mapsize, MADV_RANDOM);
+
+    qhasharr_t *tbl = qhasharr_ex(map, 0, 0, 0, 0);
+    if (tbl == NULL) {
+        int errnobak = errno;
+        munmap(map, mapsize);
+        errno = errnobak;
+        return NULL;
+    }
+    tbl->mapsize = mapsize;
 
     return tbl;
 }
@@ -343,85 +562,39 @@ bool qhasharr_putstrf(qhasharr_t *tbl, const char *name, const char *format, ...
  */
 bool qhasharr_put_by_obj(qhasharr_t *tbl, const void *name, size_t namesize,
                          const void *data, size_t datasize) {
-    if (tbl == NULL || name == NULL || namesize == 0 || data == NULL
-            || datasize == 0) {
-        errno = EINVAL;
-        return false;
-    }
-
-    qhasharr_data_t *tbldata = tbl->data;
-    qhasharr_slot_t *tblslots = get_slots(tbl);
+    return put_entry(tbl, name, namesize, data, datasize, 0);
+}
 
-    // check full
-    if (tbldata->usedslots >= tbldata->maxslots) {
-        errno = ENOBUFS;
+/**
+ * qhasharr->put_ttl(): Put an object into this table which expires after
+ * the given seconds.
+ *
+ * @param tbl       qhasharr_t container pointer.
+ * @param key       key string
+ * @param value     value object data
+ * @param size      size of value
+ * @param ttl       seconds to keep the object, must be bigger than 0.
+ *
+ * @return true if successful, otherwise returns false
+ * @retval errno will be set in error condition.
+ *  - ENOBUFS   : Table doesn't have enough space to store the object.
+ *  - EINVAL    : Invalid argument.
+ *  - EFAULT    : Unexpected error. Data structure is not constant.
+ *
+ * @note
+ *  An expired object is not returned by get() and getnext(), but it stays
+ *  in the table taking slots until it's overwritten, removed or evicted.
+ */
+bool qhasharr_put_ttl(qhasharr_t *tbl, const char *name, const void *data,
+                      size_t datasize, int ttl) {
+    if (ttl <= 0) {
+        errno = EINVAL;
         return false;
     }
 
-    // get hash integer
-    uint32_t hash = qhashmurmur3_32(name, namesize) % tbldata->maxslots;
-
-    // check, is slot empty
-    if (tblslots[hash].count == 0) {  // empty slot
-        // put data
-        if (put_data(tbl, hash, hash, name, namesize, data, datasize,
-                     1) == false) {
-            return false;
-        }
-    } else if (tblslots[hash].count > 0) {  // same key or hash collision
-        // check same key;
-        int idx = get_idx(tbl, name, namesize, hash);
-        if (idx >= 0) {  // same key
-            // remove and recall
-            qhasharr_remove_by_idx(tbl, idx);
-            return qhasharr_put_by_obj(tbl, name, namesize, data, datasize);
-        } else {  // no same key but hash collision
-            // find empty slot
-            int idx = find_avail(tbl, hash);
-            if (idx < 0) {
-                errno = ENOBUFS;
-                return false;
-            }
-
-            // put data. -1 is used for collision resolution (idx != hash);
-            if (put_data(tbl, idx, hash, name, namesize, data, datasize,
-                         COLLISION_MARK) == false) {
-                return false;
-            }
-
-            // increase counter from leading slot
-            tblslots[hash].count++;
-        }
-    } else {
-        // collision key or extended block
-
-        // find empty slot
-        int idx = find_avail(tbl, hash + 1);
-        if (idx < 0) {
-            errno = ENOBUFS;
-            return false;
-        }
-
-        // move the slot
-        copy_slot(tbl, idx, hash);
-        remove_slot(tbl, hash);
-
-        // adjust the link chain
-        if (tblslots[idx].link != -1) {
-            tblslots[tblslots[idx].link].hash = idx;
-        }
-        if (tblslots[idx].count == EXTBLOCK_MARK) {
-            tblslots[tblslots[idx].hash].link = idx;
-        }
-
-        // store data
-        if (put_data(tbl, hash, hash, name, namesize, data, datasize,
-                     1) == false) {
-            return false;
-        }
-    }
-
-    return true;
+    uint32_t expire = (uint32_t) time(NULL) + ttl;
+    return put_entry(tbl, name, (name) ? strlen(name) + 1 : 0, data, datasize,
+                     expire);
 }
 
 /**
@@ -491,16 +664,27 @@ void *qhasharr_get_by_obj(qhasharr_t *tbl, const void *name, size_t namesize,
     }
 
     qhasharr_data_t *tbldata = tbl->data;
+    uint32_t keyhash = tbl->hashfunc(name, namesize);
+
+    lock_read(tbl);
 
     // get hash integer
-    uint32_t hash = qhashmurmur3_32(name, namesize) % tbldata->maxslots;
-    int idx = get_idx(tbl, name, namesize, hash);
-    if (idx < 0) {
-        errno = ENOENT;
-        return NULL;
+    uint32_t hash = keyhash % tbldata->maxslots;
+    int idx = get_idx(tbl, name, namesize, NULL, hash);
+    if (idx >= 0) {
+        qhasharr_slot_t *slot = get_slot(tbl, idx);
+        if (is_expired(slot, (uint32_t) time(NULL))) {
+            idx = -1;
+        } else if ((tbldata->options & QHASHARR_CACHE) && tbl->mapsize == 0) {
+            // readers may mark it at the same time.
+            __atomic_store_n(&slot->clock, 1, __ATOMIC_RELAXED);
+        }
     }
+    void *data = get_data(tbl, idx, datasize);
 
-    return get_data(tbl, idx, datasize);
+    unlock_read(tbl);
+
+    return data;
 }
 
 /**
@@ -537,18 +721,29 @@ bool qhasharr_remove_by_obj(qhasharr_t *tbl, const char *name, size_t namesize)
         errno = EINVAL;
         return false;
     }
+    if (tbl->mapsize > 0) {
+        errno = EROFS;
+        return false;
+    }
 
     qhasharr_data_t *tbldata = tbl->data;
+    uint32_t keyhash = tbl->hashfunc(name, namesize);
+
+    lock_write(tbl);
 
     // get hash integer
-    uint32_t hash = qhashmurmur3_32(name, namesize) % tbldata->maxslots;
-    int idx = get_idx(tbl, name, namesize, hash);
+    uint32_t hash = keyhash % tbldata->maxslots;
+    int idx = get_idx(tbl, name, namesize, NULL, hash);
+    bool ret = false;
     if (idx < 0) {
         errno = ENOENT;
-        return false;
+    } else {
+        ret = remove_idx(tbl, idx);
     }
 
-    return qhasharr_remove_by_idx(tbl, idx);
+    unlock_write(tbl);
+
+    return ret;
 }
 
 /**
@@ -589,60 +784,20 @@ bool qhasharr_remove_by_obj(qhasharr_t *tbl, const char *name, size_t namesize)
  * slot index again. Please refer an example code.
  */
 bool qhasharr_remove_by_idx(qhasharr_t *tbl, int idx) {
-    if (idx < 0) {
+    if (tbl == NULL || idx < 0) {
         errno = EINVAL;
         return false;
     }
-
-    qhasharr_data_t *tbldata = tbl->data;
-    qhasharr_slot_t *tblslots = get_slots(tbl);
-
-    if (tblslots[idx].count == 1) {
-        // just remove
-        remove_data(tbl, idx);
-    } else if (tblslots[idx].count > 1) {  // leading slot and has collision
-        // find the collision key
-        int idx2;
-        for (idx2 = idx + 1;; idx2++) {
-            if (idx2 >= tbldata->maxslots)
-                idx2 = 0;
-            if (idx2 == idx) {
-                errno = EFAULT;
-                return false;
-            }
-            if (tblslots[idx2].count == COLLISION_MARK
-                    && tblslots[idx2].hash == tblslots[idx].hash) {
-                break;
-            }
-        }
-
-        // move to leading slot
-        int backupcount = tblslots[idx].count;
-        remove_data(tbl, idx);  // remove leading data
-        copy_slot(tbl, idx, idx2);  // copy slot
-        remove_slot(tbl, idx2);  // remove moved slot
-
-        tblslots[idx].count = backupcount - 1;  // adjust collision counter
-        if (tblslots[idx].link != -1) {
-            tblslots[tblslots[idx].link].hash = idx;
-        }
-
-    } else if (tblslots[idx].count == COLLISION_MARK) {  // collision key
-        // decrease counter from leading slot
-        if (tblslots[tblslots[idx].hash].count <= 1) {
-            errno = EFAULT;
-            return false;
-        }
-        tblslots[tblslots[idx].hash].count--;
-
-        // remove data
-        remove_data(tbl, idx);
-    } else {
-        errno = ENOENT;
+    if (tbl->mapsize > 0) {
+        errno = EROFS;
         return false;
     }
 
-    return true;
+    lock_write(tbl);
+    bool ret = remove_idx(tbl, idx);
+    unlock_write(tbl);
+
+    return ret;
 }
 
 /**
@@ -671,7 +826,7 @@ bool qhasharr_remove_by_idx(qhasharr_t *tbl, int idx) {
  * @note
  *  Please be aware a key name will be returned with truncated length
  *  because key name gets truncated if it doesn't fit into slot size,
- *  Q_HASHARR_NAMESIZE.
+ *  the key size of the slot geometry. Expired objects are skipped.
  */
 bool qhasharr_getnext(qhasharr_t *tbl, qhasharr_obj_t *obj, int *idx) {
     if (tbl == NULL || obj == NULL || idx == NULL) {
@@ -680,36 +835,43 @@ bool qhasharr_getnext(qhasharr_t *tbl, qhasharr_obj_t *obj, int *idx) {
     }
 
     qhasharr_data_t *tbldata = tbl->data;
-    qhasharr_slot_t *tblslots = get_slots(tbl);
 
+    uint32_t now = (uint32_t) time(NULL);
+    lock_read(tbl);
     for (; *idx < tbldata->maxslots; (*idx)++) {
-        if (tblslots[*idx].count == 0 || tblslots[*idx].count == EXTBLOCK_MARK) {
+        qhasharr_slot_t *slot = get_slot(tbl, *idx);
+        if (slot->count == 0 || slot->count == EXTBLOCK_MARK
+                || is_expired(slot, now)) {
             continue;
         }
 
-        size_t namesize = tblslots[*idx].data.pair.namesize;
-        if (namesize > Q_HASHARR_NAMESIZE)
-            namesize = Q_HASHARR_NAMESIZE;
+        size_t namesize = slot->namesize;
+        if (namesize > (size_t) tbldata->namesize)
+            namesize = tbldata->namesize;
 
         obj->name = malloc(namesize + 1);
         if (obj->name == NULL) {
+            unlock_read(tbl);
             errno = ENOMEM;
             return false;
         }
-        memcpy(obj->name, tblslots[*idx].data.pair.name, namesize);
+        memcpy(obj->name, slot->data + tbldata->datasize, namesize);
         memcpy(obj->name + namesize, "", 1); // for truncated case
         obj->namesize = namesize;
 
         obj->data = get_data(tbl, *idx, &obj->datasize);
         if (obj->data == NULL) {
+            unlock_read(tbl);
             free(obj->name);
             errno = ENOMEM;
             return false;
         }
 
+        unlock_read(tbl);
         *idx += 1;
         return true;
     }
+    unlock_read(tbl);
 
     errno = ENOENT;
     return false;
@@ -722,7 +884,8 @@ bool qhasharr_getnext(qhasharr_t *tbl, qhasharr_obj_t *obj, int *idx) {
  * @param maxslots  if not NULL, total number of slots will be stored.
  * @param usedslots if not NULL, total number of used slots will be stored.
  *
- * @return a number of elements stored.
+ * @return a number of elements stored, including the expired ones which
+ *         are not evicted yet.
  */
 int qhasharr_size(qhasharr_t *tbl, int *maxslots, int *usedslots) {
     if (tbl == NULL) {
@@ -732,12 +895,15 @@ int qhasharr_size(qhasharr_t *tbl, int *maxslots, int *usedslots) {
 
     qhasharr_data_t *tbldata = tbl->data;
 
+    lock_read(tbl);
     if (maxslots != NULL)
         *maxslots = tbldata->maxslots;
     if (usedslots != NULL)
         *usedslots = tbldata->usedslots;
+    int num = tbldata->num;
+    unlock_read(tbl);
 
-    return tbldata->num;
+    return num;
 }
 
 /**
@@ -752,19 +918,195 @@ void qhasharr_clear(qhasharr_t *tbl) {
         errno = EINVAL;
         return;
     }
+    if (tbl->mapsize > 0) {
+        errno = EROFS;
+        return;
+    }
 
     qhasharr_data_t *tbldata = tbl->data;
-    qhasharr_slot_t *tblslots = get_slots(tbl);
 
-    if (tbldata->usedslots == 0)
-        return;
+    lock_write(tbl);
+    if (tbldata->usedslots > 0) {
+        tbldata->usedslots = 0;
+        tbldata->num = 0;
+
+        // clear memory
+        memset((void *) get_slot(tbl, 0), '\0',
+               ((size_t) tbldata->maxslots * tbldata->slotsize));
+    }
+    unlock_write(tbl);
+}
+
+/**
+ * qhasharr->grow(): Move the table into a larger memory.
+ *
+ * All the objects are rehashed into the new memory with the same slot
+ * geometry, except the expired ones, then the table switches over to it. The old memory is left
+ * untouched, so it can be released once every process sharing the table
+ * has re-attached to the new memory with qhasharr(memory, 0).
+ *
+ * @param tbl       qhasharr_t container pointer.
+ * @param memory    a pointer of new data memory.
+ * @param memsize   a size of new data memory.
+ *
+ * @return true if successful, otherwise returns false and the table stays
+ *         on the old memory.
+ * @retval errno will be set in error condition.
+ *  - EINVAL    : Invalid argument, the new memory overlaps the current one
+ *                or doesn't have more slots.
+ *  - ENOBUFS   : Objects don't fit into the new memory.
+ *  - ENOMEM    : Memory allocation failure.
+ *
+ * @code
+ *  int maxslots, usedslots;
+ *  tbl->size(tbl, &maxslots, &usedslots);
+ *  if (usedslots > maxslots * 8 / 10) {
+ *      size_t newsize = qhasharr_calculate_memsize(maxslots * 2);
+ *      void *newmem = malloc(newsize);
+ *      if (tbl->grow(tbl, newmem, newsize)) {
+ *          free(oldmem);
+ *      }
+ *  }
+ * @endcode
+ *
+ * @note
+ *  It takes O(n) and other users of the table must be kept out with the
+ *  same locking mechanism used for updates. A QHASHARR_THREADSAFE table
+ *  keeps the old memory locked for updates while moving, but the other
+ *  processes keep using the old memory until they re-attach, so they must
+ *  be told to do so before their next update.
+ */
+bool qhasharr_grow(qhasharr_t *tbl, void *memory, size_t memsize) {
+    if (tbl == NULL || memory == NULL) {
+        errno = EINVAL;
+        return false;
+    }
+    if (tbl->mapsize > 0) {
+        errno = EROFS;
+        return false;
+    }
+
+    qhasharr_data_t *tbldata = tbl->data;
+    char *oldmem = (char *) tbldata;
+    char *oldend = (char *) get_slot(tbl, tbldata->maxslots);
+    if ((char *) memory < oldend && (char *) memory + memsize > oldmem) {
+        errno = EINVAL;
+        return false;
+    }
+    if (memsize < qhasharr_calculate_memsize_ex(tbldata->maxslots + 1,
+                                                tbldata->namesize,
+                                                tbldata->datasize)) {
+        errno = EINVAL;
+        return false;
+    }
+
+    // build the new table aside, using the same hash function.
+    qhasharr_data_t *newdata = (qhasharr_data_t *) memory;
+    memset(memory, 0, memsize);
+    newdata->maxslots = (memsize - sizeof(qhasharr_data_t)) / tbldata->slotsize;
+    newdata->namesize = tbldata->namesize;
+    newdata->datasize = tbldata->datasize;
+    newdata->slotsize = tbldata->slotsize;
+    newdata->version = tbldata->version;
+    newdata->options = tbldata->options;
+    newdata->clockhand = 0;
+    qhasharr_t newtbl = *tbl;
+    newtbl.data = newdata;
+
+    // the new memory is not visible to others yet, so no lock is needed.
+    lock_write(tbl);
+    uint32_t now = (uint32_t) time(NULL);
+    bool ret = true;
+    int idx;
+    for (idx = 0; ret == true && idx < tbldata->maxslots; idx++) {
+        qhasharr_slot_t *slot = get_slot(tbl, idx);
+        if (slot->count == 0 || slot->count == EXTBLOCK_MARK
+                || is_expired(slot, now)) {
+            continue;
+        }
+
+        // a truncated key is moved as it's stored, with its MD5 hash.
+        size_t datasize;
+        void *data = get_data(tbl, idx, &datasize);
+        if (data == NULL) {
+            ret = false;
+            break;
+        }
+        ret = put_obj(&newtbl, slot->keyhash, slot->data + tbldata->datasize,
+                      slot->namesize, slot->namefp, data, datasize,
+                      slot->expire);
+        free(data);
+    }
+    unlock_write(tbl);
+
+    if (ret == false) {
+        return false;
+    }
+
+    tbl->data = newdata;
+    tbl->resizes++;
+    return true;
+}
+
+/**
+ * qhasharr->save(): Save the table into a file to be mapped with
+ * qhasharr_map().
+ *
+ * @param tbl       qhasharr_t container pointer.
+ * @param filepath  table file path.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - ENOMEM : Memory allocation failure.
+ *  - and errors of mkstemp(), write(), fdatasync() and rename().
+ *
+ * @note
+ *  The table memory is written as it is into a temporary file next to the
+ *  filepath, which is renamed over it when complete. So the processes
+ *  mapping an older file are never exposed to a partial one.
+ */
+bool qhasharr_save(qhasharr_t *tbl, const char *filepath) {
+    if (tbl == NULL || filepath == NULL) {
+        errno = EINVAL;
+        return false;
+    }
 
-    tbldata->usedslots = 0;
-    tbldata->num = 0;
+    char *tmppath;
+    int fd = _q_tmpfile_create(filepath, &tmppath);
+    if (fd < 0) {
+        return false;
+    }
 
-    // clear memory
-    memset((void *) tblslots, '\0',
-           (tbldata->maxslots * sizeof(qhasharr_slot_t)));
+    // the header goes without the lock state of this process.
+    lock_read(tbl);
+    qhasharr_data_t tbldata = *tbl->data;
+    tbldata.lock = 0;
+    size_t slotsize = (size_t) tbldata.maxslots * tbldata.slotsize;
+    bool ret = (qio_write(fd, &tbldata, sizeof(tbldata), -1)
+                    == (ssize_t) sizeof(tbldata)
+                && qio_write(fd, get_slot(tbl, 0), slotsize, -1)
+                    == (ssize_t) slotsize);
+    unlock_read(tbl);
+
+    return _q_tmpfile_finish(fd, tmppath, filepath, ret, true);
+}
+
+/**
+ * qhasharr->set_hash(): Set the hash function of the keys.
+ *
+ * @param tbl       qhasharr_t container pointer.
+ * @param hashfunc  a pointer to the hash function.
+ *
+ * @note
+ *  By default, qhasharr uses qhashmurmur3_32(). The hash function decides
+ *  the slot of each key, so it must be set before any key is stored and
+ *  every process sharing the table memory must set the same function right
+ *  after attaching to it.
+ */
+void qhasharr_set_hash(qhasharr_t *tbl,
+                       uint32_t (*hashfunc)(const void *data, size_t nbytes)) {
+    tbl->hashfunc = (hashfunc != NULL) ? hashfunc : qhashmurmur3_32;
 }
 
 /**
@@ -788,14 +1130,14 @@ bool qhasharr_debug(qhasharr_t *tbl, FILE *out) {
         return false;
     }
 
-    qhasharr_slot_t *tblslots = get_slots(tbl);
 
+    qhasharr_data_t *tbldata = tbl->data;
     int idx = 0;
     qhasharr_obj_t obj;
     while (tbl->getnext(tbl, &obj, &idx) == true) {
-        uint16_t namesize = tblslots[idx - 1].data.pair.namesize;
+        uint16_t namesize = get_slot(tbl, idx - 1)->namesize;
         _q_textout(out, obj.name, obj.namesize, MAX_HUMANOUT);
-        fprintf(out, "%s(%d)=", (namesize > Q_HASHARR_NAMESIZE) ? "..." : "",
+        fprintf(out, "%s(%d)=", (namesize > tbldata->namesize) ? "..." : "",
                 namesize);
         _q_textout(out, obj.data, obj.datasize, MAX_HUMANOUT);
         fprintf(out, " (%zu)\n", obj.datasize);
@@ -805,50 +1147,110 @@ bool qhasharr_debug(qhasharr_t *tbl, FILE *out) {
     }
 
 #ifdef BUILD_DEBUG
-    qhasharr_data_t *tbldata = tbl->data;
-    fprintf(out, "%d elements (slot %d used/%d total)\n",
-            tbldata->num, tbldata->usedslots, tbldata->maxslots);
+    lock_read(tbl);
+    fprintf(out, "%d elements (slot %d used/%d total, key %d/value %d bytes)\n",
+            tbldata->num, tbldata->usedslots, tbldata->maxslots,
+            tbldata->namesize, tbldata->datasize);
     for (idx = 0; idx < tbldata->maxslots; idx++) {
-        if (tblslots[idx].count == 0) continue;
+        qhasharr_slot_t *slot = get_slot(tbl, idx);
+        if (slot->count == 0) continue;
 
         fprintf(out, "slot=%d,type=", idx);
-        if (tblslots[idx].count == EXTBLOCK_MARK) {
+        if (slot->count == EXTBLOCK_MARK) {
             fprintf(out, "EXTEND");
-            fprintf(out, ",prev=%d", tblslots[idx].hash);
-            fprintf(out, ",next=%d", tblslots[idx].link);
-            fprintf(out, ",datasize=%d", tblslots[idx].datasize);
+            fprintf(out, ",prev=%d", slot->hash);
+            fprintf(out, ",next=%d", slot->link);
+            fprintf(out, ",datasize=%d", slot->datasize);
             fprintf(out, ",data=");
             _q_textout(out,
-                    tblslots[idx].data.ext.data,
-                    tblslots[idx].datasize,
+                    get_slotdata(slot),
+                    slot->datasize,
                     MAX_HUMANOUT);
         } else {
-            fprintf(out, "%s", (tblslots[idx].count == COLLISION_MARK)?"COLISN":"NORMAL");
-            fprintf(out, ",next=%d", tblslots[idx].link);
-            fprintf(out, ",count=%d", tblslots[idx].count);
-            fprintf(out, ",hash=%u", tblslots[idx].hash);
-            fprintf(out, ",namesize=%d", tblslots[idx].data.pair.namesize);
-            fprintf(out, ",datasize=%d", tblslots[idx].datasize);
+            fprintf(out, "%s", (slot->count == COLLISION_MARK)?"COLISN":"NORMAL");
+            fprintf(out, ",next=%d", slot->link);
+            fprintf(out, ",count=%d", slot->count);
+            fprintf(out, ",hash=%u", slot->hash);
+            fprintf(out, ",namesize=%d", slot->namesize);
+            fprintf(out, ",datasize=%d", slot->datasize);
             fprintf(out, ",name=");
             _q_textout(out,
-                    tblslots[idx].data.pair.name,
-                    (tblslots[idx].data.pair.namesize>Q_HASHARR_NAMESIZE)
-                    ? Q_HASHARR_NAMESIZE
-                    : tblslots[idx].data.pair.namesize,
+                    slot->data + tbldata->datasize,
+                    (slot->namesize > tbldata->namesize)
+                    ? tbldata->namesize
+                    : slot->namesize,
                     MAX_HUMANOUT);
             fprintf(out, ",data=");
             _q_textout(out,
-                    tblslots[idx].data.pair.data,
-                    tblslots[idx].datasize,
+                    slot->data,
+                    slot->datasize,
                     MAX_HUMANOUT);
         }
         fprintf(out, "\n");
     }
+    unlock_read(tbl);
 #endif
 
     return true;
 }
 
+/**
+ * qhasharr->stats(): Get runtime statistics of this table.
+ *
+ * @param tbl       qhasharr_t container pointer.
+ * @param stats     qstats_t structure to fill in.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *
+ * @code
+ *  qstats_t stats;
+ *  tbl->stats(tbl, &stats);
+ *  if (stats.usedslots > stats.slots * 8 / 10 || stats.maxprobe > 16) {
+ *      // time to grow the table.
+ *  }
+ * @endcode
+ *
+ * @note
+ *  The probes of a key is the distance of its slot from the home slot,
+ *  which is what a lookup scans, and the extended data blocks taking the
+ *  slots are counted in usedslots only. The shape is of the shared memory
+ *  but the counters are of this qhasharr_t handle, so each process
+ *  attached to the table counts its own operations. The lock counters are
+ *  given with QHASHARR_THREADSAFE.
+ */
+bool qhasharr_stats(qhasharr_t *tbl, qstats_t *stats) {
+    if (tbl == NULL || stats == NULL) {
+        errno = EINVAL;
+        return false;
+    }
+    memset((void *) stats, 0, sizeof(qstats_t));
+
+    lock_read(tbl);
+    qhasharr_data_t *tbldata = tbl->data;
+    stats->num = tbldata->num;
+    stats->slots = tbldata->maxslots;
+    stats->usedslots = tbldata->usedslots;
+    int idx;
+    for (idx = 0; idx < tbldata->maxslots; idx++) {
+        qhasharr_slot_t *slot = get_slot(tbl, idx);
+        if (slot->count > 0 || slot->count == COLLISION_MARK) {
+            _q_stats_probe(stats, ((size_t) idx + tbldata->maxslots - slot->hash)
+                                  % tbldata->maxslots);
+        }
+    }
+    stats->collisions = tbl->collisions;
+    stats->resizes = tbl->resizes;
+    stats->evictions = tbl->evictions;
+    stats->locks = __atomic_load_n(&tbl->locks, __ATOMIC_RELAXED);
+    stats->contended = __atomic_load_n(&tbl->contended, __ATOMIC_RELAXED);
+    stats->lockwait = __atomic_load_n(&tbl->waitns, __ATOMIC_RELAXED);
+    unlock_read(tbl);
+
+    return true;
+}
+
 /**
  * qhasharr->free(): De-allocate table reference object.
  *
@@ -857,29 +1259,48 @@ bool qhasharr_debug(qhasharr_t *tbl, FILE *out) {
  * @note
  *  This does not de-allocate the data memory but only the memory of
  *  qhasharr struct. User provided data memory must be de-allocated
- *  by user.
+ *  by user. A table from qhasharr_map() is unmapped.
  */
 void qhasharr_free(qhasharr_t *tbl) {
+    if (tbl->mapsize > 0) {
+        munmap(tbl->data, tbl->mapsize);
+    }
     free(tbl);
 }
 
 #ifndef _DOXYGEN_SKIP
 
-static qhasharr_slot_t* get_slots(qhasharr_t *tbl) {
-    return (qhasharr_slot_t*) ((char*) (tbl->data) + sizeof(qhasharr_data_t));
+// slot header followed by the value then the key, aligned for the header.
+static size_t get_slotsize(int namesize, int datasize) {
+    size_t size = offsetof(qhasharr_slot_t, data) + namesize + datasize;
+    size_t align = sizeof(uint64_t);
+    return (size + align - 1) / align * align;
+}
+
+static qhasharr_slot_t *get_slot(qhasharr_t *tbl, int idx) {
+    qhasharr_data_t *tbldata = tbl->data;
+    return (qhasharr_slot_t *) ((char *) tbldata + sizeof(qhasharr_data_t)
+                                + (size_t) tbldata->slotsize * idx);
+}
+
+// the value of an extended data block takes the key area as well.
+static uint8_t *get_slotdata(qhasharr_slot_t *slot) {
+    if (slot->count == EXTBLOCK_MARK) {
+        return (uint8_t *) &slot->keyhash;
+    }
+    return slot->data;
 }
 
 // find empty slot : return empty slow number, otherwise returns -1.
 static int find_avail(qhasharr_t *tbl, int startidx) {
     qhasharr_data_t *tbldata = tbl->data;
-    qhasharr_slot_t *tblslots = get_slots(tbl);
 
     if (startidx >= tbldata->maxslots)
         startidx = 0;
 
     int idx = startidx;
     while (true) {
-        if (tblslots[idx].count == 0)
+        if (get_slot(tbl, idx)->count == 0)
             return idx;
 
         idx++;
@@ -893,36 +1314,37 @@ static int find_avail(qhasharr_t *tbl, int startidx) {
 }
 
 static int get_idx(qhasharr_t *tbl, const void *name, size_t namesize,
-                   uint32_t hash) {
+                   const unsigned char *namefp, uint32_t hash) {
     qhasharr_data_t *tbldata = tbl->data;
-    qhasharr_slot_t *tblslots = get_slots(tbl);
+    qhasharr_slot_t *leadslot = get_slot(tbl, hash);
 
-    if (tblslots[hash].count > 0) {
+    if (leadslot->count > 0) {
+        unsigned char fpbuf[16];
         int count, idx;
-        for (count = 0, idx = hash; count < tblslots[hash].count;) {
-            if (tblslots[idx].hash == hash
-                    && (tblslots[idx].count > 0 || tblslots[idx].count == COLLISION_MARK)) {
+        for (count = 0, idx = hash; count < leadslot->count;) {
+            qhasharr_slot_t *slot = get_slot(tbl, idx);
+            if (slot->hash == hash
+                    && (slot->count > 0 || slot->count == COLLISION_MARK)) {
                 // same hash
                 count++;
 
                 // is same key?
                 // first check key length
-                if (namesize == tblslots[idx].data.pair.namesize) {
-                    if (namesize <= Q_HASHARR_NAMESIZE) {
+                uint8_t *slotname = slot->data + tbldata->datasize;
+                if (namesize == slot->namesize) {
+                    if (namesize <= (size_t) tbldata->namesize) {
                         // original key is stored
-                        if (!memcmp(name, tblslots[idx].data.pair.name,
-                                    namesize)) {
+                        if (!memcmp(name, slotname, namesize)) {
                             return idx;
                         }
                     } else {
                         // key is truncated, compare MD5 also.
-                        unsigned char namemd5[16];
-                        qhashmd5(name, namesize, namemd5);
-                        if (!memcmp(name, tblslots[idx].data.pair.name,
-                        Q_HASHARR_NAMESIZE)
-                                && !memcmp(namemd5,
-                                           tblslots[idx].data.pair.namemd5,
-                                           16)) {
+                        if (namefp == NULL) {
+                            get_fingerprint(tbl, name, namesize, fpbuf);
+                            namefp = fpbuf;
+                        }
+                        if (!memcmp(name, slotname, tbldata->namesize)
+                                && !memcmp(namefp, slot->namefp, 16)) {
                             return idx;
                         }
                     }
@@ -945,19 +1367,29 @@ static int get_idx(qhasharr_t *tbl, const void *name, size_t namesize,
     return -1;
 }
 
+// only truncated keys need a fingerprint.
+static void get_fingerprint(qhasharr_t *tbl, const void *name,
+                            size_t namesize, unsigned char *namefp) {
+    if (namesize <= (size_t) tbl->data->namesize) {
+        memset(namefp, 0, 16);
+    } else if (tbl->data->version == 0) {
+        qhashmd5(name, namesize, namefp);
+    } else {
+        qhashmurmur3_128(name, namesize, namefp);
+    }
+}
+
 static void *get_data(qhasharr_t *tbl, int idx, size_t *size) {
     if (idx < 0) {
         errno = ENOENT;
         return NULL;
     }
 
-    qhasharr_slot_t *tblslots = get_slots(tbl);
-
     int newidx;
     size_t datasize;
-    for (newidx = idx, datasize = 0;; newidx = tblslots[newidx].link) {
-        datasize += tblslots[newidx].datasize;
-        if (tblslots[newidx].link == -1)
+    for (newidx = idx, datasize = 0;; newidx = get_slot(tbl, newidx)->link) {
+        datasize += get_slot(tbl, newidx)->datasize;
+        if (get_slot(tbl, newidx)->link == -1)
             break;
     }
 
@@ -967,19 +1399,12 @@ static void *get_data(qhasharr_t *tbl, int idx, size_t *size) {
         return NULL;
     }
 
-    for (newidx = idx, dp = data;; newidx = tblslots[newidx].link) {
-        if (tblslots[newidx].count == EXTBLOCK_MARK) {
-            // extended data block
-            memcpy(dp, (void *) tblslots[newidx].data.ext.data,
-                   tblslots[newidx].datasize);
-        } else {
-            // key/value pair data block
-            memcpy(dp, (void *) tblslots[newidx].data.pair.data,
-                   tblslots[newidx].datasize);
-        }
+    for (newidx = idx, dp = data;; newidx = get_slot(tbl, newidx)->link) {
+        qhasharr_slot_t *slot = get_slot(tbl, newidx);
+        memcpy(dp, (void *) get_slotdata(slot), slot->datasize);
 
-        dp += tblslots[newidx].datasize;
-        if (tblslots[newidx].link == -1)
+        dp += slot->datasize;
+        if (slot->link == -1)
             break;
     }
 
@@ -988,25 +1413,139 @@ static void *get_data(qhasharr_t *tbl, int idx, size_t *size) {
     return data;
 }
 
-static bool put_data(qhasharr_t *tbl, int idx, uint32_t hash, const void *name,
-                     size_t namesize, const void *data, size_t datasize,
-                     int count) {
+static bool put_entry(qhasharr_t *tbl, const void *name, size_t namesize,
+                      const void *data, size_t datasize, uint32_t expire) {
+    if (tbl == NULL || name == NULL || namesize == 0 || data == NULL
+            || datasize == 0) {
+        errno = EINVAL;
+        return false;
+    }
+    if (tbl->mapsize > 0) {
+        errno = EROFS;
+        return false;
+    }
+
+    uint32_t keyhash = tbl->hashfunc(name, namesize);
+    unsigned char namefp[16];
+    get_fingerprint(tbl, name, namesize, namefp);
+
+    lock_write(tbl);
+    bool ret;
+    while ((ret = put_obj(tbl, keyhash, name, namesize, namefp, data, datasize,
+                          expire)) == false) {
+        // make room in cache mode and try again.
+        if (errno != ENOBUFS || !(tbl->data->options & QHASHARR_CACHE)
+                || evict_one(tbl) == false) {
+            break;
+        }
+    }
+    unlock_write(tbl);
+
+    return ret;
+}
+
+static bool put_obj(qhasharr_t *tbl, uint32_t keyhash, const void *name,
+                    size_t namesize, const unsigned char *namefp,
+                    const void *data, size_t datasize, uint32_t expire) {
     qhasharr_data_t *tbldata = tbl->data;
-    qhasharr_slot_t *tblslots = get_slots(tbl);
 
-    assert(tblslots[idx].count == 0);
+    // check full
+    if (tbldata->usedslots >= tbldata->maxslots) {
+        errno = ENOBUFS;
+        return false;
+    }
+
+    // get hash integer
+    uint32_t hash = keyhash % tbldata->maxslots;
+    qhasharr_slot_t *leadslot = get_slot(tbl, hash);
+
+    // check, is slot empty
+    if (leadslot->count == 0) {  // empty slot
+        // put data
+        if (put_data(tbl, hash, hash, keyhash, name, namesize, namefp, data,
+                     datasize, expire, 1) == false) {
+            return false;
+        }
+    } else if (leadslot->count > 0) {  // same key or hash collision
+        // check same key;
+        int idx = get_idx(tbl, name, namesize, namefp, hash);
+        if (idx >= 0) {  // same key
+            // remove and recall
+            remove_idx(tbl, idx);
+            return put_obj(tbl, keyhash, name, namesize, namefp, data,
+                           datasize, expire);
+        } else {  // no same key but hash collision
+            // find empty slot
+            int idx = find_avail(tbl, hash);
+            if (idx < 0) {
+                errno = ENOBUFS;
+                return false;
+            }
+
+            // put data. -1 is used for collision resolution (idx != hash);
+            if (put_data(tbl, idx, hash, keyhash, name, namesize, namefp,
+                         data, datasize, expire, COLLISION_MARK) == false) {
+                return false;
+            }
+            tbl->collisions++;
+
+            // increase counter from leading slot
+            leadslot->count++;
+        }
+    } else {
+        // collision key or extended block
+
+        // find empty slot
+        int idx = find_avail(tbl, hash + 1);
+        if (idx < 0) {
+            errno = ENOBUFS;
+            return false;
+        }
+
+        // move the slot
+        copy_slot(tbl, idx, hash);
+        remove_slot(tbl, hash);
+
+        // adjust the link chain
+        qhasharr_slot_t *slot = get_slot(tbl, idx);
+        if (slot->link != -1) {
+            get_slot(tbl, slot->link)->hash = idx;
+        }
+        if (slot->count == EXTBLOCK_MARK) {
+            get_slot(tbl, slot->hash)->link = idx;
+        }
 
-    unsigned char namemd5[16];
-    qhashmd5(name, namesize, namemd5);
+        // store data
+        if (put_data(tbl, hash, hash, keyhash, name, namesize, namefp, data,
+                     datasize, expire, 1) == false) {
+            return false;
+        }
+        tbl->collisions++;
+    }
+
+    return true;
+}
+
+static bool put_data(qhasharr_t *tbl, int idx, uint32_t hash,
+                     uint32_t keyhash, const void *name, size_t namesize,
+                     const unsigned char *namefp, const void *data,
+                     size_t datasize, uint32_t expire, int count) {
+    qhasharr_data_t *tbldata = tbl->data;
+    qhasharr_slot_t *slot = get_slot(tbl, idx);
+
+    assert(slot->count == 0);
 
     // store name
-    tblslots[idx].count = count;
-    tblslots[idx].hash = hash;
-    memcpy(tblslots[idx].data.pair.name, name,
-           (namesize < Q_HASHARR_NAMESIZE) ? namesize : Q_HASHARR_NAMESIZE);
-    memcpy((char *) tblslots[idx].data.pair.namemd5, (char *) namemd5, 16);
-    tblslots[idx].data.pair.namesize = namesize;
-    tblslots[idx].link = -1;
+    slot->count = count;
+    slot->hash = hash;
+    slot->keyhash = keyhash;
+    memcpy(slot->data + tbldata->datasize, name,
+           (namesize < (size_t) tbldata->namesize) ? namesize : (size_t) tbldata->namesize);
+    memcpy((char *) slot->namefp, (char *) namefp, 16);
+    slot->namesize = namesize;
+    slot->link = -1;
+    slot->expire = expire;
+    slot->clock = 1;
 
     // store data
     int newidx;
@@ -1021,36 +1560,39 @@ static bool put_data(qhasharr_t *tbl, int idx, uint32_t hash, const void *name,
             }
 
             // clear & set
-            memset((void *) (&tblslots[tmpidx]), '\0', sizeof(qhasharr_slot_t));
+            qhasharr_slot_t *extslot = get_slot(tbl, tmpidx);
+            memset((void *) extslot, '\0', tbldata->slotsize);
 
-            tblslots[tmpidx].count = EXTBLOCK_MARK; // extended data block
-            tblslots[tmpidx].hash = newidx;   // previous link
-            tblslots[tmpidx].link = -1;       // end block mark
-            tblslots[tmpidx].datasize = 0;
-            tblslots[newidx].link = tmpidx;   // link chain
+            extslot->count = EXTBLOCK_MARK; // extended data block
+            extslot->hash = newidx;   // previous link
+            extslot->link = -1;       // end block mark
+            extslot->datasize = 0;
+            get_slot(tbl, newidx)->link = tmpidx;   // link chain
 
             newidx = tmpidx;
         }
 
         // copy data
+        qhasharr_slot_t *dataslot = get_slot(tbl, newidx);
         size_t copysize = datasize - savesize;
-        if (tblslots[newidx].count == EXTBLOCK_MARK) {
-            // extended value
-            if (copysize > sizeof(struct Q_HASHARR_SLOT_EXT)) {
-                copysize = sizeof(struct Q_HASHARR_SLOT_EXT);
+        if (dataslot->count == EXTBLOCK_MARK) {
+            // extended value takes the key area as well
+            size_t maxsize = tbldata->slotsize
+                    - offsetof(qhasharr_slot_t, keyhash);
+            if (copysize > maxsize) {
+                copysize = maxsize;
             }
-            memcpy(tblslots[newidx].data.ext.data, data + savesize, copysize);
         } else {
             // first slot
-            if (copysize > Q_HASHARR_DATASIZE) {
-                copysize = Q_HASHARR_DATASIZE;
+            if (copysize > (size_t) tbldata->datasize) {
+                copysize = tbldata->datasize;
             }
-            memcpy(tblslots[newidx].data.pair.data, data + savesize, copysize);
 
             // increase stored key counter
             tbldata->num++;
         }
-        tblslots[newidx].datasize = copysize;
+        memcpy(get_slotdata(dataslot), data + savesize, copysize);
+        dataslot->datasize = copysize;
         savesize += copysize;
 
         // increase used slot counter
@@ -1061,34 +1603,30 @@ static bool put_data(qhasharr_t *tbl, int idx, uint32_t hash, const void *name,
 }
 
 static bool copy_slot(qhasharr_t *tbl, int idx1, int idx2) {
-    qhasharr_slot_t *tblslots = get_slots(tbl);
-
-    if (tblslots[idx1].count != 0 || tblslots[idx2].count == 0) {
+    if (get_slot(tbl, idx1)->count != 0 || get_slot(tbl, idx2)->count == 0) {
         errno = EFAULT;
         return false;
     }
 
-    memcpy((void *) (&tblslots[idx1]), (void *) (&tblslots[idx2]),
-           sizeof(qhasharr_slot_t));
+    memcpy((void *) get_slot(tbl, idx1), (void *) get_slot(tbl, idx2),
+           tbl->data->slotsize);
 
     return true;
 }
 
 static bool remove_slot(qhasharr_t *tbl, int idx) {
-    qhasharr_slot_t *tblslots = get_slots(tbl);
-    assert(tblslots[idx].count != 0);
+    assert(get_slot(tbl, idx)->count != 0);
 
-    tblslots[idx].count = 0;
+    get_slot(tbl, idx)->count = 0;
     return true;
 }
 
 static bool remove_data(qhasharr_t *tbl, int idx) {
     qhasharr_data_t *tbldata = tbl->data;
-    qhasharr_slot_t *tblslots = get_slots(tbl);
-    assert(tblslots[idx].count != 0);
+    assert(get_slot(tbl, idx)->count != 0);
 
     while (true) {
-        int link = tblslots[idx].link;
+        int link = get_slot(tbl, idx)->link;
         remove_slot(tbl, idx);
         tbldata->usedslots--;
 
@@ -1104,4 +1642,175 @@ static bool remove_data(qhasharr_t *tbl, int idx) {
     return true;
 }
 
+static bool remove_idx(qhasharr_t *tbl, int idx) {
+    qhasharr_data_t *tbldata = tbl->data;
+
+    if (get_slot(tbl, idx)->count == 1) {
+        // just remove
+        remove_data(tbl, idx);
+    } else if (get_slot(tbl, idx)->count > 1) {  // leading slot and has collision
+        // find the collision key
+        int idx2;
+        for (idx2 = idx + 1;; idx2++) {
+            if (idx2 >= tbldata->maxslots)
+                idx2 = 0;
+            if (idx2 == idx) {
+                errno = EFAULT;
+                return false;
+            }
+            if (get_slot(tbl, idx2)->count == COLLISION_MARK
+                    && get_slot(tbl, idx2)->hash == get_slot(tbl, idx)->hash) {
+                break;
+            }
+        }
+
+        // move to leading slot
+        int backupcount = get_slot(tbl, idx)->count;
+        remove_data(tbl, idx);  // remove leading data
+        copy_slot(tbl, idx, idx2);  // copy slot
+        remove_slot(tbl, idx2);  // remove moved slot
+
+        get_slot(tbl, idx)->count = backupcount - 1;  // adjust collision counter
+        if (get_slot(tbl, idx)->link != -1) {
+            get_slot(tbl, get_slot(tbl, idx)->link)->hash = idx;
+        }
+
+    } else if (get_slot(tbl, idx)->count == COLLISION_MARK) {  // collision key
+        // decrease counter from leading slot
+        if (get_slot(tbl, get_slot(tbl, idx)->hash)->count <= 1) {
+            errno = EFAULT;
+            return false;
+        }
+        get_slot(tbl, get_slot(tbl, idx)->hash)->count--;
+
+        // remove data
+        remove_data(tbl, idx);
+    } else {
+        errno = ENOENT;
+        return false;
+    }
+
+    return true;
+}
+
+static bool is_expired(qhasharr_slot_t *slot, uint32_t now) {
+    return (slot->expire != 0 && slot->expire <= now);
+}
+
+// evict an entry in CLOCK order. entries marked by lookups get a second
+// chance, so it finds one within two rounds.
+static bool evict_one(qhasharr_t *tbl) {
+    qhasharr_data_t *tbldata = tbl->data;
+    if (tbldata->num == 0)
+        return false;
+
+    uint32_t now = (uint32_t) time(NULL);
+    int idx = tbldata->clockhand, n;
+    for (n = 0; n < tbldata->maxslots * 2; n++) {
+        if (idx >= tbldata->maxslots)
+            idx = 0;
+
+        qhasharr_slot_t *slot = get_slot(tbl, idx);
+        if (slot->count != 0 && slot->count != EXTBLOCK_MARK) {
+            if (slot->clock == 0 || is_expired(slot, now)) {
+                // a collision entry may move into this slot, so keep the
+                // hand here.
+                tbldata->clockhand = idx;
+                tbl->evictions++;
+                return remove_idx(tbl, idx);
+            }
+            slot->clock = 0;
+        }
+        idx++;
+    }
+
+    errno = EFAULT;
+    return false;
+}
+
+// read-write spin lock over atomic operations, which works between processes
+// sharing the memory. writers are preferred not to get starved by readers.
+static void lock_read(qhasharr_t *tbl) {
+    qhasharr_data_t *tbldata = tbl->data;
+    if (!(tbldata->options & QHASHARR_THREADSAFE) || tbl->mapsize > 0)
+        return;
+
+    uint64_t waitstart = 0;
+    int spins;
+    for (spins = 0;; spins++) {
+        uint32_t lock = __atomic_load_n(&tbldata->lock, __ATOMIC_RELAXED);
+        if (!(lock & (LOCK_WRITER | LOCK_WAITING))
+                && __atomic_compare_exchange_n(&tbldata->lock, &lock, lock + 1,
+                                               true, __ATOMIC_ACQUIRE,
+                                               __ATOMIC_RELAXED)) {
+            count_lock(tbl, waitstart);
+            return;
+        }
+        if (waitstart == 0)
+            waitstart = _q_nanotime();
+        if (spins >= LOCK_SPINS) {
+            sched_yield();
+            spins = 0;
+        }
+    }
+}
+
+static void lock_write(qhasharr_t *tbl) {
+    qhasharr_data_t *tbldata = tbl->data;
+    if (!(tbldata->options & QHASHARR_THREADSAFE) || tbl->mapsize > 0)
+        return;
+
+    uint64_t waitstart = 0;
+    int spins;
+    for (spins = 0;; spins++) {
+        uint32_t lock = __atomic_load_n(&tbldata->lock, __ATOMIC_RELAXED);
+        if ((lock & ~LOCK_WAITING) == 0) {
+            // no owner, take it over clearing the waiting mark.
+            if (__atomic_compare_exchange_n(&tbldata->lock, &lock, LOCK_WRITER,
+                                            true, __ATOMIC_ACQUIRE,
+                                            __ATOMIC_RELAXED)) {
+                count_lock(tbl, waitstart);
+                return;
+            }
+        } else if (!(lock & LOCK_WAITING)) {
+            // hold off new readers.
+            __atomic_fetch_or(&tbldata->lock, LOCK_WAITING, __ATOMIC_RELAXED);
+        }
+        if (waitstart == 0)
+            waitstart = _q_nanotime();
+        if (spins >= LOCK_SPINS) {
+            sched_yield();
+            spins = 0;
+        }
+    }
+}
+
+static void unlock_read(qhasharr_t *tbl) {
+    qhasharr_data_t *tbldata = tbl->data;
+    if (!(tbldata->options & QHASHARR_THREADSAFE) || tbl->mapsize > 0)
+        return;
+
+    __atomic_fetch_sub(&tbldata->lock, 1, __ATOMIC_RELEASE);
+}
+
+static void unlock_write(qhasharr_t *tbl) {
+    qhasharr_data_t *tbldata = tbl->data;
+    if (!(tbldata->options & QHASHARR_THREADSAFE) || tbl->mapsize > 0)
+        return;
+
+    // keep the waiting mark of other writers.
+    __atomic_fetch_and(&tbldata->lock, ~LOCK_WRITER, __ATOMIC_RELEASE);
+}
+
+// count a lock acquisition into the counters of this handle. readers in
+// different threads may share the handle, so the counters are atomic.
+static void count_lock(qhasharr_t *tbl, uint64_t waitstart) {
+    __atomic_add_fetch(&tbl->locks, 1, __ATOMIC_RELAXED);
+    if (waitstart != 0) {
+        __atomic_add_fetch(&tbl->contended, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&tbl->waitns, _q_nanotime() - waitstart,
+                           __ATOMIC_RELAXED);
+    }
+}
+
 #endif /* _DOXYGEN_SKIP */
@@ -56,6 +56,74 @@
  *  [ 9 ] -> [hash=12439,key7=value]
  * @endcode
  *
+ * With QHASHTBL_OPENADDR option, qhashtbl uses open addressing instead. The
+ * objects are stored directly in a contiguous slot array and a collision is
+ * resolved by probing the following slots using the Robin Hood hashing
+ * strategy, which keeps probe sequences short and lets a lookup stop early.
+ * The hash value is stored inline in each slot, so most mismatches are
+ * rejected without touching the key string.
+ *
+ * @code
+ *  [Internal Structure Example for 8-slot open addressing hash table]
+ *
+ *  SLOT     OBJECT                     HOME SLOT (hash % range)
+ *  =====    ======================     =========
+ *  [ 0 ]    [hash=320,key3=value]      0
+ *  [ 1 ]    [hash=1,key1=value]        1
+ *  [ 2 ]    [hash=9,key9=value]        1
+ *  [ 3 ]    [hash=18,key8=value]       2
+ *  [ 4 ]
+ *  [ 5 ]    [hash=8545,key10=value]    5
+ *  [ 6 ]
+ *  [ 7 ]    [hash=12439,key7=value]    7
+ * @endcode
+ *
+ * With QHASHTBL_STRIPED option, the slots are split into a number of stripes
+ * and each stripe is protected by its own reader/writer lock, so operations
+ * on keys in different stripes, and lookups on the same stripe, can run
+ * concurrently. qhashtbl_lock() still locks the whole table.
+ *
+ * @code
+ *  STRIPE   SLOTS (slot index % number of stripes)
+ *  ======   =====
+ *  [ 0 ]    [ 0 ] [ 4 ] [ 8 ] ...
+ *  [ 1 ]    [ 1 ] [ 5 ] [ 9 ] ...
+ *  [ 2 ]    [ 2 ] [ 6 ] [10 ] ...
+ *  [ 3 ]    [ 3 ] [ 7 ] [11 ] ...
+ * @endcode
+ *
+ * With QHASHTBL_LOCKFREE_READ option, lookups don't take any lock at all.
+ * Writers are serialized by the table lock and never modify an object that
+ * readers can see; a new object is published instead and the old one is
+ * retired, then freed by a later writer once every reader that could have
+ * seen it has left its read section (epoch based reclamation). This suits
+ * tables which are read far more often than written.
+ *
+ * @code
+ *  qhashtbl_t *tbl = qhashtbl(0, QHASHTBL_LOCKFREE_READ);
+ *
+ *  // newmem=false pointers stay valid until the read section ends.
+ *  tbl->read_enter(tbl);
+ *  char *route = tbl->getstr(tbl, "/api", false);
+ *  (...use route...)
+ *  tbl->read_leave(tbl);
+ * @endcode
+ *
+ * Tables holding the same names over and over can share a qstrpool. The
+ * names are then interned in the pool instead of being copied into each
+ * object, and the lookups by an interned name and its hash from the pool
+ * match on the pointer without comparing the bytes.
+ *
+ * @code
+ *  qstrpool_t *pool = qstrpool(0, QSTRPOOL_THREADSAFE);
+ *  qhashtbl_t *tbl = qhashtbl(0, QHASHTBL_THREADSAFE);
+ *  tbl->set_strpool(tbl, pool);
+ *
+ *  uint32_t hash;
+ *  const char *name = pool->intern(pool, "host", 4, &hash);
+ *  char *host = tbl->get_by_obj(tbl, name, 4, hash, NULL, false);
+ * @endcode
+ *
  * @code
  *  // create a hash-table with 10 hash-index range.
  *  // Please be aware, the hash-index range 10 does not mean the number of
@@ -96,9 +164,86 @@
 #include <errno.h>
 #include "qinternal.h"
 #include "utilities/qhash.h"
+#include "utilities/qthreadpool.h"
 #include "containers/qhashtbl.h"
 
 #define DEFAULT_INDEX_RANGE (1000)  /*!< default value of hash-index range */
+#define DEFAULT_LOADFACTOR  (1.0)   /*!< default load factor threshold for resizing */
+#define REHASH_STEP         (4)     /*!< number of old slots migrated per operation */
+#define OPENADDR_LOADFACTOR (0.8)   /*!< default load factor for QHASHTBL_OPENADDR */
+#define DEFAULT_NUM_STRIPES (32)    /*!< number of stripes for QHASHTBL_STRIPED */
+#define BATCH_SIZE          (64)    /*!< number of keys prefetched together in batch calls */
+
+/* size of a chained object header, the data follows it suitably aligned */
+#define OBJ_HEADSIZE ((sizeof(qhashtbl_obj_t) + 15) & ~((size_t) 15))
+
+/* compare the key of an object, the name is compared only if the hash matches
+ * and it is not the very same pointer, which is the case for interned names */
+#define NAME_MATCH(obj, h, n, ns)                                       \
+    ((obj)->hash == (h) && (obj)->namesize == (ns)                      \
+     && ((const void *) (obj)->name == (const void *) (n)               \
+         || !memcmp((obj)->name, (n), (ns))))
+
+/* distance of the object in the given open slot from its home slot */
+#define PROBE_DISTANCE(tbl, idx)                                        \
+    (((idx) + (tbl)->range - ((tbl)->openslots[idx].hash & ((tbl)->range - 1))) \
+     & ((tbl)->range - 1))
+
+#ifndef _DOXYGEN_SKIP
+
+/* stripe locks for QHASHTBL_STRIPED */
+typedef struct qhashtbl_stripes_s {
+    size_t num;         /*!< number of stripes */
+    pthread_t owner;    /*!< thread holding the whole table locked */
+    int depth;          /*!< whole table lock depth */
+    uint64_t contended; /*!< stripe acquisitions which had to wait */
+    uint64_t waitns;    /*!< total wait time on the stripes in nanoseconds */
+    pthread_rwlock_t locks[];   /*!< stripe locks */
+} qhashtbl_stripes_t;
+
+static bool new_stripes(qhashtbl_t *tbl, size_t num);
+static void free_stripes(qhashtbl_t *tbl);
+static void lock_key(qhashtbl_t *tbl, uint32_t hash, bool write);
+static void unlock_key(qhashtbl_t *tbl, uint32_t hash, bool write);
+static void add_num(qhashtbl_t *tbl, int n);
+static void add_stat(qhashtbl_t *tbl, uint64_t *counter);
+
+static qhashtbl_obj_t *find_published(qhashtbl_t *tbl, uint32_t hash,
+                                      const void *name, size_t namesize);
+static void retire_obj(qhashtbl_t *tbl, qhashtbl_obj_t *obj);
+static void reclaim(qhashtbl_t *tbl);
+static qhashtbl_obj_t *new_obj(qhashtbl_t *tbl, qhashtbl_obj_t *slot,
+                               uint32_t hash, const void *name, size_t namesize,
+                               const void *data, size_t size);
+static void free_obj(qhashtbl_t *tbl, qhashtbl_obj_t *obj);
+static void free_retired(void *tbl, void *obj);
+
+static qhashtbl_obj_t **find_link(qhashtbl_t *tbl, uint32_t hash,
+                                  const void *name, size_t namesize);
+static void rehash(qhashtbl_t *tbl, size_t nslots);
+static void grow(qhashtbl_t *tbl);
+static qhashtbl_obj_t *find_openaddr(qhashtbl_t *tbl, uint32_t hash,
+                                     const void *name, size_t namesize);
+static void insert_openaddr(qhashtbl_t *tbl, qhashtbl_obj_t *obj);
+static void remove_openaddr(qhashtbl_t *tbl, qhashtbl_obj_t *obj);
+static bool grow_openaddr(qhashtbl_t *tbl);
+
+static size_t hash_batch(qhashtbl_t *tbl, const char *names[], size_t num,
+                         size_t *namesizes, uint32_t *hashes);
+static void prefetch_batch(qhashtbl_t *tbl, const uint32_t *hashes, size_t num);
+static void lock_batch(qhashtbl_t *tbl, bool write);
+static void unlock_batch(qhashtbl_t *tbl, bool write);
+
+typedef struct qhashtbl_parallel_s qhashtbl_parallel_t;
+struct qhashtbl_parallel_s {
+    qhashtbl_t *tbl;
+    void (*func)(const qhashtbl_obj_t *obj, void *userdata);
+    void *userdata;
+};
+
+static void foreach_slots(size_t begin, size_t end, void *userdata);
+
+#endif
 
 /**
  * Initialize hash table.
@@ -116,6 +261,12 @@
  *
  *  // create a large hash-table for millions of keys with thread-safe option.
  *  qhashtbl_t *small_hashtbl = qhashtbl(1000000, QHASHTBL_THREADSAFE);
+ *
+ *  // create a hash-table that grows as more keys are added.
+ *  qhashtbl_t *growing_hashtbl = qhashtbl(0, QHASHTBL_AUTORESIZE);
+ *
+ *  // create a cache-friendly open addressing hash-table.
+ *  qhashtbl_t *flat_hashtbl = qhashtbl(0, QHASHTBL_OPENADDR);
  * @endcode
  *
  * @note
@@ -123,20 +274,57 @@
  *   In practice, pick a value between (total keys / 3) ~ (total keys * 2).
  *   Available options:
  *   - QHASHTBL_THREADSAFE - make it thread-safe.
+ *   - QHASHTBL_AUTORESIZE - double the range when the number of keys exceeds
+ *                           range * load factor. Keys are migrated to the new
+ *                           slots a few at a time on each put/get/remove call
+ *                           so no single call pays for the whole rehash.
+ *   - QHASHTBL_OPENADDR   - use open addressing with a contiguous slot array.
+ *                           The range is rounded up to a power of 2 and the
+ *                           table always doubles its range when the load
+ *                           factor (default 0.8) is exceeded.
+ *   - QHASHTBL_STRIPED    - make it thread-safe with a reader/writer lock per
+ *                           stripe of slots instead of a single table lock.
+ *                           It implies QHASHTBL_THREADSAFE, and the hash range
+ *                           stays fixed so QHASHTBL_AUTORESIZE and
+ *                           QHASHTBL_OPENADDR are ignored.
+ *   - QHASHTBL_LOCKFREE_READ - make it thread-safe where get() takes no lock
+ *                           and writers are serialized by the table lock.
+ *                           It implies QHASHTBL_THREADSAFE, and the hash
+ *                           range stays fixed so QHASHTBL_AUTORESIZE,
+ *                           QHASHTBL_OPENADDR and QHASHTBL_STRIPED are
+ *                           ignored. Each table uses a pthread key.
  */
 qhashtbl_t *qhashtbl(size_t range, int options) {
     if (range == 0) {
         range = DEFAULT_INDEX_RANGE;
     }
 
+    if (options & QHASHTBL_LOCKFREE_READ) {
+        options |= QHASHTBL_THREADSAFE;
+        options &= ~(QHASHTBL_AUTORESIZE | QHASHTBL_OPENADDR | QHASHTBL_STRIPED);
+    }
+    if (options & QHASHTBL_STRIPED) {
+        options |= QHASHTBL_THREADSAFE;
+        options &= ~(QHASHTBL_AUTORESIZE | QHASHTBL_OPENADDR);
+    }
+
     qhashtbl_t *tbl = (qhashtbl_t *) calloc(1, sizeof(qhashtbl_t));
     if (tbl == NULL)
         goto malloc_failure;
 
     // allocate table space
-    tbl->slots = (qhashtbl_obj_t **) calloc(range, sizeof(qhashtbl_obj_t *));
-    if (tbl->slots == NULL)
-        goto malloc_failure;
+    if (options & QHASHTBL_OPENADDR) {
+        size_t n;
+        for (n = 1; n < range; n *= 2);
+        range = n;
+        tbl->openslots = (qhashtbl_obj_t *) calloc(range, sizeof(qhashtbl_obj_t));
+        if (tbl->openslots == NULL)
+            goto malloc_failure;
+    } else {
+        tbl->slots = (qhashtbl_obj_t **) calloc(range, sizeof(qhashtbl_obj_t *));
+        if (tbl->slots == NULL)
+            goto malloc_failure;
+    }
 
     // handle options.
     if (options & QHASHTBL_THREADSAFE) {
@@ -144,6 +332,21 @@ qhashtbl_t *qhashtbl(size_t range, int options) {
         if (tbl->qmutex == NULL)
             goto malloc_failure;
     }
+    if (options & QHASHTBL_STRIPED) {
+        if (new_stripes(tbl, (range < DEFAULT_NUM_STRIPES) ? range
+                                                            : DEFAULT_NUM_STRIPES) == false) {
+            Q_MUTEX_DESTROY(tbl->qmutex);
+            tbl->qmutex = NULL;
+            goto malloc_failure;
+        }
+    }
+    if (options & QHASHTBL_LOCKFREE_READ) {
+        if ((tbl->epoch = _q_epoch_new(tbl)) == NULL) {
+            Q_MUTEX_DESTROY(tbl->qmutex);
+            tbl->qmutex = NULL;
+            goto malloc_failure;
+        }
+    }
 
     // assign methods
     tbl->put = qhashtbl_put;
@@ -157,19 +360,41 @@ qhashtbl_t *qhashtbl(size_t range, int options) {
 
     tbl->remove = qhashtbl_remove;
 
+    tbl->put_by_obj = qhashtbl_put_by_obj;
+    tbl->get_by_obj = qhashtbl_get_by_obj;
+    tbl->remove_by_obj = qhashtbl_remove_by_obj;
+
+    tbl->getmulti = qhashtbl_getmulti;
+    tbl->putmulti = qhashtbl_putmulti;
+
     tbl->getnext = qhashtbl_getnext;
 
     tbl->size = qhashtbl_size;
     tbl->clear = qhashtbl_clear;
     tbl->debug = qhashtbl_debug;
+    tbl->stats = qhashtbl_stats;
 
     tbl->lock = qhashtbl_lock;
     tbl->unlock = qhashtbl_unlock;
 
     tbl->free = qhashtbl_free;
 
+    tbl->set_loadfactor = qhashtbl_set_loadfactor;
+    tbl->set_hash = qhashtbl_set_hash;
+    tbl->set_arena = qhashtbl_set_arena;
+    tbl->set_strpool = qhashtbl_set_strpool;
+    tbl->dump = qhashtbl_dump;
+    tbl->restore = qhashtbl_restore;
+
+    tbl->read_enter = qhashtbl_read_enter;
+    tbl->read_leave = qhashtbl_read_leave;
+
     // set table range.
     tbl->range = range;
+    tbl->options = options;
+    tbl->hashfunc = qhashmurmur3_32;
+    tbl->loadfactor = (options & QHASHTBL_OPENADDR) ? OPENADDR_LOADFACTOR
+                                                    : DEFAULT_LOADFACTOR;
 
     return tbl;
 
@@ -197,70 +422,124 @@ qhashtbl_t *qhashtbl(size_t range, int options) {
  */
 bool qhashtbl_put(qhashtbl_t *tbl, const char *name, const void *data,
                 size_t size) {
-    if (name == NULL || data == NULL) {
+    if (name == NULL) {
         errno = EINVAL;
         return false;
     }
 
-    // get hash integer
-    uint32_t hash = qhashmurmur3_32(name, strlen(name));
-    int idx = hash % tbl->range;
-
-    qhashtbl_lock(tbl);
+    size_t namesize = strlen(name);
+    return qhashtbl_put_by_obj(tbl, name, namesize,
+                               tbl->hashfunc(name, namesize), data, size);
+}
 
-    // find existence key
-    qhashtbl_obj_t *obj;
-    for (obj = tbl->slots[idx]; obj != NULL; obj = obj->next) {
-        if (obj->hash == hash && !strcmp(obj->name, name)) {
-            break;
-        }
+/**
+ * qhashtbl->put_by_obj(): Put an object into this table with a pre-hashed
+ * key of arbitrary binary data.
+ *
+ * @param tbl       qhashtbl_t container pointer.
+ * @param name      key data
+ * @param namesize  size of key data
+ * @param hash      hash value of the key by the table's hash function
+ * @param data      data object
+ * @param size      size of data object
+ *
+ * @return true if successful, otherwise returns false
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @code
+ *  uint32_t hash = qhashmurmur3_32(key, keylen);  // the default hash function
+ *  tbl->put_by_obj(tbl, key, keylen, hash, &obj, sizeof(obj));
+ *  void *data = tbl->get_by_obj(tbl, key, keylen, hash, NULL, false);
+ * @endcode
+ *
+ * @note
+ *  The key doesn't need to be NUL terminated and may contain NUL bytes.
+ *  A copy of the key is stored with a terminating NUL appended, so string
+ *  keys can be read back as obj.name with getnext(). Passing a hash value
+ *  other than the one computed by the table's hash function makes the key
+ *  unreachable from the string based calls.
+ */
+bool qhashtbl_put_by_obj(qhashtbl_t *tbl, const void *name, size_t namesize,
+                         uint32_t hash, const void *data, size_t size) {
+    if (name == NULL || data == NULL) {
+        errno = EINVAL;
+        return false;
     }
 
-    // duplicate object
-    char *dupname = strdup(name);
-    void *dupdata = malloc(size);
-    if (dupname == NULL || dupdata == NULL) {
-        free(dupname);
-        free(dupdata);
-        qhashtbl_unlock(tbl);
-        errno = ENOMEM;
-        return false;
+    lock_key(tbl, hash, true);
+    rehash(tbl, REHASH_STEP);
+
+    // find existence key
+    qhashtbl_obj_t *obj, **link = NULL;
+    if (tbl->openslots != NULL) {
+        obj = find_openaddr(tbl, hash, name, namesize);
+    } else {
+        link = find_link(tbl, hash, name, namesize);
+        obj = (link != NULL) ? *link : NULL;
     }
-    memcpy(dupdata, data, size);
 
     // put into table
-    if (obj == NULL) {
-        // insert
-        obj = (qhashtbl_obj_t *) calloc(1, sizeof(qhashtbl_obj_t));
-        if (obj == NULL) {
-            free(dupname);
-            free(dupdata);
-            qhashtbl_unlock(tbl);
+    if (obj == NULL && tbl->openslots != NULL) {
+        // insert into an open slot
+        qhashtbl_obj_t newobj;
+        if (grow_openaddr(tbl) == false
+            || new_obj(tbl, &newobj, hash, name, namesize, data, size) == NULL) {
+            unlock_key(tbl, hash, true);
+            errno = ENOMEM;
+            return false;
+        }
+        if (tbl->openslots[hash & (tbl->range - 1)].name != NULL) {
+            add_stat(tbl, &tbl->collisions);
+        }
+        insert_openaddr(tbl, &newobj);
+        add_num(tbl, 1);
+    } else if (obj != NULL && tbl->openslots != NULL) {
+        // replace in place, the slot only refers to its data block
+        qhashtbl_obj_t newobj;
+        if (new_obj(tbl, &newobj, hash, name, namesize, data, size) == NULL) {
+            unlock_key(tbl, hash, true);
+            errno = ENOMEM;
+            return false;
+        }
+        Q_ARENA_FREE(tbl->arena, obj->data);
+        add_stat(tbl, &tbl->frees);
+        obj->name = newobj.name;
+        obj->data = newobj.data;
+        obj->size = size;
+    } else {
+        // insert, or replace by publishing a new object since the name and
+        // the data live in the object allocation and readers in lock-free
+        // read mode may be looking at the old one.
+        qhashtbl_obj_t *newobj = new_obj(tbl, NULL, hash, name, namesize, data, size);
+        if (newobj == NULL) {
+            unlock_key(tbl, hash, true);
             errno = ENOMEM;
             return false;
         }
 
-        if (tbl->slots[idx] != NULL) {
+        if (obj == NULL) {
             // insert at the beginning
-            obj->next = tbl->slots[idx];
-        }
-        tbl->slots[idx] = obj;
+            link = &tbl->slots[hash % tbl->range];
+            if (*link != NULL) {
+                add_stat(tbl, &tbl->collisions);
+            }
+            newobj->next = *link;
+            __atomic_store_n(link, newobj, __ATOMIC_RELEASE);
 
-        // increase counter
-        tbl->num++;
-    } else {
-        // replace
-        free(obj->name);
-        free(obj->data);
+            // increase counter
+            add_num(tbl, 1);
+            grow(tbl);
+        } else {
+            newobj->next = obj->next;
+            __atomic_store_n(link, newobj, __ATOMIC_RELEASE);
+            retire_obj(tbl, obj);
+            reclaim(tbl);
+        }
     }
 
-    // set data
-    obj->hash = hash;
-    obj->name = dupname;
-    obj->data = dupdata;
-    obj->size = size;
-
-    qhashtbl_unlock(tbl);
+    unlock_key(tbl, hash, true);
     return true;
 }
 
@@ -358,7 +637,9 @@ bool qhashtbl_putint(qhashtbl_t *tbl, const char *name, const int64_t num) {
  *  If newmem flag is set, returned data will be malloced and should be
  *  deallocated by user. Otherwise returned pointer will point internal buffer
  *  directly and should not be de-allocated by user. In thread-safe mode,
- *  newmem flag must be set to true always.
+ *  newmem flag must be set to true always, unless the call is made within
+ *  qhashtbl->read_enter() and qhashtbl->read_leave() where the returned
+ *  pointer stays valid until the read section ends.
  */
 void *qhashtbl_get(qhashtbl_t *tbl, const char *name, size_t *size, bool newmem) {
     if (name == NULL) {
@@ -366,17 +647,51 @@ void *qhashtbl_get(qhashtbl_t *tbl, const char *name, size_t *size, bool newmem)
         return NULL;
     }
 
-    uint32_t hash = qhashmurmur3_32(name, strlen(name));
-    int idx = hash % tbl->range;
+    size_t namesize = strlen(name);
+    return qhashtbl_get_by_obj(tbl, name, namesize,
+                               tbl->hashfunc(name, namesize), size, newmem);
+}
+
+/**
+ * qhashtbl->get_by_obj(): Get an object from this table with a pre-hashed
+ * key of arbitrary binary data.
+ *
+ * @param tbl       qhashtbl_t container pointer.
+ * @param name      key data
+ * @param namesize  size of key data
+ * @param hash      hash value of the key by the table's hash function
+ * @param size      if not NULL, oject size will be stored.
+ * @param newmem    whether or not to allocate memory for the data.
+ *
+ * @return a pointer of data if the key is found, otherwise returns NULL.
+ * @retval errno will be set in error condition.
+ *  - ENOENT : No such key found.
+ *  - EINVAL : Invalid argument.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @note
+ *  Same as get() except that the key isn't required to be a string and the
+ *  hash is taken from the caller instead of being computed.
+ */
+void *qhashtbl_get_by_obj(qhashtbl_t *tbl, const void *name, size_t namesize,
+                          uint32_t hash, size_t *size, bool newmem) {
+    if (name == NULL) {
+        errno = EINVAL;
+        return NULL;
+    }
 
-    qhashtbl_lock(tbl);
+    lock_key(tbl, hash, false);
+    rehash(tbl, REHASH_STEP);
 
     // find key
     qhashtbl_obj_t *obj;
-    for (obj = tbl->slots[idx]; obj != NULL; obj = obj->next) {
-        if (obj->hash == hash && !strcmp(obj->name, name)) {
-            break;
-        }
+    if (tbl->epoch != NULL) {
+        obj = find_published(tbl, hash, name, namesize);
+    } else if (tbl->openslots != NULL) {
+        obj = find_openaddr(tbl, hash, name, namesize);
+    } else {
+        qhashtbl_obj_t **link = find_link(tbl, hash, name, namesize);
+        obj = (link != NULL) ? *link : NULL;
     }
 
     void *data = NULL;
@@ -385,20 +700,18 @@ void *qhashtbl_get(qhashtbl_t *tbl, const char *name, size_t *size, bool newmem)
             data = obj->data;
         } else {
             data = malloc(obj->size);
-            if (data == NULL) {
-                errno = ENOMEM;
-                return NULL;
+            if (data != NULL) {
+                memcpy(data, obj->data, obj->size);
             }
-            memcpy(data, obj->data, obj->size);
         }
         if (size != NULL && data != NULL)
             *size = obj->size;
     }
 
-    qhashtbl_unlock(tbl);
+    unlock_key(tbl, hash, false);
 
     if (data == NULL)
-        errno = ENOENT;
+        errno = (obj == NULL) ? ENOENT : ENOMEM;
     return data;
 }
 
@@ -464,37 +777,62 @@ bool qhashtbl_remove(qhashtbl_t *tbl, const char *name) {
         return false;
     }
 
-    qhashtbl_lock(tbl);
+    size_t namesize = strlen(name);
+    return qhashtbl_remove_by_obj(tbl, name, namesize,
+                                  tbl->hashfunc(name, namesize));
+}
+
+/**
+ * qhashtbl->remove_by_obj(): Remove an object from this table with a
+ * pre-hashed key of arbitrary binary data.
+ *
+ * @param tbl       qhashtbl_t container pointer.
+ * @param name      key data
+ * @param namesize  size of key data
+ * @param hash      hash value of the key by the table's hash function
+ *
+ * @return true if successful, otherwise(not found) returns false
+ * @retval errno will be set in error condition.
+ *  - ENOENT : No such key found.
+ *  - EINVAL : Invalid argument.
+ */
+bool qhashtbl_remove_by_obj(qhashtbl_t *tbl, const void *name, size_t namesize,
+                            uint32_t hash) {
+    if (name == NULL) {
+        errno = EINVAL;
+        return false;
+    }
 
-    uint32_t hash = qhashmurmur3_32(name, strlen(name));
-    int idx = hash % tbl->range;
+    lock_key(tbl, hash, true);
+    rehash(tbl, REHASH_STEP);
 
     // find key
     bool found = false;
-    qhashtbl_obj_t *prev = NULL;
-    qhashtbl_obj_t *obj;
-    for (obj = tbl->slots[idx]; obj != NULL; obj = obj->next) {
-        if (obj->hash == hash && !strcmp(obj->name, name)) {
+    if (tbl->openslots != NULL) {
+        qhashtbl_obj_t *obj = find_openaddr(tbl, hash, name, namesize);
+        if (obj != NULL) {
+            remove_openaddr(tbl, obj);
+            found = true;
+            add_num(tbl, -1);
+        }
+    } else {
+        qhashtbl_obj_t **link = find_link(tbl, hash, name, namesize);
+        if (link != NULL) {
+        qhashtbl_obj_t *obj = *link;
+
             // adjust link
-            if (prev == NULL)
-                tbl->slots[idx] = obj->next;
-            else
-                prev->next = obj->next;
+            __atomic_store_n(link, obj->next, __ATOMIC_RELEASE);
 
             // remove
-            free(obj->name);
-            free(obj->data);
-            free(obj);
+            retire_obj(tbl, obj);
+            reclaim(tbl);
 
             found = true;
-            tbl->num--;
-            break;
+            add_num(tbl, -1);
         }
-
-        prev = obj;
     }
 
-    qhashtbl_unlock(tbl);
+    unlock_key(tbl, hash, true);
 
     if (found == false)
         errno = ENOENT;
@@ -502,6 +840,126 @@ bool qhashtbl_remove(qhashtbl_t *tbl, const char *name) {
     return found;
 }
 
+/**
+ * qhashtbl->getmulti(): Get multiple objects from this table at once.
+ *
+ * @param tbl       qhashtbl_t container pointer.
+ * @param names     array of key names.
+ * @param num       number of keys in the names array.
+ * @param datas     array where the data pointer of each key will be stored,
+ *                  or NULL if the key isn't found.
+ * @param sizes     if not NULL, array where the object size of each key will
+ *                  be stored.
+ * @param newmem    whether or not to allocate memory for the data.
+ *
+ * @return the number of keys found.
+ * @retval errno will be set in error condition.
+ *  - ENOENT : None of the keys found.
+ *  - EINVAL : Invalid argument.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @code
+ *  const char *names[] = { "key1", "key2", "key3" };
+ *  void *datas[3];
+ *  size_t sizes[3];
+ *  size_t found = tbl->getmulti(tbl, names, 3, datas, sizes, false);
+ * @endcode
+ *
+ * @note
+ *  The keys are hashed up front and their slots are prefetched before the
+ *  lookups, so the memory latency of a batch is overlapped instead of paid
+ *  one key after another. In thread-safe mode, the table is locked once per
+ *  batch rather than once per key, except with QHASHTBL_STRIPED where each
+ *  key still takes its own stripe lock. The same rules of newmem flag as
+ *  get() apply.
+ */
+size_t qhashtbl_getmulti(qhashtbl_t *tbl, const char *names[], size_t num,
+                         void *datas[], size_t sizes[], bool newmem) {
+    if (names == NULL || datas == NULL) {
+        errno = EINVAL;
+        return 0;
+    }
+
+    size_t namesizes[BATCH_SIZE];
+    uint32_t hashes[BATCH_SIZE];
+    size_t found = 0;
+    size_t i;
+    for (i = 0; i < num; i += BATCH_SIZE) {
+        size_t n = hash_batch(tbl, &names[i], num - i, namesizes, hashes);
+
+        lock_batch(tbl, false);
+        prefetch_batch(tbl, hashes, n);
+        size_t j;
+        for (j = 0; j < n; j++) {
+            datas[i + j] = NULL;
+            if (names[i + j] == NULL)
+                continue;
+            datas[i + j] = qhashtbl_get_by_obj(tbl, names[i + j], namesizes[j],
+                                               hashes[j],
+                                               (sizes != NULL) ? &sizes[i + j] : NULL,
+                                               newmem);
+            if (datas[i + j] != NULL)
+                found++;
+        }
+        unlock_batch(tbl, false);
+    }
+
+    if (found == 0)
+        errno = ENOENT;
+    return found;
+}
+
+/**
+ * qhashtbl->putmulti(): Put multiple objects into this table at once.
+ *
+ * @param tbl       qhashtbl_t container pointer.
+ * @param names     array of key names.
+ * @param datas     array of data objects.
+ * @param sizes     array of data object sizes.
+ * @param num       number of objects in the arrays.
+ *
+ * @return the number of objects stored.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @note
+ *  Same as getmulti(), the keys are hashed and prefetched by batch and the
+ *  table is locked once per batch. An object which couldn't be stored is
+ *  skipped and the rest of the objects are still stored.
+ */
+size_t qhashtbl_putmulti(qhashtbl_t *tbl, const char *names[],
+                         const void *datas[], const size_t sizes[], size_t num) {
+    if (names == NULL || datas == NULL || sizes == NULL) {
+        errno = EINVAL;
+        return 0;
+    }
+
+    size_t namesizes[BATCH_SIZE];
+    uint32_t hashes[BATCH_SIZE];
+    size_t stored = 0;
+    size_t i;
+    for (i = 0; i < num; i += BATCH_SIZE) {
+        size_t n = hash_batch(tbl, &names[i], num - i, namesizes, hashes);
+
+        lock_batch(tbl, true);
+        prefetch_batch(tbl, hashes, n);
+        size_t j;
+        for (j = 0; j < n; j++) {
+            if (names[i + j] == NULL) {
+                errno = EINVAL;
+                continue;
+            }
+            if (qhashtbl_put_by_obj(tbl, names[i + j], namesizes[j], hashes[j],
+                                    datas[i + j], sizes[i + j]) == true)
+                stored++;
+        }
+        unlock_batch(tbl, true);
+    }
+
+    return stored;
+}
+
 /**
  * qhashtbl->getnext(): Get next element.
  *
@@ -539,6 +997,11 @@ bool qhashtbl_remove(qhashtbl_t *tbl, const char *name) {
  *  will be show up in this scan or next scan. Make sure newmem flag is set
  *  if deletion is expected during the scan.
  *  Object obj should be initialized with 0 by using memset() before first call.
+ *  With QHASHTBL_AUTORESIZE, a pending resize is completed before traversal,
+ *  and an insertion during the scan that grows the table may cause elements
+ *  to be skipped or visited twice. The same applies to QHASHTBL_OPENADDR,
+ *  where a deletion during the scan may also move an unvisited element into
+ *  an already visited slot.
  */
 bool qhashtbl_getnext(qhashtbl_t *tbl, qhashtbl_obj_t *obj, const bool newmem) {
     if (obj == NULL) {
@@ -547,12 +1010,24 @@ bool qhashtbl_getnext(qhashtbl_t *tbl, qhashtbl_obj_t *obj, const bool newmem) {
     }
 
     qhashtbl_lock(tbl);
+    rehash(tbl, SIZE_MAX);
 
     bool found = false;
 
     qhashtbl_obj_t *cursor = NULL;
     int idx = 0;
-    if (obj->name != NULL) {
+    if (tbl->openslots != NULL) {
+        // obj->next keeps the slot index of the previous object plus one,
+        // not a pointer, since the slots may be reallocated between calls.
+        size_t i = (obj->name != NULL) ? (size_t) (uintptr_t) obj->next : 0;
+        for (; i < tbl->range; i++) {
+            if (tbl->openslots[i].name != NULL) {
+                cursor = &tbl->openslots[i];
+                found = true;
+                break;
+            }
+        }
+    } else if (obj->name != NULL) {
         idx = (obj->hash % tbl->range) + 1;
         cursor = obj->next;
     }
@@ -560,7 +1035,7 @@ bool qhashtbl_getnext(qhashtbl_t *tbl, qhashtbl_obj_t *obj, const bool newmem) {
     if (cursor != NULL) {
         // has link
         found = true;
-    } else {
+    } else if (tbl->slots != NULL) {
         // search from next index
         for (; idx < tbl->range; idx++) {
             if (tbl->slots[idx] != NULL) {
@@ -573,7 +1048,7 @@ bool qhashtbl_getnext(qhashtbl_t *tbl, qhashtbl_obj_t *obj, const bool newmem) {
 
     if (cursor != NULL) {
         if (newmem == true) {
-            obj->name = strdup(cursor->name);
+            obj->name = (char *) malloc(cursor->namesize + 1);
             obj->data = malloc(cursor->size);
             if (obj->name == NULL || obj->data == NULL) {
                 DEBUG("getnext(): Unable to allocate memory.");
@@ -583,6 +1058,7 @@ bool qhashtbl_getnext(qhashtbl_t *tbl, qhashtbl_obj_t *obj, const bool newmem) {
                 errno = ENOMEM;
                 return false;
             }
+            memcpy(obj->name, cursor->name, cursor->namesize + 1);
             memcpy(obj->data, cursor->data, cursor->size);
             obj->size = cursor->size;
         } else {
@@ -590,8 +1066,14 @@ bool qhashtbl_getnext(qhashtbl_t *tbl, qhashtbl_obj_t *obj, const bool newmem) {
             obj->data = cursor->data;
         }
         obj->hash = cursor->hash;
+        obj->namesize = cursor->namesize;
         obj->size = cursor->size;
-        obj->next = cursor->next;
+        if (tbl->openslots != NULL) {
+            obj->next = (qhashtbl_obj_t *) (uintptr_t) (cursor - tbl->openslots
+                                                        + 1);
+        } else {
+            obj->next = cursor->next;
+        }
 
     }
 
@@ -603,6 +1085,55 @@ bool qhashtbl_getnext(qhashtbl_t *tbl, qhashtbl_obj_t *obj, const bool newmem) {
     return found;
 }
 
+/**
+ * qhashtbl_parallel_foreach(): Calls a function for each object of this
+ * table on the threads of a pool.
+ *
+ * @param tbl       qhashtbl_t container pointer.
+ * @param pool      qthreadpool_t pointer, NULL to run in the calling thread.
+ * @param func      function called with an object and userdata.
+ * @param userdata  user data passed to the function.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *
+ * @code
+ *  static void count_bytes(const qhashtbl_obj_t *obj, void *userdata) {
+ *      __atomic_add_fetch((size_t *) userdata, obj->size, __ATOMIC_RELAXED);
+ *  }
+ *
+ *  size_t total = 0;
+ *  qhashtbl_parallel_foreach(tbl, pool, count_bytes, &total);
+ * @endcode
+ *
+ * @note
+ *  The slots are split in ranges over the threads, so the function is
+ *  called in no particular order and on several threads at once. The table
+ *  is locked meanwhile and obj->data can be modified in place, but the
+ *  function must not call the methods of this table. There is no member
+ *  function for this as with qvector_data().
+ */
+bool qhashtbl_parallel_foreach(qhashtbl_t *tbl, qthreadpool_t *pool,
+                               void (*func)(const qhashtbl_obj_t *obj,
+                                            void *userdata),
+                               void *userdata) {
+    if (func == NULL) {
+        errno = EINVAL;
+        return false;
+    }
+
+    qhashtbl_lock(tbl);
+    rehash(tbl, SIZE_MAX);
+
+    qhashtbl_parallel_t foreach = { tbl, func, userdata };
+    bool ret = qthreadpool_parallel_for(pool, 0, tbl->range, 0, foreach_slots,
+                                        &foreach);
+
+    qhashtbl_unlock(tbl);
+    return ret;
+}
+
 /**
  * qhashtbl->size(): Returns the number of keys in this hashtable.
  *
@@ -621,70 +1152,427 @@ size_t qhashtbl_size(qhashtbl_t *tbl) {
  */
 void qhashtbl_clear(qhashtbl_t *tbl) {
     qhashtbl_lock(tbl);
+    rehash(tbl, SIZE_MAX);
     int idx;
-    for (idx = 0; idx < tbl->range && tbl->num > 0; idx++) {
+    if (tbl->arena != NULL) {
+        // the objects are released together with the arena
+        if (tbl->openslots != NULL)
+            memset((void *) tbl->openslots, 0, sizeof(qhashtbl_obj_t) * tbl->range);
+        for (idx = 0; tbl->slots != NULL && idx < tbl->range; idx++)
+            __atomic_store_n(&tbl->slots[idx], NULL, __ATOMIC_RELEASE);
+        tbl->num = 0;
+        qhashtbl_unlock(tbl);
+        return;
+    }
+    for (idx = 0; tbl->openslots != NULL && idx < tbl->range; idx++) {
+        qhashtbl_obj_t *obj = &tbl->openslots[idx];
+        if (obj->name == NULL)
+            continue;
+        Q_ARENA_FREE(tbl->arena, obj->data);  // the name shares the data block unless interned
+        memset((void *) obj, 0, sizeof(qhashtbl_obj_t));
+        tbl->num--;
+        tbl->frees++;
+    }
+    for (idx = 0; tbl->slots != NULL && idx < tbl->range && tbl->num > 0; idx++) {
         if (tbl->slots[idx] == NULL)
             continue;
         qhashtbl_obj_t *obj = tbl->slots[idx];
-        tbl->slots[idx] = NULL;
+        __atomic_store_n(&tbl->slots[idx], NULL, __ATOMIC_RELEASE);
         while (obj != NULL) {
             qhashtbl_obj_t *next = obj->next;
-            free(obj->name);
-            free(obj->data);
-            free(obj);
+            retire_obj(tbl, obj);
             obj = next;
 
             tbl->num--;
         }
     }
+    reclaim(tbl);
 
     qhashtbl_unlock(tbl);
 }
 
 /**
- * qhashtbl->debug(): Print hash table for debugging purpose
+ * qhashtbl->set_loadfactor(): Set the load factor threshold for resizing.
  *
- * @param tbl   qhashtbl_t container pointer.
- * @param out   output stream
+ * @param tbl           qhashtbl_t container pointer.
+ * @param loadfactor    maximum average number of keys per slot.
  *
  * @return true if successful, otherwise returns false.
  * @retval errno will be set in error condition.
- *  - EIO : Invalid output stream.
+ *  - EINVAL : Invalid argument.
+ *
+ * @code
+ *  qhashtbl_t *tbl = qhashtbl(0, QHASHTBL_AUTORESIZE);
+ *  tbl->set_loadfactor(tbl, 0.75);  // grow when keys > range * 0.75
+ * @endcode
+ *
+ * @note
+ *  This only takes effect when QHASHTBL_AUTORESIZE or QHASHTBL_OPENADDR
+ *  option was given at the initialization time. The default value is 1.0,
+ *  or 0.8 for QHASHTBL_OPENADDR which only accepts values less than 1.0.
  */
-bool qhashtbl_debug(qhashtbl_t *tbl, FILE *out) {
-    if (out == NULL) {
-        errno = EIO;
+bool qhashtbl_set_loadfactor(qhashtbl_t *tbl, double loadfactor) {
+    if (!(loadfactor > 0)
+        || (tbl->openslots != NULL && !(loadfactor < 1))) {
+        errno = EINVAL;
         return false;
     }
 
-    qhashtbl_obj_t obj;
-    memset((void *) &obj, 0, sizeof(obj));  // must be cleared before call
     qhashtbl_lock(tbl);
-    while (tbl->getnext(tbl, &obj, false) == true) {
-        fprintf(out, "%s=", obj.name);
-        _q_textout(out, obj.data, obj.size, MAX_HUMANOUT);
-        fprintf(out, " (%zu, %08x)\n", obj.size, obj.hash);
-    }
+    tbl->loadfactor = loadfactor;
+    grow(tbl);
     qhashtbl_unlock(tbl);
 
     return true;
 }
 
 /**
- * qhashtbl->lock(): Enter critical section.
- *
- * @param tbl   qhashtbl_t container pointer.
+ * qhashtbl->set_hash(): Set the hash function of the keys.
  *
- * @note
- *  From user side, normally locking operation is only needed when traverse
- *  all elements using qhashtbl->getnext().
+ * @param tbl       qhashtbl_t container pointer.
+ * @param hashfunc  a pointer to the hash function.
  *
- * @note
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - EBUSY  : The table is not empty.
+ *
+ * @code
+ *  qhashtbl_t *tbl = qhashtbl(0, 0);
+ *  tbl->set_hash(tbl, qhashwyhash_32);
+ * @endcode
+ *
+ * @note
+ *  By default, qhashtbl uses qhashmurmur3_32(). The hash function can only
+ *  be changed while the table is empty since the stored objects keep the
+ *  hash values of their keys. Any hash function of qhash.c returning 32-bit
+ *  value such as qhashwyhash_32() or qhashcrc32c() can be used, and the
+ *  hash values given to the *_by_obj() calls must be computed by the same
+ *  function.
+ */
+bool qhashtbl_set_hash(qhashtbl_t *tbl,
+                       uint32_t (*hashfunc)(const void *data, size_t nbytes)) {
+    if (hashfunc == NULL) {
+        errno = EINVAL;
+        return false;
+    }
+
+    qhashtbl_lock(tbl);
+    if (tbl->num > 0) {
+        qhashtbl_unlock(tbl);
+        errno = EBUSY;
+        return false;
+    }
+    tbl->hashfunc = hashfunc;
+    qhashtbl_unlock(tbl);
+
+    return true;
+}
+
+/**
+ * qhashtbl->set_arena(): Take the objects from an arena allocator.
+ *
+ * @param tbl       qhashtbl_t container pointer.
+ * @param arena     qarena_t container pointer, NULL to use the heap again.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EBUSY  : The table is not empty.
+ *
+ * @code
+ *  qarena_t *arena = qarena(0, 0);
+ *  qhashtbl_t *tbl = qhashtbl(0, 0);
+ *  tbl->set_arena(tbl, arena);
+ *  (...codes...)
+ *  tbl->free(tbl);
+ *  arena->free(arena);
+ * @endcode
+ *
+ * @note
+ *  The names and the data of the stored objects are then allocated from the
+ *  arena and never freed one by one, which makes clear() and free() take
+ *  time proportional only to the number of slots. The memory of removed or
+ *  replaced objects is reclaimed when the arena is reset, so the table must
+ *  be cleared or freed before that. A thread-safe table needs an arena
+ *  created with QARENA_THREADSAFE option.
+ */
+bool qhashtbl_set_arena(qhashtbl_t *tbl, qarena_t *arena) {
+    qhashtbl_lock(tbl);
+    if (tbl->num > 0) {
+        qhashtbl_unlock(tbl);
+        errno = EBUSY;
+        return false;
+    }
+    tbl->arena = arena;
+    qhashtbl_unlock(tbl);
+
+    return true;
+}
+
+/**
+ * qhashtbl->set_strpool(): Keep the names interned in a string pool.
+ *
+ * @param tbl       qhashtbl_t container pointer.
+ * @param pool      qstrpool_t container pointer, NULL to copy the names again.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EBUSY  : The table is not empty.
+ *
+ * @code
+ *  qstrpool_t *pool = qstrpool(0, 0);
+ *  qhashtbl_t *tbl1 = qhashtbl(0, 0), *tbl2 = qhashtbl(0, 0);
+ *  tbl1->set_strpool(tbl1, pool);
+ *  tbl2->set_strpool(tbl2, pool);
+ *  tbl1->putstr(tbl1, "name", "a");
+ *  tbl2->putstr(tbl2, "name", "b");  // both refer to the same "name"
+ *  (...codes...)
+ *  tbl1->free(tbl1);
+ *  tbl2->free(tbl2);
+ *  pool->free(pool);
+ * @endcode
+ *
+ * @note
+ *  The objects then point to the names in the pool rather than carrying
+ *  their own copies, so obj.name returned by getnext() is an interned
+ *  string. Names stay in the pool after the objects are removed, hence a
+ *  pool suits a bounded set of names repeated across many objects or
+ *  tables. The pool must outlive the table, and a thread-safe table needs a
+ *  pool created with QSTRPOOL_THREADSAFE option.
+ */
+bool qhashtbl_set_strpool(qhashtbl_t *tbl, qstrpool_t *pool) {
+    qhashtbl_lock(tbl);
+    if (tbl->num > 0) {
+        qhashtbl_unlock(tbl);
+        errno = EBUSY;
+        return false;
+    }
+    tbl->strpool = pool;
+    qhashtbl_unlock(tbl);
+
+    return true;
+}
+
+/**
+ * qhashtbl->debug(): Print hash table for debugging purpose
+ *
+ * @param tbl   qhashtbl_t container pointer.
+ * @param out   output stream
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EIO : Invalid output stream.
+ */
+bool qhashtbl_debug(qhashtbl_t *tbl, FILE *out) {
+    if (out == NULL) {
+        errno = EIO;
+        return false;
+    }
+
+    qhashtbl_obj_t obj;
+    memset((void *) &obj, 0, sizeof(obj));  // must be cleared before call
+    qhashtbl_lock(tbl);
+    while (tbl->getnext(tbl, &obj, false) == true) {
+        fprintf(out, "%s=", obj.name);
+        _q_textout(out, obj.data, obj.size, MAX_HUMANOUT);
+        fprintf(out, " (%zu, %08x)\n", obj.size, obj.hash);
+    }
+    qhashtbl_unlock(tbl);
+
+    return true;
+}
+
+/**
+ * qhashtbl->stats(): Get runtime statistics of this table.
+ *
+ * @param tbl       qhashtbl_t container pointer.
+ * @param stats     qstats_t structure to fill in.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *
+ * @code
+ *  qstats_t stats;
+ *  tbl->stats(tbl, &stats);
+ *  if (stats.maxprobe > 8) {
+ *      // the range is too small or the keys don't hash well.
+ *  }
+ *  qstats_print(&stats, "sessions", stdout);
+ * @endcode
+ *
+ * @note
+ *  It walks all the slots with the table locked, so it takes O(n). For the
+ *  chained slots, the probes of an object is its position in the chain.
+ *  The lock counters are given with QHASHTBL_THREADSAFE. With
+ *  QHASHTBL_STRIPED, contended and lockwait include the waits on the
+ *  stripe locks, while locks counts the whole table locks only.
+ */
+bool qhashtbl_stats(qhashtbl_t *tbl, qstats_t *stats) {
+    if (stats == NULL) {
+        errno = EINVAL;
+        return false;
+    }
+    memset((void *) stats, 0, sizeof(qstats_t));
+
+    qhashtbl_lock(tbl);
+    stats->num = tbl->num;
+    stats->slots = tbl->range + tbl->oldrange;
+    size_t idx;
+    for (idx = 0; tbl->openslots != NULL && idx < tbl->range; idx++) {
+        if (tbl->openslots[idx].name != NULL) {
+            stats->usedslots++;
+            _q_stats_probe(stats, PROBE_DISTANCE(tbl, idx));
+        }
+    }
+    for (idx = 0; tbl->slots != NULL && idx < tbl->range + tbl->oldrange; idx++) {
+        qhashtbl_obj_t *obj = (idx < tbl->range) ? tbl->slots[idx]
+                : tbl->oldslots[idx - tbl->range];
+        if (obj != NULL) {
+            stats->usedslots++;
+        }
+        size_t probe;
+        for (probe = 0; obj != NULL; obj = obj->next, probe++) {
+            _q_stats_probe(stats, probe);
+        }
+    }
+    stats->collisions = tbl->collisions;
+    stats->resizes = tbl->resizes;
+    stats->allocs = tbl->allocs;
+    stats->frees = tbl->frees;
+    Q_MUTEX_STATS(tbl->qmutex, stats);
+    qhashtbl_stripes_t *stripes = (qhashtbl_stripes_t *) tbl->stripes;
+    if (stripes != NULL) {
+        stats->contended += __atomic_load_n(&stripes->contended, __ATOMIC_RELAXED);
+        stats->lockwait += __atomic_load_n(&stripes->waitns, __ATOMIC_RELAXED);
+    }
+    qhashtbl_unlock(tbl);
+
+    return true;
+}
+
+/**
+ * qhashtbl->dump(): Save all the elements into a binary snapshot file.
+ *
+ * @param tbl       qhashtbl_t container pointer.
+ * @param filepath  snapshot file path
+ * @param checksum  whether or not to protect the records with CRC32C.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - ENOMEM : Memory allocation failure.
+ *  - and errors of mkstemp(), write() and rename().
+ *
+ * @note
+ *  The snapshot is written into a temporary file next to the filepath and
+ *  renamed over it when complete, so an existing snapshot is either kept or
+ *  replaced as a whole. The key hashes are saved along, which saves hashing
+ *  on qhashtbl->restore() when the table uses the same hash function.
+ */
+bool qhashtbl_dump(qhashtbl_t *tbl, const char *filepath, bool checksum) {
+    _q_snapshot_t *snap = _q_snapshot_create(filepath, Q_SNAPSHOT_HASHTBL,
+                                             checksum);
+    if (snap == NULL) {
+        return false;
+    }
+
+    bool ret = true;
+    qhashtbl_obj_t obj;
+    memset((void *) &obj, 0, sizeof(obj));  // must be cleared before call
+    qhashtbl_lock(tbl);
+    while (ret == true && qhashtbl_getnext(tbl, &obj, false) == true) {
+        ret = _q_snapshot_write(snap, obj.hash, obj.name, obj.namesize,
+                                obj.data, obj.size);
+    }
+    qhashtbl_unlock(tbl);
+
+    return _q_snapshot_finish(snap, ret);
+}
+
+/**
+ * qhashtbl->restore(): Put all the elements of a snapshot file made by
+ * qhashtbl->dump() into this table.
+ *
+ * @param tbl       qhashtbl_t container pointer.
+ * @param filepath  snapshot file path
+ *
+ * @return the number of elements restored if successful, otherwise -1.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - EBADMSG : Not a qhashtbl snapshot, truncated or checksum mismatch.
+ *  - ENOMEM : Memory allocation failure.
+ *  - and errors of open() and mmap().
+ *
+ * @note
+ *  The whole file is validated before any element is put, so the table is
+ *  left untouched on a broken snapshot. Existing keys are replaced.
+ */
+ssize_t qhashtbl_restore(qhashtbl_t *tbl, const char *filepath) {
+    _q_snapshot_t *snap = _q_snapshot_open(filepath, Q_SNAPSHOT_HASHTBL);
+    if (snap == NULL) {
+        return -1;
+    }
+
+    ssize_t cnt = 0;
+    bool rehash = false;
+    uint32_t hash;
+    const void *name, *data;
+    size_t namesize, datasize;
+    while (_q_snapshot_read(snap, &hash, &name, &namesize, &data, &datasize)) {
+        // trust the saved hashes only if they came from the same function.
+        if (cnt == 0) {
+            rehash = (tbl->hashfunc(name, namesize) != hash);
+        }
+        if (rehash == true) {
+            hash = tbl->hashfunc(name, namesize);
+        }
+        if (qhashtbl_put_by_obj(tbl, name, namesize, hash, data, datasize)
+                == false) {
+            cnt = -1;
+            break;
+        }
+        cnt++;
+    }
+
+    int errnobak = errno;
+    _q_snapshot_close(snap);
+    errno = errnobak;
+
+    return cnt;
+}
+
+/**
+ * qhashtbl->lock(): Enter critical section.
+ *
+ * @param tbl   qhashtbl_t container pointer.
+ *
+ * @note
+ *  From user side, normally locking operation is only needed when traverse
+ *  all elements using qhashtbl->getnext().
+ *  With QHASHTBL_STRIPED, this acquires every stripe lock for writing, then
+ *  the operations made by the locking thread skip the stripe locks until
+ *  the table is unlocked.
+ *
+ * @note
  *  This operation will do nothing if QHASHTBL_THREADSAFE option was not
  *  given at the initialization time.
  */
 void qhashtbl_lock(qhashtbl_t *tbl) {
     Q_MUTEX_ENTER(tbl->qmutex);
+
+    qhashtbl_stripes_t *stripes = (qhashtbl_stripes_t *) tbl->stripes;
+    if (stripes != NULL && stripes->depth == 0) {
+        size_t i;
+        for (i = 0; i < stripes->num; i++) {
+            pthread_rwlock_wrlock(&stripes->locks[i]);
+        }
+        pthread_t self = pthread_self();
+        __atomic_store(&stripes->owner, &self, __ATOMIC_RELAXED);
+        __atomic_store_n(&stripes->depth, 1, __ATOMIC_RELEASE);
+    } else if (stripes != NULL) {
+        __atomic_store_n(&stripes->depth, stripes->depth + 1, __ATOMIC_RELAXED);
+    }
 }
 
 /**
@@ -697,9 +1585,54 @@ void qhashtbl_lock(qhashtbl_t *tbl) {
  *  given at the initialization time.
  */
 void qhashtbl_unlock(qhashtbl_t *tbl) {
+    qhashtbl_stripes_t *stripes = (qhashtbl_stripes_t *) tbl->stripes;
+    if (stripes != NULL && stripes->depth == 1) {
+        __atomic_store_n(&stripes->depth, 0, __ATOMIC_RELEASE);
+        size_t i;
+        for (i = 0; i < stripes->num; i++) {
+            pthread_rwlock_unlock(&stripes->locks[i]);
+        }
+    } else if (stripes != NULL && stripes->depth > 1) {
+        __atomic_store_n(&stripes->depth, stripes->depth - 1, __ATOMIC_RELAXED);
+    }
+
     Q_MUTEX_LEAVE(tbl->qmutex);
 }
 
+/**
+ * qhashtbl->read_enter(): Enter read section.
+ *
+ * @param tbl   qhashtbl_t container pointer.
+ *
+ * @note
+ *  With QHASHTBL_LOCKFREE_READ, this only marks the calling thread as a
+ *  reader without taking any lock, and the objects looked up with
+ *  newmem=false won't be freed until the thread calls read_leave(). Keep
+ *  read sections short since retired objects can't be freed meanwhile.
+ *  Read sections can be nested. Without QHASHTBL_LOCKFREE_READ, this is the
+ *  same as qhashtbl->lock().
+ */
+void qhashtbl_read_enter(qhashtbl_t *tbl) {
+    if (tbl->epoch == NULL) {
+        qhashtbl_lock(tbl);
+        return;
+    }
+    _q_epoch_enter((_q_epoch_t *) tbl->epoch);
+}
+
+/**
+ * qhashtbl->read_leave(): Leave read section.
+ *
+ * @param tbl   qhashtbl_t container pointer.
+ */
+void qhashtbl_read_leave(qhashtbl_t *tbl) {
+    if (tbl->epoch == NULL) {
+        qhashtbl_unlock(tbl);
+        return;
+    }
+    _q_epoch_leave((_q_epoch_t *) tbl->epoch);
+}
+
 /**
  * qhashtbl->free(): De-allocate hash table
  *
@@ -709,7 +1642,527 @@ void qhashtbl_free(qhashtbl_t *tbl) {
     qhashtbl_lock(tbl);
     qhashtbl_clear(tbl);
     free(tbl->slots);
+    free(tbl->oldslots);
+    free(tbl->openslots);
     qhashtbl_unlock(tbl);
+    free_stripes(tbl);
+    _q_epoch_free((_q_epoch_t *) tbl->epoch);
     Q_MUTEX_DESTROY(tbl->qmutex);
     free(tbl);
 }
+
+#ifndef _DOXYGEN_SKIP
+
+/**
+ * Find the link which points to the object with the given key. The returned
+ * link belongs to either the slots being migrated or the current slots.
+ */
+static qhashtbl_obj_t **find_link(qhashtbl_t *tbl, uint32_t hash,
+                                  const void *name, size_t namesize) {
+    qhashtbl_obj_t **link;
+
+    // keys in the old slots which haven't been migrated yet
+    if (tbl->oldslots != NULL) {
+        size_t idx = hash % tbl->oldrange;
+        if (idx >= tbl->rehashidx) {
+            for (link = &tbl->oldslots[idx]; *link != NULL;
+                 link = &(*link)->next) {
+                if (NAME_MATCH(*link, hash, name, namesize)) {
+                    return link;
+                }
+            }
+        }
+    }
+
+    for (link = &tbl->slots[hash % tbl->range]; *link != NULL;
+         link = &(*link)->next) {
+        if (NAME_MATCH(*link, hash, name, namesize)) {
+            return link;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Migrate up to nslots of the old slots into the current slots.
+ */
+static void rehash(qhashtbl_t *tbl, size_t nslots) {
+    for (; tbl->oldslots != NULL && nslots > 0; nslots--) {
+        qhashtbl_obj_t *obj = tbl->oldslots[tbl->rehashidx];
+        tbl->oldslots[tbl->rehashidx] = NULL;
+        while (obj != NULL) {
+            qhashtbl_obj_t *next = obj->next;
+            size_t idx = obj->hash % tbl->range;
+            obj->next = tbl->slots[idx];
+            tbl->slots[idx] = obj;
+            obj = next;
+        }
+
+        if (++tbl->rehashidx >= tbl->oldrange) {
+            free(tbl->oldslots);
+            tbl->oldslots = NULL;
+            tbl->oldrange = 0;
+            tbl->rehashidx = 0;
+        }
+    }
+}
+
+/**
+ * Double the hash range when the load factor threshold is exceeded. The
+ * existing slots are kept as old slots and migrated later by rehash().
+ */
+static void grow(qhashtbl_t *tbl) {
+    if (!(tbl->options & QHASHTBL_AUTORESIZE) || tbl->openslots != NULL
+        || tbl->num <= tbl->range * tbl->loadfactor) {
+        return;
+    }
+
+    // finish the previous resize first. This rarely happens since a resize
+    // normally completes well before the table doubles again.
+    rehash(tbl, SIZE_MAX);
+
+    qhashtbl_obj_t **slots = (qhashtbl_obj_t **) calloc(tbl->range * 2,
+                                                        sizeof(qhashtbl_obj_t *));
+    if (slots == NULL) {
+        DEBUG("grow(): can't allocate memory. keep the current range.");
+        return;
+    }
+
+    tbl->oldslots = tbl->slots;
+    tbl->oldrange = tbl->range;
+    tbl->rehashidx = 0;
+    tbl->slots = slots;
+    tbl->range *= 2;
+    tbl->resizes++;
+}
+
+/**
+ * Find the slot of the object with the given key in the open addressing slot
+ * array. The probing stops as soon as it reaches an empty slot or a slot
+ * closer to its home than the key would be, thanks to the Robin Hood
+ * invariant.
+ */
+static qhashtbl_obj_t *find_openaddr(qhashtbl_t *tbl, uint32_t hash,
+                                     const void *name, size_t namesize) {
+    size_t mask = tbl->range - 1;
+    size_t idx = hash & mask;
+    size_t dist;
+    for (dist = 0; ; dist++, idx = (idx + 1) & mask) {
+        qhashtbl_obj_t *obj = &tbl->openslots[idx];
+        if (obj->name == NULL || PROBE_DISTANCE(tbl, idx) < dist) {
+            return NULL;
+        }
+        if (NAME_MATCH(obj, hash, name, namesize)) {
+            return obj;
+        }
+    }
+}
+
+/**
+ * Insert an object which doesn't exist in the table yet into the open
+ * addressing slot array. An object that is closer to its home slot gives
+ * way to the one being inserted and moves on to the next slot.
+ */
+static void insert_openaddr(qhashtbl_t *tbl, qhashtbl_obj_t *obj) {
+    size_t mask = tbl->range - 1;
+    size_t idx = obj->hash & mask;
+    size_t dist;
+    qhashtbl_obj_t tmp = *obj;
+    for (dist = 0; ; dist++, idx = (idx + 1) & mask) {
+        qhashtbl_obj_t *slot = &tbl->openslots[idx];
+        if (slot->name == NULL) {
+            *slot = tmp;
+            return;
+        }
+
+        size_t slotdist = PROBE_DISTANCE(tbl, idx);
+        if (slotdist < dist) {
+            qhashtbl_obj_t swap = *slot;
+            *slot = tmp;
+            tmp = swap;
+            dist = slotdist;
+        }
+    }
+}
+
+/**
+ * Remove an object from the open addressing slot array. The following
+ * objects are shifted back so no tombstone is needed.
+ */
+static void remove_openaddr(qhashtbl_t *tbl, qhashtbl_obj_t *obj) {
+    size_t mask = tbl->range - 1;
+    size_t idx = obj - tbl->openslots;
+
+    Q_ARENA_FREE(tbl->arena, obj->data);  // the name shares the data block unless interned
+    tbl->frees++;
+
+    size_t next;
+    for (next = (idx + 1) & mask;
+         tbl->openslots[next].name != NULL && PROBE_DISTANCE(tbl, next) > 0;
+         idx = next, next = (next + 1) & mask) {
+        tbl->openslots[idx] = tbl->openslots[next];
+    }
+    memset((void *) &tbl->openslots[idx], 0, sizeof(qhashtbl_obj_t));
+}
+
+/**
+ * Make sure there's room for one more object in the open addressing slot
+ * array, doubling the range when the load factor would be exceeded.
+ */
+static bool grow_openaddr(qhashtbl_t *tbl) {
+    if (tbl->num + 1 <= tbl->range * tbl->loadfactor && tbl->num + 1 < tbl->range) {
+        return true;
+    }
+
+    qhashtbl_obj_t *oldslots = tbl->openslots;
+    size_t oldrange = tbl->range;
+    qhashtbl_obj_t *slots = (qhashtbl_obj_t *) calloc(oldrange * 2,
+                                                      sizeof(qhashtbl_obj_t));
+    if (slots == NULL) {
+        DEBUG("grow_openaddr(): can't allocate memory.");
+        return (tbl->num + 1 < tbl->range);
+    }
+
+    tbl->openslots = slots;
+    tbl->range = oldrange * 2;
+    tbl->resizes++;
+
+    size_t idx;
+    for (idx = 0; idx < oldrange; idx++) {
+        if (oldslots[idx].name != NULL) {
+            insert_openaddr(tbl, &oldslots[idx]);
+        }
+    }
+    free(oldslots);
+
+    return true;
+}
+
+/**
+ * Create stripe locks for QHASHTBL_STRIPED.
+ */
+static bool new_stripes(qhashtbl_t *tbl, size_t num) {
+    qhashtbl_stripes_t *stripes = (qhashtbl_stripes_t *) calloc(
+            1, sizeof(qhashtbl_stripes_t) + sizeof(pthread_rwlock_t) * num);
+    if (stripes == NULL) {
+        return false;
+    }
+
+    for (stripes->num = 0; stripes->num < num; stripes->num++) {
+        if (pthread_rwlock_init(&stripes->locks[stripes->num], NULL) != 0) {
+            DEBUG("new_stripes(): can't initialize rwlock.");
+            tbl->stripes = stripes;
+            free_stripes(tbl);
+            return false;
+        }
+    }
+    tbl->stripes = stripes;
+
+    return true;
+}
+
+/**
+ * Destroy stripe locks.
+ */
+static void free_stripes(qhashtbl_t *tbl) {
+    qhashtbl_stripes_t *stripes = (qhashtbl_stripes_t *) tbl->stripes;
+    if (stripes == NULL) {
+        return;
+    }
+
+    size_t i;
+    for (i = 0; i < stripes->num; i++) {
+        pthread_rwlock_destroy(&stripes->locks[i]);
+    }
+    free(stripes);
+    tbl->stripes = NULL;
+}
+
+/**
+ * Returns true if the calling thread holds the whole table locked by
+ * qhashtbl_lock(). The owner is stored before the depth is published, so a
+ * non-zero depth always comes with the right owner.
+ */
+static bool is_locked_by_me(qhashtbl_stripes_t *stripes) {
+    if (__atomic_load_n(&stripes->depth, __ATOMIC_ACQUIRE) == 0) {
+        return false;
+    }
+
+    pthread_t owner;
+    __atomic_load(&stripes->owner, &owner, __ATOMIC_RELAXED);
+    return pthread_equal(owner, pthread_self());
+}
+
+/**
+ * Lock the stripe that the given key belongs to, or the whole table when
+ * the table isn't striped. Readers of QHASHTBL_LOCKFREE_READ table only
+ * enter the read section.
+ */
+static void lock_key(qhashtbl_t *tbl, uint32_t hash, bool write) {
+    qhashtbl_stripes_t *stripes = (qhashtbl_stripes_t *) tbl->stripes;
+    if (tbl->epoch != NULL && write == false) {
+        qhashtbl_read_enter(tbl);
+        return;
+    }
+    if (stripes == NULL) {
+        qhashtbl_lock(tbl);
+        return;
+    }
+    if (is_locked_by_me(stripes)) {
+        return;
+    }
+
+    pthread_rwlock_t *lock = &stripes->locks[(hash % tbl->range) % stripes->num];
+    if (write == true) {
+        if (pthread_rwlock_trywrlock(lock) == 0) {
+            return;
+        }
+    } else if (pthread_rwlock_tryrdlock(lock) == 0) {
+        return;
+    }
+
+    // only the waits are counted, to keep the uncontended path cheap.
+    uint64_t waitstart = _q_nanotime();
+    if (write == true) {
+        pthread_rwlock_wrlock(lock);
+    } else {
+        pthread_rwlock_rdlock(lock);
+    }
+    __atomic_add_fetch(&stripes->contended, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&stripes->waitns, _q_nanotime() - waitstart,
+                       __ATOMIC_RELAXED);
+}
+
+/**
+ * Unlock what lock_key() has locked.
+ */
+static void unlock_key(qhashtbl_t *tbl, uint32_t hash, bool write) {
+    qhashtbl_stripes_t *stripes = (qhashtbl_stripes_t *) tbl->stripes;
+    if (tbl->epoch != NULL && write == false) {
+        qhashtbl_read_leave(tbl);
+        return;
+    }
+    if (stripes == NULL) {
+        qhashtbl_unlock(tbl);
+        return;
+    }
+    if (is_locked_by_me(stripes)) {
+        return;
+    }
+
+    pthread_rwlock_unlock(&stripes->locks[(hash % tbl->range) % stripes->num]);
+}
+
+/**
+ * Adjust the object counter. Striped tables update it atomically since
+ * writers on different stripes run concurrently.
+ */
+static void add_num(qhashtbl_t *tbl, int n) {
+    if (tbl->stripes != NULL) {
+        __atomic_add_fetch(&tbl->num, n, __ATOMIC_RELAXED);
+    } else {
+        tbl->num += n;
+    }
+}
+
+/**
+ * Increase a statistics counter, atomically for striped tables like
+ * add_num().
+ */
+static void add_stat(qhashtbl_t *tbl, uint64_t *counter) {
+    if (tbl->stripes != NULL) {
+        __atomic_add_fetch(counter, 1, __ATOMIC_RELAXED);
+    } else {
+        (*counter)++;
+    }
+}
+
+/**
+ * Find an object without locking. Links are read with acquire semantics to
+ * pair with the release stores made by the writers.
+ */
+static qhashtbl_obj_t *find_published(qhashtbl_t *tbl, uint32_t hash,
+                                      const void *name, size_t namesize) {
+    qhashtbl_obj_t *obj;
+    for (obj = __atomic_load_n(&tbl->slots[hash % tbl->range], __ATOMIC_ACQUIRE);
+         obj != NULL; obj = __atomic_load_n(&obj->next, __ATOMIC_ACQUIRE)) {
+        if (NAME_MATCH(obj, hash, name, namesize)) {
+            return obj;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Free an unlinked object, or defer it in lock-free read mode until no
+ * reader can see it. reclaim() must be called afterwards.
+ */
+static void retire_obj(qhashtbl_t *tbl, qhashtbl_obj_t *obj) {
+    if (tbl->epoch == NULL) {
+        free_obj(tbl, obj);
+        return;
+    }
+    _q_epoch_retire((_q_epoch_t *) tbl->epoch, obj, free_retired);
+}
+
+/**
+ * Free the retired objects that no reader can see any more.
+ */
+static void reclaim(qhashtbl_t *tbl) {
+    if (tbl->epoch != NULL) {
+        _q_epoch_reclaim((_q_epoch_t *) tbl->epoch);
+    }
+}
+
+/**
+ * Hash up to BATCH_SIZE names and return the number of names hashed.
+ * The default hash function hashes the names in SIMD lanes together.
+ */
+static size_t hash_batch(qhashtbl_t *tbl, const char *names[], size_t num,
+                         size_t *namesizes, uint32_t *hashes) {
+    if (num > BATCH_SIZE)
+        num = BATCH_SIZE;
+
+    size_t i;
+    for (i = 0; i < num; i++) {
+        namesizes[i] = (names[i] != NULL) ? strlen(names[i]) : 0;
+    }
+    if (tbl->hashfunc == qhashmurmur3_32) {
+        qhashmurmur3_32_multi((const void **) names, namesizes, num, hashes);
+        return num;
+    }
+    for (i = 0; i < num; i++) {
+        hashes[i] = (names[i] != NULL) ? tbl->hashfunc(names[i], namesizes[i]) : 0;
+    }
+    return num;
+}
+
+/**
+ * Prefetch the slots of the given hashes, then the chain heads they point
+ * to. The chain heads are loaded atomically as striped tables may be
+ * updated by other threads at the same time.
+ */
+static void prefetch_batch(qhashtbl_t *tbl, const uint32_t *hashes, size_t num) {
+    size_t i;
+    if (tbl->openslots != NULL) {
+        for (i = 0; i < num; i++) {
+            __builtin_prefetch(&tbl->openslots[hashes[i] & (tbl->range - 1)]);
+        }
+        return;
+    }
+
+    for (i = 0; i < num; i++) {
+        __builtin_prefetch(&tbl->slots[hashes[i] % tbl->range]);
+    }
+    for (i = 0; i < num; i++) {
+        qhashtbl_obj_t *obj = __atomic_load_n(&tbl->slots[hashes[i] % tbl->range],
+                                              __ATOMIC_RELAXED);
+        if (obj != NULL)
+            __builtin_prefetch(obj);
+    }
+}
+
+/**
+ * Lock the table once for a batch call. The per key locking in the batch
+ * then only re-enters the lock. Striped tables are left to the per key
+ * stripe locks to keep the other stripes available.
+ */
+static void lock_batch(qhashtbl_t *tbl, bool write) {
+    if (tbl->epoch != NULL && write == false) {
+        qhashtbl_read_enter(tbl);
+    } else if (tbl->stripes == NULL) {
+        qhashtbl_lock(tbl);
+    }
+}
+
+/**
+ * Unlock what lock_batch() has locked.
+ */
+static void unlock_batch(qhashtbl_t *tbl, bool write) {
+    if (tbl->epoch != NULL && write == false) {
+        qhashtbl_read_leave(tbl);
+    } else if (tbl->stripes == NULL) {
+        qhashtbl_unlock(tbl);
+    }
+}
+
+/**
+ * Make an object holding copies of the name and the data in one allocation.
+ *
+ * With slot NULL, a new chained object is allocated with the data and the
+ * name stored right after the object itself, so each entry costs a single
+ * allocation. Otherwise the given open addressing slot is filled in and only
+ * a block of the data followed by the name is allocated, which is freed
+ * through obj->data. The name is always NUL terminated. The block is taken
+ * from the arena when the table has one. With a string pool, the name is
+ * interned there and left out of the block.
+ */
+static qhashtbl_obj_t *new_obj(qhashtbl_t *tbl, qhashtbl_obj_t *slot,
+                               uint32_t hash, const void *name, size_t namesize,
+                               const void *data, size_t size) {
+    const char *interned = NULL;
+    if (tbl->strpool != NULL) {
+        interned = qstrpool_intern(tbl->strpool, name, namesize, NULL);
+        if (interned == NULL) {
+            return NULL;
+        }
+    }
+
+    size_t headsize = (slot == NULL) ? OBJ_HEADSIZE : 0;
+    size_t copysize = (interned == NULL) ? namesize : 0;
+    char *block = (char *) Q_ARENA_MALLOC(tbl->arena, headsize + size + copysize + 1);
+    if (block == NULL) {
+        return NULL;
+    }
+    add_stat(tbl, &tbl->allocs);
+
+    qhashtbl_obj_t *obj = (slot == NULL) ? (qhashtbl_obj_t *) block : slot;
+    memset((void *) obj, 0, sizeof(qhashtbl_obj_t));
+    obj->hash = hash;
+    obj->data = block + headsize;
+    obj->size = size;
+    obj->namesize = namesize;
+    memcpy(obj->data, data, size);
+    if (interned != NULL) {
+        obj->name = (char *) interned;
+    } else {
+        obj->name = block + headsize + size;
+        memcpy(obj->name, name, namesize);
+        obj->name[namesize] = '\0';
+    }
+
+    return obj;
+}
+
+/**
+ * Free an object of chained slots.
+ */
+static void free_obj(qhashtbl_t *tbl, qhashtbl_obj_t *obj) {
+    Q_ARENA_FREE(tbl->arena, obj);  // the name and the data share the object allocation
+    add_stat(tbl, &tbl->frees);
+}
+
+static void free_retired(void *tbl, void *obj) {
+    free_obj((qhashtbl_t *) tbl, (qhashtbl_obj_t *) obj);
+}
+
+static void foreach_slots(size_t begin, size_t end, void *userdata) {
+    qhashtbl_parallel_t *foreach = (qhashtbl_parallel_t *) userdata;
+    qhashtbl_t *tbl = foreach->tbl;
+    size_t idx;
+    for (idx = begin; idx < end; idx++) {
+        if (tbl->openslots != NULL) {
+            if (tbl->openslots[idx].name != NULL) {
+                foreach->func(&tbl->openslots[idx], foreach->userdata);
+            }
+        } else if (tbl->slots != NULL) {
+            qhashtbl_obj_t *obj;
+            for (obj = tbl->slots[idx]; obj != NULL; obj = obj->next) {
+                foreach->func(obj, foreach->userdata);
+            }
+        }
+    }
+}
+
+#endif /* _DOXYGEN_SKIP */
@@ -0,0 +1,284 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/**
+ * @file qhll.c HyperLogLog cardinality estimator implementation.
+ *
+ * qhll estimates the number of distinct elements added, in a fixed and
+ * small memory regardless of the number. Each element is hashed once with
+ * wyhash, the upper bits of the hash pick one of 2^precision registers, and
+ * the register keeps the longest run of leading zeros seen in the rest of
+ * the hash. The standard error is 1.04 / sqrt(2^precision), so a precision
+ * of 14 gives about 0.81% in 16KB. Small counts are estimated by
+ * linear counting over the empty registers, which is exact enough while
+ * many of them are empty.
+ *
+ * Like qhasharr, the estimator works in a memory given by the user and keeps
+ * everything in it, so it can be placed in a shared memory by qshm and
+ * attached by other processes. The registers are updated with atomic
+ * operations, so adding is safe from many threads and processes at the same
+ * time without a lock. Estimators of the same precision can be merged, to
+ * count the union of the elements added to each.
+ *
+ * @code
+ *  size_t memsize = qhll_calculate_memsize(14);
+ *  void *memory = malloc(memsize);
+ *  qhll_t *hll = qhll(memory, memsize, 14);
+ *
+ *  hll->add(hll, userid, strlen(userid));
+ *  printf("unique users ~ %" PRIu64 "\n", hll->count(hll));
+ *
+ *  hll->free(hll);
+ *  free(memory);
+ * @endcode
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include "qinternal.h"
+#include "utilities/qhash.h"
+#include "containers/qhll.h"
+
+#ifndef _DOXYGEN_SKIP
+
+static void update_register(uint8_t *reg, uint8_t rank);
+
+#endif
+
+/**
+ * Get how much memory is needed for the precision.
+ *
+ * @param precision number of hash bits picking the register, between
+ *                  Q_HLL_MIN_PRECISION and Q_HLL_MAX_PRECISION.
+ *
+ * @return memory size needed, or 0 for invalid arguments.
+ */
+size_t qhll_calculate_memsize(int precision) {
+    if (precision < Q_HLL_MIN_PRECISION || precision > Q_HLL_MAX_PRECISION) {
+        return 0;
+    }
+
+    return sizeof(qhll_data_t) + ((size_t) 1 << precision);
+}
+
+/**
+ * Initialize a HyperLogLog estimator in the given memory.
+ *
+ * @param memory    a pointer of data memory.
+ * @param memsize   a size of data memory, 0 for using existing data.
+ * @param precision number of hash bits picking the register, between
+ *                  Q_HLL_MIN_PRECISION and Q_HLL_MAX_PRECISION. Ignored if
+ *                  memsize is 0.
+ *
+ * @return qhll_t container pointer, otherwise returns NULL.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument, or the memory is too small for the
+ *             precision.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @code
+ *  // initialize a new estimator.
+ *  qhll_t *hll = qhll(memory, qhll_calculate_memsize(12), 12);
+ *
+ *  // use the existing estimator in other processes.
+ *  qhll_t *hll2 = qhll(memory, 0, 0);
+ * @endcode
+ */
+qhll_t *qhll(void *memory, size_t memsize, int precision) {
+    if (memory == NULL) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    qhll_data_t *hlldata = (qhll_data_t *) memory;
+    if (memsize > 0) {
+        size_t need = qhll_calculate_memsize(precision);
+        if (need == 0 || memsize < need) {
+            errno = EINVAL;
+            return NULL;
+        }
+
+        memset(memory, 0, need);
+        hlldata->version = Q_HLL_VERSION;
+        hlldata->precision = precision;
+    } else if (hlldata->version != Q_HLL_VERSION
+            || qhll_calculate_memsize(hlldata->precision) == 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    qhll_t *hll = (qhll_t *) calloc(1, sizeof(qhll_t));
+    if (hll == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    // assign methods
+    hll->add = qhll_add;
+    hll->count = qhll_count;
+    hll->merge = qhll_merge;
+
+    hll->clear = qhll_clear;
+    hll->free = qhll_free;
+
+    hll->data = hlldata;
+
+    return hll;
+}
+
+/**
+ * qhll->add(): Add an element.
+ *
+ * @param hll       qhll_t container pointer.
+ * @param data      a pointer of the element.
+ * @param size      size of the element.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ */
+bool qhll_add(qhll_t *hll, const void *data, size_t size) {
+    if (data == NULL) {
+        errno = EINVAL;
+        return false;
+    }
+
+    int precision = hll->data->precision;
+    uint64_t hash = qhashwyhash_64(data, size);
+    uint64_t idx = hash >> (64 - precision);
+    // the sentinel bit caps the rank when the rest of the hash is all zero.
+    uint64_t rest = (hash << precision) | ((uint64_t) 1 << (precision - 1));
+    uint8_t rank = (uint8_t) (__builtin_clzll(rest) + 1);
+    update_register(&hll->data->registers[idx], rank);
+
+    return true;
+}
+
+/**
+ * qhll->count(): Returns the estimated number of distinct elements.
+ *
+ * @param hll       qhll_t container pointer.
+ *
+ * @return the estimated number of distinct elements added.
+ */
+uint64_t qhll_count(qhll_t *hll) {
+    size_t nregs = (size_t) 1 << hll->data->precision;
+    double sum = 0.0;
+    size_t zeros = 0;
+    size_t i;
+    for (i = 0; i < nregs; i++) {
+        uint8_t reg = __atomic_load_n(&hll->data->registers[i],
+                                      __ATOMIC_RELAXED);
+        sum += 1.0 / (double) ((uint64_t) 1 << reg);
+        if (reg == 0) {
+            zeros++;
+        }
+    }
+
+    double m = (double) nregs;
+    double alpha = (nregs == 16) ? 0.673 : (nregs == 32) ? 0.697
+            : (nregs == 64) ? 0.709 : 0.7213 / (1.0 + 1.079 / m);
+    double estimate = alpha * m * m / sum;
+
+    // linear counting is more accurate for small counts. A 64-bit hash
+    // needs no correction for large counts.
+    if (estimate <= 2.5 * m && zeros > 0) {
+        estimate = m * _q_log(m / (double) zeros);
+    }
+
+    return (uint64_t) (estimate + 0.5);
+}
+
+/**
+ * qhll->merge(): Merges the elements of another estimator into this one.
+ *
+ * @param hll       qhll_t container pointer to merge into.
+ * @param other     qhll_t container pointer of the same precision.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Precisions differ.
+ *
+ * @note
+ *  After merging, this estimator counts the union of the elements.
+ */
+bool qhll_merge(qhll_t *hll, qhll_t *other) {
+    if (other == NULL || hll->data->precision != other->data->precision) {
+        errno = EINVAL;
+        return false;
+    }
+
+    size_t nregs = (size_t) 1 << hll->data->precision;
+    size_t i;
+    for (i = 0; i < nregs; i++) {
+        uint8_t reg = __atomic_load_n(&other->data->registers[i],
+                                      __ATOMIC_RELAXED);
+        update_register(&hll->data->registers[i], reg);
+    }
+
+    return true;
+}
+
+/**
+ * qhll->clear(): Removes all the elements.
+ *
+ * @param hll       qhll_t container pointer.
+ */
+void qhll_clear(qhll_t *hll) {
+    memset(hll->data->registers, 0, (size_t) 1 << hll->data->precision);
+}
+
+/**
+ * qhll->free(): De-initialize the estimator.
+ *
+ * @param hll       qhll_t container pointer.
+ *
+ * @note
+ *  The memory given to qhll() is not freed, and the estimator stays in it.
+ */
+void qhll_free(qhll_t *hll) {
+    free(hll);
+}
+
+#ifndef _DOXYGEN_SKIP
+
+// raise the register to the rank, racing with other writers.
+static void update_register(uint8_t *reg, uint8_t rank) {
+    uint8_t old = __atomic_load_n(reg, __ATOMIC_RELAXED);
+    while (old < rank
+            && !__atomic_compare_exchange_n(reg, &old, rank, true,
+                                            __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED)) {
+    }
+}
+
+#endif /* _DOXYGEN_SKIP */
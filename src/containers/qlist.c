@@ -98,6 +98,14 @@
 
 #ifndef _DOXYGEN_SKIP
 
+#define DEFAULT_POOL_SIZE   (64)    /*!< default max number of recycled nodes */
+#define POOL_MIN_CLASS      (16)    /*!< data capacity of the smallest class */
+#define POOL_CLASSES        (sizeof(((qlist_t *) 0)->pool) / sizeof(qlist_obj_t *))
+#define OBJ_HEADSIZE        ((sizeof(qlist_obj_t) + 15) & ~15)
+
+static qlist_obj_t *new_obj(qlist_t *list, const void *data, size_t size);
+static void free_obj(qlist_t *list, qlist_obj_t *obj);
+static int pool_class(size_t size);
 static void *get_at(qlist_t *list, int index, size_t *size, bool newmem, bool remove);
 static qlist_obj_t *get_obj(qlist_t *list, int index);
 static bool remove_obj(qlist_t *list, qlist_obj_t *obj);
@@ -140,6 +148,9 @@ qlist_t *qlist(int options) {
 
     // member methods
     list->setsize = qlist_setsize;
+    list->setpool = qlist_setpool;
+    list->poolstat = qlist_poolstat;
+    list->set_arena = qlist_set_arena;
 
     list->addfirst = qlist_addfirst;
     list->addlast = qlist_addlast;
@@ -158,13 +169,19 @@ qlist_t *qlist(int options) {
     list->removelast = qlist_removelast;
     list->removeat = qlist_removeat;
 
+    list->splice = qlist_splice;
+    list->concat = qlist_concat;
+    list->moveto = qlist_moveto;
+
     list->reverse = qlist_reverse;
+    list->sort = qlist_sort;
     list->clear = qlist_clear;
 
     list->size = qlist_size;
     list->datasize = qlist_datasize;
 
     list->toarray = qlist_toarray;
+    list->toiovec = qlist_toiovec;
     list->tostring = qlist_tostring;
     list->debug = qlist_debug;
 
@@ -173,6 +190,8 @@ qlist_t *qlist(int options) {
 
     list->free = qlist_free;
 
+    list->poolmax = DEFAULT_POOL_SIZE;
+
     return list;
 }
 
@@ -195,6 +214,92 @@ size_t qlist_setsize(qlist_t *list, size_t max) {
     return old;
 }
 
+/**
+ * qlist->setpool(): Limit the number of removed nodes kept for reuse.
+ *
+ * @param list  qlist_t container pointer.
+ * @param max   maximum number of recycled nodes. 0 disables the node pool.
+ *
+ * @return previous maximum number.
+ *
+ * @note
+ *  A removed element leaves its node, which holds the element data in the
+ *  same allocation, on a freelist of its size class so the next insertion
+ *  of a similar size doesn't need malloc(). Size classes go from 16 bytes
+ *  to 2KB, larger elements are always freed. The pool is guarded by the
+ *  list lock, so it costs no extra locking and isn't shared between lists.
+ *  The default is 64 nodes. Shrinking the limit releases the nodes over it.
+ */
+size_t qlist_setpool(qlist_t *list, size_t max) {
+    qlist_lock(list);
+    size_t old = list->poolmax;
+    list->poolmax = max;
+    int i;
+    for (i = POOL_CLASSES - 1; i >= 0 && list->poolnum > max; i--) {
+        while (list->pool[i] != NULL && list->poolnum > max) {
+            qlist_obj_t *obj = list->pool[i];
+            list->pool[i] = obj->next;
+            list->poolnum--;
+            free(obj);
+        }
+    }
+    qlist_unlock(list);
+    return old;
+}
+
+/**
+ * qlist->poolstat(): Get the node pool counters.
+ *
+ * @param list      qlist_t container pointer.
+ * @param hits      if not NULL, the number of insertions served by the pool.
+ * @param misses    if not NULL, the number of insertions that called malloc().
+ *
+ * @return the number of nodes in the pool.
+ */
+size_t qlist_poolstat(qlist_t *list, size_t *hits, size_t *misses) {
+    qlist_lock(list);
+    if (hits != NULL)
+        *hits = list->poolhits;
+    if (misses != NULL)
+        *misses = list->poolmisses;
+    size_t num = list->poolnum;
+    qlist_unlock(list);
+    return num;
+}
+
+/**
+ * qlist->set_arena(): Take the elements from an arena allocator.
+ *
+ * @param list  qlist_t container pointer.
+ * @param arena qarena_t container pointer, NULL to use the heap again.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EBUSY  : The list is not empty.
+ *
+ * @code
+ *  qarena_t *arena = qarena(0, 0);
+ *  qlist_t *list = qlist(0);
+ *  list->set_arena(list, arena);
+ * @endcode
+ *
+ * @note
+ *  The nodes and the data copies are then allocated from the arena and never
+ *  freed one by one, so clear() and free() don't walk the list. The data
+ *  returned by get and pop calls with newmem flag is still malloced.
+ */
+bool qlist_set_arena(qlist_t *list, qarena_t *arena) {
+    qlist_lock(list);
+    if (list->num > 0) {
+        qlist_unlock(list);
+        errno = EBUSY;
+        return false;
+    }
+    list->arena = arena;
+    qlist_unlock(list);
+    return true;
+}
+
 /**
  * qlist->addfirst(): Inserts a element at the beginning of this list.
  *
@@ -299,27 +404,13 @@ bool qlist_addat(qlist_t *list, int index, const void *data, size_t size) {
         return false;
     }
 
-    // duplicate object
-    void *dup_data = malloc(size);
-    if (dup_data == NULL) {
-        qlist_unlock(list);
-        errno = ENOMEM;
-        return false;
-    }
-    memcpy(dup_data, data, size);
-
     // make new object list
-    qlist_obj_t *obj = (qlist_obj_t *) malloc(sizeof(qlist_obj_t));
+    qlist_obj_t *obj = new_obj(list, data, size);
     if (obj == NULL) {
-        free(dup_data);
         qlist_unlock(list);
         errno = ENOMEM;
         return false;
     }
-    obj->data = dup_data;
-    obj->size = size;
-    obj->prev = NULL;
-    obj->next = NULL;
 
     // make link
     if (index == 0) {
@@ -343,8 +434,7 @@ bool qlist_addat(qlist_t *list, int index, const void *data, size_t size) {
         qlist_obj_t *tgt = get_obj(list, index);
         if (tgt == NULL) {
             // should not be happened.
-            free(dup_data);
-            free(obj);
+            free_obj(list, obj);
             qlist_unlock(list);
             errno = EAGAIN;
             return false;
@@ -357,6 +447,10 @@ bool qlist_addat(qlist_t *list, int index, const void *data, size_t size) {
         tgt->prev = obj;
     }
 
+    // keep the cursor pointing to the same object
+    if (list->cursor != NULL && index <= list->cursoridx)
+        list->cursoridx++;
+
     list->datasum += size;
     list->num++;
 
@@ -432,6 +526,9 @@ void *qlist_getlast(qlist_t *list, size_t *size, bool newmem) {
  *  Negative index can be used for addressing a element from the end in this
  *  stack. For example, index -1 is same as getlast() and index 0 is same as
  *  getfirst();
+ *  The list remembers the last element accessed by index and scans from
+ *  there when it's closer, so iterating with increasing or decreasing index
+ *  takes constant time per call.
  */
 void *qlist_getat(qlist_t *list, int index, size_t *size, bool newmem) {
     return get_at(list, index, size, newmem, false);
@@ -621,6 +718,222 @@ bool qlist_getnext(qlist_t *list, qlist_obj_t *obj, bool newmem) {
     return ret;
 }
 
+/**
+ * qlist->splice(): Moves all the elements of another list into this list at
+ * the specified position.
+ *
+ * @param list   qlist_t container pointer.
+ * @param index  index at which the elements are to be inserted.
+ * @param src    qlist_t container to take the elements from.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  -ERANGE : Index out of range.
+ *  -ENOBUFS : List full. Only happens when this list has set to have limited
+ *             number of elements.
+ *  -EINVAL : Both are the same list or they use different arenas.
+ *
+ * @code
+ *  dst: [ A ]<=>[ B ]          src: [ X ]<=>[ Y ]
+ *
+ *  qlist_splice(dst, 1, src);
+ *
+ *  dst: [ A ]<=>[ X ]<=>[ Y ]<=>[ B ]    src: (empty)
+ * @endcode
+ *
+ * @note
+ *  No data is copied. The nodes are relinked, so it takes constant time plus
+ *  the scan to the index. Negative index can be used like addat(), index -1
+ *  appends the elements at the end. When both lists are thread-safe, avoid
+ *  splicing them into each other from different threads at the same time
+ *  since both locks are held.
+ */
+bool qlist_splice(qlist_t *list, int index, qlist_t *src) {
+    if (list == src) {
+        errno = EINVAL;
+        return false;
+    }
+
+    qlist_lock(list);
+    qlist_lock(src);
+
+    if (list->arena != src->arena) {
+        errno = EINVAL;
+        goto fail;
+    }
+    if (list->max > 0 && list->num + src->num > list->max) {
+        errno = ENOBUFS;
+        goto fail;
+    }
+
+    // adjust index
+    if (index < 0)
+        index = (list->num + index) + 1;  // -1 is same as concat()
+    if (index < 0 || index > list->num) {
+        errno = ERANGE;
+        goto fail;
+    }
+
+    if (src->num > 0) {
+        qlist_obj_t *prev, *next;
+        if (index == list->num) {
+            prev = list->last;
+            next = NULL;
+        } else {
+            next = get_obj(list, index);
+            prev = next->prev;
+        }
+
+        src->first->prev = prev;
+        src->last->next = next;
+        if (prev != NULL)
+            prev->next = src->first;
+        else
+            list->first = src->first;
+        if (next != NULL)
+            next->prev = src->last;
+        else
+            list->last = src->last;
+
+        if (list->cursor != NULL && index <= list->cursoridx)
+            list->cursoridx += src->num;
+        list->num += src->num;
+        list->datasum += src->datasum;
+
+        src->first = NULL;
+        src->last = NULL;
+        src->cursor = NULL;
+        src->num = 0;
+        src->datasum = 0;
+    }
+
+    qlist_unlock(src);
+    qlist_unlock(list);
+    return true;
+
+ fail:
+    qlist_unlock(src);
+    qlist_unlock(list);
+    return false;
+}
+
+/**
+ * qlist->concat(): Moves all the elements of another list to the end of
+ * this list.
+ *
+ * @param list  qlist_t container pointer.
+ * @param src   qlist_t container to take the elements from.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  -ENOBUFS : List full. Only happens when this list has set to have limited
+ *             number of elements.
+ *  -EINVAL : Both are the same list or they use different arenas.
+ *
+ * @note
+ *  Same as splice() with index -1. It takes constant time.
+ */
+bool qlist_concat(qlist_t *list, qlist_t *src) {
+    return qlist_splice(list, -1, src);
+}
+
+/**
+ * qlist->moveto(): Moves a range of elements from this list to the end of
+ * another list.
+ *
+ * @param list   qlist_t container pointer.
+ * @param index  index of the first element to move.
+ * @param count  number of elements to move.
+ * @param dst    qlist_t container to move the elements to.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  -ERANGE : The range is out of this list.
+ *  -ENOBUFS : Destination list full. Only happens when dst has set to have
+ *             limited number of elements.
+ *  -EINVAL : Both are the same list or they use different arenas.
+ *
+ * @code
+ *  // hand the first 100 elements over to the next stage
+ *  list->moveto(list, 0, 100, next);
+ * @endcode
+ *
+ * @note
+ *  No data is copied. The nodes are relinked, so it takes the scan to the
+ *  index plus the count. Negative index can be used for addressing the first
+ *  element from the end.
+ */
+bool qlist_moveto(qlist_t *list, int index, size_t count, qlist_t *dst) {
+    if (list == dst) {
+        errno = EINVAL;
+        return false;
+    }
+
+    qlist_lock(list);
+    qlist_lock(dst);
+
+    if (list->arena != dst->arena) {
+        errno = EINVAL;
+        goto fail;
+    }
+    if (dst->max > 0 && dst->num + count > dst->max) {
+        errno = ENOBUFS;
+        goto fail;
+    }
+
+    // adjust index
+    if (index < 0)
+        index = list->num + index;
+    if (index < 0 || index + count > list->num) {
+        errno = ERANGE;
+        goto fail;
+    }
+
+    if (count > 0) {
+        qlist_obj_t *first = get_obj(list, index);
+        qlist_obj_t *last = first;
+        size_t datasum = first->size;
+        size_t i;
+        for (i = 1; i < count; i++) {
+            last = last->next;
+            datasum += last->size;
+        }
+
+        // unlink the range
+        if (first->prev != NULL)
+            first->prev->next = last->next;
+        else
+            list->first = last->next;
+        if (last->next != NULL)
+            last->next->prev = first->prev;
+        else
+            list->last = first->prev;
+        list->cursor = NULL;
+        list->num -= count;
+        list->datasum -= datasum;
+
+        // append to dst
+        first->prev = dst->last;
+        last->next = NULL;
+        if (dst->last != NULL)
+            dst->last->next = first;
+        else
+            dst->first = first;
+        dst->last = last;
+        dst->num += count;
+        dst->datasum += datasum;
+    }
+
+    qlist_unlock(dst);
+    qlist_unlock(list);
+    return true;
+
+ fail:
+    qlist_unlock(dst);
+    qlist_unlock(list);
+    return false;
+}
+
 /**
  * qlist->size(): Returns the number of elements in this list.
  *
@@ -661,6 +974,83 @@ void qlist_reverse(qlist_t *list) {
     obj = list->first;
     list->first = list->last;
     list->last = obj;
+    if (list->cursor != NULL)
+        list->cursoridx = list->num - 1 - list->cursoridx;
+
+    qlist_unlock(list);
+}
+
+/**
+ * qlist->sort(): Sorts the elements in this list.
+ *
+ * @param list  qlist_t container pointer.
+ * @param cmp   comparison function returning negative, zero or positive
+ *              when the first element is less than, equal to or greater
+ *              than the second.
+ *
+ * @code
+ *  int cmp_int(const void *data1, size_t size1,
+ *              const void *data2, size_t size2) {
+ *      return *(int *) data1 - *(int *) data2;
+ *  }
+ *
+ *  list->sort(list, cmp_int);
+ * @endcode
+ *
+ * @note
+ *  It's a stable merge sort which relinks the nodes in place, O(n log n)
+ *  without extra memory. Equal elements keep their order.
+ */
+void qlist_sort(qlist_t *list,
+                int (*cmp)(const void *data1, size_t size1,
+                           const void *data2, size_t size2)) {
+    qlist_lock(list);
+
+    // bottom-up merge of the runs of width 1, 2, 4, ...
+    qlist_obj_t *head = list->first;
+    size_t width;
+    for (width = 1; width < list->num; width *= 2) {
+        qlist_obj_t *p = head, *tail = NULL;
+        head = NULL;
+        while (p != NULL) {
+            qlist_obj_t *q = p;
+            size_t psize = 0, qsize = width;
+            while (psize < width && q != NULL) {
+                q = q->next;
+                psize++;
+            }
+
+            while (psize > 0 || (qsize > 0 && q != NULL)) {
+                qlist_obj_t *obj;
+                if (psize == 0) {
+                    obj = q;
+                    q = q->next;
+                    qsize--;
+                } else if (qsize == 0 || q == NULL
+                        || cmp(p->data, p->size, q->data, q->size) <= 0) {
+                    obj = p;
+                    p = p->next;
+                    psize--;
+                } else {
+                    obj = q;
+                    q = q->next;
+                    qsize--;
+                }
+
+                if (tail != NULL)
+                    tail->next = obj;
+                else
+                    head = obj;
+                obj->prev = tail;
+                tail = obj;
+            }
+            p = q;
+        }
+        tail->next = NULL;
+        list->first = head;
+        list->last = tail;
+    }
+    list->cursor = NULL;
 
     qlist_unlock(list);
 }
@@ -673,10 +1063,9 @@ void qlist_reverse(qlist_t *list) {
 void qlist_clear(qlist_t *list) {
     qlist_lock(list);
     qlist_obj_t *obj;
-    for (obj = list->first; obj;) {
+    for (obj = list->first; list->arena == NULL && obj;) {
         qlist_obj_t *next = obj->next;
-        free(obj->data);
-        free(obj);
+        free_obj(list, obj);
         obj = next;
     }
 
@@ -684,6 +1073,7 @@ void qlist_clear(qlist_t *list) {
     list->datasum = 0;
     list->first = NULL;
     list->last = NULL;
+    list->cursor = NULL;
     qlist_unlock(list);
 }
 
@@ -730,6 +1120,44 @@ void *qlist_toarray(qlist_t *list, size_t *size) {
     return chunk;
 }
 
+/**
+ * qlist->toiovec(): Fills an iovec array pointing to the elements in this
+ * list, so they can be written out with writev() without merging.
+ *
+ * @param list    qlist_t container pointer.
+ * @param iov     iovec array to fill. NULL to query the number of entries.
+ * @param iovcnt  number of entries iov can hold.
+ *
+ * @return the number of entries filled, or needed when iov is NULL.
+ *
+ * @code
+ *  struct iovec iov[IOV_MAX];
+ *  int n = list->toiovec(list, iov, IOV_MAX);
+ *  qio_writev(fd, iov, n, -1);
+ * @endcode
+ *
+ * @note
+ *  No data is copied. The entries point to the stored elements and stay
+ *  valid until the elements are removed or the list is freed. If iovcnt is
+ *  smaller than the number of elements, only the leading ones are covered.
+ */
+int qlist_toiovec(qlist_t *list, struct iovec *iov, int iovcnt) {
+    qlist_lock(list);
+    int n = 0;
+    qlist_obj_t *obj;
+    for (obj = list->first; obj; obj = obj->next) {
+        if (iov != NULL) {
+            if (n >= iovcnt) break;
+            iov[n].iov_base = obj->data;
+            iov[n].iov_len = obj->size;
+        }
+        n++;
+    }
+    qlist_unlock(list);
+
+    return n;
+}
+
 /**
  * qlist->tostring(): Returns a string representation of this list,
  * containing string representation of each element.
@@ -834,6 +1262,7 @@ void qlist_unlock(qlist_t *list) {
  */
 void qlist_free(qlist_t *list) {
     qlist_clear(list);
+    qlist_setpool(list, 0);
     Q_MUTEX_DESTROY(list->qmutex);
 
     free(list);
@@ -891,37 +1320,38 @@ static qlist_obj_t *get_obj(qlist_t *list, int index) {
         return NULL;
     }
 
-    // detect faster scan direction
-    bool backward;
-    qlist_obj_t *obj;
-    int listidx;
-    if (index < list->num / 2) {
-        backward = false;
-        obj = list->first;
-        listidx = 0;
-    } else {
-        backward = true;
+    // start from the nearest of the first, the last and the cursor object,
+    // so sequential access by index doesn't scan the list every time.
+    qlist_obj_t *obj = list->first;
+    size_t listidx = 0;
+    size_t dist = index;
+    if (list->num - 1 - index < dist) {
         obj = list->last;
         listidx = list->num - 1;
+        dist = list->num - 1 - index;
+    }
+    if (list->cursor != NULL) {
+        size_t cdist = (list->cursoridx > index) ?
+                list->cursoridx - index : index - list->cursoridx;
+        if (cdist < dist) {
+            obj = list->cursor;
+            listidx = list->cursoridx;
+        }
     }
 
     // find object
-    while (obj != NULL) {
-        if (listidx == index)
-            return obj;
-
-        if (backward == false) {
-            obj = obj->next;
-            listidx++;
-        } else {
-            obj = obj->prev;
-            listidx--;
-        }
+    while (listidx < index) {
+        obj = obj->next;
+        listidx++;
+    }
+    while (listidx > index) {
+        obj = obj->prev;
+        listidx--;
     }
 
-    // never reach here
-    errno = ENOENT;
-    return NULL;
+    list->cursor = obj;
+    list->cursoridx = index;
+    return obj;
 }
 
 static bool remove_obj(qlist_t *list, qlist_obj_t *obj) {
@@ -938,15 +1368,82 @@ static bool remove_obj(qlist_t *list, qlist_obj_t *obj) {
     else
         obj->next->prev = obj->prev;
 
+    // move the cursor off the object. it's always the cursor when removed by
+    // index, since get_obj() is called first.
+    if (obj == list->cursor) {
+        if (obj->next != NULL) {
+            list->cursor = obj->next;
+        } else {
+            list->cursor = obj->prev;
+            list->cursoridx--;
+        }
+    } else {
+        list->cursor = NULL;
+    }
+
     // adjust counter
     list->datasum -= obj->size;
     list->num--;
 
     // release obj
-    free(obj->data);
-    free(obj);
+    free_obj(list, obj);
 
     return true;
 }
 
+static qlist_obj_t *new_obj(qlist_t *list, const void *data, size_t size) {
+    qlist_obj_t *obj;
+    int class = pool_class(size);
+    if (list->arena != NULL) {
+        obj = (qlist_obj_t *) qarena_alloc(list->arena, OBJ_HEADSIZE + size);
+    } else if (class >= 0 && list->pool[class] != NULL) {
+        obj = list->pool[class];
+        list->pool[class] = obj->next;
+        list->poolnum--;
+        list->poolhits++;
+    } else {
+        // allocate the full class capacity so the node can be recycled
+        size_t capacity = (class >= 0) ? ((size_t) POOL_MIN_CLASS << class) : size;
+        obj = (qlist_obj_t *) malloc(OBJ_HEADSIZE + capacity);
+        list->poolmisses++;
+    }
+    if (obj == NULL) {
+        return NULL;
+    }
+
+    // the data is stored right after the node
+    obj->data = (char *) obj + OBJ_HEADSIZE;
+    memcpy(obj->data, data, size);
+    obj->size = size;
+    obj->prev = NULL;
+    obj->next = NULL;
+
+    return obj;
+}
+
+static void free_obj(qlist_t *list, qlist_obj_t *obj) {
+    if (list->arena != NULL) {
+        return;
+    }
+
+    int class = pool_class(obj->size);
+    if (class < 0 || list->poolnum >= list->poolmax) {
+        free(obj);
+        return;
+    }
+    obj->next = list->pool[class];
+    list->pool[class] = obj;
+    list->poolnum++;
+}
+
+static int pool_class(size_t size) {
+    int class = 0;
+    size_t capacity = POOL_MIN_CLASS;
+    while (capacity < size) {
+        capacity <<= 1;
+        class++;
+    }
+    return (class < POOL_CLASSES) ? class : -1;
+}
+
 #endif /* _DOXYGEN_SKIP */
@@ -104,6 +104,7 @@
 #include <sys/stat.h>
 #include <assert.h>
 #include <errno.h>
+#include <ctype.h>
 #include "qinternal.h"
 #include "utilities/qencode.h"
 #include "utilities/qfile.h"
@@ -115,12 +116,31 @@
 
 #ifndef _DOXYGEN_SKIP
 
-static qlisttbl_obj_t *newobj(const char *name, const void *data, size_t size);
-static bool insertobj(qlisttbl_t *tbl, qlisttbl_obj_t *obj);
-static qlisttbl_obj_t *findobj(qlisttbl_t *tbl, const char *name, qlisttbl_obj_t *retobj);
+#define INDEX_INITSIZE  (64)  /* initial number of the hash index buckets */
+#define IOBUF_SIZE      (64 * 1024)  /* write buffer size of save() */
 
-static bool namematch(qlisttbl_obj_t *obj, const char *name, uint32_t hash);
-static bool namecasematch(qlisttbl_obj_t *obj, const char *name, uint32_t hash);
+static qlisttbl_obj_t *newobj(qlisttbl_t *tbl, const void *name, size_t namesize,
+                              uint32_t hash, const void *data, size_t size);
+static bool insertobj(qlisttbl_t *tbl, qlisttbl_obj_t *obj);
+static qlisttbl_obj_t *findobj(qlisttbl_t *tbl, const void *name, size_t namesize,
+                               uint32_t hash, qlisttbl_obj_t *retobj);
+static bool getnextobj(qlisttbl_t *tbl, qlisttbl_obj_t *obj, const void *name,
+                       size_t namesize, uint32_t hash, bool newmem);
+static void sortobjs(qlisttbl_t *tbl,
+                     int (*cmp)(const qlisttbl_obj_t *obj1,
+                                const qlisttbl_obj_t *obj2));
+static uint32_t indexhash(qlisttbl_t *tbl, const void *name, size_t namesize,
+                          uint32_t hash);
+static void indexobj(qlisttbl_t *tbl, qlisttbl_obj_t *obj);
+static void unindexobj(qlisttbl_t *tbl, qlisttbl_obj_t *obj);
+static bool reindex(qlisttbl_t *tbl, size_t indexsize);
+static bool bufwrite(int fd, char *buf, size_t *buflen, const void *data,
+                     size_t size);
+
+static bool namematch(qlisttbl_obj_t *obj, const void *name, size_t namesize,
+                      uint32_t hash);
+static bool namecasematch(qlisttbl_obj_t *obj, const void *name, size_t namesize,
+                          uint32_t hash);
 
 #endif
 
@@ -146,6 +166,10 @@ static bool namecasematch(qlisttbl_obj_t *obj, const char *name, uint32_t hash);
  *   - QLISTTBL_CASEINSENSITIVE  - key is case insensitive
  *   - QLISTTBL_INSERTTOP        - insert new key at the top
  *   - QLISTTBL_LOOKUPFORWARD    - find key from the top
+ *   - QLISTTBL_HASHINDEX        - keep a hash index of the keys to make
+ *                                 lookups take O(1) instead of O(n). It
+ *                                 keeps the order of the table and costs
+ *                                 two pointers per element plus buckets.
  */
 qlisttbl_t *qlisttbl(int options)
 {
@@ -171,15 +195,25 @@ qlisttbl_t *qlisttbl(int options)
     tbl->remove     = qlisttbl_remove;
     tbl->removeobj  = qlisttbl_removeobj;
 
+    tbl->put_by_obj     = qlisttbl_put_by_obj;
+    tbl->get_by_obj     = qlisttbl_get_by_obj;
+    tbl->remove_by_obj  = qlisttbl_remove_by_obj;
+
     tbl->getnext    = qlisttbl_getnext;
 
     tbl->size       = qlisttbl_size;
     tbl->sort       = qlisttbl_sort;
+    tbl->sort_by    = qlisttbl_sort_by;
+    tbl->set_hash   = qlisttbl_set_hash;
+    tbl->set_arena  = qlisttbl_set_arena;
     tbl->clear      = qlisttbl_clear;
     tbl->save       = qlisttbl_save;
     tbl->load       = qlisttbl_load;
+    tbl->dump       = qlisttbl_dump;
+    tbl->restore    = qlisttbl_restore;
 
     tbl->debug      = qlisttbl_debug;
+    tbl->stats      = qlisttbl_stats;
 
     tbl->lock       = qlisttbl_lock;
     tbl->unlock     = qlisttbl_unlock;
@@ -189,6 +223,7 @@ qlisttbl_t *qlisttbl(int options)
     // assign private methods.
     tbl->namematch  = namematch;
     tbl->namecmp    = strcmp;
+    tbl->hashfunc   = qhashmurmur3_32;
 
     // handle options.
     if (options & QLISTTBL_THREADSAFE) {
@@ -203,6 +238,7 @@ qlisttbl_t *qlisttbl(int options)
         tbl->unique = true;
     }
     if (options & QLISTTBL_CASEINSENSITIVE) {
+        tbl->caseinsensitive = true;
         tbl->namematch = namecasematch;
         tbl->namecmp = strcasecmp;
     }
@@ -212,6 +248,13 @@ qlisttbl_t *qlisttbl(int options)
     if (options & QLISTTBL_LOOKUPFORWARD) {
       tbl->lookupforward = true;
     }
+    if (options & QLISTTBL_HASHINDEX) {
+        if (reindex(tbl, INDEX_INITSIZE) == false) {
+            Q_MUTEX_DESTROY(tbl->qmutex);
+            free(tbl);
+            return NULL;
+        }
+    }
 
     return tbl;
 }
@@ -247,9 +290,44 @@ qlisttbl_t *qlisttbl(int options)
  *  unless QLISTTBL_INSERTTOP option was given.
  */
 bool qlisttbl_put(qlisttbl_t *tbl, const char *name, const void *data, size_t size)
+{
+    if (name == NULL) {
+        errno = EINVAL;
+        return false;
+    }
+
+    size_t namesize = strlen(name);
+    return qlisttbl_put_by_obj(tbl, name, namesize, tbl->hashfunc(name, namesize),
+                               data, size);
+}
+
+/**
+ * qlisttbl->put_by_obj(): Put an element to this table with a pre-hashed key
+ * of arbitrary binary data.
+ *
+ * @param tbl       qlisttbl container pointer.
+ * @param name      element name data.
+ * @param namesize  size of name data.
+ * @param hash      hash value of the name by the table's hash function.
+ * @param data      a pointer which points data memory.
+ * @param size      size of the data.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - ENOMEM : Memory allocation failure.
+ *  - EINVAL : Invalid argument.
+ *
+ * @note
+ *  The name doesn't need to be NUL terminated. A copy of the name is stored
+ *  with a terminating NUL appended, so names with embedded NUL bytes are
+ *  matched correctly by the *_by_obj() calls but will be cut at the first
+ *  NUL by sort(), save() and the string based calls.
+ */
+bool qlisttbl_put_by_obj(qlisttbl_t *tbl, const void *name, size_t namesize,
+                         uint32_t hash, const void *data, size_t size)
 {
     // make new object table
-    qlisttbl_obj_t *obj = newobj(name, data, size);
+    qlisttbl_obj_t *obj = newobj(tbl, name, namesize, hash, data, size);
     if (obj == NULL) {
         return false;
     }
@@ -258,7 +336,7 @@ bool qlisttbl_put(qlisttbl_t *tbl, const char *name, const void *data, size_t si
     qlisttbl_lock(tbl);
 
     // if unique flag is set, remove same key
-    if (tbl->unique == true) qlisttbl_remove(tbl, name);
+    if (tbl->unique == true) qlisttbl_remove_by_obj(tbl, name, namesize, hash);
 
     // insert into table
     if (tbl->num == 0) {
@@ -396,9 +474,52 @@ void *qlisttbl_get(qlisttbl_t *tbl, const char *name, size_t *size, bool newmem)
         return NULL;
     }
 
+    size_t namesize = strlen(name);
+    return qlisttbl_get_by_obj(tbl, name, namesize, tbl->hashfunc(name, namesize),
+                               size, newmem);
+}
+
+/**
+ * qlisttbl->get_by_obj(): Finds an object with a pre-hashed name of arbitrary
+ * binary data.
+ *
+ * @param tbl       qlisttbl container pointer.
+ * @param name      element name data.
+ * @param namesize  size of name data.
+ * @param hash      hash value of the name by the table's hash function.
+ * @param size      if size is not NULL, data size will be stored.
+ * @param newmem    whether or not to allocate memory for the data.
+ *
+ * @return a pointer of data if key is found, otherwise returns NULL.
+ * @retval errno will be set in error condition.
+ *  - ENOENT : No such key found.
+ *  - EINVAL : Invalid argument.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @code
+ *  qlisttbl_t *tbl = qlisttbl(0);
+ *  (...codes...)
+ *
+ *  uint32_t hash = qhashmurmur3_32(key, keylen);  // the default hash function
+ *  void *data = tbl->get_by_obj(tbl, key, keylen, hash, NULL, false);
+ * @endcode
+ *
+ * @note
+ *  Same as get() except that the name isn't required to be a string and the
+ *  hash is taken from the caller instead of being computed. With
+ *  QLISTTBL_CASEINSENSITIVE option, the hash is not used for matching.
+ */
+void *qlisttbl_get_by_obj(qlisttbl_t *tbl, const void *name, size_t namesize,
+                          uint32_t hash, size_t *size, bool newmem)
+{
+    if (name == NULL) {
+        errno = EINVAL;
+        return NULL;
+    }
+
     qlisttbl_lock(tbl);
     void *data = NULL;
-    qlisttbl_obj_t *obj = findobj(tbl, name, NULL);
+    qlisttbl_obj_t *obj = findobj(tbl, name, namesize, hash, NULL);
     if (obj != NULL) {
         // get data
         if (newmem == true) {
@@ -594,12 +715,33 @@ size_t qlisttbl_remove(qlisttbl_t *tbl, const char *name)
 {
     if (name == NULL) return false;
 
+    size_t namesize = strlen(name);
+    return qlisttbl_remove_by_obj(tbl, name, namesize,
+                                  tbl->hashfunc(name, namesize));
+}
+
+/**
+ * qlisttbl->remove_by_obj(): Remove matched objects with a pre-hashed name of
+ * arbitrary binary data.
+ *
+ * @param tbl       qlisttbl container pointer.
+ * @param name      element name data.
+ * @param namesize  size of name data.
+ * @param hash      hash value of the name by the table's hash function.
+ *
+ * @return a number of removed objects.
+ */
+size_t qlisttbl_remove_by_obj(qlisttbl_t *tbl, const void *name, size_t namesize,
+                              uint32_t hash)
+{
+    if (name == NULL) return false;
+
     size_t numremoved = 0;
 
     qlisttbl_obj_t obj;
     memset((void*)&obj, 0, sizeof(obj)); // must be cleared before call
     qlisttbl_lock(tbl);
-    while (qlisttbl_getnext(tbl, &obj, name, false) == true) {
+    while (getnextobj(tbl, &obj, name, namesize, hash, false) == true) {
         qlisttbl_removeobj(tbl, &obj);
         numremoved++;
     }
@@ -667,12 +809,13 @@ bool qlisttbl_removeobj(qlisttbl_t *tbl, const qlisttbl_obj_t *obj)
     // adjust counter
     tbl->num--;
 
+    if (tbl->index != NULL) unindexobj(tbl, this);
+    tbl->frees++;
+
     qlisttbl_unlock(tbl);
 
-    // free object
-    free(this->name);
-    free(this->data);
-    free(this);
+    // free object, name and data are in the same block.
+    Q_ARENA_FREE(tbl->arena, this);
 
     return true;
 }
@@ -727,66 +870,9 @@ bool qlisttbl_removeobj(qlisttbl_t *tbl, const qlisttbl_obj_t *obj)
 bool qlisttbl_getnext(qlisttbl_t *tbl, qlisttbl_obj_t *obj, const char *name,
                              bool newmem)
 {
-    if (obj == NULL) return NULL;
-
-    qlisttbl_lock(tbl);
-
-    qlisttbl_obj_t *cont = NULL;
-    if (obj->size == 0) {  // first time call
-        if (name == NULL) {  // full scan
-            cont = (tbl->lookupforward) ? tbl->first : tbl->last;
-        } else {  // name search
-            cont = findobj(tbl, name, NULL);
-        }
-    } else {  // next call
-        cont = (tbl->lookupforward) ? obj->next : obj->prev;
-    }
-
-    if (cont == NULL) {
-        errno = ENOENT;
-        qlisttbl_unlock(tbl);
-        return false;
-    }
-
-    uint32_t hash = (name != NULL) ? qhashmurmur3_32(name, strlen(name)) : 0;
-
-    bool ret = false;
-    while (cont != NULL) {
-        if (name == NULL || tbl->namematch(cont, name, hash) == true) {
-            if (newmem == true) {
-                obj->name = strdup(cont->name);
-                obj->data = malloc(cont->size);
-                if (obj->name == NULL || obj->data == NULL) {
-                    if (obj->name != NULL) free(obj->name);
-                    if (obj->data != NULL) free(obj->data);
-                    obj->name = NULL;
-                    obj->data = NULL;
-                    errno = ENOMEM;
-                    break;
-                }
-                memcpy(obj->data, cont->data, cont->size);
-            } else {
-                obj->name = cont->name;
-                obj->data = cont->data;
-            }
-            obj->hash = cont->hash;
-            obj->size = cont->size;
-            obj->prev = cont->prev;
-            obj->next = cont->next;
-
-            ret = true;
-            break;
-        }
-
-        cont = (tbl->lookupforward) ? cont->next : cont->prev;
-    }
-    qlisttbl_unlock(tbl);
-
-    if (ret == false) {
-        errno = ENOENT;
-    }
-
-    return ret;
+    size_t namesize = (name != NULL) ? strlen(name) : 0;
+    uint32_t hash = (name != NULL) ? tbl->hashfunc(name, namesize) : 0;
+    return getnextobj(tbl, obj, name, namesize, hash, newmem);
 }
 
 /**
@@ -822,38 +908,120 @@ size_t qlisttbl_size(qlisttbl_t *tbl)
  *    c = 5          c = 5           b = 6
  *    b = 6          d = 1           a = 2
  * @endcode
+ *
+ *  It takes O(n log n) with a merge sort which relinks the elements.
  */
 void qlisttbl_sort(qlisttbl_t *tbl)
 {
-    // run bubble sort
     qlisttbl_lock(tbl);
-    qlisttbl_obj_t *obj1, *obj2;
-    qlisttbl_obj_t tmpobj;
-    int n, n2, i;
-    for (n = tbl->num; n > 0;) {
-        n2 = 0;
-        for (i = 0, obj1 = tbl->first; i < (n - 1); i++, obj1 = obj1->next) {
-            obj2 = obj1->next;  // this can't be null.
-            if (tbl->namecmp(obj1->name, obj2->name) > 0) {
-                // swapping contents is faster than adjusting links.
-                tmpobj = *obj1;
-                obj1->hash = obj2->hash;
-                obj1->name = obj2->name;
-                obj1->data = obj2->data;
-                obj1->size = obj2->size;
-                obj2->hash = tmpobj.hash;
-                obj2->name = tmpobj.name;
-                obj2->data = tmpobj.data;
-                obj2->size = tmpobj.size;
-
-                n2 = i + 1;
-            }
-        }
-        n = n2;  // skip sorted tailing elements
+    sortobjs(tbl, NULL);
+    if (tbl->index != NULL) reindex(tbl, tbl->indexsize);
+    qlisttbl_unlock(tbl);
+}
+
+/**
+ * qlisttbl->sort_by(): Sort elements in this table with the given comparator.
+ *
+ * @param tbl           qlisttbl container pointer.
+ * @param cmp           comparator which returns a negative, zero or positive
+ *                      value when obj1 is less than, equal to or greater
+ *                      than obj2.
+ *
+ * @note
+ *  The sort is stable, so the elements compared as equal keep their order.
+ *  The comparator can look at both the names and values of the objects but
+ *  must not modify the table.
+ *
+ * @code
+ *  // sort by value string
+ *  int cmp_value(const qlisttbl_obj_t *obj1, const qlisttbl_obj_t *obj2) {
+ *      return strcmp((char *)obj1->data, (char *)obj2->data);
+ *  }
+ *
+ *  tbl->sort_by(tbl, cmp_value);
+ * @endcode
+ */
+void qlisttbl_sort_by(qlisttbl_t *tbl,
+                      int (*cmp)(const qlisttbl_obj_t *obj1,
+                                 const qlisttbl_obj_t *obj2))
+{
+    if (cmp == NULL) {
+        errno = EINVAL;
+        return;
     }
+
+    qlisttbl_lock(tbl);
+    sortobjs(tbl, cmp);
+    if (tbl->index != NULL) reindex(tbl, tbl->indexsize);
     qlisttbl_unlock(tbl);
 }
 
+/**
+ * qlisttbl->set_hash(): Set the hash function of the names.
+ *
+ * @param tbl       qlisttbl container pointer.
+ * @param hashfunc  a pointer to the hash function.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - EBUSY  : The table is not empty.
+ *
+ * @note
+ *  By default, qlisttbl uses qhashmurmur3_32(). The hash function can only
+ *  be changed while the table is empty since the stored objects keep the
+ *  hash values of their names.
+ */
+bool qlisttbl_set_hash(qlisttbl_t *tbl,
+                       uint32_t (*hashfunc)(const void *data, size_t nbytes))
+{
+    if (hashfunc == NULL) {
+        errno = EINVAL;
+        return false;
+    }
+
+    qlisttbl_lock(tbl);
+    if (tbl->num > 0) {
+        qlisttbl_unlock(tbl);
+        errno = EBUSY;
+        return false;
+    }
+    tbl->hashfunc = hashfunc;
+    qlisttbl_unlock(tbl);
+
+    return true;
+}
+
+/**
+ * qlisttbl->set_arena(): Take the objects from an arena allocator.
+ *
+ * @param tbl       qlisttbl container pointer.
+ * @param arena     qarena_t container pointer, NULL to use the heap again.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EBUSY  : The table is not empty.
+ *
+ * @note
+ *  The objects are then allocated from the arena and never freed one by
+ *  one, so clear() and free() don't walk the list. The arena must outlive
+ *  the table and must be created with QARENA_THREADSAFE option when the
+ *  table is shared between threads.
+ */
+bool qlisttbl_set_arena(qlisttbl_t *tbl, qarena_t *arena)
+{
+    qlisttbl_lock(tbl);
+    if (tbl->num > 0) {
+        qlisttbl_unlock(tbl);
+        errno = EBUSY;
+        return false;
+    }
+    tbl->arena = arena;
+    qlisttbl_unlock(tbl);
+
+    return true;
+}
+
 /**
  * qlisttbl->clear(): Removes all of the elements from this table.
  *
@@ -863,17 +1031,19 @@ void qlisttbl_clear(qlisttbl_t *tbl)
 {
     qlisttbl_lock(tbl);
     qlisttbl_obj_t *obj;
-    for (obj = tbl->first; obj != NULL;) {
+    for (obj = tbl->first; tbl->arena == NULL && obj != NULL;) {
         qlisttbl_obj_t *next = obj->next;
-        free(obj->name);
-        free(obj->data);
         free(obj);
         obj = next;
+        tbl->frees++;
     }
 
     tbl->num = 0;
     tbl->first = NULL;
     tbl->last = NULL;
+    if (tbl->index != NULL) {
+        memset((void *)tbl->index, 0, sizeof(qlisttbl_obj_t *) * tbl->indexsize);
+    }
     qlisttbl_unlock(tbl);
 }
 
@@ -891,6 +1061,13 @@ void qlisttbl_clear(qlisttbl_t *tbl)
  *                  true must be set.
  *
  * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - ENOMEM : Memory allocation failure.
+ *  - errors of open() and write().
+ *
+ * @note
+ *  The lines are buffered and written out in large blocks.
  */
 bool qlisttbl_save(qlisttbl_t *tbl, const char *filepath, char sepchar,
                    bool encode)
@@ -900,29 +1077,53 @@ bool qlisttbl_save(qlisttbl_t *tbl, const char *filepath, char sepchar,
         return false;
     }
 
+    char *buf = (char *)malloc(IOBUF_SIZE);
+    if (buf == NULL) {
+        errno = ENOMEM;
+        return false;
+    }
+
     int fd;
     if ((fd = open(filepath, O_CREAT|O_WRONLY|O_TRUNC, (S_IRUSR|S_IWUSR|S_IRGRP|S_IROTH))) < 0) {
         DEBUG("qlisttbl->save(): Can't open file %s", filepath);
+        free(buf);
         return false;
     }
 
     char *gmtstr = qtime_gmt_str(0);
-    qio_printf(fd, -1, "# %s %s\n", filepath, gmtstr);
+    size_t buflen = snprintf(buf, IOBUF_SIZE, "# %s %s\n", filepath, gmtstr);
     free(gmtstr);
+    if (buflen >= IOBUF_SIZE) buflen = IOBUF_SIZE - 1;
 
+    bool ret = true;
     qlisttbl_lock(tbl);
     qlisttbl_obj_t *obj;
-    for (obj = tbl->first; obj; obj = obj->next) {
+    for (obj = tbl->first; ret == true && obj; obj = obj->next) {
         char *encval;
         if (encode == true) encval = qurl_encode(obj->data, obj->size);
         else encval = obj->data;
-        qio_printf(fd, -1, "%s%c%s\n", obj->name, sepchar, encval);
+        if (encval == NULL) {
+            errno = ENOMEM;
+            ret = false;
+            break;
+        }
+        ret = (bufwrite(fd, buf, &buflen, obj->name, strlen(obj->name))
+               && bufwrite(fd, buf, &buflen, &sepchar, 1)
+               && bufwrite(fd, buf, &buflen, encval, strlen(encval))
+               && bufwrite(fd, buf, &buflen, "\n", 1));
         if (encode == true) free(encval);
     }
     qlisttbl_unlock(tbl);
 
+    // flush
+    if (ret == true && buflen > 0
+        && qio_write(fd, buf, buflen, -1) != (ssize_t)buflen) {
+        ret = false;
+    }
+
+    free(buf);
     close(fd);
-    return true;
+    return ret;
 }
 
 /**
@@ -937,45 +1138,181 @@ bool qlisttbl_save(qlisttbl_t *tbl, const char *filepath, char sepchar,
  * @param decode    flag for decoding data
  *
  * @return the number of loaded entries, otherwise returns -1.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - ENOMEM : Memory allocation failure.
+ *  - errors of open() and mmap().
+ *
+ * @note
+ *  The file is mapped with qfile_map() and parsed in place, so only the entries
+ *  get allocated. Setting an arena with set_arena() beforehand takes them
+ *  out of the arena as well. On failure, the entries loaded so far are
+ *  kept in the table.
  */
 ssize_t qlisttbl_load(qlisttbl_t *tbl, const char *filepath, char sepchar,
                       bool decode)
 {
-    // load file
-    char *str = qfile_load(filepath, NULL);
+    if (filepath == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // map file
+    size_t filesize = 0;
+    const char *str = (const char *)qfile_map(filepath, &filesize,
+                                              QFILE_MAP_SEQUENTIAL);
     if (str == NULL) return -1;
+    if (filesize == 0) return 0;
 
     // parse
     qlisttbl_lock(tbl);
-    char *offset, *buf;
-    int cnt = 0;
-    for (offset = str; *offset != '\0'; ) {
-        // get one line into buf
-        for (buf = offset; *offset != '\n' && *offset != '\0'; offset++);
-        if (*offset != '\0') {
-            *offset = '\0';
-            offset++;
-        }
-        qstrtrim(buf);
+    const char *end = str + filesize, *offset;
+    char *value = NULL;  // NUL terminated and decoded value
+    size_t valuesize = 0;
+    ssize_t cnt = 0;
+    for (offset = str; offset < end; ) {
+        // get one line
+        const char *line = offset;
+        const char *eol = (const char *)memchr(offset, '\n', end - offset);
+        if (eol == NULL) eol = end;
+        offset = (eol < end) ? eol + 1 : end;
+
+        // trim
+        while (line < eol && isspace((unsigned char)*line)) line++;
+        while (eol > line && isspace((unsigned char)eol[-1])) eol--;
 
         // skip blank or comment line
-        if ((buf[0] == '#') || (buf[0] == '\0')) continue;
+        if (line == eol || line[0] == '#') continue;
 
         // parse
-        char *data = strdup(buf);
-        char *name  = _q_makeword(data, sepchar);
-        qstrtrim(data);
-        qstrtrim(name);
-        if (decode == true) qurl_decode(data);
+        const char *name = line;
+        const char *nameend = (const char *)memchr(line, sepchar, eol - line);
+        const char *data = (nameend != NULL) ? nameend + 1 : eol;
+        if (nameend == NULL) nameend = eol;
+        while (nameend > name && isspace((unsigned char)nameend[-1])) nameend--;
+        while (data < eol && isspace((unsigned char)*data)) data++;
+
+        size_t datalen = eol - data;
+        if (datalen + 1 > valuesize) {
+            size_t newsize = (valuesize > 0) ? valuesize * 2 : 4096;
+            if (newsize < datalen + 1) newsize = datalen + 1;
+            char *newvalue = (char *)realloc(value, newsize);
+            if (newvalue == NULL) {
+                errno = ENOMEM;
+                cnt = -1;
+                break;
+            }
+            value = newvalue;
+            valuesize = newsize;
+        }
+        memcpy(value, data, datalen);
+        value[datalen] = '\0';
+        if (decode == true) qurl_decode(value);
 
         // add to the table.
-        qlisttbl_put(tbl, name, data, strlen(data) + 1);
+        size_t namesize = nameend - name;
+        if (qlisttbl_put_by_obj(tbl, name, namesize,
+                                tbl->hashfunc(name, namesize),
+                                value, strlen(value) + 1) == false) {
+            cnt = -1;
+            break;
+        }
+        cnt++;
+    }
+    qlisttbl_unlock(tbl);
+    free(value);
+    qfile_unmap(str, filesize);
+
+    return cnt;
+}
 
-        free(name);
-        free(data);
+/**
+ * qlisttbl->dump(): Save all the elements into a binary snapshot file in
+ * the table order.
+ *
+ * @param tbl       qlisttbl container pointer.
+ * @param filepath  snapshot file path
+ * @param checksum  whether or not to protect the records with CRC32C.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - ENOMEM : Memory allocation failure.
+ *  - and errors of mkstemp(), write() and rename().
+ *
+ * @note
+ *  Unlike save(), names and data are kept as they are in binary, so the
+ *  names with NUL bytes and non-string data are preserved. The snapshot is
+ *  written into a temporary file next to the filepath and renamed over it
+ *  when complete, so an existing snapshot is either kept or replaced as a
+ *  whole.
+ */
+bool qlisttbl_dump(qlisttbl_t *tbl, const char *filepath, bool checksum)
+{
+    _q_snapshot_t *snap = _q_snapshot_create(filepath, Q_SNAPSHOT_LISTTBL,
+                                             checksum);
+    if (snap == NULL) return false;
+
+    bool ret = true;
+    qlisttbl_lock(tbl);
+    qlisttbl_obj_t *obj;
+    for (obj = tbl->first; obj != NULL && ret == true; obj = obj->next) {
+        ret = _q_snapshot_write(snap, obj->hash, obj->name, obj->namesize,
+                                obj->data, obj->size);
     }
     qlisttbl_unlock(tbl);
-    free(str);
+
+    return _q_snapshot_finish(snap, ret);
+}
+
+/**
+ * qlisttbl->restore(): Put all the elements of a snapshot file made by
+ * qlisttbl->dump() into this table.
+ *
+ * @param tbl       qlisttbl container pointer.
+ * @param filepath  snapshot file path
+ *
+ * @return the number of restored elements, otherwise returns -1.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - EBADMSG : Not a qlisttbl snapshot, truncated or checksum mismatch.
+ *  - ENOMEM : Memory allocation failure.
+ *  - errors of open() and mmap().
+ *
+ * @note
+ *  The whole file is validated before any element is put, so the table is
+ *  left untouched on a broken snapshot. The elements are put in the saved
+ *  order, following the table options as put() does. The saved hashes are
+ *  reused when the table has the same hash function.
+ */
+ssize_t qlisttbl_restore(qlisttbl_t *tbl, const char *filepath)
+{
+    _q_snapshot_t *snap = _q_snapshot_open(filepath, Q_SNAPSHOT_LISTTBL);
+    if (snap == NULL) return -1;
+
+    qlisttbl_lock(tbl);
+    ssize_t cnt = 0;
+    bool rehash = false;
+    uint32_t hash;
+    const void *name, *data;
+    size_t namesize, datasize;
+    while (_q_snapshot_read(snap, &hash, &name, &namesize, &data, &datasize)) {
+        // trust the saved hashes only if they came from the same function.
+        if (cnt == 0) rehash = (tbl->hashfunc(name, namesize) != hash);
+        if (rehash == true) hash = tbl->hashfunc(name, namesize);
+
+        if (qlisttbl_put_by_obj(tbl, name, namesize, hash, data,
+                                datasize) == false) {
+            cnt = -1;
+            break;
+        }
+        cnt++;
+    }
+    qlisttbl_unlock(tbl);
+
+    int errnobak = errno;
+    _q_snapshot_close(snap);
+    errno = errnobak;
 
     return cnt;
 }
@@ -1009,6 +1346,52 @@ bool qlisttbl_debug(qlisttbl_t *tbl, FILE *out)
     return true;
 }
 
+/**
+ * qlisttbl->stats(): Get runtime statistics of this table.
+ *
+ * @param tbl   qlisttbl container pointer.
+ * @param stats qstats_t structure to fill in.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *
+ * @note
+ *  The slots and the probes are of the hash index, so they are given with
+ *  QLISTTBL_HASHINDEX only. The lock counters are given with
+ *  QLISTTBL_THREADSAFE.
+ */
+bool qlisttbl_stats(qlisttbl_t *tbl, qstats_t *stats)
+{
+    if (stats == NULL) {
+        errno = EINVAL;
+        return false;
+    }
+    memset((void *)stats, 0, sizeof(qstats_t));
+
+    qlisttbl_lock(tbl);
+    stats->num = tbl->num;
+    stats->slots = tbl->indexsize;
+    size_t idx;
+    for (idx = 0; tbl->index != NULL && idx < tbl->indexsize; idx++) {
+        qlisttbl_obj_t *obj = tbl->index[idx];
+        if (obj != NULL) stats->usedslots++;
+
+        size_t probe;
+        for (probe = 0; obj != NULL; obj = obj->hnext, probe++) {
+            _q_stats_probe(stats, probe);
+        }
+    }
+    stats->collisions = tbl->collisions;
+    stats->resizes = tbl->resizes;
+    stats->allocs = tbl->allocs;
+    stats->frees = tbl->frees;
+    Q_MUTEX_STATS(tbl->qmutex, stats);
+    qlisttbl_unlock(tbl);
+
+    return true;
+}
+
 /**
  * qlisttbl->lock(): Enter critical section.
  *
@@ -1042,35 +1425,39 @@ void qlisttbl_free(qlisttbl_t *tbl)
 {
     qlisttbl_clear(tbl);
     Q_MUTEX_DESTROY(tbl->qmutex);
+    free(tbl->index);
     free(tbl);
 }
 
 #ifndef _DOXYGEN_SKIP
 
 // lock must be obtained from caller
-static qlisttbl_obj_t *newobj(const char *name, const void *data, size_t size)
+static qlisttbl_obj_t *newobj(qlisttbl_t *tbl, const void *name, size_t namesize,
+                              uint32_t hash, const void *data, size_t size)
 {
     if (name == NULL || data == NULL || size <= 0) {
         errno = EINVAL;
         return false;
     }
 
-    // make a new object
-    char *dup_name = strdup(name);
-    void *dup_data = malloc(size);
-    qlisttbl_obj_t *obj = (qlisttbl_obj_t *)malloc(sizeof(qlisttbl_obj_t));
-    if (dup_name == NULL || dup_data == NULL || obj == NULL) {
-        if (dup_name != NULL) free(dup_name);
-        if (dup_data != NULL) free(dup_data);
-        if (obj != NULL) free(obj);
+    // make a new object in a single block, data goes first to be aligned.
+    qlisttbl_obj_t *obj = (qlisttbl_obj_t *)Q_ARENA_MALLOC(tbl->arena,
+                                                           sizeof(qlisttbl_obj_t)
+                                                           + size + namesize + 1);
+    if (obj == NULL) {
         errno = ENOMEM;
         return NULL;
     }
-    memcpy(dup_data, data, size);
     memset((void *)obj, '\0', sizeof(qlisttbl_obj_t));
+    void *dup_data = (void *)(obj + 1);
+    char *dup_name = (char *)dup_data + size;
+    memcpy(dup_data, data, size);
+    memcpy(dup_name, name, namesize);
+    dup_name[namesize] = '\0';
 
-    // obj->hash = qhashmurmur3_32(dup_name);
+    obj->hash = hash;
     obj->name = dup_name;
+    obj->namesize = namesize;
     obj->data = dup_data;
     obj->size = size;
 
@@ -1080,9 +1467,6 @@ static qlisttbl_obj_t *newobj(const char *name, const void *data, size_t size)
 // lock must be obtained from caller
 static bool insertobj(qlisttbl_t *tbl, qlisttbl_obj_t *obj)
 {
-    // update hash
-    obj->hash = qhashmurmur3_32(obj->name, strlen(obj->name));
-
     qlisttbl_obj_t *prev = obj->prev;
     qlisttbl_obj_t *next = obj->next;
 
@@ -1094,12 +1478,16 @@ static bool insertobj(qlisttbl_t *tbl, qlisttbl_obj_t *obj)
 
      // increase counter
     tbl->num++;
+    tbl->allocs++;
+
+    if (tbl->index != NULL) indexobj(tbl, obj);
 
     return true;
 }
 
 // lock must be obtained from caller
-static qlisttbl_obj_t *findobj(qlisttbl_t *tbl, const char *name, qlisttbl_obj_t *retobj)
+static qlisttbl_obj_t *findobj(qlisttbl_t *tbl, const void *name, size_t namesize,
+                               uint32_t hash, qlisttbl_obj_t *retobj)
 {
     if (retobj != NULL) {
         memset((void *)retobj, '\0', sizeof(qlisttbl_obj_t));
@@ -1110,17 +1498,29 @@ static qlisttbl_obj_t *findobj(qlisttbl_t *tbl, const char *name, qlisttbl_obj_t
         return NULL;
     }
 
-    uint32_t hash = qhashmurmur3_32(name, strlen(name));
-    qlisttbl_obj_t *obj = (tbl->lookupforward) ? tbl->first : tbl->last;
+    qlisttbl_obj_t *obj;
+    if (tbl->index != NULL) {
+        // buckets keep the table order, so backward lookup starts at the tail.
+        obj = tbl->index[indexhash(tbl, name, namesize, hash) % tbl->indexsize];
+        while (tbl->lookupforward == false && obj != NULL && obj->hnext != NULL) {
+            obj = obj->hnext;
+        }
+    } else {
+        obj = (tbl->lookupforward) ? tbl->first : tbl->last;
+    }
     while (obj != NULL) {
         // name string will be compared only if the hash matches.
-        if (tbl->namematch(obj, name, hash) == true) {
+        if (tbl->namematch(obj, name, namesize, hash) == true) {
            if (retobj != NULL) {
                 *retobj = *obj;
             }
             return obj;
         }
-        obj = (tbl->lookupforward)? obj->next : obj->prev;
+        if (tbl->index != NULL) {
+            obj = (tbl->lookupforward) ? obj->hnext : obj->hprev;
+        } else {
+            obj = (tbl->lookupforward) ? obj->next : obj->prev;
+        }
     }
 
     // not found, set prev and next chain.
@@ -1138,21 +1538,261 @@ static qlisttbl_obj_t *findobj(qlisttbl_t *tbl, const char *name, qlisttbl_obj_t
     return NULL;
 }
 
+// lock must be obtained from caller
+static bool getnextobj(qlisttbl_t *tbl, qlisttbl_obj_t *obj, const void *name,
+                       size_t namesize, uint32_t hash, bool newmem)
+{
+    if (obj == NULL) return NULL;
+
+    qlisttbl_lock(tbl);
+
+    qlisttbl_obj_t *cont = NULL;
+    if (obj->size == 0) {  // first time call
+        if (name == NULL) {  // full scan
+            cont = (tbl->lookupforward) ? tbl->first : tbl->last;
+        } else {  // name search
+            cont = findobj(tbl, name, namesize, hash, NULL);
+        }
+    } else if (name != NULL && tbl->index != NULL) {  // next in the bucket
+        cont = (tbl->lookupforward) ? obj->hnext : obj->hprev;
+    } else {  // next call
+        cont = (tbl->lookupforward) ? obj->next : obj->prev;
+    }
+
+    if (cont == NULL) {
+        errno = ENOENT;
+        qlisttbl_unlock(tbl);
+        return false;
+    }
+
+    bool ret = false;
+    while (cont != NULL) {
+        if (name == NULL || tbl->namematch(cont, name, namesize, hash) == true) {
+            if (newmem == true) {
+                obj->name = (char *)malloc(cont->namesize + 1);
+                obj->data = malloc(cont->size);
+                if (obj->name == NULL || obj->data == NULL) {
+                    if (obj->name != NULL) free(obj->name);
+                    if (obj->data != NULL) free(obj->data);
+                    obj->name = NULL;
+                    obj->data = NULL;
+                    errno = ENOMEM;
+                    break;
+                }
+                memcpy(obj->name, cont->name, cont->namesize + 1);
+                memcpy(obj->data, cont->data, cont->size);
+            } else {
+                obj->name = cont->name;
+                obj->data = cont->data;
+            }
+            obj->hash = cont->hash;
+            obj->namesize = cont->namesize;
+            obj->size = cont->size;
+            obj->prev = cont->prev;
+            obj->next = cont->next;
+            obj->hprev = cont->hprev;
+            obj->hnext = cont->hnext;
+
+            ret = true;
+            break;
+        }
+
+        if (name != NULL && tbl->index != NULL) {
+            cont = (tbl->lookupforward) ? cont->hnext : cont->hprev;
+        } else {
+            cont = (tbl->lookupforward) ? cont->next : cont->prev;
+        }
+    }
+    qlisttbl_unlock(tbl);
+
+    if (ret == false) {
+        errno = ENOENT;
+    }
+
+    return ret;
+}
+
 // key comp
-static bool namematch(qlisttbl_obj_t *obj, const char *name, uint32_t hash)
+static bool namematch(qlisttbl_obj_t *obj, const void *name, size_t namesize,
+                      uint32_t hash)
 {
-    if ((obj->hash == hash) && !strcmp(obj->name, name)) {
+    if ((obj->hash == hash) && (obj->namesize == namesize)
+        && !memcmp(obj->name, name, namesize)) {
         return true;
     }
     return false;
 }
 
-static bool namecasematch(qlisttbl_obj_t *obj, const char *name, uint32_t hash)
+static bool namecasematch(qlisttbl_obj_t *obj, const void *name, size_t namesize,
+                          uint32_t hash)
 {
-    if (!strcasecmp(obj->name, name)) {
+    if ((obj->namesize == namesize)
+        && !strncasecmp(obj->name, (const char *)name, namesize)) {
         return true;
     }
     return false;
 }
 
+// bottom-up merge of the runs of width 1, 2, 4, ... the names are compared
+// with namecmp when cmp is NULL.
+static void sortobjs(qlisttbl_t *tbl,
+                     int (*cmp)(const qlisttbl_obj_t *obj1,
+                                const qlisttbl_obj_t *obj2))
+{
+    qlisttbl_obj_t *head = tbl->first;
+    size_t width;
+    for (width = 1; width < tbl->num; width *= 2) {
+        qlisttbl_obj_t *p = head, *tail = NULL;
+        head = NULL;
+        while (p != NULL) {
+            qlisttbl_obj_t *q = p;
+            size_t psize = 0, qsize = width;
+            while (psize < width && q != NULL) {
+                q = q->next;
+                psize++;
+            }
+
+            while (psize > 0 || (qsize > 0 && q != NULL)) {
+                qlisttbl_obj_t *obj;
+                if (psize == 0) {
+                    obj = q;
+                    q = q->next;
+                    qsize--;
+                } else if (qsize == 0 || q == NULL
+                        || ((cmp != NULL) ? cmp(p, q)
+                            : tbl->namecmp(p->name, q->name)) <= 0) {
+                    obj = p;
+                    p = p->next;
+                    psize--;
+                } else {
+                    obj = q;
+                    q = q->next;
+                    qsize--;
+                }
+
+                if (tail != NULL)
+                    tail->next = obj;
+                else
+                    head = obj;
+                obj->prev = tail;
+                tail = obj;
+            }
+            p = q;
+        }
+        tail->next = NULL;
+        tbl->first = head;
+        tbl->last = tail;
+    }
+}
+
+// the given hash is not used for case insensitive tables, so the index takes
+// a hash of the case folded name instead.
+static uint32_t indexhash(qlisttbl_t *tbl, const void *name, size_t namesize,
+                          uint32_t hash)
+{
+    if (tbl->caseinsensitive == false) return hash;
+
+    // FNV-1a
+    const unsigned char *s = (const unsigned char *)name;
+    uint32_t h = 0x811C9DC5;
+    size_t i;
+    for (i = 0; i < namesize; i++) {
+        h ^= (uint32_t)tolower(s[i]);
+        h *= 0x01000193;
+    }
+    return h;
+}
+
+// link a new object into its bucket. the object must be either the first or
+// the last one of the table, so the bucket stays in the table order.
+static void indexobj(qlisttbl_t *tbl, qlisttbl_obj_t *obj)
+{
+    // grow the index over 1 load factor, which links the object too.
+    if (tbl->num > tbl->indexsize && reindex(tbl, tbl->indexsize * 2) == true) {
+        tbl->resizes++;
+        return;
+    }
+
+    qlisttbl_obj_t **bucket = &tbl->index[indexhash(tbl, obj->name, obj->namesize,
+                                                    obj->hash) % tbl->indexsize];
+    obj->hprev = NULL;
+    obj->hnext = NULL;
+    if (*bucket == NULL) {
+        *bucket = obj;
+        return;
+    }
+
+    tbl->collisions++;
+    if (obj->next == NULL) {  // the last one, append
+        qlisttbl_obj_t *tail;
+        for (tail = *bucket; tail->hnext != NULL; tail = tail->hnext);
+        tail->hnext = obj;
+        obj->hprev = tail;
+    } else {  // the first one, prepend
+        obj->hnext = *bucket;
+        (*bucket)->hprev = obj;
+        *bucket = obj;
+    }
+}
+
+static void unindexobj(qlisttbl_t *tbl, qlisttbl_obj_t *obj)
+{
+    if (obj->hprev != NULL) {
+        obj->hprev->hnext = obj->hnext;
+    } else {
+        tbl->index[indexhash(tbl, obj->name, obj->namesize, obj->hash)
+                   % tbl->indexsize] = obj->hnext;
+    }
+    if (obj->hnext != NULL) obj->hnext->hprev = obj->hprev;
+}
+
+// rebuild the index in the table order. the current index stays if the new
+// buckets can't be allocated.
+static bool reindex(qlisttbl_t *tbl, size_t indexsize)
+{
+    qlisttbl_obj_t **index = (qlisttbl_obj_t **)calloc(indexsize,
+                                                       sizeof(qlisttbl_obj_t *));
+    if (index == NULL) {
+        errno = ENOMEM;
+        return false;
+    }
+
+    // prepend from the last one
+    qlisttbl_obj_t *obj;
+    for (obj = tbl->last; obj != NULL; obj = obj->prev) {
+        qlisttbl_obj_t **bucket = &index[indexhash(tbl, obj->name, obj->namesize,
+                                                   obj->hash) % indexsize];
+        obj->hprev = NULL;
+        obj->hnext = *bucket;
+        if (*bucket != NULL) (*bucket)->hprev = obj;
+        *bucket = obj;
+    }
+
+    free(tbl->index);
+    tbl->index = index;
+    tbl->indexsize = indexsize;
+    return true;
+}
+
+// append data to the write buffer, flushing it when it's full.
+static bool bufwrite(int fd, char *buf, size_t *buflen, const void *data,
+                     size_t size)
+{
+    if (*buflen + size > IOBUF_SIZE) {
+        if (*buflen > 0 && qio_write(fd, buf, *buflen, -1) != (ssize_t)*buflen) {
+            return false;
+        }
+        *buflen = 0;
+
+        // too big to buffer
+        if (size > IOBUF_SIZE) {
+            return (qio_write(fd, data, size, -1) == (ssize_t)size);
+        }
+    }
+
+    memcpy(buf + *buflen, data, size);
+    *buflen += size;
+    return true;
+}
+
 #endif /* _DOXYGEN_SKIP */
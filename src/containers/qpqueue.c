@@ -0,0 +1,756 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/**
+ * @file qpqueue.c Priority queue container implementation.
+ *
+ * qpqueue is a 4-ary min-heap keeping fixed size elements in one contiguous
+ * array, in the same way qvector does. The element which compares the least
+ * with the given comparison function comes out first, so reverse the
+ * comparison for a max-heap. A 4-ary heap is half as deep as a binary one
+ * and the children of a node sit next to each other, which takes fewer cache
+ * misses on pushing and on popping alike.
+ *
+ * Every pushed element gets a handle which stays valid while the element is
+ * in the queue, whatever position it takes. Use that to change the priority
+ * of an element (decrease-key) or to take it out of the middle of the queue,
+ * which is what timeouts and schedulers need. A handle is never reused by
+ * another element, so using a stale handle safely fails.
+ *
+ * @code
+ *  struct job {
+ *    int64_t due;
+ *    int id;
+ *  };
+ *
+ *  static int cmp_job(const void *data1, const void *data2) {
+ *    const struct job *job1 = data1, *job2 = data2;
+ *    return (job1->due < job2->due) ? -1 : (job1->due > job2->due);
+ *  }
+ *
+ *  qpqueue_t *pqueue = qpqueue(0, sizeof(struct job), cmp_job, 0);
+ *
+ *  struct job job = { 1000, 1 };
+ *  int64_t handle = pqueue->push(pqueue, &job);
+ *
+ *  // move it forward
+ *  job.due = 500;
+ *  pqueue->update(pqueue, handle, &job);
+ *
+ *  struct job *next;
+ *  while ((next = pqueue->top(pqueue, false)) != NULL) {
+ *    (...run next...)
+ *    pqueue->removetop(pqueue);
+ *  }
+ *
+ *  pqueue->free(pqueue);
+ * @endcode
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include "qinternal.h"
+#include "containers/qpqueue.h"
+
+#ifndef _DOXYGEN_SKIP
+
+#define ARITY           (4)
+
+typedef struct qpqueue_slot_s qpqueue_slot_t;
+struct qpqueue_slot_s {
+    uint32_t gen;       /* generation, the upper half of the handle */
+    int pos;            /* heap position, -1 if free */
+    int next;           /* next free slot */
+};
+
+#define ELEM(q, i)      ((char *) (q)->data + (q)->objsize * (i))
+#define SLOT(q, i)      ((qpqueue_slot_t *) (q)->slots + (i))
+
+static bool grow(qpqueue_t *pqueue, size_t max);
+static int alloc_slot(qpqueue_t *pqueue);
+static void free_slot(qpqueue_t *pqueue, int slot);
+static int find_slot(qpqueue_t *pqueue, int64_t handle);
+static int64_t get_handle(qpqueue_t *pqueue, int slot);
+static void sift_up(qpqueue_t *pqueue, size_t pos);
+static void sift_down(qpqueue_t *pqueue, size_t pos);
+static void fix_at(qpqueue_t *pqueue, size_t pos);
+static void remove_at(qpqueue_t *pqueue, size_t pos);
+
+#endif
+
+/**
+ * Create new qpqueue_t container
+ *
+ * @param max       number of elements to allocate in advance.
+ * @param objsize   size of each element
+ * @param cmp       comparison function which returns a negative value when
+ *                  data1 has to come out before data2, 0 when they are equal
+ *                  and a positive value otherwise.
+ * @param options   combination of initialization options.
+ *
+ * @return a pointer of malloced qpqueue_t container, otherwise returns NULL
+ * @retval errno will be set in error condition.
+ *  - ENOMEM : Memory allocation failure.
+ *  - EINVAL : Invalid argument.
+ *
+ * @code
+ *  qpqueue_t *pqueue = qpqueue(0, sizeof(int), cmp_int, 0);
+ * @endcode
+ *
+ * @note
+ *  Available options:
+ *  - QPQUEUE_THREADSAFE - make it thread-safe.
+ *  The queue doubles its size when it's full.
+ */
+qpqueue_t *qpqueue(size_t max, size_t objsize,
+                   int (*cmp)(const void *data1, const void *data2),
+                   int options) {
+    if (objsize == 0 || cmp == NULL) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    qpqueue_t *pqueue = (qpqueue_t *) calloc(1, sizeof(qpqueue_t));
+    if (pqueue == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    pqueue->objsize = objsize;
+    pqueue->cmp = cmp;
+    pqueue->freeslot = -1;
+
+    pqueue->tmp = malloc(objsize);
+    if (pqueue->tmp == NULL || (max > 0 && grow(pqueue, max) == false)) {
+        qpqueue_free(pqueue);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    // handle options
+    if (options & QPQUEUE_THREADSAFE) {
+        Q_MUTEX_NEW(pqueue->qmutex, true);
+        if (pqueue->qmutex == NULL) {
+            qpqueue_free(pqueue);
+            errno = ENOMEM;
+            return NULL;
+        }
+    }
+
+    // member methods
+    pqueue->push = qpqueue_push;
+    pqueue->pusharray = qpqueue_pusharray;
+
+    pqueue->top = qpqueue_top;
+    pqueue->tophandle = qpqueue_tophandle;
+    pqueue->pop = qpqueue_pop;
+    pqueue->removetop = qpqueue_removetop;
+
+    pqueue->get = qpqueue_get;
+    pqueue->update = qpqueue_update;
+    pqueue->remove = qpqueue_remove;
+
+    pqueue->size = qpqueue_size;
+    pqueue->reserve = qpqueue_reserve;
+    pqueue->lock = qpqueue_lock;
+    pqueue->unlock = qpqueue_unlock;
+    pqueue->clear = qpqueue_clear;
+    pqueue->debug = qpqueue_debug;
+    pqueue->free = qpqueue_free;
+
+    return pqueue;
+}
+
+/**
+ * qpqueue->push(): Insert an element.
+ *
+ * @param pqueue    qpqueue_t container pointer.
+ * @param data      a pointer which points data memory.
+ *
+ * @return a positive handle of the element if successful, otherwise
+ *         returns -1.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - ENOMEM : Memory allocation failure.
+ */
+int64_t qpqueue_push(qpqueue_t *pqueue, const void *data) {
+    int64_t handle;
+    if (qpqueue_pusharray(pqueue, data, 1, &handle) == false) {
+        return -1;
+    }
+    return handle;
+}
+
+/**
+ * qpqueue->pusharray(): Insert an array of elements.
+ *
+ * @param pqueue    qpqueue_t container pointer.
+ * @param data      a pointer which points the first element of the array.
+ * @param n         number of elements in the array.
+ * @param handles   an array of n to store the handles in, or NULL if the
+ *                  handles are not needed.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @note
+ *  When the array is bigger than the queue, the whole heap is rebuilt from
+ *  the bottom up, which takes linear time instead of pushing elements one by
+ *  one. So this is the way to build a queue from an existing array.
+ */
+bool qpqueue_pusharray(qpqueue_t *pqueue, const void *data, size_t n,
+                       int64_t *handles) {
+    if (data == NULL || n == 0) {
+        errno = EINVAL;
+        return false;
+    }
+
+    qpqueue_lock(pqueue);
+    if (n > INT_MAX - pqueue->num
+            || (pqueue->num + n > pqueue->max
+                    && grow(pqueue, pqueue->num + n) == false)) {
+        qpqueue_unlock(pqueue);
+        errno = ENOMEM;
+        return false;
+    }
+
+    size_t first = pqueue->num;
+    memcpy(ELEM(pqueue, first), data, pqueue->objsize * n);
+    size_t i;
+    for (i = 0; i < n; i++) {
+        int slot = alloc_slot(pqueue);
+        SLOT(pqueue, slot)->pos = first + i;
+        pqueue->heapslot[first + i] = slot;
+        if (handles != NULL) {
+            handles[i] = get_handle(pqueue, slot);
+        }
+    }
+    pqueue->num += n;
+
+    if (n > first && pqueue->num > 1) {
+        // Floyd's bottom-up heap construction.
+        size_t pos = (pqueue->num - 2) / ARITY + 1;
+        while (pos-- > 0) {
+            sift_down(pqueue, pos);
+        }
+    } else {
+        for (i = first; i < pqueue->num; i++) {
+            sift_up(pqueue, i);
+        }
+    }
+    qpqueue_unlock(pqueue);
+
+    return true;
+}
+
+/**
+ * qpqueue->top(): Returns the element which comes out first.
+ *
+ * @param pqueue    qpqueue_t container pointer.
+ * @param newmem    whether or not to allocate memory for the element.
+ *
+ * @return a pointer of the element, otherwise returns NULL.
+ * @retval errno will be set in error condition.
+ *  - ENOENT : Queue is empty.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @note
+ *  Without newmem, the returned pointer points the internal array, which is
+ *  valid until the queue is modified.
+ */
+void *qpqueue_top(qpqueue_t *pqueue, bool newmem) {
+    qpqueue_lock(pqueue);
+    if (pqueue->num == 0) {
+        qpqueue_unlock(pqueue);
+        errno = ENOENT;
+        return NULL;
+    }
+
+    void *data = ELEM(pqueue, 0);
+    if (newmem) {
+        void *dump = malloc(pqueue->objsize);
+        if (dump == NULL) {
+            qpqueue_unlock(pqueue);
+            errno = ENOMEM;
+            return NULL;
+        }
+        memcpy(dump, data, pqueue->objsize);
+        data = dump;
+    }
+    qpqueue_unlock(pqueue);
+
+    return data;
+}
+
+/**
+ * qpqueue->tophandle(): Returns the handle of the element which comes out
+ * first.
+ *
+ * @param pqueue    qpqueue_t container pointer.
+ *
+ * @return the handle of the element, otherwise returns -1.
+ * @retval errno will be set in error condition.
+ *  - ENOENT : Queue is empty.
+ */
+int64_t qpqueue_tophandle(qpqueue_t *pqueue) {
+    qpqueue_lock(pqueue);
+    if (pqueue->num == 0) {
+        qpqueue_unlock(pqueue);
+        errno = ENOENT;
+        return -1;
+    }
+    int64_t handle = get_handle(pqueue, pqueue->heapslot[0]);
+    qpqueue_unlock(pqueue);
+
+    return handle;
+}
+
+/**
+ * qpqueue->pop(): Takes out the element which comes out first.
+ *
+ * @param pqueue    qpqueue_t container pointer.
+ *
+ * @return a pointer of malloced element, otherwise returns NULL.
+ * @retval errno will be set in error condition.
+ *  - ENOENT : Queue is empty.
+ *  - ENOMEM : Memory allocation failure.
+ */
+void *qpqueue_pop(qpqueue_t *pqueue) {
+    qpqueue_lock(pqueue);
+    void *data = qpqueue_top(pqueue, true);
+    if (data != NULL) {
+        remove_at(pqueue, 0);
+    }
+    qpqueue_unlock(pqueue);
+
+    return data;
+}
+
+/**
+ * qpqueue->removetop(): Removes the element which comes out first.
+ *
+ * @param pqueue    qpqueue_t container pointer.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - ENOENT : Queue is empty.
+ */
+bool qpqueue_removetop(qpqueue_t *pqueue) {
+    qpqueue_lock(pqueue);
+    if (pqueue->num == 0) {
+        qpqueue_unlock(pqueue);
+        errno = ENOENT;
+        return false;
+    }
+    remove_at(pqueue, 0);
+    qpqueue_unlock(pqueue);
+
+    return true;
+}
+
+/**
+ * qpqueue->get(): Returns the element of the handle.
+ *
+ * @param pqueue    qpqueue_t container pointer.
+ * @param handle    the handle given when the element was pushed.
+ * @param newmem    whether or not to allocate memory for the element.
+ *
+ * @return a pointer of the element, otherwise returns NULL.
+ * @retval errno will be set in error condition.
+ *  - ENOENT : No such element.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @note
+ *  Never modify the element through the returned pointer, which breaks the
+ *  order of the queue. Use qpqueue->update() instead.
+ */
+void *qpqueue_get(qpqueue_t *pqueue, int64_t handle, bool newmem) {
+    qpqueue_lock(pqueue);
+    int slot = find_slot(pqueue, handle);
+    if (slot < 0) {
+        qpqueue_unlock(pqueue);
+        errno = ENOENT;
+        return NULL;
+    }
+
+    void *data = ELEM(pqueue, SLOT(pqueue, slot)->pos);
+    if (newmem) {
+        void *dump = malloc(pqueue->objsize);
+        if (dump == NULL) {
+            qpqueue_unlock(pqueue);
+            errno = ENOMEM;
+            return NULL;
+        }
+        memcpy(dump, data, pqueue->objsize);
+        data = dump;
+    }
+    qpqueue_unlock(pqueue);
+
+    return data;
+}
+
+/**
+ * qpqueue->update(): Replaces the element of the handle, moving it to the
+ * position of its new priority.
+ *
+ * @param pqueue    qpqueue_t container pointer.
+ * @param handle    the handle given when the element was pushed.
+ * @param data      a pointer which points the new data.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - ENOENT : No such element.
+ *
+ * @note
+ *  Both raising and lowering the priority take O(log n) time.
+ */
+bool qpqueue_update(qpqueue_t *pqueue, int64_t handle, const void *data) {
+    if (data == NULL) {
+        errno = EINVAL;
+        return false;
+    }
+
+    qpqueue_lock(pqueue);
+    int slot = find_slot(pqueue, handle);
+    if (slot < 0) {
+        qpqueue_unlock(pqueue);
+        errno = ENOENT;
+        return false;
+    }
+    size_t pos = SLOT(pqueue, slot)->pos;
+    memmove(ELEM(pqueue, pos), data, pqueue->objsize);
+    fix_at(pqueue, pos);
+    qpqueue_unlock(pqueue);
+
+    return true;
+}
+
+/**
+ * qpqueue->remove(): Removes the element of the handle.
+ *
+ * @param pqueue    qpqueue_t container pointer.
+ * @param handle    the handle given when the element was pushed.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - ENOENT : No such element.
+ */
+bool qpqueue_remove(qpqueue_t *pqueue, int64_t handle) {
+    qpqueue_lock(pqueue);
+    int slot = find_slot(pqueue, handle);
+    if (slot < 0) {
+        qpqueue_unlock(pqueue);
+        errno = ENOENT;
+        return false;
+    }
+    remove_at(pqueue, SLOT(pqueue, slot)->pos);
+    qpqueue_unlock(pqueue);
+
+    return true;
+}
+
+/**
+ * qpqueue->size(): Returns the number of elements in this queue.
+ *
+ * @param pqueue    qpqueue_t container pointer.
+ *
+ * @return the number of elements in this queue.
+ */
+size_t qpqueue_size(qpqueue_t *pqueue) {
+    return pqueue->num;
+}
+
+/**
+ * qpqueue->reserve(): Makes room for n more elements in advance.
+ *
+ * @param pqueue    qpqueue_t container pointer.
+ * @param n         number of elements to add.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - ENOMEM : Memory allocation failure.
+ */
+bool qpqueue_reserve(qpqueue_t *pqueue, size_t n) {
+    qpqueue_lock(pqueue);
+    if (n > INT_MAX - pqueue->num
+            || (pqueue->num + n > pqueue->max
+                    && grow(pqueue, pqueue->num + n) == false)) {
+        qpqueue_unlock(pqueue);
+        errno = ENOMEM;
+        return false;
+    }
+    qpqueue_unlock(pqueue);
+
+    return true;
+}
+
+/**
+ * qpqueue->lock(): Enters critical section.
+ *
+ * @param pqueue    qpqueue_t container pointer.
+ *
+ * @note
+ *  From user side, normally locking operation is only needed when the
+ *  pointer of an element is used without newmem.
+ */
+void qpqueue_lock(qpqueue_t *pqueue) {
+    Q_MUTEX_ENTER(pqueue->qmutex);
+}
+
+/**
+ * qpqueue->unlock(): Leaves critical section.
+ *
+ * @param pqueue    qpqueue_t container pointer.
+ */
+void qpqueue_unlock(qpqueue_t *pqueue) {
+    Q_MUTEX_LEAVE(pqueue->qmutex);
+}
+
+/**
+ * qpqueue->clear(): Removes all the elements in this queue.
+ *
+ * @param pqueue    qpqueue_t container pointer.
+ */
+void qpqueue_clear(qpqueue_t *pqueue) {
+    qpqueue_lock(pqueue);
+    while (pqueue->num > 0) {
+        pqueue->num--;
+        free_slot(pqueue, pqueue->heapslot[pqueue->num]);
+    }
+    qpqueue_unlock(pqueue);
+}
+
+/**
+ * qpqueue->debug(): Prints out stored elements in heap order for debugging
+ * purpose.
+ *
+ * @param pqueue    qpqueue_t container pointer.
+ * @param out       output stream FILE descriptor such like stdout, stderr.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EIO : Invalid output stream.
+ */
+bool qpqueue_debug(qpqueue_t *pqueue, FILE *out) {
+    if (out == NULL) {
+        errno = EIO;
+        return false;
+    }
+
+    qpqueue_lock(pqueue);
+    size_t i;
+    for (i = 0; i < pqueue->num; i++) {
+        fprintf(out, "%zu=", i);
+        _q_textout(out, ELEM(pqueue, i), pqueue->objsize, MAX_HUMANOUT);
+        fprintf(out, " (%zu) handle=%" PRId64 "\n", pqueue->objsize,
+                get_handle(pqueue, pqueue->heapslot[i]));
+    }
+    qpqueue_unlock(pqueue);
+
+    return true;
+}
+
+/**
+ * qpqueue->free(): Free this queue.
+ *
+ * @param pqueue    qpqueue_t container pointer.
+ */
+void qpqueue_free(qpqueue_t *pqueue) {
+    Q_MUTEX_DESTROY(pqueue->qmutex);
+    free(pqueue->data);
+    free(pqueue->heapslot);
+    free(pqueue->slots);
+    free(pqueue->tmp);
+    free(pqueue);
+}
+
+#ifndef _DOXYGEN_SKIP
+
+// grow the arrays to hold at least max elements.
+static bool grow(qpqueue_t *pqueue, size_t max) {
+    size_t newmax = (pqueue->max > 0) ? pqueue->max : 16;
+    while (newmax < max) {
+        newmax *= 2;
+    }
+    if (newmax > INT_MAX) {
+        newmax = INT_MAX;
+    }
+
+    void *data = realloc(pqueue->data, pqueue->objsize * newmax);
+    if (data == NULL) {
+        return false;
+    }
+    pqueue->data = data;
+
+    int *heapslot = (int *) realloc(pqueue->heapslot, sizeof(int) * newmax);
+    if (heapslot == NULL) {
+        return false;
+    }
+    pqueue->heapslot = heapslot;
+
+    qpqueue_slot_t *slots = (qpqueue_slot_t *) realloc(
+            pqueue->slots, sizeof(qpqueue_slot_t) * newmax);
+    if (slots == NULL) {
+        return false;
+    }
+    pqueue->slots = slots;
+
+    int i;
+    for (i = (int) newmax - 1; i >= (int) pqueue->max; i--) {
+        slots[i].gen = 1;
+        slots[i].pos = -1;
+        slots[i].next = pqueue->freeslot;
+        pqueue->freeslot = i;
+    }
+    pqueue->max = newmax;
+
+    return true;
+}
+
+// the slots never run out, there is one for each allocated element.
+static int alloc_slot(qpqueue_t *pqueue) {
+    int slot = pqueue->freeslot;
+    pqueue->freeslot = SLOT(pqueue, slot)->next;
+    return slot;
+}
+
+// put back to the free list with a new generation, invalidating the handle.
+static void free_slot(qpqueue_t *pqueue, int slot) {
+    qpqueue_slot_t *s = SLOT(pqueue, slot);
+    s->gen = (s->gen + 1) & INT32_MAX;
+    if (s->gen == 0)
+        s->gen = 1;
+    s->pos = -1;
+    s->next = pqueue->freeslot;
+    pqueue->freeslot = slot;
+}
+
+static int find_slot(qpqueue_t *pqueue, int64_t handle) {
+    if (handle <= 0)
+        return -1;
+    int64_t slot = handle & 0xffffffff;
+    uint32_t gen = (uint32_t) (handle >> 32);
+    if (slot >= (int64_t) pqueue->max)
+        return -1;
+    qpqueue_slot_t *s = SLOT(pqueue, slot);
+    if (s->gen != gen || s->pos < 0)
+        return -1;
+    return (int) slot;
+}
+
+static int64_t get_handle(qpqueue_t *pqueue, int slot) {
+    return ((int64_t) SLOT(pqueue, slot)->gen << 32) | (uint32_t) slot;
+}
+
+// move the element up while it's less than the parent, carrying it in tmp.
+static void sift_up(qpqueue_t *pqueue, size_t pos) {
+    size_t objsize = pqueue->objsize;
+    int slot = pqueue->heapslot[pos];
+    memcpy(pqueue->tmp, ELEM(pqueue, pos), objsize);
+
+    while (pos > 0) {
+        size_t parent = (pos - 1) / ARITY;
+        if (pqueue->cmp(pqueue->tmp, ELEM(pqueue, parent)) >= 0)
+            break;
+        memcpy(ELEM(pqueue, pos), ELEM(pqueue, parent), objsize);
+        pqueue->heapslot[pos] = pqueue->heapslot[parent];
+        SLOT(pqueue, pqueue->heapslot[pos])->pos = pos;
+        pos = parent;
+    }
+
+    memcpy(ELEM(pqueue, pos), pqueue->tmp, objsize);
+    pqueue->heapslot[pos] = slot;
+    SLOT(pqueue, slot)->pos = pos;
+}
+
+// move the element down while the least child is less than it.
+static void sift_down(qpqueue_t *pqueue, size_t pos) {
+    size_t objsize = pqueue->objsize;
+    int slot = pqueue->heapslot[pos];
+    memcpy(pqueue->tmp, ELEM(pqueue, pos), objsize);
+
+    while (true) {
+        size_t child = pos * ARITY + 1;
+        if (child >= pqueue->num)
+            break;
+        size_t last = child + ARITY;
+        if (last > pqueue->num)
+            last = pqueue->num;
+
+        size_t least = child, i;
+        for (i = child + 1; i < last; i++) {
+            if (pqueue->cmp(ELEM(pqueue, i), ELEM(pqueue, least)) < 0)
+                least = i;
+        }
+        if (pqueue->cmp(ELEM(pqueue, least), pqueue->tmp) >= 0)
+            break;
+
+        memcpy(ELEM(pqueue, pos), ELEM(pqueue, least), objsize);
+        pqueue->heapslot[pos] = pqueue->heapslot[least];
+        SLOT(pqueue, pqueue->heapslot[pos])->pos = pos;
+        pos = least;
+    }
+
+    memcpy(ELEM(pqueue, pos), pqueue->tmp, objsize);
+    pqueue->heapslot[pos] = slot;
+    SLOT(pqueue, slot)->pos = pos;
+}
+
+// restore the order after the element at pos has changed.
+static void fix_at(qpqueue_t *pqueue, size_t pos) {
+    if (pos > 0
+            && pqueue->cmp(ELEM(pqueue, pos), ELEM(pqueue, (pos - 1) / ARITY))
+                    < 0) {
+        sift_up(pqueue, pos);
+    } else {
+        sift_down(pqueue, pos);
+    }
+}
+
+// fill the hole with the last element and restore the order.
+static void remove_at(qpqueue_t *pqueue, size_t pos) {
+    free_slot(pqueue, pqueue->heapslot[pos]);
+    pqueue->num--;
+    if (pos == pqueue->num)
+        return;
+
+    memcpy(ELEM(pqueue, pos), ELEM(pqueue, pqueue->num), pqueue->objsize);
+    pqueue->heapslot[pos] = pqueue->heapslot[pqueue->num];
+    SLOT(pqueue, pqueue->heapslot[pos])->pos = pos;
+    fix_at(pqueue, pos);
+}
+
+#endif /* _DOXYGEN_SKIP */
@@ -99,6 +99,19 @@
  *  pop(): B object
  *  pop(): A object
  * @endcode
+ *
+ * A queue created by qqueue_ring() keeps fixed size slots in a preallocated
+ * ring buffer instead of a list. Its push and pop are lock-free for any
+ * number of producers and consumers and don't allocate memory except for
+ * the copy returned by pop() and popstr().
+ *
+ * @code
+ *  qqueue_t *ring = qqueue_ring(1024, sizeof(struct job));
+ *  ring->push(ring, &job, sizeof(job));       // from any thread
+ *  struct job *j = ring->pop(ring, NULL);     // from any thread
+ *  free(j);
+ *  ring->free(ring);
+ * @endcode
  */
 
 #include <stdio.h>
@@ -106,9 +119,47 @@
 #include <stdbool.h>
 #include <string.h>
 #include <errno.h>
+#include <time.h>
 #include "qinternal.h"
 #include "containers/qqueue.h"
 
+#ifndef _DOXYGEN_SKIP
+
+/* waiting consumers of pop_wait() */
+typedef struct qqueue_wait_s {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int waiters;            /*!< number of sleeping consumers */
+} qqueue_wait_t;
+
+/* ring buffer slot, the element data follows it */
+typedef struct ring_slot_s {
+    size_t seq;     /*!< turn sequence of this slot */
+    size_t size;    /*!< size of the element */
+} ring_slot_t;
+
+/* bounded multi-producer multi-consumer ring buffer */
+typedef struct qqueue_ring_s {
+    size_t enqpos __attribute__((aligned(64)));  /*!< next enqueue position */
+    size_t deqpos __attribute__((aligned(64)));  /*!< next dequeue position */
+    size_t mask __attribute__((aligned(64)));    /*!< number of slots - 1 */
+    size_t objsize;                              /*!< maximum element size */
+    size_t slotsize;                             /*!< size of a slot with its data */
+    char *slots;                                 /*!< slot array */
+} qqueue_ring_t;
+
+static qqueue_ring_t *ring_new(size_t max, size_t objsize);
+static bool ring_push(qqueue_ring_t *ring, const void *data, size_t size);
+static bool ring_pop(qqueue_ring_t *ring, void *buf, size_t bufsize,
+                     size_t *size);
+static void *ring_popmem(qqueue_ring_t *ring, size_t *size);
+static size_t ring_size(qqueue_ring_t *ring);
+static qqueue_wait_t *wait_new(void);
+static void wait_free(qqueue_wait_t *w);
+static void wake_waiters(qqueue_t *queue);
+
+#endif
+
 /**
  * Create new queue container
  *
@@ -139,9 +190,17 @@ qqueue_t *qqueue(int options) {
         free(queue);
         return NULL;
     }
+    queue->qwait = wait_new();
+    if (queue->qwait == NULL) {
+        queue->list->free(queue->list);
+        free(queue);
+        errno = ENOMEM;
+        return NULL;
+    }
 
     // methods
     queue->setsize = qqueue_setsize;
+    queue->poolstat = qqueue_poolstat;
 
     queue->push = qqueue_push;
     queue->pushstr = qqueue_pushstr;
@@ -151,6 +210,8 @@ qqueue_t *qqueue(int options) {
     queue->popstr = qqueue_popstr;
     queue->popint = qqueue_popint;
     queue->popat = qqueue_popat;
+    queue->pop_wait = qqueue_pop_wait;
+    queue->popbatch = qqueue_popbatch;
 
     queue->get = qqueue_get;
     queue->getstr = qqueue_getstr;
@@ -165,6 +226,51 @@ qqueue_t *qqueue(int options) {
     return queue;
 }
 
+/**
+ * Create a lock-free queue over a bounded ring buffer.
+ *
+ * @param max       maximum number of elements. It's rounded up to the next
+ *                  power of 2.
+ * @param objsize   maximum size of an element.
+ *
+ * @return a pointer of malloced qqueue container, otherwise returns NULL.
+ * @retval errno will be set in error condition.
+ *  - EINVAL    : Invalid argument.
+ *  - ENOMEM    : Memory allocation failure.
+ *
+ * @code
+ *   qqueue_t *queue = qqueue_ring(1024, sizeof(int64_t));
+ * @endcode
+ *
+ * @note
+ *  The queue is always thread-safe. push() and pop() can be called from
+ *  any number of threads concurrently without locking, push() fails with
+ *  ENOBUFS when all the slots are taken. Only the head of the queue is
+ *  accessible, so popat(), get(), getstr(), getint() and getat() fail with
+ *  ENOTSUP, and setsize() can't change the capacity.
+ */
+qqueue_t *qqueue_ring(size_t max, size_t objsize) {
+    if (max == 0 || objsize == 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    qqueue_t *queue = qqueue(0);
+    if (queue == NULL) {
+        return NULL;
+    }
+    queue->ring = ring_new(max, objsize);
+    if (queue->ring == NULL) {
+        qqueue_free(queue);
+        errno = ENOMEM;
+        return NULL;
+    }
+    queue->list->free(queue->list);
+    queue->list = NULL;
+
+    return queue;
+}
+
 /**
  * qqueue->setsize(): Sets maximum number of elements allowed in this
  * queue.
@@ -175,9 +281,35 @@ qqueue_t *qqueue(int options) {
  * @return previous maximum number.
  */
 size_t qqueue_setsize(qqueue_t *queue, size_t max) {
+    if (queue->ring != NULL) {
+        return ((qqueue_ring_t *) queue->ring)->mask + 1;
+    }
     return queue->list->setsize(queue->list, max);
 }
 
+/**
+ * qqueue->poolstat(): Get the node pool counters of this queue.
+ *
+ * @param queue     qqueue container pointer.
+ * @param hits      if not NULL, the number of pushes served by the pool.
+ * @param misses    if not NULL, the number of pushes that called malloc().
+ *
+ * @return the number of nodes in the pool.
+ *
+ * @note
+ *  Popped nodes are recycled, so steady push and pop don't call malloc()
+ *  for the elements. Please refer qlist_setpool() for the details.
+ */
+size_t qqueue_poolstat(qqueue_t *queue, size_t *hits, size_t *misses) {
+    if (queue->ring != NULL) {
+        // the slots are preallocated
+        if (hits != NULL) *hits = 0;
+        if (misses != NULL) *misses = 0;
+        return 0;
+    }
+    return queue->list->poolstat(queue->list, hits, misses);
+}
+
 /**
  * qqueue->push(): Pushes an element onto the top of this queue.
  *
@@ -193,7 +325,16 @@ size_t qqueue_setsize(qqueue_t *queue, size_t max) {
  *  - ENOMEM    : Memory allocation failure.
  */
 bool qqueue_push(qqueue_t *queue, const void *data, size_t size) {
-    return queue->list->addlast(queue->list, data, size);
+    bool pushed;
+    if (queue->ring != NULL) {
+        pushed = ring_push(queue->ring, data, size);
+    } else {
+        pushed = queue->list->addlast(queue->list, data, size);
+    }
+    if (pushed) {
+        wake_waiters(queue);
+    }
+    return pushed;
 }
 
 /**
@@ -215,7 +356,7 @@ bool qqueue_pushstr(qqueue_t *queue, const char *str) {
         errno = EINVAL;
         return false;
     }
-    return queue->list->addlast(queue->list, str, strlen(str) + 1);
+    return qqueue_push(queue, str, strlen(str) + 1);
 }
 
 /**
@@ -231,7 +372,7 @@ bool qqueue_pushstr(qqueue_t *queue, const char *str) {
  *  - ENOMEM    : Memory allocation failure.
  */
 bool qqueue_pushint(qqueue_t *queue, int64_t num) {
-    return queue->list->addlast(queue->list, &num, sizeof(num));
+    return qqueue_push(queue, &num, sizeof(num));
 }
 
 /**
@@ -247,7 +388,14 @@ bool qqueue_pushint(qqueue_t *queue, int64_t num) {
  *  - ENOMEM    : Memory allocation failure.
  */
 void *qqueue_pop(qqueue_t *queue, size_t *size) {
-    return queue->list->popfirst(queue->list, size);
+    if (queue->ring != NULL) {
+        return ring_popmem(queue->ring, size);
+    }
+    void *data = queue->list->popfirst(queue->list, size);
+    if (data == NULL && errno == ERANGE) {
+        errno = ENOENT;  // the list reports an empty one as out of range
+    }
+    return data;
 }
 
 /**
@@ -266,7 +414,7 @@ void *qqueue_pop(qqueue_t *queue, size_t *size) {
  */
 char *qqueue_popstr(qqueue_t *queue) {
     size_t strsize;
-    char *str = queue->list->popfirst(queue->list, &strsize);
+    char *str = qqueue_pop(queue, &strsize);
     if (str != NULL) {
         str[strsize - 1] = '\0';  // just to make sure
     }
@@ -290,11 +438,17 @@ char *qqueue_popstr(qqueue_t *queue) {
  */
 int64_t qqueue_popint(qqueue_t *queue) {
     int64_t num = 0;
-    int64_t *pnum = queue->list->popfirst(queue->list, NULL);
+    if (queue->ring != NULL) {
+        ring_pop(queue->ring, &num, sizeof(num), NULL);
+        return num;
+    }
+    queue->list->lock(queue->list);
+    int64_t *pnum = queue->list->getfirst(queue->list, NULL, false);
     if (pnum != NULL) {
         num = *pnum;
-        free(pnum);
+        queue->list->removefirst(queue->list);
     }
+    queue->list->unlock(queue->list);
 
     return num;
 }
@@ -318,9 +472,130 @@ int64_t qqueue_popint(qqueue_t *queue) {
  *  very last time.
  */
 void *qqueue_popat(qqueue_t *queue, int index, size_t *size) {
+    if (queue->ring != NULL) {
+        errno = ENOTSUP;
+        return NULL;
+    }
     return queue->list->popat(queue->list, index, size);
 }
 
+/**
+ * qqueue->pop_wait(): Removes a element at the top of this queue, waiting
+ * for one to be pushed if the queue is empty.
+ *
+ * @param queue     qqueue container pointer.
+ * @param size      if size is not NULL, element size will be stored.
+ * @param timeoutms maximum time to wait in milliseconds. 0 doesn't wait and
+ *                  a negative value waits forever.
+ *
+ * @return a pointer of malloced element, otherwise returns NULL.
+ * @retval errno will be set in error condition.
+ *  - ETIMEDOUT : No element was pushed in time.
+ *  - ENOENT    : Queue is empty and timeoutms is 0.
+ *  - ENOMEM    : Memory allocation failure.
+ *
+ * @code
+ *  // worker thread
+ *  while (running) {
+ *      struct job *job = queue->pop_wait(queue, NULL, 1000);
+ *      if (job == NULL) continue;
+ *      (...process...)
+ *      free(job);
+ *  }
+ * @endcode
+ *
+ * @note
+ *  Consumers sleep on a condition variable and a push wakes one of them
+ *  right away. Pushes don't touch the condition variable unless there is
+ *  a sleeping consumer. The queue should be created with QQUEUE_THREADSAFE
+ *  option or by qqueue_ring().
+ */
+void *qqueue_pop_wait(qqueue_t *queue, size_t *size, int timeoutms) {
+    void *data = qqueue_pop(queue, size);
+    if (data != NULL || errno != ENOENT || timeoutms == 0) {
+        return data;
+    }
+
+    struct timespec deadline;
+    if (timeoutms > 0) {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += timeoutms / 1000;
+        deadline.tv_nsec += (timeoutms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+
+    qqueue_wait_t *w = (qqueue_wait_t *) queue->qwait;
+    pthread_mutex_lock(&w->mutex);
+    // announce before checking again, so a push either sees us or we see it
+    __atomic_add_fetch(&w->waiters, 1, __ATOMIC_SEQ_CST);
+    while (true) {
+        data = qqueue_pop(queue, size);
+        if (data != NULL || errno != ENOENT) {
+            break;
+        }
+        int ret = (timeoutms > 0) ?
+                pthread_cond_timedwait(&w->cond, &w->mutex, &deadline) :
+                pthread_cond_wait(&w->cond, &w->mutex);
+        if (ret == ETIMEDOUT) {
+            data = qqueue_pop(queue, size);
+            if (data == NULL && errno == ENOENT) {
+                errno = ETIMEDOUT;
+            }
+            break;
+        }
+    }
+    __atomic_sub_fetch(&w->waiters, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&w->mutex);
+
+    return data;
+}
+
+/**
+ * qqueue->popbatch(): Removes up to the given number of elements at the top
+ * of this queue at once.
+ *
+ * @param queue qqueue container pointer.
+ * @param datas array to store the pointers of the malloced elements.
+ * @param sizes if not NULL, array to store the element sizes.
+ * @param max   maximum number of elements to remove.
+ *
+ * @return the number of elements removed.
+ *
+ * @code
+ *  void *jobs[64];
+ *  size_t n = queue->popbatch(queue, jobs, NULL, 64);
+ *  for (i = 0; i < n; i++) {
+ *      (...process...)
+ *      free(jobs[i]);
+ *  }
+ * @endcode
+ *
+ * @note
+ *  The elements are taken under a single lock acquisition, so a consumer
+ *  pays the synchronization once per batch instead of once per element.
+ */
+size_t qqueue_popbatch(qqueue_t *queue, void *datas[], size_t sizes[],
+                       size_t max) {
+    size_t num;
+    if (queue->list != NULL) {
+        queue->list->lock(queue->list);
+    }
+    for (num = 0; num < max; num++) {
+        datas[num] = qqueue_pop(queue, (sizes != NULL) ? &sizes[num] : NULL);
+        if (datas[num] == NULL) {
+            break;
+        }
+    }
+    if (queue->list != NULL) {
+        queue->list->unlock(queue->list);
+    }
+
+    return num;
+}
+
 /**
  * qqueue->get(): Returns an element at the top of this queue without
  * removing it.
@@ -335,6 +610,10 @@ void *qqueue_popat(qqueue_t *queue, int index, size_t *size) {
  *  - ENOMEM    : Memory allocation failure.
  */
 void *qqueue_get(qqueue_t *queue, size_t *size, bool newmem) {
+    if (queue->ring != NULL) {
+        errno = ENOTSUP;
+        return NULL;
+    }
     return queue->list->getfirst(queue->list, size, newmem);
 }
 
@@ -353,6 +632,10 @@ void *qqueue_get(qqueue_t *queue, size_t *size, bool newmem) {
  * The string element should be pushed through pushstr().
  */
 char *qqueue_getstr(qqueue_t *queue) {
+    if (queue->ring != NULL) {
+        errno = ENOTSUP;
+        return NULL;
+    }
     size_t strsize;
     char *str = queue->list->getfirst(queue->list, &strsize, true);
     if (str != NULL) {
@@ -378,11 +661,16 @@ char *qqueue_getstr(qqueue_t *queue) {
  */
 int64_t qqueue_getint(qqueue_t *queue) {
     int64_t num = 0;
-    int64_t *pnum = queue->list->getfirst(queue->list, NULL, true);
+    if (queue->ring != NULL) {
+        errno = ENOTSUP;
+        return 0;
+    }
+    queue->list->lock(queue->list);
+    int64_t *pnum = queue->list->getfirst(queue->list, NULL, false);
     if (pnum != NULL) {
         num = *pnum;
-        free(pnum);
     }
+    queue->list->unlock(queue->list);
 
     return num;
 }
@@ -407,6 +695,10 @@ int64_t qqueue_getint(qqueue_t *queue) {
  *  very last time.
  */
 void *qqueue_getat(qqueue_t *queue, int index, size_t *size, bool newmem) {
+    if (queue->ring != NULL) {
+        errno = ENOTSUP;
+        return NULL;
+    }
     return queue->list->getat(queue->list, index, size, newmem);
 }
 
@@ -418,6 +710,9 @@ void *qqueue_getat(qqueue_t *queue, int index, size_t *size, bool newmem) {
  * @return the number of elements in this queue.
  */
 size_t qqueue_size(qqueue_t *queue) {
+    if (queue->ring != NULL) {
+        return ring_size(queue->ring);
+    }
     return queue->list->size(queue->list);
 }
 
@@ -427,6 +722,10 @@ size_t qqueue_size(qqueue_t *queue) {
  * @param queue qqueue container pointer.
  */
 void qqueue_clear(qqueue_t *queue) {
+    if (queue->ring != NULL) {
+        while (ring_pop(queue->ring, NULL, 0, NULL));
+        return;
+    }
     queue->list->clear(queue->list);
 }
 
@@ -439,6 +738,16 @@ void qqueue_clear(qqueue_t *queue) {
  * @return true if successful, otherwise returns false.
  */
 bool qqueue_debug(qqueue_t *queue, FILE *out) {
+    if (queue->ring != NULL) {
+        if (out == NULL) {
+            errno = EIO;
+            return false;
+        }
+        qqueue_ring_t *ring = (qqueue_ring_t *) queue->ring;
+        fprintf(out, "ring: %zu/%zu elements, %zu bytes per slot\n",
+                ring_size(ring), ring->mask + 1, ring->objsize);
+        return true;
+    }
     return queue->list->debug(queue->list, out);
 }
 
@@ -450,6 +759,183 @@ bool qqueue_debug(qqueue_t *queue, FILE *out) {
  * @return always returns true.
  */
 void qqueue_free(qqueue_t *queue) {
-    queue->list->free(queue->list);
+    if (queue->ring != NULL) {
+        free(((qqueue_ring_t *) queue->ring)->slots);
+        free(queue->ring);
+    }
+    if (queue->list != NULL) {
+        queue->list->free(queue->list);
+    }
+    wait_free(queue->qwait);
     free(queue);
 }
+
+#ifndef _DOXYGEN_SKIP
+
+static qqueue_ring_t *ring_new(size_t max, size_t objsize) {
+    size_t num = 1;
+    while (num < max) {
+        num <<= 1;
+    }
+
+    qqueue_ring_t *ring;
+    if (posix_memalign((void **) &ring, 64, sizeof(qqueue_ring_t)) != 0) {
+        return NULL;
+    }
+    memset((void *) ring, 0, sizeof(qqueue_ring_t));
+    ring->mask = num - 1;
+    ring->objsize = objsize;
+    ring->slotsize = (sizeof(ring_slot_t) + objsize + 15) & ~((size_t) 15);
+    ring->slots = (char *) malloc(num * ring->slotsize);
+    if (ring->slots == NULL) {
+        free(ring);
+        return NULL;
+    }
+
+    size_t i;
+    for (i = 0; i < num; i++) {
+        ring_slot_t *slot = (ring_slot_t *) (ring->slots + i * ring->slotsize);
+        slot->seq = i;
+        slot->size = 0;
+    }
+
+    return ring;
+}
+
+/*
+ * Each slot carries a sequence number which tells whose turn it is. A slot
+ * at position pos is free for the producer when seq == pos and holds an
+ * element for the consumer when seq == pos + 1. Producers and consumers
+ * claim positions with a CAS on their own counter, then hand the slot over
+ * by publishing the next sequence number with release semantics.
+ */
+static bool ring_push(qqueue_ring_t *ring, const void *data, size_t size) {
+    if (data == NULL || size == 0 || size > ring->objsize) {
+        errno = EINVAL;
+        return false;
+    }
+
+    ring_slot_t *slot;
+    size_t pos = __atomic_load_n(&ring->enqpos, __ATOMIC_RELAXED);
+    for (;;) {
+        slot = (ring_slot_t *) (ring->slots + (pos & ring->mask) * ring->slotsize);
+        size_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        intptr_t diff = (intptr_t) seq - (intptr_t) pos;
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&ring->enqpos, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            errno = ENOBUFS;  // full
+            return false;
+        } else {
+            pos = __atomic_load_n(&ring->enqpos, __ATOMIC_RELAXED);
+        }
+    }
+
+    memcpy((void *) (slot + 1), data, size);
+    slot->size = size;
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+static bool ring_pop(qqueue_ring_t *ring, void *buf, size_t bufsize,
+                     size_t *size) {
+    ring_slot_t *slot;
+    size_t pos = __atomic_load_n(&ring->deqpos, __ATOMIC_RELAXED);
+    for (;;) {
+        slot = (ring_slot_t *) (ring->slots + (pos & ring->mask) * ring->slotsize);
+        size_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        intptr_t diff = (intptr_t) seq - (intptr_t) (pos + 1);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&ring->deqpos, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            errno = ENOENT;  // empty
+            return false;
+        } else {
+            pos = __atomic_load_n(&ring->deqpos, __ATOMIC_RELAXED);
+        }
+    }
+
+    if (buf != NULL) {
+        memcpy(buf, (void *) (slot + 1), (slot->size < bufsize) ? slot->size : bufsize);
+    }
+    if (size != NULL) {
+        *size = slot->size;
+    }
+    __atomic_store_n(&slot->seq, pos + ring->mask + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+static void *ring_popmem(qqueue_ring_t *ring, size_t *size) {
+    // allocate before claiming a slot so a slow malloc() doesn't hold it
+    void *data = malloc(ring->objsize);
+    if (data == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    if (ring_pop(ring, data, ring->objsize, size) == false) {
+        free(data);
+        return NULL;
+    }
+    return data;
+}
+
+static size_t ring_size(qqueue_ring_t *ring) {
+    size_t deq = __atomic_load_n(&ring->deqpos, __ATOMIC_ACQUIRE);
+    size_t enq = __atomic_load_n(&ring->enqpos, __ATOMIC_ACQUIRE);
+    return (enq > deq) ? enq - deq : 0;
+}
+
+static qqueue_wait_t *wait_new(void) {
+    qqueue_wait_t *w = (qqueue_wait_t *) calloc(1, sizeof(qqueue_wait_t));
+    if (w == NULL) {
+        return NULL;
+    }
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    int ret = pthread_cond_init(&w->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    if (ret != 0) {
+        free(w);
+        return NULL;
+    }
+    if (pthread_mutex_init(&w->mutex, NULL) != 0) {
+        pthread_cond_destroy(&w->cond);
+        free(w);
+        return NULL;
+    }
+
+    return w;
+}
+
+static void wait_free(qqueue_wait_t *w) {
+    if (w == NULL) {
+        return;
+    }
+    pthread_cond_destroy(&w->cond);
+    pthread_mutex_destroy(&w->mutex);
+    free(w);
+}
+
+static void wake_waiters(qqueue_t *queue) {
+    qqueue_wait_t *w = (qqueue_wait_t *) queue->qwait;
+    // pairs with the increment in pop_wait(), one of the two sees the other
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&w->waiters, __ATOMIC_SEQ_CST) == 0) {
+        return;
+    }
+    pthread_mutex_lock(&w->mutex);
+    pthread_cond_signal(&w->cond);
+    pthread_mutex_unlock(&w->mutex);
+}
+
+#endif /* _DOXYGEN_SKIP */
@@ -0,0 +1,503 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/**
+ * @file qshmring.c Message ring buffer working in preallocated shared memory.
+ *
+ * qshmring streams variable length messages from producer processes to a
+ * consumer process through a ring buffer in shared memory, such as the
+ * memory from qshm_get() or qshm_map(). Pushing and popping never take a
+ * lock. A single producer just moves its own position forward, and with
+ * QSHMRING_MULTIPRODUCER the producers reserve their records with an
+ * atomic compare-and-swap and fill them in concurrently. There is one
+ * consumer at a time.
+ *
+ * The waiting calls sleep on futexes in the shared memory, and the other
+ * side only makes the wake-up system call when somebody is sleeping. So a
+ * busy ring moves messages with plain memory accesses.
+ *
+ * @code
+ *  [creator]
+ *  size_t memsize = qshmring_calculate_memsize(4 * 1024 * 1024);
+ *  int shmid = qshm_init("/some/file", 'r', memsize, true);
+ *  void *memory = qshm_get(shmid);
+ *  qshmring_t *ring = qshmring(memory, memsize, QSHMRING_MULTIPRODUCER);
+ *
+ *  [producers]
+ *  qshmring_t *ring = qshmring(qshm_get(qshm_getid("/some/file", 'r')), 0, 0);
+ *  ring->push_wait(ring, msg, msgsize, -1);
+ *
+ *  [consumer]
+ *  char buf[4096];
+ *  ssize_t n;
+ *  while ((n = ring->pop_wait(ring, buf, sizeof(buf), 1000)) >= 0) {
+ *    (...process buf[0] ~ buf[n - 1]...)
+ *  }
+ *  ring->free(ring);  // the memory is not released
+ * @endcode
+ *
+ * @note
+ *  A producer killed between reserving and filling in a record stalls the
+ *  consumer at that record for good, like a writer dying in the middle of
+ *  other shared memory updates.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+#include "qinternal.h"
+#include "containers/qshmring.h"
+
+#define RING_MAGIC      (0x474e5251)    /*!< "QRNG" */
+#define MIN_CAPACITY    (64)            /*!< smallest record area */
+#define REC_HEADSIZE    (8)             /*!< record header size */
+#define REC_SIZE(n)     (((uint64_t) (n) + REC_HEADSIZE + 7) & ~((uint64_t) 7))
+
+#ifndef _DOXYGEN_SKIP
+
+/* ring header, the record area follows it */
+typedef struct {
+    uint32_t magic;         /*!< set once the header is ready */
+    uint32_t options;       /*!< ring options */
+    uint64_t capacity;      /*!< size of the record area, a power of 2 */
+    uint64_t head __attribute__((aligned(64)));  /*!< end of the reserved records */
+    uint64_t tail __attribute__((aligned(64)));  /*!< end of the consumed records */
+    uint32_t datawake __attribute__((aligned(64)));  /*!< futex of the consumer */
+    uint32_t datawaiters;   /*!< 1 while the consumer sleeps */
+    uint32_t spacewake;     /*!< futex of the producers */
+    uint32_t spacewaiters;  /*!< number of the producers sleeping */
+} __attribute__((aligned(64))) qshmring_data_t;
+
+/* record header. The record area is all zero except the reserved records,
+ * so the state of a record reads 0 until its producer fills it in. */
+enum {
+    REC_EMPTY = 0,  /*!< being written */
+    REC_DATA = 1,   /*!< a message */
+    REC_PAD = 2     /*!< skip to the start of the area */
+};
+typedef struct {
+    uint32_t size;  /*!< message size */
+    uint32_t state; /*!< record state */
+} qshmring_rec_t;
+
+static void wait_on(uint32_t *addr, uint32_t val, int timeoutms);
+static void wake_up(uint32_t *addr, int num);
+static int remaining_ms(const struct timespec *start, int timeoutms);
+
+#endif
+
+/**
+ * Get how much memory is needed for a ring.
+ *
+ * @param capacity  bytes of the records. It is rounded up to a power of 2.
+ *
+ * @return memory size needed
+ *
+ * @note
+ *  Each message takes 8 bytes of header plus its size rounded up to 8
+ *  bytes, and a message can be up to half of the capacity.
+ */
+size_t qshmring_calculate_memsize(size_t capacity) {
+    size_t size;
+    for (size = MIN_CAPACITY; size < capacity; size <<= 1);
+    return sizeof(qshmring_data_t) + size;
+}
+
+/**
+ * Initialize a ring buffer in the given memory or attach to the existing one.
+ *
+ * @param memory    a pointer of the memory, shared by the processes.
+ * @param memsize   a size of the memory, 0 for using the existing ring.
+ * @param options   combination of the options. Ignored if memsize is 0.
+ *
+ * @return qshmring_t container pointer, otherwise returns NULL.
+ * @retval errno  will be set in error condition.
+ *  - EINVAL : Invalid argument, the memory is too small or not a ring.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @note
+ *   Available options:
+ *   - QSHMRING_MULTIPRODUCER - allow many producers to push at the same
+ *     time. Without it, only one producer may push at a time.
+ *
+ *  The record area takes the largest power of 2 that fits in the memory.
+ */
+qshmring_t *qshmring(void *memory, size_t memsize, int options) {
+    qshmring_data_t *data = (qshmring_data_t *) memory;
+    if (memory == NULL) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    if (memsize > 0) {
+        if (memsize < sizeof(qshmring_data_t) + MIN_CAPACITY) {
+            errno = EINVAL;
+            return NULL;
+        }
+        uint64_t capacity;
+        for (capacity = MIN_CAPACITY;
+             capacity * 2 <= memsize - sizeof(qshmring_data_t); capacity <<= 1);
+
+        memset(memory, 0, sizeof(qshmring_data_t) + capacity);
+        data->options = options;
+        data->capacity = capacity;
+        __atomic_store_n(&data->magic, RING_MAGIC, __ATOMIC_RELEASE);
+    } else if (__atomic_load_n(&data->magic, __ATOMIC_ACQUIRE) != RING_MAGIC) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    qshmring_t *ring = (qshmring_t *) calloc(1, sizeof(qshmring_t));
+    if (ring == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    // assign methods
+    ring->push = qshmring_push;
+    ring->push_wait = qshmring_push_wait;
+    ring->pop = qshmring_pop;
+    ring->pop_wait = qshmring_pop_wait;
+
+    ring->used = qshmring_used;
+    ring->capacity = qshmring_capacity;
+    ring->free = qshmring_free;
+
+    ring->shared = data;
+    ring->buf = (uint8_t *) memory + sizeof(qshmring_data_t);
+    ring->mask = data->capacity - 1;
+
+    return ring;
+}
+
+/**
+ * qshmring->push(): Push a message without waiting.
+ *
+ * @param ring      qshmring_t container pointer.
+ * @param data      message
+ * @param size      message size
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EAGAIN : The ring is full.
+ *  - EMSGSIZE : The message is larger than half of the capacity.
+ */
+bool qshmring_push(qshmring_t *ring, const void *data, size_t size) {
+    qshmring_data_t *shared = (qshmring_data_t *) ring->shared;
+    uint64_t capacity = ring->mask + 1;
+    uint64_t need = REC_SIZE(size);
+    if (need > capacity / 2) {
+        errno = EMSGSIZE;
+        return false;
+    }
+
+    // a record which doesn't fit at the end starts over after a padding.
+    uint64_t head = __atomic_load_n(&shared->head, __ATOMIC_RELAXED);
+    uint64_t total;
+    while (true) {
+        uint64_t tail = __atomic_load_n(&shared->tail, __ATOMIC_ACQUIRE);
+        uint64_t room = capacity - (head & ring->mask);
+        total = (room < need) ? room + need : need;
+        if (head + total - tail > capacity) {
+            errno = EAGAIN;
+            return false;
+        }
+        if (!(shared->options & QSHMRING_MULTIPRODUCER)) {
+            __atomic_store_n(&shared->head, head + total, __ATOMIC_RELAXED);
+            break;
+        }
+        if (__atomic_compare_exchange_n(&shared->head, &head, head + total,
+                                        true, __ATOMIC_ACQ_REL,
+                                        __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+
+    // fill in the reserved records, the state goes last.
+    uint64_t offset = head & ring->mask;
+    if (total != need) {
+        qshmring_rec_t *pad = (qshmring_rec_t *) (ring->buf + offset);
+        pad->size = capacity - offset - REC_HEADSIZE;
+        __atomic_store_n(&pad->state, REC_PAD, __ATOMIC_RELEASE);
+        offset = 0;
+    }
+    qshmring_rec_t *rec = (qshmring_rec_t *) (ring->buf + offset);
+    rec->size = size;
+    if (size > 0) {
+        memcpy((uint8_t *) rec + REC_HEADSIZE, data, size);
+    }
+    __atomic_store_n(&rec->state, REC_DATA, __ATOMIC_RELEASE);
+
+    // wake up the consumer only if it sleeps.
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&shared->datawaiters, __ATOMIC_RELAXED) > 0) {
+        __atomic_add_fetch(&shared->datawake, 1, __ATOMIC_RELEASE);
+        wake_up(&shared->datawake, 1);
+    }
+
+    return true;
+}
+
+/**
+ * qshmring->push_wait(): Push a message, waiting for the room.
+ *
+ * @param ring      qshmring_t container pointer.
+ * @param data      message
+ * @param size      message size
+ * @param timeoutms maximum milli-seconds to wait, -1 to wait forever.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - ETIMEDOUT : No room made within the time.
+ *  - EMSGSIZE : The message is larger than half of the capacity.
+ */
+bool qshmring_push_wait(qshmring_t *ring, const void *data, size_t size,
+                        int timeoutms) {
+    qshmring_data_t *shared = (qshmring_data_t *) ring->shared;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (true) {
+        if (qshmring_push(ring, data, size) == true) {
+            return true;
+        } else if (errno != EAGAIN) {
+            return false;
+        }
+
+        // recheck after announcing the wait, then sleep.
+        uint32_t wake = __atomic_load_n(&shared->spacewake, __ATOMIC_ACQUIRE);
+        __atomic_add_fetch(&shared->spacewaiters, 1, __ATOMIC_SEQ_CST);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        bool ret = qshmring_push(ring, data, size);
+        int errnobak = errno;
+        int remain = remaining_ms(&start, timeoutms);
+        if (ret == false && errnobak == EAGAIN && remain != 0) {
+            wait_on(&shared->spacewake, wake, remain);
+        }
+        __atomic_sub_fetch(&shared->spacewaiters, 1, __ATOMIC_SEQ_CST);
+        if (ret == true) {
+            return true;
+        } else if (errnobak != EAGAIN) {
+            errno = errnobak;
+            return false;
+        } else if (remain == 0) {
+            errno = ETIMEDOUT;
+            return false;
+        }
+    }
+}
+
+/**
+ * qshmring->pop(): Pop a message without waiting.
+ *
+ * @param ring      qshmring_t container pointer.
+ * @param buf       buffer to copy the message into
+ * @param bufsize   size of the buffer
+ *
+ * @return the message size if successful, otherwise returns -1.
+ * @retval errno will be set in error condition.
+ *  - EAGAIN : The ring is empty.
+ *  - EMSGSIZE : The buffer is smaller than the message, which is kept.
+ */
+ssize_t qshmring_pop(qshmring_t *ring, void *buf, size_t bufsize) {
+    qshmring_data_t *shared = (qshmring_data_t *) ring->shared;
+    uint64_t tail = __atomic_load_n(&shared->tail, __ATOMIC_RELAXED);
+    while (true) {
+        uint64_t head = __atomic_load_n(&shared->head, __ATOMIC_ACQUIRE);
+        if (tail == head) {
+            errno = EAGAIN;
+            return -1;
+        }
+
+        uint64_t offset = tail & ring->mask;
+        qshmring_rec_t *rec = (qshmring_rec_t *) (ring->buf + offset);
+        uint32_t state = __atomic_load_n(&rec->state, __ATOMIC_ACQUIRE);
+        if (state == REC_EMPTY) {
+            // reserved but not filled in yet
+            errno = EAGAIN;
+            return -1;
+        }
+
+        // consumed records are zeroed for the next round.
+        if (state == REC_PAD) {
+            memset((void *) rec, 0, REC_HEADSIZE);
+            tail += ring->mask + 1 - offset;
+            __atomic_store_n(&shared->tail, tail, __ATOMIC_RELEASE);
+            continue;
+        }
+        size_t size = rec->size;
+        if (size > bufsize) {
+            errno = EMSGSIZE;
+            return -1;
+        }
+        if (size > 0) {
+            memcpy(buf, (uint8_t *) rec + REC_HEADSIZE, size);
+        }
+        memset((void *) rec, 0, REC_SIZE(size));
+        __atomic_store_n(&shared->tail, tail + REC_SIZE(size), __ATOMIC_RELEASE);
+
+        // wake up the producers only if any sleeps.
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&shared->spacewaiters, __ATOMIC_RELAXED) > 0) {
+            __atomic_add_fetch(&shared->spacewake, 1, __ATOMIC_RELEASE);
+            wake_up(&shared->spacewake, INT_MAX);
+        }
+
+        return size;
+    }
+}
+
+/**
+ * qshmring->pop_wait(): Pop a message, waiting for one.
+ *
+ * @param ring      qshmring_t container pointer.
+ * @param buf       buffer to copy the message into
+ * @param bufsize   size of the buffer
+ * @param timeoutms maximum milli-seconds to wait, -1 to wait forever.
+ *
+ * @return the message size if successful, otherwise returns -1.
+ * @retval errno will be set in error condition.
+ *  - ETIMEDOUT : No message within the time.
+ *  - EMSGSIZE : The buffer is smaller than the message, which is kept.
+ */
+ssize_t qshmring_pop_wait(qshmring_t *ring, void *buf, size_t bufsize,
+                          int timeoutms) {
+    qshmring_data_t *shared = (qshmring_data_t *) ring->shared;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (true) {
+        ssize_t size = qshmring_pop(ring, buf, bufsize);
+        if (size >= 0 || errno != EAGAIN) {
+            return size;
+        }
+
+        // recheck after announcing the wait, then sleep.
+        uint32_t wake = __atomic_load_n(&shared->datawake, __ATOMIC_ACQUIRE);
+        __atomic_add_fetch(&shared->datawaiters, 1, __ATOMIC_SEQ_CST);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        size = qshmring_pop(ring, buf, bufsize);
+        int errnobak = errno;
+        int remain = remaining_ms(&start, timeoutms);
+        if (size < 0 && errnobak == EAGAIN && remain != 0) {
+            wait_on(&shared->datawake, wake, remain);
+        }
+        __atomic_sub_fetch(&shared->datawaiters, 1, __ATOMIC_SEQ_CST);
+        if (size >= 0) {
+            return size;
+        } else if (errnobak != EAGAIN) {
+            errno = errnobak;
+            return -1;
+        } else if (remain == 0) {
+            errno = ETIMEDOUT;
+            return -1;
+        }
+    }
+}
+
+/**
+ * qshmring->used(): Get the bytes taken by the messages in the ring.
+ *
+ * @param ring      qshmring_t container pointer.
+ *
+ * @return number of bytes of the records not consumed yet, including
+ *  their headers and paddings.
+ */
+size_t qshmring_used(qshmring_t *ring) {
+    qshmring_data_t *shared = (qshmring_data_t *) ring->shared;
+    uint64_t tail = __atomic_load_n(&shared->tail, __ATOMIC_ACQUIRE);
+    uint64_t head = __atomic_load_n(&shared->head, __ATOMIC_ACQUIRE);
+    return (size_t) (head - tail);
+}
+
+/**
+ * qshmring->capacity(): Get the size of the record area.
+ *
+ * @param ring      qshmring_t container pointer.
+ *
+ * @return number of bytes of the record area.
+ */
+size_t qshmring_capacity(qshmring_t *ring) {
+    return (size_t) (ring->mask + 1);
+}
+
+/**
+ * qshmring->free(): De-allocate the ring object. The shared memory itself
+ * and the messages in it are left as they are.
+ *
+ * @param ring      qshmring_t container pointer.
+ */
+void qshmring_free(qshmring_t *ring) {
+    free(ring);
+}
+
+#ifndef _DOXYGEN_SKIP
+
+static void wait_on(uint32_t *addr, uint32_t val, int timeoutms) {
+#ifdef __linux__
+    struct timespec ts, *tsp = NULL;
+    if (timeoutms >= 0) {
+        ts.tv_sec = timeoutms / 1000;
+        ts.tv_nsec = (long) (timeoutms % 1000) * 1000000L;
+        tsp = &ts;
+    }
+    syscall(SYS_futex, addr, FUTEX_WAIT, val, tsp, NULL, 0);
+#else
+    if (__atomic_load_n(addr, __ATOMIC_ACQUIRE) == val) {
+        usleep(1000);
+    }
+#endif
+}
+
+static void wake_up(uint32_t *addr, int num) {
+#ifdef __linux__
+    syscall(SYS_futex, addr, FUTEX_WAKE, num, NULL, NULL, 0);
+#endif
+}
+
+/* milli-seconds left, -1 for no time limit */
+static int remaining_ms(const struct timespec *start, int timeoutms) {
+    if (timeoutms < 0) {
+        return -1;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long elapsed = (now.tv_sec - start->tv_sec) * 1000L
+                   + (now.tv_nsec - start->tv_nsec) / 1000000L;
+    return (elapsed >= timeoutms) ? 0 : (int) (timeoutms - elapsed);
+}
+
+#endif /* _DOXYGEN_SKIP */
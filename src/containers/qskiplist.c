@@ -0,0 +1,906 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/**
+ * @file qskiplist.c Concurrent skip list container implementation.
+ *
+ * qskiplist is an ordered map like qtreetbl, which many threads can update
+ * at the same time. A balanced tree rebalances over many nodes on every
+ * update, so qtreetbl serializes all the calls on one lock. A skip list
+ * keeps its order with randomly leveled forward links instead, and an
+ * update only changes the links right before the node it adds or removes.
+ *
+ * This is the lazy skip list of Herlihy, Lev, Luchangco and Shavit.
+ *  - Lookups and traversals take no lock at all.
+ *  - Writers lock only the predecessors of the node they change, and
+ *    validate them before linking, so writers to different parts of the
+ *    list don't wait for each other.
+ *  - A removed node is first marked, then unlinked. Readers going through
+ *    it keep walking, and never see a half linked node.
+ *  - Putting an existing key swaps in the new data atomically.
+ *
+ * A removed node or replaced data isn't freed right away, readers may be
+ * looking at it. It's retired and freed once every reader that could have
+ * seen it has left its read section (epoch based reclamation), the same
+ * scheme QHASHTBL_LOCKFREE_READ uses. Every call enters a read section on
+ * its own. When pointers are returned with newmem=false, or when traversing
+ * with getnext(), enclose the calls with read_enter() and read_leave() to
+ * keep the objects from being freed meanwhile.
+ *
+ * @code
+ *  qskiplist_t *list = qskiplist();
+ *
+ *  // from any thread
+ *  list->putstr(list, "e1", "a");
+ *  char *str = list->getstr(list, "e1", true);
+ *  free(str);
+ *  list->remove(list, "e1");
+ *
+ *  // ordered traversal
+ *  qskiplist_obj_t obj;
+ *  memset((void *) &obj, 0, sizeof(obj));
+ *  list->read_enter(list);
+ *  while (list->getnext(list, &obj, false) == true) {
+ *    printf("NAME=%s, DATA=%s\n", (char *) obj.name, (char *) obj.data);
+ *  }
+ *  list->read_leave(list);
+ *
+ *  list->free(list);
+ * @endcode
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sched.h>
+#include "qinternal.h"
+#include "utilities/qstring.h"
+#include "containers/qtreetbl.h"
+#include "containers/qskiplist.h"
+
+#ifndef _DOXYGEN_SKIP
+
+#define MAX_LEVEL           (16)    /* 4^16 objects on average */
+#define LOCK_SPINS          (100)   /* spins before yielding the CPU */
+#define RECLAIM_THRESHOLD   (64)    /* retired objects to try freeing */
+
+#define LOAD(p)             __atomic_load_n(&(p), __ATOMIC_ACQUIRE)
+#define STORE(p, v)         __atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
+
+/* data of a node, swapped as a whole when the key is put again */
+typedef struct qskiplist_val_s qskiplist_val_t;
+struct qskiplist_val_s {
+    size_t datasize;
+    uint8_t data[];
+};
+
+typedef struct qskiplist_node_s qskiplist_node_t;
+struct qskiplist_node_s {
+    void *name;             /* points into the node allocation */
+    size_t namesize;
+    qskiplist_val_t *val;
+    int level;              /* number of forward links */
+    uint8_t lock;           /* spin lock of the writers */
+    bool marked;            /* removed logically */
+    bool linked;            /* linked at every level */
+    qskiplist_node_t *next[];
+};
+
+static qskiplist_node_t *new_node(const void *name, size_t namesize,
+                                  int level);
+static void free_node(qskiplist_node_t *node);
+static qskiplist_val_t *new_val(const void *data, size_t datasize);
+static void *dup_data(qskiplist_val_t *val);
+static int random_level(void);
+static int find_node(qskiplist_t *list, const void *name, size_t namesize,
+                     qskiplist_node_t **preds, qskiplist_node_t **succs);
+static void lock_node(qskiplist_node_t *node);
+static void unlock_node(qskiplist_node_t *node);
+static void unlock_preds(qskiplist_node_t **preds, int highest);
+static bool fill_obj(qskiplist_obj_t *obj, qskiplist_node_t *node,
+                     bool newmem);
+static void retire(qskiplist_t *list, void *ptr, bool node);
+static void free_retired_node(void *list, void *node);
+static void free_retired_val(void *list, void *val);
+
+#endif
+
+/**
+ * Create a skip list.
+ *
+ * @return a pointer of malloced qskiplist_t, otherwise returns NULL.
+ * @retval errno will be set in error condition.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @code
+ *  qskiplist_t *list = qskiplist();
+ * @endcode
+ *
+ * @note
+ *  The list is always thread-safe. Keys are compared with
+ *  qtreetbl_byte_cmp() unless another one is set by set_compare().
+ */
+qskiplist_t *qskiplist(void) {
+    qskiplist_t *list = (qskiplist_t *) calloc(1, sizeof(qskiplist_t));
+    if (list == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    list->head = new_node(NULL, 0, MAX_LEVEL);
+    if (list->head == NULL || (list->epoch = _q_epoch_new(list)) == NULL) {
+        free(list->head);
+        free(list);
+        errno = ENOMEM;
+        return NULL;
+    }
+    ((qskiplist_node_t *) list->head)->linked = true;
+
+    // member methods
+    list->set_compare = qskiplist_set_compare;
+
+    list->put = qskiplist_put;
+    list->putstr = qskiplist_putstr;
+    list->putobj = qskiplist_putobj;
+
+    list->get = qskiplist_get;
+    list->getstr = qskiplist_getstr;
+    list->getobj = qskiplist_getobj;
+
+    list->remove = qskiplist_remove;
+    list->removeobj = qskiplist_removeobj;
+
+    list->getnext = qskiplist_getnext;
+    list->find_nearest = qskiplist_find_nearest;
+
+    list->size = qskiplist_size;
+    list->read_enter = qskiplist_read_enter;
+    list->read_leave = qskiplist_read_leave;
+    list->clear = qskiplist_clear;
+    list->free = qskiplist_free;
+
+    list->compare = qtreetbl_byte_cmp;
+
+    return list;
+}
+
+/**
+ * qskiplist->set_compare(): Set the user comparator.
+ *
+ * @param list  qskiplist_t container pointer.
+ * @param cmp   a pointer to the user comparator function.
+ *
+ * @note
+ *  Set it before putting any object, and not while other threads use the
+ *  list.
+ */
+void qskiplist_set_compare(qskiplist_t *list,
+                           int (*cmp)(const void *name1, size_t namesize1,
+                                      const void *name2, size_t namesize2)) {
+    list->compare = cmp;
+}
+
+/**
+ * qskiplist->put(): Put an object into this list with a string key.
+ *
+ * @param list      qskiplist_t container pointer.
+ * @param name      key name.
+ * @param data      data object.
+ * @param datasize  size of data object.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - ENOMEM : Memory allocation failure.
+ */
+bool qskiplist_put(qskiplist_t *list, const char *name, const void *data,
+                   size_t datasize) {
+    return qskiplist_putobj(list, name,
+                            (name != NULL) ? (strlen(name) + 1) : 0, data,
+                            datasize);
+}
+
+/**
+ * qskiplist->putstr(): Put a string into this list.
+ *
+ * @param list  qskiplist_t container pointer.
+ * @param name  key name.
+ * @param str   string data.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - ENOMEM : Memory allocation failure.
+ */
+bool qskiplist_putstr(qskiplist_t *list, const char *name, const char *str) {
+    return qskiplist_putobj(list, name,
+                            (name != NULL) ? (strlen(name) + 1) : 0, str,
+                            (str != NULL) ? (strlen(str) + 1) : 0);
+}
+
+/**
+ * qskiplist->putobj(): Put an object into this list.
+ *
+ * @param list      qskiplist_t container pointer.
+ * @param name      key.
+ * @param namesize  key size.
+ * @param data      data object.
+ * @param datasize  size of data object.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @note
+ *  If the key exists, its data is replaced. Readers see either the old
+ *  data or the new one as a whole.
+ */
+bool qskiplist_putobj(qskiplist_t *list, const void *name, size_t namesize,
+                      const void *data, size_t datasize) {
+    if (name == NULL || namesize == 0 || (data == NULL && datasize > 0)) {
+        errno = EINVAL;
+        return false;
+    }
+
+    qskiplist_val_t *val = new_val(data, datasize);
+    if (val == NULL) {
+        errno = ENOMEM;
+        return false;
+    }
+
+    int level = random_level();
+    qskiplist_node_t *preds[MAX_LEVEL], *succs[MAX_LEVEL];
+    qskiplist_node_t *node = NULL;
+
+    qskiplist_read_enter(list);
+    while (true) {
+        int found = find_node(list, name, namesize, preds, succs);
+        if (found >= 0) {
+            qskiplist_node_t *exist = succs[found];
+            if (LOAD(exist->marked)) {
+                continue;  // being removed, wait until it's unlinked.
+            }
+            while (LOAD(exist->linked) == false) {
+                sched_yield();
+            }
+
+            qskiplist_val_t *old = __atomic_exchange_n(&exist->val, val,
+                                                       __ATOMIC_ACQ_REL);
+            qskiplist_read_leave(list);
+            free_node(node);
+            retire(list, old, false);
+            return true;
+        }
+
+        if (node == NULL) {
+            node = new_node(name, namesize, level);
+            if (node == NULL) {
+                qskiplist_read_leave(list);
+                free(val);
+                errno = ENOMEM;
+                return false;
+            }
+        }
+
+        // lock the predecessors bottom up, and check nothing has changed.
+        int i, highest = -1;
+        bool valid = true;
+        for (i = 0; valid && i < level; i++) {
+            if (i == 0 || preds[i] != preds[i - 1]) {
+                lock_node(preds[i]);
+                highest = i;
+            }
+            valid = !LOAD(preds[i]->marked)
+                    && (succs[i] == NULL || !LOAD(succs[i]->marked))
+                    && LOAD(preds[i]->next[i]) == succs[i];
+        }
+        if (valid == false) {
+            unlock_preds(preds, highest);
+            continue;
+        }
+
+        node->val = val;
+        for (i = 0; i < level; i++) {
+            node->next[i] = succs[i];
+        }
+        for (i = 0; i < level; i++) {
+            STORE(preds[i]->next[i], node);
+        }
+        STORE(node->linked, true);
+        unlock_preds(preds, highest);
+        break;
+    }
+    qskiplist_read_leave(list);
+    __atomic_add_fetch(&list->num, 1, __ATOMIC_RELAXED);
+
+    return true;
+}
+
+/**
+ * qskiplist->get(): Get an object from this list with a string key.
+ *
+ * @param list      qskiplist_t container pointer.
+ * @param name      key name.
+ * @param datasize  if not NULL, the size of the data will be stored.
+ * @param newmem    whether or not to allocate memory for the data.
+ *
+ * @return a pointer of data if the key is found, otherwise returns NULL.
+ * @retval errno will be set in error condition.
+ *  - ENOENT : No such key found.
+ *  - EINVAL : Invalid argument.
+ *  - ENOMEM : Memory allocation failure.
+ */
+void *qskiplist_get(qskiplist_t *list, const char *name, size_t *datasize,
+                    bool newmem) {
+    return qskiplist_getobj(list, name,
+                            (name != NULL) ? (strlen(name) + 1) : 0,
+                            datasize, newmem);
+}
+
+/**
+ * qskiplist->getstr(): Get a string from this list.
+ *
+ * @param list      qskiplist_t container pointer.
+ * @param name      key name.
+ * @param newmem    whether or not to allocate memory for the data.
+ *
+ * @return a pointer of data if the key is found, otherwise returns NULL.
+ * @retval errno will be set in error condition.
+ *  - ENOENT : No such key found.
+ *  - EINVAL : Invalid argument.
+ *  - ENOMEM : Memory allocation failure.
+ */
+char *qskiplist_getstr(qskiplist_t *list, const char *name, bool newmem) {
+    return qskiplist_getobj(list, name,
+                            (name != NULL) ? (strlen(name) + 1) : 0, NULL,
+                            newmem);
+}
+
+/**
+ * qskiplist->getobj(): Get an object from this list.
+ *
+ * @param list      qskiplist_t container pointer.
+ * @param name      key.
+ * @param namesize  key size.
+ * @param datasize  if not NULL, the size of the data will be stored.
+ * @param newmem    whether or not to allocate memory for the data.
+ *
+ * @return a pointer of data if the key is found, otherwise returns NULL.
+ * @retval errno will be set in error condition.
+ *  - ENOENT : No such key found.
+ *  - EINVAL : Invalid argument.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @note
+ *  With newmem=false, the returned data stays valid until the caller leaves
+ *  its read section, so call read_enter() beforehand.
+ */
+void *qskiplist_getobj(qskiplist_t *list, const void *name, size_t namesize,
+                       size_t *datasize, bool newmem) {
+    if (name == NULL || namesize == 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    qskiplist_node_t *preds[MAX_LEVEL], *succs[MAX_LEVEL];
+    void *data = NULL;
+
+    qskiplist_read_enter(list);
+    int found = find_node(list, name, namesize, preds, succs);
+    if (found >= 0 && !LOAD(succs[found]->marked)) {
+        qskiplist_val_t *val = LOAD(succs[found]->val);
+        data = (newmem) ? dup_data(val) : val->data;
+        if (data == NULL) {
+            errno = ENOMEM;
+        } else if (datasize != NULL) {
+            *datasize = val->datasize;
+        }
+    } else {
+        errno = ENOENT;
+    }
+    qskiplist_read_leave(list);
+
+    return data;
+}
+
+/**
+ * qskiplist->remove(): Remove an object from this list with a string key.
+ *
+ * @param list  qskiplist_t container pointer.
+ * @param name  key name.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - ENOENT : No such key found.
+ *  - EINVAL : Invalid argument.
+ */
+bool qskiplist_remove(qskiplist_t *list, const char *name) {
+    return qskiplist_removeobj(list, name,
+                               (name != NULL) ? (strlen(name) + 1) : 0);
+}
+
+/**
+ * qskiplist->removeobj(): Remove an object from this list.
+ *
+ * @param list      qskiplist_t container pointer.
+ * @param name      key.
+ * @param namesize  key size.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - ENOENT : No such key found.
+ *  - EINVAL : Invalid argument.
+ */
+bool qskiplist_removeobj(qskiplist_t *list, const void *name,
+                         size_t namesize) {
+    if (name == NULL || namesize == 0) {
+        errno = EINVAL;
+        return false;
+    }
+
+    qskiplist_node_t *preds[MAX_LEVEL], *succs[MAX_LEVEL];
+    qskiplist_node_t *victim = NULL;
+
+    qskiplist_read_enter(list);
+    while (true) {
+        int found = find_node(list, name, namesize, preds, succs);
+        if (victim == NULL) {
+            // only a fully linked node found at its top level is removable.
+            if (found < 0 || LOAD(succs[found]->linked) == false
+                    || succs[found]->level - 1 != found
+                    || LOAD(succs[found]->marked)) {
+                qskiplist_read_leave(list);
+                errno = ENOENT;
+                return false;
+            }
+
+            lock_node(succs[found]);
+            if (LOAD(succs[found]->marked)) {
+                unlock_node(succs[found]);
+                qskiplist_read_leave(list);
+                errno = ENOENT;
+                return false;
+            }
+            victim = succs[found];
+            STORE(victim->marked, true);
+        }
+
+        int i, highest = -1;
+        bool valid = true;
+        for (i = 0; valid && i < victim->level; i++) {
+            if (i == 0 || preds[i] != preds[i - 1]) {
+                lock_node(preds[i]);
+                highest = i;
+            }
+            valid = !LOAD(preds[i]->marked)
+                    && LOAD(preds[i]->next[i]) == victim;
+        }
+        if (valid == false) {
+            unlock_preds(preds, highest);
+            continue;
+        }
+
+        for (i = victim->level - 1; i >= 0; i--) {
+            STORE(preds[i]->next[i], LOAD(victim->next[i]));
+        }
+        unlock_node(victim);
+        unlock_preds(preds, highest);
+        break;
+    }
+    qskiplist_read_leave(list);
+    __atomic_sub_fetch(&list->num, 1, __ATOMIC_RELAXED);
+    retire(list, victim, true);
+
+    return true;
+}
+
+/**
+ * qskiplist->getnext(): Get the objects in the key order.
+ *
+ * @param list      qskiplist_t container pointer.
+ * @param obj       found data will be stored in this object
+ * @param newmem    whether or not to allocate memory for the data.
+ *
+ * @return true if found otherwise returns false
+ * @retval errno will be set in error condition.
+ *  - ENOENT : No next element.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @code
+ *  qskiplist_obj_t obj;
+ *  memset((void *) &obj, 0, sizeof(obj));  // must be cleared before call
+ *  list->read_enter(list);
+ *  while (list->getnext(list, &obj, false) == true) {
+ *    printf("NAME=%s, DATA=%s\n", (char *) obj.name, (char *) obj.data);
+ *  }
+ *  list->read_leave(list);
+ * @endcode
+ *
+ * @note
+ *  - Keep the whole traversal in one read section, the object remembers
+ *  the node where it is.
+ *  - Other threads can update the list during the traversal. The objects
+ *  added or removed meanwhile may or may not be visited, but every other
+ *  object is visited once in order.
+ *  - If newmem flag is true, user should de-allocate obj.name and obj.data
+ *  resources.
+ */
+bool qskiplist_getnext(qskiplist_t *list, qskiplist_obj_t *obj, bool newmem) {
+    if (obj == NULL) {
+        errno = EINVAL;
+        return false;
+    }
+
+    qskiplist_read_enter(list);
+    qskiplist_node_t *cur = (obj->cur != NULL)
+            ? (qskiplist_node_t *) obj->cur : (qskiplist_node_t *) list->head;
+    qskiplist_node_t *node = LOAD(cur->next[0]);
+    while (node != NULL && LOAD(node->marked)) {
+        node = LOAD(node->next[0]);
+    }
+
+    bool found = false;
+    if (node == NULL) {
+        errno = ENOENT;
+    } else if (fill_obj(obj, node, newmem)) {
+        obj->cur = node;
+        found = true;
+    }
+    qskiplist_read_leave(list);
+
+    return found;
+}
+
+/**
+ * qskiplist->find_nearest(): Find an object with the key or the nearest one.
+ *
+ * It returns the object of the matching key, otherwise the nearest smaller
+ * key, or the nearest bigger key when there's no smaller one.
+ *
+ * @param list      qskiplist_t container pointer.
+ * @param name      key.
+ * @param namesize  key size.
+ * @param newmem    whether or not to allocate memory for the data.
+ *
+ * @return qskiplist_obj_t object, which is empty if none found.
+ * @retval errno will be set in error condition.
+ *  - ENOENT : The list is empty.
+ *  - EINVAL : Invalid argument.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @code
+ *  Data Set : A B C D E I N R S X
+ *  find_nearest("0") => "A" // no smaller key available, so "A"
+ *  find_nearest("C") => "C" // matching key found
+ *  find_nearest("F") => "E" // "E" is nearest smaller key from "F"
+ * @endcode
+ *
+ * @note
+ *  The returned object can start a getnext() traversal, which begins with
+ *  the found object itself and goes on to the end of the list. Unlike
+ *  qtreetbl, it doesn't wrap around to the smallest key.
+ */
+qskiplist_obj_t qskiplist_find_nearest(qskiplist_t *list, const void *name,
+                                       size_t namesize, bool newmem) {
+    qskiplist_obj_t obj;
+    memset((void *) &obj, 0, sizeof(obj));
+    if (name == NULL || namesize == 0) {
+        errno = EINVAL;
+        return obj;
+    }
+
+    qskiplist_node_t *head = (qskiplist_node_t *) list->head;
+    qskiplist_node_t *preds[MAX_LEVEL], *succs[MAX_LEVEL];
+
+    qskiplist_read_enter(list);
+    while (true) {
+        int found = find_node(list, name, namesize, preds, succs);
+        qskiplist_node_t *node;
+        if (found >= 0) {
+            node = succs[found];
+        } else if (preds[0] != head) {
+            // the nearest smaller one, and then its predecessor.
+            node = preds[0];
+            if (LOAD(node->marked) == false) {
+                find_node(list, node->name, node->namesize, preds, succs);
+            }
+        } else {
+            node = succs[0];
+        }
+
+        if (node == NULL) {
+            errno = ENOENT;
+            break;
+        }
+        if (LOAD(node->marked)) {
+            sched_yield();  // being removed, look again when it's unlinked.
+            continue;
+        }
+
+        if (fill_obj(&obj, node, newmem)) {
+            obj.cur = preds[0];
+        }
+        break;
+    }
+    qskiplist_read_leave(list);
+
+    return obj;
+}
+
+/**
+ * qskiplist->size(): Returns the number of objects in this list.
+ *
+ * @param list  qskiplist_t container pointer.
+ *
+ * @return the number of objects.
+ */
+size_t qskiplist_size(qskiplist_t *list) {
+    return __atomic_load_n(&list->num, __ATOMIC_RELAXED);
+}
+
+/**
+ * qskiplist->read_enter(): Enter read section.
+ *
+ * @param list  qskiplist_t container pointer.
+ *
+ * @note
+ *  This only marks the calling thread as a reader without taking any lock,
+ *  and the objects seen by the thread won't be freed until it calls
+ *  read_leave(). Keep read sections short since removed objects can't be
+ *  freed meanwhile. Read sections can be nested.
+ */
+void qskiplist_read_enter(qskiplist_t *list) {
+    _q_epoch_enter((_q_epoch_t *) list->epoch);
+}
+
+/**
+ * qskiplist->read_leave(): Leave read section.
+ *
+ * @param list  qskiplist_t container pointer.
+ */
+void qskiplist_read_leave(qskiplist_t *list) {
+    _q_epoch_leave((_q_epoch_t *) list->epoch);
+}
+
+/**
+ * qskiplist->clear(): Remove all the objects in this list.
+ *
+ * @param list  qskiplist_t container pointer.
+ *
+ * @note
+ *  The objects are removed one by one, so it's safe to call while other
+ *  threads use the list. The objects added meanwhile may remain.
+ */
+void qskiplist_clear(qskiplist_t *list) {
+    qskiplist_node_t *head = (qskiplist_node_t *) list->head;
+    while (true) {
+        qskiplist_read_enter(list);
+        qskiplist_node_t *node = LOAD(head->next[0]);
+        while (node != NULL && LOAD(node->marked)) {
+            node = LOAD(node->next[0]);
+        }
+        if (node == NULL) {
+            qskiplist_read_leave(list);
+            break;
+        }
+        // the node isn't freed while in the read section.
+        qskiplist_removeobj(list, node->name, node->namesize);
+        qskiplist_read_leave(list);
+    }
+    _q_epoch_reclaim((_q_epoch_t *) list->epoch);
+}
+
+/**
+ * qskiplist->free(): De-allocate the list.
+ *
+ * @param list  qskiplist_t container pointer.
+ *
+ * @note
+ *  No other thread should be using the list by now.
+ */
+void qskiplist_free(qskiplist_t *list) {
+    qskiplist_node_t *node = ((qskiplist_node_t *) list->head)->next[0];
+    while (node != NULL) {
+        qskiplist_node_t *next = node->next[0];
+        free(node->val);
+        free_node(node);
+        node = next;
+    }
+    free_node(list->head);
+    _q_epoch_free((_q_epoch_t *) list->epoch);
+    free(list);
+}
+
+#ifndef _DOXYGEN_SKIP
+
+// the name is kept right after the links in the same allocation.
+static qskiplist_node_t *new_node(const void *name, size_t namesize,
+                                  int level) {
+    size_t linksize = sizeof(qskiplist_node_t *) * level;
+    qskiplist_node_t *node = (qskiplist_node_t *) malloc(
+            sizeof(qskiplist_node_t) + linksize + namesize);
+    if (node == NULL) {
+        return NULL;
+    }
+    memset((void *) node, 0, sizeof(qskiplist_node_t) + linksize);
+    node->level = level;
+    node->namesize = namesize;
+    if (namesize > 0) {
+        node->name = (char *) node + sizeof(qskiplist_node_t) + linksize;
+        memcpy(node->name, name, namesize);
+    }
+    return node;
+}
+
+static void free_node(qskiplist_node_t *node) {
+    free(node);
+}
+
+static qskiplist_val_t *new_val(const void *data, size_t datasize) {
+    qskiplist_val_t *val = (qskiplist_val_t *) malloc(
+            sizeof(qskiplist_val_t) + datasize);
+    if (val == NULL) {
+        return NULL;
+    }
+    val->datasize = datasize;
+    if (datasize > 0) {
+        memcpy(val->data, data, datasize);
+    }
+    return val;
+}
+
+// a copy of the data, which is never NULL for empty data.
+static void *dup_data(qskiplist_val_t *val) {
+    void *data = malloc((val->datasize > 0) ? val->datasize : 1);
+    if (data != NULL) {
+        memcpy(data, val->data, val->datasize);
+    }
+    return data;
+}
+
+// a level goes up with the probability of 1/4.
+static int random_level(void) {
+    static __thread uint32_t seed = 0;
+    if (seed == 0) {
+        seed = (uint32_t) (uintptr_t) &seed | 1;
+    }
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+
+    uint32_t r = seed;
+    int level = 1;
+    while (level < MAX_LEVEL && (r & 3) == 0) {
+        level++;
+        r >>= 2;
+    }
+    return level;
+}
+
+// fill the predecessors and the successors of the key at every level.
+// returns the highest level where the key is found, otherwise -1.
+static int find_node(qskiplist_t *list, const void *name, size_t namesize,
+                     qskiplist_node_t **preds, qskiplist_node_t **succs) {
+    int found = -1;
+    qskiplist_node_t *pred = (qskiplist_node_t *) list->head;
+    int level;
+    for (level = MAX_LEVEL - 1; level >= 0; level--) {
+        qskiplist_node_t *curr = LOAD(pred->next[level]);
+        while (curr != NULL) {
+            int cmp = list->compare(curr->name, curr->namesize, name,
+                                    namesize);
+            if (cmp >= 0) {
+                if (cmp == 0 && found < 0) {
+                    found = level;
+                }
+                break;
+            }
+            pred = curr;
+            curr = LOAD(pred->next[level]);
+        }
+        preds[level] = pred;
+        succs[level] = curr;
+    }
+    return found;
+}
+
+static void lock_node(qskiplist_node_t *node) {
+    int spins;
+    for (spins = 0; __atomic_test_and_set(&node->lock, __ATOMIC_ACQUIRE);
+         spins++) {
+        if (spins >= LOCK_SPINS) {
+            sched_yield();
+            spins = 0;
+        }
+    }
+}
+
+static void unlock_node(qskiplist_node_t *node) {
+    __atomic_clear(&node->lock, __ATOMIC_RELEASE);
+}
+
+// the same predecessor can repeat on consecutive levels, locked once.
+static void unlock_preds(qskiplist_node_t **preds, int highest) {
+    int i;
+    for (i = 0; i <= highest; i++) {
+        if (i == 0 || preds[i] != preds[i - 1]) {
+            unlock_node(preds[i]);
+        }
+    }
+}
+
+static bool fill_obj(qskiplist_obj_t *obj, qskiplist_node_t *node,
+                     bool newmem) {
+    qskiplist_val_t *val = LOAD(node->val);
+    if (newmem) {
+        void *name = qmemdup(node->name, node->namesize);
+        void *data = dup_data(val);
+        if (name == NULL || data == NULL) {
+            free(name);
+            free(data);
+            errno = ENOMEM;
+            return false;
+        }
+        obj->name = name;
+        obj->data = data;
+    } else {
+        obj->name = node->name;
+        obj->data = val->data;
+    }
+    obj->namesize = node->namesize;
+    obj->datasize = val->datasize;
+    return true;
+}
+
+// defer freeing an unlinked node or a replaced value until no reader can
+// see it. Call it out of the read section, it may wait for the readers.
+static void retire(qskiplist_t *list, void *ptr, bool node) {
+    _q_epoch_t *ep = (_q_epoch_t *) list->epoch;
+    size_t num = _q_epoch_retire(ep, ptr, (node) ? free_retired_node
+                                                 : free_retired_val);
+    if (num >= RECLAIM_THRESHOLD) {
+        _q_epoch_reclaim(ep);
+    }
+}
+
+// a node takes its value with it.
+static void free_retired_node(void *list, void *node) {
+    free(((qskiplist_node_t *) node)->val);
+    free_node((qskiplist_node_t *) node);
+}
+
+static void free_retired_val(void *list, void *val) {
+    free(val);
+}
+
+#endif /* _DOXYGEN_SKIP */
@@ -142,6 +142,7 @@ qstack_t *qstack(int options) {
 
     // methods
     stack->setsize = qstack_setsize;
+    stack->poolstat = qstack_poolstat;
 
     stack->push = qstack_push;
     stack->pushstr = qstack_pushstr;
@@ -178,6 +179,23 @@ size_t qstack_setsize(qstack_t *stack, size_t max) {
     return stack->list->setsize(stack->list, max);
 }
 
+/**
+ * qstack->poolstat(): Get the node pool counters of this stack.
+ *
+ * @param stack     qstack container pointer.
+ * @param hits      if not NULL, the number of pushes served by the pool.
+ * @param misses    if not NULL, the number of pushes that called malloc().
+ *
+ * @return the number of nodes in the pool.
+ *
+ * @note
+ *  Popped nodes are recycled, so steady push and pop don't call malloc()
+ *  for the elements. Please refer qlist_setpool() for the details.
+ */
+size_t qstack_poolstat(qstack_t *stack, size_t *hits, size_t *misses) {
+    return stack->list->poolstat(stack->list, hits, misses);
+}
+
 /**
  * qstack->push(): Pushes an element onto the top of this stack.
  *
@@ -290,11 +308,13 @@ char *qstack_popstr(qstack_t *stack) {
  */
 int64_t qstack_popint(qstack_t *stack) {
     int64_t num = 0;
-    int64_t *pnum = stack->list->popfirst(stack->list, NULL);
+    stack->list->lock(stack->list);
+    int64_t *pnum = stack->list->getfirst(stack->list, NULL, false);
     if (pnum != NULL) {
         num = *pnum;
-        free(pnum);
+        stack->list->removefirst(stack->list);
     }
+    stack->list->unlock(stack->list);
 
     return num;
 }
@@ -378,11 +398,12 @@ char *qstack_getstr(qstack_t *stack) {
  */
 int64_t qstack_getint(qstack_t *stack) {
     int64_t num = 0;
-    int64_t *pnum = stack->list->getfirst(stack->list, NULL, true);
+    stack->list->lock(stack->list);
+    int64_t *pnum = stack->list->getfirst(stack->list, NULL, false);
     if (pnum != NULL) {
         num = *pnum;
-        free(pnum);
     }
+    stack->list->unlock(stack->list);
 
     return num;
 }
@@ -0,0 +1,131 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/**
+ * @file qstats.c Runtime statistics of the containers.
+ *
+ * The hash containers fill a qstats_t through their stats() member, which
+ * walks the slots to measure the shape of the table and copies the
+ * counters kept along the way. Counting costs an increment on the paths
+ * which allocate, resize, collide or wait for a lock, so it is always on.
+ * The lock counters come from the Q_MUTEX macros, which count every
+ * acquisition and time only the ones that had to wait.
+ *
+ * qstats_print() writes the statistics as "prefix.field=value" lines, one
+ * per field, which is easy to scrape into a monitoring system or diff
+ * between runs.
+ *
+ * @code
+ *  qstats_t stats;
+ *  tbl->stats(tbl, &stats);
+ *  qstats_print(&stats, "sessions", stdout);
+ *
+ *  [Output]
+ *  sessions.num=10000
+ *  sessions.slots=16384
+ *  sessions.usedslots=7597
+ *  sessions.maxprobe=5
+ *  sessions.probes.0=7597
+ *  sessions.probes.1=1909
+ *  ...
+ * @endcode
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <errno.h>
+#include "qinternal.h"
+#include "containers/qstats.h"
+
+/**
+ * Write statistics into a stream.
+ *
+ * @param stats     statistics taken by the container's stats() member.
+ * @param prefix    name prefixed to each field, NULL or "" for none.
+ * @param out       output stream
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - EIO : Invalid output stream.
+ *
+ * @note
+ *  The probes histogram only lists the buckets up to maxprobe.
+ */
+bool qstats_print(const qstats_t *stats, const char *prefix, FILE *out) {
+    if (stats == NULL) {
+        errno = EINVAL;
+        return false;
+    }
+    if (out == NULL) {
+        errno = EIO;
+        return false;
+    }
+
+    const char *dot = ".";
+    if (prefix == NULL || *prefix == '\0') {
+        prefix = "";
+        dot = "";
+    }
+
+    fprintf(out, "%s%snum=%zu\n", prefix, dot, stats->num);
+    fprintf(out, "%s%sslots=%zu\n", prefix, dot, stats->slots);
+    fprintf(out, "%s%susedslots=%zu\n", prefix, dot, stats->usedslots);
+    fprintf(out, "%s%smaxprobe=%zu\n", prefix, dot, stats->maxprobe);
+    size_t i;
+    for (i = 0; i < QSTATS_HISTSIZE && i <= stats->maxprobe; i++) {
+        fprintf(out, "%s%sprobes.%zu=%zu\n", prefix, dot, i, stats->probes[i]);
+    }
+    fprintf(out, "%s%scollisions=%" PRIu64 "\n", prefix, dot, stats->collisions);
+    fprintf(out, "%s%sresizes=%" PRIu64 "\n", prefix, dot, stats->resizes);
+    fprintf(out, "%s%sevictions=%" PRIu64 "\n", prefix, dot, stats->evictions);
+    fprintf(out, "%s%sallocs=%" PRIu64 "\n", prefix, dot, stats->allocs);
+    fprintf(out, "%s%sfrees=%" PRIu64 "\n", prefix, dot, stats->frees);
+    fprintf(out, "%s%slocks=%" PRIu64 "\n", prefix, dot, stats->locks);
+    fprintf(out, "%s%scontended=%" PRIu64 "\n", prefix, dot, stats->contended);
+    fprintf(out, "%s%slockwait=%" PRIu64 "\n", prefix, dot, stats->lockwait);
+
+    return (ferror(out) == 0);
+}
+
+#ifndef _DOXYGEN_SKIP
+
+/**
+ * Add an object found after the given extra probes to the histogram.
+ */
+void _q_stats_probe(qstats_t *stats, size_t probe) {
+    stats->probes[(probe < QSTATS_HISTSIZE) ? probe : QSTATS_HISTSIZE - 1]++;
+    if (probe > stats->maxprobe) {
+        stats->maxprobe = probe;
+    }
+}
+
+#endif /* _DOXYGEN_SKIP */
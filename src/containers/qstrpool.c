@@ -0,0 +1,408 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/**
+ * @file qstrpool.c String interning pool implementation.
+ *
+ * qstrpool keeps a single copy of each distinct string. Interning a string
+ * returns a pointer to that copy, which stays valid and unchanged until the
+ * pool is freed, along with its 32bit Murmur3 hash computed once when the
+ * string first came in. So within a pool two interned strings are equal
+ * exactly when their pointers are equal.
+ *
+ * A pool can be shared by many containers holding the same names, such as
+ * tables of HTTP headers or of parsed records with the same fields. Told to
+ * use a pool with their set_strpool() call, the containers keep pointers to
+ * the interned names in place of their own copies, and the lookups by an
+ * interned name compare the pointer before the bytes.
+ *
+ * @code
+ *  qstrpool_t *pool = qstrpool(0, QSTRPOOL_THREADSAFE);
+ *
+ *  qhashtbl_t *tbl = qhashtbl(0, QHASHTBL_THREADSAFE);
+ *  tbl->set_strpool(tbl, pool);
+ *  tbl->putstr(tbl, "content-type", "text/html");  // the name is interned
+ *
+ *  // lookup with the interned name and its precomputed hash
+ *  uint32_t hash;
+ *  const char *name = pool->intern(pool, "content-type", 12, &hash);
+ *  char *value = tbl->get_by_obj(tbl, name, 12, hash, NULL, false);
+ *  (...codes...)
+ *
+ *  tbl->free(tbl);
+ *  pool->free(pool);  // the pool must outlive the containers using it
+ * @endcode
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include "qinternal.h"
+#include "utilities/qhash.h"
+#include "containers/qstrpool.h"
+
+#define DEFAULT_RANGE       (256)   /*!< default number of buckets */
+#define POOL_CHUNK_SIZE     (64 * 1024)   /*!< arena chunk size of the strings */
+
+#ifndef _DOXYGEN_SKIP
+
+/* interned string entry, the string follows the header */
+typedef struct qstrpool_ent_s qstrpool_ent_t;
+struct qstrpool_ent_s {
+    qstrpool_ent_t *next;   /*!< next entry in the bucket */
+    size_t len;             /*!< length of the string */
+    uint32_t hash;          /*!< Murmur3 hash of the string */
+    char str[];             /*!< NUL terminated string */
+};
+
+#define ENT_OF(s) ((const qstrpool_ent_t *) ((s) - offsetof(qstrpool_ent_t, str)))
+
+static qstrpool_ent_t *lookup(qstrpool_t *pool, const void *str, size_t len,
+                              uint32_t hash);
+static void grow(qstrpool_t *pool);
+
+#endif
+
+/**
+ * Create a string interning pool.
+ *
+ * @param range     initial number of buckets. 0 for the default of 256. It
+ *                  is rounded up to a power of 2 and doubles as the pool
+ *                  fills up.
+ * @param options   combination of initialization options.
+ *
+ * @return a pointer of malloced qstrpool_t, otherwise returns NULL.
+ * @retval errno will be set in error condition.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @code
+ *  qstrpool_t *pool = qstrpool(0, QSTRPOOL_THREADSAFE);
+ * @endcode
+ *
+ * @note
+ *   Available options:
+ *   - QSTRPOOL_THREADSAFE - make it thread-safe. Lookups of the strings
+ *     already in the pool only take a read lock. A pool shared by
+ *     thread-safe containers must be created with this option.
+ */
+qstrpool_t *qstrpool(size_t range, int options) {
+    size_t size;
+    for (size = 1; size < ((range > 0) ? range : DEFAULT_RANGE); size <<= 1);
+
+    qstrpool_t *pool = (qstrpool_t *) calloc(1, sizeof(qstrpool_t));
+    if (pool == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    pool->buckets = (void **) calloc(size, sizeof(void *));
+    pool->arena = qarena(POOL_CHUNK_SIZE, 0);
+    if (pool->buckets == NULL || pool->arena == NULL) {
+        qstrpool_free(pool);
+        errno = ENOMEM;
+        return NULL;
+    }
+    pool->range = size;
+
+    // handle options.
+    if (options & QSTRPOOL_THREADSAFE) {
+        Q_RWLOCK_NEW(pool->qrwlock);
+        if (pool->qrwlock == NULL) {
+            qstrpool_free(pool);
+            errno = ENOMEM;
+            return NULL;
+        }
+    }
+
+    // assign methods
+    pool->intern = qstrpool_intern;
+    pool->internstr = qstrpool_internstr;
+    pool->find = qstrpool_find;
+
+    pool->size = qstrpool_size;
+    pool->memsize = qstrpool_memsize;
+    pool->free = qstrpool_free;
+
+    return pool;
+}
+
+/**
+ * qstrpool->intern(): Get the interned copy of a string, adding it to the
+ * pool if it isn't there yet.
+ *
+ * @param pool  qstrpool_t container pointer.
+ * @param str   string to intern. It doesn't need to be NUL terminated.
+ * @param len   length of the string.
+ * @param hash  if not NULL, the Murmur3 hash of the string is stored here.
+ *
+ * @return the interned string which is NUL terminated, otherwise NULL.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @code
+ *  uint32_t hash;
+ *  const char *s1 = pool->intern(pool, "name=value", 4, &hash);
+ *  const char *s2 = pool->internstr(pool, "name");
+ *  // s1 == s2 and hash == qhashmurmur3_32("name", 4)
+ * @endcode
+ *
+ * @note
+ *  The returned pointer stays valid until the pool is freed and must not be
+ *  modified. The hash is the same as qhashmurmur3_32() gives, which is the
+ *  default hash of qhashtbl, so it can be passed to put_by_obj() and
+ *  get_by_obj() of those tables.
+ */
+const char *qstrpool_intern(qstrpool_t *pool, const void *str, size_t len,
+                            uint32_t *hash) {
+    if (pool == NULL || (str == NULL && len > 0)) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    uint32_t h = qhashmurmur3_32(str, len);
+    if (hash != NULL) {
+        *hash = h;
+    }
+
+    // most of the calls find the string already in the pool.
+    Q_RWLOCK_RDLOCK(pool->qrwlock);
+    qstrpool_ent_t *ent = lookup(pool, str, len, h);
+    Q_RWLOCK_UNLOCK(pool->qrwlock);
+    if (ent != NULL) {
+        return ent->str;
+    }
+
+    Q_RWLOCK_WRLOCK(pool->qrwlock);
+    ent = lookup(pool, str, len, h);  // may have been added meanwhile
+    if (ent == NULL) {
+        ent = (qstrpool_ent_t *) qarena_alloc(pool->arena,
+                                              sizeof(qstrpool_ent_t) + len + 1);
+        if (ent == NULL) {
+            Q_RWLOCK_UNLOCK(pool->qrwlock);
+            errno = ENOMEM;
+            return NULL;
+        }
+        ent->len = len;
+        ent->hash = h;
+        if (len > 0) {
+            memcpy(ent->str, str, len);
+        }
+        ent->str[len] = '\0';
+
+        size_t idx = h & (pool->range - 1);
+        ent->next = (qstrpool_ent_t *) pool->buckets[idx];
+        pool->buckets[idx] = ent;
+        pool->num++;
+        if (pool->num > pool->range) {
+            grow(pool);
+        }
+    }
+    Q_RWLOCK_UNLOCK(pool->qrwlock);
+
+    return ent->str;
+}
+
+/**
+ * qstrpool->internstr(): Get the interned copy of a NUL terminated string.
+ *
+ * @param pool  qstrpool_t container pointer.
+ * @param str   string to intern.
+ *
+ * @return the interned string, otherwise NULL.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - ENOMEM : Memory allocation failure.
+ */
+const char *qstrpool_internstr(qstrpool_t *pool, const char *str) {
+    if (str == NULL) {
+        errno = EINVAL;
+        return NULL;
+    }
+    return qstrpool_intern(pool, str, strlen(str), NULL);
+}
+
+/**
+ * qstrpool->find(): Get the interned copy of a string without adding it.
+ *
+ * @param pool  qstrpool_t container pointer.
+ * @param str   string to look up. It doesn't need to be NUL terminated.
+ * @param len   length of the string.
+ * @param hash  if not NULL, the Murmur3 hash of the string is stored here.
+ *
+ * @return the interned string if found, otherwise NULL.
+ * @retval errno will be set in error condition.
+ *  - ENOENT : The string is not in the pool.
+ *  - EINVAL : Invalid argument.
+ *
+ * @note
+ *  A name that is not in the pool can't be a key of the containers storing
+ *  their names in it, so a miss here answers their lookups too.
+ */
+const char *qstrpool_find(qstrpool_t *pool, const void *str, size_t len,
+                          uint32_t *hash) {
+    if (pool == NULL || (str == NULL && len > 0)) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    uint32_t h = qhashmurmur3_32(str, len);
+    if (hash != NULL) {
+        *hash = h;
+    }
+
+    Q_RWLOCK_RDLOCK(pool->qrwlock);
+    qstrpool_ent_t *ent = lookup(pool, str, len, h);
+    Q_RWLOCK_UNLOCK(pool->qrwlock);
+    if (ent == NULL) {
+        errno = ENOENT;
+        return NULL;
+    }
+
+    return ent->str;
+}
+
+/**
+ * Get the hash of an interned string.
+ *
+ * @param interned  string returned by the pool.
+ *
+ * @return the Murmur3 hash computed when the string was interned.
+ *
+ * @note
+ *  It reads the hash stored along with the string, so the argument must be
+ *  a pointer handed out by a pool.
+ */
+uint32_t qstrpool_hash(const char *interned) {
+    return ENT_OF(interned)->hash;
+}
+
+/**
+ * Get the length of an interned string.
+ *
+ * @param interned  string returned by the pool.
+ *
+ * @return the length of the string.
+ *
+ * @note
+ *  The argument must be a pointer handed out by a pool.
+ */
+size_t qstrpool_len(const char *interned) {
+    return ENT_OF(interned)->len;
+}
+
+/**
+ * qstrpool->size(): Get the number of the interned strings.
+ *
+ * @param pool  qstrpool_t container pointer.
+ *
+ * @return the number of the distinct strings in the pool.
+ */
+size_t qstrpool_size(qstrpool_t *pool) {
+    Q_RWLOCK_RDLOCK(pool->qrwlock);
+    size_t num = pool->num;
+    Q_RWLOCK_UNLOCK(pool->qrwlock);
+    return num;
+}
+
+/**
+ * qstrpool->memsize(): Get the memory held by the interned strings.
+ *
+ * @param pool  qstrpool_t container pointer.
+ *
+ * @return number of bytes taken by the strings and their headers, not
+ *  counting the buckets.
+ */
+size_t qstrpool_memsize(qstrpool_t *pool) {
+    Q_RWLOCK_RDLOCK(pool->qrwlock);
+    size_t size = qarena_size(pool->arena);
+    Q_RWLOCK_UNLOCK(pool->qrwlock);
+    return size;
+}
+
+/**
+ * qstrpool->free(): Free the pool and all the interned strings.
+ *
+ * @param pool  qstrpool_t container pointer.
+ *
+ * @note
+ *  The containers using the pool must be freed before.
+ */
+void qstrpool_free(qstrpool_t *pool) {
+    if (pool == NULL) {
+        return;
+    }
+    if (pool->arena != NULL) {
+        qarena_free(pool->arena);
+    }
+    free(pool->buckets);
+    Q_RWLOCK_DESTROY(pool->qrwlock);
+    free(pool);
+}
+
+#ifndef _DOXYGEN_SKIP
+
+static qstrpool_ent_t *lookup(qstrpool_t *pool, const void *str, size_t len,
+                              uint32_t hash) {
+    qstrpool_ent_t *ent = (qstrpool_ent_t *) pool->buckets[hash & (pool->range - 1)];
+    for (; ent != NULL; ent = ent->next) {
+        if (ent->hash == hash && ent->len == len
+            && (len == 0 || !memcmp(ent->str, str, len))) {
+            return ent;
+        }
+    }
+    return NULL;
+}
+
+/* double the buckets, the entries are relinked and never move. */
+static void grow(qstrpool_t *pool) {
+    size_t range = pool->range * 2;
+    void **buckets = (void **) calloc(range, sizeof(void *));
+    if (buckets == NULL) {
+        return;  // keep going with longer chains
+    }
+
+    size_t idx;
+    for (idx = 0; idx < pool->range; idx++) {
+        qstrpool_ent_t *ent = (qstrpool_ent_t *) pool->buckets[idx];
+        while (ent != NULL) {
+            qstrpool_ent_t *next = ent->next;
+            size_t newidx = ent->hash & (range - 1);
+            ent->next = (qstrpool_ent_t *) buckets[newidx];
+            buckets[newidx] = ent;
+            ent = next;
+        }
+    }
+    free(pool->buckets);
+    pool->buckets = buckets;
+    pool->range = range;
+}
+
+#endif /* _DOXYGEN_SKIP */
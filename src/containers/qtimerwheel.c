@@ -0,0 +1,643 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/**
+ * @file qtimerwheel.c Hierarchical timer wheel container implementation.
+ *
+ * qtimerwheel keeps timeouts in buckets of ticks instead of ordering them,
+ * so adding, resetting and cancelling a timer take constant time. That fits
+ * per-connection timeouts which are mostly cancelled or pushed back before
+ * they expire. The first wheel has a bucket for each of the next 256 ticks,
+ * and four more wheels of 64 buckets cover 64 times longer ranges each, up
+ * to 2^32 ticks. A timer in an outer wheel moves down when the inner wheel
+ * comes around to it, and every timer of a bucket expires together.
+ *
+ * Timers never expire early. They expire on the first expire() call after
+ * their tick has passed, so the accuracy is tickms plus the calling
+ * interval. nexttimeout() gives how long to wait before calling expire(),
+ * to be used as the timeout of poll(), qio calls or qevloop->once().
+ *
+ * @code
+ *  static void on_timeout(qtimerwheel_t *wheel, int64_t timerid,
+ *                         void *userdata) {
+ *    struct conn *conn = (struct conn *) userdata;
+ *    close(conn->fd);
+ *  }
+ *
+ *  qtimerwheel_t *wheel = qtimerwheel(10, 0);  // 10ms ticks
+ *  conn->timerid = wheel->add(wheel, 30000, on_timeout, conn);
+ *
+ *  while (true) {
+ *    qio_wait_readable(fd, wheel->nexttimeout(wheel));
+ *    (...some data arrived, push back the timeout...)
+ *    wheel->reset(wheel, conn->timerid, 30000);
+ *    wheel->expire(wheel);
+ *  }
+ *
+ *  wheel->cancel(wheel, conn->timerid);
+ *  wheel->free(wheel);
+ * @endcode
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include "qinternal.h"
+#include "utilities/qtime.h"
+#include "containers/qtimerwheel.h"
+
+#ifndef _DOXYGEN_SKIP
+
+#define WHEEL0_BITS     (8)
+#define WHEELN_BITS     (6)
+#define WHEEL0_SIZE     (1 << WHEEL0_BITS)
+#define WHEELN_SIZE     (1 << WHEELN_BITS)
+#define WHEEL0_MASK     (WHEEL0_SIZE - 1)
+#define WHEELN_MASK     (WHEELN_SIZE - 1)
+#define NUM_WHEELS      (5)
+#define NUM_BUCKETS     (WHEEL0_SIZE + WHEELN_SIZE * (NUM_WHEELS - 1))
+#define MAX_TICKS       (UINT32_MAX)
+
+#define BUCKET_FREE     (-1)
+#define BUCKET_RUNNING  (-2)
+
+typedef struct qtimerwheel_timer_s qtimerwheel_timer_t;
+struct qtimerwheel_timer_s {
+    uint64_t expire;        /* tick to expire */
+    uint32_t gen;           /* generation, the upper half of the timer id */
+    int bucket;             /* bucket linked in, or BUCKET_* */
+    int prev;
+    int next;
+    qtimerwheel_cb_t cb;
+    void *userdata;
+};
+
+static int64_t now_ms(void);
+static int find_timer(qtimerwheel_t *wheel, int64_t timerid);
+static int alloc_timer(qtimerwheel_t *wheel);
+static void free_timer(qtimerwheel_t *wheel, int idx);
+static uint64_t get_expire(qtimerwheel_t *wheel, int64_t nowms, int timeoutms);
+static void place_timer(qtimerwheel_t *wheel, int idx);
+static void link_timer(qtimerwheel_t *wheel, int idx, int bucket);
+static void unlink_timer(qtimerwheel_t *wheel, int idx);
+static int cascade(qtimerwheel_t *wheel, int level);
+static int run_tick(qtimerwheel_t *wheel);
+
+#endif
+
+/**
+ * Create a timer wheel.
+ *
+ * @param tickms    milliseconds per tick, 0 for 1ms.
+ * @param options   combination of initialization options.
+ *
+ * @return a pointer of malloced qtimerwheel_t, otherwise returns NULL.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @code
+ *  qtimerwheel_t *wheel = qtimerwheel(0, 0);
+ * @endcode
+ *
+ * @note
+ *   Available options:
+ *   - QTIMERWHEEL_THREADSAFE - make it thread-safe.
+ *
+ *   A coarser tick lets the wheels cover a longer range, 2^32 ticks, and
+ *   makes expire() catch up with fewer steps after a long wait.
+ */
+qtimerwheel_t *qtimerwheel(int tickms, int options) {
+    if (tickms < 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    qtimerwheel_t *wheel = (qtimerwheel_t *) calloc(1, sizeof(qtimerwheel_t));
+    int *buckets = (int *) malloc(sizeof(int) * NUM_BUCKETS);
+    if (wheel == NULL || buckets == NULL) {
+        free(wheel);
+        free(buckets);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    // handle options.
+    if (options & QTIMERWHEEL_THREADSAFE) {
+        Q_MUTEX_NEW(wheel->qmutex, true);
+        if (wheel->qmutex == NULL) {
+            free(wheel);
+            free(buckets);
+            errno = ENOMEM;
+            return NULL;
+        }
+    }
+
+    int i;
+    for (i = 0; i < NUM_BUCKETS; i++)
+        buckets[i] = -1;
+    wheel->buckets = buckets;
+    wheel->running = -1;
+    wheel->freetimer = -1;
+    wheel->tickms = (tickms > 0) ? tickms : 1;
+    wheel->startms = now_ms();
+
+    // member methods
+    wheel->add = qtimerwheel_add;
+    wheel->reset = qtimerwheel_reset;
+    wheel->cancel = qtimerwheel_cancel;
+
+    wheel->expire = qtimerwheel_expire;
+    wheel->advance = qtimerwheel_advance;
+    wheel->nexttimeout = qtimerwheel_nexttimeout;
+
+    wheel->size = qtimerwheel_size;
+    wheel->clear = qtimerwheel_clear;
+    wheel->lock = qtimerwheel_lock;
+    wheel->unlock = qtimerwheel_unlock;
+    wheel->free = qtimerwheel_free;
+
+    return wheel;
+}
+
+/**
+ * qtimerwheel->add(): Add a timer.
+ *
+ * @param wheel     qtimerwheel_t container pointer.
+ * @param timeoutms milliseconds to expire.
+ * @param cb        callback called on expiry.
+ * @param userdata  user data pointer given to the callback.
+ *
+ * @return a positive timer id if successful, otherwise returns -1.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @note
+ *  A timer id is never reused by another timer, so it's safe to cancel a
+ *  timer which might have expired already.
+ */
+int64_t qtimerwheel_add(qtimerwheel_t *wheel, int timeoutms,
+                        qtimerwheel_cb_t cb, void *userdata) {
+    if (timeoutms < 0 || cb == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    int64_t nowms = now_ms();
+
+    qtimerwheel_lock(wheel);
+    int idx = alloc_timer(wheel);
+    if (idx < 0) {
+        qtimerwheel_unlock(wheel);
+        errno = ENOMEM;
+        return -1;
+    }
+    qtimerwheel_timer_t *timer = (qtimerwheel_timer_t *) wheel->timers + idx;
+    timer->expire = get_expire(wheel, nowms, timeoutms);
+    timer->cb = cb;
+    timer->userdata = userdata;
+    place_timer(wheel, idx);
+    wheel->num++;
+    int64_t timerid = ((int64_t) timer->gen << 32) | (uint32_t) idx;
+    qtimerwheel_unlock(wheel);
+
+    return timerid;
+}
+
+/**
+ * qtimerwheel->reset(): Restart a timer with a new timeout.
+ *
+ * @param wheel     qtimerwheel_t container pointer.
+ * @param timerid   timer id returned by add().
+ * @param timeoutms milliseconds to expire from now.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - ENOENT : No such timer, or it's expired already.
+ *
+ * @code
+ *  // push back the idle timeout on every request
+ *  wheel->reset(wheel, conn->timerid, 30000);
+ * @endcode
+ */
+bool qtimerwheel_reset(qtimerwheel_t *wheel, int64_t timerid, int timeoutms) {
+    if (timeoutms < 0) {
+        errno = EINVAL;
+        return false;
+    }
+
+    int64_t nowms = now_ms();
+
+    qtimerwheel_lock(wheel);
+    int idx = find_timer(wheel, timerid);
+    if (idx < 0) {
+        qtimerwheel_unlock(wheel);
+        errno = ENOENT;
+        return false;
+    }
+    qtimerwheel_timer_t *timer = (qtimerwheel_timer_t *) wheel->timers + idx;
+    unlink_timer(wheel, idx);
+    timer->expire = get_expire(wheel, nowms, timeoutms);
+    place_timer(wheel, idx);
+    qtimerwheel_unlock(wheel);
+
+    return true;
+}
+
+/**
+ * qtimerwheel->cancel(): Cancel a timer.
+ *
+ * @param wheel     qtimerwheel_t container pointer.
+ * @param timerid   timer id returned by add().
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - ENOENT : No such timer, or it's expired already.
+ */
+bool qtimerwheel_cancel(qtimerwheel_t *wheel, int64_t timerid) {
+    qtimerwheel_lock(wheel);
+    int idx = find_timer(wheel, timerid);
+    if (idx < 0) {
+        qtimerwheel_unlock(wheel);
+        errno = ENOENT;
+        return false;
+    }
+    unlink_timer(wheel, idx);
+    free_timer(wheel, idx);
+    wheel->num--;
+    qtimerwheel_unlock(wheel);
+
+    return true;
+}
+
+/**
+ * qtimerwheel->expire(): Call the callbacks of the timers due by now.
+ *
+ * @param wheel     qtimerwheel_t container pointer.
+ *
+ * @return the number of timers expired.
+ *
+ * @note
+ *  The callbacks can add, reset and cancel timers, including the ones
+ *  expiring in the same call.
+ */
+int qtimerwheel_expire(qtimerwheel_t *wheel) {
+    return qtimerwheel_advance(wheel, now_ms());
+}
+
+/**
+ * qtimerwheel->advance(): Call the callbacks of the timers due by the given
+ * time.
+ *
+ * @param wheel     qtimerwheel_t container pointer.
+ * @param nowms     monotonic milliseconds, as qtime_monotonic_nano() / 1000000.
+ *
+ * @return the number of timers expired.
+ *
+ * @note
+ *  This is for driving the wheel with a clock the caller has read already.
+ *  The time going backward is ignored.
+ */
+int qtimerwheel_advance(qtimerwheel_t *wheel, int64_t nowms) {
+    qtimerwheel_lock(wheel);
+    if (nowms < wheel->startms) {
+        qtimerwheel_unlock(wheel);
+        return 0;
+    }
+
+    uint64_t target = (uint64_t) (nowms - wheel->startms) / wheel->tickms;
+    int called = 0;
+    while (wheel->tick <= target) {
+        if (wheel->num == 0) {
+            wheel->tick = target + 1;  // nothing to move down or expire
+            break;
+        }
+        called += run_tick(wheel);
+    }
+    qtimerwheel_unlock(wheel);
+
+    return called;
+}
+
+/**
+ * qtimerwheel->nexttimeout(): Get milliseconds to wait before the next
+ * expire() call.
+ *
+ * @param wheel     qtimerwheel_t container pointer.
+ *
+ * @return milliseconds till the next timer expires, 0 if some are due
+ *         already, or -1 if there is no timer.
+ *
+ * @note
+ *  For the timers in the outer wheels, it can be shorter than the actual
+ *  expiry, up to when the timers move down to the first wheel. So call
+ *  expire() and this again after waiting. It's never longer than the
+ *  actual expiry.
+ */
+int qtimerwheel_nexttimeout(qtimerwheel_t *wheel) {
+    int64_t nowms = now_ms();
+
+    qtimerwheel_lock(wheel);
+    if (wheel->num == 0) {
+        qtimerwheel_unlock(wheel);
+        return -1;
+    }
+
+    // the first wheel has the timers to expire till it comes around.
+    uint64_t due = (wheel->tick | WHEEL0_MASK) + 1;
+    uint64_t tick;
+    for (tick = wheel->tick; tick < due; tick++) {
+        if (wheel->buckets[tick & WHEEL0_MASK] != -1) {
+            due = tick;
+            break;
+        }
+    }
+    int64_t duems = wheel->startms + (int64_t) due * wheel->tickms;
+    qtimerwheel_unlock(wheel);
+
+    if (duems <= nowms)
+        return 0;
+    return (duems - nowms < INT_MAX) ? (int) (duems - nowms) : INT_MAX;
+}
+
+/**
+ * qtimerwheel->size(): Returns the number of pending timers.
+ *
+ * @param wheel     qtimerwheel_t container pointer.
+ *
+ * @return the number of pending timers.
+ */
+size_t qtimerwheel_size(qtimerwheel_t *wheel) {
+    return wheel->num;
+}
+
+/**
+ * qtimerwheel->clear(): Cancel all the timers.
+ *
+ * @param wheel     qtimerwheel_t container pointer.
+ */
+void qtimerwheel_clear(qtimerwheel_t *wheel) {
+    qtimerwheel_lock(wheel);
+    qtimerwheel_timer_t *timers = (qtimerwheel_timer_t *) wheel->timers;
+    int i;
+    for (i = 0; i < wheel->maxtimers; i++) {
+        if (timers[i].bucket != BUCKET_FREE) {
+            unlink_timer(wheel, i);
+            free_timer(wheel, i);
+        }
+    }
+    wheel->num = 0;
+    qtimerwheel_unlock(wheel);
+}
+
+/**
+ * qtimerwheel->lock(): Enter critical section.
+ *
+ * @param wheel     qtimerwheel_t container pointer.
+ *
+ * @note
+ *  From user side, normally locking operation is only needed when calling
+ *  several methods as one operation. It's recursive, so the methods can be
+ *  called inside, including from the callbacks.
+ */
+void qtimerwheel_lock(qtimerwheel_t *wheel) {
+    Q_MUTEX_ENTER(wheel->qmutex);
+}
+
+/**
+ * qtimerwheel->unlock(): Leave critical section.
+ *
+ * @param wheel     qtimerwheel_t container pointer.
+ */
+void qtimerwheel_unlock(qtimerwheel_t *wheel) {
+    Q_MUTEX_LEAVE(wheel->qmutex);
+}
+
+/**
+ * qtimerwheel->free(): Free the wheel. Pending timers are dropped without
+ * calling the callbacks.
+ *
+ * @param wheel     qtimerwheel_t container pointer.
+ */
+void qtimerwheel_free(qtimerwheel_t *wheel) {
+    Q_MUTEX_DESTROY(wheel->qmutex);
+    free(wheel->timers);
+    free(wheel->buckets);
+    free(wheel);
+}
+
+#ifndef _DOXYGEN_SKIP
+
+static int64_t now_ms(void) {
+    return qtime_monotonic_nano() / 1000000;
+}
+
+static int find_timer(qtimerwheel_t *wheel, int64_t timerid) {
+    if (timerid <= 0)
+        return -1;
+    int64_t idx = timerid & 0xffffffff;
+    uint32_t gen = (uint32_t) (timerid >> 32);
+    if (idx >= wheel->maxtimers)
+        return -1;
+    qtimerwheel_timer_t *timer = (qtimerwheel_timer_t *) wheel->timers + idx;
+    if (timer->gen != gen || timer->bucket == BUCKET_FREE)
+        return -1;
+    return (int) idx;
+}
+
+static int alloc_timer(qtimerwheel_t *wheel) {
+    if (wheel->freetimer < 0) {
+        if (wheel->maxtimers >= INT_MAX / 2)
+            return -1;
+        int max = (wheel->maxtimers > 0) ? wheel->maxtimers * 2 : 64;
+        qtimerwheel_timer_t *timers = (qtimerwheel_timer_t *) realloc(
+                wheel->timers, sizeof(qtimerwheel_timer_t) * max);
+        if (timers == NULL)
+            return -1;
+        int i;
+        for (i = max - 1; i >= wheel->maxtimers; i--) {
+            memset((void *) &timers[i], 0, sizeof(qtimerwheel_timer_t));
+            timers[i].gen = 1;
+            timers[i].bucket = BUCKET_FREE;
+            timers[i].next = wheel->freetimer;
+            wheel->freetimer = i;
+        }
+        wheel->timers = timers;
+        wheel->maxtimers = max;
+    }
+
+    int idx = wheel->freetimer;
+    qtimerwheel_timer_t *timer = (qtimerwheel_timer_t *) wheel->timers + idx;
+    wheel->freetimer = timer->next;
+    timer->prev = timer->next = -1;
+    return idx;
+}
+
+// put back to the free list with a new generation, invalidating the id.
+static void free_timer(qtimerwheel_t *wheel, int idx) {
+    qtimerwheel_timer_t *timer = (qtimerwheel_timer_t *) wheel->timers + idx;
+    timer->gen = (timer->gen + 1) & INT32_MAX;
+    if (timer->gen == 0)
+        timer->gen = 1;
+    timer->bucket = BUCKET_FREE;
+    timer->cb = NULL;
+    timer->userdata = NULL;
+    timer->next = wheel->freetimer;
+    wheel->freetimer = idx;
+}
+
+// the first tick when the timeout has fully passed.
+static uint64_t get_expire(qtimerwheel_t *wheel, int64_t nowms, int timeoutms) {
+    int64_t duems = nowms + timeoutms - wheel->startms;
+    uint64_t expire = (duems > 0) ?
+            ((uint64_t) duems + wheel->tickms - 1) / wheel->tickms : 0;
+    return (expire > wheel->tick) ? expire : wheel->tick;
+}
+
+// link a timer into the bucket for its expiry, relative to the current tick.
+static void place_timer(qtimerwheel_t *wheel, int idx) {
+    qtimerwheel_timer_t *timer = (qtimerwheel_timer_t *) wheel->timers + idx;
+    uint64_t expire = timer->expire;
+    uint64_t delta = (expire > wheel->tick) ? expire - wheel->tick : 0;
+    if (delta > MAX_TICKS) {
+        // beyond the range, it's moved down and placed again later.
+        delta = MAX_TICKS;
+        expire = wheel->tick + delta;
+    }
+
+    int bucket;
+    if (delta < WHEEL0_SIZE) {
+        bucket = ((delta > 0) ? expire : wheel->tick) & WHEEL0_MASK;
+    } else {
+        int level;
+        int shift = WHEEL0_BITS;
+        for (level = 1; level < NUM_WHEELS - 1; level++) {
+            if (delta < ((uint64_t) 1 << (shift + WHEELN_BITS)))
+                break;
+            shift += WHEELN_BITS;
+        }
+        bucket = WHEEL0_SIZE + (level - 1) * WHEELN_SIZE
+                + ((expire >> shift) & WHEELN_MASK);
+    }
+    link_timer(wheel, idx, bucket);
+}
+
+static void link_timer(qtimerwheel_t *wheel, int idx, int bucket) {
+    qtimerwheel_timer_t *timers = (qtimerwheel_timer_t *) wheel->timers;
+    int *head = (bucket == BUCKET_RUNNING) ?
+            &wheel->running : &wheel->buckets[bucket];
+    timers[idx].bucket = bucket;
+    timers[idx].prev = -1;
+    timers[idx].next = *head;
+    if (*head != -1)
+        timers[*head].prev = idx;
+    *head = idx;
+}
+
+static void unlink_timer(qtimerwheel_t *wheel, int idx) {
+    qtimerwheel_timer_t *timers = (qtimerwheel_timer_t *) wheel->timers;
+    qtimerwheel_timer_t *timer = &timers[idx];
+    if (timer->prev != -1) {
+        timers[timer->prev].next = timer->next;
+    } else if (timer->bucket == BUCKET_RUNNING) {
+        wheel->running = timer->next;
+    } else {
+        wheel->buckets[timer->bucket] = timer->next;
+    }
+    if (timer->next != -1)
+        timers[timer->next].prev = timer->prev;
+    timer->prev = timer->next = -1;
+}
+
+// move the timers of the current bucket of an outer wheel down, and return
+// the bucket index so the next wheel moves down too when it's 0.
+static int cascade(qtimerwheel_t *wheel, int level) {
+    int shift = WHEEL0_BITS + (level - 1) * WHEELN_BITS;
+    int slot = (wheel->tick >> shift) & WHEELN_MASK;
+    int bucket = WHEEL0_SIZE + (level - 1) * WHEELN_SIZE + slot;
+
+    int idx = wheel->buckets[bucket];
+    wheel->buckets[bucket] = -1;
+    qtimerwheel_timer_t *timers = (qtimerwheel_timer_t *) wheel->timers;
+    while (idx != -1) {
+        int next = timers[idx].next;
+        place_timer(wheel, idx);
+        idx = next;
+    }
+
+    return slot;
+}
+
+// expire a tick, moving down the outer wheels when the first one comes
+// around.
+static int run_tick(qtimerwheel_t *wheel) {
+    int slot = wheel->tick & WHEEL0_MASK;
+    if (slot == 0) {
+        int level;
+        for (level = 1; level < NUM_WHEELS; level++) {
+            if (cascade(wheel, level) != 0)
+                break;
+        }
+    }
+
+    // take the bucket out, the callbacks may add timers to this tick again.
+    qtimerwheel_timer_t *timers = (qtimerwheel_timer_t *) wheel->timers;
+    int idx = wheel->buckets[slot];
+    wheel->buckets[slot] = -1;
+    while (idx != -1) {
+        int next = timers[idx].next;
+        link_timer(wheel, idx, BUCKET_RUNNING);
+        idx = next;
+    }
+    wheel->tick++;
+
+    int called = 0;
+    while ((idx = wheel->running) != -1) {
+        qtimerwheel_timer_t *timer = (qtimerwheel_timer_t *) wheel->timers
+                + idx;
+        int64_t timerid = ((int64_t) timer->gen << 32) | (uint32_t) idx;
+        qtimerwheel_cb_t cb = timer->cb;
+        void *userdata = timer->userdata;
+        unlink_timer(wheel, idx);
+        free_timer(wheel, idx);
+        wheel->num--;
+
+        cb(wheel, timerid, userdata);
+        called++;
+    }
+
+    return called;
+}
+
+#endif /* _DOXYGEN_SKIP */
@@ -139,19 +139,74 @@ static qtreetbl_obj_t *move_red_left(qtreetbl_obj_t *obj);
 static qtreetbl_obj_t *move_red_right(qtreetbl_obj_t *obj);
 static qtreetbl_obj_t *find_min(qtreetbl_obj_t *obj);
 static qtreetbl_obj_t *find_max(qtreetbl_obj_t *obj);
-static qtreetbl_obj_t *remove_min(qtreetbl_obj_t *obj);
+static qtreetbl_obj_t *remove_min(qtreetbl_t *tbl, qtreetbl_obj_t *obj);
 static qtreetbl_obj_t *fix(qtreetbl_obj_t *obj);
+static size_t count_of(qtreetbl_obj_t *obj);
+static void update_count(qtreetbl_obj_t *obj);
+static inline int key_cmp(qtreetbl_t *tbl, const void *name1, size_t namesize1,
+                          const void *name2, size_t namesize2);
+static bool valid_key(qtreetbl_t *tbl, const void *name, size_t namesize);
 static qtreetbl_obj_t *find_obj(qtreetbl_t *tbl, const void *name,
                                 size_t namesize);
-static qtreetbl_obj_t *new_obj(bool red, const void *name, size_t namesize,
-                               const void *data, size_t datasize);
+static void *dup_mem(qtreetbl_t *tbl, const void *data, size_t size);
+static qtreetbl_obj_t *new_obj(qtreetbl_t *tbl, bool red, const void *name,
+                               size_t namesize, const void *data, size_t datasize);
 static qtreetbl_obj_t *put_obj(qtreetbl_t *tbl, qtreetbl_obj_t *obj,
                                const void *name, size_t namesize,
                                const void *data, size_t datasize);
 static qtreetbl_obj_t *remove_obj(qtreetbl_t *tbl, qtreetbl_obj_t *obj,
                                   const void *name, size_t namesize);
-static void free_objs(qtreetbl_obj_t *obj);
+static qtreetbl_obj_t *build_tree(qtreetbl_obj_t **objs, size_t num,
+                                  size_t cap);
+static void free_objs(qtreetbl_t *tbl, qtreetbl_obj_t *obj);
 static uint8_t reset_iterator(qtreetbl_t *tbl);
+static qtreetbl_obj_t *cursor_pop(qtreetbl_t *tbl, qtreetbl_cursor_t *cursor);
+static bool dump_obj(const qtreetbl_obj_t *obj, void *userdata);
+static bool restore_obj(void *userdata, qtreetbl_obj_t *obj);
+
+#define BPT_ORDER   (32)    /*!< maximum number of keys in a B+tree node */
+
+typedef struct bpt_node_s bpt_node_t;
+struct bpt_node_s {
+    bool leaf;              /*!< true if it's a leaf */
+    int num;                /*!< number of keys */
+    bpt_node_t *prev;       /*!< previous leaf in key order */
+    bpt_node_t *next;       /*!< next leaf in key order */
+    union {
+        qtreetbl_obj_t objs[BPT_ORDER];             /*!< leaf objects */
+        struct {
+            void *names[BPT_ORDER];                 /*!< separator keys */
+            size_t namesizes[BPT_ORDER];            /*!< separator key sizes */
+            bpt_node_t *children[BPT_ORDER + 1];    /*!< child nodes */
+        };
+    };
+};
+
+static bpt_node_t *bpt_new_node(qtreetbl_t *tbl, bool leaf);
+static int bpt_lower(qtreetbl_t *tbl, bpt_node_t *leaf, const void *name,
+                     size_t namesize);
+static int bpt_child(qtreetbl_t *tbl, bpt_node_t *node, const void *name,
+                     size_t namesize);
+static bpt_node_t *bpt_find_leaf(qtreetbl_t *tbl, const void *name,
+                                 size_t namesize);
+static bpt_node_t *bpt_edge_leaf(qtreetbl_t *tbl, bool last);
+static bpt_node_t *bpt_seek(qtreetbl_t *tbl, const void *name, size_t namesize,
+                            int *slot);
+static qtreetbl_obj_t *bpt_find(qtreetbl_t *tbl, const void *name,
+                                size_t namesize);
+static int bpt_insert(qtreetbl_t *tbl, bpt_node_t *node, const void *name,
+                      size_t namesize, const void *data, size_t datasize,
+                      bpt_node_t **right, void **sepname, size_t *sepsize);
+static bool bpt_put(qtreetbl_t *tbl, const void *name, size_t namesize,
+                    const void *data, size_t datasize);
+static bool bpt_delete(qtreetbl_t *tbl, bpt_node_t *node, const void *name,
+                       size_t namesize);
+static bool bpt_remove(qtreetbl_t *tbl, const void *name, size_t namesize);
+static void bpt_free(qtreetbl_t *tbl, bpt_node_t *node);
+static void bpt_print(qtreetbl_t *tbl, bpt_node_t *node, FILE *out, int depth);
+static int bpt_check(qtreetbl_t *tbl, bpt_node_t *node, const void *lo,
+                     size_t losize, const void *hi, size_t hisize, int depth,
+                     int *leafdepth, size_t *num);
 
 struct branch_obj_s {
     struct branch_obj_s *p;
@@ -178,6 +233,20 @@ static void print_node(qtreetbl_obj_t *obj, FILE *out, struct branch_obj_s *prev
  * @note
  *  Available options:
  *   - QTREETBL_THREADSAFE - make it thread-safe.
+ *   - QTREETBL_RWLOCK - make it thread-safe with a read-write lock, so
+ *     lookups and cursor scans from several threads run concurrently.
+ *     Unlike QTREETBL_THREADSAFE, the lock is not recursive. See rdlock().
+ *   - QTREETBL_BPTREE - use a B+tree engine instead of the red-black tree.
+ *     Up to 32 objects are kept sorted in each leaf and the leaves are
+ *     linked, so lookups touch a few nodes and scans walk the leaves
+ *     sequentially. The interface stays the same, except that getnext()
+ *     doesn't support removing keys in the middle of an iteration and
+ *     find_nearest() followed by getnext() continues after the found key.
+ *   - QTREETBL_KEY_UINT64, QTREETBL_KEY_INT64 - keys are 8-byte integers
+ *     in host byte order, compared numerically inline without calling the
+ *     comparator. Keys of any other size are rejected with EINVAL.
+ *   - QTREETBL_KEY_FIXED - keys are binary of the same size, compared
+ *     with memcmp() inline. The size is set by the first key stored.
  */
 qtreetbl_t *qtreetbl(int options) {
     qtreetbl_t *tbl = (qtreetbl_t *) calloc(1, sizeof(qtreetbl_t));
@@ -185,7 +254,23 @@ qtreetbl_t *qtreetbl(int options) {
         goto malloc_failure;
 
     // handle options.
-    if (options & QTREETBL_THREADSAFE) {
+    if (options & QTREETBL_BPTREE) {
+        tbl->bptree = true;
+    }
+    if (options & QTREETBL_KEY_UINT64) {
+        tbl->keytype = QTREETBL_KEY_UINT64;
+        tbl->keysize = sizeof(uint64_t);
+    } else if (options & QTREETBL_KEY_INT64) {
+        tbl->keytype = QTREETBL_KEY_INT64;
+        tbl->keysize = sizeof(int64_t);
+    } else if (options & QTREETBL_KEY_FIXED) {
+        tbl->keytype = QTREETBL_KEY_FIXED;
+    }
+    if (options & QTREETBL_RWLOCK) {
+        Q_RWLOCK_NEW(tbl->qrwlock);
+        if (tbl->qrwlock == NULL)
+            goto malloc_failure;
+    } else if (options & QTREETBL_THREADSAFE) {
         Q_MUTEX_NEW(tbl->qmutex, true);
         if (tbl->qmutex == NULL)
             goto malloc_failure;
@@ -193,11 +278,13 @@ qtreetbl_t *qtreetbl(int options) {
 
     // assign methods
     tbl->set_compare = qtreetbl_set_compare;
+    tbl->set_arena = qtreetbl_set_arena;
 
     tbl->put = qtreetbl_put;
     tbl->putstr = qtreetbl_putstr;
     tbl->putstrf = qtreetbl_putstrf;
     tbl->putobj = qtreetbl_putobj;
+    tbl->bulkload = qtreetbl_bulkload;
 
     tbl->get = qtreetbl_get;
     tbl->getstr = qtreetbl_getstr;
@@ -211,18 +298,28 @@ qtreetbl_t *qtreetbl(int options) {
     tbl->find_min = qtreetbl_find_min;
     tbl->find_max = qtreetbl_find_max;
     tbl->find_nearest = qtreetbl_find_nearest;
+    tbl->select = qtreetbl_select;
+    tbl->rank = qtreetbl_rank;
+    tbl->cursor_seek = qtreetbl_cursor_seek;
+    tbl->cursor_next = qtreetbl_cursor_next;
+    tbl->range = qtreetbl_range;
 
     tbl->size = qtreetbl_size;
     tbl->clear = qtreetbl_clear;
+    tbl->dump = qtreetbl_dump;
+    tbl->restore = qtreetbl_restore;
 
     tbl->lock = qtreetbl_lock;
+    tbl->rdlock = qtreetbl_rdlock;
     tbl->unlock = qtreetbl_unlock;
 
     tbl->free = qtreetbl_free;
     tbl->debug = qtreetbl_debug;
 
     // Set default comparison function.
-    qtreetbl_set_compare(tbl, qtreetbl_byte_cmp);
+    qtreetbl_set_compare(tbl, (tbl->keytype == QTREETBL_KEY_UINT64) ? qtreetbl_uint64_cmp :
+                              (tbl->keytype == QTREETBL_KEY_INT64) ? qtreetbl_int64_cmp :
+                              qtreetbl_byte_cmp);
     reset_iterator(tbl);
 
     return tbl;
@@ -246,13 +343,46 @@ qtreetbl_t *qtreetbl(int options) {
  *  By default, qtreetbl uses byte comparator that works for
  *  both binary type key and string type key. Please refer
  *  qtreetbl_byte_cmp() for your idea to make your own comparator.
+ *  Setting a different comparator turns off the QTREETBL_KEY_* key mode.
  */
 void qtreetbl_set_compare(qtreetbl_t *tbl,
                           int (*cmp)(const void *name1, size_t namesize1,
                                      const void *name2, size_t namesize2)) {
+    if (tbl->compare != NULL && cmp != tbl->compare) {
+        // the built-in key mode no longer applies
+        tbl->keytype = 0;
+        tbl->keysize = 0;
+    }
     tbl->compare = cmp;
 }
 
+/**
+ * qtreetbl->set_arena(): Take the objects from an arena allocator.
+ *
+ * @param tbl   qtreetbl_t container pointer.
+ * @param arena qarena_t container pointer, NULL to use the heap again.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EBUSY  : The table is not empty.
+ *
+ * @note
+ *  The nodes, the names and the data are then allocated from the arena and
+ *  never freed one by one, so clear() and free() don't walk the tree. The
+ *  data returned with newmem flag is still malloced.
+ */
+bool qtreetbl_set_arena(qtreetbl_t *tbl, qarena_t *arena) {
+    qtreetbl_lock(tbl);
+    if (tbl->num > 0) {
+        qtreetbl_unlock(tbl);
+        errno = EBUSY;
+        return false;
+    }
+    tbl->arena = arena;
+    qtreetbl_unlock(tbl);
+    return true;
+}
+
 /**
  * qtreetbl->put(): Put an object into this table with string type key.
  *
@@ -335,12 +465,20 @@ bool qtreetbl_putstrf(qtreetbl_t *tbl, const char *name, const char *format,
  */
 bool qtreetbl_putobj(qtreetbl_t *tbl, const void *name, size_t namesize,
                      const void *data, size_t datasize) {
-    if (name == NULL || namesize == 0) {
+    if (valid_key(tbl, name, namesize) == false) {
         errno = EINVAL;
         return false;
     }
 
     qtreetbl_lock(tbl);
+    if (tbl->keytype == QTREETBL_KEY_FIXED && tbl->keysize == 0) {
+        tbl->keysize = namesize;
+    }
+    if (tbl->bptree) {
+        bool ret = bpt_put(tbl, name, namesize, data, datasize);
+        qtreetbl_unlock(tbl);
+        return ret;
+    }
     errno = 0;
     qtreetbl_obj_t *root = put_obj(tbl, tbl->root, name, namesize, data,
                                    datasize);
@@ -355,6 +493,143 @@ bool qtreetbl_putobj(qtreetbl_t *tbl, const void *name, size_t namesize,
     return true;
 }
 
+/**
+ * qtreetbl->bulkload(): Load an empty table from sorted input.
+ *
+ * The iterator is called repeatedly to fill in the name, namesize, data and
+ * datasize of the next object, and returns false when there's no more.
+ * The keys must come in strictly ascending order of the table's comparator.
+ * Instead of rebalancing on each insertion, the objects are allocated in a
+ * single pass then linked into a balanced tree bottom-up, which takes O(n).
+ *
+ * @param tbl         qtreetbl_t container pointer.
+ * @param iter        iterator callback.
+ * @param userdata    user data passed to the iterator.
+ *
+ * @return true if successful, otherwise returns false and the table is
+ *         left empty.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument, the table isn't empty or the keys aren't
+ *             in ascending order.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @code
+ *  static bool next_key(void *userdata, qtreetbl_obj_t *obj) {
+ *      int *i = (int *) userdata;
+ *      if (*i == 10) return false;
+ *      obj->name = keys[*i];  // sorted
+ *      obj->namesize = strlen(keys[*i]) + 1;
+ *      obj->data = values[*i];
+ *      obj->datasize = strlen(values[*i]) + 1;
+ *      (*i)++;
+ *      return true;
+ *  }
+ *
+ *  int i = 0;
+ *  tbl->bulkload(tbl, next_key, &i);
+ * @endcode
+ *
+ * @note
+ *  With QTREETBL_BPTREE, the objects are appended through the regular
+ *  insertion.
+ */
+bool qtreetbl_bulkload(qtreetbl_t *tbl,
+                       bool (*iter)(void *userdata, qtreetbl_obj_t *obj),
+                       void *userdata) {
+    if (iter == NULL) {
+        errno = EINVAL;
+        return false;
+    }
+
+    qtreetbl_lock(tbl);
+    if (tbl->num > 0) {
+        qtreetbl_unlock(tbl);
+        errno = EINVAL;
+        return false;
+    }
+
+    qtreetbl_obj_t **objs = NULL;
+    size_t num = 0, max = 0;
+    qtreetbl_obj_t in, last;
+    memset((void *) &last, 0, sizeof(last));
+    for (;;) {
+        memset((void *) &in, 0, sizeof(in));
+        if (iter(userdata, &in) == false) {
+            break;
+        }
+        if (tbl->keytype == QTREETBL_KEY_FIXED && tbl->keysize == 0) {
+            tbl->keysize = in.namesize;
+        }
+        if (valid_key(tbl, in.name, in.namesize) == false
+            || (last.name != NULL
+                && key_cmp(tbl, last.name, last.namesize, in.name,
+                                in.namesize) >= 0)) {
+            errno = EINVAL;
+            goto fail;
+        }
+
+        if (tbl->bptree) {
+            if (bpt_put(tbl, in.name, in.namesize, in.data, in.datasize) == false) {
+                goto fail;
+            }
+            // compare with the stored key, the iterator may reuse its buffer
+            last = *bpt_find(tbl, in.name, in.namesize);
+            continue;
+        }
+
+        if (num == max) {
+            size_t newmax = (max > 0) ? max * 2 : 1024;
+            qtreetbl_obj_t **newobjs = (qtreetbl_obj_t **) realloc(
+                    objs, sizeof(qtreetbl_obj_t *) * newmax);
+            if (newobjs == NULL) {
+                errno = ENOMEM;
+                goto fail;
+            }
+            objs = newobjs;
+            max = newmax;
+        }
+        objs[num] = new_obj(tbl, false, in.name, in.namesize, in.data,
+                            in.datasize);
+        if (objs[num] == NULL) {
+            goto fail;
+        }
+        last = *objs[num++];
+    }
+
+    if (num > 0) {
+        // pick the tallest black height h with 2^h - 1 <= num, then
+        // each child of the root holds at most 3^(h-1) - 1 objects.
+        size_t cap = 1, full = 1;
+        while (full * 2 + 1 <= num) {
+            full = full * 2 + 1;
+            cap *= 3;
+        }
+        tbl->root = build_tree(objs, num, cap - 1);
+        tbl->num = num;
+    }
+    free(objs);
+    qtreetbl_unlock(tbl);
+    return true;
+
+    fail:
+    while (num > 0) {
+        qtreetbl_obj_t *obj = objs[--num];
+        Q_ARENA_FREE(tbl->arena, obj->name);
+        Q_ARENA_FREE(tbl->arena, obj->data);
+        Q_ARENA_FREE(tbl->arena, obj);
+    }
+    free(objs);
+    if (tbl->bptree) {
+        if (tbl->arena == NULL) {
+            bpt_free(tbl, (bpt_node_t *) tbl->broot);
+        }
+        tbl->broot = NULL;
+        tbl->num = 0;
+    }
+    qtreetbl_unlock(tbl);
+    return false;
+}
+
 /**
  * qtreetbl->get(): Get an object from this table.
  *
@@ -442,13 +717,14 @@ char *qtreetbl_getstr(qtreetbl_t *tbl, const char *name, const bool newmem) {
  */
 void *qtreetbl_getobj(qtreetbl_t *tbl, const void *name, size_t namesize,
                       size_t *datasize, bool newmem) {
-    if (name == NULL || namesize == 0) {
+    if (valid_key(tbl, name, namesize) == false) {
         errno = EINVAL;
         return NULL;
     }
 
-    qtreetbl_lock(tbl);
-    qtreetbl_obj_t *obj = find_obj(tbl, name, namesize);
+    qtreetbl_rdlock(tbl);
+    qtreetbl_obj_t *obj = (tbl->bptree) ? bpt_find(tbl, name, namesize)
+                                        : find_obj(tbl, name, namesize);
     void *data = NULL;
     if (obj != NULL) {
         data = (newmem) ? qmemdup(obj->data, obj->datasize) : obj->data;
@@ -489,12 +765,17 @@ bool qtreetbl_remove(qtreetbl_t *tbl, const char *name) {
  *  - EINVAL : Invalid argument.
  */
 bool qtreetbl_removeobj(qtreetbl_t *tbl, const void *name, size_t namesize) {
-    if (name == NULL) {
+    if (valid_key(tbl, name, namesize) == false) {
         errno = EINVAL;
         return false;
     }
 
     qtreetbl_lock(tbl);
+    if (tbl->bptree) {
+        bool removed = bpt_remove(tbl, name, namesize);
+        qtreetbl_unlock(tbl);
+        return removed;
+    }
     errno = 0;
     tbl->root = remove_obj(tbl, tbl->root, name, namesize);
     if (tbl->root != NULL) {
@@ -583,6 +864,29 @@ bool qtreetbl_getnext(qtreetbl_t *tbl, qtreetbl_obj_t *obj, const bool newmem) {
         return NULL;
     }
 
+    if (tbl->bptree) {
+        // obj->next and obj->tid keep the leaf and the slot to visit next
+        int slot = obj->tid;
+        bpt_node_t *leaf = (obj->next != NULL) ? (bpt_node_t *) obj->next
+                                               : bpt_edge_leaf(tbl, false);
+        if (leaf != NULL && slot >= leaf->num) {
+            leaf = leaf->next;
+            slot = 0;
+        }
+        if (leaf == NULL) {
+            errno = ENOENT;
+            return false;
+        }
+        *obj = leaf->objs[slot];
+        if (newmem) {
+            obj->name = qmemdup(obj->name, obj->namesize);
+            obj->data = qmemdup(obj->data, obj->datasize);
+        }
+        obj->next = (qtreetbl_obj_t *) leaf;
+        obj->tid = slot + 1;
+        return true;
+    }
+
     uint8_t tid = obj->tid;
     if (obj->next == NULL) {  // first time call
         if (tbl->root == NULL) {
@@ -632,8 +936,12 @@ bool qtreetbl_getnext(qtreetbl_t *tbl, qtreetbl_obj_t *obj, const bool newmem) {
  *  It's user's responsibility to free the return.
  */
 void *qtreetbl_find_min(qtreetbl_t *tbl, size_t *namesize) {
-    qtreetbl_lock(tbl);
+    qtreetbl_rdlock(tbl);
     qtreetbl_obj_t *obj = find_min(tbl->root);
+    if (tbl->bptree) {
+        bpt_node_t *leaf = bpt_edge_leaf(tbl, false);
+        obj = (leaf != NULL) ? &leaf->objs[0] : NULL;
+    }
     if (obj == NULL) {
         errno = ENOENT;
         qtreetbl_unlock(tbl);
@@ -660,8 +968,12 @@ void *qtreetbl_find_min(qtreetbl_t *tbl, size_t *namesize) {
  *  It's user's responsibility to free the return.
  */
 void *qtreetbl_find_max(qtreetbl_t *tbl, size_t *namesize) {
-    qtreetbl_lock(tbl);
+    qtreetbl_rdlock(tbl);
     qtreetbl_obj_t *obj = find_max(tbl->root);
+    if (tbl->bptree) {
+        bpt_node_t *leaf = bpt_edge_leaf(tbl, true);
+        obj = (leaf != NULL) ? &leaf->objs[leaf->num - 1] : NULL;
+    }
     if (obj == NULL) {
         errno = ENOENT;
         qtreetbl_unlock(tbl);
@@ -713,15 +1025,49 @@ qtreetbl_obj_t qtreetbl_find_nearest(qtreetbl_t *tbl, const void *name,
     qtreetbl_obj_t retobj;
     memset((void*) &retobj, 0, sizeof(retobj));
 
-    if (name == NULL || namesize == 0) {
+    if (valid_key(tbl, name, namesize) == false) {
         errno = EINVAL;
         return retobj;
     }
 
     qtreetbl_lock(tbl);
+    if (tbl->bptree) {
+        int slot;
+        bpt_node_t *leaf = bpt_seek(tbl, name, namesize, &slot);
+        if (leaf == NULL) {
+            // nothing bigger, take the biggest
+            leaf = bpt_edge_leaf(tbl, true);
+            slot = (leaf != NULL) ? leaf->num - 1 : 0;
+        } else if (key_cmp(tbl, leaf->objs[slot].name, leaf->objs[slot].namesize,
+                                name, namesize) != 0) {
+            // step back to the nearest smaller key if there's one
+            if (slot > 0) {
+                slot--;
+            } else if (leaf->prev != NULL) {
+                leaf = leaf->prev;
+                slot = leaf->num - 1;
+            }
+        }
+
+        if (leaf != NULL) {
+            retobj = leaf->objs[slot];
+            if (newmem) {
+                retobj.name = qmemdup(retobj.name, retobj.namesize);
+                retobj.data = qmemdup(retobj.data, retobj.datasize);
+            }
+            // continue after the found key in getnext()
+            retobj.next = (qtreetbl_obj_t *) leaf;
+            retobj.tid = slot + 1;
+        } else {
+            errno = ENOENT;
+        }
+        qtreetbl_unlock(tbl);
+        return retobj;
+    }
+
     qtreetbl_obj_t *obj, *lastobj;
     for (obj = lastobj = tbl->root; obj != NULL;) {
-        int cmp = tbl->compare(name, namesize, obj->name, obj->namesize);
+        int cmp = key_cmp(tbl, name, namesize, obj->name, obj->namesize);
         if (cmp == 0) {
             break;
         }
@@ -741,7 +1087,7 @@ qtreetbl_obj_t qtreetbl_find_nearest(qtreetbl_t *tbl, const void *name,
 
     if (obj == NULL) {
         for (obj = lastobj;
-            obj != NULL && (tbl->compare(name, namesize, obj->name, obj->namesize) < 0);
+            obj != NULL && (key_cmp(tbl, name, namesize, obj->name, obj->namesize) < 0);
             obj = obj->next);
         if (obj == NULL) {
             obj = lastobj;
@@ -766,124 +1112,588 @@ qtreetbl_obj_t qtreetbl_find_nearest(qtreetbl_t *tbl, const void *name,
 }
 
 /**
- * qtreetbl->size(): Returns the number of keys in the table.
+ * qtreetbl->select(): Find the k-th smallest object.
  *
- * @param tbl    qtreetbl_t container pointer.
+ * @param tbl       qtreetbl_t container pointer.
+ * @param k         zero-based rank of the object. 0 is the smallest key.
+ * @param newmem    whether or not to allocate memory for the name and data.
  *
- * @return number of elements stored.
- */
-size_t qtreetbl_size(qtreetbl_t *tbl) {
-    return tbl->num;
-}
-
-/**
- * qtreetbl->clear(): Clears the table so that it contains no keys.
+ * @return qtreetbl_obj_t object. The name is NULL if not found.
  *
- * @param tbl    qtreetbl_t container pointer.
+ * @retval errno will be set in error condition.
+ *  - ENOENT : k is out of range.
+ *
+ * @code
+ *  Data Set : A B C D E I N R S X
+ *  select(0) => "A"
+ *  select(5) => "I"
+ *  select(10) => ENOENT
+ * @endcode
+ *
+ * @note
+ *  It takes O(log n) with the red-black tree using the subtree counts.
+ *  With QTREETBL_BPTREE, it walks the leaves which takes O(n / 32).
  */
-void qtreetbl_clear(qtreetbl_t *tbl) {
-    qtreetbl_lock(tbl);
-    free_objs(tbl->root);
-    tbl->root = NULL;
-    tbl->num = 0;
+qtreetbl_obj_t qtreetbl_select(qtreetbl_t *tbl, size_t k, bool newmem) {
+    qtreetbl_obj_t retobj;
+    memset((void *) &retobj, 0, sizeof(retobj));
+
+    qtreetbl_rdlock(tbl);
+    qtreetbl_obj_t *obj = NULL;
+    if (k >= tbl->num) {
+        // out of range
+    } else if (tbl->bptree) {
+        bpt_node_t *leaf = bpt_edge_leaf(tbl, false);
+        for (; k >= (size_t) leaf->num; leaf = leaf->next) {
+            k -= leaf->num;
+        }
+        obj = &leaf->objs[k];
+    } else {
+        for (obj = tbl->root; obj != NULL;) {
+            size_t leftnum = count_of(obj->left);
+            if (k == leftnum) {
+                break;
+            }
+            if (k < leftnum) {
+                obj = obj->left;
+            } else {
+                k -= leftnum + 1;
+                obj = obj->right;
+            }
+        }
+    }
+
+    if (obj != NULL) {
+        retobj = *obj;
+        if (newmem) {
+            retobj.name = qmemdup(obj->name, obj->namesize);
+            retobj.data = qmemdup(obj->data, obj->datasize);
+        }
+        retobj.left = retobj.right = retobj.next = NULL;
+    } else {
+        errno = ENOENT;
+    }
     qtreetbl_unlock(tbl);
+
+    return retobj;
 }
 
 /**
- * qtreetbl->lock(): Enter critical section.
+ * qtreetbl->rank(): Count the keys smaller than the given key.
  *
- * @param tbl    qtreetbl_t container pointer.
+ * The key doesn't need to exist in the table. If it exists, the return is
+ * also its zero-based rank, so select(rank(key)) finds the key back.
  *
- * @note
- *  From user side, normally locking operation is only needed when traverse
- *  all elements using qtreetbl->getnext().
+ * @param tbl         qtreetbl_t container pointer.
+ * @param name        key name.
+ * @param namesize    key size.
  *
- * @note
- *  This operation will do nothing if QTREETBL_THREADSAFE option was not
- *  given at the initialization time.
- */
-void qtreetbl_lock(qtreetbl_t *tbl) {
-    Q_MUTEX_ENTER(tbl->qmutex);
-}
-
-/**
- * qtreetbl->unlock(): Leave critical section.
+ * @return number of keys smaller than the given key.
  *
- * @param tbl    qtreetbl_t container pointer.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
  *
- * @note
- *  This operation will do nothing if QTREETBL_THREADSAFE option was not
- *  given at the initialization time.
- */
-void qtreetbl_unlock(qtreetbl_t *tbl) {
-    Q_MUTEX_LEAVE(tbl->qmutex);
-}
-
-/**
- * qtreetbl->free(): De-allocate the table.
+ * @code
+ *  Data Set : A B C D E I N R S X
+ *  rank("A") => 0
+ *  rank("F") => 5
+ *  rank("Z") => 10
+ * @endcode
  *
- * @param tbl    qtreetbl_t container pointer.
+ * @note
+ *  It takes O(log n) with the red-black tree using the subtree counts.
+ *  With QTREETBL_BPTREE, it walks the leaves which takes O(n / 32).
  */
-void qtreetbl_free(qtreetbl_t *tbl) {
-    qtreetbl_clear(tbl);
-    Q_MUTEX_DESTROY(tbl->qmutex);
-    free(tbl);
-}
+size_t qtreetbl_rank(qtreetbl_t *tbl, const void *name, size_t namesize) {
+    if (valid_key(tbl, name, namesize) == false) {
+        errno = EINVAL;
+        return 0;
+    }
 
-int qtreetbl_byte_cmp(const void *name1, size_t namesize1, const void *name2,
-                      size_t namesize2) {
-    size_t minsize = (namesize1 < namesize2) ? namesize1 : namesize2;
-    int cmp = memcmp(name1, name2, minsize);
-    if (cmp != 0 || namesize1 == namesize2) {
-        return cmp;
+    size_t rank = 0;
+    qtreetbl_rdlock(tbl);
+    if (tbl->bptree) {
+        int slot;
+        bpt_node_t *found = bpt_seek(tbl, name, namesize, &slot);
+        bpt_node_t *leaf = bpt_edge_leaf(tbl, false);
+        for (; leaf != NULL && leaf != found; leaf = leaf->next) {
+            rank += leaf->num;
+        }
+        if (found != NULL) {
+            rank += slot;
+        }
+    } else {
+        qtreetbl_obj_t *obj;
+        for (obj = tbl->root; obj != NULL;) {
+            int cmp = key_cmp(tbl, name, namesize, obj->name, obj->namesize);
+            if (cmp <= 0) {
+                if (cmp == 0) {
+                    rank += count_of(obj->left);
+                    break;
+                }
+                obj = obj->left;
+            } else {
+                rank += count_of(obj->left) + 1;
+                obj = obj->right;
+            }
+        }
     }
-    return (namesize1 < namesize2) ? -1 : +1;
+    qtreetbl_unlock(tbl);
+
+    return rank;
 }
 
 /**
- * qtreetbl->debug(): Print the internal tree structure in text.
- *
- * @param tbl    qtreetbl_t container pointer.
- * @param out    output stream.
+ * qtreetbl->cursor_seek(): Positions a cursor at the smallest key not less
+ * than the lower bound, for iterating up to the upper bound.
  *
- * @return true if successful, otherwise returns false.
+ * @param tbl       qtreetbl_t container pointer.
+ * @param cursor    qtreetbl_cursor_t cursor to position.
+ * @param lo        lower bound key, inclusive. NULL to start from the
+ *                  smallest key.
+ * @param losize    lower bound key size.
+ * @param hi        upper bound key, inclusive. NULL for no upper bound.
+ * @param hisize    upper bound key size.
+ *
+ * @return true if there's a key in the range, otherwise returns false.
  * @retval errno will be set in error condition.
- *  - EIO : Invalid output stream.
+ *  - EINVAL : Invalid argument.
+ *  - ENOENT : No key in the range.
  *
  * @code
- * Example output:
- *
- *     ┌───9
- *     │   └──[8]
- * ┌───7
- * │   │   ┌───6
- * │   └──[5]
- * │       └───4
- * 3
- * │   ┌───2
- * └───1
- *     └───0
+ *  qtreetbl_cursor_t cursor;
+ *  qtreetbl_obj_t obj;
+ *  tbl->lock(tbl);
+ *  tbl->cursor_seek(tbl, &cursor, "2015-01", 7, "2015-06", 7);
+ *  while (tbl->cursor_next(tbl, &cursor, &obj, false)) {
+ *      printf("%s=%s\n", (char *) obj.name, (char *) obj.data);
+ *  }
+ *  tbl->unlock(tbl);
  * @endcode
+ *
  * @note
- *  Red nodes are wrapped in `[]`.
- *  In this example, 5 and 8 are Red nodes.
+ *  Unlike getnext(), a cursor doesn't write traversal markers into the tree,
+ *  so it can start at any key and several cursors can run at once. Seeking
+ *  takes O(log n) and each step takes amortized constant time. With
+ *  QTREETBL_BPTREE, the cursor walks the linked leaves. The cursor
+ *  keeps pointers to the bound and the tree objects, so the bound must stay
+ *  valid and the table must not be modified while the cursor is used.
  */
-bool qtreetbl_debug(qtreetbl_t *tbl, FILE *out) {
-    if (out == NULL) {
-        errno = EIO;
+bool qtreetbl_cursor_seek(qtreetbl_t *tbl, qtreetbl_cursor_t *cursor,
+                          const void *lo, size_t losize,
+                          const void *hi, size_t hisize) {
+    if ((lo != NULL && valid_key(tbl, lo, losize) == false)
+        || (hi != NULL && valid_key(tbl, hi, hisize) == false)) {
+        errno = EINVAL;
         return false;
     }
 
-    qtreetbl_lock(tbl);
-    print_node(tbl->root, out, NULL, false);
+    qtreetbl_rdlock(tbl);
+    cursor->depth = 0;
+    cursor->hi = hi;
+    cursor->hisize = hisize;
+
+    if (tbl->bptree) {
+        bpt_node_t *leaf = bpt_seek(tbl, lo, losize, &cursor->slot);
+        if (leaf != NULL && hi != NULL
+            && key_cmp(tbl, leaf->objs[cursor->slot].name,
+                            leaf->objs[cursor->slot].namesize, hi, hisize) > 0) {
+            leaf = NULL;
+        }
+        cursor->leaf = leaf;
+        if (leaf == NULL) {
+            errno = ENOENT;
+        }
+        qtreetbl_unlock(tbl);
+        return (leaf != NULL);
+    }
+
+    // keep the ancestors where the path turns left, the top is the bound
+    qtreetbl_obj_t *obj = tbl->root;
+    while (obj != NULL) {
+        if (lo == NULL || key_cmp(tbl, obj->name, obj->namesize, lo, losize) >= 0) {
+            cursor->stack[cursor->depth++] = obj;
+            obj = obj->left;
+        } else {
+            obj = obj->right;
+        }
+    }
+
+    bool found = (cursor->depth > 0 && (hi == NULL ||
+                  key_cmp(tbl, cursor->stack[cursor->depth - 1]->name,
+                               cursor->stack[cursor->depth - 1]->namesize,
+                               hi, hisize) <= 0));
+    if (found == false) {
+        cursor->depth = 0;
+        errno = ENOENT;
+    }
     qtreetbl_unlock(tbl);
-    return true;
+    return found;
 }
 
 /**
- * Verifies that root property of the red-black tree is satisfied.
+ * qtreetbl->cursor_next(): Gets the next object within the range of a cursor.
  *
- * Root property: The root is black.
+ * @param tbl       qtreetbl_t container pointer.
+ * @param cursor    qtreetbl_cursor_t cursor positioned by cursor_seek().
+ * @param obj       found data will be stored in this structure.
+ * @param newmem    whether or not to allocate memory for the name and data.
+ *
+ * @return true if found otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - ENOENT : No more keys in the range.
+ *
+ * @note
+ *  If newmem flag is true, user should de-allocate obj.name and obj.data
+ *  resources.
+ */
+bool qtreetbl_cursor_next(qtreetbl_t *tbl, qtreetbl_cursor_t *cursor,
+                          qtreetbl_obj_t *obj, bool newmem) {
+    qtreetbl_rdlock(tbl);
+    qtreetbl_obj_t *found = cursor_pop(tbl, cursor);
+    if (found == NULL) {
+        qtreetbl_unlock(tbl);
+        errno = ENOENT;
+        return false;
+    }
+
+    *obj = *found;
+    if (newmem) {
+        obj->name = qmemdup(found->name, found->namesize);
+        obj->data = qmemdup(found->data, found->datasize);
+    }
+    obj->next = NULL;
+    qtreetbl_unlock(tbl);
+    return true;
+}
+
+/**
+ * qtreetbl->range(): Calls a function for every object within a key range
+ * in order.
+ *
+ * @param tbl       qtreetbl_t container pointer.
+ * @param lo        lower bound key, inclusive. NULL for no lower bound.
+ * @param losize    lower bound key size.
+ * @param hi        upper bound key, inclusive. NULL for no upper bound.
+ * @param hisize    upper bound key size.
+ * @param cb        callback function. Return false to stop the scan.
+ * @param userdata  user data passed to the callback.
+ *
+ * @return the number of objects passed to the callback.
+ *
+ * @code
+ *  bool print_obj(const qtreetbl_obj_t *obj, void *userdata) {
+ *      printf("%s\n", (char *) obj->name);
+ *      return true;
+ *  }
+ *
+ *  tbl->range(tbl, "B", 2, "F", 2, print_obj, NULL);
+ * @endcode
+ *
+ * @note
+ *  It takes O(log n + k) for k objects. The table is locked during the scan,
+ *  so the callback must not modify it.
+ */
+size_t qtreetbl_range(qtreetbl_t *tbl, const void *lo, size_t losize,
+                      const void *hi, size_t hisize,
+                      bool (*cb)(const qtreetbl_obj_t *obj, void *userdata),
+                      void *userdata) {
+    qtreetbl_cursor_t cursor;
+    size_t num = 0;
+
+    qtreetbl_rdlock(tbl);
+    if (qtreetbl_cursor_seek(tbl, &cursor, lo, losize, hi, hisize)) {
+        qtreetbl_obj_t *obj;
+        while ((obj = cursor_pop(tbl, &cursor)) != NULL) {
+            num++;
+            if (cb(obj, userdata) == false) {
+                break;
+            }
+        }
+    }
+    qtreetbl_unlock(tbl);
+
+    return num;
+}
+
+/**
+ * qtreetbl->size(): Returns the number of keys in the table.
+ *
+ * @param tbl    qtreetbl_t container pointer.
+ *
+ * @return number of elements stored.
+ */
+size_t qtreetbl_size(qtreetbl_t *tbl) {
+    return tbl->num;
+}
+
+/**
+ * qtreetbl->clear(): Clears the table so that it contains no keys.
+ *
+ * @param tbl    qtreetbl_t container pointer.
+ */
+void qtreetbl_clear(qtreetbl_t *tbl) {
+    qtreetbl_lock(tbl);
+    if (tbl->arena == NULL) {
+        free_objs(tbl, tbl->root);
+        bpt_free(tbl, (bpt_node_t *) tbl->broot);
+    }
+    tbl->root = NULL;
+    tbl->broot = NULL;
+    tbl->num = 0;
+    qtreetbl_unlock(tbl);
+}
+
+/**
+ * qtreetbl->dump(): Save all the objects into a binary snapshot file in
+ * key order.
+ *
+ * @param tbl       qtreetbl_t container pointer.
+ * @param filepath  snapshot file path
+ * @param checksum  whether or not to protect the records with CRC32C.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - ENOMEM : Memory allocation failure.
+ *  - and errors of mkstemp(), write() and rename().
+ *
+ * @note
+ *  The snapshot is written into a temporary file next to the filepath and
+ *  renamed over it when complete, so an existing snapshot is either kept or
+ *  replaced as a whole. The table is read locked during the scan.
+ */
+bool qtreetbl_dump(qtreetbl_t *tbl, const char *filepath, bool checksum) {
+    _q_snapshot_t *snap = _q_snapshot_create(filepath, Q_SNAPSHOT_TREETBL,
+                                             checksum);
+    if (snap == NULL) {
+        return false;
+    }
+
+    // a failed write stops the scan, leaving the snapshot a record short.
+    size_t cnt = qtreetbl_range(tbl, NULL, 0, NULL, 0, dump_obj, snap);
+    return _q_snapshot_finish(snap, (snap->num == cnt));
+}
+
+/**
+ * qtreetbl->restore(): Put all the objects of a snapshot file made by
+ * qtreetbl->dump() into this table.
+ *
+ * @param tbl       qtreetbl_t container pointer.
+ * @param filepath  snapshot file path
+ *
+ * @return the number of objects restored if successful, otherwise -1.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - EBADMSG : Not a qtreetbl snapshot, truncated or checksum mismatch.
+ *  - ENOMEM : Memory allocation failure.
+ *  - and errors of open() and mmap().
+ *
+ * @note
+ *  The whole file is validated before any object is put, so the table is
+ *  left untouched on a broken snapshot. When the table is empty and its
+ *  comparator agrees with the saved key order, the objects are loaded with
+ *  qtreetbl->bulkload() in O(n), otherwise they're inserted one by one.
+ */
+ssize_t qtreetbl_restore(qtreetbl_t *tbl, const char *filepath) {
+    _q_snapshot_t *snap = _q_snapshot_open(filepath, Q_SNAPSHOT_TREETBL);
+    if (snap == NULL) {
+        return -1;
+    }
+
+    ssize_t cnt = (ssize_t) snap->num;
+    if (qtreetbl_size(tbl) == 0) {
+        if (qtreetbl_bulkload(tbl, restore_obj, snap) == true) {
+            _q_snapshot_close(snap);
+            return cnt;
+        }
+        if (errno != EINVAL) {
+            int errnobak = errno;
+            _q_snapshot_close(snap);
+            errno = errnobak;
+            return -1;
+        }
+
+        // not in the order of this table, start over.
+        _q_snapshot_close(snap);
+        if ((snap = _q_snapshot_open(filepath, Q_SNAPSHOT_TREETBL)) == NULL) {
+            return -1;
+        }
+    }
+
+    uint32_t hash;
+    const void *name, *data;
+    size_t namesize, datasize;
+    while (_q_snapshot_read(snap, &hash, &name, &namesize, &data, &datasize)) {
+        if (qtreetbl_putobj(tbl, name, namesize, data, datasize) == false) {
+            cnt = -1;
+            break;
+        }
+    }
+
+    int errnobak = errno;
+    _q_snapshot_close(snap);
+    errno = errnobak;
+
+    return cnt;
+}
+
+/**
+ * qtreetbl->lock(): Enter critical section.
+ *
+ * @param tbl    qtreetbl_t container pointer.
+ *
+ * @note
+ *  From user side, normally locking operation is only needed when traverse
+ *  all elements using qtreetbl->getnext().
+ *
+ * @note
+ *  This operation will do nothing if QTREETBL_THREADSAFE option was not
+ *  given at the initialization time.
+ */
+void qtreetbl_lock(qtreetbl_t *tbl) {
+    Q_MUTEX_ENTER(tbl->qmutex);
+    Q_RWLOCK_WRLOCK(tbl->qrwlock);
+}
+
+/**
+ * qtreetbl->rdlock(): Enter critical section shared with other readers.
+ *
+ * @param tbl    qtreetbl_t container pointer.
+ *
+ * @code
+ *  qtreetbl_cursor_t cursor;
+ *  qtreetbl_obj_t obj;
+ *  tbl->rdlock(tbl);  // other threads can scan at the same time
+ *  tbl->cursor_seek(tbl, &cursor, NULL, 0, NULL, 0);
+ *  while (tbl->cursor_next(tbl, &cursor, &obj, false)) {
+ *      (...omit...)
+ *  }
+ *  tbl->unlock(tbl);
+ * @endcode
+ *
+ * @note
+ *  With QTREETBL_RWLOCK, get, find_min(), find_max(), cursor and range()
+ *  calls take the shared lock, while modifications, find_nearest() and
+ *  getnext() take the exclusive one since they write traversal marks into
+ *  the tree. The read-write lock is not recursive, so don't call a member
+ *  function which modifies the table while holding either lock. Without
+ *  QTREETBL_RWLOCK it's the same as lock().
+ */
+void qtreetbl_rdlock(qtreetbl_t *tbl) {
+    Q_MUTEX_ENTER(tbl->qmutex);
+    Q_RWLOCK_RDLOCK(tbl->qrwlock);
+}
+
+/**
+ * qtreetbl->unlock(): Leave critical section.
+ *
+ * @param tbl    qtreetbl_t container pointer.
+ *
+ * @note
+ *  This operation will do nothing if QTREETBL_THREADSAFE option was not
+ *  given at the initialization time.
+ */
+void qtreetbl_unlock(qtreetbl_t *tbl) {
+    Q_RWLOCK_UNLOCK(tbl->qrwlock);
+    Q_MUTEX_LEAVE(tbl->qmutex);
+}
+
+/**
+ * qtreetbl->free(): De-allocate the table.
+ *
+ * @param tbl    qtreetbl_t container pointer.
+ */
+void qtreetbl_free(qtreetbl_t *tbl) {
+    qtreetbl_clear(tbl);
+    Q_MUTEX_DESTROY(tbl->qmutex);
+    Q_RWLOCK_DESTROY(tbl->qrwlock);
+    free(tbl);
+}
+
+int qtreetbl_byte_cmp(const void *name1, size_t namesize1, const void *name2,
+                      size_t namesize2) {
+    size_t minsize = (namesize1 < namesize2) ? namesize1 : namesize2;
+    int cmp = memcmp(name1, name2, minsize);
+    if (cmp != 0 || namesize1 == namesize2) {
+        return cmp;
+    }
+    return (namesize1 < namesize2) ? -1 : +1;
+}
+
+/**
+ * Comparator for uint64_t keys in host byte order.
+ *
+ * This is the comparator of QTREETBL_KEY_UINT64 tables, where the
+ * comparison is done inline instead.
+ */
+int qtreetbl_uint64_cmp(const void *name1, size_t namesize1, const void *name2,
+                        size_t namesize2) {
+    uint64_t a, b;
+    memcpy(&a, name1, sizeof(a));
+    memcpy(&b, name2, sizeof(b));
+    return (a > b) - (a < b);
+}
+
+/**
+ * Comparator for int64_t keys in host byte order.
+ *
+ * This is the comparator of QTREETBL_KEY_INT64 tables, where the
+ * comparison is done inline instead.
+ */
+int qtreetbl_int64_cmp(const void *name1, size_t namesize1, const void *name2,
+                       size_t namesize2) {
+    int64_t a, b;
+    memcpy(&a, name1, sizeof(a));
+    memcpy(&b, name2, sizeof(b));
+    return (a > b) - (a < b);
+}
+
+/**
+ * qtreetbl->debug(): Print the internal tree structure in text.
+ *
+ * @param tbl    qtreetbl_t container pointer.
+ * @param out    output stream.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EIO : Invalid output stream.
+ *
+ * @code
+ * Example output:
+ *
+ *     ┌───9
+ *     │   └──[8]
+ * ┌───7
+ * │   │   ┌───6
+ * │   └──[5]
+ * │       └───4
+ * 3
+ * │   ┌───2
+ * └───1
+ *     └───0
+ * @endcode
+ * @note
+ *  Red nodes are wrapped in `[]`.
+ *  In this example, 5 and 8 are Red nodes.
+ */
+bool qtreetbl_debug(qtreetbl_t *tbl, FILE *out) {
+    if (out == NULL) {
+        errno = EIO;
+        return false;
+    }
+
+    qtreetbl_rdlock(tbl);
+    print_node(tbl->root, out, NULL, false);
+    bpt_print(tbl, (bpt_node_t *) tbl->broot, out, 0);
+    qtreetbl_unlock(tbl);
+    return true;
+}
+
+/**
+ * Verifies that root property of the red-black tree is satisfied.
+ *
+ * Root property: The root is black.
  *
  * @param tbl    qtreetbl_t container pointer.
  */
@@ -987,6 +1797,31 @@ int node_check_llrb(qtreetbl_t *tbl, qtreetbl_obj_t *obj) {
     return 0;
 }
 
+/**
+ * Verifies that the subtree counts used by select() and rank() are correct.
+ *
+ * @param tbl    qtreetbl_t container pointer.
+ * @param obj    qtreetbl_obj_t object pointer.
+ */
+int node_check_count(qtreetbl_t *tbl, qtreetbl_obj_t *obj) {
+    if (obj == NULL) {
+        return 0;
+    }
+
+    if (obj->count != count_of(obj->left) + count_of(obj->right) + 1) {
+        return 1;
+    }
+
+    if (node_check_count(tbl, obj->right)) {
+        return 1;
+    }
+    if (node_check_count(tbl, obj->left)) {
+        return 1;
+    }
+
+    return 0;
+}
+
 /**
  * Verifies that the invariants of the red-black tree are satisfied.
  *
@@ -995,6 +1830,11 @@ int node_check_llrb(qtreetbl_t *tbl, qtreetbl_obj_t *obj) {
  * Black property: For each node, all simple paths from the node to
  *                 descendant leaves contain the same number of black nodes.
  * LLRB property:  3-nodes always lean to the left and 4-nodes are balanced.
+ * Count property: Each node counts the objects in its subtree.
+ *
+ * With QTREETBL_BPTREE, it checks instead that keys are sorted within their
+ * separator bounds, every leaf is at the same depth and the number of
+ * objects matches.
  *
  * @param tbl    qtreetbl_t container pointer.
  */
@@ -1003,6 +1843,17 @@ int qtreetbl_check(qtreetbl_t *tbl) {
         return 0;
     }
 
+    if (tbl->bptree) {
+        if (tbl->broot == NULL) {
+            return (tbl->num == 0) ? 0 : 8;
+        }
+        int leafdepth = -1;
+        size_t num = 0;
+        int ret = bpt_check(tbl, (bpt_node_t *) tbl->broot, NULL, 0, NULL, 0,
+                            0, &leafdepth, &num);
+        return (ret != 0) ? ret : (num == tbl->num) ? 0 : 8;
+    }
+
     if (node_check_root(tbl)) {
         return 1;
     }
@@ -1016,6 +1867,9 @@ int qtreetbl_check(qtreetbl_t *tbl) {
     if (node_check_llrb(tbl, tbl->root)) {
         return 4;
     }
+    if (node_check_count(tbl, tbl->root)) {
+        return 5;
+    }
 
     return 0;
 }
@@ -1042,6 +1896,8 @@ static qtreetbl_obj_t *rotate_left(qtreetbl_obj_t *obj) {
     x->left = obj;
     x->red = x->left->red;
     x->left->red = true;
+    x->count = obj->count;
+    update_count(obj);
     _q_treetbl_rotate_left_cnt++;
     return x;
 }
@@ -1053,6 +1909,8 @@ static qtreetbl_obj_t *rotate_right(qtreetbl_obj_t *obj) {
     x->right = obj;
     x->red = x->right->red;
     x->right->red = true;
+    x->count = obj->count;
+    update_count(obj);
     _q_treetbl_rotate_right_cnt++;
     return x;
 }
@@ -1102,21 +1960,25 @@ static qtreetbl_obj_t *find_max(qtreetbl_obj_t *obj) {
     return obj;
 }
 
-static qtreetbl_obj_t *remove_min(qtreetbl_obj_t *obj) {
+static qtreetbl_obj_t *remove_min(qtreetbl_t *tbl, qtreetbl_obj_t *obj) {
     if (obj->left == NULL) {
         // 3-nodes are left-leaning, so this is a leaf.
-        free(obj->name);
-        free(obj->data);
+        Q_ARENA_FREE(tbl->arena, obj->name);
+        Q_ARENA_FREE(tbl->arena, obj->data);
+        Q_ARENA_FREE(tbl->arena, obj);
         return NULL;
     }
     if (!is_red(obj->left) && !is_red(obj->left->left)) {
         obj = move_red_left(obj);
     }
-    obj->left = remove_min(obj->left);
+    obj->left = remove_min(tbl, obj->left);
     return fix(obj);
 }
 
 static qtreetbl_obj_t *fix(qtreetbl_obj_t *obj) {
+    // a descendant was removed
+    update_count(obj);
+
     // rotate right red to left
     if (is_red(obj->right)) {
 #ifdef LLRB234
@@ -1140,16 +2002,55 @@ static qtreetbl_obj_t *fix(qtreetbl_obj_t *obj) {
     return obj;
 }
 
+static size_t count_of(qtreetbl_obj_t *obj) {
+    return (obj != NULL) ? obj->count : 0;
+}
+
+static void update_count(qtreetbl_obj_t *obj) {
+    obj->count = count_of(obj->left) + count_of(obj->right) + 1;
+}
+
+static inline int key_cmp(qtreetbl_t *tbl, const void *name1, size_t namesize1,
+                          const void *name2, size_t namesize2) {
+    switch (tbl->keytype) {
+        case QTREETBL_KEY_UINT64: {
+            uint64_t a, b;
+            memcpy(&a, name1, sizeof(a));
+            memcpy(&b, name2, sizeof(b));
+            return (a > b) - (a < b);
+        }
+        case QTREETBL_KEY_INT64: {
+            int64_t a, b;
+            memcpy(&a, name1, sizeof(a));
+            memcpy(&b, name2, sizeof(b));
+            return (a > b) - (a < b);
+        }
+        case QTREETBL_KEY_FIXED: {
+            return memcmp(name1, name2, namesize1);
+        }
+        default: {
+            return tbl->compare(name1, namesize1, name2, namesize2);
+        }
+    }
+}
+
+static bool valid_key(qtreetbl_t *tbl, const void *name, size_t namesize) {
+    if (name == NULL || namesize == 0) {
+        return false;
+    }
+    return (tbl->keysize == 0 || namesize == tbl->keysize);
+}
+
 static qtreetbl_obj_t *find_obj(qtreetbl_t *tbl, const void *name,
                                 size_t namesize) {
-    if (name == NULL || namesize == 0) {
+    if (valid_key(tbl, name, namesize) == false) {
         errno = EINVAL;
         return NULL;
     }
 
     qtreetbl_obj_t *obj;
     for (obj = tbl->root; obj != NULL;) {
-        int cmp = tbl->compare(name, namesize, obj->name, obj->namesize);
+        int cmp = key_cmp(tbl, name, namesize, obj->name, obj->namesize);
         if (cmp == 0) {
             return obj;
         }
@@ -1160,21 +2061,31 @@ static qtreetbl_obj_t *find_obj(qtreetbl_t *tbl, const void *name,
     return NULL;
 }
 
-static qtreetbl_obj_t *new_obj(bool red, const void *name, size_t namesize,
-                               const void *data, size_t datasize) {
-    qtreetbl_obj_t *obj = (qtreetbl_obj_t *) calloc(1, sizeof(qtreetbl_obj_t));
-    void *copyname = qmemdup(name, namesize);
-    void *copydata = qmemdup(data, datasize);
+static void *dup_mem(qtreetbl_t *tbl, const void *data, size_t size) {
+    if (tbl->arena != NULL) {
+        return qarena_memdup(tbl->arena, data, size);
+    }
+    return qmemdup(data, size);
+}
+
+static qtreetbl_obj_t *new_obj(qtreetbl_t *tbl, bool red, const void *name,
+                               size_t namesize, const void *data, size_t datasize) {
+    qtreetbl_obj_t *obj = (tbl->arena != NULL) ?
+            (qtreetbl_obj_t *) qarena_calloc(tbl->arena, sizeof(qtreetbl_obj_t)) :
+            (qtreetbl_obj_t *) calloc(1, sizeof(qtreetbl_obj_t));
+    void *copyname = dup_mem(tbl, name, namesize);
+    void *copydata = dup_mem(tbl, data, datasize);
 
     if (obj == NULL || copyname == NULL) {
         errno = ENOMEM;
-        free(obj);
-        free(copyname);
-        free(copydata);
+        Q_ARENA_FREE(tbl->arena, obj);
+        Q_ARENA_FREE(tbl->arena, copyname);
+        Q_ARENA_FREE(tbl->arena, copydata);
         return NULL;
     }
 
     obj->red = red;
+    obj->count = 1;
     obj->name = copyname;
     obj->namesize = namesize;
     obj->data = copydata;
@@ -1188,7 +2099,7 @@ static qtreetbl_obj_t *put_obj(qtreetbl_t *tbl, qtreetbl_obj_t *obj,
                                const void *data, size_t datasize) {
     if (obj == NULL) {
         tbl->num++;
-        return new_obj(true, name, namesize, data, datasize);
+        return new_obj(tbl, true, name, namesize, data, datasize);
     }
 
 #ifdef LLRB234
@@ -1198,11 +2109,11 @@ static qtreetbl_obj_t *put_obj(qtreetbl_t *tbl, qtreetbl_obj_t *obj,
     }
 #endif
 
-    int cmp = tbl->compare(name, namesize, obj->name, obj->namesize);
+    int cmp = key_cmp(tbl, name, namesize, obj->name, obj->namesize);
     if (cmp == 0) {  // existing key found
-        void *copydata = qmemdup(data, datasize);
+        void *copydata = dup_mem(tbl, data, datasize);
         if (copydata != NULL) {
-            free(obj->data);
+            Q_ARENA_FREE(tbl->arena, obj->data);
             obj->data = copydata;
             obj->datasize = datasize;
         }
@@ -1211,6 +2122,7 @@ static qtreetbl_obj_t *put_obj(qtreetbl_t *tbl, qtreetbl_obj_t *obj,
     } else {
         obj->right = put_obj(tbl, obj->right, name, namesize, data, datasize);
     }
+    update_count(obj);
 
     // fix right-leaning reds on the way up
     if (is_red(obj->right) && !is_red(obj->left)) {
@@ -1233,6 +2145,44 @@ static qtreetbl_obj_t *put_obj(qtreetbl_t *tbl, qtreetbl_obj_t *obj,
     return obj;
 }
 
+/*
+ * Links sorted objects into a left-leaning red-black tree of 2-3 nodes.
+ * The black height is fixed by cap, the maximum number of objects each child
+ * subtree can hold. A 3-node is a black node with a red left child.
+ */
+static qtreetbl_obj_t *build_tree(qtreetbl_obj_t **objs, size_t num,
+                                  size_t cap) {
+    if (num == 0) {
+        return NULL;
+    }
+
+    size_t subcap = (cap > 0) ? (cap + 1) / 3 - 1 : 0;
+    qtreetbl_obj_t *obj;
+    if (num - 1 <= cap * 2) {
+        // 2-node
+        size_t left = (num - 1) / 2;
+        obj = objs[left];
+        obj->left = build_tree(objs, left, subcap);
+        obj->right = build_tree(&objs[left + 1], num - 1 - left, subcap);
+    } else {
+        // 3-node
+        size_t a = (num - 2) / 3;
+        size_t b = (num - 2 - a) / 2;
+        size_t c = num - 2 - a - b;
+        qtreetbl_obj_t *red = objs[a];
+        red->red = true;
+        red->left = build_tree(objs, a, subcap);
+        red->right = build_tree(&objs[a + 1], b, subcap);
+        update_count(red);
+        obj = objs[a + 1 + b];
+        obj->left = red;
+        obj->right = build_tree(&objs[a + b + 2], c, subcap);
+    }
+    obj->red = false;
+    update_count(obj);
+    return obj;
+}
+
 static qtreetbl_obj_t *remove_obj(qtreetbl_t *tbl, qtreetbl_obj_t *obj,
                                   const void *name, size_t namesize) {
     if (obj == NULL) {
@@ -1240,7 +2190,7 @@ static qtreetbl_obj_t *remove_obj(qtreetbl_t *tbl, qtreetbl_obj_t *obj,
         return NULL;
     }
 
-    int cmp = tbl->compare(name, namesize, obj->name, obj->namesize);
+    int cmp = key_cmp(tbl, name, namesize, obj->name, obj->namesize);
     if (cmp < 0) {
         // move red left
         if (obj->left != NULL
@@ -1258,13 +2208,13 @@ static qtreetbl_obj_t *remove_obj(qtreetbl_t *tbl, qtreetbl_obj_t *obj,
         // remove if equal at the bottom
         if (obj->right == NULL) {
             if (recmp) {
-                cmp = tbl->compare(name, namesize, obj->name, obj->namesize);
+                cmp = key_cmp(tbl, name, namesize, obj->name, obj->namesize);
                 recmp = false;
             }
             if (cmp == 0) {
-                free(obj->name);
-                free(obj->data);
-                free(obj);
+                Q_ARENA_FREE(tbl->arena, obj->name);
+                Q_ARENA_FREE(tbl->arena, obj->data);
+                Q_ARENA_FREE(tbl->arena, obj);
                 tbl->num--;
                 return NULL;
             }
@@ -1277,19 +2227,19 @@ static qtreetbl_obj_t *remove_obj(qtreetbl_t *tbl, qtreetbl_obj_t *obj,
         }
         // found in the middle
         if (recmp) {
-            cmp = tbl->compare(name, namesize, obj->name, obj->namesize);
+            cmp = key_cmp(tbl, name, namesize, obj->name, obj->namesize);
         }
         if (cmp == 0) {
             // copy min to this then remove min
             qtreetbl_obj_t *minobj = find_min(obj->right);
             assert(minobj != NULL);
-            free(obj->name);
-            free(obj->data);
-            obj->name = qmemdup(minobj->name, minobj->namesize);
+            Q_ARENA_FREE(tbl->arena, obj->name);
+            Q_ARENA_FREE(tbl->arena, obj->data);
+            obj->name = dup_mem(tbl, minobj->name, minobj->namesize);
             obj->namesize = minobj->namesize;
-            obj->data = qmemdup(minobj->data, minobj->datasize);
+            obj->data = dup_mem(tbl, minobj->data, minobj->datasize);
             obj->datasize = minobj->datasize;
-            obj->right = remove_min(obj->right);
+            obj->right = remove_min(tbl, obj->right);
             tbl->num--;
         } else {
             // keep going down to the right
@@ -1300,13 +2250,13 @@ static qtreetbl_obj_t *remove_obj(qtreetbl_t *tbl, qtreetbl_obj_t *obj,
     return fix(obj);
 }
 
-static void free_objs(qtreetbl_obj_t *obj) {
+static void free_objs(qtreetbl_t *tbl, qtreetbl_obj_t *obj) {
     if (obj == NULL) {
         return;
     }
 
-    free_objs(obj->left);
-    free_objs(obj->right);
+    free_objs(tbl, obj->left);
+    free_objs(tbl, obj->right);
 
     free(obj->name);
     free(obj->data);
@@ -1320,6 +2270,520 @@ static uint8_t reset_iterator(qtreetbl_t *tbl) {
     return (++tbl->tid);
 }
 
+static qtreetbl_obj_t *cursor_pop(qtreetbl_t *tbl, qtreetbl_cursor_t *cursor) {
+    if (tbl->bptree) {
+        bpt_node_t *leaf = (bpt_node_t *) cursor->leaf;
+        if (leaf == NULL) {
+            return NULL;
+        }
+        qtreetbl_obj_t *obj = &leaf->objs[cursor->slot];
+        if (cursor->hi != NULL
+            && key_cmp(tbl, obj->name, obj->namesize, cursor->hi, cursor->hisize) > 0) {
+            cursor->leaf = NULL;
+            return NULL;
+        }
+        if (++cursor->slot == leaf->num) {
+            cursor->leaf = leaf->next;
+            cursor->slot = 0;
+        }
+        return obj;
+    }
+
+    if (cursor->depth == 0) {
+        return NULL;
+    }
+
+    qtreetbl_obj_t *obj = cursor->stack[--cursor->depth];
+    if (cursor->hi != NULL
+        && key_cmp(tbl, obj->name, obj->namesize, cursor->hi, cursor->hisize) > 0) {
+        cursor->depth = 0;
+        return NULL;
+    }
+
+    // the successors of obj are the leftmost path of its right subtree
+    qtreetbl_obj_t *next;
+    for (next = obj->right; next != NULL; next = next->left) {
+        cursor->stack[cursor->depth++] = next;
+    }
+    return obj;
+}
+
+// qtreetbl->range() callback of qtreetbl->dump().
+static bool dump_obj(const qtreetbl_obj_t *obj, void *userdata) {
+    return _q_snapshot_write((_q_snapshot_t *) userdata, 0, obj->name,
+                             obj->namesize, obj->data, obj->datasize);
+}
+
+// qtreetbl->bulkload() iterator of qtreetbl->restore().
+static bool restore_obj(void *userdata, qtreetbl_obj_t *obj) {
+    uint32_t hash;
+    const void *name, *data;
+    if (_q_snapshot_read((_q_snapshot_t *) userdata, &hash, &name,
+                         &obj->namesize, &data, &obj->datasize) == false) {
+        return false;
+    }
+    obj->name = (void *) name;
+    obj->data = (void *) data;
+    return true;
+}
+
+/*
+ * B+tree engine
+ *
+ * The objects are kept sorted in the leaves, which are doubly linked in key
+ * order. Inner nodes hold their own copies of the separator keys, child[i]
+ * holds the keys k such that key[i-1] <= k < key[i]. A node is removed when
+ * it gets empty instead of being merged with its siblings, which keeps the
+ * search paths valid and the tree never gets deeper by removals.
+ */
+static bpt_node_t *bpt_new_node(qtreetbl_t *tbl, bool leaf) {
+    bpt_node_t *node = (tbl->arena != NULL) ?
+            (bpt_node_t *) qarena_calloc(tbl->arena, sizeof(bpt_node_t)) :
+            (bpt_node_t *) calloc(1, sizeof(bpt_node_t));
+    if (node == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    node->leaf = leaf;
+    return node;
+}
+
+static int bpt_lower(qtreetbl_t *tbl, bpt_node_t *leaf, const void *name,
+                     size_t namesize) {
+    int low = 0, high = leaf->num;
+    while (low < high) {
+        int mid = (low + high) / 2;
+        if (key_cmp(tbl, leaf->objs[mid].name, leaf->objs[mid].namesize,
+                         name, namesize) < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+static int bpt_child(qtreetbl_t *tbl, bpt_node_t *node, const void *name,
+                     size_t namesize) {
+    int low = 0, high = node->num;
+    while (low < high) {
+        int mid = (low + high) / 2;
+        if (key_cmp(tbl, name, namesize, node->names[mid],
+                         node->namesizes[mid]) >= 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+static bpt_node_t *bpt_find_leaf(qtreetbl_t *tbl, const void *name,
+                                 size_t namesize) {
+    bpt_node_t *node = (bpt_node_t *) tbl->broot;
+    while (node != NULL && node->leaf == false) {
+        node = node->children[bpt_child(tbl, node, name, namesize)];
+    }
+    return node;
+}
+
+static bpt_node_t *bpt_edge_leaf(qtreetbl_t *tbl, bool last) {
+    bpt_node_t *node = (bpt_node_t *) tbl->broot;
+    while (node != NULL && node->leaf == false) {
+        node = node->children[(last) ? node->num : 0];
+    }
+    return node;
+}
+
+static bpt_node_t *bpt_seek(qtreetbl_t *tbl, const void *name, size_t namesize,
+                            int *slot) {
+    if (name == NULL) {
+        *slot = 0;
+        return bpt_edge_leaf(tbl, false);
+    }
+
+    bpt_node_t *leaf = bpt_find_leaf(tbl, name, namesize);
+    if (leaf == NULL) {
+        return NULL;
+    }
+    *slot = bpt_lower(tbl, leaf, name, namesize);
+    if (*slot == leaf->num) {
+        // every key in this leaf is smaller, the next one starts bigger
+        leaf = leaf->next;
+        *slot = 0;
+    }
+    return leaf;
+}
+
+static qtreetbl_obj_t *bpt_find(qtreetbl_t *tbl, const void *name,
+                                size_t namesize) {
+    int slot;
+    bpt_node_t *leaf = bpt_seek(tbl, name, namesize, &slot);
+    if (leaf == NULL
+        || key_cmp(tbl, leaf->objs[slot].name, leaf->objs[slot].namesize,
+                        name, namesize) != 0) {
+        errno = ENOENT;
+        return NULL;
+    }
+    return &leaf->objs[slot];
+}
+
+static int bpt_insert(qtreetbl_t *tbl, bpt_node_t *node, const void *name,
+                      size_t namesize, const void *data, size_t datasize,
+                      bpt_node_t **right, void **sepname, size_t *sepsize) {
+    if (node->leaf == false) {
+        // get the node to split into ready before going down, so a failure
+        // doesn't leave a split child behind
+        bpt_node_t *spare = NULL;
+        if (node->num == BPT_ORDER && (spare = bpt_new_node(tbl, false)) == NULL) {
+            return -1;
+        }
+
+        int c = bpt_child(tbl, node, name, namesize);
+        bpt_node_t *cright;
+        void *cname;
+        size_t csize;
+        int ret = bpt_insert(tbl, node->children[c], name, namesize, data,
+                             datasize, &cright, &cname, &csize);
+        if (ret != 1) {
+            Q_ARENA_FREE(tbl->arena, spare);
+            return ret;
+        }
+
+        // put the separator at c and the new child at c + 1
+        void *names[BPT_ORDER + 1];
+        size_t namesizes[BPT_ORDER + 1];
+        bpt_node_t *children[BPT_ORDER + 2];
+        int i, num = node->num + 1;
+        for (i = 0; i < c; i++) {
+            names[i] = node->names[i];
+            namesizes[i] = node->namesizes[i];
+        }
+        names[c] = cname;
+        namesizes[c] = csize;
+        for (i = c; i < node->num; i++) {
+            names[i + 1] = node->names[i];
+            namesizes[i + 1] = node->namesizes[i];
+        }
+        for (i = 0; i <= c; i++) {
+            children[i] = node->children[i];
+        }
+        children[c + 1] = cright;
+        for (i = c + 1; i <= node->num; i++) {
+            children[i + 1] = node->children[i];
+        }
+
+        if (num <= BPT_ORDER) {
+            memcpy(node->names, names, sizeof(void *) * num);
+            memcpy(node->namesizes, namesizes, sizeof(size_t) * num);
+            memcpy(node->children, children, sizeof(bpt_node_t *) * (num + 1));
+            node->num = num;
+            return 0;
+        }
+
+        // split, the middle key moves up
+        int mid = num / 2;
+        node->num = mid;
+        memcpy(node->names, names, sizeof(void *) * mid);
+        memcpy(node->namesizes, namesizes, sizeof(size_t) * mid);
+        memcpy(node->children, children, sizeof(bpt_node_t *) * (mid + 1));
+        spare->num = num - mid - 1;
+        memcpy(spare->names, &names[mid + 1], sizeof(void *) * spare->num);
+        memcpy(spare->namesizes, &namesizes[mid + 1], sizeof(size_t) * spare->num);
+        memcpy(spare->children, &children[mid + 1],
+               sizeof(bpt_node_t *) * (spare->num + 1));
+        *right = spare;
+        *sepname = names[mid];
+        *sepsize = namesizes[mid];
+        return 1;
+    }
+
+    int slot = bpt_lower(tbl, node, name, namesize);
+    if (slot < node->num
+        && key_cmp(tbl, node->objs[slot].name, node->objs[slot].namesize,
+                        name, namesize) == 0) {
+        // existing key found
+        void *copydata = dup_mem(tbl, data, datasize);
+        if (copydata == NULL && datasize > 0) {
+            errno = ENOMEM;
+            return -1;
+        }
+        Q_ARENA_FREE(tbl->arena, node->objs[slot].data);
+        node->objs[slot].data = copydata;
+        node->objs[slot].datasize = datasize;
+        return 0;
+    }
+
+    qtreetbl_obj_t obj;
+    memset((void *) &obj, 0, sizeof(obj));
+    obj.name = dup_mem(tbl, name, namesize);
+    obj.namesize = namesize;
+    obj.data = dup_mem(tbl, data, datasize);
+    obj.datasize = datasize;
+    if (obj.name == NULL || (obj.data == NULL && datasize > 0)) {
+        Q_ARENA_FREE(tbl->arena, obj.name);
+        Q_ARENA_FREE(tbl->arena, obj.data);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    if (node->num < BPT_ORDER) {
+        memmove(&node->objs[slot + 1], &node->objs[slot],
+                sizeof(qtreetbl_obj_t) * (node->num - slot));
+        node->objs[slot] = obj;
+        node->num++;
+        tbl->num++;
+        return 0;
+    }
+
+    // split the leaf in half
+    qtreetbl_obj_t objs[BPT_ORDER + 1];
+    memcpy(objs, node->objs, sizeof(qtreetbl_obj_t) * slot);
+    objs[slot] = obj;
+    memcpy(&objs[slot + 1], &node->objs[slot],
+           sizeof(qtreetbl_obj_t) * (BPT_ORDER - slot));
+    int mid = (BPT_ORDER + 1) / 2;
+
+    bpt_node_t *leaf = bpt_new_node(tbl, true);
+    void *sep = dup_mem(tbl, objs[mid].name, objs[mid].namesize);
+    if (leaf == NULL || sep == NULL) {
+        Q_ARENA_FREE(tbl->arena, leaf);
+        Q_ARENA_FREE(tbl->arena, sep);
+        Q_ARENA_FREE(tbl->arena, obj.name);
+        Q_ARENA_FREE(tbl->arena, obj.data);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    node->num = mid;
+    memcpy(node->objs, objs, sizeof(qtreetbl_obj_t) * mid);
+    leaf->num = BPT_ORDER + 1 - mid;
+    memcpy(leaf->objs, &objs[mid], sizeof(qtreetbl_obj_t) * leaf->num);
+    leaf->prev = node;
+    leaf->next = node->next;
+    if (node->next != NULL) {
+        node->next->prev = leaf;
+    }
+    node->next = leaf;
+    tbl->num++;
+
+    *right = leaf;
+    *sepname = sep;
+    *sepsize = objs[mid].namesize;
+    return 1;
+}
+
+static bool bpt_put(qtreetbl_t *tbl, const void *name, size_t namesize,
+                    const void *data, size_t datasize) {
+    if (tbl->broot == NULL && (tbl->broot = bpt_new_node(tbl, true)) == NULL) {
+        return false;
+    }
+
+    // a full root may split, get the new root ready beforehand
+    bpt_node_t *root = (bpt_node_t *) tbl->broot;
+    bpt_node_t *spare = NULL;
+    if (root->num == BPT_ORDER && (spare = bpt_new_node(tbl, false)) == NULL) {
+        return false;
+    }
+
+    bpt_node_t *right;
+    void *sepname;
+    size_t sepsize;
+    int ret = bpt_insert(tbl, root, name, namesize, data, datasize, &right,
+                         &sepname, &sepsize);
+    if (ret == 1) {
+        spare->num = 1;
+        spare->names[0] = sepname;
+        spare->namesizes[0] = sepsize;
+        spare->children[0] = root;
+        spare->children[1] = right;
+        tbl->broot = spare;
+    } else {
+        Q_ARENA_FREE(tbl->arena, spare);
+        if (root->num == 0) {
+            Q_ARENA_FREE(tbl->arena, root);
+            tbl->broot = NULL;
+        }
+    }
+    return (ret >= 0);
+}
+
+static bool bpt_delete(qtreetbl_t *tbl, bpt_node_t *node, const void *name,
+                       size_t namesize) {
+    if (node->leaf == false) {
+        int c = bpt_child(tbl, node, name, namesize);
+        bpt_node_t *child = node->children[c];
+        if (bpt_delete(tbl, child, name, namesize) == false) {
+            return false;
+        }
+
+        // drop the empty child with one of the separators around it
+        Q_ARENA_FREE(tbl->arena, child);
+        if (node->num == 0) {
+            return true;
+        }
+        int k = (c > 0) ? c - 1 : 0;
+        Q_ARENA_FREE(tbl->arena, node->names[k]);
+        memmove(&node->names[k], &node->names[k + 1],
+                sizeof(void *) * (node->num - k - 1));
+        memmove(&node->namesizes[k], &node->namesizes[k + 1],
+                sizeof(size_t) * (node->num - k - 1));
+        memmove(&node->children[c], &node->children[c + 1],
+                sizeof(bpt_node_t *) * (node->num - c));
+        node->num--;
+        return false;
+    }
+
+    int slot = bpt_lower(tbl, node, name, namesize);
+    if (slot >= node->num
+        || key_cmp(tbl, node->objs[slot].name, node->objs[slot].namesize,
+                        name, namesize) != 0) {
+        errno = ENOENT;
+        return false;
+    }
+
+    Q_ARENA_FREE(tbl->arena, node->objs[slot].name);
+    Q_ARENA_FREE(tbl->arena, node->objs[slot].data);
+    memmove(&node->objs[slot], &node->objs[slot + 1],
+            sizeof(qtreetbl_obj_t) * (node->num - slot - 1));
+    node->num--;
+    tbl->num--;
+    if (node->num > 0) {
+        return false;
+    }
+
+    // unlink the empty leaf
+    if (node->prev != NULL) {
+        node->prev->next = node->next;
+    }
+    if (node->next != NULL) {
+        node->next->prev = node->prev;
+    }
+    return true;
+}
+
+static bool bpt_remove(qtreetbl_t *tbl, const void *name, size_t namesize) {
+    bpt_node_t *root = (bpt_node_t *) tbl->broot;
+    if (root == NULL) {
+        errno = ENOENT;
+        return false;
+    }
+
+    errno = 0;
+    if (bpt_delete(tbl, root, name, namesize) == true) {
+        Q_ARENA_FREE(tbl->arena, root);
+        tbl->broot = NULL;
+        return true;
+    }
+    if (errno == ENOENT) {
+        return false;
+    }
+
+    // shrink the root with a single child
+    while (root->leaf == false && root->num == 0) {
+        tbl->broot = root->children[0];
+        Q_ARENA_FREE(tbl->arena, root);
+        root = (bpt_node_t *) tbl->broot;
+    }
+    return true;
+}
+
+static void bpt_free(qtreetbl_t *tbl, bpt_node_t *node) {
+    if (node == NULL) {
+        return;
+    }
+
+    int i;
+    if (node->leaf == true) {
+        for (i = 0; i < node->num; i++) {
+            free(node->objs[i].name);
+            free(node->objs[i].data);
+        }
+    } else {
+        for (i = 0; i <= node->num; i++) {
+            bpt_free(tbl, node->children[i]);
+        }
+        for (i = 0; i < node->num; i++) {
+            free(node->names[i]);
+        }
+    }
+    free(node);
+}
+
+static void bpt_print(qtreetbl_t *tbl, bpt_node_t *node, FILE *out, int depth) {
+    if (node == NULL) {
+        return;
+    }
+
+    int i;
+    fprintf(out, "%*s%s", depth * 4, "", (node->leaf) ? "(" : "[");
+    for (i = 0; i < node->num; i++) {
+        if (i > 0) {
+            fprintf(out, " ");
+        }
+        if (node->leaf) {
+            _q_textout(out, node->objs[i].name, node->objs[i].namesize,
+                       MAX_HUMANOUT);
+        } else {
+            _q_textout(out, node->names[i], node->namesizes[i], MAX_HUMANOUT);
+        }
+    }
+    fprintf(out, "%s\n", (node->leaf) ? ")" : "]");
+
+    if (node->leaf == false) {
+        for (i = 0; i <= node->num; i++) {
+            bpt_print(tbl, node->children[i], out, depth + 1);
+        }
+    }
+}
+
+static int bpt_check(qtreetbl_t *tbl, bpt_node_t *node, const void *lo,
+                     size_t losize, const void *hi, size_t hisize, int depth,
+                     int *leafdepth, size_t *num) {
+    int i;
+    if (node->leaf == true) {
+        if (node->num == 0) {
+            return 5;
+        }
+        if (*leafdepth < 0) {
+            *leafdepth = depth;
+        } else if (*leafdepth != depth) {
+            return 6;
+        }
+        for (i = 0; i < node->num; i++) {
+            const qtreetbl_obj_t *obj = &node->objs[i];
+            if ((i > 0 && key_cmp(tbl, node->objs[i - 1].name,
+                                       node->objs[i - 1].namesize,
+                                       obj->name, obj->namesize) >= 0)
+                || (lo && key_cmp(tbl, obj->name, obj->namesize, lo, losize) < 0)
+                || (hi && key_cmp(tbl, obj->name, obj->namesize, hi, hisize) >= 0)) {
+                return 7;
+            }
+        }
+        *num += node->num;
+        return 0;
+    }
+
+    for (i = 1; i < node->num; i++) {
+        if (key_cmp(tbl, node->names[i - 1], node->namesizes[i - 1],
+                         node->names[i], node->namesizes[i]) >= 0) {
+            return 7;
+        }
+    }
+    for (i = 0; i <= node->num; i++) {
+        int ret = bpt_check(tbl, node->children[i],
+                            (i > 0) ? node->names[i - 1] : lo,
+                            (i > 0) ? node->namesizes[i - 1] : losize,
+                            (i < node->num) ? node->names[i] : hi,
+                            (i < node->num) ? node->namesizes[i] : hisize,
+                            depth + 1, leafdepth, num);
+        if (ret != 0) {
+            return ret;
+        }
+    }
+    return 0;
+}
+
 static void print_branch(struct branch_obj_s *branch, FILE *out) {
     if (branch == NULL) {
         return;
@@ -82,12 +82,34 @@
 #include <errno.h>
 #include <stdbool.h>
 #include "qinternal.h"
+#include "utilities/qthreadpool.h"
 #include "containers/qvector.h"
 
+#define PARALLEL_SORT_MIN   (8192)  /* sorted in a thread if smaller */
+
 #ifndef _DOXGEN_SKIP
 
 static void *get_at(qvector_t *vector, int index, bool newmem);
 static bool remove_at(qvector_t *vector, int index);
+static void *elem_at(qvector_t *vector, size_t index);
+static void move_elem(qvector_t *vector, size_t dst, size_t src);
+static bool grow_to(qvector_t *vector, size_t need);
+
+typedef struct qvector_parallel_s qvector_parallel_t;
+struct qvector_parallel_s {
+    unsigned char *data;
+    unsigned char *tmp;
+    size_t objsize;
+    size_t num;
+    size_t width;
+    int (*cmp)(const void *data1, const void *data2);
+    void (*func)(void *data, size_t index, void *userdata);
+    void *userdata;
+};
+
+static void foreach_range(size_t begin, size_t end, void *userdata);
+static void sort_range(size_t begin, size_t end, void *userdata);
+static void merge_range(size_t begin, size_t end, void *userdata);
 
 #endif
 
@@ -113,6 +135,9 @@ static bool remove_at(qvector_t *vector, int index);
  *  - QVECTOR_RESIZE_DOUBLE - double the size when vector is full
  *  - QVECTOR_RESIZE_LINEAR - add the size with initial num when vector is full
  *  - QVECTOR_RESIZE_EXACT - add up as much as needed
+ *  - QVECTOR_CIRCULAR - keep the elements in a ring buffer, so adding and
+ *    removing at both ends take constant time. Insertion and removal in the
+ *    middle shift the shorter side.
  */
 qvector_t *qvector(size_t max, size_t objsize, int options) {
     if (objsize == 0) {
@@ -168,11 +193,15 @@ qvector_t *qvector(size_t max, size_t objsize, int options) {
     } else {
         vector->options |= QVECTOR_RESIZE_EXACT;
     }
+    if (options & QVECTOR_CIRCULAR) {
+        vector->options |= QVECTOR_CIRCULAR;
+    }
 
     //member methods
     vector->addfirst = qvector_addfirst;
     vector->addlast = qvector_addlast;
     vector->addat = qvector_addat;
+    vector->addarray = qvector_addarray;
 
     vector->getfirst = qvector_getfirst;
     vector->getlast = qvector_getlast;
@@ -192,6 +221,8 @@ qvector_t *qvector(size_t max, size_t objsize, int options) {
 
     vector->size = qvector_size;
     vector->resize = qvector_resize;
+    vector->reserve = qvector_reserve;
+    vector->set_arena = qvector_set_arena;
 
     vector->toarray = qvector_toarray;
 
@@ -203,6 +234,8 @@ qvector_t *qvector(size_t max, size_t objsize, int options) {
     vector->free = qvector_free;
 
     vector->reverse = qvector_reverse;
+    vector->sort = qvector_sort;
+    vector->bsearch = qvector_bsearch;
     vector->getnext = qvector_getnext;
 
     return vector;
@@ -330,16 +363,21 @@ bool qvector_addat(qvector_t *vector, int index, const void *data) {
         }
     }
 
-    //shift data from index...(num - 1)  to index + 1...num
     int i;
-    for (i = vector->num; i > index; i--) {
-        void *dst = (unsigned char *)vector->data + vector->objsize * i;
-        void *src = (unsigned char *)vector->data + vector->objsize * (i - 1);
-
-        memcpy(dst, src, vector->objsize);
+    if ((vector->options & QVECTOR_CIRCULAR) && index < vector->num / 2) {
+        //step the head back and shift data from 0...(index - 1) to -1...(index - 2)
+        vector->head = (vector->head == 0) ? vector->max - 1 : vector->head - 1;
+        for (i = 0; i < index; i++) {
+            move_elem(vector, i, i + 1);
+        }
+    } else {
+        //shift data from index...(num - 1)  to index + 1...num
+        for (i = vector->num; i > index; i--) {
+            move_elem(vector, i, i - 1);
+        }
     }
 
-    void *add = (unsigned char *)vector->data + index * vector->objsize;
+    void *add = elem_at(vector, index);
     memcpy(add, data, vector->objsize);
     vector->num++;
 
@@ -347,6 +385,64 @@ bool qvector_addat(qvector_t *vector, int index, const void *data) {
     return true;
 }
 
+/**
+ * qvector->addarray(): Appends an array of elements at the end of this
+ * vector.
+ *
+ * @param vector    qvector_t container pointer.
+ * @param data      a pointer of the array of elements
+ * @param n         the number of elements in the array
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *
+ * - EINVAL  : Invalid argument.
+ * - ENOMEM  : Memory allocation failure.
+ *
+ * @code
+ *  struct my_obj objs[1000];
+ *  vector->addarray(vector, objs, 1000);
+ * @endcode
+ *
+ * @note
+ *  The vector is resized at most once and the elements are copied in bulk.
+ */
+bool qvector_addarray(qvector_t *vector, const void *data, size_t n) {
+    if (data == NULL && n > 0) {
+        errno = EINVAL;
+        return false;
+    }
+    if (n == 0) {
+        return true;
+    }
+
+    vector->lock(vector);
+
+    if (grow_to(vector, vector->num + n) == false) {
+        vector->unlock(vector);
+        errno = ENOMEM;
+        return false;
+    }
+
+    //copy up to the end of the buffer, then the rest from the beginning
+    size_t pos = vector->head + vector->num;
+    if (pos >= vector->max) {
+        pos -= vector->max;
+    }
+    size_t first = vector->max - pos;
+    if (first > n) {
+        first = n;
+    }
+    memcpy((unsigned char *)vector->data + pos * vector->objsize, data,
+           first * vector->objsize);
+    memcpy(vector->data, (const unsigned char *)data + first * vector->objsize,
+           (n - first) * vector->objsize);
+    vector->num += n;
+
+    vector->unlock(vector);
+    return true;
+}
+
 /**
  * qvector->getfirst(): Returns the first element in this vector.
  *
@@ -675,6 +771,7 @@ void qvector_unlock(qvector_t *vector) {
 void qvector_clear(qvector_t *vector) {
     vector->lock(vector);
     vector->num = 0;
+    vector->head = 0;
     vector->unlock(vector);
 }
 
@@ -688,7 +785,7 @@ void qvector_free(qvector_t *vector) {
     Q_MUTEX_DESTROY(vector->qmutex);
 
     if (vector->data != NULL) {
-        free(vector->data);
+        Q_ARENA_FREE(vector->arena, vector->data);
     }
 
     free(vector);
@@ -713,7 +810,7 @@ bool qvector_debug(qvector_t *vector, FILE *out) {
     vector->lock(vector);
     int i;
     for (i = 0; i < vector->num; i++) {
-        void *data = (unsigned char  *)vector->data + i * vector->objsize;
+        void *data = elem_at(vector, i);
         fprintf(out, "%d=", i);
         _q_textout(out, data, vector->objsize, MAX_HUMANOUT);
         fprintf(out, " (%zu)\n", vector->objsize);
@@ -747,17 +844,36 @@ bool qvector_resize(qvector_t *vector, size_t newmax) {
     vector->lock(vector);
 
     if (newmax == 0) {
-        free(vector->data);
+        Q_ARENA_FREE(vector->arena, vector->data);
         vector->data = NULL;
         vector->max = 0;
         vector->num = 0;
+        vector->head = 0;
         vector->objsize = 0;
 
         vector->unlock(vector);
         return true;
     }
 
-    void *newdata = realloc(vector->data, newmax * vector->objsize);
+    void *newdata;
+    if (vector->arena != NULL || vector->head != 0) {
+        // arena memory can't be resized in place and a ring buffer has to be
+        // unrolled, move the elements over
+        newdata = Q_ARENA_MALLOC(vector->arena, newmax * vector->objsize);
+        if (newdata != NULL && vector->data != NULL) {
+            size_t num = (vector->num < newmax) ? vector->num : newmax;
+            size_t first = vector->max - vector->head;
+            if (first > num) {
+                first = num;
+            }
+            memcpy(newdata, elem_at(vector, 0), first * vector->objsize);
+            memcpy((unsigned char *)newdata + first * vector->objsize,
+                   vector->data, (num - first) * vector->objsize);
+            Q_ARENA_FREE(vector->arena, vector->data);
+        }
+    } else {
+        newdata = realloc(vector->data, newmax * vector->objsize);
+    }
     if (newdata == NULL) {
         errno = ENOMEM;
         vector->unlock(vector);
@@ -765,6 +881,7 @@ bool qvector_resize(qvector_t *vector, size_t newmax) {
     }
 
     vector->data = newdata;
+    vector->head = 0;
     vector->max = newmax;
     if (vector->num > newmax) {
         vector->num = newmax;
@@ -774,6 +891,80 @@ bool qvector_resize(qvector_t *vector, size_t newmax) {
     return true;
 }
 
+/**
+ * qvector->reserve(): Makes sure the vector can hold the given number of
+ * elements without resizing.
+ *
+ * @param vector    qvector_t container pointer.
+ * @param n         the number of elements to make room for.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @code
+ *  qvector_t *vector = qvector(0, sizeof(struct my_obj), 0);
+ *  vector->reserve(vector, 1000000);
+ * @endcode
+ *
+ * @note
+ *  Unlike resize(), it never shrinks the vector.
+ */
+bool qvector_reserve(qvector_t *vector, size_t n) {
+    vector->lock(vector);
+    bool ret = true;
+    if (n > vector->max) {
+        ret = vector->resize(vector, n);
+    }
+    vector->unlock(vector);
+    return ret;
+}
+
+/**
+ * qvector->set_arena(): Take the element buffer from an arena allocator.
+ *
+ * @param vector    qvector_t container pointer.
+ * @param arena     qarena_t container pointer, NULL to use the heap again.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EBUSY  : The vector is not empty.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @note
+ *  The preallocated buffer is moved to the arena. Buffers outgrown by
+ *  resizing are left to the arena, so the arena should be reset or freed
+ *  only after the vector.
+ */
+bool qvector_set_arena(qvector_t *vector, qarena_t *arena) {
+    vector->lock(vector);
+    if (vector->num > 0) {
+        vector->unlock(vector);
+        errno = EBUSY;
+        return false;
+    }
+
+    void *newdata = NULL;
+    if (vector->max > 0) {
+        size_t bufsize = vector->max * vector->objsize;
+        newdata = (arena != NULL) ? qarena_alloc(arena, bufsize) : malloc(bufsize);
+        if (newdata == NULL) {
+            vector->unlock(vector);
+            errno = ENOMEM;
+            return false;
+        }
+    }
+    if (vector->data != NULL) {
+        Q_ARENA_FREE(vector->arena, vector->data);
+    }
+    vector->data = newdata;
+    vector->head = 0;
+    vector->arena = arena;
+
+    vector->unlock(vector);
+    return true;
+}
+
 /**
  * qvector->toarray(): Returns an array contains all the elements in this vector.
  * @param vector    qvector_t container pointer.
@@ -802,7 +993,13 @@ void *qvector_toarray(qvector_t *vector, size_t *size) {
         return NULL;
     }
 
-    memcpy(array, vector->data, vector->num * vector->objsize);
+    size_t first = vector->max - vector->head;
+    if (first > vector->num) {
+        first = vector->num;
+    }
+    memcpy(array, elem_at(vector, 0), first * vector->objsize);
+    memcpy((unsigned char *)array + first * vector->objsize, vector->data,
+           (vector->num - first) * vector->objsize);
 
     if (size != NULL) {
         *size = vector->num;
@@ -812,6 +1009,119 @@ void *qvector_toarray(qvector_t *vector, size_t *size) {
     return array;
 }
 
+/**
+ * qvector_data(): Returns the buffer holding the elements of this vector
+ * for direct access.
+ *
+ * @param vector    qvector_t container pointer.
+ * @param num       if num is not NULL, the number of elements will be stored.
+ *
+ * @return the pointer of the first element, otherwise returns NULL.
+ * @retval errno will be set in error condition.
+ *  - ENOENT : Vector is empty.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @code
+ *  vector->lock(vector);
+ *  size_t i, num;
+ *  struct my_obj *objs = qvector_data(vector, &num);
+ *  for (i = 0; i < num; i++) {
+ *      (...omit...)
+ *  }
+ *  vector->unlock(vector);
+ * @endcode
+ *
+ * @note
+ *  Nothing is copied. The elements are laid out contiguously and the buffer
+ *  can be read and written in place, so hold the lock while using it on a
+ *  thread-safe vector. The pointer is valid until the next modification. A
+ *  wrapped circular vector is unrolled first. There is no member function
+ *  for this since the buffer itself is vector->data.
+ */
+void *qvector_data(qvector_t *vector, size_t *num) {
+    vector->lock(vector);
+
+    if (num != NULL) {
+        *num = vector->num;
+    }
+    if (vector->num == 0) {
+        vector->unlock(vector);
+        errno = ENOENT;
+        return NULL;
+    }
+    if (vector->head != 0 && vector->resize(vector, vector->max) == false) {
+        vector->unlock(vector);
+        return NULL;
+    }
+    void *data = vector->data;
+
+    vector->unlock(vector);
+    return data;
+}
+
+/**
+ * qvector_parallel_foreach(): Calls a function for each element of this
+ * vector on the threads of a pool.
+ *
+ * @param vector    qvector_t container pointer.
+ * @param pool      qthreadpool_t pointer, NULL to run in the calling thread.
+ * @param func      function called with an element, its index and userdata.
+ * @param userdata  user data passed to the function.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @code
+ *  static void scale(void *data, size_t index, void *userdata) {
+ *      *(double *) data *= *(double *) userdata;
+ *  }
+ *
+ *  double factor = 1.5;
+ *  qvector_parallel_foreach(vector, pool, scale, &factor);
+ * @endcode
+ *
+ * @note
+ *  The elements are split in ranges of consecutive indexes, so the function
+ *  is called in no particular order and on several threads at once. The
+ *  vector is locked meanwhile and the elements can be modified in place,
+ *  but the function must not call the methods of this vector. There is no
+ *  member function for this as with qvector_data().
+ */
+bool qvector_parallel_foreach(qvector_t *vector, qthreadpool_t *pool,
+                              void (*func)(void *data, size_t index,
+                                           void *userdata),
+                              void *userdata) {
+    if (func == NULL) {
+        errno = EINVAL;
+        return false;
+    }
+
+    vector->lock(vector);
+    if (vector->num == 0) {
+        vector->unlock(vector);
+        return true;
+    }
+    if (vector->head != 0 && vector->resize(vector, vector->max) == false) {
+        vector->unlock(vector);
+        return false;
+    }
+
+    qvector_parallel_t foreach;
+    memset((void *) &foreach, 0, sizeof(foreach));
+    foreach.data = (unsigned char *) vector->data;
+    foreach.objsize = vector->objsize;
+    foreach.num = vector->num;
+    foreach.func = func;
+    foreach.userdata = userdata;
+    bool ret = qthreadpool_parallel_for(pool, 0, vector->num, 0,
+                                        foreach_range, &foreach);
+
+    vector->unlock(vector);
+    return ret;
+}
+
 /**
  * qvector->reverse(): Reverse the order of element in this vector.
  *
@@ -837,8 +1147,8 @@ void qvector_reverse(qvector_t *vector) {
     }
 
     for (i = 0, j = vector->num - 1; i < j; i++, j--) {
-        void *data1 = (unsigned char *)vector->data + i * vector->objsize;
-        void *data2 = (unsigned char *)vector->data + j * vector->objsize;
+        void *data1 = elem_at(vector, i);
+        void *data2 = elem_at(vector, j);
 
         memcpy(tmp, data1, vector->objsize);
         memcpy(data1, data2, vector->objsize);
@@ -849,6 +1159,170 @@ void qvector_reverse(qvector_t *vector) {
     vector->unlock(vector);
 }
 
+/**
+ * qvector->sort(): Sorts the elements in this vector.
+ *
+ * @param vector    qvector_t container pointer.
+ * @param cmp       comparison function of qsort().
+ *
+ * @code
+ *  int cmp_int(const void *data1, const void *data2) {
+ *      return *(int *)data1 - *(int *)data2;
+ *  }
+ *
+ *  vector->sort(vector, cmp_int);
+ * @endcode
+ *
+ * @note
+ *  The elements are sorted in place by qsort(), so the order of equal
+ *  elements is not kept. A wrapped circular vector is unrolled first.
+ */
+void qvector_sort(qvector_t *vector,
+                  int (*cmp)(const void *data1, const void *data2)) {
+    vector->lock(vector);
+    if (vector->num > 1) {
+        if (vector->head != 0 && vector->resize(vector, vector->max) == false) {
+            vector->unlock(vector);
+            return;
+        }
+        qsort(vector->data, vector->num, vector->objsize, cmp);
+    }
+    vector->unlock(vector);
+}
+
+/**
+ * qvector_parallel_sort(): Sorts the elements of this vector on the threads
+ * of a pool.
+ *
+ * @param vector    qvector_t container pointer.
+ * @param pool      qthreadpool_t pointer, NULL to sort in the calling thread.
+ * @param cmp       comparison function, same as the one of qsort().
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @code
+ *  qthreadpool_t *pool = qthreadpool(0);
+ *  qvector_parallel_sort(vector, pool, cmp_int);
+ * @endcode
+ *
+ * @note
+ *  The vector is split into a chunk per thread which are sorted with
+ *  qsort() at once, and then merged pairwise in ceil(log2(chunks)) passes
+ *  through a temporary copy of the elements. Small vectors are sorted in
+ *  the calling thread. There is no member function for this as with
+ *  qvector_data().
+ */
+bool qvector_parallel_sort(qvector_t *vector, qthreadpool_t *pool,
+                           int (*cmp)(const void *data1, const void *data2)) {
+    if (cmp == NULL) {
+        errno = EINVAL;
+        return false;
+    }
+
+    vector->lock(vector);
+    if (vector->num <= 1) {
+        vector->unlock(vector);
+        return true;
+    }
+    if (vector->head != 0 && vector->resize(vector, vector->max) == false) {
+        vector->unlock(vector);
+        return false;
+    }
+    if (pool == NULL || vector->num < PARALLEL_SORT_MIN) {
+        qsort(vector->data, vector->num, vector->objsize, cmp);
+        vector->unlock(vector);
+        return true;
+    }
+
+    qvector_parallel_t sort;
+    memset((void *) &sort, 0, sizeof(sort));
+    sort.data = (unsigned char *) vector->data;
+    sort.tmp = (unsigned char *) malloc(vector->num * vector->objsize);
+    if (sort.tmp == NULL) {
+        vector->unlock(vector);
+        errno = ENOMEM;
+        return false;
+    }
+    sort.objsize = vector->objsize;
+    sort.num = vector->num;
+    sort.cmp = cmp;
+
+    size_t nchunks = (size_t) qthreadpool_nthreads(pool);
+    sort.width = sort.num / nchunks + ((sort.num % nchunks) ? 1 : 0);
+    nchunks = sort.num / sort.width + ((sort.num % sort.width) ? 1 : 0);
+    qthreadpool_parallel_for(pool, 0, nchunks, 1, sort_range, &sort);
+
+    for (; sort.width < sort.num; sort.width *= 2) {
+        size_t npairs = sort.num / (sort.width * 2)
+                + ((sort.num % (sort.width * 2)) ? 1 : 0);
+        qthreadpool_parallel_for(pool, 0, npairs, 1, merge_range, &sort);
+
+        unsigned char *swap = sort.data;
+        sort.data = sort.tmp;
+        sort.tmp = swap;
+    }
+
+    if (sort.data != vector->data) {
+        memcpy(vector->data, sort.data, sort.num * sort.objsize);
+        sort.tmp = sort.data;
+    }
+    free(sort.tmp);
+
+    vector->unlock(vector);
+    return true;
+}
+
+/**
+ * qvector->bsearch(): Finds an element in this sorted vector.
+ *
+ * @param vector    qvector_t container pointer.
+ * @param key       the element to look for.
+ * @param cmp       comparison function the vector is sorted by.
+ *
+ * @return the index of the first matching element, otherwise returns -1.
+ * @retval errno will be set in error condition.
+ *  - ENOENT : No matching element.
+ *
+ * @code
+ *  vector->sort(vector, cmp_int);
+ *  int index = vector->bsearch(vector, &key, cmp_int);
+ *  if (index >= 0) {
+ *      vector->removeat(vector, index);
+ *  }
+ * @endcode
+ *
+ * @note
+ *  The key is always passed to cmp() as the first argument.
+ */
+int qvector_bsearch(qvector_t *vector, const void *key,
+                    int (*cmp)(const void *data1, const void *data2)) {
+    vector->lock(vector);
+
+    //find the first element which is not less than the key
+    size_t low = 0, high = vector->num;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (cmp(key, elem_at(vector, mid)) > 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    int index = -1;
+    if (low < vector->num && cmp(key, elem_at(vector, low)) == 0) {
+        index = low;
+    } else {
+        errno = ENOENT;
+    }
+
+    vector->unlock(vector);
+    return index;
+}
+
 /**
  * qvector->getnext(): Get next element in this vector.
  *
@@ -891,7 +1365,7 @@ bool qvector_getnext(qvector_t *vector, qvector_obj_t *obj, bool newmem) {
         return false;
     }
 
-    void *data = (unsigned char *)vector->data + (obj->index) * vector->objsize;
+    void *data = elem_at(vector, obj->index);
     if (newmem) {
         void *dump = malloc(vector->objsize);
         if (dump == NULL ) {
@@ -929,7 +1403,7 @@ static void *get_at(qvector_t *vector, int index, bool newmem) {
         }
     }
 
-    void *src_data = (unsigned char *)vector->data + index * vector->objsize;
+    void *src_data = elem_at(vector, index);
     if (newmem) {
         void *dump_data = malloc(vector->objsize);
         if (dump_data == NULL) {
@@ -958,12 +1432,112 @@ static bool remove_at(qvector_t *vector, int index) {
         }
     }
 
-    void *src = (unsigned char *)vector->data + (index + 1) * vector->objsize;
-    void *dst = (unsigned char *)vector->data + index * vector->objsize;
-    int size = (vector->num - (index + 1)) * vector->objsize;
-    memcpy(dst, src, size);
+    int i;
+    if ((vector->options & QVECTOR_CIRCULAR) && index < vector->num / 2) {
+        //shift data from 0...(index - 1) to 1...index and step the head
+        for (i = index; i > 0; i--) {
+            move_elem(vector, i, i - 1);
+        }
+        vector->head = (vector->head + 1 == vector->max) ? 0 : vector->head + 1;
+    } else if (vector->head == 0) {
+        void *src = (unsigned char *)vector->data + (index + 1) * vector->objsize;
+        void *dst = (unsigned char *)vector->data + index * vector->objsize;
+        int size = (vector->num - (index + 1)) * vector->objsize;
+        memmove(dst, src, size);
+    } else {
+        for (i = index; i < vector->num - 1; i++) {
+            move_elem(vector, i, i + 1);
+        }
+    }
 
     return true;
 }
 
+static void *elem_at(qvector_t *vector, size_t index) {
+    size_t pos = vector->head + index;
+    if (pos >= vector->max) {
+        pos -= vector->max;
+    }
+    return (unsigned char *)vector->data + pos * vector->objsize;
+}
+
+static void move_elem(qvector_t *vector, size_t dst, size_t src) {
+    memcpy(elem_at(vector, dst), elem_at(vector, src), vector->objsize);
+}
+
+static bool grow_to(qvector_t *vector, size_t need) {
+    if (need <= vector->max) {
+        return true;
+    }
+
+    size_t newmax = vector->max;
+    if (vector->options & QVECTOR_RESIZE_DOUBLE) {
+        while (newmax < need) {
+            newmax = (newmax + 1) * 2;
+        }
+    } else if (vector->options & QVECTOR_RESIZE_LINEAR) {
+        while (newmax < need) {
+            newmax += vector->initnum;
+        }
+    } else {
+        newmax = need;
+    }
+    return vector->resize(vector, newmax);
+}
+
+static void foreach_range(size_t begin, size_t end, void *userdata) {
+    qvector_parallel_t *foreach = (qvector_parallel_t *) userdata;
+    size_t i;
+    for (i = begin; i < end; i++) {
+        foreach->func(foreach->data + i * foreach->objsize, i,
+                      foreach->userdata);
+    }
+}
+
+// sorts the chunks of width elements.
+static void sort_range(size_t begin, size_t end, void *userdata) {
+    qvector_parallel_t *sort = (qvector_parallel_t *) userdata;
+    size_t chunk;
+    for (chunk = begin; chunk < end; chunk++) {
+        size_t first = chunk * sort->width;
+        size_t num = (sort->num - first > sort->width) ?
+                sort->width : sort->num - first;
+        qsort(sort->data + first * sort->objsize, num, sort->objsize,
+              sort->cmp);
+    }
+}
+
+// merges the pairs of the sorted runs of width elements from data to tmp.
+static void merge_range(size_t begin, size_t end, void *userdata) {
+    qvector_parallel_t *sort = (qvector_parallel_t *) userdata;
+    size_t objsize = sort->objsize;
+    size_t pair;
+    for (pair = begin; pair < end; pair++) {
+        size_t lo = pair * sort->width * 2;
+        size_t mid = (sort->num - lo > sort->width) ?
+                lo + sort->width : sort->num;
+        size_t hi = (sort->num - mid > sort->width) ?
+                mid + sort->width : sort->num;
+
+        unsigned char *left = sort->data + lo * objsize;
+        unsigned char *leftend = sort->data + mid * objsize;
+        unsigned char *right = leftend;
+        unsigned char *rightend = sort->data + hi * objsize;
+        unsigned char *out = sort->tmp + lo * objsize;
+        while (left < leftend && right < rightend) {
+            if (sort->cmp(left, right) <= 0) {
+                memcpy(out, left, objsize);
+                left += objsize;
+            } else {
+                memcpy(out, right, objsize);
+                right += objsize;
+            }
+            out += objsize;
+        }
+        memcpy(out, left, leftend - left);
+        out += leftend - left;
+        memcpy(out, right, rightend - right);
+    }
+}
+
 #endif
\ No newline at end of file
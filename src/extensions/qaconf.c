@@ -205,12 +205,21 @@
 #include <string.h>
 #include <assert.h>
 #include <errno.h>
+#include <ctype.h>
 #include "qinternal.h"
 #include "utilities/qstring.h"
+#include "utilities/qfile.h"
 #include "extensions/qaconf.h"
 
 #ifndef _DOXYGEN_SKIP
-#define MAX_LINESIZE    (1024*4)
+
+/* a mapped file being parsed */
+struct _qaconf_input {
+    const char *offset;
+    const char *end;
+    char *line;         /* the current line, trimmed in place */
+    size_t linesize;
+};
 
 /* internal functions */
 static int addoptions(qaconf_t *qaconf, const qaconf_option_t *options);
@@ -221,9 +230,15 @@ static const char *errmsg(qaconf_t *qaconf);
 static void reseterror(qaconf_t *qaconf);
 static void free_(qaconf_t *qaconf);
 
-static int _parse_inline(qaconf_t *qaconf, FILE *fp, uint8_t flags,
-                         enum qaconf_section sectionid,
+static int _parse_inline(qaconf_t *qaconf, struct _qaconf_input *input,
+                         uint8_t flags, enum qaconf_section sectionid,
                          qaconf_cbdata_t *cbdata_parent);
+static char *_readline(struct _qaconf_input *input);
+static bool _build_optindex(qaconf_t *qaconf);
+static qaconf_option_t *_find_option(qaconf_t *qaconf, const char *name,
+                                     int (*cmpfunc)(const char *,
+                                                    const char *));
+static uint32_t _hash_optname(const char *name);
 static void _seterrmsg(qaconf_t *qaconf, const char *format, ...);
 static void _free_cbdata(qaconf_cbdata_t *cbdata);
 static int _is_str_number(const char *s);
@@ -450,11 +465,23 @@ static int addoptions(qaconf_t *qaconf, const qaconf_option_t *options) {
 
     // Realloc
     size_t newsize = sizeof(qaconf_option_t) * (qaconf->numoptions + numopts);
-    qaconf->options = (qaconf_option_t *) realloc(qaconf->options, newsize);
+    qaconf_option_t *newoptions = (qaconf_option_t *) realloc(qaconf->options,
+                                                              newsize);
+    if (newoptions == NULL) {
+        _seterrmsg(qaconf, "Memory allocation failure.");
+        return -1;
+    }
+    qaconf->options = newoptions;
     memcpy(&qaconf->options[qaconf->numoptions], options,
            sizeof(qaconf_option_t) * numopts);
     qaconf->numoptions += numopts;
 
+    // Index option names for the lookups while parsing
+    if (_build_optindex(qaconf) == false) {
+        _seterrmsg(qaconf, "Memory allocation failure.");
+        return -1;
+    }
+
     return numopts;
 }
 
@@ -532,9 +559,10 @@ static void setuserdata(qaconf_t *qaconf, const void *userdata) {
  * @endcode
  */
 static int parse(qaconf_t *qaconf, const char *filepath, uint8_t flags) {
-    // Open file
-    FILE *fp = fopen(filepath, "r");
-    if (fp == NULL) {
+    // Map file
+    size_t size = 0;
+    const char *map = qfile_map(filepath, &size, QFILE_MAP_SEQUENTIAL);
+    if (map == NULL) {
         _seterrmsg(qaconf, "Failed to open file '%s'.", filepath);
         return -1;
     }
@@ -546,10 +574,16 @@ static int parse(qaconf_t *qaconf, const char *filepath, uint8_t flags) {
     qaconf->lineno = 0;
 
     // Parse
-    int optcount = _parse_inline(qaconf, fp, flags, QAC_SECTION_ROOT, NULL);
+    struct _qaconf_input input;
+    memset((void *) &input, 0, sizeof(input));
+    input.offset = map;
+    input.end = map + size;
+    int optcount = _parse_inline(qaconf, &input, flags, QAC_SECTION_ROOT,
+                                 NULL);
 
     // Clean up
-    fclose(fp);
+    free(input.line);
+    qfile_unmap(map, size);
 
     return optcount;
 }
@@ -609,6 +643,8 @@ static void free_(qaconf_t *qaconf) {
         free(qaconf->errstr);
     if (qaconf->options != NULL)
         free(qaconf->options);
+    if (qaconf->optindex != NULL)
+        free(qaconf->optindex);
     free(qaconf);
 }
 
@@ -617,15 +653,15 @@ static void free_(qaconf_t *qaconf) {
 #define ARGV_INIT_SIZE  (4)
 #define ARGV_INCR_STEP  (8)
 #define MAX_TYPECHECK   (5)
-static int _parse_inline(qaconf_t *qaconf, FILE *fp, uint8_t flags,
-                         enum qaconf_section sectionid,
+static int _parse_inline(qaconf_t *qaconf, struct _qaconf_input *input,
+                         uint8_t flags, enum qaconf_section sectionid,
                          qaconf_cbdata_t *cbdata_parent) {
     // Assign compare function.
     int (*cmpfunc)(const char *, const char *) = strcmp;
     if (flags & QAC_CASEINSENSITIVE)
         cmpfunc = strcasecmp;
 
-    char buf[MAX_LINESIZE];
+    char *buf;
     bool doneloop = false;
     bool exception = false;
     int optcount = 0;  // number of option entry processed.
@@ -640,7 +676,11 @@ static int _parse_inline(qaconf_t *qaconf, FILE *fp, uint8_t flags,
     goto exitloop;                                                          \
 } while (0);
 
-        if (fgets(buf, MAX_LINESIZE, fp) == NULL) {
+        if ((buf = _readline(input)) == NULL) {
+            if (input->offset < input->end) {
+                EXITLOOP("Memory allocation failure.");
+            }
+
             // Check if section was opened and never closed
             if (cbdata_parent != NULL) {
                 EXITLOOP("<%s> section was not closed.", cbdata_parent->argv[0]);
@@ -773,7 +813,7 @@ static int _parse_inline(qaconf_t *qaconf, FILE *fp, uint8_t flags,
             DEBUG("  argv[%d]=%s", cbdata->argc - 1, wp1);
 
             // For quoted string, this case can be happened.
-            if (*wp2 == '\0') {
+            if (doneparsing == false && *wp2 == '\0') {
                 doneparsing = true;
             }
         }
@@ -789,120 +829,116 @@ static int _parse_inline(qaconf_t *qaconf, FILE *fp, uint8_t flags,
 
         // Find matching option
         bool optfound = false;
-        int i;
-        for (i = 0; optfound == false && i < qaconf->numoptions; i++) {
-            qaconf_option_t *option = &qaconf->options[i];
-
-            if (!cmpfunc(cbdata->argv[0], option->name)) {
-                // Check sections
-                if ((cbdata->otype != QAC_OTYPE_SECTIONCLOSE)
-                        && (option->sections != QAC_SECTION_ALL)
-                        && (option->sections & sectionid) == 0) {
-                    EXITLOOP("Option '%s' is in wrong section.", option->name);
+        qaconf_option_t *option = _find_option(qaconf, cbdata->argv[0], cmpfunc);
+        if (option != NULL) {
+            // Check sections
+            if ((cbdata->otype != QAC_OTYPE_SECTIONCLOSE)
+                    && (option->sections != QAC_SECTION_ALL)
+                    && (option->sections & sectionid) == 0) {
+                EXITLOOP("Option '%s' is in wrong section.", option->name);
+            }
+
+            // Check argument types
+            if (cbdata->otype != QAC_OTYPE_SECTIONCLOSE) {
+                // Check number of arguments
+                int numtake = option->take & QAC_TAKEALL;
+                if (numtake != QAC_TAKEALL
+                        && numtake != (cbdata->argc - 1)) {
+                    EXITLOOP("'%s' option takes %d arguments.",
+                             option->name, numtake);
                 }
 
                 // Check argument types
-                if (cbdata->otype != QAC_OTYPE_SECTIONCLOSE) {
-                    // Check number of arguments
-                    int numtake = option->take & QAC_TAKEALL;
-                    if (numtake != QAC_TAKEALL
-                            && numtake != (cbdata->argc - 1)) {
-                        EXITLOOP("'%s' option takes %d arguments.",
-                                 option->name, numtake);
-                    }
-
-                    // Check argument types
-                    int deftype;  // 0:str, 1:int, 2:float, 3:bool
-                    if (option->take & QAC_AA_INT)
-                        deftype = 1;
-                    else if (option->take & QAC_AA_FLOAT)
-                        deftype = 2;
-                    else if (option->take & QAC_AA_BOOL)
-                        deftype = 3;
+                int deftype;  // 0:str, 1:int, 2:float, 3:bool
+                if (option->take & QAC_AA_INT)
+                    deftype = 1;
+                else if (option->take & QAC_AA_FLOAT)
+                    deftype = 2;
+                else if (option->take & QAC_AA_BOOL)
+                    deftype = 3;
+                else
+                    deftype = 0;
+
+                int j;
+                for (j = 1; j < cbdata->argc && j <= MAX_TYPECHECK; j++) {
+                    int argtype;
+                    if (option->take & (QAC_A1_INT << (j - 1)))
+                        argtype = 1;
+                    else if (option->take & (QAC_A1_FLOAT << (j - 1)))
+                        argtype = 2;
+                    else if (option->take & (QAC_A1_BOOL << (j - 1)))
+                        argtype = 3;
                     else
-                        deftype = 0;
-
-                    int j;
-                    for (j = 1; j < cbdata->argc && j <= MAX_TYPECHECK; j++) {
-                        int argtype;
-                        if (option->take & (QAC_A1_INT << (j - 1)))
-                            argtype = 1;
-                        else if (option->take & (QAC_A1_FLOAT << (j - 1)))
-                            argtype = 2;
-                        else if (option->take & (QAC_A1_BOOL << (j - 1)))
-                            argtype = 3;
-                        else
-                            argtype = deftype;
-
-                        if (argtype == 1) {
-                            // integer type
-                            if (_is_str_number(cbdata->argv[j]) != 1) {
-                                EXITLOOP(
-                                        "%dth argument of '%s' must be integer type.",
-                                        j, option->name);
-                            }
-                        } else if (argtype == 2) {
-                            // floating point type
-                            if (_is_str_number(cbdata->argv[j]) == 0) {
-                                EXITLOOP(
-                                        "%dth argument of '%s' must be floating point. type",
-                                        j, option->name);
-                            }
-                        } else if (argtype == 3) {
-                            // bool type
-                            if (_is_str_bool(cbdata->argv[j]) != 0) {
-                                // Change argument to "1".
-                                strcpy(cbdata->argv[j], "1");
-                            } else {
-                                EXITLOOP(
-                                        "%dth argument of '%s' must be bool type.",
-                                        j, option->name);
-                            }
+                        argtype = deftype;
+
+                    if (argtype == 1) {
+                        // integer type
+                        if (_is_str_number(cbdata->argv[j]) != 1) {
+                            EXITLOOP(
+                                    "%dth argument of '%s' must be integer type.",
+                                    j, option->name);
+                        }
+                    } else if (argtype == 2) {
+                        // floating point type
+                        if (_is_str_number(cbdata->argv[j]) == 0) {
+                            EXITLOOP(
+                                    "%dth argument of '%s' must be floating point. type",
+                                    j, option->name);
+                        }
+                    } else if (argtype == 3) {
+                        // bool type
+                        if (_is_str_bool(cbdata->argv[j]) != 0) {
+                            // Change argument to "1".
+                            strcpy(cbdata->argv[j], "1");
+                        } else {
+                            EXITLOOP(
+                                    "%dth argument of '%s' must be bool type.",
+                                    j, option->name);
                         }
                     }
                 }
+            }
 
-                // Callback
-                //DEBUG("Callback %s", option->name);
-                qaconf_cb_t *usercb = option->cb;
-                if (usercb == NULL)
-                    usercb = qaconf->defcb;
-                if (usercb != NULL) {
-                    char *cberrmsg = NULL;
-
-                    if (cbdata->otype != QAC_OTYPE_SECTIONCLOSE) {
-                        // Normal option and sectionopen
-                        cberrmsg = usercb(cbdata, qaconf->userdata);
-                    } else {
-                        // QAC_OTYPE_SECTIONCLOSE
-
-                        // Change otype
-                        ASSERT(cbdata_parent != NULL);
-                        enum qaconf_otype orig_otype = cbdata_parent->otype;
-                        cbdata_parent->otype = QAC_OTYPE_SECTIONCLOSE;
-
-                        // Callback
-                        cberrmsg = usercb(cbdata_parent, qaconf->userdata);
-
-                        // Restore type
-                        cbdata_parent->otype = orig_otype;
-                    }
+            // Callback
+            //DEBUG("Callback %s", option->name);
+            qaconf_cb_t *usercb = option->cb;
+            if (usercb == NULL)
+                usercb = qaconf->defcb;
+            if (usercb != NULL) {
+                char *cberrmsg = NULL;
 
-                    // Error handling
-                    if (cberrmsg != NULL) {
-                        freethis = cberrmsg;
-                        EXITLOOP("%s", cberrmsg);
-                    }
+                if (cbdata->otype != QAC_OTYPE_SECTIONCLOSE) {
+                    // Normal option and sectionopen
+                    cberrmsg = usercb(cbdata, qaconf->userdata);
+                } else {
+                    // QAC_OTYPE_SECTIONCLOSE
+
+                    // Change otype
+                    ASSERT(cbdata_parent != NULL);
+                    enum qaconf_otype orig_otype = cbdata_parent->otype;
+                    cbdata_parent->otype = QAC_OTYPE_SECTIONCLOSE;
+
+                    // Callback
+                    cberrmsg = usercb(cbdata_parent, qaconf->userdata);
+
+                    // Restore type
+                    cbdata_parent->otype = orig_otype;
                 }
 
-                if (cbdata->otype == QAC_OTYPE_SECTIONOPEN) {
-                    // Store it for later
-                    newsectionid = option->sectionid;
+                // Error handling
+                if (cberrmsg != NULL) {
+                    freethis = cberrmsg;
+                    EXITLOOP("%s", cberrmsg);
                 }
+            }
 
-                // Set found flag
-                optfound = true;
+            if (cbdata->otype == QAC_OTYPE_SECTIONOPEN) {
+                // Store it for later
+                newsectionid = option->sectionid;
             }
+
+            // Set found flag
+            optfound = true;
         }
 
         // If not found.
@@ -918,7 +954,7 @@ static int _parse_inline(qaconf_t *qaconf, FILE *fp, uint8_t flags,
         if (cbdata->otype == QAC_OTYPE_SECTIONOPEN) {
             // Enter recursive call
             DEBUG("Entering next level %d.", cbdata->level+1);
-            int optcount2 = _parse_inline(qaconf, fp, flags, newsectionid,
+            int optcount2 = _parse_inline(qaconf, input, flags, newsectionid,
                                           cbdata);
             if (optcount2 >= 0) {
                 optcount += optcount2;
@@ -955,6 +991,91 @@ static int _parse_inline(qaconf_t *qaconf, FILE *fp, uint8_t flags,
     return (exception == false) ? optcount : -1;
 }
 
+/**
+ * Copy the next line of the input into the line buffer, which grows to the
+ * longest line. Returns NULL at the end of the input.
+ */
+static char *_readline(struct _qaconf_input *input) {
+    if (input->offset >= input->end)
+        return NULL;
+
+    const char *eol = memchr(input->offset, '\n', input->end - input->offset);
+    if (eol == NULL)
+        eol = input->end;
+    size_t linelen = eol - input->offset;
+    if (linelen + 1 > input->linesize) {
+        size_t newsize = (input->linesize > 0) ? input->linesize * 2 : 256;
+        if (newsize < linelen + 1)
+            newsize = linelen + 1;
+        char *newline = (char *) realloc(input->line, newsize);
+        if (newline == NULL)
+            return NULL;
+        input->line = newline;
+        input->linesize = newsize;
+    }
+    memcpy(input->line, input->offset, linelen);
+    input->line[linelen] = '\0';
+    input->offset = (eol < input->end) ? eol + 1 : input->end;
+
+    return input->line;
+}
+
+/**
+ * Rebuild the open addressing index of the option names. The names are
+ * hashed case-insensitively, so the index serves both comparisons, and
+ * options are inserted in order, so the first registered one is found first
+ * as the list scan did.
+ */
+static bool _build_optindex(qaconf_t *qaconf) {
+    int size = 16;
+    while (size < qaconf->numoptions * 2)
+        size *= 2;
+    int *optindex = (int *) calloc(size, sizeof(int));
+    if (optindex == NULL)
+        return false;
+
+    int i;
+    for (i = 0; i < qaconf->numoptions; i++) {
+        int slot = _hash_optname(qaconf->options[i].name) & (size - 1);
+        while (optindex[slot] != 0)
+            slot = (slot + 1) & (size - 1);
+        optindex[slot] = i + 1;
+    }
+
+    if (qaconf->optindex != NULL)
+        free(qaconf->optindex);
+    qaconf->optindex = optindex;
+    qaconf->optindexsize = size;
+    return true;
+}
+
+static qaconf_option_t *_find_option(qaconf_t *qaconf, const char *name,
+                                     int (*cmpfunc)(const char *,
+                                                    const char *)) {
+    if (qaconf->optindex == NULL)
+        return NULL;
+
+    int mask = qaconf->optindexsize - 1;
+    int slot;
+    for (slot = _hash_optname(name) & mask; qaconf->optindex[slot] != 0;
+            slot = (slot + 1) & mask) {
+        qaconf_option_t *option = &qaconf->options[qaconf->optindex[slot] - 1];
+        if (!cmpfunc(name, option->name))
+            return option;
+    }
+    return NULL;
+}
+
+/* case-insensitive FNV-1a */
+static uint32_t _hash_optname(const char *name) {
+    uint32_t h = 2166136261U;
+    for (; *name != '\0'; name++) {
+        h ^= (unsigned char) tolower((unsigned char) *name);
+        h *= 16777619U;
+    }
+    return h;
+}
+
 static void _seterrmsg(qaconf_t *qaconf, const char *format, ...) {
     if (qaconf->errstr != NULL)
         free(qaconf->errstr);
@@ -0,0 +1,326 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/**
+ * @file qconfhandle.c Hot swappable configuration handle.
+ *
+ * qconfhandle holds the current version of a configuration, such as a
+ * qlisttbl_t parsed by qconfig_parse_file() or a structure filled in by
+ * qaconf callbacks. Readers get the current version without taking any lock,
+ * and a reload publishes a new version by swapping a single pointer. The
+ * replaced version is freed once every reader that could have seen it has
+ * left its read section, in the same epoch based way as the lock-free reads
+ * of qhashtbl. So readers never wait for a reload and a reload never waits
+ * for readers.
+ *
+ * A published configuration must not be modified, since readers may be
+ * using it at any time.
+ *
+ * @code
+ *   // qconfig
+ *   qconfhandle_t *conf = qconfhandle(NULL);
+ *   conf->reload(conf, "server.conf", '=');
+ *
+ *   // readers
+ *   qlisttbl_t *tbl = (qlisttbl_t *) conf->read_enter(conf);
+ *   const char *port = tbl->getstr(tbl, "port", false);
+ *   (...use port...)
+ *   conf->read_leave(conf);
+ *
+ *   // on SIGHUP
+ *   conf->reload(conf, "server.conf", '=');
+ *
+ *   conf->free(conf);
+ * @endcode
+ *
+ * @code
+ *   // qaconf, the callbacks fill in a user structure
+ *   qconfhandle_t *conf = qconfhandle(free_myconf);
+ *   struct myconf *myconf = calloc(1, sizeof(struct myconf));
+ *   qaconf->setuserdata(qaconf, myconf);
+ *   if (qaconf->parse(qaconf, "server.conf", QAC_CASEINSENSITIVE) >= 0) {
+ *     conf->publish(conf, myconf);
+ *   } else {
+ *     free_myconf(myconf);
+ *   }
+ * @endcode
+ */
+
+#ifndef DISABLE_QCONFIG
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include "containers/qlisttbl.h"
+#include "extensions/qconfig.h"
+#include "extensions/qconfhandle.h"
+#include "qinternal.h"
+
+#ifndef _DOXYGEN_SKIP
+
+/* a published configuration */
+typedef struct qconfhandle_version_s qconfhandle_version_t;
+struct qconfhandle_version_s {
+    void *config;           /*!< user configuration */
+    uint64_t version;       /*!< version number */
+};
+
+struct qconfhandle_data_s {
+    qconfhandle_version_t *current; /*!< published version */
+    uint64_t version;               /*!< last version number */
+    _q_epoch_t *epoch;              /*!< readers and replaced versions */
+    qconfhandle_free_cb_t *freefunc;    /*!< configuration destructor */
+    pthread_mutex_t lock;           /*!< serializes writers */
+};
+
+static void free_version(void *data, void *version);
+
+#endif
+
+/**
+ * Create a configuration handle.
+ *
+ * @param freefunc  function to free a replaced configuration. NULL for
+ *                  qlisttbl_t configurations, which are freed with
+ *                  qlisttbl->free().
+ *
+ * @return a pointer of qconfhandle_t if successful, otherwise returns NULL.
+ * @retval errno will be set in error condition.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @code
+ *   qconfhandle_t *conf = qconfhandle(NULL);
+ * @endcode
+ */
+qconfhandle_t *qconfhandle(qconfhandle_free_cb_t *freefunc) {
+    qconfhandle_t *handle = (qconfhandle_t *) calloc(1, sizeof(qconfhandle_t));
+    qconfhandle_data_t *data = (qconfhandle_data_t *) calloc(
+            1, sizeof(qconfhandle_data_t));
+    if (handle == NULL || data == NULL) {
+        free(handle);
+        free(data);
+        errno = ENOMEM;
+        return NULL;
+    }
+    if ((data->epoch = _q_epoch_new(data)) == NULL) {
+        free(handle);
+        free(data);
+        errno = ENOMEM;
+        return NULL;
+    }
+    pthread_mutex_init(&data->lock, NULL);
+    data->freefunc = freefunc;
+    handle->data = data;
+
+    // assign methods
+    handle->publish = qconfhandle_publish;
+    handle->reload = qconfhandle_reload;
+    handle->read_enter = qconfhandle_read_enter;
+    handle->read_leave = qconfhandle_read_leave;
+    handle->version = qconfhandle_version;
+    handle->reclaim = qconfhandle_reclaim;
+    handle->free = qconfhandle_free;
+
+    return handle;
+}
+
+/**
+ * qconfhandle->publish(): Replace the current configuration.
+ *
+ * Readers entering after this see the new configuration. The replaced one
+ * is freed with the free function as soon as no reader can be using it,
+ * here or in a later call of publish() or reclaim().
+ *
+ * @param handle    qconfhandle_t container pointer.
+ * @param config    new configuration. The handle takes its ownership.
+ *
+ * @return the version number of the new configuration, starting from 1,
+ *         otherwise returns 0.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - ENOMEM : Memory allocation failure.
+ */
+uint64_t qconfhandle_publish(qconfhandle_t *handle, void *config) {
+    if (config == NULL) {
+        errno = EINVAL;
+        return 0;
+    }
+    qconfhandle_data_t *data = handle->data;
+
+    qconfhandle_version_t *version = (qconfhandle_version_t *) calloc(
+            1, sizeof(qconfhandle_version_t));
+    if (version == NULL) {
+        errno = ENOMEM;
+        return 0;
+    }
+    version->config = config;
+
+    pthread_mutex_lock(&data->lock);
+    uint64_t num = data->version + 1;
+    version->version = num;
+    qconfhandle_version_t *old = __atomic_exchange_n(&data->current, version,
+                                                     __ATOMIC_SEQ_CST);
+    __atomic_store_n(&data->version, num, __ATOMIC_RELEASE);
+    if (old != NULL) {
+        _q_epoch_retire(data->epoch, old, free_version);
+    }
+    _q_epoch_reclaim(data->epoch);
+    pthread_mutex_unlock(&data->lock);
+
+    return num;
+}
+
+/**
+ * qconfhandle->reload(): Parse a configuration file with
+ * qconfig_parse_file() and publish it.
+ *
+ * @param handle    qconfhandle_t container pointer, created with NULL free
+ *                  function.
+ * @param filepath  configuration file path
+ * @param sepchar   separater used in configuration file to divice key and value
+ *
+ * @return the version number of the new configuration if successful,
+ *         otherwise returns 0 and the current configuration is kept.
+ */
+uint64_t qconfhandle_reload(qconfhandle_t *handle, const char *filepath,
+                            char sepchar) {
+    qlisttbl_t *tbl = qconfig_parse_file(NULL, filepath, sepchar);
+    if (tbl == NULL) {
+        return 0;
+    }
+
+    uint64_t version = qconfhandle_publish(handle, tbl);
+    if (version == 0) {
+        tbl->free(tbl);
+    }
+    return version;
+}
+
+/**
+ * qconfhandle->read_enter(): Enter read section and get the current
+ * configuration.
+ *
+ * @param handle    qconfhandle_t container pointer.
+ *
+ * @return the current configuration, or NULL if nothing has been published.
+ *
+ * @note
+ *  The configuration stays valid until the thread calls read_leave(), even
+ *  if it's replaced meanwhile. Read sections can be nested. A read section
+ *  holds back freeing of the replaced configurations, so keep it short, and
+ *  enter again to pick up a newer version.
+ */
+void *qconfhandle_read_enter(qconfhandle_t *handle) {
+    qconfhandle_data_t *data = handle->data;
+
+    _q_epoch_enter(data->epoch);
+    qconfhandle_version_t *current = __atomic_load_n(&data->current,
+                                                     __ATOMIC_ACQUIRE);
+    return (current != NULL) ? current->config : NULL;
+}
+
+/**
+ * qconfhandle->read_leave(): Leave read section.
+ *
+ * @param handle    qconfhandle_t container pointer.
+ */
+void qconfhandle_read_leave(qconfhandle_t *handle) {
+    _q_epoch_leave(handle->data->epoch);
+}
+
+/**
+ * qconfhandle->version(): Get the version number of the current
+ * configuration.
+ *
+ * @param handle    qconfhandle_t container pointer.
+ *
+ * @return the version number, or 0 if nothing has been published.
+ */
+uint64_t qconfhandle_version(qconfhandle_t *handle) {
+    return __atomic_load_n(&handle->data->version, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * qconfhandle->reclaim(): Free the replaced configurations which no reader
+ * is using any more.
+ *
+ * @param handle    qconfhandle_t container pointer.
+ *
+ * @return the number of replaced configurations still in use.
+ *
+ * @note
+ *  publish() does this as well, so it's only needed to release memory
+ *  early when readers were in read sections at the last publish().
+ */
+size_t qconfhandle_reclaim(qconfhandle_t *handle) {
+    return _q_epoch_reclaim(handle->data->epoch);
+}
+
+/**
+ * qconfhandle->free(): Free the handle with the current and the replaced
+ * configurations.
+ *
+ * @param handle    qconfhandle_t container pointer.
+ *
+ * @note
+ *  No reader should be in a read section by now.
+ */
+void qconfhandle_free(qconfhandle_t *handle) {
+    qconfhandle_data_t *data = handle->data;
+
+    _q_epoch_free(data->epoch);
+    if (data->current != NULL) {
+        free_version(data, data->current);
+    }
+
+    pthread_mutex_destroy(&data->lock);
+    free(data);
+    free(handle);
+}
+
+#ifndef _DOXYGEN_SKIP
+
+static void free_version(void *data, void *version) {
+    qconfhandle_free_cb_t *freefunc = ((qconfhandle_data_t *) data)->freefunc;
+    void *config = ((qconfhandle_version_t *) version)->config;
+    if (freefunc != NULL) {
+        freefunc(config);
+    } else {
+        qlisttbl_t *tbl = (qlisttbl_t *) config;
+        tbl->free(tbl);
+    }
+    free(version);
+}
+
+#endif /* _DOXYGEN_SKIP */
+
+#endif /* DISABLE_QCONFIG */
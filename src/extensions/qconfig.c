@@ -38,7 +38,11 @@
 #include <string.h>
 #include <limits.h>
 #include <errno.h>
+#include <pthread.h>
+#include <sys/stat.h>
 #include "qinternal.h"
+#include "containers/qgrow.h"
+#include "containers/qhashtbl.h"
 #include "utilities/qfile.h"
 #include "utilities/qstring.h"
 #include "utilities/qsystem.h"
@@ -53,7 +57,28 @@
 #define _VAR_CMD    '!'
 #define _VAR_ENV    '%'
 
+#define _INCLUDE_MAXDEPTH   (16)
+
+/* cached contents of an included file */
+struct _qconfig_cached {
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+    size_t len;
+    char data[];
+};
+
+static pthread_mutex_t _cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static qhashtbl_t *_cache = NULL;
+
 /* internal functions */
+static qlisttbl_t *_parsebuf(qlisttbl_t *tbl, const char *str, size_t len,
+                             char sepchar);
+static bool _hasinclude(const char *str, size_t len);
+static bool _expand(qgrow_t *grow, const char *dirpath, const char *str,
+                    size_t len, int depth);
+static char *_loadinclude(const char *filepath, size_t *len);
 static char *_parsestr(qlisttbl_t *tbl, const char *str);
 #endif
 
@@ -122,80 +147,96 @@ static char *_parsestr(qlisttbl_t *tbl, const char *str);
  *   daemon.name=seungyoung.kim_eng22_linux_x86_64? (28)
  *   rev=822? (4)
  * @endcode
+ *
+ * @note
+ *  The file is mapped with qfile_map() and parsed in place one line at a
+ *  time. Only a file with @INCLUDE directives is copied into memory, to
+ *  expand them before parsing. Relative include paths are resolved against
+ *  the directory of this file, and includes can be nested up to 16 levels.
+ *  The contents of included files can be kept between calls with
+ *  qconfig_set_cache().
  */
 qlisttbl_t *qconfig_parse_file(qlisttbl_t *tbl, const char *filepath,
                                char sepchar) {
-    char *str = qfile_load(filepath, NULL);
-    if (str == NULL)
+    size_t size = 0;
+    const char *map = qfile_map(filepath, &size, QFILE_MAP_SEQUENTIAL);
+    if (map == NULL)
         return NULL;
 
-    // process include directive
-    char *strp = str;
-
-    while ((strp = strstr(strp, _INCLUDE_DIRECTIVE)) != NULL) {
-        if (strp == str || strp[-1] == '\n') {
-            char buf[PATH_MAX];
-
-            // parse filename
-            char *tmpp;
-            for (tmpp = strp + CONST_STRLEN(_INCLUDE_DIRECTIVE);
-                    *tmpp != '\n' && *tmpp != '\0'; tmpp++)
-                ;
-            int len = tmpp - (strp + CONST_STRLEN(_INCLUDE_DIRECTIVE));
-            if (len >= sizeof(buf)) {
-                DEBUG("Can't process %s directive.", _INCLUDE_DIRECTIVE);
-                free(str);
-                return NULL;
-            }
-
-            strncpy(buf, strp + CONST_STRLEN(_INCLUDE_DIRECTIVE), len);
-            buf[len] = '\0';
-            qstrtrim(buf);
-
-            // get full file path
-            if (!(buf[0] == '/' || buf[0] == '\\')) {
-                char tmp[PATH_MAX];
-                char *dir = qfile_get_dir(filepath);
-                if (strlen(dir) + 1 + strlen(buf) >= sizeof(buf)) {
-                    DEBUG("Can't process %s directive.", _INCLUDE_DIRECTIVE);
-                    free(dir);
-                    free(str);
-                    return NULL;
-                }
-                snprintf(tmp, sizeof(tmp), "%s/%s", dir, buf);
-                free(dir);
-
-                strcpy(buf, tmp);
-            }
-
-            // read file
-            char *incdata;
-            if (strlen(buf) == 0 || (incdata = qfile_load(buf, NULL)) == NULL) {
-                DEBUG("Can't process '%s%s' directive.", _INCLUDE_DIRECTIVE,
-                        buf);
-                free(str);
-                return NULL;
-            }
+    // the contents end at the first NUL as the loaded string would.
+    const char *nul = memchr(map, '\0', size);
+    size_t len = (nul != NULL) ? (size_t) (nul - map) : size;
+    if (_hasinclude(map, len) == false) {
+        tbl = _parsebuf(tbl, map, len, sepchar);
+        qfile_unmap(map, size);
+        return tbl;
+    }
 
-            // replace
-            strncpy(buf, strp, CONST_STRLEN(_INCLUDE_DIRECTIVE) + len);
-            buf[CONST_STRLEN(_INCLUDE_DIRECTIVE) + len] = '\0';
-            strp = qstrreplace("sn", str, buf, incdata);
-            free(incdata);
-            free(str);
-            str = strp;
-        } else {
-            strp += CONST_STRLEN(_INCLUDE_DIRECTIVE);
-        }
+    // expand include directives
+    qgrow_t *grow = qgrow(QGROW_CONTIGUOUS);
+    if (grow == NULL) {
+        qfile_unmap(map, size);
+        return NULL;
+    }
+    char *dir = qfile_get_dir(filepath);
+    bool expanded = _expand(grow, dir, map, len, 0);
+    free(dir);
+    qfile_unmap(map, size);
+    if (expanded == false) {
+        qgrow_free(grow);
+        return NULL;
     }
 
     // parse
-    tbl = qconfig_parse_str(tbl, str, sepchar);
-    free(str);
+    size_t buflen = 0;
+    const char *buf = (const char *) qgrow_buffer(grow, &buflen);
+    tbl = _parsebuf(tbl, (buf != NULL) ? buf : "", buflen, sepchar);
+    qgrow_free(grow);
 
     return tbl;
 }
 
+/**
+ * Turn on or off the cache of included files.
+ *
+ * When the cache is on, the contents of a file read by an @INCLUDE directive
+ * are kept in memory, and reloading the configuration reads the file again
+ * only if its inode, size or modification time has changed. Turning the
+ * cache off releases the kept contents.
+ *
+ * @param enable    true to turn on the cache, false to turn off.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @note
+ *  The values are not cached but parsed on every call, since they can refer
+ *  to the keys defined before them and to the outputs of commands.
+ *
+ * @code
+ *  qconfig_set_cache(true);
+ *  qlisttbl_t *tbl = qconfig_parse_file(NULL, "config.conf", '=');
+ *  (...reload...)
+ *  tbl->free(tbl);
+ *  tbl = qconfig_parse_file(NULL, "config.conf", '=');
+ * @endcode
+ */
+bool qconfig_set_cache(bool enable) {
+    bool ret = true;
+    pthread_mutex_lock(&_cache_lock);
+    if (enable == true && _cache == NULL) {
+        _cache = qhashtbl(0, 0);
+        if (_cache == NULL)
+            ret = false;
+    } else if (enable == false && _cache != NULL) {
+        _cache->free(_cache);
+        _cache = NULL;
+    }
+    pthread_mutex_unlock(&_cache_lock);
+    return ret;
+}
+
 /**
  * Parse string
  *
@@ -217,6 +258,18 @@ qlisttbl_t *qconfig_parse_str(qlisttbl_t *tbl, const char *str, char sepchar) {
     if (str == NULL)
         return NULL;
 
+    return _parsebuf(tbl, str, strlen(str), sepchar);
+}
+
+#ifndef _DOXYGEN_SKIP
+
+/**
+ * Parse the lines of a buffer which doesn't need to be NUL terminated. Each
+ * line is copied into a line buffer to be trimmed and split, so the input is
+ * never modified and can be a read-only mapping.
+ */
+static qlisttbl_t *_parsebuf(qlisttbl_t *tbl, const char *str, size_t len,
+                             char sepchar) {
     if (tbl == NULL) {
         tbl = qlisttbl(0);
         if (tbl == NULL)
@@ -224,15 +277,28 @@ qlisttbl_t *qconfig_parse_str(qlisttbl_t *tbl, const char *str, char sepchar) {
     }
 
     char *section = NULL;
-    char *org, *buf, *offset;
-    for (org = buf = offset = strdup(str); *offset != '\0';) {
+    char *buf = NULL;
+    size_t bufsize = 0;
+    const char *offset, *end = str + len;
+    for (offset = str; offset < end;) {
         // get one line into buf
-        for (buf = offset; *offset != '\n' && *offset != '\0'; offset++)
-            ;
-        if (*offset != '\0') {
-            *offset = '\0';
-            offset++;
+        const char *eol = memchr(offset, '\n', end - offset);
+        if (eol == NULL)
+            eol = end;
+        size_t linelen = eol - offset;
+        if (linelen + 1 > bufsize) {
+            size_t newsize = (bufsize > 0) ? bufsize * 2 : 256;
+            if (newsize < linelen + 1)
+                newsize = linelen + 1;
+            char *newbuf = (char *) realloc(buf, newsize);
+            if (newbuf == NULL)
+                break;
+            buf = newbuf;
+            bufsize = newsize;
         }
+        memcpy(buf, offset, linelen);
+        buf[linelen] = '\0';
+        offset = (eol < end) ? eol + 1 : end;
         qstrtrim(buf);
 
         // skip blank or comment line
@@ -282,14 +348,175 @@ qlisttbl_t *qconfig_parse_str(qlisttbl_t *tbl, const char *str, char sepchar) {
         free(name);
         free(value);
     }
-    free(org);
+    free(buf);
     if (section != NULL)
         free(section);
 
     return tbl;
 }
 
-#ifndef _DOXYGEN_SKIP
+/**
+ * Check if any line starts with the include directive.
+ */
+static bool _hasinclude(const char *str, size_t len) {
+    const char *offset, *end = str + len;
+    for (offset = str; offset < end;) {
+        if ((size_t) (end - offset) >= CONST_STRLEN(_INCLUDE_DIRECTIVE)
+            && !memcmp(offset, _INCLUDE_DIRECTIVE,
+                       CONST_STRLEN(_INCLUDE_DIRECTIVE)))
+            return true;
+        const char *eol = memchr(offset, '\n', end - offset);
+        if (eol == NULL)
+            break;
+        offset = eol + 1;
+    }
+    return false;
+}
+
+/**
+ * Append the lines of a buffer to grow, replacing include directives with
+ * the expanded contents of the files.
+ */
+static bool _expand(qgrow_t *grow, const char *dirpath, const char *str,
+                    size_t len, int depth) {
+    const char *offset, *end = str + len;
+    for (offset = str; offset < end;) {
+        const char *eol = memchr(offset, '\n', end - offset);
+        if (eol == NULL)
+            eol = end;
+        size_t linelen = eol - offset;
+
+        if (linelen < CONST_STRLEN(_INCLUDE_DIRECTIVE)
+            || memcmp(offset, _INCLUDE_DIRECTIVE,
+                      CONST_STRLEN(_INCLUDE_DIRECTIVE))) {
+            if (qgrow_add(grow, offset, (eol < end) ? linelen + 1 : linelen)
+                == false)
+                return false;
+            offset = (eol < end) ? eol + 1 : end;
+            continue;
+        }
+
+        // parse filename
+        char buf[PATH_MAX];
+        size_t namelen = linelen - CONST_STRLEN(_INCLUDE_DIRECTIVE);
+        if (namelen >= sizeof(buf)) {
+            DEBUG("Too long path in %s directive.", _INCLUDE_DIRECTIVE);
+            errno = ENAMETOOLONG;
+            return false;
+        }
+        memcpy(buf, offset + CONST_STRLEN(_INCLUDE_DIRECTIVE), namelen);
+        buf[namelen] = '\0';
+        qstrtrim(buf);
+        if (buf[0] == '\0') {
+            DEBUG("Can't process %s directive.", _INCLUDE_DIRECTIVE);
+            return false;
+        }
+
+        // get full file path
+        if (!(buf[0] == '/' || buf[0] == '\\')) {
+            char tmp[PATH_MAX];
+            int tmplen = snprintf(tmp, sizeof(tmp), "%s/%s", dirpath, buf);
+            if (tmplen < 0 || (size_t) tmplen >= sizeof(buf)) {
+                DEBUG("Too long path in %s directive.", _INCLUDE_DIRECTIVE);
+                errno = ENAMETOOLONG;
+                return false;
+            }
+            memcpy(buf, tmp, tmplen + 1);
+        }
+
+        // read file
+        if (depth >= _INCLUDE_MAXDEPTH) {
+            DEBUG("Too many levels of '%s%s' directive.", _INCLUDE_DIRECTIVE,
+                  buf);
+            errno = ELOOP;
+            return false;
+        }
+        size_t incsize;
+        char *incdata = _loadinclude(buf, &incsize);
+        if (incdata == NULL) {
+            DEBUG("Can't process '%s%s' directive.", _INCLUDE_DIRECTIVE, buf);
+            return false;
+        }
+
+        // replace
+        bool expanded = _expand(grow, dirpath, incdata, incsize, depth + 1);
+        free(incdata);
+        if (expanded == false)
+            return false;
+        if (eol < end && qgrow_add(grow, "\n", 1) == false)
+            return false;
+        offset = (eol < end) ? eol + 1 : end;
+    }
+    return true;
+}
+
+/**
+ * Read an included file up to the first NUL, from the cache if the file
+ * hasn't changed since it was cached.
+ *
+ * @return malloced contents if successful, otherwise returns NULL.
+ */
+static char *_loadinclude(const char *filepath, size_t *len) {
+    struct stat st;
+    if (stat(filepath, &st) != 0)
+        return NULL;
+
+    pthread_mutex_lock(&_cache_lock);
+    if (_cache != NULL) {
+        struct _qconfig_cached *cached;
+        cached = (struct _qconfig_cached *) _cache->get(_cache, filepath, NULL,
+                                                        false);
+        if (cached != NULL && cached->dev == st.st_dev
+            && cached->ino == st.st_ino && cached->size == st.st_size
+            && cached->mtime.tv_sec == st.st_mtim.tv_sec
+            && cached->mtime.tv_nsec == st.st_mtim.tv_nsec) {
+            char *data = (char *) malloc(cached->len + 1);
+            if (data != NULL) {
+                memcpy(data, cached->data, cached->len + 1);
+                *len = cached->len;
+            }
+            pthread_mutex_unlock(&_cache_lock);
+            return data;
+        }
+    }
+    pthread_mutex_unlock(&_cache_lock);
+
+    size_t size = 0;
+    const char *map = qfile_map(filepath, &size, QFILE_MAP_SEQUENTIAL);
+    if (map == NULL)
+        return NULL;
+    const char *nul = memchr(map, '\0', size);
+    size_t datalen = (nul != NULL) ? (size_t) (nul - map) : size;
+    char *data = (char *) malloc(datalen + 1);
+    if (data == NULL) {
+        qfile_unmap(map, size);
+        return NULL;
+    }
+    memcpy(data, map, datalen);
+    data[datalen] = '\0';
+    qfile_unmap(map, size);
+    *len = datalen;
+
+    pthread_mutex_lock(&_cache_lock);
+    if (_cache != NULL) {
+        size_t objsize = sizeof(struct _qconfig_cached) + datalen + 1;
+        struct _qconfig_cached *cached;
+        cached = (struct _qconfig_cached *) malloc(objsize);
+        if (cached != NULL) {
+            cached->dev = st.st_dev;
+            cached->ino = st.st_ino;
+            cached->size = st.st_size;
+            cached->mtime = st.st_mtim;
+            cached->len = datalen;
+            memcpy(cached->data, data, datalen + 1);
+            _cache->put(_cache, filepath, cached, objsize);
+            free(cached);
+        }
+    }
+    pthread_mutex_unlock(&_cache_lock);
+
+    return data;
+}
 
 /**
  * (qlisttbl_t*)->parsestr(): Parse a string and replace variables in the
@@ -59,9 +59,9 @@
  *   if (result != NULL) {
  *     printf("COLS : %d , ROWS : %d\n",
  *            result->get_cols(result), result->get_rows(result));
- *     while (result->get_next(result) == true) {
- *       char *pszName = result->get_str(result, "name");
- *       int   nPopulation = result->get_int(result, "population");
+ *     while (result->getnext(result) == true) {
+ *       const char *pszName = result->getstr(result, "name");
+ *       int   nPopulation = result->getint(result, "population");
  *       printf("Country : %s , Population : %d\n", pszName, nPopulation);
  *     }
  *     result->free(result);
@@ -73,6 +73,31 @@
  *   // free db object
  *   db->free(db);
  * @endcode
+ *
+ * Repeated queries can be prepared once and executed with bound parameters,
+ * so the server parses them only once. A connection pool shares connections
+ * among threads.
+ *
+ * @code
+ *   qdbpool_t *pool = qdbpool("MYSQL", "dbhost.qdecoder.org", 3306,
+ *                             "test", "secret", "sampledb", true, 2, 16);
+ *
+ *   // in any thread
+ *   qdb_t *db = pool->get(pool, 1000);
+ *   qdbstmt_t *stmt = db->prepare(db, "SELECT name FROM City WHERE id = ?");
+ *   stmt->bind_int(stmt, 1, 1234);
+ *   qdbresult_t *result = stmt->execute_query(stmt);
+ *   if (result != NULL) {
+ *     while (result->getnext(result) == true) {
+ *       printf("City : %s\n", result->getstr(result, "name"));
+ *     }
+ *     result->free(result);
+ *   }
+ *   stmt->free(stmt);
+ *   pool->release(pool, db);
+ *
+ *   pool->free(pool);
+ * @endcode
  */
 
 #ifndef DISABLE_QDATABASE
@@ -81,6 +106,9 @@
 
 #ifdef ENABLE_MYSQL
 #include "mysql.h"
+#ifdef MYSQL_H
+typedef bool my_bool;  /* dropped for bool since MySQL 8.0 */
+#endif
 /* mysql specific connector options */
 #define Q_MYSQL_OPT_RECONNECT          (1)
 #define Q_MYSQL_OPT_CONNECT_TIMEOUT    (10)
@@ -93,6 +121,9 @@
 #include <stdbool.h>
 #include <stdarg.h>
 #include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <time.h>
 #include "qinternal.h"
 #include "extensions/qdatabase.h"
 
@@ -106,8 +137,10 @@ static bool close_(qdb_t *db);
 
 static int execute_update(qdb_t *db, const char *query);
 static int execute_updatef(qdb_t *db, const char *format, ...);
+static int execute_batch(qdb_t *db, const char *queries[], int num);
 static qdbresult_t *execute_query(qdb_t *db, const char *query);
 static qdbresult_t *execute_queryf(qdb_t *db, const char *format, ...);
+static qdbstmt_t *prepare(qdb_t *db, const char *query);
 
 static bool begin_tran(qdb_t *db);
 static bool commit(qdb_t *db);
@@ -129,9 +162,120 @@ static bool _resultGetNext(qdbresult_t *result);
 static int result_get_cols(qdbresult_t *result);
 static int result_get_rows(qdbresult_t *result);
 static int result_get_row(qdbresult_t *result);
+static int result_get_col_idx(qdbresult_t *result, const char *field);
+
+static int result_getbatch(qdbresult_t *result, int maxrows);
+static const char **result_get_batch_col(qdbresult_t *result, int idx,
+                                         const unsigned long **lengths);
 
 static void result_free(qdbresult_t *result);
 
+// qdbstmt_t object
+static bool stmt_bind_str(qdbstmt_t *stmt, int idx, const char *str);
+static bool stmt_bind_int(qdbstmt_t *stmt, int idx, int64_t num);
+static bool stmt_bind_null(qdbstmt_t *stmt, int idx);
+static int stmt_execute_update(qdbstmt_t *stmt);
+static qdbresult_t *stmt_execute_query(qdbstmt_t *stmt);
+static void stmt_free(qdbstmt_t *stmt);
+
+// qdbpool_t object
+static qdb_t *pool_get(qdbpool_t *pool, int timeoutms);
+static bool pool_release(qdbpool_t *pool, qdb_t *db);
+static int pool_size(qdbpool_t *pool);
+static bool pool_submit_query(qdbpool_t *pool, const char *query,
+                              qdbpool_query_cb_t cb, void *userdata);
+static bool pool_submit_update(qdbpool_t *pool, const char *query,
+                               qdbpool_update_cb_t cb, void *userdata);
+static bool pool_drain(qdbpool_t *pool, int timeoutms);
+static void pool_free(qdbpool_t *pool);
+
+// internal
+#ifdef Q_ENABLE_MYSQL
+static void library_init(void);
+static bool stmt_execute(qdbstmt_t *stmt);
+static bool result_refetch(qdbresult_t *result);
+static bool result_build_colmap(qdbresult_t *result);
+static unsigned long result_col_length(qdbresult_t *result, int i);
+static uint32_t colname_hash(const char *name);
+#endif
+static qdb_t *pool_connect(qdbpool_t *pool);
+static struct qdbpool_wait_s *pool_wait_new(void);
+static bool pool_submit(qdbpool_t *pool, const char *query, bool update,
+                        qdbpool_query_cb_t querycb,
+                        qdbpool_update_cb_t updatecb, void *userdata);
+static void *pool_worker(void *arg);
+
+#ifdef Q_ENABLE_MYSQL
+/* a bound parameter of a prepared statement */
+struct qdbstmt_value_s {
+    long long num;
+    char *str;
+    unsigned long length;
+};
+
+/* rows of a batch, stored column by column */
+struct qdbresult_batch_s {
+    char *data;              /* values of all the rows, NUL terminated */
+    size_t datasize;
+    size_t *offsets;         /* cols * maxrows, (size_t)-1 for NULL */
+    const char **values;     /* cols * maxrows */
+    unsigned long *lengths;  /* cols * maxrows */
+    int maxrows;
+    int rows;
+};
+
+/* a column buffer of a prepared statement result */
+struct qdbresult_column_s {
+    char *buf;
+    unsigned long bufsize;
+    unsigned long length;
+    my_bool isnull;
+    my_bool truncated;
+};
+
+static pthread_once_t library_once = PTHREAD_ONCE_INIT;
+static bool library_ready = false;
+#endif
+
+/* a connection slot of the pool */
+enum {
+    POOL_CONN_FREE = 0,
+    POOL_CONN_OPENING,
+    POOL_CONN_IDLE,
+    POOL_CONN_BUSY
+};
+
+struct qdbpool_conn_s {
+    qdb_t *db;
+    int state;
+    time_t lastused;
+};
+
+/* a query waiting for an async worker */
+struct qdbpool_job_s {
+    char *query;
+    bool update;
+    qdbpool_query_cb_t querycb;
+    qdbpool_update_cb_t updatecb;
+    void *userdata;
+    struct qdbpool_job_s *next;
+};
+
+struct qdbpool_wait_s {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;       /* a connection is released */
+
+    // async workers, started by the first submit
+    pthread_cond_t jobcond;    /* a job is submitted or stopping */
+    pthread_cond_t donecond;   /* all the jobs are done */
+    struct qdbpool_job_s *head;
+    struct qdbpool_job_s *tail;
+    int pending;               /* submitted and not finished */
+    pthread_t *workers;
+    int nworkers;
+    bool stopping;
+};
+
 #endif
 
 /**
@@ -203,8 +347,10 @@ qdb_t *qdb(const char *dbtype, const char *addr, int port, const char *username,
 
     db->execute_update = execute_update;
     db->execute_updatef = execute_updatef;
+    db->execute_batch = execute_batch;
     db->execute_query = execute_query;
     db->execute_queryf = execute_queryf;
+    db->prepare = prepare;
 
     db->begin_tran = begin_tran;
     db->commit = commit;
@@ -244,7 +390,10 @@ static bool open_(qdb_t *db)
     // initialize handler
     if (db->mysql != NULL) close_(db);
 
-    if (mysql_library_init(0, NULL, NULL) != 0) {
+    // the library is initialized once, as connections of a pool come and go
+    // in different threads.
+    pthread_once(&library_once, library_init);
+    if (library_ready == false) {
         Q_MUTEX_LEAVE(db->qmutex);
         return false;
     }
@@ -330,7 +479,6 @@ static bool close_(qdb_t *db)
     if (db->mysql != NULL) {
         mysql_close(db->mysql);
         db->mysql = NULL;
-        mysql_library_end();
     }
     db->connected = false;
 
@@ -392,6 +540,91 @@ static int execute_updatef(qdb_t *db, const char *format, ...)
     return affected;
 }
 
+/**
+ * qdb->execute_batch(): Executes many update DMLs in one round-trip
+ *
+ * @param db        a pointer of qdb_t object
+ * @param queries   array of query strings
+ * @param num       number of queries
+ *
+ * @return the total number of affected rows, otherwise returns -1
+ *
+ * @code
+ *   const char *queries[] = {
+ *     "INSERT INTO t VALUES (1, 'a')",
+ *     "INSERT INTO t VALUES (2, 'b')",
+ *     "UPDATE c SET n = n + 2"
+ *   };
+ *   db->begin_tran(db);
+ *   if (db->execute_batch(db, queries, 3) < 0) {
+ *     db->rollback(db);
+ *   } else {
+ *     db->commit(db);
+ *   }
+ * @endcode
+ *
+ * @note
+ *  The queries are sent as one multi-statement request, and the server runs
+ *  them in order. It stops at the first failed query, so run the batch in a
+ *  transaction to apply all or nothing. Multi-statement mode is turned on
+ *  only for the batch. Never put untrusted input in the queries without
+ *  escaping.
+ */
+static int execute_batch(qdb_t *db, const char *queries[], int num)
+{
+    if (db == NULL || db->connected == false || queries == NULL || num <= 0) {
+        return -1;
+    }
+
+#ifdef Q_ENABLE_MYSQL
+    // join the queries
+    size_t size = 1;
+    int i;
+    for (i = 0; i < num; i++) {
+        size += strlen(queries[i]) + 1;
+    }
+    char *query = (char *)malloc(size);
+    if (query == NULL) return -1;
+    char *qp = query;
+    for (i = 0; i < num; i++) {
+        size_t len = strlen(queries[i]);
+        memcpy(qp, queries[i], len);
+        qp += len;
+        *qp++ = ';';
+    }
+    *qp = '\0';
+
+    Q_MUTEX_ENTER(db->qmutex);
+
+    int affected = -1;
+    DEBUG("%s", query);
+    if (mysql_set_server_option(db->mysql, MYSQL_OPTION_MULTI_STATEMENTS_ON)
+            == 0) {
+        if (mysql_query(db->mysql, query) == 0) {
+            // collect the result of every statement
+            affected = 0;
+            int ret;
+            do {
+                MYSQL_RES *rs = mysql_store_result(db->mysql);
+                if (rs != NULL) {
+                    mysql_free_result(rs);
+                } else if (mysql_field_count(db->mysql) == 0) {
+                    affected += (int)mysql_affected_rows(db->mysql);
+                }
+            } while ((ret = mysql_next_result(db->mysql)) == 0);
+            if (ret > 0) affected = -1;  // a statement failed
+        }
+        mysql_set_server_option(db->mysql, MYSQL_OPTION_MULTI_STATEMENTS_OFF);
+    }
+
+    Q_MUTEX_LEAVE(db->qmutex);
+    free(query);
+    return affected;
+#else
+    return -1;
+#endif
+}
+
 /**
  * qdb->execute_query(): Executes the query
  *
@@ -429,17 +662,27 @@ static qdbresult_t *execute_query(qdb_t *db, const char *query)
     result->row = NULL;
     result->cols = mysql_num_fields(result->rs);
     result->cursor = 0;
+    result->stmt = NULL;
+    result->binds = NULL;
+    result->columns = NULL;
+    result->colmap = NULL;
+    result->colmapsize = 0;
+    result->batch = NULL;
 
     /* assign methods */
-    result->get_str = _resultGetStr;
+    result->getstr = _resultGetStr;
     result->get_str_at = _resultGetStrAt;
-    result->get_int = _resultGetInt;
+    result->getint = _resultGetInt;
     result->get_int_at = _resultGetIntAt;
-    result->get_next = _resultGetNext;
+    result->getnext = _resultGetNext;
 
     result->get_cols = result_get_cols;
     result->get_rows = result_get_rows;
     result->get_row = result_get_row;
+    result->get_col_idx = result_get_col_idx;
+
+    result->getbatch = result_getbatch;
+    result->get_batch_col = result_get_batch_col;
 
     result->free = result_free;
 
@@ -468,6 +711,88 @@ static qdbresult_t *execute_queryf(qdb_t *db, const char *format, ...)
     return ret;
 }
 
+/**
+ * qdb->prepare(): Prepare a statement to execute repeatedly
+ *
+ * @param db        a pointer of qdb_t object
+ * @param query     query string with '?' placeholders for parameters
+ *
+ * @return a pointer of qdbstmt_t if successful, otherwise returns NULL
+ *
+ * @code
+ *   qdbstmt_t *stmt = db->prepare(db, "UPDATE t SET v = ? WHERE k = ?");
+ *   stmt->bind_str(stmt, 1, "value");
+ *   stmt->bind_int(stmt, 2, 100);
+ *   int affected = stmt->execute_update(stmt);
+ *   stmt->free(stmt);
+ * @endcode
+ *
+ * @note
+ *  The query is parsed by the server only once, and parameters are sent in
+ *  binary without quoting or escaping. A statement belongs to the connection
+ *  and must be prepared again after the connection is re-opened.
+ */
+static qdbstmt_t *prepare(qdb_t *db, const char *query)
+{
+    if (db == NULL || db->connected == false || query == NULL) return NULL;
+
+#ifdef Q_ENABLE_MYSQL
+    Q_MUTEX_ENTER(db->qmutex);
+
+    DEBUG("%s", query);
+    MYSQL_STMT *mstmt = mysql_stmt_init(db->mysql);
+    if (mstmt == NULL) {
+        Q_MUTEX_LEAVE(db->qmutex);
+        return NULL;
+    }
+    if (mysql_stmt_prepare(mstmt, query, strlen(query)) != 0) {
+        mysql_stmt_close(mstmt);
+        Q_MUTEX_LEAVE(db->qmutex);
+        return NULL;
+    }
+
+    int nparams = mysql_stmt_param_count(mstmt);
+    qdbstmt_t *stmt = (qdbstmt_t *)calloc(1, sizeof(qdbstmt_t));
+    if (stmt != NULL) {
+        // one more, not to allocate zero bytes
+        stmt->params = (MYSQL_BIND *)calloc(nparams + 1, sizeof(MYSQL_BIND));
+        stmt->values = calloc(nparams + 1, sizeof(struct qdbstmt_value_s));
+    }
+    if (stmt == NULL || stmt->params == NULL || stmt->values == NULL) {
+        if (stmt != NULL) {
+            free(stmt->params);
+            free(stmt->values);
+            free(stmt);
+        }
+        mysql_stmt_close(mstmt);
+        Q_MUTEX_LEAVE(db->qmutex);
+        return NULL;
+    }
+
+    // parameters are NULL until bound
+    int i;
+    for (i = 0; i < nparams; i++) {
+        stmt->params[i].buffer_type = MYSQL_TYPE_NULL;
+    }
+    stmt->db = db;
+    stmt->nparams = nparams;
+    stmt->stmt = mstmt;
+
+    /* assign methods */
+    stmt->bind_str = stmt_bind_str;
+    stmt->bind_int = stmt_bind_int;
+    stmt->bind_null = stmt_bind_null;
+    stmt->execute_update = stmt_execute_update;
+    stmt->execute_query = stmt_execute_query;
+    stmt->free = stmt_free;
+
+    Q_MUTEX_LEAVE(db->qmutex);
+    return stmt;
+#else
+    return NULL;
+#endif
+}
+
 /**
  * qdb->begin_tran(): Start transaction
  *
@@ -487,18 +812,16 @@ static bool begin_tran(qdb_t *db)
 
 #ifdef Q_ENABLE_MYSQL
     Q_MUTEX_ENTER(db->qmutex);
-    if (db->qmutex.count != 1) {
+    if (((qmutex_t *)db->qmutex)->count != 1) {
         Q_MUTEX_LEAVE(db->qmutex);
         return false;
     }
 
-    qdbresult_t *result;
-    result = db->execute_query(db, "START TRANSACTION");
-    if (result == NULL) {
+    // no result set to store, so not by execute_query()
+    if (db->execute_update(db, "START TRANSACTION") < 0) {
         Q_MUTEX_LEAVE(db->qmutex);
         return false;
     }
-    result->free(result);
     return true;
 #else
     return false;
@@ -522,7 +845,7 @@ static bool commit(qdb_t *db)
         ret = true;
     }
 
-    if (db->qmutex.count > 0) {
+    if (((qmutex_t *)db->qmutex)->count > 0) {
         Q_MUTEX_LEAVE(db->qmutex);
     }
     return ret;
@@ -548,7 +871,7 @@ static bool rollback(qdb_t *db)
         ret = true;
     }
 
-    if (db->qmutex.count > 0) {
+    if (((qmutex_t *)db->qmutex)->count > 0) {
         Q_MUTEX_LEAVE(db->qmutex);
     }
     return ret;
@@ -569,7 +892,7 @@ static bool rollback(qdb_t *db)
  * @note
  *  If qdb->set_fetchtype(db, true) is called, the results does not
  *  actually read into the client. Instead, each row must be retrieved
- *  individually by making calls to qdbresult->get_next().
+ *  individually by making calls to qdbresult->getnext().
  *  This reads the result of a query directly from the server without storing
  *  it in local buffer, which is somewhat faster and uses much less memory than
  *  default behavior qdb->set_fetchtype(db, false).
@@ -676,16 +999,16 @@ static void free_(qdb_t *db)
     free(db->info.username);
     free(db->info.password);
     free(db->info.database);
-    free(db);
 
     Q_MUTEX_LEAVE(db->qmutex);
     Q_MUTEX_DESTROY(db->qmutex);
+    free(db);
 
     return;
 }
 
 /**
- * qdbresult->get_str(): Get the result as string by field name
+ * qdbresult->getstr(): Get the result as string by field name
  *
  * @param result    a pointer of qdbresult_t
  * @param field     column name
@@ -698,18 +1021,9 @@ static void free_(qdb_t *db)
 static const char *_resultGetStr(qdbresult_t *result, const char *field)
 {
 #ifdef Q_ENABLE_MYSQL
-    if (result == NULL || result->rs == NULL || result->cols <= 0) return NULL;
-
-    if (result->fields == NULL) result->fields = mysql_fetch_fields(result->rs);
-
-    int i;
-    for (i = 0; i < result->cols; i++) {
-        if (!strcasecmp(result->fields[i].name, field)) {
-            return result->get_str_at(result, i + 1);
-        }
-    }
-
-    return NULL;
+    int idx = result_get_col_idx(result, field);
+    if (idx <= 0) return NULL;
+    return result->get_str_at(result, idx);
 #else
     return NULL;
 #endif
@@ -733,6 +1047,11 @@ static const char *_resultGetStrAt(qdbresult_t *result, int idx)
             || idx > result->cols ) {
         return NULL;
     }
+    if (result->stmt != NULL) {
+        struct qdbresult_column_s *column =
+                &((struct qdbresult_column_s *)result->columns)[idx-1];
+        return (column->isnull) ? NULL : column->buf;
+    }
     return result->row[idx-1];
 #else
     return NULL;
@@ -740,7 +1059,7 @@ static const char *_resultGetStrAt(qdbresult_t *result, int idx)
 }
 
 /**
- * qdbresult->get_int(): Get the result as integer by field name
+ * qdbresult->getint(): Get the result as integer by field name
  *
  * @param result    a pointer of qdbresult_t
  * @param field     column name
@@ -749,7 +1068,7 @@ static const char *_resultGetStrAt(qdbresult_t *result, int idx)
  */
 static int _resultGetInt(qdbresult_t *result, const char *field)
 {
-    const char *val = result->get_str(result, field);
+    const char *val = result->getstr(result, field);
     if (val == NULL) return 0;
     return atoi(val);
 }
@@ -770,7 +1089,7 @@ static int _resultGetIntAt(qdbresult_t *result, int idx)
 }
 
 /**
- * qdbresult->get_next(): Retrieves the next row of a result set
+ * qdbresult->getnext(): Retrieves the next row of a result set
  *
  * @param result    a pointer of qdbresult_t
  *
@@ -781,6 +1100,26 @@ static bool _resultGetNext(qdbresult_t *result)
 #ifdef Q_ENABLE_MYSQL
     if (result == NULL || result->rs == NULL) return false;
 
+    if (result->stmt != NULL) {
+        int ret = mysql_stmt_fetch(result->stmt);
+        if (ret == MYSQL_DATA_TRUNCATED) {
+            if (result_refetch(result) == false) return false;
+        } else if (ret != 0) {
+            return false;
+        }
+
+        // there is always a spare byte in the buffers
+        struct qdbresult_column_s *columns = result->columns;
+        int i;
+        for (i = 0; i < result->cols; i++) {
+            if (columns[i].isnull == false) {
+                columns[i].buf[columns[i].length] = '\0';
+            }
+        }
+        result->cursor++;
+        return true;
+    }
+
     if ((result->row = mysql_fetch_row(result->rs)) == NULL) return false;
     result->cursor++;
 
@@ -818,6 +1157,7 @@ static int result_get_rows(qdbresult_t *result)
 {
 #ifdef Q_ENABLE_MYSQL
     if (result == NULL || result->rs == NULL) return 0;
+    if (result->stmt != NULL) return mysql_stmt_num_rows(result->stmt);
     return mysql_num_rows(result->rs);
 #else
     return 0;
@@ -844,6 +1184,183 @@ static int result_get_row(qdbresult_t *result)
 #endif
 }
 
+/**
+ * qdbresult->get_col_idx(): Get the column number of a field name
+ *
+ * @param result    a pointer of qdbresult_t
+ * @param field     column name, case-insensitive
+ *
+ * @return column number (first column is 1) if found, otherwise returns 0
+ *
+ * @note
+ *  A hash map of the column names is built on the first lookup, so the
+ *  lookups by name don't scan the columns for every row.
+ */
+static int result_get_col_idx(qdbresult_t *result, const char *field)
+{
+#ifdef Q_ENABLE_MYSQL
+    if (result == NULL || result->rs == NULL || result->cols <= 0
+            || field == NULL) {
+        return 0;
+    }
+
+    if (result->colmap == NULL && result_build_colmap(result) == false) {
+        return 0;
+    }
+
+    int mask = result->colmapsize - 1;
+    int i;
+    for (i = colname_hash(field) & mask; result->colmap[i] != 0;
+            i = (i + 1) & mask) {
+        int idx = result->colmap[i];
+        if (!strcasecmp(result->fields[idx - 1].name, field)) {
+            return idx;
+        }
+    }
+
+    return 0;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * qdbresult->getbatch(): Retrieves the next rows of a result set at once
+ *
+ * @param result    a pointer of qdbresult_t
+ * @param maxrows   maximum number of rows to retrieve
+ *
+ * @return the number of rows retrieved, 0 if no more rows are left,
+ *         otherwise returns -1.
+ *
+ * @code
+ *   db->set_fetchtype(db, true);  // stream rows from the server
+ *   qdbresult_t *result = db->execute_query(db, "SELECT id, name FROM t");
+ *   int idx = result->get_col_idx(result, "name");
+ *   int rows;
+ *   while ((rows = result->getbatch(result, 1000)) > 0) {
+ *     const unsigned long *lengths;
+ *     const char **names = result->get_batch_col(result, idx, &lengths);
+ *     int i;
+ *     for (i = 0; i < rows; i++) {
+ *       (...names[i] of lengths[i] bytes...)
+ *     }
+ *   }
+ *   result->free(result);
+ * @endcode
+ *
+ * @note
+ *  The rows are copied into a buffer reused by the next batch, so memory
+ *  is bounded by the batch size when the result is fetched directly from
+ *  the server with qdb->set_fetchtype(db, true).
+ */
+static int result_getbatch(qdbresult_t *result, int maxrows)
+{
+#ifdef Q_ENABLE_MYSQL
+    if (result == NULL || result->rs == NULL || maxrows <= 0) return -1;
+
+    struct qdbresult_batch_s *batch = result->batch;
+    if (batch == NULL) {
+        batch = (struct qdbresult_batch_s *)calloc(1,
+                sizeof(struct qdbresult_batch_s));
+        if (batch == NULL) return -1;
+        result->batch = batch;
+    }
+    if (batch->maxrows < maxrows) {
+        size_t num = (size_t)result->cols * maxrows;
+        size_t *offsets = (size_t *)realloc(batch->offsets,
+                                            num * sizeof(size_t));
+        if (offsets != NULL) batch->offsets = offsets;
+        const char **values = (const char **)realloc(batch->values,
+                num * sizeof(char *));
+        if (values != NULL) batch->values = values;
+        unsigned long *lengths = (unsigned long *)realloc(batch->lengths,
+                num * sizeof(unsigned long));
+        if (lengths != NULL) batch->lengths = lengths;
+        if (offsets == NULL || values == NULL || lengths == NULL) return -1;
+        batch->maxrows = maxrows;
+    }
+
+    // copy the values, and point them after the buffer stops moving
+    size_t used = 0;
+    int rows, i;
+    for (rows = 0; rows < maxrows && result->getnext(result) == true;
+            rows++) {
+        for (i = 0; i < result->cols; i++) {
+            size_t n = (size_t)i * maxrows + rows;
+            const char *value = result->get_str_at(result, i + 1);
+            if (value == NULL) {
+                batch->offsets[n] = (size_t)-1;
+                batch->lengths[n] = 0;
+                continue;
+            }
+
+            unsigned long length = result_col_length(result, i);
+            if (used + length + 1 > batch->datasize) {
+                size_t datasize = (batch->datasize > 0) ?
+                        batch->datasize * 2 : 4096;
+                while (used + length + 1 > datasize) datasize *= 2;
+                char *data = (char *)realloc(batch->data, datasize);
+                if (data == NULL) return -1;
+                batch->data = data;
+                batch->datasize = datasize;
+            }
+            memcpy(batch->data + used, value, length);
+            batch->data[used + length] = '\0';
+            batch->offsets[n] = used;
+            batch->lengths[n] = length;
+            used += length + 1;
+        }
+    }
+
+    int r;
+    for (i = 0; i < result->cols; i++) {
+        for (r = 0; r < rows; r++) {
+            size_t n = (size_t)i * maxrows + r;
+            batch->values[n] = (batch->offsets[n] == (size_t)-1) ?
+                    NULL : batch->data + batch->offsets[n];
+        }
+    }
+    batch->rows = rows;
+    batch->maxrows = maxrows;
+
+    return rows;
+#else
+    return -1;
+#endif
+}
+
+/**
+ * qdbresult->get_batch_col(): Get a column of the rows of the last batch
+ *
+ * @param result    a pointer of qdbresult_t
+ * @param idx       column number (first column is 1)
+ * @param lengths   if not NULL, the array of value lengths will be stored
+ *
+ * @return an array of the values of the rows, NULL for SQL NULL values.
+ *         Returns NULL if there is no batch or idx is out of range.
+ *
+ * @note
+ *  Do not free returned arrays, which are valid until the next batch.
+ */
+static const char **result_get_batch_col(qdbresult_t *result, int idx,
+                                         const unsigned long **lengths)
+{
+#ifdef Q_ENABLE_MYSQL
+    if (result == NULL || result->batch == NULL
+            || idx <= 0 || idx > result->cols) {
+        return NULL;
+    }
+
+    struct qdbresult_batch_s *batch = result->batch;
+    size_t n = (size_t)(idx - 1) * batch->maxrows;
+    if (lengths != NULL) *lengths = batch->lengths + n;
+    return batch->values + n;
+#else
+    return NULL;
+#endif
+}
+
 /**
  * qdbresult->free(): De-allocate the result
  *
@@ -853,6 +1370,29 @@ static void result_free(qdbresult_t *result)
 {
 #ifdef Q_ENABLE_MYSQL
     if (result == NULL) return;
+    free(result->colmap);
+    if (result->batch != NULL) {
+        struct qdbresult_batch_s *batch = result->batch;
+        free(batch->data);
+        free(batch->offsets);
+        free(batch->values);
+        free(batch->lengths);
+        free(batch);
+    }
+    if (result->stmt != NULL) {
+        // the statement stays, only its result set is released
+        struct qdbresult_column_s *columns = result->columns;
+        int i;
+        for (i = 0; columns != NULL && i < result->cols; i++) {
+            free(columns[i].buf);
+        }
+        free(result->columns);
+        free(result->binds);
+        mysql_stmt_free_result(result->stmt);
+        mysql_free_result(result->rs);
+        free(result);
+        return;
+    }
     if (result->rs != NULL) {
         if (result->fetchtype == true) {
             while (mysql_fetch_row(result->rs) != NULL);
@@ -867,6 +1407,918 @@ static void result_free(qdbresult_t *result)
 #endif
 }
 
+/**
+ * qdbstmt->bind_str(): Bind a string to a parameter
+ *
+ * @param stmt      a pointer of qdbstmt_t
+ * @param idx       parameter number (first parameter is 1)
+ * @param str       string value. NULL binds SQL NULL.
+ *
+ * @return true if successful, otherwise returns false.
+ *
+ * @note
+ *  The string is copied, so it doesn't need to be kept until execution.
+ *  Parameters stay bound across executions until they are bound again.
+ */
+static bool stmt_bind_str(qdbstmt_t *stmt, int idx, const char *str)
+{
+    if (stmt == NULL || idx <= 0 || idx > stmt->nparams) return false;
+    if (str == NULL) return stmt_bind_null(stmt, idx);
+
+#ifdef Q_ENABLE_MYSQL
+    struct qdbstmt_value_s *value =
+            &((struct qdbstmt_value_s *)stmt->values)[idx-1];
+    char *copy = strdup(str);
+    if (copy == NULL) return false;
+    free(value->str);
+    value->str = copy;
+    value->length = strlen(copy);
+
+    MYSQL_BIND *param = &stmt->params[idx-1];
+    memset((void *)param, 0, sizeof(MYSQL_BIND));
+    param->buffer_type = MYSQL_TYPE_STRING;
+    param->buffer = value->str;
+    param->buffer_length = value->length;
+    param->length = &value->length;
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * qdbstmt->bind_int(): Bind an integer to a parameter
+ *
+ * @param stmt      a pointer of qdbstmt_t
+ * @param idx       parameter number (first parameter is 1)
+ * @param num       integer value
+ *
+ * @return true if successful, otherwise returns false.
+ */
+static bool stmt_bind_int(qdbstmt_t *stmt, int idx, int64_t num)
+{
+    if (stmt == NULL || idx <= 0 || idx > stmt->nparams) return false;
+
+#ifdef Q_ENABLE_MYSQL
+    struct qdbstmt_value_s *value =
+            &((struct qdbstmt_value_s *)stmt->values)[idx-1];
+    value->num = num;
+
+    MYSQL_BIND *param = &stmt->params[idx-1];
+    memset((void *)param, 0, sizeof(MYSQL_BIND));
+    param->buffer_type = MYSQL_TYPE_LONGLONG;
+    param->buffer = &value->num;
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * qdbstmt->bind_null(): Bind SQL NULL to a parameter
+ *
+ * @param stmt      a pointer of qdbstmt_t
+ * @param idx       parameter number (first parameter is 1)
+ *
+ * @return true if successful, otherwise returns false.
+ */
+static bool stmt_bind_null(qdbstmt_t *stmt, int idx)
+{
+    if (stmt == NULL || idx <= 0 || idx > stmt->nparams) return false;
+
+#ifdef Q_ENABLE_MYSQL
+    MYSQL_BIND *param = &stmt->params[idx-1];
+    memset((void *)param, 0, sizeof(MYSQL_BIND));
+    param->buffer_type = MYSQL_TYPE_NULL;
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * qdbstmt->execute_update(): Executes the prepared update DML
+ *
+ * @param stmt      a pointer of qdbstmt_t
+ *
+ * @return a number of affected rows, otherwise returns -1
+ */
+static int stmt_execute_update(qdbstmt_t *stmt)
+{
+    if (stmt == NULL || stmt->db->connected == false) return -1;
+
+#ifdef Q_ENABLE_MYSQL
+    Q_MUTEX_ENTER(stmt->db->qmutex);
+
+    int affected = -1;
+    if (stmt_execute(stmt) == true) {
+        /* get affected rows */
+        if ((affected = mysql_stmt_affected_rows(stmt->stmt)) < 0) {
+            affected = -1;
+        }
+    }
+
+    Q_MUTEX_LEAVE(stmt->db->qmutex);
+    return affected;
+#else
+    return -1;
+#endif
+}
+
+/**
+ * qdbstmt->execute_query(): Executes the prepared query
+ *
+ * @param stmt      a pointer of qdbstmt_t
+ *
+ * @return a pointer of qdbresult_t if successful, otherwise returns NULL
+ *
+ * @note
+ *  Columns are fetched as strings like qdb->execute_query(). The result must
+ *  be freed before the statement is executed again.
+ */
+static qdbresult_t *stmt_execute_query(qdbstmt_t *stmt)
+{
+    if (stmt == NULL || stmt->db->connected == false) return NULL;
+
+#ifdef Q_ENABLE_MYSQL
+    Q_MUTEX_ENTER(stmt->db->qmutex);
+
+    MYSQL_RES *meta;
+    if (stmt_execute(stmt) == false
+            || (meta = mysql_stmt_result_metadata(stmt->stmt)) == NULL) {
+        Q_MUTEX_LEAVE(stmt->db->qmutex);
+        return NULL;
+    }
+
+    qdbresult_t *result = (qdbresult_t *)calloc(1, sizeof(qdbresult_t));
+    if (result == NULL) {
+        mysql_free_result(meta);
+        mysql_stmt_free_result(stmt->stmt);
+        Q_MUTEX_LEAVE(stmt->db->qmutex);
+        return NULL;
+    }
+    result->fetchtype = stmt->db->info.fetchtype;
+    result->rs = meta;
+    result->cols = mysql_num_fields(meta);
+    result->stmt = stmt->stmt;
+    result->binds = (MYSQL_BIND *)calloc(result->cols + 1, sizeof(MYSQL_BIND));
+    result->columns = calloc(result->cols + 1,
+                             sizeof(struct qdbresult_column_s));
+    if (result->binds == NULL || result->columns == NULL) {
+        result_free(result);
+        Q_MUTEX_LEAVE(stmt->db->qmutex);
+        return NULL;
+    }
+
+    // every column is fetched into a string buffer which grows as needed
+    struct qdbresult_column_s *columns = result->columns;
+    int i;
+    for (i = 0; i < result->cols; i++) {
+        columns[i].bufsize = 64;
+        if ((columns[i].buf = (char *)malloc(columns[i].bufsize)) == NULL) {
+            result_free(result);
+            Q_MUTEX_LEAVE(stmt->db->qmutex);
+            return NULL;
+        }
+        result->binds[i].buffer_type = MYSQL_TYPE_STRING;
+        result->binds[i].buffer = columns[i].buf;
+        result->binds[i].buffer_length = columns[i].bufsize - 1;
+        result->binds[i].length = &columns[i].length;
+        result->binds[i].is_null = &columns[i].isnull;
+        result->binds[i].error = &columns[i].truncated;
+    }
+    if (mysql_stmt_bind_result(stmt->stmt, result->binds) != 0
+            || (result->fetchtype == false
+                && mysql_stmt_store_result(stmt->stmt) != 0)) {
+        result_free(result);
+        Q_MUTEX_LEAVE(stmt->db->qmutex);
+        return NULL;
+    }
+
+    /* assign methods */
+    result->getstr = _resultGetStr;
+    result->get_str_at = _resultGetStrAt;
+    result->getint = _resultGetInt;
+    result->get_int_at = _resultGetIntAt;
+    result->getnext = _resultGetNext;
+
+    result->get_cols = result_get_cols;
+    result->get_rows = result_get_rows;
+    result->get_row = result_get_row;
+    result->get_col_idx = result_get_col_idx;
+
+    result->getbatch = result_getbatch;
+    result->get_batch_col = result_get_batch_col;
+
+    result->free = result_free;
+
+    Q_MUTEX_LEAVE(stmt->db->qmutex);
+    return result;
+#else
+    return NULL;
+#endif
+}
+
+/**
+ * qdbstmt->free(): Close the prepared statement
+ *
+ * @param stmt      a pointer of qdbstmt_t
+ */
+static void stmt_free(qdbstmt_t *stmt)
+{
+    if (stmt == NULL) return;
+
+#ifdef Q_ENABLE_MYSQL
+    Q_MUTEX_ENTER(stmt->db->qmutex);
+    mysql_stmt_close(stmt->stmt);
+    Q_MUTEX_LEAVE(stmt->db->qmutex);
+
+    struct qdbstmt_value_s *values = stmt->values;
+    int i;
+    for (i = 0; i < stmt->nparams; i++) {
+        free(values[i].str);
+    }
+    free(stmt->values);
+    free(stmt->params);
+#endif
+    free(stmt);
+}
+
+/**
+ * Initialize a pool of connections shared by threads
+ *
+ * @param dbtype    database server type. currently "MYSQL" is only supported
+ * @param addr      ip or fqdn address.
+ * @param port      port number
+ * @param username  database username
+ * @param password  database password
+ * @param database  database name
+ * @param autocommit sets autocommit mode of the connections
+ * @param minconns  number of connections to open now and keep opened
+ * @param maxconns  maximum number of connections
+ *
+ * @return a pointer of qdbpool_t object in case of successful,
+ *         otherwise returns NULL.
+ * @retval errno  will be set in error condition.
+ *  - EINVAL : Invalid arguments or not supported database type.
+ *  - ENOMEM : Memory allocation failure.
+ *  - ECONNREFUSED : Can't open the initial connections.
+ *
+ * @note
+ *  Connections are opened on demand up to maxconns. The ones idle longer
+ *  than QDBPOOL_PING_INTERVAL are checked with qdb->ping() before they are
+ *  handed out, which re-connects if the connection has gone down. The ones
+ *  idle longer than QDBPOOL_IDLE_TIMEOUT are closed down to minconns.
+ */
+qdbpool_t *qdbpool(const char *dbtype, const char *addr, int port,
+                   const char *username, const char *password,
+                   const char *database, bool autocommit, int minconns,
+                   int maxconns)
+{
+    if (minconns < 0 || maxconns < 1 || minconns > maxconns) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    qdbpool_t *pool = (qdbpool_t *)calloc(1, sizeof(qdbpool_t));
+    if (pool == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    pool->conf = qdb(dbtype, addr, port, username, password, database,
+                     autocommit);
+    if (pool->conf == NULL) {
+        free(pool);
+        errno = EINVAL;
+        return NULL;
+    }
+    pool->conns = (struct qdbpool_conn_s *)calloc(maxconns,
+            sizeof(struct qdbpool_conn_s));
+    pool->qwait = pool_wait_new();
+    pool->minconns = minconns;
+    pool->maxconns = maxconns;
+    if (pool->conns == NULL || pool->qwait == NULL) {
+        pool_free(pool);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    // open the minimum connections
+    int i;
+    for (i = 0; i < minconns; i++) {
+        qdb_t *db = pool_connect(pool);
+        if (db == NULL) {
+            pool_free(pool);
+            errno = ECONNREFUSED;
+            return NULL;
+        }
+        pool->conns[i].db = db;
+        pool->conns[i].state = POOL_CONN_IDLE;
+        pool->conns[i].lastused = time(NULL);
+        pool->numconns++;
+    }
+
+    // assign methods
+    pool->get = pool_get;
+    pool->release = pool_release;
+    pool->size = pool_size;
+    pool->submit_query = pool_submit_query;
+    pool->submit_update = pool_submit_update;
+    pool->drain = pool_drain;
+    pool->free = pool_free;
+
+    return pool;
+}
+
+/**
+ * qdbpool->get(): Borrow a connection from the pool
+ *
+ * @param pool      a pointer of qdbpool_t object
+ * @param timeoutms milliseconds to wait for a connection to be released
+ *                  when all are in use. 0 for no wait, -1 for infinite.
+ *
+ * @return a pointer of opened qdb_t object if successful,
+ *         otherwise returns NULL.
+ * @retval errno  will be set in error condition.
+ *  - EAGAIN : All the connections are in use and timeoutms is 0.
+ *  - ETIMEDOUT : All the connections are in use until timeoutms.
+ *  - ECONNREFUSED : Can't open a new connection.
+ *
+ * @note
+ *  The connection must be given back with qdbpool->release() and must not
+ *  be freed. The most recently used idle connection is given first, so the
+ *  rest can time out. Statements prepared on a connection don't survive a
+ *  re-connect, so prepare them for each use of a borrowed connection.
+ */
+static qdb_t *pool_get(qdbpool_t *pool, int timeoutms)
+{
+    if (pool == NULL) return NULL;
+
+    struct timespec deadline;
+    if (timeoutms > 0) {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += timeoutms / 1000;
+        deadline.tv_nsec += (timeoutms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+
+    struct qdbpool_wait_s *w = (struct qdbpool_wait_s *)pool->qwait;
+    pthread_mutex_lock(&w->mutex);
+    while (true) {
+        struct qdbpool_conn_s *conn = NULL, *freeconn = NULL;
+        int i;
+        for (i = 0; i < pool->maxconns; i++) {
+            struct qdbpool_conn_s *c = &pool->conns[i];
+            if (c->state == POOL_CONN_IDLE
+                    && (conn == NULL || c->lastused > conn->lastused)) {
+                conn = c;
+            } else if (c->state == POOL_CONN_FREE && freeconn == NULL) {
+                freeconn = c;
+            }
+        }
+
+        if (conn != NULL) {
+            conn->state = POOL_CONN_BUSY;
+            pthread_mutex_unlock(&w->mutex);
+
+            // health check, which re-connects if needed
+            if (time(NULL) - conn->lastused < QDBPOOL_PING_INTERVAL
+                    || conn->db->ping(conn->db) == true) {
+                return conn->db;
+            }
+
+            // can't recover, drop it and look again
+            DEBUG("Dropping a dead connection.");
+            conn->db->free(conn->db);
+            pthread_mutex_lock(&w->mutex);
+            conn->db = NULL;
+            conn->state = POOL_CONN_FREE;
+            pool->numconns--;
+            continue;
+        }
+
+        if (freeconn != NULL) {
+            freeconn->state = POOL_CONN_OPENING;
+            pool->numconns++;
+            pthread_mutex_unlock(&w->mutex);
+
+            qdb_t *db = pool_connect(pool);
+
+            pthread_mutex_lock(&w->mutex);
+            if (db == NULL) {
+                freeconn->state = POOL_CONN_FREE;
+                pool->numconns--;
+                pthread_cond_signal(&w->cond);
+                pthread_mutex_unlock(&w->mutex);
+                errno = ECONNREFUSED;
+                return NULL;
+            }
+            freeconn->db = db;
+            freeconn->state = POOL_CONN_BUSY;
+            pthread_mutex_unlock(&w->mutex);
+            return db;
+        }
+
+        // all in use, wait for a release
+        if (timeoutms == 0) {
+            errno = EAGAIN;
+            break;
+        }
+        int ret = (timeoutms > 0) ?
+                pthread_cond_timedwait(&w->cond, &w->mutex, &deadline) :
+                pthread_cond_wait(&w->cond, &w->mutex);
+        if (ret == ETIMEDOUT) {
+            errno = ETIMEDOUT;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&w->mutex);
+
+    return NULL;
+}
+
+/**
+ * qdbpool->release(): Give a connection back to the pool
+ *
+ * @param pool      a pointer of qdbpool_t object
+ * @param db        a pointer of qdb_t object from qdbpool->get()
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno  will be set in error condition.
+ *  - EINVAL : The connection is not from this pool.
+ *
+ * @note
+ *  Any transaction should be finished before release. Prepared statements
+ *  of the connection should be freed before release as well.
+ */
+static bool pool_release(qdbpool_t *pool, qdb_t *db)
+{
+    if (pool == NULL || db == NULL) return false;
+
+    struct qdbpool_wait_s *w = (struct qdbpool_wait_s *)pool->qwait;
+    time_t now = time(NULL);
+    qdb_t *expired = NULL;
+
+    pthread_mutex_lock(&w->mutex);
+    struct qdbpool_conn_s *conn = NULL;
+    int i;
+    for (i = 0; i < pool->maxconns; i++) {
+        struct qdbpool_conn_s *c = &pool->conns[i];
+        if (c->state == POOL_CONN_BUSY && c->db == db) {
+            conn = c;
+        } else if (c->state == POOL_CONN_IDLE && expired == NULL
+                && now - c->lastused >= QDBPOOL_IDLE_TIMEOUT
+                && pool->numconns > pool->minconns) {
+            // close one extra connection at a time
+            expired = c->db;
+            c->db = NULL;
+            c->state = POOL_CONN_FREE;
+            pool->numconns--;
+        }
+    }
+    if (conn != NULL) {
+        conn->state = POOL_CONN_IDLE;
+        conn->lastused = now;
+        pthread_cond_signal(&w->cond);
+    }
+    pthread_mutex_unlock(&w->mutex);
+
+    if (expired != NULL) {
+        expired->free(expired);
+    }
+    if (conn == NULL) {
+        errno = EINVAL;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * qdbpool->size(): Get the number of connections
+ *
+ * @param pool      a pointer of qdbpool_t object
+ *
+ * @return the number of opened connections, both in use and idle.
+ */
+static int pool_size(qdbpool_t *pool)
+{
+    if (pool == NULL) return 0;
+
+    struct qdbpool_wait_s *w = (struct qdbpool_wait_s *)pool->qwait;
+    pthread_mutex_lock(&w->mutex);
+    int num = pool->numconns;
+    pthread_mutex_unlock(&w->mutex);
+    return num;
+}
+
+/**
+ * qdbpool->submit_query(): Executes a query asynchronously
+ *
+ * @param pool      a pointer of qdbpool_t object
+ * @param query     query string
+ * @param cb        callback to call with the result, may be NULL
+ * @param userdata  user data to pass to the callback
+ *
+ * @return true if the query is queued, otherwise returns false.
+ * @retval errno  will be set in error condition.
+ *  - EINVAL : Invalid arguments.
+ *  - ENOMEM : Memory allocation failure.
+ *  - EAGAIN : Can't start the workers.
+ *
+ * @code
+ *   static void on_result(qdb_t *db, qdbresult_t *result, void *userdata) {
+ *     if (result == NULL) {
+ *       printf("ERROR: %s\n", (db != NULL) ? db->get_error(db, NULL) : "");
+ *       return;
+ *     }
+ *     while (result->getnext(result) == true) {
+ *       (...)
+ *     }
+ *   }
+ *
+ *   pool->submit_query(pool, "SELECT * FROM t", on_result, NULL);
+ * @endcode
+ *
+ * @note
+ *  The queries are executed in the order of submission by as many worker
+ *  threads as maxconns of the pool, which are started by the first submit.
+ *  The callback is called in a worker thread with the connection used,
+ *  which is NULL if no connection could be opened. The result is NULL on
+ *  error, and is freed after the callback returns.
+ */
+static bool pool_submit_query(qdbpool_t *pool, const char *query,
+                              qdbpool_query_cb_t cb, void *userdata)
+{
+    return pool_submit(pool, query, false, cb, NULL, userdata);
+}
+
+/**
+ * qdbpool->submit_update(): Executes an update DML asynchronously
+ *
+ * @param pool      a pointer of qdbpool_t object
+ * @param query     query string
+ * @param cb        callback to call with the number of affected rows, which
+ *                  is -1 on error. May be NULL.
+ * @param userdata  user data to pass to the callback
+ *
+ * @return true if the query is queued, otherwise returns false.
+ * @retval errno  will be set in error condition.
+ *  - EINVAL : Invalid arguments.
+ *  - ENOMEM : Memory allocation failure.
+ *  - EAGAIN : Can't start the workers.
+ *
+ * @note
+ *  The callback is called in a worker thread like qdbpool->submit_query().
+ */
+static bool pool_submit_update(qdbpool_t *pool, const char *query,
+                               qdbpool_update_cb_t cb, void *userdata)
+{
+    return pool_submit(pool, query, true, NULL, cb, userdata);
+}
+
+/**
+ * qdbpool->drain(): Wait until all the submitted queries are done
+ *
+ * @param pool      a pointer of qdbpool_t object
+ * @param timeoutms milliseconds to wait, -1 for infinite.
+ *
+ * @return true if all done, otherwise returns false.
+ * @retval errno  will be set in error condition.
+ *  - ETIMEDOUT : Queries are still running until timeoutms.
+ */
+static bool pool_drain(qdbpool_t *pool, int timeoutms)
+{
+    if (pool == NULL) return false;
+
+    struct timespec deadline;
+    if (timeoutms > 0) {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += timeoutms / 1000;
+        deadline.tv_nsec += (timeoutms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+
+    struct qdbpool_wait_s *w = (struct qdbpool_wait_s *)pool->qwait;
+    bool done = true;
+    pthread_mutex_lock(&w->mutex);
+    while (w->pending > 0) {
+        int ret = 0;
+        if (timeoutms == 0) {
+            ret = ETIMEDOUT;
+        } else if (timeoutms > 0) {
+            ret = pthread_cond_timedwait(&w->donecond, &w->mutex, &deadline);
+        } else {
+            pthread_cond_wait(&w->donecond, &w->mutex);
+        }
+        if (ret == ETIMEDOUT && w->pending > 0) {
+            errno = ETIMEDOUT;
+            done = false;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&w->mutex);
+
+    return done;
+}
+
+/**
+ * qdbpool->free(): Close all the connections and de-allocate the pool
+ *
+ * @param pool      a pointer of qdbpool_t object
+ *
+ * @note
+ *  All the connections must be released before. Submitted queries are
+ *  finished before the workers stop.
+ */
+static void pool_free(qdbpool_t *pool)
+{
+    if (pool == NULL) return;
+
+    // stop the workers after the queued jobs
+    struct qdbpool_wait_s *w = (struct qdbpool_wait_s *)pool->qwait;
+    if (w != NULL && w->nworkers > 0) {
+        pthread_mutex_lock(&w->mutex);
+        w->stopping = true;
+        pthread_cond_broadcast(&w->jobcond);
+        pthread_mutex_unlock(&w->mutex);
+
+        int i;
+        for (i = 0; i < w->nworkers; i++) {
+            pthread_join(w->workers[i], NULL);
+        }
+    }
+
+    int i;
+    for (i = 0; pool->conns != NULL && i < pool->maxconns; i++) {
+        if (pool->conns[i].db != NULL) {
+            pool->conns[i].db->free(pool->conns[i].db);
+        }
+    }
+    if (pool->qwait != NULL) {
+        struct qdbpool_wait_s *w = (struct qdbpool_wait_s *)pool->qwait;
+        pthread_cond_destroy(&w->cond);
+        pthread_cond_destroy(&w->jobcond);
+        pthread_cond_destroy(&w->donecond);
+        pthread_mutex_destroy(&w->mutex);
+        free(w->workers);
+        free(w);
+    }
+    pool->conf->free(pool->conf);
+    free(pool->conns);
+    free(pool);
+}
+
+#ifndef _DOXYGEN_SKIP
+
+#ifdef Q_ENABLE_MYSQL
+static void library_init(void)
+{
+    library_ready = (mysql_library_init(0, NULL, NULL) == 0);
+}
+
+/* caller holds the lock of the connection */
+static bool stmt_execute(qdbstmt_t *stmt)
+{
+    if (mysql_stmt_bind_param(stmt->stmt, stmt->params) != 0
+            || mysql_stmt_execute(stmt->stmt) != 0) {
+        return false;
+    }
+    return true;
+}
+
+/* grow the buffers of truncated columns and fetch them again */
+static bool result_refetch(qdbresult_t *result)
+{
+    struct qdbresult_column_s *columns = result->columns;
+    int i;
+    for (i = 0; i < result->cols; i++) {
+        if (columns[i].truncated == false) continue;
+
+        char *buf = (char *)realloc(columns[i].buf, columns[i].length + 1);
+        if (buf == NULL) return false;
+        columns[i].buf = buf;
+        columns[i].bufsize = columns[i].length + 1;
+        result->binds[i].buffer = buf;
+        result->binds[i].buffer_length = columns[i].bufsize - 1;
+        if (mysql_stmt_fetch_column(result->stmt, &result->binds[i], i, 0)) {
+            return false;
+        }
+    }
+
+    // next rows are fetched into the grown buffers
+    return (mysql_stmt_bind_result(result->stmt, result->binds) == 0);
+}
+/* open addressing map of column names to column numbers */
+static bool result_build_colmap(qdbresult_t *result)
+{
+    if (result->fields == NULL) result->fields = mysql_fetch_fields(result->rs);
+    if (result->fields == NULL) return false;
+
+    int size = 4;
+    while (size < result->cols * 2) size *= 2;
+    int *colmap = (int *)calloc(size, sizeof(int));
+    if (colmap == NULL) return false;
+
+    int idx;
+    for (idx = 1; idx <= result->cols; idx++) {
+        int i = colname_hash(result->fields[idx - 1].name) & (size - 1);
+        while (colmap[i] != 0) {
+            // the first one wins for duplicated names, as by a scan
+            if (!strcasecmp(result->fields[colmap[i] - 1].name,
+                            result->fields[idx - 1].name)) {
+                break;
+            }
+            i = (i + 1) & (size - 1);
+        }
+        if (colmap[i] == 0) colmap[i] = idx;
+    }
+
+    result->colmap = colmap;
+    result->colmapsize = size;
+    return true;
+}
+
+/* length of a column of the current row */
+static unsigned long result_col_length(qdbresult_t *result, int i)
+{
+    if (result->stmt != NULL) {
+        return ((struct qdbresult_column_s *)result->columns)[i].length;
+    }
+    unsigned long *lengths = mysql_fetch_lengths(result->rs);
+    return (lengths != NULL) ? lengths[i] : strlen(result->row[i]);
+}
+
+/* case-insensitive FNV-1a */
+static uint32_t colname_hash(const char *name)
+{
+    uint32_t h = 2166136261U;
+    for (; *name != '\0'; name++) {
+        h ^= (unsigned char)tolower((unsigned char)*name);
+        h *= 16777619U;
+    }
+    return h;
+}
+#endif
+
+static qdb_t *pool_connect(qdbpool_t *pool)
+{
+    qdb_t *conf = pool->conf;
+    qdb_t *db = qdb(conf->info.dbtype, conf->info.addr, conf->info.port,
+                    conf->info.username, conf->info.password,
+                    conf->info.database, conf->info.autocommit);
+    if (db == NULL) return NULL;
+    db->set_fetchtype(db, conf->info.fetchtype);
+    if (db->open(db) == false) {
+        db->free(db);
+        return NULL;
+    }
+    return db;
+}
+
+static struct qdbpool_wait_s *pool_wait_new(void)
+{
+    struct qdbpool_wait_s *w;
+    w = (struct qdbpool_wait_s *)calloc(1, sizeof(struct qdbpool_wait_s));
+    if (w == NULL) return NULL;
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    int ret = pthread_cond_init(&w->cond, &attr);
+    if (ret == 0 && (ret = pthread_cond_init(&w->jobcond, &attr)) != 0) {
+        pthread_cond_destroy(&w->cond);
+    }
+    if (ret == 0 && (ret = pthread_cond_init(&w->donecond, &attr)) != 0) {
+        pthread_cond_destroy(&w->jobcond);
+        pthread_cond_destroy(&w->cond);
+    }
+    pthread_condattr_destroy(&attr);
+    if (ret != 0) {
+        free(w);
+        return NULL;
+    }
+    if (pthread_mutex_init(&w->mutex, NULL) != 0) {
+        pthread_cond_destroy(&w->donecond);
+        pthread_cond_destroy(&w->jobcond);
+        pthread_cond_destroy(&w->cond);
+        free(w);
+        return NULL;
+    }
+    return w;
+}
+
+static bool pool_submit(qdbpool_t *pool, const char *query, bool update,
+                        qdbpool_query_cb_t querycb,
+                        qdbpool_update_cb_t updatecb, void *userdata)
+{
+    if (pool == NULL || query == NULL) {
+        errno = EINVAL;
+        return false;
+    }
+
+    struct qdbpool_job_s *job;
+    job = (struct qdbpool_job_s *)calloc(1, sizeof(struct qdbpool_job_s));
+    if (job == NULL || (job->query = strdup(query)) == NULL) {
+        free(job);
+        errno = ENOMEM;
+        return false;
+    }
+    job->update = update;
+    job->querycb = querycb;
+    job->updatecb = updatecb;
+    job->userdata = userdata;
+
+    struct qdbpool_wait_s *w = (struct qdbpool_wait_s *)pool->qwait;
+    pthread_mutex_lock(&w->mutex);
+
+    // start the workers, one for each connection
+    if (w->workers == NULL) {
+        w->workers = (pthread_t *)calloc(pool->maxconns, sizeof(pthread_t));
+        while (w->workers != NULL && w->nworkers < pool->maxconns) {
+            if (pthread_create(&w->workers[w->nworkers], NULL, pool_worker,
+                               pool) != 0) {
+                break;
+            }
+            w->nworkers++;
+        }
+    }
+    if (w->nworkers == 0) {
+        free(w->workers);
+        w->workers = NULL;
+        pthread_mutex_unlock(&w->mutex);
+        free(job->query);
+        free(job);
+        errno = EAGAIN;
+        return false;
+    }
+
+    if (w->tail == NULL) {
+        w->head = job;
+    } else {
+        w->tail->next = job;
+    }
+    w->tail = job;
+    w->pending++;
+    pthread_cond_signal(&w->jobcond);
+    pthread_mutex_unlock(&w->mutex);
+
+    return true;
+}
+
+static void *pool_worker(void *arg)
+{
+    qdbpool_t *pool = (qdbpool_t *)arg;
+    struct qdbpool_wait_s *w = (struct qdbpool_wait_s *)pool->qwait;
+
+    pthread_mutex_lock(&w->mutex);
+    while (true) {
+        struct qdbpool_job_s *job = w->head;
+        if (job == NULL) {
+            if (w->stopping == true) break;
+            pthread_cond_wait(&w->jobcond, &w->mutex);
+            continue;
+        }
+        w->head = job->next;
+        if (w->head == NULL) w->tail = NULL;
+        pthread_mutex_unlock(&w->mutex);
+
+        qdb_t *db = pool_get(pool, -1);
+        if (job->update == false) {
+            qdbresult_t *result = NULL;
+            if (db != NULL) result = db->execute_query(db, job->query);
+            if (job->querycb != NULL) {
+                job->querycb(db, result, job->userdata);
+            }
+            if (result != NULL) result->free(result);
+        } else {
+            int affected = -1;
+            if (db != NULL) affected = db->execute_update(db, job->query);
+            if (job->updatecb != NULL) {
+                job->updatecb(db, affected, job->userdata);
+            }
+        }
+        if (db != NULL) pool_release(pool, db);
+        free(job->query);
+        free(job);
+
+        pthread_mutex_lock(&w->mutex);
+        if (--w->pending == 0) {
+            pthread_cond_broadcast(&w->donecond);
+        }
+    }
+    pthread_mutex_unlock(&w->mutex);
+
+    return NULL;
+}
+
+#endif /* _DOXYGEN_SKIP */
+
 #endif
 
 #endif /* DISABLE_QDATABASE */
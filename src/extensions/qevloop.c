@@ -0,0 +1,833 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/**
+ * @file qevloop.c Event loop implementation.
+ *
+ * qevloop drives many non-blocking descriptors and timers from a thread,
+ * instead of a thread blocking on each descriptor with qio_wait_readable().
+ * The backend is epoll on Linux and kqueue on BSD and macOS. Descriptors are
+ * level-triggered, the callback is called again while the condition lasts.
+ *
+ * A loop is not thread-safe and belongs to the thread running it, except
+ * stop() which can be called from anywhere. Run a loop per thread to use
+ * more cores.
+ *
+ * @code
+ *   static void on_read(qevloop_t *loop, int fd, int events, void *userdata) {
+ *       qio_reader_t *reader = (qio_reader_t *) userdata;
+ *       if ((events & QEVLOOP_ERROR) || qio_reader_fill(reader, 0) == 0) {
+ *           loop->remove(loop, fd);
+ *           close(fd);
+ *           qio_reader_free(reader);
+ *           return;
+ *       }
+ *       char line[1024];
+ *       while (qio_reader_hasline(reader)) {
+ *           qio_reader_gets(reader, line, sizeof(line), 0);
+ *           // handle the line
+ *       }
+ *   }
+ *
+ *   qevloop_t *loop = qevloop(0);
+ *   qio_reader_t *reader = qio_reader(sockfd, 0);
+ *   loop->add(loop, sockfd, QEVLOOP_READ, on_read, reader);
+ *   loop->setreader(loop, sockfd, reader);
+ *   loop->run(loop);
+ *   loop->free(loop);
+ * @endcode
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <errno.h>
+#if defined(__linux__)
+#include <sys/epoll.h>
+#define QEVLOOP_EPOLL
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__NetBSD__) \
+    || defined(__OpenBSD__) || defined(__DragonFly__)
+#include <sys/types.h>
+#include <sys/event.h>
+#include <sys/time.h>
+#define QEVLOOP_KQUEUE
+#endif
+#include "qinternal.h"
+#include "utilities/qio.h"
+#include "containers/qtimerwheel.h"
+#include "extensions/qevloop.h"
+
+#ifndef _DOXYGEN_SKIP
+
+typedef struct qevloop_handler_s qevloop_handler_t;
+struct qevloop_handler_s {
+    qevloop_cb_t cb;        /* NULL if not registered */
+    void *userdata;
+    int events;
+    qio_reader_t *reader;   /* buffered reader of the descriptor */
+    bool queued;            /* in the ready list */
+};
+
+typedef struct qevloop_timer_s qevloop_timer_t;
+struct qevloop_timer_s {
+    uint64_t expire;        /* monotonic milliseconds */
+    int intervalms;
+    int id;
+    bool repeat;
+    qevloop_timer_cb_t cb;
+    void *userdata;
+};
+
+static bool add(qevloop_t *loop, int fd, int events, qevloop_cb_t cb,
+                void *userdata);
+static bool modify(qevloop_t *loop, int fd, int events);
+static bool remove_(qevloop_t *loop, int fd);
+static bool setreader(qevloop_t *loop, int fd, qio_reader_t *reader);
+static int addtimer(qevloop_t *loop, int intervalms, bool repeat,
+                    qevloop_timer_cb_t cb, void *userdata);
+static bool removetimer(qevloop_t *loop, int timerid);
+static bool setwheel(qevloop_t *loop, qtimerwheel_t *wheel);
+static int once(qevloop_t *loop, int timeoutms);
+static bool run(qevloop_t *loop);
+static bool stop(qevloop_t *loop);
+static void free_(qevloop_t *loop);
+
+#ifdef QEVLOOP_EPOLL
+static bool epoll_set(qevloop_t *loop, int op, int fd, int events);
+#endif
+static bool backend_add(qevloop_t *loop, int fd, int events);
+static bool backend_mod(qevloop_t *loop, int fd, int oldevents, int events);
+static void backend_del(qevloop_t *loop, int fd, int oldevents);
+static int backend_wait(qevloop_t *loop, int timeoutms);
+static int backend_get(qevloop_t *loop, int idx, int *events);
+static qevloop_handler_t *get_handler(qevloop_t *loop, int fd);
+static uint64_t now_ms(void);
+static void heap_up(qevloop_t *loop, int idx);
+static void heap_down(qevloop_t *loop, int idx);
+static void heap_delete(qevloop_t *loop, int idx);
+static int dispatch_ready(qevloop_t *loop);
+static int dispatch_timers(qevloop_t *loop);
+
+#endif
+
+/**
+ * Create an event loop.
+ *
+ * @param maxevents  the number of events taken from the kernel at once,
+ *                   0 for QEVLOOP_MAXEVENTS.
+ *
+ * @return a pointer of qevloop_t if successful, otherwise returns NULL.
+ * @retval errno will be set in error condition.
+ *  - ENOMEM : Memory allocation failure.
+ *  - ENOTSUP : No epoll or kqueue on this system.
+ *  - Others : Errors of epoll_create() or kqueue().
+ *
+ * @code
+ *   qevloop_t *loop = qevloop(0);
+ * @endcode
+ */
+qevloop_t *qevloop(int maxevents) {
+#if !defined(QEVLOOP_EPOLL) && !defined(QEVLOOP_KQUEUE)
+    errno = ENOTSUP;
+    return NULL;
+#else
+    if (maxevents <= 0)
+        maxevents = QEVLOOP_MAXEVENTS;
+
+    qevloop_t *loop = (qevloop_t *) calloc(1, sizeof(qevloop_t));
+    if (loop == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    loop->wakeupfd[0] = loop->wakeupfd[1] = -1;
+    loop->maxevents = maxevents;
+#ifdef QEVLOOP_EPOLL
+    loop->events = malloc(sizeof(struct epoll_event) * maxevents);
+    loop->pollfd = epoll_create(maxevents);
+#else
+    loop->events = malloc(sizeof(struct kevent) * maxevents);
+    loop->pollfd = kqueue();
+#endif
+    if (loop->events == NULL || loop->pollfd < 0
+            || pipe(loop->wakeupfd) != 0) {
+        if (loop->events == NULL)
+            errno = ENOMEM;
+        free_(loop);
+        return NULL;
+    }
+    fcntl(loop->pollfd, F_SETFD, FD_CLOEXEC);
+    int i;
+    for (i = 0; i < 2; i++) {
+        fcntl(loop->wakeupfd[i], F_SETFD, FD_CLOEXEC);
+        fcntl(loop->wakeupfd[i], F_SETFL,
+              fcntl(loop->wakeupfd[i], F_GETFL) | O_NONBLOCK);
+    }
+    if (backend_add(loop, loop->wakeupfd[0], QEVLOOP_READ) == false) {
+        free_(loop);
+        return NULL;
+    }
+
+    // member methods
+    loop->add = add;
+    loop->modify = modify;
+    loop->remove = remove_;
+    loop->setreader = setreader;
+    loop->addtimer = addtimer;
+    loop->removetimer = removetimer;
+    loop->setwheel = setwheel;
+    loop->once = once;
+    loop->run = run;
+    loop->stop = stop;
+    loop->free = free_;
+
+    return loop;
+#endif
+}
+
+/**
+ * qevloop->add(): Watch a descriptor.
+ *
+ * @param loop      qevloop_t container pointer.
+ * @param fd        descriptor, it should be in non-blocking mode.
+ * @param events    QEVLOOP_READ and/or QEVLOOP_WRITE to watch.
+ * @param cb        callback called with the events occurred.
+ * @param userdata  user data pointer given to the callback.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - EEXIST : The descriptor is already watched.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @note
+ *  QEVLOOP_ERROR is given to the callback along with the watched events
+ *  on error or hang-up, whether or not it's asked.
+ */
+static bool add(qevloop_t *loop, int fd, int events, qevloop_cb_t cb,
+                void *userdata) {
+    if (fd < 0 || cb == NULL || fd == loop->wakeupfd[0]) {
+        errno = EINVAL;
+        return false;
+    }
+
+    // grow the handler table to hold the descriptor.
+    if (fd >= loop->numhandlers) {
+        int num = (loop->numhandlers > 0) ? loop->numhandlers : 64;
+        while (num <= fd)
+            num *= 2;
+        qevloop_handler_t *handlers = (qevloop_handler_t *) realloc(
+                loop->handlers, sizeof(qevloop_handler_t) * num);
+        if (handlers == NULL) {
+            errno = ENOMEM;
+            return false;
+        }
+        memset(handlers + loop->numhandlers, 0,
+               sizeof(qevloop_handler_t) * (num - loop->numhandlers));
+        loop->handlers = handlers;
+        loop->numhandlers = num;
+    }
+
+    qevloop_handler_t *handler = (qevloop_handler_t *) loop->handlers + fd;
+    if (handler->cb != NULL) {
+        errno = EEXIST;
+        return false;
+    }
+    events &= (QEVLOOP_READ | QEVLOOP_WRITE);
+    if (backend_add(loop, fd, events) == false)
+        return false;
+
+    handler->cb = cb;
+    handler->userdata = userdata;
+    handler->events = events;
+    handler->reader = NULL;
+    return true;
+}
+
+/**
+ * qevloop->modify(): Change the events to watch of a descriptor.
+ *
+ * @param loop      qevloop_t container pointer.
+ * @param fd        descriptor added.
+ * @param events    QEVLOOP_READ and/or QEVLOOP_WRITE, 0 to pause.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - ENOENT : The descriptor is not watched.
+ *
+ * @code
+ *   // output is queued, wait for the socket to be writable.
+ *   loop->modify(loop, fd, QEVLOOP_READ | QEVLOOP_WRITE);
+ * @endcode
+ */
+static bool modify(qevloop_t *loop, int fd, int events) {
+    qevloop_handler_t *handler = get_handler(loop, fd);
+    if (handler == NULL) {
+        errno = ENOENT;
+        return false;
+    }
+
+    events &= (QEVLOOP_READ | QEVLOOP_WRITE);
+    if (events == handler->events)
+        return true;
+    if (backend_mod(loop, fd, handler->events, events) == false)
+        return false;
+    handler->events = events;
+    return true;
+}
+
+/**
+ * qevloop->remove(): Stop watching a descriptor.
+ *
+ * @param loop      qevloop_t container pointer.
+ * @param fd        descriptor added.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - ENOENT : The descriptor is not watched.
+ *
+ * @note
+ *  Remove the descriptor before closing it. The callback can remove any
+ *  descriptor including its own.
+ */
+static bool remove_(qevloop_t *loop, int fd) {
+    qevloop_handler_t *handler = get_handler(loop, fd);
+    if (handler == NULL) {
+        errno = ENOENT;
+        return false;
+    }
+
+    // the descriptor could be closed already, it's gone from the kernel then.
+    backend_del(loop, fd, handler->events);
+    handler->cb = NULL;
+    handler->userdata = NULL;
+    handler->events = 0;
+    handler->reader = NULL;
+    return true;
+}
+
+/**
+ * qevloop->setreader(): Tell the buffered reader of a descriptor.
+ *
+ * A qio_reader_t may have read more than the callback took, and the kernel
+ * doesn't know about the data in the buffer. With the reader set, the read
+ * callback is called again while the reader has buffered data.
+ *
+ * @param loop      qevloop_t container pointer.
+ * @param fd        descriptor added.
+ * @param reader    qio_reader_t reading the descriptor, NULL to unset.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - ENOENT : The descriptor is not watched.
+ *
+ * @note
+ *  The callback must consume the buffered data, or get it off the reader
+ *  like by qio_reader_fill() when the line is not complete, otherwise it's
+ *  called again and again.
+ */
+static bool setreader(qevloop_t *loop, int fd, qio_reader_t *reader) {
+    qevloop_handler_t *handler = get_handler(loop, fd);
+    if (handler == NULL) {
+        errno = ENOENT;
+        return false;
+    }
+
+    handler->reader = reader;
+    return true;
+}
+
+/**
+ * qevloop->addtimer(): Add a timer.
+ *
+ * @param loop        qevloop_t container pointer.
+ * @param intervalms  milliseconds to expire.
+ * @param repeat      true to repeat at every interval, false for once.
+ * @param cb          callback called on expiry
+ * @param userdata    user data pointer given to the callback.
+ *
+ * @return a positive timer id if successful, otherwise returns -1.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @code
+ *   int timerid = loop->addtimer(loop, 1000, true, on_timer, NULL);
+ *   loop->removetimer(loop, timerid);
+ * @endcode
+ */
+static int addtimer(qevloop_t *loop, int intervalms, bool repeat,
+                    qevloop_timer_cb_t cb, void *userdata) {
+    if (intervalms < 0 || cb == NULL || (repeat == true && intervalms == 0)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (loop->numtimers == loop->maxtimers) {
+        int max = (loop->maxtimers > 0) ? loop->maxtimers * 2 : 16;
+        void *timers = realloc(loop->timers, sizeof(qevloop_timer_t) * max);
+        if (timers == NULL) {
+            errno = ENOMEM;
+            return -1;
+        }
+        loop->timers = timers;
+        loop->maxtimers = max;
+    }
+
+    if (loop->lasttimerid == INT32_MAX)
+        loop->lasttimerid = 0;
+    qevloop_timer_t *timer = (qevloop_timer_t *) loop->timers
+            + loop->numtimers;
+    timer->expire = now_ms() + intervalms;
+    timer->intervalms = intervalms;
+    timer->id = ++loop->lasttimerid;
+    timer->repeat = repeat;
+    timer->cb = cb;
+    timer->userdata = userdata;
+    heap_up(loop, loop->numtimers++);
+
+    return loop->lasttimerid;
+}
+
+/**
+ * qevloop->removetimer(): Remove a timer.
+ *
+ * @param loop      qevloop_t container pointer.
+ * @param timerid   timer id returned by addtimer().
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - ENOENT : No such timer, or it's expired already.
+ *
+ * @note
+ *  This takes linear time to the number of timers. For many timeouts which
+ *  are mostly cancelled, like one per connection, use a qtimerwheel with
+ *  setwheel().
+ */
+static bool removetimer(qevloop_t *loop, int timerid) {
+    qevloop_timer_t *timers = (qevloop_timer_t *) loop->timers;
+    int i;
+    for (i = 0; i < loop->numtimers; i++) {
+        if (timers[i].id == timerid) {
+            heap_delete(loop, i);
+            return true;
+        }
+    }
+
+    errno = ENOENT;
+    return false;
+}
+
+/**
+ * qevloop->setwheel(): Expire a timer wheel from the loop.
+ *
+ * The loop waits no longer than the next timeout of the wheel, and expires
+ * the wheel in every round. The wheel takes constant time to add and cancel
+ * a timer, so it suits a timeout per connection, while addtimer() suits a
+ * few periodic jobs.
+ *
+ * @param loop      qevloop_t container pointer.
+ * @param wheel     qtimerwheel_t container pointer, NULL to unset.
+ *                  It's not freed with the loop.
+ *
+ * @return true if successful, otherwise returns false.
+ *
+ * @code
+ *   qtimerwheel_t *wheel = qtimerwheel(10, 0);
+ *   loop->setwheel(loop, wheel);
+ *   conn->timerid = wheel->add(wheel, 30000, on_idle, conn);
+ *   loop->run(loop);
+ * @endcode
+ */
+static bool setwheel(qevloop_t *loop, qtimerwheel_t *wheel) {
+    loop->wheel = wheel;
+    return true;
+}
+
+/**
+ * qevloop->once(): Wait for events and call the callbacks once.
+ *
+ * @param loop      qevloop_t container pointer.
+ * @param timeoutms maximum milliseconds to wait, -1 for infinite wait.
+ *                  It's shortened to the next timer.
+ *
+ * @return the number of callbacks called, otherwise returns -1.
+ * @retval errno will be set in error condition.
+ *  - EINTR : Interrupted by a signal.
+ *  - Others : Errors of epoll_wait() or kevent().
+ */
+static int once(qevloop_t *loop, int timeoutms) {
+    // wait till the first timer
+    if (loop->numtimers > 0) {
+        uint64_t now = now_ms();
+        uint64_t expire = ((qevloop_timer_t *) loop->timers)->expire;
+        int waitms = (expire > now) ? (int) (expire - now) : 0;
+        if (timeoutms < 0 || waitms < timeoutms)
+            timeoutms = waitms;
+    }
+    if (loop->wheel != NULL) {
+        int waitms = qtimerwheel_nexttimeout(loop->wheel);
+        if (waitms >= 0 && (timeoutms < 0 || waitms < timeoutms))
+            timeoutms = waitms;
+    }
+    if (loop->numready > 0)
+        timeoutms = 0;
+
+    int num = backend_wait(loop, timeoutms);
+    if (num < 0)
+        return -1;
+
+    int called = 0;
+    int i;
+    for (i = 0; i < num; i++) {
+        int events;
+        int fd = backend_get(loop, i, &events);
+        if (fd == loop->wakeupfd[0]) {
+            // the drain ends with EAGAIN, which is not the caller's error
+            char buf[64];
+            int errnobak = errno;
+            while (read(fd, buf, sizeof(buf)) > 0);
+            errno = errnobak;
+            loop->stopped = true;
+            continue;
+        }
+
+        // removed by a callback already
+        qevloop_handler_t *handler = get_handler(loop, fd);
+        if (handler == NULL)
+            continue;
+        events &= (handler->events | QEVLOOP_ERROR);
+        if (events == 0)
+            continue;
+        if (events & QEVLOOP_ERROR)
+            events |= handler->events;
+
+        handler->cb(loop, fd, events, handler->userdata);
+        called++;
+
+        // queue it up while the reader has data the kernel doesn't know.
+        handler = get_handler(loop, fd);
+        if (handler != NULL && handler->reader != NULL
+                && handler->queued == false
+                && qio_reader_pending(handler->reader) > 0) {
+            if (loop->numready == loop->maxready) {
+                int max = (loop->maxready > 0) ? loop->maxready * 2 : 16;
+                int *ready = (int *) realloc(loop->ready, sizeof(int) * max);
+                if (ready == NULL)
+                    continue;  // will be found next time reading the fd.
+                loop->ready = ready;
+                loop->maxready = max;
+            }
+            loop->ready[loop->numready++] = fd;
+            handler->queued = true;
+        }
+    }
+
+    called += dispatch_ready(loop);
+    called += dispatch_timers(loop);
+    if (loop->wheel != NULL)
+        called += qtimerwheel_expire(loop->wheel);
+
+    return called;
+}
+
+/**
+ * qevloop->run(): Run the loop until stop() is called.
+ *
+ * @param loop      qevloop_t container pointer.
+ *
+ * @return true if stopped by stop(), false on error.
+ */
+static bool run(qevloop_t *loop) {
+    loop->stopped = false;
+    while (loop->stopped == false) {
+        if (once(loop, -1) < 0 && errno != EINTR)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * qevloop->stop(): Stop the running loop.
+ *
+ * @param loop      qevloop_t container pointer.
+ *
+ * @return true if successful, otherwise returns false.
+ *
+ * @note
+ *  This is thread-safe and async-signal-safe. The loop returns from run()
+ *  after the current round of callbacks.
+ */
+static bool stop(qevloop_t *loop) {
+    while (write(loop->wakeupfd[1], "", 1) < 0) {
+        if (errno == EAGAIN)
+            return true;  // the pipe is full of wake-ups already
+        if (errno != EINTR)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * qevloop->free(): Free the loop. The descriptors added are not closed.
+ *
+ * @param loop      qevloop_t container pointer.
+ */
+static void free_(qevloop_t *loop) {
+    if (loop->pollfd >= 0)
+        close(loop->pollfd);
+    if (loop->wakeupfd[0] >= 0)
+        close(loop->wakeupfd[0]);
+    if (loop->wakeupfd[1] >= 0)
+        close(loop->wakeupfd[1]);
+    free(loop->events);
+    free(loop->handlers);
+    free(loop->timers);
+    free(loop->ready);
+    free(loop);
+}
+
+#ifndef _DOXYGEN_SKIP
+
+#ifdef QEVLOOP_EPOLL
+static bool epoll_set(qevloop_t *loop, int op, int fd, int events) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.data.fd = fd;
+    if (events & QEVLOOP_READ)
+        ev.events |= EPOLLIN;
+    if (events & QEVLOOP_WRITE)
+        ev.events |= EPOLLOUT;
+    return (epoll_ctl(loop->pollfd, op, fd, &ev) == 0);
+}
+
+// a descriptor paused with no events stays in epoll.
+static bool backend_add(qevloop_t *loop, int fd, int events) {
+    return epoll_set(loop, EPOLL_CTL_ADD, fd, events);
+}
+
+static bool backend_mod(qevloop_t *loop, int fd, int oldevents, int events) {
+    return epoll_set(loop, EPOLL_CTL_MOD, fd, events);
+}
+
+static void backend_del(qevloop_t *loop, int fd, int oldevents) {
+    epoll_set(loop, EPOLL_CTL_DEL, fd, 0);
+}
+
+static int backend_wait(qevloop_t *loop, int timeoutms) {
+    return epoll_wait(loop->pollfd, (struct epoll_event *) loop->events,
+                      loop->maxevents, timeoutms);
+}
+
+static int backend_get(qevloop_t *loop, int idx, int *events) {
+    struct epoll_event *ev = (struct epoll_event *) loop->events + idx;
+    *events = 0;
+    if (ev->events & EPOLLIN)
+        *events |= QEVLOOP_READ;
+    if (ev->events & EPOLLOUT)
+        *events |= QEVLOOP_WRITE;
+    if (ev->events & (EPOLLERR | EPOLLHUP))
+        *events |= QEVLOOP_ERROR;
+    return ev->data.fd;
+}
+#endif /* QEVLOOP_EPOLL */
+
+#ifdef QEVLOOP_KQUEUE
+// a filter is added for each event, nothing's there for no events.
+static bool backend_mod(qevloop_t *loop, int fd, int oldevents, int events) {
+    struct kevent changes[2];
+    int num = 0;
+    if ((oldevents ^ events) & QEVLOOP_READ) {
+        EV_SET(&changes[num++], fd, EVFILT_READ,
+               (events & QEVLOOP_READ) ? EV_ADD : EV_DELETE, 0, 0, NULL);
+    }
+    if ((oldevents ^ events) & QEVLOOP_WRITE) {
+        EV_SET(&changes[num++], fd, EVFILT_WRITE,
+               (events & QEVLOOP_WRITE) ? EV_ADD : EV_DELETE, 0, 0, NULL);
+    }
+    if (num == 0)
+        return true;
+    return (kevent(loop->pollfd, changes, num, NULL, 0, NULL) == 0);
+}
+
+static bool backend_add(qevloop_t *loop, int fd, int events) {
+    return backend_mod(loop, fd, 0, events);
+}
+
+static void backend_del(qevloop_t *loop, int fd, int oldevents) {
+    backend_mod(loop, fd, oldevents, 0);
+}
+
+static int backend_wait(qevloop_t *loop, int timeoutms) {
+    struct timespec ts, *tsp = NULL;
+    if (timeoutms >= 0) {
+        ts.tv_sec = timeoutms / 1000;
+        ts.tv_nsec = (timeoutms % 1000) * 1000000L;
+        tsp = &ts;
+    }
+    return kevent(loop->pollfd, NULL, 0, (struct kevent *) loop->events,
+                  loop->maxevents, tsp);
+}
+
+static int backend_get(qevloop_t *loop, int idx, int *events) {
+    struct kevent *ev = (struct kevent *) loop->events + idx;
+    *events = 0;
+    if (ev->filter == EVFILT_READ)
+        *events |= QEVLOOP_READ;
+    else if (ev->filter == EVFILT_WRITE)
+        *events |= QEVLOOP_WRITE;
+    if (ev->flags & (EV_EOF | EV_ERROR))
+        *events |= QEVLOOP_ERROR;
+    return (int) ev->ident;
+}
+#endif /* QEVLOOP_KQUEUE */
+
+static qevloop_handler_t *get_handler(qevloop_t *loop, int fd) {
+    if (fd < 0 || fd >= loop->numhandlers)
+        return NULL;
+    qevloop_handler_t *handler = (qevloop_handler_t *) loop->handlers + fd;
+    return (handler->cb != NULL) ? handler : NULL;
+}
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// timer heap, the earliest one at the top.
+static void heap_up(qevloop_t *loop, int idx) {
+    qevloop_timer_t *timers = (qevloop_timer_t *) loop->timers;
+    qevloop_timer_t timer = timers[idx];
+    while (idx > 0) {
+        int parent = (idx - 1) / 2;
+        if (timers[parent].expire <= timer.expire)
+            break;
+        timers[idx] = timers[parent];
+        idx = parent;
+    }
+    timers[idx] = timer;
+}
+
+static void heap_down(qevloop_t *loop, int idx) {
+    qevloop_timer_t *timers = (qevloop_timer_t *) loop->timers;
+    qevloop_timer_t timer = timers[idx];
+    while (true) {
+        int child = idx * 2 + 1;
+        if (child >= loop->numtimers)
+            break;
+        if (child + 1 < loop->numtimers
+                && timers[child + 1].expire < timers[child].expire) {
+            child++;
+        }
+        if (timer.expire <= timers[child].expire)
+            break;
+        timers[idx] = timers[child];
+        idx = child;
+    }
+    timers[idx] = timer;
+}
+
+static void heap_delete(qevloop_t *loop, int idx) {
+    qevloop_timer_t *timers = (qevloop_timer_t *) loop->timers;
+    loop->numtimers--;
+    if (idx == loop->numtimers)
+        return;
+    timers[idx] = timers[loop->numtimers];
+    heap_up(loop, idx);
+    heap_down(loop, idx);
+}
+
+// call the read callbacks of the descriptors having buffered data.
+static int dispatch_ready(qevloop_t *loop) {
+    int called = 0;
+    int num = loop->numready;
+    int i, keep = 0;
+    for (i = 0; i < num; i++) {
+        int fd = loop->ready[i];
+        qevloop_handler_t *handler = get_handler(loop, fd);
+        if (handler == NULL) {
+            // removed, the slot could be taken by another descriptor.
+            if (fd < loop->numhandlers)
+                ((qevloop_handler_t *) loop->handlers)[fd].queued = false;
+            continue;
+        }
+        if (handler->reader != NULL && (handler->events & QEVLOOP_READ)
+                && qio_reader_pending(handler->reader) > 0) {
+            handler->cb(loop, fd, QEVLOOP_READ, handler->userdata);
+            called++;
+        }
+
+        handler = get_handler(loop, fd);
+        if (handler != NULL && handler->reader != NULL
+                && qio_reader_pending(handler->reader) > 0) {
+            loop->ready[keep++] = fd;
+        } else if (fd < loop->numhandlers) {
+            ((qevloop_handler_t *) loop->handlers)[fd].queued = false;
+        }
+    }
+
+    // descriptors queued by the callbacks in the meantime
+    if (loop->numready > num) {
+        memmove(loop->ready + keep, loop->ready + num,
+                sizeof(int) * (loop->numready - num));
+    }
+    loop->numready = keep + (loop->numready - num);
+    return called;
+}
+
+static int dispatch_timers(qevloop_t *loop) {
+    int called = 0;
+    uint64_t now = now_ms();
+    while (loop->numtimers > 0) {
+        qevloop_timer_t *top = (qevloop_timer_t *) loop->timers;
+        if (top->expire > now)
+            break;
+
+        // take it out before the callback, it may add or remove timers.
+        qevloop_timer_t timer = *top;
+        if (timer.repeat == true) {
+            top->expire += timer.intervalms;
+            if (top->expire <= now)
+                top->expire = now + timer.intervalms;  // fell behind
+            heap_down(loop, 0);
+        } else {
+            heap_delete(loop, 0);
+        }
+
+        timer.cb(loop, timer.id, timer.userdata);
+        called++;
+    }
+    return called;
+}
+
+#endif /* _DOXYGEN_SKIP */
@@ -120,6 +120,8 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <time.h>
+#include <pthread.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -131,12 +133,20 @@
 #include "openssl/err.h"
 #endif
 
+#ifdef ENABLE_ZLIB
+#include <zlib.h>
+#endif
+
 #include "qinternal.h"
 #include "utilities/qio.h"
 #include "utilities/qstring.h"
 #include "utilities/qsocket.h"
+#include "utilities/qtrace.h"
+#include "containers/qlist.h"
 #include "containers/qlisttbl.h"
+#include "containers/qhashtbl.h"
 #include "containers/qgrow.h"
+#include "extensions/qevloop.h"
 #include "extensions/qhttpclient.h"
 
 #ifndef _DOXYGEN_SKIP
@@ -146,6 +156,7 @@ static bool setssl(qhttpclient_t *client);
 static void settimeout(qhttpclient_t *client, int timeoutms);
 static void setkeepalive(qhttpclient_t *client, bool keepalive);
 static void setuseragent(qhttpclient_t *client, const char *agentname);
+static bool setdecoding(qhttpclient_t *client, bool decoding);
 
 static bool head(qhttpclient_t *client, const char *uri, int *rescode,
                  qlisttbl_t *reqheaders, qlisttbl_t *resheaders);
@@ -165,6 +176,21 @@ static bool sendrequest(qhttpclient_t *client, const char *method,
                         const char *uri, qlisttbl_t *reqheaders);
 static int readresponse(qhttpclient_t *client, qlisttbl_t *resheaders,
                         off_t *contentlength);
+static ssize_t readbody(qhttpclient_t *client, const void **data);
+static bool stream(qhttpclient_t *client, const char *method, const char *uri,
+                   void *data, size_t size, int *rescode,
+                   qlisttbl_t *reqheaders, qlisttbl_t *resheaders,
+                   bool (*callback)(void *userdata, const void *data,
+                                    size_t size),
+                   void *userdata);
+
+static bool pipeline(qhttpclient_t *client, const char *method,
+                     const char *uri, void *data, size_t size,
+                     qlisttbl_t *reqheaders, qhttpclient_cb_t callback,
+                     void *userdata);
+static int dispatch(qhttpclient_t *client, int timeoutms);
+static int inflight(qhttpclient_t *client);
+static bool attach(qhttpclient_t *client, qevloop_t *loop);
 
 static ssize_t gets_(qhttpclient_t *client, char *buf, size_t bufsize);
 static ssize_t read_(qhttpclient_t *client, void *buf, size_t nbytes);
@@ -175,7 +201,42 @@ static off_t sendfile_(qhttpclient_t *client, int fd, off_t nbytes);
 static bool _close(qhttpclient_t *client);
 static void _free(qhttpclient_t *client);
 
+static qhttpclient_t *pool_get(qhttpclient_pool_t *pool, const char *destname,
+                               int port);
+static void pool_release(qhttpclient_pool_t *pool, qhttpclient_t *client);
+static void pool_free(qhttpclient_pool_t *pool);
+
 // internal usages
+static qhttpclient_t *_new_client(const struct sockaddr_in *addr,
+                                  const char *hostname, int port,
+                                  bool ishttps);
+static bool _parse_dest(const char *destname, int *port, bool *ishttps,
+                        char *hostname, size_t namesize);
+static bool _is_reusable(qhttpclient_t *client);
+static int _read_response(qhttpclient_t *client, qlisttbl_t *resheaders,
+                          off_t *contentlength);
+static ssize_t _read_slice(qhttpclient_t *client, const void **data,
+                           off_t nbytes);
+static ssize_t _read_body(qhttpclient_t *client, const void **data);
+static bool _is_encoded(const char *encoding);
+static void _decoder_start(qhttpclient_t *client, bool encoded);
+static bool _decoder_active(qhttpclient_t *client);
+static ssize_t _read_decoded(qhttpclient_t *client, const void **data);
+static bool _decode_all(qhttpclient_t *client, const void *data, size_t size,
+                        char **out, size_t *outsize);
+static void _decoder_free(qhttpclient_t *client);
+#ifdef ENABLE_OPENSSL
+static void _ssl_init(void);
+static int _ssl_new_session(SSL *ssl, SSL_SESSION *session);
+#endif
+static void *_pipe_get(qhttpclient_t *client);
+static bool _pipe_watch(qhttpclient_t *client, bool watch);
+static void _pipe_event(qevloop_t *loop, int fd, int events, void *userdata);
+static int _pipe_parse(qhttpclient_t *client);
+static bool _pipe_take(qhttpclient_t *client, size_t nbytes);
+static int _pipe_complete(qhttpclient_t *client);
+static void _pipe_fail(qhttpclient_t *client);
+static void _pipe_free(qhttpclient_t *client);
 static bool _set_socket_option(int socket);
 static bool _parse_uri(const char *uri, bool *protocol, char *hostname,
                        size_t namesize, int *port);
@@ -205,6 +266,19 @@ static bool _parse_uri(const char *uri, bool *protocol, char *hostname,
 
 #define HTTP_PROTOCOL_11                "HTTP/1.1"
 
+//
+// RESPONSE BODY STATES OF READBODY()
+//
+enum {
+    BODY_NONE = 0,    /*< no body to read */
+    BODY_LENGTH,      /*< body of Content-Length */
+    BODY_CHUNKSIZE,   /*< chunk size line comes next */
+    BODY_CHUNKDATA,   /*< in a chunk */
+    BODY_CHUNKEND,    /*< line break after a chunk comes next */
+    BODY_UNTILCLOSE,  /*< body ends when the server closes the connection */
+    BODY_END          /*< end of the body reached */
+};
+
 //
 // TCP SOCKET DEFINITION
 //
@@ -213,13 +287,84 @@ static bool _parse_uri(const char *uri, bool *protocol, char *hostname,
 #define MAX_SHUTDOWN_WAIT       (100)  /*< maximum shutdown wait, unit is ms */
 #define MAX_ATOMIC_DATA_SIZE    (32 * 1024)  /*< maximum sending bytes */
 
+#ifdef ENABLE_ZLIB
+typedef struct {
+    z_stream zs;
+    bool active;  // decoding the current body
+    bool eof;     // end of the encoded body
+    bool ended;   // end of the compressed stream
+    char out[MAX_ATOMIC_DATA_SIZE];
+} qhttpclient_decoder_t;
+#endif
+
 #ifdef  ENABLE_OPENSSL
 struct SslConn {
     SSL *ssl;
     SSL_CTX *ctx;
 };
+
+// shared by all the clients of the process
+static pthread_once_t _ssl_once = PTHREAD_ONCE_INIT;
+static SSL_CTX *_ssl_ctx = NULL;
+static qhashtbl_t *_ssl_sessions = NULL;  // last session of "host:port"
+static pthread_mutex_t _ssl_lock = PTHREAD_MUTEX_INITIALIZER;
 #endif
 
+// pool host entry
+typedef struct {
+    char *hostname;
+    int port;
+    bool ishttps;
+    struct sockaddr_in addr;  // resolved once per host
+
+    int conns;  // connections handed out plus idle ones
+    struct {
+        qhttpclient_t *client;
+        time_t since;
+    } *idle;  // idle stack, most recently released on top
+    int numidle;
+    int maxidle;
+} qhttpclient_poolhost_t;
+
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} qhttpclient_poollock_t;
+
+// pipelined request waiting for its response
+typedef struct {
+    qhttpclient_cb_t callback;
+    void *userdata;
+    bool nobody;  // HEAD request
+} qhttpclient_pipereq_t;
+
+// response parser states
+enum {
+    PIPE_STATUS = 0,
+    PIPE_HEADER,
+    PIPE_BODY,
+    PIPE_CHUNKSIZE,
+    PIPE_CHUNKDATA,
+    PIPE_CHUNKEND,
+    PIPE_TRAILER,
+    PIPE_UNTILCLOSE
+};
+
+typedef struct {
+    qlist_t *queue;  // requests in the order sent
+    qevloop_t *loop;
+
+    int state;
+    int rescode;
+    qlisttbl_t *resheaders;
+    off_t contentlength;  // -1 for chunked, -2 for unknown
+    off_t remain;         // bytes left in the body or the chunk
+
+    char *body;
+    size_t bodylen;
+    size_t bodysize;
+} qhttpclient_pipe_t;
+
 /**
  * Initialize & create new HTTP client.
  *
@@ -245,16 +390,9 @@ struct SslConn {
 qhttpclient_t *qhttpclient(const char *destname, int port) {
     bool ishttps = false;
     char hostname[256];
-    if (port == 0 || strstr(destname, "://") != NULL) {
-        if (_parse_uri(destname, &ishttps, hostname, sizeof(hostname), &port)
-                == false) {
-            DEBUG("Can't parse URI %s", destname);
-            return NULL;
-        }
-
-        DEBUG("https: %d, hostname: %s, port:%d\n", ishttps, hostname, port);
-    } else {
-        qstrcpy(hostname, sizeof(hostname), destname);
+    if (_parse_dest(destname, &port, &ishttps, hostname, sizeof(hostname))
+            == false) {
+        return NULL;
     }
 
     // get remote address
@@ -263,52 +401,7 @@ qhttpclient_t *qhttpclient(const char *destname, int port) {
         return NULL;
     }
 
-    // allocate  object
-    qhttpclient_t *client = (qhttpclient_t *) malloc(sizeof(qhttpclient_t));
-    if (client == NULL)
-        return NULL;
-    memset((void *) client, 0, sizeof(qhttpclient_t));
-
-    // initialize object
-    client->socket = -1;
-
-    memcpy((void *) &client->addr, (void *) &addr, sizeof(client->addr));
-    client->hostname = strdup(hostname);
-    client->port = port;
-
-    // member methods
-    client->setssl = setssl;
-    client->settimeout = settimeout;
-    client->setkeepalive = setkeepalive;
-    client->setuseragent = setuseragent;
-
-    client->open = open_;
-
-    client->head = head;
-    client->get = get;
-    client->put = put;
-    client->cmd = cmd;
-
-    client->sendrequest = sendrequest;
-    client->readresponse = readresponse;
-
-    client->gets = gets_;
-    client->read = read_;
-    client->write = write_;
-    client->recvfile = recvfile;
-    client->sendfile = sendfile_;
-
-    client->close = _close;
-    client->free = _free;
-
-    // init client
-    settimeout(client, 0);
-    setkeepalive(client, false);
-    setuseragent(client, QHTTPCLIENT_NAME);
-    if (ishttps == true)
-        setssl(client);
-
-    return client;
+    return _new_client(&addr, hostname, port, ishttps);
 }
 
 /**
@@ -322,19 +415,15 @@ qhttpclient_t *qhttpclient(const char *destname, int port) {
  */
 static bool setssl(qhttpclient_t *client) {
 #ifdef  ENABLE_OPENSSL
-    static bool initialized = false;
-
     if (client->socket >= 0) {
         // must be set before making a connection.
         return false;
     }
-    
+
     // init openssl
-    if (initialized == false) {
-      initialized = true;
-      SSL_load_error_strings();
-      SSL_library_init();
-    }
+    pthread_once(&_ssl_once, _ssl_init);
+    if (_ssl_ctx == NULL)
+        return false;
 
     // allocate ssl structure
     if (client->ssl == NULL) {
@@ -397,6 +486,40 @@ static void setuseragent(qhttpclient_t *client, const char *useragent) {
     client->useragent = strdup(useragent);
 }
 
+/**
+ * qhttpclient->setdecoding(): Sets content decoding on/off.
+ *
+ * When it's on, requests ask for compressed responses with
+ * "Accept-Encoding: gzip, deflate" and the gzip or deflate encoded bodies
+ * are decompressed on the fly, so get(), cmd(), readbody(), stream() and
+ * the pipelined callbacks all see the original content.
+ *
+ * @param client    qhttpclient object pointer
+ * @param decoding  true to set content decoding on, false to set it off
+ *
+ * @return true if successful, otherwise returns false
+ * @retval errno will be set in error condition.
+ *  - ENOTSUP : Not compiled with zlib(--with-zlib).
+ *
+ * @code
+ *   httpclient->setdecoding(httpclient, true);
+ * @endcode
+ *
+ * @note
+ *  Content decoding is turned off by default. The response headers are
+ *  given as received, so Content-Length is the encoded size.
+ */
+static bool setdecoding(qhttpclient_t *client, bool decoding) {
+#ifndef ENABLE_ZLIB
+    if (decoding == true) {
+        errno = ENOTSUP;
+        return false;
+    }
+#endif
+    client->decoding = decoding;
+    return true;
+}
+
 /**
  * qhttpclient->open(): Opens a connection to the remote host.
  *
@@ -437,15 +560,18 @@ static bool open_(qhttpclient_t *client) {
     }
 
     // try to connect
+    Q_TRACE_BEGIN(trace, QTRACE_HTTP_CONNECT, sockfd, client->hostname);
     int status = connect(sockfd, (struct sockaddr *) &client->addr,
                          sizeof(client->addr));
     if (status < 0
             && (errno != EINPROGRESS
                     || qio_wait_writable(sockfd, client->timeoutms) <= 0)) {
         DEBUG("connection failed. (%d)", errno);
+        Q_TRACE_END(trace, -1, false);
         close(sockfd);
         return false;
     }
+    Q_TRACE_END(trace, sockfd, true);
 
     // restore to block socket
     if (client->timeoutms > 0) {
@@ -454,6 +580,8 @@ static bool open_(qhttpclient_t *client) {
 
     // store socket descriptor
     client->socket = sockfd;
+    qio_reader_reset(client->reader, sockfd);
+    _pipe_watch(client, true);
 
     // set socket option
     _set_socket_option(sockfd);
@@ -461,14 +589,9 @@ static bool open_(qhttpclient_t *client) {
 #ifdef ENABLE_OPENSSL
     // set SSL option
     if (client->ssl != NULL) {
-        // get ssl context using SSL 2 or 3
+        // the context is shared, so are its settings and session tickets
         struct SslConn *ssl = client->ssl;
-        ssl->ctx = SSL_CTX_new(SSLv23_client_method());
-        if (ssl->ctx == NULL) {
-            DEBUG("OpenSSL: %s", ERR_reason_error_string(ERR_get_error()));
-            _close(client);
-            return false;
-        }
+        ssl->ctx = _ssl_ctx;
 
         // get ssl handle
         ssl->ssl = SSL_new(ssl->ctx);
@@ -477,6 +600,7 @@ static bool open_(qhttpclient_t *client) {
             _close(client);
             return false;
         }
+        SSL_set_app_data(ssl->ssl, client);
 
         // map ssl handle with socket
         if (SSL_set_fd(ssl->ssl, client->socket) != 1) {
@@ -490,17 +614,32 @@ static bool open_(qhttpclient_t *client) {
 
 #ifndef OPENSSL_NO_TLSEXT
         // set server name indication extension for the handshake
-        ssl->ssl->tlsext_hostname = client->hostname;
+        SSL_set_tlsext_host_name(ssl->ssl, client->hostname);
 #endif
 
+        // resume the last session to the destination for a short handshake
+        char key[256 + 16];
+        snprintf(key, sizeof(key), "%s:%d", client->hostname, client->port);
+        pthread_mutex_lock(&_ssl_lock);
+        SSL_SESSION **session = _ssl_sessions->get(_ssl_sessions, key, NULL,
+                                                   false);
+        if (session != NULL) {
+            SSL_set_session(ssl->ssl, *session);
+        }
+        pthread_mutex_unlock(&_ssl_lock);
+
         // do handshake
-        if (SSL_connect(ssl->ssl) != 1) {
+        Q_TRACE_BEGIN(tls, QTRACE_HTTP_TLS, sockfd, client->hostname);
+        int handshake = SSL_connect(ssl->ssl);
+        Q_TRACE_END(tls, SSL_session_reused(ssl->ssl), handshake == 1);
+        if (handshake != 1) {
             DEBUG("OpenSSL: %s", ERR_reason_error_string(ERR_get_error()));
             _close(client);
             return false;
         }
 
-        DEBUG("ssl initialized");
+        DEBUG("ssl initialized, session reused: %d",
+              SSL_session_reused(ssl->ssl));
     }
 #endif /* ENABLE_OPENSSL */
 
@@ -751,7 +890,26 @@ static bool get(qhttpclient_t *client, const char *uri, int fd, off_t *savesize,
         return false;
     }
 
-    if (clength > 0) {
+    if (_decoder_active(client) == true) {
+        const void *slice;
+        ssize_t slicesize;
+        while ((slicesize = readbody(client, &slice)) > 0) {
+            if (qio_write(fd, slice, slicesize, -1) != slicesize) {
+                _close(client);
+                return false;
+            }
+            recv += slicesize;
+            if (savesize != NULL)
+                *savesize = recv;
+
+            if (callback != NULL && callback(userdata, recv) == false) {
+                _close(client);
+                return false;
+            }
+        }
+        if (slicesize < 0)
+            return false;
+    } else if (clength > 0) {
         while (recv < clength) {
             unsigned int recvsize;  // this time receive size
             if (clength - recv < MAX_ATOMIC_DATA_SIZE) {
@@ -956,7 +1114,8 @@ static bool put(qhttpclient_t *client, const char *uri, int fd, off_t length,
     }
 
     // wait 100-continue
-    if (qio_wait_readable(client->socket, client->timeoutms) <= 0) {
+    if (qio_reader_pending(client->reader) == 0
+            && qio_wait_readable(client->socket, client->timeoutms) <= 0) {
         DEBUG("timed out %d", client->timeoutms);
         _close(client);
         return false;
@@ -1139,11 +1298,38 @@ static void *cmd(qhttpclient_t *client, const char *method, const char *uri,
     int resno = readresponse(client, resheaders, &clength);
     if (rescode != NULL)
         *rescode = resno;
+
+    void *content = NULL;
+    if (_decoder_active(client) == true) {
+        // decoded size is not known ahead
+        qgrow_t *grow = qgrow(0);
+        const void *slice;
+        ssize_t slicesize = -1;
+        while (grow != NULL && (slicesize = readbody(client, &slice)) > 0) {
+            if (grow->add(grow, slice, slicesize) == false) {
+                slicesize = -1;
+                break;
+            }
+        }
+        size_t total = 0;
+        if (slicesize == 0 && grow->add(grow, "", 1) == true) {
+            content = grow->toarray(grow, &total);
+        }
+        if (content != NULL) {
+            clength = total - 1;
+        } else {
+            _close(client);
+        }
+        if (grow != NULL)
+            grow->free(grow);
+        if (contentslength != NULL)
+            *contentslength = clength;
+        return content;
+    }
     if (contentslength != NULL)
         *contentslength = clength;
 
     // malloc data
-    void *content = NULL;
     if (clength > 0) {
         content = malloc(clength + 1);
         if (content != NULL) {
@@ -1168,6 +1354,226 @@ static void *cmd(qhttpclient_t *client, const char *method, const char *uri,
     return content;
 }
 
+/**
+ * qhttpclient->pipeline(): Sends a request without waiting for the response.
+ *
+ * Requests are written back to back on the same keep-alive connection and
+ * the responses come back in the same order, so many requests share a
+ * single round trip. The callback is called by dispatch() when its
+ * response is read.
+ *
+ * @param client        qhttpclient object pointer
+ * @param method        HTTP method name
+ * @param uri           URI string for the method. ("/path" or "http://.../path")
+ * @param data          data to send. (can be NULL)
+ * @param size          data size
+ * @param reqheaders    qlisttbl_t pointer which contains additional user
+ *                      request headers. (can be NULL)
+ * @param callback      function called with the response.
+ * @param userdata      user data pointer given to the callback.
+ *
+ * @return true if the request is sent, otherwise returns false.
+ * @retval errno  will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - ENOTSUP : HTTPS connection.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @code
+ *   static void done(qhttpclient_t *client, int rescode,
+ *                    qlisttbl_t *resheaders, void *body, size_t bodysize,
+ *                    void *userdata) {
+ *     printf("%s %d, %zu bytes\n", (char *) userdata, rescode, bodysize);
+ *   }
+ *
+ *   httpclient->pipeline(httpclient, "GET", "/a.txt", NULL, 0, NULL,
+ *                        done, "/a.txt");
+ *   httpclient->pipeline(httpclient, "GET", "/b.txt", NULL, 0, NULL,
+ *                        done, "/b.txt");
+ *   while (httpclient->inflight(httpclient) > 0) {
+ *     if (httpclient->dispatch(httpclient, 1000) < 0) break;
+ *   }
+ * @endcode
+ *
+ * @note
+ *  Keep-alive is turned on. The response body is given to the callback in
+ *  memory with a NUL terminator, and rescode 0 tells the request failed as
+ *  the connection was closed before its response. The callbacks can queue
+ *  more requests but must not free the client. Content-Length is added
+ *  only when reqheaders is NULL, like cmd(). Don't mix it with the
+ *  synchronous calls while requests are in flight.
+ */
+static bool pipeline(qhttpclient_t *client, const char *method,
+                     const char *uri, void *data, size_t size,
+                     qlisttbl_t *reqheaders, qhttpclient_cb_t callback,
+                     void *userdata) {
+    if (method == NULL || uri == NULL || callback == NULL) {
+        errno = EINVAL;
+        return false;
+    }
+    if (client->ssl != NULL) {
+        // responses are parsed off the plain socket reader
+        errno = ENOTSUP;
+        return false;
+    }
+
+    qhttpclient_pipe_t *pipe = _pipe_get(client);
+    if (pipe == NULL)
+        return false;
+    client->keepalive = true;
+
+    // send request
+    bool freeReqHeaders = false;
+    if (reqheaders == NULL && data != NULL && size > 0) {
+        reqheaders = qlisttbl(
+                QLISTTBL_UNIQUE | QLISTTBL_CASEINSENSITIVE);
+        if (reqheaders == NULL)
+            return false;
+        reqheaders->putstrf(reqheaders, "Content-Length", "%zu", size);
+        freeReqHeaders = true;
+    }
+
+    bool sendret = sendrequest(client, method, uri, reqheaders);
+    if (freeReqHeaders == true) {
+        reqheaders->free(reqheaders);
+    }
+    if (sendret == true && data != NULL && size > 0) {
+        sendret = (write_(client, data, size) == size);
+    }
+    if (sendret == false) {
+        _close(client);
+        return false;
+    }
+
+    // queue up for the response
+    qhttpclient_pipereq_t req;
+    req.callback = callback;
+    req.userdata = userdata;
+    req.nobody = (strcasecmp(method, "HEAD") == 0);
+    if (pipe->queue->addlast(pipe->queue, &req, sizeof(req)) == false) {
+        // the response can't be matched any more
+        _close(client);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * qhttpclient->dispatch(): Reads responses of the pipelined requests.
+ *
+ * It reads what the connection has and calls back every response read in
+ * full, without waiting for the rest of a partial response. So it can be
+ * called from an event loop whenever the socket is readable.
+ *
+ * @param client        qhttpclient object pointer
+ * @param timeoutms     wait timeout milliseconds for the first data, 0 for
+ *                      no wait, -1 for infinite wait.
+ *
+ * @return the number of responses called back, or -1 if the connection
+ *         failed. The requests in flight are called back with rescode 0
+ *         then.
+ *
+ * @note
+ *  The connection is closed after a response with "Connection: close"
+ *  and the requests behind it are failed.
+ */
+static int dispatch(qhttpclient_t *client, int timeoutms) {
+    qhttpclient_pipe_t *pipe = client->pipe;
+    if (pipe == NULL || pipe->queue->size(pipe->queue) == 0)
+        return 0;
+
+    int count = 0;
+    bool waited = false;
+    while (client->socket >= 0 && pipe->queue->size(pipe->queue) > 0) {
+        int ret = _pipe_parse(client);
+        if (ret > 0) {
+            count++;
+            if (client->connclose == true) {
+                _close(client);
+            }
+            continue;
+        } else if (ret < 0) {
+            DEBUG("Malformed response.");
+            _close(client);
+            errno = EPROTO;
+            return -1;
+        }
+
+        // need more data
+        int waitms = (count == 0 && waited == false) ? timeoutms : 0;
+        waited = true;
+        if (qio_wait_readable(client->socket, waitms) <= 0)
+            break;
+
+        ssize_t rsize = qio_reader_fill(client->reader, 0);
+        if (rsize == 0 && pipe->state == PIPE_UNTILCLOSE) {
+            // body delimited by the end of the connection
+            _pipe_complete(client);
+            count++;
+            _close(client);
+        } else if (rsize <= 0) {
+            DEBUG("Connection lost.");
+            _close(client);
+            if (rsize == 0)
+                errno = ECONNRESET;
+            return -1;
+        }
+    }
+
+    return count;
+}
+
+/**
+ * qhttpclient->inflight(): Gets the number of pipelined requests waiting
+ * for their responses.
+ *
+ * @param client        qhttpclient object pointer
+ *
+ * @return the number of requests in flight.
+ */
+static int inflight(qhttpclient_t *client) {
+    qhttpclient_pipe_t *pipe = client->pipe;
+    if (pipe == NULL)
+        return 0;
+    return pipe->queue->size(pipe->queue);
+}
+
+/**
+ * qhttpclient->attach(): Dispatches the pipelined responses from an event
+ * loop.
+ *
+ * The connection is watched by the loop and dispatch() is called whenever
+ * it's readable, so a single thread can keep requests in flight on many
+ * clients. It follows the reconnections of the client.
+ *
+ * @param client        qhttpclient object pointer
+ * @param loop          qevloop_t pointer, NULL to detach.
+ *
+ * @return true if successful, otherwise returns false.
+ *
+ * @code
+ *   qevloop_t *loop = qevloop(0);
+ *   httpclient->attach(httpclient, loop);
+ *   httpclient->pipeline(httpclient, "GET", "/a.txt", NULL, 0, NULL,
+ *                        done, NULL);
+ *   while (httpclient->inflight(httpclient) > 0) {
+ *     loop->once(loop, 1000);
+ *   }
+ * @endcode
+ *
+ * @note
+ *  Detach it before freeing the loop.
+ */
+static bool attach(qhttpclient_t *client, qevloop_t *loop) {
+    qhttpclient_pipe_t *pipe = _pipe_get(client);
+    if (pipe == NULL)
+        return false;
+
+    _pipe_watch(client, false);
+    pipe->loop = loop;
+    return _pipe_watch(client, true);
+}
+
 /**
  * qhttpclient->sendrequest(): Sends a HTTP request to the remote host.
  *
@@ -1220,6 +1626,11 @@ static bool sendrequest(qhttpclient_t *client, const char *method,
                 reqheaders, "Connection",
                 (client->keepalive == true) ? "Keep-Alive" : "close");
     }
+    if (client->decoding == true
+            && reqheaders->get(reqheaders, "Accept-Encoding", NULL, false)
+                    == NULL) {
+        reqheaders->putstr(reqheaders, "Accept-Encoding", "gzip, deflate");
+    }
 
     // create stream buffer
     qgrow_t *outBuf = qgrow(0);
@@ -1242,6 +1653,7 @@ static bool sendrequest(qhttpclient_t *client, const char *method,
     outBuf->addstrf(outBuf, "\r\n");
 
     // stream out
+    Q_TRACE_BEGIN(trace, QTRACE_HTTP_REQUEST, client->socket, method);
     size_t towrite = 0;
     char *final = outBuf->toarray(outBuf, &towrite);
     ssize_t written = 0;
@@ -1249,6 +1661,7 @@ static bool sendrequest(qhttpclient_t *client, const char *method,
         written = write_(client, final, towrite);
         free(final);
     }
+    Q_TRACE_END(trace, written, written > 0 && written == towrite);
 
     // de-allocate
     outBuf->free(outBuf);
@@ -1268,7 +1681,9 @@ static bool sendrequest(qhttpclient_t *client, const char *method,
  * @param resheaders    qlisttbl_t pointer for storing response headers.
  *                      (can be NULL)
  * @param contentlength length of content body(or -1 for chunked transfer
- *                      encoding) will be stored. (can be NULL)
+ *                      encoding) will be stored. 0 is also stored when the
+ *                      body runs until the server closes the connection,
+ *                      which readbody() reads. (can be NULL)
  *
  * @return numeric HTTP response code if successful, otherwise returns 0.
  *
@@ -1292,66 +1707,146 @@ static bool sendrequest(qhttpclient_t *client, const char *method,
  */
 static int readresponse(qhttpclient_t *client, qlisttbl_t *resheaders,
                         off_t *contentlength) {
-    if (contentlength != NULL) {
-        *contentlength = 0;
-    }
-
-    // read response
-    char buf[1024];
-    if (gets_(client, buf, sizeof(buf)) <= 0)
-        return HTTP_NO_RESPONSE;
+    Q_TRACE_BEGIN(trace, QTRACE_HTTP_RESPONSE, client->socket, NULL);
+    int rescode = _read_response(client, resheaders, contentlength);
+    Q_TRACE_END(trace, rescode, rescode != HTTP_NO_RESPONSE);
+    return rescode;
+}
 
-    // parse response code
-    if (strncmp(buf, "HTTP/", CONST_STRLEN("HTTP/")))
-        return HTTP_NO_RESPONSE;
-    char *tmp = strstr(buf, " ");
-    if (tmp == NULL)
-        return HTTP_NO_RESPONSE;
-    int rescode = atoi(tmp + 1);
-    if (rescode == 0)
-        return HTTP_NO_RESPONSE;
+/**
+ * qhttpclient->readbody(): Reads the response body slice by slice.
+ *
+ * The slices point into the read buffer of the connection, with the
+ * chunked encoding taken off already, so a response of any size is
+ * read in constant memory without copying.
+ *
+ * @param client    qhttpclient object pointer
+ * @param data      set to the data of the slice.
+ *
+ * @return the size of the slice, 0 at the end of the body, or -1 if the
+ *         connection failed.
+ *
+ * @code
+ *   off_t clength;
+ *   httpclient->sendrequest(httpclient, "GET", "/big.log", NULL);
+ *   int rescode = httpclient->readresponse(httpclient, NULL, &clength);
+ *
+ *   const void *data;
+ *   ssize_t size;
+ *   while ((size = httpclient->readbody(httpclient, &data)) > 0) {
+ *     parse(data, size);
+ *   }
+ * @endcode
+ *
+ * @note
+ *  Call it after readresponse(). A slice stays valid until the next call.
+ *  The connection is closed at the end of the body if keep-alive is off or
+ *  the server asked so. A body without a length or chunked encoding is read
+ *  until the server closes the connection. The body of a HEAD request is
+ *  none even though it has a Content-Length, so don't read it.
+ */
+static ssize_t readbody(qhttpclient_t *client, const void **data) {
+    if (_decoder_active(client) == true)
+        return _read_decoded(client, data);
+    return _read_body(client, data);
+}
 
-    // read headers
-    while (gets_(client, buf, sizeof(buf)) > 0) {
-        if (buf[0] == '\0')
-            break;
+/**
+ * qhttpclient->stream(): Sends a request and streams the response body
+ * to a call-back function.
+ *
+ * @param client        qhttpclient object pointer
+ * @param method        HTTP method name
+ * @param uri           URI string for the method. ("/path" or "http://.../path")
+ * @param data          data to send. (can be NULL)
+ * @param size          data size
+ * @param rescode       if not NULL, remote response code will be stored.
+ *                      (can be NULL)
+ * @param reqheaders    qlisttbl_t pointer which contains additional user
+ *                      request headers. (can be NULL)
+ * @param resheaders    qlisttbl_t pointer for storing response headers.
+ *                      (can be NULL)
+ * @param callback      function called with each slice of the body.
+ * @param userdata      user data pointer given to the callback.
+ *
+ * @return true if the whole response is received, otherwise returns false.
+ *
+ * @code
+ *   static bool proxy(void *userdata, const void *data, size_t size) {
+ *     int *fd = (int *) userdata;
+ *     return (write(*fd, data, size) == size);  // false to cancel
+ *   }
+ *
+ *   int rescode;
+ *   httpclient->stream(httpclient, "GET", "/big.log", NULL, 0, &rescode,
+ *                      NULL, NULL, proxy, &outfd);
+ * @endcode
+ *
+ * @note
+ *  The body is given for any response code, check rescode for it. The
+ *  slices are valid only in the callback. Returning false from the
+ *  callback closes the connection and stops here.
+ */
+static bool stream(qhttpclient_t *client, const char *method, const char *uri,
+                   void *data, size_t size, int *rescode,
+                   qlisttbl_t *reqheaders, qlisttbl_t *resheaders,
+                   bool (*callback)(void *userdata, const void *data,
+                                    size_t size),
+                   void *userdata) {
+    // reset rescode
+    if (rescode != NULL)
+        *rescode = 0;
 
-        // parse header
-        char *name = buf;
-        char *value = strstr(buf, ":");
-        if (value != NULL) {
-            *value = '\0';
-            value += 1;
-            qstrtrim(value);
-        } else {
-            // missing colon
-            value = "";
-        }
+    // send request
+    bool freeReqHeaders = false;
+    if (reqheaders == NULL && data != NULL && size > 0) {
+        reqheaders = qlisttbl(
+                QLISTTBL_UNIQUE | QLISTTBL_CASEINSENSITIVE);
+        if (reqheaders == NULL)
+            return false;
+        reqheaders->putstrf(reqheaders, "Content-Length", "%zu", size);
+        freeReqHeaders = true;
+    }
 
-        if (resheaders != NULL) {
-            resheaders->putstr(resheaders, name, value);
-        }
+    bool sendret = sendrequest(client, method, uri, reqheaders);
+    if (freeReqHeaders == true) {
+        reqheaders->free(reqheaders);
+    }
+    if (sendret == true && data != NULL && size > 0) {
+        sendret = (write_(client, data, size) == size);
+    }
+    if (sendret == false) {
+        _close(client);
+        return false;
+    }
 
-        // check Connection header
-        if (!strcasecmp(name, "Connection")) {
-            if (!strcasecmp(value, "close")) {
-                client->connclose = true;
-            }
-        }
-        // check Content-Length & Transfer-Encoding header
-        else if (contentlength != NULL && *contentlength == 0) {
-            if (!strcasecmp(name, "Content-Length")) {
-                *contentlength = atoll(value);
-            }
-            // check transfer-encoding header
-            else if (!strcasecmp(name, "Transfer-Encoding")
-                    && !strcasecmp(value, "chunked")) {
-                *contentlength = -1;
-            }
+    // read response, past the interim ones
+    int resno;
+    do {
+        resno = readresponse(client, resheaders, NULL);
+    } while (resno / 100 == 1);
+    if (rescode != NULL)
+        *rescode = resno;
+    if (resno == HTTP_NO_RESPONSE) {
+        _close(client);
+        return false;
+    }
+    if (!strcasecmp(method, "HEAD") || resno == HTTP_CODE_NO_CONTENT
+            || resno == HTTP_CODE_NOT_MODIFIED) {
+        client->bodystate = BODY_END;
+    }
+
+    // stream out the body
+    const void *slice;
+    ssize_t slicesize;
+    while ((slicesize = readbody(client, &slice)) > 0) {
+        if (callback(userdata, slice, slicesize) == false) {
+            _close(client);
+            return false;
         }
     }
 
-    return rescode;
+    return (slicesize == 0);
 }
 
 /**
@@ -1372,7 +1867,8 @@ static int readresponse(qhttpclient_t *client, qlisttbl_t *resheaders,
 static ssize_t gets_(qhttpclient_t *client, char *buf, size_t bufsize) {
 #ifdef ENABLE_OPENSSL
     if (client->ssl == NULL) {
-        return qio_gets(client->socket, buf, bufsize, client->timeoutms);
+        return qio_reader_gets(client->reader, buf, bufsize,
+                               client->timeoutms);
     } else {
         if (bufsize <= 1) return -1;
 
@@ -1410,7 +1906,7 @@ static ssize_t gets_(qhttpclient_t *client, char *buf, size_t bufsize) {
         return -1;
     }
 #else
-    return qio_gets(client->socket, buf, bufsize, client->timeoutms);
+    return qio_reader_gets(client->reader, buf, bufsize, client->timeoutms);
 #endif
 }
 
@@ -1436,7 +1932,8 @@ static ssize_t gets_(qhttpclient_t *client, char *buf, size_t bufsize) {
 static ssize_t read_(qhttpclient_t *client, void *buf, size_t nbytes) {
 #ifdef ENABLE_OPENSSL
     if (client->ssl == NULL) {
-        return qio_read(client->socket, buf, nbytes, client->timeoutms);
+        return qio_reader_read(client->reader, buf, nbytes,
+                               client->timeoutms);
     } else {
         if (nbytes == 0) return 0;
 
@@ -1474,7 +1971,7 @@ static ssize_t read_(qhttpclient_t *client, void *buf, size_t nbytes) {
         return -1;
     }
 #else
-    return qio_read(client->socket, buf, nbytes, client->timeoutms);
+    return qio_reader_read(client->reader, buf, nbytes, client->timeoutms);
 #endif
 }
 
@@ -1539,11 +2036,23 @@ static off_t recvfile(qhttpclient_t *client, int fd, off_t nbytes) {
 
     off_t total = 0;  // total size sent
     while (total < nbytes) {
+        // plain connection, let the kernel move the rest to the file.
+        size_t pending = qio_reader_pending(client->reader);
+        if (client->ssl == NULL && pending == 0) {
+            off_t rsize = qio_send(fd, client->socket, nbytes - total,
+                                   client->timeoutms);
+            if (rsize > 0)
+                total += rsize;
+            break;
+        }
+
         size_t chunksize;  // this time sending size
         if (nbytes - total <= sizeof(buf))
             chunksize = nbytes - total;
         else
             chunksize = sizeof(buf);
+        if (client->ssl == NULL && chunksize > pending)
+            chunksize = pending;  // buffered data first
 
         // read
         ssize_t rsize = read_(client, buf, chunksize);
@@ -1581,6 +2090,12 @@ static off_t sendfile_(qhttpclient_t *client, int fd, off_t nbytes) {
     if (nbytes == 0)
         return 0;
 
+    if (client->ssl == NULL) {
+        // no need to copy through user space.
+        off_t total = qio_send(client->socket, fd, nbytes, -1);
+        return (total > 0) ? total : -1;
+    }
+
     unsigned char buf[MAX_ATOMIC_DATA_SIZE];
 
     off_t total = 0;  // total size sent
@@ -1640,10 +2155,8 @@ static bool _close(qhttpclient_t *client) {
             ssl->ssl = NULL;
         }
 
-        if (ssl->ctx != NULL) {
-            SSL_CTX_free(ssl->ctx);
-            ssl->ctx = NULL;
-        }
+        // the context is shared
+        ssl->ctx = NULL;
     }
 #endif
 
@@ -1655,9 +2168,16 @@ static bool _close(qhttpclient_t *client) {
     }
 
     // close connection
+    _pipe_watch(client, false);
     close(client->socket);
     client->socket = -1;
+    qio_reader_reset(client->reader, -1);
     client->connclose = false;
+    client->bodystate = BODY_NONE;
+    _decoder_start(client, false);
+
+    // requests in flight will never be answered
+    _pipe_fail(client);
 
     return true;
 }
@@ -1682,6 +2202,11 @@ static void _free(qhttpclient_t *client) {
 
     if (client->ssl != NULL)
         free(client->ssl);
+    _pipe_free(client);
+    if (client->bodybuf != NULL)
+        free(client->bodybuf);
+    _decoder_free(client);
+    qio_reader_free(client->reader);
     if (client->hostname != NULL)
         free(client->hostname);
     if (client->useragent != NULL)
@@ -1690,7 +2215,1057 @@ static void _free(qhttpclient_t *client) {
     free(client);
 }
 
+/**
+ * Create a pool of keep-alive HTTP connections.
+ *
+ * The pool hands out idle connections to the same host, port and protocol
+ * instead of opening new ones, and resolves each host name only once.
+ * The pool is thread-safe, so many threads can share one.
+ *
+ * @param maxperhost  maximum connections per host, 0 for unlimited.
+ * @param idlesec     seconds an idle connection is kept, 0 for no limit.
+ *
+ * @return pool object if successful, otherwise returns NULL.
+ * @retval errno  will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @code
+ *   qhttpclient_pool_t *pool = qhttpclient_pool(8, 30);
+ *
+ *   qhttpclient_t *client = pool->get(pool, "http://www.qdecoder.org", 0);
+ *   client->get(client, "/robots.txt", fd, &savesize, &rescode,
+ *               NULL, NULL, NULL, NULL);
+ *   pool->release(pool, client);
+ *
+ *   pool->free(pool);
+ * @endcode
+ *
+ * @note
+ *  Clients from get() have keep-alive turned on. When the limit of a host
+ *  is reached, get() waits until another thread releases a connection to
+ *  the host.
+ */
+qhttpclient_pool_t *qhttpclient_pool(int maxperhost, int idlesec) {
+    if (maxperhost < 0 || idlesec < 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    qhttpclient_pool_t *pool = (qhttpclient_pool_t *) calloc(
+            1, sizeof(qhttpclient_pool_t));
+    qhttpclient_poollock_t *lock = (qhttpclient_poollock_t *) calloc(
+            1, sizeof(qhttpclient_poollock_t));
+    qhashtbl_t *hosts = qhashtbl(0, 0);
+    if (pool == NULL || lock == NULL || hosts == NULL) {
+        free(pool);
+        free(lock);
+        if (hosts != NULL)
+            hosts->free(hosts);
+        errno = ENOMEM;
+        return NULL;
+    }
+    pthread_mutex_init(&lock->mutex, NULL);
+    pthread_cond_init(&lock->cond, NULL);
+
+    pool->hosts = hosts;
+    pool->lock = lock;
+    pool->maxperhost = maxperhost;
+    pool->idlesec = idlesec;
+
+    // member methods
+    pool->get = pool_get;
+    pool->release = pool_release;
+    pool->free = pool_free;
+
+    return pool;
+}
+
+/**
+ * qhttpclient_pool->get(): Get a client connected to the destination.
+ *
+ * @param pool      qhttpclient_pool object pointer
+ * @param destname  remote address, one of IP address, FQDN domain name and URI.
+ * @param port      remote port number. (can be 0 when destname is URI)
+ *
+ * @return HTTP client object if succcessful, otherwise returns NULL.
+ *
+ * @note
+ *  An idle connection is handed out if there is one, otherwise a new client
+ *  is created which connects on its first request. Hand the client back
+ *  with release() instead of free().
+ */
+static qhttpclient_t *pool_get(qhttpclient_pool_t *pool, const char *destname,
+                               int port) {
+    bool ishttps = false;
+    char hostname[256];
+    if (_parse_dest(destname, &port, &ishttps, hostname, sizeof(hostname))
+            == false) {
+        return NULL;
+    }
+
+    char key[sizeof(hostname) + 32];
+    snprintf(key, sizeof(key), "%s:%d:%d", hostname, port, ishttps);
+
+    qhashtbl_t *hosts = (qhashtbl_t *) pool->hosts;
+    qhttpclient_poollock_t *lock = (qhttpclient_poollock_t *) pool->lock;
+    qhttpclient_poolhost_t **entry, *host;
+
+    pthread_mutex_lock(&lock->mutex);
+    entry = hosts->get(hosts, key, NULL, false);
+    if (entry == NULL) {
+        // name lookup without holding the pool
+        pthread_mutex_unlock(&lock->mutex);
+        struct sockaddr_in addr;
+        if (qsocket_get_addr(&addr, hostname, port) == false) {
+            return NULL;
+        }
+
+        pthread_mutex_lock(&lock->mutex);
+        entry = hosts->get(hosts, key, NULL, false);
+        if (entry == NULL) {
+            host = (qhttpclient_poolhost_t *) calloc(
+                    1, sizeof(qhttpclient_poolhost_t));
+            if (host == NULL
+                    || (host->hostname = strdup(hostname)) == NULL
+                    || hosts->put(hosts, key, &host, sizeof(host)) == false) {
+                if (host != NULL)
+                    free(host->hostname);
+                free(host);
+                pthread_mutex_unlock(&lock->mutex);
+                errno = ENOMEM;
+                return NULL;
+            }
+            host->port = port;
+            host->ishttps = ishttps;
+            host->addr = addr;
+            entry = hosts->get(hosts, key, NULL, false);
+        }
+    }
+    host = *entry;
+
+    qhttpclient_t *client = NULL;
+    while (true) {
+        // take the most recently used connection, dropping stale ones
+        time_t now = time(NULL);
+        while (host->numidle > 0) {
+            qhttpclient_t *idle = host->idle[--host->numidle].client;
+            if ((pool->idlesec == 0
+                    || now - host->idle[host->numidle].since < pool->idlesec)
+                    && _is_reusable(idle) == true) {
+                client = idle;
+                break;
+            }
+            host->conns--;
+            pthread_mutex_unlock(&lock->mutex);
+            _free(idle);
+            pthread_mutex_lock(&lock->mutex);
+        }
+        if (client != NULL)
+            break;
+
+        // or a new one if the host is under the limit
+        if (pool->maxperhost == 0 || host->conns < pool->maxperhost) {
+            host->conns++;
+            break;
+        }
+        pthread_cond_wait(&lock->cond, &lock->mutex);
+    }
+    pthread_mutex_unlock(&lock->mutex);
+
+    if (client == NULL) {
+        client = _new_client(&host->addr, host->hostname, host->port,
+                             host->ishttps);
+        if (client == NULL) {
+            pthread_mutex_lock(&lock->mutex);
+            host->conns--;
+            pthread_cond_signal(&lock->cond);
+            pthread_mutex_unlock(&lock->mutex);
+            return NULL;
+        }
+        client->setkeepalive(client, true);
+        client->pool = host;
+    }
+
+    return client;
+}
+
+/**
+ * qhttpclient_pool->release(): Hand a client back to the pool.
+ *
+ * @param pool      qhttpclient_pool object pointer
+ * @param client    qhttpclient object pointer from get()
+ *
+ * @note
+ *  The connection is kept for reuse when the last response allowed
+ *  keep-alive and nothing is left unread. Otherwise it is closed and the
+ *  client is de-allocated.
+ */
+static void pool_release(qhttpclient_pool_t *pool, qhttpclient_t *client) {
+    qhttpclient_poollock_t *lock = (qhttpclient_poollock_t *) pool->lock;
+    qhttpclient_poolhost_t *host = (qhttpclient_poolhost_t *) client->pool;
+
+    bool reuse = (client->keepalive == true && client->connclose == false
+            && _is_reusable(client) == true);
+
+    pthread_mutex_lock(&lock->mutex);
+    if (reuse == true && host->numidle == host->maxidle) {
+        int maxidle = (host->maxidle > 0) ? host->maxidle * 2 : 4;
+        void *idle = realloc(host->idle, sizeof(*host->idle) * maxidle);
+        if (idle != NULL) {
+            host->idle = idle;
+            host->maxidle = maxidle;
+        } else {
+            reuse = false;
+        }
+    }
+    if (reuse == true) {
+        host->idle[host->numidle].client = client;
+        host->idle[host->numidle].since = time(NULL);
+        host->numidle++;
+    } else {
+        host->conns--;
+    }
+    pthread_cond_signal(&lock->cond);
+    pthread_mutex_unlock(&lock->mutex);
+
+    if (reuse == false) {
+        _free(client);
+    }
+}
+
+/**
+ * qhttpclient_pool->free(): Close idle connections and free the pool.
+ *
+ * @param pool      qhttpclient_pool object pointer
+ *
+ * @note
+ *  All clients must be released to the pool before calling this.
+ */
+static void pool_free(qhttpclient_pool_t *pool) {
+    qhashtbl_t *hosts = (qhashtbl_t *) pool->hosts;
+    qhttpclient_poollock_t *lock = (qhttpclient_poollock_t *) pool->lock;
+
+    qhashtbl_obj_t obj;
+    memset((void *) &obj, 0, sizeof(obj));
+    while (hosts->getnext(hosts, &obj, false) == true) {
+        qhttpclient_poolhost_t *host = *(qhttpclient_poolhost_t **) obj.data;
+        while (host->numidle > 0) {
+            _free(host->idle[--host->numidle].client);
+        }
+        free(host->idle);
+        free(host->hostname);
+        free(host);
+    }
+    hosts->free(hosts);
+
+    pthread_cond_destroy(&lock->cond);
+    pthread_mutex_destroy(&lock->mutex);
+    free(lock);
+    free(pool);
+}
+
+
 #ifndef _DOXYGEN_SKIP
+static qhttpclient_t *_new_client(const struct sockaddr_in *addr,
+                                  const char *hostname, int port,
+                                  bool ishttps) {
+    // allocate  object
+    qhttpclient_t *client = (qhttpclient_t *) malloc(sizeof(qhttpclient_t));
+    if (client == NULL)
+        return NULL;
+    memset((void *) client, 0, sizeof(qhttpclient_t));
+
+    // initialize object
+    client->socket = -1;
+    client->reader = qio_reader(-1, 0);
+    if (client->reader == NULL) {
+        free(client);
+        return NULL;
+    }
+
+    memcpy((void *) &client->addr, (void *) addr, sizeof(client->addr));
+    client->hostname = strdup(hostname);
+    client->port = port;
+
+    // member methods
+    client->setssl = setssl;
+    client->settimeout = settimeout;
+    client->setkeepalive = setkeepalive;
+    client->setuseragent = setuseragent;
+    client->setdecoding = setdecoding;
+
+    client->open = open_;
+
+    client->head = head;
+    client->get = get;
+    client->put = put;
+    client->cmd = cmd;
+
+    client->sendrequest = sendrequest;
+    client->readresponse = readresponse;
+    client->readbody = readbody;
+    client->stream = stream;
+
+    client->pipeline = pipeline;
+    client->dispatch = dispatch;
+    client->inflight = inflight;
+    client->attach = attach;
+
+    client->gets = gets_;
+    client->read = read_;
+    client->write = write_;
+    client->recvfile = recvfile;
+    client->sendfile = sendfile_;
+
+    client->close = _close;
+    client->free = _free;
+
+    // init client
+    settimeout(client, 0);
+    setkeepalive(client, false);
+    setuseragent(client, QHTTPCLIENT_NAME);
+    if (ishttps == true)
+        setssl(client);
+
+    return client;
+}
+
+static bool _parse_dest(const char *destname, int *port, bool *ishttps,
+                        char *hostname, size_t namesize) {
+    if (*port == 0 || strstr(destname, "://") != NULL) {
+        if (_parse_uri(destname, ishttps, hostname, namesize, port) == false) {
+            DEBUG("Can't parse URI %s", destname);
+            return false;
+        }
+
+        DEBUG("https: %d, hostname: %s, port:%d\n", *ishttps, hostname, *port);
+    } else {
+        qstrcpy(hostname, namesize, destname);
+    }
+
+    return true;
+}
+
+// reads the status line and the headers for readresponse().
+static int _read_response(qhttpclient_t *client, qlisttbl_t *resheaders,
+                          off_t *contentlength) {
+    if (contentlength != NULL) {
+        *contentlength = 0;
+    }
+    client->bodystate = BODY_NONE;
+
+    // read response
+    char buf[1024];
+    if (gets_(client, buf, sizeof(buf)) <= 0)
+        return HTTP_NO_RESPONSE;
+
+    // parse response code
+    if (strncmp(buf, "HTTP/", CONST_STRLEN("HTTP/")))
+        return HTTP_NO_RESPONSE;
+    char *tmp = strstr(buf, " ");
+    if (tmp == NULL)
+        return HTTP_NO_RESPONSE;
+    int rescode = atoi(tmp + 1);
+    if (rescode == 0)
+        return HTTP_NO_RESPONSE;
+    bool http10 = (strncmp(buf, "HTTP/1.0", CONST_STRLEN("HTTP/1.0")) == 0);
+
+    // read headers
+    off_t clength = 0;
+    bool haslength = false;
+    bool keepalive = false;
+    bool encoded = false;
+    while (gets_(client, buf, sizeof(buf)) > 0) {
+        if (buf[0] == '\0')
+            break;
+
+        // parse header
+        char *name = buf;
+        char *value = strstr(buf, ":");
+        if (value != NULL) {
+            *value = '\0';
+            value += 1;
+            qstrtrim(value);
+        } else {
+            // missing colon
+            value = "";
+        }
+
+        if (resheaders != NULL) {
+            resheaders->putstr(resheaders, name, value);
+        }
+
+        // check Connection header
+        if (!strcasecmp(name, "Connection")) {
+            if (!strcasecmp(value, "close")) {
+                client->connclose = true;
+            } else if (!strcasecmp(value, "keep-alive")) {
+                keepalive = true;
+            }
+        }
+        // check Content-Encoding header
+        else if (!strcasecmp(name, "Content-Encoding")) {
+            encoded = _is_encoded(value);
+        }
+        // check Content-Length & Transfer-Encoding header
+        else if (clength == 0) {
+            if (!strcasecmp(name, "Content-Length")) {
+                clength = atoll(value);
+                haslength = true;
+            }
+            // check transfer-encoding header
+            else if (!strcasecmp(name, "Transfer-Encoding")
+                    && !strcasecmp(value, "chunked")) {
+                clength = -1;
+                haslength = true;
+            }
+        }
+    }
+    if (contentlength != NULL) {
+        *contentlength = clength;
+    }
+
+    // HTTP/1.0 servers close the connection unless they say otherwise
+    if (http10 == true && keepalive == false && rescode / 100 != 1) {
+        client->connclose = true;
+    }
+
+    // ready for readbody()
+    if (rescode / 100 != 1) {
+        client->bodyremain = (clength > 0) ? clength : 0;
+        if (clength > 0) {
+            client->bodystate = BODY_LENGTH;
+        } else if (clength < 0) {
+            client->bodystate = BODY_CHUNKSIZE;
+        } else if (haslength == false && client->connclose == true
+                && rescode != HTTP_CODE_NO_CONTENT
+                && rescode != HTTP_CODE_NOT_MODIFIED) {
+            // delimited by the end of the connection
+            client->bodystate = BODY_UNTILCLOSE;
+        } else {
+            client->bodystate = BODY_END;
+        }
+    }
+    _decoder_start(client, (rescode / 100 != 1) ? encoded : false);
+
+    return rescode;
+}
+
+// an idle connection must not have anything to read, not even EOF.
+static bool _is_reusable(qhttpclient_t *client) {
+    if (client->socket < 0)
+        return false;
+    if (qio_reader_pending(client->reader) > 0)
+        return false;
+#ifdef ENABLE_OPENSSL
+    if (client->ssl != NULL) {
+        struct SslConn *ssl = client->ssl;
+        if (ssl->ssl != NULL && SSL_pending(ssl->ssl) > 0)
+            return false;
+    }
+#endif
+    return (qio_wait_readable(client->socket, 0) == 0);
+}
+
+static void *_pipe_get(qhttpclient_t *client) {
+    if (client->pipe != NULL)
+        return client->pipe;
+
+    qhttpclient_pipe_t *pipe = (qhttpclient_pipe_t *) calloc(
+            1, sizeof(qhttpclient_pipe_t));
+    if (pipe == NULL || (pipe->queue = qlist(0)) == NULL) {
+        free(pipe);
+        errno = ENOMEM;
+        return NULL;
+    }
+    pipe->state = PIPE_STATUS;
+
+    client->pipe = pipe;
+    return pipe;
+}
+
+static bool _pipe_watch(qhttpclient_t *client, bool watch) {
+    qhttpclient_pipe_t *pipe = client->pipe;
+    if (pipe == NULL || pipe->loop == NULL || client->socket < 0)
+        return true;
+
+    if (watch == false) {
+        return pipe->loop->remove(pipe->loop, client->socket);
+    }
+    return pipe->loop->add(pipe->loop, client->socket, QEVLOOP_READ,
+                           _pipe_event, client);
+}
+
+static void _pipe_event(qevloop_t *loop, int fd, int events, void *userdata) {
+    qhttpclient_t *client = (qhttpclient_t *) userdata;
+    if (dispatch(client, 0) == 0 && (events & QEVLOOP_ERROR)
+            && client->socket == fd) {
+        // hang-up with nothing in flight
+        _close(client);
+    }
+}
+
+// parse what's buffered. returns 1 for a response called back, 0 for more
+// data needed, -1 for malformed response.
+static int _pipe_parse(qhttpclient_t *client) {
+    qhttpclient_pipe_t *pipe = client->pipe;
+    qio_reader_t *reader = client->reader;
+    char buf[1024];
+
+    while (true) {
+        // the body states take the buffered bytes as is
+        if (pipe->state == PIPE_BODY || pipe->state == PIPE_CHUNKDATA
+                || pipe->state == PIPE_UNTILCLOSE) {
+            size_t pending = qio_reader_pending(reader);
+            if (pipe->state != PIPE_UNTILCLOSE
+                    && pending > (size_t) pipe->remain) {
+                pending = pipe->remain;
+            }
+            if (pending > 0 && _pipe_take(client, pending) == false)
+                return -1;
+            if (pipe->state == PIPE_UNTILCLOSE)
+                return 0;
+
+            pipe->remain -= pending;
+            if (pipe->remain > 0)
+                return 0;
+            if (pipe->state == PIPE_BODY)
+                return _pipe_complete(client);
+            pipe->state = PIPE_CHUNKEND;
+            continue;
+        }
+
+        // the others are line by line
+        if (qio_reader_hasline(reader) == false)
+            return 0;
+        if (qio_reader_gets(reader, buf, sizeof(buf), 0) <= 0)
+            return -1;
+
+        switch (pipe->state) {
+            case PIPE_STATUS: {
+                if (buf[0] == '\0')
+                    continue;  // stray line break
+                if (strncmp(buf, "HTTP/", CONST_STRLEN("HTTP/")))
+                    return -1;
+                char *tmp = strstr(buf, " ");
+                if (tmp == NULL || (pipe->rescode = atoi(tmp + 1)) == 0)
+                    return -1;
+                pipe->resheaders = qlisttbl(
+                        QLISTTBL_UNIQUE | QLISTTBL_CASEINSENSITIVE);
+                if (pipe->resheaders == NULL)
+                    return -1;
+                pipe->contentlength = -2;
+                pipe->state = PIPE_HEADER;
+                break;
+            }
+            case PIPE_HEADER: {
+                if (buf[0] != '\0') {
+                    char *name = buf;
+                    char *value = strstr(buf, ":");
+                    if (value != NULL) {
+                        *value = '\0';
+                        value += 1;
+                        qstrtrim(value);
+                    } else {
+                        value = "";
+                    }
+                    pipe->resheaders->putstr(pipe->resheaders, name, value);
+
+                    if (!strcasecmp(name, "Connection")) {
+                        if (!strcasecmp(value, "close"))
+                            client->connclose = true;
+                    } else if (!strcasecmp(name, "Content-Length")) {
+                        if (pipe->contentlength == -2)
+                            pipe->contentlength = atoll(value);
+                    } else if (!strcasecmp(name, "Transfer-Encoding")
+                            && !strcasecmp(value, "chunked")) {
+                        pipe->contentlength = -1;
+                    }
+                    break;
+                }
+
+                // end of headers
+                if (pipe->rescode / 100 == 1) {
+                    // interim response, the real one follows
+                    pipe->resheaders->free(pipe->resheaders);
+                    pipe->resheaders = NULL;
+                    pipe->state = PIPE_STATUS;
+                    break;
+                }
+
+                qhttpclient_pipereq_t *req = pipe->queue->getfirst(
+                        pipe->queue, NULL, false);
+                if (req->nobody == true
+                        || pipe->rescode == HTTP_CODE_NO_CONTENT
+                        || pipe->rescode == HTTP_CODE_NOT_MODIFIED
+                        || pipe->contentlength == 0) {
+                    return _pipe_complete(client);
+                } else if (pipe->contentlength == -1) {
+                    pipe->state = PIPE_CHUNKSIZE;
+                } else if (pipe->contentlength > 0) {
+                    pipe->remain = pipe->contentlength;
+                    pipe->state = PIPE_BODY;
+                    if (_pipe_take(client, 0) == false)
+                        return -1;
+                } else {
+                    pipe->state = PIPE_UNTILCLOSE;
+                }
+                break;
+            }
+            case PIPE_CHUNKSIZE: {
+                char *end = NULL;
+                pipe->remain = strtoll(buf, &end, 16);
+                if (end == buf || pipe->remain < 0)
+                    return -1;
+                pipe->state = (pipe->remain > 0) ? PIPE_CHUNKDATA : PIPE_TRAILER;
+                break;
+            }
+            case PIPE_CHUNKEND: {
+                pipe->state = PIPE_CHUNKSIZE;
+                break;
+            }
+            case PIPE_TRAILER: {
+                if (buf[0] == '\0')
+                    return _pipe_complete(client);
+                break;
+            }
+        }
+    }
+}
+
+// move buffered bytes to the body, keeping it NUL terminated.
+static bool _pipe_take(qhttpclient_t *client, size_t nbytes) {
+    qhttpclient_pipe_t *pipe = client->pipe;
+
+    size_t need = pipe->bodylen + nbytes + 1;
+    if (nbytes == 0 && pipe->state == PIPE_BODY) {
+        // room for the whole body at once
+        need = pipe->contentlength + 1;
+    }
+    if (need > pipe->bodysize) {
+        size_t bodysize = (pipe->bodysize > 0) ? pipe->bodysize : 1024;
+        while (bodysize < need)
+            bodysize *= 2;
+        char *body = realloc(pipe->body, bodysize);
+        if (body == NULL)
+            return false;
+        pipe->body = body;
+        pipe->bodysize = bodysize;
+    }
+
+    if (nbytes > 0
+            && qio_reader_read(client->reader, pipe->body + pipe->bodylen,
+                               nbytes, 0) != nbytes) {
+        return false;
+    }
+    pipe->bodylen += nbytes;
+    pipe->body[pipe->bodylen] = '\0';
+    return true;
+}
+
+// call back the response for the first request in flight.
+static int _pipe_complete(qhttpclient_t *client) {
+    qhttpclient_pipe_t *pipe = client->pipe;
+
+    if (pipe->body == NULL && _pipe_take(client, 0) == false)
+        return -1;
+
+    // decode the body as a whole
+    char *body = pipe->body, *decoded = NULL;
+    size_t bodylen = pipe->bodylen;
+    const char *encoding = pipe->resheaders->getstr(pipe->resheaders,
+                                                    "Content-Encoding",
+                                                    false);
+    if (client->decoding == true && encoding != NULL && _is_encoded(encoding)
+            && bodylen > 0) {
+        if (_decode_all(client, body, bodylen, &decoded, &bodylen) == false)
+            return -1;
+        body = decoded;
+    }
+
+    qhttpclient_pipereq_t req;
+    memcpy(&req, pipe->queue->getfirst(pipe->queue, NULL, false), sizeof(req));
+    pipe->queue->removefirst(pipe->queue);
+
+    // reset the parser first, the callback may queue more.
+    qlisttbl_t *resheaders = pipe->resheaders;
+    pipe->resheaders = NULL;
+    pipe->bodylen = 0;
+    pipe->state = PIPE_STATUS;
+
+    req.callback(client, pipe->rescode, resheaders, body, bodylen,
+                 req.userdata);
+    if (resheaders != NULL)
+        resheaders->free(resheaders);
+    if (decoded != NULL)
+        free(decoded);
+
+    return 1;
+}
+
+// fail the requests in flight and reset the parser.
+static void _pipe_fail(qhttpclient_t *client) {
+    qhttpclient_pipe_t *pipe = client->pipe;
+    if (pipe == NULL)
+        return;
+
+    if (pipe->resheaders != NULL) {
+        pipe->resheaders->free(pipe->resheaders);
+        pipe->resheaders = NULL;
+    }
+    pipe->bodylen = 0;
+    pipe->state = PIPE_STATUS;
+    if (pipe->queue->size(pipe->queue) == 0)
+        return;
+
+    // the callbacks may queue new requests on a new connection
+    qlist_t *failed = pipe->queue;
+    qlist_t *queue = qlist(0);
+    if (queue != NULL)
+        pipe->queue = queue;
+
+    qhttpclient_pipereq_t *req;
+    while ((req = failed->popfirst(failed, NULL)) != NULL) {
+        req->callback(client, HTTP_NO_RESPONSE, NULL, NULL, 0, req->userdata);
+        free(req);
+    }
+    if (failed != pipe->queue)
+        failed->free(failed);
+}
+
+static void _pipe_free(qhttpclient_t *client) {
+    qhttpclient_pipe_t *pipe = client->pipe;
+    if (pipe == NULL)
+        return;
+
+    _pipe_fail(client);
+    pipe->queue->free(pipe->queue);
+    if (pipe->body != NULL)
+        free(pipe->body);
+    free(pipe);
+    client->pipe = NULL;
+}
+
+// a slice of the body from the read buffer.
+static ssize_t _read_slice(qhttpclient_t *client, const void **data,
+                           off_t nbytes) {
+    size_t maxbytes = (nbytes < MAX_ATOMIC_DATA_SIZE) ?
+                      nbytes : MAX_ATOMIC_DATA_SIZE;
+#ifdef ENABLE_OPENSSL
+    if (client->ssl != NULL) {
+        // decrypted data has to land somewhere
+        if (client->bodybuf == NULL) {
+            client->bodybuf = malloc(MAX_ATOMIC_DATA_SIZE);
+            if (client->bodybuf == NULL)
+                return -1;
+        }
+        *data = client->bodybuf;
+        return read_(client, client->bodybuf, maxbytes);
+    }
+#endif
+    return qio_reader_take(client->reader, data, maxbytes, client->timeoutms);
+}
+
+// a slice of the body as it's transferred.
+static ssize_t _read_body(qhttpclient_t *client, const void **data) {
+    char buf[64];
+    while (true) {
+        switch (client->bodystate) {
+            case BODY_LENGTH:
+            case BODY_CHUNKDATA: {
+                ssize_t size = _read_slice(client, data, client->bodyremain);
+                if (size <= 0) {
+                    DEBUG("Broken pipe. %jd bytes left, errno=%d",
+                          (intmax_t) client->bodyremain, errno);
+                    _close(client);
+                    return -1;
+                }
+                client->bodyremain -= size;
+                if (client->bodyremain == 0) {
+                    client->bodystate = (client->bodystate == BODY_LENGTH) ?
+                                        BODY_END : BODY_CHUNKEND;
+                }
+                return size;
+            }
+            case BODY_CHUNKSIZE: {
+                char *end = NULL;
+                if (gets_(client, buf, sizeof(buf)) <= 0
+                        || (client->bodyremain = strtoll(buf, &end, 16)) < 0
+                        || end == buf) {
+                    _close(client);
+                    return -1;
+                }
+                if (client->bodyremain > 0) {
+                    client->bodystate = BODY_CHUNKDATA;
+                    break;
+                }
+
+                // last chunk, skip trailers
+                do {
+                    if (gets_(client, buf, sizeof(buf)) <= 0) {
+                        _close(client);
+                        return -1;
+                    }
+                } while (buf[0] != '\0');
+                client->bodystate = BODY_END;
+                break;
+            }
+            case BODY_CHUNKEND: {
+                if (gets_(client, buf, sizeof(buf)) <= 0) {
+                    _close(client);
+                    return -1;
+                }
+                client->bodystate = BODY_CHUNKSIZE;
+                break;
+            }
+            case BODY_UNTILCLOSE: {
+                // 0 is the end of the body unless it timed out
+                errno = 0;
+                ssize_t size = _read_slice(client, data, MAX_ATOMIC_DATA_SIZE);
+                if (size > 0)
+                    return size;
+                if (size < 0 || errno == ETIMEDOUT) {
+                    DEBUG("Broken pipe before the end, errno=%d", errno);
+                    _close(client);
+                    return -1;
+                }
+                client->bodystate = BODY_END;
+                break;
+            }
+            case BODY_END: {
+                client->bodystate = BODY_NONE;
+                if (client->keepalive == false || client->connclose == true) {
+                    _close(client);
+                }
+                return 0;
+            }
+            default: {
+                return 0;
+            }
+        }
+    }
+}
+
+static bool _is_encoded(const char *encoding) {
+    return (!strcasecmp(encoding, "gzip") || !strcasecmp(encoding, "x-gzip")
+            || !strcasecmp(encoding, "deflate"));
+}
+
+static void _decoder_start(qhttpclient_t *client, bool encoded) {
+#ifdef ENABLE_ZLIB
+    qhttpclient_decoder_t *dec = (qhttpclient_decoder_t *) client->decoder;
+    if (dec != NULL)
+        dec->active = false;
+    if (client->decoding == false || encoded == false)
+        return;
+
+    if (dec == NULL) {
+        dec = (qhttpclient_decoder_t *) calloc(1,
+                                               sizeof(qhttpclient_decoder_t));
+        if (dec == NULL)
+            return;
+        // 32 to detect zlib and gzip headers
+        if (inflateInit2(&dec->zs, 15 + 32) != Z_OK) {
+            free(dec);
+            return;
+        }
+        client->decoder = dec;
+    } else {
+        inflateReset(&dec->zs);
+    }
+    dec->zs.avail_in = 0;
+    dec->eof = false;
+    dec->ended = false;
+    dec->active = true;
+#endif
+}
+
+static bool _decoder_active(qhttpclient_t *client) {
+#ifdef ENABLE_ZLIB
+    qhttpclient_decoder_t *dec = (qhttpclient_decoder_t *) client->decoder;
+    return (dec != NULL && dec->active == true);
+#else
+    return false;
+#endif
+}
+
+// inflate the slices of the body into the output buffer of the decoder.
+static ssize_t _read_decoded(qhttpclient_t *client, const void **data) {
+#ifdef ENABLE_ZLIB
+    qhttpclient_decoder_t *dec = (qhttpclient_decoder_t *) client->decoder;
+    z_stream *zs = &dec->zs;
+
+    zs->next_out = (Bytef *) dec->out;
+    zs->avail_out = sizeof(dec->out);
+    while (zs->avail_out == sizeof(dec->out)) {
+        // the slice stays valid till the next read
+        if (zs->avail_in == 0 && dec->eof == false) {
+            const void *slice;
+            ssize_t size = _read_body(client, &slice);
+            if (size < 0) {
+                dec->active = false;
+                return -1;
+            }
+            dec->eof = (size == 0);
+            zs->next_in = (Bytef *) slice;
+            zs->avail_in = size;
+        }
+
+        if (dec->ended == true) {
+            if (zs->avail_in == 0) {
+                if (dec->eof == true)
+                    break;
+                continue;
+            }
+            // concatenated gzip member
+            inflateReset(zs);
+            dec->ended = false;
+        }
+
+        int ret = inflate(zs, Z_NO_FLUSH);
+        if (ret == Z_STREAM_END) {
+            dec->ended = true;
+        } else if (ret == Z_BUF_ERROR && dec->eof == true) {
+            break;  // truncated
+        } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            DEBUG("zlib: %s (%d)", (zs->msg != NULL) ? zs->msg : "", ret);
+            dec->active = false;
+            _close(client);
+            errno = EPROTO;
+            return -1;
+        }
+    }
+
+    size_t size = sizeof(dec->out) - zs->avail_out;
+    if (size > 0) {
+        *data = dec->out;
+        return size;
+    }
+
+    dec->active = false;
+    if (dec->ended == false) {
+        DEBUG("zlib: truncated stream.");
+        _close(client);
+        errno = EPROTO;
+        return -1;
+    }
+    return 0;
+#else
+    return _read_body(client, data);
+#endif
+}
+
+// decode a whole body in memory into a new NUL terminated buffer.
+static bool _decode_all(qhttpclient_t *client, const void *data, size_t size,
+                        char **out, size_t *outsize) {
+#ifdef ENABLE_ZLIB
+    _decoder_start(client, true);
+    qhttpclient_decoder_t *dec = (qhttpclient_decoder_t *) client->decoder;
+    if (dec == NULL)
+        return false;
+    dec->active = false;
+
+    z_stream *zs = &dec->zs;
+    zs->next_in = (Bytef *) data;
+    zs->avail_in = size;
+
+    char *buf = NULL;
+    size_t buflen = 0, bufsize = 0;
+    int ret = Z_OK;
+    while (true) {
+        if (bufsize - buflen < 2) {
+            bufsize = (bufsize > 0) ? bufsize * 2 : size * 4 + 64;
+            char *tmp = realloc(buf, bufsize);
+            if (tmp == NULL)
+                break;
+            buf = tmp;
+        }
+
+        zs->next_out = (Bytef *) buf + buflen;
+        zs->avail_out = bufsize - buflen - 1;
+        ret = inflate(zs, Z_NO_FLUSH);
+        buflen = bufsize - 1 - zs->avail_out;
+        if (ret == Z_STREAM_END && zs->avail_in > 0) {
+            inflateReset(zs);  // concatenated gzip member
+            continue;
+        }
+        if (ret != Z_OK || (zs->avail_in == 0 && zs->avail_out > 0))
+            break;
+    }
+
+    if (ret != Z_STREAM_END) {
+        DEBUG("zlib: can't decode the body (%d)", ret);
+        free(buf);
+        return false;
+    }
+    buf[buflen] = '\0';
+    *out = buf;
+    *outsize = buflen;
+    return true;
+#else
+    return false;
+#endif
+}
+
+static void _decoder_free(qhttpclient_t *client) {
+#ifdef ENABLE_ZLIB
+    qhttpclient_decoder_t *dec = (qhttpclient_decoder_t *) client->decoder;
+    if (dec != NULL) {
+        inflateEnd(&dec->zs);
+        free(dec);
+        client->decoder = NULL;
+    }
+#endif
+}
+
+#ifdef ENABLE_OPENSSL
+static void _ssl_init(void) {
+    SSL_load_error_strings();
+    SSL_library_init();
+
+    _ssl_sessions = qhashtbl(0, 0);
+    if (_ssl_sessions == NULL)
+        return;
+
+    _ssl_ctx = SSL_CTX_new(SSLv23_client_method());
+    if (_ssl_ctx == NULL) {
+        DEBUG("OpenSSL: %s", ERR_reason_error_string(ERR_get_error()));
+        return;
+    }
+
+    // client sessions are looked up by destination, not by session id.
+    SSL_CTX_set_session_cache_mode(_ssl_ctx, SSL_SESS_CACHE_CLIENT
+                                   | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(_ssl_ctx, _ssl_new_session);
+}
+
+// called on a new session or a new ticket, which can come after the
+// handshake with TLSv1.3.
+static int _ssl_new_session(SSL *ssl, SSL_SESSION *session) {
+    qhttpclient_t *client = (qhttpclient_t *) SSL_get_app_data(ssl);
+    if (client == NULL)
+        return 0;
+
+    char key[256 + 16];
+    snprintf(key, sizeof(key), "%s:%d", client->hostname, client->port);
+    pthread_mutex_lock(&_ssl_lock);
+    SSL_SESSION **old = _ssl_sessions->get(_ssl_sessions, key, NULL, false);
+    if (old != NULL) {
+        SSL_SESSION_free(*old);
+    }
+    bool stored = _ssl_sessions->put(_ssl_sessions, key, &session,
+                                     sizeof(session));
+    if (stored == false && old != NULL) {
+        _ssl_sessions->remove(_ssl_sessions, key);
+    }
+    pthread_mutex_unlock(&_ssl_lock);
+
+    // taking the reference when stored
+    return (stored == true) ? 1 : 0;
+}
+#endif
+
 static bool _set_socket_option(int socket) {
     bool ret = true;
 
@@ -46,6 +46,12 @@
  *   // close and release resources.
  *   log->free(log);
  * @endcode
+ *
+ * With QLOG_OPT_ASYNC, the messages are appended to a memory buffer and a
+ * background thread writes them out in batches, so the logging threads
+ * never wait for the disk unless the buffer is full. QLOG_OPT_DEFERRED goes
+ * further and leaves the formatting of writef() to the background thread,
+ * the logging threads only copy the arguments.
  */
 
 #ifndef DISABLE_QLOG
@@ -53,14 +59,23 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
 #include <string.h>
+#include <limits.h>
 #include <stdarg.h>
 #include <unistd.h>
 #include <time.h>
+#include <fcntl.h>
 #include <sys/stat.h>
 #include <errno.h>
+#include <pthread.h>
+#ifdef ENABLE_ZLIB
+#include <zlib.h>
+#endif
 #include "qinternal.h"
 #include "utilities/qstring.h"
+#include "utilities/qtime.h"
 #include "extensions/qlog.h"
 
 #ifndef _DOXYGEN_SKIP
@@ -68,10 +83,99 @@ static bool write_(qlog_t *log, const char *str);
 static bool writef(qlog_t *log, const char *format, ...);
 static bool duplicate(qlog_t *log, FILE *outfp, bool flush);
 static bool flush_(qlog_t *log);
+static bool timestamp(qlog_t *log, const char *format);
+static bool compress_(qlog_t *log, int level);
 static void free_(qlog_t *log);
 
 // internal usages
 static bool _real_open(qlog_t *log);
+static void _real_write(qlog_t *log, const char *buf, size_t size);
+static const char *_get_prefix(qlog_t *log, time_t now);
+
+// async mode
+typedef struct qlog_async_s qlog_async_t;
+struct qlog_async_s {
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;      /* signals the writer */
+    pthread_cond_t done;        /* signals the waiters for space or flush */
+    pthread_t thread;
+
+    char *buf;          /* messages being appended */
+    size_t bufsize;
+    size_t buflen;
+    char *wbuf;         /* messages being written by the writer */
+    size_t wbufsize;
+
+    uint64_t appended;  /* total bytes appended */
+    uint64_t written;   /* total bytes written out */
+    size_t dropped;     /* messages dropped since the last report */
+    bool drop;          /* drop messages instead of waiting for space */
+    bool deferred;      /* buffers hold records to be formatted */
+    bool flushreq;      /* a flush is requested */
+    bool stop;
+
+    char *out;          /* formatted records, QLOG_OPT_DEFERRED only */
+    size_t outsize;
+    size_t outlen;
+};
+
+static bool _async_start(qlog_t *log, bool drop, bool deferred);
+static void _async_stop(qlog_t *log);
+static char *_async_reserve(qlog_t *log, size_t len);
+static void _async_commit(qlog_t *log, size_t len);
+static bool _async_write(qlog_t *log, const char *str);
+static bool _async_writef(qlog_t *log, const char *format, va_list ap);
+static void _async_flush(qlog_t *log);
+static void *_async_writer(void *arg);
+
+// deferred mode
+typedef struct qlog_record_s qlog_record_t;
+struct qlog_record_s {
+    uint32_t size;          /* size of the data following */
+    time_t time;
+    const char *format;     /* NULL for a formatted message */
+};
+
+#define QLOG_SPEC_MAX   (32)    /* max length of a conversion specification */
+
+enum {
+    ARG_NONE = 0, ARG_INT, ARG_LONG, ARG_LLONG, ARG_SIZE, ARG_INTMAX,
+    ARG_PTRDIFF, ARG_DOUBLE, ARG_LDOUBLE, ARG_PTR, ARG_STR
+};
+
+static int _deferred_spec(const char *spec, int *type, int *prec);
+static ssize_t _deferred_pack(const char *format, va_list ap, char *out);
+static bool _out_append(qlog_async_t *async, const char *spec, int type,
+                        const char *arg, size_t argsize);
+static void _deferred_format(qlog_t *log, const char *buf, size_t buflen);
+
+// compression of rotated files
+typedef struct qlog_gzjob_s qlog_gzjob_t;
+struct qlog_gzjob_s {
+    qlog_gzjob_t *next;
+    char filepath[];
+};
+
+typedef struct qlog_gz_s qlog_gz_t;
+struct qlog_gz_s {
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+    pthread_t thread;
+
+    qlog_gzjob_t *head;     /* files waiting to be compressed */
+    qlog_gzjob_t *tail;
+    int level;
+    mode_t mode;
+    bool stop;
+};
+
+#define QLOG_GZ_BUFSIZE (64 * 1024)
+
+static bool _gz_start(qlog_t *log, int level);
+static void _gz_stop(qlog_gz_t *gz);
+static void _gz_queue(qlog_t *log, const char *filepath);
+static void *_gz_worker(void *arg);
+static bool _gz_file(const char *filepath, int level, mode_t mode);
 #endif
 
 /**
@@ -96,6 +200,15 @@ static bool _real_open(qlog_t *log);
  *   Available options:
  *   - QLOG_OPT_THREADSAFE - make it thread-safe.
  *   - QLOG_OPT_FLUSH -  flush out buffer everytime.
+ *   - QLOG_OPT_ASYNC - write by a background thread. It's thread-safe.
+ *   - QLOG_OPT_DROP - with QLOG_OPT_ASYNC, drop messages when the buffer is
+ *     full instead of waiting for the writer. The number of dropped
+ *     messages is logged when the writer catches up.
+ *   - QLOG_OPT_DEFERRED - async mode which leaves formatting to the writer.
+ *     writef() only copies the format pointer and the arguments, so the
+ *     format must stay valid until the message is written, like a string
+ *     literal. String arguments are copied. Formats with '*', %n or wide
+ *     characters are formatted in place as usual.
  *
  * @code
  *   qlog_t *log = qlog("/tmp/qdecoder-%Y%m%d.err", 0644, 86400, QLOG_OPT_THREADSAFE);
@@ -120,7 +233,8 @@ qlog_t *qlog(const char *filepathfmt, mode_t mode, int rotateinterval,
         log->rotateinterval = rotateinterval;
 
     // handle options
-    if (options & QLOG_OPT_THREADSAFE) {
+    if (options
+            & (QLOG_OPT_THREADSAFE | QLOG_OPT_ASYNC | QLOG_OPT_DEFERRED)) {
         Q_MUTEX_NEW(log->qmutex, true);
         if (log->qmutex == NULL) {
             errno = ENOMEM;
@@ -138,12 +252,22 @@ qlog_t *qlog(const char *filepathfmt, mode_t mode, int rotateinterval,
         free(log);
         return NULL;
     }
+    if ((options & (QLOG_OPT_ASYNC | QLOG_OPT_DEFERRED))
+            && _async_start(log, (options & QLOG_OPT_DROP),
+                            (options & QLOG_OPT_DEFERRED)) == false) {
+        fclose(log->fp);
+        Q_MUTEX_DESTROY(log->qmutex);
+        free(log);
+        return NULL;
+    }
 
     // member methods
     log->write = write_;
     log->writef = writef;
     log->duplicate = duplicate;
     log->flush = flush_;
+    log->timestamp = timestamp;
+    log->compress = compress_;
     log->free = free_;
 
     return log;
@@ -156,28 +280,38 @@ qlog_t *qlog(const char *filepathfmt, mode_t mode, int rotateinterval,
  * @param str       message string
  *
  * @return true if successful, otherewise returns false
+ *
+ * @note
+ *  With QLOG_OPT_ASYNC, true means the message is queued to be written,
+ *  and false with QLOG_OPT_DROP means it's dropped due to the full buffer.
  */
 static bool write_(qlog_t *log, const char *str) {
-    if (log == NULL || log->fp == NULL)
+    // the writer owns the stream in async mode, it's rotated there.
+    if (log == NULL || (log->async == NULL && log->fp == NULL))
         return false;
 
+    if (log->async != NULL)
+        return _async_write(log, str);
+
     Q_MUTEX_ENTER(log->qmutex);
+    time_t now = qtime_coarse();
+    const char *prefix = _get_prefix(log, now);
 
     /* duplicate stream */
     if (log->outfp != NULL) {
-        fprintf(log->outfp, "%s\n", str);
+        fprintf(log->outfp, "%s%s\n", prefix, str);
         if (log->outflush == true)
             fflush(log->outfp);
     }
 
     /* check if log rotation is needed */
-    if (log->nextrotate > 0 && time(NULL) >= log->nextrotate) {
+    if (log->nextrotate > 0 && now >= log->nextrotate) {
         _real_open(log);
     }
 
     /* log to file */
     bool ret = false;
-    if (fprintf(log->fp, "%s\n", str) >= 0) {
+    if (fprintf(log->fp, "%s%s\n", prefix, str) >= 0) {
         if (log->logflush == true)
             fflush(log->fp);
         ret = true;
@@ -197,9 +331,19 @@ static bool write_(qlog_t *log, const char *str) {
  * @return true if successful, otherewise returns false
  */
 static bool writef(qlog_t *log, const char *format, ...) {
-    if (log == NULL || log->fp == NULL)
+    // the writer owns the stream in async mode, it's rotated there.
+    if (log == NULL || (log->async == NULL && log->fp == NULL))
         return false;
 
+    if (log->async != NULL
+            && ((qlog_async_t *) log->async)->deferred == true) {
+        va_list ap;
+        va_start(ap, format);
+        bool ret = _async_writef(log, format, ap);
+        va_end(ap);
+        return ret;
+    }
+
     char *str;
     DYNAMIC_VSPRINTF(str, format);
     if (str == NULL)
@@ -245,11 +389,18 @@ static bool duplicate(qlog_t *log, FILE *outfp, bool flush) {
  * @param log       a pointer of qlog_t
  *
  * @return true if successful, otherewise returns false
+ *
+ * @note
+ *  With QLOG_OPT_ASYNC, it waits until the messages logged before the call
+ *  are written out.
  */
 static bool flush_(qlog_t *log) {
     if (log == NULL)
         return false;
 
+    if (log->async != NULL)
+        _async_flush(log);
+
     // only flush if flush flag is disabled
     Q_MUTEX_ENTER(log->qmutex);
     if (log->fp != NULL && log->logflush == false)
@@ -258,7 +409,112 @@ static bool flush_(qlog_t *log) {
         fflush(log->outfp);
     Q_MUTEX_LEAVE(log->qmutex);
 
+    return true;
+}
+
+/**
+ * qlog->timestamp(): Prefix every message with the time it's logged.
+ *
+ * @param log       a pointer of qlog_t
+ * @param format    strftime() format of the prefix in local time, like
+ *                  "[%Y-%m-%d %H:%M:%S] ". NULL to disable.
+ *
+ * @return true if successful, otherewise returns false
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument or the format is too long.
+ *
+ * @code
+ *   log->timestamp(log, "%Y%m%d %H:%M:%S ");
+ *   log->write(log, "Service started.");  // 20240101 12:00:00 Service started.
+ * @endcode
+ *
+ * @note
+ *  The prefix is rendered once a second from a coarse clock, so logging
+ *  doesn't cost a localtime() and strftime() call per message as formatting
+ *  the time in the message does. With QLOG_OPT_DEFERRED, it waits until the
+ *  queued messages are written out with the previous prefix.
+ */
+static bool timestamp(qlog_t *log, const char *format) {
+    if (log == NULL || (format != NULL
+                        && strlen(format) >= sizeof(log->tsformat))) {
+        errno = EINVAL;
+        return false;
+    }
+
+    // deferred records get the prefix when they're formatted, so the queued
+    // ones are written out with the prefix they're logged with.
+    qlog_async_t *async = (qlog_async_t *) log->async;
+    if (async != NULL && async->deferred == true)
+        _async_flush(log);
+
+    Q_MUTEX_ENTER(log->qmutex);
+    if (async != NULL)
+        pthread_mutex_lock(&async->lock);
+    qstrcpy(log->tsformat, sizeof(log->tsformat), (format) ? format : "");
+    log->tsprefix[0] = '\0';
+    log->tstime = 0;
+    if (async != NULL)
+        pthread_mutex_unlock(&async->lock);
+    Q_MUTEX_LEAVE(log->qmutex);
+
+    return true;
+}
+
+/**
+ * qlog->compress(): Compress the rotated log files with gzip.
+ *
+ * When the log file is rotated, the previous file is compressed into a
+ * file of the same name with ".gz" suffix by a background thread and
+ * removed. If the ".gz" file already exists like an overrided daily log
+ * file, the compressed data is appended as another gzip member.
+ *
+ * @param log       a pointer of qlog_t
+ * @param level     compression level from 1(fastest) to 9(best),
+ *                  0 to stop compressing.
+ *
+ * @return true if successful, otherewise returns false
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - ENOTSUP : Not compiled with zlib(--with-zlib).
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @code
+ *   qlog_t *log = qlog("/tmp/access-%Y%m%d%H.log", 0644, 3600, 0);
+ *   log->compress(log, 6);  // access-2024010112.log.gz, ...
+ * @endcode
+ *
+ * @note
+ *  The file being logged is never compressed, only the files left behind
+ *  by rotation are. Files queued when stopping are still compressed.
+ */
+static bool compress_(qlog_t *log, int level) {
+    if (log == NULL || level < 0 || level > 9) {
+        errno = EINVAL;
+        return false;
+    }
+#ifndef ENABLE_ZLIB
+    errno = ENOTSUP;
     return false;
+#endif
+
+    bool ret = true;
+    qlog_gz_t *stopgz = NULL;
+    Q_MUTEX_ENTER(log->qmutex);
+    qlog_gz_t *gz = (qlog_gz_t *) log->gz;
+    if (level == 0) {
+        stopgz = gz;
+        log->gz = NULL;
+    } else if (gz != NULL) {
+        pthread_mutex_lock(&gz->lock);
+        gz->level = level;
+        pthread_mutex_unlock(&gz->lock);
+    } else {
+        ret = _gz_start(log, level);
+    }
+    Q_MUTEX_LEAVE(log->qmutex);
+    _gz_stop(stopgz);
+
+    return ret;
 }
 
 /**
@@ -270,13 +526,17 @@ static void free_(qlog_t *log) {
     if (log == NULL)
         return;
 
+    _async_stop(log);
     flush_(log);
     Q_MUTEX_ENTER(log->qmutex);
     if (log->fp != NULL) {
         fclose(log->fp);
         log->fp = NULL;
     }
+    qlog_gz_t *gz = (qlog_gz_t *) log->gz;
+    log->gz = NULL;
     Q_MUTEX_LEAVE(log->qmutex);
+    _gz_stop(gz);
     Q_MUTEX_DESTROY(log->qmutex);
     free(log);
     return;
@@ -312,6 +572,7 @@ static bool _real_open(qlog_t *log) {
                 fchmod(fileno(newfp), log->mode);
             fclose(log->fp);
             log->fp = newfp;
+            _gz_queue(log, log->filepath);
             qstrcpy(log->filepath, sizeof(log->filepath), newfilepath);
         } else {
             DEBUG("_real_open: Can't open log file '%s' for rotating.",
@@ -334,6 +595,743 @@ static bool _real_open(qlog_t *log) {
     return true;
 }
 
+// write out messages to the log file and the duplicated stream.
+static void _real_write(qlog_t *log, const char *buf, size_t size) {
+    /* duplicate stream */
+    if (log->outfp != NULL) {
+        fwrite(buf, 1, size, log->outfp);
+        if (log->outflush == true)
+            fflush(log->outfp);
+    }
+
+    /* check if log rotation is needed */
+    if (log->nextrotate > 0 && qtime_coarse() >= log->nextrotate) {
+        _real_open(log);
+    }
+
+    /* log to file */
+    fwrite(buf, 1, size, log->fp);
+    if (log->logflush == true)
+        fflush(log->fp);
+}
+
+// returns the timestamp prefix, rendering it again when the second changes.
+static const char *_get_prefix(qlog_t *log, time_t now) {
+    if (log->tsformat[0] != '\0' && now != log->tstime) {
+        qtime_localtime_strf(log->tsprefix, sizeof(log->tsprefix), now,
+                             log->tsformat);
+        log->tstime = now;
+    }
+    return log->tsprefix;
+}
+
+static bool _async_start(qlog_t *log, bool drop, bool deferred) {
+    qlog_async_t *async = (qlog_async_t *) calloc(1, sizeof(qlog_async_t));
+    if (async == NULL) {
+        errno = ENOMEM;
+        return false;
+    }
+    async->bufsize = async->wbufsize = QLOG_ASYNC_BUFSIZE;
+    async->buf = (char *) malloc(async->bufsize);
+    async->wbuf = (char *) malloc(async->wbufsize);
+    if (async->buf == NULL || async->wbuf == NULL) {
+        free(async->buf);
+        free(async->wbuf);
+        free(async);
+        errno = ENOMEM;
+        return false;
+    }
+    async->drop = drop;
+    async->deferred = deferred;
+    pthread_mutex_init(&async->lock, NULL);
+    pthread_cond_init(&async->wakeup, NULL);
+    pthread_cond_init(&async->done, NULL);
+
+    log->async = async;
+    if (pthread_create(&async->thread, NULL, _async_writer, log) != 0) {
+        log->async = NULL;
+        pthread_cond_destroy(&async->done);
+        pthread_cond_destroy(&async->wakeup);
+        pthread_mutex_destroy(&async->lock);
+        free(async->buf);
+        free(async->wbuf);
+        free(async);
+        return false;
+    }
+
+    return true;
+}
+
+// let the writer write out all the messages and finish.
+static void _async_stop(qlog_t *log) {
+    qlog_async_t *async = (qlog_async_t *) log->async;
+    if (async == NULL)
+        return;
+
+    pthread_mutex_lock(&async->lock);
+    async->stop = true;
+    pthread_cond_signal(&async->wakeup);
+    pthread_mutex_unlock(&async->lock);
+    pthread_join(async->thread, NULL);
+
+    log->async = NULL;
+    pthread_cond_destroy(&async->done);
+    pthread_cond_destroy(&async->wakeup);
+    pthread_mutex_destroy(&async->lock);
+    free(async->buf);
+    free(async->wbuf);
+    free(async->out);
+    free(async);
+}
+
+// take len bytes of the buffer, returns with the lock held on success.
+static char *_async_reserve(qlog_t *log, size_t len) {
+    qlog_async_t *async = (qlog_async_t *) log->async;
+
+    pthread_mutex_lock(&async->lock);
+    while (async->buflen + len > async->bufsize) {
+        if (async->buflen > 0 && async->drop == true) {
+            async->dropped++;
+            pthread_mutex_unlock(&async->lock);
+            return NULL;
+        }
+        if (async->buflen == 0) {
+            // bigger than the buffer, make it fit.
+            char *newbuf = (char *) realloc(async->buf, len);
+            if (newbuf == NULL) {
+                pthread_mutex_unlock(&async->lock);
+                errno = ENOMEM;
+                return NULL;
+            }
+            async->buf = newbuf;
+            async->bufsize = len;
+            break;
+        }
+        pthread_cond_signal(&async->wakeup);
+        pthread_cond_wait(&async->done, &async->lock);
+    }
+
+    return async->buf + async->buflen;
+}
+
+// hand the reserved bytes over to the writer and release the lock.
+static void _async_commit(qlog_t *log, size_t len) {
+    qlog_async_t *async = (qlog_async_t *) log->async;
+
+    if (async->buflen == 0)
+        pthread_cond_signal(&async->wakeup);
+    async->buflen += len;
+    async->appended += len;
+    pthread_mutex_unlock(&async->lock);
+}
+
+static bool _async_write(qlog_t *log, const char *str) {
+    qlog_async_t *async = (qlog_async_t *) log->async;
+    size_t strsize = strlen(str);
+
+    if (async->deferred == true) {
+        // a record without a format is a plain message.
+        qlog_record_t rec = { strsize, qtime_coarse(), NULL };
+        char *p = _async_reserve(log, sizeof(rec) + strsize);
+        if (p == NULL)
+            return false;
+        memcpy(p, &rec, sizeof(rec));
+        memcpy(p + sizeof(rec), str, strsize);
+        _async_commit(log, sizeof(rec) + strsize);
+        return true;
+    }
+
+    // keep a copy, waiting for space lets others render it again.
+    char prefix[sizeof(log->tsprefix)];
+    pthread_mutex_lock(&async->lock);
+    qstrcpy(prefix, sizeof(prefix), _get_prefix(log, qtime_coarse()));
+    pthread_mutex_unlock(&async->lock);
+    size_t prefixlen = strlen(prefix);
+
+    size_t len = prefixlen + strsize + 1;
+    char *p = _async_reserve(log, len);
+    if (p == NULL)
+        return false;
+    memcpy(p, prefix, prefixlen);
+    memcpy(p + prefixlen, str, strsize);
+    p[len - 1] = '\n';
+    _async_commit(log, len);
+
+    return true;
+}
+
+// queue the format and the arguments to be formatted by the writer.
+static bool _async_writef(qlog_t *log, const char *format, va_list ap) {
+    // measure the arguments
+    va_list ap2;
+    va_copy(ap2, ap);
+    ssize_t argsize = _deferred_pack(format, ap2, NULL);
+    va_end(ap2);
+    if (argsize < 0) {
+        // not supported, format it now.
+        char buf[1024];
+        va_copy(ap2, ap);
+        int n = vsnprintf(buf, sizeof(buf), format, ap2);
+        va_end(ap2);
+        if (n < 0)
+            return false;
+        if (n < (int) sizeof(buf))
+            return _async_write(log, buf);
+
+        char *str = (char *) malloc(n + 1);
+        if (str == NULL) {
+            errno = ENOMEM;
+            return false;
+        }
+        vsnprintf(str, n + 1, format, ap);
+        bool ret = _async_write(log, str);
+        free(str);
+        return ret;
+    }
+
+    qlog_record_t rec = { argsize, qtime_coarse(), format };
+    char *p = _async_reserve(log, sizeof(rec) + argsize);
+    if (p == NULL)
+        return false;
+    memcpy(p, &rec, sizeof(rec));
+    _deferred_pack(format, ap, p + sizeof(rec));
+    _async_commit(log, sizeof(rec) + argsize);
+
+    return true;
+}
+
+static void _async_flush(qlog_t *log) {
+    qlog_async_t *async = (qlog_async_t *) log->async;
+
+    pthread_mutex_lock(&async->lock);
+    uint64_t target = async->appended;
+    while (async->written < target) {
+        async->flushreq = true;
+        pthread_cond_signal(&async->wakeup);
+        pthread_cond_wait(&async->done, &async->lock);
+    }
+    pthread_mutex_unlock(&async->lock);
+}
+
+// background writer, swaps the buffers and writes out a whole buffer at once.
+static void *_async_writer(void *arg) {
+    qlog_t *log = (qlog_t *) arg;
+    qlog_async_t *async = (qlog_async_t *) log->async;
+
+    pthread_mutex_lock(&async->lock);
+    while (true) {
+        while (async->buflen == 0 && async->dropped == 0
+                && async->stop == false) {
+            pthread_cond_wait(&async->wakeup, &async->lock);
+        }
+        if (async->buflen == 0 && async->dropped == 0)
+            break;  // stopped and drained
+
+        // take the messages, the loggers go on with the other buffer.
+        char *buf = async->buf;
+        size_t bufsize = async->bufsize, buflen = async->buflen;
+        size_t dropped = async->dropped;
+        async->buf = async->wbuf;
+        async->bufsize = async->wbufsize;
+        async->buflen = 0;
+        async->dropped = 0;
+        async->wbuf = buf;
+        async->wbufsize = bufsize;
+        bool flushreq = (async->flushreq || async->stop);
+        async->flushreq = false;
+        pthread_cond_broadcast(&async->done);
+        pthread_mutex_unlock(&async->lock);
+
+        Q_MUTEX_ENTER(log->qmutex);
+        if (async->deferred == true) {
+            _deferred_format(log, buf, buflen);
+            _real_write(log, async->out, async->outlen);
+        } else {
+            _real_write(log, buf, buflen);
+        }
+        if (dropped > 0) {
+            char msg[64];
+            int msglen = snprintf(msg, sizeof(msg),
+                                  "qlog: %zu messages dropped\n", dropped);
+            _real_write(log, msg, msglen);
+        }
+        if (flushreq == true) {
+            fflush(log->fp);
+            if (log->outfp != NULL)
+                fflush(log->outfp);
+        }
+        Q_MUTEX_LEAVE(log->qmutex);
+
+        pthread_mutex_lock(&async->lock);
+        async->written += buflen;
+        pthread_cond_broadcast(&async->done);
+    }
+    pthread_mutex_unlock(&async->lock);
+
+    return NULL;
+}
+
+/*
+ * Deferred formatting
+ *
+ * A record is qlog_record_t followed by the arguments of the format packed
+ * in the order of the conversions. Integers, pointers and doubles are
+ * copied as they are in the size of their types, and strings are copied
+ * with their length in front, since they may be gone by the time the
+ * record is formatted.
+ */
+
+// parse a conversion specification at spec starting with '%'. returns its
+// length and the argument type, or 0 if it's not supported. prec is set to
+// the precision, or -1 if none, when it's not NULL.
+static int _deferred_spec(const char *spec, int *type, int *prec) {
+    const char *p = spec + 1;
+    if (prec != NULL)
+        *prec = -1;
+    if (*p == '%') {
+        *type = ARG_NONE;
+        return 2;
+    }
+
+    // flags, width and precision
+    while (*p != '\0' && strchr("-+ #0'", *p) != NULL)
+        p++;
+    while (*p >= '0' && *p <= '9')
+        p++;
+    if (*p == '.') {
+        p++;
+        int n = 0;
+        while (*p >= '0' && *p <= '9') {
+            if (n < INT_MAX / 10)
+                n = n * 10 + (*p - '0');
+            p++;
+        }
+        if (prec != NULL)
+            *prec = n;
+    }
+
+    // length modifier
+    int length = ARG_INT;
+    bool half = false;
+    if (p[0] == 'h') {
+        half = true;
+        p += (p[1] == 'h') ? 2 : 1;
+    } else if (p[0] == 'l' && p[1] == 'l') {
+        length = ARG_LLONG;
+        p += 2;
+    } else if (p[0] == 'l') {
+        length = ARG_LONG;
+        p++;
+    } else if (p[0] == 'z') {
+        length = ARG_SIZE;
+        p++;
+    } else if (p[0] == 'j') {
+        length = ARG_INTMAX;
+        p++;
+    } else if (p[0] == 't') {
+        length = ARG_PTRDIFF;
+        p++;
+    } else if (p[0] == 'L') {
+        length = ARG_LDOUBLE;
+        p++;
+    }
+
+    // conversion
+    if (*p != '\0' && strchr("diouxX", *p) != NULL && length != ARG_LDOUBLE) {
+        *type = length;
+    } else if (*p != '\0' && strchr("fFeEgGaA", *p) != NULL && half == false
+            && (length == ARG_INT || length == ARG_LONG
+                || length == ARG_LDOUBLE)) {
+        // 'l' has no effect on doubles
+        *type = (length == ARG_LDOUBLE) ? ARG_LDOUBLE : ARG_DOUBLE;
+    } else if (*p == 'c' && length == ARG_INT && half == false) {
+        *type = ARG_INT;
+    } else if (*p == 's' && length == ARG_INT && half == false) {
+        *type = ARG_STR;
+    } else if (*p == 'p' && length == ARG_INT && half == false) {
+        *type = ARG_PTR;
+    } else {
+        return 0;  // %n, '*' and wide characters
+    }
+
+    p++;
+    return (p - spec < QLOG_SPEC_MAX) ? (int) (p - spec) : 0;
+}
+
+// pack the arguments into out and returns the size. out can be NULL to get
+// the size only. returns -1 if the format is not supported.
+static ssize_t _deferred_pack(const char *format, va_list ap, char *out) {
+    size_t size = 0;
+    const char *p;
+    for (p = strchr(format, '%'); p != NULL; p = strchr(p, '%')) {
+        int type, prec;
+        int speclen = _deferred_spec(p, &type, &prec);
+        if (speclen == 0)
+            return -1;
+        p += speclen;
+
+#define PACK_ARG(t) do {                                                \
+            t _v = va_arg(ap, t);                                       \
+            if (out != NULL) memcpy(out + size, &_v, sizeof(t));        \
+            size += sizeof(t);                                          \
+        } while (0)
+
+        switch (type) {
+            case ARG_NONE :
+                break;
+            case ARG_INT :
+                PACK_ARG(int);
+                break;
+            case ARG_LONG :
+                PACK_ARG(long);
+                break;
+            case ARG_LLONG :
+                PACK_ARG(long long);
+                break;
+            case ARG_SIZE :
+                PACK_ARG(size_t);
+                break;
+            case ARG_INTMAX :
+                PACK_ARG(intmax_t);
+                break;
+            case ARG_PTRDIFF :
+                PACK_ARG(ptrdiff_t);
+                break;
+            case ARG_DOUBLE :
+                PACK_ARG(double);
+                break;
+            case ARG_LDOUBLE :
+                PACK_ARG(long double);
+                break;
+            case ARG_PTR :
+                PACK_ARG(void *);
+                break;
+            case ARG_STR : {
+                // copied with the terminating NUL. with a precision, the
+                // string doesn't have to be terminated within it.
+                const char *s = va_arg(ap, const char *);
+                if (s == NULL)
+                    s = "(null)";
+                uint32_t len = ((prec >= 0) ? strnlen(s, prec) : strlen(s))
+                        + 1;
+                if (out != NULL) {
+                    memcpy(out + size, &len, sizeof(len));
+                    memcpy(out + size + sizeof(len), s, len - 1);
+                    out[size + sizeof(len) + len - 1] = '\0';
+                }
+                size += sizeof(len) + len;
+                break;
+            }
+        }
+#undef PACK_ARG
+    }
+
+    return size;
+}
+
+// append formatted data to the output buffer of the writer.
+static bool _out_append(qlog_async_t *async, const char *spec, int type,
+                        const char *arg, size_t argsize) {
+    while (true) {
+        size_t avail = async->outsize - async->outlen;
+        char *dst = async->out + async->outlen;
+        int n = 0;
+        switch (type) {
+            case -1 :  // raw bytes
+                n = argsize;
+                if (argsize > 0 && argsize <= avail)
+                    memcpy(dst, arg, argsize);
+                break;
+
+#define FORMAT_ARG(t) do {                                              \
+                t _v;                                                   \
+                memcpy(&_v, arg, sizeof(t));                            \
+                n = snprintf(dst, avail, spec, _v);                     \
+            } while (0)
+
+            case ARG_NONE :
+                n = snprintf(dst, avail, "%%");
+                break;
+            case ARG_INT :
+                FORMAT_ARG(int);
+                break;
+            case ARG_LONG :
+                FORMAT_ARG(long);
+                break;
+            case ARG_LLONG :
+                FORMAT_ARG(long long);
+                break;
+            case ARG_SIZE :
+                FORMAT_ARG(size_t);
+                break;
+            case ARG_INTMAX :
+                FORMAT_ARG(intmax_t);
+                break;
+            case ARG_PTRDIFF :
+                FORMAT_ARG(ptrdiff_t);
+                break;
+            case ARG_DOUBLE :
+                FORMAT_ARG(double);
+                break;
+            case ARG_LDOUBLE :
+                FORMAT_ARG(long double);
+                break;
+            case ARG_PTR :
+                FORMAT_ARG(void *);
+                break;
+            case ARG_STR :
+                n = snprintf(dst, avail, spec, arg);
+                break;
+#undef FORMAT_ARG
+        }
+        if (n < 0)
+            return false;
+        // snprintf() needs a room for the NUL terminator
+        if ((size_t) n < avail || (type == -1 && (size_t) n <= avail)) {
+            async->outlen += n;
+            return true;
+        }
+
+        size_t newsize = (async->outsize > 0) ? async->outsize * 2 : 4096;
+        while (newsize < async->outlen + n + 1)
+            newsize *= 2;
+        char *newout = (char *) realloc(async->out, newsize);
+        if (newout == NULL)
+            return false;
+        async->out = newout;
+        async->outsize = newsize;
+    }
+}
+
+// format the records in buf into the output buffer of the writer.
+static void _deferred_format(qlog_t *log, const char *buf, size_t buflen) {
+    qlog_async_t *async = (qlog_async_t *) log->async;
+    async->outlen = 0;
+
+    size_t offset;
+    qlog_record_t rec;
+    for (offset = 0; offset + sizeof(rec) <= buflen;
+         offset += sizeof(rec) + rec.size) {
+        memcpy(&rec, buf + offset, sizeof(rec));
+        const char *arg = buf + offset + sizeof(rec);
+
+        const char *prefix = _get_prefix(log, rec.time);
+        _out_append(async, NULL, -1, prefix, strlen(prefix));
+        if (rec.format == NULL) {
+            _out_append(async, NULL, -1, arg, rec.size);
+            _out_append(async, NULL, -1, "\n", 1);
+            continue;
+        }
+
+        const char *p, *lit;
+        for (lit = p = rec.format; (p = strchr(p, '%')) != NULL; lit = p) {
+            _out_append(async, NULL, -1, lit, p - lit);
+
+            // the specification is copied to be NUL terminated
+            int type;
+            int speclen = _deferred_spec(p, &type, NULL);
+            char spec[QLOG_SPEC_MAX];
+            memcpy(spec, p, speclen);
+            spec[speclen] = '\0';
+            p += speclen;
+
+            size_t argsize = 0;
+            switch (type) {
+                case ARG_NONE : argsize = 0; break;
+                case ARG_INT : argsize = sizeof(int); break;
+                case ARG_LONG : argsize = sizeof(long); break;
+                case ARG_LLONG : argsize = sizeof(long long); break;
+                case ARG_SIZE : argsize = sizeof(size_t); break;
+                case ARG_INTMAX : argsize = sizeof(intmax_t); break;
+                case ARG_PTRDIFF : argsize = sizeof(ptrdiff_t); break;
+                case ARG_DOUBLE : argsize = sizeof(double); break;
+                case ARG_LDOUBLE : argsize = sizeof(long double); break;
+                case ARG_PTR : argsize = sizeof(void *); break;
+            }
+            if (type == ARG_STR) {
+                uint32_t len;
+                memcpy(&len, arg, sizeof(len));
+                _out_append(async, spec, type, arg + sizeof(len), len);
+                arg += sizeof(len) + len;
+            } else {
+                _out_append(async, spec, type, arg, argsize);
+                arg += argsize;
+            }
+        }
+        _out_append(async, NULL, -1, lit, strlen(lit));
+        _out_append(async, NULL, -1, "\n", 1);
+    }
+}
+
+static bool _gz_start(qlog_t *log, int level) {
+    qlog_gz_t *gz = (qlog_gz_t *) calloc(1, sizeof(qlog_gz_t));
+    if (gz == NULL) {
+        errno = ENOMEM;
+        return false;
+    }
+    gz->level = level;
+    gz->mode = log->mode;
+    pthread_mutex_init(&gz->lock, NULL);
+    pthread_cond_init(&gz->wakeup, NULL);
+
+    if (pthread_create(&gz->thread, NULL, _gz_worker, gz) != 0) {
+        pthread_cond_destroy(&gz->wakeup);
+        pthread_mutex_destroy(&gz->lock);
+        free(gz);
+        return false;
+    }
+
+    log->gz = gz;
+    return true;
+}
+
+// let the compressor finish the queued files and stop.
+static void _gz_stop(qlog_gz_t *gz) {
+    if (gz == NULL)
+        return;
+
+    pthread_mutex_lock(&gz->lock);
+    gz->stop = true;
+    pthread_cond_signal(&gz->wakeup);
+    pthread_mutex_unlock(&gz->lock);
+    pthread_join(gz->thread, NULL);
+
+    pthread_cond_destroy(&gz->wakeup);
+    pthread_mutex_destroy(&gz->lock);
+    free(gz);
+}
+
+// queue a rotated file to be compressed.
+static void _gz_queue(qlog_t *log, const char *filepath) {
+    qlog_gz_t *gz = (qlog_gz_t *) log->gz;
+    if (gz == NULL)
+        return;
+
+    size_t pathsize = strlen(filepath) + 1;
+    qlog_gzjob_t *job = (qlog_gzjob_t *) malloc(sizeof(qlog_gzjob_t)
+                                                + pathsize);
+    if (job == NULL) {
+        DEBUG("_gz_queue: Can't queue '%s' to compress.", filepath);
+        return;
+    }
+    job->next = NULL;
+    memcpy(job->filepath, filepath, pathsize);
+
+    pthread_mutex_lock(&gz->lock);
+    if (gz->tail != NULL)
+        gz->tail->next = job;
+    else
+        gz->head = job;
+    gz->tail = job;
+    pthread_cond_signal(&gz->wakeup);
+    pthread_mutex_unlock(&gz->lock);
+}
+
+static void *_gz_worker(void *arg) {
+    qlog_gz_t *gz = (qlog_gz_t *) arg;
+
+    pthread_mutex_lock(&gz->lock);
+    while (true) {
+        while (gz->head == NULL && gz->stop == false)
+            pthread_cond_wait(&gz->wakeup, &gz->lock);
+        if (gz->head == NULL)
+            break;  // stopped and drained
+
+        qlog_gzjob_t *job = gz->head;
+        gz->head = job->next;
+        if (gz->head == NULL)
+            gz->tail = NULL;
+        int level = gz->level;
+        pthread_mutex_unlock(&gz->lock);
+
+        _gz_file(job->filepath, level, gz->mode);
+        free(job);
+
+        pthread_mutex_lock(&gz->lock);
+    }
+    pthread_mutex_unlock(&gz->lock);
+
+    return NULL;
+}
+
+// compress filepath into filepath.gz and remove it.
+static bool _gz_file(const char *filepath, int level, mode_t mode) {
+#ifdef ENABLE_ZLIB
+    char gzpath[PATH_MAX];
+    if (snprintf(gzpath, sizeof(gzpath), "%s.gz", filepath)
+            >= (int) sizeof(gzpath)) {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+
+    FILE *fp = fopen(filepath, "r");
+    if (fp == NULL) {
+        DEBUG("_gz_file: Can't open '%s'.", filepath);
+        return false;
+    }
+
+    // appends another gzip member if it exists, gunzip reads them all.
+    int fd = open(gzpath, O_WRONLY | O_CREAT | O_APPEND, 0666);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        DEBUG("_gz_file: Can't open '%s'.", gzpath);
+        if (fd >= 0)
+            close(fd);
+        fclose(fp);
+        return false;
+    }
+    if (mode != 0)
+        fchmod(fd, mode);
+
+    // gzclose() closes the descriptor, keep one to roll back.
+    int rollbackfd = dup(fd);
+    char gzmode[8];
+    snprintf(gzmode, sizeof(gzmode), "ab%d", level);
+    gzFile gzfp = (rollbackfd >= 0) ? gzdopen(fd, gzmode) : NULL;
+    if (gzfp == NULL) {
+        close(fd);
+        if (rollbackfd >= 0)
+            close(rollbackfd);
+        fclose(fp);
+        return false;
+    }
+    gzbuffer(gzfp, QLOG_GZ_BUFSIZE);
+
+    bool ret = true;
+    char buf[QLOG_GZ_BUFSIZE];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        if (gzwrite(gzfp, buf, n) != (int) n) {
+            ret = false;
+            break;
+        }
+    }
+    if (ferror(fp))
+        ret = false;
+    if (gzclose(gzfp) != Z_OK)
+        ret = false;
+    fclose(fp);
+
+    if (ret == true) {
+        ret = (fsync(rollbackfd) == 0);
+    }
+    if (ret == true) {
+        unlink(filepath);
+    } else {
+        DEBUG("_gz_file: Failed to compress '%s'.", filepath);
+        if (ftruncate(rollbackfd, st.st_size) != 0) {
+            DEBUG("_gz_file: Can't roll back '%s'.", gzpath);
+        }
+    }
+    close(rollbackfd);
+
+    return ret;
+#else
+    errno = ENOTSUP;
+    return false;
+#endif
+}
+
 #endif
 
 #endif /* DISABLE_QLOG */
@@ -0,0 +1,511 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+
+/**
+ * @file qratelimit.c Keyed rate limiter.
+ *
+ * qratelimit keeps a token bucket per key, in the same form as
+ * qtokenbucket_atomic_t: the time when the bucket would have been empty.
+ * Keys are remembered by their 64-bit hash in groups of 7 slots which fill
+ * a 128 bytes block with a spinlock. Each key has two candidate groups and
+ * goes to the less loaded one, which keeps the groups evenly loaded,
+ * so active keys are seldom evicted even near the capacity.
+ *
+ * A bucket which has refilled up to max_tokens is the same as a new bucket,
+ * so its slot is reused by other keys without losing anything. Only when a
+ * group is full of active keys, the most refilled one is evicted. Memory is
+ * therefore fixed by qratelimit_calculate_memsize() however many keys come.
+ *
+ * Like qhasharr, the limiter works on the memory given by the user. It can
+ * be shared memory to limit across processes, as the lock and the monotonic
+ * clock work among processes as well.
+ *
+ * @code
+ *   // 100 requests burst and 10 requests per second for each client, and
+ *   // 10000 requests per second in total.
+ *   size_t memsize = qratelimit_calculate_memsize(1000000);
+ *   void *memory = malloc(memsize);
+ *   qratelimit_t *limiter = qratelimit(memory, memsize, 100, 10);
+ *   limiter->set_global(limiter, 10000, 10000);
+ *
+ *   if (limiter->consume(limiter, client_ip, 1) == false) {
+ *     // too many requests
+ *   }
+ *
+ *   limiter->free(limiter);
+ *   free(memory);
+ * @endcode
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <time.h>
+#include "utilities/qhash.h"
+#include "extensions/qtokenbucket.h"
+#include "extensions/qratelimit.h"
+#include "qinternal.h"
+
+#ifndef _DOXYGEN_SKIP
+
+#define GROUP_SLOTS     (7)
+#define HEADER_SIZE     ((sizeof(qratelimit_data_t) + 63) / 64 * 64)
+
+typedef struct qratelimit_slot_s qratelimit_slot_t;
+typedef struct qratelimit_group_s qratelimit_group_t;
+
+struct qratelimit_slot_s {
+    uint64_t keyhash;   /* 0 for unused slot */
+    int64_t empty_at;
+};
+
+struct qratelimit_group_s {
+    uint32_t lock;
+    uint32_t reserved;
+    qratelimit_slot_t slots[GROUP_SLOTS];
+    uint64_t padding;
+};
+
+struct qratelimit_data_s {
+    uint64_t ngroups;
+    int64_t num;
+    int64_t burst_ns;
+    int max_tokens;
+    int tokens_per_sec;
+    bool global_enabled;
+    qtokenbucket_atomic_t global;
+};
+
+static bool consume_hash(qratelimit_t *limiter, uint64_t keyhash, int tokens);
+static long waittime_hash(qratelimit_t *limiter, uint64_t keyhash,
+                          int tokens);
+static uint64_t key_hash(const void *key, size_t keysize);
+static qratelimit_slot_t *find_slot(qratelimit_data_t *data,
+                                    uint64_t keyhash, int64_t idle_at,
+                                    qratelimit_slot_t **victim,
+                                    qratelimit_group_t **groups);
+static void groups_lock(qratelimit_group_t **groups);
+static void groups_unlock(qratelimit_group_t **groups);
+static void group_lock(qratelimit_group_t *group);
+static void group_unlock(qratelimit_group_t *group);
+static int64_t monotonic_nsec(void);
+
+#endif
+
+/**
+ * Get how much memory is needed for N keys.
+ *
+ * @param maxkeys   number of keys to keep track of.
+ *
+ * @return memory size needed
+ *
+ * @note
+ *  There is headroom for uneven hashing, and keys beyond maxkeys do not
+ *  fail but make idle buckets evicted earlier.
+ */
+size_t qratelimit_calculate_memsize(size_t maxkeys) {
+    size_t ngroups = (maxkeys + 4) / 5;
+    if (ngroups < 2) {
+        ngroups = 2;
+    }
+    return HEADER_SIZE + (ngroups * sizeof(qratelimit_group_t));
+}
+
+/**
+ * Initialize keyed rate limiter.
+ *
+ * @param memory    a pointer of data memory.
+ * @param memsize   a size of data memory, 0 for using existing data.
+ * @param max_tokens
+ *      maximum number of tokens in the bucket of each key. Ignored if memsize
+ *      is 0.
+ * @param tokens_per_sec
+ *      number of tokens to fill per a second for each key. Ignored if memsize
+ *      is 0.
+ *
+ * @return qratelimit_t container pointer, otherwise returns NULL.
+ * @retval errno  will be set in error condition.
+ *  - EINVAL : Invalid rate or the memory is too small for two groups of
+ *    keys, which every key is hashed into.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @note
+ *  A key seen for the first time starts with a full bucket.
+ */
+qratelimit_t *qratelimit(void *memory, size_t memsize, int max_tokens,
+                         int tokens_per_sec) {
+    qratelimit_data_t *data = (qratelimit_data_t *) memory;
+
+    // Initialize data if memsize is set or use existing data.
+    if (memsize > 0) {
+        if (max_tokens < 1 || tokens_per_sec < 1
+            || memsize < HEADER_SIZE + (2 * sizeof(qratelimit_group_t))) {
+            errno = EINVAL;
+            return NULL;
+        }
+
+        memset(memory, 0, memsize);
+        data->ngroups = (memsize - HEADER_SIZE) / sizeof(qratelimit_group_t);
+        data->max_tokens = max_tokens;
+        data->tokens_per_sec = tokens_per_sec;
+        data->burst_ns = (int64_t) max_tokens * 1000000000 / tokens_per_sec;
+    }
+
+    qratelimit_t *limiter = (qratelimit_t *) calloc(1, sizeof(qratelimit_t));
+    if (limiter == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    // assign methods
+    limiter->set_global = qratelimit_set_global;
+    limiter->consume = qratelimit_consume;
+    limiter->consume_by_obj = qratelimit_consume_by_obj;
+    limiter->waittime = qratelimit_waittime;
+    limiter->waittime_by_obj = qratelimit_waittime_by_obj;
+    limiter->size = qratelimit_size;
+    limiter->clear = qratelimit_clear;
+    limiter->free = qratelimit_free;
+
+    limiter->data = data;
+
+    return limiter;
+}
+
+/**
+ * qratelimit->set_global(): Set a limit on top of all the keys.
+ *
+ * @param limiter   qratelimit_t container pointer.
+ * @param max_tokens
+ *      maximum number of tokens in the global bucket, 0 for no global limit.
+ * @param tokens_per_sec
+ *      number of tokens to fill per a second in the global bucket.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno  will be set in error condition.
+ *  - EINVAL : Invalid rate.
+ *
+ * @note
+ *  Tokens are granted only when both the key and the global bucket have
+ *  them, and neither bucket is charged otherwise. The global bucket starts
+ *  full. This must be called before the limiter is used by other threads
+ *  or processes.
+ */
+bool qratelimit_set_global(qratelimit_t *limiter, int max_tokens,
+                           int tokens_per_sec) {
+    qratelimit_data_t *data = limiter->data;
+    if (max_tokens == 0) {
+        data->global_enabled = false;
+        return true;
+    }
+    if (max_tokens < 0 || tokens_per_sec < 1) {
+        errno = EINVAL;
+        return false;
+    }
+    qtokenbucket_atomic_init(&data->global, max_tokens, max_tokens,
+                             tokens_per_sec);
+    data->global_enabled = true;
+    return true;
+}
+
+/**
+ * qratelimit->consume(): Consume tokens of a string key.
+ *
+ * @param limiter   qratelimit_t container pointer.
+ * @param key       key string.
+ * @param tokens    number of tokens to request.
+ *
+ * @return true if there are enough tokens, otherwise false.
+ */
+bool qratelimit_consume(qratelimit_t *limiter, const char *key, int tokens) {
+    return consume_hash(limiter, key_hash(key, strlen(key)), tokens);
+}
+
+/**
+ * qratelimit->consume_by_obj(): Consume tokens of a binary key.
+ *
+ * @param limiter   qratelimit_t container pointer.
+ * @param key       key data, such as an IP address in binary.
+ * @param keysize   size of key.
+ * @param tokens    number of tokens to request.
+ *
+ * @return true if there are enough tokens, otherwise false.
+ */
+bool qratelimit_consume_by_obj(qratelimit_t *limiter, const void *key,
+                               size_t keysize, int tokens) {
+    return consume_hash(limiter, key_hash(key, keysize), tokens);
+}
+
+/**
+ * qratelimit->waittime(): Get the estimate time until given number of
+ * tokens is ready for a string key.
+ *
+ * @param limiter   qratelimit_t container pointer.
+ * @param key       key string.
+ * @param tokens    number of tokens.
+ *
+ * @return estimated milliseconds, including the wait for the global bucket.
+ */
+long qratelimit_waittime(qratelimit_t *limiter, const char *key, int tokens) {
+    return waittime_hash(limiter, key_hash(key, strlen(key)), tokens);
+}
+
+/**
+ * qratelimit->waittime_by_obj(): Get the estimate time until given number of
+ * tokens is ready for a binary key.
+ *
+ * @param limiter   qratelimit_t container pointer.
+ * @param key       key data.
+ * @param keysize   size of key.
+ * @param tokens    number of tokens.
+ *
+ * @return estimated milliseconds, including the wait for the global bucket.
+ */
+long qratelimit_waittime_by_obj(qratelimit_t *limiter, const void *key,
+                                size_t keysize, int tokens) {
+    return waittime_hash(limiter, key_hash(key, keysize), tokens);
+}
+
+/**
+ * qratelimit->size(): Get the number of keys being tracked.
+ *
+ * @param limiter   qratelimit_t container pointer.
+ *
+ * @return number of keys, including idle ones not evicted yet.
+ */
+size_t qratelimit_size(qratelimit_t *limiter) {
+    return __atomic_load_n(&limiter->data->num, __ATOMIC_RELAXED);
+}
+
+/**
+ * qratelimit->clear(): Forget all the keys. Every key starts with a full
+ * bucket again.
+ *
+ * @param limiter   qratelimit_t container pointer.
+ */
+void qratelimit_clear(qratelimit_t *limiter) {
+    qratelimit_data_t *data = limiter->data;
+    qratelimit_group_t *groups = (qratelimit_group_t *) ((char *) data
+            + HEADER_SIZE);
+    uint64_t i;
+    for (i = 0; i < data->ngroups; i++) {
+        group_lock(&groups[i]);
+        int n, cleared = 0;
+        for (n = 0; n < GROUP_SLOTS; n++) {
+            if (groups[i].slots[n].keyhash != 0) {
+                cleared++;
+            }
+        }
+        memset(groups[i].slots, 0, sizeof(groups[i].slots));
+        __atomic_sub_fetch(&data->num, cleared, __ATOMIC_RELAXED);
+        group_unlock(&groups[i]);
+    }
+}
+
+/**
+ * qratelimit->free(): De-allocate limiter reference object.
+ *
+ * @param limiter   qratelimit_t container pointer.
+ *
+ * @note
+ *  This does not de-allocate the data memory but only the memory of
+ *  qratelimit struct. User provided data memory must be de-allocated
+ *  by user.
+ */
+void qratelimit_free(qratelimit_t *limiter) {
+    free(limiter);
+}
+
+#ifndef _DOXYGEN_SKIP
+
+static bool consume_hash(qratelimit_t *limiter, uint64_t keyhash, int tokens) {
+    qratelimit_data_t *data = limiter->data;
+    int64_t now = monotonic_nsec();
+    int64_t cost = (int64_t) tokens * 1000000000 / data->tokens_per_sec;
+    int64_t full = now - data->burst_ns;
+
+    qratelimit_group_t *groups[2];
+    qratelimit_slot_t *victim;
+    qratelimit_slot_t *slot = find_slot(data, keyhash, full, &victim,
+                                        groups);
+
+    int64_t base = full;
+    if (slot != NULL && slot->empty_at > full) {
+        base = slot->empty_at;
+    }
+    if (base + cost > now) {
+        groups_unlock(groups);
+        return false;
+    }
+    if (data->global_enabled
+        && qtokenbucket_atomic_consume(&data->global, tokens) == false) {
+        groups_unlock(groups);
+        return false;
+    }
+
+    if (slot == NULL) {
+        slot = victim;
+        if (slot->keyhash == 0) {
+            __atomic_add_fetch(&data->num, 1, __ATOMIC_RELAXED);
+        }
+        slot->keyhash = keyhash;
+    }
+    slot->empty_at = base + cost;
+
+    groups_unlock(groups);
+    return true;
+}
+
+static long waittime_hash(qratelimit_t *limiter, uint64_t keyhash,
+                          int tokens) {
+    qratelimit_data_t *data = limiter->data;
+    int64_t now = monotonic_nsec();
+    int64_t cost = (int64_t) tokens * 1000000000 / data->tokens_per_sec;
+    int64_t base = now - data->burst_ns;
+
+    qratelimit_group_t *groups[2];
+    qratelimit_slot_t *victim;
+    qratelimit_slot_t *slot = find_slot(data, keyhash, base, &victim,
+                                        groups);
+    if (slot != NULL && slot->empty_at > base) {
+        base = slot->empty_at;
+    }
+    groups_unlock(groups);
+
+    int64_t wait = base + cost - now;
+    long waitms = (wait > 0) ? (wait + 999999) / 1000000 : 0;
+    if (data->global_enabled) {
+        long globalms = qtokenbucket_atomic_waittime(&data->global, tokens);
+        if (globalms > waitms) {
+            waitms = globalms;
+        }
+    }
+    return waitms;
+}
+
+static uint64_t key_hash(const void *key, size_t keysize) {
+    uint64_t keyhash = qhashwyhash_64(key, keysize);
+    return (keyhash != 0) ? keyhash : 1;
+}
+
+/*
+ * Lock the two candidate groups of the key and find its slot. If the key
+ * is not there, the victim is a free or idle slot of the less loaded group,
+ * otherwise the most refilled bucket of both.
+ */
+static qratelimit_slot_t *find_slot(qratelimit_data_t *data,
+                                    uint64_t keyhash, int64_t idle_at,
+                                    qratelimit_slot_t **victim,
+                                    qratelimit_group_t **groups) {
+    qratelimit_group_t *base = (qratelimit_group_t *) ((char *) data
+            + HEADER_SIZE);
+    uint64_t idx1 = (uint32_t) keyhash % data->ngroups;
+    uint64_t idx2 = (keyhash >> 32) % data->ngroups;
+    if (idx2 == idx1) {
+        idx2 = (idx1 + 1) % data->ngroups;
+    }
+    groups[0] = &base[(idx1 < idx2) ? idx1 : idx2];
+    groups[1] = &base[(idx1 < idx2) ? idx2 : idx1];
+    groups_lock(groups);
+
+    // the most refilled slot and the number of active keys in each group
+    qratelimit_slot_t *victims[2] = { NULL, NULL };
+    int64_t victims_at[2] = { 0, 0 };
+    int active[2] = { 0, 0 };
+    int i, n;
+    for (i = 0; i < 2; i++) {
+        for (n = 0; n < GROUP_SLOTS; n++) {
+            qratelimit_slot_t *s = &groups[i]->slots[n];
+            if (s->keyhash == keyhash) {
+                return s;
+            }
+            int64_t at = (s->keyhash == 0) ? INT64_MIN : s->empty_at;
+            if (at > idle_at) {
+                active[i]++;
+            }
+            if (victims[i] == NULL || at < victims_at[i]) {
+                victims[i] = s;
+                victims_at[i] = at;
+            }
+        }
+    }
+
+    // prefer the less loaded group, then the most refilled bucket.
+    if (active[0] != active[1] && active[0] < GROUP_SLOTS
+        && active[1] < GROUP_SLOTS) {
+        i = (active[0] < active[1]) ? 0 : 1;
+    } else {
+        i = (victims_at[0] <= victims_at[1]) ? 0 : 1;
+    }
+    *victim = victims[i];
+    return NULL;
+}
+
+/* groups are always locked in the order of address */
+static void groups_lock(qratelimit_group_t **groups) {
+    group_lock(groups[0]);
+    group_lock(groups[1]);
+}
+
+static void groups_unlock(qratelimit_group_t **groups) {
+    group_unlock(groups[1]);
+    group_unlock(groups[0]);
+}
+
+static void group_lock(qratelimit_group_t *group) {
+    int spins = 0;
+    while (__atomic_exchange_n(&group->lock, 1, __ATOMIC_ACQUIRE) != 0) {
+        while (__atomic_load_n(&group->lock, __ATOMIC_RELAXED) != 0) {
+            if (++spins > 100) {
+                sched_yield();
+                spins = 0;
+            }
+        }
+    }
+}
+
+static void group_unlock(qratelimit_group_t *group) {
+    __atomic_store_n(&group->lock, 0, __ATOMIC_RELEASE);
+}
+
+static int64_t monotonic_nsec(void) {
+    struct timespec ts;
+#ifdef CLOCK_MONOTONIC_COARSE
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+    return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+#endif /* _DOXYGEN_SKIP */
@@ -29,7 +29,9 @@
 /**
  * @file qtokenbucket.c Token Bucket implementation.
  *
- * Current implementation is not thread-safe.
+ * qtokenbucket_t is not thread-safe. For a bucket shared by multiple threads,
+ * use qtokenbucket_atomic_t which keeps the whole state in a single 64-bit
+ * word updated with compare-and-swap, so no lock is needed.
  *
  * More information about token-bucket:
  *   http://en.wikipedia.org/wiki/Token_bucket
@@ -47,6 +49,17 @@
  *     do_something();
  *   }
  * @endcode
+ *
+ * @code
+ *   // shared by all the threads
+ *   static qtokenbucket_atomic_t bucket;
+ *   qtokenbucket_atomic_init(&bucket, 500, 1000, 1000);
+ *
+ *   // in any thread
+ *   if (qtokenbucket_atomic_consume(&bucket, 1) == false) {
+ *     // rate limited
+ *   }
+ * @endcode
  */
 
 #include "extensions/qtokenbucket.h"
@@ -54,6 +67,8 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <string.h>
+#include <stdint.h>
+#include <time.h>
 #include <sys/time.h>
 #include "utilities/qtime.h"
 #include "qinternal.h"
@@ -61,6 +76,8 @@
 #ifndef _DOXYGEN_SKIP
 /* internal functions */
 static void refill_tokens(qtokenbucket_t *bucket);
+static int64_t monotonic_nsec(void);
+static int64_t tokens_to_nsec(int64_t tokens, int tokens_per_sec);
 #endif
 
 /**
@@ -117,6 +134,86 @@ long qtokenbucket_waittime(qtokenbucket_t *bucket, int tokens) {
     return estimate_milli;
 }
 
+/**
+ * Initialize the thread-safe token bucket.
+ *
+ * @param init_tokens
+ *      the initial number of tokens.
+ * @param max_tokens
+ *      maximum number of tokens in the bucket.
+ * @param tokens_per_sec
+ *      number of tokens to fill per a second.
+ *
+ * @note
+ *  Instead of a token count and a refill time, the bucket keeps the time
+ *  when it would have been empty. The tokens available now are the elapsed
+ *  time since then multiplied by the rate, capped at max_tokens, so a single
+ *  compare-and-swap consumes tokens and refills the bucket at once.
+ *  Initialization itself is not atomic and must be done before the bucket
+ *  is shared.
+ */
+void qtokenbucket_atomic_init(qtokenbucket_atomic_t *bucket, int init_tokens,
+                              int max_tokens, int tokens_per_sec) {
+    memset(bucket, 0, sizeof(qtokenbucket_atomic_t));
+    bucket->max_tokens = max_tokens;
+    bucket->tokens_per_sec = tokens_per_sec;
+    bucket->burst_ns = tokens_to_nsec(max_tokens, tokens_per_sec);
+    bucket->empty_at = monotonic_nsec()
+            - tokens_to_nsec(init_tokens, tokens_per_sec);
+}
+
+/**
+ * Consume tokens from the thread-safe bucket.
+ *
+ * @param bucket tockenbucket object.
+ * @param tokens number of tokens to request.
+ *
+ * @return return true if there are enough tokens, otherwise false.
+ *
+ * @note
+ *  A request which can not be granted returns without writing to the shared
+ *  state, so rejected callers do not contend with each other.
+ */
+bool qtokenbucket_atomic_consume(qtokenbucket_atomic_t *bucket, int tokens) {
+    int64_t now = monotonic_nsec();
+    int64_t cost = tokens_to_nsec(tokens, bucket->tokens_per_sec);
+    int64_t old = __atomic_load_n(&bucket->empty_at, __ATOMIC_RELAXED);
+    while (true) {
+        // tokens above max_tokens are not accumulated
+        int64_t base = (old > now - bucket->burst_ns) ?
+                old : now - bucket->burst_ns;
+        if (base + cost > now) {
+            return false;
+        }
+        if (__atomic_compare_exchange_n(&bucket->empty_at, &old, base + cost,
+                                        true, __ATOMIC_RELAXED,
+                                        __ATOMIC_RELAXED)) {
+            return true;
+        }
+    }
+}
+
+/**
+ * Get the estimate time until given number of token is ready in the
+ * thread-safe bucket.
+ *
+ * @param tokens number of tokens
+ *
+ * @return estimated milliseconds
+ */
+long qtokenbucket_atomic_waittime(qtokenbucket_atomic_t *bucket, int tokens) {
+    int64_t now = monotonic_nsec();
+    int64_t cost = tokens_to_nsec(tokens, bucket->tokens_per_sec);
+    int64_t old = __atomic_load_n(&bucket->empty_at, __ATOMIC_RELAXED);
+    int64_t base = (old > now - bucket->burst_ns) ?
+            old : now - bucket->burst_ns;
+    int64_t wait = base + cost - now;
+    if (wait <= 0) {
+        return 0;
+    }
+    return (wait + 999999) / 1000000;
+}
+
 #ifndef _DOXYGEN_SKIP
 /**
  * Refill tokens.
@@ -132,4 +229,26 @@ static void refill_tokens(qtokenbucket_t *bucket) {
     }
     bucket->last_fill = now;
 }
+
+/**
+ * Current monotonic time in nanosecond. The coarse clock is read from the
+ * vDSO without a system call, and its resolution of a few milliseconds is
+ * good enough for rate limiting.
+ */
+static int64_t monotonic_nsec(void) {
+    struct timespec ts;
+#ifdef CLOCK_MONOTONIC_COARSE
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+    return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * Time in nanosecond to fill the given number of tokens.
+ */
+static int64_t tokens_to_nsec(int64_t tokens, int tokens_per_sec) {
+    return tokens * 1000000000 / tokens_per_sec;
+}
 #endif // _DOXYGEN_SKIP
@@ -0,0 +1,290 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/*
+ * Epoch based reclamation shared by the containers with lock-free readers.
+ *
+ * A reader marks its read section with the global epoch it saw on entering,
+ * without taking any lock. A writer retires an object it has unlinked with
+ * the current epoch instead of freeing it, and reclaiming advances the
+ * global epoch and frees the retired objects older than the oldest epoch
+ * still observed by any reader, since no reader can see them any more.
+ *
+ * Each reading thread gets a reader record through a thread specific key.
+ * The records are kept in a lock-free list, and a record released by an
+ * exited thread is reused by the next new thread.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "qinternal.h"
+
+/* reader record, one per reading thread */
+typedef struct _q_epoch_reader_s _q_epoch_reader_t;
+struct _q_epoch_reader_s {
+    uint64_t epoch;             /* global epoch seen on entering, 0 when idle */
+    int depth;                  /* nested read section depth */
+    bool inuse;                 /* owned by a live thread */
+    _q_epoch_reader_t *next;    /* next registered record */
+} __attribute__((aligned(64)));
+
+typedef struct _q_epoch_retired_s {
+    void *ptr;
+    _q_epoch_free_cb_t *freefunc;
+    uint64_t epoch;             /* epoch when it was retired */
+} _q_epoch_retired_t;
+
+struct _q_epoch_s {
+    pthread_key_t key;          /* thread specific reader record */
+    uint64_t epoch;             /* global epoch */
+    int pinned;                 /* readers without a record, hold every free */
+    _q_epoch_reader_t *readers; /* registered reader records */
+    void *arg;                  /* first argument of the free functions */
+
+    pthread_mutex_t lock;       /* protects the retired list */
+    _q_epoch_retired_t *retired;    /* objects waiting to be freed */
+    size_t nretired;            /* number of retired objects */
+    size_t maxretired;          /* allocated size of retired list */
+};
+
+static void release_reader(void *reader);
+static uint64_t oldest_epoch(_q_epoch_t *ep);
+static size_t reclaim(_q_epoch_t *ep);
+
+/*
+ * Create epoch state. arg is passed to the free functions of the retired
+ * objects, like the container they belong to.
+ */
+_q_epoch_t *_q_epoch_new(void *arg) {
+    _q_epoch_t *ep = (_q_epoch_t *) calloc(1, sizeof(_q_epoch_t));
+    if (ep == NULL) {
+        return NULL;
+    }
+    if (pthread_key_create(&ep->key, release_reader) != 0) {
+        DEBUG("_q_epoch_new(): can't create pthread key.");
+        free(ep);
+        return NULL;
+    }
+    pthread_mutex_init(&ep->lock, NULL);
+    ep->epoch = 1;
+    ep->arg = arg;
+
+    return ep;
+}
+
+/*
+ * Destroy epoch state and free every retired object. No reader should be in
+ * a read section by now.
+ */
+void _q_epoch_free(_q_epoch_t *ep) {
+    if (ep == NULL) {
+        return;
+    }
+
+    size_t i;
+    for (i = 0; i < ep->nretired; i++) {
+        ep->retired[i].freefunc(ep->arg, ep->retired[i].ptr);
+    }
+    free(ep->retired);
+
+    _q_epoch_reader_t *reader = ep->readers;
+    while (reader != NULL) {
+        _q_epoch_reader_t *next = reader->next;
+        free(reader);
+        reader = next;
+    }
+
+    pthread_mutex_destroy(&ep->lock);
+    pthread_key_delete(ep->key);
+    free(ep);
+}
+
+/*
+ * Enter read section. Read sections can be nested. If the record of a new
+ * thread can't be allocated, the epoch is pinned instead so nothing is
+ * freed until it leaves.
+ */
+void _q_epoch_enter(_q_epoch_t *ep) {
+    _q_epoch_reader_t *reader = pthread_getspecific(ep->key);
+    if (reader == NULL) {
+        // register this thread, reusing a record released by an exited thread
+        for (reader = __atomic_load_n(&ep->readers, __ATOMIC_ACQUIRE);
+             reader != NULL; reader = reader->next) {
+            bool inuse = false;
+            if (__atomic_compare_exchange_n(&reader->inuse, &inuse, true, false,
+                                            __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                break;
+            }
+        }
+        if (reader == NULL) {
+            if (posix_memalign((void **) &reader, sizeof(_q_epoch_reader_t),
+                               sizeof(_q_epoch_reader_t)) != 0) {
+                DEBUG("_q_epoch_enter(): can't allocate memory. pin the epoch.");
+                __atomic_add_fetch(&ep->pinned, 1, __ATOMIC_SEQ_CST);
+                return;
+            }
+            memset((void *) reader, 0, sizeof(_q_epoch_reader_t));
+            reader->inuse = true;
+            reader->next = __atomic_load_n(&ep->readers, __ATOMIC_RELAXED);
+            while (!__atomic_compare_exchange_n(&ep->readers, &reader->next,
+                                                reader, true, __ATOMIC_RELEASE,
+                                                __ATOMIC_RELAXED));
+        }
+        pthread_setspecific(ep->key, reader);
+    }
+
+    if (reader->depth++ == 0) {
+        __atomic_store_n(&reader->epoch,
+                         __atomic_load_n(&ep->epoch, __ATOMIC_ACQUIRE),
+                         __ATOMIC_RELAXED);
+        // make the epoch visible to writers before reading any object
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    }
+}
+
+/*
+ * Leave read section.
+ */
+void _q_epoch_leave(_q_epoch_t *ep) {
+    _q_epoch_reader_t *reader = pthread_getspecific(ep->key);
+    if (reader == NULL) {
+        __atomic_sub_fetch(&ep->pinned, 1, __ATOMIC_SEQ_CST);
+        return;
+    }
+
+    if (--reader->depth == 0) {
+        __atomic_store_n(&reader->epoch, 0, __ATOMIC_RELEASE);
+    }
+}
+
+/*
+ * Defer freeing an unlinked object with freefunc until no reader can see it.
+ * Returns the number of retired objects, call _q_epoch_reclaim() to free
+ * them. Call it out of the read section, it may wait for the readers.
+ */
+size_t _q_epoch_retire(_q_epoch_t *ep, void *ptr,
+                       _q_epoch_free_cb_t *freefunc) {
+    pthread_mutex_lock(&ep->lock);
+    if (ep->nretired == ep->maxretired) {
+        size_t max = (ep->maxretired > 0) ? ep->maxretired * 2 : 64;
+        _q_epoch_retired_t *retired = (_q_epoch_retired_t *) realloc(
+                ep->retired, sizeof(_q_epoch_retired_t) * max);
+        if (retired == NULL) {
+            // can't defer it. wait until no reader can see it then free.
+            DEBUG("_q_epoch_retire(): can't allocate memory. wait for readers.");
+            uint64_t epoch = __atomic_add_fetch(&ep->epoch, 1,
+                                                __ATOMIC_SEQ_CST) - 1;
+            while (oldest_epoch(ep) <= epoch) {
+                usleep(1);
+            }
+            freefunc(ep->arg, ptr);
+            size_t num = ep->nretired;
+            pthread_mutex_unlock(&ep->lock);
+            return num;
+        } else {
+            ep->retired = retired;
+            ep->maxretired = max;
+        }
+    }
+
+    ep->retired[ep->nretired].ptr = ptr;
+    ep->retired[ep->nretired].freefunc = freefunc;
+    ep->retired[ep->nretired].epoch = __atomic_load_n(&ep->epoch,
+                                                      __ATOMIC_SEQ_CST);
+    size_t num = ++ep->nretired;
+    pthread_mutex_unlock(&ep->lock);
+
+    return num;
+}
+
+/*
+ * Advance the global epoch and free the retired objects that were retired
+ * before the oldest epoch still observed by any reader. Returns the number
+ * of retired objects still waiting.
+ */
+size_t _q_epoch_reclaim(_q_epoch_t *ep) {
+    pthread_mutex_lock(&ep->lock);
+    size_t num = reclaim(ep);
+    pthread_mutex_unlock(&ep->lock);
+
+    return num;
+}
+
+/*
+ * Release the reader record of an exiting thread so it can be reused.
+ */
+static void release_reader(void *reader) {
+    _q_epoch_reader_t *r = (_q_epoch_reader_t *) reader;
+    r->depth = 0;
+    __atomic_store_n(&r->epoch, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&r->inuse, false, __ATOMIC_RELEASE);
+}
+
+// the oldest epoch observed by the readers, UINT64_MAX if there's none.
+static uint64_t oldest_epoch(_q_epoch_t *ep) {
+    uint64_t oldest = UINT64_MAX;
+    if (__atomic_load_n(&ep->pinned, __ATOMIC_SEQ_CST) > 0) {
+        oldest = 0;
+    }
+    _q_epoch_reader_t *reader;
+    for (reader = __atomic_load_n(&ep->readers, __ATOMIC_ACQUIRE);
+         reader != NULL; reader = reader->next) {
+        uint64_t epoch = __atomic_load_n(&reader->epoch, __ATOMIC_SEQ_CST);
+        if (epoch != 0 && epoch < oldest) {
+            oldest = epoch;
+        }
+    }
+    return oldest;
+}
+
+// called with the lock held.
+static size_t reclaim(_q_epoch_t *ep) {
+    if (ep->nretired == 0) {
+        return 0;
+    }
+
+    __atomic_add_fetch(&ep->epoch, 1, __ATOMIC_SEQ_CST);
+    uint64_t oldest = oldest_epoch(ep);
+
+    size_t i, n;
+    for (i = n = 0; i < ep->nretired; i++) {
+        if (ep->retired[i].epoch < oldest) {
+            ep->retired[i].freefunc(ep->arg, ep->retired[i].ptr);
+        } else {
+            ep->retired[n++] = ep->retired[i];
+        }
+    }
+    ep->nretired = n;
+
+    return n;
+}
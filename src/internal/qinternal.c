@@ -33,8 +33,12 @@
 #include <string.h>
 #include <ctype.h>
 #include <unistd.h>
+#include <stdint.h>
 #include <errno.h>
+#include <time.h>
+#include <fcntl.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include "qinternal.h"
 
 // Change two hex character to one hex value.
@@ -80,3 +84,98 @@ void _q_textout(FILE *fp, void *data, size_t size, size_t max) {
     if (size > max)
         fputs("...", fp);
 }
+
+// natural logarithm of a positive number, for estimations without libm.
+double _q_log(double x) {
+    int exp = 0;
+    while (x > 2.0) {
+        x /= 2.0;
+        exp++;
+    }
+    while (x < 1.0) {
+        x *= 2.0;
+        exp--;
+    }
+
+    // ln(x) = 2 * atanh((x - 1) / (x + 1)), converges fast for 1 <= x <= 2.
+    double y = (x - 1.0) / (x + 1.0), y2 = y * y, term = y, sum = 0.0;
+    int n;
+    for (n = 1; n < 40; n += 2) {
+        sum += term / n;
+        term *= y2;
+    }
+
+    return 2.0 * sum + exp * 0.69314718055994530942;
+}
+
+// Monotonic clock in nanoseconds, for measuring wait times.
+uint64_t _q_nanotime(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Create a temporary file next to filepath to be renamed over it later with
+// _q_tmpfile_finish(). Returns the descriptor and the malloced path in
+// tmppath, or -1 with errno set.
+int _q_tmpfile_create(const char *filepath, char **tmppath) {
+    size_t pathlen = strlen(filepath);
+    char *path = (char *) malloc(pathlen + sizeof(".XXXXXX"));
+    if (path == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+    memcpy(path, filepath, pathlen);
+    memcpy(path + pathlen, ".XXXXXX", sizeof(".XXXXXX"));
+
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        free(path);
+        return -1;
+    }
+    fchmod(fd, (S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH));
+
+    *tmppath = path;
+    return fd;
+}
+
+// Close a file made by _q_tmpfile_create() and rename it over filepath if
+// commit is true, otherwise remove it. With sync, the data is flushed to the
+// disk before the rename and the directory after it, so the new contents
+// survive a crash. tmppath is freed. Returns false with errno set on error,
+// filepath is left as it was then.
+bool _q_tmpfile_finish(int fd, char *tmppath, const char *filepath,
+                       bool commit, bool sync) {
+    bool ret = commit;
+    int errnobak = errno;
+    if (ret == true && sync == true && fdatasync(fd) != 0) {
+        errnobak = errno;
+        ret = false;
+    }
+    close(fd);
+    if (ret == true && rename(tmppath, filepath) != 0) {
+        errnobak = errno;
+        ret = false;
+    }
+    if (ret == false) {
+        unlink(tmppath);
+    }
+    free(tmppath);
+
+    // make the rename itself durable.
+    if (ret == true && sync == true) {
+        const char *slash = strrchr(filepath, '/');
+        char *dir = (slash != NULL) ? strndup(filepath, (slash > filepath)
+                                              ? slash - filepath : 1)
+                                    : strdup(".");
+        int dirfd = (dir != NULL) ? open(dir, O_RDONLY, 0) : -1;
+        if (dirfd >= 0) {
+            fsync(dirfd);
+            close(dirfd);
+        }
+        free(dir);
+    }
+
+    errno = errnobak;
+    return ret;
+}
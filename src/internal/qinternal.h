@@ -54,6 +54,16 @@
         }                                                               \
     } while(0)
 
+/*
+ * Q_ARENA Macros - memory is taken from the arena when one is given and
+ * released together with the arena, otherwise from the heap.
+ */
+#define Q_ARENA_MALLOC(a, s)                                            \
+    (((a) != NULL) ? qarena_alloc((a), (s)) : malloc(s))
+#define Q_ARENA_FREE(a, p) do {                                         \
+        if ((a) == NULL) free(p);                                       \
+    } while (0)
+
 /*
  * Q_MUTEX Macros
  */
@@ -61,6 +71,8 @@
 #define _MULTI_THREADED
 #endif
 
+#include <stdint.h>
+#include <stdbool.h>
 #include <unistd.h>
 #include <pthread.h>
 
@@ -70,6 +82,9 @@ struct qmutex_s {
     pthread_mutex_t mutex;  /*!< pthread mutex */
     pthread_t owner;        /*!< mutex owner thread id */
     int count;              /*!< recursive lock counter */
+    uint64_t locks;         /*!< number of acquisitions */
+    uint64_t contended;     /*!< acquisitions which had to wait */
+    uint64_t waitns;        /*!< total wait time in nanoseconds */
 };
 
 #define Q_MUTEX_NEW(m,r) do {                                           \
@@ -102,12 +117,14 @@ struct qmutex_s {
 #define MAX_MUTEX_LOCK_WAIT (5000)
 #define Q_MUTEX_ENTER(m) do {                                           \
         if (m == NULL) break;                                           \
+        uint64_t _waitstart = 0;                                        \
         while (true) {                                                  \
             int _ret, i;                                                \
             for (i = 0; (_ret = pthread_mutex_trylock(&(((qmutex_t *)m)->mutex))) != 0 \
                         && i < MAX_MUTEX_LOCK_WAIT; i++) {              \
                 if (i == 0) {                                           \
                     DEBUG("Q_MUTEX: mutex is already locked - retrying"); \
+                    if (_waitstart == 0) _waitstart = _q_nanotime();    \
                 }                                                       \
                 usleep(1);                                              \
             }                                                           \
@@ -118,6 +135,19 @@ struct qmutex_s {
         }                                                               \
         ((qmutex_t *)m)->count++;                                       \
         ((qmutex_t *)m)->owner = pthread_self();                        \
+        ((qmutex_t *)m)->locks++;                                       \
+        if (_waitstart != 0) {                                          \
+            ((qmutex_t *)m)->contended++;                               \
+            ((qmutex_t *)m)->waitns += _q_nanotime() - _waitstart;      \
+        }                                                               \
+    } while(0)
+
+/* copies the lock counters into a qstats_t, call it with the lock held */
+#define Q_MUTEX_STATS(m, s) do {                                        \
+        if (m == NULL) break;                                           \
+        (s)->locks = ((qmutex_t *)m)->locks;                            \
+        (s)->contended = ((qmutex_t *)m)->contended;                    \
+        (s)->lockwait = ((qmutex_t *)m)->waitns;                        \
     } while(0)
 
 #define Q_MUTEX_DESTROY(m) do {                                         \
@@ -130,6 +160,39 @@ struct qmutex_s {
         }                                                               \
         free(m);                                                        \
     } while(0)
+/*
+ * Q_RWLOCK Macros
+ */
+#define Q_RWLOCK_NEW(m) do {                                            \
+        pthread_rwlock_t *x = (pthread_rwlock_t *)malloc(sizeof(pthread_rwlock_t)); \
+        if (x != NULL && pthread_rwlock_init(x, NULL) != 0) {           \
+            DEBUG("Q_RWLOCK: can't initialize rwlock.");                \
+            free(x);                                                    \
+            x = NULL;                                                   \
+        }                                                               \
+        m = x;                                                          \
+    } while(0)
+
+#define Q_RWLOCK_RDLOCK(m) do {                                         \
+        if (m == NULL) break;                                           \
+        pthread_rwlock_rdlock((pthread_rwlock_t *)m);                   \
+    } while(0)
+
+#define Q_RWLOCK_WRLOCK(m) do {                                         \
+        if (m == NULL) break;                                           \
+        pthread_rwlock_wrlock((pthread_rwlock_t *)m);                   \
+    } while(0)
+
+#define Q_RWLOCK_UNLOCK(m) do {                                         \
+        if (m == NULL) break;                                           \
+        pthread_rwlock_unlock((pthread_rwlock_t *)m);                   \
+    } while(0)
+
+#define Q_RWLOCK_DESTROY(m) do {                                        \
+        if (m == NULL) break;                                           \
+        pthread_rwlock_destroy((pthread_rwlock_t *)m);                  \
+        free(m);                                                        \
+    } while(0)
 
 /*
  * Debug Macros
@@ -157,5 +220,127 @@ struct qmutex_s {
 extern char _q_x2c(char hex_up, char hex_low);
 extern char *_q_makeword(char *str, char stop);
 extern void _q_textout(FILE *fp, void *data, size_t size, size_t max);
+extern double _q_log(double x);
+extern uint64_t _q_nanotime(void);
+extern int _q_tmpfile_create(const char *filepath, char **tmppath);
+extern bool _q_tmpfile_finish(int fd, char *tmppath, const char *filepath,
+                              bool commit, bool sync);
+
+/*
+ * qstats.c
+ */
+struct qstats_s;
+extern void _q_stats_probe(struct qstats_s *stats, size_t probe);
+
+/*
+ * qtrace.c
+ */
+#include <stdbool.h>
+
+typedef struct {
+    int type;
+    int fd;
+    const char *detail;
+    uint64_t start;     /* 0 if no callback was set at the beginning */
+} _q_trace_t;
+
+struct qtrace_event_s;
+extern void (*_q_tracecb)(const struct qtrace_event_s *event, void *userdata);
+extern void _q_trace_emit(const _q_trace_t *trace, int64_t result, bool ok);
+
+/*
+ * Q_TRACE_BEGIN() declares the trace of an operation and Q_TRACE_END()
+ * reports it. Without a callback set, it costs a load and a branch. With
+ * ENABLE_USDT, qlibc:begin and qlibc:end static probes are placed as well,
+ * which are nops until perf or bpftrace attaches to them.
+ *
+ *   bpftrace -e 'usdt:./libqlibc.so:qlibc:begin { @s[tid] = nsecs; }
+ *                usdt:./libqlibc.so:qlibc:end /@s[tid]/ {
+ *                  @ns[arg0] = hist(nsecs - @s[tid]); delete(@s[tid]); }'
+ */
+#ifdef ENABLE_USDT
+#include <errno.h>
+#include <sys/sdt.h>
+#define Q_USDT_BEGIN(t)                                                 \
+    DTRACE_PROBE3(qlibc, begin, (t).type, (t).fd, (t).detail)
+#define Q_USDT_END(t, result, ok)                                       \
+    DTRACE_PROBE4(qlibc, end, (t).type, (t).fd, (int64_t)(result),      \
+                  (ok) ? 0 : errno)
+#else
+#define Q_USDT_BEGIN(t)
+#define Q_USDT_END(t, result, ok)
+#endif
+
+#define Q_TRACE_BEGIN(t, ttype, tfd, tdetail)                           \
+    _q_trace_t t = { (ttype), (tfd), (tdetail), 0 };                    \
+    if (__builtin_expect(__atomic_load_n(&_q_tracecb, __ATOMIC_RELAXED) \
+                         != NULL, 0)) {                                 \
+        t.start = _q_nanotime();                                        \
+    }                                                                   \
+    Q_USDT_BEGIN(t)
+
+#define Q_TRACE_END(t, result, ok) do {                                 \
+        Q_USDT_END(t, result, ok);                                      \
+        if (__builtin_expect((t).start != 0, 0)) {                      \
+            _q_trace_emit(&(t), (int64_t)(result), (ok));               \
+        }                                                               \
+    } while (0)
+
+/*
+ * qsnapshot.c
+ */
+#include <stdint.h>
+#include <stdbool.h>
+
+#define Q_SNAPSHOT_HASHTBL  (1)
+#define Q_SNAPSHOT_TREETBL  (2)
+#define Q_SNAPSHOT_LISTTBL  (3)
+
+typedef struct _q_snapshot_s _q_snapshot_t;
+
+struct _q_snapshot_s {
+    int type;           /* container type of the records */
+    int flags;          /* format flags */
+    uint64_t num;       /* number of records */
+    uint32_t checksum;  /* running checksum of the records */
+
+    /* writer */
+    int fd;
+    char *filepath;
+    char *tmppath;
+    char *buf;
+    size_t buflen;
+
+    /* reader */
+    uint8_t *map;
+    size_t mapsize;
+    size_t offset;
+};
+
+extern _q_snapshot_t *_q_snapshot_create(const char *filepath, int type,
+                                         bool checksum);
+extern bool _q_snapshot_write(_q_snapshot_t *snap, uint32_t hash,
+                              const void *name, size_t namesize,
+                              const void *data, size_t datasize);
+extern bool _q_snapshot_finish(_q_snapshot_t *snap, bool commit);
+extern _q_snapshot_t *_q_snapshot_open(const char *filepath, int type);
+extern bool _q_snapshot_read(_q_snapshot_t *snap, uint32_t *hash,
+                             const void **name, size_t *namesize,
+                             const void **data, size_t *datasize);
+extern void _q_snapshot_close(_q_snapshot_t *snap);
+
+/*
+ * qepoch.c
+ */
+typedef struct _q_epoch_s _q_epoch_t;
+typedef void (_q_epoch_free_cb_t)(void *arg, void *ptr);
+
+extern _q_epoch_t *_q_epoch_new(void *arg);
+extern void _q_epoch_free(_q_epoch_t *ep);
+extern void _q_epoch_enter(_q_epoch_t *ep);
+extern void _q_epoch_leave(_q_epoch_t *ep);
+extern size_t _q_epoch_retire(_q_epoch_t *ep, void *ptr,
+                              _q_epoch_free_cb_t *freefunc);
+extern size_t _q_epoch_reclaim(_q_epoch_t *ep);
 
 #endif /* QINTERNAL_H */
@@ -0,0 +1,350 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/*
+ * Binary snapshot format shared by the dump() and restore() calls of the
+ * table containers.
+ *
+ *  [Header, 24 bytes]
+ *   "QSNP" | version(1) | type(1) | flags(1) | reserved(1)
+ *   | number of records(8) | CRC32C of the records(4) | reserved(4)
+ *
+ *  [Record]
+ *   hash(4) | namesize(4) | datasize(8) | name | data
+ *
+ * All the integers are stored in little endian. The records are written into
+ * a temporary file which replaces the snapshot file once it's complete, and
+ * the whole file is validated when it's opened, so a reader never sees a
+ * partial or broken snapshot.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "qinternal.h"
+#include "utilities/qhash.h"
+#include "utilities/qio.h"
+
+#define SNAPSHOT_MAGIC      "QSNP"
+#define SNAPSHOT_VERSION    (1)
+#define SNAPSHOT_CHECKSUM   (0x01)  /* flag, records are checksummed */
+#define SNAPSHOT_HDRSIZE    (24)
+#define SNAPSHOT_RECHDRSIZE (16)
+#define SNAPSHOT_BUFSIZE    (64 * 1024)
+
+static void put_le32(uint8_t *p, uint32_t v);
+static void put_le64(uint8_t *p, uint64_t v);
+static uint32_t get_le32(const uint8_t *p);
+static uint64_t get_le64(const uint8_t *p);
+static bool snapshot_out(_q_snapshot_t *snap, const void *data, size_t size);
+
+/*
+ * Create a snapshot file to write records in.
+ */
+_q_snapshot_t *_q_snapshot_create(const char *filepath, int type,
+                                  bool checksum) {
+    if (filepath == NULL) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    _q_snapshot_t *snap = (_q_snapshot_t *) calloc(1, sizeof(_q_snapshot_t));
+    char *buf = (char *) malloc(SNAPSHOT_BUFSIZE);
+    if (snap == NULL || buf == NULL) {
+        free(snap);
+        free(buf);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    char *tmppath;
+    snap->fd = _q_tmpfile_create(filepath, &tmppath);
+    if (snap->fd < 0) {
+        free(snap);
+        free(buf);
+        return NULL;
+    }
+
+    snap->filepath = strdup(filepath);
+    snap->tmppath = tmppath;
+    snap->buf = buf;
+    snap->type = type;
+    snap->flags = (checksum == true) ? SNAPSHOT_CHECKSUM : 0;
+
+    // the header is filled in when it's finished.
+    memset(buf, 0, SNAPSHOT_HDRSIZE);
+    snap->buflen = SNAPSHOT_HDRSIZE;
+    if (snap->filepath == NULL) {
+        _q_snapshot_finish(snap, false);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    return snap;
+}
+
+/*
+ * Append a record.
+ */
+bool _q_snapshot_write(_q_snapshot_t *snap, uint32_t hash, const void *name,
+                       size_t namesize, const void *data, size_t datasize) {
+    if (namesize > UINT32_MAX) {
+        errno = EINVAL;
+        return false;
+    }
+
+    uint8_t hdr[SNAPSHOT_RECHDRSIZE];
+    put_le32(hdr, hash);
+    put_le32(hdr + 4, (uint32_t) namesize);
+    put_le64(hdr + 8, (uint64_t) datasize);
+
+    if (snap->flags & SNAPSHOT_CHECKSUM) {
+        snap->checksum = qhashcrc32c_update(snap->checksum, hdr, sizeof(hdr));
+        snap->checksum = qhashcrc32c_update(snap->checksum, name, namesize);
+        snap->checksum = qhashcrc32c_update(snap->checksum, data, datasize);
+    }
+    if (snapshot_out(snap, hdr, sizeof(hdr)) == false
+            || snapshot_out(snap, name, namesize) == false
+            || snapshot_out(snap, data, datasize) == false) {
+        return false;
+    }
+    snap->num++;
+
+    return true;
+}
+
+/*
+ * Complete the snapshot file and release the writer. If commit is false or
+ * anything goes wrong, the snapshot file is left as it was.
+ */
+bool _q_snapshot_finish(_q_snapshot_t *snap, bool commit) {
+    bool ret = commit;
+
+    // flush
+    if (ret == true && snap->buflen > 0
+            && qio_write(snap->fd, snap->buf, snap->buflen, -1)
+                    != (ssize_t) snap->buflen) {
+        ret = false;
+    }
+
+    // header
+    if (ret == true) {
+        uint8_t hdr[SNAPSHOT_HDRSIZE];
+        memset(hdr, 0, sizeof(hdr));
+        memcpy(hdr, SNAPSHOT_MAGIC, 4);
+        hdr[4] = SNAPSHOT_VERSION;
+        hdr[5] = (uint8_t) snap->type;
+        hdr[6] = (uint8_t) snap->flags;
+        put_le64(hdr + 8, snap->num);
+        put_le32(hdr + 16, snap->checksum);
+        if (pwrite(snap->fd, hdr, sizeof(hdr), 0) != sizeof(hdr)) {
+            ret = false;
+        }
+    }
+
+    ret = _q_tmpfile_finish(snap->fd, snap->tmppath, snap->filepath, ret,
+                            true);
+    int errnobak = errno;
+    free(snap->filepath);
+    free(snap->buf);
+    free(snap);
+
+    errno = errnobak;
+    return ret;
+}
+
+/*
+ * Open a snapshot file to read records from. The file is mapped into memory
+ * and validated entirely.
+ *
+ * errno : EINVAL for invalid argument, EBADMSG for broken or unknown format,
+ *         or errors of open() and mmap().
+ */
+_q_snapshot_t *_q_snapshot_open(const char *filepath, int type) {
+    if (filepath == NULL) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    int fd = open(filepath, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return NULL;
+    }
+    if (st.st_size < SNAPSHOT_HDRSIZE) {
+        close(fd);
+        errno = EBADMSG;
+        return NULL;
+    }
+
+    size_t mapsize = st.st_size;
+    uint8_t *map = (uint8_t *) mmap(NULL, mapsize, PROT_READ, MAP_PRIVATE,
+                                    fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+    madvise(map, mapsize, MADV_SEQUENTIAL);
+
+    // header
+    uint64_t num = get_le64(map + 8);
+    if (memcmp(map, SNAPSHOT_MAGIC, 4) || map[4] != SNAPSHOT_VERSION
+            || map[5] != type) {
+        munmap(map, mapsize);
+        errno = EBADMSG;
+        return NULL;
+    }
+    if ((map[6] & SNAPSHOT_CHECKSUM)
+            && qhashcrc32c(map + SNAPSHOT_HDRSIZE, mapsize - SNAPSHOT_HDRSIZE)
+                    != get_le32(map + 16)) {
+        munmap(map, mapsize);
+        errno = EBADMSG;
+        return NULL;
+    }
+
+    // records must fill up the file exactly.
+    size_t offset = SNAPSHOT_HDRSIZE;
+    uint64_t i;
+    for (i = 0; i < num; i++) {
+        if (mapsize - offset < SNAPSHOT_RECHDRSIZE) {
+            break;
+        }
+        uint64_t namesize = get_le32(map + offset + 4);
+        uint64_t datasize = get_le64(map + offset + 8);
+        offset += SNAPSHOT_RECHDRSIZE;
+        if (namesize > mapsize - offset
+                || datasize > mapsize - offset - namesize) {
+            break;
+        }
+        offset += namesize + datasize;
+    }
+    if (i != num || offset != mapsize) {
+        munmap(map, mapsize);
+        errno = EBADMSG;
+        return NULL;
+    }
+
+    _q_snapshot_t *snap = (_q_snapshot_t *) calloc(1, sizeof(_q_snapshot_t));
+    if (snap == NULL) {
+        munmap(map, mapsize);
+        errno = ENOMEM;
+        return NULL;
+    }
+    snap->fd = -1;
+    snap->type = type;
+    snap->flags = map[6];
+    snap->num = num;
+    snap->map = map;
+    snap->mapsize = mapsize;
+    snap->offset = SNAPSHOT_HDRSIZE;
+
+    return snap;
+}
+
+/*
+ * Get the next record. The name and data point to the mapped file.
+ */
+bool _q_snapshot_read(_q_snapshot_t *snap, uint32_t *hash, const void **name,
+                      size_t *namesize, const void **data, size_t *datasize) {
+    if (snap->offset >= snap->mapsize) {
+        errno = ENOENT;
+        return false;
+    }
+
+    const uint8_t *p = snap->map + snap->offset;
+    *hash = get_le32(p);
+    *namesize = get_le32(p + 4);
+    *datasize = get_le64(p + 8);
+    *name = p + SNAPSHOT_RECHDRSIZE;
+    *data = p + SNAPSHOT_RECHDRSIZE + *namesize;
+    snap->offset += SNAPSHOT_RECHDRSIZE + *namesize + *datasize;
+
+    return true;
+}
+
+/*
+ * Release the reader.
+ */
+void _q_snapshot_close(_q_snapshot_t *snap) {
+    munmap(snap->map, snap->mapsize);
+    free(snap);
+}
+
+static void put_le32(uint8_t *p, uint32_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static void put_le64(uint8_t *p, uint64_t v) {
+    put_le32(p, (uint32_t) v);
+    put_le32(p + 4, (uint32_t) (v >> 32));
+}
+
+static uint32_t get_le32(const uint8_t *p) {
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16)
+            | ((uint32_t) p[3] << 24);
+}
+
+static uint64_t get_le64(const uint8_t *p) {
+    return (uint64_t) get_le32(p) | ((uint64_t) get_le32(p + 4) << 32);
+}
+
+// append data to the write buffer, flushing it when it's full.
+static bool snapshot_out(_q_snapshot_t *snap, const void *data, size_t size) {
+    if (snap->buflen + size > SNAPSHOT_BUFSIZE) {
+        if (snap->buflen > 0
+                && qio_write(snap->fd, snap->buf, snap->buflen, -1)
+                        != (ssize_t) snap->buflen) {
+            return false;
+        }
+        snap->buflen = 0;
+
+        // too big to buffer
+        if (size > SNAPSHOT_BUFSIZE) {
+            return (qio_write(snap->fd, data, size, -1) == (ssize_t) size);
+        }
+    }
+
+    memcpy(snap->buf + snap->buflen, data, size);
+    snap->buflen += size;
+    return true;
+}
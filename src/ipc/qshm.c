@@ -66,18 +66,57 @@
  *     return -1;
  *   }
  * @endcode
+ *
+ * The SysV segments are limited by kernel.shmmax and live until removed
+ * by id. qshm_open() and qshm_map() make POSIX shared memory objects
+ * instead, named under /dev/shm or anonymous with memfd_create(), which
+ * are sized freely, cleaned up by name and can use huge pages.
+ *
+ * @code
+ *   [creator]
+ *   int fd = qshm_open("/mycache", memsize, QSHM_RECREATE | QSHM_HUGEPAGE);
+ *   size_t size = 0;
+ *   void *mem = qshm_map(fd, &size, QSHM_HUGEPAGE);
+ *   close(fd);  // the mapping stays
+ *   qhasharr_t *tbl = qhasharr(mem, size);
+ *
+ *   [user]
+ *   int fd = qshm_open("/mycache", 0, 0);
+ *   size_t size = 0;
+ *   void *mem = qshm_map(fd, &size, 0);
+ *   close(fd);
+ *   qhasharr_t *tbl = qhasharr(mem, 0);
+ *
+ *   [cleanup]
+ *   qshm_unmap(mem, size);
+ *   qshm_unlink("/mycache");
+ * @endcode
  */
 
 #ifndef DISABLE_IPC
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE  /* memfd_create(), MAP_HUGETLB */
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <sys/shm.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
 #include "qinternal.h"
 #include "ipc/qshm.h"
 
+#define HUGEPAGE_SIZE   (2 * 1024 * 1024)   /*!< size of a huge page */
+#define MPOL_INTERLEAVE_ (3)                /*!< mbind() interleave policy */
+
 /**
  * Initialize shared-memory
  *
@@ -172,4 +211,183 @@ bool qshm_free(int shmid) {
     return true;
 }
 
+/**
+ * Open a POSIX shared memory object.
+ *
+ * @param name      object name like "/name", NULL for an anonymous object
+ *                  made with memfd_create(), which can be shared with the
+ *                  child processes or by passing the descriptor.
+ * @param size      size of the object to create, 0 to open an existing one.
+ * @param options   combination of the options.
+ *
+ * @return non-negative file descriptor if successful, otherwise returns -1.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - ENOSYS : memfd_create() is not supported.
+ *  - errors of shm_open(), memfd_create() and ftruncate().
+ *
+ * @note
+ *   Available options:
+ *   - QSHM_RECREATE - remove the existing object of the name first.
+ *     Without it, an existing object is opened as it is.
+ *   - QSHM_HUGEPAGE - an anonymous object is made of huge pages when the
+ *     system has them reserved, and its size is rounded up to the huge page
+ *     size. Otherwise it falls back to the regular pages, and qshm_map()
+ *     asks for transparent huge pages instead.
+ *
+ *  The descriptor can be closed once it is mapped with qshm_map().
+ */
+int qshm_open(const char *name, size_t size, int options) {
+    int fd;
+    if (name == NULL) {
+        if (size == 0) {
+            errno = EINVAL;
+            return -1;
+        }
+#if defined(MFD_CLOEXEC)
+        fd = -1;
+#if defined(MFD_HUGETLB)
+        if (options & QSHM_HUGEPAGE) {
+            size_t hsize = (size + HUGEPAGE_SIZE - 1) & ~((size_t) HUGEPAGE_SIZE - 1);
+            fd = memfd_create("qshm", MFD_CLOEXEC | MFD_HUGETLB);
+            if (fd >= 0 && ftruncate(fd, hsize) == 0) {
+                // the huge pages are reserved when mapped, try it now.
+                void *mem = mmap(NULL, hsize, PROT_READ | PROT_WRITE,
+                                 MAP_SHARED, fd, 0);
+                if (mem != MAP_FAILED) {
+                    munmap(mem, hsize);
+                    return fd;
+                }
+            }
+            if (fd >= 0)
+                close(fd);
+        }
+#endif
+        fd = memfd_create("qshm", MFD_CLOEXEC);
+#else
+        errno = ENOSYS;
+        return -1;
+#endif
+    } else if (size == 0) {
+        return shm_open(name, O_RDWR, 0);
+    } else {
+        if (options & QSHM_RECREATE)
+            shm_unlink(name);
+        fd = shm_open(name, O_RDWR | O_CREAT, 0666);
+    }
+    if (fd < 0)
+        return -1;
+
+    // size a new object, keep an existing one as it is.
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int errnobak = errno;
+        close(fd);
+        errno = errnobak;
+        return -1;
+    }
+    if (st.st_size == 0 && ftruncate(fd, size) != 0) {
+        int errnobak = errno;
+        close(fd);
+        if (name != NULL)
+            shm_unlink(name);
+        errno = errnobak;
+        return -1;
+    }
+
+    return fd;
+}
+
+/**
+ * Map a shared memory object opened by qshm_open().
+ *
+ * @param fd        file descriptor returned by qshm_open().
+ * @param size      the size of the object is stored here. It can be set to
+ *                  map only the leading part.
+ * @param options   combination of the options.
+ *
+ * @return a pointer of the shared memory if successful, otherwise NULL.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - errors of fstat() and mmap().
+ *
+ * @note
+ *   Available options:
+ *   - QSHM_HUGEPAGE - ask for transparent huge pages, where the system
+ *     enables them for shared memory. Objects made of huge pages by
+ *     qshm_open() need nothing.
+ *   - QSHM_INTERLEAVE - spread the pages over the NUMA nodes, so a large
+ *     cache used by the processes on all the nodes doesn't load a single
+ *     memory controller. It applies to the pages touched afterwards.
+ *
+ *  The hints are best effort, their failures are not errors.
+ */
+void *qshm_map(int fd, size_t *size, int options) {
+    struct stat st;
+    if (fd < 0 || size == NULL) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (fstat(fd, &st) != 0)
+        return NULL;
+
+    size_t mapsize = st.st_size;
+    if (*size > 0 && *size < mapsize)
+        mapsize = *size;
+    if (mapsize == 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    void *mem = mmap(NULL, mapsize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mem == MAP_FAILED)
+        return NULL;
+
+#ifdef MADV_HUGEPAGE
+    if (options & QSHM_HUGEPAGE)
+        madvise(mem, mapsize, MADV_HUGEPAGE);
+#endif
+#if defined(__linux__) && defined(SYS_mbind)
+    if (options & QSHM_INTERLEAVE) {
+        // all the nodes, the kernel keeps the ones allowed and online.
+        unsigned long nodemask = ~0UL;
+        syscall(SYS_mbind, mem, mapsize, MPOL_INTERLEAVE_, &nodemask,
+                sizeof(nodemask) * 8 + 1, 0);
+    }
+#endif
+
+    *size = mapsize;
+    return mem;
+}
+
+/**
+ * Unmap a shared memory mapped by qshm_map().
+ *
+ * @param mem       pointer returned by qshm_map().
+ * @param size      size returned by qshm_map().
+ *
+ * @return true if successful, otherwise returns false
+ */
+bool qshm_unmap(void *mem, size_t size) {
+    if (mem == NULL || munmap(mem, size) != 0)
+        return false;
+    return true;
+}
+
+/**
+ * Remove a named shared memory object.
+ *
+ * @param name      object name given to qshm_open().
+ *
+ * @return true if successful, otherwise returns false
+ *
+ * @note
+ *  The memory is released when the last process unmaps it.
+ */
+bool qshm_unlink(const char *name) {
+    if (name == NULL || shm_unlink(name) != 0)
+        return false;
+    return true;
+}
+
 #endif /* DISABLE_IPC */
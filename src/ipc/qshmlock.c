@@ -0,0 +1,487 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/**
+ * @file qshmlock.c Process-shared lock APIs.
+ *
+ * qshmlock keeps an array of process-shared pthread locks in a shared
+ * memory segment, created and found with a keyfile and keyid like qsem.
+ * Unlike the SysV semaphores which make a semop() call on every enter and
+ * leave, an uncontended lock here is taken and released with atomic
+ * instructions in user space, the kernel is entered only to sleep and wake
+ * up the waiters.
+ *
+ * Each lock number has a mutex, taken with enter() and leave(), and an
+ * independent reader-writer lock taken with read_enter() and write_enter().
+ * The mutex is robust where the system supports it: when its owner dies
+ * holding it, the next enter() takes it over instead of waiting forever.
+ *
+ * @code
+ *   [daemon main]
+ *   qshmlock_t *lock = qshmlock_init("/some/file/for/generating/unique/key",
+ *                                    'l', 2, true);
+ *   if (lock == NULL) {
+ *     printf("ERROR: Can't initialize locks.\n");
+ *     return -1;
+ *   }
+ *   (... child forking codes ...)
+ *   qshmlock_free(lock);
+ *
+ *   [forked child]
+ *   qshmlock_enter(lock, 0);
+ *   (... guaranteed as atomic procedure ...)
+ *   qshmlock_leave(lock, 0);
+ *
+ *   [other program which uses lock 1]
+ *   qshmlock_t *lock = qshmlock_attach("/some/file/for/generating/unique/key",
+ *                                      'l');
+ *   qshmlock_read_enter(lock, 1);
+ *   (... many readers at a time ...)
+ *   qshmlock_read_leave(lock, 1);
+ *   qshmlock_detach(lock);
+ * @endcode
+ */
+
+#ifndef DISABLE_IPC
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/shm.h>
+#include "qinternal.h"
+#include "ipc/qshm.h"
+#include "ipc/qshmlock.h"
+
+#define INIT_WAIT_MS    (5000)  /*!< max wait for the creator to initialize */
+
+#ifndef _DOXYGEN_SKIP
+
+/* segment header, the locks follow it */
+typedef struct {
+    int state;      /*!< 0: being initialized, 1: ready */
+    int nlocks;     /*!< number of locks */
+} __attribute__((aligned(64))) qshmlock_header_t;
+
+/* a lock number, on its own cache line */
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_rwlock_t rwlock;
+} __attribute__((aligned(64))) qshmlock_slot_t;
+
+static qshmlock_slot_t *get_slot(qshmlock_t *lock, int lockno);
+
+#endif
+
+/**
+ * Create process-shared locks in a new shared memory segment.
+ *
+ * @param keyfile   seed for generating unique IPC key. NULL for a private
+ *                  segment shared only with the child processes forked
+ *                  afterwards.
+ * @param keyid     seed for generating unique IPC key
+ * @param nlocks    number of locks
+ * @param recreate  set to true to re-create the locks if already exists
+ *
+ * @return a pointer of qshmlock_t if successful, otherwise returns NULL.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - ENOMEM : Memory allocation failure.
+ *  - errors of ftok(), shmget(), shmat() and pthread initializers.
+ */
+qshmlock_t *qshmlock_init(const char *keyfile, int keyid, int nlocks,
+                          bool recreate) {
+    if (nlocks <= 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    qshmlock_t *lock = (qshmlock_t *) calloc(1, sizeof(qshmlock_t));
+    if (lock == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    size_t size = sizeof(qshmlock_header_t) + sizeof(qshmlock_slot_t) * nlocks;
+    lock->shmid = qshm_init(keyfile, keyid, size, recreate);
+    if (lock->shmid < 0 || (lock->shared = qshm_get(lock->shmid)) == NULL) {
+        int errnobak = errno;
+        if (lock->shmid >= 0)
+            qshm_free(lock->shmid);
+        free(lock);
+        errno = errnobak;
+        return NULL;
+    }
+    lock->nlocks = nlocks;
+
+    pthread_mutexattr_t mattr;
+    pthread_rwlockattr_t rwattr;
+    pthread_mutexattr_init(&mattr);
+    pthread_mutexattr_setpshared(&mattr, PTHREAD_PROCESS_SHARED);
+#ifdef __linux__
+    pthread_mutexattr_setrobust(&mattr, PTHREAD_MUTEX_ROBUST);
+#endif
+    pthread_rwlockattr_init(&rwattr);
+    pthread_rwlockattr_setpshared(&rwattr, PTHREAD_PROCESS_SHARED);
+
+    int i, ret = 0;
+    for (i = 0; i < nlocks && ret == 0; i++) {
+        qshmlock_slot_t *slot = get_slot(lock, i);
+        if ((ret = pthread_mutex_init(&slot->mutex, &mattr)) == 0
+            && (ret = pthread_rwlock_init(&slot->rwlock, &rwattr)) != 0) {
+            pthread_mutex_destroy(&slot->mutex);
+        }
+    }
+    pthread_mutexattr_destroy(&mattr);
+    pthread_rwlockattr_destroy(&rwattr);
+    if (ret != 0) {
+        DEBUG("Can't initialize process-shared lock. [%d]", ret);
+        qshmlock_free(lock);
+        errno = ret;
+        return NULL;
+    }
+
+    qshmlock_header_t *header = (qshmlock_header_t *) lock->shared;
+    header->nlocks = nlocks;
+    __atomic_store_n(&header->state, 1, __ATOMIC_RELEASE);
+
+    return lock;
+}
+
+/**
+ * Attach to the process-shared locks created by qshmlock_init().
+ *
+ * @param keyfile   seed for generating unique IPC key
+ * @param keyid     seed for generating unique IPC key
+ *
+ * @return a pointer of qshmlock_t if successful, otherwise returns NULL.
+ * @retval errno will be set in error condition.
+ *  - ENOMEM : Memory allocation failure.
+ *  - ETIMEDOUT : The creator didn't finish initializing the locks.
+ *  - errors of ftok(), shmget() and shmat().
+ */
+qshmlock_t *qshmlock_attach(const char *keyfile, int keyid) {
+    qshmlock_t *lock = (qshmlock_t *) calloc(1, sizeof(qshmlock_t));
+    if (lock == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    lock->shmid = qshm_getid(keyfile, keyid);
+    if (lock->shmid < 0 || (lock->shared = qshm_get(lock->shmid)) == NULL) {
+        int errnobak = errno;
+        free(lock);
+        errno = errnobak;
+        return NULL;
+    }
+
+    qshmlock_header_t *header = (qshmlock_header_t *) lock->shared;
+    int i;
+    for (i = 0; __atomic_load_n(&header->state, __ATOMIC_ACQUIRE) != 1
+                && i < INIT_WAIT_MS; i++) {
+        usleep(1000);
+    }
+    if (i == INIT_WAIT_MS) {
+        qshmlock_detach(lock);
+        errno = ETIMEDOUT;
+        return NULL;
+    }
+    lock->nlocks = header->nlocks;
+
+    return lock;
+}
+
+/**
+ * Enter the critical section of a lock.
+ *
+ * @param lock      qshmlock_t pointer
+ * @param lockno    lock number
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid lock number.
+ *  - errors of pthread_mutex_lock().
+ *
+ * @note
+ *  If the previous owner died while holding the lock, the lock is taken
+ *  over and true is returned. The data it protects may be left in the
+ *  middle of an update then, just like qsem_enter_force() forcing a
+ *  semaphore.
+ */
+bool qshmlock_enter(qshmlock_t *lock, int lockno) {
+    qshmlock_slot_t *slot = get_slot(lock, lockno);
+    if (slot == NULL)
+        return false;
+
+    int ret = pthread_mutex_lock(&slot->mutex);
+#ifdef __linux__
+    if (ret == EOWNERDEAD) {
+        DEBUG("take over the lock %d of a dead owner", lockno);
+        ret = pthread_mutex_consistent(&slot->mutex);
+    }
+#endif
+    if (ret != 0) {
+        errno = ret;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Try to enter the critical section of a lock. If it is already locked,
+ * do not wait.
+ *
+ * @param lock      qshmlock_t pointer
+ * @param lockno    lock number
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EBUSY  : Locked by other.
+ *  - EINVAL : Invalid lock number.
+ */
+bool qshmlock_enter_nowait(qshmlock_t *lock, int lockno) {
+    qshmlock_slot_t *slot = get_slot(lock, lockno);
+    if (slot == NULL)
+        return false;
+
+    int ret = pthread_mutex_trylock(&slot->mutex);
+#ifdef __linux__
+    if (ret == EOWNERDEAD) {
+        DEBUG("take over the lock %d of a dead owner", lockno);
+        ret = pthread_mutex_consistent(&slot->mutex);
+    }
+#endif
+    if (ret != 0) {
+        errno = ret;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Enter the critical section of a lock, waiting for a limited time.
+ *
+ * @param lock      qshmlock_t pointer
+ * @param lockno    lock number
+ * @param maxwaitms maximum waiting milli-seconds
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - ETIMEDOUT : Not released within maxwaitms.
+ *  - EINVAL : Invalid lock number.
+ *
+ * @note
+ *  The waiter sleeps until the lock is released or the time runs out,
+ *  which replaces the polling of qsem_enter_force().
+ */
+bool qshmlock_enter_timed(qshmlock_t *lock, int lockno, int maxwaitms) {
+    qshmlock_slot_t *slot = get_slot(lock, lockno);
+    if (slot == NULL)
+        return false;
+
+#ifdef __linux__
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += maxwaitms / 1000;
+    ts.tv_nsec += (long) (maxwaitms % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    int ret = pthread_mutex_timedlock(&slot->mutex, &ts);
+    if (ret == EOWNERDEAD) {
+        DEBUG("take over the lock %d of a dead owner", lockno);
+        ret = pthread_mutex_consistent(&slot->mutex);
+    }
+#else
+    int ret, wait;
+    for (wait = 0; (ret = pthread_mutex_trylock(&slot->mutex)) == EBUSY
+                   && wait < maxwaitms; wait++) {
+        usleep(1000);
+    }
+    if (ret == EBUSY)
+        ret = ETIMEDOUT;
+#endif
+    if (ret != 0) {
+        errno = ret;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Leave the critical section of a lock.
+ *
+ * @param lock      qshmlock_t pointer
+ * @param lockno    lock number
+ *
+ * @return true if successful, otherwise returns false.
+ */
+bool qshmlock_leave(qshmlock_t *lock, int lockno) {
+    qshmlock_slot_t *slot = get_slot(lock, lockno);
+    if (slot == NULL)
+        return false;
+
+    int ret = pthread_mutex_unlock(&slot->mutex);
+    if (ret != 0) {
+        errno = ret;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Take the reader-writer lock for reading. Many readers can hold it at a
+ * time.
+ *
+ * @param lock      qshmlock_t pointer
+ * @param lockno    lock number
+ *
+ * @return true if successful, otherwise returns false.
+ *
+ * @note
+ *  The reader-writer locks are not robust, a process must not be killed
+ *  while holding one.
+ */
+bool qshmlock_read_enter(qshmlock_t *lock, int lockno) {
+    qshmlock_slot_t *slot = get_slot(lock, lockno);
+    if (slot == NULL)
+        return false;
+
+    int ret = pthread_rwlock_rdlock(&slot->rwlock);
+    if (ret != 0) {
+        errno = ret;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Release the reader-writer lock taken for reading.
+ *
+ * @param lock      qshmlock_t pointer
+ * @param lockno    lock number
+ *
+ * @return true if successful, otherwise returns false.
+ */
+bool qshmlock_read_leave(qshmlock_t *lock, int lockno) {
+    qshmlock_slot_t *slot = get_slot(lock, lockno);
+    if (slot == NULL)
+        return false;
+
+    int ret = pthread_rwlock_unlock(&slot->rwlock);
+    if (ret != 0) {
+        errno = ret;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Take the reader-writer lock for writing, excluding all the others.
+ *
+ * @param lock      qshmlock_t pointer
+ * @param lockno    lock number
+ *
+ * @return true if successful, otherwise returns false.
+ */
+bool qshmlock_write_enter(qshmlock_t *lock, int lockno) {
+    qshmlock_slot_t *slot = get_slot(lock, lockno);
+    if (slot == NULL)
+        return false;
+
+    int ret = pthread_rwlock_wrlock(&slot->rwlock);
+    if (ret != 0) {
+        errno = ret;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Release the reader-writer lock taken for writing.
+ *
+ * @param lock      qshmlock_t pointer
+ * @param lockno    lock number
+ *
+ * @return true if successful, otherwise returns false.
+ */
+bool qshmlock_write_leave(qshmlock_t *lock, int lockno) {
+    return qshmlock_read_leave(lock, lockno);
+}
+
+/**
+ * Detach from the locks, leaving them for the other processes.
+ *
+ * @param lock      qshmlock_t pointer
+ */
+void qshmlock_detach(qshmlock_t *lock) {
+    if (lock == NULL)
+        return;
+    shmdt(lock->shared);
+    free(lock);
+}
+
+/**
+ * Release the locks to system and detach.
+ *
+ * @param lock      qshmlock_t pointer
+ *
+ * @return true if successful, otherwise returns false
+ *
+ * @note
+ *  The segment is removed when the last process detaches, the ones still
+ *  attached can keep using the locks until then.
+ */
+bool qshmlock_free(qshmlock_t *lock) {
+    if (lock == NULL)
+        return false;
+    bool ret = qshm_free(lock->shmid);
+    qshmlock_detach(lock);
+    return ret;
+}
+
+#ifndef _DOXYGEN_SKIP
+
+static qshmlock_slot_t *get_slot(qshmlock_t *lock, int lockno) {
+    if (lock == NULL || lockno < 0 || lockno >= lock->nlocks) {
+        errno = EINVAL;
+        return NULL;
+    }
+    return (qshmlock_slot_t *) ((char *) lock->shared
+                                + sizeof(qshmlock_header_t))
+           + lockno;
+}
+
+#endif /* _DOXYGEN_SKIP */
+
+#endif /* DISABLE_IPC */
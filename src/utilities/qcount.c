@@ -28,6 +28,21 @@
 
 /**
  * @file qcount.c Counter file handling APIs.
+ *
+ * A counter file holds a number in text. qcount_update() reads and saves
+ * the file on every call, which is fine for occasional updates. For the
+ * counters updated on every request, qcount_shm() keeps the counter in a
+ * shared memory segment where the processes add to it atomically, and the
+ * value is flushed into the file only once in a while.
+ *
+ * @code
+ *   // every process attaches to the same counter
+ *   qcount_shm_t *hits = qcount_shm("/var/run/hits.cnt", "/var/run", 'h',
+ *                                   1, 1000);
+ *   qcount_shm_update(hits, 1);  // per request, rarely touches the file
+ *   (...)
+ *   qcount_shm_free(hits, false);
+ * @endcode
  */
 
 #include <stdio.h>
@@ -38,11 +53,36 @@
 #include <string.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <time.h>
+#include <errno.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#ifndef DISABLE_IPC
+#include <sys/shm.h>
+#endif
 #include "qinternal.h"
-#include "utilities/qstring.h"
+#include "utilities/qfile.h"
 #include "utilities/qcount.h"
+#include "ipc/qshm.h"
+
+#define DEFAULT_FLUSH_INTERVAL  (1)       /*!< default seconds between flushes */
+#define DEFAULT_FLUSH_BATCH     (1000)    /*!< default updates between flushes */
+#define FLUSH_TIMEOUT           (10)      /*!< seconds to take over a stuck flush */
+#define INIT_WAIT_MS            (5000)    /*!< max wait for the initializer */
+
+#ifndef _DOXYGEN_SKIP
+
+/* counter state in the shared memory, zero filled when created */
+typedef struct {
+    int state;          /*!< 0: new, 1: being initialized, 2: ready */
+    int64_t value;      /*!< current counter value */
+    int64_t saved;      /*!< value last saved into the file */
+    int64_t pending;    /*!< updates since the last flush */
+    int64_t lastflush;  /*!< time of the last flush */
+    int64_t flushing;   /*!< start time of the flush in progress, or 0 */
+} qcount_shared_t;
+
+#endif
 
 /**
  * Read counter(integer) from file with advisory file locking.
@@ -91,18 +131,16 @@ int64_t qcount_read(const char *filepath) {
  * @code
  *   qcount_save("number.dat", 75);
  * @endcode
+ *
+ * @note
+ *  The file is replaced with qfile_save_atomic(), so a concurrent
+ *  qcount_read() never sees a truncated number.
  */
 bool qcount_save(const char *filepath, int64_t number) {
-    int fd = open(filepath, O_CREAT | O_WRONLY | O_TRUNC,
-                  (S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH));
-    if (fd < 0)
-        return false;
-
-    char *str = qstrdupf("%"PRId64, number);
-    ssize_t updated = write(fd, str, strlen(str));
-    close(fd);
+    char str[20 + 1];
+    int len = snprintf(str, sizeof(str), "%"PRId64, number);
 
-    if (updated > 0)
+    if (qfile_save_atomic(filepath, str, len, false) > 0)
         return true;
     return false;
 }
@@ -129,3 +167,185 @@ int64_t qcount_update(const char *filepath, int64_t number) {
     }
     return 0;
 }
+
+#ifndef DISABLE_IPC
+
+/**
+ * Attach to a counter kept in shared memory.
+ *
+ * @param filepath  counter file the value is flushed into.
+ * @param keyfile   seed for generating unique IPC key, an existing file
+ *                  which is not replaced. NULL for a private segment shared
+ *                  only with the child processes forked afterwards.
+ * @param keyid     seed for generating unique IPC key
+ * @param interval  seconds between flushes, 0 for the default of 1 second.
+ * @param batch     updates between flushes, 0 for the default of 1000.
+ *
+ * @return a pointer of qcount_shm_t if successful, otherwise returns NULL.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - ENOMEM : Memory allocation failure.
+ *  - ETIMEDOUT : The process initializing the segment didn't finish.
+ *  - errors of ftok(), shmget() and shmat().
+ *
+ * @code
+ *   qcount_shm_t *counter = qcount_shm("hits.cnt", "/var/run", 'h', 0, 0);
+ *   int64_t now = qcount_shm_update(counter, 1);
+ * @endcode
+ *
+ * @note
+ *  The first process to attach creates the segment and loads the value from
+ *  the counter file, the others share it. The value is flushed into the file
+ *  by whichever process updates the counter after the interval or the batch
+ *  of updates is reached, so the file lags behind by that much at most.
+ *  The counter file is replaced on each flush, so it can't be the keyfile.
+ */
+qcount_shm_t *qcount_shm(const char *filepath, const char *keyfile,
+                         int keyid, int interval, int64_t batch) {
+    if (filepath == NULL || interval < 0 || batch < 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    qcount_shm_t *counter = (qcount_shm_t *) calloc(1, sizeof(qcount_shm_t));
+    if (counter == NULL || (counter->filepath = strdup(filepath)) == NULL) {
+        free(counter);
+        errno = ENOMEM;
+        return NULL;
+    }
+    counter->interval = (interval > 0) ? interval : DEFAULT_FLUSH_INTERVAL;
+    counter->batch = (batch > 0) ? batch : DEFAULT_FLUSH_BATCH;
+
+    // create or attach to the existing one
+    counter->shmid = qshm_init(keyfile, keyid, sizeof(qcount_shared_t), false);
+    if (counter->shmid < 0 && keyfile != NULL && errno == EEXIST) {
+        counter->shmid = qshm_getid(keyfile, keyid);
+    }
+    if (counter->shmid < 0
+        || (counter->shared = qshm_get(counter->shmid)) == NULL) {
+        int errnobak = errno;
+        free(counter->filepath);
+        free(counter);
+        errno = errnobak;
+        return NULL;
+    }
+
+    // the first one to attach loads the value from the file
+    qcount_shared_t *shared = (qcount_shared_t *) counter->shared;
+    int state = 0;
+    if (__atomic_compare_exchange_n(&shared->state, &state, 1, false,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+        shared->value = shared->saved = qcount_read(filepath);
+        shared->lastflush = time(NULL);
+        __atomic_store_n(&shared->state, 2, __ATOMIC_RELEASE);
+    } else {
+        int i;
+        for (i = 0; __atomic_load_n(&shared->state, __ATOMIC_ACQUIRE) != 2
+                    && i < INIT_WAIT_MS; i++) {
+            usleep(1000);
+        }
+        if (i == INIT_WAIT_MS) {
+            shmdt(counter->shared);
+            free(counter->filepath);
+            free(counter);
+            errno = ETIMEDOUT;
+            return NULL;
+        }
+    }
+
+    return counter;
+}
+
+/**
+ * Increase(or decrease) the shared counter.
+ *
+ * @param counter   qcount_shm_t pointer
+ * @param number    how much increase or decrease
+ *
+ * @return updated counter value.
+ *
+ * @note
+ *  The update itself is a single atomic addition in the shared memory. The
+ *  counter file is written only when a flush is due.
+ */
+int64_t qcount_shm_update(qcount_shm_t *counter, int64_t number) {
+    qcount_shared_t *shared = (qcount_shared_t *) counter->shared;
+    int64_t value = __atomic_add_fetch(&shared->value, number,
+                                       __ATOMIC_SEQ_CST);
+    int64_t pending = __atomic_add_fetch(&shared->pending, 1,
+                                         __ATOMIC_RELAXED);
+    if (pending >= counter->batch
+        || time(NULL) - __atomic_load_n(&shared->lastflush, __ATOMIC_RELAXED)
+            >= counter->interval) {
+        qcount_shm_flush(counter);
+    }
+
+    return value;
+}
+
+/**
+ * Read the shared counter.
+ *
+ * @param counter   qcount_shm_t pointer
+ *
+ * @return current counter value, which may be ahead of the counter file.
+ */
+int64_t qcount_shm_read(qcount_shm_t *counter) {
+    qcount_shared_t *shared = (qcount_shared_t *) counter->shared;
+    return __atomic_load_n(&shared->value, __ATOMIC_SEQ_CST);
+}
+
+/**
+ * Save the shared counter into the counter file now.
+ *
+ * @param counter   qcount_shm_t pointer
+ *
+ * @return true if successful or another process is flushing it, otherwise
+ *  returns false.
+ */
+bool qcount_shm_flush(qcount_shm_t *counter) {
+    qcount_shared_t *shared = (qcount_shared_t *) counter->shared;
+
+    // one flush at a time, the one left by a dead process is taken over.
+    int64_t now = time(NULL);
+    int64_t owner = __atomic_load_n(&shared->flushing, __ATOMIC_ACQUIRE);
+    if ((owner != 0 && now - owner < FLUSH_TIMEOUT)
+        || !__atomic_compare_exchange_n(&shared->flushing, &owner, now, false,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return true;
+    }
+
+    __atomic_store_n(&shared->pending, 0, __ATOMIC_RELAXED);
+    int64_t value = __atomic_load_n(&shared->value, __ATOMIC_SEQ_CST);
+    bool ret = true;
+    if (value != shared->saved) {
+        ret = qcount_save(counter->filepath, value);
+        if (ret == true)
+            shared->saved = value;
+    }
+    __atomic_store_n(&shared->lastflush, now, __ATOMIC_RELAXED);
+    __atomic_store_n(&shared->flushing, 0, __ATOMIC_RELEASE);
+
+    return ret;
+}
+
+/**
+ * Flush and detach from the shared counter.
+ *
+ * @param counter   qcount_shm_t pointer
+ * @param destroy   true to remove the shared memory segment as well, when
+ *                  no process is going to use the counter anymore.
+ */
+void qcount_shm_free(qcount_shm_t *counter, bool destroy) {
+    if (counter == NULL)
+        return;
+
+    qcount_shm_flush(counter);
+    shmdt(counter->shared);
+    if (destroy == true)
+        qshm_free(counter->shmid);
+    free(counter->filepath);
+    free(counter);
+}
+
+#endif /* DISABLE_IPC */
@@ -33,11 +33,121 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <pthread.h>
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 #include "qinternal.h"
 #include "utilities/qstring.h"
 #include "utilities/qencode.h"
 
+#ifndef _DOXYGEN_SKIP
+
+static const char B64CHARTBL[64] = {
+    'A','B','C','D','E','F','G','H','I','J','K','L','M','N','O','P', // 00-0F
+    'Q','R','S','T','U','V','W','X','Y','Z','a','b','c','d','e','f', // 10-1F
+    'g','h','i','j','k','l','m','n','o','p','q','r','s','t','u','v', // 20-2F
+    'w','x','y','z','0','1','2','3','4','5','6','7','8','9','+','/'  // 30-3F
+};
+
+static const uint8_t B64MAPTBL[16 * 16] = {
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,  // 00-0F
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,  // 10-1F
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 62, 64, 64, 64, 63,  // 20-2F
+    52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 64, 64, 64, 64, 64, 64,  // 30-3F
+    64,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,  // 40-4F
+    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 64, 64, 64, 64, 64,  // 50-5F
+    64, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,  // 60-6F
+    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 64, 64, 64, 64, 64,  // 70-7F
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,  // 80-8F
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,  // 90-9F
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,  // A0-AF
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,  // B0-BF
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,  // C0-CF
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,  // D0-DF
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,  // E0-EF
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64   // F0-FF
+};
+
+static const char HEXCHARTBL[16] = {
+    '0','1','2','3','4','5','6','7','8','9','a','b','c','d','e','f'
+};
+
+static const uint8_t HEXMAPTBL[16 * 16] = {
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // 00-0F
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // 10-1F
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // 20-2F
+    0,  1,  2,  3,  4,  5,  6,  7,  8,  9,  0,  0,  0,  0,  0,  0, // 30-3F
+    0, 10, 11, 12, 13, 14, 15,  0,  0,  0,  0,  0,  0,  0,  0,  0, // 40-4F
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // 50-5F
+    0, 10, 11, 12, 13, 14, 15,  0,  0,  0,  0,  0,  0,  0,  0,  0, // 60-6f
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // 70-7F
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // 80-8F
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // 90-9F
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // A0-AF
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // B0-BF
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // C0-CF
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // D0-DF
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // E0-EF
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0  // F0-FF
+};
+
+// characters not to be URL encoded: 0-9 A-Z a-z - . / : @ \ _
+#define URLSAFE(c)                                                            \
+    (((c) >= '-' && (c) <= ':') || ((c) >= '@' && (c) <= 'Z')                 \
+     || ((c) >= 'a' && (c) <= 'z') || (c) == '\\' || (c) == '_')
+
+// SIMD kernels of the blocks, returning the input length processed.
+static pthread_once_t codec_once = PTHREAD_ONCE_INIT;
+static size_t (*scan_func)(const uint8_t *p, size_t len, uint8_t a, uint8_t b,
+                           uint8_t c);
+static size_t (*urlsafe_func)(const uint8_t *p, size_t len);
+static size_t (*b64enc_func)(char *dst, const uint8_t *src, size_t size);
+static size_t (*b64dec_func)(uint8_t *dst, size_t dstsize, const uint8_t *src,
+                             size_t len, size_t *outlen);
+static size_t (*hexenc_func)(char *dst, const uint8_t *src, size_t size);
+static size_t (*hexdec_func)(uint8_t *dst, const uint8_t *src, size_t len);
+static void codec_init(void);
+static char *b64enc_run(char *out, const uint8_t *in, size_t size);
+static char *b64enc_tail(char *out, const uint8_t *in, size_t size);
+static ssize_t b64dec_run(uint8_t *dst, size_t dstsize, const uint8_t *in,
+                          size_t len, int *idx, uint8_t *last);
+static char *hexenc_run(char *out, const uint8_t *in, size_t size);
+static uint8_t *hexdec_run(uint8_t *out, const uint8_t *in, size_t len);
+static char *urlenc_run(char *out, const uint8_t *in, size_t size);
+static char *urldec_run(char *out, const uint8_t *in, size_t len,
+                        size_t *left);
+static size_t scan_sw(const uint8_t *p, size_t len, uint8_t a, uint8_t b,
+                      uint8_t c);
+static size_t urlsafe_sw(const uint8_t *p, size_t len);
+#if defined(__x86_64__) && defined(__GNUC__)
+static size_t scan_avx2(const uint8_t *p, size_t len, uint8_t a, uint8_t b,
+                        uint8_t c);
+static size_t urlsafe_avx2(const uint8_t *p, size_t len);
+static size_t b64enc_avx2(char *dst, const uint8_t *src, size_t size);
+static size_t b64dec_avx2(uint8_t *dst, size_t dstsize, const uint8_t *src,
+                          size_t len, size_t *outlen);
+static size_t hexenc_avx2(char *dst, const uint8_t *src, size_t size);
+static size_t hexdec_avx2(uint8_t *dst, const uint8_t *src, size_t len);
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+static size_t scan_neon(const uint8_t *p, size_t len, uint8_t a, uint8_t b,
+                        uint8_t c);
+static size_t urlsafe_neon(const uint8_t *p, size_t len);
+static size_t b64enc_neon(char *dst, const uint8_t *src, size_t size);
+static size_t b64dec_neon(uint8_t *dst, size_t dstsize, const uint8_t *src,
+                          size_t len, size_t *outlen);
+static size_t hexenc_neon(char *dst, const uint8_t *src, size_t size);
+static size_t hexdec_neon(uint8_t *dst, const uint8_t *src, size_t len);
+#endif
+
+#endif
+
 /**
  * Parse URL encoded query string
  *
@@ -69,30 +179,105 @@ qlisttbl_t *qparse_queries(qlisttbl_t *tbl, const char *query, char equalchar,
         return tbl;
     }
 
+    // a scratch buffer for the decoded pairs
+    size_t len = strlen(query);
+    char stackbuf[1024];
+    char *buf = (len + 2 <= sizeof(stackbuf)) ? stackbuf : malloc(len + 2);
+    if (buf == NULL) {
+        return tbl;
+    }
+
     int cnt = 0;
-    char *newquery = strdup(query);
-    while (newquery && *newquery) {
-        char *value = _q_makeword(newquery, sepchar);
-        char *name = qstrtrim(_q_makeword(value, equalchar));
-        qurl_decode(name);
-        qurl_decode(value);
+    qquery_t obj;
+    memset((void *) &obj, 0, sizeof(obj));
+    while (qquery_getnext(query, len, equalchar, sepchar, &obj)) {
+        char *name = buf;
+        ssize_t namelen = qurl_decode_into(name, len + 2, obj.name,
+                                           obj.namesize);
+        char *value = name + namelen + 1;
+        qurl_decode_into(value, len + 1 - namelen, obj.value, obj.valuesize);
 
         if (tbl->putstr(tbl, name, value) == true) {
             cnt++;
         }
-
-        free(name);
-        free(value);
     }
 
     if (count != NULL) {
         *count = cnt;
     }
-    free(newquery);
+    if (buf != stackbuf) {
+        free(buf);
+    }
 
     return tbl;
 }
 
+/**
+ * Get the next name and value pair from URL encoded query string without
+ * copying.
+ *
+ * The name and value are the slices of the query string as they are, which
+ * are neither decoded nor terminated by NULL character. Decode them with
+ * qurl_decode_into() only when needed.
+ *
+ * @param query     URL encoded string.
+ * @param len       the length of query string.
+ * @param equalchar separater of key, value pair.
+ * @param sepchar   separater of line.
+ * @param obj       found data will be stored in this object.
+ *
+ * @return true if found otherwise returns false.
+ *
+ * @code
+ *  const char *query = "category=love&str=%C5%A5%B5%F0&sort=asc";
+ *  qquery_t obj;
+ *  memset((void *) &obj, 0, sizeof(obj)); // must be cleared before call
+ *  while (qquery_getnext(query, strlen(query), '=', '&', &obj)) {
+ *    if (obj.namesize == 3 && !memcmp(obj.name, "str", 3)) {
+ *      char value[64];
+ *      qurl_decode_into(value, sizeof(value), obj.value, obj.valuesize);
+ *    }
+ *  }
+ * @endcode
+ *
+ * @note
+ *  The name is trimmed of white spaces as qparse_queries() does. A pair
+ *  without equalchar has empty value.
+ */
+bool qquery_getnext(const char *query, size_t len, char equalchar,
+                    char sepchar, qquery_t *obj) {
+    if (query == NULL || obj == NULL || obj->next >= len) {
+        return false;
+    }
+
+    pthread_once(&codec_once, codec_init);
+    const uint8_t *start = (const uint8_t *) query + obj->next;
+    size_t seglen = scan_func(start, len - obj->next, sepchar, sepchar,
+                              sepchar);
+    obj->next += seglen + 1;
+
+    // name = value
+    size_t namelen = scan_func(start, seglen, equalchar, equalchar, equalchar);
+    obj->value = (const char *) start + namelen;
+    obj->valuesize = 0;
+    if (namelen < seglen) {
+        obj->value++;
+        obj->valuesize = seglen - namelen - 1;
+    }
+
+    obj->name = (const char *) start;
+    while (namelen > 0 && isspace(obj->name[0])) {
+        obj->name++;
+        namelen--;
+    }
+    while (namelen > 0 && isspace(obj->name[namelen - 1])) {
+        namelen--;
+    }
+    obj->namesize = namelen;
+
+    return true;
+}
+
 /**
  * Encode data using URL encoding(Percent encoding) algorithm.
  *
@@ -123,25 +308,6 @@ qlisttbl_t *qparse_queries(qlisttbl_t *tbl, const char *query, char equalchar,
  * @endcode
  */
 char *qurl_encode(const void *bin, size_t size) {
-    const char URLCHARTBL[16*16] = {
-        00 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , // 00-0F
-        00 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , // 10-1F
-        00 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 ,'-','.','/', // 20-2F
-        '0','1','2','3','4','5','6','7','8','9',':', 0 , 0 , 0 , 0 , 0 , // 30-3F
-        '@','A','B','C','D','E','F','G','H','I','J','K','L','M','N','O', // 40-4F
-        'P','Q','R','S','T','U','V','W','X','Y','Z', 0 ,'\\',0 , 0 ,'_', // 50-5F
-        00 ,'a','b','c','d','e','f','g','h','i','j','k','l','m','n','o', // 60-6f
-        'p','q','r','s','t','u','v','w','x','y','z', 0 , 0 , 0 , 0 , 0 , // 70-7F
-        00 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , // 80-8F
-        00 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , // 90-9F
-        00 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , // A0-AF
-        00 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , // B0-BF
-        00 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , // C0-CF
-        00 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , // D0-DF
-        00 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , // E0-EF
-        00 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0   // F0-FF
-    }; // 0 means must be encoded.
-
     if (bin == NULL)
         return NULL;
     if (size == 0)
@@ -152,26 +318,7 @@ char *qurl_encode(const void *bin, size_t size) {
     if (pszEncStr == NULL)
         return NULL;
 
-    char *pszEncPt = pszEncStr;
-    char *pBinPt = (char *) bin;
-    const char *pBinEnd = (bin + size - 1);
-    for (; pBinPt <= pBinEnd; pBinPt++) {
-        unsigned char c = *pBinPt;
-        if (URLCHARTBL[c] != 0) {
-            *pszEncPt++ = *pBinPt;
-        } else {
-            unsigned char cUpper4 = (c >> 4);
-            unsigned char cLower4 = (c & 0x0F);
-
-            *pszEncPt++ = '%';
-            *pszEncPt++ =
-                    (cUpper4 < 0x0A) ?
-                            (cUpper4 + '0') : ((cUpper4 - 0x0A) + 'a');
-            *pszEncPt++ =
-                    (cLower4 < 0x0A) ?
-                            (cLower4 + '0') : ((cLower4 - 0x0A) + 'a');
-        }
-    }
+    char *pszEncPt = urlenc_run(pszEncStr, (const uint8_t *) bin, size);
     *pszEncPt = '\0';
 
     return pszEncStr;
@@ -194,27 +341,45 @@ size_t qurl_decode(char *str) {
         return 0;
     }
 
-    char *pEncPt, *pBinPt = str;
-    for (pEncPt = str; *pEncPt != '\0'; pEncPt++) {
-        switch (*pEncPt) {
-            case '+': {
-                *pBinPt++ = ' ';
-                break;
-            }
-            case '%': {
-                *pBinPt++ = _q_x2c(*(pEncPt + 1), *(pEncPt + 2));
-                pEncPt += 2;
-                break;
-            }
-            default: {
-                *pBinPt++ = *pEncPt;
-                break;
-            }
-        }
+    size_t len = strlen(str);
+    return qurl_decode_into(str, len + 1, str, len);
+}
+
+/**
+ * Decode URL encoded string into the given buffer.
+ *
+ * @param dst       buffer to store the decoded string. It must be at least
+ *                  len + 1 bytes long.
+ * @param dstsize   size of the buffer.
+ * @param src       a pointer of URL encoded string.
+ * @param len       the length of encoded string.
+ *
+ * @return the length of decoded string stored in dst, not counting the
+ *         terminating NULL character. Otherwise returns -1.
+ * @retval errno will be set in error condition.
+ *  - ENOBUFS : The buffer is too small.
+ *
+ * @note
+ *  The dst can be the same memory as src. A '%' not followed by 2
+ *  characters is kept as it is.
+ */
+ssize_t qurl_decode_into(char *dst, size_t dstsize, const char *src,
+                         size_t len) {
+    if (dstsize < len + 1) {
+        errno = ENOBUFS;
+        return -1;
+    }
+
+    // the incomplete escape at the end is kept as it is
+    size_t left = 0;
+    char *out = urldec_run(dst, (const uint8_t *) src, len, &left);
+    if (left > 0) {
+        memmove(out, src + len - left, left);
+        out += left;
     }
-    *pBinPt = '\0';
+    *out = '\0';
 
-    return (pBinPt - str);
+    return (out - dst);
 }
 
 /**
@@ -247,49 +412,14 @@ size_t qurl_decode(char *str) {
  * @endcode
  */
 char *qbase64_encode(const void *bin, size_t size) {
-    const char B64CHARTBL[64] = {
-        'A','B','C','D','E','F','G','H','I','J','K','L','M','N','O','P', // 00-0F
-        'Q','R','S','T','U','V','W','X','Y','Z','a','b','c','d','e','f', // 10-1F
-        'g','h','i','j','k','l','m','n','o','p','q','r','s','t','u','v', // 20-2F
-        'w','x','y','z','0','1','2','3','4','5','6','7','8','9','+','/'  // 30-3F
-    };
-
-    if (size == 0) {
-        return strdup("");
-    }
-
     // malloc for encoded string
-    char *pszB64 = (char *) malloc(
-            4 * ((size / 3) + ((size % 3 == 0) ? 0 : 1)) + 1);
+    size_t bufsize = qbase64_encode_len(size) + 1;
+    char *pszB64 = (char *) malloc(bufsize);
     if (pszB64 == NULL) {
         return NULL;
     }
 
-    char *pszB64Pt = pszB64;
-    unsigned char *pBinPt, *pBinEnd = (unsigned char *) (bin + size - 1);
-    unsigned char szIn[3] = { 0, 0, 0 };
-    int nOffset;
-    for (pBinPt = (unsigned char *) bin, nOffset = 0; pBinPt <= pBinEnd;
-            pBinPt++, nOffset++) {
-        int nIdxOfThree = nOffset % 3;
-        szIn[nIdxOfThree] = *pBinPt;
-        if (nIdxOfThree < 2 && pBinPt < pBinEnd)
-            continue;
-
-        *pszB64Pt++ = B64CHARTBL[((szIn[0] & 0xFC) >> 2)];
-        *pszB64Pt++ = B64CHARTBL[(((szIn[0] & 0x03) << 4)
-                | ((szIn[1] & 0xF0) >> 4))];
-        *pszB64Pt++ =
-                (nIdxOfThree >= 1) ?
-                        B64CHARTBL[(((szIn[1] & 0x0F) << 2)
-                                | ((szIn[2] & 0xC0) >> 6))] :
-                        '=';
-        *pszB64Pt++ = (nIdxOfThree >= 2) ? B64CHARTBL[(szIn[2] & 0x3F)] : '=';
-
-        memset((void *) szIn, 0, sizeof(szIn));
-    }
-    *pszB64Pt = '\0';
-
+    qbase64_encode_into(pszB64, bufsize, bin, size);
     return pszB64;
 }
 
@@ -306,57 +436,101 @@ char *qbase64_encode(const void *bin, size_t size) {
  *  character.
  */
 size_t qbase64_decode(char *str) {
-    const char B64MAPTBL[16 * 16] = {
-        64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,  // 00-0F
-        64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,  // 10-1F
-        64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 62, 64, 64, 64, 63,  // 20-2F
-        52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 64, 64, 64, 64, 64, 64,  // 30-3F
-        64,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,  // 40-4F
-        15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 64, 64, 64, 64, 64,  // 50-5F
-        64, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,  // 60-6F
-        41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 64, 64, 64, 64, 64,  // 70-7F
-        64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,  // 80-8F
-        64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,  // 90-9F
-        64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,  // A0-AF
-        64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,  // B0-BF
-        64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,  // C0-CF
-        64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,  // D0-DF
-        64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,  // E0-EF
-        64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64   // F0-FF
-    };
-
-    char *pEncPt, *pBinPt = str;
-    int nIdxOfFour = 0;
-    char cLastByte = 0;
-    for (pEncPt = str; *pEncPt != '\0'; pEncPt++) {
-        char cByte = B64MAPTBL[(unsigned char) (*pEncPt)];
-        if (cByte == 64)
-            continue;
-
-        if (nIdxOfFour == 0) {
-            nIdxOfFour++;
-        } else if (nIdxOfFour == 1) {
-            // 00876543 0021????
-            //*pBinPt++ = ( ((cLastByte << 2) & 0xFC) | ((cByte >> 4) & 0x03) );
-            *pBinPt++ = ((cLastByte << 2) | (cByte >> 4));
-            nIdxOfFour++;
-        } else if (nIdxOfFour == 2) {
-            // 00??8765 004321??
-            //*pBinPt++ = ( ((cLastByte << 4) & 0xF0) | ((cByte >> 2) & 0x0F) );
-            *pBinPt++ = ((cLastByte << 4) | (cByte >> 2));
-            nIdxOfFour++;
-        } else {
-            // 00????87 00654321
-            //*pBinPt++ = ( ((cLastByte << 6) & 0xC0) | (cByte & 0x3F) );
-            *pBinPt++ = ((cLastByte << 6) | cByte);
-            nIdxOfFour = 0;
-        }
+    size_t len = strlen(str);
+    ssize_t decsize = qbase64_decode_into(str, len + 1, str, len);
+    if (decsize < 0)
+        decsize = 0;
+    str[decsize] = '\0';
+
+    return decsize;
+}
+
+/**
+ * Get the exact length of BASE64 encoded string of the data.
+ *
+ * @param size  the length of input data.
+ *
+ * @return the length of encoded string, not counting the terminating NULL
+ *         character.
+ */
+size_t qbase64_encode_len(size_t size) {
+    return 4 * ((size / 3) + ((size % 3 == 0) ? 0 : 1));
+}
+
+/**
+ * Get the maximum length of data decoded from BASE64 encoded string.
+ *
+ * @param len   the length of encoded string.
+ *
+ * @return the maximum length of decoded data. It's exact when the encoded
+ *         string has no padding or white spaces.
+ */
+size_t qbase64_decode_len(size_t len) {
+    return (len / 4) * 3 + ((len % 4 > 1) ? (len % 4) - 1 : 0);
+}
 
-        cLastByte = cByte;
+/**
+ * Encode data using BASE64 algorithm into the given buffer.
+ *
+ * @param dst       buffer to store the encoded string. It must be at least
+ *                  qbase64_encode_len(size) + 1 bytes long.
+ * @param dstsize   size of the buffer.
+ * @param src       a pointer of input data.
+ * @param size      the length of input data.
+ *
+ * @return the length of encoded string stored in dst, not counting the
+ *         terminating NULL character. Otherwise returns -1.
+ * @retval errno will be set in error condition.
+ *  - ENOBUFS : The buffer is too small.
+ *
+ * @code
+ *   char buf[qbase64_encode_len(sizeof(digest)) + 1];
+ *   qbase64_encode_into(buf, sizeof(buf), digest, sizeof(digest));
+ * @endcode
+ *
+ * @note
+ *  AVX2 is used when the running CPU supports it, which is detected at the
+ *  first call. NEON is used on ARMv8. The output is the same either way.
+ */
+ssize_t qbase64_encode_into(char *dst, size_t dstsize, const void *src,
+                            size_t size) {
+    size_t enclen = qbase64_encode_len(size);
+    if (dstsize < enclen + 1) {
+        errno = ENOBUFS;
+        return -1;
     }
-    *pBinPt = '\0';
 
-    return (pBinPt - str);
+    const uint8_t *in = (const uint8_t *) src;
+    char *out = b64enc_run(dst, in, size);
+    out = b64enc_tail(out, in + (size / 3) * 3, size % 3);
+    *out = '\0';
+
+    return (out - dst);
+}
+
+/**
+ * Decode BASE64 encoded string into the given buffer.
+ *
+ * @param dst       buffer to store the decoded data.
+ * @param dstsize   size of the buffer. qbase64_decode_len(len) is enough.
+ * @param src       a pointer of Base64 encoded string.
+ * @param len       the length of encoded string.
+ *
+ * @return the length of bytes stored in dst, otherwise returns -1.
+ * @retval errno will be set in error condition.
+ *  - ENOBUFS : The buffer is too small. Some may have been stored.
+ *
+ * @note
+ *  The characters which are not in BASE64 alphabet like the padding and
+ *  white spaces are skipped. The dst isn't terminated by NULL character and
+ *  it can be the same memory as src.
+ */
+ssize_t qbase64_decode_into(void *dst, size_t dstsize, const char *src,
+                            size_t len) {
+    int nIdxOfFour = 0;
+    uint8_t cLastByte = 0;
+    return b64dec_run((uint8_t *) dst, dstsize, (const uint8_t *) src, len,
+                      &nIdxOfFour, &cLastByte);
 }
 
 /**
@@ -391,23 +565,11 @@ size_t qbase64_decode(char *str) {
  * @endcode
  */
 char *qhex_encode(const void *bin, size_t size) {
-    const char HEXCHARTBL[16] = {
-        '0','1','2','3','4','5','6','7','8','9','a','b','c','d','e','f'
-    };
-
     char *pHexStr = (char *) malloc(sizeof(char) * ((size * 2) + 1));
     if (pHexStr == NULL)
         return NULL;
 
-    unsigned char *pSrc = (unsigned char *) bin;
-    char *pHexPt = pHexStr;
-    int i;
-    for (i = 0; i < size; i++) {
-        *pHexPt++ = HEXCHARTBL[(pSrc[i] >> 4)];
-        *pHexPt++ = HEXCHARTBL[(pSrc[i] & 0x0F)];
-    }
-    *pHexPt = '\0';
-
+    qhex_encode_into(pHexStr, (size * 2) + 1, bin, size);
     return pHexStr;
 }
 
@@ -424,31 +586,868 @@ char *qhex_encode(const void *bin, size_t size) {
  *  character.
  */
 size_t qhex_decode(char *str) {
-    const char HEXMAPTBL[16*16] = {
-        0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // 00-0F
-        0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // 10-1F
-        0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // 20-2F
-        0,  1,  2,  3,  4,  5,  6,  7,  8,  9,  0,  0,  0,  0,  0,  0, // 30-3F
-        0, 10, 11, 12, 13, 14, 15,  0,  0,  0,  0,  0,  0,  0,  0,  0, // 40-4F
-        0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // 50-5F
-        0, 10, 11, 12, 13, 14, 15,  0,  0,  0,  0,  0,  0,  0,  0,  0, // 60-6f
-        0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // 70-7F
-        0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // 80-8F
-        0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // 90-9F
-        0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // A0-AF
-        0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // B0-BF
-        0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // C0-CF
-        0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // D0-DF
-        0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // E0-EF
-        0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0  // F0-FF
-    };
-
-    char *pEncPt, *pBinPt = str;
-    for (pEncPt = str; *pEncPt != '\0'; pEncPt += 2) {
-        *pBinPt++ = (HEXMAPTBL[(unsigned char) (*pEncPt)] << 4)
-                + HEXMAPTBL[(unsigned char) (*(pEncPt + 1))];
-    }
-    *pBinPt = '\0';
-
-    return (pBinPt - str);
+    size_t len = strlen(str);
+    ssize_t decsize = qhex_decode_into(str, len + 1, str, len);
+    if (decsize < 0)
+        decsize = 0;
+    str[decsize] = '\0';
+
+    return decsize;
+}
+
+/**
+ * Encode data to Hexadecimal digit format into the given buffer.
+ *
+ * @param dst       buffer to store the encoded string. It must be at least
+ *                  (size * 2) + 1 bytes long.
+ * @param dstsize   size of the buffer.
+ * @param src       a pointer of input data.
+ * @param size      the length of input data.
+ *
+ * @return the length of encoded string stored in dst, not counting the
+ *         terminating NULL character. Otherwise returns -1.
+ * @retval errno will be set in error condition.
+ *  - ENOBUFS : The buffer is too small.
+ *
+ * @note
+ *  AVX2 is used when the running CPU supports it, which is detected at the
+ *  first call. NEON is used on ARMv8. The output is the same either way.
+ */
+ssize_t qhex_encode_into(char *dst, size_t dstsize, const void *src,
+                         size_t size) {
+    if (dstsize < (size * 2) + 1) {
+        errno = ENOBUFS;
+        return -1;
+    }
+
+    char *out = hexenc_run(dst, (const uint8_t *) src, size);
+    *out = '\0';
+
+    return (out - dst);
 }
+
+/**
+ * Decode Hexadecimal encoded data into the given buffer.
+ *
+ * @param dst       buffer to store the decoded data. It must be at least
+ *                  (len + 1) / 2 bytes long.
+ * @param dstsize   size of the buffer.
+ * @param src       a pointer of Hexadecimal encoded string.
+ * @param len       the length of encoded string.
+ *
+ * @return the length of bytes stored in dst, otherwise returns -1.
+ * @retval errno will be set in error condition.
+ *  - ENOBUFS : The buffer is too small.
+ *
+ * @note
+ *  Non-hexadecimal characters are taken as 0. The dst isn't terminated by
+ *  NULL character and it can be the same memory as src.
+ */
+ssize_t qhex_decode_into(void *dst, size_t dstsize, const char *src,
+                         size_t len) {
+    size_t declen = (len + 1) / 2;
+    if (dstsize < declen) {
+        errno = ENOBUFS;
+        return -1;
+    }
+
+    const uint8_t *in = (const uint8_t *) src;
+    uint8_t *out = hexdec_run((uint8_t *) dst, in, len & ~((size_t) 1));
+    if (len % 2 > 0) {
+        *out++ = (HEXMAPTBL[in[len - 1]] << 4);
+    }
+
+    return declen;
+}
+
+/**
+ * Initialize a streaming codec.
+ *
+ * The data can be encoded or decoded chunk by chunk with constant memory,
+ * which gives the same output as the whole data at once.
+ *
+ * @param codec     qcodec_t structure pointer to initialize.
+ * @param type      one of QCODEC_BASE64_ENCODE, QCODEC_BASE64_DECODE,
+ *                  QCODEC_HEX_ENCODE, QCODEC_HEX_DECODE, QCODEC_URL_ENCODE
+ *                  and QCODEC_URL_DECODE.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *
+ * @code
+ *   qcodec_t codec;
+ *   qcodec_init(&codec, QCODEC_BASE64_ENCODE);
+ *
+ *   char in[4096], out[qcodec_bound(&codec, sizeof(in))];
+ *   ssize_t n;
+ *   while ((n = qio_read(infd, in, sizeof(in), -1)) > 0) {
+ *     ssize_t outlen = qcodec_update(&codec, out, sizeof(out), in, n);
+ *     qio_write(outfd, out, outlen, -1);
+ *   }
+ *   qio_write(outfd, out, qcodec_final(&codec, out, sizeof(out)), -1);
+ * @endcode
+ */
+bool qcodec_init(qcodec_t *codec, int type) {
+    if (codec == NULL || type < QCODEC_BASE64_ENCODE
+            || type > QCODEC_URL_DECODE) {
+        errno = EINVAL;
+        return false;
+    }
+
+    memset((void *) codec, 0, sizeof(qcodec_t));
+    codec->type = type;
+    return true;
+}
+
+/**
+ * Get the maximum length of the output for the next input.
+ *
+ * @param codec     qcodec_t structure pointer.
+ * @param size      the length of the next input for qcodec_update().
+ *
+ * @return the maximum length qcodec_update() stores for the input, which
+ *         also covers qcodec_final() after it. 0 size gives the one for
+ *         qcodec_final().
+ *
+ * @note
+ *  It depends only on the data carried over, so a buffer sized with the
+ *  chunk size plus a few bytes fits every update.
+ */
+size_t qcodec_bound(const qcodec_t *codec, size_t size) {
+    size_t total = codec->npending + size;
+    switch (codec->type) {
+        case QCODEC_BASE64_ENCODE:
+            return qbase64_encode_len(total);
+        case QCODEC_BASE64_DECODE:
+            // bytes of the current quad are already out
+            return qbase64_decode_len(codec->idx + size)
+                    - ((codec->idx > 1) ? codec->idx - 1 : 0);
+        case QCODEC_HEX_ENCODE:
+            return size * 2;
+        case QCODEC_HEX_DECODE:
+            return (total + 1) / 2;
+        case QCODEC_URL_ENCODE:
+            return size * 3;
+        case QCODEC_URL_DECODE:
+            return total;
+    }
+    return 0;
+}
+
+/**
+ * Encode or decode the next chunk of data.
+ *
+ * @param codec     qcodec_t structure pointer.
+ * @param dst       buffer to store the output. It's not terminated by NULL
+ *                  character.
+ * @param dstsize   size of the buffer. qcodec_bound(codec, size) is enough.
+ * @param src       a pointer of the input chunk.
+ * @param size      the length of the input chunk.
+ *
+ * @return the length of the output stored in dst, otherwise returns -1.
+ * @retval errno will be set in error condition.
+ *  - ENOBUFS : The buffer is smaller than qcodec_bound(). Nothing is done.
+ *
+ * @note
+ *  The bytes which can't make a whole unit yet like a part of BASE64 quad
+ *  or URL escape are carried over to the next call. The dst can't be the
+ *  same memory as src.
+ */
+ssize_t qcodec_update(qcodec_t *codec, void *dst, size_t dstsize,
+                      const void *src, size_t size) {
+    if (dstsize < qcodec_bound(codec, size)) {
+        errno = ENOBUFS;
+        return -1;
+    }
+
+    const uint8_t *in = (const uint8_t *) src;
+    uint8_t *out = (uint8_t *) dst;
+
+    // fill up the carried unit first
+    size_t unit = (codec->type == QCODEC_BASE64_ENCODE) ? 3 :
+                  (codec->type == QCODEC_HEX_DECODE) ? 2 :
+                  (codec->type == QCODEC_URL_DECODE) ? 3 : 0;
+    if (codec->npending > 0) {
+        while (codec->npending < unit && size > 0) {
+            codec->pending[codec->npending++] = *in++;
+            size--;
+        }
+        if (codec->npending < unit)
+            return 0;
+
+        if (codec->type == QCODEC_BASE64_ENCODE) {
+            out = (uint8_t *) b64enc_run((char *) out, codec->pending, 3);
+        } else if (codec->type == QCODEC_HEX_DECODE) {
+            out = hexdec_run(out, codec->pending, 2);
+        } else {
+            *out++ = _q_x2c(codec->pending[1], codec->pending[2]);
+        }
+        codec->npending = 0;
+    }
+
+    size_t left = 0;
+    switch (codec->type) {
+        case QCODEC_BASE64_ENCODE: {
+            out = (uint8_t *) b64enc_run((char *) out, in, size);
+            left = size % 3;
+            break;
+        }
+        case QCODEC_BASE64_DECODE: {
+            size_t avail = (uint8_t *) dst + dstsize - out;
+            ssize_t outlen = b64dec_run(out, avail, in, size, &codec->idx,
+                                        &codec->last);
+            if (outlen < 0)
+                return -1;
+            out += outlen;
+            break;
+        }
+        case QCODEC_HEX_ENCODE: {
+            out = (uint8_t *) hexenc_run((char *) out, in, size);
+            break;
+        }
+        case QCODEC_HEX_DECODE: {
+            out = hexdec_run(out, in, size & ~((size_t) 1));
+            left = size % 2;
+            break;
+        }
+        case QCODEC_URL_ENCODE: {
+            out = (uint8_t *) urlenc_run((char *) out, in, size);
+            break;
+        }
+        case QCODEC_URL_DECODE: {
+            out = (uint8_t *) urldec_run((char *) out, in, size, &left);
+            break;
+        }
+    }
+
+    // carry the rest over
+    memcpy((void *) codec->pending, (void *) (in + size - left), left);
+    codec->npending = left;
+
+    return (out - (uint8_t *) dst);
+}
+
+/**
+ * Finish the stream, storing what is carried over.
+ *
+ * @param codec     qcodec_t structure pointer.
+ * @param dst       buffer to store the output. It's not terminated by NULL
+ *                  character.
+ * @param dstsize   size of the buffer. qcodec_bound(codec, 0) is enough.
+ *
+ * @return the length of the output stored in dst, otherwise returns -1.
+ * @retval errno will be set in error condition.
+ *  - ENOBUFS : The buffer is too small.
+ *
+ * @note
+ *  The padding of BASE64 is stored here. The codec is ready for the next
+ *  stream of the same type after this.
+ */
+ssize_t qcodec_final(qcodec_t *codec, void *dst, size_t dstsize) {
+    if (dstsize < qcodec_bound(codec, 0)) {
+        errno = ENOBUFS;
+        return -1;
+    }
+
+    uint8_t *out = (uint8_t *) dst;
+    if (codec->npending > 0) {
+        if (codec->type == QCODEC_BASE64_ENCODE) {
+            out = (uint8_t *) b64enc_tail((char *) out, codec->pending,
+                                          codec->npending);
+        } else if (codec->type == QCODEC_HEX_DECODE) {
+            *out++ = (HEXMAPTBL[codec->pending[0]] << 4);
+        } else {
+            // incomplete URL escape as it is
+            memcpy((void *) out, (void *) codec->pending, codec->npending);
+            out += codec->npending;
+        }
+    }
+
+    qcodec_init(codec, codec->type);
+    return (out - (uint8_t *) dst);
+}
+
+#ifndef _DOXYGEN_SKIP
+
+static void codec_init(void) {
+    scan_func = scan_sw;
+    urlsafe_func = urlsafe_sw;
+#if defined(__x86_64__) && defined(__GNUC__)
+    if (__builtin_cpu_supports("avx2")) {
+        scan_func = scan_avx2;
+        urlsafe_func = urlsafe_avx2;
+        b64enc_func = b64enc_avx2;
+        b64dec_func = b64dec_avx2;
+        hexenc_func = hexenc_avx2;
+        hexdec_func = hexdec_avx2;
+    }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+    scan_func = scan_neon;
+    urlsafe_func = urlsafe_neon;
+    b64enc_func = b64enc_neon;
+    b64dec_func = b64dec_neon;
+    hexenc_func = hexenc_neon;
+    hexdec_func = hexdec_neon;
+#endif
+}
+
+// encodes the whole triples of the data, returning the end of the output.
+static char *b64enc_run(char *out, const uint8_t *in, size_t size) {
+    // blocks by SIMD, then the rest by table
+    pthread_once(&codec_once, codec_init);
+    if (b64enc_func != NULL) {
+        size_t done = b64enc_func(out, in, size);
+        in += done;
+        out += (done / 3) * 4;
+        size -= done;
+    }
+
+    for (; size >= 3; size -= 3, in += 3) {
+        *out++ = B64CHARTBL[in[0] >> 2];
+        *out++ = B64CHARTBL[((in[0] & 0x03) << 4) | (in[1] >> 4)];
+        *out++ = B64CHARTBL[((in[1] & 0x0F) << 2) | (in[2] >> 6)];
+        *out++ = B64CHARTBL[in[2] & 0x3F];
+    }
+
+    return out;
+}
+
+// encodes the last 1 or 2 bytes with the padding.
+static char *b64enc_tail(char *out, const uint8_t *in, size_t size) {
+    if (size > 0) {
+        uint8_t in1 = (size > 1) ? in[1] : 0;
+        *out++ = B64CHARTBL[in[0] >> 2];
+        *out++ = B64CHARTBL[((in[0] & 0x03) << 4) | (in1 >> 4)];
+        *out++ = (size > 1) ? B64CHARTBL[(in1 & 0x0F) << 2] : '=';
+        *out++ = '=';
+    }
+
+    return out;
+}
+
+// decodes with the position in a quad and the last value carried over.
+static ssize_t b64dec_run(uint8_t *dst, size_t dstsize, const uint8_t *in,
+                          size_t len, int *idx, uint8_t *last) {
+    const uint8_t *end = in + len;
+    uint8_t *out = dst, *outend = dst + dstsize;
+    int nIdxOfFour = *idx;
+    uint8_t cLastByte = *last;
+
+    pthread_once(&codec_once, codec_init);
+    while (in < end) {
+        // blocks by SIMD until the first non-alphabet character
+        if (nIdxOfFour == 0 && b64dec_func != NULL) {
+            size_t outlen = 0;
+            in += b64dec_func(out, outend - out, in, end - in, &outlen);
+            out += outlen;
+        }
+
+        // a block by table, then back to SIMD
+        const uint8_t *stop = (end - in > 32) ? in + 32 : end;
+        for (; in < stop; in++) {
+            uint8_t cByte = B64MAPTBL[*in];
+            if (cByte == 64)
+                continue;
+
+            if (nIdxOfFour > 0) {
+                if (out >= outend) {
+                    *idx = nIdxOfFour;
+                    *last = cLastByte;
+                    errno = ENOBUFS;
+                    return -1;
+                }
+                if (nIdxOfFour == 1) {
+                    // 00876543 0021????
+                    *out++ = ((cLastByte << 2) | (cByte >> 4));
+                } else if (nIdxOfFour == 2) {
+                    // 00??8765 004321??
+                    *out++ = ((cLastByte << 4) | (cByte >> 2));
+                } else {
+                    // 00????87 00654321
+                    *out++ = ((cLastByte << 6) | cByte);
+                }
+            }
+            nIdxOfFour = (nIdxOfFour + 1) % 4;
+            cLastByte = cByte;
+        }
+    }
+
+    *idx = nIdxOfFour;
+    *last = cLastByte;
+    return (out - dst);
+}
+
+static char *hexenc_run(char *out, const uint8_t *in, size_t size) {
+    const uint8_t *end = in + size;
+
+    pthread_once(&codec_once, codec_init);
+    if (hexenc_func != NULL) {
+        size_t done = hexenc_func(out, in, size);
+        in += done;
+        out += done * 2;
+    }
+
+    for (; in < end; in++) {
+        *out++ = HEXCHARTBL[(*in >> 4)];
+        *out++ = HEXCHARTBL[(*in & 0x0F)];
+    }
+
+    return out;
+}
+
+// decodes the pairs, len must be even.
+static uint8_t *hexdec_run(uint8_t *out, const uint8_t *in, size_t len) {
+    pthread_once(&codec_once, codec_init);
+    if (hexdec_func != NULL) {
+        size_t done = hexdec_func(out, in, len);
+        in += done;
+        out += done / 2;
+        len -= done;
+    }
+
+    for (; len >= 2; len -= 2, in += 2) {
+        *out++ = (HEXMAPTBL[in[0]] << 4) + HEXMAPTBL[in[1]];
+    }
+
+    return out;
+}
+
+static char *urlenc_run(char *out, const uint8_t *in, size_t size) {
+    const uint8_t *end = in + size;
+
+    pthread_once(&codec_once, codec_init);
+    while (in < end) {
+        // copy the run of characters not to be encoded
+        size_t run = urlsafe_func(in, end - in);
+        if (run > 0) {
+            memcpy(out, in, run);
+            out += run;
+            in += run;
+            if (in >= end)
+                break;
+        }
+
+        unsigned char cUpper4 = (*in >> 4);
+        unsigned char cLower4 = (*in & 0x0F);
+        *out++ = '%';
+        *out++ = (cUpper4 < 0x0A) ? (cUpper4 + '0') : ((cUpper4 - 0x0A) + 'a');
+        *out++ = (cLower4 < 0x0A) ? (cLower4 + '0') : ((cLower4 - 0x0A) + 'a');
+        in++;
+    }
+
+    return out;
+}
+
+// decodes up to the incomplete escape at the end, its length goes to left.
+static char *urldec_run(char *out, const uint8_t *in, size_t len,
+                        size_t *left) {
+    const uint8_t *end = in + len;
+
+    pthread_once(&codec_once, codec_init);
+    *left = 0;
+    while (in < end) {
+        // move the run of plain characters at once
+        size_t run = scan_func(in, end - in, '%', '+', '%');
+        if (run > 0) {
+            if (out != (const char *) in)
+                memmove(out, in, run);
+            out += run;
+            in += run;
+            if (in >= end)
+                break;
+        }
+
+        if (*in == '+') {
+            *out++ = ' ';
+            in++;
+        } else if (end - in >= 3) {
+            *out++ = _q_x2c(in[1], in[2]);
+            in += 3;
+        } else {
+            *left = end - in;
+            break;
+        }
+    }
+
+    return out;
+}
+
+// returns the position of the first one of a, b or c, len if none.
+static size_t scan_sw(const uint8_t *p, size_t len, uint8_t a, uint8_t b,
+                      uint8_t c) {
+    size_t i;
+    for (i = 0; i < len; i++) {
+        if (p[i] == a || p[i] == b || p[i] == c)
+            break;
+    }
+    return i;
+}
+
+// returns the length of the leading characters not to be URL encoded.
+static size_t urlsafe_sw(const uint8_t *p, size_t len) {
+    size_t i;
+    for (i = 0; i < len && URLSAFE(p[i]); i++);
+    return i;
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+__attribute__((target("avx2")))
+static size_t scan_avx2(const uint8_t *p, size_t len, uint8_t a, uint8_t b,
+                        uint8_t c) {
+    const __m256i va = _mm256_set1_epi8(a);
+    const __m256i vb = _mm256_set1_epi8(b);
+    const __m256i vc = _mm256_set1_epi8(c);
+
+    size_t i;
+    for (i = 0; len - i >= 32; i += 32) {
+        __m256i in = _mm256_loadu_si256((const __m256i *) (p + i));
+        __m256i eq = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(in, va),
+                                _mm256_cmpeq_epi8(in, vb)),
+                _mm256_cmpeq_epi8(in, vc));
+        uint32_t mask = (uint32_t) _mm256_movemask_epi8(eq);
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+
+    return i + scan_sw(p + i, len - i, a, b, c);
+}
+
+// a byte is in [lo, lo + n] by one unsigned comparison.
+#define IN_RANGE_AVX2(v, lo, n)                                               \
+    _mm256_cmpeq_epi8(_mm256_min_epu8(_mm256_sub_epi8(v, _mm256_set1_epi8(lo)),\
+                                      _mm256_set1_epi8(n)),                   \
+                      _mm256_sub_epi8(v, _mm256_set1_epi8(lo)))
+
+__attribute__((target("avx2")))
+static size_t urlsafe_avx2(const uint8_t *p, size_t len) {
+    size_t i;
+    for (i = 0; len - i >= 32; i += 32) {
+        __m256i in = _mm256_loadu_si256((const __m256i *) (p + i));
+        __m256i ok = _mm256_or_si256(
+                _mm256_or_si256(IN_RANGE_AVX2(in, '-', ':' - '-'),
+                                IN_RANGE_AVX2(in, '@', 'Z' - '@')),
+                _mm256_or_si256(IN_RANGE_AVX2(in, 'a', 'z' - 'a'),
+                                _mm256_or_si256(
+                                        _mm256_cmpeq_epi8(
+                                                in, _mm256_set1_epi8('\\')),
+                                        _mm256_cmpeq_epi8(
+                                                in, _mm256_set1_epi8('_')))));
+        uint32_t mask = ~(uint32_t) _mm256_movemask_epi8(ok);
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+
+    return i + urlsafe_sw(p + i, len - i);
+}
+
+// 24 bytes to 32 characters a round, reading 28 bytes ahead.
+__attribute__((target("avx2")))
+static size_t b64enc_avx2(char *dst, const uint8_t *src, size_t size) {
+    const __m256i shuf = _mm256_set_epi8(
+            10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+            10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+    const __m256i shift = _mm256_setr_epi8(
+            'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+            '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+            '/' - 63, 'A', 0, 0,
+            'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+            '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+            '/' - 63, 'A', 0, 0);
+
+    size_t done;
+    for (done = 0; size - done >= 28; done += 24, dst += 32) {
+        __m256i in = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(
+                        _mm_loadu_si128((const __m128i *) (src + done))),
+                _mm_loadu_si128((const __m128i *) (src + done + 12)), 1);
+        in = _mm256_shuffle_epi8(in, shuf);
+
+        // split 3 bytes to 4 indices of 6 bits
+        __m256i t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00));
+        __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+        __m256i t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0));
+        __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+        __m256i idx = _mm256_or_si256(t1, t3);
+
+        // index to character by the offset of its range
+        __m256i r = _mm256_subs_epu8(idx, _mm256_set1_epi8(51));
+        __m256i less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), idx);
+        r = _mm256_or_si256(r, _mm256_and_si256(less, _mm256_set1_epi8(13)));
+        r = _mm256_add_epi8(_mm256_shuffle_epi8(shift, r), idx);
+
+        _mm256_storeu_si256((__m256i *) dst, r);
+    }
+
+    return done;
+}
+
+// 32 characters to 24 bytes a round, writing 32 bytes.
+__attribute__((target("avx2")))
+static size_t b64dec_avx2(uint8_t *dst, size_t dstsize, const uint8_t *src,
+                          size_t len, size_t *outlen) {
+    const __m256i lut_lo = _mm256_setr_epi8(
+            0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+            0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+            0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+            0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m256i lut_hi = _mm256_setr_epi8(
+            0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+            0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+            0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+            0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m256i lut_roll = _mm256_setr_epi8(
+            0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+            0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i mask_2f = _mm256_set1_epi8(0x2f);
+    const __m256i pack = _mm256_setr_epi8(
+            2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+            2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+    size_t done, out;
+    for (done = 0, out = 0; len - done >= 32 && dstsize - out >= 32;
+            done += 32, out += 24) {
+        __m256i in = _mm256_loadu_si256((const __m256i *) (src + done));
+
+        // stop at any character out of the alphabet
+        __m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(in, 4),
+                                              mask_2f);
+        __m256i lo_nibbles = _mm256_and_si256(in, mask_2f);
+        __m256i lo = _mm256_shuffle_epi8(lut_lo, lo_nibbles);
+        __m256i hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+        if (!_mm256_testz_si256(lo, hi))
+            break;
+
+        // character to 6 bits value
+        __m256i eq_2f = _mm256_cmpeq_epi8(in, mask_2f);
+        __m256i roll = _mm256_shuffle_epi8(lut_roll,
+                                           _mm256_add_epi8(eq_2f, hi_nibbles));
+        __m256i v = _mm256_add_epi8(in, roll);
+
+        // merge 4 values of 6 bits to 3 bytes
+        v = _mm256_maddubs_epi16(v, _mm256_set1_epi32(0x01400140));
+        v = _mm256_madd_epi16(v, _mm256_set1_epi32(0x00011000));
+        v = _mm256_shuffle_epi8(v, pack);
+        v = _mm256_permutevar8x32_epi32(v,
+                                        _mm256_setr_epi32(0, 1, 2, 4, 5, 6,
+                                                          -1, -1));
+        _mm256_storeu_si256((__m256i *) (dst + out), v);
+    }
+
+    *outlen = out;
+    return done;
+}
+
+// 16 bytes to 32 characters a round.
+__attribute__((target("avx2")))
+static size_t hexenc_avx2(char *dst, const uint8_t *src, size_t size) {
+    const __m256i lut = _mm256_setr_epi8(
+            '0', '1', '2', '3', '4', '5', '6', '7',
+            '8', '9', 'a', 'b', 'c', 'd', 'e', 'f',
+            '0', '1', '2', '3', '4', '5', '6', '7',
+            '8', '9', 'a', 'b', 'c', 'd', 'e', 'f');
+    const __m128i mask_0f = _mm_set1_epi8(0x0f);
+
+    size_t done;
+    for (done = 0; size - done >= 16; done += 16, dst += 32) {
+        __m128i in = _mm_loadu_si128((const __m128i *) (src + done));
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(in, 4), mask_0f);
+        __m128i lo = _mm_and_si128(in, mask_0f);
+        __m256i nibbles = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_unpacklo_epi8(hi, lo)),
+                _mm_unpackhi_epi8(hi, lo), 1);
+        _mm256_storeu_si256((__m256i *) dst,
+                            _mm256_shuffle_epi8(lut, nibbles));
+    }
+
+    return done;
+}
+
+// 32 characters to 16 bytes a round.
+__attribute__((target("avx2")))
+static size_t hexdec_avx2(uint8_t *dst, const uint8_t *src, size_t len) {
+    size_t done;
+    for (done = 0; len - done >= 32; done += 32, dst += 16) {
+        __m256i in = _mm256_loadu_si256((const __m256i *) (src + done));
+
+        // '0'-'9', 'A'-'F' and 'a'-'f' to its value, others to 0
+        __m256i d = _mm256_sub_epi8(in, _mm256_set1_epi8('0'));
+        __m256i isd = _mm256_cmpeq_epi8(
+                _mm256_min_epu8(d, _mm256_set1_epi8(9)), d);
+        __m256i a = _mm256_sub_epi8(
+                _mm256_or_si256(in, _mm256_set1_epi8(0x20)),
+                _mm256_set1_epi8('a'));
+        __m256i isa = _mm256_cmpeq_epi8(
+                _mm256_min_epu8(a, _mm256_set1_epi8(5)), a);
+        __m256i v = _mm256_or_si256(
+                _mm256_and_si256(isd, d),
+                _mm256_and_si256(isa,
+                                 _mm256_add_epi8(a, _mm256_set1_epi8(10))));
+
+        // merge 2 nibbles to a byte
+        v = _mm256_maddubs_epi16(v, _mm256_set1_epi16(0x0110));
+        v = _mm256_packus_epi16(v, v);
+        v = _mm256_permute4x64_epi64(v, 0x08);
+        _mm_storeu_si128((__m128i *) dst, _mm256_castsi256_si128(v));
+    }
+
+    return done;
+}
+
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+// the position of the first set byte of 0xFF or 0x00 bytes, 16 if none.
+static inline int neon_first(uint8x16_t eq) {
+    uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(
+            vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+    return (mask != 0) ? __builtin_ctzll(mask) / 4 : 16;
+}
+
+static size_t scan_neon(const uint8_t *p, size_t len, uint8_t a, uint8_t b,
+                        uint8_t c) {
+    const uint8x16_t va = vdupq_n_u8(a);
+    const uint8x16_t vb = vdupq_n_u8(b);
+    const uint8x16_t vc = vdupq_n_u8(c);
+
+    size_t i;
+    for (i = 0; len - i >= 16; i += 16) {
+        uint8x16_t in = vld1q_u8(p + i);
+        uint8x16_t eq = vorrq_u8(vorrq_u8(vceqq_u8(in, va), vceqq_u8(in, vb)),
+                                 vceqq_u8(in, vc));
+        int first = neon_first(eq);
+        if (first < 16)
+            return i + first;
+    }
+
+    return i + scan_sw(p + i, len - i, a, b, c);
+}
+
+static size_t urlsafe_neon(const uint8_t *p, size_t len) {
+    size_t i;
+    for (i = 0; len - i >= 16; i += 16) {
+        uint8x16_t in = vld1q_u8(p + i);
+        uint8x16_t ok = vorrq_u8(
+                vorrq_u8(vcleq_u8(vsubq_u8(in, vdupq_n_u8('-')),
+                                  vdupq_n_u8(':' - '-')),
+                         vcleq_u8(vsubq_u8(in, vdupq_n_u8('@')),
+                                  vdupq_n_u8('Z' - '@'))),
+                vorrq_u8(vcleq_u8(vsubq_u8(in, vdupq_n_u8('a')),
+                                  vdupq_n_u8('z' - 'a')),
+                         vorrq_u8(vceqq_u8(in, vdupq_n_u8('\\')),
+                                  vceqq_u8(in, vdupq_n_u8('_')))));
+        int first = neon_first(vmvnq_u8(ok));
+        if (first < 16)
+            return i + first;
+    }
+
+    return i + urlsafe_sw(p + i, len - i);
+}
+
+// 48 bytes to 64 characters a round.
+static size_t b64enc_neon(char *dst, const uint8_t *src, size_t size) {
+    uint8x16x4_t lut = vld1q_u8_x4((const uint8_t *) B64CHARTBL);
+    uint8x16_t mask_3f = vdupq_n_u8(0x3f);
+
+    size_t done;
+    for (done = 0; size - done >= 48; done += 48, dst += 64) {
+        uint8x16x3_t in = vld3q_u8(src + done);
+        uint8x16x4_t out;
+        out.val[0] = vshrq_n_u8(in.val[0], 2);
+        out.val[1] = vandq_u8(vorrq_u8(vshrq_n_u8(in.val[1], 4),
+                                       vshlq_n_u8(in.val[0], 4)), mask_3f);
+        out.val[2] = vandq_u8(vorrq_u8(vshrq_n_u8(in.val[2], 6),
+                                       vshlq_n_u8(in.val[1], 2)), mask_3f);
+        out.val[3] = vandq_u8(in.val[2], mask_3f);
+
+        int i;
+        for (i = 0; i < 4; i++) {
+            out.val[i] = vqtbl4q_u8(lut, out.val[i]);
+        }
+        vst4q_u8((uint8_t *) dst, out);
+    }
+
+    return done;
+}
+
+// 64 characters to 48 bytes a round.
+static size_t b64dec_neon(uint8_t *dst, size_t dstsize, const uint8_t *src,
+                          size_t len, size_t *outlen) {
+    uint8x16x4_t lut_lo = vld1q_u8_x4((const uint8_t *) B64MAPTBL);
+    uint8x16x4_t lut_hi = vld1q_u8_x4((const uint8_t *) B64MAPTBL + 64);
+    uint8x16_t off_40 = vdupq_n_u8(0x40);
+
+    size_t done, out;
+    for (done = 0, out = 0; len - done >= 64 && dstsize - out >= 48;
+            done += 64, out += 48) {
+        uint8x16x4_t in = vld4q_u8(src + done);
+
+        // character to 6 bits value, 64 or more out of the alphabet
+        uint8x16_t bad = vdupq_n_u8(0);
+        int i;
+        for (i = 0; i < 4; i++) {
+            uint8x16_t c = in.val[i];
+            uint8x16_t v = vqtbl4q_u8(lut_lo, c);
+            v = vqtbx4q_u8(v, lut_hi, vsubq_u8(c, off_40));
+            bad = vorrq_u8(bad, vorrq_u8(v, vandq_u8(c, vdupq_n_u8(0x80))));
+            in.val[i] = v;
+        }
+        // non-alphabet are 64, high-bit characters are 0x80 or above
+        if (vmaxvq_u8(vandq_u8(bad, vdupq_n_u8(0xc0))) != 0)
+            break;
+
+        uint8x16x3_t o;
+        o.val[0] = vorrq_u8(vshlq_n_u8(in.val[0], 2),
+                            vshrq_n_u8(in.val[1], 4));
+        o.val[1] = vorrq_u8(vshlq_n_u8(in.val[1], 4),
+                            vshrq_n_u8(in.val[2], 2));
+        o.val[2] = vorrq_u8(vshlq_n_u8(in.val[2], 6), in.val[3]);
+        vst3q_u8(dst + out, o);
+    }
+
+    *outlen = out;
+    return done;
+}
+
+// 16 bytes to 32 characters a round.
+static size_t hexenc_neon(char *dst, const uint8_t *src, size_t size) {
+    uint8x16_t lut = vld1q_u8((const uint8_t *) HEXCHARTBL);
+    uint8x16_t mask_0f = vdupq_n_u8(0x0f);
+
+    size_t done;
+    for (done = 0; size - done >= 16; done += 16, dst += 32) {
+        uint8x16_t in = vld1q_u8(src + done);
+        uint8x16x2_t out;
+        out.val[0] = vqtbl1q_u8(lut, vshrq_n_u8(in, 4));
+        out.val[1] = vqtbl1q_u8(lut, vandq_u8(in, mask_0f));
+        vst2q_u8((uint8_t *) dst, out);
+    }
+
+    return done;
+}
+
+// 32 characters to 16 bytes a round.
+static size_t hexdec_neon(uint8_t *dst, const uint8_t *src, size_t len) {
+    size_t done;
+    for (done = 0; len - done >= 32; done += 32, dst += 16) {
+        uint8x16x2_t in = vld2q_u8(src + done);
+
+        // '0'-'9', 'A'-'F' and 'a'-'f' to its value, others to 0
+        int i;
+        for (i = 0; i < 2; i++) {
+            uint8x16_t c = in.val[i];
+            uint8x16_t d = vsubq_u8(c, vdupq_n_u8('0'));
+            uint8x16_t a = vsubq_u8(vorrq_u8(c, vdupq_n_u8(0x20)),
+                                    vdupq_n_u8('a'));
+            in.val[i] = vorrq_u8(
+                    vandq_u8(vcleq_u8(d, vdupq_n_u8(9)), d),
+                    vandq_u8(vcleq_u8(a, vdupq_n_u8(5)),
+                             vaddq_u8(a, vdupq_n_u8(10))));
+        }
+        vst1q_u8(dst, vorrq_u8(vshlq_n_u8(in.val[0], 4), in.val[1]));
+    }
+
+    return done;
+}
+#endif
+
+#endif /* _DOXYGEN_SKIP */
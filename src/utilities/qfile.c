@@ -43,7 +43,9 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/file.h>
+#include <sys/mman.h>
 #include "qinternal.h"
+#include "utilities/qio.h"
 #include "utilities/qstring.h"
 #include "utilities/qfile.h"
 
@@ -260,6 +262,110 @@ void *qfile_read(FILE *fp, size_t *nbytes) {
     return (void *) data;
 }
 
+/**
+ * Map a file into memory for reading.
+ *
+ * @param filepath  file path
+ * @param nbytes    has two purpose, one is to set bytes to map.
+ *                  the other is to return actual number of bytes mapped.
+ *                  0 or NULL can be set to map the whole file.
+ * @param hints     combination of the access hints, 0 for none.
+ *
+ * @return a pointer of the read-only mapping if successful, otherwise
+ *  returns NULL.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - errors of open(), fstat() and mmap().
+ *
+ * @code
+ *   size_t size = 0;
+ *   const char *data = qfile_map("/data/big.csv", &size, QFILE_MAP_SEQUENTIAL);
+ *   if (data != NULL) {
+ *     (...parse data[0] ~ data[size - 1]...)
+ *     qfile_unmap(data, size);
+ *   }
+ * @endcode
+ *
+ * @note
+ *  Unlike qfile_load(), nothing is copied, the pages come straight from the
+ *  page cache as they are touched, so a large file doesn't take its size in
+ *  the heap. The mapping isn't NUL terminated; use the returned size. An
+ *  empty file gives a valid pointer with size 0.
+ *
+ *  Available hints:
+ *   - QFILE_MAP_SEQUENTIAL - the mapping is read from the start to the end.
+ *   - QFILE_MAP_WILLNEED - read in the whole mapping ahead of the access.
+ *   - QFILE_MAP_HUGEPAGE - ask for huge pages, where the system supports
+ *     them for file mappings. It's silently ignored otherwise.
+ */
+const void *qfile_map(const char *filepath, size_t *nbytes, int hints) {
+    static const char empty[1] = "";
+    if (filepath == NULL) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    int fd;
+    if ((fd = open(filepath, O_RDONLY, 0)) < 0)
+        return NULL;
+
+    struct stat fs;
+    if (fstat(fd, &fs) < 0) {
+        int errnobak = errno;
+        close(fd);
+        errno = errnobak;
+        return NULL;
+    }
+
+    size_t size = fs.st_size;
+    if (nbytes != NULL && *nbytes > 0 && *nbytes < size)
+        size = *nbytes;
+    if (size == 0) {
+        close(fd);
+        if (nbytes != NULL)
+            *nbytes = 0;
+        return empty;
+    }
+
+    void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    int errnobak = errno;
+    close(fd);
+    if (map == MAP_FAILED) {
+        errno = errnobak;
+        return NULL;
+    }
+
+    // the hints are only advisory, failures are not errors.
+    if (hints & QFILE_MAP_SEQUENTIAL)
+        madvise(map, size, MADV_SEQUENTIAL);
+    if (hints & QFILE_MAP_WILLNEED)
+        madvise(map, size, MADV_WILLNEED);
+#ifdef MADV_HUGEPAGE
+    if (hints & QFILE_MAP_HUGEPAGE)
+        madvise(map, size, MADV_HUGEPAGE);
+#endif
+
+    if (nbytes != NULL)
+        *nbytes = size;
+    return map;
+}
+
+/**
+ * Unmap a mapping made by qfile_map().
+ *
+ * @param map       pointer returned by qfile_map().
+ * @param nbytes    size returned by qfile_map().
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - errors of munmap().
+ */
+bool qfile_unmap(const void *map, size_t nbytes) {
+    if (map == NULL || nbytes == 0)
+        return true;
+    return (munmap((void *) map, nbytes) == 0);
+}
+
 /**
  * Save data into file.
  *
@@ -300,6 +406,48 @@ ssize_t qfile_save(const char *filepath, const void *buf, size_t size,
     return count;
 }
 
+/**
+ * Save data into file atomically.
+ *
+ * @param filepath  file path
+ * @param buf       data
+ * @param size      the number of bytes to save
+ * @param sync      true to flush the data to the disk before returning
+ *
+ * @return the number of bytes written if successful, otherwise returns -1.
+ * @retval errno will be set in error condition.
+ *  - ENOMEM : Memory allocation failure.
+ *  - errors of mkstemp(), write(), fdatasync() and rename().
+ *
+ * @code
+ *   char *conf = "port=8080\n";
+ *   qfile_save_atomic("/etc/app.conf", conf, strlen(conf), true);
+ * @endcode
+ *
+ * @note
+ *  The data is written into a temporary file next to the filepath which is
+ *  then renamed over it, so the readers see either the old or the new
+ *  contents as a whole, never a truncated file. With sync, the data is
+ *  fdatasync()ed before the rename and the directory is synced after it,
+ *  so the new contents survive a crash once this returns. The file takes a
+ *  new inode, hence it can't be used as an ftok() key file.
+ */
+ssize_t qfile_save_atomic(const char *filepath, const void *buf, size_t size,
+                          bool sync) {
+    char *tmppath;
+    int fd = _q_tmpfile_create(filepath, &tmppath);
+    if (fd < 0)
+        return -1;
+
+    ssize_t count = (size > 0) ? qio_write(fd, buf, size, -1) : 0;
+    if (_q_tmpfile_finish(fd, tmppath, filepath, (count == (ssize_t) size),
+                          sync) == false) {
+        return -1;
+    }
+
+    return count;
+}
+
 /**
  * Attempts to create a directory recursively.
  *
@@ -40,10 +40,125 @@
 #include <errno.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <pthread.h>
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#endif
+#if defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 #include "md5/md5.h"
 #include "qinternal.h"
 #include "utilities/qhash.h"
 
+#ifndef _DOXYGEN_SKIP
+
+/* state of the non-MD5 algorithms in qhash_t */
+typedef struct {
+    union {
+        uint32_t w[8];
+        uint64_t d[4];
+    } h;                /* running hash values */
+    uint64_t total;     /* bytes hashed so far */
+    uint8_t buf[64];    /* partial block, wyhash keeps the last 16 bytes at 48 */
+    bool stop;          /* FNV1 met a NUL byte */
+} hashstate_t;
+
+/* both states must fit in qhash_t */
+typedef char qhash_ctx_fits[(sizeof(hashstate_t) <= sizeof(((qhash_t *) 0)->ctx)
+                             && sizeof(MD5_CTX) <= sizeof(((qhash_t *) 0)->ctx))
+                            ? 1 : -1];
+
+static const uint64_t WYSECRET[4] = {
+    0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL,
+    0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL
+};
+
+static const uint32_t SHA256K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static void update_blocks(hashstate_t *st, const uint8_t *p, size_t nbytes,
+                          size_t bsize,
+                          void (*func)(hashstate_t *, const uint8_t *, size_t));
+static bool update_fd(qhash_t *ctx, int fd, off_t offset, size_t nbytes);
+
+static uint32_t murmur3_32_blocks(uint32_t h, const uint8_t *p,
+                                  size_t nblocks);
+static uint32_t murmur3_32_final(uint32_t h, const uint8_t *tail,
+                                 size_t nbytes);
+static void murmur3_128_blocks(uint64_t h[2], const uint8_t *p,
+                               size_t nblocks);
+static void murmur3_128_final(uint64_t h[2], const uint8_t *tail,
+                              size_t nbytes, void *retbuf);
+static void murmur3_32_stream(hashstate_t *st, const uint8_t *p,
+                              size_t nblocks);
+static void (*murmur3_32_multi_func)(const void *datas[],
+                                     const size_t nbytes[], size_t num,
+                                     uint32_t hashes[]);
+static void murmur3_32_multi_sw(const void *datas[], const size_t nbytes[],
+                                size_t num, uint32_t hashes[]);
+static void murmur3_32_multi_tail(const void *datas[], const size_t nbytes[],
+                                  size_t lanes, size_t nblocks, uint32_t *h,
+                                  uint32_t *k);
+static size_t murmur3_32_multi_blocks(const void *datas[],
+                                      const size_t nbytes[], size_t lanes);
+#if defined(__x86_64__) && defined(__GNUC__)
+static void murmur3_32_multi_avx2(const void *datas[], const size_t nbytes[],
+                                  size_t num, uint32_t hashes[]);
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+static void murmur3_32_multi_neon(const void *datas[], const size_t nbytes[],
+                                  size_t num, uint32_t hashes[]);
+#endif
+static void murmur3_128_stream(hashstate_t *st, const uint8_t *p,
+                               size_t nblocks);
+
+static void wyhash_update(hashstate_t *st, const uint8_t *p, size_t nbytes);
+static uint64_t wyhash_final(hashstate_t *st);
+static inline void wyhash_round(uint64_t s[3], const uint8_t *p);
+
+static void (*sha256_func)(uint32_t state[8], const uint8_t *p,
+                           size_t nblocks);
+static void sha256_stream(hashstate_t *st, const uint8_t *p, size_t nblocks);
+static void sha256_final(hashstate_t *st, uint8_t *digest);
+static void sha256_sw(uint32_t state[8], const uint8_t *p, size_t nblocks);
+#if defined(__x86_64__) && defined(__GNUC__)
+static void sha256_shani(uint32_t state[8], const uint8_t *p, size_t nblocks);
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_SHA2)
+static void sha256_armv8(uint32_t state[8], const uint8_t *p, size_t nblocks);
+#endif
+
+static inline uint64_t wyr8(const uint8_t *p);
+static inline uint64_t wyr4(const uint8_t *p);
+static inline void wymum(uint64_t *a, uint64_t *b);
+static inline uint64_t wymix(uint64_t a, uint64_t b);
+
+static uint32_t crc32c_table[256];
+static uint32_t (*crc32c_func)(uint32_t crc, const uint8_t *p, size_t nbytes);
+static void crc32c_init_table(void);
+static uint32_t crc32c_sw(uint32_t crc, const uint8_t *p, size_t nbytes);
+#if defined(__x86_64__) && defined(__GNUC__)
+static uint32_t crc32c_sse42(uint32_t crc, const uint8_t *p, size_t nbytes);
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+static uint32_t crc32c_armv8(uint32_t crc, const uint8_t *p, size_t nbytes);
+#endif
+
+#endif
+
 /**
  * Calculate 128-bit(16-bytes) MD5 hash.
  *
@@ -89,6 +204,9 @@ bool qhashmd5(const void *data, size_t nbytes, void *retbuf) {
  *
  * @return true if successful, otherwise false.
  *
+ * @note
+ *  The file is read by qhash_update_file().
+ *
  * @code
  *   unsigned char md5hash[16];
  *   qhashmd5_file("/tmp/test.dat", 0, 0, md5hash);
@@ -96,57 +214,50 @@ bool qhashmd5(const void *data, size_t nbytes, void *retbuf) {
  */
 bool qhashmd5_file(const char *filepath, off_t offset, ssize_t nbytes,
                    void *retbuf) {
-    if (filepath == NULL || offset < 0 || nbytes < 0 || retbuf == NULL) {
+    if (retbuf == NULL) {
         errno = EINVAL;
         return false;
     }
 
-    int fd = open(filepath, O_RDONLY, 0);
-    if (fd < 0)
+    qhash_t ctx;
+    qhash_init(&ctx, QHASH_MD5);
+    if (qhash_update_file(&ctx, filepath, offset, nbytes) == false)
         return false;
+    qhash_final(&ctx, retbuf);
 
-    struct stat st;
-    if (fstat(fd, &st) < 0)
-        return false;
-    size_t size = st.st_size;
+    return true;
+}
 
-    // check filesize
-    if (size < offset + nbytes) {
+/**
+ * Calculate 256-bit(32-bytes) SHA-256 hash.
+ *
+ * @param data      source object
+ * @param nbytes    size of data
+ * @param retbuf    user buffer. It must be at leat 32-bytes long.
+ *
+ * @return true if successful, otherwise false.
+ *
+ * @code
+ *   unsigned char sha[32];
+ *   qhashsha256((void*)"abc", 3, sha);  // ba7816bf8f01cfea...
+ * @endcode
+ *
+ * @note
+ *  The SHA extensions of x86 are used when the running CPU supports them,
+ *  which is detected at the first call. On ARMv8, the SHA2 instructions are
+ *  used when the library is built with them enabled. Otherwise a portable
+ *  implementation is used.
+ */
+bool qhashsha256(const void *data, size_t nbytes, void *retbuf) {
+    if (data == NULL || retbuf == NULL) {
         errno = EINVAL;
-        close(fd);
         return false;
     }
 
-    // if requested to digest until the end of file, set nbytes to the remaining size
-    if (nbytes == 0) {
-        nbytes = size - offset;
-    }
-
-    // move the seek pointer to the beginning of the offset
-    if (offset > 0) {
-        if (lseek(fd, offset, SEEK_SET) != offset) {
-            close(fd);
-            return false;
-        }
-    }
-
-    MD5_CTX context;
-    MD5Init(&context);
-    ssize_t toread, nread;
-    unsigned char buf[32 * 1024];
-    for (toread = nbytes; toread > 0; toread -= nread) {
-        if (toread > sizeof(buf))
-            nread = read(fd, buf, sizeof(buf));
-        else
-            nread = read(fd, buf, toread);
-        if (nread < 0)
-            break;
-        MD5Update(&context, buf, nread);
-    }
-    close(fd);
-    if (toread != 0)
-        return false;
-    MD5Final(retbuf, &context);
+    qhash_t ctx;
+    qhash_init(&ctx, QHASH_SHA256);
+    qhash_update(&ctx, data, nbytes);
+    qhash_final(&ctx, retbuf);
 
     return true;
 }
@@ -264,19 +375,645 @@ uint32_t qhashmurmur3_32(const void *data, size_t nbytes) {
     if (data == NULL || nbytes == 0)
         return 0;
 
-    const uint32_t c1 = 0xcc9e2d51;
-    const uint32_t c2 = 0x1b873593;
+    const uint8_t *p = (const uint8_t *) data;
+    size_t nblocks = nbytes / 4;
+    uint32_t h = murmur3_32_blocks(0, p, nblocks);
+    return murmur3_32_final(h, p + nblocks * 4, nbytes);
+}
 
-    const int nblocks = nbytes / 4;
-    const uint32_t *blocks = (const uint32_t *) (data);
-    const uint8_t *tail = (const uint8_t *) (data + (nblocks * 4));
+/**
+ * Get 32-bit Murmur3 hashes of multiple keys at once.
+ *
+ * @param datas     array of source data. A NULL entry gets 0.
+ * @param nbytes    array of data sizes.
+ * @param num       number of keys.
+ * @param hashes    array to store the hashes, at least num long.
+ *
+ * @return true if successful, otherwise false.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *
+ * @note
+ *  Each hash is the same as qhashmurmur3_32() of the key. With AVX2 or
+ *  NEON, 8 or 4 keys are hashed in the lanes of a vector register, which
+ *  makes bulk operations on many short keys faster than one by one.
+ *
+ * @code
+ *  const void *keys[] = { "key1", "key2", "key3" };
+ *  size_t sizes[] = { 4, 4, 4 };
+ *  uint32_t hashes[3];
+ *  qhashmurmur3_32_multi(keys, sizes, 3, hashes);
+ * @endcode
+ */
+bool qhashmurmur3_32_multi(const void *datas[], const size_t nbytes[],
+                           size_t num, uint32_t hashes[]) {
+    if (datas == NULL || nbytes == NULL || hashes == NULL) {
+        errno = EINVAL;
+        return false;
+    }
 
-    uint32_t h = 0;
+    void (*func)(const void **, const size_t *, size_t, uint32_t *);
+    func = __atomic_load_n(&murmur3_32_multi_func, __ATOMIC_RELAXED);
+    if (func == NULL) {
+        func = murmur3_32_multi_sw;
+#if defined(__x86_64__) && defined(__GNUC__)
+        if (__builtin_cpu_supports("avx2"))
+            func = murmur3_32_multi_avx2;
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+        func = murmur3_32_multi_neon;
+#endif
+        __atomic_store_n(&murmur3_32_multi_func, func, __ATOMIC_RELAXED);
+    }
 
-    int i;
+    func(datas, nbytes, num, hashes);
+    return true;
+}
+
+/**
+ * Get 128-bit Murmur3 hash.
+ *
+ * @param data      source data
+ * @param nbytes    size of data
+ * @param retbuf    user buffer. It must be at leat 16-bytes long.
+ *
+ * @return true if successful, otherwise false.
+ *
+ * @code
+ *   // get 128-bit Murmur3 hash.
+ *   unsigned char hash[16];
+ *   qhashmurmur3_128((void*)"hello", 5, hash);
+ *
+ *   // hex encode
+ *   char *ascii = qhex_encode(hash, 16);
+ *   printf("Hex encoded Murmur3: %s\n", ascii);
+ *   free(ascii);
+ * @endcode
+ */
+bool qhashmurmur3_128(const void *data, size_t nbytes, void *retbuf) {
+    if (data == NULL || nbytes == 0)
+        return false;
+
+    const uint8_t *p = (const uint8_t *) data;
+    size_t nblocks = nbytes / 16;
+    uint64_t h[2] = { 0, 0 };
+    murmur3_128_blocks(h, p, nblocks);
+    murmur3_128_final(h, p + nblocks * 16, nbytes, retbuf);
+
+    return true;
+}
+
+/**
+ * Get 64-bit wyhash hash.
+ *
+ * @param data      source data
+ * @param nbytes    size of data
+ *
+ * @return 64-bit unsigned hash value.
+ *
+ * @code
+ *  uint64_t hashval = qhashwyhash_64((void*)"hello", 5);
+ * @endcode
+ *
+ * @code
+ *  wyhash was created by Wang Yi and released into the public domain.
+ *    https://github.com/wangyi-fudan/wyhash
+ *  This is a port of its final version 4 with the default secret and
+ *  zero seed. It consumes 16 to 48 bytes per round using 64x64->128 bit
+ *  multiplications, which makes it several times faster than Murmur3 for
+ *  medium and long keys.
+ * @endcode
+ */
+uint64_t qhashwyhash_64(const void *data, size_t nbytes) {
+    if (data == NULL)
+        return 0;
+
+    const uint8_t *p = (const uint8_t *) data;
+    uint64_t seed = wymix(WYSECRET[0], WYSECRET[1]);
+    uint64_t a, b;
+    if (nbytes <= 16) {
+        if (nbytes >= 4) {
+            a = (wyr4(p) << 32) | wyr4(p + ((nbytes >> 3) << 2));
+            b = (wyr4(p + nbytes - 4) << 32)
+                | wyr4(p + nbytes - 4 - ((nbytes >> 3) << 2));
+        } else if (nbytes > 0) {
+            a = ((uint64_t) p[0] << 16) | ((uint64_t) p[nbytes >> 1] << 8)
+                | p[nbytes - 1];
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = nbytes;
+        if (i > 48) {
+            uint64_t see1 = seed, see2 = seed;
+            do {
+                seed = wymix(wyr8(p) ^ WYSECRET[1], wyr8(p + 8) ^ seed);
+                see1 = wymix(wyr8(p + 16) ^ WYSECRET[2], wyr8(p + 24) ^ see1);
+                see2 = wymix(wyr8(p + 32) ^ WYSECRET[3], wyr8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while (i > 16) {
+            seed = wymix(wyr8(p) ^ WYSECRET[1], wyr8(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        a = wyr8(p + i - 16);
+        b = wyr8(p + i - 8);
+    }
+
+    a ^= WYSECRET[1];
+    b ^= seed;
+    wymum(&a, &b);
+    return wymix(a ^ WYSECRET[0] ^ nbytes, b ^ WYSECRET[1]);
+}
+
+/**
+ * Get 32-bit wyhash hash.
+ *
+ * @param data      source data
+ * @param nbytes    size of data
+ *
+ * @return 32-bit unsigned hash value.
+ *
+ * @note
+ *  It folds the result of qhashwyhash_64(), so it can be given to the
+ *  hash table containers as a faster alternative to qhashmurmur3_32().
+ *
+ * @code
+ *  qhashtbl_t *tbl = qhashtbl(0, 0);
+ *  tbl->set_hash(tbl, qhashwyhash_32);
+ * @endcode
+ */
+uint32_t qhashwyhash_32(const void *data, size_t nbytes) {
+    uint64_t h = qhashwyhash_64(data, nbytes);
+    return (uint32_t) (h ^ (h >> 32));
+}
+
+/**
+ * Get 32-bit CRC32C(Castagnoli) checksum.
+ *
+ * @param data      source data
+ * @param nbytes    size of data
+ *
+ * @return 32-bit unsigned CRC32C value.
+ *
+ * @code
+ *  uint32_t crc = qhashcrc32c((void*)"123456789", 9);  // 0xe3069283
+ * @endcode
+ *
+ * @note
+ *  The CRC32 instruction of SSE4.2 is used when the running CPU supports
+ *  it, which is detected at the first call. On ARMv8, the CRC instructions
+ *  are used when the library is built with them enabled. Otherwise a table
+ *  driven implementation is used. All of them return the same values.
+ */
+uint32_t qhashcrc32c(const void *data, size_t nbytes) {
+    return qhashcrc32c_update(0, data, nbytes);
+}
+
+/**
+ * Continue a CRC32C(Castagnoli) checksum over the next block of data.
+ *
+ * @param crc       checksum of the previous blocks, 0 for the first block.
+ * @param data      source data
+ * @param nbytes    size of data
+ *
+ * @return 32-bit unsigned CRC32C value of all the blocks so far.
+ *
+ * @code
+ *  uint32_t crc = qhashcrc32c_update(0, (void*)"1234", 4);
+ *  crc = qhashcrc32c_update(crc, (void*)"56789", 5);  // 0xe3069283
+ * @endcode
+ */
+uint32_t qhashcrc32c_update(uint32_t crc, const void *data, size_t nbytes) {
+    if (data == NULL)
+        return crc;
+
+    uint32_t (*func)(uint32_t, const uint8_t *, size_t);
+    func = __atomic_load_n(&crc32c_func, __ATOMIC_RELAXED);
+    if (func == NULL) {
+        func = crc32c_sw;
+#if defined(__x86_64__) && defined(__GNUC__)
+        if (__builtin_cpu_supports("sse4.2"))
+            func = crc32c_sse42;
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+        func = crc32c_armv8;
+#endif
+        __atomic_store_n(&crc32c_func, func, __ATOMIC_RELAXED);
+    }
+
+    return ~func(~crc, (const uint8_t *) data, nbytes);
+}
+
+/**
+ * Initialize a streaming hash.
+ *
+ * The data can be hashed chunk by chunk with constant memory, which gives
+ * the same value as the one-shot function of the algorithm over the whole
+ * data.
+ *
+ * @param ctx       qhash_t structure pointer to initialize.
+ * @param type      one of QHASH_MD5, QHASH_SHA256, QHASH_CRC32C,
+ *                  QHASH_FNV1_32, QHASH_FNV1_64, QHASH_MURMUR3_32,
+ *                  QHASH_MURMUR3_128 and QHASH_WYHASH_64.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *
+ * @code
+ *   qhash_t ctx;
+ *   qhash_init(&ctx, QHASH_SHA256);
+ *
+ *   char buf[4096];
+ *   ssize_t n;
+ *   while ((n = qio_read(fd, buf, sizeof(buf), -1)) > 0) {
+ *     qhash_update(&ctx, buf, n);
+ *   }
+ *
+ *   unsigned char sha[32];
+ *   qhash_final(&ctx, sha);
+ * @endcode
+ */
+bool qhash_init(qhash_t *ctx, int type) {
+    if (ctx == NULL || qhash_digestsize(type) == 0) {
+        errno = EINVAL;
+        return false;
+    }
+
+    memset((void *) ctx, 0, sizeof(qhash_t));
+    ctx->type = type;
+
+    hashstate_t *st = (hashstate_t *) ctx->ctx;
+    switch (type) {
+        case QHASH_MD5:
+            MD5Init((MD5_CTX *) ctx->ctx);
+            break;
+        case QHASH_SHA256: {
+            static const uint32_t iv[8] = {
+                0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+            };
+            memcpy(st->h.w, iv, sizeof(iv));
+            break;
+        }
+        case QHASH_FNV1_32:
+            st->h.w[0] = 0x811C9DC5;
+            break;
+        case QHASH_FNV1_64:
+            st->h.d[0] = 0xCBF29CE484222325ULL;
+            break;
+        case QHASH_WYHASH_64:
+            st->h.d[0] = wymix(WYSECRET[0], WYSECRET[1]);
+            st->h.d[1] = st->h.d[2] = st->h.d[0];
+            break;
+    }
+
+    return true;
+}
+
+/**
+ * Hash the next chunk of data.
+ *
+ * @param ctx       qhash_t structure pointer.
+ * @param data      source data
+ * @param nbytes    size of data
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *
+ * @note
+ *  Like qhashfnv1_32() and qhashfnv1_64(), the FNV1 types stop at the
+ *  first NUL byte and ignore the rest of the data.
+ */
+bool qhash_update(qhash_t *ctx, const void *data, size_t nbytes) {
+    if (ctx == NULL || (data == NULL && nbytes > 0)) {
+        errno = EINVAL;
+        return false;
+    }
+
+    const uint8_t *p = (const uint8_t *) data;
+    hashstate_t *st = (hashstate_t *) ctx->ctx;
+    switch (ctx->type) {
+        case QHASH_MD5: {
+            // MD5Update() takes an unsigned int size.
+            while (nbytes > 0) {
+                unsigned int n = (nbytes < 0x40000000) ? nbytes : 0x40000000;
+                MD5Update((MD5_CTX *) ctx->ctx, p, n);
+                p += n;
+                nbytes -= n;
+            }
+            break;
+        }
+        case QHASH_SHA256:
+            update_blocks(st, p, nbytes, 64, sha256_stream);
+            break;
+        case QHASH_CRC32C:
+            st->h.w[0] = qhashcrc32c_update(st->h.w[0], p, nbytes);
+            break;
+        case QHASH_FNV1_32: {
+            uint32_t h = st->h.w[0];
+            st->total += nbytes;
+            for (; st->stop == false && nbytes > 0; p++, nbytes--) {
+                if (*p == '\0') {
+                    st->stop = true;
+                    break;
+                }
+                h *= 0x01000193;
+                h ^= *p;
+            }
+            st->h.w[0] = h;
+            break;
+        }
+        case QHASH_FNV1_64: {
+            uint64_t h = st->h.d[0];
+            st->total += nbytes;
+            for (; st->stop == false && nbytes > 0; p++, nbytes--) {
+                if (*p == '\0') {
+                    st->stop = true;
+                    break;
+                }
+                h *= 0x100000001B3ULL;
+                h ^= *p;
+            }
+            st->h.d[0] = h;
+            break;
+        }
+        case QHASH_MURMUR3_32:
+            update_blocks(st, p, nbytes, 4, murmur3_32_stream);
+            break;
+        case QHASH_MURMUR3_128:
+            update_blocks(st, p, nbytes, 16, murmur3_128_stream);
+            break;
+        case QHASH_WYHASH_64:
+            wyhash_update(st, p, nbytes);
+            break;
+        default:
+            errno = EINVAL;
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * Hash the contents of a file.
+ *
+ * @param ctx       qhash_t structure pointer.
+ * @param filepath  file path
+ * @param offset    start offset. Set to 0 to digest from beginning of file.
+ * @param nbytes    number of bytes to digest. Set to 0 to digest until end
+ *                  of file.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument or the range is beyond the end of file.
+ *
+ * @note
+ *  The file is mapped QHASH_MMAP_WINDOW bytes at a time and hashed from
+ *  the page cache without copying. If it can't be mapped, it's read in
+ *  page aligned chunks of QHASH_READ_BUFSIZE bytes. Truncating the file
+ *  while it's being hashed can raise SIGBUS.
+ *
+ * @code
+ *   qhash_t ctx;
+ *   unsigned char sha[32];
+ *   qhash_init(&ctx, QHASH_SHA256);
+ *   qhash_update_file(&ctx, "/tmp/test.dat", 0, 0);
+ *   qhash_final(&ctx, sha);
+ * @endcode
+ */
+bool qhash_update_file(qhash_t *ctx, const char *filepath, off_t offset,
+                       ssize_t nbytes) {
+    if (ctx == NULL || filepath == NULL || offset < 0 || nbytes < 0) {
+        errno = EINVAL;
+        return false;
+    }
+
+    int fd = open(filepath, O_RDONLY, 0);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return false;
+    }
+
+    // check filesize
+    if (st.st_size < offset + nbytes) {
+        errno = EINVAL;
+        close(fd);
+        return false;
+    }
+
+    // if requested to digest until the end of file, set nbytes to the remaining size
+    if (nbytes == 0) {
+        nbytes = st.st_size - offset;
+    }
+
+    bool ret = update_fd(ctx, fd, offset, nbytes);
+    int errsv = errno;
+    close(fd);
+    errno = errsv;
+
+    return ret;
+}
+
+/**
+ * Finish a streaming hash.
+ *
+ * @param ctx       qhash_t structure pointer.
+ * @param retbuf    user buffer. It must be at least qhash_digestsize() long.
+ *                  The 32 and 64-bit types store a uint32_t or uint64_t
+ *                  value in host byte order.
+ *
+ * @return the number of bytes stored in retbuf, otherwise returns 0.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *
+ * @note
+ *  The context is initialized again for the same type, so it can be
+ *  reused right away.
+ *
+ * @code
+ *   uint64_t hash;
+ *   qhash_init(&ctx, QHASH_WYHASH_64);
+ *   qhash_update(&ctx, "hello ", 6);
+ *   qhash_update(&ctx, "world", 5);
+ *   qhash_final(&ctx, &hash);  // same as qhashwyhash_64("hello world", 11)
+ * @endcode
+ */
+size_t qhash_final(qhash_t *ctx, void *retbuf) {
+    if (ctx == NULL || retbuf == NULL) {
+        errno = EINVAL;
+        return 0;
+    }
+
+    size_t size = qhash_digestsize(ctx->type);
+    if (size == 0) {
+        errno = EINVAL;
+        return 0;
+    }
+
+    hashstate_t *st = (hashstate_t *) ctx->ctx;
+    uint32_t h32;
+    uint64_t h64;
+    switch (ctx->type) {
+        case QHASH_MD5:
+            MD5Final(retbuf, (MD5_CTX *) ctx->ctx);
+            break;
+        case QHASH_SHA256:
+            sha256_final(st, retbuf);
+            break;
+        case QHASH_CRC32C:
+            memcpy(retbuf, &st->h.w[0], sizeof(uint32_t));
+            break;
+        case QHASH_FNV1_32:
+            h32 = (st->total > 0) ? st->h.w[0] : 0;
+            memcpy(retbuf, &h32, sizeof(h32));
+            break;
+        case QHASH_FNV1_64:
+            h64 = (st->total > 0) ? st->h.d[0] : 0;
+            memcpy(retbuf, &h64, sizeof(h64));
+            break;
+        case QHASH_MURMUR3_32:
+            h32 = murmur3_32_final(st->h.w[0], st->buf, st->total);
+            memcpy(retbuf, &h32, sizeof(h32));
+            break;
+        case QHASH_MURMUR3_128:
+            murmur3_128_final(st->h.d, st->buf, st->total, retbuf);
+            break;
+        case QHASH_WYHASH_64:
+            h64 = wyhash_final(st);
+            memcpy(retbuf, &h64, sizeof(h64));
+            break;
+    }
+
+    qhash_init(ctx, ctx->type);
+    return size;
+}
+
+/**
+ * Get the digest size of a hash type.
+ *
+ * @param type      QHASH_* type
+ *
+ * @return the number of bytes qhash_final() stores, or 0 for an unknown
+ *         type.
+ */
+size_t qhash_digestsize(int type) {
+    switch (type) {
+        case QHASH_MD5:
+        case QHASH_MURMUR3_128:
+            return 16;
+        case QHASH_SHA256:
+            return 32;
+        case QHASH_CRC32C:
+        case QHASH_FNV1_32:
+        case QHASH_MURMUR3_32:
+            return 4;
+        case QHASH_FNV1_64:
+        case QHASH_WYHASH_64:
+            return 8;
+    }
+    return 0;
+}
+
+#ifndef _DOXYGEN_SKIP
+
+#define SHA256_ROR(x, n)    (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void update_blocks(hashstate_t *st, const uint8_t *p, size_t nbytes,
+                          size_t bsize,
+                          void (*func)(hashstate_t *, const uint8_t *, size_t)) {
+    size_t len = st->total % bsize;
+    st->total += nbytes;
+
+    // complete the partial block first
+    if (len > 0) {
+        size_t n = bsize - len;
+        if (nbytes < n) {
+            memcpy(st->buf + len, p, nbytes);
+            return;
+        }
+        memcpy(st->buf + len, p, n);
+        func(st, st->buf, 1);
+        p += n;
+        nbytes -= n;
+    }
+
+    // then the whole blocks in place
+    if (nbytes >= bsize) {
+        func(st, p, nbytes / bsize);
+        p += nbytes / bsize * bsize;
+        nbytes %= bsize;
+    }
+    memcpy(st->buf, p, nbytes);
+}
+
+static bool update_fd(qhash_t *ctx, int fd, off_t offset, size_t nbytes) {
+    long pagesize = sysconf(_SC_PAGESIZE);
+
+    // map window by window and hash the page cache in place.
+    while (nbytes > 0) {
+        off_t mapoff = offset - offset % pagesize;
+        size_t skip = offset - mapoff;
+        size_t len = (nbytes < QHASH_MMAP_WINDOW) ? nbytes : QHASH_MMAP_WINDOW;
+        void *map = mmap(NULL, skip + len, PROT_READ, MAP_PRIVATE, fd, mapoff);
+        if (map == MAP_FAILED)
+            break;
+        madvise(map, skip + len, MADV_SEQUENTIAL);
+        qhash_update(ctx, (uint8_t *) map + skip, len);
+        munmap(map, skip + len);
+        offset += len;
+        nbytes -= len;
+    }
+    if (nbytes == 0)
+        return true;
+
+    // not mappable, read the rest in large aligned chunks.
+    if (lseek(fd, offset, SEEK_SET) != offset)
+        return false;
+    posix_fadvise(fd, offset, nbytes, POSIX_FADV_SEQUENTIAL);
+
+    void *buf;
+    if (posix_memalign(&buf, pagesize, QHASH_READ_BUFSIZE) != 0) {
+        errno = ENOMEM;
+        return false;
+    }
+    while (nbytes > 0) {
+        size_t toread = (nbytes < QHASH_READ_BUFSIZE) ? nbytes
+                                                      : QHASH_READ_BUFSIZE;
+        ssize_t nread = read(fd, buf, toread);
+        if (nread < 0 && errno == EINTR)
+            continue;
+        if (nread <= 0) {
+            if (nread == 0)
+                errno = EINVAL;  // the file got shorter
+            break;
+        }
+        qhash_update(ctx, buf, nread);
+        nbytes -= nread;
+    }
+    free(buf);
+
+    return (nbytes == 0);
+}
+
+static uint32_t murmur3_32_blocks(uint32_t h, const uint8_t *p,
+                                  size_t nblocks) {
+    const uint32_t c1 = 0xcc9e2d51;
+    const uint32_t c2 = 0x1b873593;
+
+    size_t i;
     uint32_t k;
     for (i = 0; i < nblocks; i++) {
-        k = blocks[i];
+        memcpy(&k, p + i * 4, sizeof(k));  // blocks may not be aligned
 
         k *= c1;
         k = (k << 15) | (k >> (32 - 15));
@@ -287,7 +1024,15 @@ uint32_t qhashmurmur3_32(const void *data, size_t nbytes) {
         h = (h * 5) + 0xe6546b64;
     }
 
-    k = 0;
+    return h;
+}
+
+static uint32_t murmur3_32_final(uint32_t h, const uint8_t *tail,
+                                 size_t nbytes) {
+    const uint32_t c1 = 0xcc9e2d51;
+    const uint32_t c2 = 0x1b873593;
+
+    uint32_t k = 0;
     switch (nbytes & 3) {
         case 3:
             k ^= tail[2] << 16;
@@ -312,45 +1057,19 @@ uint32_t qhashmurmur3_32(const void *data, size_t nbytes) {
     return h;
 }
 
-/**
- * Get 128-bit Murmur3 hash.
- *
- * @param data      source data
- * @param nbytes    size of data
- * @param retbuf    user buffer. It must be at leat 16-bytes long.
- *
- * @return true if successful, otherwise false.
- *
- * @code
- *   // get 128-bit Murmur3 hash.
- *   unsigned char hash[16];
- *   qhashmurmur3_128((void*)"hello", 5, hash);
- *
- *   // hex encode
- *   char *ascii = qhex_encode(hash, 16);
- *   printf("Hex encoded Murmur3: %s\n", ascii);
- *   free(ascii);
- * @endcode
- */
-bool qhashmurmur3_128(const void *data, size_t nbytes, void *retbuf) {
-    if (data == NULL || nbytes == 0)
-        return false;
-
+static void murmur3_128_blocks(uint64_t h[2], const uint8_t *p,
+                               size_t nblocks) {
     const uint64_t c1 = 0x87c37b91114253d5ULL;
     const uint64_t c2 = 0x4cf5ad432745937fULL;
 
-    const int nblocks = nbytes / 16;
-    const uint64_t *blocks = (const uint64_t *) (data);
-    const uint8_t *tail = (const uint8_t *) (data + (nblocks * 16));
-
-    uint64_t h1 = 0;
-    uint64_t h2 = 0;
+    uint64_t h1 = h[0];
+    uint64_t h2 = h[1];
 
-    int i;
+    size_t i;
     uint64_t k1, k2;
     for (i = 0; i < nblocks; i++) {
-        k1 = blocks[i * 2 + 0];
-        k2 = blocks[i * 2 + 1];
+        memcpy(&k1, p + i * 16, sizeof(k1));  // blocks may not be aligned
+        memcpy(&k2, p + i * 16 + 8, sizeof(k2));
 
         k1 *= c1;
         k1 = (k1 << 31) | (k1 >> (64 - 31));
@@ -371,7 +1090,19 @@ bool qhashmurmur3_128(const void *data, size_t nbytes, void *retbuf) {
         h2 = h2 * 5 + 0x38495ab5;
     }
 
-    k1 = k2 = 0;
+    h[0] = h1;
+    h[1] = h2;
+}
+
+static void murmur3_128_final(uint64_t h[2], const uint8_t *tail,
+                              size_t nbytes, void *retbuf) {
+    const uint64_t c1 = 0x87c37b91114253d5ULL;
+    const uint64_t c2 = 0x4cf5ad432745937fULL;
+
+    uint64_t h1 = h[0];
+    uint64_t h2 = h[1];
+
+    uint64_t k1 = 0, k2 = 0;
     switch (nbytes & 15) {
         case 15:
             k2 ^= (uint64_t)(tail[14]) << 48;
@@ -438,8 +1169,472 @@ bool qhashmurmur3_128(const void *data, size_t nbytes, void *retbuf) {
     h1 += h2;
     h2 += h1;
 
-    ((uint64_t *) retbuf)[0] = h1;
-    ((uint64_t *) retbuf)[1] = h2;
+    memcpy(retbuf, &h1, sizeof(h1));
+    memcpy((uint8_t *) retbuf + 8, &h2, sizeof(h2));
+}
 
-    return true;
+static void murmur3_32_stream(hashstate_t *st, const uint8_t *p,
+                              size_t nblocks) {
+    st->h.w[0] = murmur3_32_blocks(st->h.w[0], p, nblocks);
+}
+
+static void murmur3_32_multi_sw(const void *datas[], const size_t nbytes[],
+                                size_t num, uint32_t hashes[]) {
+    size_t i;
+    for (i = 0; i < num; i++) {
+        hashes[i] = qhashmurmur3_32(datas[i], nbytes[i]);
+    }
+}
+
+// hash the blocks beyond the common ones lane by lane and load the tails,
+// a missing tail is 0 which leaves the hash as is.
+static void murmur3_32_multi_tail(const void *datas[], const size_t nbytes[],
+                                  size_t lanes, size_t nblocks, uint32_t *h,
+                                  uint32_t *k) {
+    size_t l;
+    for (l = 0; l < lanes; l++) {
+        const uint8_t *p = (const uint8_t *) datas[l];
+        size_t len = (p != NULL) ? nbytes[l] : 0;
+        size_t n = len / 4;
+        if (n > nblocks)
+            h[l] = murmur3_32_blocks(h[l], p + nblocks * 4, n - nblocks);
+        if (len >= 4) {
+            k[l] = (uint32_t) (wyr4(p + len - 4) >> (8 * (4 - (len & 3))));
+        } else {
+            k[l] = 0;
+            switch (len) {
+                case 3:
+                    k[l] ^= p[2] << 16;
+                case 2:
+                    k[l] ^= p[1] << 8;
+                case 1:
+                    k[l] ^= p[0];
+            }
+        }
+    }
+}
+
+// blocks every lane has
+static size_t murmur3_32_multi_blocks(const void *datas[],
+                                      const size_t nbytes[], size_t lanes) {
+    size_t nblocks = SIZE_MAX;
+    size_t l;
+    for (l = 0; l < lanes; l++) {
+        size_t n = (datas[l] != NULL) ? nbytes[l] / 4 : 0;
+        if (n < nblocks)
+            nblocks = n;
+    }
+    return nblocks;
+}
+
+static void murmur3_128_stream(hashstate_t *st, const uint8_t *p,
+                               size_t nblocks) {
+    murmur3_128_blocks(st->h.d, p, nblocks);
+}
+
+// wyhash takes a 48 bytes round only if more data follows, so up to 48
+// bytes are kept in buf and the last 16 bytes of the data at buf + 48.
+static void wyhash_update(hashstate_t *st, const uint8_t *p, size_t nbytes) {
+    const uint8_t *end = p + nbytes;
+    size_t len = (st->total <= 48) ? st->total : (st->total - 1) % 48 + 1;
+    size_t n = nbytes;
+    uint64_t *s = st->h.d;
+    st->total += nbytes;
+
+    if (len > 0 && n > 0) {
+        size_t fill = (n < 48 - len) ? n : 48 - len;
+        memcpy(st->buf + len, p, fill);
+        p += fill;
+        n -= fill;
+        len += fill;
+        if (n > 0) {
+            wyhash_round(s, st->buf);
+            len = 0;
+        }
+    }
+    if (len == 0) {
+        for (; n > 48; p += 48, n -= 48) {
+            wyhash_round(s, p);
+        }
+        memcpy(st->buf, p, n);
+    }
+
+    if (nbytes >= 16) {
+        memcpy(st->buf + 48, end - 16, 16);
+    } else if (nbytes > 0) {
+        memmove(st->buf + 48, st->buf + 48 + nbytes, 16 - nbytes);
+        memcpy(st->buf + 64 - nbytes, end - nbytes, nbytes);
+    }
 }
+
+static uint64_t wyhash_final(hashstate_t *st) {
+    if (st->total <= 48)
+        return qhashwyhash_64(st->buf, st->total);
+
+    uint64_t seed = st->h.d[0] ^ st->h.d[1] ^ st->h.d[2];
+    const uint8_t *p = st->buf;
+    size_t i;
+    for (i = (st->total - 1) % 48 + 1; i > 16; i -= 16, p += 16) {
+        seed = wymix(wyr8(p) ^ WYSECRET[1], wyr8(p + 8) ^ seed);
+    }
+
+    uint64_t a = wyr8(st->buf + 48) ^ WYSECRET[1];
+    uint64_t b = wyr8(st->buf + 56) ^ seed;
+    wymum(&a, &b);
+    return wymix(a ^ WYSECRET[0] ^ st->total, b ^ WYSECRET[1]);
+}
+
+static void sha256_stream(hashstate_t *st, const uint8_t *p, size_t nblocks) {
+    void (*func)(uint32_t *, const uint8_t *, size_t);
+    func = __atomic_load_n(&sha256_func, __ATOMIC_RELAXED);
+    if (func == NULL) {
+        func = sha256_sw;
+#if defined(__x86_64__) && defined(__GNUC__)
+        if (__builtin_cpu_supports("sha") && __builtin_cpu_supports("sse4.1"))
+            func = sha256_shani;
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_SHA2)
+        func = sha256_armv8;
+#endif
+        __atomic_store_n(&sha256_func, func, __ATOMIC_RELAXED);
+    }
+
+    func(st->h.w, p, nblocks);
+}
+
+static void sha256_final(hashstate_t *st, uint8_t *digest) {
+    uint64_t bits = st->total * 8;
+    size_t len = st->total % 64;
+    int i;
+
+    st->buf[len++] = 0x80;
+    if (len > 56) {
+        memset(st->buf + len, 0, 64 - len);
+        sha256_stream(st, st->buf, 1);
+        len = 0;
+    }
+    memset(st->buf + len, 0, 56 - len);
+    for (i = 0; i < 8; i++) {
+        st->buf[56 + i] = (uint8_t) (bits >> (56 - i * 8));
+    }
+    sha256_stream(st, st->buf, 1);
+
+    for (i = 0; i < 8; i++) {
+        digest[i * 4 + 0] = (uint8_t) (st->h.w[i] >> 24);
+        digest[i * 4 + 1] = (uint8_t) (st->h.w[i] >> 16);
+        digest[i * 4 + 2] = (uint8_t) (st->h.w[i] >> 8);
+        digest[i * 4 + 3] = (uint8_t) st->h.w[i];
+    }
+}
+
+static void sha256_sw(uint32_t state[8], const uint8_t *p, size_t nblocks) {
+    uint32_t w[64];
+    int i;
+
+    for (; nblocks > 0; nblocks--, p += 64) {
+        for (i = 0; i < 16; i++) {
+            w[i] = ((uint32_t) p[i * 4] << 24) | ((uint32_t) p[i * 4 + 1] << 16)
+                   | ((uint32_t) p[i * 4 + 2] << 8) | p[i * 4 + 3];
+        }
+        for (i = 16; i < 64; i++) {
+            uint32_t s0 = SHA256_ROR(w[i - 15], 7) ^ SHA256_ROR(w[i - 15], 18)
+                          ^ (w[i - 15] >> 3);
+            uint32_t s1 = SHA256_ROR(w[i - 2], 17) ^ SHA256_ROR(w[i - 2], 19)
+                          ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (i = 0; i < 64; i++) {
+            uint32_t t1 = h + (SHA256_ROR(e, 6) ^ SHA256_ROR(e, 11)
+                               ^ SHA256_ROR(e, 25))
+                          + ((e & f) ^ (~e & g)) + SHA256K[i] + w[i];
+            uint32_t t2 = (SHA256_ROR(a, 2) ^ SHA256_ROR(a, 13)
+                           ^ SHA256_ROR(a, 22))
+                          + ((a & b) ^ (a & c) ^ (b & c));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+// 4 rounds per step with the message schedule of the next steps interleaved.
+__attribute__((target("sha,sse4.1")))
+static void sha256_shani(uint32_t state[8], const uint8_t *p, size_t nblocks) {
+    const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+                                        0x0405060700010203ULL);
+    __m128i s0, s1, tmp, msg, m[4];
+
+    // ABCD, EFGH to ABEF, CDGH
+    tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) &state[0]), 0xB1);
+    s1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) &state[4]), 0x1B);
+    s0 = _mm_alignr_epi8(tmp, s1, 8);
+    s1 = _mm_blend_epi16(s1, tmp, 0xF0);
+
+    for (; nblocks > 0; nblocks--, p += 64) {
+        __m128i abef = s0, cdgh = s1;
+        int i;
+#pragma GCC unroll 16
+        for (i = 0; i < 16; i++) {
+            __m128i *cur = &m[i & 3], *prev = &m[(i - 1) & 3];
+            if (i < 4) {
+                *cur = _mm_shuffle_epi8(
+                        _mm_loadu_si128((const __m128i *) (p + i * 16)), mask);
+            }
+            msg = _mm_add_epi32(*cur,
+                                _mm_loadu_si128((const __m128i *) &SHA256K[i * 4]));
+            s1 = _mm_sha256rnds2_epu32(s1, s0, msg);
+            if (i >= 3 && i < 15) {
+                __m128i *next = &m[(i + 1) & 3];
+                tmp = _mm_alignr_epi8(*cur, *prev, 4);
+                *next = _mm_sha256msg2_epu32(_mm_add_epi32(*next, tmp), *cur);
+            }
+            msg = _mm_shuffle_epi32(msg, 0x0E);
+            s0 = _mm_sha256rnds2_epu32(s0, s1, msg);
+            if (i >= 1 && i < 13) {
+                *prev = _mm_sha256msg1_epu32(*prev, *cur);
+            }
+        }
+        s0 = _mm_add_epi32(s0, abef);
+        s1 = _mm_add_epi32(s1, cdgh);
+    }
+
+    // ABEF, CDGH back to ABCD, EFGH
+    tmp = _mm_shuffle_epi32(s0, 0x1B);
+    s1 = _mm_shuffle_epi32(s1, 0xB1);
+    _mm_storeu_si128((__m128i *) &state[0], _mm_blend_epi16(tmp, s1, 0xF0));
+    _mm_storeu_si128((__m128i *) &state[4], _mm_alignr_epi8(s1, tmp, 8));
+}
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_SHA2)
+static void sha256_armv8(uint32_t state[8], const uint8_t *p, size_t nblocks) {
+    uint32x4_t s0 = vld1q_u32(&state[0]);
+    uint32x4_t s1 = vld1q_u32(&state[4]);
+
+    for (; nblocks > 0; nblocks--, p += 64) {
+        uint32x4_t abcd = s0, efgh = s1, m[4];
+        int i;
+        for (i = 0; i < 4; i++) {
+            m[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(p + i * 16)));
+        }
+#pragma GCC unroll 16
+        for (i = 0; i < 16; i++) {
+            uint32x4_t w = vaddq_u32(m[i & 3], vld1q_u32(&SHA256K[i * 4]));
+            if (i < 12) {
+                m[i & 3] = vsha256su1q_u32(vsha256su0q_u32(m[i & 3],
+                                                           m[(i + 1) & 3]),
+                                           m[(i + 2) & 3], m[(i + 3) & 3]);
+            }
+            uint32x4_t t = s0;
+            s0 = vsha256hq_u32(s0, s1, w);
+            s1 = vsha256h2q_u32(s1, t, w);
+        }
+        s0 = vaddq_u32(s0, abcd);
+        s1 = vaddq_u32(s1, efgh);
+    }
+
+    vst1q_u32(&state[0], s0);
+    vst1q_u32(&state[4], s1);
+}
+#endif
+
+#if defined(__x86_64__) && defined(__GNUC__)
+__attribute__((target("avx2")))
+static void murmur3_32_multi_avx2(const void *datas[], const size_t nbytes[],
+                                  size_t num, uint32_t hashes[]) {
+    const __m256i c1 = _mm256_set1_epi32(0xcc9e2d51);
+    const __m256i c2 = _mm256_set1_epi32(0x1b873593);
+    const __m256i c3 = _mm256_set1_epi32(0xe6546b64);
+
+    size_t i;
+    for (i = 0; i + 8 <= num; i += 8) {
+        const uint8_t *const *p = (const uint8_t *const *) &datas[i];
+        size_t nblocks = murmur3_32_multi_blocks(&datas[i], &nbytes[i], 8);
+        __m256i h = _mm256_setzero_si256();
+        size_t j;
+        for (j = 0; j < nblocks * 4; j += 4) {
+            __m256i k = _mm256_set_epi32(wyr4(p[7] + j), wyr4(p[6] + j),
+                                         wyr4(p[5] + j), wyr4(p[4] + j),
+                                         wyr4(p[3] + j), wyr4(p[2] + j),
+                                         wyr4(p[1] + j), wyr4(p[0] + j));
+            k = _mm256_mullo_epi32(k, c1);
+            k = _mm256_or_si256(_mm256_slli_epi32(k, 15), _mm256_srli_epi32(k, 17));
+            k = _mm256_mullo_epi32(k, c2);
+
+            h = _mm256_xor_si256(h, k);
+            h = _mm256_or_si256(_mm256_slli_epi32(h, 13), _mm256_srli_epi32(h, 19));
+            h = _mm256_add_epi32(_mm256_add_epi32(_mm256_slli_epi32(h, 2), h), c3);
+        }
+
+        uint32_t lanes[8], tails[8];
+        _mm256_storeu_si256((__m256i *) lanes, h);
+        murmur3_32_multi_tail(&datas[i], &nbytes[i], 8, nblocks, lanes, tails);
+        h = _mm256_loadu_si256((const __m256i *) lanes);
+
+        __m256i k = _mm256_loadu_si256((const __m256i *) tails);
+        k = _mm256_mullo_epi32(k, c1);
+        k = _mm256_or_si256(_mm256_slli_epi32(k, 15), _mm256_srli_epi32(k, 17));
+        k = _mm256_mullo_epi32(k, c2);
+        h = _mm256_xor_si256(h, k);
+
+        __m256i len = _mm256_set_epi32(datas[i + 7] ? nbytes[i + 7] : 0,
+                                       datas[i + 6] ? nbytes[i + 6] : 0,
+                                       datas[i + 5] ? nbytes[i + 5] : 0,
+                                       datas[i + 4] ? nbytes[i + 4] : 0,
+                                       datas[i + 3] ? nbytes[i + 3] : 0,
+                                       datas[i + 2] ? nbytes[i + 2] : 0,
+                                       datas[i + 1] ? nbytes[i + 1] : 0,
+                                       datas[i + 0] ? nbytes[i + 0] : 0);
+        h = _mm256_xor_si256(h, len);
+        h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+        h = _mm256_mullo_epi32(h, _mm256_set1_epi32(0x85ebca6b));
+        h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 13));
+        h = _mm256_mullo_epi32(h, _mm256_set1_epi32(0xc2b2ae35));
+        h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+        _mm256_storeu_si256((__m256i *) &hashes[i], h);
+    }
+    murmur3_32_multi_sw(&datas[i], &nbytes[i], num - i, &hashes[i]);
+}
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+static void murmur3_32_multi_neon(const void *datas[], const size_t nbytes[],
+                                  size_t num, uint32_t hashes[]) {
+    const uint32x4_t c1 = vdupq_n_u32(0xcc9e2d51);
+    const uint32x4_t c2 = vdupq_n_u32(0x1b873593);
+    const uint32x4_t c3 = vdupq_n_u32(0xe6546b64);
+
+    size_t i;
+    for (i = 0; i + 4 <= num; i += 4) {
+        const uint8_t *const *p = (const uint8_t *const *) &datas[i];
+        size_t nblocks = murmur3_32_multi_blocks(&datas[i], &nbytes[i], 4);
+        uint32x4_t h = vdupq_n_u32(0);
+        size_t j;
+        for (j = 0; j < nblocks * 4; j += 4) {
+            uint32_t w[4] = { wyr4(p[0] + j), wyr4(p[1] + j),
+                              wyr4(p[2] + j), wyr4(p[3] + j) };
+            uint32x4_t k = vmulq_u32(vld1q_u32(w), c1);
+            k = vorrq_u32(vshlq_n_u32(k, 15), vshrq_n_u32(k, 17));
+            k = vmulq_u32(k, c2);
+
+            h = veorq_u32(h, k);
+            h = vorrq_u32(vshlq_n_u32(h, 13), vshrq_n_u32(h, 19));
+            h = vaddq_u32(vaddq_u32(vshlq_n_u32(h, 2), h), c3);
+        }
+
+        uint32_t lanes[4], tails[4];
+        vst1q_u32(lanes, h);
+        murmur3_32_multi_tail(&datas[i], &nbytes[i], 4, nblocks, lanes, tails);
+        h = vld1q_u32(lanes);
+
+        uint32x4_t k = vmulq_u32(vld1q_u32(tails), c1);
+        k = vorrq_u32(vshlq_n_u32(k, 15), vshrq_n_u32(k, 17));
+        k = vmulq_u32(k, c2);
+        h = veorq_u32(h, k);
+
+        uint32_t len[4];
+        size_t l;
+        for (l = 0; l < 4; l++) {
+            len[l] = (datas[i + l] != NULL) ? nbytes[i + l] : 0;
+        }
+        h = veorq_u32(h, vld1q_u32(len));
+        h = veorq_u32(h, vshrq_n_u32(h, 16));
+        h = vmulq_u32(h, vdupq_n_u32(0x85ebca6b));
+        h = veorq_u32(h, vshrq_n_u32(h, 13));
+        h = vmulq_u32(h, vdupq_n_u32(0xc2b2ae35));
+        h = veorq_u32(h, vshrq_n_u32(h, 16));
+        vst1q_u32(&hashes[i], h);
+    }
+    murmur3_32_multi_sw(&datas[i], &nbytes[i], num - i, &hashes[i]);
+}
+#endif
+
+static inline void wyhash_round(uint64_t s[3], const uint8_t *p) {
+    s[0] = wymix(wyr8(p) ^ WYSECRET[1], wyr8(p + 8) ^ s[0]);
+    s[1] = wymix(wyr8(p + 16) ^ WYSECRET[2], wyr8(p + 24) ^ s[1]);
+    s[2] = wymix(wyr8(p + 32) ^ WYSECRET[3], wyr8(p + 40) ^ s[2]);
+}
+
+static inline uint64_t wyr8(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static inline uint64_t wyr4(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static inline void wymum(uint64_t *a, uint64_t *b) {
+    __uint128_t r = *a;
+    r *= *b;
+    *a = (uint64_t) r;
+    *b = (uint64_t) (r >> 64);
+}
+
+static inline uint64_t wymix(uint64_t a, uint64_t b) {
+    wymum(&a, &b);
+    return a ^ b;
+}
+
+static void crc32c_init_table(void) {
+    uint32_t i, j;
+    for (i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (j = 0; j < 8; j++) {
+            crc = (crc >> 1) ^ (0x82F63B78 & (0 - (crc & 1)));
+        }
+        crc32c_table[i] = crc;
+    }
+}
+
+static uint32_t crc32c_sw(uint32_t crc, const uint8_t *p, size_t nbytes) {
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, crc32c_init_table);
+
+    for (; nbytes > 0; nbytes--, p++) {
+        crc = crc32c_table[(crc ^ *p) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(uint32_t crc, const uint8_t *p, size_t nbytes) {
+    uint64_t crc64 = crc;
+    for (; nbytes >= 8; nbytes -= 8, p += 8) {
+        crc64 = __builtin_ia32_crc32di(crc64, wyr8(p));
+    }
+    crc = (uint32_t) crc64;
+    for (; nbytes > 0; nbytes--, p++) {
+        crc = __builtin_ia32_crc32qi(crc, *p);
+    }
+    return crc;
+}
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+static uint32_t crc32c_armv8(uint32_t crc, const uint8_t *p, size_t nbytes) {
+    for (; nbytes >= 8; nbytes -= 8, p += 8) {
+        crc = __crc32cd(crc, wyr8(p));
+    }
+    for (; nbytes > 0; nbytes--, p++) {
+        crc = __crc32cb(crc, *p);
+    }
+    return crc;
+}
+#endif
+
+#endif /* _DOXYGEN_SKIP */
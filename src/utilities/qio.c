@@ -30,18 +30,42 @@
  * @file qio.c I/O handling APIs.
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE  /* splice(), copy_file_range() */
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdarg.h>
 #include <string.h>
 #include <unistd.h>
+#include <limits.h>
 #include <poll.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
 #include <errno.h>
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#endif
 #include "qinternal.h"
 #include "utilities/qio.h"
+#include "utilities/qtrace.h"
 
 #define MAX_IOSEND_SIZE     (32 * 1024)
+#define MAX_ZEROCOPY_SIZE   (1024 * 1024)
+
+#ifndef IOV_MAX
+#define IOV_MAX             (1024)
+#endif
+
+#ifndef _DOXYGEN_SKIP
+static ssize_t fill_buffer(qio_reader_t *reader, int timeoutms);
+#ifdef __linux__
+static off_t send_zerocopy(int outfd, int infd, off_t nbytes, int timeoutms,
+                           bool *fallback);
+#endif
+#endif
 
 /**
  * Test & wait until the file descriptor has readable data.
@@ -119,14 +143,21 @@ ssize_t qio_read(int fd, void *buf, size_t nbytes, int timeoutms) {
     if (nbytes == 0)
         return 0;
 
+    Q_TRACE_BEGIN(trace, QTRACE_IO_READ, fd, NULL);
     ssize_t total = 0;
+    bool timedout = false;
     while (total < nbytes) {
-        if (timeoutms >= 0 && qio_wait_readable(fd, timeoutms) <= 0)
-            break;
+        if (timeoutms >= 0) {
+            int ready = qio_wait_readable(fd, timeoutms);
+            if (ready <= 0) {
+                timedout = (ready == 0);
+                break;
+            }
+        }
 
         ssize_t rsize = read(fd, buf + total, nbytes - total);
         if (rsize <= 0) {
-            if (errno == EAGAIN || errno == EINPROGRESS) {
+            if (rsize < 0 && (errno == EAGAIN || errno == EINPROGRESS)) {
                 // possible with non-block io
                 usleep(1);
                 continue;
@@ -136,11 +167,9 @@ ssize_t qio_read(int fd, void *buf, size_t nbytes, int timeoutms) {
         total += rsize;
     }
 
-    if (total > 0)
-        return total;
-    else if (errno == ETIMEDOUT)
-        return 0;
-    return -1;
+    ssize_t ret = (total > 0) ? total : (timedout == true) ? 0 : -1;
+    Q_TRACE_END(trace, ret, ret > 0);
+    return ret;
 }
 
 /**
@@ -160,13 +189,77 @@ ssize_t qio_write(int fd, const void *buf, size_t nbytes, int timeoutms) {
     if (nbytes == 0)
         return 0;
 
+    Q_TRACE_BEGIN(trace, QTRACE_IO_WRITE, fd, NULL);
     ssize_t total = 0;
     while (total < nbytes) {
         if (timeoutms >= 0 && qio_wait_writable(fd, timeoutms) <= 0)
             break;
         ssize_t wsize = write(fd, buf + total, nbytes - total);
         if (wsize <= 0) {
-            if (errno == EAGAIN || errno == EINPROGRESS) {
+            if (wsize < 0 && (errno == EAGAIN || errno == EINPROGRESS)) {
+                // possible with non-block io
+                usleep(1);
+                continue;
+            }
+            break;
+        }
+        total += wsize;
+    }
+
+    ssize_t ret = (total > 0) ? total : (errno == ETIMEDOUT) ? 0 : -1;
+    Q_TRACE_END(trace, ret, ret > 0);
+    return ret;
+}
+
+/**
+ * Write an array of buffers to a file descriptor.
+ *
+ * @param fd        file descriptor
+ * @param iov       array of buffers to read from
+ * @param iovcnt    the number of entries in iov
+ * @param timeoutms wait timeout milliseconds. 0 for no wait, -1 for infinite
+ *                  wait
+ *
+ * @return the number of bytes written if successful, 0 on timeout,
+ *         -1 for error.
+ *
+ * @code
+ *  struct iovec iov[IOV_MAX];
+ *  int n = grow->toiovec(grow, iov, IOV_MAX);
+ *  qio_writev(fd, iov, n, -1);
+ * @endcode
+ *
+ * @note
+ *  Like qio_write(), it keeps writing until all the buffers are written out,
+ *  resuming in the middle of a buffer after a partial write. The given iov
+ *  array is not modified.
+ */
+ssize_t qio_writev(int fd, const struct iovec *iov, int iovcnt,
+                   int timeoutms) {
+    if (iovcnt <= 0)
+        return 0;
+
+    struct iovec *vec = (struct iovec *) malloc(sizeof(struct iovec) * iovcnt);
+    if (vec == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+    memcpy(vec, iov, sizeof(struct iovec) * iovcnt);
+
+    struct iovec *cur = vec;
+    int left = iovcnt;
+    ssize_t total = 0;
+    while (left > 0) {
+        if (cur->iov_len == 0) {
+            cur++;
+            left--;
+            continue;
+        }
+        if (timeoutms >= 0 && qio_wait_writable(fd, timeoutms) <= 0)
+            break;
+        ssize_t wsize = writev(fd, cur, (left > IOV_MAX) ? IOV_MAX : left);
+        if (wsize <= 0) {
+            if (wsize < 0 && (errno == EAGAIN || errno == EINPROGRESS)) {
                 // possible with non-block io
                 usleep(1);
                 continue;
@@ -174,7 +267,21 @@ ssize_t qio_write(int fd, const void *buf, size_t nbytes, int timeoutms) {
             break;
         }
         total += wsize;
+
+        // skip fully written buffers and trim the partially written one
+        while (left > 0 && (size_t) wsize >= cur->iov_len) {
+            wsize -= cur->iov_len;
+            cur++;
+            left--;
+        }
+        if (wsize > 0) {
+            cur->iov_base = (char *) cur->iov_base + wsize;
+            cur->iov_len -= wsize;
+        }
     }
+    int errsave = errno;
+    free(vec);
+    errno = errsave;
 
     if (total > 0)
         return total;
@@ -195,6 +302,12 @@ ssize_t qio_write(int fd, const void *buf, size_t nbytes, int timeoutms) {
  *
  * @return the number of bytes transferred if successful, 0 on timeout,
  *         -1 for error.
+ *
+ * @note
+ *  On Linux, the data doesn't go through user space when the kernel can
+ *  move it. sendfile() is used from a regular file, copy_file_range() between
+ *  regular files and splice() from a socket or a pipe. Otherwise it's
+ *  copied through a buffer with read() and write().
  */
 off_t qio_send(int outfd, int infd, off_t nbytes, int timeoutms) {
     if (nbytes == 0)
@@ -203,7 +316,11 @@ off_t qio_send(int outfd, int infd, off_t nbytes, int timeoutms) {
     unsigned char buf[MAX_IOSEND_SIZE];
 
     off_t total = 0;  // total size sent
-    while (total < nbytes) {
+    bool fallback = true;
+#ifdef __linux__
+    total = send_zerocopy(outfd, infd, nbytes, timeoutms, &fallback);
+#endif
+    while (fallback == true && total < nbytes) {
         size_t chunksize;  // this time sending size
         if (nbytes - total <= sizeof(buf))
             chunksize = nbytes - total;
@@ -261,15 +378,10 @@ ssize_t qio_gets(int fd, char *buf, size_t bufsize, int timeoutms) {
     ssize_t readcnt = 0;
     char *ptr;
     for (ptr = buf; readcnt < (bufsize - 1); ptr++) {
+        // qio_read() retries the non-block io itself
         ssize_t rsize = qio_read(fd, ptr, 1, timeoutms);
-        if (rsize != 1) {
-            if (errno == EAGAIN || errno == EINPROGRESS) {
-                // possible with non-block io
-                usleep(1);
-                continue;
-            }
+        if (rsize != 1)
             break;
-        }
 
         readcnt++;
         if (*ptr == '\r')
@@ -333,3 +445,478 @@ ssize_t qio_printf(int fd, int timeoutms, const char *format, ...) {
 
     return ret;
 }
+
+/**
+ * Create a buffered reader of a file descriptor.
+ *
+ * qio_read() and qio_gets() issue system calls for every request, and
+ * qio_gets() reads a byte at a time not to consume the data after the line.
+ * The reader reads as much as the buffer takes at once and serves the reads
+ * and lines from the buffer, so reading headers of a protocol takes a
+ * couple of system calls instead of one per byte.
+ *
+ * @param fd        file descriptor. -1 to set it later with
+ *                  qio_reader_reset().
+ * @param bufsize   buffer size, 0 for QIO_READER_BUFSIZE.
+ *
+ * @return a pointer of qio_reader_t if successful, otherwise returns NULL.
+ * @retval errno will be set in error condition.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @code
+ *   qio_reader_t *reader = qio_reader(sockfd, 0);
+ *   char line[1024];
+ *   while (qio_reader_gets(reader, line, sizeof(line), 1000) > 0) {
+ *       if (line[0] == '\0') break;  // end of headers
+ *   }
+ *   qio_reader_read(reader, body, bodysize, 1000);
+ *   qio_reader_free(reader);
+ * @endcode
+ *
+ * @note
+ *  Once the reader is used, the data may be already in the buffer, so the
+ *  file descriptor must not be read directly, and qio_reader_pending() has
+ *  to be checked ahead of polling the file descriptor.
+ */
+qio_reader_t *qio_reader(int fd, size_t bufsize) {
+    if (bufsize == 0)
+        bufsize = QIO_READER_BUFSIZE;
+
+    qio_reader_t *reader = (qio_reader_t *) calloc(1, sizeof(qio_reader_t));
+    if (reader == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    reader->buf = (char *) malloc(bufsize);
+    if (reader->buf == NULL) {
+        free(reader);
+        errno = ENOMEM;
+        return NULL;
+    }
+    reader->fd = fd;
+    reader->bufsize = bufsize;
+
+    return reader;
+}
+
+/**
+ * Read from a buffered reader.
+ *
+ * @param reader    qio_reader_t pointer
+ * @param buf       data buffer pointer to write to. NULL to read and throw
+ *                  out the data.
+ * @param nbytes    the number of bytes to read
+ * @param timeoutms wait timeout milliseconds. 0 for no wait, -1 for infinite
+ *                  wait
+ *
+ * @return the number of bytes read if successful, 0 on timeout, -1 for error.
+ *
+ * @note
+ *  Same as qio_read(), it tries to read nbytes until timeout or end of file.
+ *  Reads bigger than the buffer go straight into buf after the buffered
+ *  data is taken.
+ */
+ssize_t qio_reader_read(qio_reader_t *reader, void *buf, size_t nbytes,
+                        int timeoutms) {
+    if (nbytes == 0)
+        return 0;
+
+    size_t total = 0;
+    bool timedout = false;
+    while (total < nbytes) {
+        if (reader->pos == reader->len) {
+            if (buf != NULL && nbytes - total >= reader->bufsize) {
+                ssize_t rsize = qio_read(reader->fd, buf + total,
+                                         nbytes - total, timeoutms);
+                if (rsize > 0)
+                    total += rsize;
+                timedout = (rsize == 0);
+                break;
+            }
+            // errno is left as it was at end of file
+            ssize_t rsize = fill_buffer(reader, timeoutms);
+            if (rsize <= 0) {
+                timedout = (rsize < 0 && errno == ETIMEDOUT);
+                break;
+            }
+        }
+
+        size_t n = reader->len - reader->pos;
+        if (n > nbytes - total)
+            n = nbytes - total;
+        if (buf != NULL)
+            memcpy(buf + total, reader->buf + reader->pos, n);
+        reader->pos += n;
+        total += n;
+    }
+
+    if (total > 0)
+        return total;
+    return (timedout == true) ? 0 : -1;
+}
+
+/**
+ * Read a line from a buffered reader. Same as qio_gets() but the line is
+ * found in the buffer.
+ *
+ * @param reader      qio_reader_t pointer
+ * @param buf         data buffer pointer
+ * @param bufsize     buffer size
+ * @param timeoutms   wait timeout milliseconds. 0 for no wait, -1 for infinite
+ *                    wait
+ *
+ * @return the number of bytes read if successful, 0 on timeout, -1 for error.
+ *
+ * @note
+ *  Be sure the return value does not mean the length of actual stored data.
+ *  It means how many bytes are consumed from the reader, so the new-line
+ *  characters will be counted, but not be stored.
+ */
+ssize_t qio_reader_gets(qio_reader_t *reader, char *buf, size_t bufsize,
+                        int timeoutms) {
+    if (bufsize <= 1)
+        return -1;
+
+    size_t readcnt = 0;
+    bool timedout = false;
+    char *ptr = buf;
+    while (readcnt < bufsize - 1) {
+        if (reader->pos == reader->len) {
+            ssize_t rsize = fill_buffer(reader, timeoutms);
+            if (rsize <= 0) {
+                timedout = (rsize < 0 && errno == ETIMEDOUT);
+                break;
+            }
+        }
+
+        const char *start = reader->buf + reader->pos;
+        size_t n = reader->len - reader->pos;
+        if (n > bufsize - 1 - readcnt)
+            n = bufsize - 1 - readcnt;
+        const char *newline = memchr(start, '\n', n);
+        if (newline != NULL)
+            n = newline - start + 1;
+        reader->pos += n;
+        readcnt += n;
+
+        // copy the line without new-line characters
+        size_t i;
+        for (i = 0; i < n; i++) {
+            if (start[i] != '\r' && start[i] != '\n')
+                *ptr++ = start[i];
+        }
+        if (newline != NULL)
+            break;
+    }
+
+    *ptr = '\0';
+
+    if (readcnt > 0)
+        return readcnt;
+    return (timedout == true) ? 0 : -1;
+}
+
+/**
+ * Get the number of bytes buffered in a reader.
+ *
+ * @param reader    qio_reader_t pointer
+ *
+ * @return the number of bytes which can be read without waiting.
+ */
+size_t qio_reader_pending(qio_reader_t *reader) {
+    return reader->len - reader->pos;
+}
+
+/**
+ * Take the buffered data in place without copying it out.
+ *
+ * @param reader    qio_reader_t pointer
+ * @param data      set to the data in the buffer.
+ * @param maxbytes  the maximum number of bytes to take
+ * @param timeoutms wait timeout milliseconds when nothing is buffered.
+ *                  0 for no wait, -1 for infinite wait
+ *
+ * @return the number of bytes taken if successful, 0 on timeout or end of
+ *         file, -1 for error.
+ *
+ * @note
+ *  It reads once only when the buffer is empty, so it may take less than
+ *  maxbytes. The data stays valid until the next call on the reader.
+ *
+ * @code
+ *   const void *data;
+ *   ssize_t n;
+ *   while ((n = qio_reader_take(reader, &data, nbytes, 1000)) > 0) {
+ *       parse(data, n);
+ *       nbytes -= n;
+ *   }
+ * @endcode
+ */
+ssize_t qio_reader_take(qio_reader_t *reader, const void **data,
+                        size_t maxbytes, int timeoutms) {
+    if (maxbytes == 0)
+        return 0;
+
+    if (reader->pos == reader->len) {
+        ssize_t rsize = fill_buffer(reader, timeoutms);
+        if (rsize <= 0)
+            return (rsize == 0 || errno == ETIMEDOUT) ? 0 : -1;
+    }
+
+    size_t n = reader->len - reader->pos;
+    if (n > maxbytes)
+        n = maxbytes;
+    *data = reader->buf + reader->pos;
+    reader->pos += n;
+    return n;
+}
+
+/**
+ * Read more data into the buffer without consuming the buffered data.
+ *
+ * This is for event driven readers like the callbacks of qevloop. Fill the
+ * buffer once the descriptor is readable, and take the complete lines with
+ * qio_reader_hasline() and qio_reader_gets() with 0 timeout.
+ *
+ * @param reader    qio_reader_t pointer
+ * @param timeoutms wait timeout milliseconds. 0 for no wait, -1 for infinite
+ *                  wait
+ *
+ * @return the number of bytes read if successful, 0 on end of file,
+ *         -1 on error or timeout.
+ * @retval errno will be set in error condition.
+ *  - ETIMEDOUT : Nothing to read in time.
+ *  - ENOBUFS : The buffer is full.
+ *
+ * @code
+ *   // fd is readable
+ *   if (qio_reader_fill(reader, 0) == 0) {
+ *       // closed by peer
+ *   }
+ *   char line[1024];
+ *   while (qio_reader_hasline(reader)) {
+ *       qio_reader_gets(reader, line, sizeof(line), 0);
+ *   }
+ * @endcode
+ */
+ssize_t qio_reader_fill(qio_reader_t *reader, int timeoutms) {
+    // move the unread data to the front
+    if (reader->pos > 0) {
+        memmove(reader->buf, reader->buf + reader->pos,
+                reader->len - reader->pos);
+        reader->len -= reader->pos;
+        reader->pos = 0;
+    }
+    if (reader->len == reader->bufsize) {
+        errno = ENOBUFS;
+        return -1;
+    }
+
+    while (true) {
+        if (timeoutms >= 0 && qio_wait_readable(reader->fd, timeoutms) <= 0)
+            return -1;
+
+        ssize_t rsize = read(reader->fd, reader->buf + reader->len,
+                             reader->bufsize - reader->len);
+        if (rsize < 0 && (errno == EAGAIN || errno == EINPROGRESS)) {
+            if (timeoutms == 0) {
+                errno = ETIMEDOUT;
+                return -1;
+            }
+            // possible with non-block io
+            usleep(1);
+            continue;
+        }
+        if (rsize > 0)
+            reader->len += rsize;
+        return rsize;
+    }
+}
+
+/**
+ * Check if a whole line is buffered, or the buffer is full of a line.
+ *
+ * @param reader    qio_reader_t pointer
+ *
+ * @return true if qio_reader_gets() can return a line without reading.
+ */
+bool qio_reader_hasline(qio_reader_t *reader) {
+    size_t pending = reader->len - reader->pos;
+    if (pending == 0)
+        return false;
+    return (pending == reader->bufsize
+            || memchr(reader->buf + reader->pos, '\n', pending) != NULL);
+}
+
+/**
+ * Discard the buffered data and set a new file descriptor to read from
+ * like after reconnecting.
+ *
+ * @param reader    qio_reader_t pointer
+ * @param fd        file descriptor
+ */
+void qio_reader_reset(qio_reader_t *reader, int fd) {
+    reader->fd = fd;
+    reader->pos = reader->len = 0;
+}
+
+/**
+ * Free a buffered reader. The file descriptor is not closed.
+ *
+ * @param reader    qio_reader_t pointer
+ */
+void qio_reader_free(qio_reader_t *reader) {
+    if (reader == NULL)
+        return;
+    free(reader->buf);
+    free(reader);
+}
+
+#ifndef _DOXYGEN_SKIP
+
+// read what's available into the empty buffer at once.
+static ssize_t fill_buffer(qio_reader_t *reader, int timeoutms) {
+    reader->pos = reader->len = 0;
+    Q_TRACE_BEGIN(trace, QTRACE_IO_READ, reader->fd, NULL);
+    ssize_t rsize;
+    while (true) {
+        if (timeoutms >= 0 && qio_wait_readable(reader->fd, timeoutms) <= 0) {
+            rsize = -1;
+            break;
+        }
+
+        rsize = read(reader->fd, reader->buf, reader->bufsize);
+        if (rsize < 0 && (errno == EAGAIN || errno == EINPROGRESS)) {
+            // possible with non-block io
+            usleep(1);
+            continue;
+        }
+        if (rsize > 0)
+            reader->len = rsize;
+        break;
+    }
+    Q_TRACE_END(trace, rsize, rsize > 0);
+    return rsize;
+}
+
+
+#ifdef __linux__
+enum {
+    ZEROCOPY_NONE = 0, ZEROCOPY_SENDFILE, ZEROCOPY_COPYRANGE, ZEROCOPY_SPLICE
+};
+
+// transfer in kernel. *fallback is set if the rest has to be copied by
+// the caller, as the descriptors are not supported.
+static off_t send_zerocopy(int outfd, int infd, off_t nbytes, int timeoutms,
+                           bool *fallback) {
+    *fallback = true;
+
+    // kernel copies don't append.
+    struct stat inst, outst;
+    if (fstat(infd, &inst) != 0 || fstat(outfd, &outst) != 0
+            || (fcntl(outfd, F_GETFL) & O_APPEND)) {
+        return 0;
+    }
+
+    int method = ZEROCOPY_NONE;
+    if (S_ISREG(inst.st_mode) && S_ISREG(outst.st_mode)) {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 27)
+        method = ZEROCOPY_COPYRANGE;
+#else
+        method = ZEROCOPY_SENDFILE;
+#endif
+    } else if (S_ISREG(inst.st_mode)) {
+        method = ZEROCOPY_SENDFILE;
+    } else if ((S_ISSOCK(inst.st_mode) || S_ISFIFO(inst.st_mode))
+            && (S_ISREG(outst.st_mode) || S_ISSOCK(outst.st_mode)
+                || S_ISFIFO(outst.st_mode))) {
+        method = ZEROCOPY_SPLICE;
+    } else {
+        return 0;
+    }
+
+    // splice() needs a pipe on one side.
+    int pipefd[2] = { -1, -1 };
+    if (method == ZEROCOPY_SPLICE && !S_ISFIFO(inst.st_mode)
+            && !S_ISFIFO(outst.st_mode) && pipe(pipefd) != 0) {
+        return 0;
+    }
+
+    off_t total = 0;
+    while (total < nbytes) {
+        size_t chunksize = (nbytes - total < MAX_ZEROCOPY_SIZE) ?
+                nbytes - total : MAX_ZEROCOPY_SIZE;
+
+        ssize_t size = -1;
+        if (method == ZEROCOPY_SPLICE) {
+            if (timeoutms >= 0 && qio_wait_readable(infd, timeoutms) <= 0) {
+                *fallback = false;
+                break;
+            }
+            if (pipefd[1] < 0) {
+                size = splice(infd, NULL, outfd, NULL, chunksize,
+                              SPLICE_F_MOVE);
+            } else {
+                size = splice(infd, NULL, pipefd[1], NULL, chunksize,
+                              SPLICE_F_MOVE);
+                // the data in the pipe has to be written out, it's gone
+                // from the input.
+                ssize_t moved = 0;
+                while (size > 0 && moved < size) {
+                    ssize_t n = splice(pipefd[0], NULL, outfd, NULL,
+                                       size - moved, SPLICE_F_MOVE);
+                    if (n <= 0) {
+                        if (n < 0 && errno == EAGAIN
+                                && qio_wait_writable(outfd, -1) > 0) {
+                            continue;
+                        }
+                        break;
+                    }
+                    moved += n;
+                }
+                if (moved < size) {
+                    total += moved;
+                    *fallback = false;
+                    break;
+                }
+            }
+        } else {
+            if (timeoutms >= 0 && qio_wait_writable(outfd, timeoutms) <= 0) {
+                *fallback = false;
+                break;
+            }
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 27)
+            if (method == ZEROCOPY_COPYRANGE) {
+                size = copy_file_range(infd, NULL, outfd, NULL, chunksize, 0);
+            } else
+#endif
+            size = sendfile(outfd, infd, NULL, chunksize);
+        }
+
+        if (size <= 0) {
+            if (size < 0 && (errno == EAGAIN || errno == EINPROGRESS)) {
+                // possible with non-block io
+                usleep(1);
+                continue;
+            }
+            if (size < 0 && total == 0
+                    && (errno == EINVAL || errno == ENOSYS || errno == EXDEV
+                        || errno == EOPNOTSUPP)) {
+                break;  // not supported by the descriptors
+            }
+            *fallback = false;
+            break;
+        }
+        total += size;
+    }
+
+    if (pipefd[0] >= 0) {
+        close(pipefd[0]);
+        close(pipefd[1]);
+    }
+
+    return total;
+}
+#endif /* __linux__ */
+
+#endif /* _DOXYGEN_SKIP */
@@ -0,0 +1,657 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/**
+ * @file qiouring.c Batched I/O submission APIs on io_uring.
+ *
+ * qio_read() and qio_write() issue a system call or two per operation.
+ * qiouring queues reads, writes, sends, receives and accepts in a ring
+ * shared with the kernel, submits any number of them with a system call and
+ * calls back on completion. Buffers registered with
+ * qiouring_register_buffers() save the kernel mapping them for every
+ * operation.
+ *
+ * It's Linux 5.6 or later only, qiouring() fails with ENOTSUP elsewhere.
+ * A ring is not thread-safe, use one per thread.
+ *
+ * @code
+ *   static void on_read(qiouring_t *ring, int result, void *userdata) {
+ *       if (result < 0) {
+ *           printf("error: %s\n", strerror(-result));
+ *       }
+ *   }
+ *
+ *   qiouring_t *ring = qiouring(256);
+ *   for (i = 0; i < 100; i++) {
+ *       qiouring_read(ring, fd, bufs[i], 4096, i * 4096, on_read, bufs[i]);
+ *   }
+ *   qiouring_wait(ring, 100);  // submit all and wait for all
+ *   qiouring_free(ring);
+ * @endcode
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/uio.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+#include "qinternal.h"
+#include "utilities/qiouring.h"
+
+#if defined(__linux__) && defined(__NR_io_uring_setup) \
+    && defined(IORING_FEAT_RW_CUR_POS)
+#define QIOURING_SUPPORTED
+#endif
+
+#ifndef _DOXYGEN_SKIP
+
+typedef struct qiouring_slot_s qiouring_slot_t;
+struct qiouring_slot_s {
+    qiouring_cb_t cb;
+    void *userdata;
+    int next;           /* next free slot */
+};
+
+#ifdef QIOURING_SUPPORTED
+static struct io_uring_sqe *get_sqe(qiouring_t *ring, qiouring_cb_t cb,
+                                    void *userdata);
+static int enter(qiouring_t *ring, unsigned int tosubmit,
+                 unsigned int mincomplete, unsigned int flags);
+static int reap(qiouring_t *ring);
+#endif
+
+#endif
+
+/**
+ * Create an io_uring instance.
+ *
+ * @param entries   the number of operations which can be queued before
+ *                  submitting. up to twice of it can be in flight.
+ *
+ * @return a pointer of qiouring_t if successful, otherwise returns NULL.
+ * @retval errno will be set in error condition.
+ *  - ENOTSUP : io_uring is not supported.
+ *  - ENOMEM : Memory allocation failure.
+ *  - Others : Errors of io_uring_setup() or mmap().
+ */
+qiouring_t *qiouring(unsigned int entries) {
+#ifndef QIOURING_SUPPORTED
+    errno = ENOTSUP;
+    return NULL;
+#else
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = syscall(__NR_io_uring_setup, entries, &params);
+    if (fd < 0) {
+        if (errno == ENOSYS)
+            errno = ENOTSUP;
+        return NULL;
+    }
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP)
+            || !(params.features & IORING_FEAT_RW_CUR_POS)) {
+        close(fd);
+        errno = ENOTSUP;  // older than 5.6
+        return NULL;
+    }
+
+    qiouring_t *ring = (qiouring_t *) calloc(1, sizeof(qiouring_t));
+    if (ring == NULL) {
+        close(fd);
+        errno = ENOMEM;
+        return NULL;
+    }
+    ring->fd = fd;
+
+    // the rings share a mapping.
+    ring->sqringsize = params.sq_off.array
+            + params.sq_entries * sizeof(unsigned);
+    size_t cqringsize = params.cq_off.cqes
+            + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (cqringsize > ring->sqringsize)
+        ring->sqringsize = cqringsize;
+    ring->sqring = mmap(NULL, ring->sqringsize, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ring->sqring == MAP_FAILED) {
+        ring->sqring = NULL;
+        qiouring_free(ring);
+        return NULL;
+    }
+    ring->cqring = ring->sqring;
+
+    ring->sqessize = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqessize, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        qiouring_free(ring);
+        return NULL;
+    }
+
+    char *sq = (char *) ring->sqring;
+    ring->sqhead = (unsigned *) (sq + params.sq_off.head);
+    ring->sqtail = (unsigned *) (sq + params.sq_off.tail);
+    ring->sqmask = (unsigned *) (sq + params.sq_off.ring_mask);
+    ring->sqarray = (unsigned *) (sq + params.sq_off.array);
+    ring->sqentries = params.sq_entries;
+    ring->sqlocal = *ring->sqtail;
+
+    char *cq = (char *) ring->cqring;
+    ring->cqhead = (unsigned *) (cq + params.cq_off.head);
+    ring->cqtail = (unsigned *) (cq + params.cq_off.tail);
+    ring->cqmask = (unsigned *) (cq + params.cq_off.ring_mask);
+    ring->cqes = cq + params.cq_off.cqes;
+
+    // no more in flight than the completion queue takes.
+    ring->numslots = params.cq_entries;
+    ring->slots = malloc(sizeof(qiouring_slot_t) * ring->numslots);
+    if (ring->slots == NULL) {
+        qiouring_free(ring);
+        errno = ENOMEM;
+        return NULL;
+    }
+    qiouring_slot_t *slots = (qiouring_slot_t *) ring->slots;
+    int i;
+    for (i = 0; i < ring->numslots; i++)
+        slots[i].next = (i + 1 < ring->numslots) ? i + 1 : -1;
+    ring->freeslot = 0;
+
+    return ring;
+#endif
+}
+
+/**
+ * Queue a read from a file descriptor.
+ *
+ * @param ring      qiouring_t pointer
+ * @param fd        file descriptor
+ * @param buf       data buffer pointer to write to, it has to be valid
+ *                  until the completion.
+ * @param nbytes    the number of bytes to read
+ * @param offset    file offset to read from, -1 for the current position.
+ * @param cb        completion callback. NULL for nothing to do.
+ * @param userdata  user data pointer given to the callback.
+ *
+ * @return true if queued, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EBUSY : Too many operations in flight.
+ *
+ * @note
+ *  The callback gets the number of bytes read, or a negative errno value
+ *  on failure. A read can be shorter than asked like read().
+ *
+ * @note
+ *  When the queue is full, the queued operations are submitted. When twice
+ *  the entries are in flight, it waits for one to complete and its callback
+ *  is called before returning. It's the same for all the operations.
+ */
+bool qiouring_read(qiouring_t *ring, int fd, void *buf, size_t nbytes,
+                   off_t offset, qiouring_cb_t cb, void *userdata) {
+#ifndef QIOURING_SUPPORTED
+    errno = ENOTSUP;
+    return false;
+#else
+    struct io_uring_sqe *sqe = get_sqe(ring, cb, userdata);
+    if (sqe == NULL)
+        return false;
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = (uintptr_t) buf;
+    sqe->len = nbytes;
+    sqe->off = (uint64_t) offset;
+    return true;
+#endif
+}
+
+/**
+ * Queue a write to a file descriptor.
+ *
+ * @param ring      qiouring_t pointer
+ * @param fd        file descriptor
+ * @param buf       data buffer pointer to read from, it has to be valid
+ *                  until the completion.
+ * @param nbytes    the number of bytes to write
+ * @param offset    file offset to write at, -1 for the current position.
+ * @param cb        completion callback. NULL for nothing to do.
+ * @param userdata  user data pointer given to the callback.
+ *
+ * @return true if queued, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EBUSY : Too many operations in flight.
+ */
+bool qiouring_write(qiouring_t *ring, int fd, const void *buf, size_t nbytes,
+                    off_t offset, qiouring_cb_t cb, void *userdata) {
+#ifndef QIOURING_SUPPORTED
+    errno = ENOTSUP;
+    return false;
+#else
+    struct io_uring_sqe *sqe = get_sqe(ring, cb, userdata);
+    if (sqe == NULL)
+        return false;
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = fd;
+    sqe->addr = (uintptr_t) buf;
+    sqe->len = nbytes;
+    sqe->off = (uint64_t) offset;
+    return true;
+#endif
+}
+
+/**
+ * Queue a receive from a socket.
+ *
+ * @param ring      qiouring_t pointer
+ * @param fd        socket descriptor
+ * @param buf       data buffer pointer to write to
+ * @param nbytes    the number of bytes to receive
+ * @param flags     flags of recv() like MSG_WAITALL
+ * @param cb        completion callback. NULL for nothing to do.
+ * @param userdata  user data pointer given to the callback.
+ *
+ * @return true if queued, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EBUSY : Too many operations in flight.
+ */
+bool qiouring_recv(qiouring_t *ring, int fd, void *buf, size_t nbytes,
+                   int flags, qiouring_cb_t cb, void *userdata) {
+#ifndef QIOURING_SUPPORTED
+    errno = ENOTSUP;
+    return false;
+#else
+    struct io_uring_sqe *sqe = get_sqe(ring, cb, userdata);
+    if (sqe == NULL)
+        return false;
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->addr = (uintptr_t) buf;
+    sqe->len = nbytes;
+    sqe->msg_flags = flags;
+    return true;
+#endif
+}
+
+/**
+ * Queue a send to a socket.
+ *
+ * @param ring      qiouring_t pointer
+ * @param fd        socket descriptor
+ * @param buf       data buffer pointer to read from
+ * @param nbytes    the number of bytes to send
+ * @param flags     flags of send() like MSG_NOSIGNAL
+ * @param cb        completion callback. NULL for nothing to do.
+ * @param userdata  user data pointer given to the callback.
+ *
+ * @return true if queued, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EBUSY : Too many operations in flight.
+ */
+bool qiouring_send(qiouring_t *ring, int fd, const void *buf, size_t nbytes,
+                   int flags, qiouring_cb_t cb, void *userdata) {
+#ifndef QIOURING_SUPPORTED
+    errno = ENOTSUP;
+    return false;
+#else
+    struct io_uring_sqe *sqe = get_sqe(ring, cb, userdata);
+    if (sqe == NULL)
+        return false;
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = fd;
+    sqe->addr = (uintptr_t) buf;
+    sqe->len = nbytes;
+    sqe->msg_flags = flags;
+    return true;
+#endif
+}
+
+/**
+ * Queue an accept of a connection.
+ *
+ * @param ring      qiouring_t pointer
+ * @param fd        listening socket descriptor
+ * @param cb        completion callback, it gets the accepted descriptor.
+ * @param userdata  user data pointer given to the callback.
+ *
+ * @return true if queued, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EBUSY : Too many operations in flight.
+ */
+bool qiouring_accept(qiouring_t *ring, int fd, qiouring_cb_t cb,
+                     void *userdata) {
+#ifndef QIOURING_SUPPORTED
+    errno = ENOTSUP;
+    return false;
+#else
+    struct io_uring_sqe *sqe = get_sqe(ring, cb, userdata);
+    if (sqe == NULL)
+        return false;
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    return true;
+#endif
+}
+
+/**
+ * Register buffers to be used by qiouring_read_fixed() and
+ * qiouring_write_fixed().
+ *
+ * The kernel pins the buffers once, instead of mapping the pages for each
+ * operation. Registering again replaces the buffers, and only when nothing
+ * is in flight.
+ *
+ * @param ring      qiouring_t pointer
+ * @param iov       the buffers, index in the array is the buffer index.
+ * @param iovcnt    the number of buffers, 0 to unregister.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EBUSY : Operations are in flight.
+ *  - Others : Errors of io_uring_register() like ENOMEM by RLIMIT_MEMLOCK.
+ */
+bool qiouring_register_buffers(qiouring_t *ring, const struct iovec *iov,
+                               int iovcnt) {
+#ifndef QIOURING_SUPPORTED
+    errno = ENOTSUP;
+    return false;
+#else
+    if (ring->inflight > 0) {
+        errno = EBUSY;
+        return false;
+    }
+
+    // unregistering fails if nothing is registered, that's fine.
+    syscall(__NR_io_uring_register, ring->fd, IORING_UNREGISTER_BUFFERS,
+            NULL, 0);
+    if (iovcnt == 0)
+        return true;
+    return (syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_BUFFERS,
+                    iov, iovcnt) == 0);
+#endif
+}
+
+/**
+ * Queue a read into a registered buffer.
+ *
+ * @param ring      qiouring_t pointer
+ * @param fd        file descriptor
+ * @param buf       data buffer pointer inside the registered buffer
+ * @param nbytes    the number of bytes to read
+ * @param offset    file offset to read from, -1 for the current position.
+ * @param bufidx    index of the registered buffer
+ * @param cb        completion callback. NULL for nothing to do.
+ * @param userdata  user data pointer given to the callback.
+ *
+ * @return true if queued, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EBUSY : Too many operations in flight.
+ */
+bool qiouring_read_fixed(qiouring_t *ring, int fd, void *buf, size_t nbytes,
+                         off_t offset, int bufidx, qiouring_cb_t cb,
+                         void *userdata) {
+#ifndef QIOURING_SUPPORTED
+    errno = ENOTSUP;
+    return false;
+#else
+    struct io_uring_sqe *sqe = get_sqe(ring, cb, userdata);
+    if (sqe == NULL)
+        return false;
+    sqe->opcode = IORING_OP_READ_FIXED;
+    sqe->fd = fd;
+    sqe->addr = (uintptr_t) buf;
+    sqe->len = nbytes;
+    sqe->off = (uint64_t) offset;
+    sqe->buf_index = bufidx;
+    return true;
+#endif
+}
+
+/**
+ * Queue a write from a registered buffer.
+ *
+ * @param ring      qiouring_t pointer
+ * @param fd        file descriptor
+ * @param buf       data buffer pointer inside the registered buffer
+ * @param nbytes    the number of bytes to write
+ * @param offset    file offset to write at, -1 for the current position.
+ * @param bufidx    index of the registered buffer
+ * @param cb        completion callback. NULL for nothing to do.
+ * @param userdata  user data pointer given to the callback.
+ *
+ * @return true if queued, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EBUSY : Too many operations in flight.
+ */
+bool qiouring_write_fixed(qiouring_t *ring, int fd, const void *buf,
+                          size_t nbytes, off_t offset, int bufidx,
+                          qiouring_cb_t cb, void *userdata) {
+#ifndef QIOURING_SUPPORTED
+    errno = ENOTSUP;
+    return false;
+#else
+    struct io_uring_sqe *sqe = get_sqe(ring, cb, userdata);
+    if (sqe == NULL)
+        return false;
+    sqe->opcode = IORING_OP_WRITE_FIXED;
+    sqe->fd = fd;
+    sqe->addr = (uintptr_t) buf;
+    sqe->len = nbytes;
+    sqe->off = (uint64_t) offset;
+    sqe->buf_index = bufidx;
+    return true;
+#endif
+}
+
+/**
+ * Submit the queued operations to the kernel.
+ *
+ * @param ring      qiouring_t pointer
+ *
+ * @return the number of operations submitted, otherwise returns -1.
+ */
+int qiouring_submit(qiouring_t *ring) {
+#ifndef QIOURING_SUPPORTED
+    errno = ENOTSUP;
+    return -1;
+#else
+    return enter(ring, ring->sqlocal
+                 - __atomic_load_n(ring->sqhead, __ATOMIC_ACQUIRE), 0, 0);
+#endif
+}
+
+/**
+ * Submit the queued operations and call back the completed ones.
+ *
+ * @param ring          qiouring_t pointer
+ * @param mincomplete   the number of completions to wait for, 0 for no wait.
+ *                      It's capped to the operations in flight.
+ *
+ * @return the number of completions called back, otherwise returns -1.
+ * @retval errno will be set in error condition.
+ *  - EINTR : Interrupted by a signal.
+ *
+ * @note
+ *  The callbacks can queue more operations, they're submitted by the next
+ *  call.
+ */
+int qiouring_wait(qiouring_t *ring, int mincomplete) {
+#ifndef QIOURING_SUPPORTED
+    errno = ENOTSUP;
+    return -1;
+#else
+    int called = 0;
+    do {
+        // not taken by the kernel yet
+        unsigned int tosubmit = ring->sqlocal
+                - __atomic_load_n(ring->sqhead, __ATOMIC_ACQUIRE);
+        int waitfor = mincomplete - called;
+        if (waitfor > ring->inflight)
+            waitfor = ring->inflight;
+        if (waitfor < 0)
+            waitfor = 0;
+
+        // take the completions already there first.
+        int ready = __atomic_load_n(ring->cqtail, __ATOMIC_ACQUIRE)
+                - *ring->cqhead;
+        if (tosubmit > 0 || ready < waitfor) {
+            if (enter(ring, tosubmit, (ready < waitfor) ? waitfor : 0,
+                      (ready < waitfor) ? IORING_ENTER_GETEVENTS : 0) < 0) {
+                return (called > 0) ? called : -1;
+            }
+        }
+        called += reap(ring);
+    } while (called < mincomplete && ring->inflight > 0);
+
+    return called;
+#endif
+}
+
+/**
+ * Get the number of operations queued or in flight.
+ *
+ * @param ring      qiouring_t pointer
+ *
+ * @return the number of operations not completed yet.
+ */
+int qiouring_inflight(qiouring_t *ring) {
+    return ring->inflight;
+}
+
+/**
+ * Free an io_uring instance. The operations in flight are cancelled.
+ *
+ * @param ring      qiouring_t pointer
+ */
+void qiouring_free(qiouring_t *ring) {
+    if (ring == NULL)
+        return;
+#ifdef QIOURING_SUPPORTED
+    if (ring->sqes != NULL)
+        munmap(ring->sqes, ring->sqessize);
+    if (ring->sqring != NULL)
+        munmap(ring->sqring, ring->sqringsize);
+#endif
+    if (ring->fd >= 0)
+        close(ring->fd);
+    free(ring->slots);
+    free(ring);
+}
+
+#ifndef _DOXYGEN_SKIP
+
+#ifdef QIOURING_SUPPORTED
+// take a submission entry, submits the queued ones to make a room.
+static struct io_uring_sqe *get_sqe(qiouring_t *ring, qiouring_cb_t cb,
+                                    void *userdata) {
+    if (ring->freeslot < 0) {
+        // wait for one to complete
+        if (qiouring_wait(ring, 1) < 0)
+            return NULL;
+        if (ring->freeslot < 0) {
+            errno = EBUSY;
+            return NULL;
+        }
+    }
+
+    unsigned head = __atomic_load_n(ring->sqhead, __ATOMIC_ACQUIRE);
+    if (ring->sqlocal - head >= ring->sqentries) {
+        if (qiouring_submit(ring) < 0)
+            return NULL;
+        head = __atomic_load_n(ring->sqhead, __ATOMIC_ACQUIRE);
+        if (ring->sqlocal - head >= ring->sqentries) {
+            errno = EBUSY;
+            return NULL;
+        }
+    }
+
+    qiouring_slot_t *slots = (qiouring_slot_t *) ring->slots;
+    int slot = ring->freeslot;
+    ring->freeslot = slots[slot].next;
+    slots[slot].cb = cb;
+    slots[slot].userdata = userdata;
+    ring->inflight++;
+
+    unsigned idx = ring->sqlocal & *ring->sqmask;
+    struct io_uring_sqe *sqe = (struct io_uring_sqe *) ring->sqes + idx;
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->user_data = slot;
+    ring->sqarray[idx] = idx;
+    ring->sqlocal++;
+
+    return sqe;
+}
+
+// publish the queued entries and enter the kernel.
+static int enter(qiouring_t *ring, unsigned int tosubmit,
+                 unsigned int mincomplete, unsigned int flags) {
+    __atomic_store_n(ring->sqtail, ring->sqlocal, __ATOMIC_RELEASE);
+    if (tosubmit == 0 && mincomplete == 0)
+        return 0;
+
+    return syscall(__NR_io_uring_enter, ring->fd, tosubmit, mincomplete,
+                   flags, NULL, 0);
+}
+
+// call back the completions.
+static int reap(qiouring_t *ring) {
+    qiouring_slot_t *slots = (qiouring_slot_t *) ring->slots;
+    int called = 0;
+
+    while (true) {
+        unsigned head = *ring->cqhead;
+        if (head == __atomic_load_n(ring->cqtail, __ATOMIC_ACQUIRE))
+            break;
+
+        struct io_uring_cqe *cqe = (struct io_uring_cqe *) ring->cqes
+                + (head & *ring->cqmask);
+        int slot = (int) cqe->user_data;
+        int result = cqe->res;
+        __atomic_store_n(ring->cqhead, head + 1, __ATOMIC_RELEASE);
+
+        // free the slot before the callback, it may queue another one.
+        qiouring_cb_t cb = slots[slot].cb;
+        void *userdata = slots[slot].userdata;
+        slots[slot].next = ring->freeslot;
+        ring->freeslot = slot;
+        ring->inflight--;
+
+        if (cb != NULL)
+            cb(ring, result, userdata);
+        called++;
+    }
+
+    return called;
+}
+#endif /* QIOURING_SUPPORTED */
+
+#endif /* _DOXYGEN_SKIP */
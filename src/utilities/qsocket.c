@@ -41,17 +41,74 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
+#include <time.h>
+#include <pthread.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <sys/socket.h>
+#include <poll.h>
 #include "qinternal.h"
 #include "utilities/qio.h"
+#include "utilities/qhash.h"
 #include "utilities/qstring.h"
+#include "utilities/qtime.h"
 #include "utilities/qsocket.h"
+#include "utilities/qtrace.h"
+
+#ifndef _DOXYGEN_SKIP
+
+// a resolved address
+typedef struct {
+    struct sockaddr_storage addr;
+    socklen_t addrlen;
+} dnsaddr_t;
+
+static int resolve_addrs(const char *hostname, int family, dnsaddr_t *addrs,
+                         int *naddrs);
+static int lookup(const char *hostname, int family, dnsaddr_t *addrs,
+                  int *naddrs);
+static int cache_get(const char *hostname, int family, dnsaddr_t *addrs,
+                     int *naddrs);
+static void cache_put(const char *hostname, int family, int error,
+                      const dnsaddr_t *addrs, int naddrs);
+static void set_port(struct sockaddr_storage *addr, int port);
+static int connect_start(const dnsaddr_t *addr, bool *created);
+static int connect_race(const dnsaddr_t *addrs, int naddrs, int timeoutms);
+static void *resolver_main(void *arg);
+static void release_req(qsocket_dns_t *req);
+
+// resolver cache, a name takes the slot of its hash.
+typedef struct {
+    char *hostname;
+    int family;
+    time_t expire;
+    int error;  // cached failure if not 0
+    dnsaddr_t *addrs;
+    int naddrs;
+} dnscache_t;
+
+static pthread_mutex_t dns_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t dns_cond = PTHREAD_COND_INITIALIZER;
+static dnscache_t dns_cache[QSOCKET_DNS_CACHESIZE];
+static int dns_ttl = QSOCKET_DNS_TTL;
+static int dns_negttl = QSOCKET_DNS_NEGTTL;
+
+// async requests waiting for a resolver thread
+static qsocket_dns_t *dns_jobs = NULL, *dns_jobs_last = NULL;
+static int dns_threads = 0, dns_idle = 0;
+
+#endif
 
 /**
  * Create a TCP socket for the remote host and port.
  *
+ * When the host has several addresses, the connections are raced in the way
+ * of RFC 8305. The next address is tried every QSOCKET_CONNECT_DELAY
+ * milliseconds or as soon as an attempt fails, taking turns between IPv6 and
+ * IPv4, and the first one connected wins. So a dead address costs the delay
+ * rather than the whole timeout.
+ *
  * @param hostname  remote hostname
  * @param port      remote port
  * @param timeoutms wait timeout milliseconds. if set to negative value,
@@ -64,34 +121,135 @@
  */
 int qsocket_open(const char *hostname, int port, int timeoutms) {
     /* host conversion */
-    struct sockaddr_in addr;
-    if (qsocket_get_addr(&addr, hostname, port) == false) {
+    dnsaddr_t addrs[QSOCKET_DNS_MAXADDRS];
+    int naddrs = QSOCKET_DNS_MAXADDRS;
+    if (hostname == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    Q_TRACE_BEGIN(resolve, QTRACE_SOCKET_RESOLVE, -1, hostname);
+    int error = resolve_addrs(hostname, AF_UNSPEC, addrs, &naddrs);
+    if (error != 0) {
+        errno = error;
+        Q_TRACE_END(resolve, -1, false);
         return -1; /* invalid hostname */
     }
+    Q_TRACE_END(resolve, naddrs, true);
+    int i;
+    for (i = 0; i < naddrs; i++) {
+        set_port(&addrs[i].addr, port);
+    }
+
+    /* try to connect */
+    Q_TRACE_BEGIN(connect, QTRACE_SOCKET_CONNECT, -1, hostname);
+    int sockfd = connect_race(addrs, naddrs, timeoutms);
+    Q_TRACE_END(connect, sockfd, sockfd >= 0);
+    return sockfd;
+}
+
+/**
+ * Create a TCP socket listening on the local address and port.
+ *
+ * @param hostname  local address to bind, NULL for all the addresses.
+ * @param port      local port
+ * @param backlog   length of the queue of pending connections.
+ * @param options   QSOCKET_OPT_* flags ORed, 0 for none.
+ *
+ * @return the new socket descriptor, or
+ *         -1 in case of invalid hostname,
+ *         -2 in case of socket creation failure or unsupported options,
+ *         -3 in case of bind or listen failure.
+ *
+ * @code
+ *   int sockfd = qsocket_listen(NULL, 8080, 128,
+ *                               QSOCKET_OPT_NODELAY | QSOCKET_OPT_REUSEPORT);
+ *   int clientfd = accept(sockfd, NULL, NULL);
+ * @endcode
+ *
+ * @note
+ *  SO_REUSEADDR is always set. With NULL hostname, it listens on IPv6 with
+ *  IPv4 mapped as well, or on IPv4 only where IPv6 isn't available.
+ *  - QSOCKET_OPT_NODELAY : TCP_NODELAY, inherited by the accepted sockets.
+ *  - QSOCKET_OPT_REUSEPORT : SO_REUSEPORT, so that several processes or
+ *    threads can listen on the same port and the kernel spreads the load.
+ *  - QSOCKET_OPT_FASTOPEN : TCP_FASTOPEN, which lets clients send data in
+ *    SYN. The queue length of it is the backlog.
+ */
+int qsocket_listen(const char *hostname, int port, int backlog, int options) {
+    /* host conversion */
+    struct sockaddr_storage addr;
+    socklen_t addrlen;
+    if (hostname != NULL) {
+        if (qsocket_resolve(&addr, &addrlen, hostname, port, AF_UNSPEC)
+                == false) {
+            return -1; /* invalid hostname */
+        }
+    } else {
+        memset((void *) &addr, 0, sizeof(addr));
+        struct sockaddr_in6 *in6 = (struct sockaddr_in6 *) &addr;
+        in6->sin6_family = AF_INET6;
+        in6->sin6_addr = in6addr_any;
+        in6->sin6_port = htons(port);
+        addrlen = sizeof(struct sockaddr_in6);
+    }
 
     /* create new socket */
-    int sockfd;
-    if ((sockfd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+    int sockfd = socket(addr.ss_family, SOCK_STREAM, 0);
+    if (sockfd < 0 && hostname == NULL && errno == EAFNOSUPPORT) {
+        memset((void *) &addr, 0, sizeof(addr));
+        struct sockaddr_in *in = (struct sockaddr_in *) &addr;
+        in->sin_family = AF_INET;
+        in->sin_addr.s_addr = htonl(INADDR_ANY);
+        in->sin_port = htons(port);
+        addrlen = sizeof(struct sockaddr_in);
+        sockfd = socket(AF_INET, SOCK_STREAM, 0);
+    }
+    if (sockfd < 0) {
         return -2; /* sockfd creation fail */
     }
 
-    /* set to non-block socket*/
-    int flags = fcntl(sockfd, F_GETFL, 0);
-    if (timeoutms >= 0)
-        fcntl(sockfd, F_SETFL, flags | O_NONBLOCK);
-
-    /* try to connect */
-    int status = connect(sockfd, (struct sockaddr *) &addr, sizeof(addr));
-    if (status < 0
-            && (errno != EINPROGRESS
-                    || qio_wait_writable(sockfd, timeoutms) <= 0)) {
+    /* set options */
+    int on = 1, off = 0;
+    bool ok = (setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on))
+            == 0);
+    if (ok && hostname == NULL && addr.ss_family == AF_INET6) {
+        ok = (setsockopt(sockfd, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off))
+                == 0);
+    }
+    if (ok && (options & QSOCKET_OPT_NODELAY)) {
+        ok = (setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on))
+                == 0);
+    }
+    if (ok && (options & QSOCKET_OPT_REUSEPORT)) {
+#ifdef SO_REUSEPORT
+        ok = (setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on))
+                == 0);
+#else
+        errno = ENOTSUP;
+        ok = false;
+#endif
+    }
+    if (ok && (options & QSOCKET_OPT_FASTOPEN)) {
+#ifdef TCP_FASTOPEN
+        int qlen = (backlog > 0) ? backlog : 1;
+        ok = (setsockopt(sockfd, IPPROTO_TCP, TCP_FASTOPEN, &qlen,
+                         sizeof(qlen)) == 0);
+#else
+        errno = ENOTSUP;
+        ok = false;
+#endif
+    }
+    if (ok == false) {
         close(sockfd);
-        return -3; /* connection failed */
+        return -2; /* unsupported option */
     }
 
-    /* restore to block socket */
-    if (timeoutms >= 0)
-        fcntl(sockfd, F_SETFL, flags);
+    /* bind and listen */
+    if (bind(sockfd, (struct sockaddr *) &addr, addrlen) != 0
+            || listen(sockfd, backlog) != 0) {
+        close(sockfd);
+        return -3; /* bind failed */
+    }
 
     return sockfd;
 }
@@ -131,22 +289,290 @@ bool qsocket_close(int sockfd, int timeoutms) {
  * @param port      port number
  *
  * @return true if successful, otherwise returns false.
+ *
+ * @note
+ *  It's thread-safe and the names are cached. See qsocket_resolve().
  */
 bool qsocket_get_addr(struct sockaddr_in *addr, const char *hostname, int port) {
-    /* here we assume that the hostname argument contains ip address */
-    memset((void *) addr, 0, sizeof(struct sockaddr_in));
-    if (!inet_aton(hostname, &addr->sin_addr)) { /* fail then try another way */
-        struct hostent *hp;
-        if ((hp = gethostbyname(hostname)) == 0)
-            return false;
-        memcpy(&addr->sin_addr, hp->h_addr, sizeof(struct in_addr));
+    struct sockaddr_storage ss;
+    socklen_t sslen;
+    if (qsocket_resolve(&ss, &sslen, hostname, port, AF_INET) == false)
+        return false;
+
+    memcpy((void *) addr, (void *) &ss, sizeof(struct sockaddr_in));
+    return true;
+}
+
+/**
+ * Resolve a hostname to a socket address of IPv4 or IPv6.
+ *
+ * @param addr      sockaddr_storage structure pointer to store the address.
+ * @param addrlen   set to the length of the address.
+ * @param hostname  IP string address or hostname
+ * @param port      port number
+ * @param family    AF_INET, AF_INET6 or AF_UNSPEC for either.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - ENOENT : No such host.
+ *  - EAGAIN : Temporary failure of the name server.
+ *
+ * @code
+ *   struct sockaddr_storage addr;
+ *   socklen_t addrlen;
+ *   if (qsocket_resolve(&addr, &addrlen, "www.qdecoder.org", 80, AF_UNSPEC)) {
+ *     int sockfd = socket(addr.ss_family, SOCK_STREAM, 0);
+ *     connect(sockfd, (struct sockaddr *) &addr, addrlen);
+ *   }
+ * @endcode
+ *
+ * @note
+ *  It's thread-safe. The answers including failures are cached for the
+ *  seconds set by qsocket_set_dnscache(), as the system resolver doesn't
+ *  tell the TTL of the records.
+ */
+bool qsocket_resolve(struct sockaddr_storage *addr, socklen_t *addrlen,
+                     const char *hostname, int port, int family) {
+    if (addr == NULL || addrlen == NULL || hostname == NULL
+            || (family != AF_UNSPEC && family != AF_INET
+                    && family != AF_INET6)) {
+        errno = EINVAL;
+        return false;
+    }
+
+    dnsaddr_t addrs[QSOCKET_DNS_MAXADDRS];
+    int naddrs = QSOCKET_DNS_MAXADDRS;
+    Q_TRACE_BEGIN(trace, QTRACE_SOCKET_RESOLVE, -1, hostname);
+    int error = resolve_addrs(hostname, family, addrs, &naddrs);
+    if (error != 0) {
+        errno = error;
+        Q_TRACE_END(trace, -1, false);
+        return false;
+    }
+    Q_TRACE_END(trace, naddrs, true);
+
+    memcpy((void *) addr, (void *) &addrs[0].addr, sizeof(addrs[0].addr));
+    *addrlen = addrs[0].addrlen;
+    set_port(addr, port);
+    return true;
+}
+
+/**
+ * Start resolving a hostname in the background.
+ *
+ * The resolution is done by a pool of resolver threads, and the descriptor
+ * from qsocket_resolve_fd() becomes readable when it's done. So it can be
+ * watched by an event loop along with the other descriptors.
+ *
+ * @param hostname  IP string address or hostname
+ * @param port      port number
+ * @param family    AF_INET, AF_INET6 or AF_UNSPEC for either.
+ *
+ * @return a pointer of qsocket_dns_t if successful, otherwise returns NULL.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @code
+ *   qsocket_dns_t *req = qsocket_resolve_async("www.qdecoder.org", 80,
+ *                                              AF_UNSPEC);
+ *   loop->add(loop, qsocket_resolve_fd(req), QEVLOOP_READ, resolved, req);
+ *
+ *   static void resolved(qevloop_t *loop, int fd, int events, void *userdata) {
+ *     qsocket_dns_t *req = (qsocket_dns_t *) userdata;
+ *     struct sockaddr_storage addr;
+ *     socklen_t addrlen;
+ *     bool ok = qsocket_resolve_result(req, &addr, &addrlen);
+ *     loop->remove(loop, fd);
+ *     qsocket_resolve_free(req);
+ *     ...
+ *   }
+ * @endcode
+ *
+ * @note
+ *  A cached name is done right away without a thread.
+ */
+qsocket_dns_t *qsocket_resolve_async(const char *hostname, int port,
+                                     int family) {
+    if (hostname == NULL
+            || (family != AF_UNSPEC && family != AF_INET
+                    && family != AF_INET6)) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    qsocket_dns_t *req = (qsocket_dns_t *) calloc(1, sizeof(qsocket_dns_t));
+    if (req == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    if (pipe(req->pipefd) != 0) {
+        free(req);
+        return NULL;
+    }
+    int i;
+    for (i = 0; i < 2; i++) {
+        fcntl(req->pipefd[i], F_SETFL,
+              fcntl(req->pipefd[i], F_GETFL, 0) | O_NONBLOCK);
+        fcntl(req->pipefd[i], F_SETFD, FD_CLOEXEC);
+    }
+    req->port = port;
+    req->family = family;
+    req->refcnt = 1;
+
+    // done by the cache
+    dnsaddr_t addrs[QSOCKET_DNS_MAXADDRS];
+    int naddrs = QSOCKET_DNS_MAXADDRS;
+    int error = cache_get(hostname, family, addrs, &naddrs);
+    if (error >= 0) {
+        if (error == 0) {
+            memcpy((void *) &req->addr, (void *) &addrs[0].addr,
+                   sizeof(req->addr));
+            req->addrlen = addrs[0].addrlen;
+        }
+        req->error = error;
+        req->done = true;
+        if (write(req->pipefd[1], "", 1) != 1) {
+            DEBUG("Can't wake up the caller.");
+        }
+        return req;
+    }
+
+    req->hostname = strdup(hostname);
+    if (req->hostname == NULL) {
+        release_req(req);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    // queue it up for a resolver thread
+    pthread_mutex_lock(&dns_lock);
+    req->refcnt++;
+    if (dns_jobs_last != NULL)
+        dns_jobs_last->next = req;
+    else
+        dns_jobs = req;
+    dns_jobs_last = req;
+
+    if (dns_idle == 0 && dns_threads < QSOCKET_DNS_THREADS) {
+        pthread_t tid;
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        if (pthread_create(&tid, &attr, resolver_main, NULL) == 0)
+            dns_threads++;
+        pthread_attr_destroy(&attr);
+    }
+    bool running = (dns_threads > 0);
+    pthread_cond_signal(&dns_cond);
+    pthread_mutex_unlock(&dns_lock);
+
+    if (running == false) {
+        DEBUG("Can't start a resolver thread.");
+        pthread_mutex_lock(&dns_lock);
+        dns_jobs = dns_jobs_last = NULL;
+        pthread_mutex_unlock(&dns_lock);
+        release_req(req);
+        release_req(req);
+        errno = EAGAIN;
+        return NULL;
+    }
+
+    return req;
+}
+
+/**
+ * Get the descriptor which becomes readable when the resolution is done.
+ *
+ * @param req       qsocket_dns_t pointer
+ *
+ * @return the descriptor to watch for reading.
+ */
+int qsocket_resolve_fd(qsocket_dns_t *req) {
+    return req->pipefd[0];
+}
+
+/**
+ * Get the result of a background resolution.
+ *
+ * @param req       qsocket_dns_t pointer
+ * @param addr      sockaddr_storage structure pointer to store the address.
+ * @param addrlen   set to the length of the address.
+ *
+ * @return true if resolved, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EINPROGRESS : Not done yet.
+ *  - ENOENT : No such host.
+ *  - EAGAIN : Temporary failure of the name server.
+ */
+bool qsocket_resolve_result(qsocket_dns_t *req, struct sockaddr_storage *addr,
+                            socklen_t *addrlen) {
+    pthread_mutex_lock(&dns_lock);
+    bool done = req->done;
+    pthread_mutex_unlock(&dns_lock);
+    if (done == false) {
+        errno = EINPROGRESS;
+        return false;
+    }
+    if (req->error != 0) {
+        errno = req->error;
+        return false;
     }
-    addr->sin_family = AF_INET;
-    addr->sin_port = htons(port);
 
+    memcpy((void *) addr, (void *) &req->addr, sizeof(req->addr));
+    *addrlen = req->addrlen;
+    set_port(addr, req->port);
     return true;
 }
 
+/**
+ * Free a background resolution, done or not.
+ *
+ * @param req       qsocket_dns_t pointer
+ *
+ * @note
+ *  The resolution a thread has started still completes and gets cached,
+ *  only the result is dropped. The one still queued is skipped.
+ */
+void qsocket_resolve_free(qsocket_dns_t *req) {
+    release_req(req);
+}
+
+/**
+ * Set how long the resolved names are cached.
+ *
+ * @param ttlsec    seconds to cache an address, 0 to disable caching.
+ * @param negttlsec seconds to cache a failure, 0 to disable caching it.
+ *
+ * @note
+ *  QSOCKET_DNS_TTL and QSOCKET_DNS_NEGTTL are the defaults. It applies to
+ *  the names cached from now on.
+ */
+void qsocket_set_dnscache(int ttlsec, int negttlsec) {
+    pthread_mutex_lock(&dns_lock);
+    dns_ttl = (ttlsec > 0) ? ttlsec : 0;
+    dns_negttl = (negttlsec > 0) ? negttlsec : 0;
+    pthread_mutex_unlock(&dns_lock);
+}
+
+/**
+ * Drop all the cached names.
+ */
+void qsocket_clear_dnscache(void) {
+    pthread_mutex_lock(&dns_lock);
+    int i;
+    for (i = 0; i < QSOCKET_DNS_CACHESIZE; i++) {
+        if (dns_cache[i].hostname != NULL)
+            free(dns_cache[i].hostname);
+        if (dns_cache[i].addrs != NULL)
+            free(dns_cache[i].addrs);
+        dns_cache[i].hostname = NULL;
+        dns_cache[i].addrs = NULL;
+    }
+    pthread_mutex_unlock(&dns_lock);
+}
+
 /**
  * Return local IP address.
  *
@@ -170,4 +596,325 @@ char *qsocket_get_localaddr(char *buf, size_t bufsize) {
     return buf;
 }
 
+#ifndef _DOXYGEN_SKIP
+
+// returns 0 or errno of the failure, from the cache if there.
+static int resolve_addrs(const char *hostname, int family, dnsaddr_t *addrs,
+                         int *naddrs) {
+    int error = cache_get(hostname, family, addrs, naddrs);
+    if (error < 0) {
+        error = lookup(hostname, family, addrs, naddrs);
+        cache_put(hostname, family, error, addrs, *naddrs);
+    }
+    return error;
+}
+
+// returns 0 or errno of the failure. The addresses take turns by family
+// with the preferred one first, so connect_race() tries both soon.
+static int lookup(const char *hostname, int family, dnsaddr_t *addrs,
+                  int *naddrs) {
+    struct addrinfo hints, *result = NULL;
+    memset((void *) &hints, 0, sizeof(hints));
+    hints.ai_family = family;
+    hints.ai_socktype = SOCK_STREAM;
+
+    int ret = getaddrinfo(hostname, NULL, &hints, &result);
+    if (ret != 0 || result == NULL) {
+        DEBUG("getaddrinfo(%s): %s", hostname, gai_strerror(ret));
+        *naddrs = 0;
+        return (ret == EAI_AGAIN) ? EAGAIN :
+               (ret == EAI_MEMORY) ? ENOMEM : ENOENT;
+    }
+
+    int max = *naddrs, num = 0;
+    struct addrinfo *first = result, *second = result;
+    while (num < max && (first != NULL || second != NULL)) {
+        // next one of the preferred family, then the other
+        while (first != NULL && first->ai_family != result->ai_family)
+            first = first->ai_next;
+        while (second != NULL && second->ai_family == result->ai_family)
+            second = second->ai_next;
+
+        struct addrinfo *ai;
+        int i;
+        for (i = 0; i < 2 && num < max; i++) {
+            ai = (i == 0) ? first : second;
+            if (ai == NULL || ai->ai_addrlen > sizeof(addrs[num].addr))
+                continue;
+            memset((void *) &addrs[num].addr, 0, sizeof(addrs[num].addr));
+            memcpy((void *) &addrs[num].addr, (void *) ai->ai_addr,
+                   ai->ai_addrlen);
+            addrs[num].addrlen = ai->ai_addrlen;
+            num++;
+        }
+        if (first != NULL)
+            first = first->ai_next;
+        if (second != NULL)
+            second = second->ai_next;
+    }
+    freeaddrinfo(result);
+
+    *naddrs = num;
+    return (num > 0) ? 0 : ENOENT;
+}
+
+// returns 0 or errno of the cached answer, -1 if not cached.
+static int cache_get(const char *hostname, int family, dnsaddr_t *addrs,
+                     int *naddrs) {
+    uint32_t hash = qhashmurmur3_32(hostname, strlen(hostname)) + family;
+    dnscache_t *slot = &dns_cache[hash % QSOCKET_DNS_CACHESIZE];
+
+    int error = -1;
+    pthread_mutex_lock(&dns_lock);
+    if (slot->hostname != NULL && slot->family == family
+            && !strcmp(slot->hostname, hostname)
+            && slot->expire > time(NULL)) {
+        error = slot->error;
+        if (error == 0) {
+            int num = (slot->naddrs < *naddrs) ? slot->naddrs : *naddrs;
+            memcpy((void *) addrs, (void *) slot->addrs,
+                   sizeof(dnsaddr_t) * num);
+            *naddrs = num;
+        }
+    }
+    pthread_mutex_unlock(&dns_lock);
+
+    return error;
+}
+
+static void cache_put(const char *hostname, int family, int error,
+                      const dnsaddr_t *addrs, int naddrs) {
+    // numeric addresses are resolved without asking anyone
+    // and temporary failures are worth retrying
+    unsigned char buf[sizeof(struct in6_addr)];
+    if ((error != 0 && error != ENOENT)
+            || inet_pton(AF_INET, hostname, buf) == 1
+            || inet_pton(AF_INET6, hostname, buf) == 1) {
+        return;
+    }
+
+    uint32_t hash = qhashmurmur3_32(hostname, strlen(hostname)) + family;
+    dnscache_t *slot = &dns_cache[hash % QSOCKET_DNS_CACHESIZE];
+
+    // prepare the copies out of the lock
+    char *name = strdup(hostname);
+    dnsaddr_t *copy = NULL;
+    if (error == 0) {
+        copy = (dnsaddr_t *) malloc(sizeof(dnsaddr_t) * naddrs);
+        if (copy != NULL)
+            memcpy((void *) copy, (void *) addrs, sizeof(dnsaddr_t) * naddrs);
+    }
+    if (name == NULL || (error == 0 && copy == NULL)) {
+        if (name != NULL)
+            free(name);
+        if (copy != NULL)
+            free(copy);
+        return;
+    }
+
+    pthread_mutex_lock(&dns_lock);
+    int ttl = (error == 0) ? dns_ttl : dns_negttl;
+    if (ttl > 0) {
+        // swap in the new entry and let the old one go below
+        char *oldname = slot->hostname;
+        dnsaddr_t *oldaddrs = slot->addrs;
+        slot->hostname = name;
+        slot->addrs = copy;
+        slot->naddrs = (error == 0) ? naddrs : 0;
+        slot->family = family;
+        slot->expire = time(NULL) + ttl;
+        slot->error = error;
+        name = oldname;
+        copy = oldaddrs;
+    }
+    pthread_mutex_unlock(&dns_lock);
+
+    if (name != NULL)
+        free(name);
+    if (copy != NULL)
+        free(copy);
+}
+
+static void set_port(struct sockaddr_storage *addr, int port) {
+    if (addr->ss_family == AF_INET6) {
+        ((struct sockaddr_in6 *) addr)->sin6_port = htons(port);
+    } else {
+        ((struct sockaddr_in *) addr)->sin_port = htons(port);
+    }
+}
+
+// returns the socket of the connection in progress, otherwise -1.
+static int connect_start(const dnsaddr_t *addr, bool *created) {
+    int sockfd = socket(addr->addr.ss_family, SOCK_STREAM, 0);
+    if (sockfd < 0)
+        return -1;
+    *created = true;
+
+    fcntl(sockfd, F_SETFL, fcntl(sockfd, F_GETFL, 0) | O_NONBLOCK);
+    if (connect(sockfd, (struct sockaddr *) &addr->addr, addr->addrlen) != 0
+            && errno != EINPROGRESS) {
+        int error = errno;
+        close(sockfd);
+        errno = error;
+        return -1;
+    }
+
+    return sockfd;
+}
+
+// returns the connected socket, otherwise -2 or -3 as qsocket_open() does.
+static int connect_race(const dnsaddr_t *addrs, int naddrs, int timeoutms) {
+    struct pollfd fds[QSOCKET_DNS_MAXADDRS];
+    int nfds = 0, next = 0, winner = -1;
+    bool created = false;
+    int error = ECONNREFUSED;
+    long deadline = (timeoutms >= 0) ? qtime_current_milli() + timeoutms : -1;
+
+    while (winner < 0) {
+        // start the next attempt when there's nothing else to wait
+        bool startnow = (nfds == 0);
+        while (startnow && next < naddrs) {
+            int sockfd = connect_start(&addrs[next++], &created);
+            if (sockfd >= 0) {
+                fds[nfds].fd = sockfd;
+                fds[nfds].events = POLLOUT;
+                fds[nfds].revents = 0;
+                nfds++;
+                break;
+            }
+            error = errno;
+        }
+        if (nfds == 0)
+            break;  // all failed
+
+        // wait up to the delay if there're more to try
+        int waitms = -1;
+        if (deadline >= 0) {
+            long left = deadline - qtime_current_milli();
+            waitms = (left > 0) ? (int) left : 0;
+        }
+        if (next < naddrs && (waitms < 0 || waitms > QSOCKET_CONNECT_DELAY))
+            waitms = QSOCKET_CONNECT_DELAY;
+
+        int ret = poll(fds, nfds, waitms);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            error = errno;
+            break;
+        }
+        if (ret == 0) {
+            if (deadline >= 0 && qtime_current_milli() >= deadline) {
+                error = ETIMEDOUT;
+                break;
+            }
+            if (next < naddrs) {
+                int sockfd = connect_start(&addrs[next++], &created);
+                if (sockfd >= 0) {
+                    fds[nfds].fd = sockfd;
+                    fds[nfds].events = POLLOUT;
+                    fds[nfds].revents = 0;
+                    nfds++;
+                }
+            }
+            continue;
+        }
+
+        int i;
+        for (i = 0; i < nfds;) {
+            if (fds[i].revents == 0) {
+                i++;
+                continue;
+            }
+            int soerr = 0;
+            socklen_t soerrlen = sizeof(soerr);
+            if (getsockopt(fds[i].fd, SOL_SOCKET, SO_ERROR, &soerr, &soerrlen)
+                    == 0 && soerr == 0) {
+                winner = fds[i].fd;
+                fds[i] = fds[--nfds];
+                break;
+            }
+
+            // drop the failed one
+            error = (soerr != 0) ? soerr : ECONNREFUSED;
+            close(fds[i].fd);
+            fds[i] = fds[--nfds];
+        }
+    }
+
+    // close the ones lost the race
+    int i;
+    for (i = 0; i < nfds; i++) {
+        close(fds[i].fd);
+    }
+
+    if (winner < 0) {
+        errno = error;
+        return (created) ? -3 : -2; /* connection failed */
+    }
+
+    /* restore to block socket */
+    fcntl(winner, F_SETFL, fcntl(winner, F_GETFL, 0) & ~O_NONBLOCK);
+    return winner;
+}
+
+static void *resolver_main(void *arg) {
+    pthread_mutex_lock(&dns_lock);
+    while (true) {
+        while (dns_jobs == NULL) {
+            dns_idle++;
+            pthread_cond_wait(&dns_cond, &dns_lock);
+            dns_idle--;
+        }
+
+        qsocket_dns_t *req = dns_jobs;
+        dns_jobs = req->next;
+        if (dns_jobs == NULL)
+            dns_jobs_last = NULL;
+
+        // skip the ones freed by the caller already
+        if (req->refcnt > 1) {
+            pthread_mutex_unlock(&dns_lock);
+            dnsaddr_t addrs[QSOCKET_DNS_MAXADDRS];
+            int naddrs = QSOCKET_DNS_MAXADDRS;
+            int error = resolve_addrs(req->hostname, req->family, addrs,
+                                      &naddrs);
+            pthread_mutex_lock(&dns_lock);
+
+            req->error = error;
+            if (error == 0) {
+                memcpy((void *) &req->addr, (void *) &addrs[0].addr,
+                       sizeof(req->addr));
+                req->addrlen = addrs[0].addrlen;
+            }
+            req->done = true;
+            if (write(req->pipefd[1], "", 1) != 1) {
+                DEBUG("Can't wake up the caller.");
+            }
+        }
+
+        pthread_mutex_unlock(&dns_lock);
+        release_req(req);
+        pthread_mutex_lock(&dns_lock);
+    }
+
+    return NULL;
+}
+
+static void release_req(qsocket_dns_t *req) {
+    pthread_mutex_lock(&dns_lock);
+    bool last = (--req->refcnt == 0);
+    pthread_mutex_unlock(&dns_lock);
+    if (last == false)
+        return;
+
+    close(req->pipefd[0]);
+    close(req->pipefd[1]);
+    if (req->hostname != NULL)
+        free(req->hostname);
+    free(req);
+}
+
+#endif /* _DOXYGEN_SKIP */
+
 #endif /* _WIN32 */
@@ -33,16 +33,52 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
 #include <stdarg.h>
 #include <ctype.h>
+#include <errno.h>
 #include <unistd.h>
+#include <pthread.h>
 #include <sys/time.h>
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 #include "qinternal.h"
 #include "utilities/qencode.h"
 #include "utilities/qhash.h"
 #include "utilities/qstring.h"
 
+#ifndef _DOXYGEN_SKIP
+
+static inline char *qstr_ptr(const qstr_t *s);
+static const char *find_token(const char *str, size_t len, const char *tok,
+                              size_t toklen);
+
+typedef struct qstrdelims_s delims_t;
+
+static pthread_once_t scan_once = PTHREAD_ONCE_INIT;
+static size_t (*scan_func)(const uint8_t *p, size_t len, const delims_t *d);
+static const char *(*scan_str_func)(const char *p, const delims_t *d);
+
+static void delims_init(delims_t *d, const char *delimiters, bool nul);
+static void scan_init(void);
+static size_t scan_delims(const char *p, size_t len, const delims_t *d);
+static char *scan_delims_str(char *p, const delims_t *d);
+static size_t scan_sw(const uint8_t *p, size_t len, const delims_t *d);
+static const char *scan_str_sw(const char *p, const delims_t *d);
+#if defined(__x86_64__) && defined(__GNUC__)
+static size_t scan_avx2(const uint8_t *p, size_t len, const delims_t *d);
+static const char *scan_str_avx2(const char *p, const delims_t *d);
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+static size_t scan_neon(const uint8_t *p, size_t len, const delims_t *d);
+static const char *scan_str_neon(const char *p, const delims_t *d);
+#endif
+
+#endif
+
 /**
  * Remove white spaces(including CR, LF) from head and tail of the string.
  *
@@ -241,66 +277,68 @@ char *qstrreplace(const char *mode, char *srcstr, const char *tokstr,
         return NULL;
     }
 
-    char *newstr, *newp, *srcp, *tokenp, *retp;
-    newstr = newp = srcp = tokenp = retp = NULL;
-
+    char *newstr, *newp, *retp;
+    const char *srcp;
     char method = mode[0], memuse = mode[1];
-    int maxstrlen, tokstrlen;
+    size_t srclen = strlen(srcstr), wordlen = strlen(word);
+    size_t maxstrlen, newlen;
 
     /* Put replaced string into malloced 'newstr' */
     if (method == 't') { /* Token replace */
-        maxstrlen = strlen(srcstr) * ((strlen(word) > 0) ? strlen(word) : 1);
+        maxstrlen = srclen * ((wordlen > 0) ? wordlen : 1);
         newstr = (char *) malloc(maxstrlen + 1);
         if (newstr == NULL)
             return NULL;
 
-        for (srcp = (char *) srcstr, newp = newstr; *srcp; srcp++) {
-            for (tokenp = (char *) tokstr; *tokenp; tokenp++) {
-                if (*srcp == *tokenp) {
-                    char *wordp;
-                    for (wordp = (char *) word; *wordp; wordp++) {
-                        *newp++ = *wordp;
-                    }
-                    break;
-                }
-            }
-            if (!*tokenp)
-                *newp++ = *srcp;
+        // copy the spans between the tokens at once
+        delims_t delims;
+        delims_init(&delims, tokstr, false);
+        const char *srcend = srcstr + srclen;
+        for (srcp = srcstr, newp = newstr; srcp < srcend; srcp++) {
+            size_t n = scan_delims(srcp, srcend - srcp, &delims);
+            memcpy(newp, srcp, n);
+            newp += n;
+            srcp += n;
+            if (srcp == srcend)
+                break;
+            memcpy(newp, word, wordlen);
+            newp += wordlen;
         }
-        *newp = '\0';
     } else if (method == 's') { /* String replace */
-        if (strlen(word) > strlen(tokstr)) {
-            maxstrlen = ((strlen(srcstr) / strlen(tokstr)) * strlen(word))
-                    + (strlen(srcstr) % strlen(tokstr));
+        size_t tokstrlen = strlen(tokstr);
+        if (tokstrlen > 0 && wordlen > tokstrlen) {
+            maxstrlen = ((srclen / tokstrlen) * wordlen) + (srclen % tokstrlen);
         } else {
-            maxstrlen = strlen(srcstr);
+            maxstrlen = srclen;
         }
         newstr = (char *) malloc(maxstrlen + 1);
         if (newstr == NULL)
             return NULL;
 
-        tokstrlen = strlen(tokstr);
-
-        for (srcp = srcstr, newp = newstr; *srcp; srcp++) {
-            if (!strncmp(srcp, tokstr, tokstrlen)) {
-                char *wordp;
-                for (wordp = (char *) word; *wordp; wordp++)
-                    *newp++ = *wordp;
-                srcp += tokstrlen - 1;
-            } else
-                *newp++ = *srcp;
+        const char *match;
+        for (srcp = srcstr, newp = newstr;
+             tokstrlen > 0 && (match = strstr(srcp, tokstr)) != NULL;
+             srcp = match + tokstrlen) {
+            memcpy(newp, srcp, match - srcp);
+            newp += match - srcp;
+            memcpy(newp, word, wordlen);
+            newp += wordlen;
         }
-        *newp = '\0';
+        size_t n = srclen - (srcp - srcstr);
+        memcpy(newp, srcp, n);
+        newp += n;
     } else {
         DEBUG("Unknown mode \"%s\".", mode);
         return NULL;
     }
+    *newp = '\0';
+    newlen = newp - newstr;
 
     /* decide whether newing the memory or replacing into exist one */
     if (memuse == 'n')
         retp = newstr;
     else if (memuse == 'r') {
-        strcpy(srcstr, newstr);
+        memcpy(srcstr, newstr, newlen + 1);
         free(newstr);
         retp = srcstr;
     } else {
@@ -431,6 +469,10 @@ void *qmemdup(const void *data, size_t size) {
  * @param format    string format to append
  *
  * @return a pointer of str if successful, otherwise returns NULL
+ *
+ * @note
+ *  The string is scanned for its end on every call. To build a string with
+ *  many appends, qstr_appendf() keeps the length and grows the buffer.
  */
 char *qstrcatf(char *str, const char *format, ...) {
     char *buf;
@@ -581,22 +623,17 @@ char *qstrlower(char *str) {
  *  returns "a", "b", "", "d". But strtok() returns "a","b","d".
  */
 char *qstrtok(char *str, const char *delimiters, char *retstop, int *offset) {
-    char *tokensp, *tokenep;
-
-    tokensp = tokenep = (char *) (str + *offset);
-    int numdel = strlen(delimiters);
-    for (; *tokenep; tokenep++) {
-        int j;
-        for (j = 0; j < numdel; j++) {
-            if (*tokenep == delimiters[j]) {
-                if (retstop != NULL)
-                    *retstop = delimiters[j];
-                *tokenep = '\0';
-                tokenep++;
-                *offset = tokenep - str;
-                return tokensp;
-            }
-        }
+    delims_t delims;
+    delims_init(&delims, delimiters, true);
+
+    char *tokensp = str + *offset;
+    char *tokenep = scan_delims_str(tokensp, &delims);
+    if (*tokenep != '\0') {
+        if (retstop != NULL)
+            *retstop = *tokenep;
+        *tokenep = '\0';
+        *offset = tokenep + 1 - str;
+        return tokensp;
     }
 
     if (retstop != NULL)
@@ -631,20 +668,79 @@ qlist_t *qstrtokenizer(const char *str, const char *delimiters) {
     if (list == NULL)
         return NULL;
 
-    int i;
     char *dupstr = strdup(str);
-    char *token;
-    int offset = 0;
-    for (i = 1, token = qstrtok(dupstr, delimiters, NULL, &offset);
-            token != NULL;
-            token = qstrtok(dupstr, delimiters, NULL, &offset), i++) {
-        list->addlast(list, token, strlen(token) + 1);
+    if (dupstr == NULL) {
+        list->free(list);
+        return NULL;
+    }
+
+    size_t len = strlen(dupstr);
+    qtoken_t obj;
+    memset((void *) &obj, 0, sizeof(obj));
+    while (qstrtok_getnext(dupstr, len, delimiters, &obj)) {
+        ((char *) obj.token)[obj.tokensize] = '\0';
+        list->addlast(list, obj.token, obj.tokensize + 1);
     }
     free(dupstr);
 
     return list;
 }
 
+/**
+ * Get the next token of a string without copying.
+ *
+ * The token is the slice of the string as it is, which is not terminated by
+ * NULL character. The string is not modified, so it can be a read-only
+ * buffer such as a mapped file.
+ *
+ * @param str           source string
+ * @param len           the length of str.
+ * @param delimiters    string that specifies a set of delimiters that may
+ *                      surround the token being extracted
+ * @param obj           found token will be stored in this object.
+ *
+ * @return true if found otherwise returns false.
+ *
+ * @code
+ *  const char *line = "Hello,world|Thank,you";
+ *  qtoken_t obj;
+ *  memset((void *) &obj, 0, sizeof(obj)); // must be cleared before call
+ *  while (qstrtok_getnext(line, strlen(line), "|,", &obj)) {
+ *    printf("%.*s\n", (int) obj.tokensize, obj.token);
+ *  }
+ * @endcode
+ *
+ * @note
+ *  The tokens are the same as qstrtok() returns, including empty ones. The
+ *  delimiter set is prepared at the first call, so the same delimiters must
+ *  be given until the end. The delimiters are matched 32 bytes at a time
+ *  with AVX2 or 16 bytes with NEON, using nibble lookup tables which hold
+ *  up to 8 distinct high nibbles of the delimiters, which covers the usual
+ *  punctuation and white space sets.
+ */
+bool qstrtok_getnext(const char *str, size_t len, const char *delimiters,
+                     qtoken_t *obj) {
+    if (str == NULL || delimiters == NULL || obj == NULL || obj->next >= len) {
+        return false;
+    }
+
+    if (obj->ready == false) {
+        delims_init(&obj->delims, delimiters, false);
+        obj->ready = true;
+    }
+
+    const char *start = str + obj->next;
+    size_t left = len - obj->next;
+    size_t toklen = scan_delims(start, left, &obj->delims);
+
+    obj->token = start;
+    obj->tokensize = toklen;
+    obj->stop = (toklen < left) ? start[toklen] : '\0';
+    obj->next += toklen + 1;
+
+    return true;
+}
+
 /**
  * Generate unique id
  *
@@ -899,3 +995,563 @@ char *qstr_conv_encoding(const char *str, const char *fromcode,
     return NULL;
 #endif
 }
+
+/**
+ * Initialize a string builder.
+ *
+ * qstr_t keeps the length and the capacity of the string, so appending to it
+ * costs amortized O(1) per byte and never rescans the string. A string up to
+ * QSTR_INLINESIZE - 1 bytes is kept inside the structure without malloc.
+ *
+ * @param s         qstr_t structure pointer to initialize.
+ *
+ * @code
+ *   qstr_t s;
+ *   qstr_init(&s);
+ *   int i;
+ *   for (i = 0; i < 100; i++) {
+ *     qstr_appendf(&s, "%d,", i);
+ *   }
+ *   printf("%s\n", qstr_cstr(&s));
+ *   qstr_free(&s);
+ * @endcode
+ *
+ * @note
+ *  A qstr_t can be copied by value or moved as a plain structure, but only
+ *  one of the copies may be freed.
+ */
+void qstr_init(qstr_t *s) {
+    s->len = 0;
+    s->cap = 0;
+    s->buf.inl[0] = '\0';
+}
+
+/**
+ * Make room for a string of the given length.
+ *
+ * @param s         qstr_t structure pointer.
+ * @param size      string length to hold, not counting the NUL.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - ENOMEM : Memory allocation failure.
+ */
+bool qstr_reserve(qstr_t *s, size_t size) {
+    size_t cap = (s->cap > 0) ? s->cap : QSTR_INLINESIZE;
+    if (size < cap)
+        return true;
+
+    // grow by doubling, so repeated appends are amortized O(1).
+    size_t newcap = cap * 2;
+    if (newcap < size + 1)
+        newcap = size + 1;
+
+    char *buf;
+    if (s->cap > 0) {
+        buf = (char *) realloc(s->buf.heap, newcap);
+    } else {
+        buf = (char *) malloc(newcap);
+        if (buf != NULL)
+            memcpy(buf, s->buf.inl, s->len + 1);
+    }
+    if (buf == NULL) {
+        errno = ENOMEM;
+        return false;
+    }
+
+    s->buf.heap = buf;
+    s->cap = newcap;
+    return true;
+}
+
+/**
+ * Append data to the string.
+ *
+ * @param s         qstr_t structure pointer.
+ * @param data      data to append. It may point into the string itself.
+ * @param size      size of data
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - ENOMEM : Memory allocation failure.
+ */
+bool qstr_append(qstr_t *s, const void *data, size_t size) {
+    if (size == 0)
+        return true;
+    if (data == NULL) {
+        errno = EINVAL;
+        return false;
+    }
+
+    // data can move along with the buffer.
+    const char *ptr = qstr_ptr(s);
+    const char *src = (const char *) data;
+    bool inside = (src >= ptr && src <= ptr + s->len);
+    size_t off = src - ptr;
+
+    if (qstr_reserve(s, s->len + size) == false)
+        return false;
+
+    ptr = qstr_ptr(s);
+    if (inside)
+        src = ptr + off;
+    memmove((char *) ptr + s->len, src, size);
+    s->len += size;
+    ((char *) ptr)[s->len] = '\0';
+
+    return true;
+}
+
+/**
+ * Append a string to the string.
+ *
+ * @param s         qstr_t structure pointer.
+ * @param str       string to append.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - ENOMEM : Memory allocation failure.
+ */
+bool qstr_appendstr(qstr_t *s, const char *str) {
+    if (str == NULL) {
+        errno = EINVAL;
+        return false;
+    }
+    return qstr_append(s, str, strlen(str));
+}
+
+/**
+ * Append a formatted string to the string.
+ *
+ * @param s         qstr_t structure pointer.
+ * @param format    string format to append
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid format.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @note
+ *  The string is formatted right into the free space of the buffer, which
+ *  is grown only when it doesn't fit. So the arguments must not point into
+ *  the string itself.
+ */
+bool qstr_appendf(qstr_t *s, const char *format, ...) {
+    char *ptr = qstr_ptr(s);
+    size_t avail = ((s->cap > 0) ? s->cap : QSTR_INLINESIZE) - s->len;
+
+    va_list arglist;
+    va_start(arglist, format);
+    int n = vsnprintf(ptr + s->len, avail, format, arglist);
+    va_end(arglist);
+    if (n < 0) {
+        ptr[s->len] = '\0';
+        errno = EINVAL;
+        return false;
+    }
+
+    if ((size_t) n >= avail) {
+        ptr[s->len] = '\0';
+        if (qstr_reserve(s, s->len + n) == false)
+            return false;
+        ptr = qstr_ptr(s);
+        va_start(arglist, format);
+        vsnprintf(ptr + s->len, n + 1, format, arglist);
+        va_end(arglist);
+    }
+    s->len += n;
+
+    return true;
+}
+
+/**
+ * Replace every occurrence of a string with a word.
+ *
+ * @param s         qstr_t structure pointer.
+ * @param tokstr    string to find
+ * @param word      word to put in place of tokstr
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @note
+ *  It works like qstrreplace() with "sr" mode in a single pass. When the
+ *  word isn't longer than tokstr, the string is rewritten in place.
+ */
+bool qstr_replace(qstr_t *s, const char *tokstr, const char *word) {
+    if (tokstr == NULL || word == NULL || *tokstr == '\0') {
+        errno = EINVAL;
+        return false;
+    }
+
+    size_t toklen = strlen(tokstr), wordlen = strlen(word);
+    char *ptr = qstr_ptr(s), *end = ptr + s->len;
+    const char *src, *match;
+
+    if (wordlen <= toklen) {
+        char *dst = ptr;
+        for (src = ptr; (match = find_token(src, end - src, tokstr, toklen))
+                        != NULL; src = match + toklen) {
+            memmove(dst, src, match - src);
+            dst += match - src;
+            memcpy(dst, word, wordlen);
+            dst += wordlen;
+        }
+        memmove(dst, src, end - src);
+        dst += end - src;
+        *dst = '\0';
+        s->len = dst - ptr;
+        return true;
+    }
+
+    size_t count = 0;
+    for (src = ptr; (match = find_token(src, end - src, tokstr, toklen))
+                    != NULL; src = match + toklen) {
+        count++;
+    }
+    if (count == 0)
+        return true;
+
+    qstr_t tmp;
+    qstr_init(&tmp);
+    if (qstr_reserve(&tmp, s->len + count * (wordlen - toklen)) == false)
+        return false;
+    for (src = ptr; (match = find_token(src, end - src, tokstr, toklen))
+                    != NULL; src = match + toklen) {
+        qstr_append(&tmp, src, match - src);
+        qstr_append(&tmp, word, wordlen);
+    }
+    qstr_append(&tmp, src, end - src);
+
+    qstr_free(s);
+    *s = tmp;
+    return true;
+}
+
+/**
+ * Remove white spaces(including CR, LF) from head and tail of the string.
+ *
+ * @param s         qstr_t structure pointer.
+ */
+void qstr_trim(qstr_t *s) {
+    char *ptr = qstr_ptr(s);
+    size_t head, tail;
+
+    for (tail = s->len; tail > 0; tail--) {
+        char c = ptr[tail - 1];
+        if (c != ' ' && c != '\t' && c != '\r' && c != '\n')
+            break;
+    }
+    for (head = 0; head < tail; head++) {
+        char c = ptr[head];
+        if (c != ' ' && c != '\t' && c != '\r' && c != '\n')
+            break;
+    }
+
+    if (head > 0)
+        memmove(ptr, ptr + head, tail - head);
+    s->len = tail - head;
+    ptr[s->len] = '\0';
+}
+
+/**
+ * Convert the string to uppercase.
+ *
+ * @param s         qstr_t structure pointer.
+ */
+void qstr_upper(qstr_t *s) {
+    char *ptr = qstr_ptr(s);
+    size_t i;
+    for (i = 0; i < s->len; i++) {
+        ptr[i] = toupper((unsigned char) ptr[i]);
+    }
+}
+
+/**
+ * Convert the string to lowercase.
+ *
+ * @param s         qstr_t structure pointer.
+ */
+void qstr_lower(qstr_t *s) {
+    char *ptr = qstr_ptr(s);
+    size_t i;
+    for (i = 0; i < s->len; i++) {
+        ptr[i] = tolower((unsigned char) ptr[i]);
+    }
+}
+
+/**
+ * Shorten the string. The buffer is kept for the next appends.
+ *
+ * @param s         qstr_t structure pointer.
+ * @param len       new length. Set to 0 to empty the string. Nothing is
+ *                  done if it's not shorter than the string.
+ */
+void qstr_truncate(qstr_t *s, size_t len) {
+    if (len < s->len) {
+        s->len = len;
+        qstr_ptr(s)[len] = '\0';
+    }
+}
+
+/**
+ * Get the length of the string.
+ *
+ * @param s         qstr_t structure pointer.
+ *
+ * @return the length of the string without the terminating NUL.
+ */
+size_t qstr_len(const qstr_t *s) {
+    return s->len;
+}
+
+/**
+ * Get the string as a C string.
+ *
+ * @param s         qstr_t structure pointer.
+ *
+ * @return a pointer of the NUL terminated string, which is valid until the
+ *         string is changed or freed.
+ *
+ * @note
+ *  The string can contain NUL bytes when binary data was appended, so
+ *  qstr_len() should be used for its length.
+ */
+const char *qstr_cstr(const qstr_t *s) {
+    return qstr_ptr(s);
+}
+
+/**
+ * Take the string out as a malloced C string.
+ *
+ * @param s         qstr_t structure pointer. It's emptied.
+ *
+ * @return a pointer of malloced string if successful, otherwise returns NULL
+ * @retval errno will be set in error condition.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @note
+ *  The heap buffer is handed over without copying. The returned string
+ *  can be given to the char * functions and must be freed by the caller.
+ */
+char *qstr_detach(qstr_t *s) {
+    char *str;
+    if (s->cap > 0) {
+        str = s->buf.heap;
+    } else {
+        str = (char *) malloc(s->len + 1);
+        if (str == NULL) {
+            errno = ENOMEM;
+            return NULL;
+        }
+        memcpy(str, s->buf.inl, s->len + 1);
+    }
+
+    qstr_init(s);
+    return str;
+}
+
+/**
+ * Free the string buffer. The string is left empty and can be used again.
+ *
+ * @param s         qstr_t structure pointer.
+ */
+void qstr_free(qstr_t *s) {
+    if (s->cap > 0)
+        free(s->buf.heap);
+    qstr_init(s);
+}
+
+#ifndef _DOXYGEN_SKIP
+
+static inline char *qstr_ptr(const qstr_t *s) {
+    return (s->cap > 0) ? s->buf.heap : (char *) s->buf.inl;
+}
+
+static const char *find_token(const char *str, size_t len, const char *tok,
+                              size_t toklen) {
+    const char *end = str + len;
+    while ((size_t) (end - str) >= toklen) {
+        str = memchr(str, tok[0], end - str - toklen + 1);
+        if (str == NULL)
+            return NULL;
+        if (memcmp(str, tok, toklen) == 0)
+            return str;
+        str++;
+    }
+    return NULL;
+}
+
+// The delimiters are put into up to 8 buckets by the high nibble. A byte
+// matches when the buckets of its low nibble and high nibble meet, which is
+// a pair of table lookups by PSHUFB or TBL for a whole vector.
+static void delims_init(delims_t *d, const char *delimiters, bool nul) {
+    memset((void *) d, 0, sizeof(delims_t));
+    d->vec = true;
+
+    unsigned char buckets[8];
+    int nbuckets = 0;
+    const unsigned char *dp = (const unsigned char *) delimiters;
+    for (;; dp++) {
+        unsigned char c = *dp;
+        if (c == '\0' && nul == false)
+            break;
+        d->map[c >> 3] |= (1 << (c & 7));
+
+        int b;
+        for (b = 0; b < nbuckets && buckets[b] != (c >> 4); b++);
+        if (b == nbuckets) {
+            if (nbuckets == 8) {
+                d->vec = false;
+            } else {
+                buckets[nbuckets++] = c >> 4;
+            }
+        }
+        if (b < 8) {
+            d->lo[c & 0x0f] |= (1 << b);
+            d->hi[c >> 4] |= (1 << b);
+        }
+        if (c == '\0')
+            break;
+    }
+}
+
+static void scan_init(void) {
+    scan_func = scan_sw;
+    scan_str_func = scan_str_sw;
+#if defined(__x86_64__) && defined(__GNUC__)
+    if (__builtin_cpu_supports("avx2")) {
+        scan_func = scan_avx2;
+        scan_str_func = scan_str_avx2;
+    }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+    scan_func = scan_neon;
+    scan_str_func = scan_str_neon;
+#endif
+}
+
+// length of the leading bytes which are not delimiters.
+static size_t scan_delims(const char *p, size_t len, const delims_t *d) {
+    pthread_once(&scan_once, scan_init);
+    if (d->vec == false)
+        return scan_sw((const uint8_t *) p, len, d);
+    return scan_func((const uint8_t *) p, len, d);
+}
+
+// the first delimiter or the terminating NUL, which must be in the set.
+static char *scan_delims_str(char *p, const delims_t *d) {
+    pthread_once(&scan_once, scan_init);
+    if (d->vec == false)
+        return (char *) scan_str_sw(p, d);
+    return (char *) scan_str_func(p, d);
+}
+
+static size_t scan_sw(const uint8_t *p, size_t len, const delims_t *d) {
+    size_t i;
+    for (i = 0; i < len; i++) {
+        if (d->map[p[i] >> 3] & (1 << (p[i] & 7)))
+            break;
+    }
+    return i;
+}
+
+static const char *scan_str_sw(const char *p, const delims_t *d) {
+    const uint8_t *up = (const uint8_t *) p;
+    while ((d->map[*up >> 3] & (1 << (*up & 7))) == 0)
+        up++;
+    return (const char *) up;
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+__attribute__((target("avx2")))
+static inline uint32_t delims_match_avx2(__m256i v, __m256i lo, __m256i hi) {
+    const __m256i m4 = _mm256_set1_epi8(0x0f);
+    __m256i l = _mm256_shuffle_epi8(lo, _mm256_and_si256(v, m4));
+    __m256i h = _mm256_shuffle_epi8(hi,
+                                    _mm256_and_si256(_mm256_srli_epi16(v, 4), m4));
+    __m256i z = _mm256_cmpeq_epi8(_mm256_and_si256(l, h),
+                                  _mm256_setzero_si256());
+    return ~(uint32_t) _mm256_movemask_epi8(z);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_avx2(const uint8_t *p, size_t len, const delims_t *d) {
+    const __m256i lo = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128((const __m128i *) d->lo));
+    const __m256i hi = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128((const __m128i *) d->hi));
+
+    size_t i;
+    for (i = 0; i + 32 <= len; i += 32) {
+        uint32_t mask = delims_match_avx2(
+                _mm256_loadu_si256((const __m256i *) (p + i)), lo, hi);
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+    return i + scan_sw(p + i, len - i, d);
+}
+
+// aligned loads never cross a page, so reading past the NUL is safe.
+__attribute__((target("avx2"), no_sanitize_address))
+static const char *scan_str_avx2(const char *p, const delims_t *d) {
+    const __m256i lo = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128((const __m128i *) d->lo));
+    const __m256i hi = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128((const __m128i *) d->hi));
+
+    size_t skip = (uintptr_t) p & 31;
+    const uint8_t *ap = (const uint8_t *) p - skip;
+    uint32_t mask = delims_match_avx2(_mm256_load_si256((const __m256i *) ap),
+                                      lo, hi) & (~0U << skip);
+    while (mask == 0) {
+        ap += 32;
+        mask = delims_match_avx2(_mm256_load_si256((const __m256i *) ap), lo, hi);
+    }
+    return (const char *) ap + __builtin_ctz(mask);
+}
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+// 4 bits per byte of the matches
+static inline uint64_t delims_match_neon(uint8x16_t v, uint8x16_t lo,
+                                         uint8x16_t hi) {
+    uint8x16_t l = vqtbl1q_u8(lo, vandq_u8(v, vdupq_n_u8(0x0f)));
+    uint8x16_t h = vqtbl1q_u8(hi, vshrq_n_u8(v, 4));
+    uint8x16_t m = vtstq_u8(l, h);
+    return vget_lane_u64(vreinterpret_u64_u8(
+            vshrn_n_u16(vreinterpretq_u16_u8(m), 4)), 0);
+}
+
+static size_t scan_neon(const uint8_t *p, size_t len, const delims_t *d) {
+    const uint8x16_t lo = vld1q_u8(d->lo);
+    const uint8x16_t hi = vld1q_u8(d->hi);
+
+    size_t i;
+    for (i = 0; i + 16 <= len; i += 16) {
+        uint64_t mask = delims_match_neon(vld1q_u8(p + i), lo, hi);
+        if (mask != 0)
+            return i + (__builtin_ctzll(mask) >> 2);
+    }
+    return i + scan_sw(p + i, len - i, d);
+}
+
+// aligned loads never cross a page, so reading past the NUL is safe.
+__attribute__((no_sanitize_address))
+static const char *scan_str_neon(const char *p, const delims_t *d) {
+    const uint8x16_t lo = vld1q_u8(d->lo);
+    const uint8x16_t hi = vld1q_u8(d->hi);
+
+    size_t skip = (uintptr_t) p & 15;
+    const uint8_t *ap = (const uint8_t *) p - skip;
+    uint64_t mask = delims_match_neon(vld1q_u8(ap), lo, hi) & (~0ULL << (skip * 4));
+    while (mask == 0) {
+        ap += 16;
+        mask = delims_match_neon(vld1q_u8(ap), lo, hi);
+    }
+    return (const char *) ap + (__builtin_ctzll(mask) >> 2);
+}
+#endif
+
+#endif /* _DOXYGEN_SKIP */
@@ -0,0 +1,745 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/**
+ * @file qthreadpool.c Work stealing thread pool.
+ *
+ * Each worker thread owns a qdeque of tasks. A task submitted from a worker
+ * is pushed to its own deque and popped back in the LIFO order while it's
+ * still warm in the cache, and idle workers steal from the other end of
+ * the others. Tasks submitted from outside go to a shared inbox, since
+ * only the owner can push to a deque.
+ *
+ * A thread waiting for a future or a parallel loop runs the queued tasks
+ * meanwhile instead of blocking, so tasks can wait for the subtasks they
+ * submitted, and the caller of qthreadpool_parallel_for() works on the
+ * loop together with the workers.
+ *
+ * @code
+ *   static void *square(void *arg) {
+ *       intptr_t n = (intptr_t) arg;
+ *       return (void *) (n * n);
+ *   }
+ *
+ *   static void add_range(size_t begin, size_t end, void *userdata) {
+ *       double *values = (double *) userdata;
+ *       size_t i;
+ *       for (i = begin; i < end; i++) {
+ *           values[i] += 1.0;
+ *       }
+ *   }
+ *
+ *   qthreadpool_t *pool = qthreadpool(0);  // a thread per CPU
+ *
+ *   qthreadpool_future_t *future = qthreadpool_async(pool, square,
+ *                                                    (void *) 12);
+ *   intptr_t result = (intptr_t) qthreadpool_future_get(future);
+ *   qthreadpool_future_free(future);
+ *
+ *   qthreadpool_parallel_for(pool, 0, 1000000, 0, add_range, values);
+ *
+ *   qthreadpool_free(pool);  // finishes the queued tasks first
+ * @endcode
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include "qinternal.h"
+#include "containers/qdeque.h"
+#include "utilities/qthreadpool.h"
+
+#define DEFAULT_GRAIN_SPLIT (8)     /* chunks per thread if grain is 0 */
+
+#ifndef _DOXYGEN_SKIP
+
+typedef struct qthreadpool_task_s qthreadpool_task_t;
+typedef struct qthreadpool_worker_s qthreadpool_worker_t;
+typedef struct qthreadpool_loop_s qthreadpool_loop_t;
+
+struct qthreadpool_task_s {
+    qthreadpool_func_t func;
+    void *arg;
+    qthreadpool_future_t *future;   /* NULL if nobody waits for it */
+    qthreadpool_task_t *next;       /* link in the inbox */
+};
+
+struct qthreadpool_worker_s {
+    qthreadpool_t *pool;
+    qdeque_t *deque;
+};
+
+struct qthreadpool_future_s {
+    qthreadpool_t *pool;
+    size_t pending;             /* 1 until the task returns */
+    void *result;
+};
+
+struct qthreadpool_loop_s {
+    qthreadpool_t *pool;
+    qthreadpool_range_t func;
+    void *userdata;
+    size_t begin;
+    size_t end;
+    size_t grain;
+    size_t nchunks;
+    size_t nextchunk;
+    size_t helpers;             /* helper tasks not finished yet */
+};
+
+static __thread qthreadpool_worker_t *curworker = NULL;
+
+static void *worker_main(void *arg);
+static qthreadpool_worker_t *get_self(qthreadpool_t *pool);
+static bool push_task(qthreadpool_t *pool, qthreadpool_func_t func,
+                      void *arg, qthreadpool_future_t *future);
+static qthreadpool_task_t *take_task(qthreadpool_t *pool);
+static void run_task(qthreadpool_t *pool, qthreadpool_task_t *task);
+static void wait_zero(qthreadpool_t *pool, size_t *counter);
+static void wakeup(qthreadpool_t *pool, bool all);
+static bool closed(qthreadpool_t *pool);
+static void *loop_main(void *arg);
+static void loop_run(qthreadpool_loop_t *loop);
+static void release(qthreadpool_t *pool);
+
+#endif
+
+/**
+ * Create a thread pool.
+ *
+ * @param nthreads  number of the worker threads, 0 for the number of CPUs.
+ *
+ * @return a pointer of qthreadpool_t if successful, otherwise returns NULL.
+ * @retval errno will be set in error condition.
+ *  - ENOMEM : Memory allocation failure.
+ *  - EAGAIN : Unable to create more threads.
+ *
+ * @code
+ *   qthreadpool_t *pool = qthreadpool(0);
+ * @endcode
+ */
+qthreadpool_t *qthreadpool(int nthreads) {
+    if (nthreads <= 0) {
+        long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = (ncpus > 0) ? (int) ncpus : 1;
+    }
+
+    qthreadpool_t *pool = (qthreadpool_t *) calloc(1, sizeof(qthreadpool_t));
+    if (pool == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    pool->nthreads = nthreads;
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+
+    pool->threads = (pthread_t *) calloc(nthreads, sizeof(pthread_t));
+    pool->workers = calloc(nthreads, sizeof(qthreadpool_worker_t));
+    if (pool->threads == NULL || pool->workers == NULL) {
+        free(pool->threads);
+        free(pool->workers);
+        pool->workers = NULL;
+        release(pool);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    qthreadpool_worker_t *workers = (qthreadpool_worker_t *) pool->workers;
+    bool allocated = true;
+    int i;
+    for (i = 0; i < nthreads; i++) {
+        workers[i].pool = pool;
+        workers[i].deque = qdeque(0);
+        if (workers[i].deque == NULL) {
+            allocated = false;
+        }
+    }
+    if (allocated == false) {
+        free(pool->threads);
+        pool->threads = NULL;
+        release(pool);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    for (i = 0; i < nthreads; i++) {
+        int ret = pthread_create(&pool->threads[i], NULL, worker_main,
+                                 &workers[i]);
+        if (ret != 0) {
+            DEBUG("qthreadpool: can't create a thread. [%d]", ret);
+            pthread_mutex_lock(&pool->mutex);
+            pool->shutdown = true;
+            pthread_cond_broadcast(&pool->cond);
+            pthread_mutex_unlock(&pool->mutex);
+            while (i-- > 0) {
+                pthread_join(pool->threads[i], NULL);
+            }
+            free(pool->threads);
+            release(pool);
+            errno = ret;
+            return NULL;
+        }
+    }
+
+    return pool;
+}
+
+/**
+ * Submit a task to the pool.
+ *
+ * @param pool  qthreadpool_t pointer.
+ * @param func  task function, its return value is discarded.
+ * @param arg   argument passed to the task function.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - ECANCELED : The pool has been shut down.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @note
+ *  Use qthreadpool_wait() to wait until all the submitted tasks finish, or
+ *  qthreadpool_async() for a task to be waited alone.
+ */
+bool qthreadpool_submit(qthreadpool_t *pool, qthreadpool_func_t func,
+                        void *arg) {
+    if (pool == NULL || func == NULL) {
+        errno = EINVAL;
+        return false;
+    }
+    if (closed(pool)) {
+        errno = ECANCELED;
+        return false;
+    }
+
+    return push_task(pool, func, arg, NULL);
+}
+
+/**
+ * Submit a task to the pool and get a future of its result.
+ *
+ * @param pool  qthreadpool_t pointer.
+ * @param func  task function.
+ * @param arg   argument passed to the task function.
+ *
+ * @return a malloced future if successful, otherwise returns NULL.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *  - ECANCELED : The pool has been shut down.
+ *  - ENOMEM : Memory allocation failure.
+ *
+ * @code
+ *   qthreadpool_future_t *future = qthreadpool_async(pool, task, arg);
+ *   (...do something else...)
+ *   void *result = qthreadpool_future_get(future);
+ *   qthreadpool_future_free(future);
+ * @endcode
+ *
+ * @note
+ *  The future must be released with qthreadpool_future_free().
+ */
+qthreadpool_future_t *qthreadpool_async(qthreadpool_t *pool,
+                                        qthreadpool_func_t func, void *arg) {
+    if (pool == NULL || func == NULL) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (closed(pool)) {
+        errno = ECANCELED;
+        return NULL;
+    }
+
+    qthreadpool_future_t *future = (qthreadpool_future_t *) malloc(
+            sizeof(qthreadpool_future_t));
+    if (future == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    future->pool = pool;
+    future->pending = 1;
+    future->result = NULL;
+
+    if (push_task(pool, func, arg, future) == false) {
+        free(future);
+        return NULL;
+    }
+    return future;
+}
+
+/**
+ * Wait for the task of a future and get its result.
+ *
+ * @param future    qthreadpool_future_t pointer.
+ *
+ * @return the return value of the task function.
+ *
+ * @note
+ *  The calling thread runs other queued tasks while waiting, so it's safe
+ *  to wait for a subtask from inside a task.
+ */
+void *qthreadpool_future_get(qthreadpool_future_t *future) {
+    if (future == NULL) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    wait_zero(future->pool, &future->pending);
+    return future->result;
+}
+
+/**
+ * Check whether the task of a future has finished.
+ *
+ * @param future    qthreadpool_future_t pointer.
+ *
+ * @return true if finished, otherwise returns false.
+ */
+bool qthreadpool_future_done(qthreadpool_future_t *future) {
+    return (__atomic_load_n(&future->pending, __ATOMIC_ACQUIRE) == 0);
+}
+
+/**
+ * Release a future.
+ *
+ * @param future    qthreadpool_future_t pointer.
+ *
+ * @note
+ *  It waits for the task first if it hasn't finished yet.
+ */
+void qthreadpool_future_free(qthreadpool_future_t *future) {
+    if (future == NULL) {
+        return;
+    }
+
+    wait_zero(future->pool, &future->pending);
+    free(future);
+}
+
+/**
+ * Run a loop over a range of indexes in parallel.
+ *
+ * The range [begin, end) is split into chunks of grain indexes and func is
+ * called for each chunk with its sub-range. The calling thread takes chunks
+ * as well and returns when all of them are done.
+ *
+ * @param pool      qthreadpool_t pointer, NULL to run in the calling thread.
+ * @param begin     first index.
+ * @param end       index after the last one.
+ * @param grain     indexes per chunk, 0 to split the range into several
+ *                  chunks per thread.
+ * @param func      function called for each chunk.
+ * @param userdata  user data passed to the function.
+ *
+ * @return true if successful, otherwise returns false.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid argument.
+ *
+ * @code
+ *   static void sum_range(size_t begin, size_t end, void *userdata) {
+ *       int64_t sum = 0;
+ *       size_t i;
+ *       for (i = begin; i < end; i++) {
+ *           sum += values[i];
+ *       }
+ *       __atomic_add_fetch((int64_t *) userdata, sum, __ATOMIC_RELAXED);
+ *   }
+ *
+ *   int64_t total = 0;
+ *   qthreadpool_parallel_for(pool, 0, nvalues, 0, sum_range, &total);
+ * @endcode
+ *
+ * @note
+ *  The chunks run in any order and on several threads at once. Pick a
+ *  grain big enough to outweigh the scheduling of a chunk, thousands of
+ *  indexes for a simple loop body.
+ */
+bool qthreadpool_parallel_for(qthreadpool_t *pool, size_t begin, size_t end,
+                              size_t grain, qthreadpool_range_t func,
+                              void *userdata) {
+    if (func == NULL || end < begin) {
+        errno = EINVAL;
+        return false;
+    }
+
+    size_t num = end - begin;
+    if (num == 0) {
+        return true;
+    }
+
+    size_t nthreads = (pool != NULL) ? (size_t) pool->nthreads : 0;
+    if (grain == 0) {
+        grain = num / ((nthreads + 1) * DEFAULT_GRAIN_SPLIT);
+        if (grain == 0) {
+            grain = 1;
+        }
+    }
+
+    qthreadpool_loop_t loop;
+    loop.pool = pool;
+    loop.func = func;
+    loop.userdata = userdata;
+    loop.begin = begin;
+    loop.end = end;
+    loop.grain = grain;
+    loop.nchunks = num / grain + ((num % grain) ? 1 : 0);
+    loop.nextchunk = 0;
+    loop.helpers = 0;
+
+    if (pool != NULL && loop.nchunks > 1 && closed(pool) == false) {
+        // the calling thread takes one share itself
+        size_t nhelpers = loop.nchunks - 1;
+        if (nhelpers > nthreads) {
+            nhelpers = nthreads;
+        }
+
+        size_t i;
+        for (i = 0; i < nhelpers; i++) {
+            __atomic_add_fetch(&loop.helpers, 1, __ATOMIC_SEQ_CST);
+            if (push_task(pool, loop_main, &loop, NULL) == false) {
+                __atomic_sub_fetch(&loop.helpers, 1, __ATOMIC_SEQ_CST);
+                break;
+            }
+        }
+    }
+
+    loop_run(&loop);
+    if (pool != NULL) {
+        wait_zero(pool, &loop.helpers);
+    }
+
+    return true;
+}
+
+/**
+ * Wait until all the submitted tasks finish.
+ *
+ * @param pool  qthreadpool_t pointer.
+ *
+ * @note
+ *  Tasks submitted while waiting are waited as well. Don't call this from
+ *  a task since the calling task itself never finishes meanwhile.
+ */
+void qthreadpool_wait(qthreadpool_t *pool) {
+    wait_zero(pool, &pool->pending);
+}
+
+/**
+ * Get the number of the worker threads.
+ *
+ * @param pool  qthreadpool_t pointer.
+ *
+ * @return the number of the worker threads.
+ */
+int qthreadpool_nthreads(qthreadpool_t *pool) {
+    return pool->nthreads;
+}
+
+/**
+ * Shut down the pool gracefully.
+ *
+ * Submissions from outside the pool are refused from now on, and the
+ * worker threads finish all the queued tasks, including the subtasks they
+ * submit meanwhile, before exiting. It returns after all the worker threads
+ * have exited.
+ *
+ * @param pool  qthreadpool_t pointer.
+ *
+ * @note
+ *  Don't call this from a task, and don't submit from outside concurrently.
+ */
+void qthreadpool_shutdown(qthreadpool_t *pool) {
+    if (pool->threads == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    __atomic_store_n(&pool->shutdown, true, __ATOMIC_SEQ_CST);
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->mutex);
+
+    int i;
+    for (i = 0; i < pool->nthreads; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    free(pool->threads);
+    pool->threads = NULL;
+}
+
+/**
+ * Shut down the pool and release it.
+ *
+ * @param pool  qthreadpool_t pointer.
+ *
+ * @note
+ *  The queued tasks are finished first, see qthreadpool_shutdown().
+ */
+void qthreadpool_free(qthreadpool_t *pool) {
+    qthreadpool_shutdown(pool);
+    release(pool);
+}
+
+#ifndef _DOXYGEN_SKIP
+
+static void *worker_main(void *arg) {
+    qthreadpool_worker_t *worker = (qthreadpool_worker_t *) arg;
+    qthreadpool_t *pool = worker->pool;
+    curworker = worker;
+
+    while (true) {
+        qthreadpool_task_t *task = take_task(pool);
+        if (task != NULL) {
+            run_task(pool, task);
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->mutex);
+        if (pool->shutdown
+                && __atomic_load_n(&pool->queued, __ATOMIC_SEQ_CST) == 0) {
+            pthread_mutex_unlock(&pool->mutex);
+            break;
+        }
+        __atomic_add_fetch(&pool->sleepers, 1, __ATOMIC_SEQ_CST);
+        if (pool->shutdown == false
+                && __atomic_load_n(&pool->queued, __ATOMIC_SEQ_CST) == 0) {
+            pthread_cond_wait(&pool->cond, &pool->mutex);
+        }
+        __atomic_sub_fetch(&pool->sleepers, 1, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&pool->mutex);
+    }
+
+    curworker = NULL;
+    return NULL;
+}
+
+// the worker of the calling thread, NULL if it's not a worker of the pool.
+static qthreadpool_worker_t *get_self(qthreadpool_t *pool) {
+    return (curworker != NULL && curworker->pool == pool) ? curworker : NULL;
+}
+
+static bool push_task(qthreadpool_t *pool, qthreadpool_func_t func,
+                      void *arg, qthreadpool_future_t *future) {
+    qthreadpool_task_t *task = (qthreadpool_task_t *) malloc(
+            sizeof(qthreadpool_task_t));
+    if (task == NULL) {
+        errno = ENOMEM;
+        return false;
+    }
+    task->func = func;
+    task->arg = arg;
+    task->future = future;
+    task->next = NULL;
+
+    // counted first so a thief taking it at once doesn't see it negative
+    __atomic_add_fetch(&pool->pending, 1, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&pool->queued, 1, __ATOMIC_SEQ_CST);
+
+    qthreadpool_worker_t *self = get_self(pool);
+    if (self != NULL) {
+        if (qdeque_push(self->deque, task) == false) {
+            __atomic_sub_fetch(&pool->queued, 1, __ATOMIC_SEQ_CST);
+            __atomic_sub_fetch(&pool->pending, 1, __ATOMIC_SEQ_CST);
+            free(task);
+            return false;
+        }
+        wakeup(pool, false);
+        return true;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    if (pool->inboxlast != NULL) {
+        ((qthreadpool_task_t *) pool->inboxlast)->next = task;
+    } else {
+        __atomic_store_n(&pool->inbox, task, __ATOMIC_RELAXED);
+    }
+    pool->inboxlast = task;
+    if (pool->sleepers > 0) {
+        pthread_cond_signal(&pool->cond);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return true;
+}
+
+// pops the own deque first, then the inbox, then steals from the others.
+static qthreadpool_task_t *take_task(qthreadpool_t *pool) {
+    if (__atomic_load_n(&pool->queued, __ATOMIC_SEQ_CST) == 0) {
+        return NULL;
+    }
+
+    qthreadpool_worker_t *workers = (qthreadpool_worker_t *) pool->workers;
+    qthreadpool_worker_t *self = get_self(pool);
+    qthreadpool_task_t *task = NULL;
+    if (self != NULL) {
+        task = (qthreadpool_task_t *) qdeque_pop(self->deque);
+    }
+
+    if (task == NULL
+            && __atomic_load_n(&pool->inbox, __ATOMIC_RELAXED) != NULL) {
+        pthread_mutex_lock(&pool->mutex);
+        task = (qthreadpool_task_t *) pool->inbox;
+        if (task != NULL) {
+            __atomic_store_n(&pool->inbox, task->next, __ATOMIC_RELAXED);
+            if (pool->inbox == NULL) {
+                pool->inboxlast = NULL;
+            }
+        }
+        pthread_mutex_unlock(&pool->mutex);
+    }
+
+    if (task == NULL) {
+        size_t start = (self != NULL) ? (size_t) (self - workers)
+                : (size_t) pthread_self();
+        int i;
+        for (i = 1; i <= pool->nthreads && task == NULL; i++) {
+            qthreadpool_worker_t *victim =
+                    &workers[(start + i) % pool->nthreads];
+            if (victim != self) {
+                task = (qthreadpool_task_t *) qdeque_steal(victim->deque);
+            }
+        }
+    }
+
+    if (task != NULL) {
+        __atomic_sub_fetch(&pool->queued, 1, __ATOMIC_SEQ_CST);
+    }
+    return task;
+}
+
+static void run_task(qthreadpool_t *pool, qthreadpool_task_t *task) {
+    void *result = task->func(task->arg);
+
+    qthreadpool_future_t *future = task->future;
+    free(task);
+    if (future != NULL) {
+        future->result = result;
+        // the future can be released as soon as it's done
+        __atomic_sub_fetch(&future->pending, 1, __ATOMIC_SEQ_CST);
+        wakeup(pool, true);
+    }
+
+    if (__atomic_sub_fetch(&pool->pending, 1, __ATOMIC_SEQ_CST) == 0) {
+        wakeup(pool, true);
+    }
+}
+
+// runs the queued tasks until the counter drops to zero.
+static void wait_zero(qthreadpool_t *pool, size_t *counter) {
+    bool slept = false;
+    while (__atomic_load_n(counter, __ATOMIC_SEQ_CST) > 0) {
+        qthreadpool_task_t *task = take_task(pool);
+        if (task != NULL) {
+            run_task(pool, task);
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->mutex);
+        __atomic_add_fetch(&pool->sleepers, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(counter, __ATOMIC_SEQ_CST) > 0
+                && __atomic_load_n(&pool->queued, __ATOMIC_SEQ_CST) == 0) {
+            pthread_cond_wait(&pool->cond, &pool->mutex);
+            slept = true;
+        }
+        __atomic_sub_fetch(&pool->sleepers, 1, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&pool->mutex);
+    }
+
+    // pass on the wakeup of a new task it might have taken
+    if (slept && __atomic_load_n(&pool->queued, __ATOMIC_SEQ_CST) > 0) {
+        wakeup(pool, false);
+    }
+}
+
+static void wakeup(qthreadpool_t *pool, bool all) {
+    if (__atomic_load_n(&pool->sleepers, __ATOMIC_SEQ_CST) == 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    if (all) {
+        pthread_cond_broadcast(&pool->cond);
+    } else {
+        pthread_cond_signal(&pool->cond);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+// workers can still submit subtasks while shutting down.
+static bool closed(qthreadpool_t *pool) {
+    return (__atomic_load_n(&pool->shutdown, __ATOMIC_SEQ_CST)
+            && get_self(pool) == NULL);
+}
+
+static void *loop_main(void *arg) {
+    qthreadpool_loop_t *loop = (qthreadpool_loop_t *) arg;
+    qthreadpool_t *pool = loop->pool;
+
+    loop_run(loop);
+
+    // the loop is gone as soon as the last helper is done
+    if (__atomic_sub_fetch(&loop->helpers, 1, __ATOMIC_SEQ_CST) == 0) {
+        wakeup(pool, true);
+    }
+    return NULL;
+}
+
+static void loop_run(qthreadpool_loop_t *loop) {
+    while (true) {
+        size_t chunk = __atomic_fetch_add(&loop->nextchunk, 1,
+                                          __ATOMIC_RELAXED);
+        if (chunk >= loop->nchunks) {
+            break;
+        }
+
+        size_t begin = loop->begin + chunk * loop->grain;
+        size_t end = (loop->end - begin > loop->grain) ?
+                begin + loop->grain : loop->end;
+        loop->func(begin, end, loop->userdata);
+    }
+}
+
+static void release(qthreadpool_t *pool) {
+    qthreadpool_worker_t *workers = (qthreadpool_worker_t *) pool->workers;
+    if (workers != NULL) {
+        int i;
+        for (i = 0; i < pool->nthreads; i++) {
+            if (workers[i].deque != NULL) {
+                qdeque_free(workers[i].deque);
+            }
+        }
+        free(workers);
+    }
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool);
+}
+
+#endif /* _DOXYGEN_SKIP */
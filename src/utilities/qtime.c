@@ -36,11 +36,50 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
+#include <errno.h>
 #include <sys/time.h>
 #include "qinternal.h"
 #include "utilities/qtime.h"
 
+#ifndef _DOXYGEN_SKIP
+
+#define CACHE_FORMATSIZE    (64)
+#define CACHE_STRSIZE       (128)
+
+/* the last formatted time of a thread */
+struct strf_cache {
+    time_t utctime;
+    char format[CACHE_FORMATSIZE];
+    char str[CACHE_STRSIZE];
+    size_t len;
+};
+
+static __thread struct strf_cache _gmt_cache;
+static __thread struct strf_cache _local_cache;
+
+static const char *_wdays[] = {
+    "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"
+};
+static const char *_months[] = {
+    "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+    "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+};
+
+static size_t cached_strf(struct strf_cache *cache, bool local, char *buf,
+                          size_t size, time_t utctime, const char *format);
+static bool split_time(time_t utctime, int *year, int *month, int *day,
+                       int *wday, int *secs);
+static int64_t days_from_civil(int year, int month, int day);
+static int days_in_month(int year, int month);
+static char *put_digits(char *p, int value, int width);
+static const char *get_digits(const char *p, int width, int *value);
+static const char *get_zone(const char *p, int *offset);
+static bool parse_rfc1123(const char *str, time_t *utc);
+
+#endif
+
 /**
  * Returns the current time in milliseconds.
  *
@@ -53,6 +92,49 @@ long qtime_current_milli(void) {
     return time;
 }
 
+/**
+ * Returns the monotonic clock in nanoseconds.
+ *
+ * @return nanoseconds from an unspecified starting point.
+ *
+ * @note
+ *  The monotonic clock isn't affected by changes of the system time, so
+ *  it's for measuring elapsed time and timeouts rather than telling the
+ *  time.
+ *
+ * @code
+ *   int64_t start = qtime_monotonic_nano();
+ *   (...)
+ *   printf("%lld ns elapsed\n", (long long) (qtime_monotonic_nano() - start));
+ * @endcode
+ */
+int64_t qtime_monotonic_nano(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * Returns the current time in seconds from a cheap clock.
+ *
+ * @return current universal time.
+ *
+ * @note
+ *  It reads CLOCK_REALTIME_COARSE where it's available, which is served
+ *  without a system call on most systems but may lag behind the real time
+ *  by a few milliseconds. So it's for the frequent checks like rotation or
+ *  timestamps in logs rather than the precise timing. Elsewhere it's the
+ *  same as time(NULL).
+ */
+time_t qtime_coarse(void) {
+#ifdef CLOCK_REALTIME_COARSE
+    struct timespec ts;
+    if (clock_gettime(CLOCK_REALTIME_COARSE, &ts) == 0)
+        return ts.tv_sec;
+#endif
+    return time(NULL);
+}
+
 /**
  * Get custom formmatted local time string.
  *
@@ -63,6 +145,10 @@ long qtime_current_milli(void) {
  *
  * @return string pointer of buf
  *
+ * @note
+ *  Each thread keeps the last formatted string, so calling it again with
+ *  the same second and format only copies the string.
+ *
  * @code
  *   char *timestr = qtime_localtime_strf(0, "%H:%M:%S"); // HH:MM:SS
  *   free(timestr);
@@ -74,9 +160,8 @@ char *qtime_localtime_strf(char *buf, int size, time_t utctime,
                            const char *format) {
     if (utctime == 0)
         utctime = time(NULL);
-    struct tm *localtm = localtime(&utctime);
 
-    if (strftime(buf, size, format, localtm) == 0) {
+    if (cached_strf(&_local_cache, true, buf, size, utctime, format) == 0) {
         snprintf(buf, size, "(buffer small)");
     }
 
@@ -117,13 +202,17 @@ char *qtime_localtime_str(time_t utctime) {
  *
  * @return internal static string pointer of time string
  *
+ * @note
+ *  The string is kept per thread, so it's valid until the same thread calls
+ *  this again.
+ *
  * @code
  *   printf("%s", qtime_localtime_staticstr(0));  // now
  *   printf("%s", qtime_localtime_staticstr(time(NULL) + 86400)); // 1 day later
  * @endcode
  */
 const char *qtime_localtime_staticstr(time_t utctime) {
-    static char timestr[sizeof(char)
+    static __thread char timestr[sizeof(char)
             * (CONST_STRLEN("00-Jan-0000 00:00:00 +0000") + 1)];
     qtime_localtime_strf(timestr, sizeof(timestr), utctime,
                          "%d-%b-%Y %H:%M:%S %z");
@@ -140,6 +229,10 @@ const char *qtime_localtime_staticstr(time_t utctime) {
  *
  * @return string pointer of buf
  *
+ * @note
+ *  Each thread keeps the last formatted string, so calling it again with
+ *  the same second and format only copies the string.
+ *
  * @code
  *   char timestr[8+1];
  *   qtime_gmt_strf(buf, sizeof(buf), 0, "%H:%M:%S"); // HH:MM:SS
@@ -148,9 +241,8 @@ const char *qtime_localtime_staticstr(time_t utctime) {
 char *qtime_gmt_strf(char *buf, int size, time_t utctime, const char *format) {
     if (utctime == 0)
         utctime = time(NULL);
-    struct tm *gmtm = gmtime(&utctime);
 
-    strftime(buf, size, format, gmtm);
+    cached_strf(&_gmt_cache, false, buf, size, utctime, format);
     return buf;
 }
 
@@ -178,7 +270,11 @@ char *qtime_gmt_str(time_t utctime) {
     if (timestr == NULL)
         return NULL;
 
-    qtime_gmt_strf(timestr, size, utctime, "%a, %d %b %Y %H:%M:%S GMT");
+    if (utctime == 0)
+        utctime = time(NULL);
+    if (qtime_format_rfc1123(timestr, size, utctime) == 0) {
+        qtime_gmt_strf(timestr, size, utctime, "%a, %d %b %Y %H:%M:%S GMT");
+    }
     return timestr;
 }
 
@@ -189,16 +285,29 @@ char *qtime_gmt_str(time_t utctime) {
  *
  * @return internal static string pointer which points GMT time string.
  *
+ * @note
+ *  The string is kept per thread and formatted again only when the second
+ *  changes, so it's cheap enough for the Date header of every response.
+ *
  * @code
  *   printf("%s", qtime_gmt_staticstr(0));         // now
  *   printf("%s", qtime_gmt_staticstr(time(NULL) + 86400));    // 1 day later
  * @endcode
  */
 const char *qtime_gmt_staticstr(time_t utctime) {
-    static char timestr[sizeof(char)
+    static __thread char timestr[sizeof(char)
             * (CONST_STRLEN("Mon, 00-Jan-0000 00:00:00 GMT") + 1)];
-    qtime_gmt_strf(timestr, sizeof(timestr), utctime,
-                   "%a, %d %b %Y %H:%M:%S GMT");
+    static __thread time_t cached = 0;
+    if (utctime == 0)
+        utctime = time(NULL);
+    if (utctime == cached && timestr[0] != '\0')
+        return timestr;
+
+    if (qtime_format_rfc1123(timestr, sizeof(timestr), utctime) == 0) {
+        qtime_gmt_strf(timestr, sizeof(timestr), utctime,
+                       "%a, %d %b %Y %H:%M:%S GMT");
+    }
+    cached = utctime;
     return timestr;
 }
 
@@ -221,10 +330,15 @@ const char *qtime_gmt_staticstr(time_t utctime) {
  * @endcode
  */
 time_t qtime_parse_gmtstr(const char *gmtstr) {
+    // the usual form, which can be before 1970 as well.
+    time_t utc;
+    if (parse_rfc1123(gmtstr, &utc) == true)
+        return utc;
+
     struct tm gmtm;
     if (strptime(gmtstr, "%a, %d %b %Y %H:%M:%S", &gmtm) == NULL)
         return 0;
-    time_t utc = timegm(&gmtm);
+    utc = timegm(&gmtm);
     if (utc < 0)
         return -1;
 
@@ -240,3 +354,395 @@ time_t qtime_parse_gmtstr(const char *gmtstr) {
 
     return utc;
 }
+
+/**
+ * Format time in the form of RFC 1123 like 'Sun, 06 Nov 1994 08:49:37 GMT',
+ * which is used in HTTP headers.
+ *
+ * @param buf       save buffer, at least 30 bytes.
+ * @param size      buffer size
+ * @param utctime   universal time
+ *
+ * @return the length of the string, otherwise returns 0.
+ * @retval errno will be set in error condition.
+ *  - ENOBUFS : Buffer is too small.
+ *  - ERANGE  : The year isn't between 0 and 9999.
+ *
+ * @note
+ *  It's formatted directly without gmtime() and strftime(), so it's much
+ *  faster than qtime_gmt_strf(). The names of days and months are always
+ *  in English regardless of the locale, as HTTP requires.
+ *
+ * @code
+ *   char date[30];
+ *   qtime_format_rfc1123(date, sizeof(date), time(NULL));
+ * @endcode
+ */
+size_t qtime_format_rfc1123(char *buf, size_t size, time_t utctime) {
+    int year, month, day, wday, secs;
+    if (split_time(utctime, &year, &month, &day, &wday, &secs) == false) {
+        errno = ERANGE;
+        return 0;
+    }
+    if (size < sizeof("Sun, 06 Nov 1994 08:49:37 GMT")) {
+        errno = ENOBUFS;
+        return 0;
+    }
+
+    char *p = buf;
+    memcpy(p, _wdays[wday], 3);
+    p += 3;
+    *p++ = ',';
+    *p++ = ' ';
+    p = put_digits(p, day, 2);
+    *p++ = ' ';
+    memcpy(p, _months[month - 1], 3);
+    p += 3;
+    *p++ = ' ';
+    p = put_digits(p, year, 4);
+    *p++ = ' ';
+    p = put_digits(p, secs / 3600, 2);
+    *p++ = ':';
+    p = put_digits(p, secs / 60 % 60, 2);
+    *p++ = ':';
+    p = put_digits(p, secs % 60, 2);
+    memcpy(p, " GMT", 5);
+    p += 4;
+
+    return p - buf;
+}
+
+/**
+ * Format time in the form of ISO 8601 like '1994-11-06T08:49:37Z'.
+ *
+ * @param buf       save buffer, at least 21 bytes.
+ * @param size      buffer size
+ * @param utctime   universal time
+ *
+ * @return the length of the string, otherwise returns 0.
+ * @retval errno will be set in error condition.
+ *  - ENOBUFS : Buffer is too small.
+ *  - ERANGE  : The year isn't between 0 and 9999.
+ *
+ * @code
+ *   char timestr[21];
+ *   qtime_format_iso8601(timestr, sizeof(timestr), time(NULL));
+ * @endcode
+ */
+size_t qtime_format_iso8601(char *buf, size_t size, time_t utctime) {
+    int year, month, day, wday, secs;
+    if (split_time(utctime, &year, &month, &day, &wday, &secs) == false) {
+        errno = ERANGE;
+        return 0;
+    }
+    if (size < sizeof("1994-11-06T08:49:37Z")) {
+        errno = ENOBUFS;
+        return 0;
+    }
+
+    char *p = buf;
+    p = put_digits(p, year, 4);
+    *p++ = '-';
+    p = put_digits(p, month, 2);
+    *p++ = '-';
+    p = put_digits(p, day, 2);
+    *p++ = 'T';
+    p = put_digits(p, secs / 3600, 2);
+    *p++ = ':';
+    p = put_digits(p, secs / 60 % 60, 2);
+    *p++ = ':';
+    p = put_digits(p, secs % 60, 2);
+    *p++ = 'Z';
+    *p = '\0';
+
+    return p - buf;
+}
+
+/**
+ * Parse RFC 1123 formatted time string like 'Sun, 06 Nov 1994 08:49:37 GMT'.
+ *
+ * The day of the week is optional, the date can be separated by '-' like
+ * 'Sun, 06-Nov-1994' as in cookies, and the zone can be GMT, UT, UTC, Z or
+ * a numeric offset like +0900.
+ *
+ * @param str   time string
+ *
+ * @return universal time if successful, otherwise returns -1.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid format.
+ *
+ * @code
+ *   time_t t = qtime_parse_rfc1123("Sun, 06 Nov 1994 08:49:37 GMT");
+ * @endcode
+ *
+ * @note
+ *  -1 is also a valid result, 'Wed, 31 Dec 1969 23:59:59 GMT'. errno is not
+ *  changed on success, so set it to 0 before the call to tell them apart.
+ */
+time_t qtime_parse_rfc1123(const char *str) {
+    time_t utc;
+    if (parse_rfc1123(str, &utc) == false) {
+        errno = EINVAL;
+        return -1;
+    }
+    return utc;
+}
+
+/**
+ * Parse ISO 8601 formatted time string like '1994-11-06T08:49:37Z'.
+ *
+ * The time can be separated by a space instead of 'T', fractions of a
+ * second are ignored, and the zone can be Z or an offset like +09:00, +0900
+ * or +09. Without the zone, or without the time, it's taken as UTC.
+ *
+ * @param str   time string
+ *
+ * @return universal time if successful, otherwise returns -1.
+ * @retval errno will be set in error condition.
+ *  - EINVAL : Invalid format.
+ *
+ * @code
+ *   time_t t = qtime_parse_iso8601("1994-11-06T17:49:37+09:00");
+ * @endcode
+ *
+ * @note
+ *  -1 is also a valid result, '1969-12-31T23:59:59Z'. errno is not
+ *  changed on success, so set it to 0 before the call to tell them apart.
+ */
+time_t qtime_parse_iso8601(const char *str) {
+    const char *p = str;
+    int year, month, day, hour = 0, min = 0, sec = 0, offset = 0;
+
+    // date
+    if ((p = get_digits(p, 4, &year)) == NULL || *p++ != '-'
+        || (p = get_digits(p, 2, &month)) == NULL || *p++ != '-'
+        || (p = get_digits(p, 2, &day)) == NULL)
+        goto error;
+
+    // time
+    if (*p == 'T' || *p == 't' || *p == ' ') {
+        p++;
+        if ((p = get_digits(p, 2, &hour)) == NULL || *p++ != ':'
+            || (p = get_digits(p, 2, &min)) == NULL)
+            goto error;
+        if (*p == ':') {
+            if ((p = get_digits(p + 1, 2, &sec)) == NULL)
+                goto error;
+            if (*p == '.' || *p == ',') {
+                for (p++; *p >= '0' && *p <= '9'; p++)
+                    ;
+            }
+        }
+        if (*p != '\0' && (p = get_zone(p, &offset)) == NULL)
+            goto error;
+    }
+    if (*p != '\0')
+        goto error;
+
+    if (month < 1 || month > 12 || day < 1 || day > days_in_month(year, month)
+        || hour > 23 || min > 59 || sec > 60)
+        goto error;
+
+    return (time_t) (days_from_civil(year, month, day) * 86400 + hour * 3600
+            + min * 60 + sec - offset);
+
+    error:
+    errno = EINVAL;
+    return -1;
+}
+
+#ifndef _DOXYGEN_SKIP
+
+/**
+ * strftime() the time, or copy the string this thread formatted the last
+ * time if the time and the format are the same.
+ */
+static size_t cached_strf(struct strf_cache *cache, bool local, char *buf,
+                          size_t size, time_t utctime, const char *format) {
+    if (size == 0)
+        return 0;
+    if (cache->len > 0 && cache->utctime == utctime && cache->len < size
+        && !strcmp(cache->format, format)) {
+        memcpy(buf, cache->str, cache->len + 1);
+        return cache->len;
+    }
+
+    struct tm tm;
+    if (local == true)
+        localtime_r(&utctime, &tm);
+    else
+        gmtime_r(&utctime, &tm);
+
+    size_t len = strftime(buf, size, format, &tm);
+    size_t formatlen = strlen(format);
+    if (len > 0 && len < sizeof(cache->str)
+        && formatlen < sizeof(cache->format)) {
+        cache->utctime = utctime;
+        memcpy(cache->format, format, formatlen + 1);
+        memcpy(cache->str, buf, len + 1);
+        cache->len = len;
+    }
+    return len;
+}
+
+/**
+ * Split universal time into the date and the seconds of the day.
+ */
+static bool split_time(time_t utctime, int *year, int *month, int *day,
+                       int *wday, int *secs) {
+    int64_t t = (int64_t) utctime;
+    int64_t days = t / 86400;
+    int64_t rem = t % 86400;
+    if (rem < 0) {
+        rem += 86400;
+        days--;
+    }
+
+    // civil date from days since 1970-01-01 (Howard Hinnant's algorithm)
+    int64_t z = days + 719468;
+    int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    int64_t doe = z - era * 146097;
+    int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int64_t mp = (5 * doy + 2) / 153;
+    int64_t d = doy - (153 * mp + 2) / 5 + 1;
+    int64_t m = mp < 10 ? mp + 3 : mp - 9;
+    int64_t y = yoe + era * 400 + (m <= 2);
+    if (y < 0 || y > 9999)
+        return false;
+
+    *year = (int) y;
+    *month = (int) m;
+    *day = (int) d;
+    *wday = (int) (((days % 7) + 11) % 7);  // 1970-01-01 was Thursday
+    *secs = (int) rem;
+    return true;
+}
+
+/**
+ * Days since 1970-01-01 of a civil date.
+ */
+static int64_t days_from_civil(int year, int month, int day) {
+    int64_t y = year - (month <= 2);
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    int64_t yoe = y - era * 400;
+    int64_t doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+static int days_in_month(int year, int month) {
+    static const int days[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    if (month == 2 && (year % 4 == 0 && (year % 100 != 0 || year % 400 == 0)))
+        return 29;
+    return days[month - 1];
+}
+
+static char *put_digits(char *p, int value, int width) {
+    int i;
+    for (i = width - 1; i >= 0; i--) {
+        p[i] = '0' + value % 10;
+        value /= 10;
+    }
+    return p + width;
+}
+
+/**
+ * Read a number of exactly width digits, or 1 or 2 digits if width is 0.
+ */
+static const char *get_digits(const char *p, int width, int *value) {
+    int max = (width > 0) ? width : 2;
+    int i;
+    for (i = 0, *value = 0; i < max && p[i] >= '0' && p[i] <= '9'; i++) {
+        *value = *value * 10 + (p[i] - '0');
+    }
+    if (i == 0 || (width > 0 && i != width))
+        return NULL;
+    return p + i;
+}
+
+/**
+ * Read a zone, GMT, UT, UTC, Z or +HH[[:]MM], into seconds east of UTC.
+ */
+static const char *get_zone(const char *p, int *offset) {
+    *offset = 0;
+    if (!strncasecmp(p, "GMT", 3) || !strncasecmp(p, "UTC", 3))
+        return p + 3;
+    if (!strncasecmp(p, "UT", 2))
+        return p + 2;
+    if (*p == 'Z' || *p == 'z')
+        return p + 1;
+    if (*p != '+' && *p != '-')
+        return NULL;
+
+    int sign = (*p == '-') ? -1 : 1;
+    int hour, min = 0;
+    if ((p = get_digits(p + 1, 2, &hour)) == NULL)
+        return NULL;
+    if (*p == ':')
+        p++;
+    if (*p >= '0' && *p <= '9' && (p = get_digits(p, 2, &min)) == NULL)
+        return NULL;
+    if (hour > 23 || min > 59)
+        return NULL;
+    *offset = sign * (hour * 3600 + min * 60);
+    return p;
+}
+
+// parses into utc, returns false if the format is invalid.
+static bool parse_rfc1123(const char *str, time_t *utc) {
+    const char *p = str;
+    int day, month, year, hour, min, sec, offset = 0;
+
+    // day of week
+    while (*p == ' ')
+        p++;
+    if (p[0] != '\0' && p[1] != '\0' && p[2] != '\0' && p[3] == ',') {
+        p += 4;
+        while (*p == ' ')
+            p++;
+    }
+
+    // date
+    if ((p = get_digits(p, 0, &day)) == NULL || (*p != ' ' && *p != '-'))
+        goto error;
+    p++;
+    for (month = 1; month <= 12; month++) {
+        if (!strncasecmp(p, _months[month - 1], 3))
+            break;
+    }
+    if (month > 12 || (p[3] != ' ' && p[3] != '-'))
+        goto error;
+    p += 4;
+    if ((p = get_digits(p, 4, &year)) == NULL || *p++ != ' ')
+        goto error;
+
+    // time
+    if ((p = get_digits(p, 2, &hour)) == NULL || *p++ != ':'
+        || (p = get_digits(p, 2, &min)) == NULL || *p++ != ':'
+        || (p = get_digits(p, 2, &sec)) == NULL)
+        goto error;
+
+    // zone
+    while (*p == ' ')
+        p++;
+    if (*p != '\0' && (p = get_zone(p, &offset)) == NULL)
+        goto error;
+    while (*p == ' ')
+        p++;
+    if (*p != '\0')
+        goto error;
+
+    if (day < 1 || day > days_in_month(year, month) || hour > 23 || min > 59
+        || sec > 60)
+        goto error;
+
+    *utc = (time_t) (days_from_civil(year, month, day) * 86400 + hour * 3600
+            + min * 60 + sec - offset);
+    return true;
+
+    error:
+    return false;
+}
+
+#endif /* _DOXYGEN_SKIP */
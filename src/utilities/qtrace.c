@@ -0,0 +1,154 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/**
+ * @file qtrace.c Tracing hooks of the I/O operations.
+ *
+ * qsocket, qio and qhttpclient report the timing of their blocking
+ * operations to a callback set by qtrace_set(), so the time of a request
+ * can be broken down into name resolution, connection, TLS handshake,
+ * sending and waiting for the response. Without a callback, the hooks cost
+ * a load and a not-taken branch and the clock isn't even read.
+ *
+ * @code
+ *   static void tracer(const qtrace_event_t *ev, void *userdata) {
+ *     fprintf((FILE *) userdata, "%s fd=%d %"PRIu64"ns result=%"PRId64"\n",
+ *             ev->name, ev->fd, ev->elapsed, ev->result);
+ *   }
+ *
+ *   qtrace_set(tracer, stderr);
+ *   qhttpclient_t *client = qhttpclient("www.qdecoder.org", 80);
+ *   client->get(client, "/", fd, NULL, NULL, NULL, NULL, NULL, NULL);
+ *   qtrace_set(NULL, NULL);
+ * @endcode
+ *
+ * @note
+ *  When built with ENABLE_USDT, "qlibc:begin" and "qlibc:end" static probes
+ *  are placed at the same points for perf and bpftrace. The arguments are
+ *  (type, fd, detail) and (type, fd, result, errno) whether a callback is
+ *  set or not.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include "qinternal.h"
+#include "utilities/qtrace.h"
+
+#ifndef _DOXYGEN_SKIP
+
+void (*_q_tracecb)(const qtrace_event_t *event, void *userdata) = NULL;
+static void *_q_tracedata = NULL;
+
+#endif
+
+/**
+ * Set the callback receiving the trace events.
+ *
+ * @param callback  function called as the operations end, NULL to stop.
+ * @param userdata  user data pointer given to the callback.
+ *
+ * @code
+ *   qtrace_set(tracer, stderr);
+ * @endcode
+ *
+ * @note
+ *  The callback is called by the thread doing the operation, so it must be
+ *  thread-safe and quick. Set it while the process is quiet, since an
+ *  operation already running may report to the previous callback with the
+ *  new user data. errno is kept across the callback.
+ */
+void qtrace_set(qtrace_cb_t callback, void *userdata) {
+    __atomic_store_n(&_q_tracedata, userdata, __ATOMIC_RELAXED);
+    __atomic_store_n(&_q_tracecb, callback, __ATOMIC_RELEASE);
+}
+
+/**
+ * Check if a trace callback is set.
+ *
+ * @return true if set, otherwise returns false.
+ */
+bool qtrace_enabled(void) {
+    return (__atomic_load_n(&_q_tracecb, __ATOMIC_RELAXED) != NULL);
+}
+
+/**
+ * Get the name of a trace event type.
+ *
+ * @param type  QTRACE_* event type
+ *
+ * @return the name string like "io.read", or "unknown".
+ */
+const char *qtrace_name(int type) {
+    switch (type) {
+        case QTRACE_SOCKET_RESOLVE:
+            return "socket.resolve";
+        case QTRACE_SOCKET_CONNECT:
+            return "socket.connect";
+        case QTRACE_IO_READ:
+            return "io.read";
+        case QTRACE_IO_WRITE:
+            return "io.write";
+        case QTRACE_HTTP_CONNECT:
+            return "http.connect";
+        case QTRACE_HTTP_TLS:
+            return "http.tls";
+        case QTRACE_HTTP_REQUEST:
+            return "http.request";
+        case QTRACE_HTTP_RESPONSE:
+            return "http.response";
+    }
+    return "unknown";
+}
+
+#ifndef _DOXYGEN_SKIP
+
+// called by Q_TRACE_END() only when the clock was read at the beginning.
+void _q_trace_emit(const _q_trace_t *trace, int64_t result, bool ok) {
+    qtrace_cb_t callback = __atomic_load_n(&_q_tracecb, __ATOMIC_ACQUIRE);
+    if (callback == NULL)
+        return;
+
+    int error = errno;
+    qtrace_event_t event;
+    event.type = trace->type;
+    event.name = qtrace_name(trace->type);
+    event.fd = trace->fd;
+    event.detail = trace->detail;
+    event.start = trace->start;
+    event.elapsed = _q_nanotime() - trace->start;
+    event.result = result;
+    event.error = (ok) ? 0 : error;
+
+    callback(&event, __atomic_load_n(&_q_tracedata, __ATOMIC_RELAXED));
+    errno = error;
+}
+
+#endif /* _DOXYGEN_SKIP */
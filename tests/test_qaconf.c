@@ -0,0 +1,247 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "qunit.h"
+#include "qlibc.h"
+#include "qlibcext.h"
+
+#define NUM_OPTIONS (200)
+
+enum {
+    OPT_SECTION_ALL = QAC_SECTION_ALL,
+    OPT_SECTION_ROOT = QAC_SECTION_ROOT,
+    OPT_SECTION_HOST = (1 << 1)
+};
+
+struct result {
+    int calls[NUM_OPTIONS];
+    int first;
+    int second;
+    char last[64];
+    size_t longest;
+};
+
+static char path[] = "/tmp/test_qaconf_XXXXXX";
+
+static QAC_CB(confcb_count) {
+    struct result *result = (struct result *) userdata;
+    int n = atoi(data->argv[0] + strlen("Option"));
+    if (n >= 0 && n < NUM_OPTIONS)
+        result->calls[n]++;
+    return NULL;
+}
+
+static QAC_CB(confcb_first) {
+    ((struct result *) userdata)->first++;
+    return NULL;
+}
+
+static QAC_CB(confcb_second) {
+    ((struct result *) userdata)->second++;
+    return NULL;
+}
+
+static QAC_CB(confcb_value) {
+    struct result *result = (struct result *) userdata;
+    if (data->otype == QAC_OTYPE_OPTION && data->argc > 1) {
+        snprintf(result->last, sizeof(result->last), "%s", data->argv[1]);
+        if (strlen(data->argv[1]) > result->longest)
+            result->longest = strlen(data->argv[1]);
+    }
+    return NULL;
+}
+
+static qaconf_option_t options[] = {
+    {"Listen", QAC_TAKE_INT, confcb_value, 0, OPT_SECTION_ALL},
+    {"Dup", QAC_TAKE0, confcb_first, 0, OPT_SECTION_ALL},
+    {"DUP", QAC_TAKE0, confcb_second, 0, OPT_SECTION_ALL},
+    {"Host", QAC_TAKE_STR, confcb_value, OPT_SECTION_HOST, OPT_SECTION_ROOT},
+    {"Name", QAC_TAKE_STR, confcb_value, 0, OPT_SECTION_HOST},
+    {"Text", QAC_TAKE_STR, confcb_value, 0, OPT_SECTION_ALL},
+    QAC_OPTION_END
+};
+
+// parses the text with a new qaconf and the options above
+static int parse_str(const char *text, uint8_t flags, struct result *result,
+                     char *errbuf, size_t errbufsize) {
+    if (qfile_save(path, text, strlen(text), false) < 0)
+        return -2;
+    memset((void *) result, 0, sizeof(struct result));
+
+    qaconf_t *conf = qaconf();
+    conf->addoptions(conf, options);
+    conf->setuserdata(conf, result);
+    int count = conf->parse(conf, path, flags);
+    if (errbuf != NULL) {
+        snprintf(errbuf, errbufsize, "%s",
+                 conf->errmsg(conf) ? conf->errmsg(conf) : "");
+    }
+    conf->free(conf);
+    return count;
+}
+
+QUNIT_START("Test qaconf.c");
+
+TEST("Test hashed lookups of many directives") {
+    int fd = mkstemp(path);
+    ASSERT_TRUE(fd >= 0);
+    close(fd);
+
+    // register the options in two calls to rebuild the index
+    qaconf_option_t *opts = (qaconf_option_t *) calloc(NUM_OPTIONS + 1,
+                                                      sizeof(qaconf_option_t));
+    int i;
+    for (i = 0; i < NUM_OPTIONS; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "Option%d", i);
+        opts[i].name = strdup(name);
+        opts[i].take = QAC_TAKEALL;
+        opts[i].cb = confcb_count;
+        opts[i].sections = OPT_SECTION_ALL;
+    }
+    qaconf_t *conf = qaconf();
+    qaconf_option_t saved = opts[NUM_OPTIONS / 2];
+    memset((void *) &opts[NUM_OPTIONS / 2], 0, sizeof(qaconf_option_t));
+    ASSERT_EQUAL_INT(NUM_OPTIONS / 2, conf->addoptions(conf, opts));
+    opts[NUM_OPTIONS / 2] = saved;
+    ASSERT_EQUAL_INT(NUM_OPTIONS / 2,
+                     conf->addoptions(conf, &opts[NUM_OPTIONS / 2]));
+
+    // every option twice, in the reverse order
+    qgrow_t *grow = qgrow(QGROW_CONTIGUOUS);
+    int j;
+    for (j = 0; j < 2; j++) {
+        for (i = NUM_OPTIONS - 1; i >= 0; i--) {
+            qgrow_addstrf(grow, "Option%d arg%d\n", i, j);
+        }
+    }
+    size_t textsize = 0;
+    char *text = (char *) qgrow_toarray(grow, &textsize);
+    ASSERT_TRUE(qfile_save(path, text, textsize, false) > 0);
+    free(text);
+    qgrow_free(grow);
+
+    struct result result;
+    memset((void *) &result, 0, sizeof(result));
+    conf->setuserdata(conf, &result);
+    ASSERT_EQUAL_INT(NUM_OPTIONS * 2, conf->parse(conf, path, 0));
+    int wrong = 0;
+    for (i = 0; i < NUM_OPTIONS; i++) {
+        if (result.calls[i] != 2)
+            wrong++;
+    }
+    ASSERT_EQUAL_INT(0, wrong);
+
+    // unknown names are not found by a hash collision
+    ASSERT_TRUE(qfile_save(path, "Option200\n", 10, false) > 0);
+    ASSERT_EQUAL_INT(-1, conf->parse(conf, path, 0));
+    ASSERT_NOT_NULL(strstr(conf->errmsg(conf), "Unregistered"));
+    conf->free(conf);
+
+    for (i = 0; i < NUM_OPTIONS; i++) {
+        free(opts[i].name);
+    }
+    free(opts);
+}
+
+TEST("Test case sensitivity and the first registered option") {
+    struct result result;
+    char errbuf[256];
+
+    // the names differ by case only, so each matches itself
+    ASSERT_EQUAL_INT(2, parse_str("Dup\nDUP\n", 0, &result, NULL, 0));
+    ASSERT_EQUAL_INT(1, result.first);
+    ASSERT_EQUAL_INT(1, result.second);
+
+    // insensitively, the first registered one takes both
+    ASSERT_EQUAL_INT(3, parse_str("Dup\nDUP\ndup\n", QAC_CASEINSENSITIVE,
+                                  &result, NULL, 0));
+    ASSERT_EQUAL_INT(3, result.first);
+    ASSERT_EQUAL_INT(0, result.second);
+
+    ASSERT_EQUAL_INT(-1, parse_str("LISTEN 80\n", 0, &result, errbuf,
+                                   sizeof(errbuf)));
+    ASSERT_NOT_NULL(strstr(errbuf, "Unregistered option 'LISTEN'"));
+    ASSERT_EQUAL_INT(1, parse_str("LISTEN 80\n", QAC_CASEINSENSITIVE,
+                                  &result, NULL, 0));
+    ASSERT_EQUAL_STR("80", result.last);
+    // the ignored directives are counted too
+    ASSERT_EQUAL_INT(2, parse_str("Unknown 1\nlisten 81\n",
+                                  QAC_CASEINSENSITIVE | QAC_IGNOREUNKNOWN,
+                                  &result, NULL, 0));
+    ASSERT_EQUAL_STR("81", result.last);
+}
+
+TEST("Test sections and argument checks") {
+    struct result result;
+    char errbuf[256];
+
+    const char *text = "# comment\n"
+                       "Listen 53\n"
+                       "<Host www>\n"
+                       "  Name \"www server\"\n"
+                       "</Host>\n";
+    ASSERT_EQUAL_INT(4, parse_str(text, 0, &result, NULL, 0));
+    ASSERT_EQUAL_STR("www server", result.last);
+
+    ASSERT_EQUAL_INT(-1, parse_str("Name www\n", 0, &result, errbuf,
+                                   sizeof(errbuf)));
+    ASSERT_NOT_NULL(strstr(errbuf, "wrong section"));
+    ASSERT_EQUAL_INT(-1, parse_str("Listen www\n", 0, &result, errbuf,
+                                   sizeof(errbuf)));
+    ASSERT_NOT_NULL(strstr(errbuf, "must be integer"));
+    ASSERT_EQUAL_INT(-1, parse_str("<Host www>\nListen 1\n", 0, &result,
+                                   errbuf, sizeof(errbuf)));
+    ASSERT_NOT_NULL(strstr(errbuf, "was not closed"));
+}
+
+TEST("Test lines longer than the initial line buffer") {
+    struct result result;
+
+    size_t len = 100000;
+    char *text = (char *) malloc(len + 16);
+    strcpy(text, "Text ");
+    memset(text + 5, 'x', len);
+    strcpy(text + 5 + len, "\nListen 1");
+    ASSERT_EQUAL_INT(2, parse_str(text, 0, &result, NULL, 0));
+    ASSERT_EQUAL_INT(len, result.longest);
+    ASSERT_EQUAL_STR("1", result.last);
+    free(text);
+
+    // the last line without a newline and an empty file
+    ASSERT_EQUAL_INT(1, parse_str("Listen 2", 0, &result, NULL, 0));
+    ASSERT_EQUAL_STR("2", result.last);
+    ASSERT_EQUAL_INT(0, parse_str("", 0, &result, NULL, 0));
+
+    unlink(path);
+}
+
+QUNIT_END();
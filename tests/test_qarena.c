@@ -0,0 +1,141 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#include <errno.h>
+#include "qunit.h"
+#include "qlibc.h"
+
+QUNIT_START("Test qarena.c");
+
+TEST("Test basic allocations") {
+    qarena_t *arena = qarena(1024, 0);
+    ASSERT_NOT_NULL(arena);
+    ASSERT_EQUAL_INT(0, arena->size(arena));
+
+    int i;
+    char *prev = NULL;
+    for (i = 0; i < 100; i++) {
+        char *p = arena->alloc(arena, (i % 37) + 1);
+        ASSERT_NOT_NULL(p);
+        ASSERT_EQUAL_INT(0, (uintptr_t) p % 16);
+        ASSERT_TRUE(p != prev);
+        memset(p, i, (i % 37) + 1);
+        prev = p;
+    }
+    ASSERT_TRUE(arena->size(arena) >= 100 * 16);
+
+    char *str = arena->strdup(arena, "hello arena");
+    ASSERT_EQUAL_STR("hello arena", str);
+    int *zero = arena->calloc(arena, sizeof(int) * 8);
+    for (i = 0; i < 8; i++) {
+        ASSERT_EQUAL_INT(0, zero[i]);
+    }
+    ASSERT_NULL(arena->memdup(arena, NULL, 10));
+
+    arena->free(arena);
+}
+
+TEST("Test large allocations and reset") {
+    qarena_t *arena = qarena(1024, QARENA_THREADSAFE);
+    char *small = arena->alloc(arena, 100);
+    char *big = arena->alloc(arena, 10000);
+    ASSERT_NOT_NULL(big);
+    memset(big, 'x', 10000);
+    // a large allocation doesn't take the room of the current chunk
+    char *next = arena->alloc(arena, 100);
+    ASSERT_TRUE(next == small + 112);
+
+    arena->reset(arena);
+    ASSERT_EQUAL_INT(0, arena->size(arena));
+    char *again = arena->alloc(arena, 100);
+    ASSERT_NOT_NULL(again);
+    arena->free(arena);
+}
+
+TEST("Test containers with an arena") {
+    qarena_t *arena = qarena(0, 0);
+    char key[32], value[32];
+    int i;
+
+    qhashtbl_t *htbl = qhashtbl(0, 0);
+    qlisttbl_t *ltbl = qlisttbl(QLISTTBL_UNIQUE);
+    qtreetbl_t *ttbl = qtreetbl(0);
+    qlist_t *list = qlist(0);
+    qvector_t *vector = qvector(4, sizeof(int), QVECTOR_RESIZE_DOUBLE);
+    ASSERT_TRUE(htbl->set_arena(htbl, arena));
+    ASSERT_TRUE(ltbl->set_arena(ltbl, arena));
+    ASSERT_TRUE(ttbl->set_arena(ttbl, arena));
+    ASSERT_TRUE(list->set_arena(list, arena));
+    ASSERT_TRUE(vector->set_arena(vector, arena));
+
+    for (i = 0; i < 1000; i++) {
+        sprintf(key, "key%d", i);
+        sprintf(value, "value%d", i);
+        ASSERT_TRUE(htbl->putstr(htbl, key, value));
+        ASSERT_TRUE(ltbl->putstr(ltbl, key, value));
+        ASSERT_TRUE(ttbl->putstr(ttbl, key, value));
+        ASSERT_TRUE(list->addlast(list, value, strlen(value) + 1));
+        ASSERT_TRUE(vector->addlast(vector, &i));
+    }
+    // replace and remove some
+    for (i = 0; i < 1000; i += 3) {
+        sprintf(key, "key%d", i);
+        ASSERT_TRUE(htbl->putstr(htbl, key, "replaced"));
+        ASSERT_TRUE(ltbl->putstr(ltbl, key, "replaced"));
+        ASSERT_TRUE(ttbl->remove(ttbl, key));
+        ASSERT_TRUE(list->removefirst(list));
+    }
+    for (i = 0; i < 1000; i++) {
+        sprintf(key, "key%d", i);
+        sprintf(value, "value%d", i);
+        const char *expect = (i % 3 == 0) ? "replaced" : value;
+        ASSERT_EQUAL_STR(expect, htbl->getstr(htbl, key, false));
+        ASSERT_EQUAL_STR(expect, ltbl->getstr(ltbl, key, false));
+        if (i % 3 == 0) {
+            ASSERT_NULL(ttbl->getstr(ttbl, key, false));
+        } else {
+            ASSERT_EQUAL_STR(value, ttbl->getstr(ttbl, key, false));
+        }
+        ASSERT_EQUAL_INT(i, *(int *) vector->getat(vector, i, false));
+    }
+    ASSERT_EQUAL_INT(1000 - 334, list->size(list));
+    ASSERT_TRUE(arena->size(arena) > 0);
+
+    // not allowed while holding elements
+    ASSERT_FALSE(htbl->set_arena(htbl, NULL));
+    ASSERT_EQUAL_INT(EBUSY, errno);
+
+    htbl->free(htbl);
+    ltbl->free(ltbl);
+    ttbl->free(ttbl);
+    list->free(list);
+    vector->free(vector);
+    arena->free(arena);
+}
+
+QUNIT_END();
@@ -0,0 +1,111 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+#include <errno.h>
+#include "qunit.h"
+#include "qlibc.h"
+
+QUNIT_START("Test qbloom.c");
+
+TEST("Test qbloom_calculate_memsize() / qbloom()") {
+    ASSERT_EQUAL_INT(0, qbloom_calculate_memsize(0, 0.01));
+    ASSERT_EQUAL_INT(0, qbloom_calculate_memsize(100, 0));
+    ASSERT_EQUAL_INT(0, qbloom_calculate_memsize(100, 1));
+    ASSERT(qbloom_calculate_memsize(1000, 0.01)
+           < qbloom_calculate_memsize(1000, 0.001));
+
+    char memory[128];
+    ASSERT_TRUE(qbloom(memory, 64, 10) == NULL);
+    ASSERT_EQUAL_INT(EINVAL, errno);
+    ASSERT_TRUE(qbloom(memory, sizeof(memory), 0) == NULL);
+
+    memset(memory, 0, sizeof(memory));
+    ASSERT_TRUE(qbloom(memory, 0, 0) == NULL);
+
+    qbloom_t *bloom = qbloom(memory, sizeof(memory), 10);
+    ASSERT_NOT_NULL(bloom);
+    ASSERT_FALSE(bloom->check(bloom, "a", 1));
+    ASSERT_TRUE(bloom->add(bloom, "a", 1));
+    ASSERT_TRUE(bloom->check(bloom, "a", 1));
+    ASSERT_FALSE(bloom->add(bloom, NULL, 1));
+    ASSERT_EQUAL_INT(EINVAL, errno);
+
+    // attach to the existing filter
+    qbloom_t *bloom2 = qbloom(memory, 0, 0);
+    ASSERT_NOT_NULL(bloom2);
+    ASSERT_TRUE(bloom2->check(bloom2, "a", 1));
+    bloom2->free(bloom2);
+
+    bloom->clear(bloom);
+    ASSERT_FALSE(bloom->check(bloom, "a", 1));
+    ASSERT_EQUAL_INT(0, bloom->size(bloom));
+    bloom->free(bloom);
+}
+
+TEST("Test no false negatives and the false positive rate") {
+    const int num = 100000, trials = 200000;
+    const double fpp = 0.01;
+    size_t memsize = qbloom_calculate_memsize(num, fpp);
+    void *memory = malloc(memsize);
+    qbloom_t *bloom = qbloom(memory, memsize, num);
+    ASSERT_NOT_NULL(bloom);
+
+    char key[32];
+    int i, len;
+    for (i = 0; i < num; i++) {
+        len = sprintf(key, "key%d", i);
+        bloom->add(bloom, key, len);
+    }
+    // adding again doesn't count
+    len = sprintf(key, "key%d", 0);
+    bloom->add(bloom, key, len);
+    ASSERT(bloom->size(bloom) <= (size_t) num);
+    ASSERT(bloom->size(bloom) > (size_t) num * 99 / 100);
+
+    int missed = 0;
+    for (i = 0; i < num; i++) {
+        len = sprintf(key, "key%d", i);
+        if (bloom->check(bloom, key, len) == false) {
+            missed++;
+        }
+    }
+    ASSERT_EQUAL_INT(0, missed);
+
+    int falsepos = 0;
+    for (i = 0; i < trials; i++) {
+        len = sprintf(key, "other%d", i);
+        if (bloom->check(bloom, key, len)) {
+            falsepos++;
+        }
+    }
+    ASSERT(falsepos < trials * fpp * 1.5);
+
+    bloom->free(bloom);
+    free(memory);
+}
+
+QUNIT_END();
@@ -0,0 +1,220 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "qunit.h"
+#include "qlibc.h"
+#include "qlibcext.h"
+
+#define NUM_READERS     (4)
+#define NUM_RELOADS     (200)
+#define NUM_PUBLISHES   (20000)
+
+static qconfhandle_t *shared = NULL;
+static bool stop = false;
+
+// reads the configuration written by write_conf(), returns the number of
+// inconsistent or older versions seen.
+static void *reload_reader(void *arg) {
+    long errors = 0, last = 0;
+    while (__atomic_load_n(&stop, __ATOMIC_ACQUIRE) == false) {
+        qlisttbl_t *tbl = (qlisttbl_t *) shared->read_enter(shared);
+        if (tbl != NULL) {
+            char *a = tbl->getstr(tbl, "a", false);
+            char *b = tbl->getstr(tbl, "b", false);
+            if (a == NULL || b == NULL || strcmp(a, b) != 0 || atol(a) < last) {
+                errors++;
+            } else {
+                last = atol(a);
+            }
+        }
+        shared->read_leave(shared);
+    }
+    return (void *) errors;
+}
+
+static bool write_conf(const char *path, int n) {
+    char buf[64];
+    int len = snprintf(buf, sizeof(buf), "a=%d\nb=%d\n", n, n);
+    return (qfile_save(path, buf, len, false) == len);
+}
+
+/* a configuration which is poisoned instead of freed */
+struct myconf {
+    uint64_t version;
+    bool freed;
+    struct myconf *next;
+};
+static struct myconf *graveyard = NULL;
+static int numfreed = 0;
+
+static void free_myconf(void *config) {
+    struct myconf *conf = (struct myconf *) config;
+    __atomic_store_n(&conf->freed, true, __ATOMIC_RELEASE);
+    conf->next = graveyard;
+    graveyard = conf;
+    numfreed++;
+}
+
+// returns the number of configurations seen after being freed.
+static void *publish_reader(void *arg) {
+    long errors = 0;
+    while (__atomic_load_n(&stop, __ATOMIC_ACQUIRE) == false) {
+        struct myconf *conf = (struct myconf *) shared->read_enter(shared);
+        if (conf != NULL) {
+            int i;
+            for (i = 0; i < 100; i++) {
+                if (__atomic_load_n(&conf->freed, __ATOMIC_ACQUIRE)) {
+                    errors++;
+                    break;
+                }
+            }
+        }
+        shared->read_leave(shared);
+    }
+    return (void *) errors;
+}
+
+QUNIT_START("Test qconfhandle.c");
+
+TEST("publish() and read sections in a thread") {
+    qconfhandle_t *conf = qconfhandle(free_myconf);
+    ASSERT_NOT_NULL(conf);
+    ASSERT_EQUAL_INT(0, conf->version(conf));
+    ASSERT_NULL(conf->read_enter(conf));
+    conf->read_leave(conf);
+    ASSERT_EQUAL_INT(0, conf->publish(conf, NULL));
+    ASSERT_EQUAL_INT(EINVAL, errno);
+
+    struct myconf *c1 = calloc(1, sizeof(struct myconf));
+    struct myconf *c2 = calloc(1, sizeof(struct myconf));
+    ASSERT_EQUAL_INT(1, conf->publish(conf, c1));
+
+    // c1 is kept while the read sections are open
+    ASSERT_EQUAL_PT(c1, conf->read_enter(conf));
+    ASSERT_EQUAL_PT(c1, conf->read_enter(conf));
+    ASSERT_EQUAL_INT(2, conf->publish(conf, c2));
+    ASSERT_EQUAL_INT(2, conf->version(conf));
+    conf->read_leave(conf);
+    ASSERT_EQUAL_INT(1, conf->reclaim(conf));
+    ASSERT_FALSE(c1->freed);
+    conf->read_leave(conf);
+    ASSERT_EQUAL_INT(0, conf->reclaim(conf));
+    ASSERT_TRUE(c1->freed);
+
+    ASSERT_EQUAL_PT(c2, conf->read_enter(conf));
+    conf->read_leave(conf);
+    conf->free(conf);
+    ASSERT_TRUE(c2->freed);
+    ASSERT_EQUAL_INT(2, numfreed);
+}
+
+TEST("publish() under concurrent readers") {
+    shared = qconfhandle(free_myconf);
+    ASSERT_NOT_NULL(shared);
+    numfreed = 0;
+    stop = false;
+
+    pthread_t threads[NUM_READERS];
+    int i;
+    for (i = 0; i < NUM_READERS; i++) {
+        ASSERT_EQUAL_INT(0, pthread_create(&threads[i], NULL, publish_reader,
+                                           NULL));
+    }
+    for (i = 1; i <= NUM_PUBLISHES; i++) {
+        struct myconf *c = calloc(1, sizeof(struct myconf));
+        c->version = i;
+        ASSERT_EQUAL_INT(i, shared->publish(shared, c));
+    }
+    __atomic_store_n(&stop, true, __ATOMIC_RELEASE);
+    long errors = 0;
+    for (i = 0; i < NUM_READERS; i++) {
+        void *ret;
+        pthread_join(threads[i], &ret);
+        errors += (long) ret;
+    }
+    ASSERT_EQUAL_INT(0, errors);
+
+    // nothing is left in use once the readers are gone
+    ASSERT_EQUAL_INT(0, shared->reclaim(shared));
+    ASSERT_EQUAL_INT(NUM_PUBLISHES - 1, numfreed);
+    shared->free(shared);
+    ASSERT_EQUAL_INT(NUM_PUBLISHES, numfreed);
+
+    while (graveyard != NULL) {
+        struct myconf *next = graveyard->next;
+        free(graveyard);
+        graveyard = next;
+    }
+}
+
+TEST("reload() under concurrent readers") {
+    char path[] = "/tmp/test_qconfhandle_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_TRUE(fd >= 0);
+    close(fd);
+
+    shared = qconfhandle(NULL);
+    ASSERT_NOT_NULL(shared);
+    ASSERT_EQUAL_INT(0, shared->reload(shared, "/nonexistent/qconfhandle", '='));
+    ASSERT_TRUE(write_conf(path, 0));
+    ASSERT_EQUAL_INT(1, shared->reload(shared, path, '='));
+    stop = false;
+
+    pthread_t threads[NUM_READERS];
+    int i;
+    for (i = 0; i < NUM_READERS; i++) {
+        ASSERT_EQUAL_INT(0, pthread_create(&threads[i], NULL, reload_reader,
+                                           NULL));
+    }
+    for (i = 1; i <= NUM_RELOADS; i++) {
+        ASSERT_TRUE(write_conf(path, i));
+        ASSERT_EQUAL_INT(i + 1, shared->reload(shared, path, '='));
+    }
+    __atomic_store_n(&stop, true, __ATOMIC_RELEASE);
+    long errors = 0;
+    for (i = 0; i < NUM_READERS; i++) {
+        void *ret;
+        pthread_join(threads[i], &ret);
+        errors += (long) ret;
+    }
+    ASSERT_EQUAL_INT(0, errors);
+
+    qlisttbl_t *tbl = (qlisttbl_t *) shared->read_enter(shared);
+    ASSERT_EQUAL_STR("200", tbl->getstr(tbl, "a", false));
+    shared->read_leave(shared);
+    shared->free(shared);
+    unlink(path);
+}
+
+QUNIT_END();
@@ -0,0 +1,205 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "qunit.h"
+#include "qlibc.h"
+#include "qlibcext.h"
+
+static char dir[] = "/tmp/test_qconfig_XXXXXX";
+
+// writes a file in the test directory and returns its path
+static const char *write_file(const char *name, const char *text) {
+    static char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    if (qfile_save(path, text, strlen(text), false) < 0)
+        return NULL;
+    return path;
+}
+
+// sets back the modification time of a file by the given seconds
+static bool age_file(const char *name, int seconds) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return false;
+    struct timespec times[2];
+    times[0] = st.st_atim;
+    times[1] = st.st_mtim;
+    times[1].tv_sec -= seconds;
+    return (utimensat(AT_FDCWD, path, times, 0) == 0);
+}
+
+// parses the main file and returns the value of the key
+static char *get_value(const char *key) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/main.conf", dir);
+    qlisttbl_t *tbl = qconfig_parse_file(NULL, path, '=');
+    if (tbl == NULL)
+        return NULL;
+    char *value = tbl->getstr(tbl, key, true);
+    tbl->free(tbl);
+    return value;
+}
+
+QUNIT_START("Test qconfig.c");
+
+TEST("Test qconfig_parse_file() without includes") {
+    ASSERT_NOT_NULL(mkdtemp(dir));
+    write_file("main.conf", "# comment\n"
+                            "prefix = /tmp\n"
+                            "log = ${prefix}/log\n"
+                            "[daemon]\n"
+                            "port = 1234\n");
+
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/main.conf", dir);
+    qlisttbl_t *tbl = qconfig_parse_file(NULL, path, '=');
+    ASSERT_NOT_NULL(tbl);
+    ASSERT_EQUAL_STR("/tmp/log", tbl->getstr(tbl, "log", false));
+    ASSERT_EQUAL_STR("1234", tbl->getstr(tbl, "daemon.port", false));
+    tbl->free(tbl);
+
+    snprintf(path, sizeof(path), "%s/missing.conf", dir);
+    ASSERT_NULL(qconfig_parse_file(NULL, path, '='));
+}
+
+TEST("Test @INCLUDE directives") {
+    write_file("main.conf", "@INCLUDE inc1.conf\n"
+                            "log = ${prefix}/log\n");
+    write_file("inc1.conf", "prefix = /usr\n"
+                            "@INCLUDE inc2.conf\n");
+    write_file("inc2.conf", "nested = yes");
+
+    char *value = get_value("log");
+    ASSERT_EQUAL_STR("/usr/log", value);
+    free(value);
+    value = get_value("nested");
+    ASSERT_EQUAL_STR("yes", value);
+    free(value);
+
+    // a missing include fails the whole file
+    write_file("inc1.conf", "@INCLUDE missing.conf\n");
+    ASSERT_NULL(get_value("log"));
+
+    // an include path longer than PATH_MAX is an error
+    char *longname = (char *) malloc(PATH_MAX + 16);
+    strcpy(longname, "@INCLUDE ");
+    memset(longname + 9, 'x', PATH_MAX - 12);
+    strcpy(longname + PATH_MAX - 3, "\n");
+    write_file("inc1.conf", longname);
+    free(longname);
+    errno = 0;
+    ASSERT_NULL(get_value("log"));
+    ASSERT_EQUAL_INT(ENAMETOOLONG, errno);
+
+    // an include loop stops at the depth limit
+    write_file("inc1.conf", "@INCLUDE inc1.conf\n");
+    errno = 0;
+    ASSERT_NULL(get_value("log"));
+    ASSERT_EQUAL_INT(ELOOP, errno);
+}
+
+TEST("Test qconfig_set_cache() reuses unchanged includes") {
+    ASSERT_TRUE(qconfig_set_cache(true));
+    ASSERT_TRUE(qconfig_set_cache(true));
+    write_file("main.conf", "@INCLUDE inc1.conf\n");
+    write_file("inc1.conf", "key = value1\n");
+    ASSERT_TRUE(age_file("inc1.conf", 10));
+
+    char *value = get_value("key");
+    ASSERT_EQUAL_STR("value1", value);
+    free(value);
+
+    // the cached contents are used while the file looks the same
+    char path[PATH_MAX], tmppath[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/inc1.conf", dir);
+    struct stat st;
+    ASSERT_EQUAL_INT(0, stat(path, &st));
+    write_file("inc1.conf", "key = value9\n");
+    struct timespec times[2] = { st.st_atim, st.st_mtim };
+    ASSERT_EQUAL_INT(0, utimensat(AT_FDCWD, path, times, 0));
+    value = get_value("key");
+    ASSERT_EQUAL_STR("value1", value);
+    free(value);
+
+    // a change of the size is noticed
+    write_file("inc1.conf", "key = value22\n");
+    value = get_value("key");
+    ASSERT_EQUAL_STR("value22", value);
+    free(value);
+
+    // so is a change of only the contents and modification time
+    ASSERT_TRUE(age_file("inc1.conf", 10));
+    value = get_value("key");
+    ASSERT_EQUAL_STR("value22", value);
+    free(value);
+    write_file("inc1.conf", "key = value33\n");
+    value = get_value("key");
+    ASSERT_EQUAL_STR("value33", value);
+    free(value);
+
+    // a replaced file is noticed by its inode, even with the same
+    // size and modification time
+    snprintf(tmppath, sizeof(tmppath), "%s/inc1.tmp", dir);
+    ASSERT_EQUAL_INT(0, stat(path, &st));
+    write_file("inc1.tmp", "key = value44\n");
+    times[0] = st.st_atim;
+    times[1] = st.st_mtim;
+    ASSERT_EQUAL_INT(0, utimensat(AT_FDCWD, tmppath, times, 0));
+    ASSERT_EQUAL_INT(0, rename(tmppath, path));
+    value = get_value("key");
+    ASSERT_EQUAL_STR("value44", value);
+    free(value);
+
+    // the values are not cached, they follow the including file
+    write_file("main.conf", "key = before\n@INCLUDE inc1.conf\nafter = ${key}\n");
+    value = get_value("after");
+    ASSERT_EQUAL_STR("value44", value);
+    free(value);
+
+    ASSERT_TRUE(qconfig_set_cache(false));
+    ASSERT_TRUE(qconfig_set_cache(false));
+    value = get_value("key");
+    ASSERT_EQUAL_STR("value44", value);
+    free(value);
+
+    unlink(write_file("main.conf", ""));
+    unlink(write_file("inc1.conf", ""));
+    unlink(write_file("inc2.conf", ""));
+    ASSERT_EQUAL_INT(0, rmdir(dir));
+}
+
+QUNIT_END();
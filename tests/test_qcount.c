@@ -0,0 +1,117 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "qunit.h"
+#include "qlibc.h"
+
+static char path[] = "/tmp/test_qcount_XXXXXX";
+
+QUNIT_START("Test qcount.c");
+
+TEST("Test qcount_save() and qcount_update()") {
+    int fd = mkstemp(path);
+    ASSERT_TRUE(fd >= 0);
+    close(fd);
+
+    ASSERT_TRUE(qcount_save(path, 100));
+    ASSERT_EQUAL_INT(100, qcount_read(path));
+    ASSERT_EQUAL_INT(105, qcount_update(path, 5));
+    ASSERT_EQUAL_INT(95, qcount_update(path, -10));
+    ASSERT_EQUAL_INT(95, qcount_read(path));
+}
+
+TEST("Test qcount_shm() loads and flushes the counter file") {
+    ASSERT_TRUE(qcount_save(path, 10));
+
+    // a long interval and a batch of 3 updates
+    qcount_shm_t *counter = qcount_shm(path, NULL, 0, 3600, 3);
+    ASSERT_NOT_NULL(counter);
+    ASSERT_EQUAL_INT(10, qcount_shm_read(counter));
+
+    ASSERT_EQUAL_INT(11, qcount_shm_update(counter, 1));
+    ASSERT_EQUAL_INT(13, qcount_shm_update(counter, 2));
+    ASSERT_EQUAL_INT(10, qcount_read(path));
+
+    // the third update reaches the batch
+    ASSERT_EQUAL_INT(16, qcount_shm_update(counter, 3));
+    ASSERT_EQUAL_INT(16, qcount_read(path));
+
+    ASSERT_EQUAL_INT(15, qcount_shm_update(counter, -1));
+    ASSERT_EQUAL_INT(16, qcount_read(path));
+    ASSERT_TRUE(qcount_shm_flush(counter));
+    ASSERT_EQUAL_INT(15, qcount_read(path));
+
+    // free flushes the pending updates too
+    qcount_shm_update(counter, 5);
+    qcount_shm_free(counter, true);
+    ASSERT_EQUAL_INT(20, qcount_read(path));
+
+    ASSERT_NULL(qcount_shm(NULL, NULL, 0, 0, 0));
+    ASSERT_NULL(qcount_shm(path, NULL, 0, -1, 0));
+}
+
+TEST("Test qcount_shm() shared with child processes") {
+    ASSERT_TRUE(qcount_save(path, 0));
+    qcount_shm_t *counter = qcount_shm(path, NULL, 0, 3600, 1000);
+    ASSERT_NOT_NULL(counter);
+
+    int i;
+    pid_t pids[4];
+    for (i = 0; i < 4; i++) {
+        pids[i] = fork();
+        if (pids[i] == 0) {
+            int j;
+            for (j = 0; j < 10000; j++) {
+                qcount_shm_update(counter, 1);
+            }
+            _exit(0);
+        }
+        ASSERT_TRUE(pids[i] > 0);
+    }
+
+    int failed = 0;
+    for (i = 0; i < 4; i++) {
+        int status;
+        if (waitpid(pids[i], &status, 0) != pids[i] || !WIFEXITED(status)
+            || WEXITSTATUS(status) != 0) {
+            failed++;
+        }
+    }
+    ASSERT_EQUAL_INT(0, failed);
+    ASSERT_EQUAL_INT(40000, qcount_shm_read(counter));
+
+    qcount_shm_free(counter, true);
+    ASSERT_EQUAL_INT(40000, qcount_read(path));
+    unlink(path);
+}
+
+QUNIT_END();
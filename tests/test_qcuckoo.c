@@ -0,0 +1,139 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+#include <errno.h>
+#include "qunit.h"
+#include "qlibc.h"
+
+QUNIT_START("Test qcuckoo.c");
+
+TEST("Test add() / check() / remove()") {
+    ASSERT_EQUAL_INT(0, qcuckoo_calculate_memsize(0));
+    char small[64];
+    ASSERT_TRUE(qcuckoo(small, sizeof(small), 0) == NULL);
+    ASSERT_EQUAL_INT(EINVAL, errno);
+
+    size_t memsize = qcuckoo_calculate_memsize(1000);
+    void *memory = malloc(memsize);
+    qcuckoo_t *cuckoo = qcuckoo(memory, memsize, QCUCKOO_THREADSAFE);
+    ASSERT_NOT_NULL(cuckoo);
+
+    ASSERT_FALSE(cuckoo->check(cuckoo, "a", 1));
+    ASSERT_TRUE(cuckoo->add(cuckoo, "a", 1));
+    ASSERT_TRUE(cuckoo->add(cuckoo, "b", 1));
+    ASSERT_TRUE(cuckoo->check(cuckoo, "a", 1));
+    ASSERT_EQUAL_INT(2, cuckoo->size(cuckoo));
+
+    // attach to the existing filter
+    qcuckoo_t *cuckoo2 = qcuckoo(memory, 0, 0);
+    ASSERT_NOT_NULL(cuckoo2);
+    ASSERT_TRUE(cuckoo2->remove(cuckoo2, "a", 1));
+    cuckoo2->free(cuckoo2);
+
+    ASSERT_FALSE(cuckoo->check(cuckoo, "a", 1));
+    ASSERT_FALSE(cuckoo->remove(cuckoo, "a", 1));
+    ASSERT_EQUAL_INT(ENOENT, errno);
+    ASSERT_TRUE(cuckoo->check(cuckoo, "b", 1));
+
+    // an element added twice needs removing twice
+    ASSERT_TRUE(cuckoo->add(cuckoo, "b", 1));
+    ASSERT_TRUE(cuckoo->remove(cuckoo, "b", 1));
+    ASSERT_TRUE(cuckoo->check(cuckoo, "b", 1));
+    ASSERT_TRUE(cuckoo->remove(cuckoo, "b", 1));
+    ASSERT_FALSE(cuckoo->check(cuckoo, "b", 1));
+    ASSERT_EQUAL_INT(0, cuckoo->size(cuckoo));
+
+    cuckoo->free(cuckoo);
+    free(memory);
+}
+
+TEST("Test filling up the filter") {
+    const int num = 10000;
+    size_t memsize = qcuckoo_calculate_memsize(num);
+    void *memory = malloc(memsize);
+    qcuckoo_t *cuckoo = qcuckoo(memory, memsize, 0);
+
+    char key[32];
+    int i, len, added = 0;
+    for (i = 0; i < num * 4; i++) {
+        len = sprintf(key, "key%d", i);
+        if (cuckoo->add(cuckoo, key, len) == false) {
+            break;
+        }
+        added++;
+    }
+    ASSERT_EQUAL_INT(ENOBUFS, errno);
+    ASSERT(added >= num);
+    ASSERT_EQUAL_INT(added, cuckoo->size(cuckoo));
+
+    // nothing is lost on the way
+    int missed = 0;
+    for (i = 0; i < added; i++) {
+        len = sprintf(key, "key%d", i);
+        if (cuckoo->check(cuckoo, key, len) == false) {
+            missed++;
+        }
+    }
+    ASSERT_EQUAL_INT(0, missed);
+
+    int falsepos = 0;
+    for (i = 0; i < 100000; i++) {
+        len = sprintf(key, "other%d", i);
+        if (cuckoo->check(cuckoo, key, len)) {
+            falsepos++;
+        }
+    }
+    ASSERT(falsepos < 100);
+
+    // removing makes room again
+    int removed;
+    for (removed = 0; removed < added; removed++) {
+        len = sprintf(key, "key%d", removed);
+        ASSERT_TRUE(cuckoo->remove(cuckoo, key, len));
+        if (cuckoo->add(cuckoo, "new", 3)) {
+            break;
+        }
+    }
+    ASSERT(removed < added / 10);
+
+    for (i = removed + 1; i < added; i++) {
+        len = sprintf(key, "key%d", i);
+        if (cuckoo->remove(cuckoo, key, len) == false) {
+            missed++;
+        }
+    }
+    ASSERT_EQUAL_INT(0, missed);
+    ASSERT_EQUAL_INT(1, cuckoo->size(cuckoo));
+
+    cuckoo->clear(cuckoo);
+    ASSERT_EQUAL_INT(0, cuckoo->size(cuckoo));
+    ASSERT_FALSE(cuckoo->check(cuckoo, "new", 3));
+    cuckoo->free(cuckoo);
+    free(memory);
+}
+
+QUNIT_END();
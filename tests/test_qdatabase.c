@@ -0,0 +1,645 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/*
+ * Runs against a server given by the environment, and is skipped without:
+ *   QDB_TEST_HOST, QDB_TEST_PORT (3306), QDB_TEST_USER (root),
+ *   QDB_TEST_PASSWORD (empty), QDB_TEST_DATABASE (test)
+ * It's built with -DWITH_MYSQL=ON, which finds the headers and the client
+ * library of MySQL or MariaDB.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "mysql.h"
+#include "qunit.h"
+#include "qlibc.h"
+#include "qlibcext.h"
+
+static const char *host, *user, *password, *database;
+static int port;
+
+static const char *_env(const char *name, const char *def) {
+    const char *value = getenv(name);
+    return (value != NULL) ? value : def;
+}
+
+static qdb_t *_db(void) {
+    qdb_t *db = qdb("MYSQL", host, port, user, password, database, true);
+    if (db != NULL && db->open(db) == false) {
+        db->free(db);
+        return NULL;
+    }
+    return db;
+}
+
+// value of the row k in qdb_rows, NULL every 5 rows
+static const char *_value(int k, char *buf) {
+    if (k % 5 == 0)
+        return NULL;
+    memset(buf, 'a' + k, k * 30);
+    buf[k * 30] = '\0';
+    return buf;
+}
+
+// (re)creates qdb_rows of 10 rows, by a prepared statement
+static bool _rows(qdb_t *db) {
+    if (db->execute_update(db, "DROP TABLE IF EXISTS qdb_rows") < 0
+            || db->execute_update(db, "CREATE TABLE qdb_rows "
+                                  "(k INT PRIMARY KEY, v TEXT NULL)") < 0) {
+        return false;
+    }
+    qdbstmt_t *stmt = db->prepare(db, "INSERT INTO qdb_rows VALUES (?, ?)");
+    if (stmt == NULL)
+        return false;
+    char buf[512];
+    bool ok = true;
+    int k;
+    for (k = 1; k <= 10 && ok; k++) {
+        ok = (stmt->bind_int(stmt, 1, k)
+              && stmt->bind_str(stmt, 2, _value(k, buf))
+              && stmt->execute_update(stmt) == 1);
+    }
+    stmt->free(stmt);
+    return ok;
+}
+
+// checks a batch of qdb_rows from the row k
+static bool _check_batch(qdbresult_t *result, int rows, int k) {
+    const unsigned long *lengths;
+    const char **keys = result->get_batch_col(result, 1, NULL);
+    const char **values = result->get_batch_col(result, 2, &lengths);
+    if (keys == NULL || values == NULL)
+        return false;
+    char buf[512];
+    int i;
+    for (i = 0; i < rows; i++, k++) {
+        const char *value = _value(k, buf);
+        if (atoi(keys[i]) != k)
+            return false;
+        if (value == NULL) {
+            if (values[i] != NULL || lengths[i] != 0)
+                return false;
+        } else if (values[i] == NULL || lengths[i] != strlen(value)
+                || strcmp(values[i], value)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// counts of the callbacks of submitted queries
+struct counts {
+    pthread_mutex_t lock;
+    int calls;
+    int affected;   // sum of them, -1 counted as failures
+    int failures;
+    int nodb;
+    int value;      // of the first column of the last row
+};
+
+static void _on_update(qdb_t *db, int affected, void *userdata) {
+    struct counts *c = (struct counts *) userdata;
+    pthread_mutex_lock(&c->lock);
+    c->calls++;
+    if (affected < 0)
+        c->failures++;
+    else
+        c->affected += affected;
+    if (db == NULL)
+        c->nodb++;
+    pthread_mutex_unlock(&c->lock);
+}
+
+static void _on_query(qdb_t *db, qdbresult_t *result, void *userdata) {
+    struct counts *c = (struct counts *) userdata;
+    int value = -1;
+    while (result != NULL && result->getnext(result)) {
+        value = result->get_int_at(result, 1);
+    }
+    pthread_mutex_lock(&c->lock);
+    c->calls++;
+    if (result == NULL)
+        c->failures++;
+    else
+        c->value = value;
+    if (db == NULL)
+        c->nodb++;
+    pthread_mutex_unlock(&c->lock);
+}
+
+static qdbpool_t *_pool(int minconns, int maxconns) {
+    return qdbpool("MYSQL", host, port, user, password, database, true,
+                   minconns, maxconns);
+}
+
+// holds a connection for a while, then gives it back
+struct holder {
+    qdbpool_t *pool;
+    qdb_t *db;
+    int holdms;
+};
+
+static void *_hold(void *arg) {
+    struct holder *h = (struct holder *) arg;
+    usleep(h->holdms * 1000);
+    h->pool->release(h->pool, h->db);
+    return NULL;
+}
+
+QUNIT_START("Test qdatabase.c");
+
+host = getenv("QDB_TEST_HOST");
+port = atoi(_env("QDB_TEST_PORT", "3306"));
+user = _env("QDB_TEST_USER", "root");
+password = _env("QDB_TEST_PASSWORD", "");
+database = _env("QDB_TEST_DATABASE", "test");
+
+if (host == NULL) {
+    TEST("Test qdatabase where QDB_TEST_HOST is not set") {
+        PRINT(" skipped");
+        ASSERT_NULL(qdbpool("MYSQL", "localhost", 3306, "", "", "", true,
+                            2, 1));
+        ASSERT_EQUAL_INT(EINVAL, errno);
+    }
+} else {
+    TEST("Test qdbpool()") {
+        qdbpool_t *pool = _pool(2, 4);
+        ASSERT_NOT_NULL(pool);
+        ASSERT_EQUAL_INT(2, pool->size(pool));
+        pool->free(pool);
+
+        pool = _pool(0, 1);
+        ASSERT_TRUE(pool != NULL && pool->size(pool) == 0);
+        if (pool != NULL)
+            pool->free(pool);
+
+        errno = 0;
+        ASSERT_NULL(_pool(2, 1));
+        ASSERT_EQUAL_INT(EINVAL, errno);
+        ASSERT_NULL(_pool(0, 0));
+        ASSERT_EQUAL_INT(EINVAL, errno);
+        ASSERT_NULL(qdbpool("NOSUCHDB", host, port, user, password, database,
+                            true, 0, 1));
+        ASSERT_EQUAL_INT(EINVAL, errno);
+
+        // nothing listens on the port
+        ASSERT_NULL(qdbpool("MYSQL", "127.0.0.1", 1, user, password,
+                            database, true, 1, 1));
+        ASSERT_EQUAL_INT(ECONNREFUSED, errno);
+    }
+
+    TEST("Test qdbpool->get() and qdbpool->release()") {
+        qdbpool_t *pool = _pool(1, 2);
+        ASSERT_NOT_NULL(pool);
+
+        // the idle one first, then a new one on demand
+        qdb_t *db1 = pool->get(pool, 0);
+        ASSERT_TRUE(db1 != NULL && db1->get_conn_status(db1));
+        ASSERT_EQUAL_INT(1, pool->size(pool));
+        qdb_t *db2 = pool->get(pool, 0);
+        ASSERT_TRUE(db2 != NULL && db2 != db1);
+        ASSERT_EQUAL_INT(2, pool->size(pool));
+        qdbresult_t *result = (db2 != NULL) ?
+                db2->execute_query(db2, "SELECT 1") : NULL;
+        ASSERT_TRUE(result != NULL && result->getnext(result)
+                    && result->get_int_at(result, 1) == 1);
+        if (result != NULL)
+            result->free(result);
+
+        // all in use
+        errno = 0;
+        ASSERT_NULL(pool->get(pool, 0));
+        ASSERT_EQUAL_INT(EAGAIN, errno);
+        ASSERT_NULL(pool->get(pool, 100));
+        ASSERT_EQUAL_INT(ETIMEDOUT, errno);
+
+        // handed over as soon as released
+        struct holder h = { pool, db2, 100 };
+        pthread_t tid;
+        ASSERT_EQUAL_INT(0, pthread_create(&tid, NULL, _hold, &h));
+        qdb_t *db3 = pool->get(pool, 5000);
+        pthread_join(tid, NULL);
+        ASSERT_TRUE(db3 == db2);
+
+        // the last released goes out first
+        ASSERT_TRUE(pool->release(pool, db1));
+        ASSERT_TRUE(pool->release(pool, db3));
+        ASSERT_TRUE(pool->get(pool, 0) == db3);
+        ASSERT_TRUE(pool->release(pool, db3));
+        ASSERT_EQUAL_INT(2, pool->size(pool));
+
+        // not from the pool
+        qdb_t *other = _db();
+        ASSERT_NOT_NULL(other);
+        errno = 0;
+        ASSERT_FALSE(pool->release(pool, other));
+        ASSERT_EQUAL_INT(EINVAL, errno);
+        if (other != NULL)
+            other->free(other);
+
+        pool->free(pool);
+    }
+
+    TEST("Test qdbpool->get() with a transaction per connection") {
+        qdbpool_t *pool = _pool(0, 2);
+        ASSERT_NOT_NULL(pool);
+        qdb_t *db = pool->get(pool, 0);
+        ASSERT_NOT_NULL(db);
+        ASSERT_TRUE(db->execute_update(db, "DROP TABLE IF EXISTS qdb_pool")
+                    >= 0);
+        ASSERT_TRUE(db->execute_update(db, "CREATE TABLE qdb_pool "
+                                       "(k INT PRIMARY KEY) ENGINE=InnoDB")
+                    >= 0);
+
+        // not seen by the other connection until committed
+        qdb_t *db2 = pool->get(pool, 0);
+        ASSERT_NOT_NULL(db2);
+        ASSERT_TRUE(db->begin_tran(db));
+        ASSERT_EQUAL_INT(1, db->execute_update(db, "INSERT INTO qdb_pool "
+                                               "VALUES (1)"));
+        qdbresult_t *result = db2->execute_query(db2, "SELECT COUNT(*) "
+                                                 "FROM qdb_pool");
+        ASSERT_TRUE(result != NULL && result->getnext(result)
+                    && result->get_int_at(result, 1) == 0);
+        if (result != NULL)
+            result->free(result);
+        ASSERT_TRUE(db->commit(db));
+        result = db2->execute_query(db2, "SELECT COUNT(*) FROM qdb_pool");
+        ASSERT_TRUE(result != NULL && result->getnext(result)
+                    && result->get_int_at(result, 1) == 1);
+        if (result != NULL)
+            result->free(result);
+
+        ASSERT_TRUE(db->execute_update(db, "DROP TABLE qdb_pool") >= 0);
+        pool->release(pool, db);
+        pool->release(pool, db2);
+        pool->free(pool);
+    }
+
+    TEST("Test qdb->prepare() and qdbstmt->execute_update()") {
+        qdb_t *db = _db();
+        ASSERT_NOT_NULL(db);
+        ASSERT_TRUE(db->execute_update(db, "DROP TABLE IF EXISTS qdb_stmt")
+                    >= 0);
+        ASSERT_TRUE(db->execute_update(db, "CREATE TABLE qdb_stmt "
+                                       "(k BIGINT PRIMARY KEY, v TEXT NULL)")
+                    >= 0);
+
+        qdbstmt_t *stmt = db->prepare(db, "INSERT INTO qdb_stmt VALUES (?, ?)");
+        ASSERT_NOT_NULL(stmt);
+
+        // sent as they are, without escaping
+        ASSERT_TRUE(stmt->bind_int(stmt, 1, 1));
+        ASSERT_TRUE(stmt->bind_str(stmt, 2, "it's \"quoted\"; --"));
+        ASSERT_EQUAL_INT(1, stmt->execute_update(stmt));
+
+        // bound until bound again
+        ASSERT_TRUE(stmt->bind_int(stmt, 1, 2));
+        ASSERT_EQUAL_INT(1, stmt->execute_update(stmt));
+        ASSERT_TRUE(stmt->bind_int(stmt, 1, 3));
+        ASSERT_TRUE(stmt->bind_null(stmt, 2));
+        ASSERT_EQUAL_INT(1, stmt->execute_update(stmt));
+        ASSERT_TRUE(stmt->bind_int(stmt, 1, 4000000000LL));
+        ASSERT_TRUE(stmt->bind_str(stmt, 2, NULL));
+        ASSERT_EQUAL_INT(1, stmt->execute_update(stmt));
+
+        // duplicated key
+        ASSERT_EQUAL_INT(-1, stmt->execute_update(stmt));
+
+        ASSERT_FALSE(stmt->bind_int(stmt, 0, 1));
+        ASSERT_FALSE(stmt->bind_int(stmt, 3, 1));
+        ASSERT_FALSE(stmt->bind_str(stmt, 3, "x"));
+        ASSERT_FALSE(stmt->bind_null(stmt, 3));
+        stmt->free(stmt);
+
+        stmt = db->prepare(db, "UPDATE qdb_stmt SET v = ? WHERE k >= ?");
+        ASSERT_TRUE(stmt != NULL && stmt->bind_str(stmt, 1, "x")
+                    && stmt->bind_int(stmt, 2, 3)
+                    && stmt->execute_update(stmt) == 2);
+        if (stmt != NULL)
+            stmt->free(stmt);
+
+        qdbresult_t *result = db->execute_query(db, "SELECT v FROM qdb_stmt "
+                                                "ORDER BY k");
+        ASSERT_TRUE(result != NULL && result->get_rows(result) == 4);
+        ASSERT_TRUE(result != NULL && result->getnext(result)
+                    && result->get_str_at(result, 1) != NULL
+                    && !strcmp(result->get_str_at(result, 1),
+                               "it's \"quoted\"; --"));
+        ASSERT_TRUE(result != NULL && result->getnext(result)
+                    && result->get_str_at(result, 1) != NULL
+                    && !strcmp(result->get_str_at(result, 1),
+                               "it's \"quoted\"; --"));
+        if (result != NULL)
+            result->free(result);
+
+        ASSERT_NULL(db->prepare(db, "SELEC nothing"));
+        ASSERT_TRUE(db->execute_update(db, "DROP TABLE qdb_stmt") >= 0);
+        db->free(db);
+    }
+
+    TEST("Test qdbstmt->execute_query()") {
+        qdb_t *db = _db();
+        ASSERT_TRUE(db != NULL && _rows(db));
+
+        qdbstmt_t *stmt = db->prepare(db, "SELECT k, v FROM qdb_rows "
+                                      "WHERE k >= ? ORDER BY k");
+        ASSERT_NOT_NULL(stmt);
+        ASSERT_TRUE(stmt->bind_int(stmt, 1, 2));
+        qdbresult_t *result = stmt->execute_query(stmt);
+        ASSERT_NOT_NULL(result);
+        ASSERT_TRUE(result != NULL && result->get_cols(result) == 2
+                    && result->get_rows(result) == 9);
+
+        // the values longer than the column buffers are fetched again
+        char buf[512];
+        int k = 2;
+        bool ok = true;
+        while (result != NULL && result->getnext(result)) {
+            const char *value = _value(k, buf);
+            const char *v = result->getstr(result, "V");
+            ok = ok && result->get_row(result) == k - 1
+                    && result->getint(result, "k") == k
+                    && result->get_int_at(result, 1) == k
+                    && ((value == NULL) ? (v == NULL) :
+                        (v != NULL && !strcmp(v, value)));
+            k++;
+        }
+        ASSERT_TRUE(ok);
+        ASSERT_EQUAL_INT(11, k);
+        if (result != NULL) {
+            ASSERT_NULL(result->getstr(result, "nosuchcol"));
+            result->free(result);
+        }
+
+        // again with another parameter, streamed from the server
+        db->set_fetchtype(db, true);
+        ASSERT_TRUE(stmt->bind_int(stmt, 1, 9));
+        result = stmt->execute_query(stmt);
+        ASSERT_TRUE(result != NULL && result->getnext(result)
+                    && result->get_int_at(result, 1) == 9
+                    && result->get_str_at(result, 2) != NULL
+                    && !strcmp(result->get_str_at(result, 2), _value(9, buf)));
+        ASSERT_TRUE(result != NULL && result->getnext(result)
+                    && result->get_int_at(result, 1) == 10
+                    && result->get_str_at(result, 2) == NULL);
+        ASSERT_TRUE(result != NULL && result->getnext(result) == false);
+        if (result != NULL)
+            result->free(result);
+        db->set_fetchtype(db, false);
+
+        stmt->free(stmt);
+        ASSERT_TRUE(db->execute_update(db, "DROP TABLE qdb_rows") >= 0);
+        db->free(db);
+    }
+
+    TEST("Test qdbresult->get_col_idx()") {
+        qdb_t *db = _db();
+        ASSERT_NOT_NULL(db);
+        qdbresult_t *result = db->execute_query(db, "SELECT 1 AS a, 2 AS Bb, "
+                                                "3 AS c, 4 AS A, 5 AS e");
+        ASSERT_TRUE(result != NULL && result->getnext(result));
+        if (result != NULL) {
+            ASSERT_EQUAL_INT(1, result->get_col_idx(result, "a"));
+            ASSERT_EQUAL_INT(2, result->get_col_idx(result, "bB"));
+            ASSERT_EQUAL_INT(3, result->get_col_idx(result, "C"));
+            ASSERT_EQUAL_INT(5, result->get_col_idx(result, "e"));
+            ASSERT_EQUAL_INT(0, result->get_col_idx(result, "d"));
+            ASSERT_EQUAL_INT(0, result->get_col_idx(result, ""));
+            ASSERT_EQUAL_INT(0, result->get_col_idx(result, NULL));
+
+            // the first one of the same name, as by a scan
+            ASSERT_EQUAL_INT(1, result->getint(result, "A"));
+            ASSERT_EQUAL_INT(5, result->getint(result, "E"));
+            result->free(result);
+        }
+        db->free(db);
+    }
+
+    TEST("Test qdbresult->getbatch()") {
+        qdb_t *db = _db();
+        ASSERT_TRUE(db != NULL && _rows(db));
+        const char *query = "SELECT k, v FROM qdb_rows ORDER BY k";
+
+        // stored, streamed, and by a prepared statement
+        int i;
+        for (i = 0; i < 3; i++) {
+            db->set_fetchtype(db, (i == 1));
+            qdbstmt_t *stmt = NULL;
+            qdbresult_t *result;
+            if (i < 2) {
+                result = db->execute_query(db, query);
+            } else {
+                stmt = db->prepare(db, query);
+                result = (stmt != NULL) ? stmt->execute_query(stmt) : NULL;
+            }
+            ASSERT_NOT_NULL(result);
+            if (result == NULL)
+                continue;
+
+            ASSERT_NULL(result->get_batch_col(result, 1, NULL));
+            ASSERT_EQUAL_INT(4, result->getbatch(result, 4));
+            ASSERT_TRUE(_check_batch(result, 4, 1));
+            ASSERT_EQUAL_INT(4, result->getbatch(result, 4));
+            ASSERT_TRUE(_check_batch(result, 4, 5));
+
+            // a bigger batch than before
+            ASSERT_EQUAL_INT(2, result->getbatch(result, 8));
+            ASSERT_TRUE(_check_batch(result, 2, 9));
+            ASSERT_EQUAL_INT(0, result->getbatch(result, 8));
+
+            ASSERT_NULL(result->get_batch_col(result, 0, NULL));
+            ASSERT_NULL(result->get_batch_col(result, 3, NULL));
+            ASSERT_EQUAL_INT(-1, result->getbatch(result, 0));
+            result->free(result);
+            if (stmt != NULL)
+                stmt->free(stmt);
+        }
+        db->set_fetchtype(db, false);
+
+        ASSERT_TRUE(db->execute_update(db, "DROP TABLE qdb_rows") >= 0);
+        db->free(db);
+    }
+
+    TEST("Test qdb->execute_batch()") {
+        qdb_t *db = _db();
+        ASSERT_NOT_NULL(db);
+        ASSERT_TRUE(db->execute_update(db, "DROP TABLE IF EXISTS qdb_batch")
+                    >= 0);
+        ASSERT_TRUE(db->execute_update(db, "CREATE TABLE qdb_batch "
+                                       "(k INT PRIMARY KEY, v INT) "
+                                       "ENGINE=InnoDB") >= 0);
+
+        const char *inserts[] = {
+            "INSERT INTO qdb_batch VALUES (1, 10)",
+            "INSERT INTO qdb_batch VALUES (2, 20), (3, 30)",
+            "UPDATE qdb_batch SET v = v + 1 WHERE k >= 2"
+        };
+        ASSERT_EQUAL_INT(5, db->execute_batch(db, inserts, 3));
+
+        // the result sets in between are thrown away
+        const char *mixed[] = {
+            "SELECT * FROM qdb_batch",
+            "DELETE FROM qdb_batch WHERE k = 3",
+            "SELECT COUNT(*) FROM qdb_batch"
+        };
+        ASSERT_EQUAL_INT(1, db->execute_batch(db, mixed, 3));
+
+        // stops at the failed one, rolled back as a whole
+        const char *failing[] = {
+            "INSERT INTO qdb_batch VALUES (4, 40)",
+            "INSERT INTO qdb_batch VALUES (1, 10)",
+            "INSERT INTO qdb_batch VALUES (5, 50)"
+        };
+        ASSERT_TRUE(db->begin_tran(db));
+        ASSERT_EQUAL_INT(-1, db->execute_batch(db, failing, 3));
+        ASSERT_TRUE(db->rollback(db));
+        qdbresult_t *result = db->execute_query(db, "SELECT COUNT(*), SUM(v) "
+                                                "FROM qdb_batch");
+        ASSERT_TRUE(result != NULL && result->getnext(result)
+                    && result->get_int_at(result, 1) == 2
+                    && result->get_int_at(result, 2) == 31);
+        if (result != NULL)
+            result->free(result);
+
+        // and the connection is usable after
+        ASSERT_EQUAL_INT(-1, db->execute_batch(db, failing + 1, 1));
+        ASSERT_EQUAL_INT(1, db->execute_batch(db, failing + 2, 1));
+
+        // multiple statements only in a batch
+        ASSERT_EQUAL_INT(-1, db->execute_update(db, "INSERT INTO qdb_batch "
+                                                "VALUES (6, 60); INSERT INTO "
+                                                "qdb_batch VALUES (7, 70)"));
+
+        ASSERT_EQUAL_INT(-1, db->execute_batch(db, NULL, 1));
+        ASSERT_EQUAL_INT(-1, db->execute_batch(db, inserts, 0));
+
+        ASSERT_TRUE(db->execute_update(db, "DROP TABLE qdb_batch") >= 0);
+        db->free(db);
+    }
+
+    TEST("Test qdbpool->submit_update(), submit_query() and drain()") {
+        qdbpool_t *pool = _pool(0, 3);
+        ASSERT_NOT_NULL(pool);
+        qdb_t *db = pool->get(pool, 0);
+        ASSERT_TRUE(db != NULL
+                    && db->execute_update(db, "DROP TABLE IF EXISTS qdb_async")
+                    >= 0
+                    && db->execute_update(db, "CREATE TABLE qdb_async "
+                                          "(k INT PRIMARY KEY)") >= 0);
+        pool->release(pool, db);
+
+        struct counts updates, queries;
+        memset(&updates, 0, sizeof(updates));
+        memset(&queries, 0, sizeof(queries));
+        pthread_mutex_init(&updates.lock, NULL);
+        pthread_mutex_init(&queries.lock, NULL);
+
+        // more than the workers
+        char query[64];
+        int i;
+        for (i = 1; i <= 20; i++) {
+            snprintf(query, sizeof(query), "INSERT INTO qdb_async VALUES (%d)",
+                     i);
+            ASSERT_TRUE(pool->submit_update(pool, query, _on_update,
+                                            &updates));
+        }
+        ASSERT_TRUE(pool->submit_update(pool, "INSERT INTO qdb_async "
+                                        "VALUES (1)", _on_update, &updates));
+        ASSERT_TRUE(pool->submit_update(pool, "DELETE FROM qdb_async "
+                                        "WHERE k > 100", NULL, NULL));
+        ASSERT_TRUE(pool->drain(pool, -1));
+        ASSERT_EQUAL_INT(21, updates.calls);
+        ASSERT_EQUAL_INT(20, updates.affected);
+        ASSERT_EQUAL_INT(1, updates.failures);
+        ASSERT_EQUAL_INT(0, updates.nodb);
+        ASSERT_TRUE(pool->size(pool) <= 3);
+
+        ASSERT_TRUE(pool->submit_query(pool, "SELECT COUNT(*) FROM qdb_async",
+                                       _on_query, &queries));
+        ASSERT_TRUE(pool->submit_query(pool, "SELEC nothing", _on_query,
+                                       &queries));
+        ASSERT_TRUE(pool->drain(pool, 5000));
+        ASSERT_EQUAL_INT(2, queries.calls);
+        ASSERT_EQUAL_INT(20, queries.value);
+        ASSERT_EQUAL_INT(1, queries.failures);
+
+        // nothing to wait
+        ASSERT_TRUE(pool->drain(pool, 0));
+
+        // still running
+        ASSERT_TRUE(pool->submit_query(pool, "SELECT SLEEP(1)", NULL, NULL));
+        errno = 0;
+        ASSERT_FALSE(pool->drain(pool, 100));
+        ASSERT_EQUAL_INT(ETIMEDOUT, errno);
+        ASSERT_FALSE(pool->drain(pool, 0));
+        ASSERT_TRUE(pool->drain(pool, -1));
+
+        errno = 0;
+        ASSERT_FALSE(pool->submit_query(pool, NULL, _on_query, &queries));
+        ASSERT_EQUAL_INT(EINVAL, errno);
+
+        // the queued ones are finished by free
+        updates.calls = 0;
+        for (i = 0; i < 10; i++) {
+            ASSERT_TRUE(pool->submit_update(pool, "DELETE FROM qdb_async "
+                                            "WHERE k = 0", _on_update,
+                                            &updates));
+        }
+        db = pool->get(pool, 5000);
+        ASSERT_TRUE(db != NULL
+                    && db->execute_update(db, "DROP TABLE qdb_async") >= 0
+                    && pool->release(pool, db));
+        pool->free(pool);
+        ASSERT_EQUAL_INT(10, updates.calls);
+
+        // no connection for the callback
+        pool = qdbpool("MYSQL", "127.0.0.1", 1, user, password, database, true,
+                       0, 1);
+        ASSERT_NOT_NULL(pool);
+        queries.calls = queries.nodb = queries.failures = 0;
+        ASSERT_TRUE(pool != NULL && pool->submit_query(pool, "SELECT 1",
+                                                       _on_query, &queries)
+                    && pool->drain(pool, 5000));
+        ASSERT_EQUAL_INT(1, queries.calls);
+        ASSERT_EQUAL_INT(1, queries.nodb);
+        ASSERT_EQUAL_INT(1, queries.failures);
+        if (pool != NULL)
+            pool->free(pool);
+
+        pthread_mutex_destroy(&updates.lock);
+        pthread_mutex_destroy(&queries.lock);
+    }
+}
+
+QUNIT_END();
@@ -0,0 +1,130 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#include <errno.h>
+#include <pthread.h>
+#include "qunit.h"
+#include "qlibc.h"
+
+#define NUM_THIEVES (4)
+#define NUM_ITEMS   (200000)
+
+static void *test_thief(void *arg);
+
+static qdeque_t *g_dq;
+static int g_done;
+static char g_taken[NUM_ITEMS];
+
+QUNIT_START("Test qdeque.c");
+
+TEST("Test basic features") {
+    qdeque_t *dq = qdeque(2);
+    int items[100];
+    int i;
+    ASSERT_NULL(dq->pop(dq));
+    ASSERT_EQUAL_INT(ENOENT, errno);
+    ASSERT_NULL(dq->steal(dq));
+    ASSERT_EQUAL_INT(ENOENT, errno);
+    ASSERT_FALSE(dq->push(dq, NULL));
+
+    // grows from 2 slots
+    for (i = 0; i < 100; i++) {
+        ASSERT_TRUE(dq->push(dq, &items[i]));
+    }
+    ASSERT_EQUAL_INT(100, dq->size(dq));
+
+    // owner takes the latest, thieves take the oldest
+    ASSERT_TRUE(dq->pop(dq) == &items[99]);
+    ASSERT_TRUE(dq->steal(dq) == &items[0]);
+    ASSERT_TRUE(dq->steal(dq) == &items[1]);
+    ASSERT_TRUE(dq->pop(dq) == &items[98]);
+    ASSERT_EQUAL_INT(96, dq->size(dq));
+    for (i = 97; i >= 2; i--) {
+        ASSERT_TRUE(dq->pop(dq) == &items[i]);
+    }
+    ASSERT_NULL(dq->pop(dq));
+    ASSERT_EQUAL_INT(0, dq->size(dq));
+
+    dq->free(dq);
+}
+
+TEST("Test stealing from multiple threads") {
+    static int items[NUM_ITEMS];
+    g_dq = qdeque(0);
+    g_done = 0;
+    memset(g_taken, 0, sizeof(g_taken));
+
+    pthread_t thieves[NUM_THIEVES];
+    int i;
+    for (i = 0; i < NUM_THIEVES; i++) {
+        pthread_create(&thieves[i], NULL, test_thief, NULL);
+    }
+
+    size_t popped = 0;
+    for (i = 0; i < NUM_ITEMS; i++) {
+        items[i] = i;
+        ASSERT_TRUE(g_dq->push(g_dq, &items[i]));
+        if (i % 3 == 0) {
+            int *item = g_dq->pop(g_dq);
+            if (item != NULL) {
+                __atomic_add_fetch(&g_taken[*item], 1, __ATOMIC_RELAXED);
+                popped++;
+            }
+        }
+    }
+    int *item;
+    while ((item = g_dq->pop(g_dq)) != NULL) {
+        __atomic_add_fetch(&g_taken[*item], 1, __ATOMIC_RELAXED);
+        popped++;
+    }
+    __atomic_store_n(&g_done, 1, __ATOMIC_RELEASE);
+    for (i = 0; i < NUM_THIEVES; i++) {
+        pthread_join(thieves[i], NULL);
+    }
+
+    // every item is taken exactly once
+    for (i = 0; i < NUM_ITEMS; i++) {
+        ASSERT_EQUAL_INT(1, g_taken[i]);
+    }
+    ASSERT_TRUE(popped <= NUM_ITEMS);
+    g_dq->free(g_dq);
+}
+
+QUNIT_END();
+
+static void *test_thief(void *arg) {
+    while (true) {
+        int *item = g_dq->steal(g_dq);
+        if (item != NULL) {
+            __atomic_add_fetch(&g_taken[*item], 1, __ATOMIC_RELAXED);
+        } else if (errno == ENOENT && __atomic_load_n(&g_done, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,222 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#include <errno.h>
+#include <ctype.h>
+#include "qunit.h"
+#include "qlibc.h"
+
+QUNIT_START("Test qencode.c");
+
+TEST("qurl_encode() / qurl_decode()") {
+    char *enc = qurl_encode("hello 'qLibc' world", 19);
+    ASSERT_EQUAL_STR("hello%20%27qLibc%27%20world", enc);
+    ASSERT_EQUAL_INT(19, qurl_decode(enc));
+    ASSERT_EQUAL_STR("hello 'qLibc' world", enc);
+    free(enc);
+
+    char str[] = "a+b%2Bc%";
+    ASSERT_EQUAL_INT(6, qurl_decode(str));
+    ASSERT_EQUAL_STR("a b+c%", str);
+
+    char buf[8];
+    ASSERT_EQUAL_INT(3, qurl_decode_into(buf, sizeof(buf), "%41+Bxx", 5));
+    ASSERT_EQUAL_STR("A B", buf);
+    ASSERT_EQUAL_INT(-1, qurl_decode_into(buf, 5, "%41+Bxx", 5));
+    ASSERT_EQUAL_INT(ENOBUFS, errno);
+}
+
+TEST("qparse_queries() / qquery_getnext()") {
+    const char *query = " a =1&b&c=x%20y+z&&d=%3D";
+    int count = 0;
+    qlisttbl_t *tbl = qparse_queries(NULL, query, '=', '&', &count);
+    ASSERT_EQUAL_INT(5, count);
+    ASSERT_EQUAL_STR("1", tbl->getstr(tbl, "a", false));
+    ASSERT_EQUAL_STR("", tbl->getstr(tbl, "b", false));
+    ASSERT_EQUAL_STR("x y z", tbl->getstr(tbl, "c", false));
+    ASSERT_EQUAL_STR("=", tbl->getstr(tbl, "d", false));
+    tbl->free(tbl);
+
+    const char *names[] = { "a", "b", "c", "", "d" };
+    const char *values[] = { "1", "", "x%20y+z", "", "%3D" };
+    qquery_t obj;
+    memset((void *) &obj, 0, sizeof(obj));
+    int i;
+    for (i = 0; qquery_getnext(query, strlen(query), '=', '&', &obj); i++) {
+        ASSERT_EQUAL_INT(strlen(names[i]), obj.namesize);
+        ASSERT_EQUAL_MEM(names[i], obj.name, obj.namesize);
+        ASSERT_EQUAL_INT(strlen(values[i]), obj.valuesize);
+        ASSERT_EQUAL_MEM(values[i], obj.value, obj.valuesize);
+    }
+    ASSERT_EQUAL_INT(5, i);
+}
+
+TEST("qbase64_encode() / qbase64_decode()") {
+    const char *vectors[][2] = {
+        { "", "" }, { "f", "Zg==" }, { "fo", "Zm8=" }, { "foo", "Zm9v" },
+        { "foob", "Zm9vYg==" }, { "fooba", "Zm9vYmE=" },
+        { "foobar", "Zm9vYmFy" }
+    };
+    int i;
+    for (i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+        char *enc = qbase64_encode(vectors[i][0], strlen(vectors[i][0]));
+        ASSERT_EQUAL_STR(vectors[i][1], enc);
+        ASSERT_EQUAL_INT(strlen(vectors[i][0]), qbase64_decode(enc));
+        ASSERT_EQUAL_STR(vectors[i][0], enc);
+        free(enc);
+    }
+
+    // padding and white spaces are skipped
+    char str[] = "Zm9v\r\nYmFy \n";
+    ASSERT_EQUAL_INT(6, qbase64_decode(str));
+    ASSERT_EQUAL_STR("foobar", str);
+}
+
+TEST("qbase64_encode_into() / qbase64_decode_into()") {
+    char buf[16];
+    ASSERT_EQUAL_INT(8, qbase64_encode_len(6));
+    ASSERT_EQUAL_INT(8, qbase64_encode_into(buf, 9, "foobar", 6));
+    ASSERT_EQUAL_STR("Zm9vYmFy", buf);
+    ASSERT_EQUAL_INT(-1, qbase64_encode_into(buf, 8, "foobar", 6));
+    ASSERT_EQUAL_INT(ENOBUFS, errno);
+
+    unsigned char bin[16];
+    ASSERT_EQUAL_INT(6, qbase64_decode_len(8));
+    ASSERT_EQUAL_INT(6, qbase64_decode_into(bin, 6, "Zm9vYmFy", 8));
+    ASSERT_EQUAL_MEM("foobar", bin, 6);
+    ASSERT_EQUAL_INT(-1, qbase64_decode_into(bin, 5, "Zm9vYmFy", 8));
+    ASSERT_EQUAL_INT(ENOBUFS, errno);
+}
+
+TEST("Test base64 of long data") {
+    // long enough to go through the vector paths and the tails
+    size_t size;
+    for (size = 0; size < 1000; size += 37) {
+        unsigned char *data = malloc(size + 1);
+        size_t i;
+        for (i = 0; i < size; i++) {
+            data[i] = (unsigned char) (i * 7 + size);
+        }
+
+        char *enc = qbase64_encode(data, size);
+        ASSERT_EQUAL_INT(qbase64_encode_len(size), strlen(enc));
+        for (i = 0; enc[i] != '\0'; i++) {
+            ASSERT_TRUE(isalnum(enc[i]) || strchr("+/=", enc[i]) != NULL);
+        }
+
+        // decode in place
+        ASSERT_EQUAL_INT(size, qbase64_decode(enc));
+        ASSERT_EQUAL_MEM(data, enc, size);
+        free(enc);
+        free(data);
+    }
+}
+
+TEST("qhex_encode() / qhex_decode()") {
+    char *enc = qhex_encode("hello world", 11);
+    ASSERT_EQUAL_STR("68656c6c6f20776f726c64", enc);
+    ASSERT_EQUAL_INT(11, qhex_decode(enc));
+    ASSERT_EQUAL_STR("hello world", enc);
+    free(enc);
+
+    char str[] = "48454C4C4F";
+    ASSERT_EQUAL_INT(5, qhex_decode(str));
+    ASSERT_EQUAL_STR("HELLO", str);
+}
+
+TEST("qhex_encode_into() / qhex_decode_into()") {
+    char buf[80];
+    unsigned char data[32], bin[32];
+    int i;
+    for (i = 0; i < sizeof(data); i++) {
+        data[i] = i * 8;
+    }
+
+    ASSERT_EQUAL_INT(64, qhex_encode_into(buf, sizeof(buf), data, 32));
+    ASSERT_EQUAL_MEM("0008101820283038", buf, 16);
+    ASSERT_EQUAL_INT(-1, qhex_encode_into(buf, 64, data, 32));
+    ASSERT_EQUAL_INT(ENOBUFS, errno);
+
+    ASSERT_EQUAL_INT(32, qhex_decode_into(bin, sizeof(bin), buf, 64));
+    ASSERT_EQUAL_MEM(data, bin, 32);
+    ASSERT_EQUAL_INT(2, qhex_decode_into(bin, 2, "abc", 3));
+    ASSERT_EQUAL_MEM("\xab\xc0", bin, 2);
+}
+
+TEST("qcodec_update() / qcodec_final()") {
+    // byte by byte gives the same as at once
+    const char *text = "hello 'qLibc' world";
+    int type;
+    for (type = QCODEC_BASE64_ENCODE; type <= QCODEC_URL_ENCODE; type += 2) {
+        char *expected = (type == QCODEC_BASE64_ENCODE) ?
+                qbase64_encode(text, strlen(text)) :
+                (type == QCODEC_HEX_ENCODE) ?
+                qhex_encode(text, strlen(text)) :
+                qurl_encode(text, strlen(text));
+
+        // encode
+        qcodec_t codec;
+        ASSERT_TRUE(qcodec_init(&codec, type));
+        char enc[128];
+        size_t enclen = 0, i;
+        for (i = 0; i < strlen(text); i++) {
+            ssize_t n = qcodec_update(&codec, enc + enclen,
+                                      sizeof(enc) - enclen, text + i, 1);
+            ASSERT_TRUE(n >= 0);
+            enclen += n;
+        }
+        enclen += qcodec_final(&codec, enc + enclen, sizeof(enc) - enclen);
+        ASSERT_EQUAL_INT(strlen(expected), enclen);
+        ASSERT_EQUAL_MEM(expected, enc, enclen);
+
+        // decode
+        ASSERT_TRUE(qcodec_init(&codec, type + 1));
+        char dec[128];
+        size_t declen = 0;
+        for (i = 0; i < enclen; i++) {
+            ssize_t n = qcodec_update(&codec, dec + declen,
+                                      sizeof(dec) - declen, enc + i, 1);
+            ASSERT_TRUE(n >= 0);
+            declen += n;
+        }
+        declen += qcodec_final(&codec, dec + declen, sizeof(dec) - declen);
+        ASSERT_EQUAL_INT(strlen(text), declen);
+        ASSERT_EQUAL_MEM(text, dec, declen);
+        free(expected);
+    }
+
+    qcodec_t codec;
+    ASSERT_FALSE(qcodec_init(&codec, -1));
+    ASSERT_EQUAL_INT(EINVAL, errno);
+    qcodec_init(&codec, QCODEC_HEX_ENCODE);
+    char buf[4];
+    ASSERT_EQUAL_INT(-1, qcodec_update(&codec, buf, sizeof(buf), "abc", 3));
+    ASSERT_EQUAL_INT(ENOBUFS, errno);
+}
+
+QUNIT_END();
@@ -0,0 +1,367 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include "qunit.h"
+#include "qlibc.h"
+#include "qlibcext.h"
+
+// a non-blocking pipe
+static bool _pipe(int fds[2]) {
+    if (pipe(fds) != 0)
+        return false;
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+    return true;
+}
+
+// what the callbacks saw
+struct calls {
+    int count;
+    int lastfd;
+    int lastevents;
+    int fds[4];     // the other descriptors to act on
+    int order[8];   // timer ids in the order of expiry
+};
+
+static void _drain(int fd) {
+    char buf[64];
+    while (read(fd, buf, sizeof(buf)) > 0);
+}
+
+static void _on_read(qevloop_t *loop, int fd, int events, void *userdata) {
+    struct calls *calls = (struct calls *) userdata;
+    calls->count++;
+    calls->lastfd = fd;
+    calls->lastevents = events;
+    _drain(fd);
+}
+
+// removes every descriptor, so only one of them is called back
+static void _on_read_remove(qevloop_t *loop, int fd, int events,
+                            void *userdata) {
+    struct calls *calls = (struct calls *) userdata;
+    calls->count++;
+    loop->remove(loop, calls->fds[0]);
+    loop->remove(loop, calls->fds[1]);
+}
+
+// pauses itself and watches fds[0] instead
+static void _on_read_switch(qevloop_t *loop, int fd, int events,
+                            void *userdata) {
+    struct calls *calls = (struct calls *) userdata;
+    calls->count++;
+    loop->modify(loop, fd, 0);
+    loop->add(loop, calls->fds[0], QEVLOOP_READ, _on_read, userdata);
+}
+
+static void _on_timer(qevloop_t *loop, int timerid, void *userdata) {
+    struct calls *calls = (struct calls *) userdata;
+    if (calls->count < 8)
+        calls->order[calls->count] = timerid;
+    calls->count++;
+}
+
+// cancels the timer fds[0] and itself
+static void _on_timer_remove(qevloop_t *loop, int timerid, void *userdata) {
+    struct calls *calls = (struct calls *) userdata;
+    calls->count++;
+    loop->removetimer(loop, calls->fds[0]);
+    loop->removetimer(loop, timerid);
+}
+
+static void _on_timer_stop(qevloop_t *loop, int timerid, void *userdata) {
+    struct calls *calls = (struct calls *) userdata;
+    if (++calls->count == 3)
+        loop->stop(loop);
+}
+
+// takes a line at a time off the reader, like a line protocol does
+struct lines {
+    qio_reader_t *reader;
+    char got[8][16];
+    int num;
+    int removeat;
+};
+
+static void _on_line(qevloop_t *loop, int fd, int events, void *userdata) {
+    struct lines *lines = (struct lines *) userdata;
+    if (lines->num >= 8)
+        return;
+    if (qio_reader_gets(lines->reader, lines->got[lines->num], 16, 0) > 0) {
+        if (++lines->num == lines->removeat)
+            loop->remove(loop, fd);
+    }
+}
+
+QUNIT_START("Test qevloop.c");
+
+TEST("Test add(), modify() and remove()") {
+    qevloop_t *loop = qevloop(0);
+    ASSERT_NOT_NULL(loop);
+    int fds[2];
+    ASSERT_TRUE(_pipe(fds));
+    struct calls calls;
+    memset(&calls, 0, sizeof(calls));
+
+    ASSERT_TRUE(loop->add(loop, fds[0], QEVLOOP_READ, _on_read, &calls));
+    ASSERT_FALSE(loop->add(loop, fds[0], QEVLOOP_READ, _on_read, &calls));
+    ASSERT_EQUAL_INT(EEXIST, errno);
+    ASSERT_FALSE(loop->add(loop, -1, QEVLOOP_READ, _on_read, &calls));
+    ASSERT_EQUAL_INT(EINVAL, errno);
+    ASSERT_EQUAL_INT(0, loop->once(loop, 0));
+
+    ASSERT_EQUAL_INT(1, write(fds[1], "x", 1));
+    ASSERT_EQUAL_INT(1, loop->once(loop, 1000));
+    ASSERT_EQUAL_INT(1, calls.count);
+    ASSERT_EQUAL_INT(fds[0], calls.lastfd);
+    ASSERT_EQUAL_INT(QEVLOOP_READ, calls.lastevents);
+
+    // paused
+    ASSERT_TRUE(loop->modify(loop, fds[0], 0));
+    ASSERT_EQUAL_INT(1, write(fds[1], "x", 1));
+    ASSERT_EQUAL_INT(0, loop->once(loop, 50));
+    ASSERT_TRUE(loop->modify(loop, fds[0], QEVLOOP_READ));
+    ASSERT_EQUAL_INT(1, loop->once(loop, 1000));
+    ASSERT_EQUAL_INT(2, calls.count);
+
+    // the write end is always writable
+    ASSERT_TRUE(loop->add(loop, fds[1], QEVLOOP_WRITE, _on_read, &calls));
+    ASSERT_EQUAL_INT(1, loop->once(loop, 1000));
+    ASSERT_EQUAL_INT(fds[1], calls.lastfd);
+    ASSERT_EQUAL_INT(QEVLOOP_WRITE, calls.lastevents);
+    ASSERT_TRUE(loop->remove(loop, fds[1]));
+
+    ASSERT_TRUE(loop->remove(loop, fds[0]));
+    ASSERT_FALSE(loop->remove(loop, fds[0]));
+    ASSERT_EQUAL_INT(ENOENT, errno);
+    ASSERT_FALSE(loop->modify(loop, fds[0], QEVLOOP_READ));
+    ASSERT_EQUAL_INT(ENOENT, errno);
+    ASSERT_EQUAL_INT(1, write(fds[1], "x", 1));
+    ASSERT_EQUAL_INT(0, loop->once(loop, 50));
+
+    // hang-up comes with the watched events
+    ASSERT_TRUE(loop->add(loop, fds[0], QEVLOOP_READ, _on_read, &calls));
+    close(fds[1]);
+    ASSERT_EQUAL_INT(1, loop->once(loop, 1000));
+    ASSERT_TRUE((calls.lastevents & QEVLOOP_READ) != 0);
+    ASSERT_TRUE(loop->remove(loop, fds[0]));
+
+    close(fds[0]);
+    loop->free(loop);
+}
+
+TEST("Test remove() of other descriptors from a callback") {
+    qevloop_t *loop = qevloop(0);
+    ASSERT_NOT_NULL(loop);
+    int p1[2], p2[2];
+    ASSERT_TRUE(_pipe(p1));
+    ASSERT_TRUE(_pipe(p2));
+    struct calls calls;
+    memset(&calls, 0, sizeof(calls));
+    calls.fds[0] = p1[0];
+    calls.fds[1] = p2[0];
+
+    // both are ready in the same round
+    ASSERT_TRUE(loop->add(loop, p1[0], QEVLOOP_READ, _on_read_remove, &calls));
+    ASSERT_TRUE(loop->add(loop, p2[0], QEVLOOP_READ, _on_read_remove, &calls));
+    ASSERT_EQUAL_INT(1, write(p1[1], "x", 1));
+    ASSERT_EQUAL_INT(1, write(p2[1], "x", 1));
+    ASSERT_EQUAL_INT(1, loop->once(loop, 1000));
+    ASSERT_EQUAL_INT(1, calls.count);
+    ASSERT_EQUAL_INT(0, loop->once(loop, 50));
+
+    // the slots are free again
+    ASSERT_TRUE(loop->add(loop, p1[0], QEVLOOP_READ, _on_read, &calls));
+    ASSERT_EQUAL_INT(1, loop->once(loop, 1000));
+    ASSERT_TRUE(loop->remove(loop, p1[0]));
+
+    close(p1[0]);
+    close(p1[1]);
+    close(p2[0]);
+    close(p2[1]);
+    loop->free(loop);
+}
+
+TEST("Test add() and modify() from a callback") {
+    qevloop_t *loop = qevloop(0);
+    ASSERT_NOT_NULL(loop);
+    int p1[2], p2[2];
+    ASSERT_TRUE(_pipe(p1));
+    ASSERT_TRUE(_pipe(p2));
+    struct calls calls;
+    memset(&calls, 0, sizeof(calls));
+    calls.fds[0] = p2[0];
+
+    ASSERT_TRUE(loop->add(loop, p1[0], QEVLOOP_READ, _on_read_switch, &calls));
+    ASSERT_EQUAL_INT(1, write(p1[1], "x", 1));
+    ASSERT_EQUAL_INT(1, write(p2[1], "x", 1));
+    ASSERT_EQUAL_INT(1, loop->once(loop, 1000));
+    ASSERT_EQUAL_INT(1, calls.count);
+
+    // p1 is left unread but paused, p2 is watched now
+    ASSERT_EQUAL_INT(1, loop->once(loop, 1000));
+    ASSERT_EQUAL_INT(2, calls.count);
+    ASSERT_EQUAL_INT(p2[0], calls.lastfd);
+    ASSERT_EQUAL_INT(0, loop->once(loop, 50));
+
+    ASSERT_TRUE(loop->remove(loop, p1[0]));
+    ASSERT_TRUE(loop->remove(loop, p2[0]));
+    close(p1[0]);
+    close(p1[1]);
+    close(p2[0]);
+    close(p2[1]);
+    loop->free(loop);
+}
+
+TEST("Test timers expire in order") {
+    qevloop_t *loop = qevloop(0);
+    ASSERT_NOT_NULL(loop);
+    struct calls calls;
+    memset(&calls, 0, sizeof(calls));
+
+    int intervals[] = { 40, 10, 30, 20, 50 };
+    int ids[5];
+    int i;
+    for (i = 0; i < 5; i++) {
+        ids[i] = loop->addtimer(loop, intervals[i], false, _on_timer, &calls);
+        ASSERT_TRUE(ids[i] > 0);
+    }
+    ASSERT_EQUAL_INT(-1, loop->addtimer(loop, 10, false, NULL, &calls));
+    ASSERT_EQUAL_INT(EINVAL, errno);
+    ASSERT_TRUE(loop->removetimer(loop, ids[4]));
+    ASSERT_FALSE(loop->removetimer(loop, ids[4]));
+    ASSERT_EQUAL_INT(ENOENT, errno);
+
+    // once() waits for the timers by itself
+    for (i = 0; i < 100 && calls.count < 4; i++) {
+        ASSERT_TRUE(loop->once(loop, -1) >= 0);
+    }
+    ASSERT_EQUAL_INT(4, calls.count);
+    ASSERT_EQUAL_INT(ids[1], calls.order[0]);
+    ASSERT_EQUAL_INT(ids[3], calls.order[1]);
+    ASSERT_EQUAL_INT(ids[2], calls.order[2]);
+    ASSERT_EQUAL_INT(ids[0], calls.order[3]);
+
+    // expired ones are gone
+    ASSERT_FALSE(loop->removetimer(loop, ids[1]));
+    ASSERT_EQUAL_INT(0, loop->once(loop, 80));
+    ASSERT_EQUAL_INT(4, calls.count);
+
+    loop->free(loop);
+}
+
+TEST("Test removetimer() from a timer callback") {
+    qevloop_t *loop = qevloop(0);
+    ASSERT_NOT_NULL(loop);
+    struct calls calls;
+    memset(&calls, 0, sizeof(calls));
+
+    // a repeating timer cancels itself and the other one due after it
+    ASSERT_TRUE(loop->addtimer(loop, 10, true, _on_timer_remove, &calls) > 0);
+    calls.fds[0] = loop->addtimer(loop, 20, false, _on_timer_remove, &calls);
+    ASSERT_TRUE(calls.fds[0] > 0);
+    usleep(40 * 1000);
+    ASSERT_EQUAL_INT(1, loop->once(loop, 0));
+    ASSERT_EQUAL_INT(1, calls.count);
+    ASSERT_EQUAL_INT(0, loop->once(loop, 50));
+    ASSERT_EQUAL_INT(1, calls.count);
+
+    loop->free(loop);
+}
+
+TEST("Test callbacks for data left in a reader") {
+    qevloop_t *loop = qevloop(0);
+    ASSERT_NOT_NULL(loop);
+    int sv[2];
+    ASSERT_EQUAL_INT(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+    fcntl(sv[0], F_SETFL, fcntl(sv[0], F_GETFL) | O_NONBLOCK);
+
+    struct lines lines;
+    memset(&lines, 0, sizeof(lines));
+    lines.reader = qio_reader(sv[0], 0);
+    ASSERT_NOT_NULL(lines.reader);
+    ASSERT_TRUE(loop->add(loop, sv[0], QEVLOOP_READ, _on_line, &lines));
+    ASSERT_TRUE(loop->setreader(loop, sv[0], lines.reader));
+    ASSERT_FALSE(loop->setreader(loop, sv[1], lines.reader));
+    ASSERT_EQUAL_INT(ENOENT, errno);
+
+    // one kernel event for all the lines, the rest is in the reader
+    ASSERT_EQUAL_INT(8, write(sv[1], "a\nb\nc\nd\n", 8));
+    int i;
+    for (i = 0; i < 10 && lines.num < 4; i++) {
+        ASSERT_TRUE(loop->once(loop, 1000) > 0);
+    }
+    ASSERT_EQUAL_INT(4, lines.num);
+    ASSERT_EQUAL_STR("a", lines.got[0]);
+    ASSERT_EQUAL_STR("b", lines.got[1]);
+    ASSERT_EQUAL_STR("c", lines.got[2]);
+    ASSERT_EQUAL_STR("d", lines.got[3]);
+    ASSERT_EQUAL_INT(0, loop->once(loop, 50));
+
+    // removed from the callback while it's queued
+    lines.num = 0;
+    lines.removeat = 2;
+    ASSERT_EQUAL_INT(8, write(sv[1], "e\nf\ng\nh\n", 8));
+    for (i = 0; i < 5; i++) {
+        loop->once(loop, 50);
+    }
+    ASSERT_EQUAL_INT(2, lines.num);
+    ASSERT_EQUAL_STR("e", lines.got[0]);
+    ASSERT_EQUAL_STR("f", lines.got[1]);
+
+    qio_reader_free(lines.reader);
+    close(sv[0]);
+    close(sv[1]);
+    loop->free(loop);
+}
+
+TEST("Test run() until stop()") {
+    qevloop_t *loop = qevloop(0);
+    ASSERT_NOT_NULL(loop);
+    struct calls calls;
+    memset(&calls, 0, sizeof(calls));
+
+    ASSERT_TRUE(loop->addtimer(loop, 10, true, _on_timer_stop, &calls) > 0);
+    ASSERT_TRUE(loop->run(loop));
+    ASSERT_EQUAL_INT(3, calls.count);
+
+    // stop() ahead of run() takes effect in the first round
+    ASSERT_TRUE(loop->stop(loop));
+    ASSERT_TRUE(loop->run(loop));
+    ASSERT_TRUE(calls.count <= 4);
+
+    loop->free(loop);
+}
+
+QUNIT_END();
@@ -0,0 +1,161 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include "qunit.h"
+#include "qlibc.h"
+
+// creates an empty temporary file and returns its descriptor
+static int make_tmpfile(char *path) {
+    strcpy(path, "/tmp/test_qfile_XXXXXX");
+    return mkstemp(path);
+}
+
+QUNIT_START("Test qfile.c");
+
+TEST("Test qfile_map() maps the whole file") {
+    char path[32];
+    int fd = make_tmpfile(path);
+    ASSERT_TRUE(fd >= 0);
+    close(fd);
+
+    const char *text = "name = value\nkey = data\n";
+    ASSERT_EQUAL_INT(strlen(text), qfile_save(path, text, strlen(text), false));
+
+    size_t size = 0;
+    const char *map = qfile_map(path, &size, QFILE_MAP_SEQUENTIAL);
+    ASSERT_NOT_NULL(map);
+    ASSERT_EQUAL_INT(strlen(text), size);
+    ASSERT_EQUAL_MEM(text, map, size);
+    ASSERT_TRUE(qfile_unmap(map, size));
+
+    // all the hints are advisory
+    size = 0;
+    map = qfile_map(path, &size, QFILE_MAP_SEQUENTIAL | QFILE_MAP_WILLNEED
+                                 | QFILE_MAP_HUGEPAGE);
+    ASSERT_NOT_NULL(map);
+    ASSERT_EQUAL_MEM(text, map, size);
+    ASSERT_TRUE(qfile_unmap(map, size));
+
+    // NULL size maps the whole file without telling the size
+    map = qfile_map(path, NULL, 0);
+    ASSERT_NOT_NULL(map);
+    ASSERT_EQUAL_MEM(text, map, strlen(text));
+    ASSERT_TRUE(qfile_unmap(map, strlen(text)));
+
+    unlink(path);
+}
+
+TEST("Test qfile_map() with a size limit") {
+    char path[32];
+    int fd = make_tmpfile(path);
+    ASSERT_TRUE(fd >= 0);
+    close(fd);
+    ASSERT_EQUAL_INT(10, qfile_save(path, "0123456789", 10, false));
+
+    size_t size = 4;
+    const char *map = qfile_map(path, &size, 0);
+    ASSERT_NOT_NULL(map);
+    ASSERT_EQUAL_INT(4, size);
+    ASSERT_EQUAL_MEM("0123", map, size);
+    ASSERT_TRUE(qfile_unmap(map, size));
+
+    // a limit beyond the end is cut at the file size
+    size = 100;
+    map = qfile_map(path, &size, 0);
+    ASSERT_NOT_NULL(map);
+    ASSERT_EQUAL_INT(10, size);
+    ASSERT_TRUE(qfile_unmap(map, size));
+
+    unlink(path);
+}
+
+TEST("Test qfile_map() with an empty or missing file") {
+    char path[32];
+    int fd = make_tmpfile(path);
+    ASSERT_TRUE(fd >= 0);
+    close(fd);
+
+    size_t size = 0;
+    const char *map = qfile_map(path, &size, 0);
+    ASSERT_NOT_NULL(map);
+    ASSERT_EQUAL_INT(0, size);
+    ASSERT_TRUE(qfile_unmap(map, size));
+
+    unlink(path);
+    size = 0;
+    ASSERT_NULL(qfile_map(path, &size, 0));
+    ASSERT_NULL(qfile_map(NULL, &size, 0));
+}
+
+TEST("Test qfile_save_atomic() replaces the file") {
+    char path[32];
+    int fd = make_tmpfile(path);
+    ASSERT_TRUE(fd >= 0);
+    close(fd);
+    ASSERT_EQUAL_INT(3, qfile_save(path, "old", 3, false));
+
+    ASSERT_EQUAL_INT(3, qfile_save_atomic(path, "new", 3, false));
+    size_t size = 0;
+    char *data = qfile_load(path, &size);
+    ASSERT_NOT_NULL(data);
+    ASSERT_EQUAL_INT(3, size);
+    ASSERT_EQUAL_STR("new", data);
+    free(data);
+
+    // with sync and with nothing to write
+    ASSERT_EQUAL_INT(5, qfile_save_atomic(path, "newer", 5, true));
+    ASSERT_EQUAL_INT(5, qfile_get_size(path));
+    ASSERT_EQUAL_INT(0, qfile_save_atomic(path, NULL, 0, true));
+    ASSERT_EQUAL_INT(0, qfile_get_size(path));
+
+    unlink(path);
+}
+
+TEST("Test qfile_save_atomic() leaves no temporary file") {
+    char dir[] = "/tmp/test_qfile_XXXXXX";
+    ASSERT_NOT_NULL(mkdtemp(dir));
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/file", dir);
+
+    ASSERT_EQUAL_INT(4, qfile_save_atomic(path, "data", 4, false));
+    ASSERT_EQUAL_INT(4, qfile_get_size(path));
+    ASSERT_EQUAL_INT(0, unlink(path));
+
+    // the directory is empty again
+    ASSERT_EQUAL_INT(0, rmdir(dir));
+
+    // failures to create the temporary file are reported
+    ASSERT_EQUAL_INT(-1, qfile_save_atomic(path, "data", 4, false));
+    ASSERT_FALSE(qfile_exist(path));
+}
+
+QUNIT_END();
@@ -0,0 +1,135 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#include <errno.h>
+#include <unistd.h>
+#include "qunit.h"
+#include "qlibc.h"
+
+QUNIT_START("Test qgrow.c");
+
+TEST("Test list mode") {
+    qgrow_t *grow = qgrow(0);
+    ASSERT_TRUE(grow->addstr(grow, "AB"));
+    ASSERT_TRUE(grow->addstrf(grow, "%d", 12));
+    ASSERT_TRUE(grow->addstr(grow, "CD"));
+    ASSERT_EQUAL_INT(3, grow->size(grow));
+    ASSERT_EQUAL_INT(6, grow->datasize(grow));
+
+    char *str = grow->tostring(grow);
+    ASSERT_EQUAL_STR("AB12CD", str);
+    free(str);
+    ASSERT_NULL(grow->buffer(grow, NULL));
+    ASSERT_EQUAL_INT(ENOTSUP, errno);
+
+    struct iovec iov[4];
+    ASSERT_EQUAL_INT(3, grow->toiovec(grow, NULL, 0));
+    ASSERT_EQUAL_INT(2, grow->toiovec(grow, iov, 2));
+    ASSERT_EQUAL_INT(3, grow->toiovec(grow, iov, 4));
+    ASSERT_EQUAL_MEM("12", iov[1].iov_base, 2);
+    ASSERT_EQUAL_INT(2, iov[2].iov_len);
+
+    grow->free(grow);
+}
+
+TEST("Test contiguous mode") {
+    qgrow_t *grow = qgrow(QGROW_CONTIGUOUS | QGROW_THREADSAFE);
+    size_t size;
+    ASSERT_NULL(grow->buffer(grow, &size));
+    ASSERT_EQUAL_INT(0, size);
+    ASSERT_EQUAL_INT(0, grow->toiovec(grow, NULL, 0));
+
+    ASSERT_TRUE(grow->addstr(grow, "AB"));
+    ASSERT_TRUE(grow->addstrf(grow, "%d", 12));
+    ASSERT_TRUE(grow->addstr(grow, "CD"));
+    ASSERT_EQUAL_INT(3, grow->size(grow));
+    ASSERT_EQUAL_STR("AB12CD", grow->buffer(grow, &size));
+    ASSERT_EQUAL_INT(6, size);
+
+    // grows over the initial buffer, formatted strings included
+    int i;
+    for (i = 0; i < 10000; i++) {
+        ASSERT_TRUE(grow->addstrf(grow, "%05d%s", i, (i % 100) ? "" :
+              "0123456789012345678901234567890123456789012345678901234567890123456789"));
+    }
+    const char *buf = grow->buffer(grow, &size);
+    ASSERT_EQUAL_INT(6 + 10000 * 5 + 100 * 70, size);
+    ASSERT_EQUAL_INT(size, strlen(buf));
+    ASSERT_EQUAL_MEM("AB12CD00000012", buf, 14);
+
+    char *str = grow->tostring(grow);
+    ASSERT_EQUAL_STR(buf, str);
+    free(str);
+    void *array = grow->toarray(grow, &size);
+    ASSERT_EQUAL_MEM(buf, array, size);
+    free(array);
+
+    struct iovec iov[1];
+    ASSERT_EQUAL_INT(1, grow->toiovec(grow, iov, 1));
+    ASSERT_TRUE(iov[0].iov_base == buf);
+    ASSERT_EQUAL_INT(size, iov[0].iov_len);
+
+    grow->clear(grow);
+    ASSERT_EQUAL_INT(0, grow->size(grow));
+    ASSERT_EQUAL_INT(0, grow->datasize(grow));
+    ASSERT_TRUE(grow->add(grow, "xyz", 3));
+    ASSERT_EQUAL_STR("xyz", grow->buffer(grow, NULL));
+
+    grow->free(grow);
+}
+TEST("Test toiovec() and qio_writev()") {
+    qgrow_t *grow = qgrow(0);
+    int i;
+    for (i = 0; i < 100; i++) {
+        ASSERT_TRUE(grow->addstrf(grow, "%02d", i));
+    }
+    size_t size;
+    char *expect = grow->toarray(grow, &size);
+    ASSERT_EQUAL_INT(200, size);
+
+    struct iovec iov[100];
+    ASSERT_EQUAL_INT(100, grow->toiovec(grow, iov, 100));
+
+    int fds[2];
+    ASSERT_EQUAL_INT(0, pipe(fds));
+    ASSERT_EQUAL_INT(200, qio_writev(fds[1], iov, 100, 1000));
+    ASSERT_EQUAL_INT(0, qio_writev(fds[1], iov, 0, 1000));
+
+    char buf[200];
+    ASSERT_EQUAL_INT(200, qio_read(fds[0], buf, sizeof(buf), 1000));
+    ASSERT_EQUAL_MEM(expect, buf, size);
+    // the caller's array is left untouched
+    ASSERT_EQUAL_INT(2, iov[99].iov_len);
+
+    close(fds[0]);
+    close(fds[1]);
+    free(expect);
+    grow->free(grow);
+}
+
+QUNIT_END();
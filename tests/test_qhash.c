@@ -123,4 +123,170 @@ TEST("qhashmd5_file(test_qhash_data_4.bin, 0, 0)") {
     free(hash);
 }
 
+TEST("qhashcrc32c()") {
+    ASSERT_EQUAL_INT(0, qhashcrc32c("", 0));
+    ASSERT_EQUAL_INT(0xe3069283, qhashcrc32c("123456789", 9));
+    ASSERT_EQUAL_INT(0x22620404, qhashcrc32c("The quick brown fox jumps over the lazy dog", 43));
+
+    // same result regardless of the alignment
+    char buf[64 + 8];
+    int i;
+    for (i = 0; i < 8; i++) {
+        memset(buf, 0, sizeof(buf));
+        memcpy(buf + i, "The quick brown fox jumps over the lazy dog", 43);
+        ASSERT_EQUAL_INT(0x22620404, qhashcrc32c(buf + i, 43));
+    }
+
+    // continued over blocks
+    uint32_t crc = qhashcrc32c_update(0, "1234", 4);
+    ASSERT_EQUAL_INT(0xe3069283, qhashcrc32c_update(crc, "56789", 5));
+    for (i = 0, crc = 0; i < 43; i++) {
+        crc = qhashcrc32c_update(crc, "The quick brown fox jumps over the lazy dog" + i, 1);
+    }
+    ASSERT_EQUAL_INT(0x22620404, crc);
+}
+
+TEST("qhashwyhash_64()") {
+    ASSERT_TRUE(0x93228a4de0eec5a2ULL == qhashwyhash_64("", 0));
+
+    // every length path gives distinct and stable values
+    char buf[128 + 8];
+    int i;
+    for (i = 0; i < sizeof(buf); i++) {
+        buf[i] = (char) i;
+    }
+    for (i = 1; i < 128; i++) {
+        ASSERT_TRUE(qhashwyhash_64(buf, i) != qhashwyhash_64(buf, i - 1));
+        ASSERT_TRUE(qhashwyhash_64(buf, i) != qhashwyhash_64(buf + 1, i));
+        ASSERT_TRUE(qhashwyhash_64(buf, i) == qhashwyhash_64(buf, i));
+    }
+    uint64_t h = qhashwyhash_64("hello", 5);
+    ASSERT_EQUAL_INT((uint32_t) (h ^ (h >> 32)), qhashwyhash_32("hello", 5));
+}
+
+TEST("qhashmurmur3_32_multi()") {
+    char buf[128];
+    const void *keys[50];
+    size_t sizes[50];
+    uint32_t hashes[50];
+    int i;
+    for (i = 0; i < sizeof(buf); i++) {
+        buf[i] = (char) (i * 7);
+    }
+    for (i = 0; i < 50; i++) {
+        keys[i] = (i % 13 == 5) ? NULL : buf + i % 8;
+        sizes[i] = (i * 11) % 70;
+    }
+
+    ASSERT_TRUE(qhashmurmur3_32_multi(keys, sizes, 50, hashes));
+    for (i = 0; i < 50; i++) {
+        ASSERT_EQUAL_INT(qhashmurmur3_32(keys[i], sizes[i]), hashes[i]);
+    }
+}
+
+TEST("qhashsha256()") {
+    unsigned char sha[32];
+    char *hex;
+
+    ASSERT_TRUE(qhashsha256("", 0, sha));
+    hex = qhex_encode(sha, 32);
+    ASSERT_EQUAL_STR("e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855", hex);
+    free(hex);
+
+    ASSERT_TRUE(qhashsha256("abc", 3, sha));
+    hex = qhex_encode(sha, 32);
+    ASSERT_EQUAL_STR("ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad", hex);
+    free(hex);
+
+    // two blocks of padding
+    const char *s = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    ASSERT_TRUE(qhashsha256(s, strlen(s), sha));
+    hex = qhex_encode(sha, 32);
+    ASSERT_EQUAL_STR("248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1", hex);
+    free(hex);
+}
+
+TEST("qhash_init/update/final() equal to the one-shot functions") {
+    char buf[300];
+    int i;
+    for (i = 0; i < sizeof(buf); i++) {
+        buf[i] = (char) (i % 255 + 1);
+    }
+
+    int type;
+    for (type = QHASH_MD5; type <= QHASH_WYHASH_64; type++) {
+        size_t len;
+        for (len = 0; len <= sizeof(buf); len += 7) {
+            unsigned char ref[32], out[32];
+            uint32_t h32;
+            uint64_t h64;
+            switch (type) {
+                case QHASH_MD5:
+                    qhashmd5(buf, len, ref);
+                    break;
+                case QHASH_SHA256:
+                    qhashsha256(buf, len, ref);
+                    break;
+                case QHASH_CRC32C:
+                    h32 = qhashcrc32c(buf, len);
+                    memcpy(ref, &h32, 4);
+                    break;
+                case QHASH_FNV1_32:
+                    h32 = qhashfnv1_32(buf, len);
+                    memcpy(ref, &h32, 4);
+                    break;
+                case QHASH_FNV1_64:
+                    h64 = qhashfnv1_64(buf, len);
+                    memcpy(ref, &h64, 8);
+                    break;
+                case QHASH_MURMUR3_32:
+                    h32 = qhashmurmur3_32(buf, len);
+                    memcpy(ref, &h32, 4);
+                    break;
+                case QHASH_MURMUR3_128:
+                    memset(ref, 0, 16);
+                    qhashmurmur3_128(buf, len, ref);
+                    break;
+                case QHASH_WYHASH_64:
+                    h64 = qhashwyhash_64(buf, len);
+                    memcpy(ref, &h64, 8);
+                    break;
+            }
+
+            // feed in uneven chunks
+            qhash_t ctx;
+            ASSERT_TRUE(qhash_init(&ctx, type));
+            size_t off, n;
+            for (off = 0, n = 1; off < len; off += n, n = n * 3 % 61 + 1) {
+                if (n > len - off)
+                    n = len - off;
+                ASSERT_TRUE(qhash_update(&ctx, buf + off, n));
+            }
+            ASSERT_EQUAL_INT(qhash_digestsize(type), qhash_final(&ctx, out));
+            ASSERT_EQUAL_MEM(ref, out, qhash_digestsize(type));
+        }
+    }
+
+    qhash_t ctx;
+    ASSERT_FALSE(qhash_init(&ctx, -1));
+}
+
+TEST("qhash_update_file()") {
+    unsigned char md5[16], out[16];
+    qhash_t ctx;
+
+    ASSERT_TRUE(qhashmd5_file("test_qhash_data_1.bin", 0, 0, md5));
+    ASSERT_TRUE(qhash_init(&ctx, QHASH_MD5));
+    ASSERT_TRUE(qhash_update_file(&ctx, "test_qhash_data_1.bin", 0, 0));
+    qhash_final(&ctx, out);
+    ASSERT_EQUAL_MEM(md5, out, 16);
+
+    ASSERT_TRUE(qhash_update_file(&ctx, "test_qhash_data_1.bin", 1, 2));
+    qhash_final(&ctx, out);
+    ASSERT_TRUE(qhashmd5_file("test_qhash_data_1.bin", 1, 2, md5));
+    ASSERT_EQUAL_MEM(md5, out, 16);
+
+    ASSERT_FALSE(qhash_update_file(&ctx, "test_qhash_data_1.bin", 0, 1000000));
+}
+
 QUNIT_END();
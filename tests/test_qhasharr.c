@@ -29,8 +29,12 @@
 #include "qunit.h"
 #include "qlibc.h"
 #include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
 
 void test_thousands_of_keys(size_t memsize, int num_keys, char *key_postfix, char *value_postfix);
+static int concurrent_worker(qhasharr_t *tbl, int num_keys, bool writer);
 
 QUNIT_START("Test qhasharr.c");
 
@@ -127,6 +131,316 @@ TEST("Test remove_by_idx()") {
     tbl->free(tbl);
 }
 
+TEST("Test qhasharr_ex() slot geometry") {
+    size_t memsize = qhasharr_calculate_memsize_ex(100, 64, 200);
+    ASSERT(memsize > qhasharr_calculate_memsize(100));
+    char *memory = malloc(memsize);
+    qhasharr_t *tbl = qhasharr_ex(memory, memsize, 64, 200, 0);
+    ASSERT_NOT_NULL(tbl);
+
+    // both fit into a single slot
+    char key[60], value[150];
+    memset(key, 'k', sizeof(key) - 1);
+    key[sizeof(key) - 1] = '\0';
+    memset(value, 'v', sizeof(value) - 1);
+    value[sizeof(value) - 1] = '\0';
+    ASSERT_EQUAL_BOOL(true, tbl->putstr(tbl, key, value));
+    int maxslots, usedslots;
+    ASSERT_EQUAL_INT(1, tbl->size(tbl, &maxslots, &usedslots));
+    ASSERT_EQUAL_INT(100, maxslots);
+    ASSERT_EQUAL_INT(1, usedslots);
+
+    // the geometry comes with the memory
+    qhasharr_t *tbl2 = qhasharr(memory, 0);
+    char *str = tbl2->getstr(tbl2, key);
+    ASSERT_EQUAL_STR(value, str);
+    free(str);
+    tbl2->free(tbl2);
+
+    ASSERT_NULL(qhasharr_ex(memory, memsize, 0, 200, 0));
+    ASSERT_EQUAL_INT(EINVAL, errno);
+    ASSERT_NULL(qhasharr_ex(memory, memsize, 40000, 40000, 0));
+    ASSERT_EQUAL_INT(EINVAL, errno);
+
+    tbl->free(tbl);
+    free(memory);
+}
+
+TEST("Test grow()") {
+    size_t memsize = qhasharr_calculate_memsize(50);
+    char *memory = malloc(memsize);
+    qhasharr_t *tbl = qhasharr(memory, memsize);
+
+    // fill it up with short and truncated keys
+    int i;
+    for (i = 0;; i++) {
+        char *key = qstrdupf("key%d%s", i, (i % 2) ? "-long-key-to-be-truncated" : "");
+        char *value = qstrdupf("value%d%s", i, (i % 3) ? "" : "-long-value-taking-more-slots");
+        bool ret = tbl->putstr(tbl, key, value);
+        free(key);
+        free(value);
+        if (ret == false) {
+            ASSERT_EQUAL_INT(ENOBUFS, errno);
+            break;
+        }
+    }
+    int num = tbl->size(tbl, NULL, NULL);
+    ASSERT_EQUAL_INT(i, num);
+
+    ASSERT_EQUAL_BOOL(false, tbl->grow(tbl, memory, memsize));
+    ASSERT_EQUAL_INT(EINVAL, errno);
+
+    size_t newsize = qhasharr_calculate_memsize(200);
+    char *newmem = malloc(newsize);
+    ASSERT_EQUAL_BOOL(true, tbl->grow(tbl, newmem, newsize));
+    free(memory);
+
+    int maxslots;
+    ASSERT_EQUAL_INT(num, tbl->size(tbl, &maxslots, NULL));
+    ASSERT_EQUAL_INT(200, maxslots);
+    for (i = 0; i < num; i++) {
+        char *key = qstrdupf("key%d%s", i, (i % 2) ? "-long-key-to-be-truncated" : "");
+        char *value = qstrdupf("value%d%s", i, (i % 3) ? "" : "-long-value-taking-more-slots");
+        char *str = tbl->getstr(tbl, key);
+        ASSERT_EQUAL_STR(value, str);
+        free(str);
+        free(key);
+        free(value);
+    }
+    ASSERT_EQUAL_BOOL(true, tbl->putstr(tbl, "more", "room"));
+    ASSERT_EQUAL_INT(num + 1, tbl->size(tbl, NULL, NULL));
+
+    tbl->free(tbl);
+    free(newmem);
+}
+
+TEST("Test layout versions of truncated key fingerprints") {
+    const char *longkey = "long-key-fef6bd00f77aef990a6d62969fee0cb904d052665a1dcf";
+    char memory[qhasharr_calculate_memsize(10)];
+    qhasharr_t *tbl = qhasharr(memory, sizeof(memory));
+    ASSERT_EQUAL_INT(Q_HASHARR_VERSION, tbl->data->version);
+
+    // version 0 segments keep verifying long keys with MD5
+    tbl->data->version = 0;
+    ASSERT_EQUAL_BOOL(true, tbl->putstr(tbl, longkey, "md5"));
+    char *str = tbl->getstr(tbl, longkey);
+    ASSERT_EQUAL_STR("md5", str);
+    free(str);
+    qhasharr_t *tbl2 = qhasharr(memory, 0);
+    ASSERT_NOT_NULL(tbl2);
+    ASSERT_EQUAL_BOOL(true, tbl2->remove(tbl2, longkey));
+    tbl2->free(tbl2);
+
+    // unknown layout
+    tbl->data->version = Q_HASHARR_VERSION + 1;
+    ASSERT_NULL(qhasharr(memory, 0));
+    ASSERT_EQUAL_INT(EINVAL, errno);
+
+    tbl->free(tbl);
+}
+
+TEST("Test QHASHARR_THREADSAFE between processes") {
+    int num_keys = 200, num_readers = 4;
+    size_t memsize = qhasharr_calculate_memsize(num_keys * 4);
+    void *memory = mmap(NULL, memsize, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    ASSERT(memory != MAP_FAILED);
+    qhasharr_t *tbl = qhasharr_ex(memory, memsize, Q_HASHARR_NAMESIZE,
+                                  Q_HASHARR_DATASIZE, QHASHARR_THREADSAFE);
+    ASSERT_NOT_NULL(tbl);
+
+    char key[32], value[128];
+    int i;
+    for (i = 0; i < num_keys; i++) {
+        sprintf(key, "key%d", i);
+        sprintf(value, "value%d-%0*d", i, 40 + i % 50, i);
+        ASSERT_TRUE(tbl->putstr(tbl, key, value));
+    }
+
+    // a writer keeps replacing the odd keys while the readers look all up.
+    pid_t pids[num_readers + 1];
+    for (i = 0; i <= num_readers; i++) {
+        pids[i] = fork();
+        ASSERT(pids[i] >= 0);
+        if (pids[i] == 0) {
+            qhasharr_t *child = qhasharr(memory, 0);
+            _exit(concurrent_worker(child, num_keys, (i == 0)));
+        }
+    }
+    for (i = 0; i <= num_readers; i++) {
+        int status;
+        ASSERT_EQUAL_INT(pids[i], waitpid(pids[i], &status, 0));
+        ASSERT_TRUE(WIFEXITED(status));
+        ASSERT_EQUAL_INT(0, WEXITSTATUS(status));
+    }
+
+    ASSERT_EQUAL_INT(num_keys, tbl->size(tbl, NULL, NULL));
+    ASSERT_EQUAL_INT(0, ((qhasharr_data_t *) memory)->lock);
+
+    tbl->free(tbl);
+    munmap(memory, memsize);
+}
+
+TEST("Test QHASHARR_CACHE eviction and put_ttl()") {
+    size_t memsize = qhasharr_calculate_memsize(10);
+    char memory[memsize];
+    qhasharr_t *tbl = qhasharr_ex(memory, memsize, Q_HASHARR_NAMESIZE,
+                                  Q_HASHARR_DATASIZE, QHASHARR_CACHE);
+    ASSERT_NOT_NULL(tbl);
+
+    // a full table takes new keys, sparing the one kept looked up.
+    char key[32], value[32];
+    int i;
+    for (i = 0; i < 100; i++) {
+        free(tbl->getstr(tbl, "key0"));
+        sprintf(key, "key%d", i);
+        sprintf(value, "value%d", i);
+        ASSERT_TRUE(tbl->putstr(tbl, key, value));
+    }
+    int maxslots, usedslots;
+    ASSERT_EQUAL_INT(10, tbl->size(tbl, &maxslots, &usedslots));
+    ASSERT_EQUAL_INT(maxslots, usedslots);
+    char *str = tbl->getstr(tbl, "key0");
+    ASSERT_EQUAL_STR("value0", str);
+    free(str);
+    str = tbl->getstr(tbl, "key99");
+    ASSERT_EQUAL_STR("value99", str);
+    free(str);
+
+    // a value bigger than the table still fails.
+    char bigvalue[Q_HASHARR_DATASIZE * 100];
+    memset(bigvalue, 'x', sizeof(bigvalue));
+    ASSERT_FALSE(tbl->put(tbl, "big", bigvalue, sizeof(bigvalue)));
+    ASSERT_EQUAL_INT(ENOBUFS, errno);
+    ASSERT_EQUAL_INT(0, tbl->size(tbl, NULL, NULL));
+
+    // expiry
+    ASSERT_FALSE(tbl->put_ttl(tbl, "ttl", "v", 2, 0));
+    ASSERT_EQUAL_INT(EINVAL, errno);
+    ASSERT_TRUE(tbl->put_ttl(tbl, "ttl", "v", 2, 1));
+    ASSERT_TRUE(tbl->putstr(tbl, "keep", "v"));
+    str = tbl->getstr(tbl, "ttl");
+    ASSERT_EQUAL_STR("v", str);
+    free(str);
+    sleep(1);
+    ASSERT_NULL(tbl->getstr(tbl, "ttl"));
+    ASSERT_EQUAL_INT(ENOENT, errno);
+    int idx = 0, found = 0;
+    qhasharr_obj_t obj;
+    while (tbl->getnext(tbl, &obj, &idx) == true) {
+        ASSERT_EQUAL_STR("keep", obj.name);
+        free(obj.name);
+        free(obj.data);
+        found++;
+    }
+    ASSERT_EQUAL_INT(1, found);
+
+    // overwriting an expired key leaves a single entry.
+    ASSERT_TRUE(tbl->putstr(tbl, "ttl", "w"));
+    ASSERT_EQUAL_INT(2, tbl->size(tbl, NULL, NULL));
+
+    tbl->free(tbl);
+}
+
+TEST("Test save() / qhasharr_map()") {
+    const char *path = "test_qhasharr.tbl";
+    size_t memsize = qhasharr_calculate_memsize_ex(1000, 32, 64);
+    void *memory = malloc(memsize);
+    qhasharr_t *tbl = qhasharr_ex(memory, memsize, 32, 64, QHASHARR_THREADSAFE);
+    char key[128], value[128];
+    int i;
+    for (i = 0; i < 300; i++) {
+        sprintf(key, "key%d%s", i, (i % 3) ? "" : "-long-key-to-be-truncated-in-the-slot");
+        sprintf(value, "value%d", i);
+        ASSERT_TRUE(tbl->putstr(tbl, key, value));
+    }
+    ASSERT_TRUE(tbl->save(tbl, path));
+
+    qhasharr_t *tbl2 = qhasharr_map(path);
+    ASSERT_NOT_NULL(tbl2);
+    ASSERT_EQUAL_INT(300, tbl2->size(tbl2, NULL, NULL));
+    DISABLE_PROGRESS_DOT();
+    for (i = 0; i < 300; i++) {
+        sprintf(key, "key%d%s", i, (i % 3) ? "" : "-long-key-to-be-truncated-in-the-slot");
+        sprintf(value, "value%d", i);
+        char *str = tbl2->getstr(tbl2, key);
+        ASSERT_EQUAL_STR(value, str);
+        free(str);
+    }
+    ENABLE_PROGRESS_DOT();
+
+    // read-only
+    ASSERT_FALSE(tbl2->putstr(tbl2, "new", "value"));
+    ASSERT_EQUAL_INT(EROFS, errno);
+    ASSERT_FALSE(tbl2->remove(tbl2, "key1"));
+    ASSERT_EQUAL_INT(EROFS, errno);
+    tbl2->clear(tbl2);
+    ASSERT_EQUAL_INT(300, tbl2->size(tbl2, NULL, NULL));
+
+    // saving over a mapped file doesn't change what's mapped
+    tbl->clear(tbl);
+    ASSERT_TRUE(tbl->save(tbl, path));
+    ASSERT_EQUAL_INT(300, tbl2->size(tbl2, NULL, NULL));
+    tbl2->free(tbl2);
+    tbl2 = qhasharr_map(path);
+    ASSERT_EQUAL_INT(0, tbl2->size(tbl2, NULL, NULL));
+    tbl2->free(tbl2);
+
+    // truncated file
+    ASSERT_EQUAL_INT(0, truncate(path, memsize - 1));
+    ASSERT_NULL(qhasharr_map(path));
+    ASSERT_EQUAL_INT(EINVAL, errno);
+
+    unlink(path);
+    tbl->free(tbl);
+    free(memory);
+}
+
+TEST("Test stats()") {
+    size_t memsize = qhasharr_calculate_memsize(100);
+    void *memory = malloc(memsize);
+    qhasharr_t *tbl = qhasharr_ex(memory, memsize, Q_HASHARR_NAMESIZE,
+                                  Q_HASHARR_DATASIZE,
+                                  QHASHARR_THREADSAFE | QHASHARR_CACHE);
+    char key[32];
+    int i;
+    for (i = 0; i < 80; i++) {
+        sprintf(key, "key%d", i);
+        ASSERT_TRUE(tbl->putstr(tbl, key, "value"));
+    }
+    qstats_t stats;
+    ASSERT_TRUE(tbl->stats(tbl, &stats));
+    ASSERT_EQUAL_INT(80, stats.num);
+    ASSERT_EQUAL_INT(100, stats.slots);
+    ASSERT_EQUAL_INT(80, stats.usedslots);
+    ASSERT_TRUE(stats.collisions > 0);
+    ASSERT_EQUAL_INT(0, stats.evictions);
+    ASSERT_TRUE(stats.locks >= 80);
+    size_t n, sum = 0;
+    for (n = 0; n < QSTATS_HISTSIZE; n++) {
+        sum += stats.probes[n];
+    }
+    ASSERT_EQUAL_INT(80, sum);
+
+    // evictions and grows are counted
+    for (i = 80; i < 200; i++) {
+        sprintf(key, "key%d", i);
+        ASSERT_TRUE(tbl->putstr(tbl, key, "value"));
+    }
+    size_t newsize = qhasharr_calculate_memsize(400);
+    void *newmemory = malloc(newsize);
+    ASSERT_TRUE(tbl->grow(tbl, newmemory, newsize));
+    ASSERT_TRUE(tbl->stats(tbl, &stats));
+    ASSERT_EQUAL_INT(100, stats.evictions);
+    ASSERT_EQUAL_INT(1, stats.resizes);
+    ASSERT_EQUAL_INT(400, stats.slots);
+    ASSERT_EQUAL_INT(100, stats.num);
+
+    tbl->free(tbl);
+    free(newmemory);
+    free(memory);
+}
+
 QUNIT_END();
 
 void test_thousands_of_keys(size_t memsize, int num_keys, char *key_postfix, char *value_postfix) {
@@ -167,3 +481,35 @@ void test_thousands_of_keys(size_t memsize, int num_keys, char *key_postfix, cha
 
     tbl->free(tbl);
 }
+
+static int concurrent_worker(qhasharr_t *tbl, int num_keys, bool writer) {
+    char key[32], value[128];
+    int round, i;
+    for (round = 0; round < 100; round++) {
+        for (i = 0; i < num_keys; i++) {
+            sprintf(key, "key%d", i);
+            sprintf(value, "value%d-%0*d", i, 40 + i % 50, i);
+            if (writer) {
+                if (i % 2 == 0)
+                    continue;
+                if (!tbl->remove(tbl, key) || !tbl->putstr(tbl, key, value))
+                    return 1;
+                continue;
+            }
+
+            char *data = tbl->getstr(tbl, key);
+            if (data == NULL) {
+                // odd keys may be in the middle of being replaced.
+                if (i % 2 == 0 || errno != ENOENT)
+                    return 1;
+                continue;
+            }
+            bool same = (strcmp(data, value) == 0);
+            free(data);
+            if (!same)
+                return 1;
+        }
+    }
+    tbl->free(tbl);
+    return 0;
+}
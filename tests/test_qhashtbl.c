@@ -26,10 +26,17 @@
  * POSSIBILITY OF SUCH DAMAGE.
  *****************************************************************************/
 
+#include <errno.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "qunit.h"
 #include "qlibc.h"
 
-void test_thousands_of_keys(int num_keys, char *key_postfix, char *value_postfix);
+void test_thousands_of_keys(int num_keys, char *key_postfix, char *value_postfix,
+                            int options);
+void *test_striped_worker(void *arg);
+void *test_lockfree_reader(void *arg);
 
 QUNIT_START("Test qhashtbl.c");
 
@@ -66,25 +73,582 @@ TEST("Test basic but complete") {
 }
 
 TEST("Test thousands of keys insertion and removal: short key + short value") {
-    test_thousands_of_keys(10000, "", "");
+    test_thousands_of_keys(10000, "", "", 0);
 }
 
 TEST("Test thousands of keys insertion and removal: short key + long value") {
-    test_thousands_of_keys(10000, "", "1a087a6982371bbfc9d4e14ae76e05ddd784a5d9c6b0fc9e6cd715baab66b90987b2ee054764e58fc04e449dfa060a68398601b64cf470cb6f0a260ec6539866");
+    test_thousands_of_keys(10000, "", "1a087a6982371bbfc9d4e14ae76e05ddd784a5d9c6b0fc9e6cd715baab66b90987b2ee054764e58fc04e449dfa060a68398601b64cf470cb6f0a260ec6539866", 0);
 }
 
 TEST("Test thousands of keys insertion and removal: long key + short value") {
-    test_thousands_of_keys(10000, "1a087a6982371bbfc9d4e14ae76e05ddd784a5d9c6b0fc9e6cd715baab66b90987b2ee054764e58fc04e449dfa060a68398601b64cf470cb6f0a260ec6539866", "");
+    test_thousands_of_keys(10000, "1a087a6982371bbfc9d4e14ae76e05ddd784a5d9c6b0fc9e6cd715baab66b90987b2ee054764e58fc04e449dfa060a68398601b64cf470cb6f0a260ec6539866", "", 0);
 }
 
 TEST("Test thousands of keys insertion and removal: long key + long value") {
-    test_thousands_of_keys(10000, "1a087a6982371bbfc9d4e14ae76e05ddd784a5d9c6b0fc9e6cd715baab66b90987b2ee054764e58fc04e449dfa060a68398601b64cf470cb6f0a260ec6539866", "1a087a6982371bbfc9d4e14ae76e05ddd784a5d9c6b0fc9e6cd715baab66b90987b2ee054764e58fc04e449dfa060a68398601b64cf470cb6f0a260ec6539866");
+    test_thousands_of_keys(10000, "1a087a6982371bbfc9d4e14ae76e05ddd784a5d9c6b0fc9e6cd715baab66b90987b2ee054764e58fc04e449dfa060a68398601b64cf470cb6f0a260ec6539866", "1a087a6982371bbfc9d4e14ae76e05ddd784a5d9c6b0fc9e6cd715baab66b90987b2ee054764e58fc04e449dfa060a68398601b64cf470cb6f0a260ec6539866", 0);
 }
 
-QUNIT_END();
+TEST("Test open addressing: basic") {
+    qhashtbl_t *tbl = qhashtbl(5, QHASHTBL_OPENADDR);
+    ASSERT_EQUAL_INT(8, tbl->range);
+    ASSERT_EQUAL_INT(0, tbl->size(tbl));
+
+    ASSERT_TRUE(tbl->putstr(tbl, "key0", "value0"));
+    ASSERT_TRUE(tbl->putstr(tbl, "key1", "value1"));
+    ASSERT_TRUE(tbl->putstr(tbl, "key0", "value0-new"));
+    ASSERT_EQUAL_INT(2, tbl->size(tbl));
+    ASSERT_EQUAL_STR("value0-new", tbl->getstr(tbl, "key0", false));
+    ASSERT_EQUAL_STR("value1", tbl->getstr(tbl, "key1", false));
+
+    ASSERT_TRUE(tbl->putint(tbl, "key2", 1234));
+    ASSERT_EQUAL_INT(1234, tbl->getint(tbl, "key2"));
+
+    ASSERT_TRUE(tbl->remove(tbl, "key0"));
+    ASSERT_FALSE(tbl->remove(tbl, "key0"));
+    ASSERT_NULL(tbl->getstr(tbl, "key0", false));
+    ASSERT_EQUAL_INT(2, tbl->size(tbl));
+
+    // grows beyond the initial range
+    int i;
+    for (i = 0; i < 100; i++) {
+        char *key = qstrdupf("grow%d", i);
+        ASSERT_TRUE(tbl->putint(tbl, key, i));
+        free(key);
+    }
+    ASSERT_EQUAL_INT(102, tbl->size(tbl));
+    ASSERT_TRUE(tbl->range >= 128);
+    ASSERT_FALSE(tbl->set_loadfactor(tbl, 1.0));
+
+    int cnt = 0;
+    qhashtbl_obj_t obj;
+    memset((void *) &obj, 0, sizeof(obj));
+    while (tbl->getnext(tbl, &obj, true) == true) {
+        cnt++;
+        free(obj.name);
+        free(obj.data);
+    }
+    ASSERT_EQUAL_INT(102, cnt);
+
+    tbl->clear(tbl);
+    ASSERT_EQUAL_INT(0, tbl->size(tbl));
+    ASSERT_NULL(tbl->getstr(tbl, "key1", false));
+    tbl->free(tbl);
+}
+
+TEST("Test open addressing: getnext() across a growth") {
+    qhashtbl_t *tbl = qhashtbl(8, QHASHTBL_OPENADDR);
+    int i;
+    for (i = 0; i < 4; i++) {
+        char *key = qstrdupf("key%d", i);
+        ASSERT_TRUE(tbl->putint(tbl, key, i));
+        free(key);
+    }
+
+    // the slots are reallocated in the middle of the traversal
+    qhashtbl_obj_t obj;
+    memset((void *) &obj, 0, sizeof(obj));
+    ASSERT_TRUE(tbl->getnext(tbl, &obj, true));
+    free(obj.name);
+    free(obj.data);
+    size_t range = tbl->range;
+    for (i = 4; i < 100; i++) {
+        char *key = qstrdupf("key%d", i);
+        ASSERT_TRUE(tbl->putint(tbl, key, i));
+        free(key);
+    }
+    ASSERT_TRUE(tbl->range > range);
+
+    int cnt = 1;
+    while (tbl->getnext(tbl, &obj, true) == true) {
+        cnt++;
+        free(obj.name);
+        free(obj.data);
+    }
+    // the scan goes on from the same position, visiting most of them
+    ASSERT_TRUE(cnt > 50 && cnt <= 100);
+    tbl->free(tbl);
+}
+
+TEST("Test open addressing: thousands of keys insertion and removal") {
+    test_thousands_of_keys(10000, "", "", QHASHTBL_OPENADDR);
+    test_thousands_of_keys(10000, "1a087a6982371bbfc9d4e14ae76e05ddd784a5d9c6b0fc9e6cd715baab66b90987b2ee054764e58fc04e449dfa060a68398601b64cf470cb6f0a260ec6539866", "", QHASHTBL_OPENADDR);
+}
+
+TEST("Test open addressing: removal keeps other keys reachable") {
+    qhashtbl_t *tbl = qhashtbl(16, QHASHTBL_OPENADDR);
+    int i;
+    for (i = 0; i < 5000; i++) {
+        char *key = qstrdupf("key%d", i);
+        tbl->putint(tbl, key, i);
+        free(key);
+    }
+    for (i = 0; i < 5000; i += 3) {
+        char *key = qstrdupf("key%d", i);
+        ASSERT_TRUE(tbl->remove(tbl, key));
+        free(key);
+    }
+    DISABLE_PROGRESS_DOT();
+    for (i = 0; i < 5000; i++) {
+        char *key = qstrdupf("key%d", i);
+        if (i % 3 == 0) {
+            ASSERT_NULL(tbl->getstr(tbl, key, false));
+        } else {
+            ASSERT_EQUAL_INT(i, tbl->getint(tbl, key));
+        }
+        free(key);
+    }
+    ENABLE_PROGRESS_DOT();
+    tbl->free(tbl);
+}
+
+TEST("Test striped locking") {
+    qhashtbl_t *tbl = qhashtbl(0, QHASHTBL_STRIPED | QHASHTBL_AUTORESIZE);
+    ASSERT_NOT_NULL(tbl->qmutex);
+    ASSERT_NOT_NULL(tbl->stripes);
+    ASSERT_FALSE(tbl->options & QHASHTBL_AUTORESIZE);
+
+    pthread_t threads[8];
+    int i;
+    for (i = 0; i < 8; i++) {
+        pthread_create(&threads[i], NULL, test_striped_worker, tbl);
+    }
+
+    // whole table iteration while the workers are running
+    int scans;
+    for (scans = 0; scans < 10; scans++) {
+        size_t cnt = 0;
+        qhashtbl_obj_t obj;
+        memset((void *) &obj, 0, sizeof(obj));
+        tbl->lock(tbl);
+        size_t num = tbl->size(tbl);
+        while (tbl->getnext(tbl, &obj, false) == true) {
+            ASSERT_NOT_NULL(tbl->getstr(tbl, obj.name, false));  // nested call
+            cnt++;
+        }
+        tbl->unlock(tbl);
+        ASSERT_EQUAL_INT(num, cnt);
+    }
 
-void test_thousands_of_keys(int num_keys, char *key_postfix, char *value_postfix) {
+    bool ok = true;
+    for (i = 0; i < 8; i++) {
+        void *ret;
+        pthread_join(threads[i], &ret);
+        ok = ok && (ret == NULL);
+    }
+    ASSERT_TRUE(ok);
+    ASSERT_EQUAL_INT(8 * 1000, tbl->size(tbl));
+
+    tbl->clear(tbl);
+    ASSERT_EQUAL_INT(0, tbl->size(tbl));
+    tbl->free(tbl);
+}
+
+TEST("Test lock-free read") {
+    qhashtbl_t *tbl = qhashtbl(100, QHASHTBL_LOCKFREE_READ | QHASHTBL_STRIPED);
+    ASSERT_NOT_NULL(tbl->qmutex);
+    ASSERT_NOT_NULL(tbl->epoch);
+    ASSERT_NULL(tbl->stripes);
+
+    int i;
+    for (i = 0; i < 100; i++) {
+        char key[16], value[32];
+        snprintf(key, sizeof(key), "key%d", i);
+        snprintf(value, sizeof(value), "key%d=0", i);
+        tbl->putstr(tbl, key, value);
+    }
+
+    pthread_t threads[4];
+    for (i = 0; i < 4; i++) {
+        pthread_create(&threads[i], NULL, test_lockfree_reader, tbl);
+    }
+
+    // keep replacing and removing while readers are running
+    int round;
+    for (round = 1; round <= 200; round++) {
+        for (i = 0; i < 100; i++) {
+            char key[16], value[32];
+            snprintf(key, sizeof(key), "key%d", i);
+            snprintf(value, sizeof(value), "key%d=%d", i, round);
+            if ((i + round) % 10 == 0) {
+                tbl->remove(tbl, key);
+            } else {
+                tbl->putstr(tbl, key, value);
+            }
+        }
+    }
+
+    bool ok = true;
+    for (i = 0; i < 4; i++) {
+        void *ret;
+        pthread_join(threads[i], &ret);
+        ok = ok && (ret == NULL);
+    }
+    ASSERT_TRUE(ok);
+    ASSERT_EQUAL_INT(90, tbl->size(tbl));
+    ASSERT_EQUAL_STR("key1=200", tbl->getstr(tbl, "key1", false));
+
+    // nested read sections
+    tbl->read_enter(tbl);
+    tbl->read_enter(tbl);
+    char *value = tbl->getstr(tbl, "key2", false);
+    tbl->read_leave(tbl);
+    ASSERT_EQUAL_STR("key2=200", value);
+    tbl->read_leave(tbl);
+
+    tbl->clear(tbl);
+    ASSERT_EQUAL_INT(0, tbl->size(tbl));
+    tbl->free(tbl);
+}
+
+TEST("Test auto resizing") {
+    qhashtbl_t *tbl = qhashtbl(10, QHASHTBL_AUTORESIZE);
+    ASSERT_EQUAL_INT(10, tbl->range);
+
+    int i;
+    for (i = 0; i < 100000; i++) {
+        char *key = qstrdupf("key%d", i);
+        char *value = qstrdupf("value%d", i);
+        ASSERT_TRUE(tbl->putstr(tbl, key, value));
+        free(key);
+        free(value);
+    }
+    ASSERT_EQUAL_INT(100000, tbl->size(tbl));
+    ASSERT_TRUE(tbl->range >= 100000);
+
+    // every key must be reachable wherever it lives during migration
+    for (i = 0; i < 100000; i++) {
+        char *key = qstrdupf("key%d", i);
+        char *value = qstrdupf("value%d", i);
+        ASSERT_EQUAL_STR(value, tbl->getstr(tbl, key, false));
+        free(key);
+        free(value);
+    }
+
+    // traversal visits every key exactly once
+    int cnt = 0;
+    qhashtbl_obj_t obj;
+    memset((void *) &obj, 0, sizeof(obj));
+    while (tbl->getnext(tbl, &obj, false) == true) {
+        cnt++;
+    }
+    ASSERT_EQUAL_INT(100000, cnt);
+    ASSERT_NULL(tbl->oldslots);
+
+    for (i = 0; i < 100000; i += 2) {
+        char *key = qstrdupf("key%d", i);
+        ASSERT_TRUE(tbl->remove(tbl, key));
+        ASSERT_NULL(tbl->getstr(tbl, key, false));
+        free(key);
+    }
+    ASSERT_EQUAL_INT(50000, tbl->size(tbl));
+
+    // lower load factor grows the table immediately
+    size_t range = tbl->range;
+    ASSERT_FALSE(tbl->set_loadfactor(tbl, 0));
+    ASSERT_TRUE(tbl->set_loadfactor(tbl, 0.1));
+    ASSERT_TRUE(tbl->range > range);
+    ASSERT_EQUAL_STR("value1", tbl->getstr(tbl, "key1", false));
+
+    tbl->clear(tbl);
+    ASSERT_EQUAL_INT(0, tbl->size(tbl));
+    ASSERT_NULL(tbl->oldslots);
+    tbl->free(tbl);
+}
+
+TEST("Test replacing values of different sizes") {
+    int options[] = { 0, QHASHTBL_OPENADDR, QHASHTBL_LOCKFREE_READ };
+    int i, j;
+    for (i = 0; i < sizeof(options) / sizeof(int); i++) {
+        qhashtbl_t *tbl = qhashtbl(0, options[i]);
+        for (j = 0; j < 100; j++) {
+            char *key = qstrdupf("key%d", j);
+            ASSERT_TRUE(tbl->putint(tbl, key, j));
+            free(key);
+        }
+        for (j = 0; j < 100; j += 2) {
+            char *key = qstrdupf("key%d", j);
+            char *value = qstrdupf("%0*d", 1000, j);
+            ASSERT_TRUE(tbl->putstr(tbl, key, value));
+            ASSERT_EQUAL_STR(value, tbl->getstr(tbl, key, false));
+            ASSERT_TRUE(tbl->putint(tbl, key, j * 2));
+            free(key);
+            free(value);
+        }
+        ASSERT_EQUAL_INT(100, tbl->size(tbl));
+        for (j = 0; j < 100; j++) {
+            char *key = qstrdupf("key%d", j);
+            ASSERT_EQUAL_INT(((j % 2) ? j : j * 2), tbl->getint(tbl, key));
+            free(key);
+        }
+        tbl->free(tbl);
+    }
+}
+
+TEST("Test batch get and put") {
+    int options[] = { 0, QHASHTBL_THREADSAFE | QHASHTBL_AUTORESIZE,
+                      QHASHTBL_OPENADDR, QHASHTBL_STRIPED,
+                      QHASHTBL_LOCKFREE_READ };
+    int i, j;
+    for (i = 0; i < sizeof(options) / sizeof(int); i++) {
+        qhashtbl_t *tbl = qhashtbl(10, options[i]);
+
+        // more keys than a single batch
+        const char *names[200];
+        const void *values[200];
+        size_t sizes[200];
+        for (j = 0; j < 200; j++) {
+            names[j] = qstrdupf("key%d", j);
+            values[j] = qstrdupf("value%d", j);
+            sizes[j] = strlen(values[j]) + 1;
+        }
+        ASSERT_EQUAL_INT(150, tbl->putmulti(tbl, names, values, sizes, 150));
+        ASSERT_EQUAL_INT(150, tbl->size(tbl));
+
+        void *datas[200];
+        size_t datasizes[200];
+        ASSERT_EQUAL_INT(150, tbl->getmulti(tbl, names, 200, datas, datasizes, false));
+        for (j = 0; j < 200; j++) {
+            if (j < 150) {
+                ASSERT_EQUAL_STR(values[j], datas[j]);
+                ASSERT_EQUAL_INT(sizes[j], datasizes[j]);
+            } else {
+                ASSERT_NULL(datas[j]);
+            }
+        }
+
+        ASSERT_EQUAL_INT(50, tbl->getmulti(tbl, &names[100], 100, datas, NULL, true));
+        for (j = 0; j < 50; j++) {
+            ASSERT_EQUAL_STR(values[100 + j], datas[j]);
+            free(datas[j]);
+        }
+        ASSERT_EQUAL_INT(0, tbl->getmulti(tbl, &names[150], 50, datas, NULL, false));
+        ASSERT_EQUAL_INT(ENOENT, errno);
+
+        for (j = 0; j < 200; j++) {
+            free((void *) names[j]);
+            free((void *) values[j]);
+        }
+        tbl->free(tbl);
+    }
+}
+
+TEST("Test custom hash function") {
+    uint32_t (*hashfuncs[])(const void *, size_t) = { qhashwyhash_32, qhashcrc32c };
+    int i, j;
+    for (i = 0; i < sizeof(hashfuncs) / sizeof(hashfuncs[0]); i++) {
+        qhashtbl_t *tbl = qhashtbl(0, QHASHTBL_AUTORESIZE);
+        ASSERT_FALSE(tbl->set_hash(tbl, NULL));
+        ASSERT_TRUE(tbl->set_hash(tbl, hashfuncs[i]));
+        for (j = 0; j < 1000; j++) {
+            char *key = qstrdupf("key%d", j);
+            ASSERT_TRUE(tbl->putint(tbl, key, j));
+            free(key);
+        }
+        DISABLE_PROGRESS_DOT();
+        for (j = 0; j < 1000; j++) {
+            char *key = qstrdupf("key%d", j);
+            ASSERT_EQUAL_INT(j, tbl->getint(tbl, key));
+            ASSERT_EQUAL_INT(j, atoi(tbl->get_by_obj(tbl, key, strlen(key),
+                                                     hashfuncs[i](key, strlen(key)),
+                                                     NULL, false)));
+            free(key);
+        }
+        ENABLE_PROGRESS_DOT();
+
+        // can't be changed once keys are stored
+        ASSERT_FALSE(tbl->set_hash(tbl, qhashmurmur3_32));
+        ASSERT_EQUAL_INT(EBUSY, errno);
+        tbl->free(tbl);
+    }
+}
+
+TEST("Test pre-hashed binary keys") {
+    int options[] = { 0, QHASHTBL_OPENADDR, QHASHTBL_LOCKFREE_READ };
+    int i;
+    for (i = 0; i < sizeof(options) / sizeof(int); i++) {
+        qhashtbl_t *tbl = qhashtbl(0, options[i]);
+
+        // keys differ only after an embedded NUL
+        const char key1[] = { 'k', 'e', 'y', '\0', '1' };
+        const char key2[] = { 'k', 'e', 'y', '\0', '2' };
+        uint32_t hash1 = qhashmurmur3_32(key1, sizeof(key1));
+        uint32_t hash2 = qhashmurmur3_32(key2, sizeof(key2));
+        ASSERT_TRUE(tbl->put_by_obj(tbl, key1, sizeof(key1), hash1, "v1", 3));
+        ASSERT_TRUE(tbl->put_by_obj(tbl, key2, sizeof(key2), hash2, "v2", 3));
+        ASSERT_TRUE(tbl->putstr(tbl, "key", "v0"));
+        ASSERT_EQUAL_INT(3, tbl->size(tbl));
+
+        size_t size = 0;
+        ASSERT_EQUAL_STR("v1", tbl->get_by_obj(tbl, key1, sizeof(key1), hash1,
+                                               &size, false));
+        ASSERT_EQUAL_INT(3, size);
+        ASSERT_EQUAL_STR("v2", tbl->get_by_obj(tbl, key2, sizeof(key2), hash2,
+                                               NULL, false));
+        ASSERT_EQUAL_STR("v0", tbl->getstr(tbl, "key", false));
+
+        // string and pre-hashed calls see the same keys
+        ASSERT_EQUAL_STR("v0", tbl->get_by_obj(tbl, "key", 3,
+                                               qhashmurmur3_32("key", 3),
+                                               NULL, false));
+        ASSERT_NULL(tbl->get_by_obj(tbl, "key", 4, qhashmurmur3_32("key", 4),
+                                    NULL, false));
+        ASSERT_EQUAL_INT(ENOENT, errno);
+
+        // names are returned with their sizes
+        int found = 0;
+        qhashtbl_obj_t obj;
+        memset((void *) &obj, 0, sizeof(obj));
+        while (tbl->getnext(tbl, &obj, true) == true) {
+            if (obj.namesize == sizeof(key1)) {
+                ASSERT_TRUE(!memcmp(obj.name, key1, 4));
+                found++;
+            }
+            free(obj.name);
+            free(obj.data);
+        }
+        ASSERT_EQUAL_INT(2, found);
+
+        ASSERT_TRUE(tbl->remove_by_obj(tbl, key1, sizeof(key1), hash1));
+        ASSERT_FALSE(tbl->remove_by_obj(tbl, key1, sizeof(key1), hash1));
+        ASSERT_NULL(tbl->get_by_obj(tbl, key1, sizeof(key1), hash1, NULL, false));
+        ASSERT_EQUAL_STR("v2", tbl->get_by_obj(tbl, key2, sizeof(key2), hash2,
+                                               NULL, false));
+        ASSERT_EQUAL_INT(2, tbl->size(tbl));
+        tbl->free(tbl);
+    }
+}
+
+TEST("Test dump() / restore()") {
+    const char *path = "test_qhashtbl.snapshot";
+    qhashtbl_t *tbl = qhashtbl(0, 0);
+    int i;
+    for (i = 0; i < 10000; i++) {
+        char *key = qstrdupf("key%d", i);
+        ASSERT_TRUE(tbl->putint(tbl, key, i));
+        free(key);
+    }
+    const char bkey[] = { 'b', '\0', 'k' };
+    ASSERT_TRUE(tbl->put_by_obj(tbl, bkey, sizeof(bkey),
+                                qhashmurmur3_32(bkey, sizeof(bkey)), "", 0));
+    ASSERT_TRUE(tbl->dump(tbl, path, true));
+
+    // restored with the saved hashes, and with a different hash function
+    int options[] = { 0, QHASHTBL_OPENADDR };
+    int j;
+    for (j = 0; j < 2 * sizeof(options) / sizeof(int); j++) {
+        qhashtbl_t *tbl2 = qhashtbl(0, options[j / 2]);
+        if (j % 2) {
+            ASSERT_TRUE(tbl2->set_hash(tbl2, qhashwyhash_32));
+        }
+        ASSERT_EQUAL_INT(10001, tbl2->restore(tbl2, path));
+        ASSERT_EQUAL_INT(10001, tbl2->size(tbl2));
+        DISABLE_PROGRESS_DOT();
+        for (i = 0; i < 10000; i++) {
+            char *key = qstrdupf("key%d", i);
+            ASSERT_EQUAL_INT(i, tbl2->getint(tbl2, key));
+            free(key);
+        }
+        ENABLE_PROGRESS_DOT();
+        size_t size = 1;
+        ASSERT_NOT_NULL(tbl2->get_by_obj(tbl2, bkey, sizeof(bkey),
+                                         tbl2->hashfunc(bkey, sizeof(bkey)),
+                                         &size, false));
+        ASSERT_EQUAL_INT(0, size);
+        tbl2->free(tbl2);
+    }
+
+    // a broken snapshot leaves the table untouched
+    int fd = open(path, O_RDWR);
+    ASSERT(fd >= 0);
+    ASSERT_EQUAL_INT(1, pwrite(fd, "X", 1, lseek(fd, 0, SEEK_END) - 2));
+    close(fd);
+    qhashtbl_t *tbl2 = qhashtbl(0, 0);
+    ASSERT_EQUAL_INT(-1, tbl2->restore(tbl2, path));
+    ASSERT_EQUAL_INT(EBADMSG, errno);
+    ASSERT_EQUAL_INT(0, tbl2->size(tbl2));
+
+    // an empty table without checksum, replacing the broken one
+    ASSERT_TRUE(tbl2->dump(tbl2, path, false));
+    ASSERT_EQUAL_INT(0, tbl->restore(tbl, path));
+    ASSERT_EQUAL_INT(10001, tbl->size(tbl));
+    ASSERT_EQUAL_INT(-1, tbl->restore(tbl, "/nonexistent/qhashtbl.snapshot"));
+    ASSERT_EQUAL_INT(ENOENT, errno);
+
+    unlink(path);
+    tbl2->free(tbl2);
+    tbl->free(tbl);
+}
+
+TEST("Test stats()") {
+    int options[] = { QHASHTBL_THREADSAFE, QHASHTBL_AUTORESIZE, QHASHTBL_OPENADDR,
+                      QHASHTBL_STRIPED };
+    int j;
+    for (j = 0; j < sizeof(options) / sizeof(int); j++) {
+        qhashtbl_t *tbl = qhashtbl(16, options[j]);
+        qstats_t stats;
+        ASSERT_TRUE(tbl->stats(tbl, &stats));
+        ASSERT_EQUAL_INT(0, stats.num);
+        ASSERT_EQUAL_INT(0, stats.usedslots);
+
+        int i;
+        for (i = 0; i < 1000; i++) {
+            char *key = qstrdupf("key%d", i);
+            ASSERT_TRUE(tbl->putint(tbl, key, i));
+            free(key);
+        }
+        ASSERT_TRUE(tbl->remove(tbl, "key0"));
+        ASSERT_TRUE(tbl->stats(tbl, &stats));
+        ASSERT_EQUAL_INT(999, stats.num);
+        ASSERT_TRUE(stats.usedslots > 0 && stats.usedslots <= stats.slots);
+        ASSERT_EQUAL_INT(1000, stats.allocs);
+        ASSERT_EQUAL_INT(1, stats.frees);
+        ASSERT_TRUE(stats.collisions > 0);
+        if (options[j] & (QHASHTBL_AUTORESIZE | QHASHTBL_OPENADDR)) {
+            ASSERT_TRUE(stats.resizes > 0);
+            ASSERT_TRUE(stats.slots >= 1000);
+        } else {
+            ASSERT_EQUAL_INT(0, stats.resizes);
+            ASSERT_EQUAL_INT(16, stats.slots);
+        }
+        if (options[j] & QHASHTBL_THREADSAFE) {
+            ASSERT_TRUE(stats.locks >= 1001);
+        }
+
+        // every object shows up in the histogram once
+        size_t i2, sum = 0;
+        for (i2 = 0; i2 < QSTATS_HISTSIZE; i2++) {
+            sum += stats.probes[i2];
+        }
+        ASSERT_EQUAL_INT(999, sum);
+        ASSERT_TRUE(stats.maxprobe > 0);
+
+        tbl->free(tbl);
+    }
+
+    // exported as prefixed lines
     qhashtbl_t *tbl = qhashtbl(0, 0);
+    tbl->putstr(tbl, "key", "value");
+    qstats_t stats;
+    ASSERT_TRUE(tbl->stats(tbl, &stats));
+    char *buf = NULL;
+    size_t bufsize = 0;
+    FILE *out = open_memstream(&buf, &bufsize);
+    ASSERT_TRUE(qstats_print(&stats, "tbl", out));
+    fclose(out);
+    ASSERT_NOT_NULL(strstr(buf, "tbl.num=1\n"));
+    ASSERT_NOT_NULL(strstr(buf, "tbl.probes.0=1\n"));
+    ASSERT_NULL(strstr(buf, "tbl.probes.1="));
+    free(buf);
+    ASSERT_FALSE(qstats_print(&stats, "tbl", NULL));
+    ASSERT_EQUAL_INT(EIO, errno);
+    tbl->free(tbl);
+}
+
+QUNIT_END();
+
+void test_thousands_of_keys(int num_keys, char *key_postfix, char *value_postfix,
+                            int options) {
+    qhashtbl_t *tbl = qhashtbl(0, options);
     ASSERT_EQUAL_INT(0, tbl->size(tbl));
 
     int i;
@@ -111,3 +675,38 @@ void test_thousands_of_keys(int num_keys, char *key_postfix, char *value_postfix
     ASSERT_EQUAL_INT(0, tbl->size(tbl));
     tbl->free(tbl);
 }
+
+void *test_striped_worker(void *arg) {
+    qhashtbl_t *tbl = (qhashtbl_t *) arg;
+    void *ret = NULL;
+    int i;
+    for (i = 0; i < 2000; i++) {
+        char key[32];
+        snprintf(key, sizeof(key), "%p-%d", (void *) &i, i);
+        tbl->putint(tbl, key, i);
+        if (tbl->getint(tbl, key) != i) {
+            ret = (void *) -1;
+        }
+        if (i % 2 == 1 && tbl->remove(tbl, key) == false) {
+            ret = (void *) -1;
+        }
+    }
+    return ret;
+}
+
+void *test_lockfree_reader(void *arg) {
+    qhashtbl_t *tbl = (qhashtbl_t *) arg;
+    void *ret = NULL;
+    int i;
+    for (i = 0; i < 20000; i++) {
+        char key[16];
+        snprintf(key, sizeof(key), "key%d", i % 100);
+        tbl->read_enter(tbl);
+        char *value = tbl->getstr(tbl, key, false);
+        if (value != NULL && strncmp(value, key, strlen(key))) {
+            ret = (void *) -1;
+        }
+        tbl->read_leave(tbl);
+    }
+    return ret;
+}
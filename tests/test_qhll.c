@@ -0,0 +1,117 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+#include <errno.h>
+#include "qunit.h"
+#include "qlibc.h"
+
+static bool within(uint64_t estimate, uint64_t actual, double error) {
+    double diff = (double) estimate - (double) actual;
+    if (diff < 0) {
+        diff = -diff;
+    }
+    return (diff <= actual * error);
+}
+
+QUNIT_START("Test qhll.c");
+
+TEST("Test qhll() / add() / count()") {
+    ASSERT_EQUAL_INT(0, qhll_calculate_memsize(Q_HLL_MIN_PRECISION - 1));
+    ASSERT_EQUAL_INT(0, qhll_calculate_memsize(Q_HLL_MAX_PRECISION + 1));
+
+    size_t memsize = qhll_calculate_memsize(14);
+    void *memory = malloc(memsize);
+    ASSERT_TRUE(qhll(memory, memsize - 1, 14) == NULL);
+    ASSERT_EQUAL_INT(EINVAL, errno);
+
+    qhll_t *hll = qhll(memory, memsize, 14);
+    ASSERT_NOT_NULL(hll);
+    ASSERT_EQUAL_INT(0, hll->count(hll));
+
+    // small counts are close to exact
+    char key[32];
+    int i, len;
+    for (i = 0; i < 100; i++) {
+        len = sprintf(key, "key%d", i);
+        hll->add(hll, key, len);
+        hll->add(hll, key, len);
+    }
+    ASSERT(within(hll->count(hll), 100, 0.02));
+
+    // the standard error is 0.81%, allow 4 times
+    for (i = 100; i < 300000; i++) {
+        len = sprintf(key, "key%d", i);
+        hll->add(hll, key, len);
+    }
+    ASSERT(within(hll->count(hll), 300000, 0.033));
+
+    // attach to the existing estimator
+    qhll_t *hll2 = qhll(memory, 0, 0);
+    ASSERT_NOT_NULL(hll2);
+    ASSERT_EQUAL_INT(hll->count(hll), hll2->count(hll2));
+    hll2->free(hll2);
+
+    hll->clear(hll);
+    ASSERT_EQUAL_INT(0, hll->count(hll));
+    hll->free(hll);
+    free(memory);
+}
+
+TEST("Test merge()") {
+    void *memory1 = malloc(qhll_calculate_memsize(12));
+    void *memory2 = malloc(qhll_calculate_memsize(12));
+    void *memory3 = malloc(qhll_calculate_memsize(10));
+    qhll_t *hll1 = qhll(memory1, qhll_calculate_memsize(12), 12);
+    qhll_t *hll2 = qhll(memory2, qhll_calculate_memsize(12), 12);
+    qhll_t *hll3 = qhll(memory3, qhll_calculate_memsize(10), 10);
+
+    char key[32];
+    int i, len;
+    for (i = 0; i < 60000; i++) {
+        len = sprintf(key, "key%d", i);
+        if (i < 40000) {
+            hll1->add(hll1, key, len);
+        }
+        if (i >= 20000) {
+            hll2->add(hll2, key, len);
+        }
+    }
+
+    ASSERT_FALSE(hll1->merge(hll1, hll3));
+    ASSERT_EQUAL_INT(EINVAL, errno);
+    ASSERT_TRUE(hll1->merge(hll1, hll2));
+    ASSERT(within(hll1->count(hll1), 60000, 0.065));
+
+    hll1->free(hll1);
+    hll2->free(hll2);
+    hll3->free(hll3);
+    free(memory1);
+    free(memory2);
+    free(memory3);
+}
+
+QUNIT_END();
@@ -0,0 +1,789 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "qunit.h"
+#include "qlibc.h"
+#include "qlibcext.h"
+#ifdef ENABLE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef ENABLE_OPENSSL
+#include <openssl/ssl.h>
+#endif
+
+// response collected by the pipeline callback
+struct result {
+    int calls;
+    int rescode;
+    char body[256];
+    size_t bodysize;
+};
+
+static void _done(qhttpclient_t *client, int rescode, qlisttbl_t *resheaders,
+                  void *body, size_t bodysize, void *userdata) {
+    struct result *res = (struct result *) userdata;
+    res->calls++;
+    res->rescode = rescode;
+    res->bodysize = 0;
+    if (body != NULL && bodysize < sizeof(res->body)) {
+        memcpy(res->body, body, bodysize + 1);
+        res->bodysize = bodysize;
+    }
+}
+
+// serves the responses in turn on a single connection, one for each
+// request read, and closes it after the last one. With linger, it waits
+// for the client to close first. sizes can be NULL for strings.
+static pid_t _serve_raw(int *port, const char **responses,
+                        const size_t *sizes, int num, bool linger) {
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0)
+        return -1;
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addrlen = sizeof(addr);
+    if (bind(sock, (struct sockaddr *) &addr, sizeof(addr)) != 0
+            || listen(sock, 1) != 0
+            || getsockname(sock, (struct sockaddr *) &addr, &addrlen) != 0) {
+        close(sock);
+        return -1;
+    }
+    *port = ntohs(addr.sin_port);
+
+    pid_t pid = fork();
+    if (pid != 0) {
+        close(sock);
+        return pid;
+    }
+
+    int conn = accept(sock, NULL, NULL);
+    int i;
+    for (i = 0; conn >= 0 && i < num; i++) {
+        // a request has no body here, so it ends with an empty line
+        unsigned int last4 = 0;
+        char c;
+        while (last4 != 0x0d0a0d0a && read(conn, &c, 1) == 1) {
+            last4 = (last4 << 8) | (unsigned char) c;
+        }
+        if (last4 != 0x0d0a0d0a)
+            break;
+        size_t len = (sizes != NULL) ? sizes[i] : strlen(responses[i]);
+        if (write(conn, responses[i], len) != (ssize_t) len)
+            break;
+    }
+    if (linger == true && i == num) {
+        char buf[256];
+        while (read(conn, buf, sizeof(buf)) > 0);
+    }
+    _exit(0);
+}
+
+static pid_t _serve(int *port, const char **responses, int num, bool linger) {
+    return _serve_raw(port, responses, NULL, num, linger);
+}
+
+// appends the slices to a qgrow_t
+static bool _collect(void *userdata, const void *data, size_t size) {
+    qgrow_t *grow = (qgrow_t *) userdata;
+    return grow->add(grow, data, size);
+}
+
+// a GET with the body thrown away. returns the response code.
+static int _request(qhttpclient_t *client) {
+    int rescode = 0;
+    void *body = client->cmd(client, "GET", "/", NULL, 0, &rescode, NULL,
+                             NULL, NULL);
+    free(body);
+    return rescode;
+}
+
+// takes a client from the pool in another thread
+struct waiter {
+    qhttpclient_pool_t *pool;
+    int port;
+    qhttpclient_t *client;
+    volatile bool done;
+};
+
+static void *_pool_waiter(void *arg) {
+    struct waiter *w = (struct waiter *) arg;
+    w->client = w->pool->get(w->pool, "127.0.0.1", w->port);
+    w->done = true;
+    return NULL;
+}
+
+#ifdef ENABLE_ZLIB
+// a response with the body compressed in gzip or zlib(deflate) format,
+// sent in small chunks or with Content-Length.
+static char *_compressed(const char *body, size_t bodysize, bool gzip,
+                         bool chunked, size_t *size) {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, gzip ? 31 : 15,
+                     8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return NULL;
+    }
+    unsigned char zbuf[4096];
+    zs.next_in = (Bytef *) body;
+    zs.avail_in = bodysize;
+    zs.next_out = zbuf;
+    zs.avail_out = sizeof(zbuf);
+    int ret = deflate(&zs, Z_FINISH);
+    size_t zsize = sizeof(zbuf) - zs.avail_out;
+    deflateEnd(&zs);
+    if (ret != Z_STREAM_END)
+        return NULL;
+
+    qgrow_t *grow = qgrow(0);
+    grow->addstrf(grow, "HTTP/1.1 200 OK\r\nContent-Encoding: %s\r\n",
+                  gzip ? "gzip" : "deflate");
+    if (chunked == true) {
+        grow->addstr(grow, "Transfer-Encoding: chunked\r\n\r\n");
+        size_t i;
+        for (i = 0; i < zsize; i += 7) {
+            size_t len = (zsize - i < 7) ? zsize - i : 7;
+            grow->addstrf(grow, "%zx\r\n", len);
+            grow->add(grow, zbuf + i, len);
+            grow->addstr(grow, "\r\n");
+        }
+        grow->addstr(grow, "0\r\n\r\n");
+    } else {
+        grow->addstrf(grow, "Content-Length: %zu\r\n\r\n", zsize);
+        grow->add(grow, zbuf, zsize);
+    }
+    char *response = grow->toarray(grow, size);
+    grow->free(grow);
+    return response;
+}
+#endif
+
+#ifdef ENABLE_OPENSSL
+// mirrors struct SslConn of qhttpclient.c
+struct SslConn {
+    SSL *ssl;
+    SSL_CTX *ctx;
+};
+
+static char tlsdir[] = "/tmp/test_qhttpclient_XXXXXX";
+
+// runs "openssl s_server" with a self-signed certificate on a free port.
+static pid_t _tls_serve(int *port) {
+    if (mkdtemp(tlsdir) == NULL)
+        return -1;
+    char cmd[PATH_MAX * 2 + 256];
+    snprintf(cmd, sizeof(cmd), "openssl req -x509 -newkey rsa:2048 -nodes "
+             "-keyout %s/key.pem -out %s/cert.pem -subj /CN=localhost "
+             "-days 1 >/dev/null 2>&1", tlsdir, tlsdir);
+    if (system(cmd) != 0)
+        return -1;
+
+    // a port the kernel picked, given to the server right after
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addrlen = sizeof(addr);
+    bind(sock, (struct sockaddr *) &addr, sizeof(addr));
+    getsockname(sock, (struct sockaddr *) &addr, &addrlen);
+    close(sock);
+    *port = ntohs(addr.sin_port);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        char accept[16], cert[PATH_MAX], key[PATH_MAX];
+        snprintf(accept, sizeof(accept), "%d", *port);
+        snprintf(cert, sizeof(cert), "%s/cert.pem", tlsdir);
+        snprintf(key, sizeof(key), "%s/key.pem", tlsdir);
+        int devnull = open("/dev/null", O_WRONLY);
+        dup2(devnull, STDOUT_FILENO);
+        dup2(devnull, STDERR_FILENO);
+        execlp("openssl", "openssl", "s_server", "-accept", accept,
+               "-cert", cert, "-key", key, "-www", "-quiet", (char *) NULL);
+        _exit(127);
+    }
+
+    // wait till it listens
+    int i;
+    for (i = 0; pid > 0 && i < 100; i++) {
+        sock = socket(AF_INET, SOCK_STREAM, 0);
+        int ret = connect(sock, (struct sockaddr *) &addr, sizeof(addr));
+        close(sock);
+        if (ret == 0)
+            return pid;
+        usleep(50 * 1000);
+    }
+    if (pid > 0)
+        kill(pid, SIGTERM);
+    return -1;
+}
+
+static void _tls_stop(pid_t pid) {
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    char cmd[PATH_MAX + 16];
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", tlsdir);
+    system(cmd);
+}
+#endif
+
+static int _reap(pid_t pid) {
+    int status = -1;
+    waitpid(pid, &status, 0);
+    return status;
+}
+
+QUNIT_START("Test qhttpclient.c");
+
+// fail instead of hanging
+alarm(60);
+
+TEST("Test pipeline(): Content-Length and chunked responses in order") {
+    const char *responses[] = {
+        "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nhello",
+        "HTTP/1.1 201 Created\r\nTransfer-Encoding: chunked\r\n\r\n"
+        "5\r\nhello\r\n6\r\n world\r\n0\r\n\r\n"
+    };
+    int port;
+    pid_t pid = _serve(&port, responses, 2, false);
+    ASSERT_TRUE(pid > 0);
+
+    qhttpclient_t *client = qhttpclient("127.0.0.1", port);
+    ASSERT_NOT_NULL(client);
+    struct result res[2];
+    memset(res, 0, sizeof(res));
+    ASSERT_TRUE(client->pipeline(client, "GET", "/a", NULL, 0, NULL,
+                                 _done, &res[0]));
+    ASSERT_TRUE(client->pipeline(client, "GET", "/b", NULL, 0, NULL,
+                                 _done, &res[1]));
+    ASSERT_EQUAL_INT(2, client->inflight(client));
+
+    int i;
+    for (i = 0; i < 10 && client->inflight(client) > 0; i++) {
+        ASSERT_TRUE(client->dispatch(client, 1000) >= 0);
+    }
+    ASSERT_EQUAL_INT(0, client->inflight(client));
+    ASSERT_EQUAL_INT(1, res[0].calls);
+    ASSERT_EQUAL_INT(200, res[0].rescode);
+    ASSERT_EQUAL_STR("hello", res[0].body);
+    ASSERT_EQUAL_INT(1, res[1].calls);
+    ASSERT_EQUAL_INT(201, res[1].rescode);
+    ASSERT_EQUAL_STR("hello world", res[1].body);
+    ASSERT_EQUAL_INT(11, res[1].bodysize);
+
+    client->free(client);
+    ASSERT_EQUAL_INT(0, _reap(pid));
+}
+
+TEST("Test pipeline(): 1xx response before the final one") {
+    const char *responses[] = {
+        "HTTP/1.1 100 Continue\r\n\r\n"
+        "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok"
+    };
+    int port;
+    pid_t pid = _serve(&port, responses, 1, false);
+    ASSERT_TRUE(pid > 0);
+
+    qhttpclient_t *client = qhttpclient("127.0.0.1", port);
+    ASSERT_NOT_NULL(client);
+    struct result res;
+    memset(&res, 0, sizeof(res));
+    ASSERT_TRUE(client->pipeline(client, "GET", "/", NULL, 0, NULL,
+                                 _done, &res));
+    int i;
+    for (i = 0; i < 10 && client->inflight(client) > 0; i++) {
+        ASSERT_TRUE(client->dispatch(client, 1000) >= 0);
+    }
+    ASSERT_EQUAL_INT(1, res.calls);
+    ASSERT_EQUAL_INT(200, res.rescode);
+    ASSERT_EQUAL_STR("ok", res.body);
+
+    client->free(client);
+    ASSERT_EQUAL_INT(0, _reap(pid));
+}
+
+TEST("Test pipeline(): body until the connection closes") {
+    const char *responses[] = {
+        "HTTP/1.1 200 OK\r\nConnection: close\r\n\r\nuntil-close"
+    };
+    int port;
+    pid_t pid = _serve(&port, responses, 1, false);
+    ASSERT_TRUE(pid > 0);
+
+    qhttpclient_t *client = qhttpclient("127.0.0.1", port);
+    ASSERT_NOT_NULL(client);
+    struct result res;
+    memset(&res, 0, sizeof(res));
+    ASSERT_TRUE(client->pipeline(client, "GET", "/", NULL, 0, NULL,
+                                 _done, &res));
+    int i;
+    for (i = 0; i < 10 && client->inflight(client) > 0; i++) {
+        ASSERT_TRUE(client->dispatch(client, 1000) >= 0);
+    }
+    ASSERT_EQUAL_INT(1, res.calls);
+    ASSERT_EQUAL_INT(200, res.rescode);
+    ASSERT_EQUAL_STR("until-close", res.body);
+
+    client->free(client);
+    ASSERT_EQUAL_INT(0, _reap(pid));
+}
+
+TEST("Test pipeline(): rescode 0 for the requests behind a close") {
+    const char *responses[] = {
+        "HTTP/1.1 200 OK\r\nContent-Length: 3\r\nConnection: close\r\n\r\n"
+        "one"
+    };
+    int port;
+    pid_t pid = _serve(&port, responses, 1, false);
+    ASSERT_TRUE(pid > 0);
+
+    qhttpclient_t *client = qhttpclient("127.0.0.1", port);
+    ASSERT_NOT_NULL(client);
+    struct result res[3];
+    memset(res, 0, sizeof(res));
+    for (int i = 0; i < 3; i++) {
+        ASSERT_TRUE(client->pipeline(client, "GET", "/", NULL, 0, NULL,
+                                     _done, &res[i]));
+    }
+    int i;
+    for (i = 0; i < 10 && client->inflight(client) > 0; i++) {
+        if (client->dispatch(client, 1000) < 0)
+            break;
+    }
+    ASSERT_EQUAL_INT(0, client->inflight(client));
+    ASSERT_EQUAL_INT(200, res[0].rescode);
+    ASSERT_EQUAL_STR("one", res[0].body);
+    ASSERT_EQUAL_INT(1, res[1].calls);
+    ASSERT_EQUAL_INT(0, res[1].rescode);
+    ASSERT_EQUAL_INT(1, res[2].calls);
+    ASSERT_EQUAL_INT(0, res[2].rescode);
+
+    client->free(client);
+    ASSERT_EQUAL_INT(0, _reap(pid));
+}
+
+TEST("Test pipeline(): rescode 0 when the connection drops") {
+    const char *responses[] = {
+        "HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\nshort"
+    };
+    int port;
+    pid_t pid = _serve(&port, responses, 1, false);
+    ASSERT_TRUE(pid > 0);
+
+    qhttpclient_t *client = qhttpclient("127.0.0.1", port);
+    ASSERT_NOT_NULL(client);
+    struct result res;
+    memset(&res, 0, sizeof(res));
+    ASSERT_TRUE(client->pipeline(client, "GET", "/", NULL, 0, NULL,
+                                 _done, &res));
+    int ret = 0;
+    int i;
+    for (i = 0; i < 10 && client->inflight(client) > 0; i++) {
+        if ((ret = client->dispatch(client, 1000)) < 0)
+            break;
+    }
+    ASSERT_EQUAL_INT(-1, ret);
+    ASSERT_EQUAL_INT(0, client->inflight(client));
+    ASSERT_EQUAL_INT(1, res.calls);
+    ASSERT_EQUAL_INT(0, res.rescode);
+
+    client->free(client);
+    ASSERT_EQUAL_INT(0, _reap(pid));
+}
+
+TEST("Test stream(): body until the connection closes") {
+    const char *responses[] = {
+        "HTTP/1.1 200 OK\r\nConnection: close\r\n\r\n0123456789abcdef"
+    };
+    int port;
+    pid_t pid = _serve(&port, responses, 1, false);
+    ASSERT_TRUE(pid > 0);
+
+    qhttpclient_t *client = qhttpclient("127.0.0.1", port);
+    ASSERT_NOT_NULL(client);
+    qgrow_t *grow = qgrow(0);
+    int rescode;
+    ASSERT_TRUE(client->stream(client, "GET", "/", NULL, 0, &rescode,
+                               NULL, NULL, _collect, grow));
+    ASSERT_EQUAL_INT(200, rescode);
+    ASSERT_EQUAL_INT(16, grow->datasize(grow));
+    char *body = grow->toarray(grow, NULL);
+    ASSERT_TRUE(body != NULL && !memcmp("0123456789abcdef", body, 16));
+    free(body);
+
+    grow->free(grow);
+    client->free(client);
+    ASSERT_EQUAL_INT(0, _reap(pid));
+}
+
+TEST("Test readbody(): HTTP/1.0 body until the connection closes") {
+    const char *responses[] = {
+        "HTTP/1.0 200 OK\r\n\r\nhello-1.0"
+    };
+    int port;
+    pid_t pid = _serve(&port, responses, 1, false);
+    ASSERT_TRUE(pid > 0);
+
+    qhttpclient_t *client = qhttpclient("127.0.0.1", port);
+    ASSERT_NOT_NULL(client);
+    ASSERT_TRUE(client->sendrequest(client, "GET", "/", NULL));
+    off_t clength = -1;
+    ASSERT_EQUAL_INT(200, client->readresponse(client, NULL, &clength));
+    ASSERT_EQUAL_INT(0, clength);
+
+    char body[64];
+    size_t total = 0;
+    const void *data;
+    ssize_t size;
+    while ((size = client->readbody(client, &data)) > 0) {
+        ASSERT_TRUE(total + size < sizeof(body));
+        memcpy(body + total, data, size);
+        total += size;
+    }
+    ASSERT_EQUAL_INT(0, size);
+    ASSERT_EQUAL_INT(9, total);
+    ASSERT_EQUAL_MEM("hello-1.0", body, 9);
+
+    client->free(client);
+    ASSERT_EQUAL_INT(0, _reap(pid));
+}
+
+TEST("Test qhttpclient_pool: reuse of a kept-alive connection") {
+    // one connection only, so the second request has to reuse it
+    const char *responses[] = {
+        "HTTP/1.1 200 OK\r\nContent-Length: 1\r\n\r\na",
+        "HTTP/1.1 202 Accepted\r\nContent-Length: 1\r\n\r\nb"
+    };
+    int port;
+    pid_t pid = _serve(&port, responses, 2, true);
+    ASSERT_TRUE(pid > 0);
+
+    qhttpclient_pool_t *pool = qhttpclient_pool(0, 0);
+    ASSERT_NOT_NULL(pool);
+    qhttpclient_t *client = pool->get(pool, "127.0.0.1", port);
+    ASSERT_NOT_NULL(client);
+    ASSERT_EQUAL_INT(200, _request(client));
+    int sock = client->socket;
+    ASSERT_TRUE(sock >= 0);
+    pool->release(pool, client);
+
+    qhttpclient_t *again = pool->get(pool, "127.0.0.1", port);
+    ASSERT_EQUAL_PT(client, again);
+    ASSERT_EQUAL_INT(sock, again->socket);
+    ASSERT_EQUAL_INT(202, _request(again));
+    pool->release(pool, again);
+
+    pool->free(pool);
+    ASSERT_EQUAL_INT(0, _reap(pid));
+}
+
+TEST("Test qhttpclient_pool: get() blocks at the per-host limit") {
+    qhttpclient_pool_t *pool = qhttpclient_pool(1, 0);
+    ASSERT_NOT_NULL(pool);
+    qhttpclient_t *client = pool->get(pool, "127.0.0.1", 80);
+    ASSERT_NOT_NULL(client);
+
+    struct waiter w;
+    memset(&w, 0, sizeof(w));
+    w.pool = pool;
+    w.port = 80;
+    pthread_t thread;
+    ASSERT_EQUAL_INT(0, pthread_create(&thread, NULL, _pool_waiter, &w));
+    usleep(200 * 1000);
+    ASSERT_EQUAL_BOOL(false, w.done);
+
+    // the slot frees up on release
+    pool->release(pool, client);
+    pthread_join(thread, NULL);
+    ASSERT_EQUAL_BOOL(true, w.done);
+    ASSERT_NOT_NULL(w.client);
+    pool->release(pool, w.client);
+
+    pool->free(pool);
+}
+
+TEST("Test qhttpclient_pool: idle connections expire") {
+    const char *responses[] = {
+        "HTTP/1.1 200 OK\r\nContent-Length: 1\r\n\r\na"
+    };
+    int port;
+    pid_t pid = _serve(&port, responses, 1, true);
+    ASSERT_TRUE(pid > 0);
+
+    qhttpclient_pool_t *pool = qhttpclient_pool(0, 1);
+    ASSERT_NOT_NULL(pool);
+    qhttpclient_t *client = pool->get(pool, "127.0.0.1", port);
+    ASSERT_NOT_NULL(client);
+    ASSERT_EQUAL_INT(200, _request(client));
+    pool->release(pool, client);
+
+    // a new unconnected client instead of the expired one
+    sleep(2);
+    client = pool->get(pool, "127.0.0.1", port);
+    ASSERT_NOT_NULL(client);
+    ASSERT_TRUE(client->socket < 0);
+    ASSERT_EQUAL_INT(0, _reap(pid));
+    pool->release(pool, client);
+
+    pool->free(pool);
+}
+
+TEST("Test qhttpclient_pool: connections closed by the peer are dropped") {
+    // keep-alive response, but the server goes away right after
+    const char *responses[] = {
+        "HTTP/1.1 200 OK\r\nContent-Length: 1\r\n\r\na"
+    };
+    int port;
+    pid_t pid = _serve(&port, responses, 1, false);
+    ASSERT_TRUE(pid > 0);
+
+    qhttpclient_pool_t *pool = qhttpclient_pool(0, 0);
+    ASSERT_NOT_NULL(pool);
+    qhttpclient_t *client = pool->get(pool, "127.0.0.1", port);
+    ASSERT_NOT_NULL(client);
+    ASSERT_EQUAL_INT(200, _request(client));
+    pool->release(pool, client);
+    ASSERT_EQUAL_INT(0, _reap(pid));
+
+    client = pool->get(pool, "127.0.0.1", port);
+    ASSERT_NOT_NULL(client);
+    ASSERT_TRUE(client->socket < 0);
+    pool->release(pool, client);
+
+    pool->free(pool);
+}
+
+#ifdef ENABLE_ZLIB
+TEST("Test setdecoding(): gzip body with Content-Length") {
+    char body[20000];
+    for (size_t i = 0; i < sizeof(body); i++) {
+        body[i] = 'a' + (i % 7) + (i / 1000) % 3;
+    }
+    size_t size;
+    char *response = _compressed(body, sizeof(body), true, false, &size);
+    ASSERT_NOT_NULL(response);
+    const char *responses[] = { response };
+    int port;
+    pid_t pid = _serve_raw(&port, responses, &size, 1, false);
+    ASSERT_TRUE(pid > 0);
+
+    qhttpclient_t *client = qhttpclient("127.0.0.1", port);
+    ASSERT_NOT_NULL(client);
+    ASSERT_TRUE(client->setdecoding(client, true));
+    int rescode;
+    size_t clength;
+    char *content = client->cmd(client, "GET", "/", NULL, 0, &rescode,
+                                &clength, NULL, NULL);
+    ASSERT_EQUAL_INT(200, rescode);
+    ASSERT_EQUAL_INT(sizeof(body), clength);
+    ASSERT_TRUE(content != NULL && !memcmp(body, content, sizeof(body)));
+    free(content);
+
+    client->free(client);
+    free(response);
+    ASSERT_EQUAL_INT(0, _reap(pid));
+}
+
+TEST("Test setdecoding(): chunked deflate body streamed") {
+    char body[20000];
+    for (size_t i = 0; i < sizeof(body); i++) {
+        body[i] = '0' + (i % 10) + (i / 3000) % 2;
+    }
+    size_t size;
+    char *response = _compressed(body, sizeof(body), false, true, &size);
+    ASSERT_NOT_NULL(response);
+    const char *responses[] = { response };
+    int port;
+    pid_t pid = _serve_raw(&port, responses, &size, 1, false);
+    ASSERT_TRUE(pid > 0);
+
+    qhttpclient_t *client = qhttpclient("127.0.0.1", port);
+    ASSERT_NOT_NULL(client);
+    ASSERT_TRUE(client->setdecoding(client, true));
+    qgrow_t *grow = qgrow(0);
+    int rescode;
+    ASSERT_TRUE(client->stream(client, "GET", "/", NULL, 0, &rescode,
+                               NULL, NULL, _collect, grow));
+    ASSERT_EQUAL_INT(200, rescode);
+    ASSERT_EQUAL_INT(sizeof(body), grow->datasize(grow));
+    char *content = grow->toarray(grow, NULL);
+    ASSERT_TRUE(content != NULL && !memcmp(body, content, sizeof(body)));
+    free(content);
+
+    grow->free(grow);
+    client->free(client);
+    free(response);
+    ASSERT_EQUAL_INT(0, _reap(pid));
+}
+
+TEST("Test setdecoding(): pipelined gzip and chunked deflate bodies") {
+    char body[200];
+    for (size_t i = 0; i < sizeof(body) - 1; i++) {
+        body[i] = 'A' + (i % 26);
+    }
+    body[sizeof(body) - 1] = '\0';
+    size_t sizes[3];
+    char *gz = _compressed(body, strlen(body), true, false, &sizes[0]);
+    char *df = _compressed(body, strlen(body), false, true, &sizes[1]);
+    const char *plain = "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nplain";
+    sizes[2] = strlen(plain);
+    ASSERT_TRUE(gz != NULL && df != NULL);
+    const char *responses[] = { gz, df, plain };
+    int port;
+    pid_t pid = _serve_raw(&port, responses, sizes, 3, false);
+    ASSERT_TRUE(pid > 0);
+
+    qhttpclient_t *client = qhttpclient("127.0.0.1", port);
+    ASSERT_NOT_NULL(client);
+    ASSERT_TRUE(client->setdecoding(client, true));
+    struct result res[3];
+    memset(res, 0, sizeof(res));
+    int i;
+    for (i = 0; i < 3; i++) {
+        ASSERT_TRUE(client->pipeline(client, "GET", "/", NULL, 0, NULL,
+                                     _done, &res[i]));
+    }
+    for (i = 0; i < 10 && client->inflight(client) > 0; i++) {
+        ASSERT_TRUE(client->dispatch(client, 1000) >= 0);
+    }
+    ASSERT_EQUAL_INT(200, res[0].rescode);
+    ASSERT_EQUAL_STR(body, res[0].body);
+    ASSERT_EQUAL_INT(200, res[1].rescode);
+    ASSERT_EQUAL_STR(body, res[1].body);
+    ASSERT_EQUAL_INT(200, res[2].rescode);
+    ASSERT_EQUAL_STR("plain", res[2].body);
+
+    client->free(client);
+    free(gz);
+    free(df);
+    ASSERT_EQUAL_INT(0, _reap(pid));
+}
+#else
+TEST("Test setdecoding(): not supported without zlib") {
+    qhttpclient_t *client = qhttpclient("127.0.0.1", 80);
+    ASSERT_NOT_NULL(client);
+    ASSERT_FALSE(client->setdecoding(client, true));
+    ASSERT_EQUAL_INT(ENOTSUP, errno);
+    ASSERT_TRUE(client->setdecoding(client, false));
+    client->free(client);
+}
+#endif
+
+#ifdef ENABLE_OPENSSL
+TEST("Test setssl(): shared context and session resumption") {
+    // needs the openssl command line tool for the server
+    bool hastool = (system("openssl version >/dev/null 2>&1") == 0);
+    if (hastool == false) {
+        PRINT(" skipped, no openssl command");
+    } else {
+        int port;
+        pid_t pid = _tls_serve(&port);
+        ASSERT_TRUE(pid > 0);
+
+        // the first connection stores the session and the second resumes it
+        int reused[2] = { -1, -1 };
+        SSL_CTX *ctx[2] = { NULL, NULL };
+        int i;
+        for (i = 0; pid > 0 && i < 2; i++) {
+            qhttpclient_t *client = qhttpclient("localhost", port);
+            ASSERT_NOT_NULL(client);
+            ASSERT_TRUE(client->setssl(client));
+            ASSERT_TRUE(client->open(client));
+            struct SslConn *ssl = (struct SslConn *) client->ssl;
+            ctx[i] = ssl->ctx;
+            if (ssl->ssl != NULL)
+                reused[i] = SSL_session_reused(ssl->ssl);
+
+            // TLSv1.3 tickets come with the first read
+            int rescode = 0;
+            void *body = client->cmd(client, "GET", "/", NULL, 0, &rescode,
+                                     NULL, NULL, NULL);
+            ASSERT_EQUAL_INT(200, rescode);
+            free(body);
+            client->free(client);
+        }
+        ASSERT_EQUAL_INT(0, reused[0]);
+        ASSERT_EQUAL_INT(1, reused[1]);
+        ASSERT_TRUE(ctx[0] != NULL && ctx[0] == ctx[1]);
+
+        if (pid > 0)
+            _tls_stop(pid);
+    }
+}
+#endif
+
+TEST("Test attach(): free the client after the loop dispatched") {
+    const char *responses[] = {
+        "HTTP/1.1 200 OK\r\nContent-Length: 1\r\n\r\na",
+        "HTTP/1.1 200 OK\r\nContent-Length: 1\r\n\r\nb"
+    };
+    int port;
+    pid_t pid = _serve(&port, responses, 2, true);
+    ASSERT_TRUE(pid > 0);
+
+    qevloop_t *loop = qevloop(0);
+    ASSERT_NOT_NULL(loop);
+    qhttpclient_t *client = qhttpclient("127.0.0.1", port);
+    ASSERT_NOT_NULL(client);
+    ASSERT_TRUE(client->attach(client, loop));
+    struct result res[2];
+    memset(res, 0, sizeof(res));
+    ASSERT_TRUE(client->pipeline(client, "GET", "/a", NULL, 0, NULL,
+                                 _done, &res[0]));
+    ASSERT_TRUE(client->pipeline(client, "GET", "/b", NULL, 0, NULL,
+                                 _done, &res[1]));
+    int i;
+    for (i = 0; i < 10 && client->inflight(client) > 0; i++) {
+        ASSERT_TRUE(loop->once(loop, 1000) >= 0);
+    }
+    ASSERT_EQUAL_STR("a", res[0].body);
+    ASSERT_EQUAL_STR("b", res[1].body);
+
+    // the wake-up drain must not leave EAGAIN for the close on free
+    ASSERT_TRUE(loop->stop(loop));
+    loop->once(loop, 100);
+    client->free(client);
+    ASSERT_EQUAL_INT(0, _reap(pid));
+    loop->free(loop);
+}
+
+QUNIT_END();
@@ -0,0 +1,168 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+#include <errno.h>
+#include "qunit.h"
+#include "qlibc.h"
+#include "containers/qinline.h"
+
+struct point {
+    int x, y;
+};
+
+static inline uint32_t hash_id(const uint64_t *key) {
+    return qinline_hash64(*key);
+}
+
+Q_HASHTBL_TYPED(idmap, uint64_t, struct point, hash_id)
+Q_VECTOR_TYPED(points, struct point)
+Q_LIST_TYPED(pointlist, struct point)
+
+QUNIT_START("Test qinline.h");
+
+TEST("qinline_hash64()") {
+    ASSERT_EQUAL_INT(qinline_hash64(12345), qinline_hash64(12345));
+    ASSERT_TRUE(qinline_hash64(1) != qinline_hash64(2));
+}
+
+TEST("Q_HASHTBL_TYPED() inline and fallback paths") {
+    // AUTORESIZE looks up during the migrations
+    int options[] = { 0, QHASHTBL_AUTORESIZE, QHASHTBL_OPENADDR,
+                      QHASHTBL_THREADSAFE, QHASHTBL_STRIPED };
+    int j;
+    for (j = 0; j < sizeof(options) / sizeof(int); j++) {
+        qhashtbl_t *tbl = qhashtbl(3, options[j]);
+        ASSERT_NOT_NULL(tbl);
+
+        uint64_t id;
+        for (id = 0; id < 1000; id++) {
+            struct point pt = { (int) id, (int) id * 2 };
+            ASSERT_TRUE(idmap_put(tbl, id, pt));
+        }
+        ASSERT_EQUAL_INT(1000, tbl->size(tbl));
+
+        for (id = 0; id < 1000; id++) {
+            struct point *pt = idmap_get(tbl, id);
+            ASSERT_NOT_NULL(pt);
+            ASSERT_EQUAL_INT((int) id, pt->x);
+            ASSERT_EQUAL_INT((int) id * 2, pt->y);
+        }
+        ASSERT_NULL(idmap_get(tbl, 1000));
+        ASSERT_EQUAL_INT(ENOENT, errno);
+
+        // overwrite and remove
+        struct point pt = { -1, -1 };
+        ASSERT_TRUE(idmap_put(tbl, 7, pt));
+        ASSERT_EQUAL_INT(-1, idmap_get(tbl, 7)->x);
+        ASSERT_EQUAL_INT(1000, tbl->size(tbl));
+        ASSERT_TRUE(idmap_remove(tbl, 7));
+        ASSERT_NULL(idmap_get(tbl, 7));
+        ASSERT_FALSE(idmap_remove(tbl, 7));
+
+        tbl->free(tbl);
+    }
+}
+
+TEST("qhashtbl_get_inline() finds the string keys") {
+    qhashtbl_t *tbl = qhashtbl(0, 0);
+    tbl->putstr(tbl, "name", "qlibc");
+
+    size_t size = 0;
+    char *str = qhashtbl_get_inline(tbl, "name", 4,
+                                    qhashmurmur3_32("name", 4), &size);
+    ASSERT_EQUAL_STR("qlibc", str);
+    ASSERT_EQUAL_INT(6, size);
+    ASSERT_NULL(qhashtbl_get_inline(tbl, "nam", 3, qhashmurmur3_32("nam", 3),
+                                    NULL));
+    ASSERT_EQUAL_INT(ENOENT, errno);
+
+    tbl->free(tbl);
+}
+
+TEST("Q_VECTOR_TYPED()") {
+    int options[] = { 0, QVECTOR_RESIZE_DOUBLE, QVECTOR_CIRCULAR,
+                      QVECTOR_THREADSAFE };
+    int i, j;
+    for (j = 0; j < sizeof(options) / sizeof(int); j++) {
+        qvector_t *vector = points_new(4, options[j] | QVECTOR_RESIZE_EXACT);
+        ASSERT_NOT_NULL(vector);
+
+        for (i = 0; i < 100; i++) {
+            struct point pt = { i, -i };
+            ASSERT_TRUE(points_addlast(vector, pt));
+        }
+        // moves the head of the circular one around the ring
+        for (i = 100; i < 150; i++) {
+            struct point pt = { i, -i };
+            ASSERT_TRUE(vector->removefirst(vector));
+            ASSERT_TRUE(points_addlast(vector, pt));
+        }
+        ASSERT_EQUAL_INT(100, points_size(vector));
+        ASSERT_EQUAL_INT(50, points_getat(vector, 0)->x);
+        ASSERT_EQUAL_INT(149, points_getat(vector, -1)->x);
+        for (i = 0; i < 100; i++) {
+            ASSERT_EQUAL_INT(-(i + 50), points_getat(vector, i)->y);
+        }
+
+        ASSERT_NULL(points_getat(vector, 100));
+        ASSERT_EQUAL_INT(ERANGE, errno);
+        ASSERT_NULL(points_getat(vector, -101));
+        ASSERT_EQUAL_INT(ERANGE, errno);
+
+        vector->clear(vector);
+        ASSERT_NULL(points_getat(vector, 0));
+        ASSERT_EQUAL_INT(ENOENT, errno);
+        vector->free(vector);
+    }
+}
+
+TEST("Q_LIST_TYPED()") {
+    int options[] = { 0, QLIST_THREADSAFE };
+    int i, j;
+    for (j = 0; j < sizeof(options) / sizeof(int); j++) {
+        qlist_t *list = qlist(options[j]);
+        ASSERT_NULL(pointlist_getfirst(list));
+        ASSERT_EQUAL_INT(ERANGE, errno);
+        ASSERT_NULL(pointlist_getlast(list));
+
+        for (i = 0; i < 10; i++) {
+            struct point pt = { i, i * i };
+            ASSERT_TRUE(pointlist_addlast(list, pt));
+        }
+        ASSERT_EQUAL_INT(0, pointlist_getfirst(list)->x);
+        ASSERT_EQUAL_INT(9, pointlist_getlast(list)->x);
+        ASSERT_EQUAL_INT(25, pointlist_getat(list, 5)->y);
+
+        size_t size = 0;
+        ASSERT_NOT_NULL(qlist_getlast_inline(list, &size));
+        ASSERT_EQUAL_INT(sizeof(struct point), size);
+
+        list->free(list);
+    }
+}
+
+QUNIT_END();
@@ -0,0 +1,372 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include "qunit.h"
+#include "qlibc.h"
+
+// a temp file filled with a pattern, at offset 0
+static int _tmpfile(size_t size) {
+    char path[] = "/tmp/test_qio_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0)
+        return -1;
+    unlink(path);
+    char buf[4096];
+    size_t i;
+    for (i = 0; i < size; i++) {
+        buf[i % sizeof(buf)] = (char) (i * 7 % 251);
+        if (i % sizeof(buf) == sizeof(buf) - 1 || i == size - 1) {
+            size_t len = i % sizeof(buf) + 1;
+            if (write(fd, buf, len) != (ssize_t) len) {
+                close(fd);
+                return -1;
+            }
+        }
+    }
+    lseek(fd, 0, SEEK_SET);
+    return fd;
+}
+
+// checks the pattern of _tmpfile() from the offset
+static bool _check(const char *data, size_t size, size_t offset) {
+    size_t i;
+    for (i = 0; i < size; i++) {
+        if (data[i] != (char) ((offset + i) * 7 % 251))
+            return false;
+    }
+    return true;
+}
+
+static bool _check_fd(int fd, size_t size, size_t offset) {
+    char *data = malloc(size + 1);
+    if (data == NULL)
+        return false;
+    bool ret = (pread(fd, data, size + 1, 0) == (ssize_t) size
+                && _check(data, size, offset));
+    free(data);
+    return ret;
+}
+
+QUNIT_START("Test qio.c");
+
+TEST("Test qio_read() at EOF with a stale EAGAIN") {
+    int fds[2];
+    ASSERT_EQUAL_INT(0, pipe(fds));
+    ASSERT_EQUAL_INT(2, write(fds[1], "ab", 2));
+    close(fds[1]);
+
+    // a non-block drain elsewhere leaves EAGAIN behind
+    char buf[8];
+    errno = EAGAIN;
+    ASSERT_EQUAL_INT(2, qio_read(fds[0], buf, sizeof(buf), -1));
+    errno = EAGAIN;
+    ASSERT_EQUAL_INT(-1, qio_read(fds[0], buf, sizeof(buf), -1));
+    errno = EAGAIN;
+    ASSERT_EQUAL_INT(-1, qio_read(fds[0], buf, sizeof(buf), 100));
+    errno = EAGAIN;
+    ASSERT_EQUAL_INT(-1, qio_gets(fds[0], buf, sizeof(buf), -1));
+    close(fds[0]);
+}
+
+TEST("Test qio_send() between regular files") {
+    // more than a chunk of the kernel copy, from the current offsets
+    size_t size = 3 * 1024 * 1024 + 100;
+    int infd = _tmpfile(size + 10);
+    int outfd = _tmpfile(0);
+    ASSERT_TRUE(infd >= 0 && outfd >= 0);
+    ASSERT_EQUAL_INT(10, lseek(infd, 10, SEEK_SET));
+    ASSERT_EQUAL_INT(size, qio_send(outfd, infd, size, 1000));
+    ASSERT_EQUAL_INT(size + 10, lseek(infd, 0, SEEK_CUR));
+    ASSERT_EQUAL_INT(size, lseek(outfd, 0, SEEK_CUR));
+    ASSERT_TRUE(_check_fd(outfd, size, 10));
+
+    // the input ends short
+    ASSERT_TRUE(ftruncate(outfd, 0) == 0 && lseek(outfd, 0, SEEK_SET) == 0);
+    ASSERT_EQUAL_INT(size - 100, lseek(infd, -110, SEEK_END));
+    ASSERT_EQUAL_INT(110, qio_send(outfd, infd, 1000, 1000));
+    ASSERT_TRUE(_check_fd(outfd, 110, size - 100));
+
+    close(infd);
+    close(outfd);
+}
+
+TEST("Test qio_send() to an O_APPEND file") {
+    int infd = _tmpfile(5000);
+    int outfd = _tmpfile(100);
+    ASSERT_TRUE(infd >= 0 && outfd >= 0);
+    ASSERT_EQUAL_INT(100, lseek(infd, 100, SEEK_SET));
+
+    // kernel copies don't append, so it's copied through the buffer
+    fcntl(outfd, F_SETFL, fcntl(outfd, F_GETFL) | O_APPEND);
+    ASSERT_EQUAL_INT(4900, qio_send(outfd, infd, 4900, 1000));
+    ASSERT_TRUE(_check_fd(outfd, 5000, 0));
+
+    close(infd);
+    close(outfd);
+}
+
+TEST("Test qio_send() from a file to a socket") {
+    int sv[2];
+    ASSERT_EQUAL_INT(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+    int infd = _tmpfile(60000);
+    ASSERT_TRUE(infd >= 0);
+
+    // fits in the socket buffer, read after
+    ASSERT_EQUAL_INT(60000, qio_send(sv[0], infd, 60000, 1000));
+    char *data = malloc(60000);
+    ASSERT_EQUAL_INT(60000, qio_read(sv[1], data, 60000, 1000));
+    ASSERT_TRUE(_check(data, 60000, 0));
+
+    // short input
+    ASSERT_EQUAL_INT(59000, lseek(infd, 59000, SEEK_SET));
+    ASSERT_EQUAL_INT(1000, qio_send(sv[0], infd, 60000, 1000));
+    ASSERT_EQUAL_INT(1000, qio_read(sv[1], data, 60000, 100));
+    ASSERT_TRUE(_check(data, 1000, 59000));
+
+    free(data);
+    close(infd);
+    close(sv[0]);
+    close(sv[1]);
+}
+
+TEST("Test qio_send() from a pipe and a socket to a file") {
+    int fds[2], sv[2];
+    ASSERT_EQUAL_INT(0, pipe(fds));
+    ASSERT_EQUAL_INT(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+    int outfd = _tmpfile(0);
+    ASSERT_TRUE(outfd >= 0);
+
+    // straight from the pipe
+    char data[1000];
+    int i;
+    for (i = 0; i < (int) sizeof(data); i++) {
+        data[i] = (char) (i * 7 % 251);
+    }
+    ASSERT_EQUAL_INT(600, write(fds[1], data, 600));
+    ASSERT_EQUAL_INT(600, qio_send(outfd, fds[0], 600, 1000));
+
+    // through a pipe from the socket, then short as the peer closes
+    ASSERT_EQUAL_INT(400, write(sv[1], data + 600, 400));
+    close(sv[1]);
+    ASSERT_EQUAL_INT(400, qio_send(outfd, sv[0], 1000, 1000));
+    ASSERT_TRUE(_check_fd(outfd, 1000, 0));
+
+    // nothing came in time
+    ASSERT_EQUAL_INT(0, qio_send(outfd, fds[0], 100, 10));
+    ASSERT_EQUAL_INT(ETIMEDOUT, errno);
+
+    close(fds[0]);
+    close(fds[1]);
+    close(sv[0]);
+    close(outfd);
+}
+
+TEST("Test qio_send() copying through the buffer") {
+    // no kernel copy from a character device
+    int infd = open("/dev/zero", O_RDONLY);
+    int outfd = _tmpfile(0);
+    ASSERT_TRUE(infd >= 0 && outfd >= 0);
+    ASSERT_EQUAL_INT(100000, qio_send(outfd, infd, 100000, 1000));
+    ASSERT_EQUAL_INT(100000, lseek(outfd, 0, SEEK_END));
+    char buf[100];
+    ASSERT_EQUAL_INT(100, pread(outfd, buf, sizeof(buf), 99900));
+    char zeros[100] = { 0 };
+    ASSERT_EQUAL_MEM(zeros, buf, sizeof(buf));
+
+    close(infd);
+    close(outfd);
+}
+
+TEST("Test qio_reader_gets() with lines split across fills") {
+    int sv[2];
+    ASSERT_EQUAL_INT(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+    qio_reader_t *reader = qio_reader(sv[0], 8);
+    ASSERT_NOT_NULL(reader);
+
+    char line[64];
+    ASSERT_EQUAL_INT(10, write(sv[1], "hello\r\nwor", 10));
+    ASSERT_EQUAL_INT(7, qio_reader_gets(reader, line, sizeof(line), 1000));
+    ASSERT_EQUAL_STR("hello", line);
+    ASSERT_EQUAL_INT(1, qio_reader_pending(reader));
+
+    // the rest of the line comes later
+    ASSERT_EQUAL_INT(3, write(sv[1], "ld\n", 3));
+    ASSERT_EQUAL_INT(6, qio_reader_gets(reader, line, sizeof(line), 1000));
+    ASSERT_EQUAL_STR("world", line);
+
+    // longer than the reader buffer
+    ASSERT_EQUAL_INT(21, write(sv[1], "0123456789abcdefghij\n", 21));
+    ASSERT_EQUAL_INT(21, qio_reader_gets(reader, line, sizeof(line), 1000));
+    ASSERT_EQUAL_STR("0123456789abcdefghij", line);
+
+    // longer than the line buffer, the rest is left for the next call
+    ASSERT_EQUAL_INT(7, write(sv[1], "abcdef\n", 7));
+    ASSERT_EQUAL_INT(3, qio_reader_gets(reader, line, 4, 1000));
+    ASSERT_EQUAL_STR("abc", line);
+    ASSERT_EQUAL_INT(4, qio_reader_gets(reader, line, sizeof(line), 1000));
+    ASSERT_EQUAL_STR("def", line);
+
+    qio_reader_free(reader);
+    close(sv[0]);
+    close(sv[1]);
+}
+
+TEST("Test qio_reader_read() smaller and larger than the buffer") {
+    int sv[2];
+    ASSERT_EQUAL_INT(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+    qio_reader_t *reader = qio_reader(sv[0], 16);
+    ASSERT_NOT_NULL(reader);
+
+    char data[100];
+    int i;
+    for (i = 0; i < (int) sizeof(data); i++) {
+        data[i] = (char) i;
+    }
+    ASSERT_EQUAL_INT(100, write(sv[1], data, 100));
+
+    // buffered, then what's buffered and the rest straight
+    char buf[100];
+    ASSERT_EQUAL_INT(5, qio_reader_read(reader, buf, 5, 1000));
+    ASSERT_EQUAL_MEM(data, buf, 5);
+    ASSERT_TRUE(qio_reader_pending(reader) > 0);
+    ASSERT_EQUAL_INT(85, qio_reader_read(reader, buf + 5, 85, 1000));
+    ASSERT_EQUAL_MEM(data, buf, 90);
+    ASSERT_EQUAL_INT(0, qio_reader_pending(reader));
+
+    // thrown out
+    ASSERT_EQUAL_INT(7, qio_reader_read(reader, NULL, 7, 1000));
+    ASSERT_EQUAL_INT(3, qio_reader_read(reader, buf, 3, 1000));
+    ASSERT_EQUAL_MEM(data + 97, buf, 3);
+
+    qio_reader_free(reader);
+    close(sv[0]);
+    close(sv[1]);
+}
+
+TEST("Test qio_reader_take() in place") {
+    int sv[2];
+    ASSERT_EQUAL_INT(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+    qio_reader_t *reader = qio_reader(sv[0], 8);
+    ASSERT_NOT_NULL(reader);
+
+    ASSERT_EQUAL_INT(12, write(sv[1], "abcdefghijkl", 12));
+    const void *data;
+    ASSERT_EQUAL_INT(3, qio_reader_take(reader, &data, 3, 1000));
+    ASSERT_EQUAL_MEM("abc", data, 3);
+    ASSERT_EQUAL_INT(5, qio_reader_pending(reader));
+
+    // no more than buffered, then one read for the rest
+    ASSERT_EQUAL_INT(5, qio_reader_take(reader, &data, 100, 1000));
+    ASSERT_EQUAL_MEM("defgh", data, 5);
+    ASSERT_EQUAL_INT(4, qio_reader_take(reader, &data, 100, 1000));
+    ASSERT_EQUAL_MEM("ijkl", data, 4);
+    ASSERT_EQUAL_INT(0, qio_reader_take(reader, &data, 0, 1000));
+
+    qio_reader_free(reader);
+    close(sv[0]);
+    close(sv[1]);
+}
+
+TEST("Test qio_reader_fill() and qio_reader_hasline()") {
+    int sv[2];
+    ASSERT_EQUAL_INT(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+    qio_reader_t *reader = qio_reader(sv[0], 8);
+    ASSERT_NOT_NULL(reader);
+    ASSERT_FALSE(qio_reader_hasline(reader));
+
+    char line[16];
+    ASSERT_EQUAL_INT(2, write(sv[1], "ab", 2));
+    ASSERT_EQUAL_INT(2, qio_reader_fill(reader, 1000));
+    ASSERT_FALSE(qio_reader_hasline(reader));
+    ASSERT_EQUAL_INT(3, write(sv[1], "c\nd", 3));
+    ASSERT_EQUAL_INT(3, qio_reader_fill(reader, 1000));
+    ASSERT_TRUE(qio_reader_hasline(reader));
+    ASSERT_EQUAL_INT(4, qio_reader_gets(reader, line, sizeof(line), 0));
+    ASSERT_EQUAL_STR("abc", line);
+    ASSERT_EQUAL_INT(1, qio_reader_pending(reader));
+    ASSERT_FALSE(qio_reader_hasline(reader));
+
+    // a full buffer counts as a line, it can't take more anyway
+    ASSERT_EQUAL_INT(10, write(sv[1], "efghijklmn", 10));
+    ASSERT_EQUAL_INT(7, qio_reader_fill(reader, 1000));
+    ASSERT_TRUE(qio_reader_hasline(reader));
+    ASSERT_EQUAL_INT(-1, qio_reader_fill(reader, 1000));
+    ASSERT_EQUAL_INT(ENOBUFS, errno);
+    ASSERT_EQUAL_INT(7, qio_reader_gets(reader, line, sizeof(line) - 8, 0));
+    ASSERT_EQUAL_STR("defghij", line);
+
+    // discarded on reset, a line without the end comes out on timeout
+    qio_reader_reset(reader, sv[0]);
+    ASSERT_EQUAL_INT(0, qio_reader_pending(reader));
+    ASSERT_EQUAL_INT(3, qio_reader_gets(reader, line, sizeof(line), 10));
+    ASSERT_EQUAL_STR("lmn", line);
+
+    qio_reader_free(reader);
+    close(sv[0]);
+    close(sv[1]);
+}
+
+TEST("Test qio_reader at timeout and end of file") {
+    int sv[2];
+    ASSERT_EQUAL_INT(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+    qio_reader_t *reader = qio_reader(sv[0], 8);
+    ASSERT_NOT_NULL(reader);
+
+    char buf[16];
+    const void *data;
+    ASSERT_EQUAL_INT(0, qio_reader_read(reader, buf, sizeof(buf), 10));
+    ASSERT_EQUAL_INT(ETIMEDOUT, errno);
+    ASSERT_EQUAL_INT(0, qio_reader_gets(reader, buf, sizeof(buf), 10));
+    ASSERT_EQUAL_INT(0, qio_reader_take(reader, &data, sizeof(buf), 10));
+    ASSERT_EQUAL_INT(-1, qio_reader_fill(reader, 10));
+    ASSERT_EQUAL_INT(ETIMEDOUT, errno);
+
+    // partial data before the end, then the end not taken for a timeout
+    ASSERT_EQUAL_INT(2, write(sv[1], "xy", 2));
+    close(sv[1]);
+    ASSERT_EQUAL_INT(2, qio_reader_read(reader, buf, sizeof(buf), 1000));
+    errno = ETIMEDOUT;
+    ASSERT_EQUAL_INT(-1, qio_reader_read(reader, buf, 4, 1000));
+    errno = ETIMEDOUT;
+    ASSERT_EQUAL_INT(-1, qio_reader_read(reader, buf, sizeof(buf), 1000));
+    errno = ETIMEDOUT;
+    ASSERT_EQUAL_INT(-1, qio_reader_gets(reader, buf, sizeof(buf), 1000));
+    ASSERT_EQUAL_INT(0, qio_reader_take(reader, &data, sizeof(buf), 1000));
+    ASSERT_EQUAL_INT(0, qio_reader_fill(reader, 1000));
+
+    qio_reader_free(reader);
+    close(sv[0]);
+}
+
+QUNIT_END();
@@ -0,0 +1,219 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include "qunit.h"
+#include "qlibc.h"
+
+// result of a completion
+struct done {
+    int calls;
+    int result;
+};
+
+static void _on_done(qiouring_t *ring, int result, void *userdata) {
+    struct done *done = (struct done *) userdata;
+    done->calls++;
+    done->result = result;
+}
+
+static void _on_count(qiouring_t *ring, int result, void *userdata) {
+    int *count = (int *) userdata;
+    if (result == 1)
+        (*count)++;
+}
+
+static int _tmpfile(void) {
+    char path[] = "/tmp/test_qiouring_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd >= 0)
+        unlink(path);
+    return fd;
+}
+
+QUNIT_START("Test qiouring.c");
+
+// io_uring can be missing, or disabled by the sysctl or a seccomp filter
+qiouring_t *probe = qiouring(1);
+int probeerrno = errno;
+qiouring_free(probe);
+
+if (probe == NULL) {
+    TEST("Test qiouring() where io_uring is not available") {
+        PRINT(" skipped");
+        ASSERT_TRUE(probeerrno == ENOTSUP || probeerrno == EPERM);
+    }
+} else {
+    TEST("Test qiouring_read() and qiouring_write()") {
+        qiouring_t *ring = qiouring(8);
+        ASSERT_NOT_NULL(ring);
+        int fd = _tmpfile();
+        ASSERT_TRUE(fd >= 0);
+
+        struct done wr, rd;
+        memset(&wr, 0, sizeof(wr));
+        memset(&rd, 0, sizeof(rd));
+        ASSERT_TRUE(qiouring_write(ring, fd, "hello world", 11, 0, _on_done,
+                                   &wr));
+        ASSERT_EQUAL_INT(1, qiouring_inflight(ring));
+        ASSERT_EQUAL_INT(1, qiouring_wait(ring, 1));
+        ASSERT_EQUAL_INT(1, wr.calls);
+        ASSERT_EQUAL_INT(11, wr.result);
+
+        char buf[16] = { 0 };
+        ASSERT_TRUE(qiouring_read(ring, fd, buf, 5, 6, _on_done, &rd));
+        ASSERT_EQUAL_INT(1, qiouring_wait(ring, 1));
+        ASSERT_EQUAL_INT(5, rd.result);
+        ASSERT_EQUAL_STR("world", buf);
+        ASSERT_EQUAL_INT(0, qiouring_inflight(ring));
+
+        // at the current position, past the end
+        memset(buf, 0, sizeof(buf));
+        ASSERT_EQUAL_INT(0, lseek(fd, 0, SEEK_SET));
+        ASSERT_TRUE(qiouring_read(ring, fd, buf, 5, -1, _on_done, &rd));
+        ASSERT_TRUE(qiouring_read(ring, fd, buf + 5, 16, 100, NULL, NULL));
+        ASSERT_EQUAL_INT(2, qiouring_wait(ring, 2));
+        ASSERT_EQUAL_INT(5, rd.result);
+        ASSERT_EQUAL_STR("hello", buf);
+        ASSERT_EQUAL_INT(5, lseek(fd, 0, SEEK_CUR));
+
+        // errors come as negative errno
+        ASSERT_TRUE(qiouring_read(ring, -1, buf, 1, 0, _on_done, &rd));
+        ASSERT_EQUAL_INT(1, qiouring_wait(ring, 1));
+        ASSERT_EQUAL_INT(-EBADF, rd.result);
+
+        close(fd);
+        qiouring_free(ring);
+    }
+
+    TEST("Test registered buffers") {
+        qiouring_t *ring = qiouring(8);
+        ASSERT_NOT_NULL(ring);
+        int fd = _tmpfile();
+        ASSERT_TRUE(fd >= 0);
+
+        static char bufs[2][4096];
+        struct iovec iov[2];
+        iov[0].iov_base = bufs[0];
+        iov[0].iov_len = sizeof(bufs[0]);
+        iov[1].iov_base = bufs[1];
+        iov[1].iov_len = sizeof(bufs[1]);
+        ASSERT_TRUE(qiouring_register_buffers(ring, iov, 2));
+
+        memset(bufs[0], 'f', sizeof(bufs[0]));
+        struct done wr, rd;
+        memset(&wr, 0, sizeof(wr));
+        memset(&rd, 0, sizeof(rd));
+        ASSERT_TRUE(qiouring_write_fixed(ring, fd, bufs[0], 4096, 0, 0,
+                                         _on_done, &wr));
+        ASSERT_EQUAL_INT(1, qiouring_wait(ring, 1));
+        ASSERT_EQUAL_INT(4096, wr.result);
+
+        // a part of a buffer, and no registering while in flight
+        ASSERT_TRUE(qiouring_read_fixed(ring, fd, bufs[1] + 100, 1000, 10, 1,
+                                        _on_done, &rd));
+        ASSERT_FALSE(qiouring_register_buffers(ring, iov, 1));
+        ASSERT_EQUAL_INT(EBUSY, errno);
+        ASSERT_EQUAL_INT(1, qiouring_wait(ring, 1));
+        ASSERT_EQUAL_INT(1000, rd.result);
+        ASSERT_EQUAL_MEM(bufs[0], bufs[1] + 100, 1000);
+        ASSERT_EQUAL_INT(0, bufs[1][99]);
+
+        ASSERT_TRUE(qiouring_register_buffers(ring, NULL, 0));
+        close(fd);
+        qiouring_free(ring);
+    }
+
+    TEST("Test qiouring_send() and qiouring_recv()") {
+        qiouring_t *ring = qiouring(8);
+        ASSERT_NOT_NULL(ring);
+        int sv[2];
+        ASSERT_EQUAL_INT(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+
+        // the receive waits in the kernel for the send
+        char buf[16] = { 0 };
+        struct done rv, sd;
+        memset(&rv, 0, sizeof(rv));
+        memset(&sd, 0, sizeof(sd));
+        ASSERT_TRUE(qiouring_recv(ring, sv[0], buf, sizeof(buf), 0, _on_done,
+                                  &rv));
+        ASSERT_EQUAL_INT(1, qiouring_submit(ring));
+        ASSERT_EQUAL_INT(0, qiouring_wait(ring, 0));
+        ASSERT_EQUAL_INT(0, rv.calls);
+        ASSERT_TRUE(qiouring_send(ring, sv[1], "ping", 4, 0, _on_done, &sd));
+        ASSERT_EQUAL_INT(2, qiouring_wait(ring, 2));
+        ASSERT_EQUAL_INT(4, sd.result);
+        ASSERT_EQUAL_INT(4, rv.result);
+        ASSERT_EQUAL_STR("ping", buf);
+
+        // end of stream
+        close(sv[1]);
+        ASSERT_TRUE(qiouring_recv(ring, sv[0], buf, sizeof(buf), 0, _on_done,
+                                  &rv));
+        ASSERT_EQUAL_INT(1, qiouring_wait(ring, 1));
+        ASSERT_EQUAL_INT(0, rv.result);
+
+        close(sv[0]);
+        qiouring_free(ring);
+    }
+
+    TEST("Test queueing more operations than the ring holds") {
+        qiouring_t *ring = qiouring(4);
+        ASSERT_NOT_NULL(ring);
+        int fd = _tmpfile();
+        ASSERT_TRUE(fd >= 0);
+
+        // filled queues get submitted and reaped on the way
+        const char *data = "abcdefghijklmnopqrstuvwxyz0123456789ABCDEFGHIJKLMN";
+        int count = 0;
+        int i;
+        for (i = 0; i < 50; i++) {
+            ASSERT_TRUE(qiouring_write(ring, fd, data + i, 1, i, _on_count,
+                                       &count));
+            ASSERT_TRUE(qiouring_inflight(ring) <= 8);
+        }
+        qiouring_wait(ring, qiouring_inflight(ring));
+        ASSERT_EQUAL_INT(0, qiouring_inflight(ring));
+        ASSERT_EQUAL_INT(50, count);
+
+        char buf[64] = { 0 };
+        ASSERT_EQUAL_INT(50, pread(fd, buf, sizeof(buf), 0));
+        ASSERT_EQUAL_STR(data, buf);
+
+        close(fd);
+        qiouring_free(ring);
+    }
+}
+
+QUNIT_END();
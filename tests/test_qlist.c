@@ -30,10 +30,13 @@
  * Copyright (c) 2015 Zhenjiang Xie - https://github.com/Charles0429
  *****************************************************************************/
 
+#include <errno.h>
 #include "qunit.h"
 #include "qlibc.h"
 
 void test_thousands_of_values(int num_values, char *prefix, char *postfix);
+static int cmp_first_char(const void *data1, size_t size1, const void *data2,
+                          size_t size2);
 
 QUNIT_START("Test qlist.c");
 
@@ -204,6 +207,216 @@ TEST("Test thousands of values: with prefix and postfix") {
             "1a087a6982371bbfc9d4e14ae    76e05ddd784a5d9c6b0fc9e6cd715baab66b90987b2ee054764e58fc04e449dfa060a68398601b64cf470cb6f0a260ec6539866");
 }
 
+TEST("Test node pool") {
+    qlist_t *list = qlist(0);
+    size_t hits, misses;
+    int i;
+    char buf[4096];
+    memset(buf, 'x', sizeof(buf));
+
+    for (i = 0; i < 32; i++) {
+        ASSERT_TRUE(list->addlast(list, buf, (i % 8) + 1));
+    }
+    ASSERT_EQUAL_INT(0, list->poolstat(list, &hits, &misses));
+    ASSERT_EQUAL_INT(0, hits);
+    ASSERT_EQUAL_INT(32, misses);
+
+    // steady state push and pop is served by the pool
+    for (i = 0; i < 1000; i++) {
+        ASSERT_TRUE(list->removefirst(list));
+        ASSERT_TRUE(list->addlast(list, buf, (i % 16) + 1));
+    }
+    list->poolstat(list, &hits, &misses);
+    ASSERT_EQUAL_INT(1000, hits);
+    ASSERT_EQUAL_INT(32, misses);
+    for (i = 0; i < 32; i++) {
+        size_t size;
+        char *data = list->getat(list, i, &size, false);
+        ASSERT_EQUAL_MEM(buf, data, size);
+    }
+
+    // too big to be recycled
+    ASSERT_TRUE(list->addlast(list, buf, sizeof(buf)));
+    ASSERT_TRUE(list->removelast(list));
+    ASSERT_EQUAL_INT(0, list->poolstat(list, NULL, NULL));
+
+    list->clear(list);
+    ASSERT_EQUAL_INT(32, list->poolstat(list, NULL, NULL));
+    ASSERT_EQUAL_INT(64, list->setpool(list, 10));
+    ASSERT_EQUAL_INT(10, list->poolstat(list, NULL, NULL));
+    list->setpool(list, 0);
+    ASSERT_EQUAL_INT(0, list->poolstat(list, NULL, NULL));
+    ASSERT_TRUE(list->addlast(list, buf, 10));
+    ASSERT_TRUE(list->removelast(list));
+    ASSERT_EQUAL_INT(0, list->poolstat(list, NULL, NULL));
+
+    list->free(list);
+}
+
+TEST("Test indexed access cache") {
+    qlist_t *list = qlist(0);
+    int i, n = 1000;
+    for (i = 0; i < n; i++) {
+        ASSERT_TRUE(list->addlast(list, &i, sizeof(int)));
+    }
+
+    // sequential access in both directions
+    for (i = 0; i < n; i++) {
+        ASSERT_EQUAL_INT(i, *(int *) list->getat(list, i, NULL, false));
+    }
+    for (i = n - 1; i >= 0; i--) {
+        ASSERT_EQUAL_INT(i, *(int *) list->getat(list, i, NULL, false));
+    }
+
+    // the cursor follows insertions and removals: remove every odd value
+    for (i = 1; i < list->size(list); i++) {
+        ASSERT_EQUAL_INT(i * 2 - 1, *(int *) list->getat(list, i, NULL, false));
+        ASSERT_TRUE(list->removeat(list, i));
+    }
+    ASSERT_EQUAL_INT(n / 2, list->size(list));
+    for (i = 0; i < n / 2; i++) {
+        ASSERT_EQUAL_INT(i * 2, *(int *) list->getat(list, i, NULL, false));
+    }
+
+    // put them back in front of the cursor
+    for (i = 1; i < n; i += 2) {
+        ASSERT_EQUAL_INT(i - 1, *(int *) list->getat(list, i - 1, NULL, false));
+        ASSERT_TRUE(list->addat(list, i, &i, sizeof(int)));
+    }
+    for (i = 0; i < n; i++) {
+        ASSERT_EQUAL_INT(i, *(int *) list->getat(list, i, NULL, false));
+    }
+
+    // removals at both ends, negative index and reverse
+    ASSERT_TRUE(list->removelast(list));
+    ASSERT_TRUE(list->removefirst(list));
+    ASSERT_EQUAL_INT(n - 2, *(int *) list->getat(list, -1, NULL, false));
+    ASSERT_EQUAL_INT(1, *(int *) list->getat(list, 0, NULL, false));
+    list->reverse(list);
+    ASSERT_EQUAL_INT(1, *(int *) list->getat(list, -1, NULL, false));
+    for (i = 0; i < n - 2; i++) {
+        ASSERT_EQUAL_INT(n - 2 - i, *(int *) list->getat(list, i, NULL, false));
+    }
+
+    list->clear(list);
+    ASSERT_NULL(list->getat(list, 0, NULL, false));
+    ASSERT_TRUE(list->addlast(list, &n, sizeof(int)));
+    ASSERT_EQUAL_INT(n, *(int *) list->getat(list, 0, NULL, false));
+
+    list->free(list);
+}
+
+TEST("Test splice(), concat() and moveto()") {
+    qlist_t *list = qlist(0);
+    qlist_t *src = qlist(0);
+    char *str;
+
+    list->addlast(list, "A", 2);
+    list->addlast(list, "B", 2);
+    src->addlast(src, "X", 2);
+    src->addlast(src, "Y", 2);
+    const void *xdata = src->getfirst(src, NULL, false);
+
+    ASSERT_FALSE(list->splice(list, 3, src));
+    ASSERT_EQUAL_INT(ERANGE, errno);
+    ASSERT_FALSE(list->splice(list, 0, list));
+    ASSERT_EQUAL_INT(EINVAL, errno);
+
+    // nodes are relinked, not copied
+    ASSERT_TRUE(list->splice(list, 1, src));
+    ASSERT_EQUAL_STR("AXYB", (str = list->tostring(list)));
+    free(str);
+    ASSERT_TRUE(xdata == list->getat(list, 1, NULL, false));
+    ASSERT_EQUAL_INT(4, list->size(list));
+    ASSERT_EQUAL_INT(8, list->datasize(list));
+    ASSERT_EQUAL_INT(0, src->size(src));
+    ASSERT_EQUAL_INT(0, src->datasize(src));
+    ASSERT_NULL(src->getfirst(src, NULL, false));
+
+    // splicing an empty list is a no-op, concat to the end
+    ASSERT_TRUE(list->splice(list, 0, src));
+    src->addlast(src, "Z", 2);
+    ASSERT_TRUE(list->concat(list, src));
+    ASSERT_EQUAL_STR("AXYBZ", (str = list->tostring(list)));
+    free(str);
+    ASSERT_EQUAL_STR("Z", list->getlast(list, NULL, false));
+
+    // move a range out and back
+    ASSERT_FALSE(list->moveto(list, 3, 3, src));
+    ASSERT_EQUAL_INT(ERANGE, errno);
+    ASSERT_TRUE(list->moveto(list, 1, 2, src));
+    ASSERT_EQUAL_STR("ABZ", (str = list->tostring(list)));
+    free(str);
+    ASSERT_EQUAL_STR("XY", (str = src->tostring(src)));
+    free(str);
+    ASSERT_EQUAL_INT(6, list->datasize(list));
+    ASSERT_EQUAL_INT(4, src->datasize(src));
+    ASSERT_TRUE(list->moveto(list, -1, 1, src));
+    ASSERT_EQUAL_STR("XYZ", (str = src->tostring(src)));
+    free(str);
+    ASSERT_TRUE(list->moveto(list, 0, 2, src));
+    ASSERT_EQUAL_INT(0, list->size(list));
+    ASSERT_NULL(list->getlast(list, NULL, false));
+    ASSERT_TRUE(src->moveto(src, 0, 5, list));
+    ASSERT_EQUAL_STR("XYZAB", (str = list->tostring(list)));
+    free(str);
+    ASSERT_EQUAL_STR("B", list->getlast(list, NULL, false));
+
+    // maximum number of elements
+    src->setsize(src, 2);
+    ASSERT_FALSE(list->moveto(list, 0, 3, src));
+    ASSERT_EQUAL_INT(ENOBUFS, errno);
+
+    list->free(list);
+    src->free(src);
+}
+
+TEST("Test sort()") {
+    qlist_t *list = qlist(0);
+    char *str;
+
+    list->sort(list, cmp_first_char);
+    ASSERT_EQUAL_INT(0, list->size(list));
+    list->addlast(list, "c", 1);
+    list->sort(list, cmp_first_char);
+    ASSERT_EQUAL_MEM("c", list->getfirst(list, NULL, false), 1);
+
+    // stable: the digits keep the order of insertion
+    const char *input[] = { "c1", "a1", "b1", "a2", "c2", "b2", "a3" };
+    int i;
+    for (i = 0; i < sizeof(input) / sizeof(char *); i++) {
+        list->addlast(list, input[i], 2);
+    }
+    list->sort(list, cmp_first_char);
+    ASSERT_EQUAL_STR("a1a2a3b1b2cc1c2", (str = list->tostring(list)));
+    free(str);
+    ASSERT_EQUAL_INT(8, list->size(list));
+
+    // links in both directions are rebuilt
+    list->reverse(list);
+    ASSERT_EQUAL_STR("c2c1cb2b1a3a2a1", (str = list->tostring(list)));
+    free(str);
+    ASSERT_EQUAL_MEM("a1", list->getlast(list, NULL, false), 2);
+
+    // larger list
+    list->clear(list);
+    for (i = 0; i < 1000; i++) {
+        char c = 'a' + (i * 7919) % 26;
+        list->addlast(list, &c, 1);
+    }
+    list->sort(list, cmp_first_char);
+    char prev = 'a';
+    qlist_obj_t obj;
+    memset((void *) &obj, 0, sizeof(obj));
+    while (list->getnext(list, &obj, false)) {
+        ASSERT_TRUE(prev <= *(char *) obj.data);
+        prev = *(char *) obj.data;
+    }
+    ASSERT_EQUAL_INT(1000, list->size(list));
+
+    list->free(list);
+}
+
 QUNIT_END();
 
 void test_thousands_of_values(int num_values, char *prefix, char *postfix) {
@@ -289,3 +502,8 @@ void test_thousands_of_values(int num_values, char *prefix, char *postfix) {
     list->clear(list);
     list->free(list);
 }
+
+static int cmp_first_char(const void *data1, size_t size1, const void *data2,
+                          size_t size2) {
+    return *(const char *) data1 - *(const char *) data2;
+}
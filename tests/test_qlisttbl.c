@@ -0,0 +1,284 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "qunit.h"
+#include "qlibc.h"
+
+// joins the elements as "name=data," from the top to the bottom
+static char *join(qlisttbl_t *tbl, char *buf, size_t bufsize) {
+    qlisttbl_obj_t obj;
+    size_t len = 0;
+    buf[0] = '\0';
+    memset((void *)&obj, 0, sizeof(obj));
+    while (tbl->getnext(tbl, &obj, NULL, false) == true && len < bufsize) {
+        len += snprintf(buf + len, bufsize - len, "%s=%s,",
+                        obj.name, (char *)obj.data);
+    }
+    return buf;
+}
+
+static int cmp_data(const qlisttbl_obj_t *obj1, const qlisttbl_obj_t *obj2) {
+    return strcmp((char *)obj1->data, (char *)obj2->data);
+}
+
+QUNIT_START("Test qlisttbl.c");
+
+TEST("Test sort() keeps the order of duplicated keys") {
+    char buf[256];
+    qlisttbl_t *tbl = qlisttbl(QLISTTBL_LOOKUPFORWARD);
+    tbl->putstr(tbl, "d", "1");
+    tbl->putstr(tbl, "a", "2");
+    tbl->putstr(tbl, "b", "3");
+    tbl->putstr(tbl, "b", "4");
+    tbl->putstr(tbl, "c", "5");
+    tbl->putstr(tbl, "b", "6");
+    tbl->sort(tbl);
+    ASSERT_EQUAL_STR("a=2,b=3,b=4,b=6,c=5,d=1,", join(tbl, buf, sizeof(buf)));
+    ASSERT_EQUAL_INT(6, tbl->size(tbl));
+
+    // sorting a sorted table changes nothing
+    tbl->sort(tbl);
+    ASSERT_EQUAL_STR("a=2,b=3,b=4,b=6,c=5,d=1,", join(tbl, buf, sizeof(buf)));
+    tbl->free(tbl);
+}
+
+TEST("Test sort() on a large table with few distinct keys") {
+    qlisttbl_t *tbl = qlisttbl(QLISTTBL_LOOKUPFORWARD);
+    int i;
+    for (i = 0; i < 10000; i++) {
+        char name[8];
+        snprintf(name, sizeof(name), "k%d", (i * 7) % 10);
+        tbl->putint(tbl, name, i);
+    }
+    tbl->sort(tbl);
+    ASSERT_EQUAL_INT(10000, tbl->size(tbl));
+
+    // keys ascend and the values of the same key keep ascending
+    qlisttbl_obj_t obj, prev;
+    int64_t prevval = -1;
+    int unordered = 0;
+    memset((void *)&obj, 0, sizeof(obj));
+    memset((void *)&prev, 0, sizeof(prev));
+    while (tbl->getnext(tbl, &obj, NULL, false) == true) {
+        int64_t val = atoll((char *)obj.data);
+        if (prev.name != NULL) {
+            int cmp = strcmp(prev.name, obj.name);
+            if (cmp > 0 || (cmp == 0 && prevval >= val)) unordered++;
+        }
+        prev = obj;
+        prevval = val;
+    }
+    ASSERT_EQUAL_INT(0, unordered);
+    tbl->free(tbl);
+}
+
+TEST("Test sort_by() is stable") {
+    char buf[256];
+    qlisttbl_t *tbl = qlisttbl(QLISTTBL_LOOKUPFORWARD);
+    tbl->putstr(tbl, "e", "y");
+    tbl->putstr(tbl, "a", "x");
+    tbl->putstr(tbl, "d", "y");
+    tbl->putstr(tbl, "b", "x");
+    tbl->putstr(tbl, "c", "x");
+    tbl->sort_by(tbl, cmp_data);
+    ASSERT_EQUAL_STR("a=x,b=x,c=x,e=y,d=y,", join(tbl, buf, sizeof(buf)));
+
+    // a NULL comparator leaves the table as it is
+    tbl->sort_by(tbl, NULL);
+    ASSERT_EQUAL_STR("a=x,b=x,c=x,e=y,d=y,", join(tbl, buf, sizeof(buf)));
+    tbl->free(tbl);
+}
+
+TEST("Test hash index lookups with duplicated keys") {
+    qlisttbl_t *tbl = qlisttbl(QLISTTBL_HASHINDEX);
+    tbl->putstr(tbl, "key", "first");
+    tbl->putstr(tbl, "other", "value");
+    tbl->putstr(tbl, "key", "last");
+
+    // the lookup is backward by default, so the last one wins
+    ASSERT_EQUAL_STR("last", tbl->getstr(tbl, "key", false));
+    ASSERT_NULL(tbl->getstr(tbl, "KEY", false));
+
+    size_t num = 0;
+    qlisttbl_data_t *objs = tbl->getmulti(tbl, "key", false, &num);
+    ASSERT_EQUAL_INT(2, num);
+    tbl->freemulti(objs);
+
+    ASSERT_EQUAL_INT(2, tbl->remove(tbl, "key"));
+    ASSERT_NULL(tbl->getstr(tbl, "key", false));
+    ASSERT_EQUAL_STR("value", tbl->getstr(tbl, "other", false));
+    ASSERT_EQUAL_INT(1, tbl->size(tbl));
+    tbl->free(tbl);
+
+    tbl = qlisttbl(QLISTTBL_HASHINDEX | QLISTTBL_LOOKUPFORWARD);
+    tbl->putstr(tbl, "key", "first");
+    tbl->putstr(tbl, "key", "last");
+    ASSERT_EQUAL_STR("first", tbl->getstr(tbl, "key", false));
+    tbl->free(tbl);
+}
+
+TEST("Test hash index with case insensitive keys") {
+    qlisttbl_t *tbl = qlisttbl(QLISTTBL_HASHINDEX | QLISTTBL_CASEINSENSITIVE
+                               | QLISTTBL_UNIQUE);
+    tbl->putstr(tbl, "Content-Type", "text/plain");
+    tbl->putstr(tbl, "CONTENT-TYPE", "text/html");
+    ASSERT_EQUAL_INT(1, tbl->size(tbl));
+    ASSERT_EQUAL_STR("text/html", tbl->getstr(tbl, "content-type", false));
+
+    ASSERT_EQUAL_INT(1, tbl->remove(tbl, "Content-type"));
+    ASSERT_NULL(tbl->getstr(tbl, "Content-Type", false));
+    ASSERT_EQUAL_INT(0, tbl->size(tbl));
+    tbl->free(tbl);
+}
+
+TEST("Test hash index growth") {
+    qlisttbl_t *tbl = qlisttbl(QLISTTBL_HASHINDEX | QLISTTBL_UNIQUE);
+    qstats_t stats;
+    ASSERT_TRUE(tbl->stats(tbl, &stats));
+    size_t initslots = stats.slots;
+    ASSERT_TRUE(initslots > 0);
+
+    int i;
+    for (i = 0; i < 10000; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "key%d", i);
+        tbl->putint(tbl, name, i);
+    }
+    ASSERT_TRUE(tbl->stats(tbl, &stats));
+    ASSERT_EQUAL_INT(10000, stats.num);
+    ASSERT_TRUE(stats.slots >= 10000);
+    ASSERT_TRUE(stats.resizes > 0);
+
+    // every key survives the resizes and the removal of the others
+    int missing = 0;
+    for (i = 0; i < 10000; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "key%d", i);
+        if (tbl->getint(tbl, name) != i) missing++;
+        if (i % 2 == 0 && tbl->remove(tbl, name) != 1) missing++;
+    }
+    ASSERT_EQUAL_INT(0, missing);
+    ASSERT_EQUAL_INT(5000, tbl->size(tbl));
+    for (i = 0; i < 10000; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "key%d", i);
+        bool found = (tbl->getstr(tbl, name, false) != NULL);
+        if (found != (i % 2 == 1)) missing++;
+    }
+    ASSERT_EQUAL_INT(0, missing);
+
+    // the index follows the relinked elements after a sort
+    tbl->sort(tbl);
+    ASSERT_EQUAL_INT(9999, tbl->getint(tbl, "key9999"));
+    ASSERT_EQUAL_INT(1, tbl->remove(tbl, "key1"));
+    ASSERT_NULL(tbl->getstr(tbl, "key1", false));
+    tbl->free(tbl);
+}
+
+TEST("Test save() and load() round trip") {
+    char buf[256], buf2[256];
+    char path[] = "/tmp/test_qlisttbl_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_TRUE(fd >= 0);
+    close(fd);
+
+    qlisttbl_t *tbl = qlisttbl(QLISTTBL_LOOKUPFORWARD);
+    tbl->putstr(tbl, "name", "value");
+    tbl->putstr(tbl, "dup", "1");
+    tbl->putstr(tbl, "dup", "2");
+    tbl->putstr(tbl, "empty", "");
+    tbl->putstr(tbl, "multi", "line1\nline2=x");
+    ASSERT_TRUE(tbl->save(tbl, path, '=', true));
+
+    qlisttbl_t *tbl2 = qlisttbl(QLISTTBL_LOOKUPFORWARD);
+    ASSERT_EQUAL_INT(5, tbl2->load(tbl2, path, '=', true));
+    ASSERT_EQUAL_STR(join(tbl, buf, sizeof(buf)), join(tbl2, buf2, sizeof(buf2)));
+    ASSERT_EQUAL_STR("line1\nline2=x", tbl2->getstr(tbl2, "multi", false));
+
+    // load() appends and counts only the entries it loaded
+    ASSERT_EQUAL_INT(5, tbl2->load(tbl2, path, '=', true));
+    ASSERT_EQUAL_INT(10, tbl2->size(tbl2));
+    tbl2->free(tbl2);
+    tbl->free(tbl);
+
+    // blank and comment lines are not entries
+    const char *text = "# comment\n\n  a = 1 \nb=2";
+    ASSERT_TRUE(qfile_save(path, text, strlen(text), false) == (ssize_t)strlen(text));
+    tbl = qlisttbl(QLISTTBL_LOOKUPFORWARD);
+    ASSERT_EQUAL_INT(2, tbl->load(tbl, path, '=', false));
+    ASSERT_EQUAL_STR("a=1,b=2,", join(tbl, buf, sizeof(buf)));
+    tbl->free(tbl);
+
+    unlink(path);
+}
+
+TEST("Test save() and load() beyond the write buffer") {
+    char path[] = "/tmp/test_qlisttbl_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_TRUE(fd >= 0);
+    close(fd);
+
+    // about 1MB of lines to cross the write buffer many times
+    char value[100];
+    memset(value, 'v', sizeof(value) - 1);
+    value[sizeof(value) - 1] = '\0';
+    qlisttbl_t *tbl = qlisttbl(QLISTTBL_HASHINDEX | QLISTTBL_UNIQUE);
+    int i;
+    for (i = 0; i < 10000; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "key%d", i);
+        tbl->putstrf(tbl, name, "%d%s", i, value);
+    }
+    ASSERT_TRUE(tbl->save(tbl, path, '=', false));
+
+    qlisttbl_t *tbl2 = qlisttbl(QLISTTBL_HASHINDEX | QLISTTBL_UNIQUE);
+    ASSERT_EQUAL_INT(10000, tbl2->load(tbl2, path, '=', false));
+    int mismatch = 0;
+    for (i = 0; i < 10000; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "key%d", i);
+        char *v1 = tbl->getstr(tbl, name, false);
+        char *v2 = tbl2->getstr(tbl2, name, false);
+        if (v1 == NULL || v2 == NULL || strcmp(v1, v2)) mismatch++;
+    }
+    ASSERT_EQUAL_INT(0, mismatch);
+    tbl2->free(tbl2);
+    tbl->free(tbl);
+
+    // a missing file is an error, not an empty load
+    unlink(path);
+    tbl = qlisttbl(0);
+    ASSERT_EQUAL_INT(-1, tbl->load(tbl, path, '=', false));
+    ASSERT_EQUAL_INT(0, tbl->size(tbl));
+    tbl->free(tbl);
+}
+
+QUNIT_END();
@@ -0,0 +1,336 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "qunit.h"
+#include "qlibc.h"
+#include "qlibcext.h"
+#ifdef ENABLE_ZLIB
+#include <zlib.h>
+#endif
+
+static char logdir[] = "/tmp/test_qlog_XXXXXX";
+static char logpath[PATH_MAX];
+
+// loads the log file as a NUL terminated string
+static char *load_log(void) {
+    size_t size = 0;
+    char *data = qfile_load(logpath, &size);
+    unlink(logpath);
+    return data;
+}
+
+#ifdef ENABLE_ZLIB
+// loads a gzip file as a NUL terminated string
+static char *load_gz(const char *path) {
+    gzFile gz = gzopen(path, "rb");
+    if (gz == NULL)
+        return NULL;
+    char *data = (char *) calloc(1, 4096);
+    int n = gzread(gz, data, 4095);
+    gzclose(gz);
+    if (n < 0) {
+        free(data);
+        return NULL;
+    }
+    return data;
+}
+#endif
+
+// waits for the coarse clock to tick
+static time_t next_second(void) {
+    time_t now = qtime_coarse();
+    while (qtime_coarse() == now)
+        usleep(10 * 1000);
+    return qtime_coarse();
+}
+
+#define NUM_THREADS     (4)
+#define NUM_LINES       (5000)
+
+struct writer_s {
+    qlog_t *log;
+    int id;
+    int written;    /* number of writef() calls succeeded */
+};
+
+static void *writer(void *arg) {
+    struct writer_s *w = (struct writer_s *) arg;
+    int i;
+    for (i = 0; i < NUM_LINES; i++) {
+        if (w->log->writef(w->log, "thread %d line %d %s %.2f", w->id, i,
+                           "abc", i / 4.0) == true) {
+            w->written++;
+        }
+    }
+    return NULL;
+}
+
+// verifies the lines of the writer threads against snprintf() and their
+// order in each thread. returns the number of lines or -1 on a bad line,
+// the number of messages reported as dropped is added to dropped.
+static int check_lines(char *data, size_t *dropped) {
+    int next[NUM_THREADS] = { 0 };
+    int lines = 0;
+    char *line, *end;
+    for (line = data; *line != '\0'; line = end + 1) {
+        if ((end = strchr(line, '\n')) == NULL)
+            return -1;
+        *end = '\0';
+
+        size_t n;
+        if (sscanf(line, "qlog: %zu messages dropped", &n) == 1) {
+            *dropped += n;
+            continue;
+        }
+        int id, i;
+        if (sscanf(line, "thread %d line %d", &id, &i) != 2 || id < 0
+                || id >= NUM_THREADS || i < next[id]) {
+            return -1;
+        }
+        char expect[128];
+        snprintf(expect, sizeof(expect), "thread %d line %d %s %.2f", id, i,
+                 "abc", i / 4.0);
+        if (strcmp(expect, line) != 0)
+            return -1;
+        next[id] = i + 1;
+        lines++;
+    }
+    return lines;
+}
+
+QUNIT_START("Test qlog.c");
+
+if (mkdtemp(logdir) == NULL) {
+    perror("mkdtemp");
+    return 1;
+}
+snprintf(logpath, sizeof(logpath), "%s/test.log", logdir);
+
+TEST("writef() in deferred mode with string precisions") {
+    // not terminated within the precision
+    char *buf = malloc(3);
+    memcpy(buf, "abc", 3);
+
+    int options[] = { 0, QLOG_OPT_ASYNC, QLOG_OPT_DEFERRED };
+    int i;
+    for (i = 0; i < sizeof(options) / sizeof(int); i++) {
+        qlog_t *log = qlog(logpath, 0644, 0, options[i]);
+        ASSERT_NOT_NULL(log);
+        ASSERT_TRUE(log->writef(log, "x=%.3s|%5.2s|%-4.1s|%.9s|%s", buf, buf,
+                                buf, "short", "end"));
+        ASSERT_TRUE(log->writef(log, "y=%.0s|%d%%", buf, 100));
+        log->free(log);
+
+        char expect[256];
+        snprintf(expect, sizeof(expect), "x=%.3s|%5.2s|%-4.1s|%.9s|%s\n"
+                 "y=%.0s|%d%%\n", buf, buf, buf, "short", "end", buf, 100);
+        char *data = load_log();
+        ASSERT_NOT_NULL(data);
+        ASSERT_EQUAL_STR(expect, data);
+        free(data);
+    }
+    free(buf);
+}
+
+TEST("writef() from threads in async, deferred and drop modes") {
+    int options[] = { QLOG_OPT_ASYNC, QLOG_OPT_DEFERRED,
+                      QLOG_OPT_ASYNC | QLOG_OPT_DROP,
+                      QLOG_OPT_DEFERRED | QLOG_OPT_DROP };
+    int i;
+    for (i = 0; i < sizeof(options) / sizeof(int); i++) {
+        qlog_t *log = qlog(logpath, 0644, 0, options[i]);
+        ASSERT_NOT_NULL(log);
+
+        pthread_t threads[NUM_THREADS];
+        struct writer_s writers[NUM_THREADS];
+        int j, written = 0;
+        for (j = 0; j < NUM_THREADS; j++) {
+            writers[j].log = log;
+            writers[j].id = j;
+            writers[j].written = 0;
+            ASSERT_EQUAL_INT(0, pthread_create(&threads[j], NULL, writer,
+                                               &writers[j]));
+        }
+        for (j = 0; j < NUM_THREADS; j++) {
+            pthread_join(threads[j], NULL);
+            written += writers[j].written;
+        }
+        log->free(log);
+
+        char *data = load_log();
+        ASSERT_NOT_NULL(data);
+        size_t dropped = 0;
+        ASSERT_EQUAL_INT(written, check_lines(data, &dropped));
+        free(data);
+
+        // every message is either written or counted as dropped
+        if (options[i] & QLOG_OPT_DROP) {
+            ASSERT_EQUAL_INT(NUM_THREADS * NUM_LINES - written, dropped);
+        } else {
+            ASSERT_EQUAL_INT(NUM_THREADS * NUM_LINES, written);
+            ASSERT_EQUAL_INT(0, dropped);
+        }
+    }
+}
+
+TEST("flush() waits for the queued messages") {
+    int options[] = { QLOG_OPT_ASYNC, QLOG_OPT_DEFERRED };
+    int i;
+    for (i = 0; i < sizeof(options) / sizeof(int); i++) {
+        qlog_t *log = qlog(logpath, 0644, 0, options[i]);
+        ASSERT_NOT_NULL(log);
+        int j;
+        for (j = 0; j < 100; j++) {
+            ASSERT_TRUE(log->writef(log, "thread %d line %d %s %.2f", 0, j,
+                                    "abc", j / 4.0));
+        }
+        ASSERT_TRUE(log->flush(log));
+
+        // read it while the log is still open
+        size_t size = 0;
+        char *data = qfile_load(logpath, &size);
+        ASSERT_NOT_NULL(data);
+        size_t dropped = 0;
+        ASSERT_EQUAL_INT(100, check_lines(data, &dropped));
+        free(data);
+
+        log->free(log);
+        unlink(logpath);
+    }
+}
+
+TEST("timestamp() prefixes every line") {
+    const char *tsformat = "[%Y-%m-%d %H:%M:%S] ";
+    char toolong[128];
+    memset(toolong, 'x', sizeof(toolong) - 1);
+    toolong[sizeof(toolong) - 1] = '\0';
+
+    int options[] = { 0, QLOG_OPT_ASYNC, QLOG_OPT_DEFERRED };
+    int i;
+    for (i = 0; i < sizeof(options) / sizeof(int); i++) {
+        qlog_t *log = qlog(logpath, 0644, 0, options[i]);
+        ASSERT_NOT_NULL(log);
+        ASSERT_FALSE(log->timestamp(log, toolong));
+        ASSERT_EQUAL_INT(EINVAL, errno);
+
+        ASSERT_TRUE(log->timestamp(log, tsformat));
+        time_t start = qtime_coarse();
+        ASSERT_TRUE(log->write(log, "hello"));
+        ASSERT_TRUE(log->writef(log, "n=%d", 1));
+        time_t end = qtime_coarse();
+        ASSERT_TRUE(log->timestamp(log, NULL));
+        ASSERT_TRUE(log->write(log, "plain"));
+        log->free(log);
+
+        char *data = load_log();
+        ASSERT_NOT_NULL(data);
+        const char *msgs[] = { "hello", "n=1", "plain\n" };
+        char *line = data;
+        int j;
+        for (j = 0; j < 2; j++) {
+            // rendered at any second while logging
+            char expect[128];
+            time_t t;
+            for (t = start; t <= end; t++) {
+                char prefix[64];
+                qtime_localtime_strf(prefix, sizeof(prefix), t, tsformat);
+                snprintf(expect, sizeof(expect), "%s%s\n", prefix, msgs[j]);
+                if (!strncmp(expect, line, strlen(expect)))
+                    break;
+            }
+            ASSERT_TRUE(t <= end);
+            line += strlen(expect);
+        }
+        ASSERT_EQUAL_STR(msgs[2], line);
+        free(data);
+    }
+}
+
+TEST("rotated files are compressed") {
+    char fmt[PATH_MAX], rotated[PATH_MAX], current[PATH_MAX];
+    snprintf(fmt, sizeof(fmt), "%s/rotate-%%s.log", logdir);
+
+    int options[] = { 0, QLOG_OPT_ASYNC, QLOG_OPT_DEFERRED };
+    int i;
+    for (i = 0; i < sizeof(options) / sizeof(int); i++) {
+        // start early in a second not to rotate before the first message
+        next_second();
+        qlog_t *log = qlog(fmt, 0644, 1, options[i]);
+        ASSERT_NOT_NULL(log);
+        qstrcpy(rotated, sizeof(rotated), log->filepath);
+        ASSERT_FALSE(log->compress(log, 10));
+        ASSERT_EQUAL_INT(EINVAL, errno);
+#ifdef ENABLE_ZLIB
+        ASSERT_TRUE(log->compress(log, 6));
+#else
+        ASSERT_FALSE(log->compress(log, 6));
+        ASSERT_EQUAL_INT(ENOTSUP, errno);
+#endif
+        ASSERT_TRUE(log->write(log, "before rotation"));
+        ASSERT_TRUE(log->flush(log));
+        next_second();
+        ASSERT_TRUE(log->write(log, "after rotation"));
+        ASSERT_TRUE(log->flush(log));
+        qstrcpy(current, sizeof(current), log->filepath);
+        ASSERT_TRUE(strcmp(rotated, current) != 0);
+        log->free(log);
+
+        char *data = qfile_load(current, NULL);
+        ASSERT_NOT_NULL(data);
+        ASSERT_EQUAL_STR("after rotation\n", data);
+        free(data);
+        unlink(current);
+
+#ifdef ENABLE_ZLIB
+        // the queued files are compressed when it's freed
+        ASSERT_FALSE(qfile_exist(rotated));
+        char gzpath[PATH_MAX + 3];
+        snprintf(gzpath, sizeof(gzpath), "%s.gz", rotated);
+        data = load_gz(gzpath);
+        ASSERT_NOT_NULL(data);
+        ASSERT_EQUAL_STR("before rotation\n", data);
+        free(data);
+        unlink(gzpath);
+#else
+        data = qfile_load(rotated, NULL);
+        ASSERT_NOT_NULL(data);
+        ASSERT_EQUAL_STR("before rotation\n", data);
+        free(data);
+        unlink(rotated);
+#endif
+    }
+}
+
+rmdir(logdir);
+
+QUNIT_END();
@@ -0,0 +1,187 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+#include <errno.h>
+#include "qunit.h"
+#include "qlibc.h"
+
+static int cmp_int(const void *data1, const void *data2) {
+    int a = *(const int *) data1, b = *(const int *) data2;
+    return (a < b) ? -1 : (a > b);
+}
+
+static int cmp_int_desc(const void *data1, const void *data2) {
+    return cmp_int(data2, data1);
+}
+
+// pop everything and check it comes out in order.
+static bool drain_sorted(qpqueue_t *pqueue, size_t expected) {
+    size_t n = 0;
+    int prev = 0;
+    int *data;
+    while ((data = pqueue->top(pqueue, false)) != NULL) {
+        if (n > 0 && *data < prev) {
+            return false;
+        }
+        prev = *data;
+        pqueue->removetop(pqueue);
+        n++;
+    }
+    return (n == expected && errno == ENOENT);
+}
+
+QUNIT_START("Test qpqueue.c");
+
+TEST("Test push() / top() / pop()") {
+    ASSERT_TRUE(qpqueue(0, 0, cmp_int, 0) == NULL);
+    ASSERT_EQUAL_INT(EINVAL, errno);
+    ASSERT_TRUE(qpqueue(0, sizeof(int), NULL, 0) == NULL);
+
+    qpqueue_t *pqueue = qpqueue(0, sizeof(int), cmp_int, 0);
+    ASSERT_NOT_NULL(pqueue);
+    ASSERT_TRUE(pqueue->top(pqueue, false) == NULL);
+    ASSERT_EQUAL_INT(ENOENT, errno);
+    ASSERT_TRUE(pqueue->pop(pqueue) == NULL);
+    ASSERT_FALSE(pqueue->removetop(pqueue));
+    ASSERT_EQUAL_INT(-1, pqueue->tophandle(pqueue));
+
+    int values[] = { 5, 3, 8, 1, 9, 2, 7 };
+    int64_t handles[7];
+    int i;
+    for (i = 0; i < 7; i++) {
+        handles[i] = pqueue->push(pqueue, &values[i]);
+        ASSERT(handles[i] > 0);
+    }
+    ASSERT_EQUAL_INT(7, pqueue->size(pqueue));
+    ASSERT_EQUAL_INT(1, *(int *) pqueue->top(pqueue, false));
+    ASSERT(handles[3] == pqueue->tophandle(pqueue));
+
+    int *data = pqueue->pop(pqueue);
+    ASSERT_EQUAL_INT(1, *data);
+    free(data);
+    data = pqueue->pop(pqueue);
+    ASSERT_EQUAL_INT(2, *data);
+    free(data);
+    ASSERT_EQUAL_INT(5, pqueue->size(pqueue));
+
+    // the handles of the popped elements are gone
+    ASSERT_TRUE(pqueue->get(pqueue, handles[3], false) == NULL);
+    ASSERT_EQUAL_INT(ENOENT, errno);
+    ASSERT_EQUAL_INT(8, *(int *) pqueue->get(pqueue, handles[2], false));
+
+    ASSERT_TRUE(drain_sorted(pqueue, 5));
+    pqueue->free(pqueue);
+
+    // max-heap with a reversed comparison
+    pqueue = qpqueue(4, sizeof(int), cmp_int_desc, QPQUEUE_THREADSAFE);
+    for (i = 0; i < 7; i++) {
+        pqueue->push(pqueue, &values[i]);
+    }
+    ASSERT_EQUAL_INT(9, *(int *) pqueue->top(pqueue, false));
+    pqueue->free(pqueue);
+}
+
+TEST("Test update() / remove() by handle") {
+    qpqueue_t *pqueue = qpqueue(0, sizeof(int), cmp_int, 0);
+    const int num = 1000;
+    int64_t *handles = (int64_t *) malloc(sizeof(int64_t) * num);
+    int i;
+    for (i = 0; i < num; i++) {
+        int value = (i * 7919) % num + 100;
+        handles[i] = pqueue->push(pqueue, &value);
+    }
+
+    // decrease-key to the new minimum
+    int value = 1;
+    ASSERT_TRUE(pqueue->update(pqueue, handles[500], &value));
+    ASSERT(handles[500] == pqueue->tophandle(pqueue));
+
+    // increase-key sends it down again
+    value = 5000;
+    ASSERT_TRUE(pqueue->update(pqueue, handles[500], &value));
+    ASSERT(handles[500] != pqueue->tophandle(pqueue));
+    ASSERT_EQUAL_INT(5000, *(int *) pqueue->get(pqueue, handles[500], false));
+
+    // remove from the middle
+    for (i = 0; i < num; i += 3) {
+        ASSERT_TRUE(pqueue->remove(pqueue, handles[i]));
+    }
+    ASSERT_FALSE(pqueue->remove(pqueue, handles[0]));
+    ASSERT_EQUAL_INT(ENOENT, errno);
+    ASSERT_FALSE(pqueue->update(pqueue, handles[0], &value));
+    ASSERT_FALSE(pqueue->remove(pqueue, 0));
+    ASSERT_EQUAL_INT(num - (num + 2) / 3, pqueue->size(pqueue));
+
+    // a stale handle isn't taken by a new element
+    int64_t handle = pqueue->push(pqueue, &value);
+    ASSERT(handle != handles[0]);
+    ASSERT_TRUE(pqueue->get(pqueue, handles[0], false) == NULL);
+
+    ASSERT_TRUE(drain_sorted(pqueue, num - (num + 2) / 3 + 1));
+    free(handles);
+    pqueue->free(pqueue);
+}
+
+TEST("Test pusharray() builds a heap") {
+    const int num = 5000;
+    int *values = (int *) malloc(sizeof(int) * num);
+    int64_t *handles = (int64_t *) malloc(sizeof(int64_t) * num);
+    unsigned int seed = 1;
+    int i;
+    for (i = 0; i < num; i++) {
+        seed = seed * 1103515245 + 12345;
+        values[i] = (int) (seed % 100000);
+    }
+
+    qpqueue_t *pqueue = qpqueue(0, sizeof(int), cmp_int, 0);
+    ASSERT_FALSE(pqueue->pusharray(pqueue, values, 0, NULL));
+    ASSERT_EQUAL_INT(EINVAL, errno);
+
+    // bulk build into an empty queue, then a small batch
+    ASSERT_TRUE(pqueue->pusharray(pqueue, values, num - 10, handles));
+    ASSERT_TRUE(pqueue->pusharray(pqueue, values + num - 10, 10,
+                                  handles + num - 10));
+    ASSERT_EQUAL_INT(num, pqueue->size(pqueue));
+    for (i = 0; i < num; i += 97) {
+        ASSERT_EQUAL_INT(values[i],
+                         *(int *) pqueue->get(pqueue, handles[i], false));
+    }
+    ASSERT_TRUE(drain_sorted(pqueue, num));
+
+    // a single element and clear()
+    ASSERT_TRUE(pqueue->pusharray(pqueue, values, 1, NULL));
+    ASSERT_EQUAL_INT(values[0], *(int *) pqueue->top(pqueue, false));
+    pqueue->clear(pqueue);
+    ASSERT_EQUAL_INT(0, pqueue->size(pqueue));
+    ASSERT_TRUE(pqueue->get(pqueue, handles[0], false) == NULL);
+
+    free(values);
+    free(handles);
+    pqueue->free(pqueue);
+}
+
+QUNIT_END();
@@ -30,11 +30,19 @@
  * Copyright (c) 2015 Zhenjiang Xie - https://github.com/Charles0429
  *****************************************************************************/
 
+#include <errno.h>
+#include <pthread.h>
 #include "qunit.h"
 #include "qlibc.h"
 #include "limits.h"
 
 void test_thousands_of_values(int num_values, char *prefix, char *postfix);
+static void *test_ring_producer(void *arg);
+static void *test_ring_consumer(void *arg);
+static void *test_wait_consumer(void *arg);
+
+#define RING_THREADS    (4)
+#define RING_PER_THREAD (100000)
 
 QUNIT_START("Test qqueue.c");
 
@@ -186,6 +194,141 @@ TEST("Test thousands of values: with prefix and postfix") {
             "1a087a6982371bbfc9d4e14ae    76e05ddd784a5d9c6b0fc9e6cd715baab66b90987b2ee054764e58fc04e449dfa060a68398601b64cf470cb6f0a260ec6539866");
 }
 
+TEST("Test ring buffer queue") {
+    qqueue_t *queue = qqueue_ring(3, 16);
+    ASSERT_NOT_NULL(queue);
+    ASSERT_EQUAL_INT(4, queue->setsize(queue, 100));  // rounded up, fixed
+
+    ASSERT_TRUE(queue->pushint(queue, 1));
+    ASSERT_TRUE(queue->pushstr(queue, "two"));
+    ASSERT_TRUE(queue->push(queue, "three", 6));
+    ASSERT_TRUE(queue->pushint(queue, 4));
+    ASSERT_FALSE(queue->pushint(queue, 5));
+    ASSERT_EQUAL_INT(ENOBUFS, errno);
+    ASSERT_EQUAL_INT(4, queue->size(queue));
+
+    ASSERT_FALSE(queue->push(queue, "longer than sixteen", 20));
+    ASSERT_EQUAL_INT(EINVAL, errno);
+    ASSERT_NULL(queue->get(queue, NULL, false));
+    ASSERT_EQUAL_INT(ENOTSUP, errno);
+
+    ASSERT_EQUAL_INT(1, queue->popint(queue));
+    char *str = queue->popstr(queue);
+    ASSERT_EQUAL_STR("two", str);
+    free(str);
+    size_t size;
+    void *data = queue->pop(queue, &size);
+    ASSERT_EQUAL_INT(6, size);
+    ASSERT_EQUAL_STR("three", data);
+    free(data);
+
+    // wrap around
+    ASSERT_TRUE(queue->pushint(queue, 5));
+    ASSERT_EQUAL_INT(4, queue->popint(queue));
+    ASSERT_EQUAL_INT(5, queue->popint(queue));
+    ASSERT_EQUAL_INT(0, queue->size(queue));
+    ASSERT_NULL(queue->pop(queue, NULL));
+    ASSERT_EQUAL_INT(ENOENT, errno);
+
+    queue->pushint(queue, 6);
+    queue->clear(queue);
+    ASSERT_EQUAL_INT(0, queue->size(queue));
+    queue->free(queue);
+}
+
+TEST("Test ring buffer queue with multiple producers and consumers") {
+    qqueue_t *queue = qqueue_ring(256, sizeof(int64_t));
+    pthread_t producers[RING_THREADS], consumers[RING_THREADS];
+    int i;
+    for (i = 0; i < RING_THREADS; i++) {
+        pthread_create(&producers[i], NULL, test_ring_producer, queue);
+        pthread_create(&consumers[i], NULL, test_ring_consumer, queue);
+    }
+    int64_t sum = 0;
+    for (i = 0; i < RING_THREADS; i++) {
+        void *ret;
+        pthread_join(producers[i], NULL);
+        pthread_join(consumers[i], &ret);
+        sum += *(int64_t *) ret;
+        free(ret);
+    }
+    int64_t n = (int64_t) RING_THREADS * RING_PER_THREAD;
+    ASSERT_EQUAL_INT(0, queue->size(queue));
+    ASSERT_TRUE(sum == n * (n + 1) / 2);
+    queue->free(queue);
+}
+
+TEST("Test pop_wait() and popbatch()") {
+    qqueue_t *queue = qqueue(QQUEUE_THREADSAFE);
+    ASSERT_NULL(queue->pop_wait(queue, NULL, 0));
+    ASSERT_EQUAL_INT(ENOENT, errno);
+    long start = qtime_current_milli();
+    ASSERT_NULL(queue->pop_wait(queue, NULL, 50));
+    ASSERT_EQUAL_INT(ETIMEDOUT, errno);
+    ASSERT_TRUE(qtime_current_milli() - start >= 40);
+
+    int i;
+    for (i = 1; i <= 10; i++) {
+        queue->pushint(queue, i);
+    }
+    void *datas[4];
+    size_t sizes[4];
+    ASSERT_EQUAL_INT(4, queue->popbatch(queue, datas, sizes, 4));
+    for (i = 0; i < 4; i++) {
+        ASSERT_EQUAL_INT(i + 1, *(int64_t *) datas[i]);
+        ASSERT_EQUAL_INT(sizeof(int64_t), sizes[i]);
+        free(datas[i]);
+    }
+    ASSERT_EQUAL_INT(4, queue->popbatch(queue, datas, NULL, 4));
+    for (i = 0; i < 4; i++) free(datas[i]);
+    ASSERT_EQUAL_INT(2, queue->popbatch(queue, datas, NULL, 4));
+    for (i = 0; i < 2; i++) free(datas[i]);
+    ASSERT_EQUAL_INT(0, queue->popbatch(queue, datas, NULL, 4));
+
+    // sleeping consumers are woken by pushes
+    pthread_t consumers[RING_THREADS];
+    for (i = 0; i < RING_THREADS; i++) {
+        pthread_create(&consumers[i], NULL, test_wait_consumer, queue);
+    }
+    int64_t sum = 0;
+    for (i = 1; i <= 10000; i++) {
+        queue->pushint(queue, i);
+    }
+    for (i = 0; i < RING_THREADS; i++) {
+        queue->pushint(queue, -1);  // stop
+    }
+    for (i = 0; i < RING_THREADS; i++) {
+        void *ret;
+        pthread_join(consumers[i], &ret);
+        sum += *(int64_t *) ret;
+        free(ret);
+    }
+    ASSERT_TRUE(sum == 10000LL * 10001 / 2);
+    queue->free(queue);
+
+    // the same with the ring buffer
+    queue = qqueue_ring(64, sizeof(int64_t));
+    ASSERT_NULL(queue->pop_wait(queue, NULL, 10));
+    ASSERT_EQUAL_INT(ETIMEDOUT, errno);
+    for (i = 0; i < RING_THREADS; i++) {
+        pthread_create(&consumers[i], NULL, test_wait_consumer, queue);
+    }
+    for (i = 1; i <= 10000; i++) {
+        while (queue->pushint(queue, i) == false);
+    }
+    for (i = 0; i < RING_THREADS; i++) {
+        while (queue->pushint(queue, -1) == false);
+    }
+    for (sum = 0, i = 0; i < RING_THREADS; i++) {
+        void *ret;
+        pthread_join(consumers[i], &ret);
+        sum += *(int64_t *) ret;
+        free(ret);
+    }
+    ASSERT_TRUE(sum == 10000LL * 10001 / 2);
+    queue->free(queue);
+}
+
 QUNIT_END();
 
 void test_thousands_of_values(int num_values, char *prefix, char *postfix) {
@@ -251,3 +394,46 @@ void test_thousands_of_values(int num_values, char *prefix, char *postfix) {
     queue->clear(queue);
     queue->free(queue);
 }
+
+static void *test_ring_producer(void *arg) {
+    qqueue_t *queue = (qqueue_t *) arg;
+    static int64_t next = 0;
+    int i;
+    for (i = 0; i < RING_PER_THREAD; i++) {
+        int64_t num = __atomic_add_fetch(&next, 1, __ATOMIC_RELAXED);
+        while (queue->pushint(queue, num) == false);
+    }
+    return NULL;
+}
+
+static void *test_ring_consumer(void *arg) {
+    qqueue_t *queue = (qqueue_t *) arg;
+    int64_t *sum = calloc(1, sizeof(int64_t));
+    int i;
+    for (i = 0; i < RING_PER_THREAD;) {
+        int64_t num = queue->popint(queue);
+        if (num > 0) {
+            *sum += num;
+            i++;
+        }
+    }
+    return sum;
+}
+
+static void *test_wait_consumer(void *arg) {
+    qqueue_t *queue = (qqueue_t *) arg;
+    int64_t *sum = calloc(1, sizeof(int64_t));
+    while (true) {
+        int64_t *num = queue->pop_wait(queue, NULL, -1);
+        if (num == NULL) {
+            continue;
+        }
+        int64_t n = *num;
+        free(num);
+        if (n < 0) {
+            break;
+        }
+        *sum += n;
+    }
+    return sum;
+}
@@ -0,0 +1,154 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include "qunit.h"
+#include "qlibc.h"
+#include "qlibcext.h"
+
+#define NUM_THREADS     (4)
+#define NUM_TRIES       (10000)
+
+static qratelimit_t *shared = NULL;
+static int granted = 0;
+
+static void *consume_thread(void *arg) {
+    int i;
+    for (i = 0; i < NUM_TRIES; i++) {
+        if (shared->consume(shared, "shared", 1)) {
+            __atomic_add_fetch(&granted, 1, __ATOMIC_RELAXED);
+        }
+    }
+    return NULL;
+}
+
+QUNIT_START("Test qratelimit.c");
+
+TEST("qratelimit() rejects the memory for less than two groups") {
+    size_t memsize = qratelimit_calculate_memsize(1);
+    char *memory = malloc(memsize);
+    ASSERT_NULL(qratelimit(memory, memsize - 1, 5, 1));
+    ASSERT_EQUAL_INT(EINVAL, errno);
+    ASSERT_NULL(qratelimit(memory, memsize, 0, 1));
+    ASSERT_EQUAL_INT(EINVAL, errno);
+    ASSERT_NULL(qratelimit(memory, memsize, 5, 0));
+    ASSERT_EQUAL_INT(EINVAL, errno);
+    free(memory);
+}
+
+TEST("Smallest limiter consumes without deadlock") {
+    size_t memsize = qratelimit_calculate_memsize(1);
+    char *memory = malloc(memsize);
+    qratelimit_t *limiter = qratelimit(memory, memsize, 5, 1);
+    ASSERT_NOT_NULL(limiter);
+
+    // a new key starts with a full bucket
+    int i;
+    for (i = 0; i < 5; i++) {
+        ASSERT_TRUE(limiter->consume(limiter, "client1", 1));
+    }
+    ASSERT_FALSE(limiter->consume(limiter, "client1", 1));
+    ASSERT_TRUE(limiter->waittime(limiter, "client1", 1) > 0);
+    ASSERT_TRUE(limiter->waittime(limiter, "client1", 1) <= 1000);
+
+    // keys are independent
+    ASSERT_TRUE(limiter->consume(limiter, "client2", 5));
+    ASSERT_EQUAL_INT(0, limiter->waittime(limiter, "client3", 5));
+    ASSERT_EQUAL_INT(2, limiter->size(limiter));
+
+    limiter->clear(limiter);
+    ASSERT_EQUAL_INT(0, limiter->size(limiter));
+    ASSERT_TRUE(limiter->consume(limiter, "client1", 5));
+
+    limiter->free(limiter);
+    free(memory);
+}
+
+TEST("Binary keys and the global bucket") {
+    size_t memsize = qratelimit_calculate_memsize(100);
+    char *memory = malloc(memsize);
+    qratelimit_t *limiter = qratelimit(memory, memsize, 10, 1);
+    ASSERT_TRUE(limiter->set_global(limiter, 15, 1));
+
+    unsigned char ip1[4] = { 10, 0, 0, 1 }, ip2[4] = { 10, 0, 0, 2 };
+    ASSERT_TRUE(limiter->consume_by_obj(limiter, ip1, sizeof(ip1), 10));
+    ASSERT_FALSE(limiter->consume_by_obj(limiter, ip1, sizeof(ip1), 1));
+
+    // the key has tokens but the total doesn't
+    ASSERT_TRUE(limiter->consume_by_obj(limiter, ip2, sizeof(ip2), 5));
+    ASSERT_FALSE(limiter->consume_by_obj(limiter, ip2, sizeof(ip2), 1));
+    ASSERT_TRUE(limiter->waittime_by_obj(limiter, ip2, sizeof(ip2), 1) > 0);
+
+    ASSERT_TRUE(limiter->set_global(limiter, 0, 0));
+    ASSERT_TRUE(limiter->consume_by_obj(limiter, ip2, sizeof(ip2), 5));
+
+    limiter->free(limiter);
+    free(memory);
+}
+
+TEST("Many keys over the capacity evict the idle ones") {
+    size_t memsize = qratelimit_calculate_memsize(10);
+    char *memory = malloc(memsize);
+    qratelimit_t *limiter = qratelimit(memory, memsize, 1, 1);
+
+    char key[32];
+    int i;
+    for (i = 0; i < 1000; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        ASSERT_TRUE(limiter->consume(limiter, key, 1));
+    }
+    ASSERT_TRUE(limiter->size(limiter) < 1000);
+
+    limiter->free(limiter);
+    free(memory);
+}
+
+TEST("Concurrent consumers don't exceed the burst") {
+    size_t memsize = qratelimit_calculate_memsize(10);
+    char *memory = malloc(memsize);
+    shared = qratelimit(memory, memsize, 100, 1);
+
+    pthread_t threads[NUM_THREADS];
+    int i;
+    for (i = 0; i < NUM_THREADS; i++) {
+        pthread_create(&threads[i], NULL, consume_thread, NULL);
+    }
+    for (i = 0; i < NUM_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    // 100 of the burst plus a token per second while running
+    ASSERT_TRUE(granted >= 100 && granted <= 105);
+
+    shared->free(shared);
+    free(memory);
+}
+
+QUNIT_END();
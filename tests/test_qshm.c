@@ -0,0 +1,166 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/shm.h>
+#include <sys/wait.h>
+#include "qunit.h"
+#include "qlibc.h"
+
+// waits for the child and returns its exit code, -1 if it didn't exit
+static int wait_child(pid_t pid) {
+    int status;
+    if (pid <= 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status))
+        return -1;
+    return WEXITSTATUS(status);
+}
+
+QUNIT_START("Test qshm.c");
+
+TEST("Test SysV shared memory") {
+    int shmid = qshm_init(NULL, 0, 4096, false);
+    ASSERT_TRUE(shmid >= 0);
+    char *mem = (char *) qshm_get(shmid);
+    ASSERT_NOT_NULL(mem);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        strcpy(mem, "from child");
+        _exit(0);
+    }
+    ASSERT_EQUAL_INT(0, wait_child(pid));
+    ASSERT_EQUAL_STR("from child", mem);
+
+    shmdt(mem);
+    ASSERT_TRUE(qshm_free(shmid));
+}
+
+TEST("Test named POSIX shared memory") {
+    char name[64];
+    snprintf(name, sizeof(name), "/test_qshm_%d", (int) getpid());
+
+    int fd = qshm_open(name, 10000, QSHM_RECREATE);
+    ASSERT_TRUE(fd >= 0);
+    size_t size = 0;
+    char *mem = (char *) qshm_map(fd, &size, 0);
+    ASSERT_NOT_NULL(mem);
+    ASSERT_EQUAL_INT(10000, size);
+    close(fd);
+    strcpy(mem, "hello");
+
+    // open the existing one by name, the size is taken from it
+    fd = qshm_open(name, 0, 0);
+    ASSERT_TRUE(fd >= 0);
+    size_t size2 = 0;
+    char *mem2 = (char *) qshm_map(fd, &size2, QSHM_HUGEPAGE | QSHM_INTERLEAVE);
+    ASSERT_NOT_NULL(mem2);
+    ASSERT_EQUAL_INT(10000, size2);
+    close(fd);
+    ASSERT_EQUAL_STR("hello", mem2);
+    mem2[0] = 'j';
+    ASSERT_EQUAL_STR("jello", mem);
+    ASSERT_TRUE(qshm_unmap(mem2, size2));
+
+    // opening with a size keeps the existing object as it is
+    fd = qshm_open(name, 20000, 0);
+    ASSERT_TRUE(fd >= 0);
+    size2 = 0;
+    mem2 = (char *) qshm_map(fd, &size2, 0);
+    close(fd);
+    ASSERT_NOT_NULL(mem2);
+    ASSERT_EQUAL_INT(10000, size2);
+    ASSERT_EQUAL_STR("jello", mem2);
+    ASSERT_TRUE(qshm_unmap(mem2, size2));
+
+    // recreating makes a new empty object
+    fd = qshm_open(name, 4096, QSHM_RECREATE);
+    ASSERT_TRUE(fd >= 0);
+    size2 = 0;
+    mem2 = (char *) qshm_map(fd, &size2, 0);
+    close(fd);
+    ASSERT_NOT_NULL(mem2);
+    ASSERT_EQUAL_INT(4096, size2);
+    ASSERT_EQUAL_INT(0, mem2[0]);
+    ASSERT_EQUAL_STR("jello", mem);
+    ASSERT_TRUE(qshm_unmap(mem2, size2));
+
+    ASSERT_TRUE(qshm_unmap(mem, size));
+    ASSERT_TRUE(qshm_unlink(name));
+    ASSERT_FALSE(qshm_unlink(name));
+    ASSERT_EQUAL_INT(-1, qshm_open(name, 0, 0));
+    ASSERT_EQUAL_INT(ENOENT, errno);
+}
+
+TEST("Test invalid arguments") {
+    size_t size = 0;
+    int fd = qshm_open(NULL, 0, 0);
+    ASSERT_EQUAL_INT(-1, fd);
+    ASSERT_EQUAL_INT(EINVAL, errno);
+
+    ASSERT_NULL(qshm_map(-1, &size, 0));
+    ASSERT_EQUAL_INT(EINVAL, errno);
+}
+
+#ifdef __linux__
+TEST("Test anonymous POSIX shared memory") {
+    int fd = qshm_open(NULL, 8192, 0);
+    ASSERT_TRUE(fd >= 0);
+
+    // map only the leading part
+    size_t size = 4096;
+    char *mem = (char *) qshm_map(fd, &size, 0);
+    ASSERT_NOT_NULL(mem);
+    ASSERT_EQUAL_INT(4096, size);
+    close(fd);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        strcpy(mem, "from child");
+        _exit(0);
+    }
+    ASSERT_EQUAL_INT(0, wait_child(pid));
+    ASSERT_EQUAL_STR("from child", mem);
+    ASSERT_TRUE(qshm_unmap(mem, size));
+
+    // huge pages fall back to the regular ones when none are reserved
+    fd = qshm_open(NULL, 8192, QSHM_HUGEPAGE);
+    ASSERT_TRUE(fd >= 0);
+    size = 0;
+    mem = (char *) qshm_map(fd, &size, QSHM_HUGEPAGE);
+    ASSERT_NOT_NULL(mem);
+    ASSERT_TRUE(size >= 8192);
+    close(fd);
+    memset(mem, 'x', size);
+    ASSERT_TRUE(qshm_unmap(mem, size));
+}
+#endif
+
+QUNIT_END();
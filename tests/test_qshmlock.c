@@ -0,0 +1,198 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "qunit.h"
+#include "qlibc.h"
+
+// waits for the child and returns its exit code, -1 if it didn't exit
+static int wait_child(pid_t pid) {
+    int status;
+    if (pid <= 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status))
+        return -1;
+    return WEXITSTATUS(status);
+}
+
+QUNIT_START("Test qshmlock.c");
+
+TEST("Test enter() and leave() between processes") {
+    qshmlock_t *lock = qshmlock_init(NULL, 0, 2, false);
+    ASSERT_NOT_NULL(lock);
+
+    volatile int *counter = (volatile int *) mmap(NULL, sizeof(int),
+                                                  PROT_READ | PROT_WRITE,
+                                                  MAP_SHARED | MAP_ANONYMOUS,
+                                                  -1, 0);
+    ASSERT_TRUE(counter != MAP_FAILED);
+    *counter = 0;
+
+    int i;
+    pid_t pids[4];
+    for (i = 0; i < 4; i++) {
+        pids[i] = fork();
+        if (pids[i] == 0) {
+            int j;
+            for (j = 0; j < 10000; j++) {
+                if (qshmlock_enter(lock, 1) == false)
+                    _exit(1);
+                *counter = *counter + 1;
+                qshmlock_leave(lock, 1);
+            }
+            _exit(0);
+        }
+    }
+    int failed = 0;
+    for (i = 0; i < 4; i++) {
+        if (wait_child(pids[i]) != 0)
+            failed++;
+    }
+    ASSERT_EQUAL_INT(0, failed);
+    ASSERT_EQUAL_INT(40000, *counter);
+
+    munmap((void *) counter, sizeof(int));
+    ASSERT_TRUE(qshmlock_free(lock));
+}
+
+TEST("Test enter_nowait() and enter_timed() on a held lock") {
+    qshmlock_t *lock = qshmlock_init(NULL, 0, 1, false);
+    ASSERT_NOT_NULL(lock);
+    ASSERT_TRUE(qshmlock_enter(lock, 0));
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        if (qshmlock_enter_nowait(lock, 0) == true || errno != EBUSY)
+            _exit(1);
+        if (qshmlock_enter_timed(lock, 0, 10) == true || errno != ETIMEDOUT)
+            _exit(2);
+        _exit(0);
+    }
+    ASSERT_EQUAL_INT(0, wait_child(pid));
+    ASSERT_TRUE(qshmlock_leave(lock, 0));
+
+    ASSERT_TRUE(qshmlock_enter_nowait(lock, 0));
+    ASSERT_TRUE(qshmlock_leave(lock, 0));
+    ASSERT_TRUE(qshmlock_enter_timed(lock, 0, 10));
+    ASSERT_TRUE(qshmlock_leave(lock, 0));
+
+    // invalid lock numbers
+    ASSERT_FALSE(qshmlock_enter(lock, 1));
+    ASSERT_EQUAL_INT(EINVAL, errno);
+    ASSERT_FALSE(qshmlock_enter(lock, -1));
+    ASSERT_TRUE(qshmlock_free(lock));
+}
+
+#ifdef __linux__
+TEST("Test taking over the lock of a dead owner") {
+    qshmlock_t *lock = qshmlock_init(NULL, 0, 1, false);
+    ASSERT_NOT_NULL(lock);
+
+    // the child dies holding the lock
+    pid_t pid = fork();
+    if (pid == 0) {
+        qshmlock_enter(lock, 0);
+        _exit(0);
+    }
+    ASSERT_EQUAL_INT(0, wait_child(pid));
+
+    ASSERT_TRUE(qshmlock_enter(lock, 0));
+    ASSERT_TRUE(qshmlock_leave(lock, 0));
+
+    // the lock is consistent again and works as usual
+    ASSERT_TRUE(qshmlock_enter_nowait(lock, 0));
+    ASSERT_TRUE(qshmlock_leave(lock, 0));
+
+    // the same with the other ways to enter
+    pid = fork();
+    if (pid == 0) {
+        qshmlock_enter(lock, 0);
+        _exit(0);
+    }
+    ASSERT_EQUAL_INT(0, wait_child(pid));
+    ASSERT_TRUE(qshmlock_enter_nowait(lock, 0));
+    ASSERT_TRUE(qshmlock_leave(lock, 0));
+
+    pid = fork();
+    if (pid == 0) {
+        qshmlock_enter(lock, 0);
+        _exit(0);
+    }
+    ASSERT_EQUAL_INT(0, wait_child(pid));
+    ASSERT_TRUE(qshmlock_enter_timed(lock, 0, 1000));
+    ASSERT_TRUE(qshmlock_leave(lock, 0));
+
+    ASSERT_TRUE(qshmlock_free(lock));
+}
+#endif
+
+TEST("Test read and write locks") {
+    qshmlock_t *lock = qshmlock_init(NULL, 0, 1, false);
+    ASSERT_NOT_NULL(lock);
+
+    // readers share the lock and the mutex is independent of it
+    ASSERT_TRUE(qshmlock_read_enter(lock, 0));
+    ASSERT_TRUE(qshmlock_read_enter(lock, 0));
+    ASSERT_TRUE(qshmlock_enter_nowait(lock, 0));
+    ASSERT_TRUE(qshmlock_leave(lock, 0));
+    ASSERT_TRUE(qshmlock_read_leave(lock, 0));
+    ASSERT_TRUE(qshmlock_read_leave(lock, 0));
+
+    ASSERT_TRUE(qshmlock_write_enter(lock, 0));
+    ASSERT_TRUE(qshmlock_write_leave(lock, 0));
+    ASSERT_TRUE(qshmlock_free(lock));
+}
+
+TEST("Test attach() with a keyfile") {
+    char keyfile[] = "/tmp/test_qshmlock_XXXXXX";
+    int fd = mkstemp(keyfile);
+    ASSERT_TRUE(fd >= 0);
+    close(fd);
+
+    qshmlock_t *lock = qshmlock_init(keyfile, 'l', 3, true);
+    ASSERT_NOT_NULL(lock);
+    qshmlock_t *other = qshmlock_attach(keyfile, 'l');
+    ASSERT_NOT_NULL(other);
+
+    ASSERT_TRUE(qshmlock_enter(lock, 2));
+    ASSERT_FALSE(qshmlock_enter_nowait(other, 2));
+    ASSERT_EQUAL_INT(EBUSY, errno);
+    ASSERT_TRUE(qshmlock_leave(lock, 2));
+    ASSERT_TRUE(qshmlock_enter_nowait(other, 2));
+    ASSERT_TRUE(qshmlock_leave(other, 2));
+
+    qshmlock_detach(other);
+    ASSERT_TRUE(qshmlock_free(lock));
+    ASSERT_NULL(qshmlock_attach(keyfile, 'l'));
+    unlink(keyfile);
+}
+
+QUNIT_END();
@@ -0,0 +1,233 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "qunit.h"
+#include "qlibc.h"
+
+#define NUM_PRODUCERS   (4)
+#define NUM_MESSAGES    (100000)
+
+struct producer_arg {
+    qshmring_t *ring;
+    int id;
+};
+
+static void *producer_thread(void *arg);
+static size_t fill_message(char *buf, int id, int seq);
+
+QUNIT_START("Test qshmring.c");
+
+TEST("Test push and pop") {
+    size_t memsize = qshmring_calculate_memsize(1000);
+    char *memory = malloc(memsize);
+    qshmring_t *ring = qshmring(memory, memsize, 0);
+    ASSERT_NOT_NULL(ring);
+    ASSERT_EQUAL_INT(1024, ring->capacity(ring));
+    ASSERT_EQUAL_INT(0, ring->used(ring));
+
+    char buf[1024];
+    ASSERT_EQUAL_INT(-1, ring->pop(ring, buf, sizeof(buf)));
+    ASSERT_EQUAL_INT(EAGAIN, errno);
+
+    ASSERT_TRUE(ring->push(ring, "hello", 5));
+    ASSERT_TRUE(ring->push(ring, "", 0));
+    ASSERT_TRUE(ring->push(ring, "world!", 6));
+    ASSERT_EQUAL_INT(16 + 8 + 16, ring->used(ring));
+
+    // attach to the same ring
+    qshmring_t *ring2 = qshmring(memory, 0, 0);
+    ASSERT_NOT_NULL(ring2);
+    ASSERT_EQUAL_INT(-1, ring2->pop(ring2, buf, 4));
+    ASSERT_EQUAL_INT(EMSGSIZE, errno);
+    ASSERT_EQUAL_INT(5, ring2->pop(ring2, buf, sizeof(buf)));
+    ASSERT_EQUAL_MEM("hello", buf, 5);
+    ASSERT_EQUAL_INT(0, ring->pop(ring, buf, sizeof(buf)));
+    ASSERT_EQUAL_INT(6, ring->pop(ring, buf, sizeof(buf)));
+    ASSERT_EQUAL_MEM("world!", buf, 6);
+    ASSERT_EQUAL_INT(0, ring->used(ring));
+
+    // too large or full
+    ASSERT_FALSE(ring->push(ring, buf, 512));
+    ASSERT_EQUAL_INT(EMSGSIZE, errno);
+    int i;
+    for (i = 0; ring->push(ring, buf, 100); i++);
+    ASSERT_EQUAL_INT(EAGAIN, errno);
+    // 112 bytes records from offset 40, the 9th one does not fit after the
+    // padding at the end of the buffer.
+    ASSERT_EQUAL_INT(8, i);
+    ASSERT_FALSE(ring->push_wait(ring, buf, 100, 10));
+    ASSERT_EQUAL_INT(ETIMEDOUT, errno);
+
+    ring->free(ring);
+    ring2->free(ring2);
+    memset(memory, 0, memsize);
+    ASSERT_NULL(qshmring(memory, 0, 0));
+    free(memory);
+}
+
+TEST("Test wrapping around with variable sizes") {
+    size_t memsize = qshmring_calculate_memsize(4096);
+    char *memory = malloc(memsize);
+    qshmring_t *ring = qshmring(memory, memsize, 0);
+
+    char msg[2048], buf[2048];
+    int pushed = 0, popped = 0;
+    while (popped < 20000) {
+        // push a few, pop a few, so the records wrap at any offset
+        int n;
+        for (n = 0; n < 3 && pushed < 20000; n++) {
+            size_t size = fill_message(msg, 0, pushed);
+            if (ring->push(ring, msg, size) == false)
+                break;
+            pushed++;
+        }
+        ssize_t size = ring->pop(ring, buf, sizeof(buf));
+        if (size < 0)
+            continue;
+        ASSERT_EQUAL_INT(fill_message(msg, 0, popped), size);
+        ASSERT_EQUAL_MEM(msg, buf, size);
+        popped++;
+    }
+    ASSERT_EQUAL_INT(0, ring->used(ring));
+
+    ring->free(ring);
+    free(memory);
+}
+
+TEST("Test multiple producers") {
+    size_t memsize = qshmring_calculate_memsize(64 * 1024);
+    char *memory = malloc(memsize);
+    qshmring_t *ring = qshmring(memory, memsize, QSHMRING_MULTIPRODUCER);
+
+    pthread_t threads[NUM_PRODUCERS];
+    struct producer_arg args[NUM_PRODUCERS];
+    int i;
+    for (i = 0; i < NUM_PRODUCERS; i++) {
+        args[i].ring = ring;
+        args[i].id = i;
+        pthread_create(&threads[i], NULL, producer_thread, &args[i]);
+    }
+
+    // the messages of each producer come in order
+    int next[NUM_PRODUCERS] = { 0 };
+    char msg[2048], buf[2048];
+    int bad = 0;
+    for (i = 0; i < NUM_PRODUCERS * NUM_MESSAGES; i++) {
+        ssize_t size = ring->pop_wait(ring, buf, sizeof(buf), 5000);
+        if (size < 0) {
+            bad++;
+            break;
+        }
+        int id = buf[0] - 'A';
+        if (id < 0 || id >= NUM_PRODUCERS
+            || (size_t) size != fill_message(msg, id, next[id])
+            || memcmp(msg, buf, size) != 0) {
+            bad++;
+        }
+        next[id]++;
+    }
+    for (i = 0; i < NUM_PRODUCERS; i++) {
+        pthread_join(threads[i], NULL);
+        ASSERT_EQUAL_INT(NUM_MESSAGES, next[i]);
+    }
+    ASSERT_EQUAL_INT(0, bad);
+    ASSERT_EQUAL_INT(0, ring->used(ring));
+
+    ring->free(ring);
+    free(memory);
+}
+
+TEST("Test between processes") {
+    size_t memsize = qshmring_calculate_memsize(16 * 1024);
+    void *memory = mmap(NULL, memsize, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    ASSERT_TRUE(memory != MAP_FAILED);
+    qshmring_t *ring = qshmring(memory, memsize, 0);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        qshmring_t *child = qshmring(memory, 0, 0);
+        char msg[2048];
+        int seq;
+        for (seq = 0; seq < NUM_MESSAGES; seq++) {
+            size_t size = fill_message(msg, 0, seq);
+            if (child->push_wait(child, msg, size, 5000) == false)
+                _exit(1);
+        }
+        _exit(0);
+    }
+
+    char msg[2048], buf[2048];
+    int seq, bad = 0;
+    for (seq = 0; seq < NUM_MESSAGES; seq++) {
+        ssize_t size = ring->pop_wait(ring, buf, sizeof(buf), 5000);
+        if (size < 0 || (size_t) size != fill_message(msg, 0, seq)
+            || memcmp(msg, buf, size) != 0) {
+            bad++;
+            break;
+        }
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    ASSERT_EQUAL_INT(0, bad);
+    ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    ring->free(ring);
+    munmap(memory, memsize);
+}
+
+QUNIT_END();
+
+static void *producer_thread(void *arg) {
+    struct producer_arg *parg = (struct producer_arg *) arg;
+    char msg[2048];
+    int seq;
+    for (seq = 0; seq < NUM_MESSAGES; seq++) {
+        size_t size = fill_message(msg, parg->id, seq);
+        if (parg->ring->push_wait(parg->ring, msg, size, 5000) == false) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+/* message of the producer id and its sequence, 1 ~ 1500 bytes long */
+static size_t fill_message(char *buf, int id, int seq) {
+    size_t size = 1 + ((unsigned) seq * 2654435761u) % ((seq % 16 == 0) ? 1500 : 100);
+    size_t i;
+    buf[0] = 'A' + id;
+    for (i = 1; i < size; i++) {
+        buf[i] = (char) (seq + i);
+    }
+    return size;
+}
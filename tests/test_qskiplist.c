@@ -0,0 +1,205 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+#include <errno.h>
+#include <pthread.h>
+#include "qunit.h"
+#include "qlibc.h"
+
+#define NUM_WORKERS     (8)
+#define NUM_KEYS        (5000)
+
+// each worker adds its own keys, replaces them, and removes every other one.
+static void *test_worker(void *arg) {
+    qskiplist_t *list = (qskiplist_t *) arg;
+    static int nextid = 0;
+    int id = __atomic_fetch_add(&nextid, 1, __ATOMIC_RELAXED);
+
+    char name[32], data[32];
+    int i;
+    for (i = 0; i < NUM_KEYS; i++) {
+        snprintf(name, sizeof(name), "k%05d.%d", i, id);
+        snprintf(data, sizeof(data), "%d", i);
+        if (list->putstr(list, name, data) == false) {
+            return (void *) 1;
+        }
+    }
+    for (i = 0; i < NUM_KEYS; i++) {
+        snprintf(name, sizeof(name), "k%05d.%d", i, id);
+        snprintf(data, sizeof(data), "%d", -i);
+        if (list->putstr(list, name, data) == false) {
+            return (void *) 1;
+        }
+        if ((i % 2) == 1 && list->remove(list, name) == false) {
+            return (void *) 1;
+        }
+    }
+    return NULL;
+}
+
+QUNIT_START("Test qskiplist.c");
+
+TEST("Test put() / get() / remove()") {
+    qskiplist_t *list = qskiplist();
+    ASSERT_NOT_NULL(list);
+    ASSERT_FALSE(list->put(list, NULL, "x", 1));
+    ASSERT_EQUAL_INT(EINVAL, errno);
+
+    ASSERT_TRUE(list->putstr(list, "b", "2"));
+    ASSERT_TRUE(list->putstr(list, "a", "1"));
+    ASSERT_TRUE(list->put(list, "c", "3", 2));
+    ASSERT_EQUAL_INT(3, list->size(list));
+    ASSERT_EQUAL_STR("1", list->getstr(list, "a", false));
+
+    // replace
+    ASSERT_TRUE(list->putstr(list, "a", "one"));
+    ASSERT_EQUAL_INT(3, list->size(list));
+    size_t datasize;
+    char *str = list->get(list, "a", &datasize, true);
+    ASSERT_EQUAL_STR("one", str);
+    ASSERT_EQUAL_INT(4, datasize);
+    free(str);
+
+    ASSERT_TRUE(list->get(list, "z", NULL, false) == NULL);
+    ASSERT_EQUAL_INT(ENOENT, errno);
+
+    ASSERT_TRUE(list->remove(list, "b"));
+    ASSERT_FALSE(list->remove(list, "b"));
+    ASSERT_EQUAL_INT(ENOENT, errno);
+    ASSERT_TRUE(list->getstr(list, "b", false) == NULL);
+    ASSERT_EQUAL_INT(2, list->size(list));
+
+    list->clear(list);
+    ASSERT_EQUAL_INT(0, list->size(list));
+    ASSERT_TRUE(list->getstr(list, "a", false) == NULL);
+    list->free(list);
+}
+
+TEST("Test getnext() / find_nearest()") {
+    qskiplist_t *list = qskiplist();
+    const char *keys = "XSRNIEDCBA";
+    char name[2] = { 0, 0 };
+    int i;
+    for (i = 0; keys[i] != '\0'; i++) {
+        name[0] = keys[i];
+        list->putstr(list, name, name);
+    }
+
+    // in order
+    char seq[16] = "";
+    qskiplist_obj_t obj;
+    memset((void *) &obj, 0, sizeof(obj));
+    list->read_enter(list);
+    while (list->getnext(list, &obj, false)) {
+        strcat(seq, (char *) obj.name);
+    }
+    list->read_leave(list);
+    ASSERT_EQUAL_STR("ABCDEINRSX", seq);
+
+    obj = list->find_nearest(list, "0", 2, false);
+    ASSERT_EQUAL_STR("A", obj.name);
+    obj = list->find_nearest(list, "C", 2, false);
+    ASSERT_EQUAL_STR("C", obj.name);
+    obj = list->find_nearest(list, "F", 2, false);
+    ASSERT_EQUAL_STR("E", obj.name);
+    obj = list->find_nearest(list, "Z", 2, true);
+    ASSERT_EQUAL_STR("X", obj.name);
+    free(obj.name);
+    free(obj.data);
+
+    // traversal from the nearest one
+    seq[0] = '\0';
+    list->read_enter(list);
+    obj = list->find_nearest(list, "F", 2, false);
+    while (list->getnext(list, &obj, true)) {
+        strcat(seq, (char *) obj.name);
+        free(obj.name);
+        free(obj.data);
+    }
+    list->read_leave(list);
+    ASSERT_EQUAL_STR("EINRSX", seq);
+
+    list->clear(list);
+    obj = list->find_nearest(list, "F", 2, false);
+    ASSERT_TRUE(obj.name == NULL);
+    ASSERT_EQUAL_INT(ENOENT, errno);
+    list->free(list);
+}
+
+TEST("Test concurrent writers") {
+    qskiplist_t *list = qskiplist();
+    pthread_t threads[NUM_WORKERS];
+    int i;
+    for (i = 0; i < NUM_WORKERS; i++) {
+        pthread_create(&threads[i], NULL, test_worker, list);
+    }
+
+    // ordered traversal while the workers are running
+    int scans;
+    bool ordered = true;
+    for (scans = 0; scans < 20; scans++) {
+        char prev[32] = "";
+        qskiplist_obj_t obj;
+        memset((void *) &obj, 0, sizeof(obj));
+        list->read_enter(list);
+        while (list->getnext(list, &obj, false) == true) {
+            if (strcmp(prev, obj.name) >= 0) {
+                ordered = false;
+            }
+            snprintf(prev, sizeof(prev), "%s", (char *) obj.name);
+        }
+        list->read_leave(list);
+    }
+    ASSERT_TRUE(ordered);
+
+    bool ok = true;
+    for (i = 0; i < NUM_WORKERS; i++) {
+        void *ret;
+        pthread_join(threads[i], &ret);
+        ok = ok && (ret == NULL);
+    }
+    ASSERT_TRUE(ok);
+    ASSERT_EQUAL_INT(NUM_WORKERS * NUM_KEYS / 2, list->size(list));
+
+    // the remaining ones have the replaced data
+    size_t cnt = 0;
+    qskiplist_obj_t obj;
+    memset((void *) &obj, 0, sizeof(obj));
+    list->read_enter(list);
+    while (list->getnext(list, &obj, false) == true) {
+        int n = atoi((char *) obj.name + 1);
+        if ((n % 2) == 0 && atoi(obj.data) == -n) {
+            cnt++;
+        }
+    }
+    list->read_leave(list);
+    ASSERT_EQUAL_INT(NUM_WORKERS * NUM_KEYS / 2, cnt);
+
+    list->free(list);
+}
+
+QUNIT_END();
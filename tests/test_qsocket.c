@@ -0,0 +1,401 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include "qunit.h"
+#include "qlibc.h"
+
+// rejected by the system resolver without asking a name server
+#define BADNAME "bad..name"
+
+// waits for a background resolution, returns the result
+static bool _wait(qsocket_dns_t *req, struct sockaddr_storage *addr,
+                  socklen_t *addrlen) {
+    struct pollfd pfd;
+    pfd.fd = qsocket_resolve_fd(req);
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, 5000) != 1)
+        return false;
+    return qsocket_resolve_result(req, addr, addrlen);
+}
+
+// whether the name is answered by the cache, without a resolver thread
+static bool _cached(const char *hostname) {
+    qsocket_dns_t *req = qsocket_resolve_async(hostname, 0, AF_UNSPEC);
+    if (req == NULL)
+        return false;
+    bool cached = (req->hostname == NULL);
+
+    // let the lookup land in the cache before going on
+    struct sockaddr_storage addr;
+    socklen_t addrlen;
+    _wait(req, &addr, &addrlen);
+    qsocket_resolve_free(req);
+    return cached;
+}
+
+static bool _is_loopback4(const struct sockaddr_storage *addr, int port) {
+    const struct sockaddr_in *in = (const struct sockaddr_in *) addr;
+    return (addr->ss_family == AF_INET
+            && in->sin_addr.s_addr == htonl(INADDR_LOOPBACK)
+            && ntohs(in->sin_port) == port);
+}
+
+static int _port(int sockfd) {
+    struct sockaddr_storage addr;
+    socklen_t addrlen = sizeof(addr);
+    if (getsockname(sockfd, (struct sockaddr *) &addr, &addrlen) != 0)
+        return -1;
+    if (addr.ss_family == AF_INET6)
+        return ntohs(((struct sockaddr_in6 *) &addr)->sin6_port);
+    return ntohs(((struct sockaddr_in *) &addr)->sin_port);
+}
+
+// accepts a pending connection, -1 if none came in time
+static int _accept(int sockfd) {
+    struct pollfd pfd;
+    pfd.fd = sockfd;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, 1000) != 1)
+        return -1;
+    return accept(sockfd, NULL, NULL);
+}
+
+// connects to the listener and checks the data goes through
+static bool _connects(int sockfd, const char *hostname) {
+    int clientfd = qsocket_open(hostname, _port(sockfd), 1000);
+    if (clientfd < 0)
+        return false;
+    int serverfd = _accept(sockfd);
+    char c = 0;
+    bool ok = (serverfd >= 0 && write(clientfd, "x", 1) == 1
+               && read(serverfd, &c, 1) == 1 && c == 'x');
+    if (serverfd >= 0)
+        close(serverfd);
+    close(clientfd);
+    return ok;
+}
+
+QUNIT_START("Test qsocket.c");
+
+TEST("Test qsocket_resolve()") {
+    struct sockaddr_storage addr;
+    socklen_t addrlen;
+
+    ASSERT_TRUE(qsocket_resolve(&addr, &addrlen, "127.0.0.1", 8080,
+                                AF_UNSPEC));
+    ASSERT_EQUAL_INT(sizeof(struct sockaddr_in), addrlen);
+    ASSERT_TRUE(_is_loopback4(&addr, 8080));
+
+    ASSERT_TRUE(qsocket_resolve(&addr, &addrlen, "::1", 80, AF_INET6));
+    struct sockaddr_in6 *in6 = (struct sockaddr_in6 *) &addr;
+    ASSERT_EQUAL_INT(sizeof(struct sockaddr_in6), addrlen);
+    ASSERT_TRUE(addr.ss_family == AF_INET6
+                && !memcmp(&in6->sin6_addr, &in6addr_loopback,
+                           sizeof(in6addr_loopback))
+                && ntohs(in6->sin6_port) == 80);
+
+    ASSERT_TRUE(qsocket_resolve(&addr, &addrlen, "localhost", 80, AF_INET));
+    ASSERT_TRUE(_is_loopback4(&addr, 80));
+
+    // the cached answer takes the port of the call
+    ASSERT_TRUE(qsocket_resolve(&addr, &addrlen, "localhost", 81, AF_INET));
+    ASSERT_TRUE(_is_loopback4(&addr, 81));
+
+    struct sockaddr_in in;
+    ASSERT_TRUE(qsocket_get_addr(&in, "127.0.0.1", 25));
+    ASSERT_TRUE(in.sin_family == AF_INET
+                && in.sin_addr.s_addr == htonl(INADDR_LOOPBACK)
+                && ntohs(in.sin_port) == 25);
+
+    errno = 0;
+    ASSERT_FALSE(qsocket_resolve(&addr, &addrlen, "127.0.0.1", 80,
+                                 AF_INET6));
+    ASSERT_EQUAL_INT(ENOENT, errno);
+    ASSERT_FALSE(qsocket_resolve(&addr, &addrlen, BADNAME, 80, AF_UNSPEC));
+    ASSERT_EQUAL_INT(ENOENT, errno);
+    ASSERT_FALSE(qsocket_resolve(&addr, &addrlen, "localhost", 80, AF_UNIX));
+    ASSERT_EQUAL_INT(EINVAL, errno);
+    ASSERT_FALSE(qsocket_resolve(&addr, &addrlen, NULL, 80, AF_UNSPEC));
+    ASSERT_EQUAL_INT(EINVAL, errno);
+}
+
+TEST("Test qsocket_resolve_async()") {
+    struct sockaddr_storage addr;
+    socklen_t addrlen;
+    qsocket_clear_dnscache();
+
+    // by a resolver thread
+    qsocket_dns_t *req = qsocket_resolve_async("localhost", 8080, AF_INET);
+    ASSERT_TRUE(req != NULL && req->hostname != NULL);
+    ASSERT_TRUE(_wait(req, &addr, &addrlen));
+    ASSERT_EQUAL_INT(sizeof(struct sockaddr_in), addrlen);
+    ASSERT_TRUE(_is_loopback4(&addr, 8080));
+    qsocket_resolve_free(req);
+
+    // numeric addresses aren't cached but still work
+    req = qsocket_resolve_async("127.0.0.1", 80, AF_UNSPEC);
+    ASSERT_TRUE(req != NULL && req->hostname != NULL);
+    ASSERT_TRUE(_wait(req, &addr, &addrlen));
+    ASSERT_TRUE(_is_loopback4(&addr, 80));
+    qsocket_resolve_free(req);
+    ASSERT_FALSE(_cached("127.0.0.1"));
+
+    // a failure
+    req = qsocket_resolve_async(BADNAME, 80, AF_UNSPEC);
+    ASSERT_NOT_NULL(req);
+    errno = 0;
+    ASSERT_FALSE(_wait(req, &addr, &addrlen));
+    ASSERT_EQUAL_INT(ENOENT, errno);
+    qsocket_resolve_free(req);
+
+    // more at once than the threads
+    qsocket_dns_t *reqs[QSOCKET_DNS_THREADS * 2];
+    int i;
+    for (i = 0; i < QSOCKET_DNS_THREADS * 2; i++) {
+        reqs[i] = qsocket_resolve_async("127.0.0.1", i, AF_INET);
+        ASSERT_NOT_NULL(reqs[i]);
+    }
+    for (i = 0; i < QSOCKET_DNS_THREADS * 2; i++) {
+        ASSERT_TRUE(reqs[i] != NULL && _wait(reqs[i], &addr, &addrlen)
+                    && _is_loopback4(&addr, i));
+        if (reqs[i] != NULL)
+            qsocket_resolve_free(reqs[i]);
+    }
+
+    errno = 0;
+    ASSERT_NULL(qsocket_resolve_async("localhost", 80, AF_UNIX));
+    ASSERT_EQUAL_INT(EINVAL, errno);
+    ASSERT_NULL(qsocket_resolve_async(NULL, 80, AF_UNSPEC));
+    ASSERT_EQUAL_INT(EINVAL, errno);
+}
+
+TEST("Test qsocket_resolve_free() while in flight") {
+    struct sockaddr_storage addr;
+    socklen_t addrlen;
+
+    // the threads finish or skip the freed ones on their own
+    int i;
+    for (i = 0; i < 100; i++) {
+        qsocket_clear_dnscache();
+        qsocket_dns_t *req = qsocket_resolve_async("localhost", 80, AF_INET);
+        ASSERT_NOT_NULL(req);
+        if (req != NULL)
+            qsocket_resolve_free(req);
+    }
+
+    // and go on with the next
+    qsocket_dns_t *req = qsocket_resolve_async("127.0.0.1", 80, AF_INET);
+    ASSERT_TRUE(req != NULL && _wait(req, &addr, &addrlen)
+                && _is_loopback4(&addr, 80));
+    if (req != NULL)
+        qsocket_resolve_free(req);
+}
+
+TEST("Test the resolver cache") {
+    struct sockaddr_storage addr;
+    socklen_t addrlen;
+
+    // answered right away once resolved
+    qsocket_clear_dnscache();
+    ASSERT_FALSE(_cached("localhost"));
+    ASSERT_TRUE(_cached("localhost"));
+    qsocket_dns_t *req = qsocket_resolve_async("localhost", 8080, AF_UNSPEC);
+    ASSERT_TRUE(req != NULL && req->hostname == NULL);
+    ASSERT_TRUE(qsocket_resolve_result(req, &addr, &addrlen));
+    ASSERT_TRUE(_is_loopback4(&addr, 8080));
+    qsocket_resolve_free(req);
+
+    // the failures as well
+    ASSERT_FALSE(qsocket_resolve(&addr, &addrlen, BADNAME, 80, AF_UNSPEC));
+    req = qsocket_resolve_async(BADNAME, 80, AF_UNSPEC);
+    ASSERT_TRUE(req != NULL && req->hostname == NULL);
+    errno = 0;
+    ASSERT_FALSE(qsocket_resolve_result(req, &addr, &addrlen));
+    ASSERT_EQUAL_INT(ENOENT, errno);
+    qsocket_resolve_free(req);
+
+    qsocket_clear_dnscache();
+    ASSERT_FALSE(_cached("localhost"));
+    ASSERT_FALSE(_cached(BADNAME));
+
+    // expiry
+    qsocket_set_dnscache(1, 1);
+    qsocket_clear_dnscache();
+    ASSERT_TRUE(qsocket_resolve(&addr, &addrlen, "localhost", 80, AF_UNSPEC));
+    ASSERT_FALSE(qsocket_resolve(&addr, &addrlen, BADNAME, 80, AF_UNSPEC));
+    ASSERT_TRUE(_cached("localhost"));
+    ASSERT_TRUE(_cached(BADNAME));
+    sleep(2);
+    ASSERT_FALSE(_cached("localhost"));
+    ASSERT_FALSE(_cached(BADNAME));
+
+    // only the addresses
+    qsocket_set_dnscache(60, 0);
+    qsocket_clear_dnscache();
+    ASSERT_FALSE(_cached("localhost"));
+    ASSERT_FALSE(_cached(BADNAME));
+    ASSERT_TRUE(_cached("localhost"));
+    ASSERT_FALSE(_cached(BADNAME));
+
+    // nothing
+    qsocket_set_dnscache(0, 0);
+    qsocket_clear_dnscache();
+    ASSERT_FALSE(_cached("localhost"));
+    ASSERT_FALSE(_cached("localhost"));
+
+    qsocket_set_dnscache(QSOCKET_DNS_TTL, QSOCKET_DNS_NEGTTL);
+    qsocket_clear_dnscache();
+}
+
+TEST("Test qsocket_listen()") {
+    // on a given address
+    int sockfd = qsocket_listen("127.0.0.1", 0, 16, 0);
+    ASSERT_TRUE(sockfd >= 0 && _port(sockfd) > 0);
+    ASSERT_TRUE(_connects(sockfd, "127.0.0.1"));
+
+    // taken without SO_REUSEPORT
+    int port = _port(sockfd);
+    ASSERT_EQUAL_INT(-3, qsocket_listen("127.0.0.1", port, 16, 0));
+    close(sockfd);
+
+    // on all the addresses, IPv4 included
+    sockfd = qsocket_listen(NULL, 0, 16, 0);
+    ASSERT_TRUE(sockfd >= 0);
+    ASSERT_TRUE(_connects(sockfd, "127.0.0.1"));
+    close(sockfd);
+
+    // TCP_NODELAY inherited by the accepted sockets
+    sockfd = qsocket_listen("127.0.0.1", 0, 16, QSOCKET_OPT_NODELAY);
+    ASSERT_TRUE(sockfd >= 0);
+    int clientfd = qsocket_open("127.0.0.1", _port(sockfd), 1000);
+    int serverfd = _accept(sockfd);
+    int on = 0;
+    socklen_t onlen = sizeof(on);
+    ASSERT_TRUE(serverfd >= 0
+                && getsockopt(serverfd, IPPROTO_TCP, TCP_NODELAY, &on,
+                              &onlen) == 0 && on != 0);
+    if (serverfd >= 0)
+        close(serverfd);
+    if (clientfd >= 0)
+        close(clientfd);
+    close(sockfd);
+
+#ifdef SO_REUSEPORT
+    // shared by both
+    sockfd = qsocket_listen("127.0.0.1", 0, 16, QSOCKET_OPT_REUSEPORT);
+    ASSERT_TRUE(sockfd >= 0);
+    int sockfd2 = qsocket_listen("127.0.0.1", _port(sockfd), 16,
+                                 QSOCKET_OPT_REUSEPORT);
+    ASSERT_TRUE(sockfd2 >= 0 && _port(sockfd2) == _port(sockfd));
+    if (sockfd2 >= 0)
+        close(sockfd2);
+    close(sockfd);
+#endif
+
+    // not supported everywhere, but not a bind failure
+    sockfd = qsocket_listen("127.0.0.1", 0, 16, QSOCKET_OPT_FASTOPEN);
+    ASSERT_TRUE(sockfd >= 0 || sockfd == -2);
+    if (sockfd >= 0)
+        close(sockfd);
+
+    ASSERT_EQUAL_INT(-1, qsocket_listen(BADNAME, 0, 16, 0));
+}
+
+TEST("Test qsocket_open() racing the addresses") {
+    // "localhost" may come with ::1 too, which isn't listened on
+    int sockfd = qsocket_listen("127.0.0.1", 0, 16, 0);
+    ASSERT_TRUE(sockfd >= 0);
+    long start = qtime_current_milli();
+    ASSERT_TRUE(_connects(sockfd, "localhost"));
+    ASSERT_TRUE(qtime_current_milli() - start < 1000);
+    close(sockfd);
+
+    // and the other way around where "localhost" has ::1
+    struct sockaddr_storage addr;
+    socklen_t addrlen;
+    sockfd = qsocket_listen("::1", 0, 16, 0);
+    if (sockfd >= 0) {
+        ASSERT_TRUE(_connects(sockfd, "::1"));
+        if (qsocket_resolve(&addr, &addrlen, "localhost", 0, AF_INET6)) {
+            start = qtime_current_milli();
+            ASSERT_TRUE(_connects(sockfd, "localhost"));
+            ASSERT_TRUE(qtime_current_milli() - start < 1000);
+        }
+        close(sockfd);
+    }
+}
+
+TEST("Test qsocket_open() failures") {
+    // refused right away
+    int sockfd = qsocket_listen("127.0.0.1", 0, 16, 0);
+    ASSERT_TRUE(sockfd >= 0);
+    int port = _port(sockfd);
+    close(sockfd);
+    long start = qtime_current_milli();
+    errno = 0;
+    ASSERT_EQUAL_INT(-3, qsocket_open("127.0.0.1", port, 5000));
+    ASSERT_EQUAL_INT(ECONNREFUSED, errno);
+    ASSERT_TRUE(qtime_current_milli() - start < 1000);
+
+    // a full queue of pending connections leaves the next one hanging
+    sockfd = qsocket_listen("127.0.0.1", 0, 0, 0);
+    ASSERT_TRUE(sockfd >= 0);
+    int clientfds[4], i, ret = 0;
+    long elapsed = 0;
+    for (i = 0; i < 4; i++) {
+        start = qtime_current_milli();
+        errno = 0;
+        clientfds[i] = ret = qsocket_open("127.0.0.1", _port(sockfd), 200);
+        elapsed = qtime_current_milli() - start;
+        if (ret < 0)
+            break;
+    }
+    ASSERT_EQUAL_INT(-3, ret);
+    ASSERT_EQUAL_INT(ETIMEDOUT, errno);
+    ASSERT_TRUE(elapsed >= 150 && elapsed < 1000);
+    while (--i >= 0) {
+        close(clientfds[i]);
+    }
+    close(sockfd);
+
+    errno = 0;
+    ASSERT_EQUAL_INT(-1, qsocket_open(BADNAME, 80, 1000));
+    ASSERT_EQUAL_INT(ENOENT, errno);
+    ASSERT_EQUAL_INT(-1, qsocket_open(NULL, 80, 1000));
+    ASSERT_EQUAL_INT(EINVAL, errno);
+}
+
+QUNIT_END();
@@ -69,4 +69,132 @@ TEST("qstrtrim_tail()") {
     ASSERT_EQUAL_STR(qstrtrim_tail(strdup(" a ")), " a");
 }
 
+TEST("qstrtok()") {
+    char str[] = "Hello,world|Thank,,you";
+    const char *expect[] = { "Hello", "world", "Thank", "", "you" };
+    const char stops[] = { ',', '|', ',', ',', '\0' };
+    char *token, stop;
+    int offset = 0, i = 0;
+    while ((token = qstrtok(str, "|,", &stop, &offset)) != NULL) {
+        ASSERT_EQUAL_STR(expect[i], token);
+        ASSERT_EQUAL_INT(stops[i], stop);
+        i++;
+    }
+    ASSERT_EQUAL_INT(5, i);
+
+    // longer than a vector, and a set beyond the nibble buckets
+    char longstr[] = "0123456789012345678901234567890123456789\x01"
+                     "abcdefghijklmnopqrstuvwxyz0123456789ABCDEFGHIJ";
+    offset = 0;
+    token = qstrtok(longstr, "\x01\x11\x21\x7f\x81\x91\xa1\xb1\xc1", &stop, &offset);
+    ASSERT_EQUAL_INT(40, strlen(token));
+    ASSERT_EQUAL_INT('\x01', stop);
+    token = qstrtok(longstr, "a", &stop, &offset);
+    ASSERT_EQUAL_STR("", token);
+    token = qstrtok(longstr, "J", &stop, &offset);
+    ASSERT_EQUAL_STR("bcdefghijklmnopqrstuvwxyz0123456789ABCDEFGHI", token);
+    ASSERT_NULL(qstrtok(longstr, "J", &stop, &offset));
+}
+
+TEST("qstrtok_getnext()") {
+    const char *str = "a,b;;c,";
+    const char *expect[] = { "a", "b", "", "c" };
+    qtoken_t obj;
+    memset((void *) &obj, 0, sizeof(obj));
+    int i = 0;
+    while (qstrtok_getnext(str, strlen(str), ",;", &obj)) {
+        ASSERT_EQUAL_INT(strlen(expect[i]), obj.tokensize);
+        ASSERT_EQUAL_MEM(expect[i], obj.token, obj.tokensize);
+        i++;
+    }
+    ASSERT_EQUAL_INT(4, i);
+    ASSERT_EQUAL_STR("a,b;;c,", str);
+
+    qlist_t *list = qstrtokenizer("a:b::c", ":");
+    ASSERT_EQUAL_INT(4, list->size(list));
+    ASSERT_EQUAL_STR("b", list->getat(list, 1, NULL, false));
+    ASSERT_EQUAL_STR("", list->getat(list, 2, NULL, false));
+    list->free(list);
+}
+
+TEST("qstrreplace()") {
+    char *str = qstrreplace("tn", "Welcome to The qDecoder Project.", "aeiou", "_");
+    ASSERT_EQUAL_STR("W_lc_m_ t_ Th_ qD_c_d_r Pr_j_ct.", str);
+    free(str);
+    str = qstrreplace("sn", "Welcome to The qDecoder Project.", "The", "a");
+    ASSERT_EQUAL_STR("Welcome to a qDecoder Project.", str);
+    free(str);
+
+    char buf[64] = "aXbXXc";
+    ASSERT_EQUAL_STR("a--b----c", qstrreplace("sr", buf, "X", "--"));
+    ASSERT_EQUAL_STR("abc", qstrreplace("tr", buf, "-", ""));
+}
+
+TEST("qstr_append/appendf()") {
+    qstr_t s;
+    qstr_init(&s);
+    ASSERT_EQUAL_STR("", qstr_cstr(&s));
+    ASSERT_EQUAL_INT(0, qstr_len(&s));
+
+    // grows out of the inline buffer
+    char expect[2000] = "";
+    int i;
+    for (i = 0; i < 300; i++) {
+        ASSERT_TRUE(qstr_appendf(&s, "%d,", i));
+        sprintf(expect + strlen(expect), "%d,", i);
+        ASSERT_EQUAL_INT(strlen(expect), qstr_len(&s));
+    }
+    ASSERT_EQUAL_STR(expect, qstr_cstr(&s));
+
+    // append itself
+    qstr_truncate(&s, 4);
+    ASSERT_TRUE(qstr_append(&s, qstr_cstr(&s), qstr_len(&s)));
+    ASSERT_EQUAL_STR("0,1,0,1,", qstr_cstr(&s));
+    ASSERT_TRUE(qstr_appendstr(&s, "end"));
+    ASSERT_EQUAL_STR("0,1,0,1,end", qstr_cstr(&s));
+
+    char *str = qstr_detach(&s);
+    ASSERT_EQUAL_STR("0,1,0,1,end", str);
+    free(str);
+    ASSERT_EQUAL_INT(0, qstr_len(&s));
+
+    str = qstr_detach(&s);
+    ASSERT_EQUAL_STR("", str);
+    free(str);
+    qstr_free(&s);
+}
+
+TEST("qstr_replace/trim/upper()") {
+    qstr_t s;
+    qstr_init(&s);
+
+    qstr_appendstr(&s, "Welcome to The qDecoder Project.");
+    ASSERT_TRUE(qstr_replace(&s, "The", "_"));
+    ASSERT_EQUAL_STR("Welcome to _ qDecoder Project.", qstr_cstr(&s));
+    ASSERT_TRUE(qstr_replace(&s, "o", "OOO"));
+    ASSERT_EQUAL_STR("WelcOOOme tOOO _ qDecOOOder PrOOOject.", qstr_cstr(&s));
+    ASSERT_TRUE(qstr_replace(&s, "OOO", ""));
+    ASSERT_EQUAL_STR("Welcme t _ qDecder Prject.", qstr_cstr(&s));
+    ASSERT_TRUE(qstr_replace(&s, "none", "xx"));
+    ASSERT_EQUAL_INT(26, qstr_len(&s));
+    ASSERT_FALSE(qstr_replace(&s, "", "xx"));
+
+    qstr_truncate(&s, 0);
+    qstr_appendstr(&s, " \t ab c \r\n");
+    qstr_trim(&s);
+    ASSERT_EQUAL_STR("ab c", qstr_cstr(&s));
+    ASSERT_EQUAL_INT(4, qstr_len(&s));
+    qstr_upper(&s);
+    ASSERT_EQUAL_STR("AB C", qstr_cstr(&s));
+    qstr_lower(&s);
+    ASSERT_EQUAL_STR("ab c", qstr_cstr(&s));
+
+    qstr_truncate(&s, 0);
+    qstr_appendstr(&s, "   ");
+    qstr_trim(&s);
+    ASSERT_EQUAL_STR("", qstr_cstr(&s));
+
+    qstr_free(&s);
+}
+
 QUNIT_END();
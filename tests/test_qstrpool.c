@@ -0,0 +1,179 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#include <errno.h>
+#include <pthread.h>
+#include "qunit.h"
+#include "qlibc.h"
+
+#define NUM_THREADS (4)
+#define NUM_NAMES   (500)
+
+static void *intern_thread(void *arg);
+
+QUNIT_START("Test qstrpool.c");
+
+TEST("Test interning") {
+    qstrpool_t *pool = qstrpool(4, 0);
+    ASSERT_NOT_NULL(pool);
+    ASSERT_EQUAL_INT(0, pool->size(pool));
+
+    uint32_t hash;
+    const char *s1 = pool->intern(pool, "name=value", 4, &hash);
+    ASSERT_EQUAL_STR("name", s1);
+    ASSERT_EQUAL_INT(qhashmurmur3_32("name", 4), hash);
+    ASSERT_EQUAL_INT(hash, qstrpool_hash(s1));
+    ASSERT_EQUAL_INT(4, qstrpool_len(s1));
+
+    char buf[8] = "name";
+    const char *s2 = pool->internstr(pool, buf);
+    ASSERT_TRUE(s1 == s2);
+    ASSERT_EQUAL_INT(1, pool->size(pool));
+
+    const char *empty = pool->intern(pool, "", 0, NULL);
+    ASSERT_EQUAL_STR("", empty);
+    ASSERT_TRUE(empty == pool->intern(pool, NULL, 0, NULL));
+    ASSERT_NULL(pool->intern(pool, NULL, 1, NULL));
+    ASSERT_EQUAL_INT(EINVAL, errno);
+
+    // binary strings
+    const char *bin = pool->intern(pool, "a\0b", 3, NULL);
+    ASSERT_EQUAL_MEM("a\0b", bin, 4);
+    ASSERT_TRUE(bin != pool->intern(pool, "a\0c", 3, NULL));
+    ASSERT_EQUAL_INT(4, pool->size(pool));
+
+    pool->free(pool);
+}
+
+TEST("Test find and growing") {
+    qstrpool_t *pool = qstrpool(0, 0);
+    const char *names[5000];
+    char key[32];
+    int i;
+    for (i = 0; i < 5000; i++) {
+        sprintf(key, "key%d", i);
+        names[i] = pool->internstr(pool, key);
+        ASSERT_NOT_NULL(names[i]);
+    }
+    ASSERT_EQUAL_INT(5000, pool->size(pool));
+    ASSERT_TRUE(pool->memsize(pool) > 5000 * 4);
+
+    // the strings never move
+    for (i = 0; i < 5000; i++) {
+        sprintf(key, "key%d", i);
+        ASSERT_TRUE(names[i] == pool->find(pool, key, strlen(key), NULL));
+        ASSERT_EQUAL_STR(key, names[i]);
+    }
+    ASSERT_NULL(pool->find(pool, "key5000", 7, NULL));
+    ASSERT_EQUAL_INT(ENOENT, errno);
+    ASSERT_EQUAL_INT(5000, pool->size(pool));
+
+    pool->free(pool);
+}
+
+TEST("Test thread-safe interning") {
+    qstrpool_t *pool = qstrpool(0, QSTRPOOL_THREADSAFE);
+    pthread_t threads[NUM_THREADS];
+    int i;
+    for (i = 0; i < NUM_THREADS; i++) {
+        pthread_create(&threads[i], NULL, intern_thread, pool);
+    }
+    for (i = 0; i < NUM_THREADS; i++) {
+        void *ret;
+        pthread_join(threads[i], &ret);
+        ASSERT_TRUE(ret == NULL);
+    }
+    ASSERT_EQUAL_INT(NUM_NAMES, pool->size(pool));
+    pool->free(pool);
+}
+
+TEST("Test hash tables sharing a pool") {
+    qstrpool_t *pool = qstrpool(0, 0);
+    qhashtbl_t *tbl1 = qhashtbl(0, 0);
+    qhashtbl_t *tbl2 = qhashtbl(0, QHASHTBL_OPENADDR);
+    ASSERT_TRUE(tbl1->set_strpool(tbl1, pool));
+    ASSERT_TRUE(tbl2->set_strpool(tbl2, pool));
+
+    char key[32], value[32];
+    int i;
+    for (i = 0; i < 1000; i++) {
+        sprintf(key, "key%d", i % 100);
+        sprintf(value, "value%d", i);
+        ASSERT_TRUE(tbl1->putstr(tbl1, key, value));
+        ASSERT_TRUE(tbl2->putstr(tbl2, key, value));
+    }
+    ASSERT_EQUAL_INT(100, pool->size(pool));
+    ASSERT_EQUAL_INT(100, tbl1->size(tbl1));
+
+    // both tables refer to the interned names
+    qhashtbl_obj_t obj;
+    memset((void *) &obj, 0, sizeof(obj));
+    int n = 0;
+    while (tbl2->getnext(tbl2, &obj, false)) {
+        ASSERT_TRUE(obj.name == pool->find(pool, obj.name, obj.namesize, NULL));
+        n++;
+    }
+    ASSERT_EQUAL_INT(100, n);
+
+    uint32_t hash;
+    const char *name = pool->intern(pool, "key42", 5, &hash);
+    ASSERT_EQUAL_STR("value942", tbl1->get_by_obj(tbl1, name, 5, hash, NULL, false));
+    ASSERT_EQUAL_STR("value942", tbl2->getstr(tbl2, "key42", false));
+    ASSERT_TRUE(tbl1->remove(tbl1, "key42"));
+    ASSERT_NULL(tbl1->getstr(tbl1, "key42", false));
+    ASSERT_EQUAL_STR("value942", tbl2->getstr(tbl2, name, false));
+
+    // not allowed while holding elements
+    ASSERT_FALSE(tbl1->set_strpool(tbl1, NULL));
+    ASSERT_EQUAL_INT(EBUSY, errno);
+
+    tbl1->free(tbl1);
+    tbl2->free(tbl2);
+    pool->free(pool);
+}
+
+QUNIT_END();
+
+static void *intern_thread(void *arg) {
+    qstrpool_t *pool = (qstrpool_t *) arg;
+    const char *first[NUM_NAMES];
+    char key[32];
+    int round, i;
+    for (round = 0; round < 3; round++) {
+        for (i = 0; i < NUM_NAMES; i++) {
+            sprintf(key, "name%d", i);
+            const char *s = pool->internstr(pool, key);
+            if (s == NULL || strcmp(s, key) != 0
+                || (round > 0 && s != first[i])) {
+                return (void *) -1;
+            }
+            first[i] = s;
+        }
+    }
+    return NULL;
+}
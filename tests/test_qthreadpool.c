@@ -0,0 +1,275 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include "qunit.h"
+#include "qlibc.h"
+
+#define NUM_THREADS     (4)
+#define NUM_TASKS       (10000)
+#define NUM_ELEMS       (200000)
+
+static int task_count = 0;
+
+static void *count_task(void *arg) {
+    __atomic_add_fetch(&task_count, 1, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+static void *square_task(void *arg) {
+    intptr_t n = (intptr_t) arg;
+    return (void *) (n * n);
+}
+
+// waits for the subtasks from inside a task.
+static qthreadpool_t *fib_pool = NULL;
+static void *fib_task(void *arg) {
+    intptr_t n = (intptr_t) arg;
+    if (n < 2) {
+        return (void *) n;
+    }
+    qthreadpool_future_t *f1 = qthreadpool_async(fib_pool, fib_task,
+                                                 (void *) (n - 1));
+    qthreadpool_future_t *f2 = qthreadpool_async(fib_pool, fib_task,
+                                                 (void *) (n - 2));
+    if (f1 == NULL || f2 == NULL) {
+        return (void *) -1;
+    }
+    intptr_t sum = (intptr_t) qthreadpool_future_get(f1)
+            + (intptr_t) qthreadpool_future_get(f2);
+    qthreadpool_future_free(f1);
+    qthreadpool_future_free(f2);
+    return (void *) sum;
+}
+
+static void sum_range(size_t begin, size_t end, void *userdata) {
+    int64_t sum = 0;
+    size_t i;
+    for (i = begin; i < end; i++) {
+        sum += i;
+    }
+    __atomic_add_fetch((int64_t *) userdata, sum, __ATOMIC_RELAXED);
+}
+
+static void double_elem(void *data, size_t index, void *userdata) {
+    *(int *) data *= 2;
+    __atomic_add_fetch((int64_t *) userdata, index, __ATOMIC_RELAXED);
+}
+
+static int cmp_int(const void *data1, const void *data2) {
+    int a = *(const int *) data1, b = *(const int *) data2;
+    return (a > b) - (a < b);
+}
+
+static void sum_obj(const qhashtbl_obj_t *obj, void *userdata) {
+    __atomic_add_fetch((int64_t *) userdata, *(int *) obj->data,
+                       __ATOMIC_RELAXED);
+}
+
+static bool test_parallel_sort(qthreadpool_t *pool, int options, size_t num) {
+    qvector_t *vector = qvector(16, sizeof(int), options);
+    int64_t sum = 0;
+    size_t i;
+    srand(76);
+    for (i = 0; i < num; i++) {
+        int value = rand() % 100000;
+        sum += value;
+        if ((i % 2) == 0 || !(options & QVECTOR_CIRCULAR)) {
+            vector->addlast(vector, &value);
+        } else {
+            vector->addfirst(vector, &value);
+        }
+    }
+
+    bool ok = qvector_parallel_sort(vector, pool, cmp_int);
+    if (ok && vector->size(vector) != num) {
+        ok = false;
+    }
+    int prev = -1;
+    for (i = 0; ok && i < num; i++) {
+        int *value = (int *) vector->getat(vector, i, false);
+        if (*value < prev) {
+            ok = false;
+        }
+        prev = *value;
+        sum -= *value;
+    }
+    vector->free(vector);
+    return (ok && sum == 0);
+}
+
+QUNIT_START("Test qthreadpool.c");
+
+TEST("Test submit() and wait()") {
+    qthreadpool_t *pool = qthreadpool(NUM_THREADS);
+    ASSERT_NOT_NULL(pool);
+    ASSERT_EQUAL_INT(qthreadpool_nthreads(pool), NUM_THREADS);
+
+    int i;
+    for (i = 0; i < NUM_TASKS; i++) {
+        ASSERT_TRUE(qthreadpool_submit(pool, count_task, NULL));
+    }
+    qthreadpool_wait(pool);
+    ASSERT_EQUAL_INT(task_count, NUM_TASKS);
+
+    ASSERT_FALSE(qthreadpool_submit(pool, NULL, NULL));
+    ASSERT_EQUAL_INT(errno, EINVAL);
+    qthreadpool_free(pool);
+
+    // the queued tasks are done before shutting down
+    task_count = 0;
+    pool = qthreadpool(0);
+    ASSERT_NOT_NULL(pool);
+    ASSERT_TRUE(qthreadpool_nthreads(pool) > 0);
+    for (i = 0; i < NUM_TASKS; i++) {
+        ASSERT_TRUE(qthreadpool_submit(pool, count_task, NULL));
+    }
+    qthreadpool_shutdown(pool);
+    ASSERT_EQUAL_INT(task_count, NUM_TASKS);
+    ASSERT_FALSE(qthreadpool_submit(pool, count_task, NULL));
+    ASSERT_EQUAL_INT(errno, ECANCELED);
+    qthreadpool_free(pool);
+}
+
+TEST("Test futures") {
+    qthreadpool_t *pool = qthreadpool(NUM_THREADS);
+    ASSERT_NOT_NULL(pool);
+
+    qthreadpool_future_t *futures[100];
+    intptr_t i;
+    for (i = 0; i < 100; i++) {
+        futures[i] = qthreadpool_async(pool, square_task, (void *) i);
+        ASSERT_NOT_NULL(futures[i]);
+    }
+    for (i = 0; i < 100; i++) {
+        ASSERT_EQUAL_INT((intptr_t) qthreadpool_future_get(futures[i]), i * i);
+        ASSERT_TRUE(qthreadpool_future_done(futures[i]));
+        qthreadpool_future_free(futures[i]);
+    }
+
+    // nested futures
+    fib_pool = pool;
+    qthreadpool_future_t *future = qthreadpool_async(pool, fib_task,
+                                                     (void *) 18);
+    ASSERT_NOT_NULL(future);
+    ASSERT_EQUAL_INT((intptr_t) qthreadpool_future_get(future), 2584);
+    qthreadpool_future_free(future);
+
+    qthreadpool_free(pool);
+}
+
+TEST("Test parallel_for()") {
+    qthreadpool_t *pool = qthreadpool(NUM_THREADS);
+    ASSERT_NOT_NULL(pool);
+
+    size_t grains[] = { 0, 1, 7, 1000, NUM_ELEMS * 2 };
+    int i;
+    for (i = 0; i < sizeof(grains) / sizeof(grains[0]); i++) {
+        int64_t sum = 0;
+        ASSERT_TRUE(qthreadpool_parallel_for(pool, 10, NUM_ELEMS, grains[i],
+                                             sum_range, &sum));
+        ASSERT_EQUAL_INT(sum, ((int64_t) NUM_ELEMS * (NUM_ELEMS - 1) - 90) / 2);
+    }
+
+    int64_t sum = 0;
+    ASSERT_TRUE(qthreadpool_parallel_for(NULL, 0, 1000, 0, sum_range, &sum));
+    ASSERT_EQUAL_INT(sum, 499500);
+    ASSERT_TRUE(qthreadpool_parallel_for(pool, 5, 5, 0, sum_range, &sum));
+    ASSERT_FALSE(qthreadpool_parallel_for(pool, 5, 4, 0, sum_range, &sum));
+    ASSERT_EQUAL_INT(errno, EINVAL);
+
+    qthreadpool_free(pool);
+}
+
+TEST("Test qvector_parallel_foreach() and qvector_parallel_sort()") {
+    qthreadpool_t *pool = qthreadpool(NUM_THREADS);
+    ASSERT_NOT_NULL(pool);
+
+    // circular vector wrapped around
+    qvector_t *vector = qvector(16, sizeof(int), QVECTOR_CIRCULAR
+                                | QVECTOR_RESIZE_DOUBLE);
+    int i;
+    for (i = 0; i < NUM_ELEMS; i++) {
+        ASSERT_TRUE(vector->addlast(vector, &i));
+    }
+    for (i = 0; i < 100; i++) {
+        int *first = (int *) vector->popfirst(vector);
+        ASSERT_TRUE(vector->addlast(vector, first));
+        free(first);
+    }
+
+    int64_t sum = 0;
+    ASSERT_TRUE(qvector_parallel_foreach(vector, pool, double_elem, &sum));
+    ASSERT_EQUAL_INT(sum, (int64_t) NUM_ELEMS * (NUM_ELEMS - 1) / 2);
+    for (i = 0; i < NUM_ELEMS; i++) {
+        int *value = (int *) vector->getat(vector, i, false);
+        ASSERT_EQUAL_INT(*value, ((i + 100) % NUM_ELEMS) * 2);
+    }
+    vector->free(vector);
+
+    ASSERT_TRUE(test_parallel_sort(pool, QVECTOR_RESIZE_DOUBLE, NUM_ELEMS));
+    ASSERT_TRUE(test_parallel_sort(pool, QVECTOR_CIRCULAR
+                                   | QVECTOR_RESIZE_DOUBLE, NUM_ELEMS + 1));
+    ASSERT_TRUE(test_parallel_sort(pool, 0, 100));
+    ASSERT_TRUE(test_parallel_sort(NULL, 0, NUM_ELEMS));
+
+    qthreadpool_free(pool);
+}
+
+TEST("Test qhashtbl_parallel_foreach()") {
+    qthreadpool_t *pool = qthreadpool(NUM_THREADS);
+    ASSERT_NOT_NULL(pool);
+
+    int options[] = { 0, QHASHTBL_THREADSAFE | QHASHTBL_AUTORESIZE,
+                      QHASHTBL_OPENADDR };
+    int j;
+    for (j = 0; j < sizeof(options) / sizeof(options[0]); j++) {
+        qhashtbl_t *tbl = qhashtbl(100, options[j]);
+        ASSERT_NOT_NULL(tbl);
+
+        char name[32];
+        int i;
+        for (i = 0; i < NUM_TASKS; i++) {
+            snprintf(name, sizeof(name), "key%d", i);
+            ASSERT_TRUE(tbl->put(tbl, name, &i, sizeof(i)));
+        }
+
+        int64_t sum = 0;
+        ASSERT_TRUE(qhashtbl_parallel_foreach(tbl, pool, sum_obj, &sum));
+        ASSERT_EQUAL_INT(sum, (int64_t) NUM_TASKS * (NUM_TASKS - 1) / 2);
+        tbl->free(tbl);
+    }
+
+    qthreadpool_free(pool);
+}
+
+QUNIT_END();
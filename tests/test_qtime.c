@@ -0,0 +1,167 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+#include <errno.h>
+#include <time.h>
+#include "qunit.h"
+#include "qlibc.h"
+
+QUNIT_START("Test qtime.c");
+
+TEST("qtime_format_rfc1123() / qtime_format_iso8601()") {
+    char buf[32];
+    ASSERT_EQUAL_INT(29, qtime_format_rfc1123(buf, sizeof(buf), 784111777));
+    ASSERT_EQUAL_STR("Sun, 06 Nov 1994 08:49:37 GMT", buf);
+    ASSERT_EQUAL_INT(20, qtime_format_iso8601(buf, sizeof(buf), 784111777));
+    ASSERT_EQUAL_STR("1994-11-06T08:49:37Z", buf);
+
+    ASSERT_EQUAL_INT(29, qtime_format_rfc1123(buf, sizeof(buf), 0));
+    ASSERT_EQUAL_STR("Thu, 01 Jan 1970 00:00:00 GMT", buf);
+    ASSERT_EQUAL_INT(29, qtime_format_rfc1123(buf, sizeof(buf), -1));
+    ASSERT_EQUAL_STR("Wed, 31 Dec 1969 23:59:59 GMT", buf);
+    ASSERT_EQUAL_INT(20, qtime_format_iso8601(buf, sizeof(buf), 951782400));
+    ASSERT_EQUAL_STR("2000-02-29T00:00:00Z", buf);
+
+    ASSERT_EQUAL_INT(0, qtime_format_rfc1123(buf, 29, 0));
+    ASSERT_EQUAL_INT(ENOBUFS, errno);
+    ASSERT_EQUAL_INT(0, qtime_format_iso8601(buf, 20, 0));
+    ASSERT_EQUAL_INT(ENOBUFS, errno);
+}
+
+TEST("Formatters match strftime()") {
+    char buf1[64], buf2[64];
+    time_t t;
+    for (t = -86400 * 400; t < (time_t) 86400 * 365 * 80;
+         t += 86400 * 13 + 3607) {
+        qtime_format_rfc1123(buf1, sizeof(buf1), t);
+        struct tm tm;
+        gmtime_r(&t, &tm);
+        strftime(buf2, sizeof(buf2), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+        ASSERT_EQUAL_STR(buf2, buf1);
+        ASSERT_EQUAL_INT(t, qtime_parse_rfc1123(buf1));
+
+        qtime_format_iso8601(buf1, sizeof(buf1), t);
+        strftime(buf2, sizeof(buf2), "%Y-%m-%dT%H:%M:%SZ", &tm);
+        ASSERT_EQUAL_STR(buf2, buf1);
+        ASSERT_EQUAL_INT(t, qtime_parse_iso8601(buf1));
+    }
+}
+
+TEST("qtime_parse_rfc1123()") {
+    ASSERT_EQUAL_INT(784111777,
+                     qtime_parse_rfc1123("Sun, 06 Nov 1994 08:49:37 GMT"));
+    ASSERT_EQUAL_INT(784111777,
+                     qtime_parse_rfc1123("Sun, 06-Nov-1994 08:49:37 GMT"));
+    ASSERT_EQUAL_INT(784111777,
+                     qtime_parse_rfc1123("6 nov 1994 08:49:37"));
+    ASSERT_EQUAL_INT(784111777,
+                     qtime_parse_rfc1123("Sun, 06 Nov 1994 17:49:37 +0900"));
+    ASSERT_EQUAL_INT(784111777,
+                     qtime_parse_rfc1123("Sun, 06 Nov 1994 03:19:37 -0530"));
+
+    ASSERT_EQUAL_INT(-1, qtime_parse_rfc1123(""));
+    ASSERT_EQUAL_INT(EINVAL, errno);
+    ASSERT_EQUAL_INT(-1, qtime_parse_rfc1123("Sun, 06 Now 1994 08:49:37 GMT"));
+    ASSERT_EQUAL_INT(-1, qtime_parse_rfc1123("Sun, 31 Nov 1994 08:49:37 GMT"));
+    ASSERT_EQUAL_INT(-1, qtime_parse_rfc1123("Sun, 06 Nov 1994 24:49:37 GMT"));
+    ASSERT_EQUAL_INT(-1, qtime_parse_rfc1123("Sun, 06 Nov 1994 08:49 GMT"));
+    ASSERT_EQUAL_INT(-1, qtime_parse_rfc1123("Sun, 06 Nov 1994 08:49:37 XYZ"));
+
+    ASSERT_EQUAL_INT(784111777,
+                     qtime_parse_gmtstr("Sun, 06 Nov 1994 08:49:37 GMT"));
+
+    // -1 is a valid time, told from an error by errno
+    errno = 0;
+    ASSERT_EQUAL_INT(-1, qtime_parse_rfc1123("Wed, 31 Dec 1969 23:59:59 GMT"));
+    ASSERT_EQUAL_INT(0, errno);
+    ASSERT_EQUAL_INT(-1, qtime_parse_gmtstr("Wed, 31 Dec 1969 23:59:59 GMT"));
+    ASSERT_EQUAL_INT(-3600,
+                     qtime_parse_rfc1123("Thu, 01 Jan 1970 00:00:00 +0100"));
+    ASSERT_EQUAL_INT(-3600,
+                     qtime_parse_gmtstr("Thu, 01 Jan 1970 00:00:00 +0100"));
+    ASSERT_EQUAL_INT(0, errno);
+}
+
+TEST("qtime_parse_iso8601()") {
+    ASSERT_EQUAL_INT(784111777, qtime_parse_iso8601("1994-11-06T08:49:37Z"));
+    ASSERT_EQUAL_INT(784111777, qtime_parse_iso8601("1994-11-06 08:49:37"));
+    ASSERT_EQUAL_INT(784111777,
+                     qtime_parse_iso8601("1994-11-06T08:49:37.123456Z"));
+    ASSERT_EQUAL_INT(784111777,
+                     qtime_parse_iso8601("1994-11-06T17:49:37+09:00"));
+    ASSERT_EQUAL_INT(784111777,
+                     qtime_parse_iso8601("1994-11-06T03:19:37-0530"));
+    ASSERT_EQUAL_INT(784111740, qtime_parse_iso8601("1994-11-06T08:49Z"));
+    ASSERT_EQUAL_INT(784080000, qtime_parse_iso8601("1994-11-06"));
+
+    ASSERT_EQUAL_INT(-1, qtime_parse_iso8601("1994-11-6"));
+    ASSERT_EQUAL_INT(EINVAL, errno);
+    ASSERT_EQUAL_INT(-1, qtime_parse_iso8601("1994-02-29"));
+    ASSERT_EQUAL_INT(-1, qtime_parse_iso8601("1994-13-01"));
+    ASSERT_EQUAL_INT(-1, qtime_parse_iso8601("1994-11-06T08:49:37X"));
+
+    errno = 0;
+    ASSERT_EQUAL_INT(-1, qtime_parse_iso8601("1969-12-31T23:59:59Z"));
+    ASSERT_EQUAL_INT(0, errno);
+}
+
+TEST("Cached formatting") {
+    char buf1[64], buf2[64];
+    time_t t = 784111777;
+    ASSERT_EQUAL_STR("Sun, 06 Nov 1994 08:49:37 GMT", qtime_gmt_staticstr(t));
+    ASSERT_EQUAL_STR("Sun, 06 Nov 1994 08:49:38 GMT",
+                     qtime_gmt_staticstr(t + 1));
+
+    qtime_gmt_strf(buf1, sizeof(buf1), t, "%Y%m%d%H%M%S");
+    ASSERT_EQUAL_STR("19941106084937", buf1);
+    qtime_gmt_strf(buf1, sizeof(buf1), t, "%H:%M:%S");
+    ASSERT_EQUAL_STR("08:49:37", buf1);
+    qtime_gmt_strf(buf1, sizeof(buf1), t, "%H:%M:%S");
+    ASSERT_EQUAL_STR("08:49:37", buf1);
+    qtime_gmt_strf(buf1, 4, t, "%H:%M:%S");
+    qtime_gmt_strf(buf1, sizeof(buf1), t + 60, "%H:%M:%S");
+    ASSERT_EQUAL_STR("08:50:37", buf1);
+
+    qtime_localtime_strf(buf1, sizeof(buf1), t, "%d-%b-%Y %H:%M:%S %z");
+    struct tm tm;
+    localtime_r(&t, &tm);
+    strftime(buf2, sizeof(buf2), "%d-%b-%Y %H:%M:%S %z", &tm);
+    ASSERT_EQUAL_STR(buf2, buf1);
+    ASSERT_EQUAL_STR(buf2, qtime_localtime_staticstr(t));
+    qtime_localtime_strf(buf1, 4, t, "%d-%b-%Y %H:%M:%S %z");
+    ASSERT_EQUAL_STR("(bu", buf1);
+}
+
+TEST("qtime_monotonic_nano()") {
+    int64_t t1 = qtime_monotonic_nano();
+    struct timespec ts = { 0, 2000000 };
+    nanosleep(&ts, NULL);
+    int64_t t2 = qtime_monotonic_nano();
+    ASSERT(t2 - t1 >= 2000000);
+}
+
+QUNIT_END();
@@ -0,0 +1,206 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+#include <errno.h>
+#include "qunit.h"
+#include "qlibc.h"
+
+static int64_t now_ms(void) {
+    return qtime_monotonic_nano() / 1000000;
+}
+
+struct record {
+    int64_t id;
+    int64_t due;
+    int64_t duemax;
+    int64_t fired;
+};
+
+static int64_t _clock;
+static int _fired;
+static int _failed;
+
+static void on_expire(qtimerwheel_t *wheel, int64_t timerid, void *userdata) {
+    struct record *rec = (struct record *) userdata;
+    if (rec != NULL) {
+        rec->fired = _clock;
+    }
+    _fired++;
+}
+
+static void on_cancel_other(qtimerwheel_t *wheel, int64_t timerid,
+                            void *userdata) {
+    // cancel the other timer expiring at the same tick, and add another.
+    if (wheel->cancel(wheel, *(int64_t *) userdata) == false
+            || wheel->add(wheel, 0, on_expire, NULL) <= 0) {
+        _failed++;
+    }
+    _fired++;
+}
+
+QUNIT_START("Test qtimerwheel.c");
+
+TEST("Test add() / cancel() / size()") {
+    qtimerwheel_t *wheel = qtimerwheel(0, 0);
+    ASSERT_NOT_NULL(wheel);
+    ASSERT_EQUAL_INT(-1, wheel->nexttimeout(wheel));
+
+    ASSERT_EQUAL_INT(-1, wheel->add(wheel, -1, on_expire, NULL));
+    ASSERT_EQUAL_INT(EINVAL, errno);
+    ASSERT_EQUAL_INT(-1, wheel->add(wheel, 10, NULL, NULL));
+
+    int64_t id1 = wheel->add(wheel, 100, on_expire, NULL);
+    int64_t id2 = wheel->add(wheel, 200, on_expire, NULL);
+    ASSERT(id1 > 0 && id2 > 0 && id1 != id2);
+    ASSERT_EQUAL_INT(2, wheel->size(wheel));
+
+    ASSERT_TRUE(wheel->cancel(wheel, id1));
+    ASSERT_FALSE(wheel->cancel(wheel, id1));
+    ASSERT_EQUAL_INT(ENOENT, errno);
+    ASSERT_FALSE(wheel->cancel(wheel, 0));
+    ASSERT_EQUAL_INT(1, wheel->size(wheel));
+
+    // the id of a cancelled timer isn't taken by a new timer
+    int64_t id3 = wheel->add(wheel, 100, on_expire, NULL);
+    ASSERT(id3 != id1);
+    ASSERT_FALSE(wheel->cancel(wheel, id1));
+    ASSERT_FALSE(wheel->reset(wheel, id1, 10));
+
+    wheel->clear(wheel);
+    ASSERT_EQUAL_INT(0, wheel->size(wheel));
+    ASSERT_FALSE(wheel->cancel(wheel, id2));
+    wheel->free(wheel);
+}
+
+TEST("Test advance() expires on time") {
+    qtimerwheel_t *wheel = qtimerwheel(0, 0);
+    int64_t base = now_ms();
+    ASSERT_TRUE(wheel->add(wheel, 50, on_expire, NULL) > 0);
+
+    _fired = 0;
+    ASSERT_EQUAL_INT(0, wheel->advance(wheel, base + 45));
+    ASSERT_EQUAL_INT(0, _fired);
+    int waitms = wheel->nexttimeout(wheel);
+    ASSERT(waitms >= 0 && waitms <= 51);
+    ASSERT_EQUAL_INT(1, wheel->advance(wheel, base + 60));
+    ASSERT_EQUAL_INT(1, _fired);
+    ASSERT_EQUAL_INT(0, wheel->size(wheel));
+    wheel->free(wheel);
+
+    // zero timeout expires on the next call
+    wheel = qtimerwheel(0, 0);
+    ASSERT_TRUE(wheel->add(wheel, 0, on_expire, NULL) > 0);
+    ASSERT_EQUAL_INT(0, wheel->nexttimeout(wheel));
+    ASSERT_EQUAL_INT(1, wheel->expire(wheel));
+    wheel->free(wheel);
+}
+
+TEST("Test timers across the wheels") {
+    const int num = 5000;
+    struct record *recs = (struct record *) calloc(num, sizeof(struct record));
+    qtimerwheel_t *wheel = qtimerwheel(1, 0);
+    int64_t base = now_ms();
+
+    unsigned int seed = 1;
+    int i;
+    for (i = 0; i < num; i++) {
+        // up to ~4.6 hours covers the third wheel
+        seed = seed * 1103515245 + 12345;
+        int timeoutms = (i < num / 2) ? (int) (seed % 5000)
+                : (int) (seed % (1 << 24));
+        // add() reads the clock itself, somewhere between these two.
+        recs[i].due = now_ms() + timeoutms;
+        recs[i].id = wheel->add(wheel, timeoutms, on_expire, &recs[i]);
+        recs[i].duemax = now_ms() + timeoutms;
+        ASSERT(recs[i].id > 0);
+    }
+    // cancel every 5th timer
+    for (i = 0; i < num; i += 5) {
+        ASSERT_TRUE(wheel->cancel(wheel, recs[i].id));
+    }
+
+    _fired = 0;
+    int step = 997;
+    for (_clock = base; wheel->size(wheel) > 0; _clock += step) {
+        wheel->advance(wheel, _clock);
+    }
+    ASSERT_EQUAL_INT(num - num / 5, _fired);
+
+    for (i = 0; i < num; i++) {
+        if (i % 5 == 0) {
+            ASSERT_EQUAL_INT(0, recs[i].fired);
+            continue;
+        }
+        // never early, and on the first advance() after the due time.
+        ASSERT(recs[i].fired >= recs[i].due);
+        ASSERT(recs[i].fired < recs[i].duemax + step + 2);
+    }
+
+    wheel->free(wheel);
+    free(recs);
+}
+
+TEST("Test reset()") {
+    qtimerwheel_t *wheel = qtimerwheel(1, 0);
+    int64_t base = now_ms();
+    struct record rec = { 0, 0, 0 };
+    rec.id = wheel->add(wheel, 100, on_expire, &rec);
+
+    // push back twice
+    ASSERT_TRUE(wheel->reset(wheel, rec.id, 1000));
+    ASSERT_TRUE(wheel->reset(wheel, rec.id, 100000));
+    _clock = base + 5000;
+    ASSERT_EQUAL_INT(0, wheel->advance(wheel, _clock));
+    ASSERT_EQUAL_INT(1, wheel->size(wheel));
+    _clock = base + 100010;
+    ASSERT_EQUAL_INT(1, wheel->advance(wheel, _clock));
+    ASSERT_EQUAL_INT(base + 100010, rec.fired);
+
+    // expired timer can't be reset
+    ASSERT_FALSE(wheel->reset(wheel, rec.id, 100));
+    ASSERT_EQUAL_INT(ENOENT, errno);
+    wheel->free(wheel);
+}
+
+TEST("Test callbacks changing the wheel") {
+    qtimerwheel_t *wheel = qtimerwheel(10, QTIMERWHEEL_THREADSAFE);
+    int64_t base = now_ms();
+    int64_t other;
+    int64_t first = wheel->add(wheel, 100, on_cancel_other, &other);
+    other = wheel->add(wheel, 100, on_cancel_other, &first);
+    ASSERT(first > 0 && other > 0);
+
+    // only one of them runs, and the added timer expires in the same call.
+    _fired = _failed = 0;
+    ASSERT_EQUAL_INT(2, wheel->advance(wheel, base + 200));
+    ASSERT_EQUAL_INT(2, _fired);
+    ASSERT_EQUAL_INT(0, _failed);
+    ASSERT_EQUAL_INT(0, wheel->size(wheel));
+    wheel->free(wheel);
+}
+
+QUNIT_END();
@@ -0,0 +1,116 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "qunit.h"
+#include "qlibc.h"
+#include "qlibcext.h"
+
+#define NUM_THREADS (8)
+
+static qtokenbucket_atomic_t shared_bucket;
+
+static void *consumer(void *arg) {
+    int *granted = (int *) arg;
+    int i;
+    for (i = 0; i < 10000; i++) {
+        if (qtokenbucket_atomic_consume(&shared_bucket, 1) == true)
+            (*granted)++;
+    }
+    return NULL;
+}
+
+QUNIT_START("Test qtokenbucket.c");
+
+TEST("Test qtokenbucket_consume() and waittime()") {
+    qtokenbucket_t bucket;
+    qtokenbucket_init(&bucket, 5, 10, 1);
+    ASSERT_TRUE(qtokenbucket_consume(&bucket, 3));
+    ASSERT_TRUE(qtokenbucket_consume(&bucket, 2));
+    ASSERT_FALSE(qtokenbucket_consume(&bucket, 1));
+    ASSERT_TRUE(qtokenbucket_waittime(&bucket, 1) > 0);
+}
+
+TEST("Test qtokenbucket_atomic_consume() with the initial tokens") {
+    qtokenbucket_atomic_t bucket;
+    qtokenbucket_atomic_init(&bucket, 5, 10, 1);
+    ASSERT_FALSE(qtokenbucket_atomic_consume(&bucket, 6));
+    ASSERT_TRUE(qtokenbucket_atomic_consume(&bucket, 3));
+    ASSERT_TRUE(qtokenbucket_atomic_consume(&bucket, 2));
+    ASSERT_FALSE(qtokenbucket_atomic_consume(&bucket, 1));
+
+    // a token every second
+    long wait = qtokenbucket_atomic_waittime(&bucket, 1);
+    ASSERT_TRUE(wait > 0 && wait <= 1000);
+    wait = qtokenbucket_atomic_waittime(&bucket, 2);
+    ASSERT_TRUE(wait > 1000 && wait <= 2000);
+}
+
+TEST("Test qtokenbucket_atomic_consume() refills up to max_tokens") {
+    qtokenbucket_atomic_t bucket;
+    qtokenbucket_atomic_init(&bucket, 0, 10, 1000);
+    ASSERT_TRUE(qtokenbucket_atomic_waittime(&bucket, 10) > 0);
+
+    // 100 tokens worth of time, but the bucket holds 10
+    usleep(100 * 1000);
+    ASSERT_EQUAL_INT(0, qtokenbucket_atomic_waittime(&bucket, 10));
+    ASSERT_FALSE(qtokenbucket_atomic_consume(&bucket, 11));
+    ASSERT_TRUE(qtokenbucket_atomic_consume(&bucket, 10));
+    ASSERT_TRUE(qtokenbucket_atomic_waittime(&bucket, 10) > 0);
+
+    // the initial tokens are capped as well
+    qtokenbucket_atomic_init(&bucket, 100, 10, 1);
+    ASSERT_FALSE(qtokenbucket_atomic_consume(&bucket, 11));
+    ASSERT_TRUE(qtokenbucket_atomic_consume(&bucket, 10));
+}
+
+TEST("Test qtokenbucket_atomic_consume() shared by threads") {
+    // a slow rate, so no more than a token is refilled during the test
+    qtokenbucket_atomic_init(&shared_bucket, 1000, 1000, 1);
+
+    pthread_t threads[NUM_THREADS];
+    int granted[NUM_THREADS];
+    int i, total = 0;
+    for (i = 0; i < NUM_THREADS; i++) {
+        granted[i] = 0;
+        ASSERT_EQUAL_INT(0, pthread_create(&threads[i], NULL, consumer,
+                                           &granted[i]));
+    }
+    for (i = 0; i < NUM_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        total += granted[i];
+    }
+
+    // no token is granted twice
+    ASSERT_TRUE(total >= 1000 && total <= 1001);
+}
+
+QUNIT_END();
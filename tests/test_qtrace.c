@@ -0,0 +1,117 @@
+/******************************************************************************
+ * qLibc
+ *
+ * Copyright (c) 2010-2015 Seungyoung Kim.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "qunit.h"
+#include "qlibc.h"
+
+#define MAX_EVENTS  (8)
+
+static qtrace_event_t events[MAX_EVENTS];
+static int nevents = 0;
+
+static void tracer(const qtrace_event_t *event, void *userdata) {
+    if (nevents < MAX_EVENTS)
+        events[nevents++] = *event;
+    (*(int *) userdata)++;
+    errno = EFAULT;  // must not leak to the caller
+}
+
+QUNIT_START("Test qtrace.c");
+
+TEST("qtrace_name()") {
+    ASSERT_EQUAL_STR("socket.resolve", qtrace_name(QTRACE_SOCKET_RESOLVE));
+    ASSERT_EQUAL_STR("io.read", qtrace_name(QTRACE_IO_READ));
+    ASSERT_EQUAL_STR("http.response", qtrace_name(QTRACE_HTTP_RESPONSE));
+    ASSERT_EQUAL_STR("unknown", qtrace_name(0));
+}
+
+TEST("qio_write() / qio_read() events") {
+    int fds[2], calls = 0;
+    ASSERT_EQUAL_INT(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+
+    ASSERT_FALSE(qtrace_enabled());
+    qtrace_set(tracer, &calls);
+    ASSERT_TRUE(qtrace_enabled());
+
+    nevents = 0;
+    char buf[16];
+    errno = 0;
+    ASSERT_EQUAL_INT(5, qio_write(fds[0], "hello", 5, 1000));
+    ASSERT_EQUAL_INT(0, errno);
+    ASSERT_EQUAL_INT(5, qio_read(fds[1], buf, 5, 1000));
+    ASSERT_EQUAL_INT(2, nevents);
+    ASSERT_EQUAL_INT(2, calls);
+
+    ASSERT_EQUAL_INT(QTRACE_IO_WRITE, events[0].type);
+    ASSERT_EQUAL_STR("io.write", events[0].name);
+    ASSERT_EQUAL_INT(fds[0], events[0].fd);
+    ASSERT_EQUAL_INT(5, events[0].result);
+    ASSERT_EQUAL_INT(0, events[0].error);
+    ASSERT_EQUAL_INT(QTRACE_IO_READ, events[1].type);
+    ASSERT_EQUAL_INT(fds[1], events[1].fd);
+    ASSERT_EQUAL_INT(5, events[1].result);
+    ASSERT_TRUE(events[1].start >= events[0].start);
+
+    // timed out read reports the error
+    ASSERT_EQUAL_INT(0, qio_read(fds[1], buf, sizeof(buf), 10));
+    ASSERT_EQUAL_INT(ETIMEDOUT, errno);
+    ASSERT_EQUAL_INT(3, nevents);
+    ASSERT_EQUAL_INT(0, events[2].result);
+    ASSERT_EQUAL_INT(ETIMEDOUT, events[2].error);
+    ASSERT_TRUE(events[2].elapsed >= 10 * 1000000ULL);
+
+    // nothing after unset
+    qtrace_set(NULL, NULL);
+    ASSERT_FALSE(qtrace_enabled());
+    ASSERT_EQUAL_INT(5, qio_write(fds[0], "hello", 5, 1000));
+    ASSERT_EQUAL_INT(3, nevents);
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST("qsocket_resolve() events") {
+    int calls = 0;
+    qtrace_set(tracer, &calls);
+
+    nevents = 0;
+    struct sockaddr_storage addr;
+    socklen_t addrlen;
+    ASSERT_TRUE(qsocket_resolve(&addr, &addrlen, "127.0.0.1", 80, AF_INET));
+    ASSERT_EQUAL_INT(1, nevents);
+    ASSERT_EQUAL_INT(QTRACE_SOCKET_RESOLVE, events[0].type);
+    ASSERT_EQUAL_STR("127.0.0.1", events[0].detail);
+    ASSERT_EQUAL_INT(-1, events[0].fd);
+    ASSERT_TRUE(events[0].result >= 1);
+
+    qtrace_set(NULL, NULL);
+}
+
+QUNIT_END();
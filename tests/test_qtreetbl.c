@@ -32,6 +32,7 @@
 
 #include <math.h>
 #include <errno.h>
+#include <pthread.h>
 #include "qunit.h"
 #include "qlibc.h"
 
@@ -39,6 +40,19 @@ static void ASSERT_TREE_CHECK(qtreetbl_t *tbl, bool verbose);
 static bool print_tree(qtreetbl_t *tbl);
 int uint32_cmp(const void *name1, size_t namesize1, const void *name2, size_t namesize2);
 static void perf_test(uint32_t keys[], int num_keys);
+static bool range_cb(const qtreetbl_obj_t *obj, void *userdata);
+static void *reader_thread(void *arg);
+static bool count_cb(const qtreetbl_obj_t *obj, void *userdata);
+
+struct bulk_iter_s {
+    int num;            // number of keys to give
+    int unsorted_at;    // give a smaller key at this position if not 0
+    int i;
+    char key[16];
+};
+static bool bulk_iter(void *userdata, qtreetbl_obj_t *obj);
+static int reverse_cmp(const void *name1, size_t namesize1,
+                       const void *name2, size_t namesize2);
 
 QUNIT_START("Test qtreetbl.c");
 
@@ -262,6 +276,168 @@ TEST("Test clear()") {
     tbl->free(tbl);
 }
 
+TEST("Test bulkload()") {
+    struct bulk_iter_s it;
+
+    // every small size must give a valid tree
+    for (int n = 0; n <= 300; n++) {
+        qtreetbl_t *tbl = qtreetbl(0);
+        memset((void *) &it, 0, sizeof(it));
+        it.num = n;
+        ASSERT_EQUAL_BOOL(true, tbl->bulkload(tbl, bulk_iter, &it));
+        ASSERT_EQUAL_INT(n, tbl->size(tbl));
+        ASSERT_TREE_CHECK(tbl, false);
+        tbl->free(tbl);
+    }
+
+    qtreetbl_t *tbls[] = { qtreetbl(0), qtreetbl(QTREETBL_BPTREE) };
+    for (int t = 0; t < 2; t++) {
+        qtreetbl_t *tbl = tbls[t];
+        memset((void *) &it, 0, sizeof(it));
+        it.num = 100000;
+        ASSERT_EQUAL_BOOL(true, tbl->bulkload(tbl, bulk_iter, &it));
+        ASSERT_EQUAL_INT(100000, tbl->size(tbl));
+        ASSERT_EQUAL_INT(0, qtreetbl_check(tbl));
+        ASSERT_EQUAL_STR("K0000000", tbl->getstr(tbl, "K0000000", false));
+        ASSERT_EQUAL_STR("K0199998", tbl->getstr(tbl, "K0199998", false));
+        ASSERT_NULL(tbl->getstr(tbl, "K0000001", false));
+
+        // loading again requires an empty table
+        memset((void *) &it, 0, sizeof(it));
+        it.num = 10;
+        ASSERT_EQUAL_BOOL(false, tbl->bulkload(tbl, bulk_iter, &it));
+        ASSERT_EQUAL_INT(EINVAL, errno);
+
+        // keeps working as a regular table
+        ASSERT_EQUAL_BOOL(true, tbl->putstr(tbl, "K0000001", "odd"));
+        ASSERT_EQUAL_BOOL(true, tbl->remove(tbl, "K0000000"));
+        ASSERT_EQUAL_INT(0, qtreetbl_check(tbl));
+        qtreetbl_obj_t obj = tbl->select(tbl, 0, false);
+        ASSERT_EQUAL_STR("K0000001", (char *) obj.name);
+        tbl->clear(tbl);
+
+        // unsorted input leaves the table empty
+        memset((void *) &it, 0, sizeof(it));
+        it.num = 5000;
+        it.unsorted_at = 3000;
+        ASSERT_EQUAL_BOOL(false, tbl->bulkload(tbl, bulk_iter, &it));
+        ASSERT_EQUAL_INT(EINVAL, errno);
+        ASSERT_EQUAL_INT(0, tbl->size(tbl));
+        ASSERT_EQUAL_INT(0, qtreetbl_check(tbl));
+        tbl->free(tbl);
+    }
+}
+
+TEST("Test dump() / restore()") {
+    const char *path = "test_qtreetbl.snapshot";
+    struct bulk_iter_s it;
+    memset((void *) &it, 0, sizeof(it));
+    it.num = 10000;
+    qtreetbl_t *tbl = qtreetbl(0);
+    ASSERT_EQUAL_BOOL(true, tbl->bulkload(tbl, bulk_iter, &it));
+    ASSERT_EQUAL_BOOL(true, tbl->dump(tbl, path, true));
+
+    // bulk loaded into empty tables, inserted into a non-empty one
+    qtreetbl_t *tbls[] = { qtreetbl(0), qtreetbl(QTREETBL_BPTREE), qtreetbl(0) };
+    ASSERT_EQUAL_BOOL(true, tbls[2]->putstr(tbls[2], "K0000001", "odd"));
+    for (int t = 0; t < 3; t++) {
+        qtreetbl_t *tbl2 = tbls[t];
+        ASSERT_EQUAL_INT(10000, tbl2->restore(tbl2, path));
+        ASSERT_EQUAL_INT(((t < 2) ? 10000 : 10001), tbl2->size(tbl2));
+        ASSERT_EQUAL_INT(0, qtreetbl_check(tbl2));
+        ASSERT_EQUAL_STR("K0000000", tbl2->getstr(tbl2, "K0000000", false));
+        ASSERT_EQUAL_STR("K0019998", tbl2->getstr(tbl2, "K0019998", false));
+        qtreetbl_obj_t obj = tbl2->select(tbl2, 0, false);
+        ASSERT_EQUAL_STR("K0000000", (char *) obj.name);
+        tbl2->free(tbl2);
+    }
+
+    // saved order doesn't match the comparator, falls back to insertion
+    qtreetbl_t *tbl2 = qtreetbl(0);
+    tbl2->set_compare(tbl2, reverse_cmp);
+    ASSERT_EQUAL_INT(10000, tbl2->restore(tbl2, path));
+    ASSERT_EQUAL_INT(10000, tbl2->size(tbl2));
+    ASSERT_EQUAL_INT(0, qtreetbl_check(tbl2));
+    qtreetbl_obj_t obj = tbl2->select(tbl2, 0, false);
+    ASSERT_EQUAL_STR("K0019998", (char *) obj.name);
+    tbl2->free(tbl2);
+
+    // a broken snapshot leaves the table untouched
+    FILE *fp = fopen(path, "r+");
+    ASSERT_NOT_NULL(fp);
+    fseek(fp, -3, SEEK_END);
+    fputc('X', fp);
+    fclose(fp);
+    tbl2 = qtreetbl(0);
+    ASSERT_EQUAL_INT(-1, tbl2->restore(tbl2, path));
+    ASSERT_EQUAL_INT(EBADMSG, errno);
+    ASSERT_EQUAL_INT(0, tbl2->size(tbl2));
+    tbl2->free(tbl2);
+
+    unlink(path);
+    tbl->free(tbl);
+}
+
+TEST("Test integer and fixed-size key modes") {
+    int engines[] = { 0, QTREETBL_BPTREE };
+    for (int t = 0; t < 2; t++) {
+        qtreetbl_t *utbl = qtreetbl(QTREETBL_KEY_UINT64 | engines[t]);
+        qtreetbl_t *itbl = qtreetbl(QTREETBL_KEY_INT64 | engines[t]);
+        srand(26);
+        for (int i = 0; i < 5000; i++) {
+            uint64_t ukey = ((uint64_t) rand() << 32) | (uint64_t) rand();
+            int64_t ikey = (int64_t) rand() - RAND_MAX / 2;
+            ASSERT_EQUAL_BOOL(true, utbl->putobj(utbl, &ukey, sizeof(ukey), &i, sizeof(i)));
+            ASSERT_EQUAL_BOOL(true, itbl->putobj(itbl, &ikey, sizeof(ikey), &i, sizeof(i)));
+        }
+        ASSERT_EQUAL_INT(0, qtreetbl_check(utbl));
+        ASSERT_EQUAL_INT(0, qtreetbl_check(itbl));
+
+        // numeric order, negative keys first
+        qtreetbl_obj_t obj;
+        memset((void *) &obj, 0, sizeof(obj));
+        uint64_t ulast = 0;
+        while (utbl->getnext(utbl, &obj, false)) {
+            uint64_t ukey = *(uint64_t *) obj.name;
+            ASSERT(ukey >= ulast);
+            ulast = ukey;
+        }
+        memset((void *) &obj, 0, sizeof(obj));
+        int64_t ilast = INT64_MIN;
+        while (itbl->getnext(itbl, &obj, false)) {
+            int64_t ikey = *(int64_t *) obj.name;
+            ASSERT(ikey > ilast);
+            ilast = ikey;
+        }
+
+        int64_t ikey = -5;
+        ASSERT_EQUAL_BOOL(true, itbl->putobj(itbl, &ikey, sizeof(ikey), "neg", 4));
+        ASSERT_EQUAL_STR("neg", (char *) itbl->getobj(itbl, &ikey, sizeof(ikey), NULL, false));
+        ASSERT_EQUAL_BOOL(true, itbl->removeobj(itbl, &ikey, sizeof(ikey)));
+
+        // wrong key size
+        uint32_t shortkey = 1;
+        ASSERT_EQUAL_BOOL(false, utbl->putobj(utbl, &shortkey, sizeof(shortkey), "", 1));
+        ASSERT_EQUAL_INT(EINVAL, errno);
+        ASSERT_NULL(utbl->getobj(utbl, &shortkey, sizeof(shortkey), NULL, false));
+        ASSERT_EQUAL_INT(EINVAL, errno);
+        utbl->free(utbl);
+        itbl->free(itbl);
+
+        // fixed-size binary keys take the size of the first key
+        qtreetbl_t *ftbl = qtreetbl(QTREETBL_KEY_FIXED | engines[t]);
+        ASSERT_EQUAL_BOOL(true, ftbl->putstr(ftbl, "key2", "2"));
+        ASSERT_EQUAL_BOOL(true, ftbl->putstr(ftbl, "key1", "1"));
+        ASSERT_EQUAL_BOOL(true, ftbl->putstr(ftbl, "key3", "3"));
+        ASSERT_EQUAL_BOOL(false, ftbl->putstr(ftbl, "key10", "10"));
+        ASSERT_EQUAL_INT(EINVAL, errno);
+        ASSERT_EQUAL_STR("1", ftbl->getstr(ftbl, "key1", false));
+        ASSERT_EQUAL_INT(2, ftbl->rank(ftbl, "key3", 5));
+        ASSERT_EQUAL_INT(0, qtreetbl_check(ftbl));
+        ftbl->free(ftbl);
+    }
+}
+
 TEST("Test putobj() / getobj()") {
     qtreetbl_t *tbl = qtreetbl(0);
     ASSERT_EQUAL_BOOL(true, tbl->putobj(tbl, "bin_name", 8, "bin_data", 8));
@@ -401,6 +577,272 @@ TEST("Test remove() in getnext() loop") {
     tbl->free(tbl);
 }
 
+TEST("Test select() / rank()") {
+    const char *keys[] = { "A", "S", "E", "R", "C", "D", "I", "N", "B", "X", "" };
+    const char *sorted = "ABCDEINRSX";
+    qtreetbl_t *tbls[] = { qtreetbl(0), qtreetbl(QTREETBL_BPTREE) };
+    for (int t = 0; t < 2; t++) {
+        qtreetbl_t *tbl = tbls[t];
+        for (int i = 0; keys[i][0] != '\0'; i++) {
+            tbl->putstr(tbl, keys[i], keys[i]);
+        }
+        ASSERT_EQUAL_INT(0, qtreetbl_check(tbl));
+
+        for (int i = 0; sorted[i] != '\0'; i++) {
+            char key[2] = { sorted[i], '\0' };
+            qtreetbl_obj_t obj = tbl->select(tbl, i, false);
+            ASSERT_EQUAL_STR(key, (char *) obj.name);
+            ASSERT_EQUAL_INT(i, tbl->rank(tbl, key, sizeof(key)));
+        }
+        qtreetbl_obj_t obj = tbl->select(tbl, 10, false);
+        ASSERT_NULL(obj.name);
+        ASSERT_EQUAL_INT(ENOENT, errno);
+        obj = tbl->select(tbl, 5, true);
+        ASSERT_EQUAL_STR("I", (char *) obj.data);
+        free(obj.name);
+        free(obj.data);
+
+        ASSERT_EQUAL_INT(0, tbl->rank(tbl, "0", 2));
+        ASSERT_EQUAL_INT(5, tbl->rank(tbl, "F", 2));
+        ASSERT_EQUAL_INT(10, tbl->rank(tbl, "Z", 2));
+
+        // counts stay right through the removals
+        tbl->remove(tbl, "E");
+        tbl->remove(tbl, "A");
+        ASSERT_EQUAL_INT(0, qtreetbl_check(tbl));
+        ASSERT_EQUAL_STR("B", (char *) tbl->select(tbl, 0, false).name);
+        ASSERT_EQUAL_STR("I", (char *) tbl->select(tbl, 3, false).name);
+        ASSERT_EQUAL_INT(3, tbl->rank(tbl, "F", 2));
+        tbl->free(tbl);
+    }
+
+    // against a sorted walk with random keys
+    qtreetbl_t *tbl = qtreetbl(0);
+    srand(24);
+    for (int i = 0; i < 3000; i++) {
+        char *key = qstrdupf("K%05d", rand() % 5000);
+        if (i % 3 == 2) {
+            tbl->remove(tbl, key);
+        } else {
+            tbl->putstr(tbl, key, "");
+        }
+        free(key);
+    }
+    ASSERT_EQUAL_INT(0, qtreetbl_check(tbl));
+    qtreetbl_obj_t obj;
+    memset((void *) &obj, 0, sizeof(obj));
+    size_t k = 0;
+    while (tbl->getnext(tbl, &obj, false)) {
+        ASSERT_EQUAL_INT(k, tbl->rank(tbl, obj.name, obj.namesize));
+        ASSERT_EQUAL_STR((char *) obj.name, (char *) tbl->select(tbl, k, false).name);
+        k++;
+    }
+    ASSERT_EQUAL_INT(tbl->size(tbl), k);
+    tbl->free(tbl);
+}
+
+TEST("Test cursor_seek() / cursor_next()") {
+    const char *keys[] = { "A", "S", "E", "R", "C", "D", "I", "N", "B", "X", "" };
+    qtreetbl_t *tbl = qtreetbl(0);
+    int i;
+    for (i = 0; keys[i][0] != '\0'; i++) {
+        tbl->putstr(tbl, keys[i], keys[i]);
+    }
+
+    struct {
+        const char *lo, *hi, *expect;
+    } tests[] = {
+        { "C", "N", "CDEIN" },
+        { "F", "R", "INR" },
+        { NULL, "C", "ABC" },
+        { "S", NULL, "SX" },
+        { NULL, NULL, "ABCDEINRSX" },
+        { "0", "Z", "ABCDEINRSX" },
+        { "J", "M", "" },
+        { "Y", NULL, "" },
+        { "N", "F", "" },
+    };
+    qtreetbl_cursor_t cursor;
+    qtreetbl_obj_t obj;
+    for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        char buf[1024] = "";
+        bool found = tbl->cursor_seek(tbl, &cursor,
+                tests[i].lo, (tests[i].lo) ? strlen(tests[i].lo) + 1 : 0,
+                tests[i].hi, (tests[i].hi) ? strlen(tests[i].hi) + 1 : 0);
+        ASSERT_EQUAL_INT((tests[i].expect[0] != '\0'), found);
+        while (tbl->cursor_next(tbl, &cursor, &obj, false)) {
+            qstrcatf(buf, "%s", (char*)obj.name);
+        }
+        ASSERT_EQUAL_INT(ENOENT, errno);
+        ASSERT_EQUAL_STR(tests[i].expect, buf);
+    }
+
+    // newmem
+    tbl->cursor_seek(tbl, &cursor, "D", 2, NULL, 0);
+    ASSERT_TRUE(tbl->cursor_next(tbl, &cursor, &obj, true));
+    ASSERT_EQUAL_STR("D", obj.name);
+    ASSERT_EQUAL_STR("D", obj.data);
+    free(obj.name);
+    free(obj.data);
+
+    // range() with a callback which stops at the key "R"
+    char buf[1024] = "";
+    ASSERT_EQUAL_INT(5, tbl->range(tbl, "B", 2, "I", 2, range_cb, buf));
+    ASSERT_EQUAL_STR("BCDEI", buf);
+    buf[0] = '\0';
+    ASSERT_EQUAL_INT(3, tbl->range(tbl, "I", 2, NULL, 0, range_cb, buf));
+    ASSERT_EQUAL_STR("INR", buf);
+
+    tbl->free(tbl);
+
+    // numeric keys
+    tbl = qtreetbl(0);
+    tbl->set_compare(tbl, uint32_cmp);
+    uint32_t key;
+    for (key = 0; key < 10000; key += 2) {
+        tbl->putobj(tbl, &key, sizeof(key), &key, sizeof(key));
+    }
+    uint32_t lo = 101, hi = 301;
+    tbl->cursor_seek(tbl, &cursor, &lo, sizeof(lo), &hi, sizeof(hi));
+    for (key = 102; tbl->cursor_next(tbl, &cursor, &obj, false); key += 2) {
+        ASSERT_EQUAL_INT(key, *(uint32_t *)obj.name);
+    }
+    ASSERT_EQUAL_INT(302, key);
+    tbl->free(tbl);
+}
+
+TEST("Test concurrent readers with QTREETBL_RWLOCK") {
+    qtreetbl_t *tbl = qtreetbl(QTREETBL_RWLOCK);
+    tbl->set_compare(tbl, uint32_cmp);
+    uint32_t key;
+    for (key = 0; key < 1000; key++) {
+        tbl->putobj(tbl, &key, sizeof(key), &key, sizeof(key));
+    }
+
+    pthread_t threads[4];
+    int i;
+    for (i = 0; i < 4; i++) {
+        ASSERT_EQUAL_INT(0, pthread_create(&threads[i], NULL, reader_thread, tbl));
+    }
+    // writers are serialized against the readers
+    for (key = 1000; key < 2000; key++) {
+        ASSERT_TRUE(tbl->putobj(tbl, &key, sizeof(key), &key, sizeof(key)));
+    }
+    for (i = 0; i < 4; i++) {
+        void *ret;
+        pthread_join(threads[i], &ret);
+        ASSERT_TRUE(ret == NULL);
+    }
+    ASSERT_EQUAL_INT(2000, tbl->size(tbl));
+    ASSERT_EQUAL_INT(0, qtreetbl_check(tbl));
+
+    tbl->free(tbl);
+}
+
+TEST("Test B+tree engine against red-black tree") {
+    qtreetbl_t *rbt = qtreetbl(0);
+    qtreetbl_t *bpt = qtreetbl(QTREETBL_BPTREE);
+    ASSERT_NOT_NULL(bpt);
+    ASSERT_EQUAL_INT(0, qtreetbl_check(bpt));
+
+    // insert random keys with duplicates, then remove half of the key range
+    srand(19);
+    for (int i = 0; i < 20000; i++) {
+        char *key = qstrdupf("K%05d", rand() % 10000);
+        ASSERT_EQUAL_BOOL(true, rbt->putstr(rbt, key, key));
+        ASSERT_EQUAL_BOOL(true, bpt->putstr(bpt, key, key));
+        free(key);
+    }
+    ASSERT_EQUAL_INT(rbt->size(rbt), bpt->size(bpt));
+    ASSERT_EQUAL_INT(0, qtreetbl_check(bpt));
+    for (int i = 0; i < 10000; i += 2) {
+        char *key = qstrdupf("K%05d", i);
+        bool removed = rbt->remove(rbt, key);
+        ASSERT_EQUAL_BOOL(removed, bpt->remove(bpt, key));
+        free(key);
+    }
+    ASSERT_EQUAL_INT(rbt->size(rbt), bpt->size(bpt));
+    ASSERT_EQUAL_INT(0, qtreetbl_check(bpt));
+
+    // lookups
+    for (int i = 0; i < 10000; i++) {
+        char *key = qstrdupf("K%05d", i);
+        char *expect = rbt->getstr(rbt, key, false);
+        char *value = bpt->getstr(bpt, key, false);
+        if (expect == NULL) {
+            ASSERT_NULL(value);
+        } else {
+            ASSERT_EQUAL_STR(expect, value);
+        }
+        free(key);
+    }
+    char *rkey = rbt->find_min(rbt, NULL), *bkey = bpt->find_min(bpt, NULL);
+    ASSERT_EQUAL_STR(rkey, bkey);
+    free(rkey);
+    free(bkey);
+    rkey = rbt->find_max(rbt, NULL);
+    bkey = bpt->find_max(bpt, NULL);
+    ASSERT_EQUAL_STR(rkey, bkey);
+    free(rkey);
+    free(bkey);
+
+    // full scan in the same order
+    qtreetbl_obj_t robj, bobj;
+    memset((void *) &robj, 0, sizeof(robj));
+    memset((void *) &bobj, 0, sizeof(bobj));
+    size_t cnt = 0;
+    while (rbt->getnext(rbt, &robj, false)) {
+        ASSERT_EQUAL_BOOL(true, bpt->getnext(bpt, &bobj, false));
+        ASSERT_EQUAL_STR((char *) robj.name, (char *) bobj.name);
+        cnt++;
+    }
+    ASSERT_EQUAL_BOOL(false, bpt->getnext(bpt, &bobj, false));
+    ASSERT_EQUAL_INT(rbt->size(rbt), cnt);
+
+    // nearest keys, including the ones out of the key range
+    const char *probes[] = { "A", "K00000", "K00001", "K04000", "K04001",
+                             "K09998", "K09999", "Z" };
+    for (int i = 0; i < (int) (sizeof(probes) / sizeof(char *)); i++) {
+        robj = rbt->find_nearest(rbt, probes[i], strlen(probes[i]) + 1, false);
+        bobj = bpt->find_nearest(bpt, probes[i], strlen(probes[i]) + 1, false);
+        ASSERT_EQUAL_STR((char *) robj.name, (char *) bobj.name);
+    }
+
+    // range scans
+    qtreetbl_cursor_t rcur, bcur;
+    ASSERT_EQUAL_BOOL(true, qtreetbl_cursor_seek(rbt, &rcur, "K03000", 7, "K03500", 7));
+    ASSERT_EQUAL_BOOL(true, qtreetbl_cursor_seek(bpt, &bcur, "K03000", 7, "K03500", 7));
+    cnt = 0;
+    while (qtreetbl_cursor_next(rbt, &rcur, &robj, false)) {
+        ASSERT_EQUAL_BOOL(true, qtreetbl_cursor_next(bpt, &bcur, &bobj, false));
+        ASSERT_EQUAL_STR((char *) robj.name, (char *) bobj.name);
+        cnt++;
+    }
+    ASSERT_EQUAL_BOOL(false, qtreetbl_cursor_next(bpt, &bcur, &bobj, false));
+    size_t rcnt = 0, bcnt = 0;
+    ASSERT_EQUAL_INT(cnt, qtreetbl_range(rbt, "K03000", 7, "K03500", 7, count_cb, &rcnt));
+    ASSERT_EQUAL_INT(cnt, qtreetbl_range(bpt, "K03000", 7, "K03500", 7, count_cb, &bcnt));
+    ASSERT_EQUAL_INT(rcnt, bcnt);
+    ASSERT_EQUAL_BOOL(false, qtreetbl_cursor_seek(bpt, &bcur, "Z", 2, NULL, 0));
+    ASSERT_EQUAL_INT(ENOENT, errno);
+
+    // drain by removal
+    for (int i = 0; i < 10000; i++) {
+        char *key = qstrdupf("K%05d", i);
+        bpt->remove(bpt, key);
+        free(key);
+    }
+    ASSERT_EQUAL_INT(0, bpt->size(bpt));
+    ASSERT_EQUAL_INT(0, qtreetbl_check(bpt));
+    ASSERT_EQUAL_BOOL(true, bpt->putstr(bpt, "key", "value"));
+    ASSERT_EQUAL_STR("value", bpt->getstr(bpt, "key", false));
+    bpt->clear(bpt);
+    ASSERT_EQUAL_INT(0, bpt->size(bpt));
+
+    rbt->free(rbt);
+    bpt->free(bpt);
+}
+
 TEST("Test integrity of tree structure") {
     int num_keys = 10000;
 
@@ -639,3 +1081,56 @@ static void perf_test(uint32_t keys[], int num_keys) {
     tbl->free(tbl);
     ENABLE_PROGRESS_DOT();
 }
+
+static bool range_cb(const qtreetbl_obj_t *obj, void *userdata) {
+    qstrcatf((char *)userdata, "%s", (char *)obj->name);
+    return (strcmp((char *)obj->name, "R") != 0);
+}
+
+static void *reader_thread(void *arg) {
+    qtreetbl_t *tbl = (qtreetbl_t *)arg;
+    int i;
+    for (i = 0; i < 100; i++) {
+        qtreetbl_cursor_t cursor;
+        qtreetbl_obj_t obj;
+        uint32_t expect = 0;
+
+        // keys are added in ascending order, so the scan sees a prefix
+        tbl->rdlock(tbl);
+        tbl->cursor_seek(tbl, &cursor, NULL, 0, NULL, 0);
+        while (tbl->cursor_next(tbl, &cursor, &obj, false)) {
+            if (*(uint32_t *)obj.data != expect++) {
+                tbl->unlock(tbl);
+                return (void *)1;
+            }
+        }
+        tbl->unlock(tbl);
+        if (expect < 1000) {
+            return (void *)1;
+        }
+    }
+    return NULL;
+}
+
+static bool count_cb(const qtreetbl_obj_t *obj, void *userdata) {
+    (*(size_t *)userdata)++;
+    return true;
+}
+
+static bool bulk_iter(void *userdata, qtreetbl_obj_t *obj) {
+    struct bulk_iter_s *it = (struct bulk_iter_s *)userdata;
+    if (it->i == it->num) {
+        return false;
+    }
+    int n = (it->unsorted_at > 0 && it->i == it->unsorted_at) ? 0 : it->i * 2;
+    snprintf(it->key, sizeof(it->key), "K%07d", n);
+    obj->name = obj->data = it->key;
+    obj->namesize = obj->datasize = strlen(it->key) + 1;
+    it->i++;
+    return true;
+}
+
+static int reverse_cmp(const void *name1, size_t namesize1,
+                       const void *name2, size_t namesize2) {
+    return qtreetbl_byte_cmp(name2, namesize2, name1, namesize1);
+}
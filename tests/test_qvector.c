@@ -30,9 +30,12 @@
  * Copyright (c) 2015 Zhenjiang Xie - https://github.com/Charles0429
  *****************************************************************************/
 
+#include <errno.h>
 #include "qunit.h"
 #include "qlibc.h"
 
+static int cmp_int(const void *data1, const void *data2);
+
 void test_thousands_of_values(int num_values, int options, char *prefix, char *postfix);
 
 QUNIT_START("Test qvector.c");
@@ -246,8 +249,205 @@ TEST("Test resize") {
     vector->free(vector);
 }
 
+TEST("Test circular mode") {
+    qvector_t *vector = qvector(4, sizeof(int), QVECTOR_CIRCULAR | QVECTOR_RESIZE_DOUBLE);
+    int model[256];
+    int num = 0;
+    int i, j, v;
+
+    // sliding window: push at the end, pop at the front, wraps around
+    for (i = 0; i < 10; i++) {
+        ASSERT_TRUE(vector->addlast(vector, &i));
+        if (i >= 3) {
+            int *data = vector->popfirst(vector);
+            ASSERT_EQUAL_INT(i - 3, *data);
+            free(data);
+        }
+    }
+    ASSERT_EQUAL_INT(3, vector->size(vector));
+    ASSERT_EQUAL_INT(4, vector->max);
+    for (i = 0; i < 3; i++) {
+        ASSERT_EQUAL_INT(7 + i, *(int *)vector->getat(vector, i, false));
+    }
+    vector->clear(vector);
+
+    // compare random operations with a plain array
+    unsigned int seed = 1;
+    for (i = 0; i < 2000; i++) {
+        seed = seed * 1103515245 + 12345;
+        int op = (seed >> 16) % 5;
+        int idx = (num > 0) ? (int)((seed >> 8) % (num + 1)) : 0;
+        v = i;
+        if (op <= 1 || num == 0) {
+            if (op == 0) idx = 0;
+            ASSERT_TRUE(vector->addat(vector, idx, &v));
+            memmove(&model[idx + 1], &model[idx], (num - idx) * sizeof(int));
+            model[idx] = v;
+            num++;
+        } else if (op == 2) {
+            if (idx == num) idx--;
+            ASSERT_TRUE(vector->removeat(vector, idx));
+            memmove(&model[idx], &model[idx + 1], (num - idx - 1) * sizeof(int));
+            num--;
+        } else if (op == 3) {
+            int *data = vector->popfirst(vector);
+            ASSERT_EQUAL_INT(model[0], *data);
+            free(data);
+            memmove(&model[0], &model[1], (num - 1) * sizeof(int));
+            num--;
+        } else {
+            if (idx == num) idx--;
+            ASSERT_TRUE(vector->setat(vector, idx, &v));
+            model[idx] = v;
+        }
+        if (num >= 200) {
+            vector->clear(vector);
+            num = 0;
+        }
+
+        ASSERT_EQUAL_INT(num, vector->size(vector));
+        for (j = 0; j < num; j++) {
+            ASSERT_EQUAL_INT(model[j], *(int *)vector->getat(vector, j, false));
+        }
+    }
+
+    // make sure the buffer is wrapped, then check the bulk operations
+    vector->clear(vector);
+    for (i = 0; i < 6; i++) {
+        vector->addlast(vector, &i);
+    }
+    for (i = -1; i > -4; i--) {
+        vector->addfirst(vector, &i);
+    }
+    ASSERT_TRUE(vector->head > 0);
+    size_t size;
+    int *array = vector->toarray(vector, &size);
+    ASSERT_EQUAL_INT(9, size);
+    for (i = 0; i < 9; i++) {
+        ASSERT_EQUAL_INT(i - 3, array[i]);
+    }
+    free(array);
+
+    qvector_obj_t obj;
+    memset((void *) &obj, 0, sizeof(obj));
+    i = -3;
+    while (vector->getnext(vector, &obj, false)) {
+        ASSERT_EQUAL_INT(i++, *(int *)obj.data);
+    }
+
+    vector->reverse(vector);
+    for (i = 0; i < 9; i++) {
+        ASSERT_EQUAL_INT(5 - i, *(int *)vector->getat(vector, i, false));
+    }
+    ASSERT_TRUE(vector->resize(vector, 20));
+    ASSERT_EQUAL_INT(0, vector->head);
+    for (i = 0; i < 9; i++) {
+        ASSERT_EQUAL_INT(5 - i, *(int *)vector->getat(vector, i, false));
+    }
+
+    vector->free(vector);
+}
+
+TEST("Test bulk operations") {
+    qvector_t *vector = qvector(0, sizeof(int), QVECTOR_RESIZE_DOUBLE);
+    int array[1000];
+    int i;
+    for (i = 0; i < 1000; i++) {
+        array[i] = (i * 7919) % 1000;
+    }
+
+    ASSERT_TRUE(vector->reserve(vector, 100));
+    ASSERT_EQUAL_INT(100, vector->max);
+    ASSERT_TRUE(vector->reserve(vector, 10));
+    ASSERT_EQUAL_INT(100, vector->max);
+
+    ASSERT_TRUE(vector->addarray(vector, array, 0));
+    ASSERT_TRUE(vector->addarray(vector, array, 1000));
+    ASSERT_TRUE(vector->addarray(vector, array, 10));
+    ASSERT_EQUAL_INT(1010, vector->size(vector));
+    for (i = 0; i < 1010; i++) {
+        ASSERT_EQUAL_INT(array[i % 1000], *(int *)vector->getat(vector, i, false));
+    }
+
+    int key = 1000;
+    ASSERT_EQUAL_INT(-1, vector->bsearch(vector, &key, cmp_int));
+    ASSERT_EQUAL_INT(ENOENT, errno);
+    vector->sort(vector, cmp_int);
+    for (i = 1; i < 1010; i++) {
+        ASSERT_TRUE(*(int *)vector->getat(vector, i - 1, false)
+                    <= *(int *)vector->getat(vector, i, false));
+    }
+    // the leading 10 values are stored twice, the first one is found
+    for (key = 0; key < 1000; key++) {
+        int expect = key;
+        for (i = 0; i < 10; i++) {
+            if (array[i] < key) expect++;
+        }
+        ASSERT_EQUAL_INT(expect, vector->bsearch(vector, &key, cmp_int));
+    }
+    key = 1000;
+    ASSERT_EQUAL_INT(-1, vector->bsearch(vector, &key, cmp_int));
+    vector->free(vector);
+
+    // wrapped circular vector
+    vector = qvector(8, sizeof(int), QVECTOR_CIRCULAR);
+    for (i = 0; i < 6; i++) {
+        vector->addlast(vector, &i);
+    }
+    for (i = 0; i < 4; i++) {
+        vector->removefirst(vector);
+    }
+    int more[] = { 9, 1, 8, 3, 7 };
+    ASSERT_TRUE(vector->addarray(vector, more, 5));
+    ASSERT_EQUAL_INT(8, vector->max);
+    int expect[] = { 4, 5, 9, 1, 8, 3, 7 };
+    for (i = 0; i < 7; i++) {
+        ASSERT_EQUAL_INT(expect[i], *(int *)vector->getat(vector, i, false));
+    }
+    vector->sort(vector, cmp_int);
+    int sorted[] = { 1, 3, 4, 5, 7, 8, 9 };
+    for (i = 0; i < 7; i++) {
+        ASSERT_EQUAL_INT(sorted[i], *(int *)vector->getat(vector, i, false));
+        ASSERT_EQUAL_INT(i, vector->bsearch(vector, &sorted[i], cmp_int));
+    }
+    vector->free(vector);
+}
+
+TEST("Test direct data access") {
+    qvector_t *vector = qvector(4, sizeof(int), QVECTOR_CIRCULAR);
+    size_t num;
+    ASSERT_NULL(qvector_data(vector, &num));
+    ASSERT_EQUAL_INT(0, num);
+
+    int i;
+    for (i = 0; i < 3; i++) {
+        vector->addlast(vector, &i);
+    }
+    vector->removefirst(vector);
+    for (i = 3; i < 5; i++) {
+        vector->addlast(vector, &i);
+    }
+    ASSERT_TRUE(vector->head > 0);
+
+    int *data = qvector_data(vector, &num);
+    ASSERT_EQUAL_INT(4, num);
+    ASSERT_EQUAL_INT(0, vector->head);
+    for (i = 0; i < num; i++) {
+        ASSERT_EQUAL_INT(i + 1, data[i]);
+        ASSERT_EQUAL_INT(i + 1, QVECTOR_AT(vector, int, i));
+    }
+    QVECTOR_AT(vector, int, 0) = 100;
+    ASSERT_EQUAL_INT(100, *(int *)vector->getfirst(vector, false));
+
+    vector->free(vector);
+}
+
 QUNIT_END();
 
+static int cmp_int(const void *data1, const void *data2) {
+    return *(const int *)data1 - *(const int *)data2;
+}
+
 void test_thousands_of_values(int num_values, int options, char *prefix, char *postfix) {
     struct test_obj {
         char *prefix;